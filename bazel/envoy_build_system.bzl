@@ -150,6 +150,7 @@ def envoy_cc_test(name,
                   data = [],
                   # List of pairs (Bazel shell script target, shell script args)
                   repository = "",
+                  external_deps = [],
                   deps = [],
                   tags = [],
                   coverage = True,
@@ -161,6 +162,7 @@ def envoy_cc_test(name,
         name = name + "_lib",
         srcs = srcs,
         data = data,
+        external_deps = external_deps,
         deps = deps,
         repository = repository,
         tags = test_lib_tags,
@@ -18,7 +18,9 @@ TARGET_RECIPES = {
     "protobuf": "protobuf",
     "protoc": "protobuf",
     "rapidjson": "rapidjson",
+    "re2": "re2",
     "spdlog": "spdlog",
     "ssl": "boringssl",
     "tclap": "tclap",
+    "zlib": "zlib",
 }
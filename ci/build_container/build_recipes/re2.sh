@@ -0,0 +1,11 @@
+#!/bin/bash
+
+set -e
+
+VERSION=2017-07-01
+
+wget -O re2-$VERSION.tar.gz https://github.com/google/re2/archive/$VERSION.tar.gz
+tar xf re2-$VERSION.tar.gz
+cd re2-$VERSION
+make V=1 obj/libre2.a
+make static-install prefix=$THIRDPARTY_BUILD
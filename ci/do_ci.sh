@@ -84,6 +84,18 @@ elif [[ "$1" == "bazel.dev" ]]; then
   echo "Building and testing..."
   bazel --batch test ${BAZEL_TEST_OPTIONS} -c fastbuild //test/...
   exit 0
+elif [[ "$1" == "bazel.benchmark" ]]; then
+  setup_gcc_toolchain
+  echo "bazel benchmarks under -c opt..."
+  cd "${ENVOY_CI_DIR}"
+  BENCHMARKS=$(bazel --batch query 'attr(name, "_benchmark_test$", //test/...)')
+  # Benchmarks are DISABLED_ tests, so they only run when asked for explicitly.
+  bazel --batch test ${BAZEL_TEST_OPTIONS} -c opt --test_output=all --cache_test_results=no \
+    --test_arg=--gtest_also_run_disabled_tests --test_arg=--gtest_filter='DISABLED_*' \
+    ${BENCHMARKS} | tee "${ENVOY_BUILD_DIR}"/benchmark.log
+  "${ENVOY_SRCDIR}"/tools/check_benchmarks.py "${ENVOY_SRCDIR}"/ci/benchmark_thresholds \
+    < "${ENVOY_BUILD_DIR}"/benchmark.log
+  exit 0
 elif [[ "$1" == "bazel.coverage" ]]; then
   setup_gcc_toolchain
   echo "bazel coverage build with tests..."
@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "envoy/common/pure.h"
 
@@ -17,6 +18,58 @@ struct RawSlice {
   uint64_t len_;
 };
 
+/**
+ * A wrapper class to facilitate passing in externally owned data to a buffer via
+ * addBufferFragment(). When the buffer no longer needs the data passed in through a fragment, it
+ * calls done() on it.
+ */
+class BufferFragment {
+public:
+  virtual ~BufferFragment() {}
+
+  /**
+   * @return const void* a pointer to the referenced data.
+   */
+  virtual const void* data() const PURE;
+
+  /**
+   * @return size_t the size of the referenced data.
+   */
+  virtual size_t size() const PURE;
+
+  /**
+   * Called by a buffer when the referenced data is no longer needed.
+   */
+  virtual void done() PURE;
+};
+
+/**
+ * Tracks the buffer memory held on behalf of an owner such as a connection or a worker. Buffers
+ * charge an account for the slices they allocate or take over, and the account is credited when
+ * the slices are freed. Accounts may be read from any thread.
+ */
+class MemoryAccount {
+public:
+  virtual ~MemoryAccount() {}
+
+  /**
+   * Charge bytes of buffer memory to the account.
+   */
+  virtual void charge(uint64_t bytes) PURE;
+
+  /**
+   * Credit bytes previously charged to the account.
+   */
+  virtual void credit(uint64_t bytes) PURE;
+
+  /**
+   * @return uint64_t the bytes currently charged to the account.
+   */
+  virtual uint64_t balance() const PURE;
+};
+
+typedef std::shared_ptr<MemoryAccount> MemoryAccountSharedPtr;
+
 /**
  * A basic buffer abstraction.
  */
@@ -43,9 +96,18 @@ public:
    */
   virtual void add(const Instance& data) PURE;
 
+  /**
+   * Add externally owned data into the buffer. No copying is done. fragment is not owned. When
+   * the fragment->data() is no longer needed, fragment->done() is called.
+   * @param fragment the externally owned data to add to the buffer.
+   */
+  virtual void addBufferFragment(BufferFragment& fragment) PURE;
+
   /**
    * Commit a set of slices originally obtained from reserve(). The number of slices can be
    * different from the number obtained from reserve(). The size of each slice can also be altered.
+   * Reserved memory that is not committed may be freed, so commit() should be called even when
+   * none of the reservation was used.
    * @param iovecs supplies the array of slices to commit.
    * @param num_iovecs supplies the size of the slices array.
    */
@@ -64,13 +126,7 @@ public:
    * @return the actual number of slices needed, which may be greater than out_size. Passing
    *         nullptr for out and 0 for out_size will just return the size of the array needed
    *         to capture all of the slice data.
-   * TODO(mattklein123): WARNING: The underlying implementation of this function currently uses
-   * libevent's evbuffer. It has the infuriating property where calling getRawSlices(nullptr, 0)
-   * will return the slices that include all of the buffer data, but not any empty slices at the
-   * end. However, calling getRawSlices(iovec, SOME_CONST), WILL return potentially empty slices
-   * beyond the end of the buffer. Code that is trying to avoid stack overflow by limiting the
-   * number of returned slices needs to deal with this. When we get rid of evbuffer we can rework
-   * all of this.
+   *         Only slices which contain data are returned.
    */
   virtual uint64_t getRawSlices(RawSlice* out, uint64_t out_size) const PURE;
 
@@ -124,9 +180,21 @@ public:
   virtual ssize_t search(const void* data, uint64_t size, size_t start) const PURE;
 
   /**
-   * Write the buffer out to a file descriptor.
+   * Search for a sequence of patterns. Each pattern must be found after the end of the match of
+   * the previous one, but the matches need not be contiguous.
+   * @param patterns supplies the patterns to search for, in order.
+   * @param start supplies the starting index to search from.
+   * @return the index just past the match of the last pattern or -1 if any pattern is not found.
+   */
+  virtual ssize_t searchSequence(const std::vector<std::vector<uint8_t>>& patterns,
+                                 size_t start) const PURE;
+
+  /**
+   * Write the buffer out to a file descriptor. Writing continues until either the buffer is empty
+   * or the descriptor accepts less than it was offered, so data is only left in the buffer when
+   * the descriptor is full or there was an error.
    * @param fd supplies the descriptor to write to.
-   * @return the number of bytes written or -1 if there was an error.
+   * @return the number of bytes written or -1 if there was an error before anything was written.
    */
   virtual int write(int fd) PURE;
 };
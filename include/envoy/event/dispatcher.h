@@ -6,6 +6,7 @@
 #include <string>
 #include <vector>
 
+#include "envoy/common/time.h"
 #include "envoy/event/file_event.h"
 #include "envoy/event/signal.h"
 #include "envoy/event/timer.h"
@@ -118,6 +119,24 @@ public:
    */
   virtual TimerPtr createTimer(TimerCb cb) PURE;
 
+  /**
+   * Allocate a coarse timer. Coarse timers are multiplexed onto a timer wheel owned by the
+   * dispatcher, so enabling and disabling them is O(1) regardless of how many are pending, but
+   * they may fire up to one wheel tick late. Use them for timeouts that are usually disabled before
+   * they fire, such as idle and request timeouts. @see Event::Timer for docs on how to use the
+   * timer.
+   * @param cb supplies the callback to invoke when the timer fires.
+   */
+  virtual TimerPtr createCoarseTimer(TimerCb cb) PURE;
+
+  /**
+   * @return MonotonicTimeSource& a time source that returns the time cached when the event
+   *         currently being handled started to run. Reading it is much cheaper than reading the
+   *         clock, and it is accurate enough to measure request and connection durations. Callers
+   *         that need precise time should read the clock directly.
+   */
+  virtual MonotonicTimeSource& loopTimeSource() PURE;
+
   /**
    * Submit an item for deferred delete. @see DeferredDeletable.
    */
@@ -138,6 +157,13 @@ public:
    */
   virtual SignalEventPtr listenForSignal(int signal_num, SignalCb cb) PURE;
 
+  /**
+   * Start recording histograms of the load of the event loop. Must be called before run().
+   * @param scope supplies the scope to record the histograms in.
+   * @param prefix supplies the prefix of the histogram names, which identifies the thread.
+   */
+  virtual void initializeStats(Stats::Scope& scope, const std::string& prefix) PURE;
+
   /**
    * Post a functor to the dispatcher. This is safe cross thread. The functor runs in the context
    * of the dispatcher event loop which may be on a different thread than the caller.
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <sys/uio.h>
+
 #include <cstdint>
 #include <functional>
 #include <memory>
@@ -26,6 +28,12 @@ public:
    */
   virtual ssize_t write(int fd, const void* buffer, size_t num_bytes) PURE;
 
+  /**
+   * Write iovcnt buffers described by iov to fd in a single call.
+   * @return number of bytes written if non negative, otherwise error code.
+   */
+  virtual ssize_t writev(int fd, const iovec* iov, int iovcnt) PURE;
+
   /**
    * Release all resources allocated for fd.
    * @return zero on success, -1 returned otherwise.
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+
+#include "envoy/common/pure.h"
+#include "envoy/stats/stats.h"
+
+namespace Envoy {
+namespace Grpc {
+
+/**
+ * Handles to the stats of one gRPC method, grpc.<service>.<method>.*, or of the overflow bucket,
+ * grpc.overflow.*.
+ */
+struct MethodStats {
+  Stats::Counter& success_;
+  Stats::Counter& failure_;
+  Stats::Counter& total_;
+  Stats::Timer& upstream_rq_time_;
+};
+
+/**
+ * Per method gRPC stats of one cluster. Implementations intern the path of each method the first
+ * time it is seen and keep handles to its stats, so that charging a call does not build and look
+ * up stat names. The number of methods is bounded; methods seen once the table is full share the
+ * overflow stats.
+ */
+class MethodStatsTable {
+public:
+  virtual ~MethodStatsTable() {}
+
+  /**
+   * Find the stats of a method, creating them on first use.
+   * @param scope supplies the scope the stats live in. It must be the same on every call.
+   * @param path supplies the :path of the request, /<service>/<method>.
+   * @return the stats of the method, the overflow stats if the table is full, or nullptr if the
+   *         path does not name a gRPC method.
+   */
+  virtual const MethodStats* find(Stats::Scope& scope, const std::string& path) PURE;
+};
+
+} // Grpc
+} // Envoy
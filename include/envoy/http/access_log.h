@@ -162,6 +162,15 @@ public:
   virtual std::string format(const Http::HeaderMap& request_headers,
                              const Http::HeaderMap& response_headers,
                              const RequestInfo& request_info) const PURE;
+
+  /**
+   * Append the formatted output to a string. Callers that log many requests can reuse the same
+   * output string to avoid allocating per request.
+   * @param output supplies the string to append to.
+   */
+  virtual void formatTo(std::string& output, const Http::HeaderMap& request_headers,
+                        const Http::HeaderMap& response_headers,
+                        const RequestInfo& request_info) const PURE;
 };
 
 typedef std::unique_ptr<Formatter> FormatterPtr;
@@ -125,6 +125,12 @@ public:
      * Reset the stream.
      */
     virtual void reset() PURE;
+
+    /**
+     * @return whether the upstream the stream sends to is over its write buffer high watermark, in
+     *         which case data sent now is only buffered until the upstream catches up.
+     */
+    virtual bool isAboveWriteBufferHighWatermark() const PURE;
   };
 
   virtual ~AsyncClient() {}
@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <memory>
+#include <vector>
 
 #include "envoy/buffer/buffer.h"
 #include "envoy/common/pure.h"
@@ -106,6 +107,19 @@ public:
    * @param reason supplies the reset reason.
    */
   virtual void onResetStream(StreamResetReason reason) PURE;
+
+  /**
+   * Fires when a stream, or the connection the stream is sending to, goes over its high watermark.
+   * The callbacks should stop sending data on the stream, usually by disabling reads on whatever
+   * feeds it, until onBelowWriteBufferLowWatermark() is called.
+   */
+  virtual void onAboveWriteBufferHighWatermark() PURE;
+
+  /**
+   * Fires when a stream, or the connection the stream is sending to, drains below its low
+   * watermark after having gone over its high watermark.
+   */
+  virtual void onBelowWriteBufferLowWatermark() PURE;
 };
 
 /**
@@ -132,6 +146,16 @@ public:
    * @param reason supplies the reset reason.
    */
   virtual void resetStream(StreamResetReason reason) PURE;
+
+  /**
+   * Enable/disable further data from this stream, applying back pressure to the remote. For
+   * HTTP/1 this disables reads on the whole connection. For HTTP/2 the window updates for the
+   * stream are withheld, so the remote can send no more than what is left of the stream window.
+   * Calls are counted: data flows again only once every readDisable(true) has been matched by a
+   * readDisable(false).
+   * @param disable supplies TRUE if data should be disabled, FALSE if it should be enabled.
+   */
+  virtual void readDisable(bool disable) PURE;
 };
 
 /**
@@ -147,6 +171,32 @@ public:
   virtual void onGoAway() PURE;
 };
 
+/**
+ * Limits on each block of headers that a codec accepts from its peer. They are enforced while the
+ * block is parsed, so that a block which is too large is rejected before all of it is buffered.
+ */
+struct HeaderLimits {
+  // the maximum total size of the names and values of the headers in a block
+  uint32_t max_bytes_{DEFAULT_MAX_BYTES};
+  // the maximum number of headers in a block, including HTTP/2 pseudo-headers
+  uint32_t max_count_{DEFAULT_MAX_COUNT};
+
+  // nghttp2 does not send header blocks larger than about 64K (NGHTTP2_MAX_HEADERSLEN), so a
+  // larger limit could not be exercised end to end
+  static const uint32_t DEFAULT_MAX_BYTES = 63 * 1024;
+  static const uint32_t MAX_MAX_BYTES = 63 * 1024;
+  static const uint32_t DEFAULT_MAX_COUNT = 100;
+};
+
+/**
+ * HTTP/1.1 codec settings
+ */
+struct Http1Settings {
+  // keep the header lines of each request so that requests whose headers were not modified or
+  // removed can be forwarded over HTTP/1.1 from their original bytes
+  bool forward_raw_headers_{false};
+};
+
 /**
  * HTTP/2 codec settings
  */
@@ -156,6 +206,14 @@ struct Http2Settings {
   uint32_t max_concurrent_streams_{DEFAULT_MAX_CONCURRENT_STREAMS};
   uint32_t initial_stream_window_size_{DEFAULT_INITIAL_STREAM_WINDOW_SIZE};
   uint32_t initial_connection_window_size_{DEFAULT_INITIAL_CONNECTION_WINDOW_SIZE};
+  // the largest dynamic HPACK table our encoder will use, even if the peer allows a larger one
+  uint32_t hpack_encoder_table_size_{DEFAULT_HPACK_TABLE_SIZE};
+  // headers that are sent as never indexed literals, e.g. to keep secrets out of the HPACK table
+  std::vector<LowerCaseString> hpack_never_index_headers_;
+  // grow the local windows towards the bandwidth-delay product measured with PING round trips
+  bool window_autotuning_{};
+  // the number of connections that an upstream connection pool may open to a single host
+  uint32_t max_connections_per_host_{DEFAULT_MAX_CONNECTIONS_PER_HOST};
 
   // disable HPACK compression
   static const uint32_t MIN_HPACK_TABLE_SIZE = 0;
@@ -189,6 +247,9 @@ struct Http2Settings {
   // our default connection-level window also equals to our stream-level
   static const uint32_t DEFAULT_INITIAL_CONNECTION_WINDOW_SIZE = 256 * 1024 * 1024;
   static const uint32_t MAX_INITIAL_CONNECTION_WINDOW_SIZE = (1U << 31) - 1;
+
+  // a single connection per host, with new connections only replacing draining ones
+  static const uint32_t DEFAULT_MAX_CONNECTIONS_PER_HOST = 1;
 };
 
 /**
@@ -226,6 +287,17 @@ public:
    *              reasons (e.g, needing window updates).
    */
   virtual bool wantsToWrite() PURE;
+
+  /**
+   * Called when the underlying Network::Connection goes over its high watermark. The codec
+   * raises onAboveWriteBufferHighWatermark() on the callbacks of the streams using the connection.
+   */
+  virtual void onUnderlyingConnectionAboveWriteBufferHighWatermark() PURE;
+
+  /**
+   * Called when the underlying Network::Connection drains below its low watermark.
+   */
+  virtual void onUnderlyingConnectionBelowWriteBufferLowWatermark() PURE;
 };
 
 /**
@@ -260,6 +332,13 @@ public:
    * @return StreamEncoder& supplies the encoder to write the request into.
    */
   virtual StreamEncoder& newStream(StreamDecoder& response_decoder) PURE;
+
+  /**
+   * @return uint64_t the number of streams that the peer allows to be open at once. For HTTP/2
+   *         this is the peer's SETTINGS_MAX_CONCURRENT_STREAMS, or nghttp2's assumption until the
+   *         peer's SETTINGS frame has been received.
+   */
+  virtual uint64_t maxConcurrentStreams() PURE;
 };
 
 typedef std::unique_ptr<ClientConnection> ClientConnectionPtr;
@@ -1,5 +1,10 @@
 #pragma once
 
+#include <chrono>
+
+#include "envoy/common/pure.h"
+#include "envoy/stats/stats.h"
+
 namespace Envoy {
 namespace Http {
 
@@ -72,5 +77,51 @@ enum class Code {
   // clang-format on
 };
 
+/**
+ * Response code counters of one stat prefix, e.g. of a cluster or of a virtual cluster.
+ * Implementations keep handles to the counters they have charged so that charging a response does
+ * not build and look up stat names.
+ */
+class CodeStats {
+public:
+  virtual ~CodeStats() {}
+
+  /**
+   * Charge upstream_rq_<code class> and upstream_rq_<code>.
+   * @param scope supplies the scope the counters live in. It must be the same on every call.
+   * @param code supplies the response code.
+   */
+  virtual void chargeBasicResponseStat(Stats::Scope& scope, Code code) PURE;
+
+  /**
+   * Charge the basic response stats as well as their canary. and internal. or external. variants.
+   * @param scope supplies the scope the counters live in. It must be the same on every call.
+   * @param code supplies the response code.
+   * @param canary supplies whether the response came from a canary.
+   * @param internal_request supplies whether the request was internal.
+   */
+  virtual void chargeResponseStat(Stats::Scope& scope, Code code, bool canary,
+                                  bool internal_request) PURE;
+
+  /**
+   * Deliver upstream_rq_time to the sinks.
+   * @param scope supplies the scope to deliver the timing through.
+   * @param response_time supplies the response time.
+   */
+  virtual void chargeBasicResponseTiming(Stats::Scope& scope,
+                                         std::chrono::milliseconds response_time) PURE;
+
+  /**
+   * Deliver upstream_rq_time as well as its canary. and internal. or external. variants to the
+   * sinks.
+   * @param scope supplies the scope to deliver the timing through.
+   * @param response_time supplies the response time.
+   * @param canary supplies whether the response came from a canary.
+   * @param internal_request supplies whether the request was internal.
+   */
+  virtual void chargeResponseTiming(Stats::Scope& scope, std::chrono::milliseconds response_time,
+                                    bool canary, bool internal_request) PURE;
+};
+
 } // Http
 } // Envoy
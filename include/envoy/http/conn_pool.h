@@ -95,6 +95,12 @@ public:
    *                      should be done by resetting the stream.
    */
   virtual Cancellable* newStream(Http::StreamDecoder& response_decoder, Callbacks& callbacks) PURE;
+
+  /**
+   * Open a connection ahead of the first request if the pool has no connections. This is used to
+   * warm pools for hosts that have just become available.
+   */
+  virtual void warm() PURE;
 };
 
 typedef std::unique_ptr<Instance> InstancePtr;
@@ -9,6 +9,7 @@
 #include "envoy/http/access_log.h"
 #include "envoy/http/codec.h"
 #include "envoy/http/header_map.h"
+#include "envoy/network/connection.h"
 #include "envoy/router/router.h"
 #include "envoy/ssl/connection.h"
 #include "envoy/tracing/http_tracer.h"
@@ -80,6 +81,12 @@ public:
    */
   virtual Ssl::Connection* ssl() PURE;
 
+  /**
+   * @return const Network::Connection* the originating connection, or nullptr if the stream was
+   *         not started by a downstream connection.
+   */
+  virtual const Network::Connection* connection() PURE;
+
   /**
    * @return Event::Dispatcher& the thread local dispatcher for allocating timers, etc.
    */
@@ -91,14 +98,10 @@ public:
   virtual void resetStream() PURE;
 
   /**
-   * Returns the route for the current request. The assumption is that the implementation can do
-   * caching where applicable to avoid multiple lookups.
-   *
-   * NOTE: This breaks down a bit if the caller knows it has modified something that would affect
-   *       routing (such as the request headers). In practice, we don't do this anywhere currently,
-   *       but in the future we might need to provide the ability to clear the cache if a filter
-   *       knows that it has modified the headers in a way that would affect routing. In the future
-   *       we may also want to allow the filter to override the route entry.
+   * Returns the route for the current request. The route is resolved once when the request
+   * headers are decoded and cached for the rest of the request, so calling this is cheap. A
+   * decoder filter that modifies the request headers in a way that could change the route must
+   * call StreamDecoderFilterCallbacks::clearRouteCache() for later filters to see the new route.
    */
   virtual Router::RouteConstSharedPtr route() PURE;
 
@@ -125,6 +128,26 @@ public:
   virtual const std::string& downstreamAddress() PURE;
 };
 
+/**
+ * Callbacks that a decoder filter sending the request somewhere else (e.g., the router) registers
+ * to learn when the downstream connection the response is written to backs up.
+ */
+class DownstreamWatermarkCallbacks {
+public:
+  virtual ~DownstreamWatermarkCallbacks() {}
+
+  /**
+   * Fires when the downstream stream or connection goes over its high watermark. The filter should
+   * stop reading the response from wherever it comes from.
+   */
+  virtual void onAboveWriteBufferHighWatermark() PURE;
+
+  /**
+   * Fires when the downstream stream or connection drains below its low watermark.
+   */
+  virtual void onBelowWriteBufferLowWatermark() PURE;
+};
+
 /**
  * Stream decoder filter callbacks add additional callbacks that allow a decoding filter to restart
  * decoding if they decide to hold data (e.g. for buffering or rate limiting).
@@ -148,6 +171,21 @@ public:
    */
   virtual const Buffer::Instance* decodingBuffer() PURE;
 
+  /**
+   * Supply the buffer that body data is collected in when filters return StopIterationAndBuffer
+   * from decodeData(). This lets a filter that buffers whole requests bound the memory they use,
+   * e.g. by spilling them to disk. It can only be called while decodingBuffer() is nullptr.
+   * @param buffer supplies the empty buffer to use.
+   */
+  virtual void setDecodingBuffer(Buffer::InstancePtr&& buffer) PURE;
+
+  /**
+   * Clear the route cache for the current request. The route is resolved again, against the
+   * current request headers, the next time route() is called. This must be called by a filter
+   * that modifies the request headers in a way that could change the route.
+   */
+  virtual void clearRouteCache() PURE;
+
   /**
    * Add buffered body data. This method is used in advanced cases where returning
    * StopIterationAndBuffer from decodeData() is not sufficient.
@@ -191,6 +229,32 @@ public:
    * @param trailers supplies the trailers to encode.
    */
   virtual void encodeTrailers(HeaderMapPtr&& trailers) PURE;
+
+  /**
+   * Called when the place the filter sends the request to (e.g., the upstream connection) goes
+   * over its high watermark. The connection manager stops reading the request from downstream
+   * until onDecoderFilterBelowWriteBufferLowWatermark() is called.
+   */
+  virtual void onDecoderFilterAboveWriteBufferHighWatermark() PURE;
+
+  /**
+   * Called when the place the filter sends the request to drains below its low watermark.
+   */
+  virtual void onDecoderFilterBelowWriteBufferLowWatermark() PURE;
+
+  /**
+   * Register callbacks that fire when the downstream goes over or drains below its watermarks.
+   * The callbacks must be removed with removeDownstreamWatermarkCallbacks() before the filter is
+   * destroyed.
+   * @param callbacks supplies the callbacks to fire.
+   */
+  virtual void addDownstreamWatermarkCallbacks(DownstreamWatermarkCallbacks& callbacks) PURE;
+
+  /**
+   * Remove callbacks registered with addDownstreamWatermarkCallbacks().
+   * @param callbacks supplies the callbacks to remove.
+   */
+  virtual void removeDownstreamWatermarkCallbacks(DownstreamWatermarkCallbacks& callbacks) PURE;
 };
 
 /**
@@ -365,6 +429,13 @@ public:
    * @param handler supplies the handler to add.
    */
   virtual void addAccessLogHandler(Http::AccessLog::InstanceSharedPtr handler) PURE;
+
+  /**
+   * Name the filters added by subsequent calls, as used in per filter statistics. Filters added
+   * before any name is set are unnamed.
+   * @param name supplies the name, which must remain valid for as long as the filter chain factory.
+   */
+  virtual void setFilterName(const std::string& name) PURE;
 };
 
 /**
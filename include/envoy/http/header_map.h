@@ -9,6 +9,16 @@
 
 #include "envoy/common/pure.h"
 
+/**
+ * The number of bytes, including the null terminator, that a HeaderString stores without a heap
+ * allocation. Every header entry reserves this much, so it trades memory per header for fewer
+ * allocations for long values. It can be changed at build time, e.g. with
+ * --copt=-DENVOY_HEADER_STRING_INLINE_SIZE=256.
+ */
+#ifndef ENVOY_HEADER_STRING_INLINE_SIZE
+#define ENVOY_HEADER_STRING_INLINE_SIZE 128
+#endif
+
 namespace Envoy {
 namespace Http {
 
@@ -39,14 +49,23 @@ private:
 
 /**
  * This is a string implementation for use in header processing. It is heavily optimized for
- * performance. It supports 3 different types of storage and can switch between them:
- * 1) A static reference.
+ * performance. It supports 4 different types of storage and can switch between them:
+ * 1) A static reference, or a reference to data that outlives the string (see setReference()).
  * 2) Interned string.
- * 3) Heap allocated storage.
+ * 3) Heap allocated storage. Copies made with setCopy(const HeaderString&) share it until one of
+ *    them is modified.
+ * 4) A counted reference to externally owned data, e.g. a header decoded by a codec library.
  */
 class HeaderString {
 public:
-  enum class Type { Inline, Static, Dynamic };
+  enum class Type { Inline, Static, Dynamic, Reference };
+
+  /**
+   * Called to give back the reference taken by setReference(const char*, uint32_t, ReleaseCb,
+   * void*).
+   * @param context supplies the context passed to setReference().
+   */
+  typedef void (*ReleaseCb)(void* context);
 
   /**
    * Default constructor. Sets up for inline storage.
@@ -75,9 +94,11 @@ public:
   void append(const char* data, uint32_t size);
 
   /**
-   * @return the modifiable backing buffer (either inline or heap allocated).
+   * @return the modifiable backing buffer (either inline or heap allocated). Static strings,
+   *         referenced data and heap allocated storage that is shared with a copy are copied
+   *         first.
    */
-  char* buffer() { return buffer_.dynamic_; }
+  char* buffer();
 
   /**
    * @return a null terminated C string.
@@ -86,7 +107,7 @@ public:
 
   /**
    * Return the string to a default state. Static strings are not touched. Both inline/dynamic
-   * strings are reset to zero size.
+   * strings are reset to zero size. Referenced data is given back and the string becomes inline.
    */
   void clear();
 
@@ -105,11 +126,49 @@ public:
    */
   void setCopy(const char* data, uint32_t size);
 
+  /**
+   * Set the value of the string to a copy of another string. This overwrites any existing string.
+   * Heap allocated storage is shared with the other string rather than copied, until either string
+   * is modified.
+   */
+  void setCopy(const HeaderString& value);
+
   /**
    * Set the value of the string to an integer. This overwrites any existing string.
    */
   void setInteger(uint64_t value);
 
+  /**
+   * Set the value of the string to a reference to another string, without copying it. This
+   * overwrites any existing string. Like static strings, the reference is copied if the string is
+   * modified or its header map is copied.
+   * @param ref_value MUST outlive this string, e.g. a config value used for each response.
+   */
+  void setReference(const std::string& ref_value);
+
+  /**
+   * Set the value of the string to externally owned data without copying it. This overwrites any
+   * existing string. The string holds one reference to the data, which it gives back by calling
+   * release once it no longer points at the data: when it is destroyed, overwritten or modified.
+   * Like static strings, the data is copied if the string is modified or its header map is copied.
+   * @param data supplies the data, which MUST be null terminated and stay valid until release is
+   *        called. release is called on the thread that destroys or overwrites the string.
+   * @param size supplies the size of the data, not including the null terminator.
+   * @param release supplies the callback that gives back the reference.
+   * @param context supplies the argument for release.
+   */
+  void setReference(const char* data, uint32_t size, ReleaseCb release, void* context);
+
+  /**
+   * @return the context passed to setReference(const char*, uint32_t, ReleaseCb, void*) if the
+   *         string still holds a reference taken with the given release callback, or nullptr.
+   */
+  void* referenceContext(ReleaseCb release) const {
+    return type_ == Type::Reference && reference_release_.cb_ == release
+               ? reference_release_.context_
+               : nullptr;
+  }
+
   /**
    * @return the size of the string, not including the null terminator.
    */
@@ -124,14 +183,26 @@ public:
   bool operator!=(const char* rhs) const { return 0 != strcmp(c_str(), rhs); }
 
 private:
+  struct ReferenceRelease {
+    ReleaseCb cb_;
+    void* context_;
+  };
+
+  bool shared() const;
+  void unshare();
+  void releaseIfShared();
+  void copyReference();
+  void releaseReference();
+
   union {
     char* dynamic_;
     const char* static_;
   } buffer_;
 
   union {
-    char inline_buffer_[128];
+    char inline_buffer_[ENVOY_HEADER_STRING_INLINE_SIZE];
     uint32_t dynamic_capacity_;
+    ReferenceRelease reference_release_;
   };
 
   uint32_t string_length_;
@@ -279,6 +350,11 @@ public:
    */
   virtual void addStaticKey(const LowerCaseString& key, const std::string& value) PURE;
 
+  /**
+   * Add a header to the map. Both the key and the value will be copied.
+   */
+  virtual void addCopy(const LowerCaseString& key, const std::string& value) PURE;
+
   /**
    * @return uint64_t the approximate size of the header map in bytes.
    */
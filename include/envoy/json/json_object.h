@@ -142,7 +142,9 @@ public:
   virtual bool hasObject(const std::string& name) const PURE;
 
   /**
-   * Validates JSON object against passed in schema.
+   * Validates JSON object against passed in schema. Objects are immutable, so validating an object
+   * against a schema it already conformed to returns immediately. This can be called from any
+   * thread.
    * @param schema supplies the schema in string format. A Json::Exception will be thrown if
    *        the JSON object doesn't conform to the supplied schema or the schema itself is not
    *        valid.
@@ -36,6 +36,8 @@ public:
   virtual std::string toString(bool full) const PURE;
 };
 
+typedef std::unique_ptr<Message> MessagePtr;
+
 /**
  * Mongo OP_GET_MORE message.
  */
@@ -139,8 +141,20 @@ public:
   virtual void startingFrom(int32_t starting_from) PURE;
   virtual int32_t numberReturned() const PURE;
   virtual void numberReturned(int32_t number_returned) PURE;
+
+  /**
+   * Decoded replies keep their documents encoded until they are first accessed, so these may
+   * throw EnvoyException if the documents are invalid. Replies decoded by a decoder that skips
+   * reply documents have none.
+   */
   virtual const std::list<Bson::DocumentSharedPtr>& documents() const PURE;
   virtual std::list<Bson::DocumentSharedPtr>& documents() PURE;
+
+  /**
+   * @return uint64_t the encoded size of all documents, including skipped ones. This does not
+   *         decode the documents.
+   */
+  virtual uint64_t documentsByteSize() const PURE;
 };
 
 typedef std::unique_ptr<ReplyMessage> ReplyMessagePtr;
@@ -166,7 +180,12 @@ class Decoder {
 public:
   virtual ~Decoder() {}
 
-  virtual void onData(Buffer::Instance& data) PURE;
+  /**
+   * Decode the next part of a stream of messages. Messages are dispatched to the callbacks as soon
+   * as they are complete, and a partial message is kept by the decoder until the rest arrives.
+   * @param data supplies the data, which is not modified so that the caller can forward it.
+   */
+  virtual void onData(const Buffer::Instance& data) PURE;
 };
 
 typedef std::unique_ptr<Decoder> DecoderPtr;
@@ -3,12 +3,14 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "envoy/buffer/buffer.h"
 #include "envoy/common/pure.h"
 #include "envoy/event/deferred_deletable.h"
 #include "envoy/network/address.h"
 #include "envoy/network/filter.h"
+#include "envoy/network/socket_options.h"
 #include "envoy/ssl/connection.h"
 
 namespace Envoy {
@@ -45,6 +47,19 @@ public:
    * @param events supplies the ConnectionEvent events that occurred as a bitmask.
    */
   virtual void onEvent(uint32_t events) PURE;
+
+  /**
+   * Called when the write buffer for a connection goes over its high watermark. Callers should
+   * stop writing to the connection, usually by disabling reads on whatever feeds it, until
+   * onBelowWriteBufferLowWatermark() is called.
+   */
+  virtual void onAboveWriteBufferHighWatermark() PURE;
+
+  /**
+   * Called when the write buffer for a connection drains below its low watermark after having
+   * gone over its high watermark.
+   */
+  virtual void onBelowWriteBufferLowWatermark() PURE;
 };
 
 /**
@@ -106,20 +121,22 @@ public:
   /**
    * Disable socket reads on the connection, applying external back pressure. When reads are
    * enabled again if there is data still in the input buffer it will be redispatched through
-   * the filter chain.
+   * the filter chain. Calls are counted: reads resume only once every readDisable(true) has been
+   * matched by a readDisable(false).
    * @param disable supplies TRUE is reads should be disabled, FALSE if they should be enabled.
    */
   virtual void readDisable(bool disable) PURE;
 
   /**
-   * @return bool whether reading is enabled on the connection.
+   * @return bool whether reading is enabled on the connection, i.e. whether no readDisable(true)
+   *         is outstanding.
    */
   virtual bool readEnabled() PURE;
 
   /**
    * @return The address of the remote client.
    */
-  virtual const Address::Instance& remoteAddress() PURE;
+  virtual const Address::Instance& remoteAddress() const PURE;
 
   /**
    * @return the local address of the connection. For client connections, this is the origin
@@ -127,7 +144,20 @@ public:
    * it can be different from the proxy address if the downstream connection has been redirected or
    * the proxy is operating in transparent mode.
    */
-  virtual const Address::Instance& localAddress() PURE;
+  virtual const Address::Instance& localAddress() const PURE;
+
+  /**
+   * @return the server name that the client asked for in its TLS ClientHello, as peeked by the
+   *         listener before the connection was created. Empty if the listener did not inspect the
+   *         ClientHello or the client did not send a server name.
+   */
+  virtual const std::string& requestedServerName() PURE;
+
+  /**
+   * @return the application protocols that the client offered in its TLS ClientHello, as peeked
+   *         by the listener before the connection was created.
+   */
+  virtual const std::vector<std::string>& requestedApplicationProtocols() PURE;
 
   /**
    * Set the buffer stats to update when the connection's read/write buffers change. Note that
@@ -154,7 +184,10 @@ public:
 
   /**
    * Set a soft limit on the size of the read buffer prior to flushing to further stages in the
-   * processing pipeline.
+   * processing pipeline. The same limit is the high watermark of the write buffer: once more than
+   * this many bytes are waiting to be written, onAboveWriteBufferHighWatermark() is raised, and
+   * onBelowWriteBufferLowWatermark() follows when the buffer drains below half of it. A limit of
+   * zero disables both.
    */
   virtual void setReadBufferLimit(uint32_t limit) PURE;
 
@@ -162,6 +195,26 @@ public:
    * Get the value set with setReadBufferLimit.
    */
   virtual uint32_t readBufferLimit() const PURE;
+
+  /**
+   * Charge the memory of the connection's read and write buffers to an account. Memory already
+   * held by the buffers is charged right away.
+   * @param account supplies the account to charge.
+   */
+  virtual void setBufferAccount(Buffer::MemoryAccountSharedPtr account) PURE;
+
+  /**
+   * Move all further data read from this connection to another connection with splice(2), through
+   * a pipe, so that it is never copied into user space. This bypasses the read filters of this
+   * connection and the write filters of the destination, so it is refused unless this connection
+   * has at most one read filter (the caller), the destination has no write filters, and neither
+   * side uses TLS. Splicing stops if either connection closes. Data the destination has already
+   * buffered is written before any spliced data.
+   * @param destination supplies the connection to write the data to.
+   * @param bytes_spliced supplies the counter to increment with the bytes moved.
+   * @return bool whether splicing started. If not, data keeps flowing through the read filters.
+   */
+  virtual bool spliceTo(Connection& destination, Stats::Counter& bytes_spliced) PURE;
 };
 
 typedef std::unique_ptr<Connection> ConnectionPtr;
@@ -176,6 +229,25 @@ public:
    * registered via setConnectionEventCb().
    */
   virtual void connect() PURE;
+
+  /**
+   * Supply further addresses of the same remote host, in order of preference, that connect()
+   * races against the remote address. Attempts are staggered: the next address is tried when the
+   * attempts in progress have neither succeeded nor failed within a short delay, or as soon as
+   * they have all failed. The first attempt to connect wins and the others are cancelled, after
+   * which remoteAddress() returns the address that won. Must be called before connect().
+   * @param addresses supplies the alternate addresses.
+   */
+  virtual void setAlternateAddresses(
+      const std::vector<Address::InstanceConstSharedPtr>& addresses) PURE;
+
+  /**
+   * Set TCP options that are applied to the socket of the connection, and to the sockets of the
+   * attempts to connect to alternate addresses. Ignored for unix domain sockets. Must be called
+   * before connect().
+   * @param options supplies the options.
+   */
+  virtual void setSocketOptions(SocketOptionsConstSharedPtr options) PURE;
 };
 
 typedef std::unique_ptr<ClientConnection> ClientConnectionPtr;
@@ -1,15 +1,74 @@
 #pragma once
 
+#include <sys/socket.h>
+
 #include <cstdint>
 #include <memory>
 #include <string>
 
 #include "envoy/common/exception.h"
 #include "envoy/network/connection.h"
+#include "envoy/network/socket_options.h"
 
 namespace Envoy {
 namespace Network {
 
+/**
+ * A listener that takes part in connection balancing. All methods may be called from any thread.
+ */
+class BalancedConnectionHandler {
+public:
+  virtual ~BalancedConnectionHandler() {}
+
+  /**
+   * @return the number of connections owned by the handler, including connections that have been
+   *         handed to it but that it has not yet taken control of.
+   */
+  virtual uint64_t numConnections() PURE;
+
+  /**
+   * Hand a newly accepted socket to the handler, which will create the connection on its own
+   * thread.
+   * @param fd supplies the accepted fd. Ownership is transferred.
+   * @param remote_addr supplies the remote address filled in by accept().
+   * @param remote_addr_len supplies the length of remote_addr.
+   */
+  virtual void post(int fd, const sockaddr* remote_addr, int remote_addr_len) PURE;
+};
+
+/**
+ * Balances newly accepted connections among the workers listening on the same listener. Without
+ * it, a connection is owned by whichever worker accepted it for its entire lifetime.
+ */
+class ConnectionBalancer {
+public:
+  virtual ~ConnectionBalancer() {}
+
+  /**
+   * Add a handler that new connections can be balanced to.
+   */
+  virtual void registerHandler(BalancedConnectionHandler& handler) PURE;
+
+  /**
+   * Remove a handler. Once this returns no further connections will be posted to the handler.
+   */
+  virtual void unregisterHandler(BalancedConnectionHandler& handler) PURE;
+
+  /**
+   * Balance a connection that was accepted by a handler.
+   * @param current supplies the handler that accepted the connection.
+   * @param fd supplies the accepted fd.
+   * @param remote_addr supplies the remote address filled in by accept().
+   * @param remote_addr_len supplies the length of remote_addr.
+   * @return true if the connection was posted to another handler, which now owns fd. If false,
+   *         the accepting handler should create the connection itself.
+   */
+  virtual bool balance(BalancedConnectionHandler& current, int fd, const sockaddr* remote_addr,
+                       int remote_addr_len) PURE;
+};
+
+typedef std::unique_ptr<ConnectionBalancer> ConnectionBalancerPtr;
+
 /**
  * Listener configurations options.
  */
@@ -25,6 +84,14 @@ struct ListenerOptions {
   bool use_original_dst_;
   // Soft limit on size of the listener's new connection read and write buffers.
   uint32_t per_connection_buffer_limit_bytes_;
+  // If set, new connections are balanced among all the workers listening on the listener. Not
+  // owned.
+  ConnectionBalancer* connection_balancer_;
+  // Whether to peek at the TLS ClientHello of new connections, so that the requested server name
+  // and application protocols are known before the connection is created.
+  bool inspect_tls_client_hello_;
+  // Options applied to the listen socket, which new connections inherit, or nullptr.
+  SocketOptionsConstSharedPtr socket_options_;
 
   /**
    * Factory for ListenerOptions with bind_to_port_ set.
@@ -34,7 +101,10 @@ struct ListenerOptions {
     return {.bind_to_port_ = true,
             .use_proxy_proto_ = false,
             .use_original_dst_ = false,
-            .per_connection_buffer_limit_bytes_ = 0};
+            .per_connection_buffer_limit_bytes_ = 0,
+            .connection_balancer_ = nullptr,
+            .inspect_tls_client_hello_ = false,
+            .socket_options_ = nullptr};
   }
 };
 
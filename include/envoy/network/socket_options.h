@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "envoy/common/optional.h"
+
+namespace Envoy {
+namespace Network {
+
+/**
+ * TCP socket options that are applied to the sockets of a cluster's upstream connections or of a
+ * listener's downstream connections. Options that are not set keep the operating system default.
+ */
+struct SocketOptions {
+  // Whether to enable SO_KEEPALIVE. The keepalive settings below are only used if it is.
+  bool keepalive_{};
+  // The number of unanswered probes after which the connection is dropped (TCP_KEEPCNT).
+  Optional<uint32_t> keepalive_probes_;
+  // The number of seconds a connection must be idle before probes are sent (TCP_KEEPIDLE).
+  Optional<uint32_t> keepalive_time_;
+  // The number of seconds between probes (TCP_KEEPINTVL).
+  Optional<uint32_t> keepalive_interval_;
+  // How long in milliseconds sent data may remain unacknowledged before the connection is dropped
+  // (TCP_USER_TIMEOUT).
+  Optional<uint32_t> user_timeout_ms_;
+  // The kernel send and receive buffer sizes (SO_SNDBUF, SO_RCVBUF).
+  Optional<uint32_t> send_buffer_bytes_;
+  Optional<uint32_t> receive_buffer_bytes_;
+  // How much unsent data the kernel buffers before the socket stops being writable
+  // (TCP_NOTSENT_LOWAT).
+  Optional<uint32_t> notsent_lowat_bytes_;
+  // Whether client sockets send the first data in the SYN when the server supports TCP Fast Open
+  // (TCP_FASTOPEN_CONNECT).
+  bool tcp_fast_open_{};
+  // The length of the queue of pending TCP Fast Open connections of a listen socket
+  // (TCP_FASTOPEN). Not set disables TCP Fast Open on the listener.
+  Optional<uint32_t> tcp_fast_open_queue_length_;
+};
+
+typedef std::shared_ptr<const SocketOptions> SocketOptionsConstSharedPtr;
+
+} // Network
+} // Envoy
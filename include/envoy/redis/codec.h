@@ -47,6 +47,15 @@ public:
   RespType type() const { return type_; }
   void type(RespType type);
 
+  /**
+   * The bytes the value was decoded from, if the decoder was asked to retain them. A value with raw
+   * bytes only has its type set plus the contents of integers, simple strings and errors. Bulk
+   * string contents and array elements are never copied out of the wire buffer and are only
+   * available in the raw bytes, which the encoder writes as is. Calling type() clears them.
+   */
+  Buffer::InstancePtr& raw() { return raw_; }
+  const Buffer::InstancePtr& raw() const { return raw_; }
+
 private:
   union {
     std::vector<RespValue> array_;
@@ -57,6 +66,7 @@ private:
   void cleanup();
 
   RespType type_;
+  Buffer::InstancePtr raw_;
 };
 
 typedef std::unique_ptr<RespValue> RespValuePtr;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 #include <memory>
 #include <string>
 
@@ -84,6 +85,19 @@ public:
    *         all operations use the same timeout.
    */
   virtual std::chrono::milliseconds opTimeout() const PURE;
+
+  /**
+   * @return uint32_t the maximum number of requests that are encoded into a single write to an
+   *         upstream connection. 1 writes every request as soon as it is made.
+   */
+  virtual uint32_t maxBatchSize() const PURE;
+
+  /**
+   * @return std::chrono::milliseconds how long a batch that is not full waits for more requests
+   *         before it is written. 0 writes the batch on the next dispatcher loop iteration, which
+   *         batches the requests made while handling the same events.
+   */
+  virtual std::chrono::milliseconds batchFlushDelay() const PURE;
 };
 
 /**
@@ -122,6 +136,45 @@ public:
    */
   virtual PoolRequest* makeRequest(const std::string& hash_key, const RespValue& request,
                                    PoolCallbacks& callbacks) PURE;
+
+  /**
+   * Makes a read only redis request. If the pool has read replicas, the request is sent to a
+   * healthy replica of the host the key hashes to instead of the host itself.
+   * @param hash_key supplies the key to use for consistent hashing.
+   * @param request supplies the request to make.
+   * @param callbacks supplies the request completion callbacks.
+   * @return PoolRequest* a handle to the active request or nullptr if the request could not be made
+   *         for some reason.
+   */
+  virtual PoolRequest* makeReadRequest(const std::string& hash_key, const RespValue& request,
+                                       PoolCallbacks& callbacks) PURE;
+
+  /**
+   * Choose the upstream host that a key hashes to. This allows a caller to group the keys of a
+   * multi-key command by host before making requests via makeRequestToHost().
+   * @param hash_key supplies the key to use for consistent hashing.
+   * @return Upstream::HostConstSharedPtr the chosen host or nullptr if no host is available.
+   */
+  virtual Upstream::HostConstSharedPtr chooseHost(const std::string& hash_key) PURE;
+
+  /**
+   * Get the Redis Cluster hash slot of a key. A multi-key request may only combine keys that are
+   * on the same host and in the same slot, or Redis Cluster rejects it.
+   * @param hash_key supplies the key.
+   * @return uint32_t the slot of the key, or 0 if the pool does not route by slot.
+   */
+  virtual uint32_t slot(const std::string& hash_key) PURE;
+
+  /**
+   * Makes a redis request to a host previously returned by chooseHost().
+   * @param host supplies the host to send the request to.
+   * @param request supplies the request to make.
+   * @param callbacks supplies the request completion callbacks.
+   * @return PoolRequest* a handle to the active request or nullptr if the request could not be made
+   *         for some reason.
+   */
+  virtual PoolRequest* makeRequestToHost(const Upstream::HostConstSharedPtr& host,
+                                         const RespValue& request, PoolCallbacks& callbacks) PURE;
 };
 
 typedef std::unique_ptr<Instance> InstancePtr;
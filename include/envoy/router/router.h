@@ -10,8 +10,10 @@
 
 #include "envoy/common/optional.h"
 #include "envoy/http/codec.h"
+#include "envoy/http/codes.h"
 #include "envoy/http/header_map.h"
 #include "envoy/upstream/resource_manager.h"
+#include "envoy/upstream/thread_local_cluster.h"
 
 namespace Envoy {
 namespace Router {
@@ -59,6 +61,12 @@ public:
    * @return uint32_t a local OR of RETRY_ON values above.
    */
   virtual uint32_t retryOn() const PURE;
+
+  /**
+   * @return std::chrono::milliseconds how long to wait for a response before sending a hedged copy
+   *         of the request to another host, or 0 if requests should not be hedged.
+   */
+  virtual std::chrono::milliseconds hedgeDelay() const PURE;
 };
 
 /**
@@ -89,6 +97,13 @@ public:
   virtual bool shouldRetry(const Http::HeaderMap* response_headers,
                            const Optional<Http::StreamResetReason>& reset_reason,
                            DoRetryCallback callback) PURE;
+
+  /**
+   * Determine whether a hedged copy of the request should be sent now. A hedge uses up a retry and
+   * is subject to the same circuit breaker as retries.
+   * @return TRUE if a hedged request should be sent.
+   */
+  virtual bool shouldHedge() PURE;
 };
 
 typedef std::unique_ptr<RetryState> RetryStatePtr;
@@ -132,6 +147,12 @@ public:
    * @return the priority of the virtual cluster.
    */
   virtual Upstream::ResourcePriority priority() const PURE;
+
+  /**
+   * @return the response code stats of the virtual cluster. They must be charged to the global
+   *         stats store.
+   */
+  virtual Http::CodeStats& codeStats() const PURE;
 };
 
 class RateLimitPolicy;
@@ -183,6 +204,13 @@ public:
    */
   virtual const std::string& clusterName() const PURE;
 
+  /**
+   * @return const Optional<Upstream::ClusterId>& the interned ID of clusterName() if it was
+   *         resolved when the route was loaded. Routes whose cluster is only known per request
+   *         (e.g. cluster_header) do not have an ID and must be looked up by name.
+   */
+  virtual const Optional<Upstream::ClusterId>& clusterId() const PURE;
+
   /**
    * Do potentially destructive header transforms on request headers prior to forwarding. For
    * example URL prefix rewriting, adding headers, etc. This should only be called ONCE
@@ -250,6 +278,12 @@ public:
    * @return bool true if the virtual host rate limits should be included.
    */
   virtual bool includeVirtualHostRateLimits() const PURE;
+
+  /**
+   * @return const Upstream::HostMetadata& the host metadata an upstream host must match to be
+   *         chosen for the route. Empty if any host in the cluster may be used.
+   */
+  virtual const Upstream::HostMetadata& metadataMatchCriteria() const PURE;
 };
 
 /**
@@ -4,15 +4,46 @@
 #include <memory>
 #include <string>
 
+#include "envoy/buffer/buffer.h"
+#include "envoy/http/header_map.h"
 #include "envoy/http/message.h"
 
 namespace Envoy {
 namespace Router {
 
 /**
- * Interface used to shadow complete requests to an alternate upstream cluster in a "fire and
- * forget" fashion. Right now this interface takes a fully buffered request and cannot be used for
- * streaming. This is sufficient for current use cases.
+ * A shadowed request whose body is still being forwarded. The shadow is dropped (reset) rather
+ * than buffered once the shadow upstream falls behind, so it never holds back the primary request.
+ * The handle is released, and must no longer be used, once the request has been ended with
+ * sendData(..., true) or sendTrailers(), or once cancel() has been called.
+ */
+class ShadowStream {
+public:
+  virtual ~ShadowStream() {}
+
+  /**
+   * Forward request body data. The data is copied, except for slices that can be shared.
+   * @param data supplies the data to forward.
+   * @param end_stream supplies whether this is the last data of the request.
+   */
+  virtual void sendData(const Buffer::Instance& data, bool end_stream) PURE;
+
+  /**
+   * Forward request trailers. This ends the request.
+   * @param trailers supplies the trailers to forward.
+   */
+  virtual void sendTrailers(const Http::HeaderMap& trailers) PURE;
+
+  /**
+   * Abandon the shadowed request, e.g. because the primary request was reset.
+   */
+  virtual void cancel() PURE;
+};
+
+/**
+ * Interface used to shadow requests to an alternate upstream cluster in a "fire and forget"
+ * fashion. Requests can either be shadowed whole, or streamed to the shadow cluster as they
+ * arrive.
  */
 class ShadowWriter {
 public:
@@ -26,6 +57,18 @@ public:
    */
   virtual void shadow(const std::string& cluster, Http::MessagePtr&& request,
                       std::chrono::milliseconds timeout) PURE;
+
+  /**
+   * Start shadowing a request before its body has arrived.
+   * @param cluster supplies the cluster name to shadow to.
+   * @param headers supplies the request headers.
+   * @param end_stream supplies whether this is a header only request.
+   * @param timeout supplies the shadowed request timeout.
+   * @return ShadowStream* the handle to forward the rest of the request through, or nullptr if the
+   *         request has already ended or the shadow could not be started.
+   */
+  virtual ShadowStream* streamShadow(const std::string& cluster, Http::HeaderMapPtr&& headers,
+                                     bool end_stream, std::chrono::milliseconds timeout) PURE;
 };
 
 typedef std::unique_ptr<ShadowWriter> ShadowWriterPtr;
@@ -30,6 +30,30 @@ public:
 
 typedef std::unique_ptr<RandomGenerator> RandomGeneratorPtr;
 
+/**
+ * A runtime key resolved up front to a dense index, so that snapshots can find its value with a
+ * single array access instead of hashing the name. Keys are obtained from Runtime::KeyRegistry and
+ * are meant to be created once, at startup or when configuration is loaded, not per request.
+ */
+class Key {
+public:
+  Key(const std::string& name, uint32_t index) : name_(name), index_(index) {}
+
+  /**
+   * @return const std::string& the name of the key.
+   */
+  const std::string& name() const { return name_; }
+
+  /**
+   * @return uint32_t the dense index of the key, unique per name within the process.
+   */
+  uint32_t index() const { return index_; }
+
+private:
+  std::string name_;
+  uint32_t index_;
+};
+
 /**
  * A snapshot of runtime data.
  */
@@ -96,6 +120,32 @@ public:
    * @return uint64_t the runtime value or the default value.
    */
   virtual uint64_t getInteger(const std::string& key, uint64_t default_value) const PURE;
+
+  /**
+   * Variants of the above that take a registered key. Implementations that index their values
+   * by key override these; the defaults fall back to looking the key up by name.
+   */
+  virtual bool featureEnabled(const Key& key, uint64_t default_value) const {
+    return featureEnabled(key.name(), default_value);
+  }
+  virtual bool featureEnabled(const Key& key, uint64_t default_value,
+                              uint64_t random_value) const {
+    return featureEnabled(key.name(), default_value, random_value);
+  }
+  virtual bool featureEnabled(const Key& key, uint64_t default_value, uint64_t random_value,
+                              uint16_t num_buckets) const {
+    return featureEnabled(key.name(), default_value, random_value, num_buckets);
+  }
+  virtual uint64_t getInteger(const Key& key, uint64_t default_value) const {
+    return getInteger(key.name(), default_value);
+  }
+
+  /**
+   * @return uint64_t a number that identifies this snapshot. The values of a snapshot never change,
+   *         so callers may cache what they read for as long as the generation stays the same. A
+   *         generation of 0 means that values may change at any time and must not be cached.
+   */
+  virtual uint64_t generation() const PURE;
 };
 
 /**
@@ -8,8 +8,10 @@
 #include <vector>
 
 #include "envoy/common/optional.h"
+#include "envoy/network/listener.h"
 #include "envoy/ratelimit/ratelimit.h"
 #include "envoy/ssl/context.h"
+#include "envoy/stats/stats.h"
 #include "envoy/tracing/http_tracer.h"
 #include "envoy/upstream/cluster_manager.h"
 
@@ -53,6 +55,26 @@ public:
    */
   virtual bool bindToPort() PURE;
 
+  /**
+   * @return bool whether each worker should get its own SO_REUSEPORT socket for the listener, so
+   *         that the kernel distributes new connections across workers instead of all workers
+   *         contending for accepts on a single shared socket.
+   */
+  virtual bool reusePort() PURE;
+
+  /**
+   * @return bool whether new connections on the per worker SO_REUSEPORT sockets should be steered
+   *         to the worker whose index matches the CPU that received the connection, rather than
+   *         by the kernel's default flow hash. Only meaningful when reusePort() is true.
+   */
+  virtual bool reusePortCpuSteering() PURE;
+
+  /**
+   * @return Network::ConnectionBalancer* the balancer that hands new connections to the least
+   *         loaded worker, or nullptr if connections stay on the worker that accepted them.
+   */
+  virtual Network::ConnectionBalancer* connectionBalancer() PURE;
+
   /**
    * @return bool if a connection was redirected to this listener address using iptables,
    *         allow the listener to hand it off to the listener associated to the original address
@@ -65,6 +87,18 @@ public:
    */
   virtual uint32_t perConnectionBufferLimitBytes() PURE;
 
+  /**
+   * @return bool whether the listener has to peek at the TLS ClientHello of new connections
+   *         because its filter chains are selected by server name or application protocol.
+   */
+  virtual bool inspectTlsClientHello() PURE;
+
+  /**
+   * @return const Network::SocketOptionsConstSharedPtr& the options to apply to the listen socket,
+   *         which new connections inherit, or nullptr to keep the operating system defaults.
+   */
+  virtual const Network::SocketOptionsConstSharedPtr& socketOptions() PURE;
+
   /**
    * @return Stats::Scope& the stats scope to use for all listener specific stats.
    */
@@ -141,6 +175,12 @@ public:
    */
   virtual Optional<std::string> statsdUdpIpAddress() PURE;
 
+  /**
+   * @return uint32_t the maximum size of the datagrams used to batch metrics written to UDP statsd,
+   *         or 0 if each metric is written in its own datagram.
+   */
+  virtual uint32_t statsdUdpMaxDatagramSize() PURE;
+
   /**
    * @return std::chrono::milliseconds the time interval between flushing to configured stat sinks.
    *         The server latches counters.
@@ -170,6 +210,12 @@ public:
    *         multiple nonresponsive threads.
    */
   virtual std::chrono::milliseconds wdMultiKillTimeout() const PURE;
+
+  /**
+   * @return uint32_t the number of stack samples to take of a thread when it first becomes
+   *         nonresponsive for longer than the miss timeout. 0 disables stall sampling.
+   */
+  virtual uint32_t wdStallSamples() const PURE;
 };
 
 /**
@@ -189,6 +235,18 @@ public:
    */
   virtual const std::string& profilePath() PURE;
 
+  /**
+   * @return uint32_t the sampling frequency of the continuous CPU profiler, or 0 if continuous
+   *         profiling is off.
+   */
+  virtual uint32_t profileFrequencyHz() PURE;
+
+  /**
+   * @return std::chrono::milliseconds how often the continuous CPU profile is cut into a new
+   *         window.
+   */
+  virtual std::chrono::milliseconds profileWindow() PURE;
+
   /**
    * @return Network::Address::InstanceConstSharedPtr the server address.
    */
@@ -216,6 +274,12 @@ public:
    * @return Runtime* the local disk runtime configuration or nullptr if there is no configuration.
    */
   virtual Runtime* runtime() PURE;
+
+  /**
+   * @return Stats::TagProducerPtr a new producer for the tags to extract from stat names. Throws
+   *         EnvoyException if a configured tag is invalid.
+   */
+  virtual Stats::TagProducerPtr createTagProducer() PURE;
 };
 
 } // Configuration
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <chrono>
+
 #include "envoy/common/pure.h"
 #include "envoy/server/watchdog.h"
 #include "envoy/stats/stats.h"
@@ -39,6 +41,12 @@ public:
    * @param wd A WatchDogSharedPtr obtained from createWatchDog.
    */
   virtual void stopWatching(WatchDogSharedPtr wd) PURE;
+
+  /**
+   * @return std::chrono::milliseconds how far the most delayed of the watched event loops is
+   *         behind on touching its WatchDog, or zero if all of them are on time.
+   */
+  virtual std::chrono::milliseconds eventLoopLag() PURE;
 };
 
 } // Server
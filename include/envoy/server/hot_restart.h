@@ -2,9 +2,11 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include "envoy/common/pure.h"
 #include "envoy/event/dispatcher.h"
+#include "envoy/stats/stats.h"
 
 namespace Envoy {
 namespace Server {
@@ -36,12 +38,15 @@ public:
   virtual void drainParentListeners() PURE;
 
   /**
-   * Retrieve a listening socket on the specified port from the parent process. The socket will be
-   * duplicated across process boundaries.
-   * @param port supplies the port of the socket to duplicate.
-   * @return int the fd or -1 if there is no bound listen port in the parent.
+   * Retrieve the listening sockets on the specified addresses from the parent process. The sockets
+   * will be duplicated across process boundaries. Many sockets are passed per message, so this
+   * takes a few round trips to the parent however many addresses there are.
+   * @param addresses supplies the addresses of the sockets to duplicate.
+   * @return std::vector<int> the fd for each address, in order, or -1 for an address that has no
+   *         bound listen socket in the parent.
    */
-  virtual int duplicateParentListenSocket(const std::string& address) PURE;
+  virtual std::vector<int> duplicateParentListenSockets(const std::vector<std::string>& addresses)
+      PURE;
 
   /**
    * Retrieve stats from our parent process.
@@ -49,6 +54,14 @@ public:
    */
   virtual void getParentStats(GetParentStatsInfo& info) PURE;
 
+  /**
+   * Retrieve the cumulative histogram samples of our parent process and add them to the histograms
+   * of the same name in the supplied store, so that cumulative statistics carry across the
+   * restart. Counters and gauges live in shared memory and need no transfer.
+   * @param store supplies the store to add the samples to.
+   */
+  virtual void mergeParentHistograms(Stats::StoreRoot& store) PURE;
+
   /**
    * Initialize the restarter after primary server initialization begins. The hot restart
    * implementation needs to be created early to deal with shared memory, logging, etc. so
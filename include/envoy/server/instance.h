@@ -3,6 +3,8 @@
 #include <chrono>
 #include <cstdint>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "envoy/access_log/access_log.h"
 #include "envoy/api/api.h"
@@ -15,6 +17,7 @@
 #include "envoy/server/drain_manager.h"
 #include "envoy/server/hot_restart.h"
 #include "envoy/server/options.h"
+#include "envoy/server/overload_manager.h"
 #include "envoy/ssl/context_manager.h"
 #include "envoy/thread_local/thread_local.h"
 #include "envoy/tracing/http_tracer.h"
@@ -23,6 +26,11 @@
 namespace Envoy {
 namespace Server {
 
+/**
+ * The time taken by each phase of server startup, in order.
+ */
+typedef std::vector<std::pair<std::string, std::chrono::milliseconds>> StartupPhaseTimes;
+
 /**
  * An instance of the running server.
  */
@@ -57,7 +65,8 @@ public:
   virtual Event::Dispatcher& dispatcher() PURE;
 
   /**
-   * @return Network::DnsResolverSharedPtr the singleton DNS resolver for the server.
+   * @return Network::DnsResolverSharedPtr the singleton DNS resolver for the server. It may be
+   *         used on the main thread and on workers, and resolves on the calling thread.
    */
   virtual Network::DnsResolverSharedPtr dnsResolver() PURE;
 
@@ -127,11 +136,22 @@ public:
    */
   virtual Init::Manager& initManager() PURE;
 
+  /**
+   * @return the number of connections currently open on the workers of this process. This must be
+   *         called on the main thread.
+   */
+  virtual uint64_t numConnections() PURE;
+
   /**
    * @return the server's CLI options.
    */
   virtual Options& options() PURE;
 
+  /**
+   * @return OverloadManager& singleton for use by the entire server.
+   */
+  virtual OverloadManager& overloadManager() PURE;
+
   /**
    * @return RandomGenerator& the random generator for the server.
    */
@@ -168,6 +188,11 @@ public:
    */
   virtual time_t startTimeFirstEpoch() PURE;
 
+  /**
+   * @return the time taken by each phase of startup that has completed so far.
+   */
+  virtual const StartupPhaseTimes& startupPhaseTimes() PURE;
+
   /**
    * @return the server-wide stats store.
    */
@@ -3,6 +3,7 @@
 #include <chrono>
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include "envoy/common/pure.h"
 #include "envoy/network/address.h"
@@ -100,6 +101,36 @@ public:
     * @return std::chrono::milliseconds the duration in msec between log flushes.
     */
   virtual std::chrono::milliseconds fileFlushIntervalMsec() PURE;
+
+  /**
+   * @return uint64_t the maximum number of stats that can be allocated in the shared memory
+   *         region used for hot restart.
+   */
+  virtual uint64_t maxStats() PURE;
+
+  /**
+   * @return const std::vector<uint32_t>& the CPUs to pin worker threads to. Worker i is pinned to
+   *         the i-th CPU, wrapping around if there are more workers than CPUs. Empty if workers
+   *         are not pinned.
+   */
+  virtual const std::vector<uint32_t>& workerCpus() PURE;
+
+  /**
+   * @return const std::vector<uint32_t>& the CPUs the main thread may run on. Empty if the main
+   *         thread is not pinned.
+   */
+  virtual const std::vector<uint32_t>& mainThreadCpus() PURE;
+
+  /**
+   * @return bool whether heap allocations are attributed to subsystems.
+   */
+  virtual bool memoryAccounting() PURE;
+
+  /**
+   * @return uint32_t the maximum number of log lines waiting for the log writer thread, or 0 if
+   *         lines are written synchronously by the threads that log them.
+   */
+  virtual uint32_t asyncLogLines() PURE;
 };
 
 } // Server
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "envoy/common/pure.h"
+#include "envoy/event/dispatcher.h"
+
+namespace Envoy {
+namespace Server {
+
+/**
+ * Actions the overload manager can take when the server runs short of resources.
+ */
+enum class OverloadActionName {
+  // New connections are closed as soon as they are accepted.
+  StopAcceptingConnections,
+  // HTTP connections are closed once their current response is complete.
+  DisableHttpKeepAlive,
+  // New connections get a smaller read buffer limit than their listener configures.
+  ReduceBufferLimits,
+  // Cached free memory is returned to the operating system.
+  ShrinkHeap,
+  // The connections holding the most buffered data are reset.
+  ResetLargestConnections
+};
+
+/**
+ * Whether an overload action is active. The state is switched on the main thread and read on the
+ * workers, where checking it is a single relaxed atomic load so that it can be done on the hot
+ * path.
+ */
+class OverloadActionState {
+public:
+  bool isActive() const { return active_.load(std::memory_order_relaxed); }
+  void setActive(bool active) { active_.store(active, std::memory_order_relaxed); }
+
+private:
+  std::atomic<bool> active_{};
+};
+
+/**
+ * Monitors the resources of the server and switches overload actions on and off as they cross
+ * their configured thresholds.
+ */
+class OverloadManager {
+public:
+  virtual ~OverloadManager() {}
+
+  /**
+   * Start monitoring resources. Called once on the main thread when the server is ready.
+   */
+  virtual void start() PURE;
+
+  /**
+   * @param action supplies the action.
+   * @return const OverloadActionState& the state of the action. It stays valid for the life of the
+   *         overload manager and may be read from any thread.
+   */
+  virtual const OverloadActionState& getActionState(OverloadActionName action) PURE;
+
+  /**
+   * @return uint32_t the read buffer limit applied to new connections while the ReduceBufferLimits
+   *         action is active.
+   */
+  virtual uint32_t reducedBufferLimitBytes() PURE;
+
+  typedef std::function<void()> ActionCb;
+
+  /**
+   * Register a callback that is posted to a dispatcher after every refresh during which an action
+   * is active, so that actions that shed load keep doing so for as long as the pressure lasts. Must
+   * be called on the main thread before start().
+   * @param action supplies the action.
+   * @param dispatcher supplies the dispatcher the callback runs on.
+   * @param cb supplies the callback.
+   */
+  virtual void registerForAction(OverloadActionName action, Event::Dispatcher& dispatcher,
+                                 ActionCb cb) PURE;
+};
+
+typedef std::unique_ptr<OverloadManager> OverloadManagerPtr;
+
+} // Server
+} // Envoy
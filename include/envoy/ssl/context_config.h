@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -8,6 +9,14 @@
 namespace Envoy {
 namespace Ssl {
 
+/**
+ * The files that hold a certificate chain and its private key.
+ */
+struct CertificateFiles {
+  std::string cert_chain_file_;
+  std::string private_key_file_;
+};
+
 /**
  * Supplies the configuration for an SSL context.
  */
@@ -52,6 +61,13 @@ public:
    */
   virtual const std::string& privateKeyFile() const PURE;
 
+  /**
+   * @return The additional certificates of a server context. A client whose server name indication
+   * matches one of the DNS names of a certificate is served that certificate, and other clients are
+   * served certChainFile().
+   */
+  virtual const std::vector<CertificateFiles>& sniCertificates() const PURE;
+
   /**
    * @return The subject alt names to be verified, if enabled. Otherwise, ""
    */
@@ -68,6 +84,24 @@ public:
    * Otherwise, ""
    */
   virtual const std::string& serverNameIndication() const PURE;
+
+  /**
+   * @return The files that hold the keys used to encrypt and decrypt session tickets. The first
+   * key encrypts new tickets and every key decrypts tickets presented by clients. If empty, a
+   * random key private to the context is used.
+   */
+  virtual const std::vector<std::string>& sessionTicketKeyPaths() const PURE;
+
+  /**
+   * @return The number of threads that run private key operations for server handshakes, or 0 to
+   * run them inline on the connection's worker.
+   */
+  virtual uint32_t privateKeyOffloadThreads() const PURE;
+
+  /**
+   * @return true if TLS records should be encrypted by the kernel once the handshake completes.
+   */
+  virtual bool kernelTlsTx() const PURE;
 };
 
 } // Ssl
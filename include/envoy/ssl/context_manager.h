@@ -35,6 +35,14 @@ public:
    * Iterate through all currently allocated contexts.
    */
   virtual void iterateContexts(std::function<void(Context&)> callback) PURE;
+
+  /**
+   * Load the certificates, private keys and session ticket keys of all server contexts again from
+   * their files. New connections use the reloaded files, while existing connections are unaffected.
+   * Server contexts whose files fail to load keep using the files they had.
+   * throws EnvoyException describing every server context that failed to reload.
+   */
+  virtual void reloadServerContexts() PURE;
 };
 
 } // Ssl
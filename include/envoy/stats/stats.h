@@ -2,11 +2,15 @@
 
 #include <chrono>
 #include <cstdint>
+#include <functional>
 #include <list>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "envoy/common/pure.h"
+#include "envoy/common/time.h"
 
 namespace Envoy {
 namespace Event {
@@ -19,18 +23,66 @@ class Instance;
 
 namespace Stats {
 
+/**
+ * A dimension of a stat, e.g. the cluster a stat belongs to, extracted from the stat's name.
+ */
+struct Tag {
+  std::string name_;
+  std::string value_;
+};
+
+/**
+ * Extracts tags from stat names. The store runs the producer once when a stat is created.
+ */
+class TagProducer {
+public:
+  virtual ~TagProducer() {}
+
+  /**
+   * @param name supplies the full stat name.
+   * @param tags supplies the tags to add the extracted tags to.
+   * @return the name with the extracted tags removed.
+   */
+  virtual std::string produceTags(const std::string& name, std::vector<Tag>& tags) const PURE;
+};
+
+typedef std::unique_ptr<const TagProducer> TagProducerPtr;
+
+/**
+ * General interface for all stats objects that are flushed to sinks.
+ */
+class Metric {
+public:
+  virtual ~Metric() {}
+
+  /**
+   * @return the full name of the metric.
+   */
+  virtual std::string name() const PURE;
+
+  /**
+   * @return the name of the metric with the tags extracted when it was created removed. This is
+   *         the full name if no tags were extracted.
+   */
+  virtual const std::string& tagExtractedName() const PURE;
+
+  /**
+   * @return the tags extracted from the name of the metric when it was created.
+   */
+  virtual const std::vector<Tag>& tags() const PURE;
+};
+
 /**
  * An always incrementing counter with latching capability. Each increment is added both to a
  * global counter as well as periodic counter. Calling latch() returns the periodic counter and
  * clears it.
  */
-class Counter {
+class Counter : public Metric {
 public:
   virtual ~Counter() {}
   virtual void add(uint64_t amount) PURE;
   virtual void inc() PURE;
   virtual uint64_t latch() PURE;
-  virtual std::string name() PURE;
   virtual void reset() PURE;
   virtual bool used() PURE;
   virtual uint64_t value() PURE;
@@ -41,14 +93,13 @@ typedef std::shared_ptr<Counter> CounterSharedPtr;
 /**
  * A gauge that can both increment and decrement.
  */
-class Gauge {
+class Gauge : public Metric {
 public:
   virtual ~Gauge() {}
 
   virtual void add(uint64_t amount) PURE;
   virtual void dec() PURE;
   virtual void inc() PURE;
-  virtual std::string name() PURE;
   virtual void set(uint64_t value) PURE;
   virtual void sub(uint64_t amount) PURE;
   virtual bool used() PURE;
@@ -88,11 +139,85 @@ public:
   virtual ~Timer() {}
 
   virtual TimespanPtr allocateSpan() PURE;
+
+  /**
+   * Allocate a timespan that reads its start and end times from a time source instead of the
+   * clock, e.g. an event loop's cached loop time. @see Event::Dispatcher::loopTimeSource().
+   * @param time_source supplies the time source, which must outlive the timespan.
+   */
+  virtual TimespanPtr allocateSpan(MonotonicTimeSource& time_source) PURE;
+
   virtual std::string name() PURE;
 };
 
 typedef std::shared_ptr<Timer> TimerSharedPtr;
 
+/**
+ * Summary statistics computed over a set of histogram samples.
+ */
+class HistogramStatistics {
+public:
+  typedef std::function<void(uint64_t value, uint64_t count)> BucketCb;
+
+  virtual ~HistogramStatistics() {}
+
+  /**
+   * @return the number of samples.
+   */
+  virtual uint64_t sampleCount() const PURE;
+
+  /**
+   * @return the sum of all samples.
+   */
+  virtual uint64_t sampleSum() const PURE;
+
+  /**
+   * @param quantile supplies the quantile to compute in the range [0, 1].
+   * @return the approximate sample value at the quantile, or 0 if there are no samples. The result
+   *         is accurate to within the bucket resolution of the histogram.
+   */
+  virtual uint64_t quantile(double quantile) const PURE;
+
+  /**
+   * Visit the buckets that counted at least one sample, in increasing order of value.
+   * @param cb supplies the callback, called with the largest value counted by a bucket and the
+   *        number of samples it counted.
+   */
+  virtual void iterateBuckets(const BucketCb& cb) const PURE;
+
+  /**
+   * @return a human readable summary of the statistics.
+   */
+  virtual std::string summary() const PURE;
+};
+
+/**
+ * A histogram of samples recorded via Scope::deliverHistogramToSinks() and
+ * Scope::deliverTimingToSinks(). Samples are recorded per thread and merged on the main thread.
+ */
+class Histogram : public Metric {
+public:
+  virtual ~Histogram() {}
+
+  /**
+   * Merge the samples recorded on all threads since the previous merge. This must be called on the
+   * main thread.
+   */
+  virtual void merge() PURE;
+
+  /**
+   * @return the statistics for the samples merged by the most recent call to merge().
+   */
+  virtual const HistogramStatistics& intervalStatistics() const PURE;
+
+  /**
+   * @return the statistics for all samples merged since the histogram was created.
+   */
+  virtual const HistogramStatistics& cumulativeStatistics() const PURE;
+};
+
+typedef std::shared_ptr<Histogram> HistogramSharedPtr;
+
 /**
  * A sink for stats. Each sink is responsible for writing stats to a backing store.
  */
@@ -101,24 +226,34 @@ public:
   virtual ~Sink() {}
 
   /**
-   * Flush a counter delta.
+   * This will be called before a sequence of flush*() calls. Sinks may buffer stats until
+   * endFlush() is called.
    */
-  virtual void flushCounter(const std::string& name, uint64_t delta) PURE;
+  virtual void beginFlush() PURE;
 
   /**
-   * Flush a gauge value.
+   * Flush a counter delta. Only counters that were incremented since the previous flush are
+   * flushed. Sinks that support dimensions can use the counter's tag extracted name and tags,
+   * other sinks its full name.
    */
-  virtual void flushGauge(const std::string& name, uint64_t value) PURE;
+  virtual void flushCounter(const Counter& counter, uint64_t delta) PURE;
 
   /**
-   * Flush a histogram value.
+   * Flush a gauge value. Only gauges that changed since the previous flush are flushed.
    */
-  virtual void onHistogramComplete(const std::string& name, uint64_t value) PURE;
+  virtual void flushGauge(const Gauge& gauge, uint64_t value) PURE;
 
   /**
-   * Flush a timespan value.
+   * Flush the statistics for the samples recorded by a histogram during the last flush interval.
    */
-  virtual void onTimespanComplete(const std::string& name, std::chrono::milliseconds ms) PURE;
+  virtual void flushHistogram(const Histogram& histogram,
+                              const HistogramStatistics& statistics) PURE;
+
+  /**
+   * This will be called after beginFlush() and a sequence of flush*() calls. Any buffered stats
+   * should be written.
+   */
+  virtual void endFlush() PURE;
 };
 
 typedef std::unique_ptr<Sink> SinkPtr;
@@ -132,12 +267,13 @@ public:
   virtual ~Scope() {}
 
   /**
-   * Deliver an individual histogram value to all registered sinks.
+   * Record an individual histogram value. Values are flushed to sinks in aggregate.
    */
   virtual void deliverHistogramToSinks(const std::string& name, uint64_t value) PURE;
 
   /**
-   * Deliver an individual timespan completion to all registered sinks.
+   * Record an individual timespan completion in milliseconds. Timespans are recorded in a histogram
+   * of the same name.
    */
   virtual void deliverTimingToSinks(const std::string& name, std::chrono::milliseconds ms) PURE;
 
@@ -160,7 +296,7 @@ public:
 typedef std::unique_ptr<Scope> ScopePtr;
 
 /**
- * A store for all known counters, gauges, and timers.
+ * A store for all known counters, gauges, timers, and histograms.
  */
 class Store : public Scope {
 public:
@@ -181,6 +317,11 @@ public:
    * @return a list of all known gauges.
    */
   virtual std::list<GaugeSharedPtr> gauges() const PURE;
+
+  /**
+   * @return a list of all known histograms.
+   */
+  virtual std::list<HistogramSharedPtr> histograms() const PURE;
 };
 
 /**
@@ -188,10 +329,8 @@ public:
  */
 class StoreRoot : public Store {
 public:
-  /**
-   * Add a sink that is used for stat flushing.
-   */
-  virtual void addSink(Sink& sink) PURE;
+  typedef std::function<void(Counter& counter, uint64_t delta)> ChangedCounterCb;
+  typedef std::function<void(Gauge& gauge)> ChangedGaugeCb;
 
   /**
    * Initialize the store for threading. This will be called once after all worker threads have
@@ -205,6 +344,33 @@ public:
    * down.
    */
   virtual void shutdownThreading() PURE;
+
+  /**
+   * Set the producer used to extract tags from the names of stats created from now on. Stats
+   * created before this is called, or if it is never called, have no tags.
+   */
+  virtual void setTagProducer(TagProducerPtr&& tag_producer) PURE;
+
+  /**
+   * Visit the counters and gauges that changed since the previous call, without visiting the ones
+   * that did not. Counters are latched and passed along with the latched increment, and counters
+   * whose increment is zero are skipped. This is called on the main thread when stats are flushed.
+   * Increments made by a parent process during hot restart are flushed along with the next change
+   * made by this process.
+   */
+  virtual void forEachChangedStat(const ChangedCounterCb& counter_cb,
+                                  const ChangedGaugeCb& gauge_cb) PURE;
+
+  /**
+   * Add samples recorded by a parent process before a hot restart to the cumulative statistics of
+   * the histogram with the supplied name, creating the histogram if needed. This is called on the
+   * main thread.
+   * @param name supplies the final name of the histogram.
+   * @param sample_sum supplies the sum of the samples.
+   * @param buckets supplies the samples, as pairs of a value and the number of samples of it.
+   */
+  virtual void addParentHistogram(const std::string& name, uint64_t sample_sum,
+                                  const std::vector<std::pair<uint64_t, uint64_t>>& buckets) PURE;
 };
 
 typedef std::unique_ptr<StoreRoot> StoreRootPtr;
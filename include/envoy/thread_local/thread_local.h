@@ -39,18 +39,19 @@ public:
   virtual uint32_t allocateSlot() PURE;
 
   /**
-   * Get a thread local index stored in the specified slot ID.
+   * Get a thread local index stored in the specified slot ID. The reference is only valid on the
+   * calling thread and only until the slot is set again. Returning a reference rather than a copy
+   * avoids an atomic reference count update, on a count shared by every worker when the same
+   * object is stored on all threads, for each access.
    */
-  virtual ThreadLocalObjectSharedPtr get(uint32_t index) PURE;
+  virtual const ThreadLocalObjectSharedPtr& get(uint32_t index) PURE;
 
   /**
    * This is a helper on top of get() that casts the object stored in the slot to the specified
    * type. No type information is specified explicitly in code so dynamic_cast provides some level
    * of protection via RTTI.
    */
-  template <class T> T& getTyped(uint32_t index) {
-    return *std::dynamic_pointer_cast<T>(get(index));
-  }
+  template <class T> T& getTyped(uint32_t index) { return dynamic_cast<T&>(*get(index)); }
 
   /**
    * A thread (via its dispatcher) must be registered before set() is called to receive thread
@@ -11,6 +11,7 @@
 #include "envoy/http/conn_pool.h"
 #include "envoy/json/json_object.h"
 #include "envoy/local_info/local_info.h"
+#include "envoy/network/dns.h"
 #include "envoy/runtime/runtime.h"
 #include "envoy/upstream/load_balancer.h"
 #include "envoy/upstream/thread_local_cluster.h"
@@ -19,6 +20,25 @@
 namespace Envoy {
 namespace Upstream {
 
+/**
+ * A pending on demand discovery of a cluster, see ClusterManager::discoverCluster().
+ */
+class ClusterDiscoveryRequest {
+public:
+  virtual ~ClusterDiscoveryRequest() {}
+
+  /**
+   * Cancel the request. The callback will not be called.
+   */
+  virtual void cancel() PURE;
+};
+
+/**
+ * Called on the thread that requested the discovery of a cluster once the discovery is complete,
+ * whether or not the cluster was found.
+ */
+typedef std::function<void()> ClusterDiscoveryCb;
+
 /**
  * Manages connection pools and load balancing for upstream clusters. The cluster manager is
  * persistent and shared among multiple ongoing requests/connections.
@@ -62,6 +82,20 @@ public:
    */
   virtual ThreadLocalCluster* get(const std::string& cluster) PURE;
 
+  /**
+   * @return ClusterId the interned ID for a cluster name. The cluster does not need to exist yet.
+   * This takes a lock and is meant to be called at config load time rather than per request. This
+   * is thread safe.
+   */
+  virtual ClusterId clusterId(const std::string& cluster) PURE;
+
+  /**
+   * @return ThreadLocalCluster* the thread local cluster with the given ID or nullptr if it does
+   * not currently exist. This is the same as get() but avoids hashing the cluster name. The same
+   * lifetime restrictions apply to the returned pointer. This is thread safe.
+   */
+  virtual ThreadLocalCluster* getById(ClusterId id) PURE;
+
   /**
    * Allocate a load balanced HTTP connection pool for a cluster. This is *per-thread* so that
    * callers do not need to worry about per thread synchronization. The load balancing policy that
@@ -81,8 +115,12 @@ public:
    *
    * Returns both a connection and the host that backs the connection. Both can be nullptr if there
    * is no host available in the cluster.
+   *
+   * @param cluster supplies the cluster name.
+   * @param context supplies the load balancer context, or nullptr.
    */
-  virtual Host::CreateConnectionData tcpConnForCluster(const std::string& cluster) PURE;
+  virtual Host::CreateConnectionData tcpConnForCluster(const std::string& cluster,
+                                                       LoadBalancerContext* context) PURE;
 
   /**
    * Returns a client that can be used to make async HTTP calls against the given cluster. The
@@ -100,6 +138,19 @@ public:
    */
   virtual bool removePrimaryCluster(const std::string& cluster) PURE;
 
+  /**
+   * Discover a cluster that does not exist yet through the CDS API. Discoveries of the same
+   * cluster are coalesced across all threads. This is *per-thread*: the callback is invoked on the
+   * calling thread, after the cluster has been added to it if it was found.
+   *
+   * @param cluster supplies the cluster name.
+   * @param callback supplies the callback to invoke once the discovery is complete.
+   * @return ClusterDiscoveryRequest* a handle that can be used to cancel the discovery, or nullptr
+   *         if on demand discovery is not configured, in which case the callback is never called.
+   */
+  virtual ClusterDiscoveryRequest* discoverCluster(const std::string& cluster,
+                                                   ClusterDiscoveryCb callback) PURE;
+
   /**
    * Shutdown the cluster manager prior to destroying connection pools and other thread local data.
    */
@@ -114,6 +165,10 @@ typedef std::unique_ptr<ClusterManager> ClusterManagerPtr;
 struct SdsConfig {
   std::string sds_cluster_name_;
   std::chrono::milliseconds refresh_delay_;
+  // Whether hosts are pushed over a long lived stream rather than fetched periodically.
+  bool stream_;
+  // The directory that the last good response of each SDS cluster is persisted to, if not empty.
+  std::string snapshot_dir_;
 };
 
 /**
@@ -133,6 +188,22 @@ public:
    * server. If the initial load fails, the callback will also be called.
    */
   virtual void setInitializedCb(std::function<void()> callback) PURE;
+
+  /**
+   * Fetch a single cluster that is not loaded yet. This is thread safe. The fetch runs on the main
+   * thread, and a request for a cluster that is already being fetched joins that fetch. A cluster
+   * that is found is added through ClusterManager::addOrUpdatePrimaryCluster().
+   * @param cluster supplies the cluster name.
+   * @return bool whether on demand fetches are enabled. If not, nothing is fetched.
+   */
+  virtual bool requestCluster(const std::string& cluster) PURE;
+
+  /**
+   * Set a callback that is called on the main thread each time an on demand fetch completes,
+   * whether or not the cluster was found.
+   */
+  virtual void
+  setClusterRequestCompleteCb(std::function<void(const std::string& cluster)> callback) PURE;
 };
 
 typedef std::unique_ptr<CdsApi> CdsApiPtr;
@@ -172,6 +243,13 @@ public:
    * Create a CDS API provider from configuration JSON.
    */
   virtual CdsApiPtr createCds(const Json::Object& config, ClusterManager& cm) PURE;
+
+  /**
+   * @return Network::DnsResolverSharedPtr the DNS resolver that clusters resolve their hosts with.
+   *         Load balancers that resolve hosts on workers also use it, so it must be usable from
+   *         any thread.
+   */
+  virtual Network::DnsResolverSharedPtr dnsResolver() PURE;
 };
 
 } // Upstream
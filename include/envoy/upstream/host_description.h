@@ -1,7 +1,10 @@
 #pragma once
 
+#include <cstdint>
+#include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "envoy/network/address.h"
 #include "envoy/stats/stats_macros.h"
@@ -32,6 +35,12 @@ struct HostStats {
 
 class ClusterInfo;
 
+/**
+ * Key/value metadata attached to a host by its discovery source. Used, e.g., by the subset load
+ * balancer to partition a cluster's hosts.
+ */
+typedef std::map<std::string, std::string> HostMetadata;
+
 /**
  * A description of an upstream host.
  */
@@ -65,6 +74,12 @@ public:
    */
   virtual Network::Address::InstanceConstSharedPtr address() const PURE;
 
+  /**
+   * @return the addresses the host can be connected to, in order of preference. The first is
+   *         address(). Connections race the remaining addresses against it.
+   */
+  virtual std::vector<Network::Address::InstanceConstSharedPtr> addressList() const PURE;
+
   /**
    * @return host specific stats.
    */
@@ -74,6 +89,17 @@ public:
    * @return the "zone" of the host (deployment specific). Empty is unknown.
    */
   virtual const std::string& zone() const PURE;
+
+  /**
+   * @return the priority level of the host. 0 is the highest priority. Hosts of a lower priority
+   *         only receive traffic when the higher priority levels do not have enough healthy hosts.
+   */
+  virtual uint32_t priority() const PURE;
+
+  /**
+   * @return the metadata of the host. Empty if the discovery source did not supply any.
+   */
+  virtual const HostMetadata& metadata() const PURE;
 };
 
 typedef std::shared_ptr<const HostDescription> HostDescriptionConstSharedPtr;
@@ -4,6 +4,8 @@
 #include <memory>
 
 #include "envoy/common/pure.h"
+#include "envoy/http/header_map.h"
+#include "envoy/network/connection.h"
 #include "envoy/upstream/upstream.h"
 
 namespace Envoy {
@@ -21,6 +23,26 @@ public:
    * @return const Optional<uint64_t>& the optional hash key to use during load balancing.
    */
   virtual const Optional<uint64_t>& hashKey() const PURE;
+
+  /**
+   * @return const HostMetadata* the host metadata a host must match to be chosen, or nullptr if
+   *         any host may be used. Only the subset load balancer makes use of the criteria.
+   */
+  virtual const HostMetadata* metadataMatchCriteria() const PURE;
+
+  /**
+   * @return const Network::Connection* the downstream connection the host is chosen for, or
+   *         nullptr if there is none. Only the original destination load balancer makes use of
+   *         the connection.
+   */
+  virtual const Network::Connection* downstreamConnection() const PURE;
+
+  /**
+   * @return const Http::HeaderMap* the headers of the downstream request the host is chosen for,
+   *         or nullptr if there is none. Only the dynamic forward proxy load balancer makes use of
+   *         the headers.
+   */
+  virtual const Http::HeaderMap* downstreamHeaders() const PURE;
 };
 
 /**
@@ -41,5 +63,36 @@ public:
 
 typedef std::unique_ptr<LoadBalancer> LoadBalancerPtr;
 
+/**
+ * Immutable load balancer state that is computed from the hosts of a cluster, such as a
+ * consistent hashing ring. Tables are built once on the main thread when the hosts of a cluster
+ * change and are shared read only by the load balancers of all workers, which only keep the mutable
+ * state of their picks.
+ */
+class LoadBalancerTable {
+public:
+  virtual ~LoadBalancerTable() {}
+};
+
+typedef std::shared_ptr<const LoadBalancerTable> LoadBalancerTableConstSharedPtr;
+
+/**
+ * Builds the load balancer tables of a cluster.
+ */
+class LoadBalancerTableBuilder {
+public:
+  virtual ~LoadBalancerTableBuilder() {}
+
+  /**
+   * Build the table for the current hosts of a host set. A builder may reuse the table it built
+   * previously to apply host changes incrementally.
+   * @param host_set supplies the host set to build the table for.
+   * @return LoadBalancerTableConstSharedPtr the new table.
+   */
+  virtual LoadBalancerTableConstSharedPtr build(const HostSet& host_set) PURE;
+};
+
+typedef std::unique_ptr<LoadBalancerTableBuilder> LoadBalancerTableBuilderPtr;
+
 } // Upstream
 } // Envoy
@@ -1,12 +1,60 @@
 #pragma once
 
+#include <set>
+#include <string>
+#include <vector>
+
+#include "envoy/common/pure.h"
+
 namespace Envoy {
 namespace Upstream {
 
 /**
  * Type of load balancing to perform.
  */
-enum class LoadBalancerType { RoundRobin, LeastRequest, Random, RingHash };
+enum class LoadBalancerType {
+  RoundRobin,
+  LeastRequest,
+  Random,
+  RingHash,
+  Maglev,
+  OriginalDst,
+  DynamicForwardProxy
+};
+
+/**
+ * Hash function used by the ring hash load balancer to place hosts on the ring.
+ */
+enum class RingHashFunction { StdHash, XxHash64 };
+
+/**
+ * Subset load balancing configuration of a cluster.
+ */
+class LbSubsetInfo {
+public:
+  /**
+   * What to do when a request's metadata match criteria does not select any subset.
+   */
+  enum class FallbackPolicy { NoFallback, AnyEndpoint };
+
+  virtual ~LbSubsetInfo() {}
+
+  /**
+   * @return bool whether the cluster partitions its hosts into subsets.
+   */
+  virtual bool isEnabled() const PURE;
+
+  /**
+   * @return FallbackPolicy the fallback policy for requests that match no subset.
+   */
+  virtual FallbackPolicy fallbackPolicy() const PURE;
+
+  /**
+   * @return const std::vector<std::set<std::string>>& the metadata key sets the hosts are indexed
+   *         by. A subset is created for each distinct combination of values of a key set.
+   */
+  virtual const std::vector<std::set<std::string>>& subsetKeys() const PURE;
+};
 
 } // Upstream
 } // Envoy
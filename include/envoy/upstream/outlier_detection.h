@@ -61,6 +61,21 @@ public:
    *         or the cluster did not have enough hosts to run through success rate outlier ejection.
    */
   virtual double successRate() const PURE;
+
+  /**
+   * @return the peak EWMA of the response times added for the host, in milliseconds. Response
+   *         times above the average take effect immediately while lower ones decay it gradually.
+   *         0 means that no response times have been added.
+   */
+  virtual double responseTimeEwma() const PURE;
+
+  /**
+   * @return the 99th percentile response time of the host in the last calculated interval, in
+   *         milliseconds. -1 means that response times are not being tracked, the host did not
+   *         have enough request volume, or the cluster did not have enough hosts to run through
+   *         latency outlier ejection.
+   */
+  virtual double responseTimeP99() const PURE;
 };
 
 typedef std::unique_ptr<DetectorHostSink> DetectorHostSinkPtr;
@@ -99,11 +114,19 @@ public:
    *         proceed with success rate based outlier ejection.
    */
   virtual double successRateEjectionThreshold() const PURE;
+
+  /**
+   * Returns the 99th percentile response time threshold used in the last interval. Hosts with a
+   * higher 99th percentile response time are ejected.
+   * @return the threshold in milliseconds, or -1 if there were not enough hosts with enough
+   *         request volume to proceed with latency based outlier ejection.
+   */
+  virtual double latencyEjectionThreshold() const PURE;
 };
 
 typedef std::shared_ptr<Detector> DetectorSharedPtr;
 
-enum class EjectionType { Consecutive5xx, SuccessRate };
+enum class EjectionType { Consecutive5xx, SuccessRate, Latency };
 
 /**
  * Sink for outlier detection event logs.
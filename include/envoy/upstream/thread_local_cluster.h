@@ -1,8 +1,22 @@
 #pragma once
 
+#include <cstdint>
+
+#include "envoy/common/pure.h"
+#include "envoy/http/conn_pool.h"
+#include "envoy/upstream/load_balancer.h"
+#include "envoy/upstream/resource_manager.h"
+#include "envoy/upstream/upstream.h"
+
 namespace Envoy {
 namespace Upstream {
 
+/**
+ * An interned cluster name. IDs are handed out by ClusterManager::clusterId() and are never reused,
+ * so an ID that is resolved at config load time stays valid across cluster updates and removals.
+ */
+typedef uint32_t ClusterId;
+
 /**
  * A thread local cluster instance that can be used for direct load balancing and host set
  * interactions. In general, an instance of ThreadLocalCluster can only be safely used in the
@@ -29,6 +43,15 @@ public:
    * @return LoadBalancer& the backing load balancer.
    */
   virtual LoadBalancer& loadBalancer() PURE;
+
+  /**
+   * Allocate a load balanced HTTP connection pool for the cluster. This is the same as
+   * ClusterManager::httpConnPoolForCluster() without looking up the cluster again.
+   * @return Http::ConnectionPool::Instance* a connection pool or nullptr if there are no healthy
+   *         hosts in the cluster.
+   */
+  virtual Http::ConnectionPool::Instance* connPool(ResourcePriority priority,
+                                                   LoadBalancerContext* context) PURE;
 };
 
 } // Upstream
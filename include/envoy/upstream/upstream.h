@@ -6,11 +6,15 @@
 #include <list>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "envoy/common/optional.h"
+#include "envoy/grpc/method_stats.h"
 #include "envoy/http/codec.h"
+#include "envoy/http/codes.h"
 #include "envoy/network/connection.h"
+#include "envoy/network/dns.h"
 #include "envoy/ssl/context.h"
 #include "envoy/upstream/load_balancer_type.h"
 #include "envoy/upstream/outlier_detection.h"
@@ -94,10 +98,31 @@ public:
    * Set the current load balancing weight of the host, in the range 1-100.
    */
   virtual void weight(uint32_t new_weight) PURE;
+
+  /**
+   * @return the number of requests currently active on the host. Unlike the rq_active gauge this
+   *         lives in a cache line of its own, so load balancers can read it on every pick.
+   */
+  virtual uint64_t activeRequests() const PURE;
+
+  /**
+   * Record that a request has started on the host.
+   */
+  virtual void incActiveRequests() const PURE;
+
+  /**
+   * Record that a request on the host has completed.
+   */
+  virtual void decActiveRequests() const PURE;
 };
 
 typedef std::shared_ptr<const Host> HostConstSharedPtr;
 
+typedef std::shared_ptr<std::vector<HostSharedPtr>> HostVectorSharedPtr;
+typedef std::shared_ptr<const std::vector<HostSharedPtr>> HostVectorConstSharedPtr;
+typedef std::shared_ptr<std::vector<std::vector<HostSharedPtr>>> HostListsSharedPtr;
+typedef std::shared_ptr<const std::vector<std::vector<HostSharedPtr>>> HostListsConstSharedPtr;
+
 /**
  * Base host set interface. This is used both for clusters, as well as per thread/worker host sets
  * used during routing/forwarding.
@@ -146,6 +171,29 @@ public:
    * @return same as hostsPerZone but only contains healthy hosts.
    */
   virtual const std::vector<std::vector<HostSharedPtr>>& healthyHostsPerZone() const PURE;
+
+  /**
+   * The following return the same host lists as above, but as shared immutable snapshots. A
+   * snapshot is never modified once it has been published; membership changes replace it with a
+   * new one. This allows the lists to be handed to other threads without copying them.
+   * @return the shared snapshot of hosts().
+   */
+  virtual HostVectorConstSharedPtr hostsPtr() const PURE;
+
+  /**
+   * @return the shared snapshot of healthyHosts().
+   */
+  virtual HostVectorConstSharedPtr healthyHostsPtr() const PURE;
+
+  /**
+   * @return the shared snapshot of hostsPerZone().
+   */
+  virtual HostListsConstSharedPtr hostsPerZonePtr() const PURE;
+
+  /**
+   * @return the shared snapshot of healthyHostsPerZone().
+   */
+  virtual HostListsConstSharedPtr healthyHostsPerZonePtr() const PURE;
 };
 
 /**
@@ -155,7 +203,13 @@ public:
 #define ALL_CLUSTER_STATS(COUNTER, GAUGE, TIMER)                                                   \
   COUNTER(lb_healthy_panic)                                                                        \
   COUNTER(lb_local_cluster_not_ok)                                                                 \
+  COUNTER(lb_priority_failover)                                                                    \
   COUNTER(lb_recalculate_zone_structures)                                                          \
+  GAUGE  (lb_subsets_active)                                                                       \
+  COUNTER(lb_subsets_created)                                                                      \
+  COUNTER(lb_subsets_removed)                                                                      \
+  COUNTER(lb_subsets_selected)                                                                     \
+  COUNTER(lb_subsets_fallback)                                                                     \
   COUNTER(lb_zone_cluster_too_small)                                                               \
   COUNTER(lb_zone_no_capacity_left)                                                                \
   COUNTER(lb_zone_number_differs)                                                                  \
@@ -184,10 +238,15 @@ public:
   GAUGE  (upstream_cx_tx_bytes_buffered)                                                           \
   COUNTER(upstream_cx_protocol_error)                                                              \
   COUNTER(upstream_cx_max_requests)                                                                \
+  COUNTER(upstream_cx_idle_timeout)                                                                \
   COUNTER(upstream_cx_none_healthy)                                                                \
+  COUNTER(upstream_cx_prefetch)                                                                    \
+  COUNTER(upstream_cx_pipeline_disabled)                                                           \
   COUNTER(upstream_rq_total)                                                                       \
   GAUGE  (upstream_rq_active)                                                                      \
   COUNTER(upstream_rq_pending_total)                                                               \
+  COUNTER(upstream_rq_prefetch_hit)                                                                \
+  COUNTER(upstream_rq_pipelined)                                                                   \
   COUNTER(upstream_rq_pending_overflow)                                                            \
   COUNTER(upstream_rq_pending_failure_eject)                                                       \
   GAUGE  (upstream_rq_pending_active)                                                              \
@@ -200,6 +259,15 @@ public:
   COUNTER(upstream_rq_retry)                                                                       \
   COUNTER(upstream_rq_retry_success)                                                               \
   COUNTER(upstream_rq_retry_overflow)                                                              \
+  COUNTER(upstream_rq_retry_budget_overflow)                                                       \
+  COUNTER(upstream_rq_hedge)                                                                       \
+  COUNTER(upstream_rq_hedge_win)                                                                   \
+  COUNTER(upstream_rq_hedge_overflow)                                                              \
+  COUNTER(upstream_rq_shadow_dropped)                                                              \
+  COUNTER(upstream_flow_control_paused_reading_total)                                              \
+  COUNTER(upstream_flow_control_resumed_reading_total)                                             \
+  COUNTER(upstream_flow_control_backed_up_total)                                                   \
+  COUNTER(upstream_flow_control_drained_total)                                                     \
   GAUGE  (max_host_weight)                                                                         \
   COUNTER(membership_change)                                                                       \
   GAUGE  (membership_healthy)                                                                      \
@@ -249,11 +317,46 @@ public:
    */
   virtual const Http::Http2Settings& http2Settings() const PURE;
 
+  /**
+   * @return uint32_t the maximum number of requests that an HTTP/1.1 connection pool has in flight
+   *         on each connection. Requests beyond the first are pipelined behind the ones already
+   *         sent. 1 disables pipelining.
+   */
+  virtual uint32_t http1PipelineDepth() const PURE;
+
   /**
    * @return the type of load balancing that the cluster should use.
    */
   virtual LoadBalancerType lbType() const PURE;
 
+  /**
+   * @return const LbSubsetInfo& the subset load balancing configuration of the cluster.
+   */
+  virtual const LbSubsetInfo& lbSubsetInfo() const PURE;
+
+  /**
+   * @return RingHashFunction the hash function the ring hash load balancer places hosts with.
+   */
+  virtual RingHashFunction ringHashFunction() const PURE;
+
+  /**
+   * @return std::chrono::milliseconds how often the original destination and dynamic forward
+   *         proxy load balancers remove hosts that have not been used since the previous cleanup.
+   */
+  virtual std::chrono::milliseconds hostCleanupInterval() const PURE;
+
+  /**
+   * @return Network::DnsLookupFamily the address families DNS names of the cluster's hosts are
+   *         resolved to.
+   */
+  virtual Network::DnsLookupFamily dnsLookupFamily() const PURE;
+
+  /**
+   * @return the configured weights of the localities (zones) of the cluster's hosts. Localities
+   *         without a configured weight have a weight of 1. Empty if no weights are configured.
+   */
+  virtual const std::unordered_map<std::string, uint32_t>& localityWeights() const PURE;
+
   /**
    * @return Whether the cluster is currently in maintenance mode and should not be routed to.
    *         Different filters may handle this situation in different ways. The implementation
@@ -269,11 +372,41 @@ public:
    */
   virtual uint64_t maxRequestsPerConnection() const PURE;
 
+  /**
+   * @return uint32_t the percentage by which the connection pools lower the maximum number of
+   *         requests of each connection, chosen at random for each connection, so that the
+   *         connections of a pool do not all reach the maximum and reconnect at the same time.
+   */
+  virtual uint32_t maxRequestsPerConnectionJitterPercent() const PURE;
+
+  /**
+   * @return const Optional<std::chrono::milliseconds>& how long an upstream connection may be
+   *         idle, without any active requests, before the connection pool closes it. If not set
+   *         idle connections are kept until the host closes them.
+   */
+  virtual const Optional<std::chrono::milliseconds>& idleTimeout() const PURE;
+
+  /**
+   * @return const std::string& the key under which the cluster shares connection pools with other
+   *         clusters, or empty if it does not share them. Hosts of clusters with the same key and
+   *         the same address use the same connection pools on each worker. The key covers the
+   *         settings that decide which connections the pools create and how they use them: the
+   *         SSL context configuration, the protocol and the HTTP/1.1 pipelining depth.
+   */
+  virtual const std::string& connPoolSharingKey() const PURE;
+
   /**
    * @return the human readable name of the cluster.
    */
   virtual const std::string& name() const PURE;
 
+  /**
+   * @return double the number of connections that a connection pool keeps open for each request
+   *         that is active or pending, so that bursts find connections that are already
+   *         established. 1.0 indicates that connections are only opened on demand.
+   */
+  virtual double prefetchRatio() const PURE;
+
   /**
    * @return ResourceManager& the resource manager to use by proxy agents for for this cluster (at
    *         a particular priority).
@@ -285,6 +418,12 @@ public:
    */
   virtual Ssl::ClientContext* sslContext() const PURE;
 
+  /**
+   * @return const Network::SocketOptionsConstSharedPtr& the options to apply to the sockets of
+   *         connections to the cluster, or nullptr to keep the defaults.
+   */
+  virtual const Network::SocketOptionsConstSharedPtr& socketOptions() const PURE;
+
   /**
    * @return ClusterStats& strongly named stats for this cluster.
    */
@@ -295,6 +434,16 @@ public:
    *         stats that will be freed when the cluster is removed.
    */
   virtual Stats::Scope& statsScope() const PURE;
+
+  /**
+   * @return the response code stats of the cluster. They must be charged to statsScope().
+   */
+  virtual Http::CodeStats& codeStats() const PURE;
+
+  /**
+   * @return the per method gRPC stats of the cluster. They must be charged to statsScope().
+   */
+  virtual Grpc::MethodStatsTable& grpcMethodStats() const PURE;
 };
 
 typedef std::shared_ptr<const ClusterInfo> ClusterInfoConstSharedPtr;
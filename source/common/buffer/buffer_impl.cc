@@ -1,108 +1,555 @@
 #include "common/buffer/buffer_impl.h"
 
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
+#include <new>
 #include <string>
 
 #include "common/common/assert.h"
-
-#include "event2/buffer.h"
+#include "common/memory/accounting.h"
 
 namespace Envoy {
 namespace Buffer {
 
-// RawSlice is the same structure as evbuffer_iovec. This was put into place to avoid leaking
-// libevent into most code since we will likely replace evbuffer with our own implementation at
-// some point. However, we can avoid a bunch of copies since the structure is the same.
-static_assert(sizeof(RawSlice) == sizeof(evbuffer_iovec), "RawSlice != evbuffer_iovec");
-static_assert(offsetof(RawSlice, mem_) == offsetof(evbuffer_iovec, iov_base),
-              "RawSlice != evbuffer_iovec");
-static_assert(offsetof(RawSlice, len_) == offsetof(evbuffer_iovec, iov_len),
-              "RawSlice != evbuffer_iovec");
+// RawSlice is the same structure as iovec. This allows slices to be handed directly to readv() and
+// writev() without any copying.
+static_assert(sizeof(RawSlice) == sizeof(iovec), "RawSlice != iovec");
+static_assert(offsetof(RawSlice, mem_) == offsetof(iovec, iov_base), "RawSlice != iovec");
+static_assert(offsetof(RawSlice, len_) == offsetof(iovec, iov_len), "RawSlice != iovec");
+
+namespace {
+// Slices smaller than this are copied rather than moved when moving data between buffers. This
+// keeps buffers that are built up by many small moves (e.g. codec output) from having a large
+// number of mostly empty slices.
+const uint64_t CopyThreshold = 512;
+
+// The maximum number of slices handed to writev() in a single call.
+const uint64_t MaxWriteSlices = 16;
+
+// Bounds the number of bytes written by a single write() call so that the result fits an int.
+// Sockets fill up long before this.
+const int MaxBytesPerWrite = 1 << 30;
+
+// The read path reserves at most this many slices for readv().
+const uint64_t MaxReadSlices = 2;
+
+const uint64_t PageSize = 4096;
+} // namespace
+
+void Slice::drain(uint64_t size) {
+  ASSERT(size <= dataSize());
+  data_ += size;
+}
+
+void Slice::truncate(uint64_t size) {
+  ASSERT(size <= dataSize());
+  const bool full = reservable_ == capacity_;
+  reservable_ = data_ + size;
+  if (full) {
+    capacity_ = reservable_;
+  }
+}
+
+uint64_t Slice::append(const void* data, uint64_t size) {
+  uint64_t copy_size = std::min(size, reservableSize());
+  memcpy(reservableStart(), data, copy_size);
+  reservable_ += copy_size;
+  return copy_size;
+}
+
+bool Slice::commit(const void* mem, uint64_t size) {
+  if (mem != base_ + reservable_ || size > reservableSize()) {
+    return false;
+  }
+
+  reservable_ += size;
+  return true;
+}
+
+void Slice::setAccount(const MemoryAccountSharedPtr& account) {
+  const uint64_t bytes = accountableSize();
+  if (account == account_ || bytes == 0) {
+    return;
+  }
 
-void OwnedImpl::add(const void* data, uint64_t size) { evbuffer_add(buffer_.get(), data, size); }
+  account->charge(bytes);
+  if (account_) {
+    account_->credit(charged_bytes_);
+  }
+  account_ = account;
+  charged_bytes_ = bytes;
+}
 
-void OwnedImpl::add(const std::string& data) {
-  evbuffer_add(buffer_.get(), data.c_str(), data.size());
+uint64_t OwnedSlice::sliceSize(uint64_t data_size) {
+  uint64_t total_size = sizeof(OwnedSlice) + data_size;
+  return (total_size + PageSize - 1) & ~(PageSize - 1);
 }
 
+SlicePtr OwnedSlice::create(uint64_t capacity) {
+  uint64_t slice_size = sliceSize(capacity);
+  Memory::AccountingScope accounting(Memory::Subsystem::Buffer);
+  void* mem = ::operator new(slice_size);
+  return SlicePtr(new (mem) OwnedSlice(slice_size - sizeof(OwnedSlice)));
+}
+
+void OwnedSlice::operator delete(void* mem) {
+  Memory::AccountingScope accounting(Memory::Subsystem::Buffer);
+  ::operator delete(mem);
+}
+
+SlicePtr OwnedSlice::create(const void* data, uint64_t size) {
+  SlicePtr slice = create(size);
+  slice->append(data, size);
+  return slice;
+}
+
+void MemoryAccountImpl::charge(uint64_t bytes) {
+  const uint64_t balance = balance_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  if (balance > peak_balance_.load(std::memory_order_relaxed)) {
+    peak_balance_.store(balance, std::memory_order_relaxed);
+  }
+  if (parent_) {
+    parent_->charge(bytes);
+  }
+}
+
+void MemoryAccountImpl::credit(uint64_t bytes) {
+  ASSERT(bytes <= balance());
+  balance_.fetch_sub(bytes, std::memory_order_relaxed);
+  if (parent_) {
+    parent_->credit(bytes);
+  }
+}
+
+void SliceDeque::emplace_back(SlicePtr&& slice) {
+  if (size_ == capacity_) {
+    growRing();
+  }
+  ring_[internalIndex(size_)] = std::move(slice);
+  size_++;
+}
+
+void SliceDeque::emplace_front(SlicePtr&& slice) {
+  if (size_ == capacity_) {
+    growRing();
+  }
+  start_ = (start_ == 0) ? capacity_ - 1 : start_ - 1;
+  ring_[start_] = std::move(slice);
+  size_++;
+}
+
+void SliceDeque::pop_back() {
+  ASSERT(!empty());
+  ring_[internalIndex(size_ - 1)].reset();
+  size_--;
+}
+
+void SliceDeque::pop_front() {
+  ASSERT(!empty());
+  ring_[start_].reset();
+  start_++;
+  if (start_ == capacity_) {
+    start_ = 0;
+  }
+  size_--;
+}
+
+void SliceDeque::growRing() {
+  size_t new_capacity = capacity_ * 2;
+  Memory::AccountingScope accounting(Memory::Subsystem::Buffer);
+  std::unique_ptr<SlicePtr[]> new_ring(new SlicePtr[new_capacity]);
+  for (size_t i = 0; i < size_; i++) {
+    new_ring[i] = std::move(ring_[internalIndex(i)]);
+  }
+  external_ring_ = std::move(new_ring);
+  ring_ = external_ring_.get();
+  start_ = 0;
+  capacity_ = new_capacity;
+}
+
+void OwnedImpl::add(const void* data, uint64_t size) {
+  const uint8_t* src = static_cast<const uint8_t*>(data);
+  length_ += size;
+  if (!slices_.empty()) {
+    uint64_t copied = slices_.back()->append(src, size);
+    src += copied;
+    size -= copied;
+  }
+
+  if (size > 0) {
+    slices_.emplace_back(OwnedSlice::create(src, size));
+    chargeSlice(*slices_.back());
+  }
+}
+
+void OwnedImpl::add(const std::string& data) { add(data.c_str(), data.size()); }
+
 void OwnedImpl::add(const Instance& data) {
-  uint64_t num_slices = data.getRawSlices(nullptr, 0);
-  RawSlice slices[num_slices];
-  data.getRawSlices(slices, num_slices);
-  for (RawSlice& slice : slices) {
-    add(slice.mem_, slice.len_);
+  // See move() below for why we do the static cast. Slices that can be shared (e.g. data that was
+  // spilled to disk) are referenced rather than copied.
+  const OwnedImpl& other = static_cast<const OwnedImpl&>(data);
+  for (size_t i = 0; i < other.slices_.size(); i++) {
+    const SlicePtr& slice = other.slices_[i];
+    SlicePtr shared = slice->share();
+    if (shared) {
+      length_ += shared->dataSize();
+      slices_.emplace_back(std::move(shared));
+      chargeSlice(*slices_.back());
+    } else {
+      add(slice->data(), slice->dataSize());
+    }
   }
 }
 
+void OwnedImpl::addBufferFragment(BufferFragment& fragment) {
+  length_ += fragment.size();
+  slices_.emplace_back(SlicePtr{new UnownedSlice(fragment)});
+}
+
 void OwnedImpl::commit(RawSlice* iovecs, uint64_t num_iovecs) {
-  int rc =
-      evbuffer_commit_space(buffer_.get(), reinterpret_cast<evbuffer_iovec*>(iovecs), num_iovecs);
-  ASSERT(rc == 0);
-  UNREFERENCED_PARAMETER(rc);
+  if (num_iovecs > 0 && !slices_.empty()) {
+    // Reserved memory always lives in the last few slices of the buffer. Find the slice that owns
+    // the first reservation by scanning back from the end, then commit forward from there.
+    size_t slice_index = slices_.size() - 1;
+    while (slice_index > 0 && slices_[slice_index]->reservableStart() != iovecs[0].mem_) {
+      slice_index--;
+    }
+
+    for (uint64_t i = 0; i < num_iovecs && slice_index < slices_.size(); i++, slice_index++) {
+      bool committed = slices_[slice_index]->commit(iovecs[i].mem_, iovecs[i].len_);
+      ASSERT(committed);
+      UNREFERENCED_PARAMETER(committed);
+      length_ += iovecs[i].len_;
+    }
+  }
+
+  // Free the slices that were allocated for the reservation but received no data, so that a
+  // connection whose read found nothing does not hold on to the space until its next read.
+  while (!slices_.empty() && slices_.back()->dataSize() == 0) {
+    slices_.pop_back();
+  }
 }
 
 void OwnedImpl::drain(uint64_t size) {
-  ASSERT(size <= length());
-  int rc = evbuffer_drain(buffer_.get(), size);
-  ASSERT(rc == 0);
-  UNREFERENCED_PARAMETER(rc);
+  ASSERT(size <= length_);
+  length_ -= size;
+  while (size > 0) {
+    uint64_t slice_size = slices_.front()->dataSize();
+    if (slice_size <= size) {
+      slices_.pop_front();
+      size -= slice_size;
+    } else {
+      slices_.front()->drain(size);
+      size = 0;
+    }
+  }
 }
 
 uint64_t OwnedImpl::getRawSlices(RawSlice* out, uint64_t out_size) const {
-  return evbuffer_peek(buffer_.get(), -1, nullptr, reinterpret_cast<evbuffer_iovec*>(out),
-                       out_size);
+  uint64_t num_slices = 0;
+  for (size_t i = 0; i < slices_.size(); i++) {
+    const SlicePtr& slice = slices_[i];
+    if (slice->dataSize() == 0) {
+      continue;
+    }
+
+    if (num_slices < out_size) {
+      out[num_slices].mem_ = const_cast<uint8_t*>(slice->data());
+      out[num_slices].len_ = slice->dataSize();
+    }
+    num_slices++;
+  }
+
+  return num_slices;
 }
 
-uint64_t OwnedImpl::length() const { return evbuffer_get_length(buffer_.get()); }
+uint64_t OwnedImpl::length() const { return length_; }
 
 void* OwnedImpl::linearize(uint32_t size) {
-  ASSERT(size <= length());
-  return evbuffer_pullup(buffer_.get(), size);
+  ASSERT(size <= length_);
+  if (slices_.empty()) {
+    return nullptr;
+  }
+
+  if (slices_.front()->dataSize() < size) {
+    SlicePtr new_slice = OwnedSlice::create(size);
+    uint64_t remaining = size;
+    while (remaining > 0) {
+      SlicePtr& slice = slices_.front();
+      uint64_t copy_size = std::min(remaining, slice->dataSize());
+      new_slice->append(slice->data(), copy_size);
+      remaining -= copy_size;
+      if (copy_size == slice->dataSize()) {
+        slices_.pop_front();
+      } else {
+        slice->drain(copy_size);
+      }
+    }
+    slices_.emplace_front(std::move(new_slice));
+    chargeSlice(*slices_.front());
+  }
+
+  return slices_.front()->data();
+}
+
+void OwnedImpl::coalesceOrAddSlice(SlicePtr&& slice) {
+  const uint64_t slice_size = slice->dataSize();
+  if (slice_size == 0) {
+    return;
+  }
+
+  length_ += slice_size;
+  if (slice_size <= CopyThreshold && !slices_.empty() &&
+      slices_.back()->reservableSize() >= slice_size) {
+    slices_.back()->append(slice->data(), slice_size);
+  } else {
+    slices_.emplace_back(std::move(slice));
+    chargeSlice(*slices_.back());
+  }
 }
 
 void OwnedImpl::move(Instance& rhs) {
   // We do the static cast here because in practice we only have one buffer implementation right
-  // now and this is safe. Using the evbuffer move routines require having access to both evbuffers.
-  // This is a reasonable compromise in a high performance path where we want to maintain an
-  // abstraction in case we get rid of evbuffer later.
-  int rc = evbuffer_add_buffer(buffer_.get(), static_cast<OwnedImpl&>(rhs).buffer_.get());
-  ASSERT(rc == 0);
-  UNREFERENCED_PARAMETER(rc);
+  // now and this is safe. This lets us move slice ownership between buffers rather than copying
+  // the data.
+  OwnedImpl& other = static_cast<OwnedImpl&>(rhs);
+  while (!other.slices_.empty()) {
+    coalesceOrAddSlice(std::move(other.slices_.front()));
+    other.slices_.pop_front();
+  }
+  other.length_ = 0;
 }
 
 void OwnedImpl::move(Instance& rhs, uint64_t length) {
   // See move() above for why we do the static cast.
-  int rc =
-      evbuffer_remove_buffer(static_cast<OwnedImpl&>(rhs).buffer_.get(), buffer_.get(), length);
-  ASSERT(static_cast<uint64_t>(rc) == length);
-  UNREFERENCED_PARAMETER(rc);
+  OwnedImpl& other = static_cast<OwnedImpl&>(rhs);
+  ASSERT(length <= other.length_);
+  while (length > 0) {
+    SlicePtr& slice = other.slices_.front();
+    const uint64_t slice_size = slice->dataSize();
+    if (slice_size <= length) {
+      other.length_ -= slice_size;
+      coalesceOrAddSlice(std::move(slice));
+      other.slices_.pop_front();
+      length -= slice_size;
+    } else {
+      // The slice is split. The slice itself moves here unless more of it stays behind, so that
+      // at most the smaller part is copied. Shareable slices are split without copying at all.
+      const uint64_t remainder = slice_size - length;
+      SlicePtr rest = slice->share();
+      if (rest) {
+        rest->drain(length);
+      } else if (remainder < length) {
+        rest = OwnedSlice::create(slice->data() + length, remainder);
+      }
+
+      if (rest) {
+        slice->truncate(length);
+        other.length_ -= slice_size;
+        coalesceOrAddSlice(std::move(slice));
+        other.slices_.pop_front();
+        other.length_ += remainder;
+        other.slices_.emplace_front(std::move(rest));
+        other.chargeSlice(*other.slices_.front());
+      } else {
+        add(slice->data(), length);
+        other.drain(length);
+      }
+      length = 0;
+    }
+  }
 }
 
 int OwnedImpl::read(int fd, uint64_t max_length) {
-  return evbuffer_read(buffer_.get(), fd, max_length);
+  if (max_length == 0) {
+    return 0;
+  }
+
+  RawSlice slices[MaxReadSlices];
+  uint64_t num_slices = reserve(max_length, slices, MaxReadSlices);
+  ssize_t rc = ::readv(fd, reinterpret_cast<const iovec*>(slices), num_slices);
+  if (rc <= 0) {
+    return rc;
+  }
+
+  uint64_t bytes_to_commit = rc;
+  uint64_t num_slices_to_commit = 0;
+  for (uint64_t i = 0; i < num_slices && bytes_to_commit > 0; i++) {
+    slices[i].len_ = std::min(slices[i].len_, bytes_to_commit);
+    bytes_to_commit -= slices[i].len_;
+    num_slices_to_commit++;
+  }
+  commit(slices, num_slices_to_commit);
+  return rc;
 }
 
 uint64_t OwnedImpl::reserve(uint64_t length, RawSlice* iovecs, uint64_t num_iovecs) {
-  uint64_t ret = evbuffer_reserve_space(buffer_.get(), length,
-                                        reinterpret_cast<evbuffer_iovec*>(iovecs), num_iovecs);
-  ASSERT(ret >= 1);
-  return ret;
+  if (num_iovecs == 0 || length == 0) {
+    return 0;
+  }
+
+  uint64_t bytes_remaining = length;
+  uint64_t num_slices_used = 0;
+
+  // Use the tail of the last slice if it can either satisfy the whole reservation or if the caller
+  // allows the reservation to be split.
+  if (!slices_.empty()) {
+    Slice& last = *slices_.back();
+    uint64_t reservable = last.reservableSize();
+    if (reservable > 0 && (reservable >= length || num_iovecs > 1)) {
+      iovecs[0].mem_ = last.reservableStart();
+      iovecs[0].len_ = reservable;
+      bytes_remaining -= std::min(reservable, bytes_remaining);
+      num_slices_used++;
+    }
+  }
+
+  // Any remaining space comes from a single new slice which is large enough for the rest of the
+  // reservation.
+  if (bytes_remaining > 0) {
+    ASSERT(num_slices_used < num_iovecs);
+    slices_.emplace_back(OwnedSlice::create(bytes_remaining));
+    chargeSlice(*slices_.back());
+    Slice& slice = *slices_.back();
+    iovecs[num_slices_used].mem_ = slice.reservableStart();
+    iovecs[num_slices_used].len_ = slice.reservableSize();
+    num_slices_used++;
+  }
+
+  return num_slices_used;
+}
+
+bool OwnedImpl::matchesAt(size_t slice_index, uint64_t offset, const uint8_t* data,
+                          uint64_t size) const {
+  while (size > 0 && slice_index < slices_.size()) {
+    const Slice& slice = *slices_[slice_index];
+    uint64_t compare_size = std::min(size, slice.dataSize() - offset);
+    if (memcmp(slice.data() + offset, data, compare_size) != 0) {
+      return false;
+    }
+
+    data += compare_size;
+    size -= compare_size;
+    offset = 0;
+    slice_index++;
+  }
+
+  return size == 0;
 }
 
 ssize_t OwnedImpl::search(const void* data, uint64_t size, size_t start) const {
-  evbuffer_ptr start_ptr;
-  if (-1 == evbuffer_ptr_set(buffer_.get(), &start_ptr, start, EVBUFFER_PTR_SET)) {
+  size_t slice_index = 0;
+  uint64_t slice_start = 0;
+  return searchFrom(static_cast<const uint8_t*>(data), size, start, slice_index, slice_start);
+}
+
+ssize_t OwnedImpl::searchSequence(const std::vector<std::vector<uint8_t>>& patterns,
+                                  size_t start) const {
+  // Every pattern starts after the previous match, so the scan never has to go back to an earlier
+  // slice.
+  size_t slice_index = 0;
+  uint64_t slice_start = 0;
+  for (const std::vector<uint8_t>& pattern : patterns) {
+    ssize_t index = searchFrom(pattern.data(), pattern.size(), start, slice_index, slice_start);
+    if (index == -1) {
+      return -1;
+    }
+
+    start = index + pattern.size();
+  }
+
+  return start;
+}
+
+ssize_t OwnedImpl::searchFrom(const uint8_t* needle, uint64_t size, size_t start,
+                              size_t& slice_index, uint64_t& slice_start) const {
+  if (start + size > length_) {
     return -1;
   }
 
-  evbuffer_ptr result_ptr =
-      evbuffer_search(buffer_.get(), static_cast<const char*>(data), size, &start_ptr);
-  return result_ptr.pos;
+  if (size == 0) {
+    return start;
+  }
+
+  for (; slice_index < slices_.size(); slice_index++) {
+    const Slice& slice = *slices_[slice_index];
+    const uint64_t slice_size = slice.dataSize();
+    if (start >= slice_start + slice_size) {
+      slice_start += slice_size;
+      continue;
+    }
+
+    // Use memchr() to skip to candidate positions for the first byte of the pattern, then compare
+    // the rest of the pattern which may span into subsequent slices.
+    uint64_t offset = start > slice_start ? start - slice_start : 0;
+    while (offset < slice_size) {
+      const uint8_t* candidate = static_cast<const uint8_t*>(
+          memchr(slice.data() + offset, needle[0], slice_size - offset));
+      if (candidate == nullptr) {
+        break;
+      }
+
+      offset = candidate - slice.data();
+      if (slice_start + offset + size > length_) {
+        return -1;
+      }
+
+      if (matchesAt(slice_index, offset, needle, size)) {
+        return slice_start + offset;
+      }
+      offset++;
+    }
+
+    slice_start += slice_size;
+  }
+
+  return -1;
+}
+
+void OwnedImpl::setAccount(MemoryAccountSharedPtr account) {
+  account_ = account;
+  for (size_t i = 0; i < slices_.size(); i++) {
+    chargeSlice(*slices_[i]);
+  }
 }
 
-int OwnedImpl::write(int fd) { return evbuffer_write(buffer_.get(), fd); }
+int OwnedImpl::write(int fd) {
+  int bytes_written = 0;
+  do {
+    RawSlice slices[MaxWriteSlices];
+    uint64_t num_slices = std::min(getRawSlices(slices, MaxWriteSlices), MaxWriteSlices);
+    if (num_slices == 0) {
+      break;
+    }
+
+    uint64_t bytes_offered = 0;
+    for (uint64_t i = 0; i < num_slices; i++) {
+      bytes_offered += slices[i].len_;
+    }
+
+    ssize_t rc = ::writev(fd, reinterpret_cast<const iovec*>(slices), num_slices);
+    if (rc < 0) {
+      // Report the error on the next call if some data already made it out.
+      return bytes_written > 0 ? bytes_written : rc;
+    }
+
+    drain(rc);
+    bytes_written += rc;
+
+    // A short write means the descriptor is full, so another writev() would just fail with EAGAIN.
+    if (static_cast<uint64_t>(rc) < bytes_offered) {
+      break;
+    }
+  } while (bytes_written < MaxBytesPerWrite);
+
+  return bytes_written;
+}
 
-OwnedImpl::OwnedImpl() : buffer_(evbuffer_new()) {}
+OwnedImpl::OwnedImpl() {}
 
 OwnedImpl::OwnedImpl(const std::string& data) : OwnedImpl() { add(data); }
 
@@ -1,17 +1,276 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "envoy/buffer/buffer.h"
 
-#include "common/event/libevent.h"
+#include "common/common/non_copyable.h"
 
 namespace Envoy {
 namespace Buffer {
 
 /**
- * Wraps an allocated and owned evbuffer.
+ * A contiguous chunk of buffer memory. The layout of a slice is:
+ *
+ *   |<- drained ->|<- data ->|<- reservable ->|
+ *   base_         base_ + data_               base_ + capacity_
+ *
+ * Data is appended into the reservable region and drained from the front. Once a slice has been
+ * fully drained it is released by the owning buffer.
+ */
+class Slice : NonCopyable {
+public:
+  virtual ~Slice() {
+    if (account_) {
+      account_->credit(charged_bytes_);
+    }
+  }
+
+  /**
+   * @return a pointer to the start of the readable data in the slice.
+   */
+  const uint8_t* data() const { return base_ + data_; }
+  uint8_t* data() { return base_ + data_; }
+
+  /**
+   * @return the number of readable bytes in the slice.
+   */
+  uint64_t dataSize() const { return reservable_ - data_; }
+
+  /**
+   * @return the number of bytes that can still be appended to the slice.
+   */
+  uint64_t reservableSize() const { return capacity_ - reservable_; }
+
+  /**
+   * @return a pointer to the start of the reservable region of the slice.
+   */
+  uint8_t* reservableStart() { return base_ + reservable_; }
+
+  /**
+   * Mark bytes at the front of the slice as consumed.
+   * @param size supplies the number of bytes to drain, which must be <= dataSize().
+   */
+  void drain(uint64_t size);
+
+  /**
+   * Drop readable data from the end of the slice. A slice without reservable space (e.g. one that
+   * references memory it does not own) does not gain any.
+   * @param size supplies the number of bytes to keep, which must be <= dataSize().
+   */
+  void truncate(uint64_t size);
+
+  /**
+   * Copy as much of the supplied data as fits into the reservable region of the slice.
+   * @param data supplies the data to copy.
+   * @param size supplies the length of the data.
+   * @return the number of bytes actually copied.
+   */
+  uint64_t append(const void* data, uint64_t size);
+
+  /**
+   * Commit previously reserved memory so that it becomes readable data.
+   * @param mem supplies the start of the reservation which must equal reservableStart().
+   * @param size supplies the number of bytes to commit, which must be <= reservableSize().
+   * @return true if the reservation belongs to this slice and was committed.
+   */
+  bool commit(const void* mem, uint64_t size);
+
+  /**
+   * @return a new slice that references the readable data of this slice without copying it, or
+   *         nullptr if the data cannot be shared and must be copied instead.
+   */
+  virtual std::unique_ptr<Slice> share() const { return nullptr; }
+
+  /**
+   * Charge the memory of the slice to an account. The charge moves over from the account that was
+   * charged before, if any, and is credited back when the slice is freed.
+   * @param account supplies the account to charge.
+   */
+  void setAccount(const MemoryAccountSharedPtr& account);
+
+protected:
+  Slice(uint8_t* base, uint64_t data, uint64_t reservable, uint64_t capacity)
+      : base_(base), data_(data), reservable_(reservable), capacity_(capacity) {}
+
+  /**
+   * @return the bytes of heap memory held by the slice. Slices that reference memory owned
+   *         elsewhere hold none and are never charged.
+   */
+  virtual uint64_t accountableSize() const { return 0; }
+
+  uint8_t* base_;
+  uint64_t data_;
+  uint64_t reservable_;
+  uint64_t capacity_;
+  MemoryAccountSharedPtr account_;
+  uint64_t charged_bytes_{};
+};
+
+typedef std::unique_ptr<Slice> SlicePtr;
+
+/**
+ * A slice that owns its memory. The storage is allocated in the same block as the slice header so
+ * that each slice costs a single allocation.
+ */
+class OwnedSlice : public Slice {
+public:
+  /**
+   * Create an empty slice with at least the requested capacity. The capacity is rounded up so that
+   * the slice header plus storage consumes a whole number of pages.
+   * @param capacity supplies the minimum number of bytes the slice must be able to hold.
+   */
+  static SlicePtr create(uint64_t capacity);
+
+  /**
+   * Create a slice holding a copy of the supplied data.
+   */
+  static SlicePtr create(const void* data, uint64_t size);
+
+  // Storage is allocated along with the header, so sized deallocation (which would pass
+  // sizeof(OwnedSlice)) must not be used.
+  static void operator delete(void* mem);
+
+protected:
+  // Slice
+  uint64_t accountableSize() const override { return sizeof(OwnedSlice) + capacity_; }
+
+private:
+  OwnedSlice(uint64_t capacity) : Slice(storage_, 0, 0, capacity) {}
+
+  static uint64_t sliceSize(uint64_t data_size);
+
+  uint8_t storage_[];
+};
+
+/**
+ * A slice that references externally owned memory supplied via a BufferFragment. The fragment is
+ * notified when the slice is released. Unowned slices are never appended to.
+ */
+class UnownedSlice : public Slice {
+public:
+  UnownedSlice(BufferFragment& fragment)
+      : Slice(static_cast<uint8_t*>(const_cast<void*>(fragment.data())), 0, fragment.size(),
+              fragment.size()),
+        fragment_(fragment) {}
+
+  ~UnownedSlice() { fragment_.done(); }
+
+private:
+  BufferFragment& fragment_;
+};
+
+/**
+ * A BufferFragment whose releasor is called when the buffer is done with the data. The releasor is
+ * typically used to free the data and/or the fragment itself.
+ */
+class BufferFragmentImpl : NonCopyable, public BufferFragment {
+public:
+  typedef std::function<void(const void*, size_t, const BufferFragmentImpl*)> Releasor;
+
+  /**
+   * @param data supplies the externally owned data.
+   * @param size supplies the size of the data.
+   * @param releasor supplies an optional callback invoked when the buffer is done with the data.
+   */
+  BufferFragmentImpl(const void* data, size_t size, Releasor releasor)
+      : data_(data), size_(size), releasor_(releasor) {}
+
+  // Buffer::BufferFragment
+  const void* data() const override { return data_; }
+  size_t size() const override { return size_; }
+  void done() override {
+    if (releasor_) {
+      releasor_(data_, size_, this);
+    }
+  }
+
+private:
+  const void* const data_;
+  const size_t size_;
+  const Releasor releasor_;
+};
+
+/**
+ * Memory account that also charges a parent account, so that the accounts of all connections on a
+ * worker roll up into the account of the worker. Charges happen on the thread that owns the
+ * buffers, while the balance may be read from any thread.
+ */
+class MemoryAccountImpl : NonCopyable, public MemoryAccount {
+public:
+  /**
+   * @param parent supplies the account that is charged along with this one, or nullptr.
+   */
+  explicit MemoryAccountImpl(MemoryAccountSharedPtr parent = nullptr) : parent_(parent) {}
+
+  /**
+   * @return uint64_t the highest balance the account has had.
+   */
+  uint64_t peakBalance() const { return peak_balance_.load(std::memory_order_relaxed); }
+
+  // Buffer::MemoryAccount
+  void charge(uint64_t bytes) override;
+  void credit(uint64_t bytes) override;
+  uint64_t balance() const override { return balance_.load(std::memory_order_relaxed); }
+
+private:
+  const MemoryAccountSharedPtr parent_;
+  std::atomic<uint64_t> balance_{};
+  std::atomic<uint64_t> peak_balance_{};
+};
+
+typedef std::shared_ptr<MemoryAccountImpl> MemoryAccountImplSharedPtr;
+
+/**
+ * A double ended queue of slices stored as a ring. A small number of slice pointers are stored
+ * inline so that the common case of a short buffer requires no allocation for the ring itself.
+ */
+class SliceDeque : NonCopyable {
+public:
+  SliceDeque() : ring_(inline_ring_), capacity_(InlineRingCapacity) {}
+
+  void emplace_back(SlicePtr&& slice);
+  void emplace_front(SlicePtr&& slice);
+  void pop_back();
+  void pop_front();
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+
+  SlicePtr& front() { return ring_[start_]; }
+  const SlicePtr& front() const { return ring_[start_]; }
+  SlicePtr& back() { return ring_[internalIndex(size_ - 1)]; }
+  const SlicePtr& back() const { return ring_[internalIndex(size_ - 1)]; }
+  SlicePtr& operator[](size_t i) { return ring_[internalIndex(i)]; }
+  const SlicePtr& operator[](size_t i) const { return ring_[internalIndex(i)]; }
+
+private:
+  static const size_t InlineRingCapacity = 8;
+
+  size_t internalIndex(size_t index) const {
+    size_t internal_index = start_ + index;
+    if (internal_index >= capacity_) {
+      internal_index -= capacity_;
+    }
+    return internal_index;
+  }
+
+  void growRing();
+
+  SlicePtr inline_ring_[InlineRingCapacity];
+  std::unique_ptr<SlicePtr[]> external_ring_;
+  SlicePtr* ring_;
+  size_t start_{0};
+  size_t size_{0};
+  size_t capacity_;
+};
+
+/**
+ * Native buffer implementation built from a ring of owned slices.
  */
 class OwnedImpl : public Instance {
 public:
@@ -24,6 +283,7 @@ public:
   void add(const void* data, uint64_t size) override;
   void add(const std::string& data) override;
   void add(const Instance& data) override;
+  void addBufferFragment(BufferFragment& fragment) override;
   void commit(RawSlice* iovecs, uint64_t num_iovecs) override;
   void drain(uint64_t size) override;
   uint64_t getRawSlices(RawSlice* out, uint64_t out_size) const override;
@@ -34,10 +294,54 @@ public:
   int read(int fd, uint64_t max_length) override;
   uint64_t reserve(uint64_t length, RawSlice* iovecs, uint64_t num_iovecs) override;
   ssize_t search(const void* data, uint64_t size, size_t start) const override;
+  ssize_t searchSequence(const std::vector<std::vector<uint8_t>>& patterns,
+                         size_t start) const override;
   int write(int fd) override;
 
-private:
-  Event::Libevent::BufferPtr buffer_;
+  /**
+   * Charge the memory of the buffer to an account. Slices that the buffer allocates or takes over
+   * from other buffers are charged from then on. Slices that move into a buffer without an account
+   * stay charged to the account they had.
+   * @param account supplies the account to charge.
+   */
+  void setAccount(MemoryAccountSharedPtr account);
+
+protected:
+  /**
+   * Charge a slice that was just added to the buffer to the account of the buffer, if any.
+   */
+  void chargeSlice(Slice& slice) {
+    if (account_) {
+      slice.setAccount(account_);
+    }
+  }
+
+  /**
+   * Append a slice to the buffer. Small slices are copied into the reservable space of the current
+   * last slice when possible so that repeated small moves do not fragment the buffer.
+   */
+  void coalesceOrAddSlice(SlicePtr&& slice);
+
+  /**
+   * Compare the supplied data against the buffer starting at the given slice and offset. The
+   * comparison may span multiple slices.
+   */
+  bool matchesAt(size_t slice_index, uint64_t offset, const uint8_t* data, uint64_t size) const;
+
+  /**
+   * Search for needle starting at the given index, skipping the slices before slice_index.
+   * @param slice_index supplies the slice to start scanning from. It is updated to the slice the
+   *        match starts in so that a following search can continue from there.
+   * @param slice_start supplies the index of the first byte of slice_index. It is updated along
+   *        with slice_index.
+   * @return the index where the match starts or -1 if there is no match.
+   */
+  ssize_t searchFrom(const uint8_t* needle, uint64_t size, size_t start, size_t& slice_index,
+                     uint64_t& slice_start) const;
+
+  SliceDeque slices_;
+  uint64_t length_{0};
+  MemoryAccountSharedPtr account_;
 };
 
 } // Buffer
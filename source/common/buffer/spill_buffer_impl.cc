@@ -0,0 +1,157 @@
+#include "common/buffer/spill_buffer_impl.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+#include "common/common/assert.h"
+
+namespace Envoy {
+namespace Buffer {
+
+MappedSlice::Mapping::~Mapping() { ::munmap(mem_, size_); }
+
+SlicePtr MappedSlice::create(int fd, uint64_t offset, uint64_t size) {
+  ASSERT(size > 0);
+  // Mappings must start on a page boundary, so map from the start of the page holding the region
+  // and skip the bytes in front of it.
+  static const uint64_t page_size = ::sysconf(_SC_PAGESIZE);
+  const uint64_t map_offset = offset & ~(page_size - 1);
+  const uint64_t skip = offset - map_offset;
+
+  // The mapping is private so that a consumer writing to the data in place never changes the file.
+  void* mem = ::mmap(nullptr, skip + size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, map_offset);
+  if (mem == MAP_FAILED) {
+    return nullptr;
+  }
+
+  MappingSharedPtr mapping(new Mapping{mem, skip + size});
+  return SlicePtr{new MappedSlice(mapping, skip, skip + size)};
+}
+
+SlicePtr MappedSlice::share() const {
+  return SlicePtr{new MappedSlice(mapping_, data_, reservable_)};
+}
+
+SpillBufferImpl::SpillBufferImpl(const std::string& directory, uint64_t memory_limit)
+    : directory_(directory), memory_limit_(memory_limit) {}
+
+SpillBufferImpl::~SpillBufferImpl() {
+  if (fd_ != -1) {
+    ::close(fd_);
+  }
+}
+
+void SpillBufferImpl::add(const void* data, uint64_t size) {
+  OwnedImpl::add(data, size);
+  maybeSpill();
+}
+
+void SpillBufferImpl::add(const std::string& data) {
+  OwnedImpl::add(data);
+  maybeSpill();
+}
+
+void SpillBufferImpl::add(const Instance& data) {
+  OwnedImpl::add(data);
+  maybeSpill();
+}
+
+void SpillBufferImpl::commit(RawSlice* iovecs, uint64_t num_iovecs) {
+  OwnedImpl::commit(iovecs, num_iovecs);
+  maybeSpill();
+}
+
+void SpillBufferImpl::move(Instance& rhs) {
+  OwnedImpl::move(rhs);
+  maybeSpill();
+}
+
+void SpillBufferImpl::move(Instance& rhs, uint64_t length) {
+  OwnedImpl::move(rhs, length);
+  maybeSpill();
+}
+
+int SpillBufferImpl::read(int fd, uint64_t max_length) {
+  int rc = OwnedImpl::read(fd, max_length);
+  maybeSpill();
+  return rc;
+}
+
+void SpillBufferImpl::maybeSpill() {
+  if (spill_failed_ || length_ < memory_limit_ + SpillChunkSize) {
+    return;
+  }
+
+  // Walk back over the in-memory slices at the end of the buffer, stopping at data that was
+  // already spilled or at the slice that holds the memory limit.
+  size_t first_slice = slices_.size();
+  uint64_t offset = length_;
+  while (first_slice > 0 &&
+         dynamic_cast<const MappedSlice*>(slices_[first_slice - 1].get()) == nullptr) {
+    const uint64_t slice_size = slices_[first_slice - 1]->dataSize();
+    if (offset - slice_size < memory_limit_) {
+      break;
+    }
+    offset -= slice_size;
+    first_slice--;
+  }
+
+  if (length_ - offset >= SpillChunkSize && !writeToFile(first_slice)) {
+    spill_failed_ = true;
+  }
+}
+
+bool SpillBufferImpl::openFile() {
+  std::string path = directory_ + "/envoy_spill.XXXXXX";
+  fd_ = ::mkstemp(&path[0]);
+  if (fd_ == -1) {
+    return false;
+  }
+
+  ::unlink(path.c_str());
+  return true;
+}
+
+bool SpillBufferImpl::writeToFile(size_t first_slice) {
+  if (fd_ == -1 && !openFile()) {
+    return false;
+  }
+
+  uint64_t size = 0;
+  for (size_t i = first_slice; i < slices_.size(); i++) {
+    const uint8_t* data = slices_[i]->data();
+    uint64_t remaining = slices_[i]->dataSize();
+    while (remaining > 0) {
+      ssize_t rc = ::pwrite(fd_, data, remaining, file_size_ + size);
+      if (rc <= 0) {
+        if (rc == -1 && errno == EINTR) {
+          continue;
+        }
+        return false;
+      }
+      data += rc;
+      remaining -= rc;
+      size += rc;
+    }
+  }
+
+  SlicePtr mapped = MappedSlice::create(fd_, file_size_, size);
+  if (!mapped) {
+    return false;
+  }
+
+  file_size_ += size;
+  while (slices_.size() > first_slice) {
+    slices_.pop_back();
+  }
+  slices_.emplace_back(std::move(mapped));
+  return true;
+}
+
+} // Buffer
+} // Envoy
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "common/buffer/buffer_impl.h"
+
+namespace Envoy {
+namespace Buffer {
+
+/**
+ * A slice backed by a private memory mapping of a region of a file. Shared slices reference the
+ * same mapping, which is unmapped once the last of them is released. The file descriptor is not
+ * needed after the mapping has been created.
+ */
+class MappedSlice : public Slice {
+public:
+  /**
+   * Map a region of a file.
+   * @param fd supplies the file to map.
+   * @param offset supplies the offset of the region in the file.
+   * @param size supplies the length of the region.
+   * @return the slice or nullptr if the region could not be mapped.
+   */
+  static SlicePtr create(int fd, uint64_t offset, uint64_t size);
+
+  // Buffer::Slice
+  SlicePtr share() const override;
+
+private:
+  struct Mapping {
+    ~Mapping();
+
+    void* mem_;
+    uint64_t size_;
+  };
+
+  typedef std::shared_ptr<const Mapping> MappingSharedPtr;
+
+  MappedSlice(MappingSharedPtr mapping, uint64_t data, uint64_t reservable)
+      : Slice(static_cast<uint8_t*>(mapping->mem_), data, reservable, reservable),
+        mapping_(mapping) {}
+
+  const MappingSharedPtr mapping_;
+};
+
+/**
+ * A buffer that keeps about the first memory_limit bytes of its data in memory and spills the
+ * rest to a temporary file, which is read back through memory mappings. The file is unlinked as
+ * soon as it is created so that it never outlives the process. Data is spilled in chunks of at
+ * least SpillChunkSize bytes to keep the number of mappings low, so a little more than
+ * memory_limit + SpillChunkSize bytes may be held in memory at a time.
+ *
+ * Copying spilled data into another buffer (e.g. to retry or shadow a request) references the
+ * mappings rather than reading the data into memory. If the file cannot be created or written, the
+ * data stays in memory.
+ */
+class SpillBufferImpl : public OwnedImpl {
+public:
+  static const uint64_t SpillChunkSize = 64 * 1024;
+
+  /**
+   * @param directory supplies the directory to create the temporary file in.
+   * @param memory_limit supplies the number of bytes at the front of the buffer that are never
+   *        spilled.
+   */
+  SpillBufferImpl(const std::string& directory, uint64_t memory_limit);
+  ~SpillBufferImpl();
+
+  /**
+   * @return the total number of bytes written to the temporary file.
+   */
+  uint64_t bytesSpilled() const { return file_size_; }
+
+  /**
+   * @return true if spilling failed and data that should have been spilled was kept in memory.
+   */
+  bool spillFailed() const { return spill_failed_; }
+
+  // Buffer::Instance
+  void add(const void* data, uint64_t size) override;
+  void add(const std::string& data) override;
+  void add(const Instance& data) override;
+  void commit(RawSlice* iovecs, uint64_t num_iovecs) override;
+  void move(Instance& rhs) override;
+  void move(Instance& rhs, uint64_t length) override;
+  int read(int fd, uint64_t max_length) override;
+
+private:
+  /**
+   * Spill the in-memory slices at the end of the buffer that lie past memory_limit_, once there
+   * are at least SpillChunkSize bytes of them.
+   */
+  void maybeSpill();
+  bool openFile();
+  bool writeToFile(size_t first_slice);
+
+  const std::string directory_;
+  const uint64_t memory_limit_;
+  int fd_{-1};
+  uint64_t file_size_{};
+  bool spill_failed_{};
+};
+
+} // Buffer
+} // Envoy
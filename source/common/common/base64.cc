@@ -1,6 +1,8 @@
 #include "common/common/base64.h"
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <string>
 
 #include "common/common/empty_string.h"
@@ -24,131 +26,284 @@ static const unsigned char REVERSE_LOOKUP_TABLE[256] = {
     64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
     64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64};
 
-std::string Base64::decode(const std::string& input) {
-  if (input.length() % 4 || input.empty()) {
-    return EMPTY_STRING;
-  }
+namespace {
+
+/**
+ * Tables that let the hot loops handle a whole triplet or quartet at a time. Encoding looks up the
+ * two characters for each 12 bits of a triplet at once, and decoding ORs together pre-shifted
+ * values for the four characters of a quartet, with a bit above the 24 data bits flagging any
+ * character outside of the alphabet.
+ */
+struct CodecTables {
+  static const uint32_t InvalidBit = 1 << 24;
 
-  int max_length = input.length() / 4 * 3;
-  // At most last two chars can be '='.
-  if (input[input.length() - 1] == '=') {
-    max_length--;
-    if (input[input.length() - 2] == '=') {
-      max_length--;
+  CodecTables() {
+    for (uint32_t i = 0; i < 4096; i++) {
+      pairs_[i][0] = CHAR_TABLE[i >> 6];
+      pairs_[i][1] = CHAR_TABLE[i & 0x3f];
     }
-  }
-  std::string result;
-  result.reserve(max_length);
-
-  uint64_t bytes_left = input.length();
-  uint64_t cur_read = 0;
-
-  // Read input string by group of 4 chars, length of input string must be divided evenly by 4.
-  // Decode 4 chars 6 bits each into 3 chars 8 bits each.
-  while (bytes_left > 0) {
-    // Take first 6 bits from 1st converted char and first 2 bits from 2nd converted char,
-    // make 8 bits char from it.
-    // Use conversion table to map char to decoded value (value is between 0 and 64).
-    result.push_back(REVERSE_LOOKUP_TABLE[static_cast<uint32_t>(input[cur_read])] << 2 |
-                     REVERSE_LOOKUP_TABLE[static_cast<uint32_t>(input[cur_read + 1])] >> 4);
-    unsigned char c = REVERSE_LOOKUP_TABLE[static_cast<uint32_t>(input[cur_read + 2])];
-
-    // Chars not less than 64 will be skipped, '=' for example.
-    // Everything less than 64 is going to be decoded.
-    if (c < 64) {
-      // Take last 4 bits from 2nd converted char and 4 first bits from 3rd converted char.
-      result.push_back(REVERSE_LOOKUP_TABLE[static_cast<uint32_t>(input[cur_read + 1])] << 4 |
-                       c >> 2);
-      unsigned char d = REVERSE_LOOKUP_TABLE[static_cast<uint32_t>(input[cur_read + 3])];
-
-      if (d < 64) {
-        // Take last 2 bits from 3rd converted char and all(6) bits from 4th converted char.
-        result.push_back(REVERSE_LOOKUP_TABLE[static_cast<uint32_t>(input[cur_read + 2])] << 6 | d);
+    for (uint32_t c = 0; c < 256; c++) {
+      const uint32_t value = REVERSE_LOOKUP_TABLE[c];
+      for (uint32_t i = 0; i < 4; i++) {
+        shifted_[i][c] = value < 64 ? value << (18 - 6 * i) : InvalidBit;
       }
     }
-    cur_read += 4;
-    bytes_left -= 4;
   }
 
-  return result;
+  char pairs_[4096][2];
+  uint32_t shifted_[4][256];
+};
+
+const CodecTables& codecTables() {
+  static const CodecTables* tables = new CodecTables();
+  return *tables;
 }
 
-void Base64::encodeBase(const uint8_t cur_char, uint64_t pos, uint8_t& next_c, std::string& ret) {
-  switch (pos % 3) {
-  case 0:
-    ret.push_back(CHAR_TABLE[cur_char >> 2]);
-    next_c = (cur_char & 0x03) << 4;
-    break;
-  case 1:
-    ret.push_back(CHAR_TABLE[next_c | (cur_char >> 4)]);
-    next_c = (cur_char & 0x0f) << 2;
-    break;
-  case 2:
-    ret.push_back(CHAR_TABLE[next_c | (cur_char >> 6)]);
-    ret.push_back(CHAR_TABLE[cur_char & 0x3f]);
-    next_c = 0;
-    break;
+// Decodes one quartet of characters, returning the number of bytes written to out. Padding, or
+// any other character outside of the alphabet, in the last two positions ends the quartet early.
+inline uint64_t decodeQuartet(const CodecTables& tables, const uint8_t* in, uint8_t* out) {
+  const uint32_t value = tables.shifted_[0][in[0]] | tables.shifted_[1][in[1]] |
+                         tables.shifted_[2][in[2]] | tables.shifted_[3][in[3]];
+  if (value < CodecTables::InvalidBit) {
+    out[0] = value >> 16;
+    out[1] = value >> 8;
+    out[2] = value;
+    return 3;
+  }
+
+  const uint8_t a = REVERSE_LOOKUP_TABLE[in[0]];
+  const uint8_t b = REVERSE_LOOKUP_TABLE[in[1]];
+  out[0] = a << 2 | b >> 4;
+  const uint8_t c = REVERSE_LOOKUP_TABLE[in[2]];
+  if (c >= 64) {
+    return 1;
+  }
+  out[1] = b << 4 | c >> 2;
+  const uint8_t d = REVERSE_LOOKUP_TABLE[in[3]];
+  if (d >= 64) {
+    return 2;
   }
+  out[2] = c << 6 | d;
+  return 3;
 }
 
-void Base64::encodeLast(uint64_t pos, uint8_t last_char, std::string& ret) {
-  switch (pos % 3) {
-  case 1:
-    ret.push_back(CHAR_TABLE[last_char]);
-    ret.push_back('=');
-    ret.push_back('=');
-    break;
-  case 2:
-    ret.push_back(CHAR_TABLE[last_char]);
-    ret.push_back('=');
-    break;
-  default:
-    break;
+// Encodes one complete triplet into four characters.
+inline void encodeTriplet(const CodecTables& tables, const uint8_t* in, uint8_t* out) {
+  const uint32_t value = in[0] << 16 | in[1] << 8 | in[2];
+  memcpy(out, tables.pairs_[value >> 12], 2);
+  memcpy(out + 2, tables.pairs_[value & 0xfff], 2);
+}
+
+/**
+ * Encodes input that arrives in any number of pieces. Triplets that span two pieces are assembled
+ * in carry_.
+ */
+class Encoder {
+public:
+  /**
+   * @return uint8_t* the end of the characters written to out, which must have room for
+   *         (length + 2) / 3 * 4 of them.
+   */
+  uint8_t* encode(const uint8_t* in, uint64_t length, uint8_t* out) {
+    while (carry_length_ > 0 && length > 0) {
+      carry_[carry_length_++] = *in++;
+      length--;
+      if (carry_length_ == 3) {
+        encodeTriplet(tables_, carry_, out);
+        out += 4;
+        carry_length_ = 0;
+      }
+    }
+
+    while (length >= 3) {
+      encodeTriplet(tables_, in, out);
+      in += 3;
+      out += 4;
+      length -= 3;
+    }
+
+    while (length > 0) {
+      carry_[carry_length_++] = *in++;
+      length--;
+    }
+    return out;
+  }
+
+  /**
+   * Encode the last partial triplet, if any, with '=' padding.
+   * @return uint8_t* the end of the characters written to out, which must have room for 4.
+   */
+  uint8_t* finish(uint8_t* out) {
+    if (carry_length_ == 0) {
+      return out;
+    }
+
+    carry_[carry_length_] = 0;
+    if (carry_length_ == 1) {
+      carry_[2] = 0;
+    }
+    encodeTriplet(tables_, carry_, out);
+    out[3] = '=';
+    if (carry_length_ == 1) {
+      out[2] = '=';
+    }
+    carry_length_ = 0;
+    return out + 4;
+  }
+
+private:
+  const CodecTables& tables_{codecTables()};
+  uint8_t carry_[3];
+  uint64_t carry_length_{};
+};
+
+/**
+ * Decodes input that arrives in any number of pieces whose total length is a multiple of 4.
+ * Quartets that span two pieces are assembled in carry_.
+ */
+class Decoder {
+public:
+  /**
+   * @return uint8_t* the end of the bytes written to out, which must have room for
+   *         (length + 3) / 4 * 3 of them.
+   */
+  uint8_t* decode(const uint8_t* in, uint64_t length, uint8_t* out) {
+    while (carry_length_ > 0 && length > 0) {
+      carry_[carry_length_++] = *in++;
+      length--;
+      if (carry_length_ == 4) {
+        out += decodeQuartet(tables_, carry_, out);
+        carry_length_ = 0;
+      }
+    }
+
+    while (length >= 4) {
+      out += decodeQuartet(tables_, in, out);
+      in += 4;
+      length -= 4;
+    }
+
+    while (length > 0) {
+      carry_[carry_length_++] = *in++;
+      length--;
+    }
+    return out;
+  }
+
+private:
+  const CodecTables& tables_{codecTables()};
+  uint8_t carry_[4];
+  uint64_t carry_length_{};
+};
+
+} // namespace
+
+std::string Base64::decode(const std::string& input) {
+  if (input.length() % 4 || input.empty()) {
+    return EMPTY_STRING;
   }
+
+  // Padding and invalid characters shorten the output, so it is trimmed once decoded.
+  std::string result(input.length() / 4 * 3, '\0');
+  uint8_t* out = reinterpret_cast<uint8_t*>(&result[0]);
+  const uint8_t* end =
+      Decoder().decode(reinterpret_cast<const uint8_t*>(input.data()), input.length(), out);
+  result.resize(end - out);
+  return result;
 }
 
 std::string Base64::encode(const Buffer::Instance& buffer, uint64_t length) {
-  uint64_t output_length = (std::min(length, buffer.length()) + 2) / 3 * 4;
-  std::string ret;
-  ret.reserve(output_length);
+  length = std::min(length, buffer.length());
+  std::string ret((length + 2) / 3 * 4, '\0');
+  uint8_t* out = reinterpret_cast<uint8_t*>(&ret[0]);
 
   uint64_t num_slices = buffer.getRawSlices(nullptr, 0);
   Buffer::RawSlice slices[num_slices];
   buffer.getRawSlices(slices, num_slices);
 
-  uint64_t j = 0;
-  uint8_t next_c = 0;
+  Encoder encoder;
   for (Buffer::RawSlice& slice : slices) {
-    const uint8_t* slice_mem = static_cast<const uint8_t*>(slice.mem_);
-
-    for (uint64_t i = 0; i < slice.len_ && j < length; ++i, ++j) {
-      encodeBase(slice_mem[i], j, next_c, ret);
-    }
-
-    if (j == length) {
+    if (length == 0) {
       break;
     }
-  }
 
-  encodeLast(j, next_c, ret);
+    const uint64_t in_length = std::min<uint64_t>(slice.len_, length);
+    out = encoder.encode(static_cast<const uint8_t*>(slice.mem_), in_length, out);
+    length -= in_length;
+  }
+  encoder.finish(out);
 
   return ret;
 }
 
 std::string Base64::encode(const char* input, uint64_t length) {
-  uint64_t output_length = (length + 2) / 3 * 4;
-  std::string ret;
-  ret.reserve(output_length);
+  std::string ret((length + 2) / 3 * 4, '\0');
+  Encoder encoder;
+  encoder.finish(encoder.encode(reinterpret_cast<const uint8_t*>(input), length,
+                                reinterpret_cast<uint8_t*>(&ret[0])));
+  return ret;
+}
+
+void Base64::encode(const Buffer::Instance& input, uint64_t length, Buffer::Instance& output) {
+  length = std::min(length, input.length());
+  if (length == 0) {
+    return;
+  }
 
-  uint64_t pos = 0;
-  uint8_t next_c = 0;
+  // A single reservation is always contiguous, so the output is written in place.
+  Buffer::RawSlice out_slice;
+  output.reserve((length + 2) / 3 * 4, &out_slice, 1);
+  uint8_t* const out_start = static_cast<uint8_t*>(out_slice.mem_);
+  uint8_t* out = out_start;
 
-  for (uint64_t i = 0; i < length; ++i) {
-    encodeBase(input[i], pos++, next_c, ret);
+  uint64_t num_slices = input.getRawSlices(nullptr, 0);
+  Buffer::RawSlice slices[num_slices];
+  input.getRawSlices(slices, num_slices);
+
+  Encoder encoder;
+  for (Buffer::RawSlice& slice : slices) {
+    const uint64_t in_length = std::min<uint64_t>(slice.len_, length);
+    out = encoder.encode(static_cast<const uint8_t*>(slice.mem_), in_length, out);
+    length -= in_length;
+    if (length == 0) {
+      break;
+    }
   }
+  out = encoder.finish(out);
 
-  encodeLast(pos, next_c, ret);
+  out_slice.len_ = out - out_start;
+  output.commit(&out_slice, 1);
+}
 
-  return ret;
+bool Base64::decode(const Buffer::Instance& input, uint64_t length, Buffer::Instance& output) {
+  if (length % 4 || length > input.length()) {
+    return false;
+  }
+  if (length == 0) {
+    return true;
+  }
+
+  Buffer::RawSlice out_slice;
+  output.reserve(length / 4 * 3, &out_slice, 1);
+  uint8_t* const out_start = static_cast<uint8_t*>(out_slice.mem_);
+  uint8_t* out = out_start;
+
+  uint64_t num_slices = input.getRawSlices(nullptr, 0);
+  Buffer::RawSlice slices[num_slices];
+  input.getRawSlices(slices, num_slices);
+
+  Decoder decoder;
+  for (Buffer::RawSlice& slice : slices) {
+    const uint64_t in_length = std::min<uint64_t>(slice.len_, length);
+    out = decoder.decode(static_cast<const uint8_t*>(slice.mem_), in_length, out);
+    length -= in_length;
+    if (length == 0) {
+      break;
+    }
+  }
+
+  out_slice.len_ = out - out_start;
+  output.commit(&out_slice, 1);
+  return true;
 }
 } // Envoy
@@ -22,6 +22,15 @@ public:
    */
   static std::string encode(const char* input, uint64_t length);
 
+  /**
+   * Base64 encode an input buffer into an output buffer without linearizing the input. Input may
+   * be split across any number of slices.
+   * @param input supplies the buffer to encode.
+   * @param length supplies the length to encode which may be <= the input buffer length.
+   * @param output supplies the buffer to which the encoded data is appended.
+   */
+  static void encode(const Buffer::Instance& input, uint64_t length, Buffer::Instance& output);
+
   /**
    * Base64 decode an input string.
    * @param input supplies the input to decode.
@@ -31,16 +40,17 @@ public:
    */
   static std::string decode(const std::string& input);
 
-private:
-  /**
-   * Helper method for encoding. This is used to encode all of the characters from the input string.
-   */
-  static void encodeBase(const uint8_t cur_char, uint64_t pos, uint8_t& next_c, std::string& ret);
-
   /**
-   * Encode last characters. It appends '=' chars to the ret if input
-   * string length is not divisible by 3.
+   * Base64 decode an input buffer into an output buffer without linearizing the input. Quartets
+   * may be split across slices, and each quartet may carry its own '=' padding so that separately
+   * encoded chunks can be decoded as one stream.
+   * @param input supplies the buffer to decode.
+   * @param length supplies the length to decode which must be a multiple of 4 and <= the input
+   *        buffer length.
+   * @param output supplies the buffer to which the decoded data is appended.
+   * @return bool false if length is not a multiple of 4 or is larger than the input, in which case
+   *         nothing is decoded.
    */
-  static void encodeLast(uint64_t pos, uint8_t last_char, std::string& ret);
+  static bool decode(const Buffer::Instance& input, uint64_t length, Buffer::Instance& output);
 };
 } // Envoy
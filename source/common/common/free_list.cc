@@ -0,0 +1,53 @@
+#include "common/common/free_list.h"
+
+#include <algorithm>
+#include <new>
+
+#include "common/common/assert.h"
+
+namespace Envoy {
+
+FreeList::~FreeList() {
+  release();
+
+  // Objects with static storage duration can be destroyed after a thread local free list during
+  // process teardown. Make sure that any such deallocations bypass the cache.
+  max_cached_blocks_ = 0;
+}
+
+void* FreeList::allocate(size_t size) {
+  ASSERT(block_size_ == 0 || block_size_ == size);
+  if (!head_) {
+    return ::operator new(std::max(size, sizeof(FreeBlock)));
+  }
+
+  FreeBlock* block = head_;
+  head_ = block->next_;
+  size_--;
+  return block;
+}
+
+void FreeList::deallocate(void* block, size_t size) {
+  if (size_ >= max_cached_blocks_) {
+    ::operator delete(block);
+    return;
+  }
+
+  ASSERT(block_size_ == 0 || block_size_ == size);
+  block_size_ = size;
+  FreeBlock* free_block = static_cast<FreeBlock*>(block);
+  free_block->next_ = head_;
+  head_ = free_block;
+  size_++;
+}
+
+void FreeList::release() {
+  while (head_) {
+    FreeBlock* block = head_;
+    head_ = block->next_;
+    ::operator delete(block);
+  }
+  size_ = 0;
+}
+
+} // Envoy
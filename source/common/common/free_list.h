@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+
+#include "common/common/non_copyable.h"
+
+namespace Envoy {
+
+/**
+ * A bounded cache of fixed size memory blocks. Objects that are created and destroyed at very high
+ * rates can recycle their storage through a free list rather than going back to malloc each time,
+ * and reuse the most recently freed block while it is likely still in cache. Storage comes from
+ * ::operator new, so blocks released by the cache are freed normally. A free list is not thread
+ * safe; it is generally used per thread.
+ */
+class FreeList : NonCopyable {
+public:
+  /**
+   * @param max_cached_blocks supplies the maximum number of blocks cached. This bounds the memory
+   *        retained after a burst of allocations.
+   */
+  FreeList(size_t max_cached_blocks) : max_cached_blocks_(max_cached_blocks) {}
+  ~FreeList();
+
+  /**
+   * Allocate a block. All blocks allocated from a single free list must be the same size.
+   * @param size supplies the block size.
+   */
+  void* allocate(size_t size);
+
+  /**
+   * Return a block to the free list.
+   * @param block supplies the block previously returned by allocate().
+   * @param size supplies the block size.
+   */
+  void deallocate(void* block, size_t size);
+
+  /**
+   * Free all of the cached blocks.
+   */
+  void release();
+
+  /**
+   * @return the number of blocks currently cached. Used for testing.
+   */
+  size_t size() const { return size_; }
+
+private:
+  struct FreeBlock {
+    FreeBlock* next_;
+  };
+
+  size_t max_cached_blocks_;
+  size_t block_size_{};
+  FreeBlock* head_{};
+  size_t size_{};
+};
+
+} // Envoy
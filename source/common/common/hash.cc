@@ -0,0 +1,98 @@
+#include "common/common/hash.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace Envoy {
+namespace {
+
+const uint64_t Prime1 = 11400714785074694791ULL;
+const uint64_t Prime2 = 14029467366897019727ULL;
+const uint64_t Prime3 = 1609587929392839161ULL;
+const uint64_t Prime4 = 9650029242287828579ULL;
+const uint64_t Prime5 = 2870177450012600261ULL;
+
+inline uint64_t rotl(uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); }
+
+// The reference implementation reads input as little endian. memcpy keeps unaligned reads legal and
+// compiles to a single load.
+inline uint64_t read64(const char* p) {
+  uint64_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+inline uint32_t read32(const char* p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+inline uint64_t round(uint64_t acc, uint64_t input) {
+  acc += input * Prime2;
+  acc = rotl(acc, 31);
+  return acc * Prime1;
+}
+
+inline uint64_t mergeRound(uint64_t acc, uint64_t value) {
+  acc ^= round(0, value);
+  return acc * Prime1 + Prime4;
+}
+
+} // namespace
+
+uint64_t HashUtil::xxHash64(const char* input, size_t length, uint64_t seed) {
+  const char* p = input;
+  const char* const end = input + length;
+  uint64_t hash;
+
+  if (length >= 32) {
+    // Four independent lanes consume 32 byte stripes.
+    uint64_t v1 = seed + Prime1 + Prime2;
+    uint64_t v2 = seed + Prime2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - Prime1;
+    const char* const limit = end - 32;
+    do {
+      v1 = round(v1, read64(p));
+      v2 = round(v2, read64(p + 8));
+      v3 = round(v3, read64(p + 16));
+      v4 = round(v4, read64(p + 24));
+      p += 32;
+    } while (p <= limit);
+
+    hash = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+    hash = mergeRound(hash, v1);
+    hash = mergeRound(hash, v2);
+    hash = mergeRound(hash, v3);
+    hash = mergeRound(hash, v4);
+  } else {
+    hash = seed + Prime5;
+  }
+
+  hash += length;
+
+  for (; p + 8 <= end; p += 8) {
+    hash ^= round(0, read64(p));
+    hash = rotl(hash, 27) * Prime1 + Prime4;
+  }
+
+  if (p + 4 <= end) {
+    hash ^= static_cast<uint64_t>(read32(p)) * Prime1;
+    hash = rotl(hash, 23) * Prime2 + Prime3;
+    p += 4;
+  }
+
+  for (; p < end; p++) {
+    hash ^= static_cast<uint8_t>(*p) * Prime5;
+    hash = rotl(hash, 11) * Prime1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= Prime2;
+  hash ^= hash >> 29;
+  hash *= Prime3;
+  hash ^= hash >> 32;
+  return hash;
+}
+} // Envoy
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Envoy {
+/**
+ * Non-cryptographic hash functions whose output is stable across platforms and builds, unlike
+ * std::hash.
+ */
+class HashUtil final {
+public:
+  /**
+   * Compute the xxHash64 of the given data. See https://github.com/Cyan4973/xxHash.
+   * @param input supplies the data to hash.
+   * @param length supplies the length of the data.
+   * @param seed supplies the hash seed.
+   * @return uint64_t the hash.
+   */
+  static uint64_t xxHash64(const char* input, size_t length, uint64_t seed);
+
+  /**
+   * Compute the xxHash64 of the given string.
+   * @param input supplies the string to hash.
+   * @param seed supplies the hash seed.
+   * @return uint64_t the hash.
+   */
+  static uint64_t xxHash64(const std::string& input, uint64_t seed = 0) {
+    return xxHash64(input.data(), input.size(), seed);
+  }
+};
+} // Envoy
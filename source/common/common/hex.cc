@@ -1,27 +1,74 @@
 #include "common/common/hex.h"
 
-#include <array>
 #include <cstdint>
+#include <cstring>
 #include <string>
 #include <vector>
 
 #include "envoy/common/exception.h"
 
-#include "common/common/utility.h"
+#include "common/common/assert.h"
 
 #include "spdlog/spdlog.h"
 
 namespace Envoy {
-std::string Hex::encode(const uint8_t* data, size_t length) {
-  static const char* const digits = "0123456789abcdef";
 
-  std::string ret;
-  ret.reserve(length * 2);
+namespace {
+
+/**
+ * Table mapping each character to its hex digit value, or to 0xff if it is not a hex digit.
+ */
+struct HexDigitTable {
+  HexDigitTable() {
+    for (uint32_t c = 0; c < 256; c++) {
+      values_[c] = 0xff;
+    }
+    for (uint32_t i = 0; i < 10; i++) {
+      values_['0' + i] = i;
+    }
+    for (uint32_t i = 0; i < 6; i++) {
+      values_['a' + i] = 10 + i;
+      values_['A' + i] = 10 + i;
+    }
+  }
+
+  uint8_t values_[256];
+};
+
+const HexDigitTable& hexDigitTable() {
+  static const HexDigitTable* table = new HexDigitTable();
+  return *table;
+}
+
+/**
+ * Table mapping each byte to its two hex digits, so that encoding takes one lookup per byte.
+ */
+struct HexPairTable {
+  HexPairTable() {
+    static const char* const digits = "0123456789abcdef";
+    for (uint32_t i = 0; i < 256; i++) {
+      pairs_[i][0] = digits[i >> 4];
+      pairs_[i][1] = digits[i & 0xf];
+    }
+  }
+
+  char pairs_[256][2];
+};
 
+const HexPairTable& hexPairTable() {
+  static const HexPairTable* table = new HexPairTable();
+  return *table;
+}
+
+} // namespace
+
+std::string Hex::encode(const uint8_t* data, size_t length) {
+  const HexPairTable& table = hexPairTable();
+
+  std::string ret(length * 2, '\0');
+  char* out = &ret[0];
   for (size_t i = 0; i < length; i++) {
-    uint8_t d = data[i];
-    ret.push_back(digits[d >> 4]);
-    ret.push_back(digits[d & 0xf]);
+    memcpy(out + 2 * i, table.pairs_[data[i]], 2);
   }
 
   return ret;
@@ -32,33 +79,58 @@ std::vector<uint8_t> Hex::decode(const std::string& hex_string) {
     throw EnvoyException(fmt::format("invalid hex string '{}'", hex_string));
   }
 
-  std::vector<uint8_t> segment;
-  for (size_t i = 0; i < hex_string.size(); i += 2) {
-    std::string hex_byte = hex_string.substr(i, 2);
-    uint64_t out;
-    if (!StringUtil::atoul(hex_byte.c_str(), out, 16)) {
-      throw EnvoyException(fmt::format("invalid hex string '{}'", hex_string));
-    }
+  // As in hexToUint64(), invalid characters are accumulated and checked once at the end.
+  const uint8_t* table = hexDigitTable().values_;
+  std::vector<uint8_t> segment(hex_string.size() / 2);
+  uint8_t invalid = 0;
+  for (size_t i = 0; i < segment.size(); i++) {
+    const uint8_t high = table[static_cast<uint8_t>(hex_string[2 * i])];
+    const uint8_t low = table[static_cast<uint8_t>(hex_string[2 * i + 1])];
+    invalid |= high | low;
+    segment[i] = (high << 4) | (low & 0xf);
+  }
 
-    segment.push_back(out);
+  if (invalid & 0xf0) {
+    throw EnvoyException(fmt::format("invalid hex string '{}'", hex_string));
   }
 
   return segment;
 }
 
 std::string Hex::uint64ToHex(uint64_t value) {
-  std::array<uint8_t, 8> data;
-
-  // This is explicitly done for performance reasons
-  data[7] = (value & 0x00000000000000FF);
-  data[6] = (value & 0x000000000000FF00) >> 8;
-  data[5] = (value & 0x0000000000FF0000) >> 16;
-  data[4] = (value & 0x00000000FF000000) >> 24;
-  data[3] = (value & 0x000000FF00000000) >> 32;
-  data[2] = (value & 0x0000FF0000000000) >> 40;
-  data[1] = (value & 0x00FF000000000000) >> 48;
-  data[0] = (value & 0xFF00000000000000) >> 56;
-
-  return encode(&data[0], data.size());
+  char data[16];
+  uint64ToHex(value, data);
+  return std::string(data, sizeof(data));
+}
+
+void Hex::uint64ToHex(uint64_t value, char* out) {
+  static const char* const digits = "0123456789abcdef";
+
+  // Fixed trip count with no data dependent branches, so the compiler can unroll and vectorize it.
+  for (uint32_t i = 0; i < 16; i++) {
+    out[i] = digits[(value >> (60 - 4 * i)) & 0xf];
+  }
+}
+
+bool Hex::hexToUint64(const char* data, size_t length, uint64_t& value) {
+  ASSERT(length > 0 && length <= 16);
+  const uint8_t* table = hexDigitTable().values_;
+
+  // Invalid characters are accumulated rather than checked one at a time to keep the loop
+  // branch free.
+  uint64_t result = 0;
+  uint8_t invalid = 0;
+  for (size_t i = 0; i < length; i++) {
+    const uint8_t digit = table[static_cast<uint8_t>(data[i])];
+    invalid |= digit;
+    result = (result << 4) | (digit & 0xf);
+  }
+
+  if (invalid & 0xf0) {
+    return false;
+  }
+
+  value = result;
+  return true;
 }
 } // Envoy
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -39,5 +41,22 @@ public:
    * @param value The integer to be converted.
    */
   static std::string uint64ToHex(uint64_t value);
+
+  /**
+   * Writes the given 64-bit integer as exactly 16 hexadecimal digits, without allocating.
+   * @param value The integer to be converted.
+   * @param out receives the digits. It must have room for 16 characters and is not null
+   *        terminated.
+   */
+  static void uint64ToHex(uint64_t value, char* out);
+
+  /**
+   * Parses a fixed width run of hexadecimal digits, without allocating.
+   * @param data the digits to parse.
+   * @param length the number of digits, between 1 and 16.
+   * @param value receives the parsed integer.
+   * @return true if every character is a hex digit.
+   */
+  static bool hexToUint64(const char* data, size_t length, uint64_t& value);
 };
 } // Envoy
@@ -1,5 +1,6 @@
 #include "common/common/logger.h"
 
+#include <chrono>
 #include <cstdint>
 #include <iostream>
 #include <string>
@@ -22,7 +23,81 @@ Logger::Logger(const std::string& name) {
   logger_->set_level(spdlog::level::trace);
 }
 
+LockingStderrSink::~LockingStderrSink() { stopAsync(); }
+
+void LockingStderrSink::startAsync(uint32_t max_queued_lines) {
+  max_queued_lines_ = max_queued_lines;
+  stopping_ = false;
+  // std::thread rather than Thread::Thread, which logs and so cannot be used by the logger.
+  writer_.reset(new std::thread([this]() -> void { runWriter(); }));
+  async_ = true;
+}
+
+void LockingStderrSink::stopAsync() {
+  if (!writer_) {
+    return;
+  }
+
+  async_ = false;
+  {
+    std::unique_lock<std::mutex> lock(writer_mutex_);
+    stopping_ = true;
+  }
+  writer_wakeup_.notify_one();
+  writer_->join();
+  writer_.reset();
+
+  // Lines queued by threads that saw async_ just before it was cleared.
+  write(queue_.popAll());
+}
+
+void LockingStderrSink::runWriter() {
+  while (true) {
+    bool stopping;
+    {
+      // Logging threads do not take the mutex to wake the writer, so a wakeup can be missed
+      // between the check and the wait. The timeout bounds how long a line can wait then.
+      std::unique_lock<std::mutex> lock(writer_mutex_);
+      writer_wakeup_.wait_for(lock, std::chrono::milliseconds(100),
+                              [this]() -> bool { return queued_lines_ > 0 || stopping_; });
+      stopping = stopping_;
+    }
+
+    std::vector<std::unique_ptr<QueuedLine>> lines = queue_.popAll();
+    queued_lines_ -= lines.size();
+    write(lines);
+    if (stopping) {
+      return;
+    }
+  }
+}
+
+void LockingStderrSink::write(const std::vector<std::unique_ptr<QueuedLine>>& lines) {
+  if (lines.empty()) {
+    return;
+  }
+
+  // The lock is taken once for all the lines that were waiting.
+  Thread::OptionalLockGuard<Thread::BasicLockable> guard(lock_);
+  for (const std::unique_ptr<QueuedLine>& line : lines) {
+    std::cerr << line->line_;
+  }
+}
+
 void LockingStderrSink::log(const spdlog::details::log_msg& msg) {
+  if (async_ && msg.level < spdlog::level::err) {
+    if (queued_lines_++ >= max_queued_lines_) {
+      queued_lines_--;
+      dropped_lines_++;
+      return;
+    }
+
+    if (queue_.push(std::unique_ptr<QueuedLine>{new QueuedLine(msg.formatted.str())})) {
+      writer_wakeup_.notify_one();
+    }
+    return;
+  }
+
   Thread::OptionalLockGuard<Thread::BasicLockable> guard(lock_);
   std::cerr << msg.formatted.str();
 }
@@ -41,5 +116,13 @@ void Registry::initialize(uint64_t log_level, Thread::BasicLockable& lock) {
   }
 }
 
+void Registry::initialize(uint64_t log_level, Thread::BasicLockable& lock,
+                          uint32_t async_log_lines) {
+  initialize(log_level, lock);
+  if (async_log_lines > 0) {
+    getSink()->startAsync(async_log_lines);
+  }
+}
+
 } // Logger
 } // Envoy
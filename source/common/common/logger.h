@@ -1,13 +1,18 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "envoy/thread/thread.h"
 
 #include "common/common/macros.h"
+#include "common/common/mpsc_queue.h"
 
 #include "spdlog/spdlog.h"
 
@@ -59,18 +64,59 @@ private:
 };
 
 /**
- * An optionally locking stderr logging sink.
+ * An optionally locking stderr logging sink. It can also hand lines to a writer thread, so that
+ * threads that log never wait for the lock or for stderr.
  */
 class LockingStderrSink : public spdlog::sinks::sink {
 public:
+  ~LockingStderrSink();
+
   void setLock(Thread::BasicLockable& lock) { lock_ = &lock; }
 
+  /**
+   * Start writing lines from a writer thread. Logging threads queue lines without blocking, and
+   * lines are dropped once max_queued_lines are waiting to be written. Error and critical lines
+   * are still written synchronously, since the process may be about to die. It must not be called
+   * again before stopAsync().
+   * @param max_queued_lines supplies the maximum number of lines waiting to be written.
+   */
+  void startAsync(uint32_t max_queued_lines);
+
+  /**
+   * Write the queued lines, stop the writer thread and go back to writing synchronously.
+   */
+  void stopAsync();
+
+  /**
+   * @return uint64_t the number of lines dropped because too many were waiting to be written.
+   */
+  uint64_t droppedLines() const { return dropped_lines_; }
+
   // spdlog::sinks::sink
   void log(const spdlog::details::log_msg& msg) override;
   void flush() override;
 
 private:
+  struct QueuedLine {
+    QueuedLine(std::string&& line) : line_(std::move(line)) {}
+
+    const std::string line_;
+    QueuedLine* next_{};
+  };
+
+  void runWriter();
+  void write(const std::vector<std::unique_ptr<QueuedLine>>& lines);
+
   Thread::BasicLockable* lock_{};
+  std::atomic<bool> async_{};
+  uint32_t max_queued_lines_{};
+  MpscQueue<QueuedLine> queue_;
+  std::atomic<uint32_t> queued_lines_{};
+  std::atomic<uint64_t> dropped_lines_{};
+  std::mutex writer_mutex_;
+  std::condition_variable writer_wakeup_;
+  bool stopping_{};
+  std::unique_ptr<std::thread> writer_;
 };
 
 /**
@@ -98,6 +144,13 @@ public:
    */
   static void initialize(uint64_t log_level, Thread::BasicLockable& lock);
 
+  /**
+   * Initialize the logging system from server options, writing lines from a writer thread if
+   * async_log_lines is not 0. @see LockingStderrSink::startAsync().
+   */
+  static void initialize(uint64_t log_level, Thread::BasicLockable& lock,
+                         uint32_t async_log_lines);
+
   /**
    * @return const std::vector<Logger>& the installed loggers.
    */
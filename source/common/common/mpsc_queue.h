@@ -0,0 +1,58 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "common/common/non_copyable.h"
+
+namespace Envoy {
+/**
+ * A lock free, multiple producer single consumer queue. Producers push with a single compare and
+ * swap. The consumer takes every queued item at once with a single exchange, which sidesteps the
+ * ABA problem of popping items one at a time. T must have a "T* next_" member that the queue uses
+ * to link items while they are queued.
+ */
+template <class T> class MpscQueue : NonCopyable {
+public:
+  ~MpscQueue() { popAll(); }
+
+  /**
+   * Push an item. This can be called from any thread.
+   * @return true if the queue was empty before the push, i.e. the consumer may need to be woken
+   *         up.
+   */
+  bool push(std::unique_ptr<T>&& item) {
+    T* new_head = item.release();
+    T* head = head_.load(std::memory_order_relaxed);
+    do {
+      new_head->next_ = head;
+    } while (!head_.compare_exchange_weak(head, new_head, std::memory_order_release,
+                                          std::memory_order_relaxed));
+    return head == nullptr;
+  }
+
+  /**
+   * Remove every queued item. This must only be called from the consumer thread.
+   * @return the items in the order in which they were pushed.
+   */
+  std::vector<std::unique_ptr<T>> popAll() {
+    std::vector<std::unique_ptr<T>> items;
+    T* item = head_.exchange(nullptr, std::memory_order_acquire);
+    while (item) {
+      T* next = item->next_;
+      items.emplace_back(item);
+      item = next;
+    }
+
+    // The list is linked from the most recent push.
+    std::reverse(items.begin(), items.end());
+    return items;
+  }
+
+private:
+  std::atomic<T*> head_{nullptr};
+};
+
+} // Envoy
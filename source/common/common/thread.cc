@@ -1,26 +1,77 @@
 #include "common/common/thread.h"
 
+#include <sched.h>
 #include <sys/syscall.h>
 
+#include <cstdint>
 #include <functional>
+#include <vector>
+
+#include "envoy/common/exception.h"
 
 #include "common/common/assert.h"
 #include "common/common/macros.h"
 
+#include "spdlog/spdlog.h"
+
 namespace Envoy {
 namespace Thread {
 
-Thread::Thread(std::function<void()> thread_routine) : thread_routine_(thread_routine) {
-  int rc = pthread_create(&thread_id_, nullptr, [](void* arg) -> void* {
+namespace {
+
+cpu_set_t toCpuSet(const std::vector<uint32_t>& cpus) {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (uint32_t cpu : cpus) {
+    CPU_SET(cpu, &cpu_set);
+  }
+  return cpu_set;
+}
+
+} // namespace
+
+Thread::Thread(std::function<void()> thread_routine, const std::vector<uint32_t>& cpus)
+    : thread_routine_(thread_routine) {
+  pthread_attr_t attr;
+  int rc = pthread_attr_init(&attr);
+  RELEASE_ASSERT(rc == 0);
+  if (!cpus.empty()) {
+    const cpu_set_t cpu_set = toCpuSet(cpus);
+    rc = pthread_attr_setaffinity_np(&attr, sizeof(cpu_set), &cpu_set);
+    RELEASE_ASSERT(rc == 0);
+  }
+
+  rc = pthread_create(&thread_id_, &attr, [](void* arg) -> void* {
     static_cast<Thread*>(arg)->thread_routine_();
     return nullptr;
   }, this);
   RELEASE_ASSERT(rc == 0);
+  pthread_attr_destroy(&attr);
   UNREFERENCED_PARAMETER(rc);
 }
 
 int32_t Thread::currentThreadId() { return syscall(SYS_gettid); }
 
+void Thread::checkCpus(const std::vector<uint32_t>& cpus) {
+  cpu_set_t allowed;
+  int rc = pthread_getaffinity_np(pthread_self(), sizeof(allowed), &allowed);
+  RELEASE_ASSERT(rc == 0);
+  UNREFERENCED_PARAMETER(rc);
+
+  for (uint32_t cpu : cpus) {
+    if (cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed)) {
+      throw EnvoyException(fmt::format("CPU {} does not exist or is not available", cpu));
+    }
+  }
+}
+
+void Thread::setCurrentThreadAffinity(const std::vector<uint32_t>& cpus) {
+  const cpu_set_t cpu_set = toCpuSet(cpus);
+  int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+  RELEASE_ASSERT(rc == 0);
+  UNREFERENCED_PARAMETER(rc);
+}
+
 void Thread::join() {
   int rc = pthread_join(thread_id_, nullptr);
   RELEASE_ASSERT(rc == 0);
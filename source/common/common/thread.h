@@ -1,8 +1,10 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <vector>
 
 #include "envoy/thread/thread.h"
 
@@ -15,13 +17,33 @@ namespace Thread {
  */
 class Thread {
 public:
-  Thread(std::function<void()> thread_routine);
+  /**
+   * @param thread_routine supplies the function run by the thread.
+   * @param cpus supplies the CPUs the thread may run on, from its first instruction on, so that
+   *        the memory it touches first is allocated on the local NUMA node. If empty the thread
+   *        inherits the affinity of the creating thread. The CPUs must have been checked with
+   *        checkCpus().
+   */
+  Thread(std::function<void()> thread_routine, const std::vector<uint32_t>& cpus = {});
 
   /**
    * Get current thread id.
    */
   static int32_t currentThreadId();
 
+  /**
+   * Check that CPUs exist and that the calling thread is allowed to run on them.
+   * @param cpus supplies the CPUs to check.
+   * @throw EnvoyException if a CPU can't be used.
+   */
+  static void checkCpus(const std::vector<uint32_t>& cpus);
+
+  /**
+   * Restrict the calling thread to a set of CPUs.
+   * @param cpus supplies the CPUs, which must have been checked with checkCpus().
+   */
+  static void setCurrentThreadAffinity(const std::vector<uint32_t>& cpus);
+
   /**
    * Join on thread exit.
    */
@@ -1,5 +1,8 @@
 #include "common/common/to_lower_table.h"
 
+#include <cstdint>
+#include <cstring>
+
 namespace Envoy {
 ToLowerTable::ToLowerTable() {
   for (size_t c = 0; c < 256; c++) {
@@ -11,7 +14,24 @@ ToLowerTable::ToLowerTable() {
 }
 
 void ToLowerTable::toLowerCase(char* buffer, uint32_t size) const {
-  for (size_t i = 0; i < size; i++) {
+  // Convert 8 bytes at a time. For each byte we compute whether it is an ASCII upper case letter
+  // using carry free arithmetic on the low 7 bits, and then set the 0x20 bit in those bytes only.
+  // Bytes with the high bit set are never modified.
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, buffer + i, sizeof(word));
+    const uint64_t heptets = word & 0x7f7f7f7f7f7f7f7fULL;
+    const uint64_t is_ge_a = heptets + 0x3f3f3f3f3f3f3f3fULL; // High bit set if >= 'A'.
+    const uint64_t is_gt_z = heptets + 0x2525252525252525ULL; // High bit set if > 'Z'.
+    const uint64_t is_upper = (is_ge_a ^ is_gt_z) & ~word & 0x8080808080808080ULL;
+    if (is_upper != 0) {
+      word |= is_upper >> 2;
+      memcpy(buffer + i, &word, sizeof(word));
+    }
+  }
+
+  for (; i < size; i++) {
     buffer[i] = table_[static_cast<uint8_t>(buffer[i])];
   }
 }
@@ -1,11 +1,13 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
+#include <string>
 
 namespace Envoy {
 /**
- * Convenience class for converting ASCII strings to lower case using a lookup table for maximum
- * speed.
+ * Convenience class for converting ASCII strings to lower case. Long strings are converted a word
+ * at a time and any remainder uses a lookup table.
  */
 class ToLowerTable {
 public:
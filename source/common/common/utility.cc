@@ -87,6 +87,14 @@ void StringUtil::rtrim(std::string& source) {
   }
 }
 
+std::string StringUtil::trim(const std::string& source) {
+  const size_t start = source.find_first_not_of(" \t");
+  if (start == std::string::npos) {
+    return "";
+  }
+  return source.substr(start, source.find_last_not_of(" \t") - start + 1);
+}
+
 size_t StringUtil::strlcpy(char* dst, const char* src, size_t size) {
   strncpy(dst, src, size - 1);
   dst[size - 1] = '\0';
@@ -166,12 +174,33 @@ std::string StringUtil::escape(const std::string& source) {
 }
 
 std::string AccessLogDateTimeFormatter::fromTime(const SystemTime& time) {
-  static DateFormatter date_format("%Y-%m-%dT%H:%M:%S");
+  std::string output;
+  appendTime(time, output);
+  return output;
+}
+
+void AccessLogDateTimeFormatter::appendTime(const SystemTime& time, std::string& output) {
+  static thread_local time_t cached_seconds = -1;
+  static thread_local std::array<char, 32> cached_date;
+  static thread_local size_t cached_date_length;
+
+  const int64_t epoch_msec =
+      std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+  const time_t seconds = std::chrono::system_clock::to_time_t(time);
+  if (seconds != cached_seconds) {
+    tm current_tm;
+    gmtime_r(&seconds, &current_tm);
+    cached_date_length =
+        strftime(cached_date.data(), cached_date.size(), "%Y-%m-%dT%H:%M:%S", &current_tm);
+    cached_seconds = seconds;
+  }
 
-  return fmt::format(
-      "{}.{:03d}Z", date_format.fromTime(time),
-      std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count() %
-          1000);
+  const uint32_t msec = epoch_msec % 1000;
+  const char fraction[] = {'.', static_cast<char>('0' + msec / 100),
+                           static_cast<char>('0' + msec / 10 % 10),
+                           static_cast<char>('0' + msec % 10), 'Z'};
+  output.append(cached_date.data(), cached_date_length);
+  output.append(fraction, sizeof(fraction));
 }
 
 bool StringUtil::endsWith(const std::string& source, const std::string& end) {
@@ -40,6 +40,12 @@ private:
 class AccessLogDateTimeFormatter {
 public:
   static std::string fromTime(const SystemTime& time);
+
+  /**
+   * Append the formatted time to output. The date and time part is cached per thread and only
+   * reformatted when the second changes.
+   */
+  static void appendTime(const SystemTime& time, std::string& output);
 };
 
 /**
@@ -115,6 +121,11 @@ public:
    */
   static void rtrim(std::string& source);
 
+  /**
+   * @return the string with leading and trailing spaces and tabs removed.
+   */
+  static std::string trim(const std::string& source);
+
   /**
    * Size-bounded string copying and concatenation
    */
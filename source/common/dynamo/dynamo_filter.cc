@@ -11,57 +11,145 @@
 #include "common/http/codes.h"
 #include "common/http/exception.h"
 #include "common/http/utility.h"
-#include "common/json/json_loader.h"
 
 #include "spdlog/spdlog.h"
 
 namespace Envoy {
 namespace Dynamo {
 
+DynamoStats::DynamoStats(const std::string& stat_prefix, Stats::Scope& scope,
+                         ThreadLocal::Instance& tls, uint32_t max_entries)
+    : prefix_(stat_prefix + "dynamodb."), scope_(scope), tls_(tls),
+      tls_slot_(tls.allocateSlot()), max_entries_(max_entries) {
+  tls.set(tls_slot_, [](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+    return std::make_shared<ThreadLocalCache>();
+  });
+}
+
+DynamoStats::EntityStats::EntityStats(Stats::Scope& scope, const std::string& entity_prefix)
+    : entity_prefix_(entity_prefix),
+      upstream_rq_total_(scope.counter(entity_prefix + "upstream_rq_total")),
+      upstream_rq_time_(entity_prefix + "upstream_rq_time") {}
+
+DynamoStats::ThreadLocalCache& DynamoStats::cache() {
+  ThreadLocalCache& cache = tls_.getTyped<ThreadLocalCache>(tls_slot_);
+  if (cache.entries_ >= max_entries_) {
+    cache.operations_.clear();
+    cache.tables_.clear();
+    cache.entries_ = 0;
+  }
+
+  return cache;
+}
+
+uint32_t DynamoStats::cachedEntries() {
+  return tls_.getTyped<ThreadLocalCache>(tls_slot_).entries_;
+}
+
+DynamoStats::EntityStats& DynamoStats::entityStats(ThreadLocalCache& cache,
+                                                   const std::string& entity_type,
+                                                   const std::string& entity) {
+  std::unordered_map<std::string, EntityStatsPtr>& entities =
+      entity_type == "table" ? cache.tables_ : cache.operations_;
+  auto it = entities.find(entity);
+  if (it == entities.end()) {
+    cache.entries_++;
+    it = entities
+             .emplace(entity, EntityStatsPtr{new EntityStats(
+                                  scope_, fmt::format("{}{}.{}.", prefix_, entity_type, entity))})
+             .first;
+  }
+
+  return *it->second;
+}
+
+void DynamoStats::chargeEntity(const std::string& entity_type, const std::string& entity,
+                               uint64_t status, std::chrono::milliseconds latency) {
+  ThreadLocalCache& cache = this->cache();
+  EntityStats& stats = entityStats(cache, entity_type, entity);
+  auto it = stats.statuses_.find(status);
+  if (it == stats.statuses_.end()) {
+    cache.entries_++;
+    const std::string group_string =
+        Http::CodeUtility::groupStringForResponseCode(static_cast<Http::Code>(status));
+    const std::string status_string = std::to_string(status);
+    const std::string total_prefix = stats.entity_prefix_ + "upstream_rq_total_";
+    const std::string time_prefix = stats.entity_prefix_ + "upstream_rq_time_";
+    it = stats.statuses_
+             .emplace(status, StatusStats{scope_.counter(total_prefix + group_string),
+                                          scope_.counter(total_prefix + status_string),
+                                          time_prefix + group_string, time_prefix + status_string})
+             .first;
+  }
+
+  const StatusStats& status_stats = it->second;
+  stats.upstream_rq_total_.inc();
+  status_stats.upstream_rq_total_group_.inc();
+  status_stats.upstream_rq_total_status_.inc();
+
+  scope_.deliverTimingToSinks(stats.upstream_rq_time_, latency);
+  scope_.deliverTimingToSinks(status_stats.upstream_rq_time_group_, latency);
+  scope_.deliverTimingToSinks(status_stats.upstream_rq_time_status_, latency);
+}
+
+void DynamoStats::chargePartition(const std::string& table, const std::string& operation,
+                                  const std::string& partition_id, uint64_t capacity) {
+  ThreadLocalCache& cache = this->cache();
+  std::unordered_map<std::string, Stats::Counter*>& partitions =
+      entityStats(cache, "table", table).partitions_[operation];
+  auto it = partitions.find(partition_id);
+  if (it == partitions.end()) {
+    cache.entries_++;
+    it = partitions
+             .emplace(partition_id, &scope_.counter(Utility::buildPartitionStatString(
+                                        prefix_, table, operation, partition_id)))
+             .first;
+  }
+
+  it->second->add(capacity);
+}
+
 Http::FilterHeadersStatus DynamoFilter::decodeHeaders(Http::HeaderMap& headers, bool) {
   if (enabled_) {
     start_decode_ = std::chrono::steady_clock::now();
     operation_ = RequestParser::parseOperation(headers);
+    request_body_.reset(new RequestBodyParser(operation_));
   }
 
   return Http::FilterHeadersStatus::Continue;
 }
 
 Http::FilterDataStatus DynamoFilter::decodeData(Buffer::Instance& data, bool end_stream) {
-  if (enabled_ && end_stream) {
-    onDecodeComplete(data);
+  if (enabled_) {
+    request_body_->parse(data);
+    if (end_stream) {
+      onDecodeComplete();
+    }
   }
 
-  if (end_stream) {
-    return Http::FilterDataStatus::Continue;
-  } else {
-    return Http::FilterDataStatus::StopIterationAndBuffer;
-  }
+  return Http::FilterDataStatus::Continue;
 }
 
 Http::FilterTrailersStatus DynamoFilter::decodeTrailers(Http::HeaderMap&) {
   if (enabled_) {
-    Buffer::OwnedImpl empty;
-    onDecodeComplete(empty);
+    onDecodeComplete();
   }
 
   return Http::FilterTrailersStatus::Continue;
 }
 
-void DynamoFilter::onDecodeComplete(const Buffer::Instance& data) {
-  std::string body = buildBody(decoder_callbacks_->decodingBuffer(), data);
-  if (!body.empty()) {
-    try {
-      Json::ObjectSharedPtr json_body = Json::Factory::loadFromString(body);
-      table_descriptor_ = RequestParser::parseTable(operation_, *json_body);
-    } catch (const Json::Exception& jsonEx) {
+void DynamoFilter::onDecodeComplete() {
+  if (!request_body_->empty()) {
+    if (request_body_->complete()) {
+      table_descriptor_ = request_body_->table();
+    } else {
       // Body parsing failed. This should not happen, just put a stat for that.
-      stats_.counter(fmt::format("{}invalid_req_body", stat_prefix_)).inc();
+      stats_->scope().counter(fmt::format("{}invalid_req_body", stat_prefix_)).inc();
     }
   }
 }
 
-void DynamoFilter::onEncodeComplete(const Buffer::Instance& data) {
+void DynamoFilter::onEncodeComplete() {
   if (!response_headers_) {
     return;
   }
@@ -69,24 +157,22 @@ void DynamoFilter::onEncodeComplete(const Buffer::Instance& data) {
   uint64_t status = Http::Utility::getResponseStatus(*response_headers_);
   chargeBasicStats(status);
 
-  std::string body = buildBody(encoder_callbacks_->encodingBuffer(), data);
-  if (!body.empty()) {
-    try {
-      Json::ObjectSharedPtr json_body = Json::Factory::loadFromString(body);
-      chargeTablePartitionIdStats(*json_body);
+  if (!response_body_->empty()) {
+    if (response_body_->complete()) {
+      chargeTablePartitionIdStats(*response_body_);
 
       if (Http::CodeUtility::is4xx(status)) {
-        chargeFailureSpecificStats(*json_body);
+        chargeFailureSpecificStats(*response_body_);
       }
       // Batch Operations will always return status 200 for a partial or full success. Check
       // unprocessed keys to determine partial success.
       // http://docs.aws.amazon.com/amazondynamodb/latest/developerguide/Programming.Errors.html#Programming.Errors.BatchOperations
       if (RequestParser::isBatchOperation(operation_)) {
-        chargeUnProcessedKeysStats(*json_body);
+        chargeUnProcessedKeysStats(*response_body_);
       }
-    } catch (const Json::Exception&) {
+    } else {
       // Body parsing failed. This should not happen, just put a stat for that.
-      stats_.counter(fmt::format("{}invalid_resp_body", stat_prefix_)).inc();
+      stats_->scope().counter(fmt::format("{}invalid_resp_body", stat_prefix_)).inc();
     }
   }
 }
@@ -94,10 +180,10 @@ void DynamoFilter::onEncodeComplete(const Buffer::Instance& data) {
 Http::FilterHeadersStatus DynamoFilter::encodeHeaders(Http::HeaderMap& headers, bool end_stream) {
   if (enabled_) {
     response_headers_ = &headers;
+    response_body_.reset(new ResponseBodyParser());
 
     if (end_stream) {
-      Buffer::OwnedImpl empty;
-      onEncodeComplete(empty);
+      onEncodeComplete();
     }
   }
 
@@ -105,124 +191,76 @@ Http::FilterHeadersStatus DynamoFilter::encodeHeaders(Http::HeaderMap& headers,
 }
 
 Http::FilterDataStatus DynamoFilter::encodeData(Buffer::Instance& data, bool end_stream) {
-  if (enabled_ && end_stream) {
-    onEncodeComplete(data);
+  if (enabled_) {
+    response_body_->parse(data);
+    if (end_stream) {
+      onEncodeComplete();
+    }
   }
 
-  if (end_stream) {
-    return Http::FilterDataStatus::Continue;
-  } else {
-    return Http::FilterDataStatus::StopIterationAndBuffer;
-  }
+  return Http::FilterDataStatus::Continue;
 }
 
 Http::FilterTrailersStatus DynamoFilter::encodeTrailers(Http::HeaderMap&) {
   if (enabled_) {
-    Buffer::OwnedImpl empty;
-    onEncodeComplete(empty);
+    onEncodeComplete();
   }
 
   return Http::FilterTrailersStatus::Continue;
 }
 
-std::string DynamoFilter::buildBody(const Buffer::Instance* buffered,
-                                    const Buffer::Instance& last) {
-  std::string body;
-  if (buffered) {
-    uint64_t num_slices = buffered->getRawSlices(nullptr, 0);
-    Buffer::RawSlice slices[num_slices];
-    buffered->getRawSlices(slices, num_slices);
-    for (Buffer::RawSlice& slice : slices) {
-      body.append(static_cast<const char*>(slice.mem_), slice.len_);
-    }
-  }
-
-  uint64_t num_slices = last.getRawSlices(nullptr, 0);
-  Buffer::RawSlice slices[num_slices];
-  last.getRawSlices(slices, num_slices);
-  for (Buffer::RawSlice& slice : slices) {
-    body.append(static_cast<const char*>(slice.mem_), slice.len_);
-  }
-
-  return body;
-}
-
 void DynamoFilter::chargeBasicStats(uint64_t status) {
+  std::chrono::milliseconds latency = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start_decode_);
+
   if (!operation_.empty()) {
-    chargeStatsPerEntity(operation_, "operation", status);
+    stats_->chargeEntity("operation", operation_, status, latency);
   } else {
-    stats_.counter(fmt::format("{}operation_missing", stat_prefix_)).inc();
+    stats_->scope().counter(fmt::format("{}operation_missing", stat_prefix_)).inc();
   }
 
   if (!table_descriptor_.table_name.empty()) {
-    chargeStatsPerEntity(table_descriptor_.table_name, "table", status);
+    stats_->chargeEntity("table", table_descriptor_.table_name, status, latency);
   } else if (table_descriptor_.is_single_table) {
-    stats_.counter(fmt::format("{}table_missing", stat_prefix_)).inc();
+    stats_->scope().counter(fmt::format("{}table_missing", stat_prefix_)).inc();
   } else {
-    stats_.counter(fmt::format("{}multiple_tables", stat_prefix_)).inc();
+    stats_->scope().counter(fmt::format("{}multiple_tables", stat_prefix_)).inc();
   }
 }
 
-void DynamoFilter::chargeStatsPerEntity(const std::string& entity, const std::string& entity_type,
-                                        uint64_t status) {
-  std::chrono::milliseconds latency = std::chrono::duration_cast<std::chrono::milliseconds>(
-      std::chrono::steady_clock::now() - start_decode_);
-
-  std::string group_string =
-      Http::CodeUtility::groupStringForResponseCode(static_cast<Http::Code>(status));
-
-  stats_.counter(fmt::format("{}{}.{}.upstream_rq_total", stat_prefix_, entity_type, entity)).inc();
-  stats_.counter(fmt::format("{}{}.{}.upstream_rq_total_{}", stat_prefix_, entity_type, entity,
-                             group_string)).inc();
-  stats_.counter(fmt::format("{}{}.{}.upstream_rq_total_{}", stat_prefix_, entity_type, entity,
-                             std::to_string(status))).inc();
-
-  stats_.deliverTimingToSinks(
-      fmt::format("{}{}.{}.upstream_rq_time", stat_prefix_, entity_type, entity), latency);
-  stats_.deliverTimingToSinks(
-      fmt::format("{}{}.{}.upstream_rq_time_{}", stat_prefix_, entity_type, entity, group_string),
-      latency);
-  stats_.deliverTimingToSinks(fmt::format("{}{}.{}.upstream_rq_time_{}", stat_prefix_, entity_type,
-                                          entity, std::to_string(status)),
-                              latency);
-}
-
-void DynamoFilter::chargeUnProcessedKeysStats(const Json::Object& json_body) {
-  // The unprocessed keys block contains a list of tables and keys for that table that did not
-  // complete apart of the batch operation. Only the table names will be logged for errors.
-  std::vector<std::string> unprocessed_tables = RequestParser::parseBatchUnProcessedKeys(json_body);
-  for (const std::string& unprocessed_table : unprocessed_tables) {
-    stats_.counter(fmt::format("{}error.{}.BatchFailureUnprocessedKeys", stat_prefix_,
+void DynamoFilter::chargeUnProcessedKeysStats(const ResponseBodyParser& body) {
+  // Only the table names are logged for errors.
+  for (const std::string& unprocessed_table : body.unprocessedTables()) {
+    stats_->scope().counter(fmt::format("{}error.{}.BatchFailureUnprocessedKeys", stat_prefix_,
                                unprocessed_table)).inc();
   }
 }
 
-void DynamoFilter::chargeFailureSpecificStats(const Json::Object& json_body) {
-  std::string error_type = RequestParser::parseErrorType(json_body);
+void DynamoFilter::chargeFailureSpecificStats(const ResponseBodyParser& body) {
+  const std::string& error_type = body.errorType();
 
   if (!error_type.empty()) {
     if (table_descriptor_.table_name.empty()) {
-      stats_.counter(fmt::format("{}error.no_table.{}", stat_prefix_, error_type)).inc();
+      stats_->scope().counter(fmt::format("{}error.no_table.{}", stat_prefix_, error_type)).inc();
     } else {
-      stats_.counter(fmt::format("{}error.{}.{}", stat_prefix_, table_descriptor_.table_name,
-                                 error_type)).inc();
+      stats_->scope()
+          .counter(fmt::format("{}error.{}.{}", stat_prefix_, table_descriptor_.table_name,
+                               error_type))
+          .inc();
     }
   } else {
-    stats_.counter(fmt::format("{}empty_response_body", stat_prefix_)).inc();
+    stats_->scope().counter(fmt::format("{}empty_response_body", stat_prefix_)).inc();
   }
 }
 
-void DynamoFilter::chargeTablePartitionIdStats(const Json::Object& json_body) {
+void DynamoFilter::chargeTablePartitionIdStats(const ResponseBodyParser& body) {
   if (table_descriptor_.table_name.empty() || operation_.empty()) {
     return;
   }
 
-  std::vector<RequestParser::PartitionDescriptor> partitions =
-      RequestParser::parsePartitions(json_body);
-  for (const RequestParser::PartitionDescriptor& partition : partitions) {
-    std::string stats_string = Utility::buildPartitionStatString(
-        stat_prefix_, table_descriptor_.table_name, operation_, partition.partition_id_);
-    stats_.counter(stats_string).add(partition.capacity_);
+  for (const RequestParser::PartitionDescriptor& partition : body.partitions()) {
+    stats_->chargePartition(table_descriptor_.table_name, operation_, partition.partition_id_,
+                            partition.capacity_);
   }
 }
 
@@ -1,28 +1,117 @@
 #pragma once
 
+#include <chrono>
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <unordered_map>
 
 #include "envoy/http/filter.h"
 #include "envoy/runtime/runtime.h"
 #include "envoy/stats/stats.h"
+#include "envoy/thread_local/thread_local.h"
 
 #include "common/dynamo/dynamo_request_parser.h"
-#include "common/json/json_loader.h"
 
 namespace Envoy {
 namespace Dynamo {
 
+/**
+ * Per table and per operation stats of the DynamoDb filter. Stat names are built from request
+ * contents, so the counters and timer names they resolve to are cached on each worker the first
+ * time a table, operation, status code or partition is seen. Each worker's cache holds at most
+ * max_entries entries and is cleared when it fills up, so that a client that uses many tables
+ * cannot grow it without bound.
+ */
+class DynamoStats {
+public:
+  DynamoStats(const std::string& stat_prefix, Stats::Scope& scope, ThreadLocal::Instance& tls,
+              uint32_t max_entries = DEFAULT_MAX_ENTRIES);
+
+  /**
+   * Charge the request count and latency stats of an operation or table.
+   * @param entity_type supplies either "operation" or "table".
+   * @param entity supplies the operation or table name.
+   * @param status supplies the response status code.
+   * @param latency supplies the request latency.
+   */
+  void chargeEntity(const std::string& entity_type, const std::string& entity, uint64_t status,
+                    std::chrono::milliseconds latency);
+
+  /**
+   * Charge the consumed capacity of a table partition.
+   * @see Utility::buildPartitionStatString() for the stat name.
+   */
+  void chargePartition(const std::string& table, const std::string& operation,
+                       const std::string& partition_id, uint64_t capacity);
+
+  /**
+   * @return the number of entries in the calling worker's cache.
+   */
+  uint32_t cachedEntries();
+
+  Stats::Scope& scope() { return scope_; }
+  const std::string& prefix() const { return prefix_; }
+
+  static const uint32_t DEFAULT_MAX_ENTRIES = 1024;
+
+private:
+  struct StatusStats {
+    Stats::Counter& upstream_rq_total_group_;
+    Stats::Counter& upstream_rq_total_status_;
+    const std::string upstream_rq_time_group_;
+    const std::string upstream_rq_time_status_;
+  };
+
+  struct EntityStats {
+    EntityStats(Stats::Scope& scope, const std::string& entity_prefix);
+
+    const std::string entity_prefix_;
+    Stats::Counter& upstream_rq_total_;
+    const std::string upstream_rq_time_;
+    std::unordered_map<uint64_t, StatusStats> statuses_;
+    // Partition capacity counters of a table, by operation and then by partition id.
+    std::unordered_map<std::string, std::unordered_map<std::string, Stats::Counter*>> partitions_;
+  };
+
+  typedef std::unique_ptr<EntityStats> EntityStatsPtr;
+
+  struct ThreadLocalCache : public ThreadLocal::ThreadLocalObject {
+    // ThreadLocal::ThreadLocalObject
+    void shutdown() override {}
+
+    std::unordered_map<std::string, EntityStatsPtr> operations_;
+    std::unordered_map<std::string, EntityStatsPtr> tables_;
+    uint32_t entries_{};
+  };
+
+  /**
+   * @return the calling worker's cache, cleared first if it is full.
+   */
+  ThreadLocalCache& cache();
+  EntityStats& entityStats(ThreadLocalCache& cache, const std::string& entity_type,
+                           const std::string& entity);
+
+  const std::string prefix_;
+  Stats::Scope& scope_;
+  ThreadLocal::Instance& tls_;
+  const uint32_t tls_slot_;
+  const uint32_t max_entries_;
+};
+
+typedef std::shared_ptr<DynamoStats> DynamoStatsSharedPtr;
+
 /**
  * DynamoDb filter to process egress request to dynamo and capture comprehensive stats
  * It captures RPS/latencies:
  *  1) Per table per response code (and group of response codes, e.g., 2xx/3xx/etc)
  *  2) Per operation per response code (and group of response codes, e.g., 2xx/3xx/etc)
+ * Request and response bodies are parsed as they stream through, without being buffered.
  */
 class DynamoFilter : public Http::StreamFilter {
 public:
-  DynamoFilter(Runtime::Loader& runtime, const std::string& stat_prefix, Stats::Store& stats)
-      : runtime_(runtime), stat_prefix_(stat_prefix + "dynamodb."), stats_(stats) {
+  DynamoFilter(Runtime::Loader& runtime, DynamoStatsSharedPtr stats)
+      : runtime_(runtime), stats_(stats), stat_prefix_(stats->prefix()) {
     enabled_ = runtime_.snapshot().featureEnabled("dynamodb.filter_enabled", 100);
   }
 
@@ -46,23 +135,22 @@ public:
   }
 
 private:
-  void onDecodeComplete(const Buffer::Instance& data);
-  void onEncodeComplete(const Buffer::Instance& data);
-  std::string buildBody(const Buffer::Instance* buffered, const Buffer::Instance& last);
+  void onDecodeComplete();
+  void onEncodeComplete();
   void chargeBasicStats(uint64_t status);
-  void chargeStatsPerEntity(const std::string& entity, const std::string& entity_type,
-                            uint64_t status);
-  void chargeFailureSpecificStats(const Json::Object& json_body);
-  void chargeUnProcessedKeysStats(const Json::Object& json_body);
-  void chargeTablePartitionIdStats(const Json::Object& json_body);
+  void chargeFailureSpecificStats(const ResponseBodyParser& body);
+  void chargeUnProcessedKeysStats(const ResponseBodyParser& body);
+  void chargeTablePartitionIdStats(const ResponseBodyParser& body);
 
   Runtime::Loader& runtime_;
-  std::string stat_prefix_;
-  Stats::Store& stats_;
+  DynamoStatsSharedPtr stats_;
+  const std::string& stat_prefix_;
 
   bool enabled_{};
   std::string operation_{};
   RequestParser::TableDescriptor table_descriptor_{"", true};
+  std::unique_ptr<RequestBodyParser> request_body_;
+  std::unique_ptr<ResponseBodyParser> response_body_;
   std::string error_type_{};
   MonotonicTime start_decode_;
   Http::HeaderMap* response_headers_;
@@ -2,9 +2,11 @@
 
 #include <cmath>
 #include <cstdint>
+#include <cstdlib>
 #include <string>
 #include <vector>
 
+#include "common/common/assert.h"
 #include "common/common/utility.h"
 
 namespace Envoy {
@@ -65,81 +67,447 @@ std::string RequestParser::parseOperation(const Http::HeaderMap& headerMap) {
   return operation;
 }
 
-RequestParser::TableDescriptor RequestParser::parseTable(const std::string& operation,
-                                                         const Json::Object& json_data) {
-  TableDescriptor table{"", true};
+bool RequestParser::isSingleTableOperation(const std::string& operation) {
+  return find(SINGLE_TABLE_OPERATIONS.begin(), SINGLE_TABLE_OPERATIONS.end(), operation) !=
+         SINGLE_TABLE_OPERATIONS.end();
+}
 
-  // Simple operations on a single table, have "TableName" explicitly specified.
-  if (find(SINGLE_TABLE_OPERATIONS.begin(), SINGLE_TABLE_OPERATIONS.end(), operation) !=
-      SINGLE_TABLE_OPERATIONS.end()) {
-    table.table_name = json_data.getString("TableName", "");
-  } else if (find(BATCH_OPERATIONS.begin(), BATCH_OPERATIONS.end(), operation) !=
-             BATCH_OPERATIONS.end()) {
-    Json::ObjectSharedPtr tables = json_data.getObject("RequestItems", true);
-    tables->iterate([&table](const std::string& key, const Json::Object&) {
-      if (table.table_name.empty()) {
-        table.table_name = key;
+bool RequestParser::isBatchOperation(const std::string& operation) {
+  return find(BATCH_OPERATIONS.begin(), BATCH_OPERATIONS.end(), operation) !=
+         BATCH_OPERATIONS.end();
+}
+
+std::string RequestParser::parseErrorType(const std::string& type) {
+  if (type.empty()) {
+    return "";
+  }
+
+  for (const std::string& supported_error_type : SUPPORTED_ERROR_TYPES) {
+    if (StringUtil::endsWith(type, supported_error_type)) {
+      return supported_error_type;
+    }
+  }
+
+  return "";
+}
+
+namespace {
+
+bool isJsonWhitespace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+} // namespace
+
+void JsonBodyParser::parse(const Buffer::Instance& data) {
+  uint64_t num_slices = data.getRawSlices(nullptr, 0);
+  Buffer::RawSlice slices[num_slices];
+  data.getRawSlices(slices, num_slices);
+  for (const Buffer::RawSlice& slice : slices) {
+    parse(static_cast<const char*>(slice.mem_), slice.len_);
+  }
+}
+
+bool JsonBodyParser::complete() { return !empty_ && state_ == State::Done; }
+
+void JsonBodyParser::parse(const char* data, size_t length) {
+  if (length > 0) {
+    empty_ = false;
+  }
+
+  const char* end = data + length;
+  const char* p = data;
+  while (p < end && state_ != State::Error) {
+    // Strings make up most of a body, so their contents are scanned in bulk.
+    if (state_ == State::String) {
+      p = parseString(p, end);
+      continue;
+    }
+
+    const char c = *p;
+    switch (state_) {
+    case State::Value:
+    case State::FirstValueOrEnd:
+      if (isJsonWhitespace(c)) {
+        break;
+      }
+      if (state_ == State::FirstValueOrEnd && c == ']') {
+        parseSeparator(c);
       } else {
-        if (table.table_name != key) {
-          table.table_name = "";
-          table.is_single_table = false;
-          return false;
-        }
+        parseValueStart(c);
+      }
+      break;
+    case State::FirstKeyOrEnd:
+    case State::Key:
+      if (isJsonWhitespace(c)) {
+        break;
+      }
+      if (c == '"') {
+        in_key_ = true;
+        capture_ = tracked();
+        value_.clear();
+        state_ = State::String;
+      } else if (state_ == State::FirstKeyOrEnd && c == '}') {
+        parseSeparator(c);
+      } else {
+        state_ = State::Error;
+      }
+      break;
+    case State::Colon:
+      if (c == ':') {
+        state_ = State::Value;
+      } else if (!isJsonWhitespace(c)) {
+        state_ = State::Error;
       }
-      return true;
-    });
+      break;
+    case State::CommaOrEnd:
+      if (!isJsonWhitespace(c)) {
+        parseSeparator(c);
+      }
+      break;
+    case State::StringEscape:
+    case State::StringUnicode:
+      parseEscape(c);
+      break;
+    case State::Literal:
+      parseLiteral(c);
+      break;
+    case State::NumberStart:
+    case State::NumberZero:
+    case State::NumberInteger:
+    case State::NumberFractionStart:
+    case State::NumberFraction:
+    case State::NumberExponentStart:
+    case State::NumberExponentSign:
+    case State::NumberExponent:
+      parseNumber(c);
+      // The character that ends a number belongs to what follows it.
+      if (state_ == State::CommaOrEnd || state_ == State::Done) {
+        continue;
+      }
+      break;
+    case State::Done:
+      if (!isJsonWhitespace(c)) {
+        state_ = State::Error;
+      }
+      break;
+    case State::String:
+    case State::Error:
+      NOT_REACHED;
+    }
+
+    p++;
   }
+}
 
-  return table;
+void JsonBodyParser::parseValueStart(char c) {
+  // The body must be an object.
+  if (containers_.empty() && c != '{') {
+    state_ = State::Error;
+    return;
+  }
+
+  // The top level object itself has no name, so it is not reported.
+  const bool report = !containers_.empty() && tracked();
+  switch (c) {
+  case '{':
+    if (report) {
+      onValue(path_, ValueType::Object, "");
+    }
+    containers_.push_back(Container::Object);
+    state_ = State::FirstKeyOrEnd;
+    break;
+  case '[':
+    if (report) {
+      onValue(path_, ValueType::Array, "");
+    }
+    containers_.push_back(Container::Array);
+    open_arrays_++;
+    state_ = State::FirstValueOrEnd;
+    break;
+  case '"':
+    in_key_ = false;
+    capture_ = report;
+    value_.clear();
+    state_ = State::String;
+    break;
+  case 't':
+  case 'f':
+  case 'n':
+    if (report) {
+      onValue(path_, ValueType::Literal, "");
+    }
+    literal_ = c == 't' ? "rue" : (c == 'f' ? "alse" : "ull");
+    state_ = State::Literal;
+    break;
+  default:
+    if (c != '-' && !isDigit(c)) {
+      state_ = State::Error;
+      return;
+    }
+    capture_ = report;
+    value_.clear();
+    state_ = State::NumberStart;
+    if (c == '-') {
+      if (capture_) {
+        value_.push_back(c);
+      }
+    } else {
+      parseNumber(c);
+    }
+  }
 }
-std::vector<std::string> RequestParser::parseBatchUnProcessedKeys(const Json::Object& json_data) {
-  std::vector<std::string> unprocessed_tables;
-  Json::ObjectSharedPtr tables = json_data.getObject("UnprocessedKeys", true);
-  tables->iterate([&unprocessed_tables](const std::string& key, const Json::Object&) {
-    unprocessed_tables.emplace_back(key);
-    return true;
-  });
-
-  return unprocessed_tables;
+
+const char* JsonBodyParser::parseString(const char* p, const char* end) {
+  const char* start = p;
+  while (p < end && *p != '"' && *p != '\\' && static_cast<uint8_t>(*p) >= 0x20) {
+    p++;
+  }
+  if (capture_) {
+    value_.append(start, p - start);
+  }
+  if (p == end) {
+    return p;
+  }
+
+  if (*p == '\\') {
+    state_ = State::StringEscape;
+  } else if (*p != '"') {
+    // Control characters must be escaped.
+    state_ = State::Error;
+  } else if (in_key_) {
+    if (capture_) {
+      path_.resize(containers_.size());
+      path_.back() = value_;
+    }
+    state_ = State::Colon;
+  } else {
+    if (capture_) {
+      onValue(path_, ValueType::String, value_);
+    }
+    onValueEnd();
+  }
+
+  return p + 1;
 }
-std::string RequestParser::parseErrorType(const Json::Object& json_data) {
-  std::string error_type = json_data.getString("__type", "");
-  if (error_type.empty()) {
-    return "";
+
+void JsonBodyParser::parseEscape(char c) {
+  if (state_ == State::StringUnicode) {
+    uint32_t digit;
+    if (isDigit(c)) {
+      digit = c - '0';
+    } else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+      digit = (c | 0x20) - 'a' + 10;
+    } else {
+      state_ = State::Error;
+      return;
+    }
+
+    code_point_ = code_point_ << 4 | digit;
+    if (++hex_digits_ < 4) {
+      return;
+    }
+
+    // Each escaped UTF-16 code unit is encoded separately. The values used for stats, such as table
+    // names, are ASCII.
+    if (capture_) {
+      if (code_point_ < 0x80) {
+        value_.push_back(code_point_);
+      } else if (code_point_ < 0x800) {
+        value_.push_back(0xc0 | code_point_ >> 6);
+        value_.push_back(0x80 | (code_point_ & 0x3f));
+      } else {
+        value_.push_back(0xe0 | code_point_ >> 12);
+        value_.push_back(0x80 | (code_point_ >> 6 & 0x3f));
+        value_.push_back(0x80 | (code_point_ & 0x3f));
+      }
+    }
+    state_ = State::String;
+    return;
   }
 
-  for (const std::string& supported_error_type : SUPPORTED_ERROR_TYPES) {
-    if (StringUtil::endsWith(error_type, supported_error_type)) {
-      return supported_error_type;
+  char decoded;
+  switch (c) {
+  case '"':
+  case '\\':
+  case '/':
+    decoded = c;
+    break;
+  case 'b':
+    decoded = '\b';
+    break;
+  case 'f':
+    decoded = '\f';
+    break;
+  case 'n':
+    decoded = '\n';
+    break;
+  case 'r':
+    decoded = '\r';
+    break;
+  case 't':
+    decoded = '\t';
+    break;
+  case 'u':
+    code_point_ = 0;
+    hex_digits_ = 0;
+    state_ = State::StringUnicode;
+    return;
+  default:
+    state_ = State::Error;
+    return;
+  }
+
+  if (capture_) {
+    value_.push_back(decoded);
+  }
+  state_ = State::String;
+}
+
+void JsonBodyParser::parseNumber(char c) {
+  // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+  State next = State::Error;
+  switch (state_) {
+  case State::NumberStart:
+    if (c == '0') {
+      next = State::NumberZero;
+    } else if (isDigit(c)) {
+      next = State::NumberInteger;
+    }
+    break;
+  case State::NumberZero:
+  case State::NumberInteger:
+    if (c == '.') {
+      next = State::NumberFractionStart;
+    } else if (c == 'e' || c == 'E') {
+      next = State::NumberExponentStart;
+    } else if (isDigit(c) && state_ == State::NumberInteger) {
+      next = State::NumberInteger;
     }
+    break;
+  case State::NumberFractionStart:
+  case State::NumberFraction:
+    if (isDigit(c)) {
+      next = State::NumberFraction;
+    } else if ((c == 'e' || c == 'E') && state_ == State::NumberFraction) {
+      next = State::NumberExponentStart;
+    }
+    break;
+  case State::NumberExponentStart:
+    if (c == '+' || c == '-') {
+      next = State::NumberExponentSign;
+    } else if (isDigit(c)) {
+      next = State::NumberExponent;
+    }
+    break;
+  case State::NumberExponentSign:
+  case State::NumberExponent:
+    if (isDigit(c)) {
+      next = State::NumberExponent;
+    }
+    break;
+  default:
+    NOT_REACHED;
   }
 
-  return "";
+  if (next != State::Error) {
+    if (capture_) {
+      value_.push_back(c);
+    }
+    state_ = next;
+    return;
+  }
+
+  // Any other character ends the number if it is complete.
+  if (state_ == State::NumberZero || state_ == State::NumberInteger ||
+      state_ == State::NumberFraction || state_ == State::NumberExponent) {
+    if (capture_) {
+      onValue(path_, ValueType::Number, value_);
+    }
+    onValueEnd();
+  } else {
+    state_ = State::Error;
+  }
 }
 
-bool RequestParser::isBatchOperation(const std::string& operation) {
-  return find(BATCH_OPERATIONS.begin(), BATCH_OPERATIONS.end(), operation) !=
-         BATCH_OPERATIONS.end();
+void JsonBodyParser::parseLiteral(char c) {
+  if (c != *literal_) {
+    state_ = State::Error;
+    return;
+  }
+
+  if (*++literal_ == '\0') {
+    onValueEnd();
+  }
 }
 
-std::vector<RequestParser::PartitionDescriptor>
-RequestParser::parsePartitions(const Json::Object& json_data) {
-  std::vector<RequestParser::PartitionDescriptor> partition_descriptors;
+void JsonBodyParser::parseSeparator(char c) {
+  const Container container = containers_.back();
+  if (c == ',') {
+    state_ = container == Container::Object ? State::Key : State::Value;
+    return;
+  }
 
-  Json::ObjectSharedPtr partitions =
-      json_data.getObject("ConsumedCapacity", true)->getObject("Partitions", true);
-  partitions->iterate([&partition_descriptors, &partitions](const std::string& key,
-                                                            const Json::Object&) {
+  if (c != (container == Container::Object ? '}' : ']')) {
+    state_ = State::Error;
+    return;
+  }
+
+  containers_.pop_back();
+  if (container == Container::Array) {
+    open_arrays_--;
+  }
+  if (path_.size() > containers_.size()) {
+    path_.resize(containers_.size());
+  }
+  onValueEnd();
+}
+
+void JsonBodyParser::onValueEnd() {
+  state_ = containers_.empty() ? State::Done : State::CommaOrEnd;
+}
+
+RequestBodyParser::RequestBodyParser(const std::string& operation)
+    : single_table_operation_(RequestParser::isSingleTableOperation(operation)),
+      batch_operation_(RequestParser::isBatchOperation(operation)) {}
+
+void RequestBodyParser::onValue(const std::vector<std::string>& path, ValueType type,
+                                const std::string& value) {
+  // Simple operations on a single table, have "TableName" explicitly specified.
+  if (single_table_operation_) {
+    if (path.size() == 1 && path[0] == "TableName" && type == ValueType::String) {
+      table_.table_name = value;
+    }
+  } else if (batch_operation_) {
+    if (path.size() == 2 && path[0] == "RequestItems" && table_.is_single_table) {
+      if (table_.table_name.empty()) {
+        table_.table_name = path[1];
+      } else if (table_.table_name != path[1]) {
+        table_.table_name = "";
+        table_.is_single_table = false;
+      }
+    }
+  }
+}
+
+void ResponseBodyParser::onValue(const std::vector<std::string>& path, ValueType type,
+                                 const std::string& value) {
+  if (path.size() == 1 && path[0] == "__type" && type == ValueType::String) {
+    error_type_ = RequestParser::parseErrorType(value);
+  } else if (path.size() == 2 && path[0] == "UnprocessedKeys") {
+    // The unprocessed keys block contains a list of tables and keys for that table that did not
+    // complete apart of the batch operation. Only the table names are kept.
+    unprocessed_tables_.push_back(path[1]);
+  } else if (path.size() == 3 && path[0] == "ConsumedCapacity" && path[1] == "Partitions" &&
+             type == ValueType::Number) {
     // For a given partition id, the amount of capacity used is returned in the body as a double.
-    // A stat will be created to track the capacity consumed for the operation, table and partition.
-    // Stats counter only increments by whole numbers, capacity is round up to the nearest integer
-    // to account for this.
-    uint64_t capacity_integer = static_cast<uint64_t>(std::ceil(partitions->getDouble(key, 0.0)));
-    partition_descriptors.emplace_back(key, capacity_integer);
-    return true;
-  });
-
-  return partition_descriptors;
+    // A stat will be created to track the capacity consumed for the operation, table and
+    // partition. Stats counter only increments by whole numbers, capacity is round up to the
+    // nearest integer to account for this.
+    uint64_t capacity_integer =
+        static_cast<uint64_t>(std::ceil(std::strtod(value.c_str(), nullptr)));
+    partitions_.emplace_back(path[2], capacity_integer);
+  }
 }
 
 } // Dynamo
@@ -4,10 +4,10 @@
 #include <string>
 #include <vector>
 
+#include "envoy/buffer/buffer.h"
+#include "envoy/common/pure.h"
 #include "envoy/http/header_map.h"
 
-#include "common/json/json_loader.h"
-
 namespace Envoy {
 namespace Dynamo {
 
@@ -39,65 +39,197 @@ public:
   static std::string parseOperation(const Http::HeaderMap& headerMap);
 
   /**
-   * Parse table name out of data, based on the operation.
-   * @return empty string as TableDescriptor.table_name if table name cannot be parsed out of valid
-   *json data
-   * or if operation is not in the list of operations that we support.
-   *
-   * For simple operations on single table, e.g., GetItem, PutItem, Query etc @return table
-   * name in TableDescriptor.table_name.
-   *
-   * For batch operations, e.g. BatchGetItem/BatchWriteItem, @return table name in
-   *TableDescriptor.table_name if it's only one
-   * table used in all operations, @return empty string in TableDescriptor.table_name and
-   *TableDescriptor.is_single_table=false in case of multiple.
-   *
-   * @throw Json::Exception if data is not in valid Json format.
+   * @return true if the operation is in the set of supported SINGLE_TABLE_OPERATIONS.
+   */
+  static bool isSingleTableOperation(const std::string& operation);
+
+  /**
+   * @return true if the operation is in the set of supported BATCH_OPERATIONS
    */
-  static TableDescriptor parseTable(const std::string& operation, const Json::Object& json_data);
+  static bool isBatchOperation(const std::string& operation);
 
   /**
-   * Parse error details which might be provided for a given response code.
-   * @return empty string if cannot get error details.
+   * Map the __type of an error response to one of the supported error types.
+   * @return empty string if the error type is not supported.
    * For the full list of errors, see
    * http://docs.aws.amazon.com/amazondynamodb/latest/APIReference/CommonErrors.html
    * Operation specific errors, for example, error section of
    * http://docs.aws.amazon.com/amazondynamodb/latest/APIReference/API_UpdateItem.html
-   *
-   * @throw Json::Exception if data is not in valid Json format.
    */
-  static std::string parseErrorType(const Json::Object& json_data);
+  static std::string parseErrorType(const std::string& type);
+
+private:
+  static const Http::LowerCaseString X_AMZ_TARGET;
+  static const std::vector<std::string> SINGLE_TABLE_OPERATIONS;
+  static const std::vector<std::string> BATCH_OPERATIONS;
+
+  // http://docs.aws.amazon.com/amazondynamodb/latest/developerguide/Programming.Errors.html
+  static const std::vector<std::string> SUPPORTED_ERROR_TYPES;
+
+  RequestParser() {}
+};
+
+/**
+ * Incremental JSON parser for request and response bodies. The body is validated as it passes
+ * through the filter one slice at a time, so it never has to be buffered. Object members up to
+ * MaxTrackedDepth levels deep are reported to the subclass; anything nested deeper or inside an
+ * array, such as the items of a batch request, is validated without being copied.
+ */
+class JsonBodyParser {
+public:
+  virtual ~JsonBodyParser() {}
 
   /**
-   * Parse unprocessed keys for batch operation results.
-   * @return empty set if there are no unprocessed keys or a set of table names that did not get
-   * processed in the batch operation.
+   * Parse the next part of the body.
+   * @param data supplies the data, which is not modified.
    */
-  static std::vector<std::string> parseBatchUnProcessedKeys(const Json::Object& json_data);
+  void parse(const Buffer::Instance& data);
 
   /**
-   * @return true if the operation is in the set of supported BATCH_OPERATIONS
+   * Called at the end of the body.
+   * @return bool true if the body was a single complete JSON object, false if it was invalid
+   *         JSON or empty.
    */
-  static bool isBatchOperation(const std::string& operation);
+  bool complete();
 
   /**
-   * Parse the Partition ids and the consumed capacity from the body.
-   * @return empty set if there is no partition data or a set of partition data containing
-   * the partition id as a string and the capacity consumed as an integer.
-   *
-   * @throw Json::Exception if data is not in valid Json format.
+   * @return bool whether no body data has been seen.
    */
-  static std::vector<PartitionDescriptor> parsePartitions(const Json::Object& json_data);
+  bool empty() const { return empty_; }
+
+protected:
+  enum class ValueType { Object, Array, String, Number, Literal };
+
+  // The depth of the deepest values that are reported to onValue().
+  static const uint32_t MaxTrackedDepth = 3;
+
+  /**
+   * Called when an object member up to MaxTrackedDepth levels deep starts.
+   * @param path supplies the member names from the top level object down to the value.
+   * @param type supplies the type of the value.
+   * @param value supplies the decoded string or the text of the number for String and Number
+   *        values. It is empty for other types, whose members are reported separately.
+   */
+  virtual void onValue(const std::vector<std::string>& path, ValueType type,
+                       const std::string& value) PURE;
 
 private:
-  static const Http::LowerCaseString X_AMZ_TARGET;
-  static const std::vector<std::string> SINGLE_TABLE_OPERATIONS;
-  static const std::vector<std::string> BATCH_OPERATIONS;
+  enum class State {
+    Value,
+    FirstValueOrEnd,
+    FirstKeyOrEnd,
+    Key,
+    Colon,
+    CommaOrEnd,
+    String,
+    StringEscape,
+    StringUnicode,
+    Literal,
+    NumberStart,
+    NumberZero,
+    NumberInteger,
+    NumberFractionStart,
+    NumberFraction,
+    NumberExponentStart,
+    NumberExponentSign,
+    NumberExponent,
+    Done,
+    Error
+  };
 
-  // http://docs.aws.amazon.com/amazondynamodb/latest/developerguide/Programming.Errors.html
-  static const std::vector<std::string> SUPPORTED_ERROR_TYPES;
+  void parse(const char* data, size_t length);
+  void parseValueStart(char c);
+  const char* parseString(const char* p, const char* end);
+  void parseEscape(char c);
+  void parseNumber(char c);
+  void parseLiteral(char c);
+  void parseSeparator(char c);
+  void onValueEnd();
 
-  RequestParser() {}
+  /**
+   * @return bool whether the members of the innermost container are reported.
+   */
+  bool tracked() const { return open_arrays_ == 0 && containers_.size() <= MaxTrackedDepth; }
+
+  enum class Container { Object, Array };
+
+  State state_{State::Value};
+  bool empty_{true};
+  // The open objects and arrays, innermost last.
+  std::vector<Container> containers_;
+  uint32_t open_arrays_{};
+  // The member names leading to the current value, while it is tracked.
+  std::vector<std::string> path_;
+  // Whether the current string is a member name.
+  bool in_key_{};
+  // Whether the current string or number is copied into value_.
+  bool capture_{};
+  std::string value_;
+  uint32_t code_point_{};
+  uint32_t hex_digits_{};
+  const char* literal_{};
+};
+
+/**
+ * Extracts the table name from a request body, based on the operation.
+ *
+ * For simple operations on single table, e.g., GetItem, PutItem, Query etc the table name is
+ * taken from TableName.
+ *
+ * For batch operations, e.g. BatchGetItem/BatchWriteItem, the table name is returned if it's
+ * only one table used in all operations. In case of multiple tables the table name is empty and
+ * TableDescriptor.is_single_table is false.
+ *
+ * Other operations and bodies without the relevant fields leave the table name empty.
+ */
+class RequestBodyParser : public JsonBodyParser {
+public:
+  RequestBodyParser(const std::string& operation);
+
+  const RequestParser::TableDescriptor& table() const { return table_; }
+
+private:
+  // JsonBodyParser
+  void onValue(const std::vector<std::string>& path, ValueType type,
+               const std::string& value) override;
+
+  const bool single_table_operation_;
+  const bool batch_operation_;
+  RequestParser::TableDescriptor table_{"", true};
+};
+
+/**
+ * Extracts the error type, the unprocessed tables of batch operations and the consumed capacity
+ * per partition from a response body.
+ */
+class ResponseBodyParser : public JsonBodyParser {
+public:
+  /**
+   * @return empty string if the response has no supported error type.
+   */
+  const std::string& errorType() const { return error_type_; }
+
+  /**
+   * @return the table names that did not get processed in a batch operation.
+   */
+  const std::vector<std::string>& unprocessedTables() const { return unprocessed_tables_; }
+
+  /**
+   * @return the partition ids and the capacity consumed in each of them, rounded up to the
+   *         nearest integer.
+   */
+  const std::vector<RequestParser::PartitionDescriptor>& partitions() const {
+    return partitions_;
+  }
+
+private:
+  // JsonBodyParser
+  void onValue(const std::vector<std::string>& path, ValueType type,
+               const std::string& value) override;
+
+  std::string error_type_;
+  std::vector<std::string> unprocessed_tables_;
+  std::vector<RequestParser::PartitionDescriptor> partitions_;
 };
 
 } // Dynamo
@@ -3,16 +3,17 @@
 #include <chrono>
 #include <cstdint>
 #include <functional>
-#include <mutex>
 #include <string>
 #include <vector>
 
 #include "envoy/network/listen_socket.h"
 #include "envoy/network/listener.h"
 
+#include "common/common/utility.h"
 #include "common/event/file_event_impl.h"
 #include "common/event/signal_impl.h"
 #include "common/event/timer_impl.h"
+#include "common/event/timer_wheel.h"
 #include "common/filesystem/watcher_impl.h"
 #include "common/network/connection_impl.h"
 #include "common/network/dns_impl.h"
@@ -24,6 +25,9 @@
 namespace Envoy {
 namespace Event {
 
+const std::chrono::milliseconds DispatcherImpl::LoadProbeInterval{100};
+const std::chrono::milliseconds DispatcherImpl::CoarseTimerResolution{10};
+
 DispatcherImpl::DispatcherImpl()
     : base_(event_base_new()),
       deferred_delete_timer_(createTimer([this]() -> void { clearDeferredDeleteList(); })),
@@ -41,6 +45,9 @@ void DispatcherImpl::clearDeferredDeleteList() {
   }
 
   log_trace("clearing deferred deletion list (size={})", num_to_delete);
+  if (stats_scope_) {
+    stats_scope_->deliverHistogramToSinks(deferred_delete_size_stat_, num_to_delete);
+  }
 
   // Swap the current deletion vector so that if we do deferred delete while we are deleting, we
   // use the other vector. We will get another callback to delete that vector.
@@ -76,7 +83,8 @@ DispatcherImpl::createSslClientConnection(Ssl::ClientContext& ssl_ctx,
 
 Network::DnsResolverSharedPtr DispatcherImpl::createDnsResolver(
     const std::vector<Network::Address::InstanceConstSharedPtr>& resolvers) {
-  return Network::DnsResolverSharedPtr{new Network::DnsResolverImpl(*this, resolvers)};
+  return Network::DnsResolverSharedPtr{
+      new Network::DnsResolverImpl(*this, resolvers, std::make_shared<Network::DnsCacheImpl>())};
 }
 
 FileEventPtr DispatcherImpl::createFileEvent(int fd, FileReadyCb cb, FileTriggerType trigger,
@@ -108,6 +116,14 @@ DispatcherImpl::createSslListener(Network::ConnectionHandler& conn_handler,
 
 TimerPtr DispatcherImpl::createTimer(TimerCb cb) { return TimerPtr{new TimerImpl(*this, cb)}; }
 
+TimerPtr DispatcherImpl::createCoarseTimer(TimerCb cb) {
+  if (!coarse_timer_wheel_) {
+    coarse_timer_wheel_.reset(
+        new TimerWheel(*this, CoarseTimerResolution, ProdMonotonicTimeSource::instance_));
+  }
+  return coarse_timer_wheel_->createTimer(cb);
+}
+
 void DispatcherImpl::deferredDelete(DeferredDeletablePtr&& to_delete) {
   current_to_delete_->emplace_back(std::move(to_delete));
   log_trace("item added to deferred deletion list (size={})", current_to_delete_->size());
@@ -122,15 +138,19 @@ SignalEventPtr DispatcherImpl::listenForSignal(int signal_num, SignalCb cb) {
   return SignalEventPtr{new SignalEventImpl(*this, signal_num, cb)};
 }
 
-void DispatcherImpl::post(std::function<void()> callback) {
-  bool do_post;
-  {
-    std::unique_lock<std::mutex> lock(post_lock_);
-    do_post = post_callbacks_.empty();
-    post_callbacks_.push_back(callback);
-  }
+void DispatcherImpl::initializeStats(Stats::Scope& scope, const std::string& prefix) {
+  stats_scope_ = &scope;
+  loop_delay_stat_ = prefix + "dispatcher.loop_delay_us";
+  post_queue_depth_stat_ = prefix + "dispatcher.post_queue_depth";
+  deferred_delete_size_stat_ = prefix + "dispatcher.deferred_delete_size";
+  load_probe_timer_ = createTimer([this]() -> void { onLoadProbe(); });
+  armLoadProbe();
+}
 
-  if (do_post) {
+void DispatcherImpl::post(std::function<void()> callback) {
+  // Only the post that finds the queue empty needs to wake up the dispatcher. Every later post is
+  // picked up by the same run of the queue.
+  if (post_callbacks_.push(std::unique_ptr<PostCallback>{new PostCallback(std::move(callback))})) {
     post_timer_->enableTimer(std::chrono::milliseconds(0));
   }
 }
@@ -140,22 +160,53 @@ void DispatcherImpl::run(RunType type) {
   // callbacks that have to get run before the initial event loop starts running. libevent does
   // not gaurantee that events are run in any particular order. So even if we post() and call
   // event_base_once() before some other event, the other event might get called first.
+  invalidateLoopTime();
   runPostCallbacks();
 
   event_base_loop(base_.get(), type == RunType::NonBlock ? EVLOOP_NONBLOCK : 0);
 }
 
+MonotonicTime DispatcherImpl::LoopTimeSource::currentTime() {
+  if (!valid_) {
+    time_ = ProdMonotonicTimeSource::instance_.currentTime();
+    valid_ = true;
+  }
+  return time_;
+}
+
 void DispatcherImpl::runPostCallbacks() {
-  std::unique_lock<std::mutex> lock(post_lock_);
-  while (!post_callbacks_.empty()) {
-    std::function<void()> callback = post_callbacks_.front();
-    post_callbacks_.pop_front();
-
-    lock.unlock();
-    callback();
-    lock.lock();
+  // Callbacks posted while running a batch are run before returning, in the order they were
+  // posted. The first of them found the queue empty and also enabled the post timer, which will
+  // then find nothing to do.
+  std::vector<std::unique_ptr<PostCallback>> callbacks = post_callbacks_.popAll();
+  if (stats_scope_ && !callbacks.empty()) {
+    stats_scope_->deliverHistogramToSinks(post_queue_depth_stat_, callbacks.size());
+  }
+  while (!callbacks.empty()) {
+    for (std::unique_ptr<PostCallback>& callback : callbacks) {
+      callback->callback_();
+    }
+    callbacks = post_callbacks_.popAll();
   }
 }
 
+void DispatcherImpl::armLoadProbe() {
+  load_probe_due_ = ProdMonotonicTimeSource::instance_.currentTime() + LoadProbeInterval;
+  load_probe_timer_->enableTimer(LoadProbeInterval);
+}
+
+void DispatcherImpl::onLoadProbe() {
+  // The probe timer is ready as soon as it is due, but is only handled once the events ahead of it
+  // in the same loop iteration have run. How late it runs is therefore the time a ready event
+  // waits, which grows with the length of the loop iterations of a busy thread.
+  const MonotonicTime now = ProdMonotonicTimeSource::instance_.currentTime();
+  const uint64_t delay_us =
+      now > load_probe_due_
+          ? std::chrono::duration_cast<std::chrono::microseconds>(now - load_probe_due_).count()
+          : 0;
+  stats_scope_->deliverHistogramToSinks(loop_delay_stat_, delay_us);
+  armLoadProbe();
+}
+
 } // Event
 } // Envoy
@@ -1,21 +1,27 @@
 #pragma once
 
+#include <chrono>
 #include <cstdint>
 #include <functional>
-#include <list>
-#include <mutex>
+#include <memory>
+#include <string>
 #include <vector>
 
+#include "envoy/common/time.h"
 #include "envoy/event/deferred_deletable.h"
 #include "envoy/event/dispatcher.h"
 #include "envoy/network/connection_handler.h"
+#include "envoy/stats/stats.h"
 
 #include "common/common/logger.h"
+#include "common/common/mpsc_queue.h"
 #include "common/event/libevent.h"
 
 namespace Envoy {
 namespace Event {
 
+class TimerWheel;
+
 /**
  * libevent implementation of Event::Dispatcher.
  */
@@ -29,6 +35,12 @@ public:
    */
   event_base& base() { return *base_; }
 
+  /**
+   * Invalidate the cached loop time. This is called before every event callback is run, so that
+   * the clock is read at most once per event and only if the loop time is used.
+   */
+  void invalidateLoopTime() { loop_time_source_.valid_ = false; }
+
   // Event::Dispatcher
   void clearDeferredDeleteList() override;
   Network::ClientConnectionPtr
@@ -50,24 +62,69 @@ public:
                                          Network::ListenerCallbacks& cb, Stats::Scope& scope,
                                          const Network::ListenerOptions& listener_options) override;
   TimerPtr createTimer(TimerCb cb) override;
+  TimerPtr createCoarseTimer(TimerCb cb) override;
   void deferredDelete(DeferredDeletablePtr&& to_delete) override;
   void exit() override;
   SignalEventPtr listenForSignal(int signal_num, SignalCb cb) override;
+  void initializeStats(Stats::Scope& scope, const std::string& prefix) override;
+  MonotonicTimeSource& loopTimeSource() override { return loop_time_source_; }
   void post(std::function<void()> callback) override;
   void run(RunType type) override;
 
+  /**
+   * Interval of the timer used to measure how long ready events wait to be handled.
+   */
+  static const std::chrono::milliseconds LoadProbeInterval;
+
+  /**
+   * Resolution of the timer wheel that backs coarse timers.
+   */
+  static const std::chrono::milliseconds CoarseTimerResolution;
+
 private:
+  /**
+   * A posted callback, linked intrusively into the post queue.
+   */
+  struct PostCallback {
+    PostCallback(std::function<void()>&& callback) : callback_(std::move(callback)) {}
+
+    std::function<void()> callback_;
+    PostCallback* next_{};
+  };
+
+  /**
+   * Time source that caches the monotonic clock until the next event callback runs.
+   */
+  struct LoopTimeSource : public MonotonicTimeSource {
+    // MonotonicTimeSource
+    MonotonicTime currentTime() override;
+
+    MonotonicTime time_;
+    bool valid_{};
+  };
+
   void runPostCallbacks();
+  void armLoadProbe();
+  void onLoadProbe();
 
   Libevent::BasePtr base_;
+  LoopTimeSource loop_time_source_;
   TimerPtr deferred_delete_timer_;
   TimerPtr post_timer_;
   std::vector<DeferredDeletablePtr> to_delete_1_;
   std::vector<DeferredDeletablePtr> to_delete_2_;
   std::vector<DeferredDeletablePtr>* current_to_delete_;
-  std::mutex post_lock_;
-  std::list<std::function<void()>> post_callbacks_;
+  MpscQueue<PostCallback> post_callbacks_;
   bool deferred_deleting_{};
+  // Set by initializeStats().
+  Stats::Scope* stats_scope_{};
+  std::string loop_delay_stat_;
+  std::string post_queue_depth_stat_;
+  std::string deferred_delete_size_stat_;
+  TimerPtr load_probe_timer_;
+  MonotonicTime load_probe_due_;
+  // Created on first use. Declared last so that it is destroyed before the timers above.
+  std::unique_ptr<TimerWheel> coarse_timer_wheel_;
 };
 
 } // Event
@@ -8,10 +8,12 @@ namespace Envoy {
 namespace Event {
 
 SignalEventImpl::SignalEventImpl(DispatcherImpl& dispatcher, int signal_num, SignalCb cb)
-    : cb_(cb) {
+    : dispatcher_(dispatcher), cb_(cb) {
   evsignal_assign(&raw_event_, &dispatcher.base(),
                   signal_num, [](evutil_socket_t, short, void* arg) -> void {
-                    static_cast<SignalEventImpl*>(arg)->cb_();
+                    SignalEventImpl* event = static_cast<SignalEventImpl*>(arg);
+                    event->dispatcher_.invalidateLoopTime();
+                    event->cb_();
                   }, this);
   evsignal_add(&raw_event_, nullptr);
 }
@@ -10,10 +10,12 @@
 namespace Envoy {
 namespace Event {
 
-TimerImpl::TimerImpl(DispatcherImpl& dispatcher, TimerCb cb) : cb_(cb) {
+TimerImpl::TimerImpl(DispatcherImpl& dispatcher, TimerCb cb) : dispatcher_(dispatcher), cb_(cb) {
   ASSERT(cb_);
   evtimer_assign(&raw_event_, &dispatcher.base(), [](evutil_socket_t, short, void* arg) -> void {
-    static_cast<TimerImpl*>(arg)->cb_();
+    TimerImpl* timer = static_cast<TimerImpl*>(arg);
+    timer->dispatcher_.invalidateLoopTime();
+    timer->cb_();
   }, this);
 }
 
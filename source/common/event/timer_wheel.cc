@@ -0,0 +1,105 @@
+#include "common/event/timer_wheel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+#include "common/common/assert.h"
+
+namespace Envoy {
+namespace Event {
+
+const uint64_t TimerWheel::NUM_SLOTS;
+
+TimerWheel::TimerWheel(Dispatcher& dispatcher, std::chrono::milliseconds resolution,
+                       MonotonicTimeSource& time_source)
+    : resolution_(resolution), time_source_(time_source), start_time_(time_source.currentTime()),
+      tick_timer_(dispatcher.createTimer([this]() -> void { onTick(); })), slots_(NUM_SLOTS) {
+  ASSERT(resolution_.count() > 0);
+}
+
+TimerWheel::~TimerWheel() { ASSERT(pending_timers_ == 0); }
+
+TimerPtr TimerWheel::createTimer(TimerCb cb) { return TimerPtr{new WheelTimer(*this, cb)}; }
+
+uint64_t TimerWheel::currentTick() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(time_source_.currentTime() -
+                                                               start_time_)
+             .count() /
+         resolution_.count();
+}
+
+void TimerWheel::insert(WheelTimer& timer) {
+  if (pending_timers_++ == 0 && !in_tick_) {
+    // The wheel was idle, so skip any ticks that elapsed without timers and start ticking again.
+    last_tick_ = currentTick();
+    tick_timer_->enableTimer(resolution_);
+  }
+
+  // The tick that has already been processed can never fire again, so a timer that falls due
+  // within it is pushed to the next tick.
+  timer.expiry_tick_ = std::max(timer.expiry_tick_, last_tick_ + 1);
+  TimerList& slot = slots_[timer.expiry_tick_ % NUM_SLOTS];
+  timer.entry_ = slot.insert(slot.end(), &timer);
+  timer.list_ = &slot;
+}
+
+void TimerWheel::onTick() {
+  const uint64_t now_tick = currentTick();
+
+  // Walk every slot the wheel moved past since the last tick. If the loop was blocked for more
+  // than a full revolution every slot needs to be checked exactly once.
+  const uint64_t slots_to_check = std::min(now_tick - last_tick_, NUM_SLOTS);
+  for (uint64_t i = 1; i <= slots_to_check; i++) {
+    TimerList& slot = slots_[(last_tick_ + i) % NUM_SLOTS];
+    for (auto it = slot.begin(); it != slot.end();) {
+      WheelTimer* timer = *it++;
+      if (timer->expiry_tick_ <= now_tick) {
+        ready_.splice(ready_.end(), slot, timer->entry_);
+        timer->list_ = &ready_;
+      }
+    }
+  }
+  last_tick_ = now_tick;
+
+  // Callbacks may enable or disable any timer, including other ready ones, so pop one at a time.
+  in_tick_ = true;
+  while (!ready_.empty()) {
+    WheelTimer* timer = ready_.front();
+    remove(*timer);
+    timer->cb_();
+  }
+  in_tick_ = false;
+
+  if (pending_timers_ > 0) {
+    tick_timer_->enableTimer(resolution_);
+  }
+}
+
+void TimerWheel::remove(WheelTimer& timer) {
+  ASSERT(timer.list_ != nullptr);
+  ASSERT(pending_timers_ > 0);
+  timer.list_->erase(timer.entry_);
+  timer.list_ = nullptr;
+  pending_timers_--;
+}
+
+void TimerWheel::WheelTimer::disableTimer() {
+  if (list_ != nullptr) {
+    parent_.remove(*this);
+  }
+}
+
+void TimerWheel::WheelTimer::enableTimer(const std::chrono::milliseconds& d) {
+  disableTimer();
+
+  // Round up so that a timer never fires before its requested timeout.
+  const std::chrono::milliseconds elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      parent_.time_source_.currentTime() - parent_.start_time_);
+  const uint64_t resolution = parent_.resolution_.count();
+  expiry_tick_ = (elapsed.count() + d.count() + resolution - 1) / resolution;
+  parent_.insert(*this);
+}
+
+} // Event
+} // Envoy
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <vector>
+
+#include "envoy/common/time.h"
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
+
+namespace Envoy {
+namespace Event {
+
+/**
+ * A hashed timer wheel that multiplexes many coarse timers onto a single dispatcher timer. Timeouts
+ * are rounded up to the wheel resolution, so all timers that fall due within the same tick fire
+ * from one dispatcher event. This is useful when a very large number of timers with similar
+ * periods are needed (e.g., health checking thousands of hosts) and per timer precision does not
+ * matter.
+ *
+ * The wheel must outlive all timers created from it. It is not thread safe and must only be used
+ * from the thread that runs the owning dispatcher.
+ */
+class TimerWheel {
+public:
+  TimerWheel(Dispatcher& dispatcher, std::chrono::milliseconds resolution,
+             MonotonicTimeSource& time_source);
+  ~TimerWheel();
+
+  /**
+   * Create a timer that is scheduled on the wheel.
+   * @param cb supplies the callback to invoke when the timer fires.
+   * @return TimerPtr a new timer. Free the timer to unregister any pending timeouts.
+   */
+  TimerPtr createTimer(TimerCb cb);
+
+  /**
+   * @return the number of timers that are currently enabled.
+   */
+  uint64_t pendingTimers() const { return pending_timers_; }
+
+private:
+  class WheelTimer;
+  typedef std::list<WheelTimer*> TimerList;
+
+  class WheelTimer : public Timer {
+  public:
+    WheelTimer(TimerWheel& parent, TimerCb cb) : parent_(parent), cb_(cb) {}
+    ~WheelTimer() { disableTimer(); }
+
+    // Event::Timer
+    void disableTimer() override;
+    void enableTimer(const std::chrono::milliseconds& d) override;
+
+    TimerWheel& parent_;
+    TimerCb cb_;
+    uint64_t expiry_tick_{};
+    TimerList* list_{};
+    TimerList::iterator entry_;
+  };
+
+  static const uint64_t NUM_SLOTS = 512;
+
+  uint64_t currentTick();
+  void insert(WheelTimer& timer);
+  void onTick();
+  void remove(WheelTimer& timer);
+
+  const std::chrono::milliseconds resolution_;
+  MonotonicTimeSource& time_source_;
+  const MonotonicTime start_time_;
+  TimerPtr tick_timer_;
+  std::vector<TimerList> slots_;
+  // Timers that are due and waiting for their callback to run during the current tick.
+  TimerList ready_;
+  uint64_t last_tick_{};
+  uint64_t pending_timers_{};
+  bool in_tick_{};
+};
+
+} // Event
+} // Envoy
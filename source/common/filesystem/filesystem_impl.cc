@@ -2,10 +2,17 @@
 
 #include <dirent.h>
 #include <fcntl.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
 #include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <mutex>
@@ -24,6 +31,22 @@
 
 namespace Envoy {
 namespace Filesystem {
+
+namespace {
+
+/**
+ * @return the write shard of the calling thread. Shards are handed out round robin the first time
+ *         a thread writes to any file, so each worker gets its own shard as long as there are no
+ *         more workers than shards.
+ */
+uint32_t writeShardIndex(uint32_t num_shards) {
+  static std::atomic<uint32_t> next_shard_index{0};
+  static thread_local uint32_t shard_index = next_shard_index++;
+  return shard_index % num_shards;
+}
+
+} // namespace
+
 bool fileExists(const std::string& path) {
   std::ifstream input_file(path);
   return input_file.is_open();
@@ -53,6 +76,27 @@ std::string fileReadToEnd(const std::string& path) {
   return file_string.str();
 }
 
+void fileWriteAtomically(const std::string& path, const std::string& content) {
+  // The temporary file is per process so that processes that overlap during a hot restart do not
+  // write to the same one.
+  const std::string temp_path = fmt::format("{}.{}.tmp", path, getpid());
+  {
+    std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+    file.write(content.data(), content.size());
+    file.close();
+    if (!file) {
+      unlink(temp_path.c_str());
+      throw EnvoyException(fmt::format("unable to write file: {}", temp_path));
+    }
+  }
+
+  if (::rename(temp_path.c_str(), path.c_str()) != 0) {
+    unlink(temp_path.c_str());
+    throw EnvoyException(fmt::format("unable to rename {} to {}: {}", temp_path, path,
+                                     strerror(errno)));
+  }
+}
+
 int OsSysCallsImpl::open(const std::string& full_path, int flags, int mode) {
   return ::open(full_path.c_str(), flags, mode);
 }
@@ -63,6 +107,10 @@ ssize_t OsSysCallsImpl::write(int fd, const void* buffer, size_t num_bytes) {
   return ::write(fd, buffer, num_bytes);
 }
 
+ssize_t OsSysCallsImpl::writev(int fd, const iovec* iov, int iovcnt) {
+  return ::writev(fd, iov, iovcnt);
+}
+
 FileImpl::FileImpl(const std::string& path, Event::Dispatcher& dispatcher,
                    Thread::BasicLockable& lock, OsSysCalls& os_sys_calls, Stats::Store& stats_store,
                    std::chrono::milliseconds flush_interval_msec)
@@ -97,8 +145,9 @@ FileImpl::~FileImpl() {
 
   // Flush any remaining data. If file was not opened for some reason, skip flushing part.
   if (fd_ != -1) {
-    if (flush_buffer_.length() > 0) {
-      doWrite(flush_buffer_);
+    swapWriteShards(about_to_write_buffer_);
+    if (about_to_write_buffer_.length() > 0) {
+      doWrite(about_to_write_buffer_);
     }
 
     os_sys_calls_.close(fd_);
@@ -110,34 +159,61 @@ void FileImpl::doWrite(Buffer::Instance& buffer) {
   Buffer::RawSlice slices[num_slices];
   buffer.getRawSlices(slices, num_slices);
 
-  // We must do the actual writes to disk under lock, so that we don't intermix chunks from
-  // different FileImpl pointing to the same underlying file. This can happen either via hot
-  // restart or if calling code opens the same underlying file into a different FileImpl in the
-  // same process.
-  // TODO PERF: Currently, we use a single cross process lock to serialize all disk writes. This
-  //            will never block network workers, but does mean that only a single flush thread can
-  //            actually flush to disk. In the future it would be nice if we did away with the cross
-  //            process lock or had multiple locks.
-  std::unique_lock<Thread::BasicLockable> lock(flush_lock_);
-  for (Buffer::RawSlice& slice : slices) {
-    ssize_t rc = os_sys_calls_.write(fd_, slice.mem_, slice.len_);
-    ASSERT(rc == static_cast<ssize_t>(slice.len_));
+  // We must not intermix chunks from different FileImpl pointing to the same underlying file. This
+  // can happen either via hot restart or if calling code opens the same underlying file into a
+  // different FileImpl in the same process. The file is opened with O_APPEND, so a single writev()
+  // appends the whole batch atomically and no lock is needed. Only a batch with more slices than
+  // fit in one call takes the cross process lock, so that its calls are not split up by another
+  // writer.
+  std::unique_lock<Thread::BasicLockable> lock(flush_lock_, std::defer_lock);
+  if (num_slices > IOV_MAX) {
+    lock.lock();
+  }
+
+  for (uint64_t i = 0; i < num_slices; i += IOV_MAX) {
+    const uint64_t num_iov = std::min<uint64_t>(num_slices - i, IOV_MAX);
+    iovec iov[num_iov];
+    size_t num_bytes = 0;
+    for (uint64_t j = 0; j < num_iov; j++) {
+      iov[j].iov_base = slices[i + j].mem_;
+      iov[j].iov_len = slices[i + j].len_;
+      num_bytes += slices[i + j].len_;
+    }
+
+    ssize_t rc = os_sys_calls_.writev(fd_, iov, num_iov);
+    ASSERT(rc == static_cast<ssize_t>(num_bytes));
     UNREFERENCED_PARAMETER(rc);
     stats_.write_completed_.inc();
   }
-  lock.unlock();
+  if (lock.owns_lock()) {
+    lock.unlock();
+  }
 
   stats_.write_total_buffered_.sub(buffer.length());
   buffer.drain(buffer.length());
 }
 
+void FileImpl::swapWriteShards(Buffer::Instance& buffer) {
+  for (WriteShard& shard : shards_) {
+    std::unique_lock<std::mutex> shard_lock(shard.lock_);
+    if (shard.buffer_.length() == 0) {
+      continue;
+    }
+
+    buffered_bytes_ -= shard.buffer_.length();
+    stats_.write_total_pending_.sub(shard.pending_writes_);
+    shard.pending_writes_ = 0;
+    buffer.move(shard.buffer_);
+  }
+}
+
 void FileImpl::flushThreadFunc() {
   std::unique_lock<std::mutex> lock(write_lock_);
 
   while (true) {
-    // flush_event_ can be woken up either by large enough flush_buffer or by timer.
-    // In case it was timer, flush_buffer_ can be empty.
-    while (flush_buffer_.length() == 0 && !flush_thread_exit_) {
+    // flush_event_ can be woken up either by large enough shards or by timer.
+    // In case it was timer, the shards can be empty.
+    while (buffered_bytes_ == 0 && !flush_thread_exit_) {
       flush_event_.wait(lock);
     }
 
@@ -145,15 +221,17 @@ void FileImpl::flushThreadFunc() {
       return;
     }
 
-    ASSERT(flush_buffer_.length() > 0);
-    about_to_write_buffer_.move(flush_buffer_);
-    ASSERT(flush_buffer_.length() == 0);
     lock.unlock();
+    swapWriteShards(about_to_write_buffer_);
+    ASSERT(about_to_write_buffer_.length() > 0);
 
     // if we failed to open file before (-1 == fd_), then simply ignore
     if (fd_ != -1) {
       try {
         if (reopen_file_) {
+          // Reopens are serialized across processes so that processes sharing the file during a
+          // hot restart do not reopen it concurrently while it is being rotated.
+          std::unique_lock<Thread::BasicLockable> reopen_lock(flush_lock_);
           reopen_file_ = false;
           os_sys_calls_.close(fd_);
           open();
@@ -170,16 +248,29 @@ void FileImpl::flushThreadFunc() {
 }
 
 void FileImpl::write(const std::string& data) {
-  std::unique_lock<std::mutex> lock(write_lock_);
+  std::call_once(flush_structures_created_, [this]() -> void { createFlushStructures(); });
 
-  if (flush_thread_ == nullptr) {
-    createFlushStructures();
+  WriteShard& shard = shards_[writeShardIndex(WRITE_SHARDS)];
+  uint64_t buffered_bytes;
+  {
+    std::unique_lock<std::mutex> shard_lock(shard.lock_);
+    if (buffered_bytes_ + data.length() > MAX_BUFFER_SIZE) {
+      stats_.write_dropped_.inc();
+      return;
+    }
+
+    stats_.write_buffered_.inc();
+    stats_.write_total_buffered_.add(data.length());
+    stats_.write_total_pending_.inc();
+    shard.buffer_.add(data);
+    shard.pending_writes_++;
+    buffered_bytes = buffered_bytes_ += data.length();
   }
 
-  stats_.write_buffered_.inc();
-  stats_.write_total_buffered_.add(data.length());
-  flush_buffer_.add(data);
-  if (flush_buffer_.length() > MIN_FLUSH_SIZE) {
+  // The flush thread checks for buffered data under write_lock_, so taking it here makes sure the
+  // wake up is not lost.
+  if (buffered_bytes > MIN_FLUSH_SIZE) {
+    std::unique_lock<std::mutex> lock(write_lock_);
     flush_event_.notify_one();
   }
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
@@ -21,7 +22,9 @@ namespace Envoy {
   COUNTER(write_completed)                                                                         \
   COUNTER(flushed_by_timer)                                                                        \
   COUNTER(reopen_failed)                                                                           \
-  GAUGE  (write_total_buffered)
+  COUNTER(write_dropped)                                                                           \
+  GAUGE  (write_total_buffered)                                                                    \
+  GAUGE  (write_total_pending)
 // clang-format on
 
 struct FileSystemStats {
@@ -46,11 +49,21 @@ bool directoryExists(const std::string& path);
  */
 std::string fileReadToEnd(const std::string& path);
 
+/**
+ * Replace the content of a file such that readers see either the old or the new content in full.
+ * The content is written to a temporary file next to the file, which is then renamed over it.
+ * @param path supplies the path of the file.
+ * @param content supplies the new content.
+ * @throw EnvoyException if the file cannot be written.
+ */
+void fileWriteAtomically(const std::string& path, const std::string& content);
+
 class OsSysCallsImpl : public OsSysCalls {
 public:
   // Filesystem::OsSysCalls
   int open(const std::string& full_path, int flags, int mode) override;
   ssize_t write(int fd, const void* buffer, size_t num_bytes) override;
+  ssize_t writev(int fd, const iovec* iov, int iovcnt) override;
   int close(int fd) override;
 };
 
@@ -60,6 +73,11 @@ public:
  * This implementation uses a flush thread per file, with the idea there there aren't that many
  * files. If this turns out to be a good implementation we can potentially have a single flush
  * thread that flushes all files, but we will start with this.
+ *
+ * Writers append to one of several write shards picked per thread, so that workers logging to the
+ * same file do not contend on a single lock. The flush thread swaps out all shards at once and
+ * writes them with a single gathered write, which O_APPEND makes atomic with respect to other
+ * processes writing to the same file.
  */
 class FileImpl : public File {
 public:
@@ -80,34 +98,49 @@ public:
   void reopen() override;
 
 private:
+  struct WriteShard {
+    std::mutex lock_;
+    Buffer::OwnedImpl buffer_;
+    uint64_t pending_writes_{};
+  };
+
   void doWrite(Buffer::Instance& buffer);
   void flushThreadFunc();
   void open();
   void createFlushStructures();
+  void swapWriteShards(Buffer::Instance& buffer);
 
   // Minimum size before the flush thread will be told to flush.
   static const uint64_t MIN_FLUSH_SIZE = 1024 * 64;
+  // Maximum amount of data buffered before new writes are dropped. This bounds memory use when the
+  // disk cannot keep up.
+  static const uint64_t MAX_BUFFER_SIZE = 1024 * 1024 * 64;
+  // Number of write shards. Threads are spread over the shards round robin.
+  static const uint32_t WRITE_SHARDS = 16;
 
   int fd_;
   std::string path_;
-  Thread::BasicLockable& flush_lock_; // This lock is used only by the flush thread when writing
-                                      // to disk. This is used to make sure that file blocks do
-                                      // not get interleaved.
-  std::mutex write_lock_; // The lock is used when filling the flush buffer. It allows multiple
-                          // threads to write to the same file at relatively high performance.
-                          // It is always local to the process.
+  Thread::BasicLockable& flush_lock_; // This cross process lock is used only by the flush thread
+                                      // when reopening the file and when a batch takes more than
+                                      // one write to disk. Other writes rely on O_APPEND to not
+                                      // get interleaved.
+  std::mutex write_lock_; // The lock is used to wake up the flush thread. Writers only take it
+                          // when the buffered data crosses MIN_FLUSH_SIZE.
+  std::once_flag flush_structures_created_;
   Thread::ThreadPtr flush_thread_;
   std::condition_variable_any flush_event_;
   std::atomic<bool> flush_thread_exit_{};
   std::atomic<bool> reopen_file_{};
-  Buffer::OwnedImpl flush_buffer_; // This buffer is used by multiple threads. It gets filled and
-                                   // then flushed either when max size is reached or when a timer
-                                   // fires.
+  std::array<WriteShard, WRITE_SHARDS> shards_; // These buffers are filled by the writing threads,
+                                                // each under its own shard lock, and flushed either
+                                                // when MIN_FLUSH_SIZE is reached or when a timer
+                                                // fires.
+  std::atomic<uint64_t> buffered_bytes_{}; // Total data in shards_, updated under shard locks.
   Buffer::OwnedImpl about_to_write_buffer_; // This buffer is used only by the flush thread. Data
-                                            // is moved from flush_buffer_ under lock, and then
-                                            // the lock is released so that flush_buffer_ can
-                                            // continue to fill. This buffer is then used for the
-                                            // final write to disk.
+                                            // is moved from shards_ under the shard locks, which
+                                            // are then released so that the shards can continue
+                                            // to fill. This buffer is then used for the final
+                                            // write to disk.
   Event::TimerPtr flush_timer_;
   Event::Dispatcher& dispatcher_;
   OsSysCalls& os_sys_calls_;
@@ -1,13 +1,16 @@
 #include "common/filter/auth/client_ssl.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include "envoy/network/connection.h"
 
 #include "common/common/assert.h"
 #include "common/common/enum_to_int.h"
+#include "common/common/hex.h"
 #include "common/http/headers.h"
 #include "common/http/message_impl.h"
 #include "common/http/utility.h"
@@ -21,11 +24,66 @@ namespace Filter {
 namespace Auth {
 namespace ClientSsl {
 
+AllowedPrincipals::AllowedPrincipals(const std::vector<std::string>& sha256_digests) {
+  digests_.reserve(sha256_digests.size());
+  for (const std::string& sha256_digest : sha256_digests) {
+    Digest digest;
+    if (parseDigest(sha256_digest, digest)) {
+      digests_.push_back(digest);
+    }
+  }
+
+  std::sort(digests_.begin(), digests_.end());
+  digests_.erase(std::unique(digests_.begin(), digests_.end()), digests_.end());
+  digests_.shrink_to_fit();
+
+  while ((1ULL << index_bits_) < digests_.size()) {
+    index_bits_++;
+  }
+
+  // Since the digests are sorted, so are their index slots.
+  index_.resize((1ULL << index_bits_) + 1);
+  size_t position = 0;
+  for (size_t slot = 0; slot < index_.size(); slot++) {
+    while (position < digests_.size() && indexSlot(digests_[position]) < slot) {
+      position++;
+    }
+    index_[slot] = position;
+  }
+}
+
+bool AllowedPrincipals::parseDigest(const std::string& hex, Digest& digest) {
+  if (hex.size() != 64) {
+    return false;
+  }
+
+  for (size_t i = 0; i < digest.size(); i++) {
+    if (!Hex::hexToUint64(hex.data() + i * 16, 16, digest[i])) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool AllowedPrincipals::allowed(const std::string& sha256_digest) const {
+  Digest digest;
+  if (digests_.empty() || !parseDigest(sha256_digest, digest)) {
+    return false;
+  }
+
+  const size_t slot = indexSlot(digest);
+  return std::find(digests_.begin() + index_[slot], digests_.begin() + index_[slot + 1], digest) !=
+         digests_.begin() + index_[slot + 1];
+}
+
 Config::Config(const Json::Object& config, ThreadLocal::Instance& tls, Upstream::ClusterManager& cm,
                Event::Dispatcher& dispatcher, Stats::Store& stats_store,
                Runtime::RandomGenerator& random)
     : RestApiFetcher(cm, config.getString("auth_api_cluster"), dispatcher, random,
-                     std::chrono::milliseconds(config.getInteger("refresh_delay_ms", 60000))),
+                     std::chrono::milliseconds(config.getInteger("refresh_delay_ms", 60000)),
+                     ApiType::Rest, stats_store,
+                     fmt::format("auth.clientssl.{}.", config.getString("stat_prefix")), ""),
       tls_(tls), tls_slot_(tls.allocateSlot()), ip_white_list_(config, "ip_white_list"),
       stats_(generateStats(stats_store, config.getString("stat_prefix"))) {
 
@@ -36,7 +94,8 @@ Config::Config(const Json::Object& config, ThreadLocal::Instance& tls, Upstream:
         fmt::format("unknown cluster '{}' in client ssl auth config", remote_cluster_name_));
   }
 
-  AllowedPrincipalsSharedPtr empty(new AllowedPrincipals());
+  principals_.reset(new AllowedPrincipals());
+  AllowedPrincipalsSharedPtr empty = principals_;
   tls_.set(tls_slot_, [empty](Event::Dispatcher&)
                           -> ThreadLocal::ThreadLocalObjectSharedPtr { return empty; });
 }
@@ -61,19 +120,32 @@ GlobalStats Config::generateStats(Stats::Store& store, const std::string& prefix
 }
 
 void Config::parseResponse(const Http::Message& message) {
-  AllowedPrincipalsSharedPtr new_principals(new AllowedPrincipals());
+  // Responses whose body did not change since the last successful parse do not get here at all.
+  // See onResponseUnchanged().
   Json::ObjectSharedPtr loader = Json::Factory::loadFromString(message.bodyAsString());
-  for (const Json::ObjectSharedPtr& certificate : loader->getObjectArray("certificates")) {
-    new_principals->add(certificate->getString("fingerprint_sha256"));
+  std::vector<Json::ObjectSharedPtr> certificates = loader->getObjectArray("certificates");
+  std::vector<std::string> digests;
+  digests.reserve(certificates.size());
+  for (const Json::ObjectSharedPtr& certificate : certificates) {
+    digests.push_back(certificate->getString("fingerprint_sha256"));
   }
 
-  tls_.set(tls_slot_, [new_principals](Event::Dispatcher&)
-                          -> ThreadLocal::ThreadLocalObjectSharedPtr { return new_principals; });
+  AllowedPrincipalsSharedPtr new_principals(new AllowedPrincipals(digests));
+
+  // A response can change without changing the set of principals, e.g. when only other fields of
+  // the certificates or their order change. The workers then keep the set they have.
+  if (*new_principals != *principals_) {
+    principals_ = new_principals;
+    tls_.set(tls_slot_, [new_principals](Event::Dispatcher&)
+                            -> ThreadLocal::ThreadLocalObjectSharedPtr { return new_principals; });
+  }
 
   stats_.update_success_.inc();
-  stats_.total_principals_.set(new_principals->size());
+  stats_.total_principals_.set(principals_->size());
 }
 
+void Config::onResponseUnchanged(const Http::Message&) { stats_.update_success_.inc(); }
+
 void Config::onFetchFailure(EnvoyException*) { stats_.update_failure_.inc(); }
 
 static const std::string Path = "/v1/certs/list/approved";
@@ -1,9 +1,10 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <memory>
 #include <string>
-#include <unordered_set>
+#include <vector>
 
 #include "envoy/network/filter.h"
 #include "envoy/runtime/runtime.h"
@@ -42,25 +43,47 @@ struct GlobalStats {
 };
 
 /**
- * Wraps the principals currently allowed to authenticate.
+ * The principals currently allowed to authenticate. This is immutable once built, so that a single
+ * instance can be shared by all workers. The SHA-256 digests are stored in binary, sorted and
+ * without duplicates, which takes 32 bytes per principal. An index of the leading bits of the
+ * digests points each lookup at the few digests that can match. Since digests are uniformly
+ * distributed and the index has a slot per digest, a lookup compares against one digest on average.
  */
 class AllowedPrincipals : public ThreadLocal::ThreadLocalObject {
 public:
-  void add(const std::string& sha256_digest) {
-    if (!sha256_digest.empty()) {
-      allowed_sha256_digests_.emplace(sha256_digest);
-    }
-  }
-  bool allowed(const std::string& sha256_digest) const {
-    return allowed_sha256_digests_.count(sha256_digest) != 0;
-  }
-  size_t size() const { return allowed_sha256_digests_.size(); }
+  /**
+   * @param sha256_digests supplies the hex SHA-256 digests of the allowed certificates. Digests
+   *        that are not 64 hex digits can never match a certificate and are ignored.
+   */
+  AllowedPrincipals(const std::vector<std::string>& sha256_digests = {});
+
+  /**
+   * @param sha256_digest supplies the hex SHA-256 digest of a peer certificate.
+   * @return whether the certificate is allowed.
+   */
+  bool allowed(const std::string& sha256_digest) const;
+
+  size_t size() const { return digests_.size(); }
+
+  bool operator==(const AllowedPrincipals& rhs) const { return digests_ == rhs.digests_; }
+  bool operator!=(const AllowedPrincipals& rhs) const { return !(*this == rhs); }
 
   // ThreadLocal::ThreadLocalObject
   void shutdown() override {}
 
 private:
-  std::unordered_set<std::string> allowed_sha256_digests_;
+  // A digest as four 64-bit words, most significant first, so that words compare like the bytes.
+  typedef std::array<uint64_t, 4> Digest;
+
+  static bool parseDigest(const std::string& hex, Digest& digest);
+  size_t indexSlot(const Digest& digest) const {
+    return index_bits_ == 0 ? 0 : digest[0] >> (64 - index_bits_);
+  }
+
+  std::vector<Digest> digests_;
+  uint32_t index_bits_{};
+  // index_[i] is the position of the first digest whose index slot is at least i.
+  std::vector<uint32_t> index_;
 };
 
 typedef std::shared_ptr<AllowedPrincipals> AllowedPrincipalsSharedPtr;
@@ -93,11 +116,14 @@ private:
   // Http::RestApiFetcher
   void createRequest(Http::Message& request) override;
   void parseResponse(const Http::Message& response) override;
+  void onResponseUnchanged(const Http::Message& response) override;
   void onFetchComplete() override {}
   void onFetchFailure(EnvoyException* e) override;
 
   ThreadLocal::Instance& tls_;
   uint32_t tls_slot_;
+  // The principals that were last sent to the workers. Only used on the main thread.
+  AllowedPrincipalsSharedPtr principals_;
   Network::IpList ip_white_list_;
   GlobalStats stats_;
 };
@@ -119,6 +145,8 @@ public:
 
   // Network::ConnectionCallbacks
   void onEvent(uint32_t events) override;
+  void onAboveWriteBufferHighWatermark() override {}
+  void onBelowWriteBufferLowWatermark() override {}
 
 private:
   ConfigSharedPtr config_;
@@ -0,0 +1,174 @@
+#include "common/filter/tap.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "envoy/buffer/buffer.h"
+
+namespace Envoy {
+namespace Filter {
+
+const uint64_t TapBuffer::FlushBytes;
+const std::chrono::milliseconds TapBuffer::FlushInterval(1000);
+const uint64_t TapBuffer::RecordHeaderSize;
+
+TapBuffer::TapBuffer(Event::Dispatcher& dispatcher, Filesystem::FileSharedPtr file)
+    : file_(file), flush_timer_(dispatcher.createTimer([this]() -> void { flush(); })) {}
+
+void TapBuffer::record(TapEvent event, uint64_t connection_id, const Buffer::Instance& data,
+                       uint64_t length) {
+  const bool was_empty = pending_.empty();
+  writeHeader(event, connection_id, length);
+
+  uint64_t num_slices = data.getRawSlices(nullptr, 0);
+  Buffer::RawSlice slices[num_slices];
+  data.getRawSlices(slices, num_slices);
+  for (Buffer::RawSlice& slice : slices) {
+    if (length == 0) {
+      break;
+    }
+    const uint64_t to_copy = std::min(length, slice.len_);
+    pending_.append(static_cast<const char*>(slice.mem_), to_copy);
+    length -= to_copy;
+  }
+
+  onRecorded(was_empty);
+}
+
+void TapBuffer::record(TapEvent event, uint64_t connection_id, const std::string& data) {
+  const bool was_empty = pending_.empty();
+  writeHeader(event, connection_id, data.size());
+  pending_.append(data);
+  onRecorded(was_empty);
+}
+
+void TapBuffer::writeHeader(TapEvent event, uint64_t connection_id, uint32_t length) {
+  const uint64_t timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
+                                 std::chrono::system_clock::now().time_since_epoch())
+                                 .count();
+
+  char header[RecordHeaderSize];
+  char* out = header;
+  *out++ = static_cast<char>(event);
+  for (uint32_t i = 0; i < 8; i++) {
+    *out++ = static_cast<char>(connection_id >> (i * 8));
+  }
+  for (uint32_t i = 0; i < 8; i++) {
+    *out++ = static_cast<char>(timestamp >> (i * 8));
+  }
+  for (uint32_t i = 0; i < 4; i++) {
+    *out++ = static_cast<char>(length >> (i * 8));
+  }
+  pending_.append(header, RecordHeaderSize);
+}
+
+void TapBuffer::onRecorded(bool was_empty) {
+  if (pending_.size() >= FlushBytes) {
+    flush();
+  } else if (was_empty && flush_timer_) {
+    // Only the first record of a batch arms the timer, so a busy worker does not keep pushing
+    // the deadline out.
+    flush_timer_->enableTimer(FlushInterval);
+  }
+}
+
+void TapBuffer::flush() {
+  if (flush_timer_) {
+    flush_timer_->disableTimer();
+  }
+
+  if (pending_.empty()) {
+    return;
+  }
+
+  file_->write(pending_);
+  pending_.clear();
+}
+
+void TapBuffer::shutdown() {
+  flush();
+  flush_timer_.reset();
+}
+
+TapConfig::TapConfig(const Json::Object& config, Envoy::AccessLog::AccessLogManager& log_manager,
+                     ThreadLocal::Instance& tls, Runtime::Loader& runtime,
+                     Runtime::RandomGenerator& random, Stats::Scope& scope)
+    : tls_(tls), tls_slot_(tls.allocateSlot()), runtime_(runtime), random_(random),
+      stats_{ALL_TAP_STATS(POOL_COUNTER_PREFIX(scope, "tap." + config.getString("stat_prefix") +
+                                                          "."))},
+      sample_percent_(config.getInteger("sample_percent", 100)),
+      max_connection_bytes_(
+          config.getInteger("max_connection_bytes", DEFAULT_MAX_CONNECTION_BYTES)) {
+  Filesystem::FileSharedPtr file = log_manager.createAccessLog(config.getString("path"));
+  tls_.set(tls_slot_,
+           [file](Event::Dispatcher& dispatcher) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+             return ThreadLocal::ThreadLocalObjectSharedPtr{new TapBuffer(dispatcher, file)};
+           });
+}
+
+bool TapConfig::sample() {
+  return runtime_.snapshot().featureEnabled("tap.sample_percent", sample_percent_,
+                                            random_.random());
+}
+
+Network::FilterStatus TapFilter::onData(Buffer::Instance& data) {
+  recordData(TapEvent::Read, data);
+  return Network::FilterStatus::Continue;
+}
+
+Network::FilterStatus TapFilter::onNewConnection() {
+  tapped_ = config_->sample();
+  if (!tapped_) {
+    config_->stats().cx_sampled_out_.inc();
+    return Network::FilterStatus::Continue;
+  }
+
+  config_->stats().cx_tapped_.inc();
+  Network::Connection& connection = read_callbacks_->connection();
+  connection.addConnectionCallbacks(*this);
+  config_->buffer().record(TapEvent::Connected, connection.id(),
+                           connection.remoteAddress().asString());
+  return Network::FilterStatus::Continue;
+}
+
+void TapFilter::initializeReadFilterCallbacks(Network::ReadFilterCallbacks& callbacks) {
+  read_callbacks_ = &callbacks;
+}
+
+Network::FilterStatus TapFilter::onWrite(Buffer::Instance& data) {
+  recordData(TapEvent::Write, data);
+  return Network::FilterStatus::Continue;
+}
+
+void TapFilter::onEvent(uint32_t events) {
+  if (events & (Network::ConnectionEvent::RemoteClose | Network::ConnectionEvent::LocalClose)) {
+    config_->buffer().record(TapEvent::Closed, read_callbacks_->connection().id(), "");
+  }
+}
+
+void TapFilter::recordData(TapEvent event, const Buffer::Instance& data) {
+  if (!tapped_ || truncated_ || data.length() == 0) {
+    return;
+  }
+
+  uint64_t length = data.length();
+  if (recorded_bytes_ + length > config_->maxConnectionBytes()) {
+    length = config_->maxConnectionBytes() - recorded_bytes_;
+    truncated_ = true;
+    conn_log_debug("tap: truncating after {} bytes", read_callbacks_->connection(),
+                   config_->maxConnectionBytes());
+    config_->stats().cx_truncated_.inc();
+    if (length == 0) {
+      return;
+    }
+  }
+
+  recorded_bytes_ += length;
+  config_->stats().captured_bytes_.add(length);
+  config_->buffer().record(event, read_callbacks_->connection().id(), data, length);
+}
+
+} // Filter
+} // Envoy
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "envoy/access_log/access_log.h"
+#include "envoy/buffer/buffer.h"
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
+#include "envoy/filesystem/filesystem.h"
+#include "envoy/network/connection.h"
+#include "envoy/network/filter.h"
+#include "envoy/runtime/runtime.h"
+#include "envoy/stats/stats_macros.h"
+#include "envoy/thread_local/thread_local.h"
+
+#include "common/common/logger.h"
+#include "common/json/json_loader.h"
+
+namespace Envoy {
+namespace Filter {
+
+/**
+ * All tap stats. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_TAP_STATS(COUNTER)                                                                     \
+  COUNTER(cx_tapped)                                                                               \
+  COUNTER(cx_sampled_out)                                                                          \
+  COUNTER(cx_truncated)                                                                            \
+  COUNTER(captured_bytes)
+// clang-format on
+
+/**
+ * Struct definition for all tap stats. @see stats_macros.h
+ */
+struct TapStats {
+  ALL_TAP_STATS(GENERATE_COUNTER_STRUCT)
+};
+
+/**
+ * Events recorded in a tap trace.
+ */
+enum class TapEvent : uint8_t {
+  // The connection was accepted. The data is the remote address.
+  Connected = 0,
+  // Data was read from the downstream connection.
+  Read = 1,
+  // Data was written to the downstream connection.
+  Write = 2,
+  // The connection was closed. There is no data.
+  Closed = 3
+};
+
+/**
+ * Per worker buffer of tap records. Records are only appended by the owning worker so no locking
+ * is needed until a batch is handed to the trace file, which writes it to disk on its own flush
+ * thread. A batch is handed over once it reaches FlushBytes or after FlushInterval, whichever
+ * comes first.
+ *
+ * Every record is self describing so traces from several workers can be interleaved at batch
+ * granularity. All integers are little endian:
+ *   uint8_t  event (@see TapEvent)
+ *   uint64_t connection id
+ *   uint64_t microseconds since the epoch
+ *   uint32_t data length
+ *   data
+ */
+class TapBuffer : public ThreadLocal::ThreadLocalObject {
+public:
+  TapBuffer(Event::Dispatcher& dispatcher, Filesystem::FileSharedPtr file);
+
+  /**
+   * Append a record.
+   * @param event supplies the event.
+   * @param connection_id supplies the id of the tapped connection.
+   * @param data supplies the data to record.
+   * @param length supplies how many bytes from the start of data to record.
+   */
+  void record(TapEvent event, uint64_t connection_id, const Buffer::Instance& data,
+              uint64_t length);
+  void record(TapEvent event, uint64_t connection_id, const std::string& data);
+
+  /**
+   * Hand any buffered records to the trace file.
+   */
+  void flush();
+
+  // ThreadLocal::ThreadLocalObject
+  void shutdown() override;
+
+  static const uint64_t FlushBytes = 64 * 1024;
+  static const std::chrono::milliseconds FlushInterval;
+  static const uint64_t RecordHeaderSize = 21;
+
+private:
+  void writeHeader(TapEvent event, uint64_t connection_id, uint32_t length);
+  void onRecorded(bool was_empty);
+
+  Filesystem::FileSharedPtr file_;
+  Event::TimerPtr flush_timer_;
+  std::string pending_;
+};
+
+/**
+ * Global configuration for the tap filter.
+ */
+class TapConfig {
+public:
+  TapConfig(const Json::Object& config, Envoy::AccessLog::AccessLogManager& log_manager,
+            ThreadLocal::Instance& tls, Runtime::Loader& runtime,
+            Runtime::RandomGenerator& random, Stats::Scope& scope);
+
+  /**
+   * @return bool whether a new connection should be tapped.
+   */
+  bool sample();
+
+  /**
+   * @return TapBuffer& the buffer of the calling worker.
+   */
+  TapBuffer& buffer() { return tls_.getTyped<TapBuffer>(tls_slot_); }
+
+  TapStats& stats() { return stats_; }
+  uint64_t maxConnectionBytes() const { return max_connection_bytes_; }
+
+  static const uint64_t DEFAULT_MAX_CONNECTION_BYTES = 1024 * 1024;
+
+private:
+  ThreadLocal::Instance& tls_;
+  const uint32_t tls_slot_;
+  Runtime::Loader& runtime_;
+  Runtime::RandomGenerator& random_;
+  TapStats stats_;
+  const uint64_t sample_percent_;
+  const uint64_t max_connection_bytes_;
+};
+
+typedef std::shared_ptr<TapConfig> TapConfigSharedPtr;
+
+/**
+ * A network filter that records sampled downstream connections to a binary trace that can be
+ * replayed later with tools/tap_replay.py. Only the first max_connection_bytes of data of each
+ * connection are recorded.
+ */
+class TapFilter : public Network::Filter,
+                  public Network::ConnectionCallbacks,
+                  Logger::Loggable<Logger::Id::filter> {
+public:
+  TapFilter(TapConfigSharedPtr config) : config_(config) {}
+
+  // Network::ReadFilter
+  Network::FilterStatus onData(Buffer::Instance& data) override;
+  Network::FilterStatus onNewConnection() override;
+  void initializeReadFilterCallbacks(Network::ReadFilterCallbacks& callbacks) override;
+
+  // Network::WriteFilter
+  Network::FilterStatus onWrite(Buffer::Instance& data) override;
+
+  // Network::ConnectionCallbacks
+  void onEvent(uint32_t events) override;
+  void onAboveWriteBufferHighWatermark() override {}
+  void onBelowWriteBufferLowWatermark() override {}
+
+private:
+  void recordData(TapEvent event, const Buffer::Instance& data);
+
+  TapConfigSharedPtr config_;
+  Network::ReadFilterCallbacks* read_callbacks_{};
+  bool tapped_{};
+  bool truncated_{};
+  uint64_t recorded_bytes_{};
+};
+
+} // Filter
+} // Envoy
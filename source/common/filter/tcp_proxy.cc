@@ -1,7 +1,13 @@
 #include "common/filter/tcp_proxy.h"
 
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <array>
 #include <cstdint>
+#include <limits>
 #include <string>
+#include <vector>
 
 #include "envoy/buffer/buffer.h"
 #include "envoy/event/dispatcher.h"
@@ -44,7 +50,8 @@ TcpProxyConfig::Route::Route(const Json::Object& config) {
 
 TcpProxyConfig::TcpProxyConfig(const Json::Object& config,
                                Upstream::ClusterManager& cluster_manager, Stats::Store& stats_store)
-    : stats_(generateStats(config.getString("stat_prefix"), stats_store)) {
+    : stats_(generateStats(config.getString("stat_prefix"), stats_store)),
+      splice_(config.getBoolean("splice", false)) {
   config.validateSchema(Json::Schema::TCP_PROXY_NETWORK_FILTER_SCHEMA);
 
   for (const Json::ObjectSharedPtr& route_desc :
@@ -56,32 +63,170 @@ TcpProxyConfig::TcpProxyConfig(const Json::Object& config,
                                        route_desc->getString("cluster")));
     }
   }
+
+  buildIndexes();
 }
 
-const std::string& TcpProxyConfig::getRouteFromEntries(Network::Connection& connection) {
-  for (const TcpProxyConfig::Route& route : routes_) {
-    if (!route.source_port_ranges_.empty() &&
-        !Network::Utility::portInRangeList(connection.remoteAddress(), route.source_port_ranges_)) {
-      continue;
+namespace {
+
+// Routes with a condition on the port or the IP never match addresses that do not have one.
+bool portKey(const Network::Address::Instance& address, uint32_t& key) {
+  if (address.type() != Network::Address::Type::Ip) {
+    return false;
+  }
+
+  key = address.ip()->port();
+  return true;
+}
+
+bool ipv4Key(const Network::Address::Instance& address, uint32_t& key) {
+  if (address.type() != Network::Address::Type::Ip ||
+      address.ip()->version() != Network::Address::IpVersion::v4) {
+    return false;
+  }
+
+  key = ntohl(address.ip()->ipv4()->address());
+  return true;
+}
+
+} // namespace
+
+void TcpProxyConfig::RangeIndex::addRange(uint32_t route, uint32_t first, uint32_t last) {
+  ASSERT(first <= last);
+  ranges_.push_back({route, first, last});
+}
+
+void TcpProxyConfig::RangeIndex::build() {
+  static const uint32_t max_key = std::numeric_limits<uint32_t>::max();
+
+  interval_starts_.push_back(0);
+  for (const Range& range : ranges_) {
+    interval_starts_.push_back(range.first_);
+    if (range.last_ != max_key) {
+      interval_starts_.push_back(range.last_ + 1);
+    }
+  }
+
+  std::sort(interval_starts_.begin(), interval_starts_.end());
+  interval_starts_.erase(std::unique(interval_starts_.begin(), interval_starts_.end()),
+                         interval_starts_.end());
+
+  interval_routes_.assign(interval_starts_.size(), any_routes_);
+  for (const Range& range : ranges_) {
+    auto first = std::lower_bound(interval_starts_.begin(), interval_starts_.end(), range.first_);
+    auto last = range.last_ == max_key ? interval_starts_.end()
+                                       : std::lower_bound(first, interval_starts_.end(),
+                                                          range.last_ + 1);
+    for (auto interval = first; interval != last; interval++) {
+      interval_routes_[interval - interval_starts_.begin()].push_back(range.route_);
     }
+  }
+
+  // A route may have several ranges that cover the same interval.
+  for (std::vector<uint32_t>& routes : interval_routes_) {
+    std::sort(routes.begin(), routes.end());
+    routes.erase(std::unique(routes.begin(), routes.end()), routes.end());
+  }
+}
+
+const std::vector<uint32_t>& TcpProxyConfig::RangeIndex::lookup(uint32_t key) const {
+  // The first interval starts at 0, so the upper bound is never the first interval.
+  auto interval = std::upper_bound(interval_starts_.begin(), interval_starts_.end(), key);
+  return interval_routes_[interval - interval_starts_.begin() - 1];
+}
+
+void TcpProxyConfig::buildIndexes() {
+  for (uint32_t i = 0; i < routes_.size(); i++) {
+    const Route& route = routes_[i];
 
-    if (!route.source_ips_.empty() && !route.source_ips_.contains(connection.remoteAddress())) {
-      continue;
+    if (route.source_ips_.empty()) {
+      source_ips_index_.addAny(i);
+    } else {
+      route.source_ips_.forEachRange(
+          [this, i](uint32_t first, uint32_t last) { source_ips_index_.addRange(i, first, last); });
     }
 
-    if (!route.destination_port_ranges_.empty() &&
-        !Network::Utility::portInRangeList(connection.localAddress(),
-                                           route.destination_port_ranges_)) {
-      continue;
+    if (route.source_port_ranges_.empty()) {
+      source_ports_index_.addAny(i);
+    } else {
+      for (const Network::PortRange& range : route.source_port_ranges_) {
+        source_ports_index_.addRange(i, range.min(), range.max());
+      }
     }
 
-    if (!route.destination_ips_.empty() &&
-        !route.destination_ips_.contains(connection.localAddress())) {
-      continue;
+    if (route.destination_ips_.empty()) {
+      destination_ips_index_.addAny(i);
+    } else {
+      route.destination_ips_.forEachRange([this, i](uint32_t first, uint32_t last) {
+        destination_ips_index_.addRange(i, first, last);
+      });
     }
 
-    // if we made it past all checks, the route matches
-    return route.cluster_name_;
+    if (route.destination_port_ranges_.empty()) {
+      destination_ports_index_.addAny(i);
+    } else {
+      for (const Network::PortRange& range : route.destination_port_ranges_) {
+        destination_ports_index_.addRange(i, range.min(), range.max());
+      }
+    }
+  }
+
+  source_ips_index_.build();
+  source_ports_index_.build();
+  destination_ips_index_.build();
+  destination_ports_index_.build();
+}
+
+const std::string& TcpProxyConfig::getRouteFromEntries(Network::Connection& connection) {
+  // Collect the routes that match each kind of condition that is used by any route. The first
+  // route in the table that is in all of these lists is the first route that matches.
+  std::array<const std::vector<uint32_t>*, 4> candidates;
+  size_t num_candidates = 0;
+  uint32_t key;
+
+  if (source_ports_index_.hasRanges()) {
+    candidates[num_candidates++] = portKey(connection.remoteAddress(), key)
+                                       ? &source_ports_index_.lookup(key)
+                                       : &source_ports_index_.lookupNoKey();
+  }
+
+  if (source_ips_index_.hasRanges()) {
+    candidates[num_candidates++] = ipv4Key(connection.remoteAddress(), key)
+                                       ? &source_ips_index_.lookup(key)
+                                       : &source_ips_index_.lookupNoKey();
+  }
+
+  if (destination_ports_index_.hasRanges()) {
+    candidates[num_candidates++] = portKey(connection.localAddress(), key)
+                                       ? &destination_ports_index_.lookup(key)
+                                       : &destination_ports_index_.lookupNoKey();
+  }
+
+  if (destination_ips_index_.hasRanges()) {
+    candidates[num_candidates++] = ipv4Key(connection.localAddress(), key)
+                                       ? &destination_ips_index_.lookup(key)
+                                       : &destination_ips_index_.lookupNoKey();
+  }
+
+  if (num_candidates == 0) {
+    // No route has any condition, so the first one matches.
+    return routes_.empty() ? EMPTY_STRING : routes_.front().cluster_name_;
+  }
+
+  // Walk the shortest list in order and look for each route in the others.
+  std::sort(candidates.begin(), candidates.begin() + num_candidates,
+            [](const std::vector<uint32_t>* lhs, const std::vector<uint32_t>* rhs) -> bool {
+              return lhs->size() < rhs->size();
+            });
+  for (uint32_t route : *candidates[0]) {
+    bool matches = true;
+    for (size_t i = 1; i < num_candidates && matches; i++) {
+      matches = std::binary_search(candidates[i]->begin(), candidates[i]->end(), route);
+    }
+
+    if (matches) {
+      return routes_[route].cluster_name_;
+    }
   }
 
   // no match, no more routes to try
@@ -143,7 +288,8 @@ Network::FilterStatus TcpProxy::initializeUpstreamConnection() {
     read_callbacks_->connection().close(Network::ConnectionCloseType::NoFlush);
     return Network::FilterStatus::StopIteration;
   }
-  Upstream::Host::CreateConnectionData conn_info = cluster_manager_.tcpConnForCluster(cluster_name);
+  Upstream::Host::CreateConnectionData conn_info =
+      cluster_manager_.tcpConnForCluster(cluster_name, this);
 
   upstream_connection_ = std::move(conn_info.connection_);
   read_callbacks_->upstreamHost(conn_info.host_description_);
@@ -171,10 +317,13 @@ Network::FilterStatus TcpProxy::initializeUpstreamConnection() {
   read_callbacks_->upstreamHost()->cluster().stats().upstream_cx_active_.inc();
   read_callbacks_->upstreamHost()->stats().cx_total_.inc();
   read_callbacks_->upstreamHost()->stats().cx_active_.inc();
+  MonotonicTimeSource& time_source = read_callbacks_->connection().dispatcher().loopTimeSource();
   connect_timespan_ =
-      read_callbacks_->upstreamHost()->cluster().stats().upstream_cx_connect_ms_.allocateSpan();
+      read_callbacks_->upstreamHost()->cluster().stats().upstream_cx_connect_ms_.allocateSpan(
+          time_source);
   connected_timespan_ =
-      read_callbacks_->upstreamHost()->cluster().stats().upstream_cx_length_ms_.allocateSpan();
+      read_callbacks_->upstreamHost()->cluster().stats().upstream_cx_length_ms_.allocateSpan(
+          time_source);
 
   return Network::FilterStatus::Continue;
 }
@@ -229,6 +378,9 @@ void TcpProxy::onUpstreamEvent(uint32_t event) {
     read_callbacks_->connection().close(Network::ConnectionCloseType::FlushWrite);
   } else if (event & Network::ConnectionEvent::Connected) {
     connect_timespan_->complete();
+    if (config_->splice()) {
+      startSplice();
+    }
   }
 
   if (connect_timeout_timer_) {
@@ -237,5 +389,40 @@ void TcpProxy::onUpstreamEvent(uint32_t event) {
   }
 }
 
+void TcpProxy::readDisableDownstream(bool disable) {
+  read_callbacks_->connection().readDisable(disable);
+  if (disable) {
+    config_->stats().downstream_flow_control_paused_reading_total_.inc();
+  } else {
+    config_->stats().downstream_flow_control_resumed_reading_total_.inc();
+  }
+}
+
+void TcpProxy::readDisableUpstream(bool disable) {
+  // The downstream write buffer only fills with data read from the upstream connection.
+  ASSERT(upstream_connection_);
+  upstream_connection_->readDisable(disable);
+  if (disable) {
+    config_->stats().upstream_flow_control_paused_reading_total_.inc();
+  } else {
+    config_->stats().upstream_flow_control_resumed_reading_total_.inc();
+  }
+}
+
+void TcpProxy::startSplice() {
+  // Each direction falls back to copying through the read buffers on its own if the connections
+  // do not allow splicing, e.g. because of TLS or other filters that need to see the data.
+  Network::Connection& downstream = read_callbacks_->connection();
+  bool rx_spliced =
+      downstream.spliceTo(*upstream_connection_, config_->stats().downstream_cx_rx_bytes_spliced_);
+  bool tx_spliced =
+      upstream_connection_->spliceTo(downstream, config_->stats().downstream_cx_tx_bytes_spliced_);
+  conn_log_debug("splice rx={} tx={}", downstream, rx_spliced, tx_spliced);
+
+  if (rx_spliced || tx_spliced) {
+    config_->stats().downstream_cx_spliced_.inc();
+  }
+}
+
 } // Filter
 } // Envoy
@@ -29,7 +29,14 @@ namespace Filter {
   COUNTER(downstream_cx_tx_bytes_total)                                                            \
   GAUGE  (downstream_cx_tx_bytes_buffered)                                                         \
   COUNTER(downstream_cx_total)                                                                     \
-  COUNTER(downstream_cx_no_route)
+  COUNTER(downstream_cx_no_route)                                                                  \
+  COUNTER(downstream_cx_spliced)                                                                   \
+  COUNTER(downstream_cx_rx_bytes_spliced)                                                          \
+  COUNTER(downstream_cx_tx_bytes_spliced)                                                          \
+  COUNTER(downstream_flow_control_paused_reading_total)                                            \
+  COUNTER(downstream_flow_control_resumed_reading_total)                                           \
+  COUNTER(upstream_flow_control_paused_reading_total)                                              \
+  COUNTER(upstream_flow_control_resumed_reading_total)
 // clang-format on
 
 /**
@@ -59,6 +66,11 @@ public:
 
   const TcpProxyStats& stats() { return stats_; }
 
+  /**
+   * @return bool whether connections should move data with splice(2) when they can.
+   */
+  bool splice() const { return splice_; }
+
 private:
   struct Route {
     Route(const Json::Object& config);
@@ -70,10 +82,67 @@ private:
     std::string cluster_name_;
   };
 
+  /**
+   * Maps a key, a port or an IPv4 address, to the routes whose condition on that key matches it.
+   * The key space is split at every range boundary into intervals that each have a sorted list of
+   * route indexes, so a lookup is a binary search. Routes without a condition are in every list.
+   */
+  class RangeIndex {
+  public:
+    /**
+     * Add a route that matches the keys in [first, last].
+     */
+    void addRange(uint32_t route, uint32_t first, uint32_t last);
+
+    /**
+     * Add a route that has no condition on the key.
+     */
+    void addAny(uint32_t route) { any_routes_.push_back(route); }
+
+    /**
+     * Build the intervals. Must be called after all routes have been added, in route order.
+     */
+    void build();
+
+    /**
+     * @return bool whether any route has a condition on the key.
+     */
+    bool hasRanges() const { return !ranges_.empty(); }
+
+    /**
+     * @return the sorted indexes of the routes that match the key.
+     */
+    const std::vector<uint32_t>& lookup(uint32_t key) const;
+
+    /**
+     * @return the sorted indexes of the routes that match when there is no key, i.e. the routes
+     *         without a condition.
+     */
+    const std::vector<uint32_t>& lookupNoKey() const { return any_routes_; }
+
+  private:
+    struct Range {
+      uint32_t route_;
+      uint32_t first_;
+      uint32_t last_;
+    };
+
+    std::vector<Range> ranges_;
+    std::vector<uint32_t> any_routes_;
+    std::vector<uint32_t> interval_starts_;
+    std::vector<std::vector<uint32_t>> interval_routes_;
+  };
+
   static TcpProxyStats generateStats(const std::string& name, Stats::Store& store);
+  void buildIndexes();
 
   std::vector<Route> routes_;
+  RangeIndex source_ips_index_;
+  RangeIndex source_ports_index_;
+  RangeIndex destination_ips_index_;
+  RangeIndex destination_ports_index_;
   const TcpProxyStats stats_;
+  const bool splice_;
 };
 
 typedef std::shared_ptr<TcpProxyConfig> TcpProxyConfigSharedPtr;
@@ -83,7 +152,9 @@ typedef std::shared_ptr<TcpProxyConfig> TcpProxyConfigSharedPtr;
  * connection using the defined load balancing proxy for the configured cluster. All data will
  * be proxied back and forth between the two connections.
  */
-class TcpProxy : public Network::ReadFilter, Logger::Loggable<Logger::Id::filter> {
+class TcpProxy : public Network::ReadFilter,
+                 public Upstream::LoadBalancerContext,
+                 Logger::Loggable<Logger::Id::filter> {
 public:
   TcpProxy(TcpProxyConfigSharedPtr config, Upstream::ClusterManager& cluster_manager);
   ~TcpProxy();
@@ -93,12 +164,22 @@ public:
   Network::FilterStatus onNewConnection() override { return initializeUpstreamConnection(); }
   void initializeReadFilterCallbacks(Network::ReadFilterCallbacks& callbacks) override;
 
+  // Upstream::LoadBalancerContext
+  const Optional<uint64_t>& hashKey() const override { return hash_key_; }
+  const Upstream::HostMetadata* metadataMatchCriteria() const override { return nullptr; }
+  const Network::Connection* downstreamConnection() const override {
+    return &read_callbacks_->connection();
+  }
+  const Http::HeaderMap* downstreamHeaders() const override { return nullptr; }
+
 private:
   struct DownstreamCallbacks : public Network::ConnectionCallbacks {
     DownstreamCallbacks(TcpProxy& parent) : parent_(parent) {}
 
     // Network::ConnectionCallbacks
     void onEvent(uint32_t event) override { parent_.onDownstreamEvent(event); }
+    void onAboveWriteBufferHighWatermark() override { parent_.readDisableUpstream(true); }
+    void onBelowWriteBufferLowWatermark() override { parent_.readDisableUpstream(false); }
 
     TcpProxy& parent_;
   };
@@ -109,6 +190,8 @@ private:
 
     // Network::ConnectionCallbacks
     void onEvent(uint32_t event) override { parent_.onUpstreamEvent(event); }
+    void onAboveWriteBufferHighWatermark() override { parent_.readDisableDownstream(true); }
+    void onBelowWriteBufferLowWatermark() override { parent_.readDisableDownstream(false); }
 
     // Network::ReadFilter
     Network::FilterStatus onData(Buffer::Instance& data) override {
@@ -124,9 +207,14 @@ private:
   void onDownstreamEvent(uint32_t event);
   void onUpstreamData(Buffer::Instance& data);
   void onUpstreamEvent(uint32_t event);
+  // Flow control: a side whose write buffer is over its high watermark stops reads on the other.
+  void readDisableDownstream(bool disable);
+  void readDisableUpstream(bool disable);
+  void startSplice();
 
   TcpProxyConfigSharedPtr config_;
   Upstream::ClusterManager& cluster_manager_;
+  const Optional<uint64_t> hash_key_;
   Network::ReadFilterCallbacks* read_callbacks_{};
   Network::ClientConnectionPtr upstream_connection_;
   DownstreamCallbacks downstream_callbacks_;
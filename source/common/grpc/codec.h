@@ -39,12 +39,18 @@ public:
   // Decodes the given buffer with GRPC data frame. Drains the input buffer when
   // decoding succeeded (returns true). If the input is not sufficient to make a
   // complete GRPC data frame, it will be buffered in the decoder. If a decoding
-  // error happened, the input buffer remains unchanged.
+  // error happened, the frames before the error are output and drained, and the
+  // input buffer is left starting at the invalid frame.
+  // Frame data is moved out of the input rather than copied byte by byte. Only
+  // the part of a slice that is shared with another frame has to be copied.
   // @param input supplies the binary octets wrapped in a GRPC data frame.
   // @param output supplies the buffer to store the decoded data.
   // @return bool whether the decoding succeeded or not.
   bool decode(Buffer::Instance& input, std::vector<Frame>& output);
 
+  // @return bool whether part of a frame has been received and is buffered.
+  bool hasPartialFrame() const { return state_ == State::DATA || header_length_ > 0; }
+
 private:
   // Wire format (http://www.grpc.io/docs/guides/wire.html) of GRPC data frame
   // header:
@@ -59,26 +65,23 @@ private:
   // is compressed or not (0 is uncompressed, 1 is compressed). The other seven
   // "R" bits are reserved for future use.
   // The next four "L" bytes represent the message length in BigEndian format.
+  static const uint64_t HEADER_SIZE = 5;
+
   enum class State {
-    // Waiting for decoding the flags (1 byte) of the GRPC data frame.
-    FH_FLAG,
-    // Waiting for decoding the 1st byte of the length (4 bytes in total) of the
-    // GRPC data frame.
-    FH_LEN_0,
-    // Waiting for decoding the 2nd byte of the length (4 bytes in total) of the
-    // GRPC data frame.
-    FH_LEN_1,
-    // Waiting for decoding the 3rd byte of the length (4 bytes in total) of the
-    // GRPC data frame.
-    FH_LEN_2,
-    // Waiting for decoding the 4th byte of the length (4 bytes in total) of the
-    // GRPC data frame.
-    FH_LEN_3,
+    // Waiting for the frame header, which may arrive split across slices or
+    // across calls.
+    FH,
     // Waiting for decoding the data.
     DATA,
   };
 
+  // Copies up to size bytes from the front of input into header_ without
+  // draining them.
+  void peekHeader(const Buffer::Instance& input, uint64_t size);
+
   State state_;
+  std::array<uint8_t, HEADER_SIZE> header_;
+  uint64_t header_length_{};
   Frame frame_;
 };
 } // Grpc
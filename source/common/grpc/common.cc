@@ -4,7 +4,9 @@
 
 #include <cstdint>
 #include <cstring>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "common/buffer/buffer_impl.h"
 #include "common/common/assert.h"
@@ -16,6 +18,7 @@
 #include "common/http/utility.h"
 
 #include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl.h"
 #include "google/protobuf/io/zero_copy_stream_impl_lite.h"
 #include "spdlog/spdlog.h"
 
@@ -26,21 +29,35 @@ const std::string Common::GRPC_CONTENT_TYPE{"application/grpc"};
 
 void Common::chargeStat(const Upstream::ClusterInfo& cluster, const std::string& grpc_service,
                         const std::string& grpc_method, bool success) {
-  cluster.statsScope()
-      .counter(
-           fmt::format("grpc.{}.{}.{}", grpc_service, grpc_method, success ? "success" : "failure"))
-      .inc();
-  cluster.statsScope().counter(fmt::format("grpc.{}.{}.total", grpc_service, grpc_method)).inc();
+  const MethodStats* stats = cluster.grpcMethodStats().find(
+      cluster.statsScope(), fmt::format("/{}/{}", grpc_service, grpc_method));
+  if (stats) {
+    chargeStat(*stats, success);
+  }
+}
+
+void Common::chargeStat(const MethodStats& stats, bool success) {
+  if (success) {
+    stats.success_.inc();
+  } else {
+    stats.failure_.inc();
+  }
+  stats.total_.inc();
 }
 
 Buffer::InstancePtr Common::serializeBody(const google::protobuf::Message& message) {
+  Buffer::InstancePtr body(new Buffer::OwnedImpl());
+  serializeBody(message, *body);
+  return body;
+}
+
+void Common::serializeBody(const google::protobuf::Message& message, Buffer::Instance& body) {
   // http://www.grpc.io/docs/guides/wire.html
   // Reserve enough space for the entire message and the 5 byte header.
-  Buffer::InstancePtr body(new Buffer::OwnedImpl());
   const uint32_t size = message.ByteSize();
   const uint32_t alloc_size = size + 5;
   Buffer::RawSlice iovec;
-  body->reserve(alloc_size, &iovec, 1);
+  body.reserve(alloc_size, &iovec, 1);
   ASSERT(iovec.len_ >= alloc_size);
   iovec.len_ = alloc_size;
   uint8_t* current = reinterpret_cast<uint8_t*>(iovec.mem_);
@@ -51,29 +68,68 @@ Buffer::InstancePtr Common::serializeBody(const google::protobuf::Message& messa
   google::protobuf::io::ArrayOutputStream stream(current, size, -1);
   google::protobuf::io::CodedOutputStream codec_stream(&stream);
   message.SerializeWithCachedSizes(&codec_stream);
-  body->commit(&iovec, 1);
-  return body;
+  body.commit(&iovec, 1);
+}
+
+void Common::serializeTrailers(const Http::HeaderMap& trailers, Buffer::Instance& body) {
+  Buffer::OwnedImpl payload;
+  trailers.iterate([](const Http::HeaderEntry& header, void* context) -> void {
+    Buffer::Instance* payload = static_cast<Buffer::Instance*>(context);
+    payload->add(header.key().c_str(), header.key().size());
+    payload->add(":");
+    payload->add(header.value().c_str(), header.value().size());
+    payload->add("\r\n");
+  }, &payload);
+
+  const uint8_t flags = 0b10000000;
+  body.add(&flags, 1);
+  const uint32_t length = htonl(payload.length());
+  body.add(&length, sizeof(length));
+  body.move(payload);
+}
+
+bool Common::parseBody(const Buffer::Instance& body, google::protobuf::Message& message) {
+  const uint64_t num_slices = body.getRawSlices(nullptr, 0);
+  Buffer::RawSlice slices[num_slices];
+  body.getRawSlices(slices, num_slices);
+
+  std::vector<std::unique_ptr<google::protobuf::io::ArrayInputStream>> slice_streams;
+  std::vector<google::protobuf::io::ZeroCopyInputStream*> slice_stream_ptrs;
+  slice_streams.reserve(num_slices);
+  slice_stream_ptrs.reserve(num_slices);
+  for (const Buffer::RawSlice& slice : slices) {
+    slice_streams.emplace_back(
+        new google::protobuf::io::ArrayInputStream(slice.mem_, static_cast<int>(slice.len_)));
+    slice_stream_ptrs.push_back(slice_streams.back().get());
+  }
+
+  google::protobuf::io::ConcatenatingInputStream stream(slice_stream_ptrs.data(),
+                                                        static_cast<int>(num_slices));
+  return message.ParseFromZeroCopyStream(&stream);
 }
 
 Http::MessagePtr Common::prepareHeaders(const std::string& upstream_cluster,
                                         const std::string& service_full_name,
                                         const std::string& method_name) {
   Http::MessagePtr message(new Http::RequestMessageImpl());
-  message->headers().insertMethod().value(Http::Headers::get().MethodValues.Post);
-  message->headers().insertPath().value().append("/", 1);
-  message->headers().insertPath().value().append(service_full_name.c_str(),
-                                                 service_full_name.size());
-  message->headers().insertPath().value().append("/", 1);
-  message->headers().insertPath().value().append(method_name.c_str(), method_name.size());
-  message->headers().insertHost().value(upstream_cluster);
-  message->headers().insertContentType().value(Common::GRPC_CONTENT_TYPE);
-
+  prepareHeaders(message->headers(), upstream_cluster, service_full_name, method_name);
   return message;
 }
 
-void Common::checkForHeaderOnlyError(Http::Message& http_response) {
+void Common::prepareHeaders(Http::HeaderMap& headers, const std::string& upstream_cluster,
+                            const std::string& service_full_name, const std::string& method_name) {
+  headers.insertMethod().value(Http::Headers::get().MethodValues.Post);
+  headers.insertPath().value().append("/", 1);
+  headers.insertPath().value().append(service_full_name.c_str(), service_full_name.size());
+  headers.insertPath().value().append("/", 1);
+  headers.insertPath().value().append(method_name.c_str(), method_name.size());
+  headers.insertHost().value(upstream_cluster);
+  headers.insertContentType().value(Common::GRPC_CONTENT_TYPE);
+}
+
+void Common::checkForHeaderOnlyError(const Http::HeaderMap& headers) {
   // First check for grpc-status in headers. If it is here, we have an error.
-  const Http::HeaderEntry* grpc_status_header = http_response.headers().GrpcStatus();
+  const Http::HeaderEntry* grpc_status_header = headers.GrpcStatus();
   if (!grpc_status_header) {
     return;
   }
@@ -83,24 +139,28 @@ void Common::checkForHeaderOnlyError(Http::Message& http_response) {
     throw Exception(Optional<uint64_t>(), "bad grpc-status header");
   }
 
-  const Http::HeaderEntry* grpc_status_message = http_response.headers().GrpcMessage();
+  const Http::HeaderEntry* grpc_status_message = headers.GrpcMessage();
   throw Exception(grpc_status_code,
                   grpc_status_message ? grpc_status_message->value().c_str() : EMPTY_STRING);
 }
 
 void Common::validateResponse(Http::Message& http_response) {
-  if (Http::Utility::getResponseStatus(http_response.headers()) != enumToInt(Http::Code::OK)) {
+  validateResponse(http_response.headers(), http_response.trailers());
+}
+
+void Common::validateResponse(const Http::HeaderMap& headers, const Http::HeaderMap* trailers) {
+  if (Http::Utility::getResponseStatus(headers) != enumToInt(Http::Code::OK)) {
     throw Exception(Optional<uint64_t>(), "non-200 response code");
   }
 
-  checkForHeaderOnlyError(http_response);
+  checkForHeaderOnlyError(headers);
 
   // Check for existence of trailers.
-  if (!http_response.trailers()) {
+  if (!trailers) {
     throw Exception(Optional<uint64_t>(), "no response trailers");
   }
 
-  const Http::HeaderEntry* grpc_status_header = http_response.trailers()->GrpcStatus();
+  const Http::HeaderEntry* grpc_status_header = trailers->GrpcStatus();
   uint64_t grpc_status_code;
   if (!grpc_status_header ||
       !StringUtil::atoul(grpc_status_header->value().c_str(), grpc_status_code)) {
@@ -108,7 +168,7 @@ void Common::validateResponse(Http::Message& http_response) {
   }
 
   if (grpc_status_code != 0) {
-    const Http::HeaderEntry* grpc_status_message = http_response.trailers()->GrpcMessage();
+    const Http::HeaderEntry* grpc_status_message = trailers->GrpcMessage();
     throw Exception(grpc_status_code,
                     grpc_status_message ? grpc_status_message->value().c_str() : EMPTY_STRING);
   }
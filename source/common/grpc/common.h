@@ -5,6 +5,7 @@
 
 #include "envoy/common/exception.h"
 #include "envoy/common/optional.h"
+#include "envoy/grpc/method_stats.h"
 #include "envoy/http/header_map.h"
 #include "envoy/http/message.h"
 #include "envoy/stats/stats.h"
@@ -34,11 +35,43 @@ public:
    */
   static void chargeStat(const Upstream::ClusterInfo& cluster, const std::string& grpc_service,
                          const std::string& grpc_method, bool success);
+
+  /**
+   * Charge a success/failure stat to the stats of a method.
+   * @param stats supplies the stats of the method, as found in the cluster's method stats table.
+   * @param success supplies whether the call succeeded.
+   */
+  static void chargeStat(const MethodStats& stats, bool success);
   /**
    * Serialize protobuf message.
    */
   static Buffer::InstancePtr serializeBody(const google::protobuf::Message& message);
 
+  /**
+   * Serialize a protobuf message with its gRPC frame header directly into a buffer.
+   * @param message supplies the message to serialize.
+   * @param body supplies the buffer to append the framed message to.
+   */
+  static void serializeBody(const google::protobuf::Message& message, Buffer::Instance& body);
+
+  /**
+   * Serialize trailers into a trailers frame, a gRPC frame with the most significant bit of the
+   * flags set whose payload is the trailers as "name:value" lines separated by CRLFs. This is how
+   * gRPC-Web and the HTTP/1.1 bridge carry trailers in the body of a response.
+   * @param trailers supplies the trailers to serialize.
+   * @param body supplies the buffer to append the frame to.
+   */
+  static void serializeTrailers(const Http::HeaderMap& trailers, Buffer::Instance& body);
+
+  /**
+   * Parse a protobuf message from a buffer without copying it into a string first. The gRPC frame
+   * header must already have been drained.
+   * @param body supplies the serialized message.
+   * @param message supplies the message to parse into.
+   * @return bool whether the message was parsed.
+   */
+  static bool parseBody(const Buffer::Instance& body, google::protobuf::Message& message);
+
   /**
    * Prepare headers for protobuf service.
    */
@@ -46,15 +79,29 @@ public:
                                          const std::string& service_full_name,
                                          const std::string& method_name);
 
+  /**
+   * Add the request headers for protobuf service to a header map.
+   */
+  static void prepareHeaders(Http::HeaderMap& headers, const std::string& upstream_cluster,
+                             const std::string& service_full_name, const std::string& method_name);
+
   /**
    * Basic validation of gRPC response, @throws Grpc::Exception in case of non successful response.
    */
   static void validateResponse(Http::Message& http_response);
 
+  /**
+   * Validation of the headers and trailers of a gRPC response that was received as a stream.
+   * @throws Grpc::Exception in case of non successful response.
+   * @param headers supplies the response headers.
+   * @param trailers supplies the response trailers, or nullptr if there were none.
+   */
+  static void validateResponse(const Http::HeaderMap& headers, const Http::HeaderMap* trailers);
+
   static const std::string GRPC_CONTENT_TYPE;
 
 private:
-  static void checkForHeaderOnlyError(Http::Message& http_response);
+  static void checkForHeaderOnlyError(const Http::HeaderMap& headers);
 };
 
 } // Grpc
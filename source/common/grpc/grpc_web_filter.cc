@@ -3,14 +3,12 @@
 #include <arpa/inet.h>
 
 #include "common/common/base64.h"
+#include "common/grpc/common.h"
 #include "common/http/headers.h"
 
 namespace Envoy {
 namespace Grpc {
 
-// Bit mask denotes a trailers frame of gRPC-Web.
-const uint8_t GrpcWebFilter::GRPC_WEB_TRAILER = 0b10000000;
-
 // Implements StreamDecoderFilter.
 // TODO(fengli): Implements the subtypes of gRPC-Web content-type, like +proto, etc.
 Http::FilterHeadersStatus GrpcWebFilter::decodeHeaders(Http::HeaderMap& headers, bool) {
@@ -51,15 +49,20 @@ Http::FilterDataStatus GrpcWebFilter::decodeData(Buffer::Instance& data, bool) {
     return Http::FilterDataStatus::StopIterationNoBuffer;
   }
 
-  const uint64_t needed =
-      (data.length() + decoding_buffer_.length()) / 4 * 4 - decoding_buffer_.length();
-  decoding_buffer_.move(data, needed);
-  const std::string decoded = Base64::decode(
-      std::string(static_cast<const char*>(decoding_buffer_.linearize(decoding_buffer_.length())),
-                  decoding_buffer_.length()));
-  decoding_buffer_.drain(decoding_buffer_.length());
+  // The body is decoded slice by slice, so only a partial quartet of at most three bytes is ever
+  // held back between calls.
+  Buffer::OwnedImpl decoded;
+  if (decoding_buffer_.length() > 0) {
+    decoding_buffer_.move(data, 4 - decoding_buffer_.length());
+    Base64::decode(decoding_buffer_, 4, decoded);
+    decoding_buffer_.drain(4);
+  }
+
+  const uint64_t available = data.length() / 4 * 4;
+  Base64::decode(data, available, decoded);
+  data.drain(available);
   decoding_buffer_.move(data);
-  data.add(decoded);
+  data.move(decoded);
   return Http::FilterDataStatus::Continue;
 }
 
@@ -89,40 +92,28 @@ Http::FilterDataStatus GrpcWebFilter::encodeData(Buffer::Instance& data, bool) {
     return Http::FilterDataStatus::StopIterationNoBuffer;
   }
 
-  // Encodes the decoded gRPC frames with base64.
+  // Encodes the decoded gRPC frames with base64. The frame data is moved rather than copied and is
+  // encoded straight from its slices.
   for (auto& frame : frames) {
     Buffer::OwnedImpl temp;
     temp.add(&frame.flags_, 1);
     const uint32_t length = htonl(frame.length_);
     temp.add(&length, 4);
     if (frame.length_ > 0) {
-      temp.add(*frame.data_);
+      temp.move(*frame.data_);
     }
-    data.add(Base64::encode(temp, temp.length()));
+    Base64::encode(temp, temp.length(), data);
   }
   return Http::FilterDataStatus::Continue;
 }
 
 Http::FilterTrailersStatus GrpcWebFilter::encodeTrailers(Http::HeaderMap& trailers) {
   // Trailers are expected to come all in once, and will be encoded into one single trailers frame.
-  // Trailers in the trailers frame are separated by CRLFs.
-  Buffer::OwnedImpl temp;
-  trailers.iterate([](const Http::HeaderEntry& header, void* context) -> void {
-    Buffer::Instance* temp = static_cast<Buffer::Instance*>(context);
-    temp->add(header.key().c_str(), header.key().size());
-    temp->add(":");
-    temp->add(header.value().c_str(), header.value().size());
-    temp->add("\r\n");
-  }, &temp);
   Buffer::OwnedImpl buffer;
-  // Adds the trailers frame head.
-  buffer.add(&GRPC_WEB_TRAILER, 1);
-  // Adds the trailers frame length.
-  const uint32_t length = htonl(temp.length());
-  buffer.add(&length, 4);
-  buffer.move(temp);
+  Common::serializeTrailers(trailers, buffer);
   if (is_text_response_) {
-    Buffer::OwnedImpl encoded(Base64::encode(buffer, buffer.length()));
+    Buffer::OwnedImpl encoded;
+    Base64::encode(buffer, buffer.length(), encoded);
     encoder_callbacks_->addEncodedData(encoded);
   } else {
     encoder_callbacks_->addEncodedData(buffer);
@@ -36,7 +36,6 @@ public:
   }
 
 private:
-  static const uint8_t GRPC_WEB_TRAILER;
   Http::StreamEncoderFilterCallbacks* encoder_callbacks_{};
   bool is_text_request_{};
   bool is_text_response_{};
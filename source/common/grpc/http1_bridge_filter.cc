@@ -2,10 +2,10 @@
 
 #include <cstdint>
 #include <string>
-#include <vector>
 
 #include "envoy/http/codes.h"
 
+#include "common/buffer/buffer_impl.h"
 #include "common/common/enum_to_int.h"
 #include "common/common/utility.h"
 #include "common/grpc/common.h"
@@ -25,7 +25,11 @@ void Http1BridgeFilter::chargeStat(const Http::HeaderMap& headers) {
   bool success = StringUtil::atoul(grpc_status_header->value().c_str(), grpc_status_code) &&
                  grpc_status_code == 0;
 
-  Common::chargeStat(*cluster_, grpc_service_, grpc_method_, success);
+  Common::chargeStat(*method_stats_, success);
+  if (request_timer_) {
+    request_timer_->complete();
+    request_timer_.reset();
+  }
 }
 
 Http::FilterHeadersStatus Http1BridgeFilter::decodeHeaders(Http::HeaderMap& headers, bool) {
@@ -50,6 +54,11 @@ Http::FilterHeadersStatus Http1BridgeFilter::encodeHeaders(Http::HeaderMap& head
 
   if (!do_bridging_ || end_stream) {
     return Http::FilterHeadersStatus::Continue;
+  } else if (streaming_) {
+    // The trailers frame is appended to the body, so any upstream content length no longer holds
+    // and the HTTP/1.1 codec falls back to chunk encoding.
+    headers.removeContentLength();
+    return Http::FilterHeadersStatus::Continue;
   } else {
     response_headers_ = &headers;
     return Http::FilterHeadersStatus::StopIteration;
@@ -57,7 +66,7 @@ Http::FilterHeadersStatus Http1BridgeFilter::encodeHeaders(Http::HeaderMap& head
 }
 
 Http::FilterDataStatus Http1BridgeFilter::encodeData(Buffer::Instance&, bool end_stream) {
-  if (!do_bridging_ || end_stream) {
+  if (!do_bridging_ || streaming_ || end_stream) {
     return Http::FilterDataStatus::Continue;
   } else {
     return Http::FilterDataStatus::StopIterationAndBuffer;
@@ -69,7 +78,12 @@ Http::FilterTrailersStatus Http1BridgeFilter::encodeTrailers(Http::HeaderMap& tr
     chargeStat(trailers);
   }
 
-  if (do_bridging_) {
+  if (do_bridging_ && streaming_) {
+    // The HTTP/1.1 codec drops trailers, so pass them on as the last frame of the body.
+    Buffer::OwnedImpl frame;
+    Common::serializeTrailers(trailers, frame);
+    encoder_callbacks_->addEncodedData(frame);
+  } else if (do_bridging_) {
     // Here we check for grpc-status. If it's not zero, we change the response code. We assume
     // that if a reset comes in and we disconnect the HTTP/1.1 client it will raise some type
     // of exception/error that the response was not complete.
@@ -112,13 +126,13 @@ void Http1BridgeFilter::setupStatTracking(const Http::HeaderMap& headers) {
   }
   cluster_ = cluster->info();
 
-  std::vector<std::string> parts = StringUtil::split(headers.Path()->value().c_str(), '/');
-  if (parts.size() != 2) {
+  method_stats_ =
+      cluster_->grpcMethodStats().find(cluster_->statsScope(), headers.Path()->value().c_str());
+  if (!method_stats_) {
     return;
   }
 
-  grpc_service_ = parts[0];
-  grpc_method_ = parts[1];
+  request_timer_ = method_stats_->upstream_rq_time_.allocateSpan();
   do_stat_tracking_ = true;
 }
 
@@ -2,7 +2,9 @@
 
 #include <string>
 
+#include "envoy/grpc/method_stats.h"
 #include "envoy/http/filter.h"
+#include "envoy/stats/stats.h"
 #include "envoy/upstream/cluster_manager.h"
 
 namespace Envoy {
@@ -13,7 +15,14 @@ namespace Grpc {
  */
 class Http1BridgeFilter : public Http::StreamFilter {
 public:
-  Http1BridgeFilter(Upstream::ClusterManager& cm) : cm_(cm) {}
+  /**
+   * @param cm supplies the cluster manager used for stats.
+   * @param streaming supplies whether responses flow through as they arrive, with the trailers
+   *        appended to the body as a trailers frame. Otherwise responses are buffered so that the
+   *        grpc-status trailer can be mapped to the HTTP status and headers.
+   */
+  Http1BridgeFilter(Upstream::ClusterManager& cm, bool streaming)
+      : cm_(cm), streaming_(streaming) {}
 
   // Http::StreamFilterBase
   void onDestroy() override {}
@@ -43,14 +52,16 @@ private:
   void setupStatTracking(const Http::HeaderMap& headers);
 
   Upstream::ClusterManager& cm_;
+  const bool streaming_;
   Http::StreamDecoderFilterCallbacks* decoder_callbacks_{};
   Http::StreamEncoderFilterCallbacks* encoder_callbacks_{};
   Http::HeaderMap* response_headers_{};
   bool do_bridging_{};
   bool do_stat_tracking_{};
+  // Keeps the cluster, and with it the scope of the method stats, alive.
   Upstream::ClusterInfoConstSharedPtr cluster_;
-  std::string grpc_service_;
-  std::string grpc_method_;
+  const MethodStats* method_stats_{};
+  Stats::TimespanPtr request_timer_;
 };
 
 } // Grpc
@@ -0,0 +1,45 @@
+#include "common/grpc/method_stats_impl.h"
+
+#include <string>
+#include <vector>
+
+#include "common/common/utility.h"
+
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+namespace Grpc {
+
+const MethodStats* MethodStatsTableImpl::find(Stats::Scope& scope, const std::string& path) {
+  std::unique_lock<std::mutex> lock(lock_);
+  auto it = methods_.find(path);
+  if (it != methods_.end()) {
+    return it->second.get();
+  }
+
+  std::vector<std::string> parts = StringUtil::split(path, '/');
+  if (parts.size() != 2) {
+    return nullptr;
+  }
+
+  if (methods_.size() >= max_methods_) {
+    if (!overflow_) {
+      overflow_ = makeStats(scope, "grpc.overflow.");
+    }
+    return overflow_.get();
+  }
+
+  std::unique_ptr<MethodStats>& stats = methods_[path];
+  stats = makeStats(scope, fmt::format("grpc.{}.{}.", parts[0], parts[1]));
+  return stats.get();
+}
+
+std::unique_ptr<MethodStats> MethodStatsTableImpl::makeStats(Stats::Scope& scope,
+                                                             const std::string& prefix) {
+  return std::unique_ptr<MethodStats>(
+      new MethodStats{scope.counter(prefix + "success"), scope.counter(prefix + "failure"),
+                      scope.counter(prefix + "total"), scope.timer(prefix + "upstream_rq_time")});
+}
+
+} // Grpc
+} // Envoy
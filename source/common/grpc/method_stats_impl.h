@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "envoy/grpc/method_stats.h"
+#include "envoy/stats/stats.h"
+
+namespace Envoy {
+namespace Grpc {
+
+/**
+ * MethodStatsTable that interns up to a fixed number of method paths. Workers share the table, so
+ * lookups take a lock, but once a path is interned a lookup is a single hash of the path.
+ */
+class MethodStatsTableImpl : public MethodStatsTable {
+public:
+  MethodStatsTableImpl(uint32_t max_methods = DEFAULT_MAX_METHODS) : max_methods_(max_methods) {}
+
+  // Grpc::MethodStatsTable
+  const MethodStats* find(Stats::Scope& scope, const std::string& path) override;
+
+  static const uint32_t DEFAULT_MAX_METHODS = 256;
+
+private:
+  static std::unique_ptr<MethodStats> makeStats(Stats::Scope& scope, const std::string& prefix);
+
+  const uint32_t max_methods_;
+  std::mutex lock_;
+  // Keyed by the path. Only paths that name a method are interned.
+  std::unordered_map<std::string, std::unique_ptr<MethodStats>> methods_;
+  std::unique_ptr<MethodStats> overflow_;
+};
+
+} // Grpc
+} // Envoy
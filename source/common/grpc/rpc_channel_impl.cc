@@ -6,6 +6,7 @@
 #include "common/common/enum_to_int.h"
 #include "common/common/utility.h"
 #include "common/grpc/common.h"
+#include "common/http/header_map_impl.h"
 #include "common/http/headers.h"
 #include "common/http/message_impl.h"
 #include "common/http/utility.h"
@@ -59,7 +60,7 @@ void RpcChannelImpl::onSuccess(Http::MessagePtr&& http_response) {
     }
 
     http_response->body()->drain(5);
-    if (!grpc_response_->ParseFromString(http_response->bodyAsString())) {
+    if (!Common::parseBody(*http_response->body(), *grpc_response_)) {
       throw Exception(Optional<uint64_t>(), "bad serialized body");
     }
 
@@ -92,5 +93,114 @@ void RpcChannelImpl::onComplete() {
   grpc_response_ = nullptr;
 }
 
+void StreamingRpcChannelImpl::cancel() {
+  Http::AsyncClient::Stream* stream = stream_;
+  onComplete();
+  // The reset calls onReset() inline, which is ignored now that the call is complete.
+  stream->reset();
+}
+
+void StreamingRpcChannelImpl::CallMethod(const proto::MethodDescriptor* method,
+                                         proto::RpcController*, const proto::Message* grpc_request,
+                                         proto::Message* grpc_response, proto::Closure*) {
+  ASSERT(!stream_ && !grpc_method_ && !grpc_response_);
+  grpc_method_ = method;
+  grpc_response_ = grpc_response;
+  ASSERT(grpc_request->IsInitialized());
+  ASSERT(cluster_->features() & Upstream::ClusterInfo::Features::HTTP2);
+
+  // The router keeps a reference to the request headers for the life of the stream, so they are
+  // rebuilt for each call rather than shared. The body buffers are reused.
+  request_headers_.reset(new Http::HeaderMapImpl());
+  Common::prepareHeaders(*request_headers_, cluster_->name(), method->service()->full_name(),
+                         method->name());
+  callbacks_.onPreRequestCustomizeHeaders(*request_headers_);
+  request_body_.drain(request_body_.length());
+  Common::serializeBody(*grpc_request, request_body_);
+
+  stream_ = cm_.httpAsyncClientForCluster(cluster_->name()).start(*this, timeout_);
+  if (!stream_) {
+    // onReset() has already been called.
+    return;
+  }
+
+  Http::AsyncClient::Stream* stream = stream_;
+  stream->sendHeaders(*request_headers_, false);
+  if (!grpc_method_) {
+    // The router answered while the headers were sent, e.g. because there was no healthy upstream.
+    // Nothing else is waiting for the stream, so finish it.
+    stream->reset();
+    return;
+  }
+
+  stream->sendData(request_body_, true);
+}
+
+void StreamingRpcChannelImpl::onHeaders(Http::HeaderMapPtr&& headers, bool end_stream) {
+  response_headers_ = std::move(headers);
+  if (end_stream) {
+    onRemoteComplete(nullptr);
+  }
+}
+
+void StreamingRpcChannelImpl::onData(Buffer::Instance& data, bool end_stream) {
+  response_body_.move(data);
+  if (end_stream) {
+    onRemoteComplete(nullptr);
+  }
+}
+
+void StreamingRpcChannelImpl::onTrailers(Http::HeaderMapPtr&& trailers) {
+  onRemoteComplete(trailers.get());
+}
+
+void StreamingRpcChannelImpl::onReset() {
+  if (grpc_method_) {
+    onFailureWorker(Optional<uint64_t>(), "stream reset");
+  }
+}
+
+void StreamingRpcChannelImpl::onRemoteComplete(const Http::HeaderMap* trailers) {
+  try {
+    Common::validateResponse(*response_headers_, trailers);
+
+    // As with RpcChannelImpl only unary responses are supported, so the 5 byte header is ignored.
+    if (response_body_.length() < 5) {
+      throw Exception(Optional<uint64_t>(), "bad serialized body");
+    }
+
+    response_body_.drain(5);
+    if (!Common::parseBody(response_body_, *grpc_response_)) {
+      throw Exception(Optional<uint64_t>(), "bad serialized body");
+    }
+
+    callbacks_.onSuccess();
+    incStat(true);
+    onComplete();
+  } catch (const Exception& e) {
+    onFailureWorker(e.grpc_status_, e.what());
+  }
+}
+
+void StreamingRpcChannelImpl::incStat(bool success) {
+  Common::chargeStat(*cluster_, grpc_method_->service()->full_name(), grpc_method_->name(),
+                     success);
+}
+
+void StreamingRpcChannelImpl::onFailureWorker(const Optional<uint64_t>& grpc_status,
+                                              const std::string& message) {
+  callbacks_.onFailure(grpc_status, message);
+  incStat(false);
+  onComplete();
+}
+
+void StreamingRpcChannelImpl::onComplete() {
+  stream_ = nullptr;
+  grpc_method_ = nullptr;
+  grpc_response_ = nullptr;
+  response_headers_.reset();
+  response_body_.drain(response_body_.length());
+}
+
 } // Grpc
 } // Envoy
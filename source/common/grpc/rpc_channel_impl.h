@@ -5,8 +5,10 @@
 #include <string>
 
 #include "envoy/grpc/rpc_channel.h"
+#include "envoy/http/async_client.h"
 #include "envoy/upstream/cluster_manager.h"
 
+#include "common/buffer/buffer_impl.h"
 #include "common/common/assert.h"
 
 namespace Envoy {
@@ -63,5 +65,54 @@ private:
   Optional<std::chrono::milliseconds> timeout_;
 };
 
+/**
+ * RpcChannel that makes each call on an HTTP/2 stream from the async client's streaming API
+ * instead of as a buffered request. The request is serialized straight into a buffer that the
+ * channel reuses across calls, and the response is parsed from the received buffer without being
+ * copied into a string. Calls share the cluster's long-lived HTTP/2 connections. This is meant for
+ * high rate internal services such as rate limiting and is used the same way as RpcChannelImpl.
+ */
+class StreamingRpcChannelImpl : public RpcChannel, public Http::AsyncClient::StreamCallbacks {
+public:
+  StreamingRpcChannelImpl(Upstream::ClusterManager& cm, const std::string& cluster,
+                          RpcChannelCallbacks& callbacks,
+                          const Optional<std::chrono::milliseconds>& timeout)
+      : cm_(cm), cluster_(cm.get(cluster)->info()), callbacks_(callbacks), timeout_(timeout) {}
+
+  ~StreamingRpcChannelImpl() { ASSERT(!stream_ && !grpc_method_ && !grpc_response_); }
+
+  // Grpc::RpcChannel
+  void cancel() override;
+
+  // proto::RpcChannel
+  void CallMethod(const proto::MethodDescriptor* method, proto::RpcController* controller,
+                  const proto::Message* grpc_request, proto::Message* grpc_response,
+                  proto::Closure* done_callback) override;
+
+private:
+  void incStat(bool success);
+  void onComplete();
+  void onFailureWorker(const Optional<uint64_t>& grpc_status, const std::string& message);
+  void onRemoteComplete(const Http::HeaderMap* trailers);
+
+  // Http::AsyncClient::StreamCallbacks
+  void onHeaders(Http::HeaderMapPtr&& headers, bool end_stream) override;
+  void onData(Buffer::Instance& data, bool end_stream) override;
+  void onTrailers(Http::HeaderMapPtr&& trailers) override;
+  void onReset() override;
+
+  Upstream::ClusterManager& cm_;
+  Upstream::ClusterInfoConstSharedPtr cluster_;
+  Http::AsyncClient::Stream* stream_{};
+  const proto::MethodDescriptor* grpc_method_{};
+  proto::Message* grpc_response_{};
+  RpcChannelCallbacks& callbacks_;
+  Optional<std::chrono::milliseconds> timeout_;
+  Http::HeaderMapPtr request_headers_;
+  Buffer::OwnedImpl request_body_;
+  Http::HeaderMapPtr response_headers_;
+  Buffer::OwnedImpl response_body_;
+};
+
 } // Grpc
 } // Envoy
@@ -1,7 +1,10 @@
 #include "common/http/access_log/access_log_formatter.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "common/common/assert.h"
@@ -27,66 +30,41 @@ const std::string ResponseFlagUtils::DELAY_INJECTED = "DI";
 const std::string ResponseFlagUtils::FAULT_INJECTED = "FI";
 const std::string ResponseFlagUtils::RATE_LIMITED = "RL";
 
-void ResponseFlagUtils::appendString(std::string& result, const std::string& append) {
-  if (result.empty()) {
-    result = append;
-  } else {
-    result += "," + append;
-  }
-}
-
 const std::string ResponseFlagUtils::toShortString(const RequestInfo& request_info) {
   std::string result;
+  appendShortString(request_info, result);
+  return result;
+}
 
-  if (request_info.getResponseFlag(ResponseFlag::FailedLocalHealthCheck)) {
-    appendString(result, FAILED_LOCAL_HEALTH_CHECK);
-  }
-
-  if (request_info.getResponseFlag(ResponseFlag::NoHealthyUpstream)) {
-    appendString(result, NO_HEALTHY_UPSTREAM);
-  }
-
-  if (request_info.getResponseFlag(ResponseFlag::UpstreamRequestTimeout)) {
-    appendString(result, UPSTREAM_REQUEST_TIMEOUT);
-  }
-
-  if (request_info.getResponseFlag(ResponseFlag::LocalReset)) {
-    appendString(result, LOCAL_RESET);
-  }
-
-  if (request_info.getResponseFlag(ResponseFlag::UpstreamRemoteReset)) {
-    appendString(result, UPSTREAM_REMOTE_RESET);
-  }
-
-  if (request_info.getResponseFlag(ResponseFlag::UpstreamConnectionFailure)) {
-    appendString(result, UPSTREAM_CONNECTION_FAILURE);
-  }
-
-  if (request_info.getResponseFlag(ResponseFlag::UpstreamConnectionTermination)) {
-    appendString(result, UPSTREAM_CONNECTION_TERMINATION);
-  }
-
-  if (request_info.getResponseFlag(ResponseFlag::UpstreamOverflow)) {
-    appendString(result, UPSTREAM_OVERFLOW);
-  }
-
-  if (request_info.getResponseFlag(ResponseFlag::NoRouteFound)) {
-    appendString(result, NO_ROUTE_FOUND);
-  }
-
-  if (request_info.getResponseFlag(ResponseFlag::DelayInjected)) {
-    appendString(result, DELAY_INJECTED);
-  }
-
-  if (request_info.getResponseFlag(ResponseFlag::FaultInjected)) {
-    appendString(result, FAULT_INJECTED);
+void ResponseFlagUtils::appendShortString(const RequestInfo& request_info, std::string& output) {
+  static const std::vector<std::pair<ResponseFlag, const std::string*>> flags = {
+      {ResponseFlag::FailedLocalHealthCheck, &FAILED_LOCAL_HEALTH_CHECK},
+      {ResponseFlag::NoHealthyUpstream, &NO_HEALTHY_UPSTREAM},
+      {ResponseFlag::UpstreamRequestTimeout, &UPSTREAM_REQUEST_TIMEOUT},
+      {ResponseFlag::LocalReset, &LOCAL_RESET},
+      {ResponseFlag::UpstreamRemoteReset, &UPSTREAM_REMOTE_RESET},
+      {ResponseFlag::UpstreamConnectionFailure, &UPSTREAM_CONNECTION_FAILURE},
+      {ResponseFlag::UpstreamConnectionTermination, &UPSTREAM_CONNECTION_TERMINATION},
+      {ResponseFlag::UpstreamOverflow, &UPSTREAM_OVERFLOW},
+      {ResponseFlag::NoRouteFound, &NO_ROUTE_FOUND},
+      {ResponseFlag::DelayInjected, &DELAY_INJECTED},
+      {ResponseFlag::FaultInjected, &FAULT_INJECTED},
+      {ResponseFlag::RateLimited, &RATE_LIMITED},
+  };
+
+  const size_t start = output.size();
+  for (const auto& flag : flags) {
+    if (request_info.getResponseFlag(flag.first)) {
+      if (output.size() != start) {
+        output += ',';
+      }
+      output += *flag.second;
+    }
   }
 
-  if (request_info.getResponseFlag(ResponseFlag::RateLimited)) {
-    appendString(result, RATE_LIMITED);
+  if (output.size() == start) {
+    output += NONE;
   }
-
-  return result.empty() ? NONE : result;
 }
 
 const std::string AccessLogFormatUtils::DEFAULT_FORMAT =
@@ -117,21 +95,24 @@ const std::string& AccessLogFormatUtils::protocolToString(Protocol protocol) {
   NOT_REACHED;
 }
 
+std::string FormatterBase::format(const Http::HeaderMap& request_headers,
+                                  const Http::HeaderMap& response_headers,
+                                  const RequestInfo& request_info) const {
+  std::string output;
+  formatTo(output, request_headers, response_headers, request_info);
+  return output;
+}
+
 FormatterImpl::FormatterImpl(const std::string& format) {
   formatters_ = AccessLogFormatParser::parse(format);
 }
 
-std::string FormatterImpl::format(const Http::HeaderMap& request_headers,
-                                  const Http::HeaderMap& response_headers,
-                                  const RequestInfo& request_info) const {
-  std::string log_line;
-  log_line.reserve(256);
-
+void FormatterImpl::formatTo(std::string& output, const Http::HeaderMap& request_headers,
+                             const Http::HeaderMap& response_headers,
+                             const RequestInfo& request_info) const {
   for (const FormatterPtr& formatter : formatters_) {
-    log_line += formatter->format(request_headers, response_headers, request_info);
+    formatter->formatTo(output, request_headers, response_headers, request_info);
   }
-
-  return log_line;
 }
 
 void AccessLogFormatParser::parseCommand(const std::string& token, const size_t start,
@@ -227,67 +208,81 @@ std::vector<FormatterPtr> AccessLogFormatParser::parse(const std::string& format
 }
 
 RequestInfoFormatter::RequestInfoFormatter(const std::string& field_name) {
-  if (field_name == "START_TIME") {
-    field_extractor_ = [](const RequestInfo& request_info) {
-      return AccessLogDateTimeFormatter::fromTime(request_info.startTime());
-    };
-  } else if (field_name == "BYTES_RECEIVED") {
-    field_extractor_ = [](const RequestInfo& request_info) {
-      return std::to_string(request_info.bytesReceived());
-    };
-  } else if (field_name == "PROTOCOL") {
-    field_extractor_ = [](const RequestInfo& request_info) {
-      return AccessLogFormatUtils::protocolToString(request_info.protocol());
-    };
-  } else if (field_name == "RESPONSE_CODE") {
-    field_extractor_ = [](const RequestInfo& request_info) {
-      return request_info.responseCode().valid()
-                 ? std::to_string(request_info.responseCode().value())
-                 : "0";
-    };
-  } else if (field_name == "BYTES_SENT") {
-    field_extractor_ =
-        [](const RequestInfo& request_info) { return std::to_string(request_info.bytesSent()); };
-  } else if (field_name == "DURATION") {
-    field_extractor_ = [](const RequestInfo& request_info) {
-      return std::to_string(request_info.duration().count());
-    };
-  } else if (field_name == "RESPONSE_FLAGS") {
-    field_extractor_ = [](const RequestInfo& request_info) {
-      return ResponseFlagUtils::toShortString(request_info);
-    };
-  } else if (field_name == "UPSTREAM_HOST") {
-    field_extractor_ = [](const RequestInfo& request_info) {
-      if (request_info.upstreamHost()) {
-        return request_info.upstreamHost()->address()->asString();
-      } else {
-        return std::string("-");
-      }
-    };
-  } else if (field_name == "UPSTREAM_CLUSTER") {
-    field_extractor_ = [](const RequestInfo& request_info) {
-      std::string upstream_cluster_name;
-      if (nullptr != request_info.upstreamHost()) {
-        upstream_cluster_name = request_info.upstreamHost()->cluster().name();
-      }
-
-      return upstream_cluster_name.empty() ? "-" : upstream_cluster_name;
-    };
-  } else {
+  static const std::unordered_map<std::string, Field> fields = {
+      {"START_TIME", Field::StartTime},
+      {"BYTES_RECEIVED", Field::BytesReceived},
+      {"PROTOCOL", Field::Protocol},
+      {"RESPONSE_CODE", Field::ResponseCode},
+      {"BYTES_SENT", Field::BytesSent},
+      {"DURATION", Field::Duration},
+      {"RESPONSE_FLAGS", Field::ResponseFlags},
+      {"UPSTREAM_HOST", Field::UpstreamHost},
+      {"UPSTREAM_CLUSTER", Field::UpstreamCluster},
+  };
+
+  auto field = fields.find(field_name);
+  if (field == fields.end()) {
     throw EnvoyException(fmt::format("Not supported field in RequestInfo: {}", field_name));
   }
+
+  field_ = field->second;
 }
 
-std::string RequestInfoFormatter::format(const HeaderMap&, const HeaderMap&,
-                                         const RequestInfo& request_info) const {
-  return field_extractor_(request_info);
+void RequestInfoFormatter::appendInteger(uint64_t value, std::string& output) {
+  char buffer[32];
+  const uint32_t length = StringUtil::itoa(buffer, sizeof(buffer), value);
+  output.append(buffer, length);
+}
+
+void RequestInfoFormatter::formatTo(std::string& output, const HeaderMap&, const HeaderMap&,
+                                    const RequestInfo& request_info) const {
+  switch (field_) {
+  case Field::StartTime:
+    AccessLogDateTimeFormatter::appendTime(request_info.startTime(), output);
+    return;
+  case Field::BytesReceived:
+    appendInteger(request_info.bytesReceived(), output);
+    return;
+  case Field::Protocol:
+    output += AccessLogFormatUtils::protocolToString(request_info.protocol());
+    return;
+  case Field::ResponseCode:
+    appendInteger(request_info.responseCode().valid() ? request_info.responseCode().value() : 0,
+                  output);
+    return;
+  case Field::BytesSent:
+    appendInteger(request_info.bytesSent(), output);
+    return;
+  case Field::Duration:
+    appendInteger(request_info.duration().count(), output);
+    return;
+  case Field::ResponseFlags:
+    ResponseFlagUtils::appendShortString(request_info, output);
+    return;
+  case Field::UpstreamHost:
+    if (request_info.upstreamHost()) {
+      output += request_info.upstreamHost()->address()->asString();
+    } else {
+      output += '-';
+    }
+    return;
+  case Field::UpstreamCluster:
+    if (request_info.upstreamHost() && !request_info.upstreamHost()->cluster().name().empty()) {
+      output += request_info.upstreamHost()->cluster().name();
+    } else {
+      output += '-';
+    }
+    return;
+  }
+
+  NOT_REACHED;
 }
 
 PlainStringFormatter::PlainStringFormatter(const std::string& str) : str_(str) {}
 
-std::string PlainStringFormatter::format(const Http::HeaderMap&, const Http::HeaderMap&,
-                                         const RequestInfo&) const {
-  return str_;
+void PlainStringFormatter::formatTo(std::string& output, const Http::HeaderMap&,
+                                    const Http::HeaderMap&, const RequestInfo&) const {
+  output += str_;
 }
 
 HeaderFormatter::HeaderFormatter(const std::string& main_header,
@@ -295,25 +290,24 @@ HeaderFormatter::HeaderFormatter(const std::string& main_header,
                                  const Optional<size_t>& max_length)
     : main_header_(main_header), alternative_header_(alternative_header), max_length_(max_length) {}
 
-std::string HeaderFormatter::format(const HeaderMap& headers) const {
+void HeaderFormatter::formatTo(std::string& output, const HeaderMap& headers) const {
   const HeaderEntry* header = headers.get(main_header_);
 
   if (!header && !alternative_header_.get().empty()) {
     header = headers.get(alternative_header_);
   }
 
-  std::string header_value_string;
   if (!header) {
-    header_value_string = "-";
-  } else {
-    header_value_string = header->value().c_str();
+    output.append("-", max_length_.valid() ? std::min<size_t>(1, max_length_.value()) : 1);
+    return;
   }
 
-  if (max_length_.valid() && header_value_string.length() > max_length_.value()) {
-    return header_value_string.substr(0, max_length_.value());
+  size_t length = header->value().size();
+  if (max_length_.valid() && length > max_length_.value()) {
+    length = max_length_.value();
   }
 
-  return header_value_string;
+  output.append(header->value().c_str(), length);
 }
 
 ResponseHeaderFormatter::ResponseHeaderFormatter(const std::string& main_header,
@@ -321,10 +315,10 @@ ResponseHeaderFormatter::ResponseHeaderFormatter(const std::string& main_header,
                                                  const Optional<size_t>& max_length)
     : HeaderFormatter(main_header, alternative_header, max_length) {}
 
-std::string ResponseHeaderFormatter::format(const Http::HeaderMap&,
-                                            const Http::HeaderMap& response_headers,
-                                            const RequestInfo&) const {
-  return HeaderFormatter::format(response_headers);
+void ResponseHeaderFormatter::formatTo(std::string& output, const Http::HeaderMap&,
+                                       const Http::HeaderMap& response_headers,
+                                       const RequestInfo&) const {
+  HeaderFormatter::formatTo(output, response_headers);
 }
 
 RequestHeaderFormatter::RequestHeaderFormatter(const std::string& main_header,
@@ -332,9 +326,9 @@ RequestHeaderFormatter::RequestHeaderFormatter(const std::string& main_header,
                                                const Optional<size_t>& max_length)
     : HeaderFormatter(main_header, alternative_header, max_length) {}
 
-std::string RequestHeaderFormatter::format(const Http::HeaderMap& request_headers,
-                                           const Http::HeaderMap&, const RequestInfo&) const {
-  return HeaderFormatter::format(request_headers);
+void RequestHeaderFormatter::formatTo(std::string& output, const Http::HeaderMap& request_headers,
+                                      const Http::HeaderMap&, const RequestInfo&) const {
+  HeaderFormatter::formatTo(output, request_headers);
 }
 
 } // AccessLog
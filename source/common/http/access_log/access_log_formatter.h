@@ -1,6 +1,6 @@
 #pragma once
 
-#include <functional>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -17,9 +17,13 @@ class ResponseFlagUtils {
 public:
   static const std::string toShortString(const RequestInfo& request_info);
 
+  /**
+   * Append the short string form of the response flags to output.
+   */
+  static void appendShortString(const RequestInfo& request_info, std::string& output);
+
 private:
   ResponseFlagUtils();
-  static void appendString(std::string& result, const std::string& append);
 
   const static std::string NONE;
   const static std::string FAILED_LOCAL_HEALTH_CHECK;
@@ -63,15 +67,26 @@ private:
 };
 
 /**
- * Composite formatter implementation.
+ * Base class for formatters that implements format() on top of formatTo().
  */
-class FormatterImpl : public Formatter {
+class FormatterBase : public Formatter {
 public:
-  FormatterImpl(const std::string& format);
-
   // Formatter::format
   std::string format(const HeaderMap& request_headers, const HeaderMap& response_headers,
                      const RequestInfo& request_info) const override;
+};
+
+/**
+ * Composite formatter implementation. The format string is parsed once into a flat list of
+ * formatters, each of which appends its output directly to the output string.
+ */
+class FormatterImpl : public FormatterBase {
+public:
+  FormatterImpl(const std::string& format);
+
+  // Formatter::formatTo
+  void formatTo(std::string& output, const HeaderMap& request_headers,
+                const HeaderMap& response_headers, const RequestInfo& request_info) const override;
 
 private:
   std::vector<FormatterPtr> formatters_;
@@ -81,12 +96,13 @@ private:
  * Formatter for string literal. It ignores headers and request info and returns string by which it
  * was initialized.
  */
-class PlainStringFormatter : public Formatter {
+class PlainStringFormatter : public FormatterBase {
 public:
   PlainStringFormatter(const std::string& str);
 
-  // Formatter::format
-  std::string format(const HeaderMap&, const HeaderMap&, const RequestInfo&) const override;
+  // Formatter::formatTo
+  void formatTo(std::string& output, const HeaderMap&, const HeaderMap&,
+                const RequestInfo&) const override;
 
 private:
   std::string str_;
@@ -97,7 +113,7 @@ public:
   HeaderFormatter(const std::string& main_header, const std::string& alternative_header,
                   const Optional<size_t>& max_length);
 
-  std::string format(const HeaderMap& headers) const;
+  void formatTo(std::string& output, const HeaderMap& headers) const;
 
 private:
   LowerCaseString main_header_;
@@ -108,42 +124,56 @@ private:
 /**
  * Formatter based on request header.
  */
-class RequestHeaderFormatter : public Formatter, HeaderFormatter {
+class RequestHeaderFormatter : public FormatterBase, HeaderFormatter {
 public:
   RequestHeaderFormatter(const std::string& main_header, const std::string& alternative_header,
                          const Optional<size_t>& max_length);
 
-  // Formatter::format
-  std::string format(const HeaderMap& request_headers, const HeaderMap&,
-                     const RequestInfo&) const override;
+  // Formatter::formatTo
+  void formatTo(std::string& output, const HeaderMap& request_headers, const HeaderMap&,
+                const RequestInfo&) const override;
 };
 
 /**
  * Formatter based on the response header.
  */
-class ResponseHeaderFormatter : public Formatter, HeaderFormatter {
+class ResponseHeaderFormatter : public FormatterBase, HeaderFormatter {
 public:
   ResponseHeaderFormatter(const std::string& main_header, const std::string& alternative_header,
                           const Optional<size_t>& max_length);
 
-  // Formatter::format
-  std::string format(const HeaderMap&, const HeaderMap& response_headers,
-                     const RequestInfo&) const override;
+  // Formatter::formatTo
+  void formatTo(std::string& output, const HeaderMap&, const HeaderMap& response_headers,
+                const RequestInfo&) const override;
 };
 
 /**
  * Formatter based on the RequestInfo field.
  */
-class RequestInfoFormatter : public Formatter {
+class RequestInfoFormatter : public FormatterBase {
 public:
   RequestInfoFormatter(const std::string& field_name);
 
-  // Formatter::format
-  std::string format(const HeaderMap&, const HeaderMap&,
-                     const RequestInfo& request_info) const override;
+  // Formatter::formatTo
+  void formatTo(std::string& output, const HeaderMap&, const HeaderMap&,
+                const RequestInfo& request_info) const override;
 
 private:
-  std::function<std::string(const RequestInfo&)> field_extractor_;
+  enum class Field {
+    StartTime,
+    BytesReceived,
+    Protocol,
+    ResponseCode,
+    BytesSent,
+    Duration,
+    ResponseFlags,
+    UpstreamHost,
+    UpstreamCluster
+  };
+
+  static void appendInteger(uint64_t value, std::string& output);
+
+  Field field_;
 };
 
 } // AccessLog
@@ -1,8 +1,11 @@
 #include "common/http/access_log/access_log_impl.h"
 
+#include <atomic>
 #include <cstdint>
 #include <string>
+#include <vector>
 
+#include "envoy/common/exception.h"
 #include "envoy/filesystem/filesystem.h"
 #include "envoy/http/header_map.h"
 #include "envoy/runtime/runtime.h"
@@ -18,136 +21,197 @@
 #include "common/runtime/uuid_util.h"
 #include "common/tracing/http_tracer_impl.h"
 
+#include "spdlog/spdlog.h"
+
 namespace Envoy {
 namespace Http {
 namespace AccessLog {
 
-FilterImpl::FilterImpl(Json::Object& json, Runtime::Loader& runtime)
-    : value_(json.getInteger("value")), runtime_(runtime) {
-  std::string op = json.getString("op");
-  if (op == ">=") {
-    op_ = FilterOperation::GreaterEqual;
-  } else {
-    ASSERT(op == "=");
-    op_ = FilterOperation::Equal;
-  }
+namespace {
 
-  if (json.hasObject("runtime_key")) {
-    runtime_key_.value(json.getString("runtime_key"));
-  }
+std::atomic<uint64_t> next_cache_index{0};
+
+} // namespace
+
+FilterImpl::FilterImpl(const Json::Object& json, Runtime::Loader& runtime)
+    : runtime_(runtime), cache_index_(next_cache_index++) {
+  program_.reserve(predicateCount(json));
+  compile(json, ACCEPT, REJECT);
 }
 
-bool FilterImpl::compareAgainstValue(uint64_t lhs) {
-  uint64_t value = value_;
+FilterPtr FilterImpl::fromJson(const Json::Object& json, Runtime::Loader& runtime) {
+  return FilterPtr{new FilterImpl(json, runtime)};
+}
 
-  if (runtime_key_.valid()) {
-    value = runtime_.snapshot().getInteger(runtime_key_.value(), value);
+uint32_t FilterImpl::predicateCount(const Json::Object& json) {
+  const std::string type = json.getString("type");
+  if (type != "logical_or" && type != "logical_and") {
+    return 1;
   }
 
-  switch (op_) {
-  case FilterOperation::GreaterEqual:
-    return lhs >= value;
-  case FilterOperation::Equal:
-    return lhs == value;
+  uint32_t count = 0;
+  for (const Json::ObjectSharedPtr& filter : json.getObjectArray("filters")) {
+    count += predicateCount(*filter);
   }
 
-  NOT_REACHED;
+  return count;
 }
 
-FilterPtr FilterImpl::fromJson(Json::Object& json, Runtime::Loader& runtime) {
-  std::string type = json.getString("type");
-  if (type == "status_code") {
-    return FilterPtr{new StatusCodeFilter(json, runtime)};
-  } else if (type == "duration") {
-    return FilterPtr{new DurationFilter(json, runtime)};
+void FilterImpl::compile(const Json::Object& json, uint32_t on_match, uint32_t on_miss) {
+  const std::string type = json.getString("type");
+  if (type == "logical_or" || type == "logical_and") {
+    const std::vector<Json::ObjectSharedPtr> filters = json.getObjectArray("filters");
+    if (filters.empty()) {
+      throw EnvoyException(fmt::format("access log filter '{}' requires filters", type));
+    }
+
+    // Predicates are laid out in tree order, so each operand is followed directly by the next one.
+    // An operand that does not decide the operator continues with its sibling.
+    const bool is_or = type == "logical_or";
+    for (size_t i = 0; i < filters.size(); i++) {
+      if (i == filters.size() - 1) {
+        compile(*filters[i], on_match, on_miss);
+        break;
+      }
+
+      const uint32_t next = program_.size() + predicateCount(*filters[i]);
+      if (is_or) {
+        compile(*filters[i], on_match, next);
+      } else {
+        compile(*filters[i], next, on_miss);
+      }
+    }
+    return;
+  }
+
+  Instruction instruction{Predicate::NotHealthCheck, FilterOperation::Equal, 0, NO_RUNTIME_VALUE,
+                          on_match, on_miss};
+  if (type == "status_code" || type == "duration") {
+    instruction.predicate_ = type == "status_code" ? Predicate::StatusCode : Predicate::Duration;
+    instruction.value_ = json.getInteger("value");
+    const std::string op = json.getString("op");
+    if (op == ">=") {
+      instruction.op_ = FilterOperation::GreaterEqual;
+    } else {
+      ASSERT(op == "=");
+      instruction.op_ = FilterOperation::Equal;
+    }
+
+    if (json.hasObject("runtime_key")) {
+      instruction.runtime_value_ =
+          addRuntimeValue(json.getString("runtime_key"), instruction.value_);
+    }
   } else if (type == "runtime") {
-    return FilterPtr{new RuntimeFilter(json, runtime)};
-  } else if (type == "logical_or") {
-    return FilterPtr{new OrFilter(json, runtime)};
-  } else if (type == "logical_and") {
-    return FilterPtr{new AndFilter(json, runtime)};
+    instruction.predicate_ = Predicate::Runtime;
+    instruction.runtime_value_ = addRuntimeValue(json.getString("key"), 0);
   } else if (type == "not_healthcheck") {
-    return FilterPtr{new NotHealthCheckFilter()};
+    instruction.predicate_ = Predicate::NotHealthCheck;
   } else {
     ASSERT(type == "traceable_request");
-    return FilterPtr{new TraceableRequestFilter()};
+    instruction.predicate_ = Predicate::TraceableRequest;
   }
-}
 
-bool TraceableRequestFilter::evaluate(const RequestInfo& info, const HeaderMap& request_headers) {
-  Tracing::Decision decision = Tracing::HttpTracerUtility::isTracing(info, request_headers);
-
-  return decision.is_tracing && decision.reason == Tracing::Reason::ServiceForced;
+  program_.push_back(instruction);
 }
 
-bool StatusCodeFilter::evaluate(const RequestInfo& info, const HeaderMap&) {
-  if (!info.responseCode().valid()) {
-    return compareAgainstValue(0ULL);
+uint32_t FilterImpl::addRuntimeValue(const std::string& key, uint64_t default_value) {
+  for (uint32_t i = 0; i < runtime_values_.size(); i++) {
+    if (runtime_values_[i].key_ == key && runtime_values_[i].default_value_ == default_value) {
+      return i;
+    }
   }
 
-  return compareAgainstValue(info.responseCode().value());
+  runtime_values_.push_back({key, default_value});
+  return runtime_values_.size() - 1;
 }
 
-bool DurationFilter::evaluate(const RequestInfo& info, const HeaderMap&) {
-  return compareAgainstValue(info.duration().count());
-}
-
-RuntimeFilter::RuntimeFilter(Json::Object& json, Runtime::Loader& runtime)
-    : runtime_(runtime), runtime_key_(json.getString("key")) {}
-
-bool RuntimeFilter::evaluate(const RequestInfo&, const HeaderMap& request_header) {
-  const HeaderEntry* uuid = request_header.RequestId();
-  uint16_t sampled_value;
-  if (uuid && UuidUtils::uuidModBy(uuid->value().c_str(), sampled_value, 100)) {
-    uint64_t runtime_value =
-        std::min<uint64_t>(runtime_.snapshot().getInteger(runtime_key_, 0), 100);
+bool FilterImpl::evaluate(const RequestInfo& info, const HeaderMap& request_headers) {
+  // Filters are few and only created at config time, so each thread keeps the caches of all of
+  // them in a vector indexed by filter rather than looking them up.
+  static thread_local std::vector<RuntimeCache> runtime_caches;
+  Runtime::Snapshot* snapshot = nullptr;
+  RuntimeCache* cache = nullptr;
+  if (!runtime_values_.empty()) {
+    snapshot = &runtime_.snapshot();
+    if (runtime_caches.size() <= cache_index_) {
+      runtime_caches.resize(cache_index_ + 1);
+    }
 
-    return sampled_value < static_cast<uint16_t>(runtime_value);
-  } else {
-    return runtime_.snapshot().featureEnabled(runtime_key_, 0);
+    cache = &runtime_caches[cache_index_];
+    const uint64_t generation = snapshot->generation();
+    if (cache->generation_ != generation || generation == 0) {
+      cache->generation_ = generation;
+      cache->values_.resize(runtime_values_.size());
+      cache->valid_.assign(runtime_values_.size(), false);
+    }
   }
-}
 
-OperatorFilter::OperatorFilter(const Json::Object& json, Runtime::Loader& runtime) {
-  for (const Json::ObjectSharedPtr& filter : json.getObjectArray("filters")) {
-    filters_.emplace_back(FilterImpl::fromJson(*filter, runtime));
+  uint32_t pc = 0;
+  while (true) {
+    const Instruction& instruction = program_[pc];
+    pc = evaluatePredicate(instruction, info, request_headers, snapshot, cache)
+             ? instruction.on_match_
+             : instruction.on_miss_;
+    if (pc == ACCEPT) {
+      return true;
+    } else if (pc == REJECT) {
+      return false;
+    }
   }
 }
 
-OrFilter::OrFilter(const Json::Object& json, Runtime::Loader& runtime)
-    : OperatorFilter(json, runtime) {}
-
-AndFilter::AndFilter(const Json::Object& json, Runtime::Loader& runtime)
-    : OperatorFilter(json, runtime) {}
-
-bool OrFilter::evaluate(const RequestInfo& info, const HeaderMap& request_headers) {
-  bool result = false;
-  for (auto& filter : filters_) {
-    result |= filter->evaluate(info, request_headers);
-
-    if (result) {
-      break;
+bool FilterImpl::evaluatePredicate(const Instruction& instruction, const RequestInfo& info,
+                                   const HeaderMap& request_headers, Runtime::Snapshot* snapshot,
+                                   RuntimeCache* cache) const {
+  uint64_t lhs;
+  switch (instruction.predicate_) {
+  case Predicate::StatusCode:
+    lhs = info.responseCode().valid() ? info.responseCode().value() : 0;
+    break;
+  case Predicate::Duration:
+    lhs = info.duration().count();
+    break;
+  case Predicate::NotHealthCheck:
+    return !info.healthCheck();
+  case Predicate::TraceableRequest: {
+    Tracing::Decision decision = Tracing::HttpTracerUtility::isTracing(info, request_headers);
+    return decision.is_tracing && decision.reason == Tracing::Reason::ServiceForced;
+  }
+  case Predicate::Runtime: {
+    const HeaderEntry* uuid = request_headers.RequestId();
+    uint16_t sampled_value;
+    if (uuid && UuidUtils::uuidModBy(uuid->value().c_str(), sampled_value, 100)) {
+      const uint64_t runtime_value =
+          std::min<uint64_t>(runtimeValue(instruction.runtime_value_, *snapshot, *cache), 100);
+      return sampled_value < static_cast<uint16_t>(runtime_value);
+    } else {
+      return snapshot->featureEnabled(runtime_values_[instruction.runtime_value_].key_, 0);
     }
   }
+  }
 
-  return result;
-}
-
-bool AndFilter::evaluate(const RequestInfo& info, const HeaderMap& request_headers) {
-  bool result = true;
-  for (auto& filter : filters_) {
-    result &= filter->evaluate(info, request_headers);
-
-    if (!result) {
-      break;
-    }
+  const uint64_t value = instruction.runtime_value_ == NO_RUNTIME_VALUE
+                             ? instruction.value_
+                             : runtimeValue(instruction.runtime_value_, *snapshot, *cache);
+  switch (instruction.op_) {
+  case FilterOperation::GreaterEqual:
+    return lhs >= value;
+  case FilterOperation::Equal:
+    return lhs == value;
   }
 
-  return result;
+  NOT_REACHED;
 }
 
-bool NotHealthCheckFilter::evaluate(const RequestInfo& info, const HeaderMap&) {
-  return !info.healthCheck();
+uint64_t FilterImpl::runtimeValue(uint32_t index, Runtime::Snapshot& snapshot,
+                                  RuntimeCache& cache) const {
+  if (!cache.valid_[index]) {
+    const RuntimeValue& runtime_value = runtime_values_[index];
+    cache.values_[index] = snapshot.getInteger(runtime_value.key_, runtime_value.default_value_);
+    cache.valid_[index] = true;
+  }
+
+  return cache.values_[index];
 }
 
 InstanceImpl::InstanceImpl(const std::string& access_log_path, FilterPtr&& filter,
@@ -194,8 +258,10 @@ void InstanceImpl::log(const HeaderMap* request_headers, const HeaderMap* respon
     }
   }
 
-  std::string access_log_line =
-      formatter_->format(*request_headers, *response_headers, request_info);
+  // Each thread formats into its own line buffer, which keeps its capacity between requests.
+  static thread_local std::string access_log_line;
+  access_log_line.clear();
+  formatter_->formatTo(access_log_line, *request_headers, *response_headers, request_info);
   log_file_->write(access_log_line);
 }
 
@@ -0,0 +1,238 @@
+#include "common/http/access_log/grpc_access_log_impl.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "envoy/common/exception.h"
+
+#include "common/grpc/common.h"
+#include "common/http/header_map_impl.h"
+
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+namespace Http {
+namespace AccessLog {
+
+GrpcAccessLogStreamer::GrpcAccessLogStreamer(const GrpcAccessLogConfig& config,
+                                             Upstream::ClusterManager& cm,
+                                             Event::Dispatcher& dispatcher,
+                                             GrpcAccessLogStats& stats)
+    : config_(config), cm_(cm), stats_(stats) {
+  flush_timer_ = dispatcher.createTimer([this]() -> void {
+    flush();
+    flush_timer_->enableTimer(config_.flush_interval_);
+  });
+  flush_timer_->enableTimer(config_.flush_interval_);
+}
+
+void GrpcAccessLogStreamer::entryAdded() {
+  batch_bytes_ += batch_.http_logs(batch_.http_logs_size() - 1).ByteSize();
+  if (batch_bytes_ >= config_.max_batch_bytes_) {
+    flush();
+  }
+}
+
+void GrpcAccessLogStreamer::flush() {
+  const uint32_t entries = batch_.http_logs_size();
+  if (entries == 0) {
+    return;
+  }
+
+  if (remote_closed_) {
+    // The collector ended the stream. Finish our side and start over on a new one.
+    resetStream();
+  }
+
+  if (stream_ || openStream()) {
+    request_body_.drain(request_body_.length());
+    Grpc::Common::serializeBody(batch_, request_body_);
+    stream_->sendData(request_body_, false);
+  }
+
+  // The stream is gone if it could not be opened or was reset while sending. The batch is dropped
+  // rather than kept around for a retry so that memory stays bounded while the collector is down.
+  if (stream_) {
+    stats_.logs_written_.add(entries);
+  } else {
+    stats_.logs_dropped_.add(entries);
+  }
+
+  batch_.Clear();
+  batch_bytes_ = 0;
+}
+
+bool GrpcAccessLogStreamer::openStream() {
+  remote_closed_ = false;
+  stream_ = cm_.httpAsyncClientForCluster(config_.cluster_name_)
+                .start(*this, Optional<std::chrono::milliseconds>());
+  if (!stream_) {
+    // onReset() has already been called.
+    return false;
+  }
+
+  const google::protobuf::MethodDescriptor* method =
+      envoy::accesslog::AccessLogService::descriptor()->FindMethodByName("StreamAccessLogs");
+  request_headers_.reset(new HeaderMapImpl());
+  Grpc::Common::prepareHeaders(*request_headers_, config_.cluster_name_,
+                               method->service()->full_name(), method->name());
+  stream_->sendHeaders(*request_headers_, false);
+  if (remote_closed_) {
+    // The router answered while the headers were sent, e.g. because there was no healthy upstream.
+    resetStream();
+  }
+
+  if (!stream_) {
+    return false;
+  }
+
+  batch_.set_log_name(config_.log_name_);
+  return true;
+}
+
+void GrpcAccessLogStreamer::resetStream() {
+  if (stream_) {
+    AsyncClient::Stream* stream = stream_;
+    stream_ = nullptr;
+    // The reset calls onReset() inline, which is ignored now that the stream is cleared.
+    stream->reset();
+  }
+}
+
+void GrpcAccessLogStreamer::onHeaders(HeaderMapPtr&&, bool end_stream) {
+  if (end_stream) {
+    onTrailers(nullptr);
+  }
+}
+
+void GrpcAccessLogStreamer::onData(Buffer::Instance&, bool end_stream) {
+  if (end_stream) {
+    onTrailers(nullptr);
+  }
+}
+
+void GrpcAccessLogStreamer::onTrailers(HeaderMapPtr&&) {
+  // The stream can't be reset from within its own callbacks, so it is finished on the next flush.
+  remote_closed_ = true;
+  stats_.stream_closed_.inc();
+}
+
+void GrpcAccessLogStreamer::onReset() {
+  if (stream_) {
+    stream_ = nullptr;
+    stats_.stream_closed_.inc();
+  }
+}
+
+void GrpcAccessLogStreamer::shutdown() {
+  flush_timer_->disableTimer();
+  resetStream();
+}
+
+GrpcAccessLog::GrpcAccessLog(const Json::Object& json, FilterPtr&& filter,
+                             Upstream::ClusterManager& cm, ThreadLocal::Instance& tls,
+                             Stats::Scope& scope)
+    : filter_(std::move(filter)),
+      config_({json.getString("grpc_cluster"), json.getString("log_name", ""),
+               std::chrono::milliseconds(json.getInteger("flush_interval_ms", 1000)),
+               static_cast<uint64_t>(json.getInteger("max_batch_bytes", 16384))}),
+      stats_{ALL_GRPC_ACCESS_LOG_STATS(POOL_COUNTER_PREFIX(scope, "access_log.grpc."))}, tls_(tls),
+      tls_slot_(tls.allocateSlot()) {
+  if (!cm.get(config_.cluster_name_)) {
+    throw EnvoyException(
+        fmt::format("unknown access log service cluster '{}'", config_.cluster_name_));
+  }
+
+  tls.set(tls_slot_, [this, &cm](Event::Dispatcher& dispatcher)
+                         -> ThreadLocal::ThreadLocalObjectSharedPtr {
+                           return std::make_shared<GrpcAccessLogStreamer>(config_, cm, dispatcher,
+                                                                          stats_);
+                         });
+}
+
+void GrpcAccessLog::populateEntry(const HeaderMap& request_headers, const RequestInfo& request_info,
+                                  envoy::accesslog::HttpAccessLogEntry& entry) {
+  entry.set_start_time_us(std::chrono::duration_cast<std::chrono::microseconds>(
+                              request_info.startTime().time_since_epoch())
+                              .count());
+  entry.set_duration_ms(request_info.duration().count());
+  switch (request_info.protocol()) {
+  case Protocol::Http10:
+    entry.set_protocol(envoy::accesslog::HttpAccessLogEntry::HTTP10);
+    break;
+  case Protocol::Http11:
+    entry.set_protocol(envoy::accesslog::HttpAccessLogEntry::HTTP11);
+    break;
+  case Protocol::Http2:
+    entry.set_protocol(envoy::accesslog::HttpAccessLogEntry::HTTP2);
+    break;
+  }
+
+  if (request_info.responseCode().valid()) {
+    entry.set_response_code(request_info.responseCode().value());
+  }
+
+  uint32_t response_flags = 0;
+  for (uint32_t flag = ResponseFlag::FailedLocalHealthCheck; flag <= ResponseFlag::RateLimited;
+       flag <<= 1) {
+    if (request_info.getResponseFlag(static_cast<ResponseFlag>(flag))) {
+      response_flags |= flag;
+    }
+  }
+  entry.set_response_flags(response_flags);
+  entry.set_bytes_received(request_info.bytesReceived());
+  entry.set_bytes_sent(request_info.bytesSent());
+  entry.set_health_check(request_info.healthCheck());
+
+  if (request_headers.Method()) {
+    entry.set_method(request_headers.Method()->value().c_str(),
+                     request_headers.Method()->value().size());
+  }
+  const HeaderEntry* path = request_headers.EnvoyOriginalPath() ? request_headers.EnvoyOriginalPath()
+                                                                : request_headers.Path();
+  if (path) {
+    entry.set_path(path->value().c_str(), path->value().size());
+  }
+  if (request_headers.Host()) {
+    entry.set_authority(request_headers.Host()->value().c_str(),
+                        request_headers.Host()->value().size());
+  }
+  if (request_headers.UserAgent()) {
+    entry.set_user_agent(request_headers.UserAgent()->value().c_str(),
+                         request_headers.UserAgent()->value().size());
+  }
+  if (request_headers.ForwardedFor()) {
+    entry.set_forwarded_for(request_headers.ForwardedFor()->value().c_str(),
+                            request_headers.ForwardedFor()->value().size());
+  }
+  if (request_headers.RequestId()) {
+    entry.set_request_id(request_headers.RequestId()->value().c_str(),
+                         request_headers.RequestId()->value().size());
+  }
+
+  if (request_info.upstreamHost()) {
+    entry.set_upstream_host(request_info.upstreamHost()->address()->asString());
+    entry.set_upstream_cluster(request_info.upstreamHost()->cluster().name());
+  }
+}
+
+void GrpcAccessLog::log(const HeaderMap* request_headers, const HeaderMap*,
+                        const RequestInfo& request_info) {
+  static HeaderMapImpl empty_headers;
+  if (!request_headers) {
+    request_headers = &empty_headers;
+  }
+
+  if (filter_ && !filter_->evaluate(request_info, *request_headers)) {
+    return;
+  }
+
+  GrpcAccessLogStreamer& streamer = tls_.getTyped<GrpcAccessLogStreamer>(tls_slot_);
+  populateEntry(*request_headers, request_info, streamer.addEntry());
+  streamer.entryAdded();
+}
+
+} // AccessLog
+} // Http
+} // Envoy
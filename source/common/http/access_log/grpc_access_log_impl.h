@@ -0,0 +1,134 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
+#include "envoy/http/access_log.h"
+#include "envoy/http/async_client.h"
+#include "envoy/stats/stats_macros.h"
+#include "envoy/thread_local/thread_local.h"
+#include "envoy/upstream/cluster_manager.h"
+
+#include "common/buffer/buffer_impl.h"
+#include "common/http/access_log/grpc_access_log.pb.h"
+#include "common/json/json_loader.h"
+
+namespace Envoy {
+namespace Http {
+namespace AccessLog {
+
+/**
+ * All gRPC access log stats. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_GRPC_ACCESS_LOG_STATS(COUNTER)                                                         \
+  COUNTER(logs_written)                                                                            \
+  COUNTER(logs_dropped)                                                                            \
+  COUNTER(stream_closed)
+// clang-format on
+
+/**
+ * Struct definition for all gRPC access log stats. @see stats_macros.h
+ */
+struct GrpcAccessLogStats {
+  ALL_GRPC_ACCESS_LOG_STATS(GENERATE_COUNTER_STRUCT)
+};
+
+/**
+ * Configuration shared by all of the per worker streamers of a gRPC access log.
+ */
+struct GrpcAccessLogConfig {
+  std::string cluster_name_;
+  std::string log_name_;
+  std::chrono::milliseconds flush_interval_;
+  uint64_t max_batch_bytes_;
+};
+
+/**
+ * Per worker state of a gRPC access log. Entries are batched and sent on a long lived stream to the
+ * collector cluster once the batch reaches max_batch_bytes_ or when the flush timer fires. Sending
+ * never blocks the worker: if no stream can be opened the batch is dropped, so at most one batch
+ * is buffered per worker.
+ */
+class GrpcAccessLogStreamer : public ThreadLocal::ThreadLocalObject,
+                              public AsyncClient::StreamCallbacks {
+public:
+  GrpcAccessLogStreamer(const GrpcAccessLogConfig& config, Upstream::ClusterManager& cm,
+                        Event::Dispatcher& dispatcher, GrpcAccessLogStats& stats);
+
+  /**
+   * @return envoy::accesslog::HttpAccessLogEntry& a new entry in the current batch. The caller
+   *         must fill it in and then call entryAdded().
+   */
+  envoy::accesslog::HttpAccessLogEntry& addEntry() { return *batch_.add_http_logs(); }
+
+  /**
+   * Account for the entry last returned by addEntry() and flush the batch if it is full.
+   */
+  void entryAdded();
+
+  /**
+   * Send the current batch, opening a stream first if needed.
+   */
+  void flush();
+
+  // Http::AsyncClient::StreamCallbacks
+  void onHeaders(HeaderMapPtr&& headers, bool end_stream) override;
+  void onData(Buffer::Instance& data, bool end_stream) override;
+  void onTrailers(HeaderMapPtr&& trailers) override;
+  void onReset() override;
+
+  // ThreadLocal::ThreadLocalObject
+  void shutdown() override;
+
+private:
+  bool openStream();
+  void resetStream();
+
+  const GrpcAccessLogConfig config_;
+  Upstream::ClusterManager& cm_;
+  GrpcAccessLogStats& stats_;
+  Event::TimerPtr flush_timer_;
+  envoy::accesslog::StreamAccessLogsMessage batch_;
+  uint64_t batch_bytes_{};
+  AsyncClient::Stream* stream_{};
+  // The router keeps a reference to the request headers for the life of the stream.
+  HeaderMapPtr request_headers_;
+  bool remote_closed_{};
+  Buffer::OwnedImpl request_body_;
+};
+
+/**
+ * Access log that streams structured entries to a collector over gRPC instead of writing
+ * formatted lines to a file.
+ */
+class GrpcAccessLog : public Instance {
+public:
+  GrpcAccessLog(const Json::Object& json, FilterPtr&& filter, Upstream::ClusterManager& cm,
+                ThreadLocal::Instance& tls, Stats::Scope& scope);
+
+  /**
+   * Fill in an access log entry from the request headers and request info.
+   */
+  static void populateEntry(const HeaderMap& request_headers, const RequestInfo& request_info,
+                            envoy::accesslog::HttpAccessLogEntry& entry);
+
+  // Http::AccessLog::Instance
+  void log(const HeaderMap* request_headers, const HeaderMap* response_headers,
+           const RequestInfo& request_info) override;
+
+private:
+  FilterPtr filter_;
+  const GrpcAccessLogConfig config_;
+  GrpcAccessLogStats stats_;
+  ThreadLocal::Instance& tls_;
+  const uint32_t tls_slot_;
+};
+
+} // AccessLog
+} // Http
+} // Envoy
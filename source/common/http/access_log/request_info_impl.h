@@ -3,6 +3,7 @@
 #include <chrono>
 #include <cstdint>
 
+#include "envoy/common/time.h"
 #include "envoy/http/access_log.h"
 
 namespace Envoy {
@@ -10,8 +11,14 @@ namespace Http {
 namespace AccessLog {
 
 struct RequestInfoImpl : public RequestInfo {
-  RequestInfoImpl(Protocol protocol)
-      : protocol_(protocol), start_time_(std::chrono::system_clock::now()) {}
+  /**
+   * @param protocol supplies the downstream protocol.
+   * @param time_source supplies the time source used to measure the request duration. It is
+   *        usually the dispatcher's loop time source, and must outlive the request info.
+   */
+  RequestInfoImpl(Protocol protocol, MonotonicTimeSource& time_source)
+      : protocol_(protocol), start_time_(std::chrono::system_clock::now()),
+        time_source_(time_source), start_monotonic_time_(time_source.currentTime()) {}
 
   // Http::AccessLog::RequestInfo
   SystemTime startTime() const override { return start_time_; }
@@ -26,8 +33,8 @@ struct RequestInfoImpl : public RequestInfo {
   uint64_t bytesSent() const override { return bytes_sent_; }
 
   std::chrono::milliseconds duration() const override {
-    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() -
-                                                                 start_time_);
+    return std::chrono::duration_cast<std::chrono::milliseconds>(time_source_.currentTime() -
+                                                                 start_monotonic_time_);
   }
 
   void setResponseFlag(Http::AccessLog::ResponseFlag response_flag) override {
@@ -48,6 +55,8 @@ struct RequestInfoImpl : public RequestInfo {
 
   Protocol protocol_;
   const SystemTime start_time_;
+  MonotonicTimeSource& time_source_;
+  const MonotonicTime start_monotonic_time_;
   uint64_t bytes_received_{};
   Optional<uint32_t> response_code_;
   uint64_t bytes_sent_{};
@@ -3,6 +3,7 @@
 #include <chrono>
 #include <map>
 #include <memory>
+#include <new>
 #include <string>
 #include <vector>
 
@@ -19,6 +20,7 @@ const AsyncStreamImpl::NullShadowPolicy AsyncStreamImpl::RouteEntryImpl::shadow_
 const AsyncStreamImpl::NullVirtualHost AsyncStreamImpl::RouteEntryImpl::virtual_host_;
 const AsyncStreamImpl::NullRateLimitPolicy AsyncStreamImpl::NullVirtualHost::rate_limit_policy_;
 const std::multimap<std::string, std::string> AsyncStreamImpl::RouteEntryImpl::opaque_config_;
+const Upstream::HostMetadata AsyncStreamImpl::RouteEntryImpl::metadata_match_criteria_;
 
 AsyncClientImpl::AsyncClientImpl(const Upstream::ClusterInfo& cluster, Stats::Store& stats_store,
                                  Event::Dispatcher& dispatcher,
@@ -27,19 +29,29 @@ AsyncClientImpl::AsyncClientImpl(const Upstream::ClusterInfo& cluster, Stats::St
                                  Runtime::RandomGenerator& random,
                                  Router::ShadowWriterPtr&& shadow_writer)
     : cluster_(cluster), config_("http.async-client.", local_info, stats_store, cm, runtime, random,
-                                 std::move(shadow_writer), true),
+                                 std::move(shadow_writer), true, nullptr),
       dispatcher_(dispatcher) {}
 
 AsyncClientImpl::~AsyncClientImpl() {
   while (!active_streams_.empty()) {
     active_streams_.front()->reset();
   }
+
+  for (void* block : free_streams_) {
+    ::operator delete(block);
+  }
+  for (void* block : free_requests_) {
+    ::operator delete(block);
+  }
 }
 
+const size_t AsyncClientImpl::MaxCachedStreams;
+
 AsyncClient::Request* AsyncClientImpl::send(MessagePtr&& request, AsyncClient::Callbacks& callbacks,
                                             const Optional<std::chrono::milliseconds>& timeout) {
   AsyncRequestImpl* async_request =
-      new AsyncRequestImpl(std::move(request), *this, callbacks, timeout);
+      new (allocate(free_requests_, sizeof(AsyncRequestImpl)))
+          AsyncRequestImpl(std::move(request), *this, callbacks, timeout);
   async_request->initialize();
   std::unique_ptr<AsyncStreamImpl> new_request{async_request};
 
@@ -48,22 +60,49 @@ AsyncClient::Request* AsyncClientImpl::send(MessagePtr&& request, AsyncClient::C
     new_request->moveIntoList(std::move(new_request), active_streams_);
     return async_request;
   } else {
-    new_request->cleanup();
+    recycle(std::move(new_request));
     return nullptr;
   }
 }
 
 AsyncClient::Stream* AsyncClientImpl::start(AsyncClient::StreamCallbacks& callbacks,
                                             const Optional<std::chrono::milliseconds>& timeout) {
-  std::unique_ptr<AsyncStreamImpl> new_stream{new AsyncStreamImpl(*this, callbacks, timeout)};
+  std::unique_ptr<AsyncStreamImpl> new_stream{
+      new (allocate(free_streams_, sizeof(AsyncStreamImpl)))
+          AsyncStreamImpl(*this, callbacks, timeout)};
   new_stream->moveIntoList(std::move(new_stream), active_streams_);
   return active_streams_.front().get();
 }
 
+void* AsyncClientImpl::allocate(std::vector<void*>& free_list, size_t size) {
+  if (free_list.empty()) {
+    return ::operator new(size);
+  }
+
+  void* block = free_list.back();
+  free_list.pop_back();
+  return block;
+}
+
+void AsyncClientImpl::recycle(std::unique_ptr<AsyncStreamImpl>&& stream) {
+  std::vector<void*>& free_list = stream->isRequest() ? free_requests_ : free_streams_;
+  if (free_list.size() == MaxCachedStreams) {
+    return;
+  }
+
+  // The stream may be a base class subobject, so find the start of its storage before destroying
+  // it.
+  AsyncStreamImpl* released = stream.release();
+  void* block = dynamic_cast<void*>(released);
+  released->~AsyncStreamImpl();
+  free_list.push_back(block);
+}
+
 AsyncStreamImpl::AsyncStreamImpl(AsyncClientImpl& parent, AsyncClient::StreamCallbacks& callbacks,
                                  const Optional<std::chrono::milliseconds>& timeout)
     : parent_(parent), stream_callbacks_(callbacks), stream_id_(parent.config_.random_.random()),
-      router_(parent.config_), request_info_(Protocol::Http11),
+      router_(parent.config_),
+      request_info_(Protocol::Http11, parent.dispatcher_.loopTimeSource()),
       route_(std::make_shared<RouteImpl>(parent_.cluster_.name(), timeout)) {
 
   router_.setDecoderFilterCallbacks(*this);
@@ -143,7 +182,7 @@ void AsyncStreamImpl::cleanup() {
   // This will destroy us, but only do so if we are actually in a list. This does not happen in
   // the immediate failure case.
   if (inserted()) {
-    removeFromList(parent_.active_streams_);
+    parent_.recycle(removeFromList(parent_.active_streams_));
   }
 }
 
@@ -48,11 +48,33 @@ public:
   Stream* start(StreamCallbacks& callbacks,
                 const Optional<std::chrono::milliseconds>& timeout) override;
 
+  // The maximum number of completed streams and requests whose storage is kept for reuse.
+  static const size_t MaxCachedStreams = 64;
+
 private:
+  /**
+   * Get storage for a new stream or request, reusing the storage of a completed one if possible.
+   * @param free_list supplies the recycled storage for the type being created.
+   * @param size supplies the size of the type being created.
+   */
+  static void* allocate(std::vector<void*>& free_list, size_t size);
+
+  /**
+   * Destroy a completed stream or request, keeping its storage for reuse.
+   * @param stream supplies the stream to destroy.
+   */
+  void recycle(std::unique_ptr<AsyncStreamImpl>&& stream);
+
   const Upstream::ClusterInfo& cluster_;
   Router::FilterConfig config_;
   Event::Dispatcher& dispatcher_;
   std::list<std::unique_ptr<AsyncStreamImpl>> active_streams_;
+  // Callers such as health checkers, tracers and discovery clients issue requests to the same
+  // cluster at high rates. Streams and requests are large, so their storage is recycled rather than
+  // freed. Storage comes from ::operator new so that a recycled object can still be deleted
+  // normally.
+  std::vector<void*> free_streams_;
+  std::vector<void*> free_requests_;
 
   friend class AsyncStreamImpl;
   friend class AsyncRequestImpl;
@@ -75,10 +97,16 @@ public:
   void sendData(Buffer::Instance& data, bool end_stream) override;
   void sendTrailers(HeaderMap& trailers) override;
   void reset() override;
+  bool isAboveWriteBufferHighWatermark() const override { return high_watermark_calls_ > 0; }
 
 protected:
   bool remoteClosed() { return remote_closed_; }
 
+  /**
+   * @return whether this is an AsyncRequestImpl. Used to recycle the storage of the right type.
+   */
+  virtual bool isRequest() const { return false; }
+
   AsyncClientImpl& parent_;
 
 private:
@@ -101,6 +129,7 @@ private:
     }
     uint32_t numRetries() const override { return 0; }
     uint32_t retryOn() const override { return 0; }
+    std::chrono::milliseconds hedgeDelay() const override { return std::chrono::milliseconds(0); }
   };
 
   struct NullShadowPolicy : public Router::ShadowPolicy {
@@ -124,6 +153,7 @@ private:
 
     // Router::RouteEntry
     const std::string& clusterName() const override { return cluster_name_; }
+    const Optional<Upstream::ClusterId>& clusterId() const override { return cluster_id_; }
     void finalizeRequestHeaders(Http::HeaderMap&) const override {}
     const Router::HashPolicy* hashPolicy() const override { return nullptr; }
     Upstream::ResourcePriority priority() const override {
@@ -148,14 +178,19 @@ private:
     const Router::VirtualHost& virtualHost() const override { return virtual_host_; }
     bool autoHostRewrite() const override { return false; }
     bool includeVirtualHostRateLimits() const override { return true; }
+    const Upstream::HostMetadata& metadataMatchCriteria() const override {
+      return metadata_match_criteria_;
+    }
 
     static const NullRateLimitPolicy rate_limit_policy_;
     static const NullRetryPolicy retry_policy_;
     static const NullShadowPolicy shadow_policy_;
     static const NullVirtualHost virtual_host_;
     static const std::multimap<std::string, std::string> opaque_config_;
+    static const Upstream::HostMetadata metadata_match_criteria_;
 
     const std::string& cluster_name_;
+    const Optional<Upstream::ClusterId> cluster_id_;
     Optional<std::chrono::milliseconds> timeout_;
   };
 
@@ -178,6 +213,7 @@ private:
   // Http::StreamDecoderFilterCallbacks
   uint64_t connectionId() override { return 0; }
   Ssl::Connection* ssl() override { return nullptr; }
+  const Network::Connection* connection() override { return nullptr; }
   Event::Dispatcher& dispatcher() override { return parent_.dispatcher_; }
   void resetStream() override;
   Router::RouteConstSharedPtr route() override { return route_; }
@@ -190,9 +226,20 @@ private:
   const Buffer::Instance* decodingBuffer() override {
     throw EnvoyException("buffering is not supported in streaming");
   }
+  void setDecodingBuffer(Buffer::InstancePtr&&) override { NOT_IMPLEMENTED; }
+  void clearRouteCache() override {}
   void encodeHeaders(HeaderMapPtr&& headers, bool end_stream) override;
   void encodeData(Buffer::Instance& data, bool end_stream) override;
   void encodeTrailers(HeaderMapPtr&& trailers) override;
+  // The caller consumes the response as it arrives and sends the request body itself. The upstream
+  // watermark is only tracked so that the caller can check it before sending more data.
+  void onDecoderFilterAboveWriteBufferHighWatermark() override { high_watermark_calls_++; }
+  void onDecoderFilterBelowWriteBufferLowWatermark() override {
+    ASSERT(high_watermark_calls_ > 0);
+    high_watermark_calls_--;
+  }
+  void addDownstreamWatermarkCallbacks(DownstreamWatermarkCallbacks&) override {}
+  void removeDownstreamWatermarkCallbacks(DownstreamWatermarkCallbacks&) override {}
 
   AsyncClient::StreamCallbacks& stream_callbacks_;
   const uint64_t stream_id_;
@@ -202,6 +249,7 @@ private:
   std::shared_ptr<RouteImpl> route_;
   bool local_closed_{};
   bool remote_closed_{};
+  uint32_t high_watermark_calls_{};
 
   friend class AsyncClientImpl;
 };
@@ -226,6 +274,9 @@ private:
   void onTrailers(HeaderMapPtr&& trailers) override;
   void onReset() override;
 
+  // Http::AsyncStreamImpl
+  bool isRequest() const override { return true; }
+
   // Http::StreamDecoderFilterCallbacks
   const Buffer::Instance* decodingBuffer() override { return request_->body().get(); }
 
@@ -81,6 +81,11 @@ public:
    */
   size_t numActiveRequests() { return active_requests_.size(); }
 
+  /**
+   * @return uint64_t the number of requests that the peer allows to be active at once.
+   */
+  uint64_t maxConcurrentStreams() { return codec_->maxConcurrentStreams(); }
+
   /**
    * Create a new stream. Note: The CodecClient will NOT buffer multiple requests for HTTP1
    * connections. Thus, calling newStream() before the previous request has been fully encoded
@@ -157,6 +162,8 @@ private:
 
     // StreamCallbacks
     void onResetStream(StreamResetReason reason) override { parent_.onReset(*this, reason); }
+    void onAboveWriteBufferHighWatermark() override {}
+    void onBelowWriteBufferLowWatermark() override {}
 
     // StreamDecoderWrapper
     void onPreDecodeComplete() override { parent_.responseDecodeComplete(*this); }
@@ -180,6 +187,13 @@ private:
 
   // Network::ConnectionCallbacks
   void onEvent(uint32_t events) override;
+  // Pass watermark events from the connection on to the codec, which raises them on the streams.
+  void onAboveWriteBufferHighWatermark() override {
+    codec_->onUnderlyingConnectionAboveWriteBufferHighWatermark();
+  }
+  void onBelowWriteBufferLowWatermark() override {
+    codec_->onUnderlyingConnectionBelowWriteBufferLowWatermark();
+  }
 
   std::list<ActiveRequestPtr> active_requests_;
   Http::ConnectionCallbacks* codec_callbacks_{};
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 
+#include "envoy/http/codec.h"
+
 namespace Envoy {
 namespace Http {
 
@@ -21,6 +24,40 @@ public:
     reset_callbacks_run_ = true;
   }
 
+  /**
+   * Raise onAboveWriteBufferHighWatermark() on the callbacks. A stream can go over its high
+   * watermark for more than one reason (e.g., its own send buffer and the connection's), so the
+   * callbacks only fire for the first reason, and runLowWatermarkCallbacks() only fires them once
+   * every reason has gone.
+   */
+  void runHighWatermarkCallbacks() {
+    if (high_watermark_callbacks_++ > 0) {
+      return;
+    }
+
+    for (StreamCallbacks* callbacks : callbacks_) {
+      if (callbacks) {
+        callbacks->onAboveWriteBufferHighWatermark();
+      }
+    }
+  }
+
+  /**
+   * Raise onBelowWriteBufferLowWatermark() on the callbacks. Ignored if the stream was not over its
+   * high watermark, which happens when the stream started while the connection was already over.
+   */
+  void runLowWatermarkCallbacks() {
+    if (high_watermark_callbacks_ == 0 || --high_watermark_callbacks_ > 0) {
+      return;
+    }
+
+    for (StreamCallbacks* callbacks : callbacks_) {
+      if (callbacks) {
+        callbacks->onBelowWriteBufferLowWatermark();
+      }
+    }
+  }
+
 protected:
   StreamCallbackHelper() {
     // Set space for 8 callbacks (64 bytes).
@@ -43,6 +80,7 @@ protected:
 
 private:
   std::vector<StreamCallbacks*> callbacks_;
+  uint32_t high_watermark_callbacks_{};
   bool reset_callbacks_run_{};
 };
 
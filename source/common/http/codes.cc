@@ -1,5 +1,7 @@
 #include "common/http/codes.h"
 
+#include <algorithm>
+#include <array>
 #include <cstdint>
 #include <string>
 
@@ -26,6 +28,27 @@ void CodeUtility::chargeBasicResponseStat(Stats::Scope& scope, const std::string
 
 void CodeUtility::chargeResponseStat(const ResponseStatInfo& info) {
   uint64_t response_code = Utility::getResponseStatus(info.response_headers_);
+
+  if (info.cluster_code_stats_) {
+    info.cluster_code_stats_->chargeResponseStat(info.cluster_scope_,
+                                                 static_cast<Code>(response_code),
+                                                 info.upstream_canary_, info.internal_request_);
+    if (info.vcluster_code_stats_ && !info.request_vcluster_name_.empty()) {
+      info.vcluster_code_stats_->chargeBasicResponseStat(info.global_store_,
+                                                         static_cast<Code>(response_code));
+    }
+
+    // Zone stats are named after the upstream host's zone so they are still looked up by name.
+    if (!info.from_zone_.empty() && !info.to_zone_.empty()) {
+      std::string group_string = groupStringForResponseCode(static_cast<Code>(response_code));
+      info.cluster_scope_.counter(fmt::format("{}zone.{}.{}.upstream_rq_{}", info.prefix_,
+                                              info.from_zone_, info.to_zone_, group_string)).inc();
+      info.cluster_scope_.counter(fmt::format("{}zone.{}.{}.upstream_rq_{}", info.prefix_,
+                                              info.from_zone_, info.to_zone_, response_code)).inc();
+    }
+    return;
+  }
+
   chargeBasicResponseStat(info.cluster_scope_, info.prefix_, static_cast<Code>(response_code));
 
   std::string group_string = groupStringForResponseCode(static_cast<Code>(response_code));
@@ -71,6 +94,17 @@ void CodeUtility::chargeResponseStat(const ResponseStatInfo& info) {
 }
 
 void CodeUtility::chargeResponseTiming(const ResponseTimingInfo& info) {
+  if (info.cluster_code_stats_) {
+    info.cluster_code_stats_->chargeResponseTiming(info.cluster_scope_, info.response_time_,
+                                                   info.upstream_canary_, info.internal_request_);
+    if (info.vcluster_code_stats_ && !info.request_vcluster_name_.empty()) {
+      info.vcluster_code_stats_->chargeBasicResponseTiming(info.global_store_,
+                                                           info.response_time_);
+    }
+    chargeZoneResponseTiming(info);
+    return;
+  }
+
   info.cluster_scope_.deliverTimingToSinks(info.prefix_ + "upstream_rq_time", info.response_time_);
   if (info.upstream_canary_) {
     info.cluster_scope_.deliverTimingToSinks(info.prefix_ + "canary.upstream_rq_time",
@@ -91,7 +125,10 @@ void CodeUtility::chargeResponseTiming(const ResponseTimingInfo& info) {
                                             info.response_time_);
   }
 
-  // Handle per zone stats.
+  chargeZoneResponseTiming(info);
+}
+
+void CodeUtility::chargeZoneResponseTiming(const ResponseTimingInfo& info) {
   if (!info.from_zone_.empty() && !info.to_zone_.empty()) {
     info.cluster_scope_.deliverTimingToSinks(
         fmt::format("{}zone.{}.{}.upstream_rq_time", info.prefix_, info.from_zone_, info.to_zone_),
@@ -113,6 +150,147 @@ std::string CodeUtility::groupStringForResponseCode(Code response_code) {
   }
 }
 
+namespace {
+
+// The well known codes in increasing order. Their position is their index in the per code handles.
+const std::array<Code, CodeStatsImpl::NumCodes> WellKnownCodes = {{
+    Code::Continue,
+    Code::OK,
+    Code::Created,
+    Code::Accepted,
+    Code::NonAuthoritativeInformation,
+    Code::NoContent,
+    Code::ResetContent,
+    Code::PartialContent,
+    Code::MultiStatus,
+    Code::AlreadyReported,
+    Code::IMUsed,
+    Code::MultipleChoices,
+    Code::MovedPermanently,
+    Code::Found,
+    Code::SeeOther,
+    Code::NotModified,
+    Code::UseProxy,
+    Code::TemporaryRedirect,
+    Code::PermanentRedirect,
+    Code::BadRequest,
+    Code::Unauthorized,
+    Code::PaymentRequired,
+    Code::Forbidden,
+    Code::NotFound,
+    Code::MethodNotAllowed,
+    Code::NotAcceptable,
+    Code::ProxyAuthenticationRequired,
+    Code::RequestTimeout,
+    Code::Conflict,
+    Code::Gone,
+    Code::LengthRequired,
+    Code::PreconditionFailed,
+    Code::PayloadTooLarge,
+    Code::URITooLong,
+    Code::UnsupportedMediaType,
+    Code::RangeNotSatisfiable,
+    Code::ExpectationFailed,
+    Code::MisdirectedRequest,
+    Code::UnprocessableEntity,
+    Code::Locked,
+    Code::FailedDependency,
+    Code::UpgradeRequired,
+    Code::PreconditionRequired,
+    Code::TooManyRequests,
+    Code::RequestHeaderFieldsTooLarge,
+    Code::InternalServerError,
+    Code::NotImplemented,
+    Code::BadGateway,
+    Code::ServiceUnavailable,
+    Code::GatewayTimeout,
+    Code::HTTPVersionNotSupported,
+    Code::VariantAlsoNegotiates,
+    Code::InsufficientStorage,
+    Code::LoopDetected,
+    Code::NotExtended,
+    Code::NetworkAuthenticationRequired,
+}};
+
+} // namespace
+
+const uint32_t CodeStatsImpl::NumCodes;
+
+CodeStatsImpl::CodeStatsImpl(const std::string& prefix)
+    : prefixes_({{prefix, prefix + "canary.", prefix + "internal.", prefix + "external."}}),
+      timing_names_({{prefixes_[Basic] + "upstream_rq_time", prefixes_[Canary] + "upstream_rq_time",
+                      prefixes_[Internal] + "upstream_rq_time",
+                      prefixes_[External] + "upstream_rq_time"}}) {}
+
+uint32_t CodeStatsImpl::codeIndex(uint64_t code) {
+  const auto it = std::lower_bound(WellKnownCodes.begin(), WellKnownCodes.end(), code,
+                                   [](Code lhs, uint64_t rhs) { return enumToInt(lhs) < rhs; });
+  if (it == WellKnownCodes.end() || enumToInt(*it) != code) {
+    return NumCodes;
+  }
+  return it - WellKnownCodes.begin();
+}
+
+template <class NameFunction>
+Stats::Counter& CodeStatsImpl::counter(Stats::Scope& scope, std::atomic<Stats::Counter*>& handle,
+                                       NameFunction name) {
+  Stats::Counter* counter = handle.load(std::memory_order_acquire);
+  if (!counter) {
+    counter = &scope.counter(name());
+    handle.store(counter, std::memory_order_release);
+  }
+  return *counter;
+}
+
+void CodeStatsImpl::charge(Stats::Scope& scope, Variant variant, uint64_t code) {
+  const std::string& prefix = prefixes_[variant];
+  if (code >= 200 && code < 600) {
+    counter(scope, class_handles_[variant][code / 100 - 2], [&prefix, code]() -> std::string {
+      return fmt::format("{}upstream_rq_{}", prefix,
+                         CodeUtility::groupStringForResponseCode(static_cast<Code>(code)));
+    }).inc();
+  } else {
+    scope.counter(prefix + "upstream_rq_").inc();
+  }
+
+  const uint32_t index = codeIndex(code);
+  if (index < NumCodes) {
+    counter(scope, code_handles_[variant][index], [&prefix, code]() -> std::string {
+      return fmt::format("{}upstream_rq_{}", prefix, code);
+    }).inc();
+  } else {
+    scope.counter(fmt::format("{}upstream_rq_{}", prefix, code)).inc();
+  }
+}
+
+void CodeStatsImpl::chargeBasicResponseStat(Stats::Scope& scope, Code code) {
+  charge(scope, Basic, enumToInt(code));
+}
+
+void CodeStatsImpl::chargeResponseStat(Stats::Scope& scope, Code code, bool canary,
+                                       bool internal_request) {
+  charge(scope, Basic, enumToInt(code));
+  if (canary) {
+    charge(scope, Canary, enumToInt(code));
+  }
+  charge(scope, internal_request ? Internal : External, enumToInt(code));
+}
+
+void CodeStatsImpl::chargeBasicResponseTiming(Stats::Scope& scope,
+                                              std::chrono::milliseconds response_time) {
+  scope.deliverTimingToSinks(timing_names_[Basic], response_time);
+}
+
+void CodeStatsImpl::chargeResponseTiming(Stats::Scope& scope,
+                                         std::chrono::milliseconds response_time, bool canary,
+                                         bool internal_request) {
+  scope.deliverTimingToSinks(timing_names_[Basic], response_time);
+  if (canary) {
+    scope.deliverTimingToSinks(timing_names_[Canary], response_time);
+  }
+  scope.deliverTimingToSinks(timing_names_[internal_request ? Internal : External], response_time);
+}
+
 const char* CodeUtility::toString(Code code) {
   // clang-format off
   switch (code) {
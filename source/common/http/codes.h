@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <string>
@@ -33,6 +35,10 @@ public:
     const std::string& from_zone_;
     const std::string& to_zone_;
     bool upstream_canary_;
+    // If set, used instead of building the cluster stat names from prefix_.
+    CodeStats* cluster_code_stats_;
+    // If set, used instead of building the virtual cluster stat names.
+    CodeStats* vcluster_code_stats_;
   };
 
   /**
@@ -53,6 +59,10 @@ public:
     const std::string& request_vcluster_name_;
     const std::string& from_zone_;
     const std::string& to_zone_;
+    // If set, used instead of building the cluster timing names from prefix_.
+    CodeStats* cluster_code_stats_;
+    // If set, used instead of building the virtual cluster timing name.
+    CodeStats* vcluster_code_stats_;
   };
 
   /**
@@ -60,6 +70,11 @@ public:
    */
   static void chargeResponseTiming(const ResponseTimingInfo& info);
 
+  /**
+   * Charge a response timing to the per zone stats, if the zones are known.
+   */
+  static void chargeZoneResponseTiming(const ResponseTimingInfo& info);
+
   /**
    * Convert an HTTP response code to a descriptive string.
    * @param code supplies the code to convert.
@@ -76,5 +91,48 @@ public:
   static std::string groupStringForResponseCode(Code response_code);
 };
 
+/**
+ * CodeStats that looks up the counters of the code classes and of the well known codes on first
+ * use and then keeps them. Other codes are looked up by name every time.
+ */
+class CodeStatsImpl : public CodeStats {
+public:
+  CodeStatsImpl(const std::string& prefix);
+
+  // Http::CodeStats
+  void chargeBasicResponseStat(Stats::Scope& scope, Code code) override;
+  void chargeResponseStat(Stats::Scope& scope, Code code, bool canary,
+                          bool internal_request) override;
+  void chargeBasicResponseTiming(Stats::Scope& scope,
+                                 std::chrono::milliseconds response_time) override;
+  void chargeResponseTiming(Stats::Scope& scope, std::chrono::milliseconds response_time,
+                            bool canary, bool internal_request) override;
+
+  /**
+   * @return the index of a well known code in the per code handles, or NumCodes if the code is
+   *         not well known.
+   */
+  static uint32_t codeIndex(uint64_t code);
+
+  static const uint32_t NumCodes = 56;
+
+private:
+  enum Variant { Basic, Canary, Internal, External, NumVariants };
+  // 2xx, 3xx, 4xx and 5xx.
+  static const uint32_t NumClasses = 4;
+
+  void charge(Stats::Scope& scope, Variant variant, uint64_t code);
+  template <class NameFunction>
+  static Stats::Counter& counter(Stats::Scope& scope, std::atomic<Stats::Counter*>& handle,
+                                 NameFunction name);
+
+  const std::array<std::string, NumVariants> prefixes_;
+  const std::array<std::string, NumVariants> timing_names_;
+  // Handles are filled in on first use. Racing workers look up the same counter, so whichever
+  // store wins is fine.
+  std::array<std::array<std::atomic<Stats::Counter*>, NumClasses>, NumVariants> class_handles_{};
+  std::array<std::array<std::atomic<Stats::Counter*>, NumCodes>, NumVariants> code_handles_{};
+};
+
 } // Http
 } // Envoy
@@ -1,6 +1,8 @@
 #include "common/http/conn_manager_impl.h"
 
+#include <chrono>
 #include <cstdint>
+#include <ctime>
 #include <functional>
 #include <list>
 #include <string>
@@ -17,6 +19,7 @@
 #include "common/buffer/buffer_impl.h"
 #include "common/common/assert.h"
 #include "common/common/enum_to_int.h"
+#include "common/common/free_list.h"
 #include "common/common/utility.h"
 #include "common/http/codes.h"
 #include "common/http/conn_manager_utility.h"
@@ -27,19 +30,61 @@
 #include "common/http/http2/codec_impl.h"
 #include "common/http/utility.h"
 #include "common/network/utility.h"
+#include "common/runtime/key_registry.h"
 
 #include "spdlog/spdlog.h"
 
 namespace Envoy {
 namespace Http {
 
+namespace {
+
+const Runtime::Key RuntimeFilterTimingSampling =
+    Runtime::KeyRegistry::registerKey("http_connection_manager.filter_timing_sampling");
+
+const std::string UnnamedFilter = "unnamed";
+
+template <class T> FreeList& streamFreeList() {
+  static thread_local FreeList free_list(ConnectionManagerImpl::MaxCachedStreams);
+  return free_list;
+}
+
+} // namespace
+
+const size_t ConnectionManagerImpl::MaxCachedStreams;
+
+void* ConnectionManagerImpl::ActiveStream::operator new(size_t size) {
+  return streamFreeList<ActiveStream>().allocate(size);
+}
+
+void ConnectionManagerImpl::ActiveStream::operator delete(void* block, size_t size) {
+  streamFreeList<ActiveStream>().deallocate(block, size);
+}
+
+void* ConnectionManagerImpl::ActiveStreamDecoderFilter::operator new(size_t size) {
+  return streamFreeList<ActiveStreamDecoderFilter>().allocate(size);
+}
+
+void ConnectionManagerImpl::ActiveStreamDecoderFilter::operator delete(void* block, size_t size) {
+  streamFreeList<ActiveStreamDecoderFilter>().deallocate(block, size);
+}
+
+void* ConnectionManagerImpl::ActiveStreamEncoderFilter::operator new(size_t size) {
+  return streamFreeList<ActiveStreamEncoderFilter>().allocate(size);
+}
+
+void ConnectionManagerImpl::ActiveStreamEncoderFilter::operator delete(void* block, size_t size) {
+  streamFreeList<ActiveStreamEncoderFilter>().deallocate(block, size);
+}
+
 ConnectionManagerStats ConnectionManagerImpl::generateStats(const std::string& prefix,
                                                             Stats::Store& stats) {
   return {
       {ALL_HTTP_CONN_MAN_STATS(POOL_COUNTER_PREFIX(stats, prefix), POOL_GAUGE_PREFIX(stats, prefix),
                                POOL_TIMER_PREFIX(stats, prefix))},
       prefix,
-      stats};
+      stats,
+      UserAgentContextPtr{new UserAgentContext(prefix, stats)}};
 }
 
 ConnectionManagerTracingStats ConnectionManagerImpl::generateTracingStats(const std::string& prefix,
@@ -52,13 +97,13 @@ ConnectionManagerImpl::ConnectionManagerImpl(ConnectionManagerConfig& config,
                                              Runtime::RandomGenerator& random_generator,
                                              Tracing::HttpTracer& tracer, Runtime::Loader& runtime,
                                              const LocalInfo::LocalInfo& local_info)
-    : config_(config), stats_(config_.stats()),
-      conn_length_(stats_.named_.downstream_cx_length_ms_.allocateSpan()),
-      drain_close_(drain_close), random_generator_(random_generator), tracer_(tracer),
-      runtime_(runtime), local_info_(local_info) {}
+    : config_(config), stats_(config_.stats()), drain_close_(drain_close),
+      random_generator_(random_generator), tracer_(tracer), runtime_(runtime),
+      local_info_(local_info) {}
 
 void ConnectionManagerImpl::initializeReadFilterCallbacks(Network::ReadFilterCallbacks& callbacks) {
   read_callbacks_ = &callbacks;
+  conn_length_ = stats_.named_.downstream_cx_length_ms_.allocateSpan(loopTimeSource());
   stats_.named_.downstream_cx_total_.inc();
   stats_.named_.downstream_cx_active_.inc();
   if (read_callbacks_->connection().ssl()) {
@@ -69,7 +114,7 @@ void ConnectionManagerImpl::initializeReadFilterCallbacks(Network::ReadFilterCal
   read_callbacks_->connection().addConnectionCallbacks(*this);
 
   if (config_.idleTimeout().valid()) {
-    idle_timer_ = read_callbacks_->connection().dispatcher().createTimer(
+    idle_timer_ = read_callbacks_->connection().dispatcher().createCoarseTimer(
         [this]() -> void { onIdleTimeout(); });
     idle_timer_->enableTimer(config_.idleTimeout().value());
   }
@@ -131,10 +176,12 @@ void ConnectionManagerImpl::doEndStream(ActiveStream& stream) {
 
   checkForDeferredClose();
 
-  // Reading may have been disabled for the non-multiplexing case, so enable it again.
-  if (drain_state_ != DrainState::Closing && codec_->protocol() != Protocol::Http2 &&
-      !read_callbacks_->connection().readEnabled()) {
-    read_callbacks_->connection().readDisable(false);
+  // Reading may have been disabled for the non-multiplexing case, so enable it again. This also
+  // unwinds any flow control the stream still had applied to the connection.
+  if (drain_state_ != DrainState::Closing && codec_->protocol() != Protocol::Http2) {
+    while (!read_callbacks_->connection().readEnabled()) {
+      read_callbacks_->connection().readDisable(false);
+    }
   }
 
   if (idle_timer_ && streams_.empty()) {
@@ -167,6 +214,9 @@ StreamDecoder& ConnectionManagerImpl::newStream(StreamEncoder& response_encoder)
   new_stream->response_encoder_ = &response_encoder;
   new_stream->response_encoder_->getStream().addCallbacks(*new_stream);
   config_.filterFactory().createFilterChain(*new_stream);
+  decoder_filters_hint_ = new_stream->decoder_filters_.size();
+  encoder_filters_hint_ = new_stream->encoder_filters_.size();
+  access_log_handlers_hint_ = new_stream->access_log_handlers_.size();
   new_stream->moveIntoList(std::move(new_stream), streams_);
   return **streams_.begin();
 }
@@ -268,6 +318,18 @@ void ConnectionManagerImpl::onEvent(uint32_t events) {
   }
 }
 
+void ConnectionManagerImpl::onAboveWriteBufferHighWatermark() {
+  if (codec_) {
+    codec_->onUnderlyingConnectionAboveWriteBufferHighWatermark();
+  }
+}
+
+void ConnectionManagerImpl::onBelowWriteBufferLowWatermark() {
+  if (codec_) {
+    codec_->onUnderlyingConnectionBelowWriteBufferLowWatermark();
+  }
+}
+
 void ConnectionManagerImpl::onGoAway() {
   // Currently we do nothing with remote go away frames. In the future we can decide to no longer
   // push resources if applicable.
@@ -316,8 +378,10 @@ ConnectionManagerImpl::ActiveStream::ActiveStream(ConnectionManagerImpl& connect
       snapped_route_config_(connection_manager.config_.routeConfigProvider().config()),
       stream_id_(ConnectionManagerUtility::generateStreamId(*snapped_route_config_,
                                                             connection_manager.random_generator_)),
-      request_timer_(connection_manager_.stats_.named_.downstream_rq_time_.allocateSpan()),
-      request_info_(connection_manager_.codec_->protocol()) {
+      request_timer_(connection_manager_.stats_.named_.downstream_rq_time_.allocateSpan(
+          connection_manager_.loopTimeSource())),
+      request_info_(connection_manager_.codec_->protocol(), connection_manager_.loopTimeSource()),
+      filter_name_(&UnnamedFilter) {
   connection_manager_.stats_.named_.downstream_rq_total_.inc();
   connection_manager_.stats_.named_.downstream_rq_active_.inc();
   if (connection_manager_.codec_->protocol() == Protocol::Http2) {
@@ -325,15 +389,31 @@ ConnectionManagerImpl::ActiveStream::ActiveStream(ConnectionManagerImpl& connect
   } else {
     connection_manager_.stats_.named_.downstream_rq_http1_total_.inc();
   }
+
+  decoder_filters_.reserve(connection_manager_.decoder_filters_hint_);
+  encoder_filters_.reserve(connection_manager_.encoder_filters_hint_);
+  access_log_handlers_.reserve(connection_manager_.access_log_handlers_hint_);
+  if (Memory::RequestAllocations::enabled()) {
+    allocations_.reset(new Memory::RequestAllocations());
+  }
+  time_filters_ = connection_manager_.runtime_.snapshot().featureEnabled(
+      RuntimeFilterTimingSampling, 0, stream_id_, 10000);
 }
 
 ConnectionManagerImpl::ActiveStream::~ActiveStream() {
   connection_manager_.stats_.named_.downstream_rq_active_.dec();
-  for (const AccessLog::InstanceSharedPtr& access_log : connection_manager_.config_.accessLogs()) {
-    access_log->log(request_headers_.get(), response_headers_.get(), request_info_);
+  {
+    Memory::RequestPhaseScope phase(allocations_.get(), Memory::RequestPhase::AccessLog);
+    for (const AccessLog::InstanceSharedPtr& access_log :
+         connection_manager_.config_.accessLogs()) {
+      access_log->log(request_headers_.get(), response_headers_.get(), request_info_);
+    }
+    for (const auto& log_handler : access_log_handlers_) {
+      log_handler->log(request_headers_.get(), response_headers_.get(), request_info_);
+    }
   }
-  for (const auto& log_handler : access_log_handlers_) {
-    log_handler->log(request_headers_.get(), response_headers_.get(), request_info_);
+  if (allocations_) {
+    deliverAllocationHistograms();
   }
 
   if (active_span_) {
@@ -350,16 +430,18 @@ ConnectionManagerImpl::ActiveStream::~ActiveStream() {
 
 void ConnectionManagerImpl::ActiveStream::addStreamDecoderFilterWorker(
     StreamDecoderFilterSharedPtr filter, bool dual_filter) {
-  ActiveStreamDecoderFilterPtr wrapper(new ActiveStreamDecoderFilter(*this, filter, dual_filter));
+  ActiveStreamDecoderFilterPtr wrapper(
+      new ActiveStreamDecoderFilter(*this, filter, dual_filter, decoder_filters_.size()));
   filter->setDecoderFilterCallbacks(*wrapper);
-  wrapper->moveIntoListBack(std::move(wrapper), decoder_filters_);
+  decoder_filters_.emplace_back(std::move(wrapper));
 }
 
 void ConnectionManagerImpl::ActiveStream::addStreamEncoderFilterWorker(
     StreamEncoderFilterSharedPtr filter, bool dual_filter) {
-  ActiveStreamEncoderFilterPtr wrapper(new ActiveStreamEncoderFilter(*this, filter, dual_filter));
+  ActiveStreamEncoderFilterPtr wrapper(
+      new ActiveStreamEncoderFilter(*this, filter, dual_filter, encoder_filters_.size()));
   filter->setEncoderFilterCallbacks(*wrapper);
-  wrapper->moveIntoListBack(std::move(wrapper), encoder_filters_);
+  encoder_filters_.emplace_back(std::move(wrapper));
 }
 
 void ConnectionManagerImpl::ActiveStream::addAccessLogHandler(
@@ -394,7 +476,39 @@ Ssl::Connection* ConnectionManagerImpl::ActiveStream::ssl() {
   return connection_manager_.read_callbacks_->connection().ssl();
 }
 
+const Network::Connection* ConnectionManagerImpl::ActiveStream::connection() {
+  return &connection_manager_.read_callbacks_->connection();
+}
+
+void ConnectionManagerImpl::ActiveStream::deliverAllocationHistograms() {
+  for (size_t i = 0; i < Memory::RequestAllocations::NumPhases; i++) {
+    const Memory::RequestPhase phase = static_cast<Memory::RequestPhase>(i);
+    const Memory::RequestAllocations::Tally& tally = allocations_->tally(phase);
+    const char* name = Memory::RequestAllocations::name(phase);
+    connection_manager_.stats_.store_.deliverHistogramToSinks(
+        fmt::format("{}downstream_rq_allocations.{}", connection_manager_.stats_.prefix_, name),
+        tally.allocations_);
+    connection_manager_.stats_.store_.deliverHistogramToSinks(
+        fmt::format("{}downstream_rq_allocated_bytes.{}", connection_manager_.stats_.prefix_, name),
+        tally.bytes_);
+  }
+}
+
+std::chrono::nanoseconds ConnectionManagerImpl::ActiveStream::FilterTimer::threadCpuTime() {
+  timespec now;
+  RELEASE_ASSERT(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) == 0);
+  return std::chrono::seconds(now.tv_sec) + std::chrono::nanoseconds(now.tv_nsec);
+}
+
+void ConnectionManagerImpl::ActiveStream::FilterTimer::deliver(const char* callback) {
+  const ConnectionManagerStats& stats = filter_.parent_.connection_manager_.stats_;
+  stats.store_.deliverHistogramToSinks(
+      fmt::format("{}filter.{}.{}_cpu_ns", stats.prefix_, filter_.filter_name_, callback),
+      (threadCpuTime() - start_).count());
+}
+
 void ConnectionManagerImpl::ActiveStream::decodeHeaders(HeaderMapPtr&& headers, bool end_stream) {
+  Memory::RequestPhaseScope phase(allocations_.get(), Memory::RequestPhase::DecodeHeaders);
   ASSERT(!state_.remote_complete_);
   state_.remote_complete_ = end_stream;
 
@@ -408,7 +522,7 @@ void ConnectionManagerImpl::ActiveStream::decodeHeaders(HeaderMapPtr&& headers,
 #endif
 
   connection_manager_.user_agent_.initializeFromHeaders(
-      *request_headers_, connection_manager_.stats_.prefix_, connection_manager_.stats_.store_);
+      *request_headers_, *connection_manager_.stats_.user_agent_context_);
 
   // Make sure we are getting a codec version we support.
   Protocol protocol = connection_manager_.codec_->protocol();
@@ -428,16 +542,12 @@ void ConnectionManagerImpl::ActiveStream::decodeHeaders(HeaderMapPtr&& headers,
     return;
   }
 
-  // Check for maximum incoming header size. Both codecs have some amount of checking for maximum
-  // header size. For HTTP/1.1 the entire headers data has be less than ~80K (hard coded in
-  // http_parser). For HTTP/2 we currently check if the incoming headers is less than ~63K. 63K
-  // is abritrary and is set because currently nghttp2 does not allow *sending* more than 64K of
-  // headers for reasons I don't understand so 63K is testable. However, since HTTP/1.1 can send us
-  // potentially 80K of headers, we can still die when we try to proxy to HTTP/2. We correctly
-  // handle this but to the rest of the code it looks like an upstream reset which will usually
-  // result in a 503. In order to have generally uniform behavior we also check total header size
-  // here and keep it under 60K. Ultimately it would be nice to bring this to a lower value but
-  // unclear if that is possible or not.
+  // Check for maximum incoming header size. Both codecs reject headers beyond the configured
+  // header limits while parsing them, which default to 63K because nghttp2 does not allow
+  // *sending* more than 64K of headers. Headers close to that limit can still fail when we try to
+  // proxy them to HTTP/2 with a few more headers added. We correctly handle this but to the rest of
+  // the code it looks like an upstream reset which will usually result in a 503. In order to have
+  // generally uniform behavior we also check total header size here and keep it under 60K.
   if (request_headers_->byteSize() > (60 * 1024)) {
     HeaderMapImpl headers{{Headers::get().Status, std::to_string(enumToInt(Code::BadRequest))}};
     encodeHeaders(nullptr, headers, true);
@@ -483,13 +593,26 @@ void ConnectionManagerImpl::ActiveStream::decodeHeaders(HeaderMapPtr&& headers,
 
   // Set the trusted address for the connection by taking the last address in XFF.
   downstream_address_ = Utility::getLastAddressFromXFF(*request_headers_);
+
+  // Resolve the route once, now that the headers routing depends on are final, so that filters
+  // share it. Filters that change the route by modifying the headers call clearRouteCache().
+  refreshCachedRoute();
   decodeHeaders(nullptr, *request_headers_, end_stream);
 }
 
+void ConnectionManagerImpl::ActiveStream::refreshCachedRoute() {
+  Memory::RequestPhaseScope phase(allocations_.get(), Memory::RequestPhase::Routing);
+  if (state_.route_resolved_) {
+    connection_manager_.stats_.named_.downstream_rq_route_recalc_.inc();
+  }
+  state_.route_resolved_ = true;
+  cached_route_.value(snapped_route_config_->route(*request_headers_, stream_id_));
+}
+
 void ConnectionManagerImpl::ActiveStream::decodeHeaders(ActiveStreamDecoderFilter* filter,
                                                         HeaderMap& headers, bool end_stream) {
-  std::list<ActiveStreamDecoderFilterPtr>::iterator entry;
-  std::list<ActiveStreamDecoderFilterPtr>::iterator continue_data_entry = decoder_filters_.end();
+  std::vector<ActiveStreamDecoderFilterPtr>::iterator entry;
+  std::vector<ActiveStreamDecoderFilterPtr>::iterator continue_data_entry = decoder_filters_.end();
   if (!filter) {
     entry = decoder_filters_.begin();
   } else {
@@ -499,8 +622,10 @@ void ConnectionManagerImpl::ActiveStream::decodeHeaders(ActiveStreamDecoderFilte
   for (; entry != decoder_filters_.end(); entry++) {
     ASSERT(!(state_.filter_call_state_ & FilterCallState::DecodeHeaders));
     state_.filter_call_state_ |= FilterCallState::DecodeHeaders;
+    FilterTimer timer(**entry);
     FilterHeadersStatus status = (*entry)->handle_->decodeHeaders(
         headers, end_stream && continue_data_entry == decoder_filters_.end());
+    timer.complete("decode_headers");
     state_.filter_call_state_ &= ~FilterCallState::DecodeHeaders;
     stream_log_trace("decode headers called: filter={} status={}", *this,
                      static_cast<const void*>((*entry).get()), static_cast<uint64_t>(status));
@@ -529,6 +654,7 @@ void ConnectionManagerImpl::ActiveStream::decodeHeaders(ActiveStreamDecoderFilte
 }
 
 void ConnectionManagerImpl::ActiveStream::decodeData(Buffer::Instance& data, bool end_stream) {
+  Memory::RequestPhaseScope phase(allocations_.get(), Memory::RequestPhase::DecodeBody);
   request_info_.bytes_received_ += data.length();
   ASSERT(!state_.remote_complete_);
   state_.remote_complete_ = end_stream;
@@ -547,7 +673,7 @@ void ConnectionManagerImpl::ActiveStream::decodeData(ActiveStreamDecoderFilter*
     return;
   }
 
-  std::list<ActiveStreamDecoderFilterPtr>::iterator entry;
+  std::vector<ActiveStreamDecoderFilterPtr>::iterator entry;
   if (!filter) {
     entry = decoder_filters_.begin();
   } else {
@@ -557,7 +683,9 @@ void ConnectionManagerImpl::ActiveStream::decodeData(ActiveStreamDecoderFilter*
   for (; entry != decoder_filters_.end(); entry++) {
     ASSERT(!(state_.filter_call_state_ & FilterCallState::DecodeData));
     state_.filter_call_state_ |= FilterCallState::DecodeData;
+    FilterTimer timer(**entry);
     FilterDataStatus status = (*entry)->handle_->decodeData(data, end_stream);
+    timer.complete("decode_data");
     state_.filter_call_state_ &= ~FilterCallState::DecodeData;
     stream_log_trace("decode data called: filter={} status={}", *this,
                      static_cast<const void*>((*entry).get()), static_cast<uint64_t>(status));
@@ -586,6 +714,7 @@ void ConnectionManagerImpl::ActiveStream::addDecodedData(ActiveStreamDecoderFilt
 }
 
 void ConnectionManagerImpl::ActiveStream::decodeTrailers(HeaderMapPtr&& trailers) {
+  Memory::RequestPhaseScope phase(allocations_.get(), Memory::RequestPhase::DecodeBody);
   request_trailers_ = std::move(trailers);
   ASSERT(!state_.remote_complete_);
   state_.remote_complete_ = true;
@@ -599,7 +728,7 @@ void ConnectionManagerImpl::ActiveStream::decodeTrailers(ActiveStreamDecoderFilt
     return;
   }
 
-  std::list<ActiveStreamDecoderFilterPtr>::iterator entry;
+  std::vector<ActiveStreamDecoderFilterPtr>::iterator entry;
   if (!filter) {
     entry = decoder_filters_.begin();
   } else {
@@ -619,7 +748,7 @@ void ConnectionManagerImpl::ActiveStream::decodeTrailers(ActiveStreamDecoderFilt
   }
 }
 
-std::list<ConnectionManagerImpl::ActiveStreamEncoderFilterPtr>::iterator
+std::vector<ConnectionManagerImpl::ActiveStreamEncoderFilterPtr>::iterator
 ConnectionManagerImpl::ActiveStream::commonEncodePrefix(ActiveStreamEncoderFilter* filter,
                                                         bool end_stream) {
   // Only do base state setting on the initial call. Subsequent calls for filtering do not touch
@@ -647,14 +776,17 @@ void ConnectionManagerImpl::startDrainSequence() {
 
 void ConnectionManagerImpl::ActiveStream::encodeHeaders(ActiveStreamEncoderFilter* filter,
                                                         HeaderMap& headers, bool end_stream) {
-  std::list<ActiveStreamEncoderFilterPtr>::iterator entry = commonEncodePrefix(filter, end_stream);
-  std::list<ActiveStreamEncoderFilterPtr>::iterator continue_data_entry = encoder_filters_.end();
+  Memory::RequestPhaseScope phase(allocations_.get(), Memory::RequestPhase::ResponseEncode);
+  std::vector<ActiveStreamEncoderFilterPtr>::iterator entry = commonEncodePrefix(filter, end_stream);
+  std::vector<ActiveStreamEncoderFilterPtr>::iterator continue_data_entry = encoder_filters_.end();
 
   for (; entry != encoder_filters_.end(); entry++) {
     ASSERT(!(state_.filter_call_state_ & FilterCallState::EncodeHeaders));
     state_.filter_call_state_ |= FilterCallState::EncodeHeaders;
+    FilterTimer timer(**entry);
     FilterHeadersStatus status = (*entry)->handle_->encodeHeaders(
         headers, end_stream && continue_data_entry == encoder_filters_.end());
+    timer.complete("encode_headers");
     state_.filter_call_state_ &= ~FilterCallState::EncodeHeaders;
     stream_log_trace("encode headers called: filter={} status={}", *this,
                      static_cast<const void*>((*entry).get()), static_cast<uint64_t>(status));
@@ -671,7 +803,9 @@ void ConnectionManagerImpl::ActiveStream::encodeHeaders(ActiveStreamEncoderFilte
 
   // Base headers.
   connection_manager_.config_.dateProvider().setDateHeader(headers);
-  headers.insertServer().value(connection_manager_.config_.serverName());
+  // The config outlives the streams of the connection manager, so the server name is referenced
+  // rather than copied into each response.
+  headers.insertServer().value().setReference(connection_manager_.config_.serverName());
   ConnectionManagerUtility::mutateResponseHeaders(headers, *request_headers_,
                                                   *snapped_route_config_);
 
@@ -755,11 +889,14 @@ void ConnectionManagerImpl::ActiveStream::addEncodedData(ActiveStreamEncoderFilt
 
 void ConnectionManagerImpl::ActiveStream::encodeData(ActiveStreamEncoderFilter* filter,
                                                      Buffer::Instance& data, bool end_stream) {
-  std::list<ActiveStreamEncoderFilterPtr>::iterator entry = commonEncodePrefix(filter, end_stream);
+  Memory::RequestPhaseScope phase(allocations_.get(), Memory::RequestPhase::ResponseEncode);
+  std::vector<ActiveStreamEncoderFilterPtr>::iterator entry = commonEncodePrefix(filter, end_stream);
   for (; entry != encoder_filters_.end(); entry++) {
     ASSERT(!(state_.filter_call_state_ & FilterCallState::EncodeData));
     state_.filter_call_state_ |= FilterCallState::EncodeData;
+    FilterTimer timer(**entry);
     FilterDataStatus status = (*entry)->handle_->encodeData(data, end_stream);
+    timer.complete("encode_data");
     state_.filter_call_state_ &= ~FilterCallState::EncodeData;
     stream_log_trace("encode data called: filter={} status={}", *this,
                      static_cast<const void*>((*entry).get()), static_cast<uint64_t>(status));
@@ -778,7 +915,8 @@ void ConnectionManagerImpl::ActiveStream::encodeData(ActiveStreamEncoderFilter*
 
 void ConnectionManagerImpl::ActiveStream::encodeTrailers(ActiveStreamEncoderFilter* filter,
                                                          HeaderMap& trailers) {
-  std::list<ActiveStreamEncoderFilterPtr>::iterator entry = commonEncodePrefix(filter, true);
+  Memory::RequestPhaseScope phase(allocations_.get(), Memory::RequestPhase::ResponseEncode);
+  std::vector<ActiveStreamEncoderFilterPtr>::iterator entry = commonEncodePrefix(filter, true);
   for (; entry != encoder_filters_.end(); entry++) {
     ASSERT(!(state_.filter_call_state_ & FilterCallState::EncodeTrailers));
     state_.filter_call_state_ |= FilterCallState::EncodeTrailers;
@@ -820,6 +958,24 @@ void ConnectionManagerImpl::ActiveStream::onResetStream(StreamResetReason) {
   connection_manager_.doDeferredStreamDestroy(*this);
 }
 
+void ConnectionManagerImpl::ActiveStream::onAboveWriteBufferHighWatermark() {
+  // The response cannot be written as fast as it arrives, so the filters that produce it (e.g.,
+  // the router) are told to stop reading it.
+  stream_log_debug("disabling upstream stream due to downstream stream watermark", *this);
+  state_.above_write_buffer_high_watermark_ = true;
+  for (DownstreamWatermarkCallbacks* callbacks : watermark_callbacks_) {
+    callbacks->onAboveWriteBufferHighWatermark();
+  }
+}
+
+void ConnectionManagerImpl::ActiveStream::onBelowWriteBufferLowWatermark() {
+  stream_log_debug("enabling upstream stream due to downstream stream watermark", *this);
+  state_.above_write_buffer_high_watermark_ = false;
+  for (DownstreamWatermarkCallbacks* callbacks : watermark_callbacks_) {
+    callbacks->onBelowWriteBufferLowWatermark();
+  }
+}
+
 Tracing::OperationName ConnectionManagerImpl::ActiveStream::operationName() const {
   return connection_manager_.config_.tracingConfig()->operation_name_;
 }
@@ -933,6 +1089,10 @@ uint64_t ConnectionManagerImpl::ActiveStreamFilterBase::connectionId() {
 
 Ssl::Connection* ConnectionManagerImpl::ActiveStreamFilterBase::ssl() { return parent_.ssl(); }
 
+const Network::Connection* ConnectionManagerImpl::ActiveStreamFilterBase::connection() {
+  return parent_.connection();
+}
+
 Event::Dispatcher& ConnectionManagerImpl::ActiveStreamFilterBase::dispatcher() {
   return parent_.connection_manager_.read_callbacks_->connection().dispatcher();
 }
@@ -947,8 +1107,7 @@ Tracing::Span& ConnectionManagerImpl::ActiveStreamFilterBase::activeSpan() {
 
 Router::RouteConstSharedPtr ConnectionManagerImpl::ActiveStreamFilterBase::route() {
   if (!parent_.cached_route_.valid()) {
-    parent_.cached_route_.value(
-        parent_.snapped_route_config_->route(*parent_.request_headers_, parent_.stream_id_));
+    parent_.refreshCachedRoute();
   }
 
   return parent_.cached_route_.value();
@@ -960,6 +1119,13 @@ void ConnectionManagerImpl::ActiveStreamDecoderFilter::addDecodedData(Buffer::In
 
 void ConnectionManagerImpl::ActiveStreamDecoderFilter::continueDecoding() { commonContinue(); }
 
+void ConnectionManagerImpl::ActiveStreamDecoderFilter::setDecodingBuffer(
+    Buffer::InstancePtr&& buffer) {
+  ASSERT(!parent_.buffered_request_data_);
+  ASSERT(buffer->length() == 0);
+  parent_.buffered_request_data_ = std::move(buffer);
+}
+
 void ConnectionManagerImpl::ActiveStreamDecoderFilter::encodeHeaders(HeaderMapPtr&& headers,
                                                                      bool end_stream) {
   parent_.response_headers_ = std::move(headers);
@@ -976,6 +1142,34 @@ void ConnectionManagerImpl::ActiveStreamDecoderFilter::encodeTrailers(HeaderMapP
   parent_.encodeTrailers(nullptr, *parent_.response_trailers_);
 }
 
+void ConnectionManagerImpl::ActiveStreamDecoderFilter::
+    onDecoderFilterAboveWriteBufferHighWatermark() {
+  stream_log_debug("read disabled due to upstream watermark", parent_);
+  parent_.connection_manager_.stats_.named_.downstream_flow_control_paused_reading_total_.inc();
+  parent_.response_encoder_->getStream().readDisable(true);
+}
+
+void ConnectionManagerImpl::ActiveStreamDecoderFilter::
+    onDecoderFilterBelowWriteBufferLowWatermark() {
+  stream_log_debug("read enabled due to upstream watermark", parent_);
+  parent_.connection_manager_.stats_.named_.downstream_flow_control_resumed_reading_total_.inc();
+  parent_.response_encoder_->getStream().readDisable(false);
+}
+
+void ConnectionManagerImpl::ActiveStreamDecoderFilter::addDownstreamWatermarkCallbacks(
+    DownstreamWatermarkCallbacks& callbacks) {
+  // A filter that registers while the downstream is already backed up learns about it right away.
+  parent_.watermark_callbacks_.push_back(&callbacks);
+  if (parent_.state_.above_write_buffer_high_watermark_) {
+    callbacks.onAboveWriteBufferHighWatermark();
+  }
+}
+
+void ConnectionManagerImpl::ActiveStreamDecoderFilter::removeDownstreamWatermarkCallbacks(
+    DownstreamWatermarkCallbacks& callbacks) {
+  parent_.watermark_callbacks_.remove(&callbacks);
+}
+
 void ConnectionManagerImpl::ActiveStreamEncoderFilter::addEncodedData(Buffer::Instance& data) {
   return parent_.addEncodedData(*this, data);
 }
@@ -26,6 +26,7 @@
 #include "common/http/access_log/request_info_impl.h"
 #include "common/http/date_provider.h"
 #include "common/http/user_agent.h"
+#include "common/memory/accounting.h"
 #include "common/tracing/http_tracer_impl.h"
 
 namespace Envoy {
@@ -58,6 +59,8 @@ namespace Http {
   GAUGE  (downstream_cx_tx_bytes_buffered)                                                         \
   COUNTER(downstream_cx_drain_close)                                                               \
   COUNTER(downstream_cx_idle_timeout)                                                              \
+  COUNTER(downstream_flow_control_paused_reading_total)                                            \
+  COUNTER(downstream_flow_control_resumed_reading_total)                                           \
   COUNTER(downstream_rq_total)                                                                     \
   COUNTER(downstream_rq_http1_total)                                                               \
   COUNTER(downstream_rq_http2_total)                                                               \
@@ -66,6 +69,7 @@ namespace Http {
   COUNTER(downstream_rq_rx_reset)                                                                  \
   COUNTER(downstream_rq_tx_reset)                                                                  \
   COUNTER(downstream_rq_non_relative_path)                                                         \
+  COUNTER(downstream_rq_route_recalc)                                                              \
   COUNTER(downstream_rq_2xx)                                                                       \
   COUNTER(downstream_rq_3xx)                                                                       \
   COUNTER(downstream_rq_4xx)                                                                       \
@@ -85,6 +89,7 @@ struct ConnectionManagerStats {
   ConnectionManagerNamedStats named_;
   std::string prefix_;
   Stats::Store& store_;
+  UserAgentContextPtr user_agent_context_;
 };
 
 /**
@@ -251,6 +256,14 @@ public:
 
   // Network::ConnectionCallbacks
   void onEvent(uint32_t events) override;
+  void onAboveWriteBufferHighWatermark() override;
+  void onBelowWriteBufferLowWatermark() override;
+
+  // Streams and their filter wrappers are created and destroyed for every request, on the worker
+  // that owns the connection, and are freed by its dispatcher's deferred deletion. Their storage is
+  // recycled through per thread free lists of up to this many blocks per type, so that most
+  // requests make no allocations for them.
+  static const size_t MaxCachedStreams = 256;
 
 private:
   struct ActiveStream;
@@ -260,7 +273,8 @@ private:
    */
   struct ActiveStreamFilterBase : public virtual StreamFilterCallbacks {
     ActiveStreamFilterBase(ActiveStream& parent, bool dual_filter)
-        : parent_(parent), headers_continued_(false), stopped_(false), dual_filter_(dual_filter) {}
+        : parent_(parent), filter_name_(*parent.filter_name_), headers_continued_(false),
+          stopped_(false), dual_filter_(dual_filter) {}
 
     bool commonHandleAfterHeadersCallback(FilterHeadersStatus status);
     void commonHandleBufferData(Buffer::Instance& provided_data);
@@ -278,6 +292,7 @@ private:
     // Http::StreamFilterCallbacks
     uint64_t connectionId() override;
     Ssl::Connection* ssl() override;
+    const Network::Connection* connection() override;
     Event::Dispatcher& dispatcher() override;
     void resetStream() override;
     Router::RouteConstSharedPtr route() override;
@@ -287,6 +302,7 @@ private:
     const std::string& downstreamAddress() override;
 
     ActiveStream& parent_;
+    const std::string& filter_name_;
     bool headers_continued_ : 1;
     bool stopped_ : 1;
     const bool dual_filter_ : 1;
@@ -296,11 +312,21 @@ private:
    * Wrapper for a stream decoder filter.
    */
   struct ActiveStreamDecoderFilter : public ActiveStreamFilterBase,
-                                     public StreamDecoderFilterCallbacks,
-                                     LinkedObject<ActiveStreamDecoderFilter> {
+                                     public StreamDecoderFilterCallbacks {
     ActiveStreamDecoderFilter(ActiveStream& parent, StreamDecoderFilterSharedPtr filter,
-                              bool dual_filter)
-        : ActiveStreamFilterBase(parent, dual_filter), handle_(filter) {}
+                              bool dual_filter, size_t index)
+        : ActiveStreamFilterBase(parent, dual_filter), handle_(filter), index_(index) {}
+
+    // Storage is recycled through a per thread free list. @see MaxCachedStreams.
+    static void* operator new(size_t size);
+    static void operator delete(void* block, size_t size);
+
+    /**
+     * @return the position of this filter in the stream's decoder filter chain.
+     */
+    std::vector<std::unique_ptr<ActiveStreamDecoderFilter>>::iterator entry() {
+      return parent_.decoder_filters_.begin() + index_;
+    }
 
     // ActiveStreamFilterBase
     Buffer::InstancePtr& bufferedData() override { return parent_.buffered_request_data_; }
@@ -320,11 +346,20 @@ private:
     const Buffer::Instance* decodingBuffer() override {
       return parent_.buffered_request_data_.get();
     }
+    void setDecodingBuffer(Buffer::InstancePtr&& buffer) override;
+    void clearRouteCache() override {
+      parent_.cached_route_ = Optional<Router::RouteConstSharedPtr>();
+    }
     void encodeHeaders(HeaderMapPtr&& headers, bool end_stream) override;
     void encodeData(Buffer::Instance& data, bool end_stream) override;
     void encodeTrailers(HeaderMapPtr&& trailers) override;
+    void onDecoderFilterAboveWriteBufferHighWatermark() override;
+    void onDecoderFilterBelowWriteBufferLowWatermark() override;
+    void addDownstreamWatermarkCallbacks(DownstreamWatermarkCallbacks& callbacks) override;
+    void removeDownstreamWatermarkCallbacks(DownstreamWatermarkCallbacks& callbacks) override;
 
     StreamDecoderFilterSharedPtr handle_;
+    const size_t index_;
   };
 
   typedef std::unique_ptr<ActiveStreamDecoderFilter> ActiveStreamDecoderFilterPtr;
@@ -333,11 +368,21 @@ private:
    * Wrapper for a stream encoder filter.
    */
   struct ActiveStreamEncoderFilter : public ActiveStreamFilterBase,
-                                     public StreamEncoderFilterCallbacks,
-                                     LinkedObject<ActiveStreamEncoderFilter> {
+                                     public StreamEncoderFilterCallbacks {
     ActiveStreamEncoderFilter(ActiveStream& parent, StreamEncoderFilterSharedPtr filter,
-                              bool dual_filter)
-        : ActiveStreamFilterBase(parent, dual_filter), handle_(filter) {}
+                              bool dual_filter, size_t index)
+        : ActiveStreamFilterBase(parent, dual_filter), handle_(filter), index_(index) {}
+
+    // Storage is recycled through a per thread free list. @see MaxCachedStreams.
+    static void* operator new(size_t size);
+    static void operator delete(void* block, size_t size);
+
+    /**
+     * @return the position of this filter in the stream's encoder filter chain.
+     */
+    std::vector<std::unique_ptr<ActiveStreamEncoderFilter>>::iterator entry() {
+      return parent_.encoder_filters_.begin() + index_;
+    }
 
     // ActiveStreamFilterBase
     Buffer::InstancePtr& bufferedData() override { return parent_.buffered_response_data_; }
@@ -359,6 +404,7 @@ private:
     }
 
     StreamEncoderFilterSharedPtr handle_;
+    const size_t index_;
   };
 
   typedef std::unique_ptr<ActiveStreamEncoderFilter> ActiveStreamEncoderFilterPtr;
@@ -376,13 +422,19 @@ private:
     ActiveStream(ConnectionManagerImpl& connection_manager);
     ~ActiveStream();
 
+    // Storage is recycled through a per thread free list. @see MaxCachedStreams.
+    static void* operator new(size_t size);
+    static void operator delete(void* block, size_t size);
+
     void addStreamDecoderFilterWorker(StreamDecoderFilterSharedPtr filter, bool dual_filter);
     void addStreamEncoderFilterWorker(StreamEncoderFilterSharedPtr filter, bool dual_filter);
     void chargeStats(HeaderMap& headers);
-    std::list<ActiveStreamEncoderFilterPtr>::iterator
+    void refreshCachedRoute();
+    std::vector<ActiveStreamEncoderFilterPtr>::iterator
     commonEncodePrefix(ActiveStreamEncoderFilter* filter, bool end_stream);
     uint64_t connectionId();
     Ssl::Connection* ssl();
+    const Network::Connection* connection();
     void addDecodedData(ActiveStreamDecoderFilter& filter, Buffer::Instance& data);
     void decodeHeaders(ActiveStreamDecoderFilter* filter, HeaderMap& headers, bool end_stream);
     void decodeData(ActiveStreamDecoderFilter* filter, Buffer::Instance& data, bool end_stream);
@@ -392,10 +444,13 @@ private:
     void encodeData(ActiveStreamEncoderFilter* filter, Buffer::Instance& data, bool end_stream);
     void encodeTrailers(ActiveStreamEncoderFilter* filter, HeaderMap& trailers);
     void maybeEndEncode(bool end_stream);
+    void deliverAllocationHistograms();
     uint64_t streamId() { return stream_id_; }
 
     // Http::StreamCallbacks
     void onResetStream(StreamResetReason reason) override;
+    void onAboveWriteBufferHighWatermark() override;
+    void onBelowWriteBufferLowWatermark() override;
 
     // Http::StreamDecoder
     void decodeHeaders(HeaderMapPtr&& headers, bool end_stream) override;
@@ -414,11 +469,41 @@ private:
       addStreamEncoderFilterWorker(filter, true);
     }
     void addAccessLogHandler(Http::AccessLog::InstanceSharedPtr handler) override;
+    void setFilterName(const std::string& name) override { filter_name_ = &name; }
 
     // Tracing::TracingConfig
     virtual Tracing::OperationName operationName() const override;
     virtual const std::vector<Http::LowerCaseString>& requestHeadersForTags() const override;
 
+    /**
+     * Measures the CPU time of one filter callback when the stream is sampled for filter timing,
+     * and delivers it to the filter's histogram. On other streams it costs a branch.
+     */
+    class FilterTimer {
+    public:
+      FilterTimer(ActiveStreamFilterBase& filter) : filter_(filter) {
+        if (filter.parent_.time_filters_) {
+          start_ = threadCpuTime();
+        }
+      }
+
+      /**
+       * @param callback supplies the name of the timed callback as used in the histogram name.
+       */
+      void complete(const char* callback) {
+        if (filter_.parent_.time_filters_) {
+          deliver(callback);
+        }
+      }
+
+    private:
+      static std::chrono::nanoseconds threadCpuTime();
+      void deliver(const char* callback);
+
+      ActiveStreamFilterBase& filter_;
+      std::chrono::nanoseconds start_{};
+    };
+
     /**
      * Flags that keep track of which filter calls are currently in progress.
      */
@@ -435,12 +520,17 @@ private:
 
     // All state for the stream. Put here for readability.
     struct State {
-      State() : remote_complete_(false), local_complete_(false), saw_connection_close_(false) {}
+      State()
+          : remote_complete_(false), local_complete_(false), saw_connection_close_(false),
+            above_write_buffer_high_watermark_(false), route_resolved_(false) {}
 
       uint32_t filter_call_state_{0};
       bool remote_complete_ : 1;
       bool local_complete_ : 1;
       bool saw_connection_close_ : 1;
+      bool above_write_buffer_high_watermark_ : 1;
+      // Set once the route has been resolved, so that resolving it again can be counted.
+      bool route_resolved_ : 1;
     };
 
     ConnectionManagerImpl& connection_manager_;
@@ -454,14 +544,22 @@ private:
     HeaderMapPtr request_headers_;
     Buffer::InstancePtr buffered_request_data_; // TODO(mattklein123): buffer data stat
     HeaderMapPtr request_trailers_;
-    std::list<ActiveStreamDecoderFilterPtr> decoder_filters_;
-    std::list<ActiveStreamEncoderFilterPtr> encoder_filters_;
-    std::list<Http::AccessLog::InstanceSharedPtr> access_log_handlers_;
+    // The filter chains never change once they have been created so they are kept in vectors,
+    // which are sized up front from the previous stream on the connection.
+    std::vector<ActiveStreamDecoderFilterPtr> decoder_filters_;
+    std::vector<ActiveStreamEncoderFilterPtr> encoder_filters_;
+    std::vector<Http::AccessLog::InstanceSharedPtr> access_log_handlers_;
+    std::list<DownstreamWatermarkCallbacks*> watermark_callbacks_;
     Stats::TimespanPtr request_timer_;
     State state_;
     AccessLog::RequestInfoImpl request_info_;
     std::string downstream_address_;
     Optional<Router::RouteConstSharedPtr> cached_route_;
+    // Only set when per request allocation accounting was on when the stream started.
+    std::unique_ptr<Memory::RequestAllocations> allocations_;
+    // The name given to filters as they are added, see setFilterName().
+    const std::string* filter_name_;
+    bool time_filters_{};
   };
 
   typedef std::unique_ptr<ActiveStream> ActiveStreamPtr;
@@ -483,6 +581,13 @@ private:
    */
   void doEndStream(ActiveStream& stream);
 
+  /**
+   * @return the connection's dispatcher loop time, used to time connections and requests.
+   */
+  MonotonicTimeSource& loopTimeSource() {
+    return read_callbacks_->connection().dispatcher().loopTimeSource();
+  }
+
   void resetAllStreams();
   void onIdleTimeout();
   void onDrainTimeout();
@@ -506,6 +611,11 @@ private:
   Runtime::Loader& runtime_;
   const LocalInfo::LocalInfo& local_info_;
   Network::ReadFilterCallbacks* read_callbacks_{};
+  // The filter chain sizes of the most recent stream. Every stream on a connection normally gets
+  // the same filter chain.
+  size_t decoder_filters_hint_{};
+  size_t encoder_filters_hint_{};
+  size_t access_log_handlers_hint_{};
 };
 
 } // Http
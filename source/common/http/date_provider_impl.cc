@@ -17,11 +17,16 @@ TlsCachingDateProviderImpl::TlsCachingDateProviderImpl(Event::Dispatcher& dispat
 }
 
 void TlsCachingDateProviderImpl::onRefreshDate() {
+  // The date has a resolution of a second, so most refreshes find it unchanged and do not need
+  // to post it to every thread.
   std::string new_date_string = date_formatter_.now();
-  tls_.set(tls_slot_,
-           [new_date_string](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
-             return std::make_shared<ThreadLocalCachedDate>(new_date_string);
-           });
+  if (new_date_string != date_string_) {
+    date_string_ = new_date_string;
+    tls_.set(tls_slot_,
+             [new_date_string](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+               return std::make_shared<ThreadLocalCachedDate>(new_date_string);
+             });
+  }
 
   refresh_timer_->enableTimer(std::chrono::milliseconds(500));
 }
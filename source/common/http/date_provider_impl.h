@@ -22,8 +22,8 @@ protected:
 };
 
 /**
- * A caching thread local provider. This implementation updates the date string every 500ms and
- * caches on each thread.
+ * A caching thread local provider. This implementation checks the date string every 500ms and
+ * caches it on each thread whenever it changes.
  */
 class TlsCachingDateProviderImpl : public DateProviderImplBase {
 public:
@@ -47,6 +47,8 @@ private:
   ThreadLocal::Instance& tls_;
   uint32_t tls_slot_;
   Event::TimerPtr refresh_timer_;
+  // The date string last posted to the threads.
+  std::string date_string_;
 };
 
 /**
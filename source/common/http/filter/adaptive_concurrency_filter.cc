@@ -0,0 +1,215 @@
+#include "common/http/filter/adaptive_concurrency_filter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include "envoy/http/access_log.h"
+#include "envoy/http/codes.h"
+
+#include "common/common/assert.h"
+#include "common/common/utility.h"
+#include "common/http/headers.h"
+#include "common/http/utility.h"
+#include "common/json/config_schemas.h"
+
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+namespace Http {
+
+namespace {
+
+int64_t toNanoseconds(MonotonicTime time) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+} // namespace
+
+ConcurrencyLimiter::ConcurrencyLimiter(const AdaptiveConcurrencyFilterConfig& config,
+                                       Stats::Gauge& limit_gauge, Stats::Gauge& min_rtt_gauge)
+    : config_(config), limit_gauge_(limit_gauge), min_rtt_gauge_(min_rtt_gauge),
+      limit_(config.initialLimit()),
+      next_update_ns_(toNanoseconds(config.timeSource().currentTime() + config.sampleWindow())) {
+  limit_gauge_.set(limit_);
+}
+
+bool ConcurrencyLimiter::tryAcquire() {
+  // As with the circuit breakers, workers racing here may briefly go above the limit.
+  if (in_flight_ >= limit_) {
+    return false;
+  }
+
+  in_flight_++;
+  return true;
+}
+
+void ConcurrencyLimiter::release(const Optional<std::chrono::milliseconds>& rtt) {
+  ASSERT(in_flight_ > 0);
+  in_flight_--;
+
+  if (!rtt.valid()) {
+    return;
+  }
+
+  sample_count_++;
+  sample_sum_ms_ += rtt.value().count();
+
+  MonotonicTime now = config_.timeSource().currentTime();
+  if (toNanoseconds(now) < next_update_ns_ || !update_lock_.try_lock()) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(update_lock_, std::adopt_lock);
+  // Another worker may have finished the window while this one was taking the lock.
+  if (toNanoseconds(now) >= next_update_ns_) {
+    updateLimit(now);
+  }
+}
+
+void ConcurrencyLimiter::updateLimit(MonotonicTime now) {
+  next_update_ns_ = toNanoseconds(now + config_.sampleWindow());
+  const uint64_t count = sample_count_.exchange(0);
+  const uint64_t sum_ms = sample_sum_ms_.exchange(0);
+  if (count == 0) {
+    return;
+  }
+
+  // The router reports whole milliseconds, so anything faster than that is treated as 1ms. This
+  // keeps sub-millisecond noise from being read as queueing.
+  const double sample_rtt_ms = std::max(1.0, static_cast<double>(sum_ms) / count);
+  if (min_rtt_ms_ == 0 || now >= min_rtt_reset_time_) {
+    // The minimum is forgotten periodically so that the limiter follows upstreams whose latency
+    // without load changes, e.g. after a deploy.
+    min_rtt_ms_ = sample_rtt_ms;
+    min_rtt_reset_time_ = now + config_.minRttWindow();
+  } else {
+    min_rtt_ms_ = std::min(min_rtt_ms_, sample_rtt_ms);
+  }
+
+  // A gradient below 1 means that requests are queueing. It is bounded so that a single slow
+  // window can at most halve the limit.
+  const double gradient = std::max(0.5, std::min(1.0, min_rtt_ms_ / sample_rtt_ms));
+  const double current_limit = limit_;
+  const double new_limit = current_limit * gradient + std::sqrt(current_limit);
+  limit_ = static_cast<uint32_t>(std::max<double>(
+      config_.minLimit(), std::min<double>(config_.maxLimit(), std::round(new_limit))));
+
+  limit_gauge_.set(limit_);
+  min_rtt_gauge_.set(static_cast<uint64_t>(min_rtt_ms_));
+}
+
+AdaptiveConcurrencyFilterConfig::AdaptiveConcurrencyFilterConfig(const Json::Object& json_config,
+                                                                 const std::string& stats_prefix,
+                                                                 Stats::Store& stats,
+                                                                 MonotonicTimeSource& time_source)
+    : Json::Validator(json_config, Json::Schema::ADAPTIVE_CONCURRENCY_HTTP_FILTER_SCHEMA),
+      initial_limit_(json_config.getInteger("initial_concurrency_limit", 100)),
+      min_limit_(json_config.getInteger("min_concurrency_limit", 1)),
+      max_limit_(json_config.getInteger("max_concurrency_limit", 1000)),
+      sample_window_(json_config.getInteger("sample_window_ms", 100)),
+      min_rtt_window_(json_config.getInteger("min_rtt_window_ms", 30000)), store_(stats),
+      time_source_(time_source), stats_(generateStats(stats_prefix, stats)) {
+  if (min_limit_ > max_limit_ || initial_limit_ < min_limit_ || initial_limit_ > max_limit_) {
+    throw EnvoyException("adaptive concurrency: initial_concurrency_limit must be between "
+                         "min_concurrency_limit and max_concurrency_limit");
+  }
+}
+
+ConcurrencyLimiter& AdaptiveConcurrencyFilterConfig::limiter(const std::string& cluster_name) {
+  std::unique_lock<std::mutex> lock(lock_);
+  std::unique_ptr<ConcurrencyLimiter>& limiter = limiters_[cluster_name];
+  if (!limiter) {
+    // The gauges come from the store rather than the cluster's scope so that they remain valid if
+    // the cluster is removed while the filter still holds the limiter.
+    const std::string prefix = fmt::format("cluster.{}.adaptive_concurrency.", cluster_name);
+    limiter.reset(new ConcurrencyLimiter(*this, store_.gauge(prefix + "concurrency_limit"),
+                                         store_.gauge(prefix + "min_rtt_ms")));
+  }
+
+  return *limiter;
+}
+
+AdaptiveConcurrencyFilterStats
+AdaptiveConcurrencyFilterConfig::generateStats(const std::string& prefix, Stats::Store& store) {
+  std::string final_prefix = prefix + "adaptive_concurrency.";
+  return {ALL_ADAPTIVE_CONCURRENCY_FILTER_STATS(POOL_COUNTER_PREFIX(store, final_prefix))};
+}
+
+AdaptiveConcurrencyFilter::AdaptiveConcurrencyFilter(AdaptiveConcurrencyFilterConfigSharedPtr config)
+    : config_(config) {}
+
+AdaptiveConcurrencyFilter::~AdaptiveConcurrencyFilter() { ASSERT(!limiter_); }
+
+void AdaptiveConcurrencyFilter::onDestroy() {
+  // The stream went away before a response was received, e.g. it was reset.
+  if (limiter_) {
+    limiter_->release(Optional<std::chrono::milliseconds>());
+    limiter_ = nullptr;
+  }
+}
+
+FilterHeadersStatus AdaptiveConcurrencyFilter::decodeHeaders(HeaderMap&, bool) {
+  Router::RouteConstSharedPtr route = decoder_callbacks_->route();
+  if (!route || !route->routeEntry()) {
+    // The router will respond locally.
+    return FilterHeadersStatus::Continue;
+  }
+
+  ConcurrencyLimiter& limiter = config_->limiter(route->routeEntry()->clusterName());
+  if (!limiter.tryAcquire()) {
+    config_->stats().rq_blocked_.inc();
+    decoder_callbacks_->requestInfo().setResponseFlag(
+        Http::AccessLog::ResponseFlag::UpstreamOverflow);
+    Http::Utility::sendLocalReply(*decoder_callbacks_, Http::Code::ServiceUnavailable,
+                                  "adaptive concurrency limit exceeded");
+    return FilterHeadersStatus::StopIteration;
+  }
+
+  limiter_ = &limiter;
+  return FilterHeadersStatus::Continue;
+}
+
+FilterDataStatus AdaptiveConcurrencyFilter::decodeData(Buffer::Instance&, bool) {
+  return FilterDataStatus::Continue;
+}
+
+FilterTrailersStatus AdaptiveConcurrencyFilter::decodeTrailers(HeaderMap&) {
+  return FilterTrailersStatus::Continue;
+}
+
+void AdaptiveConcurrencyFilter::setDecoderFilterCallbacks(StreamDecoderFilterCallbacks& callbacks) {
+  decoder_callbacks_ = &callbacks;
+}
+
+FilterHeadersStatus AdaptiveConcurrencyFilter::encodeHeaders(HeaderMap& headers, bool) {
+  if (!limiter_) {
+    return FilterHeadersStatus::Continue;
+  }
+
+  // Responses that the router generated itself, e.g. after a timeout, do not carry the upstream
+  // service time and say nothing about the upstream RTT.
+  Optional<std::chrono::milliseconds> rtt;
+  uint64_t service_time_ms;
+  if (headers.EnvoyUpstreamServiceTime() &&
+      StringUtil::atoul(headers.EnvoyUpstreamServiceTime()->value().c_str(), service_time_ms)) {
+    rtt.value(std::chrono::milliseconds(service_time_ms));
+  }
+
+  limiter_->release(rtt);
+  limiter_ = nullptr;
+  return FilterHeadersStatus::Continue;
+}
+
+FilterDataStatus AdaptiveConcurrencyFilter::encodeData(Buffer::Instance&, bool) {
+  return FilterDataStatus::Continue;
+}
+
+FilterTrailersStatus AdaptiveConcurrencyFilter::encodeTrailers(HeaderMap&) {
+  return FilterTrailersStatus::Continue;
+}
+
+void AdaptiveConcurrencyFilter::setEncoderFilterCallbacks(StreamEncoderFilterCallbacks&) {}
+
+} // Http
+} // Envoy
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "envoy/common/optional.h"
+#include "envoy/common/time.h"
+#include "envoy/http/filter.h"
+#include "envoy/json/json_object.h"
+#include "envoy/stats/stats.h"
+#include "envoy/stats/stats_macros.h"
+
+#include "common/json/json_validator.h"
+
+namespace Envoy {
+namespace Http {
+
+/**
+ * All stats for the adaptive concurrency filter. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_ADAPTIVE_CONCURRENCY_FILTER_STATS(COUNTER)                                             \
+  COUNTER(rq_blocked)
+// clang-format on
+
+/**
+ * Wrapper struct for adaptive concurrency filter stats. @see stats_macros.h
+ */
+struct AdaptiveConcurrencyFilterStats {
+  ALL_ADAPTIVE_CONCURRENCY_FILTER_STATS(GENERATE_COUNTER_STRUCT)
+};
+
+class AdaptiveConcurrencyFilterConfig;
+
+/**
+ * Concurrency limit for a single upstream cluster, shared by all workers. The limit follows a
+ * gradient of the observed round trip time: every sample window the average RTT of the window is
+ * compared with the minimum RTT seen recently. When requests start queueing upstream the average
+ * rises above the minimum and the limit shrinks in proportion. Otherwise the limit grows by its
+ * square root so that it can find new capacity.
+ *
+ * Acquiring and releasing only touch atomics. The limit is recalculated by whichever worker first
+ * releases a request after the window has ended, and the other workers do not wait for it.
+ */
+class ConcurrencyLimiter {
+public:
+  ConcurrencyLimiter(const AdaptiveConcurrencyFilterConfig& config, Stats::Gauge& limit_gauge,
+                     Stats::Gauge& min_rtt_gauge);
+
+  /**
+   * @return true if the request may be sent upstream. In that case release() must be called once
+   *         the request is done.
+   */
+  bool tryAcquire();
+
+  /**
+   * Release a request admitted by tryAcquire().
+   * @param rtt supplies the request's upstream round trip time if one was measured.
+   */
+  void release(const Optional<std::chrono::milliseconds>& rtt);
+
+  /**
+   * @return the current concurrency limit.
+   */
+  uint32_t limit() const { return limit_; }
+
+private:
+  void updateLimit(MonotonicTime now);
+
+  const AdaptiveConcurrencyFilterConfig& config_;
+  Stats::Gauge& limit_gauge_;
+  Stats::Gauge& min_rtt_gauge_;
+  std::atomic<uint32_t> limit_;
+  std::atomic<uint32_t> in_flight_{};
+  std::atomic<uint64_t> sample_count_{};
+  std::atomic<uint64_t> sample_sum_ms_{};
+  std::atomic<int64_t> next_update_ns_;
+  std::mutex update_lock_;
+  double min_rtt_ms_{};
+  MonotonicTime min_rtt_reset_time_;
+};
+
+/**
+ * Configuration for the adaptive concurrency filter. This owns the limiter of every cluster that
+ * the filter has seen.
+ */
+class AdaptiveConcurrencyFilterConfig : Json::Validator {
+public:
+  AdaptiveConcurrencyFilterConfig(const Json::Object& json_config, const std::string& stats_prefix,
+                                  Stats::Store& stats, MonotonicTimeSource& time_source);
+
+  /**
+   * @return the limiter for a cluster, creating it on first use. This is thread safe.
+   */
+  ConcurrencyLimiter& limiter(const std::string& cluster_name);
+
+  uint32_t initialLimit() const { return initial_limit_; }
+  uint32_t minLimit() const { return min_limit_; }
+  uint32_t maxLimit() const { return max_limit_; }
+  std::chrono::milliseconds sampleWindow() const { return sample_window_; }
+  std::chrono::milliseconds minRttWindow() const { return min_rtt_window_; }
+  MonotonicTimeSource& timeSource() const { return time_source_; }
+  AdaptiveConcurrencyFilterStats& stats() { return stats_; }
+
+private:
+  static AdaptiveConcurrencyFilterStats generateStats(const std::string& prefix,
+                                                      Stats::Store& store);
+
+  const uint32_t initial_limit_;
+  const uint32_t min_limit_;
+  const uint32_t max_limit_;
+  const std::chrono::milliseconds sample_window_;
+  const std::chrono::milliseconds min_rtt_window_;
+  Stats::Store& store_;
+  MonotonicTimeSource& time_source_;
+  AdaptiveConcurrencyFilterStats stats_;
+  std::mutex lock_;
+  std::unordered_map<std::string, std::unique_ptr<ConcurrencyLimiter>> limiters_;
+};
+
+typedef std::shared_ptr<AdaptiveConcurrencyFilterConfig> AdaptiveConcurrencyFilterConfigSharedPtr;
+
+/**
+ * A filter that limits the number of requests in flight to each upstream cluster to a limit derived
+ * from the upstream RTT. Requests above the limit are failed immediately with a 503 rather than
+ * being allowed to queue upstream. The RTT of each request is taken from the
+ * x-envoy-upstream-service-time header that the router adds to responses, so the filter must be
+ * configured ahead of the router.
+ */
+class AdaptiveConcurrencyFilter : public StreamFilter {
+public:
+  AdaptiveConcurrencyFilter(AdaptiveConcurrencyFilterConfigSharedPtr config);
+  ~AdaptiveConcurrencyFilter();
+
+  // Http::StreamFilterBase
+  void onDestroy() override;
+
+  // Http::StreamDecoderFilter
+  FilterHeadersStatus decodeHeaders(HeaderMap& headers, bool end_stream) override;
+  FilterDataStatus decodeData(Buffer::Instance& data, bool end_stream) override;
+  FilterTrailersStatus decodeTrailers(HeaderMap& trailers) override;
+  void setDecoderFilterCallbacks(StreamDecoderFilterCallbacks& callbacks) override;
+
+  // Http::StreamEncoderFilter
+  FilterHeadersStatus encodeHeaders(HeaderMap& headers, bool end_stream) override;
+  FilterDataStatus encodeData(Buffer::Instance& data, bool end_stream) override;
+  FilterTrailersStatus encodeTrailers(HeaderMap& trailers) override;
+  void setEncoderFilterCallbacks(StreamEncoderFilterCallbacks& callbacks) override;
+
+private:
+  AdaptiveConcurrencyFilterConfigSharedPtr config_;
+  StreamDecoderFilterCallbacks* decoder_callbacks_{};
+  // Set while this request holds one of the limiter's slots.
+  ConcurrencyLimiter* limiter_{};
+};
+
+} // Http
+} // Envoy
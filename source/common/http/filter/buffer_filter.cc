@@ -33,6 +33,13 @@ FilterHeadersStatus BufferFilter::decodeHeaders(HeaderMap&, bool end_stream) {
 }
 
 FilterDataStatus BufferFilter::decodeData(Buffer::Instance&, bool end_stream) {
+  if (!end_stream && !config_->spill_directory_.empty() && !callbacks_->decodingBuffer()) {
+    // The data is buffered once we return, so the spill buffer must be in place before then.
+    spill_buffer_ = new Buffer::SpillBufferImpl(config_->spill_directory_,
+                                                config_->spill_memory_limit_bytes_);
+    callbacks_->setDecodingBuffer(Buffer::InstancePtr{spill_buffer_});
+  }
+
   if (end_stream) {
     resetInternalState();
     return FilterDataStatus::Continue;
@@ -57,7 +64,19 @@ BufferFilterStats BufferFilter::generateStats(const std::string& prefix, Stats::
   return {ALL_BUFFER_FILTER_STATS(POOL_COUNTER_PREFIX(store, final_prefix))};
 }
 
-void BufferFilter::onDestroy() { resetInternalState(); }
+void BufferFilter::onDestroy() {
+  resetInternalState();
+
+  if (spill_buffer_) {
+    if (spill_buffer_->bytesSpilled() > 0) {
+      config_->stats_.rq_spilled_.inc();
+    }
+    if (spill_buffer_->spillFailed()) {
+      config_->stats_.rq_spill_failed_.inc();
+    }
+    spill_buffer_ = nullptr;
+  }
+}
 
 void BufferFilter::onRequestTimeout() {
   Http::HeaderMapPtr response_headers{new HeaderMapImpl{
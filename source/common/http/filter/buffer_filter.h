@@ -9,6 +9,7 @@
 #include "envoy/stats/stats_macros.h"
 
 #include "common/buffer/buffer_impl.h"
+#include "common/buffer/spill_buffer_impl.h"
 
 namespace Envoy {
 namespace Http {
@@ -19,7 +20,9 @@ namespace Http {
 // clang-format off
 #define ALL_BUFFER_FILTER_STATS(COUNTER)                                                           \
   COUNTER(rq_timeout)                                                                              \
-  COUNTER(rq_too_large)
+  COUNTER(rq_too_large)                                                                            \
+  COUNTER(rq_spilled)                                                                              \
+  COUNTER(rq_spill_failed)
 // clang-format on
 
 /**
@@ -36,6 +39,10 @@ struct BufferFilterConfig {
   BufferFilterStats stats_;
   uint64_t max_request_bytes_;
   std::chrono::seconds max_request_time_;
+  // Request bodies are spilled to temporary files in this directory past the first
+  // spill_memory_limit_bytes_ bytes. Spilling is disabled if the directory is empty.
+  std::string spill_directory_;
+  uint64_t spill_memory_limit_bytes_;
 };
 
 typedef std::shared_ptr<const BufferFilterConfig> BufferFilterConfigConstSharedPtr;
@@ -66,6 +73,8 @@ private:
   BufferFilterConfigConstSharedPtr config_;
   StreamDecoderFilterCallbacks* callbacks_{};
   Event::TimerPtr request_timeout_;
+  // Owned by the connection manager, which keeps it for the lifetime of the stream.
+  Buffer::SpillBufferImpl* spill_buffer_{};
 };
 
 } // Http
@@ -0,0 +1,432 @@
+#include "common/http/filter/cache_filter.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/common/assert.h"
+#include "common/common/utility.h"
+#include "common/http/headers.h"
+#include "common/http/utility.h"
+#include "common/json/config_schemas.h"
+
+namespace Envoy {
+namespace Http {
+
+namespace {
+
+/**
+ * The Cache-Control directives that the filter understands.
+ */
+struct CacheControl {
+  CacheControl(const HeaderEntry* header) {
+    if (!header) {
+      return;
+    }
+
+    for (const std::string& directive : StringUtil::split(header->value().c_str(), ',')) {
+      const size_t equals = directive.find('=');
+      const std::string name = StringUtil::trim(directive.substr(0, equals));
+      const std::string value =
+          equals == std::string::npos ? "" : StringUtil::trim(directive.substr(equals + 1));
+      if (StringUtil::caseInsensitiveCompare(name.c_str(), "no-store") == 0) {
+        no_store_ = true;
+      } else if (StringUtil::caseInsensitiveCompare(name.c_str(), "no-cache") == 0) {
+        no_cache_ = true;
+      } else if (StringUtil::caseInsensitiveCompare(name.c_str(), "private") == 0) {
+        private_ = true;
+      } else if (StringUtil::caseInsensitiveCompare(name.c_str(), "max-age") == 0) {
+        uint64_t seconds;
+        if (StringUtil::atoul(value.c_str(), seconds) && !shared_max_age_valid_) {
+          max_age_ = std::chrono::seconds(seconds);
+        }
+      } else if (StringUtil::caseInsensitiveCompare(name.c_str(), "s-maxage") == 0) {
+        // A shared cache uses s-maxage in preference to max-age.
+        uint64_t seconds;
+        if (StringUtil::atoul(value.c_str(), seconds)) {
+          max_age_ = std::chrono::seconds(seconds);
+          shared_max_age_valid_ = true;
+        }
+      }
+    }
+  }
+
+  bool no_store_{};
+  bool no_cache_{};
+  bool private_{};
+  std::chrono::seconds max_age_{};
+  bool shared_max_age_valid_{};
+};
+
+/**
+ * Replays a cached body without copying it. The fragment keeps the cached response alive until the
+ * buffer is done with it.
+ */
+class CachedBodyFragment : public Buffer::BufferFragment {
+public:
+  CachedBodyFragment(CachedResponseConstSharedPtr response) : response_(response) {}
+
+  // Buffer::BufferFragment
+  const void* data() const override { return response_->body_.data(); }
+  size_t size() const override { return response_->body_.size(); }
+  void done() override { delete this; }
+
+private:
+  const CachedResponseConstSharedPtr response_;
+};
+
+void addCachedBody(Buffer::Instance& buffer, CachedResponseConstSharedPtr response) {
+  buffer.addBufferFragment(*new CachedBodyFragment(response));
+}
+
+} // namespace
+
+CacheFilterConfig::CacheFilterConfig(const Json::Object& json_config,
+                                     const std::string& stats_prefix, Stats::Store& stats,
+                                     ThreadLocal::Instance& tls, MonotonicTimeSource& time_source)
+    : Json::Validator(json_config, Json::Schema::CACHE_HTTP_FILTER_SCHEMA),
+      max_size_bytes_(json_config.getInteger("max_size_bytes", 16 * 1024 * 1024)),
+      max_entry_bytes_(json_config.getInteger("max_entry_bytes", 1024 * 1024)), tls_(tls),
+      tls_slot_(tls.allocateSlot()), time_source_(time_source),
+      stats_(generateStats(stats_prefix + "cache.", stats)) {
+  tls.set(tls_slot_, [](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+    return std::make_shared<ThreadLocalCache>();
+  });
+}
+
+CacheFilterStats CacheFilterConfig::generateStats(const std::string& prefix,
+                                                  Stats::Store& store) {
+  return {ALL_CACHE_FILTER_STATS(POOL_COUNTER_PREFIX(store, prefix))};
+}
+
+CacheFilterConfig::LookupResult CacheFilterConfig::lookup(const std::string& key,
+                                                          const HeaderMap& request_headers) {
+  LookupResult result;
+  ThreadLocalCache& cache = tls_.getTyped<ThreadLocalCache>(tls_slot_);
+  auto it = cache.entries_.find(key);
+  if (it == cache.entries_.end()) {
+    return result;
+  }
+
+  Entry& entry = it->second;
+  for (const auto& vary : entry.response_->vary_) {
+    const HeaderEntry* header = request_headers.get(vary.first);
+    if (vary.second != (header ? header->value().c_str() : "")) {
+      return result;
+    }
+  }
+
+  cache.lru_.splice(cache.lru_.begin(), cache.lru_, entry.lru_position_);
+  result.response_ = entry.response_;
+  result.max_age_ = entry.max_age_;
+  result.age_ = entry.initial_age_ + std::chrono::duration_cast<std::chrono::seconds>(
+                                         time_source_.currentTime() - entry.response_time_);
+  result.fresh_ = result.age_ < entry.max_age_;
+  return result;
+}
+
+void CacheFilterConfig::insert(const std::string& key, CachedResponseConstSharedPtr response,
+                               std::chrono::seconds max_age, std::chrono::seconds initial_age) {
+  const uint64_t size = key.size() + response->headers_->byteSize() + response->body_.size();
+  ThreadLocalCache& cache = tls_.getTyped<ThreadLocalCache>(tls_slot_);
+  cache.erase(key);
+  if (size > max_entry_bytes_) {
+    return;
+  }
+
+  while (cache.size_ + size > max_size_bytes_ && !cache.lru_.empty()) {
+    cache.erase(*cache.lru_.back());
+    stats_.evicted_.inc();
+  }
+
+  auto it = cache.entries_.emplace(key, Entry()).first;
+  Entry& entry = it->second;
+  entry.response_ = response;
+  entry.response_time_ = time_source_.currentTime();
+  entry.max_age_ = max_age;
+  entry.initial_age_ = initial_age;
+  entry.size_ = size;
+  cache.lru_.push_front(&it->first);
+  entry.lru_position_ = cache.lru_.begin();
+  cache.size_ += size;
+  stats_.insert_.inc();
+}
+
+bool CacheFilterConfig::startFill(const std::string& key) {
+  return tls_.getTyped<ThreadLocalCache>(tls_slot_).fills_.emplace(key, std::list<CacheFilter*>())
+      .second;
+}
+
+void CacheFilterConfig::addWaiter(const std::string& key, CacheFilter& waiter) {
+  ThreadLocalCache& cache = tls_.getTyped<ThreadLocalCache>(tls_slot_);
+  ASSERT(cache.fills_.count(key) == 1);
+  cache.fills_[key].push_back(&waiter);
+}
+
+void CacheFilterConfig::removeWaiter(const std::string& key, CacheFilter& waiter) {
+  ThreadLocalCache& cache = tls_.getTyped<ThreadLocalCache>(tls_slot_);
+  auto it = cache.fills_.find(key);
+  if (it != cache.fills_.end()) {
+    it->second.remove(&waiter);
+  }
+}
+
+void CacheFilterConfig::fillComplete(const std::string& key) {
+  // Waking a request sends its response, which may reset and destroy other waiting requests. They
+  // remove themselves from the list, so it is only taken apart one request at a time.
+  ThreadLocalCache& cache = tls_.getTyped<ThreadLocalCache>(tls_slot_);
+  while (true) {
+    auto it = cache.fills_.find(key);
+    ASSERT(it != cache.fills_.end());
+    if (it->second.empty()) {
+      cache.fills_.erase(it);
+      return;
+    }
+
+    CacheFilter* waiter = it->second.front();
+    it->second.pop_front();
+    waiter->onFillComplete();
+  }
+}
+
+void CacheFilterConfig::ThreadLocalCache::erase(const std::string& key) {
+  auto it = entries_.find(key);
+  if (it != entries_.end()) {
+    size_ -= it->second.size_;
+    lru_.erase(it->second.lru_position_);
+    entries_.erase(it);
+  }
+}
+
+CacheFilter::CacheFilter(CacheFilterConfigSharedPtr config) : config_(config) {}
+
+CacheFilter::~CacheFilter() { ASSERT(state_ == State::Bypass); }
+
+void CacheFilter::onDestroy() {
+  if (state_ == State::Waiting) {
+    config_->removeWaiter(key_, *this);
+    state_ = State::Bypass;
+  } else if (state_ == State::Filling) {
+    // The requests waiting for this one go upstream themselves.
+    endFill();
+  }
+}
+
+bool CacheFilter::requestCacheable(const HeaderMap& headers) {
+  // Conditional requests are passed through so that their validators reach the upstream.
+  if (!headers.Method() || headers.Method()->value() != Headers::get().MethodValues.Get.c_str() ||
+      !headers.Host() || !headers.Path() || headers.Authorization() ||
+      headers.get(Headers::get().IfNoneMatch) || headers.get(Headers::get().IfModifiedSince)) {
+    return false;
+  }
+
+  CacheControl cache_control(headers.get(Headers::get().CacheControl));
+  return !cache_control.no_store_ && !cache_control.no_cache_;
+}
+
+FilterHeadersStatus CacheFilter::decodeHeaders(HeaderMap& headers, bool end_stream) {
+  if (!end_stream || !requestCacheable(headers)) {
+    return FilterHeadersStatus::Continue;
+  }
+
+  request_headers_ = &headers;
+  key_ = std::string(headers.Host()->value().c_str()) + headers.Path()->value().c_str();
+  CacheFilterConfig::LookupResult result = config_->lookup(key_, headers);
+  if (result.response_ && result.fresh_) {
+    config_->stats().rq_hit_.inc();
+    sendCachedResponse(result.response_, result.age_);
+    return FilterHeadersStatus::StopIteration;
+  }
+
+  if (!config_->startFill(key_)) {
+    config_->stats().rq_coalesced_.inc();
+    state_ = State::Waiting;
+    config_->addWaiter(key_, *this);
+    return FilterHeadersStatus::StopIteration;
+  }
+
+  config_->stats().rq_miss_.inc();
+  state_ = State::Filling;
+  const HeaderEntry* etag =
+      result.response_ ? result.response_->headers_->get(Headers::get().Etag) : nullptr;
+  if (etag) {
+    stale_response_ = result.response_;
+    stale_max_age_ = result.max_age_;
+    headers.addStaticKey(Headers::get().IfNoneMatch, etag->value().c_str());
+  }
+
+  return FilterHeadersStatus::Continue;
+}
+
+FilterDataStatus CacheFilter::decodeData(Buffer::Instance&, bool) {
+  return FilterDataStatus::Continue;
+}
+
+FilterTrailersStatus CacheFilter::decodeTrailers(HeaderMap&) {
+  return FilterTrailersStatus::Continue;
+}
+
+void CacheFilter::setDecoderFilterCallbacks(StreamDecoderFilterCallbacks& callbacks) {
+  decoder_callbacks_ = &callbacks;
+}
+
+void CacheFilter::onFillComplete() {
+  ASSERT(state_ == State::Waiting);
+  state_ = State::Bypass;
+  CacheFilterConfig::LookupResult result = config_->lookup(key_, *request_headers_);
+  if (result.response_ && result.fresh_) {
+    config_->stats().rq_hit_.inc();
+    sendCachedResponse(result.response_, result.age_);
+  } else {
+    // The response was not cacheable, or varies in a way that does not match this request.
+    decoder_callbacks_->continueDecoding();
+  }
+}
+
+void CacheFilter::sendCachedResponse(CachedResponseConstSharedPtr response,
+                                     std::chrono::seconds age) {
+  HeaderMapPtr headers(new HeaderMapImpl(*response->headers_));
+  headers->addStaticKey(Headers::get().Age, age.count());
+  if (response->body_.empty()) {
+    decoder_callbacks_->encodeHeaders(std::move(headers), true);
+    return;
+  }
+
+  decoder_callbacks_->encodeHeaders(std::move(headers), false);
+  Buffer::OwnedImpl body;
+  addCachedBody(body, response);
+  decoder_callbacks_->encodeData(body, true);
+}
+
+FilterHeadersStatus CacheFilter::encodeHeaders(HeaderMap& headers, bool end_stream) {
+  if (state_ != State::Filling) {
+    return FilterHeadersStatus::Continue;
+  }
+
+  const uint64_t status = Utility::getResponseStatus(headers);
+  if (stale_response_ && status == 304 && end_stream) {
+    onRevalidated(headers);
+    return FilterHeadersStatus::Continue;
+  }
+
+  CacheControl cache_control(headers.get(Headers::get().CacheControl));
+  if (status != 200 || cache_control.no_store_ || cache_control.no_cache_ ||
+      cache_control.private_ || cache_control.max_age_.count() == 0) {
+    endFill();
+    return FilterHeadersStatus::Continue;
+  }
+
+  response_.reset(new CachedResponse(headers));
+  max_age_ = cache_control.max_age_;
+  const HeaderEntry* vary = headers.get(Headers::get().Vary);
+  if (vary) {
+    for (const std::string& name : StringUtil::split(vary->value().c_str(), ',')) {
+      LowerCaseString header_name(StringUtil::trim(name));
+      if (header_name.get() == "*") {
+        endFill();
+        return FilterHeadersStatus::Continue;
+      }
+
+      const HeaderEntry* request_header = request_headers_->get(header_name);
+      response_->vary_.emplace_back(header_name,
+                                    request_header ? request_header->value().c_str() : "");
+    }
+  }
+
+  const HeaderEntry* age = headers.get(Headers::get().Age);
+  uint64_t initial_age;
+  if (age && StringUtil::atoul(age->value().c_str(), initial_age)) {
+    initial_age_ = std::chrono::seconds(initial_age);
+    response_->headers_->remove(Headers::get().Age);
+  }
+
+  if (end_stream) {
+    insertResponse();
+  }
+  return FilterHeadersStatus::Continue;
+}
+
+void CacheFilter::onRevalidated(HeaderMap& headers) {
+  // The stored response is still valid. It is cached again with the freshness lifetime of the 304
+  // if it has one, and sent in place of the 304, which the client did not ask for.
+  config_->stats().rq_revalidated_.inc();
+  CacheControl cache_control(headers.get(Headers::get().CacheControl));
+  CachedResponseConstSharedPtr response = stale_response_;
+  config_->insert(key_, response,
+                  cache_control.max_age_.count() > 0 ? cache_control.max_age_ : stale_max_age_,
+                  std::chrono::seconds(0));
+
+  std::vector<std::string> keys;
+  headers.iterate([](const HeaderEntry& header, void* context) -> void {
+    static_cast<std::vector<std::string>*>(context)->emplace_back(header.key().c_str());
+  }, &keys);
+  for (const std::string& key : keys) {
+    headers.remove(LowerCaseString(key));
+  }
+  response->headers_->iterate([](const HeaderEntry& header, void* context) -> void {
+    static_cast<HeaderMap*>(context)->addCopy(LowerCaseString(header.key().c_str()),
+                                               header.value().c_str());
+  }, &headers);
+  headers.addStaticKey(Headers::get().Age, 0);
+
+  if (!response->body_.empty()) {
+    Buffer::OwnedImpl body;
+    addCachedBody(body, response);
+    encoder_callbacks_->addEncodedData(body);
+  }
+
+  endFill();
+}
+
+FilterDataStatus CacheFilter::encodeData(Buffer::Instance& data, bool end_stream) {
+  if (!response_) {
+    return FilterDataStatus::Continue;
+  }
+
+  if (response_->body_.size() + data.length() > config_->maxEntryBytes()) {
+    endFill();
+    return FilterDataStatus::Continue;
+  }
+
+  uint64_t num_slices = data.getRawSlices(nullptr, 0);
+  Buffer::RawSlice slices[num_slices];
+  data.getRawSlices(slices, num_slices);
+  for (const Buffer::RawSlice& slice : slices) {
+    response_->body_.append(static_cast<const char*>(slice.mem_), slice.len_);
+  }
+
+  if (end_stream) {
+    insertResponse();
+  }
+  return FilterDataStatus::Continue;
+}
+
+FilterTrailersStatus CacheFilter::encodeTrailers(HeaderMap&) {
+  // Responses with trailers are not cached.
+  if (response_) {
+    endFill();
+  }
+  return FilterTrailersStatus::Continue;
+}
+
+void CacheFilter::setEncoderFilterCallbacks(StreamEncoderFilterCallbacks& callbacks) {
+  encoder_callbacks_ = &callbacks;
+}
+
+void CacheFilter::insertResponse() {
+  config_->insert(key_, response_, max_age_, initial_age_);
+  endFill();
+}
+
+void CacheFilter::endFill() {
+  ASSERT(state_ == State::Filling);
+  state_ = State::Bypass;
+  response_.reset();
+  stale_response_.reset();
+  config_->fillComplete(key_);
+}
+
+} // Http
+} // Envoy
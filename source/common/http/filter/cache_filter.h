@@ -0,0 +1,213 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "envoy/common/time.h"
+#include "envoy/http/filter.h"
+#include "envoy/json/json_object.h"
+#include "envoy/stats/stats_macros.h"
+#include "envoy/thread_local/thread_local.h"
+
+#include "common/http/header_map_impl.h"
+#include "common/json/json_validator.h"
+
+namespace Envoy {
+namespace Http {
+
+/**
+ * All stats for the cache filter. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_CACHE_FILTER_STATS(COUNTER)                                                            \
+  COUNTER(rq_hit)                                                                                  \
+  COUNTER(rq_miss)                                                                                 \
+  COUNTER(rq_coalesced)                                                                            \
+  COUNTER(rq_revalidated)                                                                          \
+  COUNTER(insert)                                                                                  \
+  COUNTER(evicted)
+// clang-format on
+
+/**
+ * Wrapper struct for cache filter stats. @see stats_macros.h
+ */
+struct CacheFilterStats {
+  ALL_CACHE_FILTER_STATS(GENERATE_COUNTER_STRUCT)
+};
+
+/**
+ * A cached response. It is immutable once cached and is shared by the cache and by every response
+ * that is replayed from it, so that an entry that is evicted or replaced while it is being sent
+ * stays alive until it has been sent.
+ */
+struct CachedResponse {
+  CachedResponse(const HeaderMap& headers) : headers_(new HeaderMapImpl(headers)) {}
+
+  HeaderMapPtr headers_;
+  std::string body_;
+  // The values of the request headers named by the response's Vary header, in the request that
+  // the response was cached for. An empty value stands for a header that was not present.
+  std::vector<std::pair<LowerCaseString, std::string>> vary_;
+};
+
+typedef std::shared_ptr<const CachedResponse> CachedResponseConstSharedPtr;
+
+class CacheFilter;
+
+/**
+ * Configuration for the cache filter. This owns a bounded LRU cache per worker.
+ */
+class CacheFilterConfig : Json::Validator {
+public:
+  CacheFilterConfig(const Json::Object& json_config, const std::string& stats_prefix,
+                    Stats::Store& stats, ThreadLocal::Instance& tls,
+                    MonotonicTimeSource& time_source);
+
+  /**
+   * The result of a lookup. A stale response is returned so that it can be revalidated.
+   */
+  struct LookupResult {
+    CachedResponseConstSharedPtr response_;
+    bool fresh_{};
+    std::chrono::seconds age_{};
+    std::chrono::seconds max_age_{};
+  };
+
+  /**
+   * Look up this worker's cached response for a request.
+   * @param key supplies the cache key of the request.
+   * @param request_headers supplies the request headers, which must match the cached response's
+   *        Vary headers.
+   */
+  LookupResult lookup(const std::string& key, const HeaderMap& request_headers);
+
+  /**
+   * Cache a response on this worker, replacing any response cached for the key.
+   * @param key supplies the cache key of the request.
+   * @param response supplies the response.
+   * @param max_age supplies the response's freshness lifetime.
+   * @param initial_age supplies the response's age when it was received.
+   */
+  void insert(const std::string& key, CachedResponseConstSharedPtr response,
+              std::chrono::seconds max_age, std::chrono::seconds initial_age);
+
+  /**
+   * Start filling the key on this worker. Requests for the key that arrive until fillComplete()
+   * is called wait for the response rather than going upstream.
+   * @return false if the key is already being filled.
+   */
+  bool startFill(const std::string& key);
+
+  /**
+   * Wait for the response of the request that is filling the key.
+   */
+  void addWaiter(const std::string& key, CacheFilter& waiter);
+  void removeWaiter(const std::string& key, CacheFilter& waiter);
+
+  /**
+   * End filling the key, whether or not a response was cached, and wake up the waiting requests.
+   */
+  void fillComplete(const std::string& key);
+
+  uint64_t maxEntryBytes() const { return max_entry_bytes_; }
+  CacheFilterStats& stats() { return stats_; }
+
+private:
+  struct Entry {
+    CachedResponseConstSharedPtr response_;
+    MonotonicTime response_time_;
+    std::chrono::seconds max_age_;
+    std::chrono::seconds initial_age_;
+    uint64_t size_;
+    std::list<const std::string*>::iterator lru_position_;
+  };
+
+  struct ThreadLocalCache : public ThreadLocal::ThreadLocalObject {
+    void erase(const std::string& key);
+
+    // ThreadLocal::ThreadLocalObject
+    void shutdown() override {}
+
+    std::unordered_map<std::string, Entry> entries_;
+    // Keys of entries_, most recently used first.
+    std::list<const std::string*> lru_;
+    uint64_t size_{};
+    // Keys that are being filled, and the requests that wait for them.
+    std::unordered_map<std::string, std::list<CacheFilter*>> fills_;
+  };
+
+  static CacheFilterStats generateStats(const std::string& prefix, Stats::Store& store);
+
+  const uint64_t max_size_bytes_;
+  const uint64_t max_entry_bytes_;
+  ThreadLocal::Instance& tls_;
+  const uint32_t tls_slot_;
+  MonotonicTimeSource& time_source_;
+  CacheFilterStats stats_;
+};
+
+typedef std::shared_ptr<CacheFilterConfig> CacheFilterConfigSharedPtr;
+
+/**
+ * A filter that caches responses to GET requests in a per worker LRU cache, following the
+ * Cache-Control and Vary headers of the responses. Cached bodies are replayed without being
+ * copied. Concurrent misses for the same key on a worker are coalesced into a single upstream
+ * request, and stale responses that have an ETag are revalidated with If-None-Match.
+ */
+class CacheFilter : public StreamFilter {
+public:
+  CacheFilter(CacheFilterConfigSharedPtr config);
+  ~CacheFilter();
+
+  /**
+   * Called on a waiting request once the request that was filling its key is done.
+   */
+  void onFillComplete();
+
+  // Http::StreamFilterBase
+  void onDestroy() override;
+
+  // Http::StreamDecoderFilter
+  FilterHeadersStatus decodeHeaders(HeaderMap& headers, bool end_stream) override;
+  FilterDataStatus decodeData(Buffer::Instance& data, bool end_stream) override;
+  FilterTrailersStatus decodeTrailers(HeaderMap& trailers) override;
+  void setDecoderFilterCallbacks(StreamDecoderFilterCallbacks& callbacks) override;
+
+  // Http::StreamEncoderFilter
+  FilterHeadersStatus encodeHeaders(HeaderMap& headers, bool end_stream) override;
+  FilterDataStatus encodeData(Buffer::Instance& data, bool end_stream) override;
+  FilterTrailersStatus encodeTrailers(HeaderMap& trailers) override;
+  void setEncoderFilterCallbacks(StreamEncoderFilterCallbacks& callbacks) override;
+
+private:
+  enum class State { Bypass, Waiting, Filling };
+
+  bool requestCacheable(const HeaderMap& headers);
+  void sendCachedResponse(CachedResponseConstSharedPtr response, std::chrono::seconds age);
+  void onRevalidated(HeaderMap& headers);
+  void insertResponse();
+  void endFill();
+
+  CacheFilterConfigSharedPtr config_;
+  StreamDecoderFilterCallbacks* decoder_callbacks_{};
+  StreamEncoderFilterCallbacks* encoder_callbacks_{};
+  State state_{State::Bypass};
+  std::string key_;
+  HeaderMap* request_headers_{};
+  // The stale response that is being revalidated, if any.
+  CachedResponseConstSharedPtr stale_response_;
+  std::chrono::seconds stale_max_age_{};
+  // The response being cached while its body arrives.
+  std::shared_ptr<CachedResponse> response_;
+  std::chrono::seconds max_age_{};
+  std::chrono::seconds initial_age_{};
+};
+
+} // Http
+} // Envoy
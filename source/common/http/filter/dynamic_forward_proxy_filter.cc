@@ -0,0 +1,92 @@
+#include "common/http/filter/dynamic_forward_proxy_filter.h"
+
+#include <cstdint>
+#include <list>
+#include <string>
+
+#include "envoy/upstream/load_balancer_type.h"
+
+#include "common/common/assert.h"
+#include "common/upstream/dynamic_forward_proxy_cluster.h"
+
+namespace Envoy {
+namespace Http {
+
+DynamicForwardProxyFilterConfig::DynamicForwardProxyFilterConfig(
+    const Json::Object& json_config, const std::string& stat_prefix, Stats::Scope& scope,
+    Upstream::ClusterManager& cm, Network::DnsResolverSharedPtr dns_resolver)
+    : Json::Validator(json_config, Json::Schema::DYNAMIC_FORWARD_PROXY_HTTP_FILTER_SCHEMA),
+      cm_(cm), dns_resolver_(dns_resolver),
+      stats_{ALL_DYNAMIC_FORWARD_PROXY_FILTER_STATS(
+          POOL_COUNTER_PREFIX(scope, stat_prefix + "dynamic_forward_proxy."))} {}
+
+FilterHeadersStatus DynamicForwardProxyFilter::decodeHeaders(HeaderMap& headers, bool) {
+  Router::RouteConstSharedPtr route = callbacks_->route();
+  if (!route || !route->routeEntry() || !headers.Host()) {
+    return FilterHeadersStatus::Continue;
+  }
+
+  Upstream::ThreadLocalCluster* cluster = config_->cm().get(route->routeEntry()->clusterName());
+  if (!cluster || cluster->info()->lbType() != Upstream::LoadBalancerType::DynamicForwardProxy) {
+    return FilterHeadersStatus::Continue;
+  }
+
+  std::string dns_name;
+  uint32_t port;
+  if (!Upstream::DynamicForwardProxyCluster::parseAuthority(headers.Host()->value().c_str(),
+                                                            *cluster->info(), dns_name, port)) {
+    return FilterHeadersStatus::Continue;
+  }
+
+  config_->stats().dns_query_.inc();
+  state_ = State::Resolving;
+  initiating_call_ = true;
+  active_query_ = config_->dnsResolver().resolve(
+      dns_name, cluster->info()->dnsLookupFamily(),
+      [this](std::list<Network::Address::InstanceConstSharedPtr>&& address_list) -> void {
+        onResolved(std::move(address_list));
+      });
+  initiating_call_ = false;
+
+  return state_ == State::Resolving ? FilterHeadersStatus::StopIteration
+                                    : FilterHeadersStatus::Continue;
+}
+
+FilterDataStatus DynamicForwardProxyFilter::decodeData(Buffer::Instance&, bool) {
+  return state_ == State::Resolving ? FilterDataStatus::StopIterationAndBuffer
+                                    : FilterDataStatus::Continue;
+}
+
+FilterTrailersStatus DynamicForwardProxyFilter::decodeTrailers(HeaderMap&) {
+  return state_ == State::Resolving ? FilterTrailersStatus::StopIteration
+                                    : FilterTrailersStatus::Continue;
+}
+
+void DynamicForwardProxyFilter::setDecoderFilterCallbacks(StreamDecoderFilterCallbacks& callbacks) {
+  callbacks_ = &callbacks;
+}
+
+void DynamicForwardProxyFilter::onDestroy() {
+  if (state_ == State::Resolving) {
+    state_ = State::Complete;
+    ASSERT(active_query_);
+    active_query_->cancel();
+    active_query_ = nullptr;
+  }
+}
+
+void DynamicForwardProxyFilter::onResolved(
+    std::list<Network::Address::InstanceConstSharedPtr>&& address_list) {
+  state_ = State::Complete;
+  active_query_ = nullptr;
+  if (address_list.empty()) {
+    config_->stats().dns_query_failure_.inc();
+  }
+
+  if (!initiating_call_) {
+    callbacks_->continueDecoding();
+  }
+}
+
+} // Http
+} // Envoy
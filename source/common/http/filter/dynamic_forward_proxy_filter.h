@@ -0,0 +1,88 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <string>
+
+#include "envoy/http/filter.h"
+#include "envoy/json/json_object.h"
+#include "envoy/network/dns.h"
+#include "envoy/stats/stats_macros.h"
+#include "envoy/upstream/cluster_manager.h"
+
+#include "common/json/config_schemas.h"
+#include "common/json/json_validator.h"
+
+namespace Envoy {
+namespace Http {
+
+/**
+ * All stats for the dynamic forward proxy filter. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_DYNAMIC_FORWARD_PROXY_FILTER_STATS(COUNTER)                                            \
+  COUNTER(dns_query)                                                                               \
+  COUNTER(dns_query_failure)
+// clang-format on
+
+/**
+ * Wrapper struct for dynamic forward proxy filter stats. @see stats_macros.h
+ */
+struct DynamicForwardProxyFilterStats {
+  ALL_DYNAMIC_FORWARD_PROXY_FILTER_STATS(GENERATE_COUNTER_STRUCT)
+};
+
+/**
+ * Configuration for the dynamic forward proxy filter.
+ */
+class DynamicForwardProxyFilterConfig : Json::Validator {
+public:
+  DynamicForwardProxyFilterConfig(const Json::Object& json_config, const std::string& stat_prefix,
+                                  Stats::Scope& scope, Upstream::ClusterManager& cm,
+                                  Network::DnsResolverSharedPtr dns_resolver);
+
+  Upstream::ClusterManager& cm() { return cm_; }
+  Network::DnsResolver& dnsResolver() { return *dns_resolver_; }
+  DynamicForwardProxyFilterStats& stats() { return stats_; }
+
+private:
+  Upstream::ClusterManager& cm_;
+  Network::DnsResolverSharedPtr dns_resolver_;
+  DynamicForwardProxyFilterStats stats_;
+};
+
+typedef std::shared_ptr<DynamicForwardProxyFilterConfig> DynamicForwardProxyFilterConfigSharedPtr;
+
+/**
+ * A filter that holds requests routed to a dynamic forward proxy cluster until the name of their
+ * authority has been resolved. The load balancer of the cluster then finds the addresses in the
+ * DNS cache it shares with the filter. Requests to other clusters, and requests whose name is
+ * already cached, are not held. A failed resolution is left to the router, which finds no host.
+ */
+class DynamicForwardProxyFilter : public StreamDecoderFilter {
+public:
+  DynamicForwardProxyFilter(DynamicForwardProxyFilterConfigSharedPtr config) : config_(config) {}
+
+  // Http::StreamFilterBase
+  void onDestroy() override;
+
+  // Http::StreamDecoderFilter
+  FilterHeadersStatus decodeHeaders(HeaderMap& headers, bool end_stream) override;
+  FilterDataStatus decodeData(Buffer::Instance& data, bool end_stream) override;
+  FilterTrailersStatus decodeTrailers(HeaderMap& trailers) override;
+  void setDecoderFilterCallbacks(StreamDecoderFilterCallbacks& callbacks) override;
+
+private:
+  void onResolved(std::list<Network::Address::InstanceConstSharedPtr>&& address_list);
+
+  enum class State { NotStarted, Resolving, Complete };
+
+  DynamicForwardProxyFilterConfigSharedPtr config_;
+  StreamDecoderFilterCallbacks* callbacks_{};
+  Network::ActiveDnsQuery* active_query_{};
+  bool initiating_call_{};
+  State state_{State::NotStarted};
+};
+
+} // Http
+} // Envoy
@@ -17,10 +17,20 @@
 #include "common/http/headers.h"
 #include "common/json/config_schemas.h"
 #include "common/router/config_impl.h"
+#include "common/runtime/key_registry.h"
 
 namespace Envoy {
 namespace Http {
 
+static const Runtime::Key RuntimeDelayPercent =
+    Runtime::KeyRegistry::registerKey("fault.http.delay.fixed_delay_percent");
+static const Runtime::Key RuntimeDelayDuration =
+    Runtime::KeyRegistry::registerKey("fault.http.delay.fixed_duration_ms");
+static const Runtime::Key RuntimeAbortPercent =
+    Runtime::KeyRegistry::registerKey("fault.http.abort.abort_percent");
+static const Runtime::Key RuntimeAbortStatus =
+    Runtime::KeyRegistry::registerKey("fault.http.abort.http_status");
+
 FaultFilterConfig::FaultFilterConfig(const Json::Object& json_config, Runtime::Loader& runtime,
                                      const std::string& stat_prefix, Stats::Store& stats)
     : runtime_(runtime), stats_(generateStats(stat_prefix, stats)) {
@@ -69,6 +79,21 @@ FaultFilter::~FaultFilter() { ASSERT(!delay_timer_); }
 // if we inject a delay, then we will inject the abort in the delay timer
 // callback.
 FilterHeadersStatus FaultFilter::decodeHeaders(HeaderMap& headers, bool) {
+  // Faults are sampled before the route and the headers are matched. Faults are usually injected
+  // into a small sample of requests, and the others then only pay for two indexed runtime reads.
+  Runtime::Snapshot& snapshot = config_->runtime().snapshot();
+  uint64_t duration_ms = 0;
+  if (snapshot.featureEnabled(RuntimeDelayPercent, config_->delayPercent())) {
+    // Delay only if the duration is >0ms
+    duration_ms = snapshot.getInteger(RuntimeDelayDuration, config_->delayDuration());
+  }
+
+  const bool abort =
+      duration_ms == 0 && snapshot.featureEnabled(RuntimeAbortPercent, config_->abortPercent());
+  if (duration_ms == 0 && !abort) {
+    return FilterHeadersStatus::Continue;
+  }
+
   if (!matchesTargetCluster()) {
     return FilterHeadersStatus::Continue;
   }
@@ -78,29 +103,16 @@ FilterHeadersStatus FaultFilter::decodeHeaders(HeaderMap& headers, bool) {
     return FilterHeadersStatus::Continue;
   }
 
-  if (config_->runtime().snapshot().featureEnabled("fault.http.delay.fixed_delay_percent",
-                                                   config_->delayPercent())) {
-    uint64_t duration_ms = config_->runtime().snapshot().getInteger(
-        "fault.http.delay.fixed_duration_ms", config_->delayDuration());
-
-    // Delay only if the duration is >0ms
-    if (0 != duration_ms) {
-      delay_timer_ =
-          callbacks_->dispatcher().createTimer([this]() -> void { postDelayInjection(); });
-      delay_timer_->enableTimer(std::chrono::milliseconds(duration_ms));
-      config_->stats().delays_injected_.inc();
-      callbacks_->requestInfo().setResponseFlag(Http::AccessLog::ResponseFlag::DelayInjected);
-      return FilterHeadersStatus::StopIteration;
-    }
-  }
-
-  if (config_->runtime().snapshot().featureEnabled("fault.http.abort.abort_percent",
-                                                   config_->abortPercent())) {
-    abortWithHTTPStatus();
+  if (duration_ms != 0) {
+    delay_timer_ = callbacks_->dispatcher().createTimer([this]() -> void { postDelayInjection(); });
+    delay_timer_->enableTimer(std::chrono::milliseconds(duration_ms));
+    config_->stats().delays_injected_.inc();
+    callbacks_->requestInfo().setResponseFlag(Http::AccessLog::ResponseFlag::DelayInjected);
     return FilterHeadersStatus::StopIteration;
   }
 
-  return FilterHeadersStatus::Continue;
+  abortWithHTTPStatus();
+  return FilterHeadersStatus::StopIteration;
 }
 
 FilterDataStatus FaultFilter::decodeData(Buffer::Instance&, bool) {
@@ -121,7 +133,7 @@ void FaultFilter::onDestroy() { resetTimerState(); }
 void FaultFilter::postDelayInjection() {
   resetTimerState();
   // Delays can be followed by aborts
-  if (config_->runtime().snapshot().featureEnabled("fault.http.abort.abort_percent",
+  if (config_->runtime().snapshot().featureEnabled(RuntimeAbortPercent,
                                                    config_->abortPercent())) {
     abortWithHTTPStatus();
   } else {
@@ -134,7 +146,7 @@ void FaultFilter::abortWithHTTPStatus() {
   // TODO(mattklein123): check http status codes obtained from runtime
   Http::HeaderMapPtr response_headers{new HeaderMapImpl{
       {Headers::get().Status, std::to_string(config_->runtime().snapshot().getInteger(
-                                  "fault.http.abort.http_status", config_->abortCode()))}}};
+                                  RuntimeAbortStatus, config_->abortCode()))}}};
   callbacks_->encodeHeaders(std::move(response_headers), true);
   config_->stats().aborts_injected_.inc();
   callbacks_->requestInfo().setResponseFlag(Http::AccessLog::ResponseFlag::FaultInjected);
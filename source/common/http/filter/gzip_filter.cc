@@ -0,0 +1,283 @@
+#include "common/http/filter/gzip_filter.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/common/assert.h"
+#include "common/common/enum_to_int.h"
+#include "common/common/utility.h"
+#include "common/http/headers.h"
+#include "common/http/utility.h"
+#include "common/json/config_schemas.h"
+
+namespace Envoy {
+namespace Http {
+
+namespace {
+
+// The size of the chunks that deflate output is written into.
+const uint64_t OUTPUT_CHUNK_SIZE = 4096;
+
+/**
+ * @return whether a quality value is zero, e.g. "0" or "0.000".
+ */
+bool zeroQuality(const std::string& value) {
+  return !value.empty() && value[0] == '0' && value.find_first_not_of("0.") == std::string::npos;
+}
+
+const std::vector<std::string>& defaultContentTypes() {
+  static const std::vector<std::string>* content_types = new std::vector<std::string>(
+      {"text/html", "text/plain", "text/css", "text/xml", "application/javascript",
+       "application/json", "application/xml", "image/svg+xml"});
+  return *content_types;
+}
+
+} // namespace
+
+GzipCompressor::GzipCompressor(int compression_level, int memory_level, int window_bits) {
+  // Adding 16 to the window bits makes deflate write a gzip header and trailer rather than a zlib
+  // wrapper.
+  const int result = deflateInit2(&zstream_, compression_level, Z_DEFLATED, window_bits + 16,
+                                  memory_level, Z_DEFAULT_STRATEGY);
+  RELEASE_ASSERT(result == Z_OK);
+}
+
+GzipCompressor::~GzipCompressor() { deflateEnd(&zstream_); }
+
+void GzipCompressor::compress(Buffer::Instance& data, bool finish) {
+  Buffer::OwnedImpl output;
+  uint64_t num_slices = data.getRawSlices(nullptr, 0);
+  Buffer::RawSlice slices[num_slices];
+  data.getRawSlices(slices, num_slices);
+  for (Buffer::RawSlice& slice : slices) {
+    zstream_.next_in = static_cast<Bytef*>(slice.mem_);
+    zstream_.avail_in = slice.len_;
+    deflateInto(output, Z_NO_FLUSH);
+  }
+
+  if (finish) {
+    deflateInto(output, Z_FINISH);
+  }
+
+  data.drain(data.length());
+  data.move(output);
+}
+
+void GzipCompressor::deflateInto(Buffer::Instance& output, int flush) {
+  // Deflate until it has consumed all of the input and, when finishing, written the trailer.
+  // Either way deflate is done once it leaves room in the output chunk.
+  do {
+    Buffer::RawSlice chunk;
+    output.reserve(OUTPUT_CHUNK_SIZE, &chunk, 1);
+    zstream_.next_out = static_cast<Bytef*>(chunk.mem_);
+    zstream_.avail_out = chunk.len_;
+    const int result = deflate(&zstream_, flush);
+    RELEASE_ASSERT(result == Z_OK || result == Z_STREAM_END || result == Z_BUF_ERROR);
+    chunk.len_ -= zstream_.avail_out;
+    output.commit(&chunk, 1);
+  } while (zstream_.avail_out == 0);
+}
+
+void GzipCompressor::reset() {
+  const int result = deflateReset(&zstream_);
+  RELEASE_ASSERT(result == Z_OK);
+}
+
+GzipFilterConfig::GzipFilterConfig(const Json::Object& json_config,
+                                   const std::string& stats_prefix, Stats::Store& stats,
+                                   ThreadLocal::Instance& tls, MonotonicTimeSource& time_source)
+    : Json::Validator(json_config, Json::Schema::GZIP_HTTP_FILTER_SCHEMA),
+      compression_level_(json_config.getInteger("compression_level", Z_DEFAULT_COMPRESSION)),
+      memory_level_(json_config.getInteger("memory_level", 8)),
+      window_bits_(json_config.getInteger("window_bits", 15)),
+      min_content_length_(json_config.getInteger("min_content_length", 30)),
+      content_types_(json_config.hasObject("content_types")
+                         ? json_config.getStringArray("content_types")
+                         : defaultContentTypes()),
+      tls_(tls), tls_slot_(tls.allocateSlot()), time_source_(time_source),
+      stats_(generateStats(stats_prefix + "gzip.", stats)) {
+  tls.set(tls_slot_, [](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+    return std::make_shared<ThreadLocalPool>();
+  });
+}
+
+GzipFilterStats GzipFilterConfig::generateStats(const std::string& prefix, Stats::Store& store) {
+  return {ALL_GZIP_FILTER_STATS(POOL_COUNTER_PREFIX(store, prefix))};
+}
+
+GzipCompressorPtr GzipFilterConfig::acquireCompressor() {
+  ThreadLocalPool& pool = tls_.getTyped<ThreadLocalPool>(tls_slot_);
+  if (pool.compressors_.empty()) {
+    stats_.compressor_allocated_.inc();
+    return GzipCompressorPtr{new GzipCompressor(compression_level_, memory_level_, window_bits_)};
+  }
+
+  GzipCompressorPtr compressor = std::move(pool.compressors_.back());
+  pool.compressors_.pop_back();
+  return compressor;
+}
+
+void GzipFilterConfig::releaseCompressor(GzipCompressorPtr compressor) {
+  ThreadLocalPool& pool = tls_.getTyped<ThreadLocalPool>(tls_slot_);
+  if (pool.compressors_.size() < MAX_POOLED_COMPRESSORS) {
+    compressor->reset();
+    pool.compressors_.emplace_back(std::move(compressor));
+  }
+}
+
+bool GzipFilterConfig::compressibleContentType(const std::string& content_type) const {
+  const std::string media_type = StringUtil::trim(content_type.substr(0, content_type.find(';')));
+  for (const std::string& compressible : content_types_) {
+    if (StringUtil::caseInsensitiveCompare(media_type.c_str(), compressible.c_str()) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+GzipFilter::GzipFilter(GzipFilterConfigSharedPtr config) : config_(config) {}
+
+GzipFilter::~GzipFilter() { ASSERT(!compressor_); }
+
+void GzipFilter::onDestroy() { releaseCompressor(); }
+
+bool GzipFilter::acceptsGzip(const std::string& accept_encoding) {
+  bool wildcard = false;
+  for (const std::string& coding : StringUtil::split(accept_encoding, ',')) {
+    const size_t semicolon = coding.find(';');
+    const std::string name = StringUtil::trim(coding.substr(0, semicolon));
+    bool accepted = true;
+    if (semicolon != std::string::npos) {
+      const std::string parameter = StringUtil::trim(coding.substr(semicolon + 1));
+      if (parameter.size() > 2 && (parameter[0] == 'q' || parameter[0] == 'Q') &&
+          parameter[1] == '=') {
+        accepted = !zeroQuality(parameter.substr(2));
+      }
+    }
+
+    if (StringUtil::caseInsensitiveCompare(name.c_str(), "gzip") == 0) {
+      // An explicit gzip coding takes precedence over the wildcard.
+      return accepted;
+    } else if (name == "*") {
+      wildcard = accepted;
+    }
+  }
+
+  return wildcard;
+}
+
+FilterHeadersStatus GzipFilter::decodeHeaders(HeaderMap& headers, bool) {
+  const HeaderEntry* accept_encoding = headers.get(Headers::get().AcceptEncoding);
+  accepts_gzip_ = accept_encoding && acceptsGzip(accept_encoding->value().c_str());
+  return FilterHeadersStatus::Continue;
+}
+
+bool GzipFilter::responseCompressible(const HeaderMap& headers) {
+  if (headers.get(Headers::get().ContentEncoding) ||
+      Utility::getResponseStatus(headers) == enumToInt(Code::PartialContent)) {
+    return false;
+  }
+
+  const HeaderEntry* cache_control = headers.get(Headers::get().CacheControl);
+  if (cache_control) {
+    for (const std::string& directive : StringUtil::split(cache_control->value().c_str(), ',')) {
+      if (StringUtil::caseInsensitiveCompare(StringUtil::trim(directive).c_str(),
+                                             "no-transform") == 0) {
+        return false;
+      }
+    }
+  }
+
+  uint64_t content_length;
+  if (headers.ContentLength() &&
+      (!StringUtil::atoul(headers.ContentLength()->value().c_str(), content_length) ||
+       content_length < config_->minContentLength())) {
+    return false;
+  }
+
+  return headers.ContentType() &&
+         config_->compressibleContentType(headers.ContentType()->value().c_str());
+}
+
+FilterHeadersStatus GzipFilter::encodeHeaders(HeaderMap& headers, bool end_stream) {
+  if (end_stream || !accepts_gzip_ || !responseCompressible(headers)) {
+    config_->stats().not_compressed_.inc();
+    return FilterHeadersStatus::Continue;
+  }
+
+  config_->stats().compressed_.inc();
+  compressor_ = config_->acquireCompressor();
+
+  headers.removeContentLength();
+  headers.addStatic(Headers::get().ContentEncoding, Headers::get().ContentEncodingValues.Gzip);
+
+  // Caches must keep the compressed and uncompressed responses apart.
+  const HeaderEntry* vary = headers.get(Headers::get().Vary);
+  std::string vary_value = vary ? vary->value().c_str() : "";
+  if (vary_value.empty()) {
+    vary_value = "Accept-Encoding";
+  } else {
+    vary_value += ", Accept-Encoding";
+  }
+  headers.remove(Headers::get().Vary);
+  headers.addStaticKey(Headers::get().Vary, vary_value);
+
+  // The compressed body is not byte for byte the body that a strong ETag identifies.
+  const HeaderEntry* etag = headers.get(Headers::get().Etag);
+  if (etag && !StringUtil::startsWith(etag->value().c_str(), "W/")) {
+    const std::string weak_etag = std::string("W/") + etag->value().c_str();
+    headers.remove(Headers::get().Etag);
+    headers.addStaticKey(Headers::get().Etag, weak_etag);
+  }
+
+  return FilterHeadersStatus::Continue;
+}
+
+FilterDataStatus GzipFilter::encodeData(Buffer::Instance& data, bool end_stream) {
+  if (compressor_) {
+    compress(data, end_stream);
+  }
+
+  return FilterDataStatus::Continue;
+}
+
+FilterTrailersStatus GzipFilter::encodeTrailers(HeaderMap&) {
+  if (compressor_) {
+    Buffer::OwnedImpl data;
+    compress(data, true);
+    encoder_callbacks_->addEncodedData(data);
+  }
+
+  return FilterTrailersStatus::Continue;
+}
+
+void GzipFilter::setEncoderFilterCallbacks(StreamEncoderFilterCallbacks& callbacks) {
+  encoder_callbacks_ = &callbacks;
+}
+
+void GzipFilter::compress(Buffer::Instance& data, bool finish) {
+  const MonotonicTime start = config_->timeSource().currentTime();
+  config_->stats().total_uncompressed_bytes_.add(data.length());
+  compressor_->compress(data, finish);
+  config_->stats().total_compressed_bytes_.add(data.length());
+  config_->stats().compression_time_us_.add(std::chrono::duration_cast<std::chrono::microseconds>(
+                                                config_->timeSource().currentTime() - start)
+                                                .count());
+
+  if (finish) {
+    releaseCompressor();
+  }
+}
+
+void GzipFilter::releaseCompressor() {
+  if (compressor_) {
+    config_->releaseCompressor(std::move(compressor_));
+  }
+}
+
+} // Http
+} // Envoy
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "envoy/buffer/buffer.h"
+#include "envoy/common/time.h"
+#include "envoy/http/filter.h"
+#include "envoy/json/json_object.h"
+#include "envoy/stats/stats_macros.h"
+#include "envoy/thread_local/thread_local.h"
+
+#include "common/json/json_validator.h"
+
+#include "zlib.h"
+
+namespace Envoy {
+namespace Http {
+
+/**
+ * All stats for the gzip filter. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_GZIP_FILTER_STATS(COUNTER)                                                             \
+  COUNTER(compressed)                                                                              \
+  COUNTER(not_compressed)                                                                          \
+  COUNTER(total_uncompressed_bytes)                                                                \
+  COUNTER(total_compressed_bytes)                                                                  \
+  COUNTER(compression_time_us)                                                                     \
+  COUNTER(compressor_allocated)
+// clang-format on
+
+/**
+ * Wrapper struct for gzip filter stats. @see stats_macros.h
+ */
+struct GzipFilterStats {
+  ALL_GZIP_FILTER_STATS(GENERATE_COUNTER_STRUCT)
+};
+
+/**
+ * A gzip stream compressor. Its deflate state takes a few hundred KB with the default settings, so
+ * it is reset and reused across streams rather than allocated for each one.
+ */
+class GzipCompressor {
+public:
+  GzipCompressor(int compression_level, int memory_level, int window_bits);
+  ~GzipCompressor();
+
+  /**
+   * Compress a buffer in place.
+   * @param data supplies the data to compress. It is replaced by the compressed data, which may be
+   *        empty if the compressor is still buffering its input.
+   * @param finish supplies whether this is the end of the stream, in which case the compressor
+   *        flushes everything it buffered and writes the gzip trailer.
+   */
+  void compress(Buffer::Instance& data, bool finish);
+
+  /**
+   * Reset the compressor so that it can compress a new stream.
+   */
+  void reset();
+
+private:
+  void deflateInto(Buffer::Instance& output, int flush);
+
+  z_stream zstream_{};
+};
+
+typedef std::unique_ptr<GzipCompressor> GzipCompressorPtr;
+
+/**
+ * Configuration for the gzip filter. This owns a pool of idle compressors per worker.
+ */
+class GzipFilterConfig : Json::Validator {
+public:
+  GzipFilterConfig(const Json::Object& json_config, const std::string& stats_prefix,
+                   Stats::Store& stats, ThreadLocal::Instance& tls,
+                   MonotonicTimeSource& time_source);
+
+  /**
+   * @return a compressor from this worker's pool, or a new one if the pool is empty.
+   */
+  GzipCompressorPtr acquireCompressor();
+
+  /**
+   * Reset a compressor and return it to this worker's pool.
+   */
+  void releaseCompressor(GzipCompressorPtr compressor);
+
+  /**
+   * @return whether responses with the given content type are compressed.
+   */
+  bool compressibleContentType(const std::string& content_type) const;
+
+  uint64_t minContentLength() const { return min_content_length_; }
+  MonotonicTimeSource& timeSource() { return time_source_; }
+  GzipFilterStats& stats() { return stats_; }
+
+  // The maximum number of idle compressors that are kept in each worker's pool.
+  static const size_t MAX_POOLED_COMPRESSORS = 16;
+
+private:
+  struct ThreadLocalPool : public ThreadLocal::ThreadLocalObject {
+    // ThreadLocal::ThreadLocalObject
+    void shutdown() override {}
+
+    std::vector<GzipCompressorPtr> compressors_;
+  };
+
+  static GzipFilterStats generateStats(const std::string& prefix, Stats::Store& store);
+
+  const int compression_level_;
+  const int memory_level_;
+  const int window_bits_;
+  const uint64_t min_content_length_;
+  const std::vector<std::string> content_types_;
+  ThreadLocal::Instance& tls_;
+  const uint32_t tls_slot_;
+  MonotonicTimeSource& time_source_;
+  GzipFilterStats stats_;
+};
+
+typedef std::shared_ptr<GzipFilterConfig> GzipFilterConfigSharedPtr;
+
+/**
+ * A filter that gzips response bodies as they stream through it, for requests that accept gzip.
+ * Each compressed stream borrows a compressor from its worker's pool for as long as it is being
+ * compressed.
+ */
+class GzipFilter : public StreamFilter {
+public:
+  GzipFilter(GzipFilterConfigSharedPtr config);
+  ~GzipFilter();
+
+  // Http::StreamFilterBase
+  void onDestroy() override;
+
+  // Http::StreamDecoderFilter
+  FilterHeadersStatus decodeHeaders(HeaderMap& headers, bool end_stream) override;
+  FilterDataStatus decodeData(Buffer::Instance&, bool) override {
+    return FilterDataStatus::Continue;
+  }
+  FilterTrailersStatus decodeTrailers(HeaderMap&) override {
+    return FilterTrailersStatus::Continue;
+  }
+  void setDecoderFilterCallbacks(StreamDecoderFilterCallbacks&) override {}
+
+  // Http::StreamEncoderFilter
+  FilterHeadersStatus encodeHeaders(HeaderMap& headers, bool end_stream) override;
+  FilterDataStatus encodeData(Buffer::Instance& data, bool end_stream) override;
+  FilterTrailersStatus encodeTrailers(HeaderMap& trailers) override;
+  void setEncoderFilterCallbacks(StreamEncoderFilterCallbacks& callbacks) override;
+
+  /**
+   * @return whether an Accept-Encoding header value accepts gzip.
+   */
+  static bool acceptsGzip(const std::string& accept_encoding);
+
+private:
+  bool responseCompressible(const HeaderMap& headers);
+  void compress(Buffer::Instance& data, bool finish);
+  void releaseCompressor();
+
+  GzipFilterConfigSharedPtr config_;
+  StreamEncoderFilterCallbacks* encoder_callbacks_{};
+  bool accepts_gzip_{};
+  GzipCompressorPtr compressor_;
+};
+
+} // Http
+} // Envoy
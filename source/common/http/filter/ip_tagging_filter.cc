@@ -1,15 +1,90 @@
 #include "common/http/filter/ip_tagging_filter.h"
 
+#include "envoy/common/exception.h"
+
+#include "common/common/utility.h"
+#include "common/http/headers.h"
+#include "common/network/cidr_range.h"
+#include "common/network/utility.h"
+
 namespace Envoy {
 namespace Http {
 
+IpTaggingFilterConfig::IpTaggingFilterConfig(const Json::Object& json_config,
+                                             const std::string& stat_prefix, Stats::Scope& scope)
+    : Json::Validator(json_config, Json::Schema::IP_TAGGING_HTTP_FILTER_SCHEMA),
+      request_type_(stringToType(json_config.getString("request_type", "both"))),
+      trie_(parseIpTags(json_config)),
+      stats_{ALL_IP_TAGGING_FILTER_STATS(
+          POOL_COUNTER_PREFIX(scope, stat_prefix + "ip_tagging."))} {}
+
+std::vector<Network::LcTrie::Prefix>
+IpTaggingFilterConfig::parseIpTags(const Json::Object& json_config) {
+  std::vector<Network::LcTrie::Prefix> prefixes;
+  if (!json_config.hasObject("ip_tags")) {
+    return prefixes;
+  }
+
+  for (const Json::ObjectSharedPtr& ip_tag : json_config.getObjectArray("ip_tags")) {
+    const std::string tag_name = ip_tag->getString("ip_tag_name");
+    for (const std::string& entry : ip_tag->getStringArray("ip_list")) {
+      const Network::Address::CidrRange range = Network::Address::CidrRange::create(entry);
+      if (!range.isValid()) {
+        throw EnvoyException(
+            fmt::format("invalid ip/mask combo '{}' in ip tag '{}'", entry, tag_name));
+      }
+
+      if (range.version() == Network::Address::IpVersion::v4) {
+        prefixes.emplace_back(tag_name, range.ipv4()->address(), range.length());
+      } else {
+        prefixes.emplace_back(tag_name, range.ipv6()->address(), range.length());
+      }
+    }
+  }
+
+  return prefixes;
+}
+
 IpTaggingFilter::IpTaggingFilter(IpTaggingFilterConfigSharedPtr config) : config_(config) {}
 
 IpTaggingFilter::~IpTaggingFilter() {}
 
 void IpTaggingFilter::onDestroy() {}
 
-FilterHeadersStatus IpTaggingFilter::decodeHeaders(HeaderMap&, bool) {
+FilterHeadersStatus IpTaggingFilter::decodeHeaders(HeaderMap& headers, bool) {
+  bool is_internal_request =
+      headers.EnvoyInternalRequest() && (headers.EnvoyInternalRequest()->value() == "true");
+
+  if ((is_internal_request && config_->requestType() == FilterRequestType::External) ||
+      (!is_internal_request && config_->requestType() == FilterRequestType::Internal)) {
+    return FilterHeadersStatus::Continue;
+  }
+
+  config_->stats().total_.inc();
+
+  // The downstream address is the trusted XFF address, which is not always a valid IP address
+  // (e.g. when the XFF header is missing entirely).
+  Network::Address::InstanceConstSharedPtr address;
+  try {
+    address = Network::Utility::parseInternetAddress(callbacks_->downstreamAddress());
+  } catch (const EnvoyException&) {
+  }
+
+  if (!address) {
+    config_->stats().no_hit_.inc();
+    return FilterHeadersStatus::Continue;
+  }
+
+  const std::vector<std::string>& tags = config_->trie().getTags(*address);
+  if (tags.empty()) {
+    config_->stats().no_hit_.inc();
+    return FilterHeadersStatus::Continue;
+  }
+
+  config_->stats().hit_.inc();
+  headers.addStaticKey(Headers::get().EnvoyIpTags, StringUtil::join(tags, ","));
+  // Routes can match on the tags.
+  callbacks_->clearRouteCache();
   return FilterHeadersStatus::Continue;
 }
 
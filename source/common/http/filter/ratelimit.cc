@@ -119,7 +119,8 @@ void Filter::complete(Envoy::RateLimit::LimitStatus status) {
     cluster_->statsScope().counter("ratelimit.over_limit").inc();
     Http::CodeUtility::ResponseStatInfo info{
         config_->globalStore(), cluster_->statsScope(), EMPTY_STRING, *getTooManyRequestsHeader(),
-        true, EMPTY_STRING, EMPTY_STRING, EMPTY_STRING, EMPTY_STRING, false};
+        true, EMPTY_STRING, EMPTY_STRING, EMPTY_STRING, EMPTY_STRING, false,
+        &cluster_->codeStats(), nullptr};
     Http::CodeUtility::chargeResponseStat(info);
     break;
   }
@@ -1,6 +1,9 @@
 #include "common/http/header_map_impl.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <cstring>
 #include <list>
 #include <string>
 
@@ -8,10 +11,53 @@
 #include "common/common/empty_string.h"
 #include "common/common/singleton.h"
 #include "common/common/utility.h"
+#include "common/memory/accounting.h"
 
 namespace Envoy {
 namespace Http {
 
+namespace {
+
+// Heap allocated strings are prefixed with a reference count so that copies of a header map can
+// share them. The count is atomic because cached responses are copied on every worker.
+typedef std::atomic<uint32_t> RefCount;
+const size_t RefCountSize = sizeof(uint64_t);
+static_assert(sizeof(RefCount) <= RefCountSize, "reference count does not fit its prefix");
+
+RefCount& refCount(const char* buffer) {
+  return *reinterpret_cast<RefCount*>(const_cast<char*>(buffer) - RefCountSize);
+}
+
+char* allocateDynamic(uint32_t capacity) {
+  char* block = static_cast<char*>(malloc(RefCountSize + capacity));
+  new (block) RefCount(1);
+  return block + RefCountSize;
+}
+
+void releaseDynamic(char* buffer) {
+  if (--refCount(buffer) == 0) {
+    free(buffer - RefCountSize);
+  }
+}
+
+/**
+ * Resize storage, keeping the first size bytes. Storage that is shared is copied rather than
+ * resized in place.
+ */
+char* resizeDynamic(char* buffer, uint32_t size, uint32_t capacity) {
+  if (refCount(buffer) == 1) {
+    return static_cast<char*>(realloc(buffer - RefCountSize, RefCountSize + capacity)) +
+           RefCountSize;
+  }
+
+  char* copy = allocateDynamic(capacity);
+  memcpy(copy, buffer, size);
+  releaseDynamic(buffer);
+  return copy;
+}
+
+} // namespace
+
 HeaderString::HeaderString() : type_(Type::Inline) {
   buffer_.dynamic_ = inline_buffer_;
   clear();
@@ -51,17 +97,74 @@ HeaderString::HeaderString(HeaderString&& move_value) {
     move_value.inline_buffer_[0] = 0;
     break;
   }
+  case Type::Reference: {
+    // Like a dynamic header, the moved header switches back to its default state (inline).
+    buffer_.static_ = move_value.buffer_.static_;
+    reference_release_ = move_value.reference_release_;
+    move_value.type_ = Type::Inline;
+    move_value.buffer_.dynamic_ = move_value.inline_buffer_;
+    move_value.clear();
+    break;
+  }
   }
 }
 
 HeaderString::~HeaderString() {
   if (type_ == Type::Dynamic) {
-    free(buffer_.dynamic_);
+    Memory::AccountingScope accounting(Memory::Subsystem::HeaderMap);
+    releaseDynamic(buffer_.dynamic_);
+  } else if (type_ == Type::Reference) {
+    reference_release_.cb_(reference_release_.context_);
+  }
+}
+
+bool HeaderString::shared() const {
+  return type_ == Type::Dynamic && refCount(buffer_.dynamic_) > 1;
+}
+
+void HeaderString::unshare() {
+  if (shared()) {
+    Memory::AccountingScope accounting(Memory::Subsystem::HeaderMap);
+    buffer_.dynamic_ = resizeDynamic(buffer_.dynamic_, string_length_ + 1, dynamic_capacity_);
+  }
+}
+
+void HeaderString::releaseIfShared() {
+  // Used when the string is about to be overwritten, so the shared storage is not copied.
+  if (shared()) {
+    releaseDynamic(buffer_.dynamic_);
+    type_ = Type::Inline;
+    buffer_.dynamic_ = inline_buffer_;
+    inline_buffer_[0] = 0;
+    string_length_ = 0;
+  }
+}
+
+void HeaderString::copyReference() {
+  // Used when the string is about to be modified in place. setCopy() gives back the reference.
+  if (type_ == Type::Reference) {
+    setCopy(buffer_.static_, string_length_);
+  }
+}
+
+void HeaderString::releaseReference() {
+  // Used when the string is about to be overwritten, so the referenced data is not copied.
+  if (type_ == Type::Reference) {
+    const ReferenceRelease release = reference_release_;
+    type_ = Type::Inline;
+    buffer_.dynamic_ = inline_buffer_;
+    inline_buffer_[0] = 0;
+    string_length_ = 0;
+    release.cb_(release.context_);
   }
 }
 
 void HeaderString::append(const char* data, uint32_t size) {
+  copyReference();
   switch (type_) {
+  case Type::Reference:
+    NOT_REACHED;
+
   case Type::Static: {
     // Switch back to inline and fall through. We do not actually append to the static string
     // currently which would require a copy.
@@ -81,9 +184,10 @@ void HeaderString::append(const char* data, uint32_t size) {
 
   case Type::Dynamic: {
     // We can get here either because we didn't fit in inline or we are already dynamic.
+    Memory::AccountingScope accounting(Memory::Subsystem::HeaderMap);
     if (type_ == Type::Inline) {
       uint32_t new_capacity = (string_length_ + size) * 2;
-      buffer_.dynamic_ = static_cast<char*>(malloc(new_capacity));
+      buffer_.dynamic_ = allocateDynamic(new_capacity);
       memcpy(buffer_.dynamic_, inline_buffer_, string_length_);
       dynamic_capacity_ = new_capacity;
       type_ = Type::Dynamic;
@@ -91,7 +195,9 @@ void HeaderString::append(const char* data, uint32_t size) {
       if (size + 1 + string_length_ > dynamic_capacity_) {
         // Need to reallocate.
         dynamic_capacity_ = (string_length_ + size) * 2;
-        buffer_.dynamic_ = static_cast<char*>(realloc(buffer_.dynamic_, dynamic_capacity_));
+        buffer_.dynamic_ = resizeDynamic(buffer_.dynamic_, string_length_, dynamic_capacity_);
+      } else {
+        unshare();
       }
     }
   }
@@ -102,8 +208,22 @@ void HeaderString::append(const char* data, uint32_t size) {
   buffer_.dynamic_[string_length_] = 0;
 }
 
+char* HeaderString::buffer() {
+  if (type_ == Type::Static || type_ == Type::Reference) {
+    // Static and referenced data must not be modified, so switch to a copy of it.
+    setCopy(buffer_.static_, string_length_);
+  } else {
+    unshare();
+  }
+  return buffer_.dynamic_;
+}
+
 void HeaderString::clear() {
+  releaseIfShared();
+  releaseReference();
   switch (type_) {
+  case Type::Reference:
+    NOT_REACHED;
   case Type::Static: {
     break;
   }
@@ -118,7 +238,19 @@ void HeaderString::clear() {
 }
 
 void HeaderString::setCopy(const char* data, uint32_t size) {
+  if (type_ == Type::Reference) {
+    // The data may be the referenced data, so the reference is given back after the copy.
+    const ReferenceRelease release = reference_release_;
+    type_ = Type::Inline;
+    buffer_.dynamic_ = inline_buffer_;
+    setCopy(data, size);
+    release.cb_(release.context_);
+    return;
+  }
+
   switch (type_) {
+  case Type::Reference:
+    NOT_REACHED;
   case Type::Static: {
     // Switch back to inline and fall through.
     type_ = Type::Inline;
@@ -136,16 +268,19 @@ void HeaderString::setCopy(const char* data, uint32_t size) {
 
   case Type::Dynamic: {
     // We can get here either because we didn't fit in inline or we are already dynamic.
+    Memory::AccountingScope accounting(Memory::Subsystem::HeaderMap);
     if (type_ == Type::Inline) {
       dynamic_capacity_ = size * 2;
-      buffer_.dynamic_ = static_cast<char*>(malloc(dynamic_capacity_));
+      buffer_.dynamic_ = allocateDynamic(dynamic_capacity_);
       type_ = Type::Dynamic;
     } else {
-      if (size + 1 > dynamic_capacity_) {
-        // Need to reallocate. Use free/malloc to avoid the copy since we are about to overwrite.
-        dynamic_capacity_ = size * 2;
-        free(buffer_.dynamic_);
-        buffer_.dynamic_ = static_cast<char*>(malloc(dynamic_capacity_));
+      if (size + 1 > dynamic_capacity_ || shared()) {
+        // Need to reallocate. Release and allocate to avoid the copy since we are about to
+        // overwrite. If the storage is shared, data may point into it, but the other owner keeps
+        // it alive.
+        dynamic_capacity_ = std::max(size * 2, dynamic_capacity_);
+        releaseDynamic(buffer_.dynamic_);
+        buffer_.dynamic_ = allocateDynamic(dynamic_capacity_);
       }
     }
   }
@@ -156,8 +291,38 @@ void HeaderString::setCopy(const char* data, uint32_t size) {
   string_length_ = size;
 }
 
+void HeaderString::setCopy(const HeaderString& value) {
+  if (value.type_ != Type::Dynamic) {
+    setCopy(value.c_str(), value.size());
+    return;
+  }
+
+  if (&value == this) {
+    return;
+  }
+
+  ++refCount(value.buffer_.dynamic_);
+  if (type_ == Type::Dynamic) {
+    Memory::AccountingScope accounting(Memory::Subsystem::HeaderMap);
+    releaseDynamic(buffer_.dynamic_);
+  }
+  releaseReference();
+
+  type_ = Type::Dynamic;
+  buffer_.dynamic_ = value.buffer_.dynamic_;
+  dynamic_capacity_ = value.dynamic_capacity_;
+  string_length_ = value.string_length_;
+}
+
+// setInteger() writes to the inline buffer without checking its size.
+static_assert(ENVOY_HEADER_STRING_INLINE_SIZE >= 32, "HeaderString inline buffer is too small");
+
 void HeaderString::setInteger(uint64_t value) {
+  releaseIfShared();
+  releaseReference();
   switch (type_) {
+  case Type::Reference:
+    NOT_REACHED;
   case Type::Static: {
     // Switch back to inline and fall through.
     type_ = Type::Inline;
@@ -172,6 +337,54 @@ void HeaderString::setInteger(uint64_t value) {
   }
 }
 
+void HeaderString::setReference(const std::string& ref_value) {
+  if (type_ == Type::Dynamic) {
+    Memory::AccountingScope accounting(Memory::Subsystem::HeaderMap);
+    releaseDynamic(buffer_.dynamic_);
+  }
+  releaseReference();
+
+  type_ = Type::Static;
+  buffer_.static_ = ref_value.c_str();
+  string_length_ = ref_value.size();
+}
+
+void HeaderString::setReference(const char* data, uint32_t size, ReleaseCb release,
+                                void* context) {
+  if (type_ == Type::Dynamic) {
+    Memory::AccountingScope accounting(Memory::Subsystem::HeaderMap);
+    releaseDynamic(buffer_.dynamic_);
+  }
+  releaseReference();
+
+  type_ = Type::Reference;
+  buffer_.static_ = data;
+  string_length_ = size;
+  reference_release_ = {release, context};
+}
+
+const size_t HeaderEntryFreeList::MaxCachedBlocks;
+
+HeaderEntryFreeList& HeaderEntryFreeList::threadLocal() {
+  static thread_local HeaderEntryFreeList free_list;
+  return free_list;
+}
+
+void* HeaderEntryFreeList::allocate(size_t size) {
+  Memory::AccountingScope accounting(Memory::Subsystem::HeaderMap);
+  return FreeList::allocate(size);
+}
+
+void HeaderEntryFreeList::deallocate(void* block, size_t size) {
+  Memory::AccountingScope accounting(Memory::Subsystem::HeaderMap);
+  FreeList::deallocate(block, size);
+}
+
+void HeaderEntryFreeList::release() {
+  Memory::AccountingScope accounting(Memory::Subsystem::HeaderMap);
+  FreeList::release();
+}
+
 HeaderMapImpl::HeaderEntryImpl::HeaderEntryImpl(const LowerCaseString& key) : key_(key) {}
 
 HeaderMapImpl::HeaderEntryImpl::HeaderEntryImpl(const LowerCaseString& key, HeaderString&& value)
@@ -206,46 +419,77 @@ HeaderMapImpl::StaticLookupTable::StaticLookupTable() {
   add(Headers::get().HostLegacy.get().c_str(), [](HeaderMapImpl& h) -> StaticLookupResponse {
     return {&h.inline_headers_.Host_, &Headers::get().Host};
   });
+
+  // Only headers that are never appended to are interned, since appending to a static value
+  // replaces it.
+  const HeaderValues& headers = Headers::get();
+  addValues(headers.ContentType,
+            {&headers.ContentTypeValues.Grpc, &headers.ContentTypeValues.GrpcWeb,
+             &headers.ContentTypeValues.GrpcWebProto, &headers.ContentTypeValues.Text});
+  addValues(headers.EnvoyInternalRequest, {&headers.EnvoyInternalRequestValues.True});
+  addValues(headers.Expect, {&headers.ExpectValues._100Continue});
+  addValues(headers.GrpcAcceptEncoding, {&headers.GrpcAcceptEncodingValues.Default});
+  addValues(headers.Method,
+            {&headers.MethodValues.Get, &headers.MethodValues.Post, &headers.MethodValues.Head});
+  addValues(headers.Scheme, {&headers.SchemeValues.Http, &headers.SchemeValues.Https});
+  addValues(headers.TE, {&headers.TEValues.Trailers});
+  addValues(headers.TransferEncoding, {&headers.TransferEncodingValues.Chunked});
 }
 
 void HeaderMapImpl::StaticLookupTable::add(const char* key, StaticLookupEntry::EntryCb cb) {
-  StaticLookupEntry* current = &root_;
-  while (uint8_t c = *key) {
-    if (!current->entries_[c]) {
-      current->entries_[c].reset(new StaticLookupEntry());
+  const size_t size = strlen(key);
+  buckets_[hash(key, size)].push_back({key, size, cb, {}});
+}
+
+void HeaderMapImpl::StaticLookupTable::addValues(const LowerCaseString& key,
+                                                 const std::vector<const std::string*>& values) {
+  const size_t size = key.get().size();
+  for (StaticLookupEntry& entry : buckets_[hash(key.get().c_str(), size)]) {
+    if (entry.size_ == size && memcmp(entry.key_, key.get().c_str(), size) == 0) {
+      entry.values_ = values;
+      return;
     }
+  }
+
+  NOT_REACHED;
+}
 
-    current = current->entries_[c].get();
-    key++;
+const HeaderMapImpl::StaticLookupEntry*
+HeaderMapImpl::StaticLookupTable::find(const char* key, size_t size) const {
+  if (size == 0) {
+    return nullptr;
+  }
+
+  for (const StaticLookupEntry& entry : buckets_[hash(key, size)]) {
+    if (entry.size_ == size && memcmp(entry.key_, key, size) == 0) {
+      return &entry;
+    }
   }
 
-  current->cb_ = cb;
+  return nullptr;
 }
 
-HeaderMapImpl::StaticLookupEntry::EntryCb
-HeaderMapImpl::StaticLookupTable::find(const char* key) const {
-  const StaticLookupEntry* current = &root_;
-  while (uint8_t c = *key) {
-    current = current->entries_[c].get();
-    if (current) {
-      key++;
-    } else {
-      return nullptr;
+HeaderString HeaderMapImpl::StaticLookupEntry::intern(HeaderString&& value) const {
+  for (const std::string* interned : values_) {
+    if (interned->size() == value.size() &&
+        memcmp(interned->c_str(), value.c_str(), value.size()) == 0) {
+      return HeaderString(*interned);
     }
   }
 
-  return current->cb_;
+  return std::move(value);
 }
 
 HeaderMapImpl::HeaderMapImpl() { memset(&inline_headers_, 0, sizeof(inline_headers_)); }
 
 HeaderMapImpl::HeaderMapImpl(const HeaderMap& rhs) : HeaderMapImpl() {
   rhs.iterate([](const HeaderEntry& header, void* context) -> void {
-    // TODO(mattklein123) PERF: Avoid copying here is not necessary.
+    // Heap allocated strings are shared with rhs rather than copied. Static strings are copied
+    // since the copy may outlive whatever they point to.
     HeaderString key_string;
-    key_string.setCopy(header.key().c_str(), header.key().size());
+    key_string.setCopy(header.key());
     HeaderString value_string;
-    value_string.setCopy(header.value().c_str(), header.value().size());
+    value_string.setCopy(header.value());
 
     static_cast<HeaderMapImpl*>(context)
         ->addViaMove(std::move(key_string), std::move(value_string));
@@ -279,20 +523,20 @@ bool HeaderMapImpl::operator==(const HeaderMapImpl& rhs) const {
 }
 
 void HeaderMapImpl::insertByKey(HeaderString&& key, HeaderString&& value) {
-  StaticLookupEntry::EntryCb cb = ConstSingleton<StaticLookupTable>::get().find(key.c_str());
-  if (cb) {
+  const StaticLookupEntry* static_entry =
+      ConstSingleton<StaticLookupTable>::get().find(key.c_str(), key.size());
+  if (static_entry) {
     // TODO(mattklein123): Currently, for all of the inline headers, we don't support appending. The
     // only inline header where we should be converting multiple headers into a comma delimited
     // list is XFF. This is not a crisis for now but we should allow an inline header to indicate
     // that it should be appended to. In that case, we would do an append here. We can do this in
     // a follow up.
     key.clear();
-    StaticLookupResponse static_lookup_response = cb(*this);
+    StaticLookupResponse static_lookup_response = static_entry->cb_(*this);
     maybeCreateInline(static_lookup_response.entry_, *static_lookup_response.key_,
-                      std::move(value));
+                      static_entry->intern(std::move(value)));
   } else {
-    std::list<HeaderEntryImpl>::iterator i =
-        headers_.emplace(headers_.end(), std::move(key), std::move(value));
+    HeaderList::iterator i = headers_.emplace(headers_.end(), std::move(key), std::move(value));
     i->entry_ = i;
   }
 }
@@ -323,6 +567,14 @@ void HeaderMapImpl::addStaticKey(const LowerCaseString& key, const std::string&
   ASSERT(new_value.empty());
 }
 
+void HeaderMapImpl::addCopy(const LowerCaseString& key, const std::string& value) {
+  HeaderString new_key;
+  new_key.setCopy(key.get().c_str(), key.get().size());
+  HeaderString new_value;
+  new_value.setCopy(value.c_str(), value.size());
+  insertByKey(std::move(new_key), std::move(new_value));
+}
+
 uint64_t HeaderMapImpl::byteSize() const {
   uint64_t byte_size = 0;
   for (const HeaderEntryImpl& header : headers_) {
@@ -350,9 +602,10 @@ void HeaderMapImpl::iterate(ConstIterateCb cb, void* context) const {
 }
 
 void HeaderMapImpl::remove(const LowerCaseString& key) {
-  StaticLookupEntry::EntryCb cb = ConstSingleton<StaticLookupTable>::get().find(key.get().c_str());
-  if (cb) {
-    StaticLookupResponse static_lookup_response = cb(*this);
+  const StaticLookupEntry* static_entry =
+      ConstSingleton<StaticLookupTable>::get().find(key.get().c_str(), key.get().size());
+  if (static_entry) {
+    StaticLookupResponse static_lookup_response = static_entry->cb_(*this);
     removeInline(static_lookup_response.entry_);
   } else {
     for (auto i = headers_.begin(); i != headers_.end();) {
@@ -371,7 +624,7 @@ HeaderMapImpl::HeaderEntryImpl& HeaderMapImpl::maybeCreateInline(HeaderEntryImpl
     return **entry;
   }
 
-  std::list<HeaderEntryImpl>::iterator i = headers_.emplace(headers_.end(), key);
+  HeaderList::iterator i = headers_.emplace(headers_.end(), key);
   i->entry_ = i;
   *entry = &(*i);
   return **entry;
@@ -385,7 +638,7 @@ HeaderMapImpl::HeaderEntryImpl& HeaderMapImpl::maybeCreateInline(HeaderEntryImpl
     return **entry;
   }
 
-  std::list<HeaderEntryImpl>::iterator i = headers_.emplace(headers_.end(), key, std::move(value));
+  HeaderList::iterator i = headers_.emplace(headers_.end(), key, std::move(value));
   i->entry_ = i;
   *entry = &(*i);
   return **entry;
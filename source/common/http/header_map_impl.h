@@ -5,9 +5,11 @@
 #include <list>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "envoy/http/header_map.h"
 
+#include "common/common/free_list.h"
 #include "common/common/non_copyable.h"
 #include "common/http/headers.h"
 
@@ -28,6 +30,62 @@ public:
 
 #define DEFINE_INLINE_HEADER_STRUCT(name) HeaderEntryImpl* name##_;
 
+/**
+ * A bounded, per-thread cache of fixed size memory blocks. Header maps are created and destroyed
+ * at very high rates on each worker, so recycling their entries avoids most of the malloc traffic
+ * that they would otherwise generate. Blocks may be freed on a different thread than the one that
+ * allocated them; they are simply cached by the freeing thread.
+ */
+class HeaderEntryFreeList : public FreeList {
+public:
+  HeaderEntryFreeList() : FreeList(MaxCachedBlocks) {}
+  ~HeaderEntryFreeList() { release(); }
+
+  /**
+   * @return the calling thread's free list.
+   */
+  static HeaderEntryFreeList& threadLocal();
+
+  // FreeList. Allocations are charged to the header map subsystem.
+  void* allocate(size_t size);
+  void deallocate(void* block, size_t size);
+  void release();
+
+  // The maximum number of blocks cached per thread. This bounds the memory retained by a thread
+  // after a burst of very large header maps.
+  static const size_t MaxCachedBlocks = 4096;
+};
+
+/**
+ * std::list allocator used for header map entries. Single node allocations are served from the
+ * per-thread HeaderEntryFreeList.
+ */
+template <class T> class HeaderEntryAllocator {
+public:
+  typedef T value_type;
+
+  HeaderEntryAllocator() {}
+  template <class U> HeaderEntryAllocator(const HeaderEntryAllocator<U>&) {}
+
+  T* allocate(size_t n) {
+    if (n != 1) {
+      return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    return static_cast<T*>(HeaderEntryFreeList::threadLocal().allocate(sizeof(T)));
+  }
+
+  void deallocate(T* p, size_t n) {
+    if (n != 1) {
+      ::operator delete(p);
+    } else {
+      HeaderEntryFreeList::threadLocal().deallocate(p, sizeof(T));
+    }
+  }
+
+  template <class U> bool operator==(const HeaderEntryAllocator<U>&) const { return true; }
+  template <class U> bool operator!=(const HeaderEntryAllocator<U>&) const { return false; }
+};
+
 /**
  * Implementation of Http::HeaderMap. This is heavily optimized for performance. Roughly, when
  * headers are added to the map, we do a hash lookup to see if it's one of the O(1) headers.
@@ -57,6 +115,7 @@ public:
   void addStatic(const LowerCaseString& key, const std::string& value) override;
   void addStaticKey(const LowerCaseString& key, uint64_t value) override;
   void addStaticKey(const LowerCaseString& key, const std::string& value) override;
+  void addCopy(const LowerCaseString& key, const std::string& value) override;
   uint64_t byteSize() const override;
   const HeaderEntry* get(const LowerCaseString& key) const override;
   void iterate(ConstIterateCb cb, void* context) const override;
@@ -64,6 +123,9 @@ public:
   size_t size() const override { return headers_.size(); }
 
 protected:
+  struct HeaderEntryImpl;
+  typedef std::list<HeaderEntryImpl, HeaderEntryAllocator<HeaderEntryImpl>> HeaderList;
+
   struct HeaderEntryImpl : public HeaderEntry, NonCopyable {
     HeaderEntryImpl(const LowerCaseString& key);
     HeaderEntryImpl(const LowerCaseString& key, HeaderString&& value);
@@ -80,7 +142,7 @@ protected:
 
     HeaderString key_;
     HeaderString value_;
-    std::list<HeaderEntryImpl>::iterator entry_;
+    HeaderList::iterator entry_;
   };
 
   struct StaticLookupResponse {
@@ -91,20 +153,36 @@ protected:
   struct StaticLookupEntry {
     typedef StaticLookupResponse (*EntryCb)(HeaderMapImpl&);
 
-    EntryCb cb_{};
-    std::array<std::unique_ptr<StaticLookupEntry>, 256> entries_;
+    /**
+     * @return a static reference to the matching interned value, or the value itself if it is not
+     *         one of them.
+     */
+    HeaderString intern(HeaderString&& value) const;
+
+    const char* key_;
+    size_t size_;
+    EntryCb cb_;
+    // Common values of the header, which are referenced rather than copied into each map.
+    std::vector<const std::string*> values_;
   };
 
   /**
    * This is the static lookup table that is used to determine whether a header is one of the O(1)
-   * headers. This uses a trie for lookup time at most equal to the size of the incoming string.
+   * headers. Keys are hashed on their length and last character, which spreads the inline headers
+   * across the table with very few collisions, so a lookup is a hash plus usually a single memcmp.
    */
   struct StaticLookupTable {
     StaticLookupTable();
     void add(const char* key, StaticLookupEntry::EntryCb cb);
-    StaticLookupEntry::EntryCb find(const char* key) const;
+    void addValues(const LowerCaseString& key, const std::vector<const std::string*>& values);
+    const StaticLookupEntry* find(const char* key, size_t size) const;
+
+    static size_t hash(const char* key, size_t size) {
+      return (size * 31 + static_cast<uint8_t>(key[size - 1])) & (TableSize - 1);
+    }
 
-    StaticLookupEntry root_;
+    static const size_t TableSize = 256;
+    std::array<std::vector<StaticLookupEntry>, TableSize> buckets_;
   };
 
   struct AllInlineHeaders {
@@ -118,7 +196,7 @@ protected:
   void removeInline(HeaderEntryImpl** entry);
 
   AllInlineHeaders inline_headers_;
-  std::list<HeaderEntryImpl> headers_;
+  HeaderList headers_;
 
   ALL_INLINE_HEADERS(DEFINE_INLINE_HEADER_FUNCS)
 };
@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include "envoy/buffer/buffer.h"
 #include "envoy/http/header_map.h"
@@ -36,25 +37,78 @@ void StreamEncoderImpl::encodeHeader(const char* key, uint32_t key_size, const c
   connection_.addCharToBuffer('\n');
 }
 
-void StreamEncoderImpl::encodeHeaders(const HeaderMap& headers, bool end_stream) {
-  bool saw_content_length = false;
+void StreamEncoderImpl::encodeHeaderEntry(const HeaderEntry& header) {
+  const char* key_to_use = header.key().c_str();
+  uint32_t key_size_to_use = header.key().size();
+  // Translate :authority -> host so that upper layers do not need to deal with this.
+  if (key_size_to_use > 1 && key_to_use[0] == ':' && key_to_use[1] == 'a') {
+    key_to_use = Headers::get().HostLegacy.get().c_str();
+    key_size_to_use = Headers::get().HostLegacy.get().size();
+  }
+
+  // Skip all headers starting with ':' that make it here.
+  if (key_to_use[0] == ':') {
+    return;
+  }
+
+  encodeHeader(key_to_use, key_size_to_use, header.value().c_str(), header.value().size());
+}
+
+bool StreamEncoderImpl::encodeRawHeaders(const HeaderMap& headers) {
+  struct Match {
+    const RawHeaderBlock* block_;
+    uint64_t headers_;
+    bool failed_;
+  };
+
+  // A value gives back its reference to the block when it is modified, so the block can only be
+  // used if every decoded header still points into it. The decoded headers come first in the map,
+  // so a map whose first header does not point into a block is given up on right away.
+  Match match{nullptr, 0, false};
   headers.iterate([](const HeaderEntry& header, void* context) -> void {
-    const char* key_to_use = header.key().c_str();
-    uint32_t key_size_to_use = header.key().size();
-    // Translate :authority -> host so that upper layers do not need to deal with this.
-    if (key_size_to_use > 1 && key_to_use[0] == ':' && key_to_use[1] == 'a') {
-      key_to_use = Headers::get().HostLegacy.get().c_str();
-      key_size_to_use = Headers::get().HostLegacy.get().size();
+    Match& match = *static_cast<Match*>(context);
+    if (match.failed_) {
+      return;
     }
 
-    // Skip all headers starting with ':' that make it here.
-    if (key_to_use[0] == ':') {
+    const RawHeaderBlock* block = RawHeaderBlock::fromValue(header.value());
+    if (!block) {
+      match.failed_ = match.block_ == nullptr;
       return;
     }
 
-    static_cast<StreamEncoderImpl*>(context)
-        ->encodeHeader(key_to_use, key_size_to_use, header.value().c_str(), header.value().size());
+    match.failed_ = match.block_ != nullptr && match.block_ != block;
+    match.block_ = block;
+    match.headers_++;
+  }, &match);
+
+  if (match.failed_ || !match.block_ || match.headers_ != match.block_->lines().size()) {
+    return false;
+  }
+
+  const std::string& data = match.block_->data();
+  connection_.reserveBuffer(data.size() + match.block_->lines().size());
+  for (const RawHeaderBlock::Line& line : match.block_->lines()) {
+    connection_.copyToBuffer(data.c_str() + line.offset_, line.length_);
+    connection_.addCharToBuffer('\r');
+    connection_.addCharToBuffer('\n');
+  }
+
+  headers.iterate([](const HeaderEntry& header, void* context) -> void {
+    if (!RawHeaderBlock::fromValue(header.value())) {
+      static_cast<StreamEncoderImpl*>(context)->encodeHeaderEntry(header);
+    }
   }, this);
+  return true;
+}
+
+void StreamEncoderImpl::encodeHeaders(const HeaderMap& headers, bool end_stream) {
+  bool saw_content_length = false;
+  if (!encodeRawHeaders(headers)) {
+    headers.iterate([](const HeaderEntry& header, void* context) -> void {
+      static_cast<StreamEncoderImpl*>(context)->encodeHeaderEntry(header);
+    }, this);
+  }
 
   if (headers.ContentLength()) {
     saw_content_length = true;
@@ -175,23 +229,48 @@ void StreamEncoderImpl::resetStream(StreamResetReason reason) {
   connection_.onResetStreamBase(reason);
 }
 
+void StreamEncoderImpl::readDisable(bool disable) { connection_.connection().readDisable(disable); }
+
 static const char RESPONSE_PREFIX[] = "HTTP/1.1 ";
 
+const std::string* ResponseStreamEncoderImpl::statusLine(uint64_t status) {
+  // The status lines never change, so they are serialized once and shared by all workers.
+  static const std::vector<std::string> status_lines = []() -> std::vector<std::string> {
+    std::vector<std::string> status_lines;
+    for (uint64_t code = MinStatusLine; code <= MaxStatusLine; code++) {
+      status_lines.emplace_back(fmt::format("{}{} {}\r\n", RESPONSE_PREFIX, code,
+                                            CodeUtility::toString(static_cast<Code>(code))));
+    }
+    return status_lines;
+  }();
+
+  if (status < MinStatusLine || status > MaxStatusLine) {
+    return nullptr;
+  }
+
+  return &status_lines[status - MinStatusLine];
+}
+
 void ResponseStreamEncoderImpl::encodeHeaders(const HeaderMap& headers, bool end_stream) {
   started_response_ = true;
   uint64_t numeric_status = Utility::getResponseStatus(headers);
 
   connection_.reserveBuffer(4096);
-  connection_.copyToBuffer(RESPONSE_PREFIX, sizeof(RESPONSE_PREFIX) - 1);
-  connection_.addIntToBuffer(numeric_status);
-  connection_.addCharToBuffer(' ');
+  const std::string* status_line = statusLine(numeric_status);
+  if (status_line != nullptr) {
+    connection_.copyToBuffer(status_line->c_str(), status_line->size());
+  } else {
+    connection_.copyToBuffer(RESPONSE_PREFIX, sizeof(RESPONSE_PREFIX) - 1);
+    connection_.addIntToBuffer(numeric_status);
+    connection_.addCharToBuffer(' ');
 
-  const char* status_string = CodeUtility::toString(static_cast<Code>(numeric_status));
-  uint32_t status_string_len = strlen(status_string);
-  connection_.copyToBuffer(status_string, status_string_len);
+    const char* status_string = CodeUtility::toString(static_cast<Code>(numeric_status));
+    uint32_t status_string_len = strlen(status_string);
+    connection_.copyToBuffer(status_string, status_string_len);
 
-  connection_.addCharToBuffer('\r');
-  connection_.addCharToBuffer('\n');
+    connection_.addCharToBuffer('\r');
+    connection_.addCharToBuffer('\n');
+  }
 
   StreamEncoderImpl::encodeHeaders(headers, end_stream);
 }
@@ -218,68 +297,21 @@ void RequestStreamEncoderImpl::encodeHeaders(const HeaderMap& headers, bool end_
   StreamEncoderImpl::encodeHeaders(headers, end_stream);
 }
 
-http_parser_settings ConnectionImpl::settings_{
-    [](http_parser* parser) -> int {
-      static_cast<ConnectionImpl*>(parser->data)->onMessageBeginBase();
-      return 0;
-    },
-    [](http_parser* parser, const char* at, size_t length) -> int {
-      static_cast<ConnectionImpl*>(parser->data)->onUrl(at, length);
-      return 0;
-    },
-    nullptr, // on_status
-    [](http_parser* parser, const char* at, size_t length) -> int {
-      static_cast<ConnectionImpl*>(parser->data)->onHeaderField(at, length);
-      return 0;
-    },
-    [](http_parser* parser, const char* at, size_t length) -> int {
-      static_cast<ConnectionImpl*>(parser->data)->onHeaderValue(at, length);
-      return 0;
-    },
-    [](http_parser* parser)
-        -> int { return static_cast<ConnectionImpl*>(parser->data)->onHeadersCompleteBase(); },
-    [](http_parser* parser, const char* at, size_t length) -> int {
-      static_cast<ConnectionImpl*>(parser->data)->onBody(at, length);
-      return 0;
-    },
-    [](http_parser* parser) -> int {
-      static_cast<ConnectionImpl*>(parser->data)->onMessageComplete();
-      return 0;
-    },
-    nullptr, // on_chunk_header
-    nullptr  // on_chunk_complete
-};
-
 const ToLowerTable& ConnectionImpl::toLowerTable() {
   static ToLowerTable* table = new ToLowerTable();
   return *table;
 }
 
-ConnectionImpl::ConnectionImpl(Network::Connection& connection, http_parser_type type)
-    : connection_(connection) {
-  http_parser_init(&parser_, type);
-  parser_.data = this;
-}
-
-void ConnectionImpl::completeLastHeader() {
-  conn_log_trace("completed header: key={} value={}", connection_, current_header_field_.c_str(),
-                 current_header_value_.c_str());
-  if (!current_header_field_.empty()) {
-    toLowerTable().toLowerCase(current_header_field_.buffer(), current_header_field_.size());
-    current_header_map_->addViaMove(std::move(current_header_field_),
-                                    std::move(current_header_value_));
-  }
-
-  header_parsing_state_ = HeaderParsingState::Field;
-  ASSERT(current_header_field_.empty());
-  ASSERT(current_header_value_.empty());
-}
+ConnectionImpl::ConnectionImpl(Network::Connection& connection, Parser::Type type,
+                               const HeaderLimits& header_limits, bool forward_raw_headers)
+    : connection_(connection), parser_callbacks_(*this),
+      parser_(type, parser_callbacks_, header_limits), forward_raw_headers_(forward_raw_headers) {}
 
 void ConnectionImpl::dispatch(Buffer::Instance& data) {
   conn_log_trace("parsing {} bytes", connection_, data.length());
 
   // Always unpause before dispatch.
-  http_parser_pause(&parser_, 0);
+  parser_.pause(false);
 
   ssize_t total_parsed = 0;
   if (data.length() > 0) {
@@ -298,70 +330,72 @@ void ConnectionImpl::dispatch(Buffer::Instance& data) {
 }
 
 size_t ConnectionImpl::dispatchSlice(const char* slice, size_t len) {
-  ssize_t rc = http_parser_execute(&parser_, &settings_, slice, len);
-  if (HTTP_PARSER_ERRNO(&parser_) != HPE_OK && HTTP_PARSER_ERRNO(&parser_) != HPE_PAUSED) {
+  size_t rc = parser_.execute(slice, len);
+  if (parser_.error() != Parser::Error::None) {
     sendProtocolError();
     throw CodecProtocolException("http/1.1 protocol error: " +
-                                 std::string(http_errno_name(HTTP_PARSER_ERRNO(&parser_))));
+                                 std::string(Parser::errorName(parser_.error())));
   }
 
   return rc;
 }
 
-void ConnectionImpl::onHeaderField(const char* data, size_t length) {
-  if (header_parsing_state_ == HeaderParsingState::Done) {
-    // Ignore trailers.
+void ConnectionImpl::onHeader(const char* name, size_t name_length, const char* value,
+                              size_t value_length) {
+  // Trailers are not reported by the parser, so every header belongs to the current message.
+  if (current_raw_headers_) {
+    current_raw_headers_->add(name, name_length, value, value_length);
     return;
   }
 
-  if (header_parsing_state_ == HeaderParsingState::Value) {
-    completeLastHeader();
-  }
-
-  current_header_field_.append(data, length);
+  HeaderString key;
+  key.setCopy(name, name_length);
+  toLowerTable().toLowerCase(key.buffer(), key.size());
+  HeaderString header_value;
+  header_value.setCopy(value, value_length);
+  conn_log_trace("completed header: key={} value={}", connection_, key.c_str(),
+                 header_value.c_str());
+  current_header_map_->addViaMove(std::move(key), std::move(header_value));
 }
 
-void ConnectionImpl::onHeaderValue(const char* data, size_t length) {
-  if (header_parsing_state_ == HeaderParsingState::Done) {
-    // Ignore trailers.
-    return;
-  }
-
-  header_parsing_state_ = HeaderParsingState::Value;
-  current_header_value_.append(data, length);
-}
-
-int ConnectionImpl::onHeadersCompleteBase() {
+bool ConnectionImpl::onHeadersCompleteBase() {
   conn_log_trace("headers complete", connection_);
-  completeLastHeader();
-  if (!(parser_.http_major == 1 && parser_.http_minor == 1)) {
+  if (!(parser_.httpMajor() == 1 && parser_.httpMinor() == 1)) {
     // This is not necessarily true, but it's good enough since higher layers only care if this is
     // HTTP/1.1 or not.
     protocol_ = Protocol::Http10;
   }
 
-  int rc = onHeadersComplete(std::move(current_header_map_));
+  if (current_raw_headers_) {
+    RawHeaderBlock::moveIntoMap(std::move(current_raw_headers_), *current_header_map_);
+  }
+
+  bool rc = onHeadersComplete(std::move(current_header_map_));
   current_header_map_.reset();
-  header_parsing_state_ = HeaderParsingState::Done;
   return rc;
 }
 
 void ConnectionImpl::onMessageBeginBase() {
   ASSERT(!current_header_map_);
   current_header_map_.reset(new HeaderMapImpl());
-  header_parsing_state_ = HeaderParsingState::Field;
+  if (forward_raw_headers_) {
+    current_raw_headers_.reset(new RawHeaderBlock(toLowerTable()));
+  }
   onMessageBegin();
 }
 
 void ConnectionImpl::onResetStreamBase(StreamResetReason reason) {
-  ASSERT(!reset_stream_called_);
   reset_stream_called_ = true;
   onResetStream(reason);
 }
 
 ServerConnectionImpl::ServerConnectionImpl(Network::Connection& connection,
-                                           ServerConnectionCallbacks& callbacks)
-    : ConnectionImpl(connection, HTTP_REQUEST), callbacks_(callbacks) {}
+                                           ServerConnectionCallbacks& callbacks,
+                                           const HeaderLimits& header_limits,
+                                           const Http1Settings& http1_settings)
+    : ConnectionImpl(connection, Parser::Type::Request, header_limits,
+                     http1_settings.forward_raw_headers_),
+      callbacks_(callbacks) {}
 
 void ServerConnectionImpl::onEncodeComplete() {
   ASSERT(active_request_);
@@ -373,7 +407,7 @@ void ServerConnectionImpl::onEncodeComplete() {
   }
 }
 
-int ServerConnectionImpl::onHeadersComplete(HeaderMapImplPtr&& headers) {
+bool ServerConnectionImpl::onHeadersComplete(HeaderMapImplPtr&& headers) {
   // Handle the case where response happens prior to request complete. It's up to upper layer code
   // to disconnect the connection but we shouldn't fire any more events since it doesn't make
   // sense.
@@ -382,8 +416,8 @@ int ServerConnectionImpl::onHeadersComplete(HeaderMapImplPtr&& headers) {
     headers->addViaMove(std::move(path), std::move(active_request_->request_url_));
     ASSERT(active_request_->request_url_.empty());
 
-    const char* method_string = http_method_str(static_cast<http_method>(parser_.method));
-    headers->insertMethod().value(method_string, strlen(method_string));
+    const std::string& method = parser_.method();
+    headers->insertMethod().value(method.c_str(), method.size());
 
     // Deal with expect: 100-continue here since higher layers are never going to do anything other
     // than say to continue so that we can respond before request complete if necessary.
@@ -401,14 +435,14 @@ int ServerConnectionImpl::onHeadersComplete(HeaderMapImplPtr&& headers) {
     // with message complete. This allows upper layers to behave like HTTP/2 and prevents a proxy
     // scenario where the higher layers stream through and implicitly switch to chunked transfer
     // encoding because end stream with zero body length has not yet been indicated.
-    if (parser_.flags & F_CHUNKED ||
-        (parser_.content_length > 0 && parser_.content_length != ULLONG_MAX)) {
+    if (parser_.chunked() ||
+        (parser_.contentLength().valid() && parser_.contentLength().value() > 0)) {
       active_request_->request_decoder_->decodeHeaders(std::move(headers), false);
 
       // If the connection has been closed (or is closing) after decoding headers, pause the parser
       // so we return control to the caller.
       if (connection_.state() != Network::Connection::State::Open) {
-        http_parser_pause(&parser_, 1);
+        parser_.pause(true);
       }
 
     } else {
@@ -416,7 +450,7 @@ int ServerConnectionImpl::onHeadersComplete(HeaderMapImplPtr&& headers) {
     }
   }
 
-  return 0;
+  return false;
 }
 
 void ServerConnectionImpl::onMessageBegin() {
@@ -460,7 +494,7 @@ void ServerConnectionImpl::onMessageComplete() {
   // Always pause the parser so that the calling code can process 1 request at a time and apply
   // back pressure. However this means that the calling code needs to detect if there is more data
   // in the buffer and dispatch it again.
-  http_parser_pause(&parser_, 1);
+  parser_.pause(true);
 }
 
 void ServerConnectionImpl::onResetStream(StreamResetReason reason) {
@@ -484,11 +518,11 @@ void ServerConnectionImpl::sendProtocolError() {
 }
 
 ClientConnectionImpl::ClientConnectionImpl(Network::Connection& connection, ConnectionCallbacks&)
-    : ConnectionImpl(connection, HTTP_RESPONSE) {}
+    : ConnectionImpl(connection, Parser::Type::Response, HeaderLimits()) {}
 
 bool ClientConnectionImpl::cannotHaveBody() {
   if ((!pending_responses_.empty() && pending_responses_.front().head_request_) ||
-      parser_.status_code == 204 || parser_.status_code == 304) {
+      parser_.statusCode() == 204 || parser_.statusCode() == 304) {
     return true;
   } else {
     return false;
@@ -500,18 +534,17 @@ StreamEncoder& ClientConnectionImpl::newStream(StreamDecoder& response_decoder)
     throw CodecClientException("cannot create new streams after calling reset");
   }
 
-  request_encoder_.reset(new RequestStreamEncoderImpl(*this));
-  pending_responses_.emplace_back(&response_decoder);
-  return *request_encoder_;
+  pending_responses_.emplace_back(&response_decoder, *this);
+  return *pending_responses_.back().encoder_;
 }
 
 void ClientConnectionImpl::onEncodeComplete() {
-  // Transfer head request state into the pending response before we reuse the encoder.
-  pending_responses_.back().head_request_ = request_encoder_->headRequest();
+  // Only the most recent request can still be encoding.
+  pending_responses_.back().head_request_ = pending_responses_.back().encoder_->headRequest();
 }
 
-int ClientConnectionImpl::onHeadersComplete(HeaderMapImplPtr&& headers) {
-  headers->insertStatus().value(parser_.status_code);
+bool ClientConnectionImpl::onHeadersComplete(HeaderMapImplPtr&& headers) {
+  headers->insertStatus().value(parser_.statusCode());
 
   // Handle the case where the client is closing a kept alive connection (by sending a 408
   // with a 'Connection: close' header). In this case we just let response flush out followed
@@ -526,9 +559,8 @@ int ClientConnectionImpl::onHeadersComplete(HeaderMapImplPtr&& headers) {
     }
   }
 
-  // Here we deal with cases where the response cannot have a body, but http_parser does not deal
-  // with it for us.
-  return cannotHaveBody() ? 1 : 0;
+  // The parser cannot know that the response to a HEAD request has no body.
+  return cannotHaveBody();
 }
 
 void ClientConnectionImpl::onBody(const char* data, size_t length) {
@@ -543,7 +575,7 @@ void ClientConnectionImpl::onBody(const char* data, size_t length) {
 void ClientConnectionImpl::onMessageComplete() {
   if (!pending_responses_.empty()) {
     // After calling decodeData() with end stream set to true, we should no longer be able to reset.
-    PendingResponse response = pending_responses_.front();
+    PendingResponse response = std::move(pending_responses_.front());
     pending_responses_.pop_front();
 
     if (deferred_end_stream_headers_) {
@@ -553,14 +585,18 @@ void ClientConnectionImpl::onMessageComplete() {
       Buffer::OwnedImpl buffer;
       response.decoder_->decodeData(buffer, true);
     }
+    completed_encoder_ = std::move(response.encoder_);
   }
 }
 
 void ClientConnectionImpl::onResetStream(StreamResetReason reason) {
-  // Only raise reset if we did not already dispatch a complete response.
-  if (!pending_responses_.empty()) {
-    pending_responses_.clear();
-    request_encoder_->runResetCallbacks(reason);
+  // Only raise reset for requests whose response has not been dispatched yet. Pipelined requests
+  // cannot be reset individually, so they are all reset. Each is taken off the pending list before
+  // its callbacks run, as they may reset the next one.
+  while (!pending_responses_.empty()) {
+    reset_responses_.splice(reset_responses_.end(), pending_responses_,
+                            pending_responses_.begin());
+    reset_responses_.back().encoder_->runResetCallbacks(reason);
   }
 }
 
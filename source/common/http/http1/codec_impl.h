@@ -14,8 +14,8 @@
 #include "common/common/to_lower_table.h"
 #include "common/http/codec_helper.h"
 #include "common/http/header_map_impl.h"
-
-#include "http_parser.h"
+#include "common/http/http1/parser.h"
+#include "common/http/http1/raw_header_block.h"
 
 namespace Envoy {
 namespace Http {
@@ -41,6 +41,7 @@ public:
   void addCallbacks(StreamCallbacks& callbacks) override { addCallbacks_(callbacks); }
   void removeCallbacks(StreamCallbacks& callbacks) override { removeCallbacks_(callbacks); }
   void resetStream(StreamResetReason reason) override;
+  void readDisable(bool disable) override;
 
 protected:
   StreamEncoderImpl(ConnectionImpl& connection) : connection_(connection) {}
@@ -60,6 +61,20 @@ private:
    */
   void encodeHeader(const char* key, uint32_t key_size, const char* value, uint32_t value_size);
 
+  /**
+   * Called to encode an individual header entry. Pseudo-headers other than :authority, which is
+   * encoded as host, are skipped.
+   */
+  void encodeHeaderEntry(const HeaderEntry& header);
+
+  /**
+   * Encode headers that were decoded with a raw header block from the block. This is only done if
+   * none of the decoded headers has been modified or removed. Headers that have been added are
+   * encoded after the block.
+   * @return bool whether the headers were encoded.
+   */
+  bool encodeRawHeaders(const HeaderMap& headers);
+
   /**
    * Called to finalize a stream encode.
    */
@@ -80,7 +95,16 @@ public:
   // Http::StreamEncoder
   void encodeHeaders(const HeaderMap& headers, bool end_stream) override;
 
+  /**
+   * @return the serialized status line, including the trailing CRLF, for a response status or
+   *         nullptr if the status is outside the range of precomputed lines.
+   */
+  static const std::string* statusLine(uint64_t status);
+
 private:
+  static const uint64_t MinStatusLine = 100;
+  static const uint64_t MaxStatusLine = 599;
+
   bool started_response_{};
 };
 
@@ -118,7 +142,9 @@ public:
   /**
    * Called when resetStream() has been called on an active stream. In HTTP/1.1 the only
    * valid operation after this point is for the connection to get blown away, but we will not
-   * fire any more callbacks in case some stack has to unwind.
+   * fire any more callbacks in case some stack has to unwind. A client connection with pipelined
+   * requests resets all of them, and their owners may reset the ones that are still to go while
+   * that is in progress, so this can be called more than once.
    */
   void onResetStreamBase(StreamResetReason reason);
 
@@ -142,21 +168,38 @@ public:
   bool wantsToWrite() override { return false; }
 
 protected:
-  ConnectionImpl(Network::Connection& connection, http_parser_type type);
+  /**
+   * @param forward_raw_headers supplies whether to decode headers with a raw header block.
+   */
+  ConnectionImpl(Network::Connection& connection, Parser::Type type,
+                 const HeaderLimits& header_limits, bool forward_raw_headers = false);
 
   bool resetStreamCalled() { return reset_stream_called_; }
 
   Network::Connection& connection_;
-  http_parser parser_;
   HeaderMapPtr deferred_end_stream_headers_;
 
 private:
-  enum class HeaderParsingState { Field, Value, Done };
-
   /**
-   * Called in order to complete an in progress header decode.
+   * Forwards parser events to the connection. The parser callbacks are kept apart from the
+   * connection's own hooks, which run after the common handling in the connection.
    */
-  void completeLastHeader();
+  struct ParserCallbacksImpl : public ParserCallbacks {
+    ParserCallbacksImpl(ConnectionImpl& parent) : parent_(parent) {}
+
+    // Http1::ParserCallbacks
+    void onMessageBegin() override { parent_.onMessageBeginBase(); }
+    void onUrl(const char* data, size_t length) override { parent_.onUrl(data, length); }
+    void onHeader(const char* name, size_t name_length, const char* value,
+                  size_t value_length) override {
+      parent_.onHeader(name, name_length, value, value_length);
+    }
+    bool onHeadersComplete() override { return parent_.onHeadersCompleteBase(); }
+    void onBody(const char* data, size_t length) override { parent_.onBody(data, length); }
+    void onMessageComplete() override { parent_.onMessageComplete(); }
+
+    ConnectionImpl& parent_;
+  };
 
   /**
    * Dispatch a memory span.
@@ -180,26 +223,21 @@ private:
   virtual void onUrl(const char* data, size_t length) PURE;
 
   /**
-   * Called when header field data is received.
-   * @param data supplies the start address.
-   * @param length supplies the length.
-   */
-  void onHeaderField(const char* data, size_t length);
-
-  /**
-   * Called when header value data is received.
-   * @param data supplies the start address.
-   * @param length supplies the length.
+   * Called when a complete header is received.
+   * @param name supplies the start address of the header name.
+   * @param name_length supplies the length of the header name.
+   * @param value supplies the start address of the header value.
+   * @param value_length supplies the length of the header value.
    */
-  void onHeaderValue(const char* data, size_t length);
+  void onHeader(const char* name, size_t name_length, const char* value, size_t value_length);
 
   /**
    * Called when headers are complete. A base routine happens first then a virtual disaptch is
    * invoked.
-   * @return 0 if no error, 1 if there should be no body.
+   * @return bool true if there should be no body.
    */
-  int onHeadersCompleteBase();
-  virtual int onHeadersComplete(HeaderMapImplPtr&& headers) PURE;
+  bool onHeadersCompleteBase();
+  virtual bool onHeadersComplete(HeaderMapImplPtr&& headers) PURE;
 
   /**
    * Called when body data is received.
@@ -223,13 +261,17 @@ private:
    */
   virtual void sendProtocolError() PURE;
 
-  static http_parser_settings settings_;
   static const ToLowerTable& toLowerTable();
 
+  ParserCallbacksImpl parser_callbacks_;
+
+protected:
+  Parser parser_;
+
+private:
+  const bool forward_raw_headers_;
   HeaderMapImplPtr current_header_map_;
-  HeaderParsingState header_parsing_state_{HeaderParsingState::Field};
-  HeaderString current_header_field_;
-  HeaderString current_header_value_;
+  RawHeaderBlockPtr current_raw_headers_;
   bool reset_stream_called_{};
   Buffer::OwnedImpl output_buffer_;
   Buffer::RawSlice reserved_iovec_;
@@ -242,7 +284,21 @@ private:
  */
 class ServerConnectionImpl : public ServerConnection, public ConnectionImpl {
 public:
-  ServerConnectionImpl(Network::Connection& connection, ServerConnectionCallbacks& callbacks);
+  ServerConnectionImpl(Network::Connection& connection, ServerConnectionCallbacks& callbacks,
+                       const HeaderLimits& header_limits,
+                       const Http1Settings& http1_settings = Http1Settings());
+
+  // Http::Connection
+  void onUnderlyingConnectionAboveWriteBufferHighWatermark() override {
+    if (active_request_) {
+      active_request_->response_encoder_.runHighWatermarkCallbacks();
+    }
+  }
+  void onUnderlyingConnectionBelowWriteBufferLowWatermark() override {
+    if (active_request_) {
+      active_request_->response_encoder_.runLowWatermarkCallbacks();
+    }
+  }
 
 private:
   /**
@@ -261,7 +317,7 @@ private:
   void onEncodeComplete() override;
   void onMessageBegin() override;
   void onUrl(const char* data, size_t length) override;
-  int onHeadersComplete(HeaderMapImplPtr&& headers) override;
+  bool onHeadersComplete(HeaderMapImplPtr&& headers) override;
   void onBody(const char* data, size_t length) override;
   void onMessageComplete() override;
   void onResetStream(StreamResetReason reason) override;
@@ -280,12 +336,31 @@ public:
 
   // Http::ClientConnection
   StreamEncoder& newStream(StreamDecoder& response_decoder) override;
+  uint64_t maxConcurrentStreams() override { return 1; }
+
+  // Http::Connection
+  void onUnderlyingConnectionAboveWriteBufferHighWatermark() override {
+    if (!pending_responses_.empty()) {
+      pending_responses_.back().encoder_->runHighWatermarkCallbacks();
+    }
+  }
+  void onUnderlyingConnectionBelowWriteBufferLowWatermark() override {
+    if (!pending_responses_.empty()) {
+      pending_responses_.back().encoder_->runLowWatermarkCallbacks();
+    }
+  }
 
 private:
+  /**
+   * A request whose response has not been received yet. Requests may be pipelined, a new one can
+   * be started as soon as the previous one has been encoded, and their responses arrive in order.
+   */
   struct PendingResponse {
-    PendingResponse(StreamDecoder* decoder) : decoder_(decoder) {}
+    PendingResponse(StreamDecoder* decoder, ConnectionImpl& connection)
+        : decoder_(decoder), encoder_(new RequestStreamEncoderImpl(connection)) {}
 
     StreamDecoder* decoder_;
+    std::unique_ptr<RequestStreamEncoderImpl> encoder_;
     bool head_request_{};
   };
 
@@ -295,14 +370,17 @@ private:
   void onEncodeComplete() override;
   void onMessageBegin() override {}
   void onUrl(const char*, size_t) override { NOT_IMPLEMENTED; }
-  int onHeadersComplete(HeaderMapImplPtr&& headers) override;
+  bool onHeadersComplete(HeaderMapImplPtr&& headers) override;
   void onBody(const char* data, size_t length) override;
   void onMessageComplete() override;
   void onResetStream(StreamResetReason reason) override;
   void sendProtocolError() override {}
 
-  std::unique_ptr<RequestStreamEncoderImpl> request_encoder_;
   std::list<PendingResponse> pending_responses_;
+  // Encoders stay alive after their response has been dispatched or their stream reset, as their
+  // owners may still refer to them until the stack unwinds.
+  std::unique_ptr<RequestStreamEncoderImpl> completed_encoder_;
+  std::list<PendingResponse> reset_responses_;
 };
 
 } // Http1
@@ -1,5 +1,6 @@
 #include "common/http/http1/conn_pool.h"
 
+#include <cmath>
 #include <cstdint>
 #include <list>
 
@@ -13,6 +14,7 @@
 #include "common/http/codec_client.h"
 #include "common/http/codes.h"
 #include "common/http/headers.h"
+#include "common/memory/accounting.h"
 #include "common/network/utility.h"
 #include "common/upstream/upstream_impl.h"
 
@@ -40,9 +42,23 @@ void ConnPoolImpl::addDrainedCallback(DrainedCb cb) {
 
 void ConnPoolImpl::attachRequestToClient(ActiveClient& client, StreamDecoder& response_decoder,
                                          ConnectionPool::Callbacks& callbacks) {
-  ASSERT(!client.stream_wrapper_);
-  client.stream_wrapper_.reset(new StreamWrapper(response_decoder, client));
-  callbacks.onPoolReady(*client.stream_wrapper_, client.real_host_description_);
+  ASSERT(client.stream_wrappers_.empty() || canPipeline(client));
+  client.prefetched_ = false;
+  client.stream_wrappers_.emplace_back(new StreamWrapper(response_decoder, client));
+  callbacks.onPoolReady(*client.stream_wrappers_.back(), client.real_host_description_);
+}
+
+bool ConnPoolImpl::canPipeline(const ActiveClient& client) {
+  // A request can follow the previous one once that has been encoded, unless the connection is
+  // going to be closed after a response.
+  if (client.stream_wrappers_.empty() || client.stream_wrappers_.size() >= pipelineDepth() ||
+      !client.stream_wrappers_.back()->encode_complete_ ||
+      client.stream_wrappers_.front()->saw_close_header_ || client.codec_client_->remoteClosed()) {
+    return false;
+  }
+
+  return client.remaining_requests_ == 0 ||
+         client.stream_wrappers_.size() < client.remaining_requests_;
 }
 
 void ConnPoolImpl::checkForDrained() {
@@ -57,21 +73,68 @@ void ConnPoolImpl::checkForDrained() {
   }
 }
 
-void ConnPoolImpl::createNewConnection() {
+void ConnPoolImpl::disablePipelining(ActiveClient& client) {
+  // Requests that were queued behind another one are lost with the connection. The upstream does
+  // not cope with pipelining, so stop.
+  if (client.stream_wrappers_.size() > 1 && !pipelining_disabled_) {
+    conn_log_debug("lost pipelined requests, disabling pipelining", *client.codec_client_);
+    host_->cluster().stats().upstream_cx_pipeline_disabled_.inc();
+    pipelining_disabled_ = true;
+  }
+}
+
+void ConnPoolImpl::createNewConnection(bool prefetched) {
   log_debug("creating a new connection");
-  ActiveClientPtr client(new ActiveClient(*this));
+  Memory::AccountingScope accounting(Memory::Subsystem::ConnPool);
+  ActiveClientPtr client(new ActiveClient(*this, prefetched));
   client->moveIntoList(std::move(client), busy_clients_);
 }
 
+uint64_t ConnPoolImpl::maxRequestsForNewConnection() {
+  // Lower the limit of each connection by a random part of the jitter, so that connections that
+  // were opened together do not all reach the limit, and reconnect, at the same time.
+  const uint64_t max_requests = host_->cluster().maxRequestsPerConnection();
+  const uint64_t jitter =
+      max_requests * host_->cluster().maxRequestsPerConnectionJitterPercent() / 100;
+  return jitter == 0 ? max_requests : max_requests - random_.random() % (jitter + 1);
+}
+
 ConnectionPool::Cancellable* ConnPoolImpl::newStream(StreamDecoder& response_decoder,
                                                      ConnectionPool::Callbacks& callbacks) {
   if (!ready_clients_.empty()) {
+    if (ready_clients_.front()->idle_timer_) {
+      ready_clients_.front()->idle_timer_->disableTimer();
+    }
     ready_clients_.front()->moveBetweenLists(ready_clients_, busy_clients_);
     conn_log_debug("using existing connection", *busy_clients_.front()->codec_client_);
+    if (busy_clients_.front()->prefetched_) {
+      host_->cluster().stats().upstream_rq_prefetch_hit_.inc();
+    }
     attachRequestToClient(*busy_clients_.front(), response_decoder, callbacks);
+    prefetchConnections();
     return nullptr;
   }
 
+  if (pipelineDepth() > 1) {
+    // Pipeline the request on the connection with the fewest requests in flight rather than open
+    // a new connection.
+    ActiveClient* least_busy = nullptr;
+    for (const ActiveClientPtr& client : busy_clients_) {
+      if (canPipeline(*client) &&
+          (!least_busy ||
+           client->stream_wrappers_.size() < least_busy->stream_wrappers_.size())) {
+        least_busy = client.get();
+      }
+    }
+
+    if (least_busy) {
+      conn_log_debug("pipelining on existing connection", *least_busy->codec_client_);
+      host_->cluster().stats().upstream_rq_pipelined_.inc();
+      attachRequestToClient(*least_busy, response_decoder, callbacks);
+      return nullptr;
+    }
+  }
+
   if (host_->cluster().resourceManager(priority_).pendingRequests().canCreate()) {
     bool can_create_connection =
         host_->cluster().resourceManager(priority_).connections().canCreate();
@@ -87,6 +150,7 @@ ConnectionPool::Cancellable* ConnPoolImpl::newStream(StreamDecoder& response_dec
     log_debug("queueing request due to no available connections");
     PendingRequestPtr pending_request(new PendingRequest(*this, response_decoder, callbacks));
     pending_request->moveIntoList(std::move(pending_request), pending_requests_);
+    prefetchConnections();
     return pending_requests_.front().get();
   } else {
     log_debug("max pending requests overflow");
@@ -103,8 +167,9 @@ void ConnPoolImpl::onConnectionEvent(ActiveClient& client, uint32_t events) {
     conn_log_debug("client disconnected", *client.codec_client_);
     ActiveClientPtr removed;
     bool check_for_drained = true;
-    if (client.stream_wrapper_) {
-      if (!client.stream_wrapper_->decode_complete_) {
+    if (!client.stream_wrappers_.empty()) {
+      // Responses arrive in order, so all are complete if the last one is.
+      if (!client.stream_wrappers_.back()->decode_complete_) {
         if (events & Network::ConnectionEvent::LocalClose) {
           host_->cluster().stats().upstream_cx_destroy_local_with_active_rq_.inc();
         }
@@ -113,6 +178,9 @@ void ConnPoolImpl::onConnectionEvent(ActiveClient& client, uint32_t events) {
         }
         host_->cluster().stats().upstream_cx_destroy_with_active_rq_.inc();
       }
+      if (events & Network::ConnectionEvent::RemoteClose) {
+        disablePipelining(client);
+      }
 
       // There is an active request attached to this client. The underlying codec client will
       // already have "reset" the stream to fire the reset callback. All we do here is just
@@ -180,34 +248,72 @@ void ConnPoolImpl::onPendingRequestCancel(PendingRequest& request) {
 
 void ConnPoolImpl::onResponseComplete(ActiveClient& client) {
   conn_log_debug("response complete", *client.codec_client_);
-  if (!client.stream_wrapper_->encode_complete_) {
+  const StreamWrapper& stream_wrapper = *client.stream_wrappers_.front();
+  if (!stream_wrapper.encode_complete_) {
     conn_log_debug("response before request complete", *client.codec_client_);
     onDownstreamReset(client);
-  } else if (client.stream_wrapper_->saw_close_header_ || client.codec_client_->remoteClosed()) {
+  } else if (stream_wrapper.saw_close_header_ || client.codec_client_->remoteClosed()) {
     conn_log_debug("saw upstream connection: close", *client.codec_client_);
+    disablePipelining(client);
     onDownstreamReset(client);
   } else if (client.remaining_requests_ > 0 && --client.remaining_requests_ == 0) {
     conn_log_debug("maximum requests per connection", *client.codec_client_);
     host_->cluster().stats().upstream_cx_max_requests_.inc();
     onDownstreamReset(client);
   } else {
-    processIdleClient(client);
+    client.stream_wrappers_.pop_front();
+    if (client.stream_wrappers_.empty()) {
+      processIdleClient(client);
+    } else {
+      pipelinePendingRequest(client);
+    }
+  }
+}
+
+void ConnPoolImpl::pipelinePendingRequest(ActiveClient& client) {
+  if (!pending_requests_.empty() && canPipeline(client)) {
+    conn_log_debug("pipelining next request", *client.codec_client_);
+    host_->cluster().stats().upstream_rq_pipelined_.inc();
+    // Take the request off the list first, as attaching it may encode it and pipeline the next.
+    PendingRequestPtr request = pending_requests_.back()->removeFromList(pending_requests_);
+    attachRequestToClient(client, request->decoder_, request->callbacks_);
+  }
+}
+
+void ConnPoolImpl::prefetchConnections() {
+  // Keep prefetchRatio() connections open for every request that is active or waiting for a
+  // connection. The number of connections therefore follows the request rate.
+  const double ratio = host_->cluster().prefetchRatio();
+  if (ratio <= 1.0 || !drained_callbacks_.empty()) {
+    return;
+  }
+
+  // Pipelined connections each serve up to pipelineDepth() requests.
+  const uint64_t wanted = static_cast<uint64_t>(
+      std::ceil(ratio * (num_active_requests_ + pending_requests_.size()) / pipelineDepth()));
+  while (ready_clients_.size() + busy_clients_.size() < wanted &&
+         host_->cluster().resourceManager(priority_).connections().canCreate()) {
+    host_->cluster().stats().upstream_cx_prefetch_.inc();
+    createNewConnection(true);
   }
 }
 
 void ConnPoolImpl::processIdleClient(ActiveClient& client) {
-  client.stream_wrapper_.reset();
+  ASSERT(client.stream_wrappers_.empty());
   if (pending_requests_.empty()) {
     // There is nothing to service so just move the connection into the ready list.
     conn_log_debug("moving to ready", *client.codec_client_);
     client.moveBetweenLists(busy_clients_, ready_clients_);
+    if (client.idle_timer_) {
+      client.idle_timer_->enableTimer(host_->cluster().idleTimeout().value());
+    }
   } else {
     // There is work to do so bind a request to the client and move it to the busy list. Pending
-    // requests are pushed onto the front, so pull from the back.
+    // requests are pushed onto the front, so pull from the back. The request is taken off the list
+    // first, as attaching it may encode it and pipeline the next one.
     conn_log_debug("attaching to next request", *client.codec_client_);
-    attachRequestToClient(client, pending_requests_.back()->decoder_,
-                          pending_requests_.back()->callbacks_);
-    pending_requests_.pop_back();
+    PendingRequestPtr request = pending_requests_.back()->removeFromList(pending_requests_);
+    attachRequestToClient(client, request->decoder_, request->callbacks_);
   }
 
   checkForDrained();
@@ -222,14 +328,29 @@ ConnPoolImpl::StreamWrapper::StreamWrapper(StreamDecoder& response_decoder, Acti
   parent_.parent_.host_->cluster().stats().upstream_rq_active_.inc();
   parent_.parent_.host_->stats().rq_total_.inc();
   parent_.parent_.host_->stats().rq_active_.inc();
+  parent_.parent_.host_->incActiveRequests();
+  parent_.parent_.num_active_requests_++;
 }
 
 ConnPoolImpl::StreamWrapper::~StreamWrapper() {
+  parent_.parent_.num_active_requests_--;
   parent_.parent_.host_->cluster().stats().upstream_rq_active_.dec();
   parent_.parent_.host_->stats().rq_active_.dec();
+  parent_.parent_.host_->decActiveRequests();
 }
 
-void ConnPoolImpl::StreamWrapper::onEncodeComplete() { encode_complete_ = true; }
+void ConnPoolImpl::warm() {
+  if (ready_clients_.empty() && busy_clients_.empty() && drained_callbacks_.empty() &&
+      host_->cluster().resourceManager(priority_).connections().canCreate()) {
+    host_->cluster().stats().upstream_cx_prefetch_.inc();
+    createNewConnection(true);
+  }
+}
+
+void ConnPoolImpl::StreamWrapper::onEncodeComplete() {
+  encode_complete_ = true;
+  parent_.parent_.pipelinePendingRequest(parent_);
+}
 
 void ConnPoolImpl::StreamWrapper::decodeHeaders(HeaderMapPtr&& headers, bool end_stream) {
   if (headers->Connection() &&
@@ -260,13 +381,18 @@ ConnPoolImpl::PendingRequest::~PendingRequest() {
   parent_.host_->cluster().resourceManager(parent_.priority_).pendingRequests().dec();
 }
 
-ConnPoolImpl::ActiveClient::ActiveClient(ConnPoolImpl& parent)
+ConnPoolImpl::ActiveClient::ActiveClient(ConnPoolImpl& parent, bool prefetched)
     : parent_(parent),
       connect_timer_(parent_.dispatcher_.createTimer([this]() -> void { onConnectTimeout(); })),
-      remaining_requests_(parent_.host_->cluster().maxRequestsPerConnection()) {
+      remaining_requests_(parent_.maxRequestsForNewConnection()),
+      prefetched_(prefetched) {
+
+  parent_.conn_connect_ms_ = parent_.host_->cluster().stats().upstream_cx_connect_ms_.allocateSpan(
+      parent_.dispatcher_.loopTimeSource());
+  if (parent_.host_->cluster().idleTimeout().valid()) {
+    idle_timer_ = parent_.dispatcher_.createTimer([this]() -> void { onIdleTimeout(); });
+  }
 
-  parent_.conn_connect_ms_ =
-      parent_.host_->cluster().stats().upstream_cx_connect_ms_.allocateSpan();
   Upstream::Host::CreateConnectionData data = parent_.host_->createConnection(parent_.dispatcher_);
   real_host_description_ = data.host_description_;
   codec_client_ = parent_.createCodecClient(data);
@@ -277,7 +403,8 @@ ConnPoolImpl::ActiveClient::ActiveClient(ConnPoolImpl& parent)
   parent_.host_->cluster().stats().upstream_cx_http1_total_.inc();
   parent_.host_->stats().cx_total_.inc();
   parent_.host_->stats().cx_active_.inc();
-  conn_length_ = parent_.host_->cluster().stats().upstream_cx_length_ms_.allocateSpan();
+  conn_length_ = parent_.host_->cluster().stats().upstream_cx_length_ms_.allocateSpan(
+      parent_.dispatcher_.loopTimeSource());
   connect_timer_->enableTimer(parent_.host_->cluster().connectTimeout());
   parent_.host_->cluster().resourceManager(parent_.priority_).connections().inc();
 
@@ -288,6 +415,11 @@ ConnPoolImpl::ActiveClient::ActiveClient(ConnPoolImpl& parent)
 }
 
 ConnPoolImpl::ActiveClient::~ActiveClient() {
+  Memory::AccountingScope accounting(Memory::Subsystem::ConnPool);
+  // Free the connection here, in the same order as the members would be, so that it is accounted
+  // for.
+  stream_wrappers_.clear();
+  codec_client_.reset();
   parent_.host_->cluster().stats().upstream_cx_active_.dec();
   parent_.host_->stats().cx_active_.dec();
   conn_length_->complete();
@@ -302,6 +434,12 @@ void ConnPoolImpl::ActiveClient::onConnectTimeout() {
   codec_client_->close();
 }
 
+void ConnPoolImpl::ActiveClient::onIdleTimeout() {
+  conn_log_debug("idle timeout", *codec_client_);
+  parent_.host_->cluster().stats().upstream_cx_idle_timeout_.inc();
+  codec_client_->close();
+}
+
 CodecClientPtr ConnPoolImplProd::createCodecClient(Upstream::Host::CreateConnectionData& data) {
   CodecClientPtr codec{new CodecClientProd(CodecClient::Type::HTTP1, std::move(data.connection_),
                                            data.host_description_)};
@@ -9,6 +9,7 @@
 #include "envoy/event/timer.h"
 #include "envoy/http/conn_pool.h"
 #include "envoy/network/connection.h"
+#include "envoy/runtime/runtime.h"
 #include "envoy/upstream/upstream.h"
 
 #include "common/common/linked_object.h"
@@ -20,16 +21,18 @@ namespace Http {
 namespace Http1 {
 
 /**
- * A connection pool implementation for HTTP/1.1 connections.
+ * A connection pool implementation for HTTP/1.1 connections. If the cluster allows it, requests are
+ * pipelined: once a request has been encoded the next one may be sent on the same connection
+ * before the response has arrived, up to the cluster's http1PipelineDepth() requests.
  * NOTE: The connection pool does NOT do DNS resolution. It assumes it is being given a numeric IP
  *       address. Higher layer code should handle resolving DNS on error and creating a new pool
  *       bound to a different IP address.
  */
 class ConnPoolImpl : Logger::Loggable<Logger::Id::pool>, public ConnectionPool::Instance {
 public:
-  ConnPoolImpl(Event::Dispatcher& dispatcher, Upstream::HostConstSharedPtr host,
-               Upstream::ResourcePriority priority)
-      : dispatcher_(dispatcher), host_(host), priority_(priority) {}
+  ConnPoolImpl(Event::Dispatcher& dispatcher, Runtime::RandomGenerator& random,
+               Upstream::HostConstSharedPtr host, Upstream::ResourcePriority priority)
+      : dispatcher_(dispatcher), random_(random), host_(host), priority_(priority) {}
 
   ~ConnPoolImpl();
 
@@ -37,6 +40,7 @@ public:
   void addDrainedCallback(DrainedCb cb) override;
   ConnectionPool::Cancellable* newStream(StreamDecoder& response_decoder,
                                          ConnectionPool::Callbacks& callbacks) override;
+  void warm() override;
 
 protected:
   struct ActiveClient;
@@ -57,6 +61,8 @@ protected:
 
     // Http::StreamCallbacks
     void onResetStream(StreamResetReason) override { parent_.parent_.onDownstreamReset(parent_); }
+    void onAboveWriteBufferHighWatermark() override {}
+    void onBelowWriteBufferLowWatermark() override {}
 
     ActiveClient& parent_;
     bool encode_complete_{};
@@ -69,21 +75,29 @@ protected:
   struct ActiveClient : LinkedObject<ActiveClient>,
                         public Network::ConnectionCallbacks,
                         public Event::DeferredDeletable {
-    ActiveClient(ConnPoolImpl& parent);
+    ActiveClient(ConnPoolImpl& parent, bool prefetched);
     ~ActiveClient();
 
     void onConnectTimeout();
+    void onIdleTimeout();
 
     // Network::ConnectionCallbacks
     void onEvent(uint32_t events) override { parent_.onConnectionEvent(*this, events); }
+    void onAboveWriteBufferHighWatermark() override {}
+    void onBelowWriteBufferLowWatermark() override {}
 
     ConnPoolImpl& parent_;
     CodecClientPtr codec_client_;
     Upstream::HostDescriptionConstSharedPtr real_host_description_;
-    StreamWrapperPtr stream_wrapper_;
+    // The requests in flight, oldest first. More than one only if requests are pipelined.
+    std::list<StreamWrapperPtr> stream_wrappers_;
     Event::TimerPtr connect_timer_;
+    // Only set if the cluster has an idle timeout. Armed while the client is in the ready list.
+    Event::TimerPtr idle_timer_;
     Stats::TimespanPtr conn_length_;
     uint64_t remaining_requests_;
+    // Whether the connection was opened ahead of demand and has not served a request yet.
+    bool prefetched_;
   };
 
   typedef std::unique_ptr<ActiveClient> ActiveClientPtr;
@@ -105,23 +119,35 @@ protected:
 
   void attachRequestToClient(ActiveClient& client, StreamDecoder& response_decoder,
                              ConnectionPool::Callbacks& callbacks);
+  bool canPipeline(const ActiveClient& client);
   virtual CodecClientPtr createCodecClient(Upstream::Host::CreateConnectionData& data) PURE;
   void checkForDrained();
-  void createNewConnection();
+  void createNewConnection(bool prefetched = false);
+  void disablePipelining(ActiveClient& client);
+  uint64_t maxRequestsForNewConnection();
+  uint32_t pipelineDepth() const {
+    return pipelining_disabled_ ? 1 : host_->cluster().http1PipelineDepth();
+  }
   void onConnectionEvent(ActiveClient& client, uint32_t events);
   void onDownstreamReset(ActiveClient& client);
   void onPendingRequestCancel(PendingRequest& request);
   void onResponseComplete(ActiveClient& client);
+  void pipelinePendingRequest(ActiveClient& client);
+  void prefetchConnections();
   void processIdleClient(ActiveClient& client);
 
   Stats::TimespanPtr conn_connect_ms_;
   Event::Dispatcher& dispatcher_;
+  Runtime::RandomGenerator& random_;
   Upstream::HostConstSharedPtr host_;
   std::list<ActiveClientPtr> ready_clients_;
   std::list<ActiveClientPtr> busy_clients_;
   std::list<PendingRequestPtr> pending_requests_;
   std::list<DrainedCb> drained_callbacks_;
   Upstream::ResourcePriority priority_;
+  uint64_t num_active_requests_{};
+  // Set for the rest of the pool's life once pipelining has failed.
+  bool pipelining_disabled_{};
 };
 
 /**
@@ -129,9 +155,9 @@ protected:
  */
 class ConnPoolImplProd : public ConnPoolImpl {
 public:
-  ConnPoolImplProd(Event::Dispatcher& dispatcher, Upstream::HostConstSharedPtr host,
-                   Upstream::ResourcePriority priority)
-      : ConnPoolImpl(dispatcher, host, priority) {}
+  ConnPoolImplProd(Event::Dispatcher& dispatcher, Runtime::RandomGenerator& random,
+                   Upstream::HostConstSharedPtr host, Upstream::ResourcePriority priority)
+      : ConnPoolImpl(dispatcher, random, host, priority) {}
 
   // ConnPoolImpl
   CodecClientPtr createCodecClient(Upstream::Host::CreateConnectionData& data) override;
@@ -0,0 +1,659 @@
+#include "common/http/http1/parser.h"
+
+#include <strings.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "common/common/assert.h"
+
+namespace Envoy {
+namespace Http {
+namespace Http1 {
+
+namespace {
+
+/**
+ * Character classes used while parsing.
+ */
+struct CharTables {
+  CharTables() {
+    // RFC 7230 tchar.
+    const char* specials = "!#$%&'*+-.^_`|~";
+    for (size_t c = 0; c < 256; c++) {
+      token_[c] = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                  (c != 0 && strchr(specials, static_cast<int>(c)) != nullptr);
+      method_[c] = (c >= 'A' && c <= 'Z') || c == '-' || c == '_';
+    }
+  }
+
+  std::array<bool, 256> token_;
+  std::array<bool, 256> method_;
+};
+
+const CharTables& charTables() {
+  static CharTables* tables = new CharTables();
+  return *tables;
+}
+
+// Methods are upper case and in practice short. Bounding their length also bounds the work done to
+// validate a request line that arrives a byte at a time.
+const size_t MaxMethodSize = 32;
+
+const char HTTP_PREFIX[] = "HTTP/";
+const size_t HTTP_PREFIX_SIZE = sizeof(HTTP_PREFIX) - 1;
+
+/**
+ * Find the first byte below a threshold, or DEL. Runs of clean bytes are skipped 8 bytes at a time:
+ * for bytes without the high bit set, subtracting the threshold from every byte only borrows into
+ * the high bit of a byte that is below it. DEL is found the same way as a zero byte after XOR with
+ * 0x7f. Bytes with the high bit set are never matched.
+ * @param data supplies the data to search.
+ * @param size supplies the size of the data.
+ * @param threshold supplies the smallest byte value that is not matched, at most 0x80.
+ * @return size_t the offset of the first matching byte or size if no byte matches.
+ */
+size_t findControl(const char* data, size_t size, uint8_t threshold) {
+  const uint64_t ones = 0x0101010101010101ULL;
+  const uint64_t highs = 0x8080808080808080ULL;
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, data + i, sizeof(word));
+    const uint64_t del = word ^ (ones * 0x7f);
+    if ((((word - ones * threshold) | (del - ones)) & ~word & highs) != 0) {
+      break;
+    }
+  }
+
+  for (; i < size; i++) {
+    const uint8_t c = data[i];
+    if (c < threshold || c == 0x7f) {
+      return i;
+    }
+  }
+
+  return size;
+}
+
+bool isWhitespace(char c) { return c == ' ' || c == '\t'; }
+
+bool equalsIgnoreCase(const char* data, size_t length, const char* literal, size_t literal_length) {
+  return length == literal_length && strncasecmp(data, literal, length) == 0;
+}
+
+// Trim leading and trailing spaces and tabs.
+void trim(const char*& data, size_t& length) {
+  while (length > 0 && isWhitespace(data[0])) {
+    data++;
+    length--;
+  }
+  while (length > 0 && isWhitespace(data[length - 1])) {
+    length--;
+  }
+}
+
+} // namespace
+
+const size_t Parser::MaxHeadSize;
+
+Parser::Parser(Type type, ParserCallbacks& callbacks, const HeaderLimits& header_limits)
+    : type_(type), callbacks_(callbacks), header_limits_(header_limits) {}
+
+const char* Parser::errorName(Error error) {
+  switch (error) {
+  case Error::None:
+    return "OK";
+  case Error::InvalidMethod:
+    return "INVALID_METHOD";
+  case Error::InvalidUrl:
+    return "INVALID_URL";
+  case Error::InvalidVersion:
+    return "INVALID_VERSION";
+  case Error::InvalidStatus:
+    return "INVALID_STATUS";
+  case Error::InvalidHeaderToken:
+    return "INVALID_HEADER_TOKEN";
+  case Error::InvalidHeaderValue:
+    return "INVALID_HEADER_VALUE";
+  case Error::HeaderOverflow:
+    return "HEADER_OVERFLOW";
+  case Error::TooManyHeaders:
+    return "TOO_MANY_HEADERS";
+  case Error::InvalidContentLength:
+    return "INVALID_CONTENT_LENGTH";
+  case Error::UnexpectedContentLength:
+    return "UNEXPECTED_CONTENT_LENGTH";
+  case Error::InvalidChunkSize:
+    return "INVALID_CHUNK_SIZE";
+  case Error::InvalidEofState:
+    return "INVALID_EOF_STATE";
+  case Error::ClosedConnection:
+    return "CLOSED_CONNECTION";
+  }
+
+  NOT_REACHED;
+}
+
+size_t Parser::execute(const char* data, size_t length) {
+  if (paused_ || error_ != Error::None) {
+    return 0;
+  }
+
+  if (state_ == State::MessageDone) {
+    onMessageComplete();
+    if (paused_) {
+      return 0;
+    }
+  }
+
+  if (length == 0) {
+    onEof();
+    return 0;
+  }
+
+  const char* p = data;
+  const char* end = data + length;
+  while (p < end && !paused_ && error_ == Error::None) {
+    switch (state_) {
+    case State::MessageStart:
+      p = parseMessageStart(p, end);
+      break;
+    case State::StartLine:
+      p = parseStartLine(p, end);
+      break;
+    case State::Header:
+      p = parseHeader(p, end);
+      break;
+    case State::MessageDone:
+      onMessageComplete();
+      break;
+    case State::Body:
+    case State::ChunkData:
+    case State::BodyUntilEof:
+      p = parseBody(p, end);
+      break;
+    case State::ChunkSize:
+      p = parseChunkSize(p, end);
+      break;
+    case State::ChunkDataEnd:
+      p = parseChunkDataEnd(p, end);
+      break;
+    case State::Trailer:
+      p = parseTrailer(p, end);
+      break;
+    case State::Dead:
+      p = parseDead(p, end);
+      break;
+    }
+  }
+
+  return p - data;
+}
+
+bool Parser::readLine(const char*& p, const char* end, size_t limit, const char*& line,
+                      size_t& length) {
+  const char* lf = static_cast<const char*>(memchr(p, '\n', end - p));
+  if (lf == nullptr) {
+    if (line_buffer_.size() + (end - p) >= limit) {
+      setError(Error::HeaderOverflow);
+      return false;
+    }
+
+    line_buffer_.append(p, end - p);
+    p = end;
+    return false;
+  }
+
+  if (line_buffer_.size() + (lf - p) >= limit) {
+    setError(Error::HeaderOverflow);
+    return false;
+  }
+
+  if (line_buffer_.empty()) {
+    line = p;
+    length = lf - p;
+  } else {
+    line_buffer_.append(p, lf - p);
+    line = line_buffer_.data();
+    length = line_buffer_.size();
+  }
+
+  head_size_ += length + 1;
+  p = lf + 1;
+  // Bare LF line endings are accepted.
+  if (length > 0 && line[length - 1] == '\r') {
+    length--;
+  }
+
+  return true;
+}
+
+const char* Parser::parseMessageStart(const char* p, const char* end) {
+  while (p < end && (*p == '\r' || *p == '\n')) {
+    p++;
+  }
+  if (p == end) {
+    return p;
+  }
+
+  // Reject obviously bad input before the message is reported.
+  if (type_ == Type::Request ? *p < 'A' || *p > 'Z' : *p != 'H') {
+    setError(type_ == Type::Request ? Error::InvalidMethod : Error::InvalidVersion);
+    return p;
+  }
+
+  method_.clear();
+  http_major_ = 0;
+  http_minor_ = 0;
+  status_code_ = 0;
+  content_length_ = Optional<uint64_t>();
+  chunked_ = false;
+  connection_close_ = false;
+  connection_keep_alive_ = false;
+  head_size_ = 0;
+  header_bytes_ = 0;
+  header_count_ = 0;
+  ASSERT(line_buffer_.empty());
+
+  state_ = State::StartLine;
+  callbacks_.onMessageBegin();
+  return p;
+}
+
+const char* Parser::parseStartLine(const char* p, const char* end) {
+  const char* line;
+  size_t length;
+  if (!readLine(p, end, MaxHeadSize - head_size_, line, length)) {
+    if (error_ == Error::None) {
+      validatePartialStartLine();
+    }
+    return p;
+  }
+
+  state_ = State::Header;
+  if (type_ == Type::Request) {
+    parseRequestLine(line, length);
+  } else {
+    parseStatusLine(line, length);
+  }
+
+  line_buffer_.clear();
+  return p;
+}
+
+void Parser::parseRequestLine(const char* line, size_t length) {
+  const CharTables& tables = charTables();
+  size_t method_length = 0;
+  while (method_length < length && tables.method_[static_cast<uint8_t>(line[method_length])]) {
+    method_length++;
+  }
+  if (method_length == 0 || method_length > MaxMethodSize || method_length == length ||
+      line[method_length] != ' ') {
+    setError(Error::InvalidMethod);
+    return;
+  }
+
+  const char* url = line + method_length + 1;
+  const size_t remaining = length - method_length - 1;
+  // The target ends at the space before the version. It may not contain controls or whitespace.
+  const size_t url_length = findControl(url, remaining, ' ' + 1);
+  if (url_length == 0 || url_length == remaining || url[url_length] != ' ') {
+    setError(Error::InvalidUrl);
+    return;
+  }
+
+  if (!parseVersion(url + url_length + 1, remaining - url_length - 1)) {
+    setError(Error::InvalidVersion);
+    return;
+  }
+
+  method_.assign(line, method_length);
+  callbacks_.onUrl(url, url_length);
+}
+
+void Parser::parseStatusLine(const char* line, size_t length) {
+  const size_t version_length = HTTP_PREFIX_SIZE + 3;
+  if (length < version_length || !parseVersion(line, version_length)) {
+    setError(Error::InvalidVersion);
+    return;
+  }
+
+  // The reason phrase is optional and is not reported.
+  const char* status = line + version_length;
+  const size_t remaining = length - version_length;
+  if (remaining < 4 || status[0] != ' ' || (remaining > 4 && status[4] != ' ')) {
+    setError(Error::InvalidStatus);
+    return;
+  }
+
+  status_code_ = 0;
+  for (size_t i = 1; i < 4; i++) {
+    if (status[i] < '0' || status[i] > '9') {
+      setError(Error::InvalidStatus);
+      return;
+    }
+    status_code_ = status_code_ * 10 + (status[i] - '0');
+  }
+}
+
+bool Parser::parseVersion(const char* version, size_t length) {
+  if (length != HTTP_PREFIX_SIZE + 3 || memcmp(version, HTTP_PREFIX, HTTP_PREFIX_SIZE) != 0) {
+    return false;
+  }
+
+  const char major = version[HTTP_PREFIX_SIZE];
+  const char minor = version[HTTP_PREFIX_SIZE + 2];
+  if (major < '0' || major > '9' || version[HTTP_PREFIX_SIZE + 1] != '.' || minor < '0' ||
+      minor > '9') {
+    return false;
+  }
+
+  http_major_ = major - '0';
+  http_minor_ = minor - '0';
+  return true;
+}
+
+void Parser::validatePartialStartLine() {
+  // Only the part of the start line that can be checked without the rest of it is validated, so
+  // that garbage is rejected before a complete line has arrived.
+  if (type_ == Type::Request) {
+    const CharTables& tables = charTables();
+    size_t method_length = 0;
+    while (method_length < line_buffer_.size() && line_buffer_[method_length] != ' ') {
+      if (!tables.method_[static_cast<uint8_t>(line_buffer_[method_length])] ||
+          ++method_length > MaxMethodSize) {
+        setError(Error::InvalidMethod);
+        return;
+      }
+    }
+  } else {
+    const size_t prefix_length = std::min(line_buffer_.size(), HTTP_PREFIX_SIZE);
+    if (line_buffer_.compare(0, prefix_length, HTTP_PREFIX, prefix_length) != 0) {
+      setError(Error::InvalidVersion);
+    }
+  }
+}
+
+const char* Parser::parseHeader(const char* p, const char* end) {
+  const char* line;
+  size_t length;
+  if (!readLine(p, end, MaxHeadSize - head_size_, line, length)) {
+    return p;
+  }
+
+  if (length == 0) {
+    line_buffer_.clear();
+    onHeadersComplete();
+    return p;
+  }
+
+  // Obsolete line folding, where a line starting with whitespace continues the previous header, is
+  // rejected as allowed by RFC 7230.
+  const CharTables& tables = charTables();
+  size_t name_length = 0;
+  while (name_length < length && tables.token_[static_cast<uint8_t>(line[name_length])]) {
+    name_length++;
+  }
+  if (name_length == 0 || name_length == length || line[name_length] != ':') {
+    setError(Error::InvalidHeaderToken);
+    line_buffer_.clear();
+    return p;
+  }
+
+  const char* value = line + name_length + 1;
+  size_t value_length = length - name_length - 1;
+  trim(value, value_length);
+
+  // Horizontal tabs are the only controls allowed in values and they are rare, so each one found
+  // restarts the fast scan.
+  size_t offset = 0;
+  while ((offset += findControl(value + offset, value_length - offset, ' ')) < value_length) {
+    if (value[offset] != '\t') {
+      setError(Error::InvalidHeaderValue);
+      line_buffer_.clear();
+      return p;
+    }
+    offset++;
+  }
+
+  header_bytes_ += name_length + value_length;
+  if (header_bytes_ > header_limits_.max_bytes_) {
+    setError(Error::HeaderOverflow);
+    line_buffer_.clear();
+    return p;
+  }
+  if (++header_count_ > header_limits_.max_count_) {
+    setError(Error::TooManyHeaders);
+    line_buffer_.clear();
+    return p;
+  }
+
+  parseSpecialHeader(line, name_length, value, value_length);
+  if (error_ == Error::None) {
+    callbacks_.onHeader(line, name_length, value, value_length);
+  }
+
+  line_buffer_.clear();
+  return p;
+}
+
+void Parser::parseSpecialHeader(const char* name, size_t name_length, const char* value,
+                                size_t value_length) {
+  static const char CONTENT_LENGTH[] = "content-length";
+  static const char TRANSFER_ENCODING[] = "transfer-encoding";
+  static const char CONNECTION[] = "connection";
+  static const char CHUNKED[] = "chunked";
+
+  if (equalsIgnoreCase(name, name_length, CONTENT_LENGTH, sizeof(CONTENT_LENGTH) - 1)) {
+    if (value_length == 0) {
+      setError(Error::InvalidContentLength);
+      return;
+    }
+
+    uint64_t content_length = 0;
+    for (size_t i = 0; i < value_length; i++) {
+      if (value[i] < '0' || value[i] > '9' || content_length > (UINT64_MAX - 9) / 10) {
+        setError(Error::InvalidContentLength);
+        return;
+      }
+      content_length = content_length * 10 + (value[i] - '0');
+    }
+
+    // Conflicting lengths could make intermediaries disagree about where the message ends.
+    if (content_length_.valid() && content_length_.value() != content_length) {
+      setError(Error::UnexpectedContentLength);
+      return;
+    }
+    content_length_.value(content_length);
+  } else if (equalsIgnoreCase(name, name_length, TRANSFER_ENCODING,
+                              sizeof(TRANSFER_ENCODING) - 1)) {
+    // The message is chunked if chunked is the last coding applied.
+    const char* coding = value + value_length;
+    while (coding > value && coding[-1] != ',') {
+      coding--;
+    }
+    size_t coding_length = value + value_length - coding;
+    trim(coding, coding_length);
+    chunked_ = equalsIgnoreCase(coding, coding_length, CHUNKED, sizeof(CHUNKED) - 1);
+  } else if (equalsIgnoreCase(name, name_length, CONNECTION, sizeof(CONNECTION) - 1)) {
+    const char* option = value;
+    const char* value_end = value + value_length;
+    while (option < value_end) {
+      const char* comma = static_cast<const char*>(memchr(option, ',', value_end - option));
+      const char* option_end = comma == nullptr ? value_end : comma;
+      size_t option_length = option_end - option;
+      trim(option, option_length);
+      connection_close_ |= equalsIgnoreCase(option, option_length, "close", 5);
+      connection_keep_alive_ |= equalsIgnoreCase(option, option_length, "keep-alive", 10);
+      option = option_end + 1;
+    }
+  }
+}
+
+void Parser::onHeadersComplete() {
+  if (chunked_ && content_length_.valid()) {
+    // A message with both is a common request smuggling vector, so it is rejected outright.
+    setError(Error::UnexpectedContentLength);
+    return;
+  }
+
+  // The state is chosen before raising the callback so that parsing can resume where it left off
+  // if the callback pauses the parser.
+  state_ = State::MessageDone;
+  const bool skip_body = callbacks_.onHeadersComplete();
+  if (skip_body || (type_ == Type::Response && (status_code_ / 100 == 1 || status_code_ == 204 ||
+                                                status_code_ == 304))) {
+    // The message is completed right away, or when parsing resumes if the callback paused.
+  } else if (chunked_) {
+    state_ = State::ChunkSize;
+  } else if (content_length_.valid()) {
+    if (content_length_.value() > 0) {
+      body_remaining_ = content_length_.value();
+      state_ = State::Body;
+    }
+  } else if (type_ == Type::Response) {
+    state_ = State::BodyUntilEof;
+  }
+
+  if (state_ == State::MessageDone && !paused_) {
+    onMessageComplete();
+  }
+}
+
+const char* Parser::parseBody(const char* p, const char* end) {
+  uint64_t length = end - p;
+  if (state_ != State::BodyUntilEof) {
+    length = std::min(length, body_remaining_);
+    body_remaining_ -= length;
+  }
+
+  callbacks_.onBody(p, length);
+  p += length;
+  if (body_remaining_ == 0) {
+    if (state_ == State::Body) {
+      onMessageComplete();
+    } else if (state_ == State::ChunkData) {
+      state_ = State::ChunkDataEnd;
+    }
+  }
+
+  return p;
+}
+
+const char* Parser::parseChunkSize(const char* p, const char* end) {
+  const char* line;
+  size_t length;
+  if (!readLine(p, end, MaxHeadSize, line, length)) {
+    return p;
+  }
+
+  // Chunk extensions are ignored.
+  uint64_t size = 0;
+  size_t i = 0;
+  for (; i < length && line[i] != ';' && !isWhitespace(line[i]); i++) {
+    const char c = line[i];
+    uint64_t digit;
+    if (c >= '0' && c <= '9') {
+      digit = c - '0';
+    } else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+      digit = (c | 0x20) - 'a' + 10;
+    } else {
+      break;
+    }
+
+    if (size > (UINT64_MAX >> 4)) {
+      break;
+    }
+    size = size << 4 | digit;
+  }
+
+  while (i < length && isWhitespace(line[i])) {
+    i++;
+  }
+  if (i == 0 || (i < length && line[i] != ';')) {
+    setError(Error::InvalidChunkSize);
+  } else if (size == 0) {
+    head_size_ = 0;
+    state_ = State::Trailer;
+  } else {
+    body_remaining_ = size;
+    state_ = State::ChunkData;
+  }
+
+  line_buffer_.clear();
+  return p;
+}
+
+const char* Parser::parseChunkDataEnd(const char* p, const char* end) {
+  const char* line;
+  size_t length;
+  if (!readLine(p, end, MaxHeadSize, line, length)) {
+    return p;
+  }
+
+  if (length != 0) {
+    setError(Error::InvalidChunkSize);
+  } else {
+    state_ = State::ChunkSize;
+  }
+
+  line_buffer_.clear();
+  return p;
+}
+
+const char* Parser::parseTrailer(const char* p, const char* end) {
+  const char* line;
+  size_t length;
+  if (!readLine(p, end, MaxHeadSize - head_size_, line, length)) {
+    return p;
+  }
+
+  line_buffer_.clear();
+  if (length == 0) {
+    onMessageComplete();
+  }
+
+  return p;
+}
+
+const char* Parser::parseDead(const char* p, const char* end) {
+  while (p < end && (*p == '\r' || *p == '\n')) {
+    p++;
+  }
+  if (p < end) {
+    setError(Error::ClosedConnection);
+  }
+
+  return p;
+}
+
+void Parser::onEof() {
+  switch (state_) {
+  case State::MessageStart:
+  case State::Dead:
+    break;
+  case State::BodyUntilEof:
+    onMessageComplete();
+    break;
+  default:
+    setError(Error::InvalidEofState);
+    break;
+  }
+}
+
+void Parser::onMessageComplete() {
+  // A response delimited by the end of the connection can never be followed by another message.
+  const bool keep_alive =
+      state_ != State::BodyUntilEof && !connection_close_ &&
+      (http_major_ > 1 || (http_major_ == 1 && http_minor_ >= 1) || connection_keep_alive_);
+  state_ = keep_alive ? State::MessageStart : State::Dead;
+  callbacks_.onMessageComplete();
+}
+
+} // Http1
+} // Http
+} // Envoy
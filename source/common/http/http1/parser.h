@@ -0,0 +1,229 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "envoy/common/optional.h"
+#include "envoy/common/pure.h"
+#include "envoy/http/codec.h"
+
+namespace Envoy {
+namespace Http {
+namespace Http1 {
+
+/**
+ * Callbacks for the events raised while a message is parsed. Data pointers are only valid for the
+ * duration of the callback.
+ */
+class ParserCallbacks {
+public:
+  virtual ~ParserCallbacks() {}
+
+  /**
+   * Called when the first byte of a new message has been received.
+   */
+  virtual void onMessageBegin() PURE;
+
+  /**
+   * Called once with the complete request target of a request.
+   * @param data supplies the start address.
+   * @param length supplies the length.
+   */
+  virtual void onUrl(const char* data, size_t length) PURE;
+
+  /**
+   * Called once for every complete header. Leading and trailing whitespace has been removed from
+   * the value. Trailers of chunked messages are not reported.
+   * @param name supplies the start address of the header name.
+   * @param name_length supplies the length of the header name.
+   * @param value supplies the start address of the header value.
+   * @param value_length supplies the length of the header value.
+   */
+  virtual void onHeader(const char* name, size_t name_length, const char* value,
+                        size_t value_length) PURE;
+
+  /**
+   * Called when all headers have been received.
+   * @return bool true if the message has no body regardless of its headers, e.g. the response to
+   *         a HEAD request.
+   */
+  virtual bool onHeadersComplete() PURE;
+
+  /**
+   * Called when body data is received.
+   * @param data supplies the start address.
+   * @param length supplies the length.
+   */
+  virtual void onBody(const char* data, size_t length) PURE;
+
+  /**
+   * Called when the message is complete.
+   */
+  virtual void onMessageComplete() PURE;
+};
+
+/**
+ * HTTP/1.x message parser. The start line, headers, chunk sizes and trailers are parsed a line at a
+ * time: line ends are found with memchr() and request targets and header values are validated 8
+ * bytes at a time, so each header is reported with a single callback. Only a line that is split
+ * across calls to execute() is copied. Any number of pipelined messages are parsed in one call
+ * unless the parser is paused from a callback.
+ */
+class Parser {
+public:
+  enum class Type { Request, Response };
+
+  enum class Error {
+    None,
+    InvalidMethod,
+    InvalidUrl,
+    InvalidVersion,
+    InvalidStatus,
+    InvalidHeaderToken,
+    InvalidHeaderValue,
+    HeaderOverflow,
+    TooManyHeaders,
+    InvalidContentLength,
+    UnexpectedContentLength,
+    InvalidChunkSize,
+    InvalidEofState,
+    ClosedConnection
+  };
+
+  // The maximum size of the start line plus headers, or of the trailers, of a message. The header
+  // names and values are further limited by the header limits.
+  static const size_t MaxHeadSize = 80 * 1024;
+
+  /**
+   * @param header_limits supplies the limits on the size and number of the headers of a message.
+   *        Exceeding them raises Error::HeaderOverflow or Error::TooManyHeaders as soon as the
+   *        offending header has been read.
+   */
+  Parser(Type type, ParserCallbacks& callbacks, const HeaderLimits& header_limits);
+
+  /**
+   * Parse data. Parsing stops early when the parser is paused from a callback or an error is found.
+   * Nothing is parsed while the parser is paused or after an error.
+   * @param data supplies the start address.
+   * @param length supplies the length. A length of 0 indicates that the connection was closed,
+   *        which completes a response that is delimited by the end of the connection.
+   * @return size_t the number of bytes consumed.
+   */
+  size_t execute(const char* data, size_t length);
+
+  /**
+   * Pause or resume parsing. Pausing from a callback stops execute() right after the event.
+   */
+  void pause(bool paused) { paused_ = paused; }
+
+  /**
+   * @return Error the error that stopped parsing, if any.
+   */
+  Error error() const { return error_; }
+
+  /**
+   * @return const char* a name which describes an error.
+   */
+  static const char* errorName(Error error);
+
+  uint32_t httpMajor() const { return http_major_; }
+  uint32_t httpMinor() const { return http_minor_; }
+
+  /**
+   * @return const std::string& the method of the current request.
+   */
+  const std::string& method() const { return method_; }
+
+  /**
+   * @return uint32_t the status code of the current response.
+   */
+  uint32_t statusCode() const { return status_code_; }
+
+  /**
+   * @return bool whether the current message uses chunked transfer encoding.
+   */
+  bool chunked() const { return chunked_; }
+
+  /**
+   * @return const Optional<uint64_t>& the content-length of the current message, if it has one.
+   */
+  const Optional<uint64_t>& contentLength() const { return content_length_; }
+
+private:
+  enum class State {
+    // Waiting for the first byte of a message. Empty lines between messages are skipped.
+    MessageStart,
+    StartLine,
+    Header,
+    // The headers are complete but the parser was paused before the body-less message could be
+    // completed.
+    MessageDone,
+    Body,
+    BodyUntilEof,
+    ChunkSize,
+    ChunkData,
+    ChunkDataEnd,
+    Trailer,
+    // A message which does not allow the connection to be reused has been completed. Only empty
+    // lines are allowed.
+    Dead
+  };
+
+  /**
+   * Find the next complete line. A line that is not complete yet is buffered in line_buffer_.
+   * @param p supplies the current position, which is advanced past the consumed data.
+   * @param end supplies the end of the data.
+   * @param limit supplies the maximum length of the line including its terminator.
+   * @param line supplies the start of the line, without its terminator, when one was found.
+   * @param length supplies the length of the line.
+   * @return bool whether a complete line was found.
+   */
+  bool readLine(const char*& p, const char* end, size_t limit, const char*& line, size_t& length);
+
+  const char* parseMessageStart(const char* p, const char* end);
+  const char* parseStartLine(const char* p, const char* end);
+  void parseRequestLine(const char* line, size_t length);
+  void parseStatusLine(const char* line, size_t length);
+  bool parseVersion(const char* version, size_t length);
+  void validatePartialStartLine();
+  const char* parseHeader(const char* p, const char* end);
+  void parseSpecialHeader(const char* name, size_t name_length, const char* value,
+                          size_t value_length);
+  void onHeadersComplete();
+  const char* parseBody(const char* p, const char* end);
+  const char* parseChunkSize(const char* p, const char* end);
+  const char* parseChunkDataEnd(const char* p, const char* end);
+  const char* parseTrailer(const char* p, const char* end);
+  const char* parseDead(const char* p, const char* end);
+  void onEof();
+  void onMessageComplete();
+  void setError(Error error) { error_ = error; }
+
+  const Type type_;
+  ParserCallbacks& callbacks_;
+  const HeaderLimits header_limits_;
+  State state_{State::MessageStart};
+  Error error_{Error::None};
+  bool paused_{};
+  std::string line_buffer_;
+  size_t head_size_{};
+  // The total size of the names and values, and the number, of the headers of the current message.
+  uint64_t header_bytes_{};
+  uint32_t header_count_{};
+  uint64_t body_remaining_{};
+
+  // State of the current message.
+  std::string method_;
+  uint32_t http_major_{};
+  uint32_t http_minor_{};
+  uint32_t status_code_{};
+  Optional<uint64_t> content_length_;
+  bool chunked_{};
+  bool connection_close_{};
+  bool connection_keep_alive_{};
+};
+
+} // Http1
+} // Http
+} // Envoy
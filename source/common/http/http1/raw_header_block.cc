@@ -0,0 +1,54 @@
+#include "common/http/http1/raw_header_block.h"
+
+#include <cstdint>
+#include <string>
+
+#include "common/common/assert.h"
+
+namespace Envoy {
+namespace Http {
+namespace Http1 {
+
+void RawHeaderBlock::add(const char* name, size_t name_length, const char* value,
+                         size_t value_length) {
+  ASSERT(references_ == 0);
+  const uint32_t offset = data_.size();
+  data_.append(name, name_length);
+  to_lower_.toLowerCase(&data_[offset], name_length);
+  data_.append(": ", 2);
+  data_.append(value, value_length);
+  data_.push_back('\0');
+  lines_.push_back({offset, static_cast<uint32_t>(name_length),
+                    static_cast<uint32_t>(name_length + value_length + 2)});
+}
+
+void RawHeaderBlock::moveIntoMap(RawHeaderBlockPtr&& block, HeaderMapImpl& headers) {
+  // The data does not move from here on. The block holds a reference of its own until all of the
+  // headers have been added, in case the map drops all of them.
+  RawHeaderBlock* owned = block.release();
+  owned->references_ = 1;
+  for (const Line& line : owned->lines_) {
+    const char* name = owned->data_.c_str() + line.offset_;
+    HeaderString key;
+    key.setCopy(name, line.name_length_);
+    HeaderString value;
+    owned->references_++;
+    value.setReference(name + line.name_length_ + 2, line.length_ - line.name_length_ - 2,
+                       &RawHeaderBlock::release, owned);
+    headers.addViaMove(std::move(key), std::move(value));
+  }
+
+  release(owned);
+}
+
+void RawHeaderBlock::release(void* context) {
+  RawHeaderBlock* block = static_cast<RawHeaderBlock*>(context);
+  ASSERT(block->references_ > 0);
+  if (--block->references_ == 0) {
+    delete block;
+  }
+}
+
+} // Http1
+} // Http
+} // Envoy
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "envoy/http/header_map.h"
+
+#include "common/common/to_lower_table.h"
+#include "common/http/header_map_impl.h"
+
+namespace Envoy {
+namespace Http {
+namespace Http1 {
+
+class RawHeaderBlock;
+typedef std::unique_ptr<RawHeaderBlock> RawHeaderBlockPtr;
+
+/**
+ * The header lines of a message decoded by the HTTP/1.1 codec, kept in a single allocation so
+ * that the message can be forwarded over HTTP/1.1 without encoding each header again. Lines are
+ * stored the way the encoder writes them, "name: value" with a lower case name, and each is
+ * terminated by a null character instead of a CRLF so that the header map values can point into
+ * the block rather than being copied.
+ *
+ * Once moved into a header map the block is owned by the values that point into it. A value gives
+ * its reference back as soon as it is modified, copied into another map or removed, so a map
+ * whose values all still point into the block holds exactly the headers that were decoded.
+ * References are taken and given back on the thread that owns the header map.
+ */
+class RawHeaderBlock {
+public:
+  /**
+   * A header line. The value starts 2 bytes after the name and ends at the null terminator.
+   */
+  struct Line {
+    uint32_t offset_;
+    uint32_t name_length_;
+    uint32_t length_;
+  };
+
+  RawHeaderBlock(const ToLowerTable& to_lower) : to_lower_(to_lower) {}
+
+  /**
+   * Append a header line. The name is converted to lower case.
+   */
+  void add(const char* name, size_t name_length, const char* value, size_t value_length);
+
+  /**
+   * Add the headers to a header map, pointing the values into the block. The block deletes itself
+   * once every value has given back its reference.
+   * @param block supplies the block.
+   * @param headers supplies the map to add the headers to.
+   */
+  static void moveIntoMap(RawHeaderBlockPtr&& block, HeaderMapImpl& headers);
+
+  /**
+   * @return the block that a header value still points into, or nullptr if it does not point into
+   *         a block.
+   */
+  static const RawHeaderBlock* fromValue(const HeaderString& value) {
+    return static_cast<const RawHeaderBlock*>(value.referenceContext(&RawHeaderBlock::release));
+  }
+
+  /**
+   * @return the stored lines, which hold data().size() + lines().size() bytes once each null
+   *         terminator is replaced with a CRLF.
+   */
+  const std::vector<Line>& lines() const { return lines_; }
+  const std::string& data() const { return data_; }
+
+private:
+  static void release(void* context);
+
+  const ToLowerTable& to_lower_;
+  std::string data_;
+  std::vector<Line> lines_;
+  uint32_t references_{};
+};
+
+} // Http1
+} // Http
+} // Envoy
@@ -1,6 +1,8 @@
 #include "common/http/http2/codec_impl.h"
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <memory>
 #include <vector>
 
@@ -38,7 +40,7 @@ bool Utility::reconstituteCrumbledCookies(const HeaderString& key, const HeaderS
 }
 
 ConnectionImpl::Http2Callbacks ConnectionImpl::http2_callbacks_;
-ConnectionImpl::Http2Options ConnectionImpl::http2_options_;
+const uint8_t ConnectionImpl::BDP_PING_OPAQUE_DATA[8] = {'e', 'n', 'v', 'o', 'y', 'b', 'd', 'p'};
 const std::unique_ptr<const Http::HeaderMap> ConnectionImpl::CONTINUE_HEADER{
     new Http::HeaderMapImpl{
         {Http::Headers::get().Status, std::to_string(enumToInt(Code::Continue))}}};
@@ -51,40 +53,65 @@ template <typename T> static T* remove_const(const void* object) {
   return const_cast<T*>(reinterpret_cast<const T*>(object));
 }
 
+/**
+ * Point a header string at a name or value decoded by nghttp2 and take a reference to it.
+ */
+static void referenceHeaderBuffer(HeaderString& string, nghttp2_rcbuf* buffer) {
+  nghttp2_rcbuf_incref(buffer);
+  const nghttp2_vec vec = nghttp2_rcbuf_get_buf(buffer);
+  string.setReference(reinterpret_cast<const char*>(vec.base), vec.len,
+                      [](void* context) -> void {
+                        nghttp2_rcbuf_decref(static_cast<nghttp2_rcbuf*>(context));
+                      },
+                      buffer);
+}
+
 ConnectionImpl::StreamImpl::StreamImpl(ConnectionImpl& parent)
     : parent_(parent), headers_(new HeaderMapImpl()), local_end_stream_(false),
       local_end_stream_sent_(false), remote_end_stream_(false), data_deferred_(false),
-      waiting_for_non_informational_headers_(false) {}
+      waiting_for_non_informational_headers_(false),
+      pending_send_data_above_high_watermark_(false) {}
 
 ConnectionImpl::StreamImpl::~StreamImpl() {}
 
-void ConnectionImpl::StreamImpl::buildHeaders(std::vector<nghttp2_nv>& final_headers,
-                                              const HeaderMap& headers) {
+void ConnectionImpl::buildHeaders(std::vector<nghttp2_nv>& final_headers,
+                                  const HeaderMap& headers) {
+  struct Context {
+    ConnectionImpl& connection_;
+    std::vector<nghttp2_nv>& final_headers_;
+    bool pseudo_headers_;
+  } context{*this, final_headers, true};
+
   // nghttp2 requires that all ':' headers come before all other headers. To avoid making higher
   // layers understand that we do two passes here to build the final header list to encode.
   final_headers.reserve(headers.size());
-  headers.iterate([](const HeaderEntry& header, void* context) -> void {
-    std::vector<nghttp2_nv>* final_headers = static_cast<std::vector<nghttp2_nv>*>(context);
-    if (header.key().c_str()[0] == ':') {
-      final_headers->push_back({remove_const<uint8_t>(header.key().c_str()),
-                                remove_const<uint8_t>(header.value().c_str()), header.key().size(),
-                                header.value().size(), 0});
+  auto add_header = [](const HeaderEntry& header, void* context) -> void {
+    Context* ctx = static_cast<Context*>(context);
+    if ((header.key().c_str()[0] == ':') != ctx->pseudo_headers_) {
+      return;
     }
-  }, &final_headers);
-
-  headers.iterate([](const HeaderEntry& header, void* context) -> void {
-    std::vector<nghttp2_nv>* final_headers = static_cast<std::vector<nghttp2_nv>*>(context);
-    if (header.key().c_str()[0] != ':') {
-      final_headers->push_back({remove_const<uint8_t>(header.key().c_str()),
-                                remove_const<uint8_t>(header.value().c_str()), header.key().size(),
-                                header.value().size(), 0});
+
+    uint8_t flags = 0;
+    for (const LowerCaseString& never_index_header : ctx->connection_.never_index_headers_) {
+      if (never_index_header.get() == header.key().c_str()) {
+        flags |= NGHTTP2_NV_FLAG_NO_INDEX;
+        break;
+      }
     }
-  }, &final_headers);
+
+    ctx->final_headers_.push_back({remove_const<uint8_t>(header.key().c_str()),
+                                   remove_const<uint8_t>(header.value().c_str()),
+                                   header.key().size(), header.value().size(), flags});
+  };
+
+  headers.iterate(add_header, &context);
+  context.pseudo_headers_ = false;
+  headers.iterate(add_header, &context);
 }
 
 void ConnectionImpl::StreamImpl::encodeHeaders(const HeaderMap& headers, bool end_stream) {
   std::vector<nghttp2_nv> final_headers;
-  buildHeaders(final_headers, headers);
+  parent_.buildHeaders(final_headers, headers);
 
   nghttp2_data_provider provider;
   if (!end_stream) {
@@ -123,7 +150,7 @@ void ConnectionImpl::StreamImpl::saveHeader(HeaderString&& name, HeaderString&&
 
 void ConnectionImpl::StreamImpl::submitTrailers(const HeaderMap& trailers) {
   std::vector<nghttp2_nv> final_headers;
-  buildHeaders(final_headers, trailers);
+  parent_.buildHeaders(final_headers, trailers);
   int rc =
       nghttp2_submit_trailer(parent_.session_, stream_id_, &final_headers[0], final_headers.size());
   ASSERT(rc == 0);
@@ -157,10 +184,15 @@ int ConnectionImpl::StreamImpl::onDataSourceSend(const uint8_t* framehd, size_t
   // https://nghttp2.org/documentation/types.html#c.nghttp2_send_data_callback
   static const uint64_t FRAME_HEADER_SIZE = 9;
 
-  // TODO(mattklein123): Back pressure.
-  Buffer::OwnedImpl output(framehd, FRAME_HEADER_SIZE);
-  output.move(pending_send_data_, length);
-  parent_.connection_.write(output);
+  parent_.pending_output_.add(framehd, FRAME_HEADER_SIZE);
+  // The payload slices are moved. Only the smaller part of a slice split by the end of the frame
+  // is copied.
+  parent_.pending_output_.move(pending_send_data_, length);
+  if (pending_send_data_above_high_watermark_ &&
+      pending_send_data_.length() < parent_.connection_.readBufferLimit() / 2) {
+    pending_send_data_above_high_watermark_ = false;
+    runLowWatermarkCallbacks();
+  }
   return 0;
 }
 
@@ -194,6 +226,15 @@ void ConnectionImpl::StreamImpl::encodeData(Buffer::Instance& data, bool end_str
   }
 
   parent_.sendPendingFrames();
+
+  // Data the peer has no window for stays in pending_send_data_. Past the connection's buffer
+  // limit the stream asks whoever feeds it to stop.
+  const uint32_t limit = parent_.connection_.readBufferLimit();
+  if (limit > 0 && !pending_send_data_above_high_watermark_ &&
+      pending_send_data_.length() > limit) {
+    pending_send_data_above_high_watermark_ = true;
+    runHighWatermarkCallbacks();
+  }
 }
 
 void ConnectionImpl::StreamImpl::resetStream(StreamResetReason reason) {
@@ -212,6 +253,24 @@ void ConnectionImpl::StreamImpl::resetStream(StreamResetReason reason) {
   }
 }
 
+void ConnectionImpl::StreamImpl::readDisable(bool disable) {
+  if (disable) {
+    ++read_disable_count_;
+    return;
+  }
+
+  ASSERT(read_disable_count_ > 0);
+  if (--read_disable_count_ == 0 && unconsumed_bytes_ > 0) {
+    // Now that the data can be consumed, open the window for the peer to send more.
+    int rc = nghttp2_session_consume(parent_.session_, stream_id_, unconsumed_bytes_);
+    ASSERT(rc == 0);
+    UNREFERENCED_PARAMETER(rc);
+
+    unconsumed_bytes_ = 0;
+    parent_.sendPendingFrames();
+  }
+}
+
 void ConnectionImpl::StreamImpl::resetStreamWorker(StreamResetReason reason) {
   int rc = nghttp2_submit_rst_stream(parent_.session_, NGHTTP2_FLAG_NONE, stream_id_,
                                      reason == StreamResetReason::LocalRefusedStreamReset
@@ -251,10 +310,63 @@ ConnectionImpl::StreamImpl* ConnectionImpl::getStream(int32_t stream_id) {
 }
 
 int ConnectionImpl::onData(int32_t stream_id, const uint8_t* data, size_t len) {
-  getStream(stream_id)->pending_recv_data_.add(data, len);
+  StreamImpl* stream = getStream(stream_id);
+  stream->pending_recv_data_.add(data, len);
+
+  // Automatic window updates are off, so the window is only returned to the peer once the data
+  // can be consumed. While something downstream of the stream has disabled reads, the peer can
+  // send at most what is left of the stream window.
+  if (stream->read_disable_count_ == 0) {
+    int rc = nghttp2_session_consume(session_, stream_id, len);
+    ASSERT(rc == 0);
+    UNREFERENCED_PARAMETER(rc);
+  } else {
+    stream->unconsumed_bytes_ += len;
+  }
+
+  if (window_autotuning_ && stream_window_size_ < Http2Settings::MAX_INITIAL_STREAM_WINDOW_SIZE) {
+    // The DATA received between sending a PING and receiving its ACK is what the peer could send
+    // in one round trip. A new sample starts with the first DATA after the previous ACK, and the
+    // count is reset once the PING has actually been sent.
+    if (bdp_ping_outstanding_) {
+      bdp_bytes_ += len;
+    } else {
+      bdp_ping_outstanding_ = true;
+      int rc = nghttp2_submit_ping(session_, NGHTTP2_FLAG_NONE, BDP_PING_OPAQUE_DATA);
+      ASSERT(rc == 0);
+      UNREFERENCED_PARAMETER(rc);
+    }
+  }
+
   return 0;
 }
 
+void ConnectionImpl::onBdpPingAck() {
+  bdp_ping_outstanding_ = false;
+
+  // If the peer managed to send close to a full window in one round trip the window is what
+  // limits throughput, so grow it to twice the measured bandwidth-delay product.
+  if (bdp_bytes_ * 3 < static_cast<uint64_t>(stream_window_size_) * 2) {
+    return;
+  }
+
+  stream_window_size_ = std::min<uint64_t>(bdp_bytes_ * 2,
+                                           Http2Settings::MAX_INITIAL_STREAM_WINDOW_SIZE);
+  conn_log_debug("autotuning stream-level window size to {}", connection_, stream_window_size_);
+  stats_.window_autotuning_increase_.inc();
+  nghttp2_settings_entry iv{NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE, stream_window_size_};
+  int rc = nghttp2_submit_settings(session_, NGHTTP2_FLAG_NONE, &iv, 1);
+  ASSERT(rc == 0);
+
+  if (connection_window_size_ < stream_window_size_) {
+    connection_window_size_ = stream_window_size_;
+    rc = nghttp2_session_set_local_window_size(session_, NGHTTP2_FLAG_NONE, 0,
+                                               connection_window_size_);
+    ASSERT(rc == 0);
+  }
+  UNREFERENCED_PARAMETER(rc);
+}
+
 void ConnectionImpl::goAway() {
   int rc = nghttp2_submit_goaway(session_, NGHTTP2_FLAG_NONE,
                                  nghttp2_session_get_last_proc_stream_id(session_),
@@ -285,6 +397,12 @@ int ConnectionImpl::onFrameReceived(const nghttp2_frame* frame) {
     return 0;
   }
 
+  if (frame->hd.type == NGHTTP2_PING && (frame->hd.flags & NGHTTP2_FLAG_ACK) &&
+      memcmp(frame->ping.opaque_data, BDP_PING_OPAQUE_DATA, sizeof(BDP_PING_OPAQUE_DATA)) == 0) {
+    onBdpPingAck();
+    return 0;
+  }
+
   StreamImpl* stream = getStream(frame->hd.stream_id);
   if (!stream) {
     return 0;
@@ -304,7 +422,7 @@ int ConnectionImpl::onFrameReceived(const nghttp2_frame* frame) {
       // Deal with expect: 100-continue here since higher layers are never going to do anything
       // other than say to continue so that we can respond before request complete if necessary.
       std::vector<nghttp2_nv> final_headers;
-      StreamImpl::buildHeaders(final_headers, *CONTINUE_HEADER);
+      buildHeaders(final_headers, *CONTINUE_HEADER);
       int rc = nghttp2_submit_headers(session_, 0, stream->stream_id_, nullptr, &final_headers[0],
                                       final_headers.size(), nullptr);
       ASSERT(rc == 0);
@@ -358,6 +476,8 @@ int ConnectionImpl::onFrameReceived(const nghttp2_frame* frame) {
     }
 
     stream->headers_.reset();
+    stream->header_bytes_ = 0;
+    stream->header_count_ = 0;
     break;
   }
   case NGHTTP2_DATA: {
@@ -396,6 +516,14 @@ int ConnectionImpl::onFrameSend(const nghttp2_frame* frame) {
     break;
   }
 
+  case NGHTTP2_PING: {
+    if (!(frame->hd.flags & NGHTTP2_FLAG_ACK) &&
+        memcmp(frame->ping.opaque_data, BDP_PING_OPAQUE_DATA, sizeof(BDP_PING_OPAQUE_DATA)) == 0) {
+      bdp_bytes_ = 0;
+    }
+    break;
+  }
+
   case NGHTTP2_RST_STREAM: {
     conn_log_debug("sent reset code={}", connection_, frame->rst_stream.error_code);
     stats_.tx_reset_.inc();
@@ -404,6 +532,17 @@ int ConnectionImpl::onFrameSend(const nghttp2_frame* frame) {
 
   case NGHTTP2_HEADERS:
   case NGHTTP2_DATA: {
+    if (frame->hd.type == NGHTTP2_HEADERS) {
+      // The frame length covers the whole encoded header block, including any CONTINUATION
+      // frames.
+      uint64_t uncompressed_bytes = 0;
+      for (size_t i = 0; i < frame->headers.nvlen; i++) {
+        uncompressed_bytes += frame->headers.nva[i].namelen + frame->headers.nva[i].valuelen;
+      }
+      stats_.tx_headers_uncompressed_bytes_.add(uncompressed_bytes);
+      stats_.tx_headers_compressed_bytes_.add(frame->hd.length);
+    }
+
     StreamImpl* stream = getStream(frame->hd.stream_id);
     stream->local_end_stream_sent_ = frame->hd.flags & NGHTTP2_FLAG_END_STREAM;
     break;
@@ -422,10 +561,8 @@ int ConnectionImpl::onInvalidFrame(int error_code) {
 }
 
 ssize_t ConnectionImpl::onSend(const uint8_t* data, size_t length) {
-  // TODO(mattklein123): Back pressure.
   conn_log_trace("send data: bytes={}", connection_, length);
-  Buffer::OwnedImpl buffer(data, length);
-  connection_.write(buffer);
+  pending_output_.add(data, length);
   return length;
 }
 
@@ -435,6 +572,15 @@ int ConnectionImpl::onStreamClose(int32_t stream_id, uint32_t error_code) {
   StreamImpl* stream = getStream(stream_id);
   if (stream) {
     conn_log_debug("stream closed: {}", connection_, error_code);
+    if (stream->unconsumed_bytes_ > 0) {
+      // The stream window goes away with the stream, but the connection window must still be
+      // returned to the peer.
+      int rc = nghttp2_session_consume_connection(session_, stream->unconsumed_bytes_);
+      ASSERT(rc == 0);
+      UNREFERENCED_PARAMETER(rc);
+      stream->unconsumed_bytes_ = 0;
+    }
+
     if (!stream->remote_end_stream_ || !stream->local_end_stream_) {
       stream->runResetCallbacks(error_code == NGHTTP2_REFUSED_STREAM
                                     ? StreamResetReason::RemoteRefusedStreamReset
@@ -462,14 +608,20 @@ int ConnectionImpl::saveHeader(const nghttp2_frame* frame, HeaderString&& name,
     return 0;
   }
 
-  stream->saveHeader(std::move(name), std::move(value));
-  if (stream->headers_->byteSize() > StreamImpl::MAX_HEADER_SIZE) {
-    // This will cause the library to reset/close the stream.
+  // The limits are checked before the header is stored so that a block which exceeds them is
+  // never buffered. Returning a temporal failure causes the library to reset the stream.
+  stream->header_bytes_ += name.size() + value.size();
+  if (stream->header_bytes_ > header_limits_.max_bytes_) {
     stats_.header_overflow_.inc();
     return NGHTTP2_ERR_TEMPORAL_CALLBACK_FAILURE;
-  } else {
-    return 0;
   }
+  if (++stream->header_count_ > header_limits_.max_count_) {
+    stats_.too_many_headers_.inc();
+    return NGHTTP2_ERR_TEMPORAL_CALLBACK_FAILURE;
+  }
+
+  stream->saveHeader(std::move(name), std::move(value));
+  return 0;
 }
 
 void ConnectionImpl::sendPendingFrames() {
@@ -483,6 +635,13 @@ void ConnectionImpl::sendPendingFrames() {
     throw CodecProtocolException(fmt::format("{}", nghttp2_strerror(rc)));
   }
 
+  // All of the frames that were ready, for every stream, go through the connection's write path
+  // as a single buffer. Anything that a write filter left behind must not be sent again.
+  if (pending_output_.length() > 0) {
+    connection_.write(pending_output_);
+    pending_output_.drain(pending_output_.length());
+  }
+
   // See ConnectionImpl::StreamImpl::resetStream() for why we do this. This is an uncommon event,
   // so iterating through every stream to find the ones that have a deferred reset is not a big
   // deal. Furthermore, queueing a reset frame does not actually invoke the close stream callback.
@@ -581,16 +740,15 @@ ConnectionImpl::Http2Callbacks::Http2Callbacks() {
         return static_cast<ConnectionImpl*>(user_data)->onBeginHeaders(frame);
       });
 
-  nghttp2_session_callbacks_set_on_header_callback(
-      callbacks_,
-      [](nghttp2_session*, const nghttp2_frame* frame, const uint8_t* raw_name, size_t name_length,
-         const uint8_t* raw_value, size_t value_length, uint8_t, void* user_data) -> int {
-
-        // TODO PERF: Can reference count here to avoid copies.
+  nghttp2_session_callbacks_set_on_header_callback2(
+      callbacks_, [](nghttp2_session*, const nghttp2_frame* frame, nghttp2_rcbuf* raw_name,
+                     nghttp2_rcbuf* raw_value, uint8_t, void* user_data) -> int {
+        // The decoded name and value are referenced rather than copied. The header map holds a
+        // reference to nghttp2's buffers, which stay valid after the session is gone.
         HeaderString name;
-        name.setCopy(reinterpret_cast<const char*>(raw_name), name_length);
+        referenceHeaderBuffer(name, raw_name);
         HeaderString value;
-        value.setCopy(reinterpret_cast<const char*>(raw_value), value_length);
+        referenceHeaderBuffer(value, raw_value);
         return static_cast<ConnectionImpl*>(user_data)
             ->onHeader(frame, std::move(name), std::move(value));
       });
@@ -632,13 +790,21 @@ ConnectionImpl::Http2Callbacks::Http2Callbacks() {
 
 ConnectionImpl::Http2Callbacks::~Http2Callbacks() { nghttp2_session_callbacks_del(callbacks_); }
 
-ConnectionImpl::Http2Options::Http2Options() {
+ConnectionImpl::Http2Options::Http2Options(const Http2Settings& http2_settings) {
   nghttp2_option_new(&options_);
   // Currently we do not do anything with stream priority. Setting the following option prevents
   // nghttp2 from keeping around closed streams for use during stream priority dependency graph
   // calculations. This saves a tremendous amount of memory in cases where there are a large number
   // of kept alive HTTP/2 connections.
   nghttp2_option_set_no_closed_streams(options_, 1);
+  // Window updates are sent as the data is consumed, which allows withholding them to apply back
+  // pressure to the peer. @see StreamImpl::readDisable().
+  nghttp2_option_set_no_auto_window_update(options_, 1);
+
+  if (http2_settings.hpack_encoder_table_size_ != NGHTTP2_DEFAULT_HEADER_TABLE_SIZE) {
+    nghttp2_option_set_max_deflate_dynamic_table_size(options_,
+                                                      http2_settings.hpack_encoder_table_size_);
+  }
 }
 
 ConnectionImpl::Http2Options::~Http2Options() { nghttp2_option_del(options_); }
@@ -646,9 +812,10 @@ ConnectionImpl::Http2Options::~Http2Options() { nghttp2_option_del(options_); }
 ClientConnectionImpl::ClientConnectionImpl(Network::Connection& connection,
                                            ConnectionCallbacks& callbacks, Stats::Scope& stats,
                                            const Http2Settings& http2_settings)
-    : ConnectionImpl(connection, stats), callbacks_(callbacks) {
+    : ConnectionImpl(connection, stats, http2_settings, HeaderLimits()), callbacks_(callbacks) {
+  Http2Options http2_options(http2_settings);
   nghttp2_session_client_new2(&session_, http2_callbacks_.callbacks(), base(),
-                              http2_options_.options());
+                              http2_options.options());
   sendSettings(http2_settings);
 }
 
@@ -659,6 +826,10 @@ Http::StreamEncoder& ClientConnectionImpl::newStream(StreamDecoder& decoder) {
   return *active_streams_.front();
 }
 
+uint64_t ClientConnectionImpl::maxConcurrentStreams() {
+  return nghttp2_session_get_remote_settings(session_, NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS);
+}
+
 int ClientConnectionImpl::onBeginHeaders(const nghttp2_frame* frame) {
   // The client code explicitly does not currently suport push promise.
   RELEASE_ASSERT(frame->hd.type == NGHTTP2_HEADERS);
@@ -683,10 +854,12 @@ int ClientConnectionImpl::onHeader(const nghttp2_frame* frame, HeaderString&& na
 
 ServerConnectionImpl::ServerConnectionImpl(Network::Connection& connection,
                                            Http::ServerConnectionCallbacks& callbacks,
-                                           Stats::Store& stats, const Http2Settings& http2_settings)
-    : ConnectionImpl(connection, stats), callbacks_(callbacks) {
+                                           Stats::Store& stats, const Http2Settings& http2_settings,
+                                           const HeaderLimits& header_limits)
+    : ConnectionImpl(connection, stats, http2_settings, header_limits), callbacks_(callbacks) {
+  Http2Options http2_options(http2_settings);
   nghttp2_session_server_new2(&session_, http2_callbacks_.callbacks(), base(),
-                              http2_options_.options());
+                              http2_options.options());
   sendSettings(http2_settings);
 }
 
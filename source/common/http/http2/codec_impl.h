@@ -39,8 +39,12 @@ const std::string CLIENT_MAGIC_PREFIX = "PRI * HTTP/2";
   COUNTER(rx_reset)                                                                                \
   COUNTER(tx_reset)                                                                                \
   COUNTER(header_overflow)                                                                         \
+  COUNTER(too_many_headers)                                                                        \
   COUNTER(trailers)                                                                                \
-  COUNTER(headers_cb_no_stream)
+  COUNTER(headers_cb_no_stream)                                                                    \
+  COUNTER(tx_headers_uncompressed_bytes)                                                           \
+  COUNTER(tx_headers_compressed_bytes)                                                             \
+  COUNTER(window_autotuning_increase)
 // clang-format on
 
 /**
@@ -68,10 +72,16 @@ public:
  */
 class ConnectionImpl : public virtual Connection, Logger::Loggable<Logger::Id::http2> {
 public:
-  ConnectionImpl(Network::Connection& connection, Stats::Scope& stats)
+  ConnectionImpl(Network::Connection& connection, Stats::Scope& stats,
+                 const Http2Settings& http2_settings, const HeaderLimits& header_limits)
       : stats_{ALL_HTTP2_CODEC_STATS(POOL_COUNTER_PREFIX(stats, "http2."))},
+        header_limits_(header_limits),
+        never_index_headers_(http2_settings.hpack_never_index_headers_),
+        window_autotuning_(http2_settings.window_autotuning_),
+        stream_window_size_(http2_settings.initial_stream_window_size_),
+        connection_window_size_(http2_settings.initial_connection_window_size_),
         connection_(connection), dispatching_(false), raised_goaway_(false),
-        pending_deferred_reset_(false) {}
+        pending_deferred_reset_(false), bdp_ping_outstanding_(false) {}
 
   ~ConnectionImpl();
 
@@ -81,6 +91,16 @@ public:
   Protocol protocol() override { return Protocol::Http2; }
   void shutdownNotice() override;
   bool wantsToWrite() override { return nghttp2_session_want_write(session_); }
+  void onUnderlyingConnectionAboveWriteBufferHighWatermark() override {
+    for (StreamImplPtr& stream : active_streams_) {
+      stream->runHighWatermarkCallbacks();
+    }
+  }
+  void onUnderlyingConnectionBelowWriteBufferLowWatermark() override {
+    for (StreamImplPtr& stream : active_streams_) {
+      stream->runLowWatermarkCallbacks();
+    }
+  }
 
 protected:
   /**
@@ -98,11 +118,11 @@ protected:
   };
 
   /**
-   * Wrapper for static nghttp2 session options.
+   * Wrapper for nghttp2 session options. nghttp2 copies the options when a session is created.
    */
   class Http2Options {
   public:
-    Http2Options();
+    Http2Options(const Http2Settings& http2_settings);
     ~Http2Options();
 
     const nghttp2_option* options() { return options_; }
@@ -127,7 +147,6 @@ protected:
     ssize_t onDataSourceRead(uint64_t length, uint32_t* data_flags);
     int onDataSourceSend(const uint8_t* framehd, size_t length);
     void resetStreamWorker(StreamResetReason reason);
-    static void buildHeaders(std::vector<nghttp2_nv>& final_headers, const HeaderMap& headers);
     void saveHeader(HeaderString&& name, HeaderString&& value);
     virtual void submitHeaders(const std::vector<nghttp2_nv>& final_headers,
                                nghttp2_data_provider* provider) PURE;
@@ -143,11 +162,7 @@ protected:
     void addCallbacks(StreamCallbacks& callbacks) override { addCallbacks_(callbacks); }
     void removeCallbacks(StreamCallbacks& callbacks) override { removeCallbacks_(callbacks); }
     void resetStream(StreamResetReason reason) override;
-
-    // Max header size of 63K. This is arbitrary but makes it easier to test since nghttp2 doesn't
-    // appear to transmit headers greater than approximtely 64K (NGHTTP2_MAX_HEADERSLEN) for reasons
-    // I don't fully understand.
-    static const uint64_t MAX_HEADER_SIZE = 63 * 1024;
+    void readDisable(bool disable) override;
 
     ConnectionImpl& parent_;
     HeaderMapImplPtr headers_;
@@ -158,11 +173,20 @@ protected:
     HeaderMapPtr pending_trailers_;
     Optional<StreamResetReason> deferred_reset_;
     HeaderString cookies_;
+    // The total size of the names and values, and the number, of the headers received so far in
+    // the current header block.
+    uint64_t header_bytes_{};
+    uint32_t header_count_{};
+    uint32_t read_disable_count_{};
+    // Bytes received while reads were disabled, whose window is returned to the peer only once
+    // reads are enabled again.
+    uint64_t unconsumed_bytes_{};
     bool local_end_stream_ : 1;
     bool local_end_stream_sent_ : 1;
     bool remote_end_stream_ : 1;
     bool data_deferred_ : 1;
     bool waiting_for_non_informational_headers_ : 1;
+    bool pending_send_data_above_high_watermark_ : 1;
   };
 
   typedef std::unique_ptr<StreamImpl> StreamImplPtr;
@@ -190,13 +214,13 @@ protected:
   };
 
   ConnectionImpl* base() { return this; }
+  void buildHeaders(std::vector<nghttp2_nv>& final_headers, const HeaderMap& headers);
   StreamImpl* getStream(int32_t stream_id);
   int saveHeader(const nghttp2_frame* frame, HeaderString&& name, HeaderString&& value);
   void sendPendingFrames();
   void sendSettings(const Http2Settings& http2_settings);
 
   static Http2Callbacks http2_callbacks_;
-  static Http2Options http2_options_;
 
   std::list<StreamImplPtr> active_streams_;
   nghttp2_session* session_{};
@@ -210,15 +234,29 @@ private:
   int onFrameSend(const nghttp2_frame* frame);
   virtual int onHeader(const nghttp2_frame* frame, HeaderString&& name, HeaderString&& value) PURE;
   int onInvalidFrame(int error_code);
+  void onBdpPingAck();
   ssize_t onSend(const uint8_t* data, size_t length);
   int onStreamClose(int32_t stream_id, uint32_t error_code);
 
   static const std::unique_ptr<const Http::HeaderMap> CONTINUE_HEADER;
 
+  // The opaque data of the PING frames used to measure the bandwidth-delay product.
+  static const uint8_t BDP_PING_OPAQUE_DATA[8];
+
+  const HeaderLimits header_limits_;
+  const std::vector<LowerCaseString> never_index_headers_;
+  const bool window_autotuning_;
+  uint32_t stream_window_size_;
+  uint32_t connection_window_size_;
+  // Bytes of DATA received since the outstanding BDP PING was sent.
+  uint64_t bdp_bytes_{};
+  // Frames produced by a single nghttp2_session_send() call, written to the connection at once.
+  Buffer::OwnedImpl pending_output_;
   Network::Connection& connection_;
   bool dispatching_ : 1;
   bool raised_goaway_ : 1;
   bool pending_deferred_reset_ : 1;
+  bool bdp_ping_outstanding_ : 1;
 };
 
 /**
@@ -231,6 +269,7 @@ public:
 
   // Http::ClientConnection
   Http::StreamEncoder& newStream(StreamDecoder& response_decoder) override;
+  uint64_t maxConcurrentStreams() override;
 
 private:
   // ConnectionImpl
@@ -247,7 +286,8 @@ private:
 class ServerConnectionImpl : public ServerConnection, public ConnectionImpl {
 public:
   ServerConnectionImpl(Network::Connection& connection, ServerConnectionCallbacks& callbacks,
-                       Stats::Store& stats, const Http2Settings& http2_settings);
+                       Stats::Store& stats, const Http2Settings& http2_settings,
+                       const HeaderLimits& header_limits);
 
 private:
   // ConnectionImpl
@@ -7,6 +7,7 @@
 #include "envoy/upstream/upstream.h"
 
 #include "common/http/http2/codec_impl.h"
+#include "common/memory/accounting.h"
 #include "common/network/utility.h"
 #include "common/upstream/upstream_impl.h"
 
@@ -14,17 +15,17 @@ namespace Envoy {
 namespace Http {
 namespace Http2 {
 
-ConnPoolImpl::ConnPoolImpl(Event::Dispatcher& dispatcher, Upstream::HostConstSharedPtr host,
-                           Upstream::ResourcePriority priority)
-    : dispatcher_(dispatcher), host_(host), priority_(priority) {}
+ConnPoolImpl::ConnPoolImpl(Event::Dispatcher& dispatcher, Runtime::RandomGenerator& random,
+                           Upstream::HostConstSharedPtr host, Upstream::ResourcePriority priority)
+    : dispatcher_(dispatcher), random_(random), host_(host), priority_(priority) {}
 
 ConnPoolImpl::~ConnPoolImpl() {
-  if (primary_client_) {
-    primary_client_->client_->close();
+  while (!active_clients_.empty()) {
+    active_clients_.front()->client_->close();
   }
 
-  if (draining_client_) {
-    draining_client_->client_->close();
+  while (!draining_clients_.empty()) {
+    draining_clients_.front()->client_->close();
   }
 
   // Make sure all clients are destroyed before we are destroyed.
@@ -42,18 +43,21 @@ void ConnPoolImpl::checkForDrained() {
   }
 
   bool drained = true;
-  if (primary_client_) {
-    if (primary_client_->client_->numActiveRequests() == 0) {
-      primary_client_->client_->close();
-      ASSERT(!primary_client_);
+  for (auto it = active_clients_.begin(); it != active_clients_.end();) {
+    // Closing a client removes it from the list.
+    ActiveClient& client = **it++;
+    if (client.client_->numActiveRequests() == 0) {
+      client.client_->close();
     } else {
       drained = false;
     }
   }
 
-  ASSERT(!draining_client_ || (draining_client_->client_->numActiveRequests() > 0));
-  if (draining_client_ && draining_client_->client_->numActiveRequests() > 0) {
-    drained = false;
+  for (const ActiveClientPtr& client : draining_clients_) {
+    ASSERT(client->client_->numActiveRequests() > 0);
+    if (client->client_->numActiveRequests() > 0) {
+      drained = false;
+    }
   }
 
   if (drained) {
@@ -69,17 +73,20 @@ ConnectionPool::Cancellable* ConnPoolImpl::newStream(Http::StreamDecoder& respon
   ASSERT(drained_callbacks_.empty());
 
   // First see if we need to handle max streams rollover.
-  uint64_t max_streams = host_->cluster().maxRequestsPerConnection();
-  if (max_streams == 0) {
-    max_streams = maxTotalStreams();
-  }
-
-  if (primary_client_ && primary_client_->total_streams_ >= max_streams) {
-    movePrimaryClientToDraining();
+  for (auto it = active_clients_.begin(); it != active_clients_.end();) {
+    ActiveClient& client = **it++;
+    if (client.total_streams_ >= client.max_total_streams_) {
+      moveClientToDraining(client);
+    }
   }
 
-  if (!primary_client_) {
-    primary_client_.reset(new ActiveClient(*this));
+  const uint32_t max_connections = host_->cluster().http2Settings().max_connections_per_host_;
+  ActiveClient* client = chooseClient();
+  if (!client || (active_clients_.size() < max_connections && shouldOpenConnection(*client))) {
+    ActiveClient& new_client = createNewConnection();
+    if (!client || client->remainingStreams() == 0) {
+      client = &new_client;
+    }
   }
 
   if (!host_->cluster().resourceManager(priority_).requests().canCreate()) {
@@ -87,20 +94,87 @@ ConnectionPool::Cancellable* ConnPoolImpl::newStream(Http::StreamDecoder& respon
     callbacks.onPoolFailure(ConnectionPool::PoolFailureReason::Overflow, nullptr);
     host_->cluster().stats().upstream_rq_pending_overflow_.inc();
   } else {
-    conn_log_debug("creating stream", *primary_client_->client_);
-    primary_client_->total_streams_++;
+    conn_log_debug("creating stream", *client->client_);
+    if (client->idle_timer_) {
+      client->idle_timer_->disableTimer();
+    }
+    client->total_streams_++;
     host_->stats().rq_total_.inc();
     host_->stats().rq_active_.inc();
+    host_->incActiveRequests();
     host_->cluster().stats().upstream_rq_total_.inc();
     host_->cluster().stats().upstream_rq_active_.inc();
     host_->cluster().resourceManager(priority_).requests().inc();
-    callbacks.onPoolReady(primary_client_->client_->newStream(response_decoder),
-                          primary_client_->real_host_description_);
+    callbacks.onPoolReady(client->client_->newStream(response_decoder),
+                          client->real_host_description_);
   }
 
   return nullptr;
 }
 
+ConnPoolImpl::ActiveClient* ConnPoolImpl::chooseClient() {
+  // Prefer connected clients that can start a stream right away, then the client with the most
+  // streams left.
+  ActiveClient* best = nullptr;
+  bool best_ready = false;
+  uint64_t best_remaining = 0;
+  for (const ActiveClientPtr& client : active_clients_) {
+    const uint64_t remaining = client->remainingStreams();
+    const bool ready = !client->connect_timer_ && remaining > 0;
+    if (!best || (ready && !best_ready) || (ready == best_ready && remaining > best_remaining)) {
+      best = client.get();
+      best_ready = ready;
+      best_remaining = remaining;
+    }
+  }
+
+  return best;
+}
+
+bool ConnPoolImpl::shouldOpenConnection(ActiveClient& best_client) {
+  if (best_client.remainingStreams() == 0) {
+    return true;
+  }
+
+  // Open another connection early, while a quarter of the best client's streams are still
+  // available, so that it has connected by the time they run out. One early connection at a time
+  // is enough since it becomes the best client once it has connected.
+  for (const ActiveClientPtr& client : active_clients_) {
+    if (client->connect_timer_) {
+      return false;
+    }
+  }
+
+  return best_client.remainingStreams() * 4 <= best_client.client_->maxConcurrentStreams();
+}
+
+uint64_t ConnPoolImpl::maxStreamsForNewConnection() {
+  const uint64_t max_requests = host_->cluster().maxRequestsPerConnection();
+  if (max_requests == 0) {
+    return maxTotalStreams();
+  }
+
+  // Lower the limit of each connection by a random part of the jitter, so that connections that
+  // were opened together are not all drained, and replaced, at the same time.
+  const uint64_t jitter =
+      max_requests * host_->cluster().maxRequestsPerConnectionJitterPercent() / 100;
+  return jitter == 0 ? max_requests : max_requests - random_.random() % (jitter + 1);
+}
+
+ConnPoolImpl::ActiveClient& ConnPoolImpl::createNewConnection() {
+  Memory::AccountingScope accounting(Memory::Subsystem::ConnPool);
+  ActiveClientPtr client(new ActiveClient(*this));
+  client->moveIntoList(std::move(client), active_clients_);
+  return *active_clients_.front();
+}
+
+void ConnPoolImpl::warm() {
+  if (active_clients_.empty() && drained_callbacks_.empty()) {
+    host_->cluster().stats().upstream_cx_prefetch_.inc();
+    createNewConnection();
+  }
+}
+
 void ConnPoolImpl::onConnectionEvent(ActiveClient& client, uint32_t events) {
   if ((events & Network::ConnectionEvent::RemoteClose) ||
       (events & Network::ConnectionEvent::LocalClose)) {
@@ -114,12 +188,12 @@ void ConnPoolImpl::onConnectionEvent(ActiveClient& client, uint32_t events) {
       }
     }
 
-    if (&client == primary_client_.get()) {
-      conn_log_debug("destroying primary client", *client.client_);
-      dispatcher_.deferredDelete(std::move(primary_client_));
-    } else {
+    if (client.draining_) {
       conn_log_debug("destroying draining client", *client.client_);
-      dispatcher_.deferredDelete(std::move(draining_client_));
+      dispatcher_.deferredDelete(client.removeFromList(draining_clients_));
+    } else {
+      conn_log_debug("destroying active client", *client.client_);
+      dispatcher_.deferredDelete(client.removeFromList(active_clients_));
     }
 
     if (client.connect_timer_) {
@@ -139,28 +213,24 @@ void ConnPoolImpl::onConnectionEvent(ActiveClient& client, uint32_t events) {
   if (client.connect_timer_) {
     client.connect_timer_->disableTimer();
     client.connect_timer_.reset();
+    if (events & Network::ConnectionEvent::Connected) {
+      // A client that was opened ahead of demand, or whose streams were reset while it was
+      // connecting, starts out idle.
+      startIdleTimer(client);
+    }
   }
 }
 
-void ConnPoolImpl::movePrimaryClientToDraining() {
-  conn_log_debug("moving primary to draining", *primary_client_->client_);
-  if (draining_client_) {
-    // This should pretty much never happen, but is possible if we start draining and then get
-    // a goaway for example. In this case just kill the current draining connection. It's not
-    // worth keeping a list.
-    draining_client_->client_->close();
-  }
-
-  ASSERT(!draining_client_);
-  if (primary_client_->client_->numActiveRequests() == 0) {
-    // If we are making a new connection and the primary does not have any active requests just
-    // close it now.
-    primary_client_->client_->close();
+void ConnPoolImpl::moveClientToDraining(ActiveClient& client) {
+  conn_log_debug("moving client to draining", *client.client_);
+  ASSERT(!client.draining_);
+  if (client.client_->numActiveRequests() == 0) {
+    // If the client does not have any active requests just close it now.
+    client.client_->close();
   } else {
-    draining_client_ = std::move(primary_client_);
+    client.draining_ = true;
+    client.moveBetweenLists(active_clients_, draining_clients_);
   }
-
-  ASSERT(!primary_client_);
 }
 
 void ConnPoolImpl::onConnectTimeout(ActiveClient& client) {
@@ -169,10 +239,16 @@ void ConnPoolImpl::onConnectTimeout(ActiveClient& client) {
   client.client_->close();
 }
 
+void ConnPoolImpl::onIdleTimeout(ActiveClient& client) {
+  conn_log_debug("idle timeout", *client.client_);
+  host_->cluster().stats().upstream_cx_idle_timeout_.inc();
+  client.client_->close();
+}
+
 void ConnPoolImpl::onGoAway(ActiveClient& client) {
   conn_log_debug("remote goaway", *client.client_);
-  if (&client == primary_client_.get()) {
-    movePrimaryClientToDraining();
+  if (!client.draining_) {
+    moveClientToDraining(client);
   }
 }
 
@@ -180,11 +256,14 @@ void ConnPoolImpl::onStreamDestroy(ActiveClient& client) {
   conn_log_debug("destroying stream: {} remaining", *client.client_,
                  client.client_->numActiveRequests());
   host_->stats().rq_active_.dec();
+  host_->decActiveRequests();
   host_->cluster().stats().upstream_rq_active_.dec();
   host_->cluster().resourceManager(priority_).requests().dec();
-  if (&client == draining_client_.get() && client.client_->numActiveRequests() == 0) {
+  if (client.draining_ && client.client_->numActiveRequests() == 0) {
     // Close out the draining client if we no long have active requests.
     client.client_->close();
+  } else if (!client.closed_with_active_rq_) {
+    startIdleTimer(client);
   }
 
   // If we are destroying this stream because of a disconnect, do not check for drain here. We will
@@ -207,12 +286,22 @@ void ConnPoolImpl::onStreamReset(ActiveClient& client, Http::StreamResetReason r
   }
 }
 
+void ConnPoolImpl::startIdleTimer(ActiveClient& client) {
+  if (client.idle_timer_ && !client.draining_ && !client.connect_timer_ &&
+      client.client_->numActiveRequests() == 0) {
+    client.idle_timer_->enableTimer(host_->cluster().idleTimeout().value());
+  }
+}
+
 ConnPoolImpl::ActiveClient::ActiveClient(ConnPoolImpl& parent)
-    : parent_(parent),
+    : parent_(parent), max_total_streams_(parent_.maxStreamsForNewConnection()),
       connect_timer_(parent_.dispatcher_.createTimer([this]() -> void { onConnectTimeout(); })) {
+  if (parent_.host_->cluster().idleTimeout().valid()) {
+    idle_timer_ = parent_.dispatcher_.createTimer([this]() -> void { onIdleTimeout(); });
+  }
 
-  parent_.conn_connect_ms_ =
-      parent_.host_->cluster().stats().upstream_cx_connect_ms_.allocateSpan();
+  parent_.conn_connect_ms_ = parent_.host_->cluster().stats().upstream_cx_connect_ms_.allocateSpan(
+      parent_.dispatcher_.loopTimeSource());
   Upstream::Host::CreateConnectionData data = parent_.host_->createConnection(parent_.dispatcher_);
   real_host_description_ = data.host_description_;
   client_ = parent_.createCodecClient(data);
@@ -226,7 +315,8 @@ ConnPoolImpl::ActiveClient::ActiveClient(ConnPoolImpl& parent)
   parent_.host_->cluster().stats().upstream_cx_total_.inc();
   parent_.host_->cluster().stats().upstream_cx_active_.inc();
   parent_.host_->cluster().stats().upstream_cx_http2_total_.inc();
-  conn_length_ = parent_.host_->cluster().stats().upstream_cx_length_ms_.allocateSpan();
+  conn_length_ = parent_.host_->cluster().stats().upstream_cx_length_ms_.allocateSpan(
+      parent_.dispatcher_.loopTimeSource());
 
   client_->setBufferStats({parent_.host_->cluster().stats().upstream_cx_rx_bytes_total_,
                            parent_.host_->cluster().stats().upstream_cx_rx_bytes_buffered_,
@@ -234,7 +324,16 @@ ConnPoolImpl::ActiveClient::ActiveClient(ConnPoolImpl& parent)
                            parent_.host_->cluster().stats().upstream_cx_tx_bytes_buffered_});
 }
 
+uint64_t ConnPoolImpl::ActiveClient::remainingStreams() {
+  const uint64_t max_streams = client_->maxConcurrentStreams();
+  const uint64_t active_streams = client_->numActiveRequests();
+  return active_streams < max_streams ? max_streams - active_streams : 0;
+}
+
 ConnPoolImpl::ActiveClient::~ActiveClient() {
+  Memory::AccountingScope accounting(Memory::Subsystem::ConnPool);
+  // Free the connection here rather than after the destructor so that it is accounted for.
+  client_.reset();
   parent_.host_->stats().cx_active_.dec();
   parent_.host_->cluster().stats().upstream_cx_active_.dec();
   conn_length_->complete();
@@ -7,8 +7,10 @@
 #include "envoy/event/timer.h"
 #include "envoy/http/conn_pool.h"
 #include "envoy/network/connection.h"
+#include "envoy/runtime/runtime.h"
 #include "envoy/upstream/upstream.h"
 
+#include "common/common/linked_object.h"
 #include "common/http/codec_client.h"
 
 namespace Envoy {
@@ -16,23 +18,26 @@ namespace Http {
 namespace Http2 {
 
 /**
- * Implementation of a "connection pool" for HTTP/2. This mainly handles stats as well as
- * shifting to a new connection if we reach max streams on the primary. This is a base class
- * used for both the prod implementation as well as the testing one.
+ * Implementation of a "connection pool" for HTTP/2. This mainly handles stats, spreading streams
+ * over up to Http2Settings::max_connections_per_host_ connections, and shifting to a new
+ * connection when one reaches max streams. This is a base class used for both the prod
+ * implementation as well as the testing one.
  */
 class ConnPoolImpl : Logger::Loggable<Logger::Id::pool>, public ConnectionPool::Instance {
 public:
-  ConnPoolImpl(Event::Dispatcher& dispatcher, Upstream::HostConstSharedPtr host,
-               Upstream::ResourcePriority priority);
+  ConnPoolImpl(Event::Dispatcher& dispatcher, Runtime::RandomGenerator& random,
+               Upstream::HostConstSharedPtr host, Upstream::ResourcePriority priority);
   ~ConnPoolImpl();
 
   // Http::ConnectionPool::Instance
   void addDrainedCallback(DrainedCb cb) override;
   ConnectionPool::Cancellable* newStream(Http::StreamDecoder& response_decoder,
                                          ConnectionPool::Callbacks& callbacks) override;
+  void warm() override;
 
 protected:
-  struct ActiveClient : public Network::ConnectionCallbacks,
+  struct ActiveClient : LinkedObject<ActiveClient>,
+                        public Network::ConnectionCallbacks,
                         public CodecClientCallbacks,
                         public Event::DeferredDeletable,
                         public Http::ConnectionCallbacks {
@@ -40,9 +45,18 @@ protected:
     ~ActiveClient();
 
     void onConnectTimeout() { parent_.onConnectTimeout(*this); }
+    void onIdleTimeout() { parent_.onIdleTimeout(*this); }
+
+    /**
+     * @return uint64_t the number of streams that can be started before the peer's
+     *         SETTINGS_MAX_CONCURRENT_STREAMS is reached.
+     */
+    uint64_t remainingStreams();
 
     // Network::ConnectionCallbacks
     void onEvent(uint32_t events) override { parent_.onConnectionEvent(*this, events); }
+    void onAboveWriteBufferHighWatermark() override {}
+    void onBelowWriteBufferLowWatermark() override {}
 
     // CodecClientCallbacks
     void onStreamDestroy() override { parent_.onStreamDestroy(*this); }
@@ -57,28 +71,43 @@ protected:
     CodecClientPtr client_;
     Upstream::HostDescriptionConstSharedPtr real_host_description_;
     uint64_t total_streams_{};
+    // The number of streams after which the client is drained.
+    uint64_t max_total_streams_;
     Event::TimerPtr connect_timer_;
+    // Only set if the cluster has an idle timeout. Armed while the client is connected and has no
+    // active streams.
+    Event::TimerPtr idle_timer_;
     Stats::TimespanPtr conn_length_;
     bool closed_with_active_rq_{};
+    bool draining_{};
   };
 
   typedef std::unique_ptr<ActiveClient> ActiveClientPtr;
 
   void checkForDrained();
+  ActiveClient* chooseClient();
   virtual CodecClientPtr createCodecClient(Upstream::Host::CreateConnectionData& data) PURE;
+  ActiveClient& createNewConnection();
+  uint64_t maxStreamsForNewConnection();
   virtual uint32_t maxTotalStreams() PURE;
-  void movePrimaryClientToDraining();
+  void moveClientToDraining(ActiveClient& client);
   void onConnectionEvent(ActiveClient& client, uint32_t events);
   void onConnectTimeout(ActiveClient& client);
+  void onIdleTimeout(ActiveClient& client);
   void onGoAway(ActiveClient& client);
   void onStreamDestroy(ActiveClient& client);
   void onStreamReset(ActiveClient& client, Http::StreamResetReason reason);
+  bool shouldOpenConnection(ActiveClient& best_client);
+  void startIdleTimer(ActiveClient& client);
 
   Stats::TimespanPtr conn_connect_ms_;
   Event::Dispatcher& dispatcher_;
+  Runtime::RandomGenerator& random_;
   Upstream::HostConstSharedPtr host_;
-  ActiveClientPtr primary_client_;
-  ActiveClientPtr draining_client_;
+  // Clients that new streams can be assigned to.
+  std::list<ActiveClientPtr> active_clients_;
+  // Clients that finish their current streams and then close.
+  std::list<ActiveClientPtr> draining_clients_;
   std::list<DrainedCb> drained_callbacks_;
   Upstream::ResourcePriority priority_;
 };
@@ -2,60 +2,275 @@
 
 #include <chrono>
 #include <cstdint>
+#include <functional>
 #include <string>
 
+#include "common/buffer/buffer_impl.h"
 #include "common/common/enum_to_int.h"
+#include "common/common/logger.h"
+#include "common/filesystem/filesystem_impl.h"
+#include "common/http/header_map_impl.h"
+#include "common/http/headers.h"
 #include "common/http/message_impl.h"
 #include "common/http/utility.h"
 
 namespace Envoy {
 namespace Http {
 
+namespace {
+
+// Sent as the accept header of a stream mode request so that the server pushes framed bodies
+// instead of answering with a single response.
+const std::string StreamContentType = "application/x-envoy-discovery-stream";
+
+} // namespace
+
+RestApiFetcher::ApiType RestApiFetcher::apiType(const std::string& api_type) {
+  return api_type == "stream" ? ApiType::Stream : ApiType::Rest;
+}
+
 RestApiFetcher::RestApiFetcher(Upstream::ClusterManager& cm, const std::string& remote_cluster_name,
                                Event::Dispatcher& dispatcher, Runtime::RandomGenerator& random,
-                               std::chrono::milliseconds refresh_interval)
+                               std::chrono::milliseconds refresh_interval, ApiType api_type,
+                               Stats::Scope& scope, const std::string& stat_prefix,
+                               const std::string& snapshot_path)
     : remote_cluster_name_(remote_cluster_name), cm_(cm), random_(random),
-      refresh_interval_(refresh_interval),
+      refresh_interval_(refresh_interval), api_type_(api_type), snapshot_path_(snapshot_path),
+      stats_{ALL_REST_API_FETCHER_STATS(POOL_COUNTER_PREFIX(scope, stat_prefix),
+                                        POOL_TIMER_PREFIX(scope, stat_prefix))},
       refresh_timer_(dispatcher.createTimer([this]() -> void { refresh(); })) {}
 
 RestApiFetcher::~RestApiFetcher() {
   if (active_request_) {
     active_request_->cancel();
   }
+
+  resetStream();
 }
 
-void RestApiFetcher::initialize() { refresh(); }
+void RestApiFetcher::initialize() {
+  if (!snapshot_path_.empty()) {
+    loadSnapshot();
+  }
 
-void RestApiFetcher::onSuccess(Http::MessagePtr&& response) {
-  uint64_t response_code = Http::Utility::getResponseStatus(response->headers());
-  if (response_code != enumToInt(Http::Code::OK)) {
-    onFailure(Http::AsyncClient::FailureReason::Reset);
+  refresh();
+}
+
+void RestApiFetcher::loadSnapshot() {
+  if (!Filesystem::fileExists(snapshot_path_)) {
     return;
   }
 
+  spdlog::logger& logger = Logger::Registry::getLog(Logger::Id::config);
+  ResponseMessageImpl response(HeaderMapPtr{new HeaderMapImpl{{Headers::get().Status, "200"}}});
   try {
-    parseResponse(*response);
+    response.body().reset(new Buffer::OwnedImpl(Filesystem::fileReadToEnd(snapshot_path_)));
+    parseResponse(response);
   } catch (EnvoyException& e) {
-    onFetchFailure(&e);
+    // The fetch that follows either replaces the snapshot or fails like it would without one.
+    stats_.snapshot_load_failure_.inc();
+    logger.warn("unable to load snapshot {}: {}", snapshot_path_, e.what());
+    return;
   }
 
+  logger.info("loaded snapshot {}", snapshot_path_);
+  stats_.snapshot_load_.inc();
+  last_response_hash_.value(std::hash<std::string>{}(response.bodyAsString()));
+  onFetchComplete();
+}
+
+void RestApiFetcher::saveSnapshot(const Message& response) {
+  try {
+    Filesystem::fileWriteAtomically(snapshot_path_, response.bodyAsString());
+  } catch (EnvoyException& e) {
+    stats_.snapshot_write_failure_.inc();
+    Logger::Registry::getLog(Logger::Id::config)
+        .warn("unable to write snapshot {}: {}", snapshot_path_, e.what());
+  }
+}
+
+void RestApiFetcher::onSuccess(Http::MessagePtr&& response) {
+  uint64_t response_code = Http::Utility::getResponseStatus(response->headers());
+  if (response_code != enumToInt(Http::Code::OK)) {
+    onFailure(Http::AsyncClient::FailureReason::Reset);
+    return;
+  }
+
+  stats_.bytes_received_.add(response->body() ? response->body()->length() : 0);
+  processResponse(*response);
   requestComplete();
 }
 
 void RestApiFetcher::onFailure(Http::AsyncClient::FailureReason) {
+  update_span_.reset();
+  onFetchFailure(nullptr);
+  requestComplete();
+}
+
+void RestApiFetcher::onHeaders(HeaderMapPtr&& headers, bool end_stream) {
+  if (!stream_failed_) {
+    if (Http::Utility::getResponseStatus(*headers) != enumToInt(Http::Code::OK)) {
+      streamFailure();
+    } else {
+      stream_response_headers_ = std::move(headers);
+    }
+  }
+
+  if (end_stream) {
+    onStreamClosed();
+  }
+}
+
+void RestApiFetcher::onData(Buffer::Instance& data, bool end_stream) {
+  if (!stream_failed_) {
+    stats_.bytes_received_.add(data.length());
+    processStreamData(data);
+  }
+
+  if (end_stream) {
+    onStreamClosed();
+  }
+}
+
+void RestApiFetcher::processStreamData(Buffer::Instance& data) {
+  if (!update_span_ && data.length() > 0) {
+    update_span_ = stats_.update_latency_.allocateSpan();
+  }
+
+  if (!stream_decoder_.decode(data, stream_frames_)) {
+    stream_frames_.clear();
+    streamFailure();
+    return;
+  }
+
+  for (Grpc::Frame& frame : stream_frames_) {
+    // Discovery bodies are small enough that compression is not supported.
+    if (frame.flags_ & Grpc::GRPC_FH_COMPRESSED) {
+      stream_frames_.clear();
+      streamFailure();
+      return;
+    }
+
+    ResponseMessageImpl response(HeaderMapPtr{new HeaderMapImpl(*stream_response_headers_)});
+    response.body() = std::move(frame.data_);
+    processResponse(response);
+    onFetchComplete();
+  }
+
+  // A body that has only been partially received is measured from its first byte.
+  if (!stream_frames_.empty() && stream_decoder_.hasPartialFrame()) {
+    update_span_ = stats_.update_latency_.allocateSpan();
+  }
+  stream_frames_.clear();
+}
+
+void RestApiFetcher::onTrailers(HeaderMapPtr&&) { onStreamClosed(); }
+
+void RestApiFetcher::onReset() {
+  // A stream that is reset by resetStream() or that fails to start has no state to clean up here.
+  if (!stream_) {
+    return;
+  }
+
+  if (!stream_failed_) {
+    update_span_.reset();
+    onFetchFailure(nullptr);
+    requestComplete();
+  }
+  stream_ = nullptr;
+}
+
+void RestApiFetcher::onStreamClosed() {
+  if (!stream_failed_) {
+    requestComplete();
+  }
+  stream_ = nullptr;
+}
+
+void RestApiFetcher::streamFailure() {
+  // The stream cannot be reset from within its own callbacks. It is ignored from now on and reset
+  // before the next stream is started.
+  stream_failed_ = true;
+  update_span_.reset();
   onFetchFailure(nullptr);
   requestComplete();
 }
 
+void RestApiFetcher::resetStream() {
+  if (stream_) {
+    Http::AsyncClient::Stream* stream = stream_;
+    stream_ = nullptr;
+    stream->reset();
+  }
+}
+
+void RestApiFetcher::processResponse(const Message& response) {
+  const uint64_t response_hash = std::hash<std::string>{}(response.bodyAsString());
+  try {
+    if (last_response_hash_.valid() && last_response_hash_.value() == response_hash) {
+      onResponseUnchanged(response);
+    } else {
+      last_response_hash_ = Optional<uint64_t>();
+      parseResponse(response);
+      last_response_hash_.value(response_hash);
+      if (!snapshot_path_.empty()) {
+        saveSnapshot(response);
+      }
+    }
+  } catch (EnvoyException& e) {
+    last_response_hash_ = Optional<uint64_t>();
+    update_span_.reset();
+    onFetchFailure(&e);
+    return;
+  }
+
+  // Only updates that were applied are measured.
+  if (update_span_) {
+    update_span_->complete();
+    update_span_.reset();
+  }
+}
+
 void RestApiFetcher::refresh() {
   MessagePtr message(new RequestMessageImpl());
   createRequest(*message);
   message->headers().insertHost().value(remote_cluster_name_);
+  if (api_type_ == ApiType::Stream) {
+    startStream(std::move(message));
+    return;
+  }
+
+  update_span_ = stats_.update_latency_.allocateSpan();
   active_request_ = cm_.httpAsyncClientForCluster(remote_cluster_name_)
                         .send(std::move(message), *this,
                               Optional<std::chrono::milliseconds>(std::chrono::milliseconds(1000)));
 }
 
+void RestApiFetcher::startStream(MessagePtr&& request) {
+  resetStream();
+  stats_.stream_start_.inc();
+  stream_failed_ = false;
+  stream_decoder_ = Grpc::Decoder();
+  stream_response_headers_.reset();
+  update_span_.reset();
+
+  // The stream stays open until the server closes it so there is no timeout.
+  Http::AsyncClient::Stream* stream =
+      cm_.httpAsyncClientForCluster(remote_cluster_name_)
+          .start(*this, Optional<std::chrono::milliseconds>());
+  if (!stream) {
+    // onReset() has already been called inline, before there was a stream to fail.
+    onFetchFailure(nullptr);
+    requestComplete();
+    return;
+  }
+
+  stream_ = stream;
+  stream_request_ = std::move(request);
+  stream_request_->headers().addStatic(Headers::get().Accept, StreamContentType);
+  stream_->sendHeaders(stream_request_->headers(), true);
+}
+
 void RestApiFetcher::requestComplete() {
   onFetchComplete();
   active_request_ = nullptr;
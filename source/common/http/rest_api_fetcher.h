@@ -1,24 +1,73 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 #include <string>
+#include <vector>
 
+#include "envoy/common/optional.h"
 #include "envoy/event/dispatcher.h"
 #include "envoy/runtime/runtime.h"
+#include "envoy/stats/stats_macros.h"
 #include "envoy/upstream/cluster_manager.h"
 
+#include "common/grpc/codec.h"
+
 namespace Envoy {
 namespace Http {
 
 /**
- * A helper base class used to fetch a REST API at a jittered periodic interval. Once initialize()
- * is called, the API will be fetched and events raised.
+ * All stats for a REST API fetcher. @see stats_macros.h
  */
-class RestApiFetcher : public Http::AsyncClient::Callbacks {
+// clang-format off
+#define ALL_REST_API_FETCHER_STATS(COUNTER, TIMER)                                                 \
+  COUNTER(bytes_received)                                                                          \
+  COUNTER(snapshot_load)                                                                           \
+  COUNTER(snapshot_load_failure)                                                                   \
+  COUNTER(snapshot_write_failure)                                                                  \
+  COUNTER(stream_start)                                                                            \
+  TIMER(update_latency)
+// clang-format on
+
+/**
+ * Struct definition for all REST API fetcher stats. @see stats_macros.h
+ */
+struct RestApiFetcherStats {
+  ALL_REST_API_FETCHER_STATS(GENERATE_COUNTER_STRUCT, GENERATE_TIMER_STRUCT)
+};
+
+/**
+ * A helper base class used to fetch a REST API. Once initialize() is called, the API will be
+ * fetched and events raised.
+ *
+ * In REST mode the API is fetched at a jittered periodic interval. In stream mode a single long
+ * lived request is kept open against the API and the server pushes a complete response body,
+ * framed as a gRPC message, whenever the result changes. Every pushed body raises the same events
+ * as a fetch. If the stream fails or is closed by the server it is reopened after the jittered
+ * interval.
+ *
+ * If a snapshot path is given, the body of every response that was parsed successfully and differs
+ * from the previous one is persisted to it. On initialize() the persisted body is parsed before the
+ * first fetch, exactly as if it had just been fetched, so that the API is initialized without
+ * waiting for the remote cluster. The fetch then revalidates it in the background.
+ */
+class RestApiFetcher : public Http::AsyncClient::Callbacks,
+                       public Http::AsyncClient::StreamCallbacks {
+public:
+  enum class ApiType { Rest, Stream };
+
+  /**
+   * @param api_type supplies the "api_type" value of a discovery API configuration.
+   * @return ApiType the matching fetch mode.
+   */
+  static ApiType apiType(const std::string& api_type);
+
 protected:
   RestApiFetcher(Upstream::ClusterManager& cm, const std::string& remote_cluster_name,
                  Event::Dispatcher& dispatcher, Runtime::RandomGenerator& random,
-                 std::chrono::milliseconds refresh_interval);
+                 std::chrono::milliseconds refresh_interval, ApiType api_type,
+                 Stats::Scope& scope, const std::string& stat_prefix,
+                 const std::string& snapshot_path);
   ~RestApiFetcher();
 
   /**
@@ -27,19 +76,28 @@ protected:
   void initialize();
 
   /**
-   * This will be called when a fetch is about to happen. It should be overridden to fill the
-   * request message with a valid request.
+   * This will be called when a fetch is about to happen or a stream is about to be opened. It
+   * should be overridden to fill the request message with a valid request.
    */
   virtual void createRequest(Message& request) PURE;
 
   /**
-   * This will be called when a 200 response is returned by the API with the response message.
+   * This will be called when a 200 response is returned by the API with the response message. In
+   * stream mode the message holds the response headers and the body that was just pushed.
    */
   virtual void parseResponse(const Message& response) PURE;
 
   /**
-   * This will be called either in the success case or in the failure case for each fetch. It can
-   * be used to hold common post request logic.
+   * This will be called instead of parseResponse() when a 200 response has the same body as the
+   * last response that was parsed successfully. The default parses it again, which is required by
+   * APIs whose result also depends on local state that may have changed in the meantime. APIs
+   * whose result only depends on the response can override this to skip parsing and applying it.
+   */
+  virtual void onResponseUnchanged(const Message& response) { parseResponse(response); }
+
+  /**
+   * This will be called either in the success case or in the failure case for each fetch and for
+   * each body pushed on a stream. It can be used to hold common post request logic.
    */
   virtual void onFetchComplete() PURE;
 
@@ -55,16 +113,48 @@ protected:
 
 private:
   void refresh();
+  void loadSnapshot();
+  void saveSnapshot(const Message& response);
+  void startStream(MessagePtr&& request);
+  void processStreamData(Buffer::Instance& data);
+  void processResponse(const Message& response);
+  void onStreamClosed();
+  void streamFailure();
+  void resetStream();
   void requestComplete();
 
   // Http::AsyncClient::Callbacks
   void onSuccess(Http::MessagePtr&& response) override;
   void onFailure(Http::AsyncClient::FailureReason reason) override;
 
+  // Http::AsyncClient::StreamCallbacks
+  void onHeaders(HeaderMapPtr&& headers, bool end_stream) override;
+  void onData(Buffer::Instance& data, bool end_stream) override;
+  void onTrailers(HeaderMapPtr&& trailers) override;
+  void onReset() override;
+
   Runtime::RandomGenerator& random_;
   const std::chrono::milliseconds refresh_interval_;
+  const ApiType api_type_;
+  const std::string snapshot_path_;
+  RestApiFetcherStats stats_;
   Event::TimerPtr refresh_timer_;
   Http::AsyncClient::Request* active_request_{};
+  // The hash of the body of the last response that was parsed successfully.
+  Optional<uint64_t> last_response_hash_;
+  // Measures the time from the start of a fetch, or from the first byte of a pushed body, until
+  // the response has been processed.
+  Stats::TimespanPtr update_span_;
+
+  // State of the open stream in stream mode. The request must outlive the stream since the stream
+  // refers to its headers.
+  Http::AsyncClient::Stream* stream_{};
+  // Set when the stream failed and only waits to be reset.
+  bool stream_failed_{};
+  MessagePtr stream_request_;
+  HeaderMapPtr stream_response_headers_;
+  Grpc::Decoder stream_decoder_;
+  std::vector<Grpc::Frame> stream_frames_;
 };
 
 } // Http
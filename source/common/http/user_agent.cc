@@ -11,16 +11,26 @@
 namespace Envoy {
 namespace Http {
 
+UserAgentContext::UserAgentContext(const std::string& prefix, Stats::Store& store)
+    : store_(store), ios_(prefix + "user_agent.ios."), android_(prefix + "user_agent.android.") {}
+
+UserAgentStats& UserAgentContext::stats(TypeContext& context) {
+  std::call_once(context.stats_once_, [this, &context]() -> void {
+    context.stats_.reset(
+        new UserAgentStats{ALL_USER_AGENTS_STATS(POOL_COUNTER_PREFIX(store_, context.prefix_))});
+  });
+  return *context.stats_;
+}
+
 void UserAgent::completeConnectionLength(Stats::Timespan& span) {
   if (!stats_) {
     return;
   }
 
-  span.complete(prefix_ + "downstream_cx_length_ms");
+  span.complete(*cx_length_ms_);
 }
 
-void UserAgent::initializeFromHeaders(const HeaderMap& headers, const std::string& prefix,
-                                      Stats::Store& stat_store) {
+void UserAgent::initializeFromHeaders(const HeaderMap& headers, UserAgentContext& context) {
   // We assume that the user-agent is consistent based on the first request.
   if (type_ != Type::NotInitialized) {
     return;
@@ -28,21 +38,21 @@ void UserAgent::initializeFromHeaders(const HeaderMap& headers, const std::strin
 
   type_ = Type::Unknown;
 
+  UserAgentContext::TypeContext* type_context = nullptr;
   const HeaderEntry* user_agent = headers.UserAgent();
   if (user_agent) {
-    prefix_ = prefix;
     if (user_agent->value().find("iOS")) {
       type_ = Type::iOS;
-      prefix_ += "user_agent.ios.";
+      type_context = &context.ios_;
     } else if (user_agent->value().find("android")) {
       type_ = Type::Android;
-      prefix_ += "user_agent.android.";
+      type_context = &context.android_;
     }
   }
 
   if (type_ != Type::Unknown) {
-    stats_.reset(
-        new UserAgentStats{ALL_USER_AGENTS_STATS(POOL_COUNTER_PREFIX(stat_store, prefix_))});
+    stats_ = &context.stats(*type_context);
+    cx_length_ms_ = &type_context->cx_length_ms_;
     stats_->downstream_cx_total_.inc();
     stats_->downstream_rq_total_.inc();
   }
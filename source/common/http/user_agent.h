@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
 
 #include "envoy/http/header_map.h"
@@ -27,6 +28,37 @@ struct UserAgentStats {
 
 namespace Http {
 
+/**
+ * User agent stats shared by all of the connections of a connection manager. The stats of a user
+ * agent type are created when the first connection of that type is seen and kept afterwards, so a
+ * new connection does not build stat names.
+ */
+class UserAgentContext {
+public:
+  UserAgentContext(const std::string& prefix, Stats::Store& store);
+
+private:
+  struct TypeContext {
+    TypeContext(const std::string& prefix)
+        : prefix_(prefix), cx_length_ms_(prefix + "downstream_cx_length_ms") {}
+
+    const std::string prefix_;
+    const std::string cx_length_ms_;
+    std::once_flag stats_once_;
+    std::unique_ptr<UserAgentStats> stats_;
+  };
+
+  UserAgentStats& stats(TypeContext& context);
+
+  Stats::Store& store_;
+  TypeContext ios_;
+  TypeContext android_;
+
+  friend class UserAgent;
+};
+
+typedef std::unique_ptr<UserAgentContext> UserAgentContextPtr;
+
 /**
  * Stats support for specific user agents.
  */
@@ -42,11 +74,9 @@ public:
    * Initialize the user agent from request headers. This is only done once and the user-agent
    * is assumed to be the same for further requests.
    * @param headers supplies the request headers.
-   * @param prefix supplies the stat prefix for the UA stats.
-   * @param stat_store supplies the backing stat store.
+   * @param context supplies the stats of the user agent types.
    */
-  void initializeFromHeaders(const HeaderMap& headers, const std::string& prefix,
-                             Stats::Store& stat_store);
+  void initializeFromHeaders(const HeaderMap& headers, UserAgentContext& context);
 
   /**
    * Called when a connection is being destroyed.
@@ -59,8 +89,8 @@ private:
   enum class Type { NotInitialized, iOS, Android, Unknown };
 
   Type type_{Type::NotInitialized};
-  std::unique_ptr<UserAgentStats> stats_;
-  std::string prefix_;
+  UserAgentStats* stats_{};
+  const std::string* cx_length_ms_{};
 };
 
 } // Http
@@ -1,6 +1,7 @@
 #include "common/http/utility.h"
 
 #include <cstdint>
+#include <cstring>
 #include <string>
 #include <vector>
 
@@ -21,20 +22,26 @@
 namespace Envoy {
 namespace Http {
 
+namespace {
+
+// The separator between the addresses in x-forwarded-for.
+const char XffSeparator[] = ", ";
+
+} // namespace
+
 void Utility::appendXff(HeaderMap& headers, const Network::Address::Instance& remote_address) {
   if (remote_address.type() != Network::Address::Type::Ip) {
     return;
   }
 
-  // TODO PERF: Append and do not copy.
-  HeaderEntry* header = headers.ForwardedFor();
-  std::string forwarded_for = header ? header->value().c_str() : "";
+  // Append to the existing value in place rather than building a new one.
+  HeaderString& forwarded_for = headers.insertForwardedFor().value();
   if (!forwarded_for.empty()) {
-    forwarded_for += ", ";
+    forwarded_for.append(XffSeparator, sizeof(XffSeparator) - 1);
   }
 
-  forwarded_for += remote_address.ip()->addressAsString();
-  headers.insertForwardedFor().value(forwarded_for);
+  const std::string& address = remote_address.ip()->addressAsString();
+  forwarded_for.append(address.c_str(), address.size());
 }
 
 std::string Utility::createSslRedirectPath(const HeaderMap& headers) {
@@ -59,7 +66,7 @@ Utility::QueryParams Utility::parseQueryString(const std::string& url) {
     }
 
     size_t equal = url.find('=', start);
-    if (equal != std::string::npos) {
+    if (equal < end) {
       params.emplace(StringUtil::subspan(url, start, equal),
                      StringUtil::subspan(url, equal + 1, end));
     } else {
@@ -136,6 +143,13 @@ bool Utility::isInternalRequest(const HeaderMap& headers) {
   return Network::Utility::isInternalAddress(forwarded_for->value().c_str());
 }
 
+Http1Settings Utility::parseHttp1Settings(const Json::Object& config) {
+  Http1Settings ret;
+  Json::ObjectSharedPtr http1_settings = config.getObject("http1_settings", true);
+  ret.forward_raw_headers_ = http1_settings->getBoolean("forward_raw_headers", false);
+  return ret;
+}
+
 Http2Settings Utility::parseHttp2Settings(const Json::Object& config) {
   Http2Settings ret;
 
@@ -149,6 +163,17 @@ Http2Settings Utility::parseHttp2Settings(const Json::Object& config) {
   ret.initial_connection_window_size_ =
       http2_settings->getInteger("initial_connection_window_size",
                                  Http::Http2Settings::DEFAULT_INITIAL_CONNECTION_WINDOW_SIZE);
+  ret.hpack_encoder_table_size_ = http2_settings->getInteger(
+      "hpack_encoder_table_size", Http::Http2Settings::DEFAULT_HPACK_TABLE_SIZE);
+  ret.window_autotuning_ = http2_settings->getBoolean("window_autotuning", false);
+  ret.max_connections_per_host_ =
+      http2_settings->getInteger("max_connections_per_host",
+                                 Http::Http2Settings::DEFAULT_MAX_CONNECTIONS_PER_HOST);
+  if (http2_settings->hasObject("hpack_never_index_headers")) {
+    for (const std::string& header : http2_settings->getStringArray("hpack_never_index_headers")) {
+      ret.hpack_never_index_headers_.emplace_back(header);
+    }
+  }
 
   // http_codec_options config is DEPRECATED
   std::string options = config.getString("http_codec_options", "");
@@ -172,10 +197,18 @@ Http2Settings Utility::parseHttp2Settings(const Json::Object& config) {
   return ret;
 }
 
+HeaderLimits Utility::parseHeaderLimits(const Json::Object& config) {
+  HeaderLimits ret;
+  ret.max_bytes_ =
+      config.getInteger("max_request_headers_kb", HeaderLimits::DEFAULT_MAX_BYTES / 1024) * 1024;
+  ret.max_count_ = config.getInteger("max_request_headers_count", HeaderLimits::DEFAULT_MAX_COUNT);
+  return ret;
+}
+
 void Utility::sendLocalReply(StreamDecoderFilterCallbacks& callbacks, Code response_code,
                              const std::string& body_text) {
-  HeaderMapPtr response_headers{
-      new HeaderMapImpl{{Headers::get().Status, std::to_string(enumToInt(response_code))}}};
+  HeaderMapPtr response_headers{new HeaderMapImpl()};
+  response_headers->insertStatus().value(enumToInt(response_code));
   if (!body_text.empty()) {
     response_headers->insertContentLength().value(body_text.size());
     response_headers->insertContentType().value(Headers::get().ContentTypeValues.Text);
@@ -197,17 +230,31 @@ void Utility::sendRedirect(StreamDecoderFilterCallbacks& callbacks, const std::s
 }
 
 std::string Utility::getLastAddressFromXFF(const Http::HeaderMap& request_headers) {
-  if (!request_headers.ForwardedFor()) {
+  const HeaderEntry* header = request_headers.ForwardedFor();
+  if (!header) {
     return EMPTY_STRING;
   }
 
-  std::vector<std::string> xff_address_list =
-      StringUtil::split(request_headers.ForwardedFor()->value().c_str(), ", ");
+  // Scan from the right so that only the last address is looked at and copied. Empty entries, such
+  // as the one after a trailing separator, are skipped.
+  const char* value = header->value().c_str();
+  const size_t separator_size = sizeof(XffSeparator) - 1;
+  auto separator_ends_at = [value, separator_size](size_t index) -> bool {
+    return index >= separator_size &&
+           memcmp(value + index - separator_size, XffSeparator, separator_size) == 0;
+  };
+
+  size_t end = header->value().size();
+  while (separator_ends_at(end)) {
+    end -= separator_size;
+  }
 
-  if (xff_address_list.empty()) {
-    return EMPTY_STRING;
+  size_t start = end;
+  while (start > 0 && !separator_ends_at(start)) {
+    start--;
   }
-  return xff_address_list.back();
+
+  return std::string(value + start, end - start);
 }
 
 } // Http
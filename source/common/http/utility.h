@@ -63,12 +63,23 @@ public:
    */
   static bool isInternalRequest(const HeaderMap& headers);
 
+  /**
+   * @return Http1Settings An Http1Settings populated from the "http1_settings" JSON field.
+   */
+  static Http1Settings parseHttp1Settings(const Json::Object& config);
+
   /**
    * @return Http2Settings An Http2Settings populated from the "http_codec_options" and
    *         "http2_settings" JSON fields.
    */
   static Http2Settings parseHttp2Settings(const Json::Object& config);
 
+  /**
+   * @return HeaderLimits a HeaderLimits populated from the "max_request_headers_kb" and
+   *         "max_request_headers_count" JSON fields.
+   */
+  static HeaderLimits parseHeaderLimits(const Json::Object& config);
+
   /**
    * Create a locally generated response using filter callbacks.
    * @param callbacks supplies the filter callbacks to use.
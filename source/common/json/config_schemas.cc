@@ -2,16 +2,54 @@
 
 #include <string>
 
+#include "common/json/json_loader.h"
+
 namespace Envoy {
 const std::string Json::Schema::LISTENER_SCHEMA(R"EOF(
   {
     "$schema": "http://json-schema.org/schema#",
     "definitions": {
+      "socket_options" : {
+        "type" : "object",
+        "properties" : {
+          "keepalive" : {
+            "type" : "object",
+            "properties" : {
+              "probes" : {"type" : "integer", "minimum" : 0, "exclusiveMinimum" : true},
+              "time_s" : {"type" : "integer", "minimum" : 0, "exclusiveMinimum" : true},
+              "interval_s" : {"type" : "integer", "minimum" : 0, "exclusiveMinimum" : true}
+            },
+            "additionalProperties" : false
+          },
+          "user_timeout_ms" : {"type" : "integer", "minimum" : 0, "exclusiveMinimum" : true},
+          "send_buffer_bytes" : {"type" : "integer", "minimum" : 0, "exclusiveMinimum" : true},
+          "receive_buffer_bytes" : {"type" : "integer", "minimum" : 0, "exclusiveMinimum" : true},
+          "notsent_lowat_bytes" : {"type" : "integer", "minimum" : 0, "exclusiveMinimum" : true},
+          "tcp_fast_open_queue_length" : {
+            "type" : "integer",
+            "minimum" : 0,
+            "exclusiveMinimum" : true
+          }
+        },
+        "additionalProperties" : false
+      },
       "ssl_context" : {
         "type" : "object",
         "properties" : {
           "cert_chain_file" : {"type" : "string"},
           "private_key_file": {"type" : "string"},
+          "sni_certificates" : {
+            "type" : "array",
+            "items" : {
+              "type" : "object",
+              "properties" : {
+                "cert_chain_file" : {"type" : "string"},
+                "private_key_file": {"type" : "string"}
+              },
+              "required": ["cert_chain_file", "private_key_file"],
+              "additionalProperties": false
+            }
+          },
           "alpn_protocols" : {"type" : "string"},
           "alt_alpn_protocols": {"type" : "string"},
           "ca_cert_file" : {"type" : "string"},
@@ -23,7 +61,16 @@ const std::string Json::Schema::LISTENER_SCHEMA(R"EOF(
             }
           },
           "cipher_suites" : {"type" : "string", "minLength" : 1},
-          "ecdh_curves" : {"type" : "string", "minLength" : 1}
+          "ecdh_curves" : {"type" : "string", "minLength" : 1},
+          "session_ticket_key_paths" : {
+            "type" : "array",
+            "minItems" : 1,
+            "items" : {
+              "type" : "string"
+            }
+          },
+          "private_key_offload_threads" : {"type" : "integer", "minimum" : 1},
+          "kernel_tls_tx" : {"type" : "boolean"}
         },
         "required": ["cert_chain_file", "private_key_file"],
         "additionalProperties": false
@@ -39,6 +86,37 @@ const std::string Json::Schema::LISTENER_SCHEMA(R"EOF(
         },
         "required": ["type", "name", "config"],
         "additionalProperties": false
+      },
+      "filter_chain_match" : {
+        "type" : "object",
+        "properties" : {
+          "destination_ip_ranges" : {
+            "type" : "array",
+            "items" : {"type" : "string"}
+          },
+          "destination_port" : {"type" : "integer", "minimum" : 1, "maximum" : 65535},
+          "server_names" : {
+            "type" : "array",
+            "items" : {"type" : "string", "minLength" : 1}
+          },
+          "application_protocols" : {
+            "type" : "array",
+            "items" : {"type" : "string", "minLength" : 1}
+          }
+        },
+        "additionalProperties": false
+      },
+      "filter_chains" : {
+        "type" : "object",
+        "properties" : {
+          "filter_chain_match" : {"$ref" : "#/definitions/filter_chain_match"},
+          "filters" : {
+            "type" : "array",
+            "items": {"$ref" : "#/definitions/filters"}
+          }
+        },
+        "required": ["filters"],
+        "additionalProperties": false
       }
     },
     "type" : "object",
@@ -48,8 +126,17 @@ const std::string Json::Schema::LISTENER_SCHEMA(R"EOF(
          "type" : "array",
          "items": {"$ref" : "#/definitions/filters"}
        },
+       "filter_chains" : {
+         "type" : "array",
+         "minItems" : 1,
+         "items": {"$ref" : "#/definitions/filter_chains"}
+       },
        "ssl_context" : {"$ref" : "#/definitions/ssl_context"},
+       "socket_options" : {"$ref" : "#/definitions/socket_options"},
        "bind_to_port" : {"type": "boolean"},
+       "reuse_port" : {"type": "boolean"},
+       "reuse_port_cpu_steering" : {"type": "boolean"},
+       "balance_connections" : {"type": "boolean"},
        "use_proxy_proto" : {"type" : "boolean"},
        "use_original_dst" : {"type" : "boolean"},
        "per_connection_buffer_limit_bytes" : {
@@ -58,7 +145,7 @@ const std::string Json::Schema::LISTENER_SCHEMA(R"EOF(
          "exclusiveMinimum" : true
        }
     },
-    "required": ["address", "filters"],
+    "required": ["address"],
     "additionalProperties": false
   }
   )EOF");
@@ -101,7 +188,12 @@ const std::string Json::Schema::RDS_CONFIGURATION_SCHEMA(R"EOF(
         "type" : "integer",
         "minimum" : 0,
         "exclusiveMinimum" : true
-      }
+      },
+      "api_type" : {
+        "type" : "string",
+        "enum" : ["rest", "stream"]
+      },
+      "snapshot_path" : {"type" : "string"}
     },
     "required" : ["cluster", "route_config_name"],
     "additionalProperties" : false
@@ -262,6 +354,13 @@ const std::string Json::Schema::HTTP_CONN_NETWORK_FILTER_SCHEMA(R"EOF(
         "type" : "string",
         "enum" : ["no_compression"]
       },
+      "http1_settings" : {
+        "type" : "object",
+        "properties" : {
+          "forward_raw_headers" : {"type" : "boolean"}
+        },
+        "additionalProperties" : false
+      },
       "http2_settings" : {
         "type" : "object",
         "properties" : {
@@ -284,10 +383,29 @@ const std::string Json::Schema::HTTP_CONN_NETWORK_FILTER_SCHEMA(R"EOF(
             "type": "integer",
             "minimum": 65535,
             "maximum" : 2147483647
-          }
+          },
+          "hpack_encoder_table_size" : {
+            "type": "integer",
+            "minimum": 0,
+            "maximum" : 4294967295
+          },
+          "hpack_never_index_headers" : {
+            "type" : "array",
+            "items" : {"type" : "string"}
+          },
+          "window_autotuning" : {"type" : "boolean"}
         }
       },
       "server_name" : {"type" : "string"},
+      "max_request_headers_kb" : {
+        "type" : "integer",
+        "minimum" : 1,
+        "maximum" : 63
+      },
+      "max_request_headers_count" : {
+        "type" : "integer",
+        "minimum" : 1
+      },
       "idle_timeout_s" : {"type" : "integer"},
       "drain_timeout_ms" : {"type" : "integer"},
       "access_log" : {
@@ -297,6 +415,16 @@ const std::string Json::Schema::HTTP_CONN_NETWORK_FILTER_SCHEMA(R"EOF(
           "properties" : {
             "path" : {"type" : "string"},
             "format" : {"type" : "string"},
+            "grpc_cluster" : {"type" : "string"},
+            "log_name" : {"type" : "string"},
+            "flush_interval_ms" : {
+              "type" : "integer",
+              "minimum" : 1
+            },
+            "max_batch_bytes" : {
+              "type" : "integer",
+              "minimum" : 0
+            },
             "filter" : {
               "type" : "object",
               "oneOf" : [
@@ -309,7 +437,10 @@ const std::string Json::Schema::HTTP_CONN_NETWORK_FILTER_SCHEMA(R"EOF(
               ]
             }
           },
-          "required" : ["path"],
+          "oneOf" : [
+            {"required" : ["path"]},
+            {"required" : ["grpc_cluster"]}
+          ],
           "additionalProperties" : false
         }
       },
@@ -327,7 +458,11 @@ const std::string Json::Schema::MONGO_PROXY_NETWORK_FILTER_SCHEMA(R"EOF(
     "type" : "object",
     "properties":{
       "stat_prefix" : {"type" : "string"},
-      "access_log" : {"type" : "string"}
+      "access_log" : {"type" : "string"},
+      "access_log_max_pending" : {
+        "type" : "integer",
+        "minimum" : 1
+      }
     },
     "required": ["stat_prefix"],
     "additionalProperties" : false
@@ -371,7 +506,8 @@ const std::string Json::Schema::REDIS_PROXY_NETWORK_FILTER_SCHEMA(R"EOF(
     "properties":{
       "cluster_name" : {"type" : "string"},
       "stat_prefix" : {"type" : "string"},
-      "conn_pool" : {"type" : "object"}
+      "conn_pool" : {"type" : "object"},
+      "read_cache" : {"type" : "object"}
     },
     "required": ["cluster_name", "stat_prefix", "conn_pool"],
     "additionalProperties": false
@@ -387,13 +523,72 @@ const std::string Json::Schema::REDIS_CONN_POOL_SCHEMA(R"EOF(
         "type" : "integer",
         "minimum" : 0,
         "exclusiveMinimum" : true
-      }
+      },
+      "max_batch_size" : {
+        "type" : "integer",
+        "minimum" : 1
+      },
+      "batch_flush_delay_ms" : {
+        "type" : "integer",
+        "minimum" : 0
+      },
+      "replica_cluster" : {"type" : "string"},
+      "cluster_mode" : {"type" : "boolean"}
     },
     "required": ["op_timeout_ms"],
     "additionalProperties": false
   }
   )EOF");
 
+const std::string Json::Schema::REDIS_READ_CACHE_SCHEMA(R"EOF(
+  {
+    "$schema": "http://json-schema.org/schema#",
+    "type" : "object",
+    "properties":{
+      "key_prefixes" : {
+        "type" : "array",
+        "minItems" : 1,
+        "uniqueItems" : true,
+        "items" : {"type" : "string"}
+      },
+      "max_entries" : {
+        "type" : "integer",
+        "minimum" : 1
+      },
+      "ttl_ms" : {
+        "type" : "integer",
+        "minimum" : 0,
+        "exclusiveMinimum" : true
+      }
+    },
+    "required": ["key_prefixes", "max_entries", "ttl_ms"],
+    "additionalProperties": false
+  }
+  )EOF");
+
+const std::string Json::Schema::TAP_NETWORK_FILTER_SCHEMA(R"EOF(
+  {
+    "$schema": "http://json-schema.org/schema#",
+    "type" : "object",
+    "properties":{
+      "stat_prefix" : {"type" : "string"},
+      "path" : {"type" : "string"},
+      "sample_percent" : {
+        "type" : "integer",
+        "minimum" : 0,
+        "maximum" : 100
+      },
+      "max_connection_bytes" : {
+        "type" : "integer",
+        "minimum" : 0,
+        "maximum" : 4294967295
+      }
+    },
+    "required": ["stat_prefix", "path"],
+    "additionalProperties" : false
+  }
+  )EOF");
+
 const std::string Json::Schema::TCP_PROXY_NETWORK_FILTER_SCHEMA(R"EOF(
   {
       "$schema": "http://json-schema.org/schema#",
@@ -439,7 +634,8 @@ const std::string Json::Schema::TCP_PROXY_NETWORK_FILTER_SCHEMA(R"EOF(
             }
           },
           "additionalProperties": false
-        }
+        },
+        "splice": {"type" : "boolean"}
       },
       "required": ["stat_prefix", "route_config"],
       "additionalProperties": false
@@ -452,6 +648,7 @@ const std::string Json::Schema::ROUTE_CONFIGURATION_SCHEMA(R"EOF(
     "type" : "object",
     "properties":{
       "virtual_hosts" : {"type" : "array"},
+      "route_cache_size" : {"type" : "integer", "minimum" : 0},
       "internal_only_headers" : {
         "type" : "array",
         "items" : {"type" : "string"}
@@ -605,7 +802,12 @@ const std::string Json::Schema::ROUTE_ENTRY_CONFIGURATION_SCHEMA(R"EOF(
             "exclusiveMinimum" : true
           },
           "num_retries" : {"type" : "integer"},
-          "retry_on" : {"type" : "string"}
+          "retry_on" : {"type" : "string"},
+          "hedge_delay_ms" : {
+            "type" : "integer",
+            "minimum" : 0,
+            "exclusiveMinimum" : true
+          }
         },
         "required" : ["retry_on"],
         "additionalProperties" : false
@@ -657,6 +859,10 @@ const std::string Json::Schema::ROUTE_ENTRY_CONFIGURATION_SCHEMA(R"EOF(
       "opaque_config" : {
         "type" : "object",
         "additionalProperties" : true
+      },
+      "metadata_match" : {
+        "type" : "object",
+        "additionalProperties" : {"type" : "string"}
       }
     },
     "additionalProperties" : false
@@ -788,19 +994,85 @@ const std::string Json::Schema::HTTP_RATE_LIMITS_CONFIGURATION_SCHEMA(R"EOF(
   }
   )EOF");
 
+const std::string Json::Schema::ADAPTIVE_CONCURRENCY_HTTP_FILTER_SCHEMA(R"EOF(
+  {
+    "$schema": "http://json-schema.org/schema#",
+    "type" : "object",
+    "properties" : {
+      "initial_concurrency_limit" : {
+        "type" : "integer",
+        "minimum" : 1
+      },
+      "min_concurrency_limit" : {
+        "type" : "integer",
+        "minimum" : 1
+      },
+      "max_concurrency_limit" : {
+        "type" : "integer",
+        "minimum" : 1
+      },
+      "sample_window_ms" : {
+        "type" : "integer",
+        "minimum" : 1
+      },
+      "min_rtt_window_ms" : {
+        "type" : "integer",
+        "minimum" : 1
+      }
+    },
+    "additionalProperties" : false
+  }
+  )EOF");
+
 const std::string Json::Schema::BUFFER_HTTP_FILTER_SCHEMA(R"EOF(
   {
     "$schema": "http://json-schema.org/schema#",
     "type" : "object",
     "properties" : {
       "max_request_bytes" : {"type" : "integer"},
-      "max_request_time_s" : {"type" : "integer"}
+      "max_request_time_s" : {"type" : "integer"},
+      "spill_to_disk" : {
+        "type" : "object",
+        "properties" : {
+          "directory" : {"type" : "string", "minLength" : 1},
+          "memory_limit_bytes" : {"type" : "integer", "minimum" : 0}
+        },
+        "required" : ["directory"],
+        "additionalProperties" : false
+      }
     },
     "required" : ["max_request_bytes", "max_request_time_s"],
     "additionalProperties" : false
   }
   )EOF");
 
+const std::string Json::Schema::CACHE_HTTP_FILTER_SCHEMA(R"EOF(
+  {
+    "$schema": "http://json-schema.org/schema#",
+    "type" : "object",
+    "properties" : {
+      "max_size_bytes" : {
+        "type" : "integer",
+        "minimum" : 1
+      },
+      "max_entry_bytes" : {
+        "type" : "integer",
+        "minimum" : 1
+      }
+    },
+    "additionalProperties" : false
+  }
+  )EOF");
+
+const std::string Json::Schema::DYNAMIC_FORWARD_PROXY_HTTP_FILTER_SCHEMA(R"EOF(
+  {
+    "$schema": "http://json-schema.org/schema#",
+    "type" : "object",
+    "properties" : {},
+    "additionalProperties" : false
+  }
+  )EOF");
+
 const std::string Json::Schema::FAULT_HTTP_FILTER_SCHEMA(R"EOF(
   {
     "$schema": "http://json-schema.org/schema#",
@@ -857,6 +1129,55 @@ const std::string Json::Schema::FAULT_HTTP_FILTER_SCHEMA(R"EOF(
   }
   )EOF");
 
+const std::string Json::Schema::GRPC_HTTP1_BRIDGE_HTTP_FILTER_SCHEMA(R"EOF(
+  {
+    "$schema": "http://json-schema.org/schema#",
+    "type" : "object",
+    "properties" : {
+      "mode" : {
+        "type" : "string",
+        "enum" : ["buffered", "streaming"]
+      }
+    },
+    "additionalProperties" : false
+  }
+  )EOF");
+
+const std::string Json::Schema::GZIP_HTTP_FILTER_SCHEMA(R"EOF(
+  {
+    "$schema": "http://json-schema.org/schema#",
+    "type" : "object",
+    "properties" : {
+      "compression_level" : {
+        "type" : "integer",
+        "minimum" : 1,
+        "maximum" : 9
+      },
+      "memory_level" : {
+        "type" : "integer",
+        "minimum" : 1,
+        "maximum" : 9
+      },
+      "window_bits" : {
+        "type" : "integer",
+        "minimum" : 9,
+        "maximum" : 15
+      },
+      "min_content_length" : {
+        "type" : "integer",
+        "minimum" : 0
+      },
+      "content_types" : {
+        "type" : "array",
+        "minItems" : 1,
+        "uniqueItems" : true,
+        "items" : {"type" : "string"}
+      }
+    },
+    "additionalProperties" : false
+  }
+  )EOF");
+
 const std::string Json::Schema::IP_TAGGING_HTTP_FILTER_SCHEMA(R"EOF(
   {
     "$schema": "http://json-schema.org/schema#",
@@ -930,7 +1251,17 @@ const std::string Json::Schema::ROUTER_HTTP_FILTER_SCHEMA(R"EOF(
     "$schema": "http://json-schema.org/schema#",
     "type" : "object",
     "properties" : {
-      "dynamic_stats" : {"type" : "boolean"}
+      "dynamic_stats" : {"type" : "boolean"},
+      "request_coalescing" : {
+        "type" : "object",
+        "properties" : {
+          "vary_headers" : {
+            "type" : "array",
+            "items" : {"type" : "string"}
+          }
+        },
+        "additionalProperties" : false
+      }
     },
     "additionalProperties" : false
   }
@@ -948,7 +1279,12 @@ const std::string Json::Schema::CLUSTER_MANAGER_SCHEMA(R"EOF(
             "type" : "integer",
             "minimum" : 0,
             "exclusiveMinimum" : true
-          }
+          },
+          "api_type" : {
+            "type" : "string",
+            "enum" : ["rest", "stream"]
+          },
+          "snapshot_dir" : {"type" : "string"}
         },
         "required" : ["cluster", "refresh_delay_ms"],
         "additionalProperties" : false
@@ -961,7 +1297,13 @@ const std::string Json::Schema::CLUSTER_MANAGER_SCHEMA(R"EOF(
             "type" : "integer",
             "minimum" : 0,
             "exclusiveMinimum" : true
-          }
+          },
+          "api_type" : {
+            "type" : "string",
+            "enum" : ["rest", "stream"]
+          },
+          "on_demand" : {"type" : "boolean"},
+          "snapshot_path" : {"type" : "string"}
         },
         "required" : ["cluster"],
         "additionalProperties" : false
@@ -975,6 +1317,15 @@ const std::string Json::Schema::CLUSTER_MANAGER_SCHEMA(R"EOF(
       },
       "sds" : {"$ref" : "#/definitions/sds"},
       "local_cluster_name" : {"type" : "string"},
+      "max_concurrent_secondary_init" : {
+        "type" : "integer",
+        "minimum" : 0
+      },
+      "idle_cluster_timeout_ms" : {
+        "type" : "integer",
+        "minimum" : 0,
+        "exclusiveMinimum" : true
+      },
       "outlier_detection" : {
         "type" : "object",
         "properties" : {
@@ -1024,7 +1375,21 @@ const std::string Json::Schema::TOP_LEVEL_CONFIG_SCHEMA(R"EOF(
             "type" : "object",
             "properties" : {
               "collector_cluster" : {"type" : "string"},
-              "collector_endpoint": {"type": "string"}
+              "collector_endpoint": {"type": "string"},
+              "collector_encoding": {
+                "type": "string",
+                "enum": ["json", "thrift"]
+              },
+              "tail_sampling": {
+                "type": "object",
+                "properties": {
+                  "latency_threshold_ms": {"type": "integer", "minimum": 0},
+                  "max_buffered_spans": {"type": "integer", "minimum": 0},
+                  "max_exports_per_second": {"type": "integer", "minimum": 1}
+                },
+                "required": ["latency_threshold_ms"],
+                "additionalProperties": false
+              }
             },
             "required": ["collector_cluster"],
             "additionalProperties" : false
@@ -1038,17 +1403,33 @@ const std::string Json::Schema::TOP_LEVEL_CONFIG_SCHEMA(R"EOF(
         "properties" : {
           "type" : {
             "type" : "string",
-            "enum" : ["grpc_service"]
+            "enum" : ["grpc_service", "local"]
           },
-          "config" : {
-            "type" : "object",
+          "config" : {"type" : "object"}
+        },
+        "oneOf" : [
+          {
             "properties" : {
-              "cluster_name" :{"type" : "string"}
-            },
-            "required" : ["cluster_name"],
-            "additionalProperties" : false
+              "type" : {"enum" : ["grpc_service"]},
+              "config" : {
+                "properties" : {
+                  "cluster_name" :{"type" : "string"},
+                  "coalesce_window_ms" : {
+                    "type" : "integer",
+                    "minimum" : 0
+                  }
+                },
+                "required" : ["cluster_name"],
+                "additionalProperties" : false
+              }
+            }
+          },
+          {
+            "properties" : {
+              "type" : {"enum" : ["local"]}
+            }
           }
-        },
+        ],
         "required" : ["type", "config"],
         "additionalProperties" : false
       }
@@ -1064,6 +1445,15 @@ const std::string Json::Schema::TOP_LEVEL_CONFIG_SCHEMA(R"EOF(
         "properties" : {
           "access_log_path" : {"type" : "string"},
           "profile_path" : {"type" : "string"},
+          "profile_frequency_hz" : {
+            "type" : "integer",
+            "minimum" : 1,
+            "maximum" : 1000
+          },
+          "profile_window_ms" : {
+            "type" : "integer",
+            "minimum" : 1000
+          },
           "address" : {"type" : "string"}
         },
         "required" : ["access_log_path", "address"],
@@ -1073,8 +1463,35 @@ const std::string Json::Schema::TOP_LEVEL_CONFIG_SCHEMA(R"EOF(
       "flags_path" : {"type" : "string"},
       "statsd_local_udp_port" : {"type" : "integer"},
       "statsd_udp_ip_address" : {"type" : "string"},
+      "statsd_udp_max_datagram_size" : {
+        "type" : "integer",
+        "minimum" : 0,
+        "maximum" : 65507
+      },
       "statsd_tcp_cluster_name" : {"type" : "string"},
       "stats_flush_interval_ms" : {"type" : "integer"},
+      "stats_tags" : {
+        "type" : "array",
+        "items" : {
+          "type" : "object",
+          "properties" : {
+            "tag_name" : {"type" : "string"},
+            "regex" : {"type" : "string"}
+          },
+          "required" : ["tag_name", "regex"],
+          "additionalProperties" : false
+        }
+      },
+      "use_all_default_tags" : {"type" : "boolean"},
+      "watchdog_miss_timeout_ms" : {"type" : "integer", "minimum" : 0},
+      "watchdog_megamiss_timeout_ms" : {"type" : "integer", "minimum" : 0},
+      "watchdog_kill_timeout_ms" : {"type" : "integer", "minimum" : 0},
+      "watchdog_multikill_timeout_ms" : {"type" : "integer", "minimum" : 0},
+      "watchdog_stall_samples" : {
+        "type" : "integer",
+        "minimum" : 0,
+        "maximum" : 20
+      },
       "tracing" : {
         "type" : "object",
         "properties" : {
@@ -1093,6 +1510,7 @@ const std::string Json::Schema::TOP_LEVEL_CONFIG_SCHEMA(R"EOF(
           }
         }
       },
+      "overload_manager" : {"type" : "object"},
       "rate_limit_service" : {"$ref" : "#/definitions/rate_limit_service"},
       "runtime" : {
         "type" : "object",
@@ -1126,7 +1544,7 @@ const std::string Json::Schema::CLUSTER_HEALTH_CHECK_SCHEMA(R"EOF(
     "properties" : {
       "type" : {
         "type" : "string",
-        "enum" : ["http", "redis", "tcp"]
+        "enum" : ["grpc", "http", "redis", "tcp"]
       },
       "timeout_ms" : {
         "type" : "integer",
@@ -1162,7 +1580,14 @@ const std::string Json::Schema::CLUSTER_HEALTH_CHECK_SCHEMA(R"EOF(
         "minimum" : 0,
         "exclusiveMinimum" : true
       },
-      "service_name" : {"type" : "string"}
+      "timer_resolution_ms" : {
+        "type" : "integer",
+        "minimum" : 0,
+        "exclusiveMinimum" : true
+      },
+      "share_across_clusters" : {"type" : "boolean"},
+      "service_name" : {"type" : "string"},
+      "use_http2" : {"type" : "boolean"}
     },
     "required" : ["type", "timeout_ms", "interval_ms", "unhealthy_threshold", "healthy_threshold"],
     "additionalProperties" : false
@@ -1173,13 +1598,48 @@ const std::string Json::Schema::CLUSTER_SCHEMA(R"EOF(
   {
     "$schema": "http://json-schema.org/schema#",
     "definitions" : {
+      "socket_options" : {
+        "type" : "object",
+        "properties" : {
+          "keepalive" : {
+            "type" : "object",
+            "properties" : {
+              "probes" : {"type" : "integer", "minimum" : 0, "exclusiveMinimum" : true},
+              "time_s" : {"type" : "integer", "minimum" : 0, "exclusiveMinimum" : true},
+              "interval_s" : {"type" : "integer", "minimum" : 0, "exclusiveMinimum" : true}
+            },
+            "additionalProperties" : false
+          },
+          "user_timeout_ms" : {"type" : "integer", "minimum" : 0, "exclusiveMinimum" : true},
+          "send_buffer_bytes" : {"type" : "integer", "minimum" : 0, "exclusiveMinimum" : true},
+          "receive_buffer_bytes" : {"type" : "integer", "minimum" : 0, "exclusiveMinimum" : true},
+          "notsent_lowat_bytes" : {"type" : "integer", "minimum" : 0, "exclusiveMinimum" : true},
+          "tcp_fast_open" : {"type" : "boolean"}
+        },
+        "additionalProperties" : false
+      },
       "circuit_breakers" : {
         "type" : "object",
         "properties" : {
           "max_connections" : {"type" : "integer"},
           "max_pending_requests" : {"type" : "integer"},
           "max_requests" : {"type" : "integer"},
-          "max_retries" : {"type" : "integer"}
+          "max_retries" : {"type" : "integer"},
+          "retry_budget" : {
+            "type" : "object",
+            "properties" : {
+              "budget_percent" : {
+                "type" : "number",
+                "minimum" : 0,
+                "maximum" : 100
+              },
+              "min_retry_concurrency" : {
+                "type" : "integer",
+                "minimum" : 0
+              }
+            },
+            "additionalProperties" : false
+          }
         },
         "additionalProperties" : false
       },
@@ -1214,7 +1674,8 @@ const std::string Json::Schema::CLUSTER_SCHEMA(R"EOF(
       },
       "type" : {
         "type" : "string",
-        "enum" : ["static", "strict_dns", "logical_dns", "sds"]
+        "enum" : ["static", "strict_dns", "logical_dns", "sds", "original_dst",
+                  "dynamic_forward_proxy"]
       },
       "connect_timeout_ms" : {
         "type" : "integer",
@@ -1228,7 +1689,52 @@ const std::string Json::Schema::CLUSTER_SCHEMA(R"EOF(
       },
       "lb_type" : {
         "type" : "string",
-        "enum" : ["round_robin", "least_request", "random", "ring_hash"]
+        "enum" : ["round_robin", "least_request", "random", "ring_hash", "maglev",
+                  "original_dst_lb", "dynamic_forward_proxy_lb"]
+      },
+      "cleanup_interval_ms" : {
+        "type" : "integer",
+        "minimum" : 0,
+        "exclusiveMinimum" : true
+      },
+      "locality_weights" : {
+        "type" : "object",
+        "additionalProperties" : {
+          "type" : "integer",
+          "minimum" : 1,
+          "maximum" : 100
+        }
+      },
+      "ring_hash_lb_config" : {
+        "type" : "object",
+        "properties" : {
+          "hash_function" : {
+            "type" : "string",
+            "enum" : ["std_hash", "xx_hash"]
+          }
+        },
+        "additionalProperties" : false
+      },
+      "lb_subset_config" : {
+        "type" : "object",
+        "properties" : {
+          "subset_keys" : {
+            "type" : "array",
+            "minItems" : 1,
+            "items" : {
+              "type" : "array",
+              "minItems" : 1,
+              "uniqueItems" : true,
+              "items" : {"type" : "string"}
+            }
+          },
+          "fallback_policy" : {
+            "type" : "string",
+            "enum" : ["no_fallback", "any_endpoint"]
+          }
+        },
+        "required" : ["subset_keys"],
+        "additionalProperties" : false
       },
       "hosts" : {
         "type" : "array",
@@ -1237,7 +1743,13 @@ const std::string Json::Schema::CLUSTER_SCHEMA(R"EOF(
         "items" : {
           "type" : "object",
           "properties" : {
-            "url" : {"type" : "string"}
+            "url" : {"type" : "string"},
+            "zone" : {"type" : "string"},
+            "priority" : {"type" : "integer", "minimum" : 0},
+            "metadata" : {
+              "type" : "object",
+              "additionalProperties" : {"type" : "string"}
+            }
           },
           "required" : ["url"],
           "additionalProperties" : false
@@ -1250,6 +1762,29 @@ const std::string Json::Schema::CLUSTER_SCHEMA(R"EOF(
         "minimum" : 0,
         "exclusiveMinimum" : true
       },
+      "prefetch_ratio" : {
+        "type" : "number",
+        "minimum" : 1.0,
+        "maximum" : 3.0
+      },
+      "http1_pipeline_depth" : {
+        "type" : "integer",
+        "minimum" : 1,
+        "maximum" : 16
+      },
+      "max_requests_per_connection_jitter_percent" : {
+        "type" : "integer",
+        "minimum" : 0,
+        "maximum" : 100,
+        "exclusiveMaximum" : true
+      },
+      "idle_timeout_ms" : {
+        "type" : "integer",
+        "minimum" : 0,
+        "exclusiveMinimum" : true
+      },
+      "share_connection_pools" : {"type" : "boolean"},
+      "socket_options" : {"$ref" : "#/definitions/socket_options"},
       "circuit_breakers" : {
         "type" : "object",
         "properties" : {
@@ -1289,6 +1824,21 @@ const std::string Json::Schema::CLUSTER_SCHEMA(R"EOF(
             "type": "integer",
             "minimum": 65535,
             "maximum" : 2147483647
+          },
+          "hpack_encoder_table_size" : {
+            "type": "integer",
+            "minimum": 0,
+            "maximum" : 4294967295
+          },
+          "hpack_never_index_headers" : {
+            "type" : "array",
+            "items" : {"type" : "string"}
+          },
+          "window_autotuning" : {"type" : "boolean"},
+          "max_connections_per_host" : {
+            "type": "integer",
+            "minimum": 1,
+            "maximum" : 64
           }
         }
       },
@@ -1354,6 +1904,26 @@ const std::string Json::Schema::CLUSTER_SCHEMA(R"EOF(
             "type" : "integer",
             "minimum" : 0,
             "maximum" : 100
+          },
+          "latency_minimum_hosts" : {
+            "type" : "integer",
+            "minimum" : 0,
+            "exclusiveMinimum" : true
+          },
+          "latency_request_volume" : {
+            "type" : "integer",
+            "minimum" : 0,
+            "exclusiveMinimum" : true
+          },
+          "latency_stdev_factor" : {
+            "type" : "integer",
+            "minimum" : 0,
+            "exclusiveMinimum" : true
+          },
+          "enforcing_latency" : {
+            "type" : "integer",
+            "minimum" : 0,
+            "maximum" : 100
           }
         },
         "additionalProperties" : false
@@ -1397,6 +1967,11 @@ const std::string Json::Schema::SDS_SCHEMA(R"EOF(
                 "type" : "integer",
                 "minimum" : 1,
                 "maximum" : 100
+              },
+              "priority" : {"type" : "integer", "minimum" : 0},
+              "metadata" : {
+                "type" : "object",
+                "additionalProperties" : {"type" : "string"}
               }
             }
           }
@@ -1414,4 +1989,184 @@ const std::string Json::Schema::SDS_SCHEMA(R"EOF(
     "required" : ["hosts"]
   }
   )EOF");
+
+const std::string Json::Schema::LOCAL_RATE_LIMIT_SERVICE_SCHEMA(R"EOF(
+  {
+    "$schema": "http://json-schema.org/schema#",
+    "type" : "object",
+    "properties" : {
+      "rebalance_interval_ms" : {
+        "type" : "integer",
+        "minimum" : 1
+      },
+      "limits" : {
+        "type" : "array",
+        "items" : {
+          "type" : "object",
+          "properties" : {
+            "domain" : {"type" : "string"},
+            "descriptor" : {
+              "type" : "array",
+              "minItems" : 1,
+              "items" : {
+                "type" : "object",
+                "properties" : {
+                  "key" : {"type" : "string"},
+                  "value" : {"type" : "string"}
+                },
+                "required" : ["key", "value"],
+                "additionalProperties" : false
+              }
+            },
+            "requests_per_second" : {
+              "type" : "integer",
+              "minimum" : 1
+            },
+            "burst" : {
+              "type" : "integer",
+              "minimum" : 1
+            }
+          },
+          "required" : ["domain", "descriptor", "requests_per_second"],
+          "additionalProperties" : false
+        }
+      },
+      "hybrid" : {
+        "type" : "object",
+        "properties" : {
+          "cluster_name" : {"type" : "string"},
+          "coalesce_window_ms" : {
+            "type" : "integer",
+            "minimum" : 0
+          },
+          "threshold_percent" : {
+            "type" : "integer",
+            "minimum" : 0,
+            "maximum" : 100
+          }
+        },
+        "required" : ["cluster_name"],
+        "additionalProperties" : false
+      }
+    },
+    "required" : ["limits"],
+    "additionalProperties" : false
+  }
+  )EOF");
+
+const std::string Json::Schema::OVERLOAD_MANAGER_SCHEMA(R"EOF(
+  {
+    "$schema": "http://json-schema.org/schema#",
+    "type" : "object",
+    "properties" : {
+      "refresh_interval_ms" : {
+        "type" : "integer",
+        "minimum" : 1
+      },
+      "reduced_buffer_limit_bytes" : {
+        "type" : "integer",
+        "minimum" : 1
+      },
+      "resources" : {
+        "type" : "object",
+        "properties" : {
+          "heap_size_bytes" : {
+            "type" : "integer",
+            "minimum" : 1
+          },
+          "active_connections" : {
+            "type" : "integer",
+            "minimum" : 1
+          },
+          "event_loop_lag_ms" : {
+            "type" : "integer",
+            "minimum" : 1
+          },
+          "buffered_bytes" : {
+            "type" : "integer",
+            "minimum" : 1
+          }
+        },
+        "additionalProperties" : false
+      },
+      "actions" : {
+        "type" : "array",
+        "items" : {
+          "type" : "object",
+          "properties" : {
+            "name" : {
+              "type" : "string",
+              "enum" : ["stop_accepting_connections", "disable_http_keepalive",
+                        "reduce_buffer_limits", "shrink_heap", "reset_largest_connections"]
+            },
+            "triggers" : {
+              "type" : "array",
+              "minItems" : 1,
+              "items" : {
+                "type" : "object",
+                "properties" : {
+                  "resource" : {
+                    "type" : "string",
+                    "enum" : ["heap_size", "active_connections", "event_loop_lag",
+                              "buffered_bytes"]
+                  },
+                  "threshold_percent" : {
+                    "type" : "integer",
+                    "minimum" : 1,
+                    "maximum" : 100
+                  }
+                },
+                "required" : ["resource", "threshold_percent"],
+                "additionalProperties" : false
+              }
+            }
+          },
+          "required" : ["name", "triggers"],
+          "additionalProperties" : false
+        }
+      }
+    },
+    "additionalProperties" : false
+  }
+  )EOF");
+
+void Json::Schema::registerNames() {
+  SchemaRegistry::setName(TOP_LEVEL_CONFIG_SCHEMA, "top_level_config");
+  SchemaRegistry::setName(LISTENER_SCHEMA, "listener");
+  SchemaRegistry::setName(CLIENT_SSL_NETWORK_FILTER_SCHEMA, "client_ssl_network_filter");
+  SchemaRegistry::setName(HTTP_CONN_NETWORK_FILTER_SCHEMA, "http_conn_network_filter");
+  SchemaRegistry::setName(MONGO_PROXY_NETWORK_FILTER_SCHEMA, "mongo_proxy_network_filter");
+  SchemaRegistry::setName(RATELIMIT_NETWORK_FILTER_SCHEMA, "ratelimit_network_filter");
+  SchemaRegistry::setName(REDIS_PROXY_NETWORK_FILTER_SCHEMA, "redis_proxy_network_filter");
+  SchemaRegistry::setName(TAP_NETWORK_FILTER_SCHEMA, "tap_network_filter");
+  SchemaRegistry::setName(TCP_PROXY_NETWORK_FILTER_SCHEMA, "tcp_proxy_network_filter");
+  SchemaRegistry::setName(ROUTE_CONFIGURATION_SCHEMA, "route_configuration");
+  SchemaRegistry::setName(VIRTUAL_HOST_CONFIGURATION_SCHEMA, "virtual_host_configuration");
+  SchemaRegistry::setName(ROUTE_ENTRY_CONFIGURATION_SCHEMA, "route_entry_configuration");
+  SchemaRegistry::setName(HTTP_RATE_LIMITS_CONFIGURATION_SCHEMA, "http_rate_limits_configuration");
+  SchemaRegistry::setName(RDS_CONFIGURATION_SCHEMA, "rds_configuration");
+  SchemaRegistry::setName(HEADER_DATA_CONFIGURATION_SCHEMA, "header_data_configuration");
+  SchemaRegistry::setName(ADAPTIVE_CONCURRENCY_HTTP_FILTER_SCHEMA,
+                          "adaptive_concurrency_http_filter");
+  SchemaRegistry::setName(BUFFER_HTTP_FILTER_SCHEMA, "buffer_http_filter");
+  SchemaRegistry::setName(CACHE_HTTP_FILTER_SCHEMA, "cache_http_filter");
+  SchemaRegistry::setName(DYNAMIC_FORWARD_PROXY_HTTP_FILTER_SCHEMA,
+                          "dynamic_forward_proxy_http_filter");
+  SchemaRegistry::setName(FAULT_HTTP_FILTER_SCHEMA, "fault_http_filter");
+  SchemaRegistry::setName(GZIP_HTTP_FILTER_SCHEMA, "gzip_http_filter");
+  SchemaRegistry::setName(HEALTH_CHECK_HTTP_FILTER_SCHEMA, "health_check_http_filter");
+  SchemaRegistry::setName(IP_TAGGING_HTTP_FILTER_SCHEMA, "ip_tagging_http_filter");
+  SchemaRegistry::setName(RATE_LIMIT_HTTP_FILTER_SCHEMA, "rate_limit_http_filter");
+  SchemaRegistry::setName(ROUTER_HTTP_FILTER_SCHEMA, "router_http_filter");
+  SchemaRegistry::setName(CLUSTER_MANAGER_SCHEMA, "cluster_manager");
+  SchemaRegistry::setName(CLUSTER_HEALTH_CHECK_SCHEMA, "cluster_health_check");
+  SchemaRegistry::setName(CLUSTER_SCHEMA, "cluster");
+  SchemaRegistry::setName(CDS_SCHEMA, "cds");
+  SchemaRegistry::setName(SDS_SCHEMA, "sds");
+  SchemaRegistry::setName(REDIS_CONN_POOL_SCHEMA, "redis_conn_pool");
+  SchemaRegistry::setName(REDIS_READ_CACHE_SCHEMA, "redis_read_cache");
+  SchemaRegistry::setName(LOCAL_RATE_LIMIT_SERVICE_SCHEMA, "local_rate_limit_service");
+  SchemaRegistry::setName(OVERLOAD_MANAGER_SCHEMA, "overload_manager");
+}
+
 } // Envoy
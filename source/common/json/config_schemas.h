@@ -19,6 +19,7 @@ public:
   static const std::string MONGO_PROXY_NETWORK_FILTER_SCHEMA;
   static const std::string RATELIMIT_NETWORK_FILTER_SCHEMA;
   static const std::string REDIS_PROXY_NETWORK_FILTER_SCHEMA;
+  static const std::string TAP_NETWORK_FILTER_SCHEMA;
   static const std::string TCP_PROXY_NETWORK_FILTER_SCHEMA;
 
   // HTTP Connection Manager Schemas
@@ -30,8 +31,13 @@ public:
   static const std::string HEADER_DATA_CONFIGURATION_SCHEMA;
 
   // HTTP Filter Schemas
+  static const std::string ADAPTIVE_CONCURRENCY_HTTP_FILTER_SCHEMA;
   static const std::string BUFFER_HTTP_FILTER_SCHEMA;
+  static const std::string CACHE_HTTP_FILTER_SCHEMA;
+  static const std::string DYNAMIC_FORWARD_PROXY_HTTP_FILTER_SCHEMA;
   static const std::string FAULT_HTTP_FILTER_SCHEMA;
+  static const std::string GRPC_HTTP1_BRIDGE_HTTP_FILTER_SCHEMA;
+  static const std::string GZIP_HTTP_FILTER_SCHEMA;
   static const std::string HEALTH_CHECK_HTTP_FILTER_SCHEMA;
   static const std::string IP_TAGGING_HTTP_FILTER_SCHEMA;
   static const std::string RATE_LIMIT_HTTP_FILTER_SCHEMA;
@@ -48,6 +54,19 @@ public:
 
   // Redis Schemas
   static const std::string REDIS_CONN_POOL_SCHEMA;
+  static const std::string REDIS_READ_CACHE_SCHEMA;
+
+  // Rate Limit Schemas
+  static const std::string LOCAL_RATE_LIMIT_SERVICE_SCHEMA;
+
+  // Overload Manager Schemas
+  static const std::string OVERLOAD_MANAGER_SCHEMA;
+
+  /**
+   * Name all of the above schemas in the SchemaRegistry, so that each of them has its own
+   * validation stats.
+   */
+  static void registerNames();
 };
 
 } // Json
@@ -3,10 +3,14 @@
 #include <cstdint>
 #include <fstream>
 #include <limits>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <sstream>
 #include <stack>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "common/common/assert.h"
@@ -29,39 +33,58 @@ namespace Json {
 
 namespace {
 /**
- * Internal representation of Object.
+ * Internal representation of Object. All fields of a document are owned by its Document and are
+ * freed together with it.
  */
-class Field;
-typedef std::shared_ptr<Field> FieldSharedPtr;
+class Document;
 
-class Field : public Object, public std::enable_shared_from_this<Field> {
+class Field : public Object {
 public:
+  enum class Type {
+    Array,
+    Boolean,
+    Double,
+    Integer,
+    Null,
+    Object,
+    String,
+  };
+
+  // Fields are only constructed by Document::createField().
+  Field(Document& document, Type type) : document_(document), type_(type) {}
+  Field(Document& document, std::string&& value) : document_(document), type_(Type::String) {
+    value_.string_value_ = std::move(value);
+  }
+  Field(Document& document, int64_t value) : document_(document), type_(Type::Integer) {
+    value_.integer_value_ = value;
+  }
+  Field(Document& document, double value) : document_(document), type_(Type::Double) {
+    value_.double_value_ = value;
+  }
+  Field(Document& document, bool value) : document_(document), type_(Type::Boolean) {
+    value_.boolean_value_ = value;
+  }
+
   void setLineNumberStart(uint64_t line_number) { line_number_start_ = line_number; }
   void setLineNumberEnd(uint64_t line_number) { line_number_end_ = line_number; }
 
-  // Container factories for handler.
-  // TODO(danielhochman): figure out how to do make_shared on private constructors
-  static FieldSharedPtr createObject() { return FieldSharedPtr{new Field(Type::Object)}; }
-  static FieldSharedPtr createArray() { return FieldSharedPtr{new Field(Type::Array)}; }
-  static FieldSharedPtr createNull() { return FieldSharedPtr{new Field(Type::Null)}; }
-
   bool isArray() const { return type_ == Type::Array; }
   bool isObject() const { return type_ == Type::Object; }
 
-  // Value factory.
-  template <typename T> static FieldSharedPtr createValue(T value) {
-    return FieldSharedPtr{new Field(value)};
-  }
-
-  void append(FieldSharedPtr field_ptr) {
+  void append(Field& field) {
     checkType(Type::Array);
-    value_.array_value_.push_back(field_ptr);
+    value_.array_value_.push_back(&field);
   }
-  void insert(const std::string& key, FieldSharedPtr field_ptr) {
+  void insert(const std::string& key, Field& field) {
     checkType(Type::Object);
-    value_.object_value_[key] = field_ptr;
+    value_.object_value_[key] = &field;
   }
 
+  /**
+   * @return ObjectSharedPtr a pointer to this field which keeps the whole document alive.
+   */
+  ObjectSharedPtr shared() const;
+
   uint64_t hash() const override;
 
   bool getBoolean(const std::string& name) const override;
@@ -84,15 +107,6 @@ public:
   void validateSchema(const std::string& schema) const override;
 
 private:
-  enum class Type {
-    Array,
-    Boolean,
-    Double,
-    Integer,
-    Null,
-    Object,
-    String,
-  };
   static const char* typeAsString(Type t) {
     switch (t) {
     case Type::Array:
@@ -115,20 +129,14 @@ private:
   }
 
   struct Value {
-    std::vector<FieldSharedPtr> array_value_;
+    std::vector<Field*> array_value_;
     bool boolean_value_;
     double double_value_;
     int64_t integer_value_;
-    std::unordered_map<std::string, FieldSharedPtr> object_value_;
+    std::unordered_map<std::string, Field*> object_value_;
     std::string string_value_;
   };
 
-  explicit Field(Type type) : type_(type) {}
-  explicit Field(const std::string& value) : type_(Type::String) { value_.string_value_ = value; }
-  explicit Field(int64_t value) : type_(Type::Integer) { value_.integer_value_ = value; }
-  explicit Field(double value) : type_(Type::Double) { value_.double_value_ = value; }
-  explicit Field(bool value) : type_(Type::Boolean) { value_.boolean_value_ = value; }
-
   bool isType(Type type) const { return type == type_; }
   void checkType(Type type) const {
     if (!isType(type)) {
@@ -139,11 +147,11 @@ private:
   }
 
   // Value return type functions.
-  std::string stringValue() const {
+  const std::string& stringValue() const {
     checkType(Type::String);
     return value_.string_value_;
   }
-  std::vector<FieldSharedPtr> arrayValue() const {
+  const std::vector<Field*>& arrayValue() const {
     checkType(Type::Array);
     return value_.array_value_;
   }
@@ -160,16 +168,185 @@ private:
     return value_.integer_value_;
   }
 
-  rapidjson::Document asRapidJsonDocument() const;
-  static void buildRapidJsonDocument(const Field& field, rapidjson::Value& value,
-                                     rapidjson::Document::AllocatorType& allocator);
+  static std::vector<ObjectSharedPtr> sharedArray(const std::vector<Field*>& array);
+
+  /**
+   * Replay the field as RapidJson SAX events, e.g. into a writer or a schema validator, without
+   * building a RapidJson document first.
+   * @return bool false if the handler stopped the replay.
+   */
+  template <typename Handler> bool accept(Handler& handler) const;
 
-  uint64_t line_number_start_;
-  uint64_t line_number_end_;
+  Document& document_;
+  uint64_t line_number_start_{};
+  uint64_t line_number_end_{};
   const Type type_;
   Value value_;
 };
 
+/**
+ * Arena which owns all the fields of a parsed document. Fields are allocated in chunks, so that a
+ * document costs a handful of allocations for the tree structure instead of one allocation plus a
+ * reference count per field, and the whole tree is freed in one shot when the last ObjectSharedPtr
+ * into it goes away.
+ */
+class Document : public std::enable_shared_from_this<Document> {
+public:
+  template <typename... Args> Field& createField(Args&&... args) {
+    // A chunk never grows past the capacity that was reserved for it, so fields are never moved
+    // and pointers to them stay valid.
+    if (chunks_.empty() || chunks_.back().size() == chunks_.back().capacity()) {
+      chunks_.emplace_back();
+      chunks_.back().reserve(FieldsPerChunk);
+    }
+    chunks_.back().emplace_back(*this, std::forward<Args>(args)...);
+    return chunks_.back().back();
+  }
+
+  /**
+   * @return ObjectSharedPtr an empty object in a new document.
+   */
+  static ObjectSharedPtr createEmptyObject() {
+    std::shared_ptr<Document> document = std::make_shared<Document>();
+    return document->createField(Field::Type::Object).shared();
+  }
+
+  /**
+   * @return whether a field of this document is known to conform to a schema.
+   */
+  bool validated(const Field& field, const rapidjson::SchemaDocument& schema) {
+    std::unique_lock<std::mutex> lock(validated_lock_);
+    return validated_.count({&field, &schema}) != 0;
+  }
+
+  /**
+   * Remember that a field of this document conforms to a schema. Fields never change once the
+   * document is parsed, so it always will.
+   */
+  void setValidated(const Field& field, const rapidjson::SchemaDocument& schema) {
+    std::unique_lock<std::mutex> lock(validated_lock_);
+    validated_.insert({&field, &schema});
+  }
+
+private:
+  static const size_t FieldsPerChunk = 256;
+
+  std::vector<std::vector<Field>> chunks_;
+  // Fields may be validated from several threads, e.g. by a parallel config validation.
+  std::mutex validated_lock_;
+  std::set<std::pair<const Field*, const rapidjson::SchemaDocument*>> validated_;
+};
+
+ObjectSharedPtr Field::shared() const {
+  return ObjectSharedPtr(document_.shared_from_this(), const_cast<Field*>(this));
+}
+
+std::vector<ObjectSharedPtr> Field::sharedArray(const std::vector<Field*>& array) {
+  std::vector<ObjectSharedPtr> shared_array;
+  shared_array.reserve(array.size());
+  for (const Field* element : array) {
+    shared_array.push_back(element->shared());
+  }
+
+  return shared_array;
+}
+
+template <typename Handler> bool Field::accept(Handler& handler) const {
+  switch (type_) {
+  case Type::Array:
+    if (!handler.StartArray()) {
+      return false;
+    }
+    for (const Field* element : value_.array_value_) {
+      if (!element->accept(handler)) {
+        return false;
+      }
+    }
+    return handler.EndArray(static_cast<rapidjson::SizeType>(value_.array_value_.size()));
+  case Type::Object:
+    if (!handler.StartObject()) {
+      return false;
+    }
+    for (const auto& item : value_.object_value_) {
+      if (!handler.Key(item.first.c_str(), static_cast<rapidjson::SizeType>(item.first.size()),
+                       false) ||
+          !item.second->accept(handler)) {
+        return false;
+      }
+    }
+    return handler.EndObject(static_cast<rapidjson::SizeType>(value_.object_value_.size()));
+  case Type::Boolean:
+    return handler.Bool(value_.boolean_value_);
+  case Type::Double:
+    return handler.Double(value_.double_value_);
+  case Type::Integer:
+    return handler.Int64(value_.integer_value_);
+  case Type::Null:
+    return handler.Null();
+  case Type::String:
+    return handler.String(value_.string_value_.c_str(),
+                          static_cast<rapidjson::SizeType>(value_.string_value_.size()), false);
+  }
+
+  NOT_REACHED;
+}
+
+/**
+ * A schema in the SchemaRegistry. Compiled schemas are immutable, so one is shared by all
+ * validations against the same schema text, on any thread.
+ */
+struct CompiledSchema {
+  rapidjson::Document document_;
+  // Set the first time that something is validated against the schema.
+  std::unique_ptr<rapidjson::SchemaDocument> schema_;
+  std::string stat_name_{"json.schema.unnamed.validation_time"};
+};
+
+struct SchemaRegistryState {
+  std::mutex lock_;
+  // Schemas are a small fixed set of constants, so entries are never evicted.
+  std::unordered_map<std::string, std::unique_ptr<CompiledSchema>> schemas_;
+  Stats::Scope* stats_scope_{};
+};
+
+SchemaRegistryState& schemaRegistry() {
+  static SchemaRegistryState* state = new SchemaRegistryState();
+  return *state;
+}
+
+/**
+ * Find or compile a schema.
+ * @param schema supplies the schema.
+ * @param span supplies the timespan of the validation, which is set if stats are recorded.
+ * @return const rapidjson::SchemaDocument& the compiled schema.
+ */
+const rapidjson::SchemaDocument& compiledSchema(const std::string& schema,
+                                                Stats::TimespanPtr& span) {
+  SchemaRegistryState& registry = schemaRegistry();
+  std::unique_lock<std::mutex> lock(registry.lock_);
+  std::unique_ptr<CompiledSchema>& compiled = registry.schemas_[schema];
+  if (!compiled) {
+    compiled.reset(new CompiledSchema());
+  }
+
+  if (!compiled->schema_) {
+    if (compiled->document_.Parse<0>(schema.c_str()).HasParseError()) {
+      throw std::invalid_argument(fmt::format(
+          "Schema supplied to validateSchema is not valid JSON\n Error(offset {}) : {}\n",
+          compiled->document_.GetErrorOffset(),
+          GetParseError_En(compiled->document_.GetParseError())));
+    }
+
+    compiled->schema_.reset(new rapidjson::SchemaDocument(compiled->document_));
+  }
+
+  if (registry.stats_scope_ != nullptr) {
+    span = registry.stats_scope_->timer(compiled->stat_name_).allocateSpan();
+  }
+
+  return *compiled->schema_;
+}
+
 /**
  * Custom stream to allow access to the line number for each object.
  */
@@ -190,32 +367,87 @@ private:
   uint64_t line_number_;
 };
 
+/**
+ * Forwards RapidJson SAX events to a SaxHandler.
+ */
+class SaxAdapter : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, SaxAdapter> {
+public:
+  SaxAdapter(SaxHandler& handler, const LineCountingStringStream& stream)
+      : handler_(handler), stream_(stream) {}
+
+  bool StartObject() { return handler_.onObjectStart(); }
+  bool EndObject(rapidjson::SizeType) { return handler_.onObjectEnd(); }
+  bool Key(const char* value, rapidjson::SizeType size, bool) {
+    return handler_.onKey(value, size);
+  }
+  bool StartArray() { return handler_.onArrayStart(); }
+  bool EndArray(rapidjson::SizeType) { return handler_.onArrayEnd(); }
+  bool Bool(bool value) { return handler_.onBoolean(value); }
+  bool Double(double value) { return handler_.onDouble(value); }
+  bool Int(int value) { return handler_.onInteger(value); }
+  bool Uint(unsigned value) { return handler_.onInteger(value); }
+  bool Int64(int64_t value) { return handler_.onInteger(value); }
+  bool Uint64(uint64_t value) {
+    if (value > std::numeric_limits<int64_t>::max()) {
+      throw Exception(fmt::format("JSON value from line {} is larger than int64_t (not supported)",
+                                  stream_.getLineNumber()));
+    }
+    return handler_.onInteger(static_cast<int64_t>(value));
+  }
+  bool Null() { return handler_.onNull(); }
+  bool String(const char* value, rapidjson::SizeType size, bool) {
+    return handler_.onString(value, size);
+  }
+  bool RawNumber(const char*, rapidjson::SizeType, bool) {
+    // Only called if kParseNumbersAsStrings is set as a parse flag, which it is not.
+    NOT_REACHED;
+  }
+
+private:
+  SaxHandler& handler_;
+  const LineCountingStringStream& stream_;
+};
+
+void parse(LineCountingStringStream& stream, SaxHandler& handler) {
+  SaxAdapter adapter(handler, stream);
+  rapidjson::Reader reader;
+  reader.Parse(stream, adapter);
+
+  if (reader.HasParseError() && reader.GetParseErrorCode() != rapidjson::kParseErrorTermination) {
+    throw Exception(fmt::format("JSON supplied is not valid. Error(offset {}, line {}): {}\n",
+                                reader.GetErrorOffset(), stream.getLineNumber(),
+                                GetParseError_En(reader.GetParseErrorCode())));
+  }
+}
+
 /**
  * Consume events from SAX callbacks to build JSON Field.
  */
-class ObjectHandler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, ObjectHandler> {
+class ObjectHandler : public SaxHandler {
 public:
-  ObjectHandler(LineCountingStringStream& stream) : state_(expectRoot), stream_(stream){};
-
-  bool StartObject();
-  bool EndObject(rapidjson::SizeType);
-  bool Key(const char* value, rapidjson::SizeType size, bool);
-  bool StartArray();
-  bool EndArray(rapidjson::SizeType);
-  bool Bool(bool value);
-  bool Double(double value);
-  bool Int(int value);
-  bool Uint(unsigned value);
-  bool Int64(int64_t value);
-  bool Uint64(uint64_t value);
-  bool Null();
-  bool String(const char* value, rapidjson::SizeType size, bool);
-  bool RawNumber(const char*, rapidjson::SizeType, bool);
-
-  ObjectSharedPtr getRoot() { return root_; }
+  ObjectHandler(Document& document, const LineCountingStringStream& stream)
+      : state_(expectRoot), document_(document), stream_(stream){};
+
+  // Json::SaxHandler
+  bool onObjectStart() override;
+  bool onKey(const char* data, size_t length) override;
+  bool onObjectEnd() override;
+  bool onArrayStart() override;
+  bool onArrayEnd() override;
+  bool onBoolean(bool value) override { return handleValueEvent(document_.createField(value)); }
+  bool onInteger(int64_t value) override {
+    return handleValueEvent(document_.createField(value));
+  }
+  bool onDouble(double value) override { return handleValueEvent(document_.createField(value)); }
+  bool onString(const char* data, size_t length) override {
+    return handleValueEvent(document_.createField(std::string(data, length)));
+  }
+  bool onNull() override { return handleValueEvent(document_.createField(Field::Type::Null)); }
+
+  ObjectSharedPtr getRoot() { return root_->shared(); }
 
 private:
-  bool handleValueEvent(FieldSharedPtr ptr);
+  bool handleValueEvent(Field& field);
 
   enum State {
     expectRoot,
@@ -225,97 +457,19 @@ private:
     expectFinished,
   };
   State state_;
-  LineCountingStringStream& stream_;
+  Document& document_;
+  const LineCountingStringStream& stream_;
 
-  std::stack<FieldSharedPtr> stack_;
+  std::stack<Field*> stack_;
   std::string key_;
 
-  FieldSharedPtr root_;
+  Field* root_{};
 };
 
-void Field::buildRapidJsonDocument(const Field& field, rapidjson::Value& value,
-                                   rapidjson::Document::AllocatorType& allocator) {
-
-  switch (field.type_) {
-  case Type::Array: {
-    value.SetArray();
-    value.Reserve(field.value_.array_value_.size(), allocator);
-    for (const auto& element : field.value_.array_value_) {
-      switch (element->type_) {
-      case Type::Array:
-      case Type::Object: {
-        rapidjson::Value nested_value;
-        buildRapidJsonDocument(*element, nested_value, allocator);
-        value.PushBack(nested_value, allocator);
-        break;
-      }
-      case Type::Boolean:
-        value.PushBack(element->value_.boolean_value_, allocator);
-        break;
-      case Type::Double:
-        value.PushBack(element->value_.double_value_, allocator);
-        break;
-      case Type::Integer:
-        value.PushBack(element->value_.integer_value_, allocator);
-        break;
-      case Type::Null:
-        value.PushBack(rapidjson::Value(), allocator);
-        break;
-      case Type::String:
-        value.PushBack(rapidjson::StringRef(element->value_.string_value_.c_str()), allocator);
-      }
-    }
-    break;
-  }
-  case Type::Object: {
-    value.SetObject();
-    for (const auto& item : field.value_.object_value_) {
-      auto name = rapidjson::StringRef(item.first.c_str());
-
-      switch (item.second->type_) {
-      case Type::Array:
-      case Type::Object: {
-        rapidjson::Value nested_value;
-        buildRapidJsonDocument(*item.second, nested_value, allocator);
-        value.AddMember(name, nested_value, allocator);
-        break;
-      }
-      case Type::Boolean:
-        value.AddMember(name, item.second->value_.boolean_value_, allocator);
-        break;
-      case Type::Double:
-        value.AddMember(name, item.second->value_.double_value_, allocator);
-        break;
-      case Type::Integer:
-        value.AddMember(name, item.second->value_.integer_value_, allocator);
-        break;
-      case Type::Null:
-        value.AddMember(name, rapidjson::Value(), allocator);
-        break;
-      case Type::String:
-        value.AddMember(name, rapidjson::StringRef(item.second->value_.string_value_.c_str()),
-                        allocator);
-        break;
-      }
-    }
-    break;
-  }
-  default:
-    NOT_REACHED;
-  }
-}
-
-rapidjson::Document Field::asRapidJsonDocument() const {
-  rapidjson::Document document;
-  rapidjson::Document::AllocatorType& allocator = document.GetAllocator();
-  buildRapidJsonDocument(*this, document, allocator);
-  return document;
-}
-
 uint64_t Field::hash() const {
   rapidjson::StringBuffer buffer;
   rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-  asRapidJsonDocument().Accept(writer);
+  accept(writer);
   return std::hash<std::string>{}(buffer.GetString());
 }
 
@@ -384,7 +538,7 @@ ObjectSharedPtr Field::getObject(const std::string& name, bool allow_empty) cons
   auto value_itr = value_.object_value_.find(name);
   if (value_itr == value_.object_value_.end()) {
     if (allow_empty) {
-      return createObject();
+      return Document::createEmptyObject();
     } else {
       throw Exception(fmt::format("key '{}' missing from lines {}-{}", name, line_number_start_,
                                   line_number_end_));
@@ -393,7 +547,7 @@ ObjectSharedPtr Field::getObject(const std::string& name, bool allow_empty) cons
     throw Exception(fmt::format("key '{}' not an object from line {}", name,
                                 value_itr->second->line_number_start_));
   } else {
-    return value_itr->second;
+    return value_itr->second->shared();
   }
 }
 
@@ -405,8 +559,7 @@ std::vector<ObjectSharedPtr> Field::getObjectArray(const std::string& name) cons
                                 line_number_start_, line_number_end_));
   }
 
-  std::vector<FieldSharedPtr> array_value = value_itr->second->arrayValue();
-  return {array_value.begin(), array_value.end()};
+  return sharedArray(value_itr->second->arrayValue());
 }
 
 std::string Field::getString(const std::string& name) const {
@@ -437,10 +590,10 @@ std::vector<std::string> Field::getStringArray(const std::string& name) const {
                                 line_number_start_, line_number_end_));
   }
 
-  std::vector<FieldSharedPtr> array = value_itr->second->arrayValue();
+  const std::vector<Field*>& array = value_itr->second->arrayValue();
   std::vector<std::string> string_array;
   string_array.reserve(array.size());
-  for (const auto& element : array) {
+  for (const Field* element : array) {
     if (!element->isType(Type::String)) {
       throw Exception(fmt::format("JSON array '{}' from line {} does not contain all strings", name,
                                   line_number_start_));
@@ -452,8 +605,7 @@ std::vector<std::string> Field::getStringArray(const std::string& name) const {
 }
 
 std::vector<ObjectSharedPtr> Field::asObjectArray() const {
-  checkType(Type::Array);
-  return {value_.array_value_.begin(), value_.array_value_.end()};
+  return sharedArray(arrayValue());
 }
 
 bool Field::empty() const {
@@ -484,17 +636,23 @@ void Field::iterate(const ObjectCallback& callback) const {
 }
 
 void Field::validateSchema(const std::string& schema) const {
-  rapidjson::Document schema_document;
-  if (schema_document.Parse<0>(schema.c_str()).HasParseError()) {
-    throw std::invalid_argument(fmt::format(
-        "Schema supplied to validateSchema is not valid JSON\n Error(offset {}) : {}\n",
-        schema_document.GetErrorOffset(), GetParseError_En(schema_document.GetParseError())));
+  Stats::TimespanPtr span;
+  const rapidjson::SchemaDocument& compiled_schema = compiledSchema(schema, span);
+  if (document_.validated(*this, compiled_schema)) {
+    return;
   }
 
-  rapidjson::SchemaDocument schema_document_for_validator(schema_document);
-  rapidjson::SchemaValidator schema_validator(schema_document_for_validator);
+  rapidjson::SchemaValidator schema_validator(compiled_schema);
+  const bool valid = accept(schema_validator);
+  if (span) {
+    span->complete();
+  }
+
+  if (valid) {
+    document_.setValidated(*this, compiled_schema);
+  }
 
-  if (!asRapidJsonDocument().Accept(schema_validator)) {
+  if (!valid) {
     rapidjson::StringBuffer schema_string_buffer;
     rapidjson::StringBuffer document_string_buffer;
 
@@ -510,18 +668,18 @@ void Field::validateSchema(const std::string& schema) const {
   }
 }
 
-bool ObjectHandler::StartObject() {
-  FieldSharedPtr object = Field::createObject();
+bool ObjectHandler::onObjectStart() {
+  Field* object = &document_.createField(Field::Type::Object);
   object->setLineNumberStart(stream_.getLineNumber());
 
   switch (state_) {
   case expectValueOrStartObjectArray:
-    stack_.top()->insert(key_, object);
+    stack_.top()->insert(key_, *object);
     stack_.push(object);
     state_ = expectKeyOrEndObject;
     return true;
   case expectArrayValueOrEndArray:
-    stack_.top()->append(object);
+    stack_.top()->append(*object);
     stack_.push(object);
     state_ = expectKeyOrEndObject;
     return true;
@@ -535,7 +693,7 @@ bool ObjectHandler::StartObject() {
   }
 }
 
-bool ObjectHandler::EndObject(rapidjson::SizeType) {
+bool ObjectHandler::onObjectEnd() {
   switch (state_) {
   case expectKeyOrEndObject:
     stack_.top()->setLineNumberEnd(stream_.getLineNumber());
@@ -554,10 +712,10 @@ bool ObjectHandler::EndObject(rapidjson::SizeType) {
   }
 }
 
-bool ObjectHandler::Key(const char* value, rapidjson::SizeType size, bool) {
+bool ObjectHandler::onKey(const char* data, size_t length) {
   switch (state_) {
   case expectKeyOrEndObject:
-    key_ = std::string(value, size);
+    key_.assign(data, length);
     state_ = expectValueOrStartObjectArray;
     return true;
   default:
@@ -565,18 +723,18 @@ bool ObjectHandler::Key(const char* value, rapidjson::SizeType size, bool) {
   }
 }
 
-bool ObjectHandler::StartArray() {
-  FieldSharedPtr array = Field::createArray();
+bool ObjectHandler::onArrayStart() {
+  Field* array = &document_.createField(Field::Type::Array);
   array->setLineNumberStart(stream_.getLineNumber());
 
   switch (state_) {
   case expectValueOrStartObjectArray:
-    stack_.top()->insert(key_, array);
+    stack_.top()->insert(key_, *array);
     stack_.push(array);
     state_ = expectArrayValueOrEndArray;
     return true;
   case expectArrayValueOrEndArray:
-    stack_.top()->append(array);
+    stack_.top()->append(*array);
     stack_.push(array);
     return true;
   case expectRoot:
@@ -589,7 +747,7 @@ bool ObjectHandler::StartArray() {
   }
 }
 
-bool ObjectHandler::EndArray(rapidjson::SizeType) {
+bool ObjectHandler::onArrayEnd() {
   switch (state_) {
   case expectArrayValueOrEndArray:
     stack_.top()->setLineNumberEnd(stream_.getLineNumber());
@@ -609,45 +767,16 @@ bool ObjectHandler::EndArray(rapidjson::SizeType) {
   }
 }
 
-// Value handlers
-bool ObjectHandler::Bool(bool value) { return handleValueEvent(Field::createValue(value)); }
-bool ObjectHandler::Double(double value) { return handleValueEvent(Field::createValue(value)); }
-bool ObjectHandler::Int(int value) {
-  return handleValueEvent(Field::createValue(static_cast<int64_t>(value)));
-}
-bool ObjectHandler::Uint(unsigned value) {
-  return handleValueEvent(Field::createValue(static_cast<int64_t>(value)));
-}
-bool ObjectHandler::Int64(int64_t value) { return handleValueEvent(Field::createValue(value)); }
-bool ObjectHandler::Uint64(uint64_t value) {
-  if (value > std::numeric_limits<int64_t>::max()) {
-    throw Exception(fmt::format("JSON value from line {} is larger than int64_t (not supported)",
-                                stream_.getLineNumber()));
-  }
-  return handleValueEvent(Field::createValue(static_cast<int64_t>(value)));
-}
-
-bool ObjectHandler::Null() { return handleValueEvent(Field::createNull()); }
-
-bool ObjectHandler::String(const char* value, rapidjson::SizeType size, bool) {
-  return handleValueEvent(Field::createValue(std::string(value, size)));
-}
-
-bool ObjectHandler::RawNumber(const char*, rapidjson::SizeType, bool) {
-  // Only called if kParseNumbersAsStrings is set as a parse flag, which it is not.
-  NOT_REACHED;
-}
-
-bool ObjectHandler::handleValueEvent(FieldSharedPtr ptr) {
-  ptr->setLineNumberStart(stream_.getLineNumber());
+bool ObjectHandler::handleValueEvent(Field& field) {
+  field.setLineNumberStart(stream_.getLineNumber());
 
   switch (state_) {
   case expectValueOrStartObjectArray:
     state_ = expectKeyOrEndObject;
-    stack_.top()->insert(key_, ptr);
+    stack_.top()->insert(key_, field);
     return true;
   case expectArrayValueOrEndArray:
-    stack_.top()->append(ptr);
+    stack_.top()->append(field);
     return true;
   default:
     NOT_REACHED;
@@ -656,6 +785,23 @@ bool ObjectHandler::handleValueEvent(FieldSharedPtr ptr) {
 
 } // namespace
 
+void SchemaRegistry::setName(const std::string& schema, const std::string& name) {
+  SchemaRegistryState& registry = schemaRegistry();
+  std::unique_lock<std::mutex> lock(registry.lock_);
+  std::unique_ptr<CompiledSchema>& compiled = registry.schemas_[schema];
+  if (!compiled) {
+    compiled.reset(new CompiledSchema());
+  }
+
+  compiled->stat_name_ = fmt::format("json.schema.{}.validation_time", name);
+}
+
+void SchemaRegistry::setStatsScope(Stats::Scope* scope) {
+  SchemaRegistryState& registry = schemaRegistry();
+  std::unique_lock<std::mutex> lock(registry.lock_);
+  registry.stats_scope_ = scope;
+}
+
 ObjectSharedPtr Factory::loadFromFile(const std::string& file_path) {
   try {
     return loadFromString(Filesystem::fileReadToEnd(file_path));
@@ -665,21 +811,18 @@ ObjectSharedPtr Factory::loadFromFile(const std::string& file_path) {
 }
 
 ObjectSharedPtr Factory::loadFromString(const std::string& json) {
+  std::shared_ptr<Document> document = std::make_shared<Document>();
   LineCountingStringStream json_stream(json.c_str());
-
-  ObjectHandler handler(json_stream);
-  rapidjson::Reader reader;
-  reader.Parse(json_stream, handler);
-
-  if (reader.HasParseError()) {
-    throw Exception(fmt::format("JSON supplied is not valid. Error(offset {}, line {}): {}\n",
-                                reader.GetErrorOffset(), json_stream.getLineNumber(),
-                                GetParseError_En(reader.GetParseErrorCode())));
-  }
-
+  ObjectHandler handler(*document, json_stream);
+  parse(json_stream, handler);
   return handler.getRoot();
 }
 
+void Factory::parseFromString(const std::string& json, SaxHandler& handler) {
+  LineCountingStringStream json_stream(json.c_str());
+  parse(json_stream, handler);
+}
+
 const std::string Factory::listAsJsonString(const std::list<std::string>& items) {
   rapidjson::StringBuffer writer_string_buffer;
   rapidjson::Writer<rapidjson::StringBuffer> writer(writer_string_buffer);
@@ -1,13 +1,60 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <list>
 #include <string>
 
+#include "envoy/common/pure.h"
 #include "envoy/json/json_object.h"
+#include "envoy/stats/stats.h"
 
 namespace Envoy {
 namespace Json {
 
+/**
+ * Callbacks for streaming (SAX style) parsing. Events are raised in document order as the input is
+ * scanned and no tree is built. Data pointers are only valid for the duration of the callback.
+ * Every callback returns false to stop parsing early.
+ */
+class SaxHandler {
+public:
+  virtual ~SaxHandler() {}
+
+  virtual bool onObjectStart() PURE;
+  virtual bool onKey(const char* data, size_t length) PURE;
+  virtual bool onObjectEnd() PURE;
+  virtual bool onArrayStart() PURE;
+  virtual bool onArrayEnd() PURE;
+  virtual bool onBoolean(bool value) PURE;
+  virtual bool onInteger(int64_t value) PURE;
+  virtual bool onDouble(double value) PURE;
+  virtual bool onString(const char* data, size_t length) PURE;
+  virtual bool onNull() PURE;
+};
+
+/**
+ * Process wide registry of compiled schemas. Every distinct schema is parsed and compiled once, the
+ * first time an object is validated against it, and is then shared by all validations against it
+ * on any thread.
+ */
+class SchemaRegistry {
+public:
+  /**
+   * Name a schema for stats.
+   * @param schema supplies the schema.
+   * @param name supplies the name.
+   */
+  static void setName(const std::string& schema, const std::string& name);
+
+  /**
+   * Set the scope in which the time spent validating against each schema is recorded, in the
+   * timer json.schema.<name>.validation_time. Schemas without a name are recorded as "unnamed".
+   * @param scope supplies the scope, or nullptr to stop recording.
+   */
+  static void setStatsScope(Stats::Scope* scope);
+};
+
 class Factory {
 public:
   /**
@@ -20,6 +67,14 @@ public:
    */
   static ObjectSharedPtr loadFromString(const std::string& json);
 
+  /**
+   * Parse a string without building a Json Object. A Json::Exception is thrown if the string is not
+   * valid JSON. Stopping from a handler callback is not an error.
+   * @param json supplies the string to parse.
+   * @param handler supplies the callbacks for the parsed events.
+   */
+  static void parseFromString(const std::string& json, SaxHandler& handler);
+
   static const std::string listAsJsonString(const std::list<std::string>& items);
 };
 
@@ -0,0 +1,187 @@
+#include "common/memory/accounting.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "common/common/assert.h"
+
+#ifdef TCMALLOC
+#include "gperftools/malloc_extension.h"
+#include "gperftools/malloc_hook.h"
+#endif
+
+namespace Envoy {
+namespace Memory {
+
+namespace {
+
+const char* const SubsystemNames[Accounting::NumSubsystems] = {"header_map", "buffer", "stats",
+                                                               "route_table", "conn_pool"};
+
+const char* const RequestPhaseNames[RequestAllocations::NumPhases] = {
+    "decode_headers", "decode_body", "routing", "upstream_encode", "response_encode", "access_log"};
+
+/**
+ * The counters of a single thread. Only the owning thread writes them, so relaxed loads and stores
+ * are enough and no read-modify-write is needed.
+ */
+struct ThreadCounters {
+  ThreadCounters();
+  ~ThreadCounters();
+
+  std::atomic<uint64_t> allocated_bytes_[Accounting::NumSubsystems];
+  std::atomic<uint64_t> freed_bytes_[Accounting::NumSubsystems];
+  ThreadCounters* prev_{};
+  ThreadCounters* next_{};
+};
+
+/**
+ * All live thread counters, and the totals of the threads that have exited. It is never freed so
+ * that threads exiting during process teardown can still retire their counters.
+ */
+struct Registry {
+  std::mutex lock_;
+  ThreadCounters* head_{};
+  Accounting::Totals retired_[Accounting::NumSubsystems];
+};
+
+Registry& registry() {
+  static Registry* registry = new Registry();
+  return *registry;
+}
+
+// Only trivially initialized thread locals are touched by the malloc hooks.
+thread_local ThreadCounters* thread_counters = nullptr;
+
+std::atomic<bool> hooks_installed{false};
+std::atomic<bool> request_accounting{false};
+
+void add(std::atomic<uint64_t>& counter, uint64_t bytes) {
+  counter.store(counter.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+}
+
+ThreadCounters::ThreadCounters() {
+  for (size_t i = 0; i < Accounting::NumSubsystems; i++) {
+    allocated_bytes_[i] = 0;
+    freed_bytes_[i] = 0;
+  }
+
+  Registry& r = registry();
+  std::unique_lock<std::mutex> lock(r.lock_);
+  next_ = r.head_;
+  if (next_) {
+    next_->prev_ = this;
+  }
+  r.head_ = this;
+}
+
+ThreadCounters::~ThreadCounters() {
+  thread_counters = nullptr;
+  Registry& r = registry();
+  std::unique_lock<std::mutex> lock(r.lock_);
+  for (size_t i = 0; i < Accounting::NumSubsystems; i++) {
+    r.retired_[i].allocated_bytes_ += allocated_bytes_[i].load(std::memory_order_relaxed);
+    r.retired_[i].freed_bytes_ += freed_bytes_[i].load(std::memory_order_relaxed);
+  }
+
+  if (prev_) {
+    prev_->next_ = next_;
+  } else {
+    r.head_ = next_;
+  }
+  if (next_) {
+    next_->prev_ = prev_;
+  }
+}
+
+#ifdef TCMALLOC
+void newHook(const void*, size_t size) { Accounting::onAllocation(size); }
+
+void deleteHook(const void* ptr) {
+  if (ptr && Accounting::charging()) {
+    Accounting::onFree(MallocExtension::instance()->GetAllocatedSize(ptr));
+  }
+}
+#endif
+
+} // namespace
+
+thread_local int AccountingScope::current_ = -1;
+thread_local bool AccountingScope::registered_ = false;
+thread_local RequestAllocations* RequestPhaseScope::current_request_ = nullptr;
+thread_local int RequestPhaseScope::current_phase_ = 0;
+
+void AccountingScope::registerThread() {
+  // Constructing the counters may allocate, which happens before the thread is in a scope so the
+  // hooks ignore it.
+  static thread_local ThreadCounters counters;
+  thread_counters = &counters;
+  registered_ = true;
+}
+
+bool Accounting::enable() {
+#ifdef TCMALLOC
+  if (!hooks_installed.exchange(true)) {
+    RELEASE_ASSERT(MallocHook::AddNewHook(&newHook) && MallocHook::AddDeleteHook(&deleteHook));
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool Accounting::enabled() { return hooks_installed; }
+
+Accounting::Totals Accounting::totals(Subsystem subsystem) {
+  const size_t index = static_cast<size_t>(subsystem);
+  Registry& r = registry();
+  std::unique_lock<std::mutex> lock(r.lock_);
+  Totals totals = r.retired_[index];
+  for (ThreadCounters* counters = r.head_; counters; counters = counters->next_) {
+    totals.allocated_bytes_ += counters->allocated_bytes_[index].load(std::memory_order_relaxed);
+    totals.freed_bytes_ += counters->freed_bytes_[index].load(std::memory_order_relaxed);
+  }
+
+  return totals;
+}
+
+const char* Accounting::name(Subsystem subsystem) {
+  return SubsystemNames[static_cast<size_t>(subsystem)];
+}
+
+bool Accounting::charging() { return AccountingScope::current_ >= 0 && thread_counters; }
+
+void Accounting::onAllocation(size_t bytes) {
+  if (charging()) {
+    add(thread_counters->allocated_bytes_[AccountingScope::current_], bytes);
+  }
+
+  RequestAllocations* request = RequestPhaseScope::current_request_;
+  if (request) {
+    RequestAllocations::Tally& tally = request->tallies_[RequestPhaseScope::current_phase_];
+    tally.allocations_++;
+    tally.bytes_ += bytes;
+  }
+}
+
+void Accounting::onFree(size_t bytes) {
+  if (charging()) {
+    add(thread_counters->freed_bytes_[AccountingScope::current_], bytes);
+  }
+}
+
+bool RequestAllocations::enable(bool enable) {
+  request_accounting = enable && Accounting::enable();
+  return request_accounting;
+}
+
+bool RequestAllocations::enabled() { return request_accounting; }
+
+const char* RequestAllocations::name(RequestPhase phase) {
+  return RequestPhaseNames[static_cast<size_t>(phase)];
+}
+
+} // Memory
+} // Envoy
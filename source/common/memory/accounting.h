@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Envoy {
+namespace Memory {
+
+/**
+ * Subsystems that heap allocations are attributed to.
+ */
+enum class Subsystem { HeaderMap, Buffer, Stats, RouteTable, ConnPool };
+
+/**
+ * Phases of an HTTP request that per request allocations are attributed to.
+ */
+enum class RequestPhase {
+  DecodeHeaders,
+  DecodeBody,
+  Routing,
+  UpstreamEncode,
+  ResponseEncode,
+  AccessLog
+};
+
+/**
+ * Attribution of heap allocations to subsystems. While an AccountingScope is active on a thread,
+ * the bytes the thread allocates and frees are charged to the subsystem of the scope, in counters
+ * owned by the thread so that charging never contends with other threads. Frees are charged to the
+ * subsystem whose scope is active when they happen, so subsystems free their memory within a scope
+ * as well.
+ *
+ * Allocations are observed through the tcmalloc malloc hooks, so accounting requires tcmalloc.
+ */
+class Accounting {
+public:
+  static const size_t NumSubsystems = 5;
+
+  struct Totals {
+    /**
+     * @return uint64_t the bytes allocated and not yet freed. Frees charged to a subsystem other
+     *         than the one that allocated can make this undercount, so it saturates at 0.
+     */
+    uint64_t netBytes() const {
+      return allocated_bytes_ > freed_bytes_ ? allocated_bytes_ - freed_bytes_ : 0;
+    }
+
+    uint64_t allocated_bytes_{};
+    uint64_t freed_bytes_{};
+  };
+
+  /**
+   * Start attributing allocations. Scopes are cheap but every allocation goes through the hooks
+   * once this is called, so it is opt in.
+   * @return bool whether accounting is on.
+   */
+  static bool enable();
+
+  /**
+   * @return bool whether enable() succeeded.
+   */
+  static bool enabled();
+
+  /**
+   * @return Totals the bytes charged to a subsystem by all threads, including threads that have
+   *         exited.
+   */
+  static Totals totals(Subsystem subsystem);
+
+  /**
+   * @return const char* the name of a subsystem as used in stat names.
+   */
+  static const char* name(Subsystem subsystem);
+
+  /**
+   * @return bool whether allocations on the calling thread are currently charged to a subsystem.
+   */
+  static bool charging();
+
+  /**
+   * Charge an allocation or a free to the subsystem of the active scope on the calling thread, and
+   * an allocation to the request phase of the active RequestPhaseScope. Does nothing outside of a
+   * scope. Called by the malloc hooks, so it must not allocate.
+   */
+  static void onAllocation(size_t bytes);
+  static void onFree(size_t bytes);
+};
+
+/**
+ * Charges the allocations made by the current thread to a subsystem for the lifetime of the scope.
+ * Scopes nest, with the innermost one winning.
+ */
+class AccountingScope {
+public:
+  explicit AccountingScope(Subsystem subsystem) : previous_(current_) {
+    if (!registered_) {
+      registerThread();
+    }
+    current_ = static_cast<int>(subsystem);
+  }
+
+  ~AccountingScope() { current_ = previous_; }
+
+private:
+  static void registerThread();
+
+  // The subsystem of the innermost scope on this thread, or -1 outside of any scope.
+  static thread_local int current_;
+  static thread_local bool registered_;
+
+  const int previous_;
+
+  friend class Accounting;
+};
+
+/**
+ * The number of allocations and bytes a single request made in each of its phases. It is owned by
+ * the request and only charged by the thread that runs the request.
+ */
+class RequestAllocations {
+public:
+  static const size_t NumPhases = 6;
+
+  struct Tally {
+    uint64_t allocations_{};
+    uint64_t bytes_{};
+  };
+
+  /**
+   * Turn per request accounting on or off. Turning it on installs the malloc hooks, see
+   * Accounting::enable(). Requests that start while it is on are accounted until they end.
+   * @return bool whether per request accounting is on.
+   */
+  static bool enable(bool enable);
+
+  /**
+   * @return bool whether requests that start now should be accounted.
+   */
+  static bool enabled();
+
+  /**
+   * @return const char* the name of a phase as used in stat names.
+   */
+  static const char* name(RequestPhase phase);
+
+  const Tally& tally(RequestPhase phase) const { return tallies_[static_cast<size_t>(phase)]; }
+
+private:
+  Tally tallies_[NumPhases];
+
+  friend class Accounting;
+};
+
+/**
+ * Charges the allocations made by the current thread to a phase of a request for the lifetime of
+ * the scope. Scopes nest, with the innermost one winning.
+ */
+class RequestPhaseScope {
+public:
+  /**
+   * @param request supplies the request to charge, or nullptr to charge nothing.
+   * @param phase supplies the phase to charge.
+   */
+  RequestPhaseScope(RequestAllocations* request, RequestPhase phase)
+      : previous_request_(current_request_), previous_phase_(current_phase_) {
+    current_request_ = request;
+    current_phase_ = static_cast<int>(phase);
+  }
+
+  /**
+   * Charge a phase of the request that is already being charged on this thread, if any. This is
+   * for code such as the router that works on behalf of a request without owning it.
+   */
+  explicit RequestPhaseScope(RequestPhase phase) : RequestPhaseScope(current_request_, phase) {}
+
+  ~RequestPhaseScope() {
+    current_request_ = previous_request_;
+    current_phase_ = previous_phase_;
+  }
+
+private:
+  static thread_local RequestAllocations* current_request_;
+  static thread_local int current_phase_;
+
+  RequestAllocations* const previous_request_;
+  const int previous_phase_;
+
+  friend class Accounting;
+};
+
+} // Memory
+} // Envoy
@@ -21,6 +21,8 @@ uint64_t Stats::totalCurrentlyReserved() {
   return value;
 }
 
+void Stats::releaseFreeMemory() { MallocExtension::instance()->ReleaseFreeMemory(); }
+
 } // Memory
 } // Envoy
 
@@ -31,6 +33,7 @@ namespace Memory {
 
 uint64_t Stats::totalCurrentlyAllocated() { return 0; }
 uint64_t Stats::totalCurrentlyReserved() { return 0; }
+void Stats::releaseFreeMemory() {}
 
 } // Memory
 } // Envoy
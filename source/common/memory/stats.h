@@ -20,6 +20,11 @@ public:
    *                  allocated.
    */
   static uint64_t totalCurrentlyReserved();
+
+  /**
+   * Return as much of the free memory cached by the heap as possible to the operating system.
+   */
+  static void releaseFreeMemory();
 };
 
 } // Memory
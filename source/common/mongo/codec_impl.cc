@@ -1,5 +1,6 @@
 #include "common/mongo/codec_impl.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <list>
 #include <memory>
@@ -181,17 +182,48 @@ std::string QueryMessageImpl::toString(bool full) const {
       return_fields_selector_ ? return_fields_selector_->toString() : "{}");
 }
 
-void ReplyMessageImpl::fromBuffer(uint32_t, Buffer::Instance& data) {
+const uint32_t ReplyMessageImpl::FixedLength;
+
+void ReplyMessageImpl::headerFromBuffer(uint32_t message_length, Buffer::Instance& data) {
   log_trace("decoding reply message");
+  if (message_length < FixedLength) {
+    throw EnvoyException(fmt::format("invalid mongo reply length {}", message_length));
+  }
+
   flags_ = Bson::BufferHelper::removeInt32(data);
   cursor_id_ = Bson::BufferHelper::removeInt64(data);
   starting_from_ = Bson::BufferHelper::removeInt32(data);
   number_returned_ = Bson::BufferHelper::removeInt32(data);
+  skipped_documents_byte_size_ = message_length - FixedLength;
+  log_trace(toString(false));
+}
+
+void ReplyMessageImpl::fromBuffer(uint32_t message_length, Buffer::Instance& data) {
+  headerFromBuffer(message_length, data);
+  encoded_documents_.move(data, skipped_documents_byte_size_);
+  skipped_documents_byte_size_ = 0;
+}
+
+void ReplyMessageImpl::decodeDocuments() const {
+  if (encoded_documents_.length() == 0) {
+    return;
+  }
+
+  // Take the encoded documents first so that a decoding error is only raised once.
+  Buffer::OwnedImpl encoded_documents;
+  encoded_documents.move(encoded_documents_);
   for (int32_t i = 0; i < number_returned_; i++) {
-    documents_.emplace_back(Bson::DocumentImpl::create(data));
+    documents_.emplace_back(Bson::DocumentImpl::create(encoded_documents));
   }
+}
 
-  log_trace(toString(true));
+uint64_t ReplyMessageImpl::documentsByteSize() const {
+  uint64_t byte_size = skipped_documents_byte_size_ + encoded_documents_.length();
+  for (const Bson::DocumentSharedPtr& document : documents_) {
+    byte_size += document->byteSize();
+  }
+
+  return byte_size;
 }
 
 bool ReplyMessageImpl::operator==(const ReplyMessage& rhs) const {
@@ -217,80 +249,143 @@ std::string ReplyMessageImpl::toString(bool full) const {
       R"EOF({{"opcode": "OP_REPLY", "id": {}, "response_to": {}, "flags": "{:#x}", "cursor": "{}", )EOF"
       R"EOF("from": {}, "returned": {}, "documents": {}}})EOF",
       request_id_, response_to_, flags_, cursor_id_, starting_from_, number_returned_,
-      full ? documentListToString(documents_) : std::to_string(documents_.size()));
+      full ? documentListToString(documents()) : std::to_string(number_returned_));
 }
 
-bool DecoderImpl::decode(Buffer::Instance& data) {
-  // See if we have enough data for the message length.
+const uint32_t DecoderImpl::HeaderLength;
+
+void DecoderImpl::onData(const Buffer::Instance& data) {
   log_trace("decoding {} bytes", data.length());
-  if (data.length() < sizeof(int32_t)) {
-    return false;
+  uint64_t num_slices = data.getRawSlices(nullptr, 0);
+  Buffer::RawSlice slices[num_slices];
+  data.getRawSlices(slices, num_slices);
+  for (const Buffer::RawSlice& slice : slices) {
+    const uint8_t* mem = static_cast<const uint8_t*>(slice.mem_);
+    uint64_t remaining = slice.len_;
+    while (remaining > 0) {
+      uint64_t length;
+      if (skip_bytes_ > 0) {
+        length = std::min(remaining, skip_bytes_);
+        skip_bytes_ -= length;
+      } else {
+        // Whatever follows the current message may be skipped, so it is not copied yet.
+        length = std::min(remaining, bytesNeeded());
+        pending_.add(mem, length);
+        decode();
+      }
+
+      mem += length;
+      remaining -= length;
+    }
   }
+}
 
-  uint32_t message_length = Bson::BufferHelper::peakInt32(data);
-  log_trace("message is {} bytes", message_length);
-  if (data.length() < message_length) {
-    return false;
+uint64_t DecoderImpl::bytesNeeded() const {
+  if (!header_decoded_) {
+    return HeaderLength - pending_.length();
+  }
+
+  return bodyLength() - pending_.length();
+}
+
+uint32_t DecoderImpl::bodyLength() const {
+  ASSERT(header_decoded_);
+  const uint32_t body_length = message_length_ - HeaderLength;
+  if (op_code_ == Message::OpCode::OP_REPLY && skip_reply_documents_) {
+    return std::min(body_length, ReplyMessageImpl::FixedLength);
   }
 
-  data.drain(sizeof(int32_t));
-  int32_t request_id = Bson::BufferHelper::removeInt32(data);
-  int32_t response_to = Bson::BufferHelper::removeInt32(data);
-  Message::OpCode op_code = static_cast<Message::OpCode>(Bson::BufferHelper::removeInt32(data));
-  log_trace("message op: {}", static_cast<int32_t>(op_code));
+  return body_length;
+}
+
+void DecoderImpl::decode() {
+  if (!header_decoded_) {
+    if (pending_.length() < HeaderLength) {
+      return;
+    }
 
-  // Some messages need to know how long they are to parse. Subtract the header that we have already
-  // parsed off before passing the final value.
-  message_length -= 16;
+    message_length_ = Bson::BufferHelper::removeInt32(pending_);
+    request_id_ = Bson::BufferHelper::removeInt32(pending_);
+    response_to_ = Bson::BufferHelper::removeInt32(pending_);
+    op_code_ = static_cast<Message::OpCode>(Bson::BufferHelper::removeInt32(pending_));
+    log_trace("message is {} bytes, op: {}", message_length_, static_cast<int32_t>(op_code_));
+    if (message_length_ < HeaderLength) {
+      throw EnvoyException(fmt::format("invalid mongo message length {}", message_length_));
+    }
+
+    // Checked up front so that the body of a message that cannot be decoded is not buffered.
+    switch (op_code_) {
+    case Message::OpCode::OP_REPLY:
+    case Message::OpCode::OP_QUERY:
+    case Message::OpCode::OP_GET_MORE:
+    case Message::OpCode::OP_INSERT:
+    case Message::OpCode::OP_KILL_CURSORS:
+      break;
+    default:
+      throw EnvoyException(fmt::format("invalid mongo op {}", static_cast<int32_t>(op_code_)));
+    }
+
+    header_decoded_ = true;
+  }
 
-  switch (op_code) {
+  if (pending_.length() < bodyLength()) {
+    return;
+  }
+
+  decodeBody();
+  header_decoded_ = false;
+  pending_.drain(pending_.length());
+}
+
+void DecoderImpl::decodeBody() {
+  // Some messages need to know how long they are to parse.
+  const uint32_t message_length = message_length_ - HeaderLength;
+
+  switch (op_code_) {
   case Message::OpCode::OP_REPLY: {
-    std::unique_ptr<ReplyMessageImpl> message(new ReplyMessageImpl(request_id, response_to));
-    message->fromBuffer(message_length, data);
+    std::unique_ptr<ReplyMessageImpl> message(new ReplyMessageImpl(request_id_, response_to_));
+    if (skip_reply_documents_) {
+      message->headerFromBuffer(message_length, pending_);
+      skip_bytes_ = message_length - ReplyMessageImpl::FixedLength;
+    } else {
+      message->fromBuffer(message_length, pending_);
+    }
     callbacks_.decodeReply(std::move(message));
     break;
   }
 
   case Message::OpCode::OP_QUERY: {
-    std::unique_ptr<QueryMessageImpl> message(new QueryMessageImpl(request_id, response_to));
-    message->fromBuffer(message_length, data);
+    std::unique_ptr<QueryMessageImpl> message(new QueryMessageImpl(request_id_, response_to_));
+    message->fromBuffer(message_length, pending_);
     callbacks_.decodeQuery(std::move(message));
     break;
   }
 
   case Message::OpCode::OP_GET_MORE: {
-    std::unique_ptr<GetMoreMessageImpl> message(new GetMoreMessageImpl(request_id, response_to));
-    message->fromBuffer(message_length, data);
+    std::unique_ptr<GetMoreMessageImpl> message(new GetMoreMessageImpl(request_id_, response_to_));
+    message->fromBuffer(message_length, pending_);
     callbacks_.decodeGetMore(std::move(message));
     break;
   }
 
   case Message::OpCode::OP_INSERT: {
-    std::unique_ptr<InsertMessageImpl> message(new InsertMessageImpl(request_id, response_to));
-    message->fromBuffer(message_length, data);
+    std::unique_ptr<InsertMessageImpl> message(new InsertMessageImpl(request_id_, response_to_));
+    message->fromBuffer(message_length, pending_);
     callbacks_.decodeInsert(std::move(message));
     break;
   }
 
   case Message::OpCode::OP_KILL_CURSORS: {
     std::unique_ptr<KillCursorsMessageImpl> message(
-        new KillCursorsMessageImpl(request_id, response_to));
-    message->fromBuffer(message_length, data);
+        new KillCursorsMessageImpl(request_id_, response_to_));
+    message->fromBuffer(message_length, pending_);
     callbacks_.decodeKillCursors(std::move(message));
     break;
   }
 
   default:
-    throw EnvoyException(fmt::format("invalid mongo op {}", static_cast<int32_t>(op_code)));
+    NOT_REACHED;
   }
-
-  log_trace("{} bytes remaining after decoding", data.length());
-  return true;
-}
-
-void DecoderImpl::onData(Buffer::Instance& data) {
-  while (data.length() > 0 && decode(data))
-    ;
 }
 
 void EncoderImpl::encodeCommonHeader(int32_t total_size, const Message& message,
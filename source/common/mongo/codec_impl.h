@@ -7,6 +7,7 @@
 
 #include "envoy/mongo/codec.h"
 
+#include "common/buffer/buffer_impl.h"
 #include "common/common/logger.h"
 
 namespace Envoy {
@@ -158,6 +159,17 @@ class ReplyMessageImpl : public MessageImpl,
 public:
   using MessageImpl::MessageImpl;
 
+  // The flags, cursor ID, starting from, and number returned that precede the documents.
+  static const uint32_t FixedLength = 20;
+
+  /**
+   * Decode the fields that precede the documents. The documents are neither read nor kept, but
+   * still count towards documentsByteSize().
+   * @param message_length supplies the length of the message without its header.
+   * @param data supplies at least FixedLength bytes of the message.
+   */
+  void headerFromBuffer(uint32_t message_length, Buffer::Instance& data);
+
   // MessageImpl
   void fromBuffer(uint32_t message_length, Buffer::Instance& data) override;
 
@@ -174,28 +186,66 @@ public:
   void startingFrom(int32_t starting_from) override { starting_from_ = starting_from; }
   int32_t numberReturned() const override { return number_returned_; }
   void numberReturned(int32_t number_returned) override { number_returned_ = number_returned; }
-  const std::list<Bson::DocumentSharedPtr>& documents() const override { return documents_; }
-  std::list<Bson::DocumentSharedPtr>& documents() override { return documents_; }
+  const std::list<Bson::DocumentSharedPtr>& documents() const override {
+    decodeDocuments();
+    return documents_;
+  }
+  std::list<Bson::DocumentSharedPtr>& documents() override {
+    decodeDocuments();
+    return documents_;
+  }
+  uint64_t documentsByteSize() const override;
 
 private:
+  void decodeDocuments() const;
+
   int32_t flags_{};
   int64_t cursor_id_{};
   int32_t starting_from_{};
   int32_t number_returned_{};
-  std::list<Bson::DocumentSharedPtr> documents_;
+  // Documents that were received but not yet accessed. Replies can hold thousands of documents
+  // that the proxy never looks at, so they are only decoded on demand.
+  mutable Buffer::OwnedImpl encoded_documents_;
+  mutable std::list<Bson::DocumentSharedPtr> documents_;
+  uint64_t skipped_documents_byte_size_{};
 };
 
+/**
+ * Resumable decoder. The decoder copies the data of the current message into its own buffer, but
+ * never more than the message still needs, and decodes the message once it is complete. Each byte
+ * is therefore copied once and looked at once no matter how the stream is split into reads.
+ *
+ * A decoder that skips reply documents dispatches a reply as soon as the fields before its
+ * documents have arrived, and then passes over the documents without copying them. This lets a
+ * proxy that only collects stats from replies forward large batches of documents untouched.
+ */
 class DecoderImpl : public Decoder, Logger::Loggable<Logger::Id::mongo> {
 public:
-  DecoderImpl(DecoderCallbacks& callbacks) : callbacks_(callbacks) {}
+  DecoderImpl(DecoderCallbacks& callbacks, bool skip_reply_documents = false)
+      : callbacks_(callbacks), skip_reply_documents_(skip_reply_documents) {}
 
   // Mongo::Decoder
-  void onData(Buffer::Instance& data) override;
+  void onData(const Buffer::Instance& data) override;
 
 private:
-  bool decode(Buffer::Instance& data);
+  static const uint32_t HeaderLength = 16;
+
+  uint64_t bytesNeeded() const;
+  uint32_t bodyLength() const;
+  void decode();
+  void decodeBody();
 
   DecoderCallbacks& callbacks_;
+  const bool skip_reply_documents_;
+  // The part of the current message received so far, without its header once that is decoded.
+  Buffer::OwnedImpl pending_;
+  bool header_decoded_{};
+  uint32_t message_length_{};
+  int32_t request_id_{};
+  int32_t response_to_{};
+  Message::OpCode op_code_{};
+  // Bytes of skipped reply documents that have not arrived yet.
+  uint64_t skip_bytes_{};
 };
 
 class EncoderImpl : public Encoder, Logger::Loggable<Logger::Id::mongo> {
@@ -18,21 +18,94 @@ namespace Envoy {
 namespace Mongo {
 
 AccessLog::AccessLog(const std::string& file_name,
-                     Envoy::AccessLog::AccessLogManager& log_manager) {
-  file_ = log_manager.createAccessLog(file_name);
+                     Envoy::AccessLog::AccessLogManager& log_manager, Runtime::Loader& runtime,
+                     Runtime::RandomGenerator& random, const std::string& stat_prefix,
+                     Stats::Scope& scope, uint64_t max_pending)
+    : file_(log_manager.createAccessLog(file_name)), runtime_(runtime), random_(random),
+      stats_{ALL_MONGO_ACCESS_LOG_STATS(POOL_COUNTER_PREFIX(scope, stat_prefix),
+                                        POOL_GAUGE_PREFIX(scope, stat_prefix))},
+      max_pending_(max_pending) {
+  flush_thread_.reset(new Thread::Thread([this]() -> void { flushThreadFunc(); }));
 }
 
-void AccessLog::logMessage(const Message& message, bool full,
+AccessLog::~AccessLog() {
+  {
+    std::unique_lock<std::mutex> lock(lock_);
+    flush_thread_exit_ = true;
+  }
+  flush_event_.notify_one();
+  flush_thread_->join();
+}
+
+void AccessLog::logMessage(MessagePtr&& message, bool full,
                            const Upstream::HostDescription* upstream_host) {
+  if (!runtime_.snapshot().featureEnabled("mongo.logging_sample_rate", 10000, random_.random(),
+                                          10000)) {
+    stats_.sampled_out_.inc();
+    return;
+  }
+
+  PendingMessage pending{std::chrono::system_clock::now(), std::move(message), full,
+                         upstream_host ? upstream_host->address() : nullptr};
+
+  bool was_empty;
+  {
+    std::unique_lock<std::mutex> lock(lock_);
+    if (pending_size_ >= max_pending_) {
+      stats_.dropped_.inc();
+      return;
+    }
+
+    was_empty = pending_messages_.empty();
+    pending_messages_.emplace_back(std::move(pending));
+    pending_size_++;
+    stats_.pending_.inc();
+  }
+
+  if (was_empty) {
+    flush_event_.notify_one();
+  }
+}
+
+void AccessLog::flushThreadFunc() {
+  while (true) {
+    std::list<PendingMessage> messages;
+    {
+      std::unique_lock<std::mutex> lock(lock_);
+      flush_event_.wait(lock, [this]() -> bool {
+        return flush_thread_exit_ || !pending_messages_.empty();
+      });
+
+      if (pending_messages_.empty()) {
+        ASSERT(flush_thread_exit_);
+        return;
+      }
+
+      // Take everything that is pending so that the workers can keep queueing while the messages
+      // are serialized. Anything queued before shutdown is still written.
+      messages.swap(pending_messages_);
+      pending_size_ = 0;
+    }
+
+    stats_.pending_.sub(messages.size());
+    writeMessages(messages);
+  }
+}
+
+void AccessLog::writeMessages(std::list<PendingMessage>& messages) {
   static const std::string log_format =
       "{{\"time\": \"{}\", \"message\": {}, \"upstream_host\": \"{}\"}}\n";
 
-  SystemTime now = std::chrono::system_clock::now();
-  std::string log_line =
-      fmt::format(log_format, AccessLogDateTimeFormatter::fromTime(now), message.toString(full),
-                  upstream_host ? upstream_host->address()->asString() : "-");
+  std::string log_lines;
+  for (const PendingMessage& pending : messages) {
+    log_lines += fmt::format(log_format, AccessLogDateTimeFormatter::fromTime(pending.time_),
+                             pending.message_->toString(pending.full_),
+                             pending.upstream_address_ ? pending.upstream_address_->asString()
+                                                       : "-");
+  }
 
-  file_->write(log_line);
+  file_->write(log_lines);
+  stats_.written_.add(messages.size());
 }
 
 ProxyFilter::ProxyFilter(const std::string& stat_prefix, Stats::Store& store,
@@ -51,25 +124,24 @@ ProxyFilter::~ProxyFilter() {}
 
 void ProxyFilter::decodeGetMore(GetMoreMessagePtr&& message) {
   stats_.op_get_more_.inc();
-  logMessage(*message, true);
   log_debug("decoded GET_MORE: {}", message->toString(true));
+  logMessage(std::move(message), true);
 }
 
 void ProxyFilter::decodeInsert(InsertMessagePtr&& message) {
   stats_.op_insert_.inc();
-  logMessage(*message, true);
   log_debug("decoded INSERT: {}", message->toString(true));
+  logMessage(std::move(message), true);
 }
 
 void ProxyFilter::decodeKillCursors(KillCursorsMessagePtr&& message) {
   stats_.op_kill_cursors_.inc();
-  logMessage(*message, true);
   log_debug("decoded KILL_CURSORS: {}", message->toString(true));
+  logMessage(std::move(message), true);
 }
 
 void ProxyFilter::decodeQuery(QueryMessagePtr&& message) {
   stats_.op_query_.inc();
-  logMessage(*message, true);
   log_debug("decoded QUERY: {}", message->toString(true));
 
   if (message->flags() & QueryMessage::Flags::TailableCursor) {
@@ -117,6 +189,7 @@ void ProxyFilter::decodeQuery(QueryMessagePtr&& message) {
   }
 
   active_query_list_.emplace_back(std::move(active_query));
+  logMessage(std::move(message), true);
 }
 
 void ProxyFilter::chargeQueryStats(const std::string& prefix,
@@ -131,8 +204,7 @@ void ProxyFilter::chargeQueryStats(const std::string& prefix,
 
 void ProxyFilter::decodeReply(ReplyMessagePtr&& message) {
   stats_.op_reply_.inc();
-  logMessage(*message, false);
-  log_debug("decoded REPLY: {}", message->toString(true));
+  log_debug("decoded REPLY: {}", message->toString(false));
 
   if (message->cursorId() != 0) {
     stats_.op_reply_valid_cursor_.inc();
@@ -172,39 +244,35 @@ void ProxyFilter::decodeReply(ReplyMessagePtr&& message) {
     active_query_list_.erase(i);
     break;
   }
+
+  logMessage(std::move(message), false);
 }
 
 void ProxyFilter::chargeReplyStats(ActiveQuery& active_query, const std::string& prefix,
                                    const ReplyMessage& message) {
-  uint64_t reply_documents_byte_size = 0;
-  for (const Bson::DocumentSharedPtr& document : message.documents()) {
-    reply_documents_byte_size += document->byteSize();
-  }
-
   stat_store_.deliverHistogramToSinks(fmt::format("{}.reply_num_docs", prefix),
-                                      message.documents().size());
+                                      message.numberReturned());
   stat_store_.deliverHistogramToSinks(fmt::format("{}.reply_size", prefix),
-                                      reply_documents_byte_size);
+                                      message.documentsByteSize());
   stat_store_.deliverTimingToSinks(
       fmt::format("{}.reply_time_ms", prefix),
       std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() -
                                                             active_query.start_time_));
 }
 
-void ProxyFilter::doDecode(Buffer::Instance& buffer) {
+void ProxyFilter::doDecode(DecoderPtr& decoder, const Buffer::Instance& data) {
   if (!sniffing_ || !runtime_.snapshot().featureEnabled("mongo.proxy_enabled", 100)) {
     // Safety measure just to make sure that if we have a decoding error we keep going and lose
     // stats. This can be removed once we are more confident of this code.
-    buffer.drain(buffer.length());
     return;
   }
 
-  if (!decoder_) {
-    decoder_ = createDecoder(*this);
+  if (!decoder) {
+    decoder = createDecoder(*this);
   }
 
   try {
-    decoder_->onData(buffer);
+    decoder->onData(data);
   } catch (EnvoyException& e) {
     log().info("mongo decoding error: {}", e.what());
     stats_.decoding_error_.inc();
@@ -212,9 +280,9 @@ void ProxyFilter::doDecode(Buffer::Instance& buffer) {
   }
 }
 
-void ProxyFilter::logMessage(Message& message, bool full) {
+void ProxyFilter::logMessage(MessagePtr&& message, bool full) {
   if (access_log_ && runtime_.snapshot().featureEnabled("mongo.logging_enabled", 100)) {
-    access_log_->logMessage(message, full, read_callbacks_->upstreamHost().get());
+    access_log_->logMessage(std::move(message), full, read_callbacks_->upstreamHost().get());
   }
 }
 
@@ -228,19 +296,18 @@ void ProxyFilter::onEvent(uint32_t event) {
 }
 
 Network::FilterStatus ProxyFilter::onData(Buffer::Instance& data) {
-  read_buffer_.add(data);
-  doDecode(read_buffer_);
+  doDecode(read_decoder_, data);
   return Network::FilterStatus::Continue;
 }
 
 Network::FilterStatus ProxyFilter::onWrite(Buffer::Instance& data) {
-  write_buffer_.add(data);
-  doDecode(write_buffer_);
+  doDecode(write_decoder_, data);
   return Network::FilterStatus::Continue;
 }
 
 DecoderPtr ProdProxyFilter::createDecoder(DecoderCallbacks& callbacks) {
-  return DecoderPtr{new DecoderImpl(callbacks)};
+  // Replies only contribute stats from the fields before their documents.
+  return DecoderPtr{new DecoderImpl(callbacks, true)};
 }
 
 } // Envoy
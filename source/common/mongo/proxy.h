@@ -1,14 +1,17 @@
 #pragma once
 
 #include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <list>
 #include <memory>
+#include <mutex>
 #include <string>
 
 #include "envoy/access_log/access_log.h"
 #include "envoy/common/time.h"
 #include "envoy/mongo/codec.h"
+#include "envoy/network/address.h"
 #include "envoy/network/connection.h"
 #include "envoy/network/filter.h"
 #include "envoy/runtime/runtime.h"
@@ -17,6 +20,7 @@
 
 #include "common/buffer/buffer_impl.h"
 #include "common/common/logger.h"
+#include "common/common/thread.h"
 #include "common/mongo/utility.h"
 #include "common/network/filter_impl.h"
 
@@ -57,24 +61,81 @@ struct MongoProxyStats {
 };
 
 /**
- * Access logger for mongo messages.
+ * All mongo access log stats. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_MONGO_ACCESS_LOG_STATS(COUNTER, GAUGE)                                                 \
+  COUNTER(written)                                                                                 \
+  COUNTER(sampled_out)                                                                             \
+  COUNTER(dropped)                                                                                 \
+  GAUGE  (pending)
+// clang-format on
+
+/**
+ * Struct definition for all mongo access log stats. @see stats_macros.h
+ */
+struct MongoAccessLogStats {
+  ALL_MONGO_ACCESS_LOG_STATS(GENERATE_COUNTER_STRUCT, GENERATE_GAUGE_STRUCT)
+};
+
+/**
+ * Access logger for mongo messages. Messages are sampled via runtime on the calling thread and
+ * then handed to a flush thread that serializes them and writes them to the file. If more than
+ * max_pending messages are waiting for the flush thread, new messages are dropped rather than
+ * letting the queue grow without bound.
  */
 class AccessLog {
 public:
-  AccessLog(const std::string& file_name, Envoy::AccessLog::AccessLogManager& log_manager);
-
-  void logMessage(const Message& message, bool full,
+  AccessLog(const std::string& file_name, Envoy::AccessLog::AccessLogManager& log_manager,
+            Runtime::Loader& runtime, Runtime::RandomGenerator& random,
+            const std::string& stat_prefix, Stats::Scope& scope, uint64_t max_pending);
+  ~AccessLog();
+
+  /**
+   * Log a message. The message is owned by the access log from here on since it is serialized
+   * on the flush thread.
+   * @param message supplies the message to log.
+   * @param full supplies whether the message is fully expanded. @see Message::toString().
+   * @param upstream_host supplies the upstream host the connection is proxying to, if any.
+   */
+  void logMessage(MessagePtr&& message, bool full,
                   const Upstream::HostDescription* upstream_host);
 
+  /**
+   * Default for max_pending if not configured.
+   */
+  static const uint64_t DEFAULT_MAX_PENDING = 10000;
+
 private:
+  struct PendingMessage {
+    SystemTime time_;
+    MessagePtr message_;
+    bool full_;
+    Network::Address::InstanceConstSharedPtr upstream_address_;
+  };
+
+  void flushThreadFunc();
+  void writeMessages(std::list<PendingMessage>& messages);
+
   Filesystem::FileSharedPtr file_;
+  Runtime::Loader& runtime_;
+  Runtime::RandomGenerator& random_;
+  MongoAccessLogStats stats_;
+  const uint64_t max_pending_;
+  std::mutex lock_;
+  std::condition_variable flush_event_;
+  std::list<PendingMessage> pending_messages_;
+  uint64_t pending_size_{};
+  bool flush_thread_exit_{};
+  Thread::ThreadPtr flush_thread_;
 };
 
 typedef std::shared_ptr<AccessLog> AccessLogSharedPtr;
 
 /**
- * A sniffing filter for mongo traffic. The current implementation makes a copy of read/written
- * data, decodes it, and generates stats.
+ * A sniffing filter for mongo traffic. Read and written data is decoded as it passes through, and
+ * stats are generated from the decoded messages. Each direction has its own decoder, which only
+ * copies the parts of messages it decodes. Reply documents are not decoded.
  */
 class ProxyFilter : public Network::Filter,
                     public DecoderCallbacks,
@@ -107,6 +168,8 @@ public:
 
   // Network::ConnectionCallbacks
   void onEvent(uint32_t event) override;
+  void onAboveWriteBufferHighWatermark() override {}
+  void onBelowWriteBufferLowWatermark() override {}
 
 private:
   struct ActiveQuery {
@@ -133,16 +196,15 @@ private:
   void chargeQueryStats(const std::string& prefix, QueryMessageInfo::QueryType query_type);
   void chargeReplyStats(ActiveQuery& active_query, const std::string& prefix,
                         const ReplyMessage& message);
-  void doDecode(Buffer::Instance& buffer);
-  void logMessage(Message& message, bool full);
+  void doDecode(DecoderPtr& decoder, const Buffer::Instance& data);
+  void logMessage(MessagePtr&& message, bool full);
 
-  std::unique_ptr<Decoder> decoder_;
+  DecoderPtr read_decoder_;
+  DecoderPtr write_decoder_;
   std::string stat_prefix_;
   Stats::Store& stat_store_;
   MongoProxyStats stats_;
   Runtime::Loader& runtime_;
-  Buffer::OwnedImpl read_buffer_;
-  Buffer::OwnedImpl write_buffer_;
   bool sniffing_{true};
   std::list<ActiveQueryPtr> active_query_list_;
   AccessLogSharedPtr access_log_;
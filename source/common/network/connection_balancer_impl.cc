@@ -0,0 +1,51 @@
+#include "common/network/connection_balancer_impl.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "common/common/assert.h"
+
+namespace Envoy {
+namespace Network {
+
+void ConnectionBalancerImpl::registerHandler(BalancedConnectionHandler& handler) {
+  std::unique_lock<std::mutex> lock(lock_);
+  handlers_.push_back(&handler);
+}
+
+void ConnectionBalancerImpl::unregisterHandler(BalancedConnectionHandler& handler) {
+  std::unique_lock<std::mutex> lock(lock_);
+  auto it = std::find(handlers_.begin(), handlers_.end(), &handler);
+  ASSERT(it != handlers_.end());
+  handlers_.erase(it);
+}
+
+bool ConnectionBalancerImpl::balance(BalancedConnectionHandler& current, int fd,
+                                     const sockaddr* remote_addr, int remote_addr_len) {
+  std::unique_lock<std::mutex> lock(lock_);
+
+  // The accepting handler wins ties so that connections only move when it is worth it.
+  BalancedConnectionHandler* target = &current;
+  uint64_t min_connections = current.numConnections();
+  for (BalancedConnectionHandler* handler : handlers_) {
+    if (min_connections == 0) {
+      break;
+    }
+
+    const uint64_t connections = handler->numConnections();
+    if (connections < min_connections) {
+      target = handler;
+      min_connections = connections;
+    }
+  }
+
+  if (target == &current) {
+    return false;
+  }
+
+  target->post(fd, remote_addr, remote_addr_len);
+  return true;
+}
+
+} // Network
+} // Envoy
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+
+#include "envoy/network/listener.h"
+
+namespace Envoy {
+namespace Network {
+
+/**
+ * Hands each new connection to the handler that currently owns the fewest connections. Handlers
+ * are only ever posted to with the balancer's lock held, so a handler that has unregistered can be
+ * destroyed safely.
+ */
+class ConnectionBalancerImpl : public ConnectionBalancer {
+public:
+  // Network::ConnectionBalancer
+  void registerHandler(BalancedConnectionHandler& handler) override;
+  void unregisterHandler(BalancedConnectionHandler& handler) override;
+  bool balance(BalancedConnectionHandler& current, int fd, const sockaddr* remote_addr,
+               int remote_addr_len) override;
+
+private:
+  std::mutex lock_;
+  std::vector<BalancedConnectionHandler*> handlers_;
+};
+
+} // Network
+} // Envoy
@@ -1,10 +1,12 @@
 #include "common/network/connection_impl.h"
 
+#include <fcntl.h>
 #include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <atomic>
 #include <cstdint>
 
@@ -52,6 +54,30 @@ void ConnectionImplUtility::updateBufferStats(uint64_t delta, uint64_t new_total
   }
 }
 
+const uint64_t ConnectionImplUtility::MinReadSize;
+const uint64_t ConnectionImplUtility::DefaultReadSize;
+const uint64_t ConnectionImplUtility::MaxReadSize;
+
+uint64_t ConnectionImplUtility::readRequestSize(uint64_t read_size, uint32_t read_buffer_limit,
+                                                uint64_t buffered) {
+  if (read_buffer_limit > 0 && buffered < read_buffer_limit) {
+    return std::min(read_size, std::max(read_buffer_limit - buffered, MinReadSize));
+  }
+
+  return read_size;
+}
+
+void ConnectionImplUtility::updateReadSize(uint64_t requested, uint64_t bytes_read,
+                                           uint64_t& read_size) {
+  if (bytes_read == requested && requested == read_size) {
+    read_size = std::min(read_size * 2, MaxReadSize);
+  } else if (bytes_read < read_size / 4) {
+    read_size = std::max(read_size / 2, MinReadSize);
+  }
+}
+
+const std::chrono::milliseconds ConnectionImplUtility::ConnectAttemptDelay(250);
+
 std::atomic<uint64_t> ConnectionImpl::next_global_id_;
 
 ConnectionImpl::ConnectionImpl(Event::DispatcherImpl& dispatcher, int fd,
@@ -64,6 +90,10 @@ ConnectionImpl::ConnectionImpl(Event::DispatcherImpl& dispatcher, int fd,
   // condition and just crash.
   RELEASE_ASSERT(fd_ != -1);
 
+  createFileEvent();
+}
+
+void ConnectionImpl::createFileEvent() {
   // We never ask for both early close and read at the same time. If we are reading, we want to
   // consume all available data.
   file_event_ = dispatcher_.createFileEvent(fd_, [this](uint32_t events) -> void {
@@ -98,7 +128,7 @@ void ConnectionImpl::close(ConnectionCloseType type) {
     return;
   }
 
-  uint64_t data_to_write = write_buffer_.length();
+  uint64_t data_to_write = write_buffer_.length() + (splice_pipe_ ? splice_pipe_->length_ : 0);
   conn_log_debug("closing data_to_write={} type={}", *this, data_to_write, enumToInt(type));
   if (data_to_write == 0 || type == ConnectionCloseType::NoFlush) {
     if (data_to_write > 0) {
@@ -139,6 +169,8 @@ void ConnectionImpl::closeSocket(uint32_t close_type) {
   updateWriteBufferStats(0, 0);
   buffer_stats_.reset();
 
+  alternate_connect_.reset();
+  stopSplice();
   file_event_.reset();
   ::close(fd_);
   fd_ = -1;
@@ -194,7 +226,27 @@ void ConnectionImpl::onRead(uint64_t read_buffer_size) {
 void ConnectionImpl::readDisable(bool disable) {
   bool read_enabled = readEnabled();
   UNREFERENCED_PARAMETER(read_enabled);
-  conn_log_trace("readDisable: enabled={} disable={}", *this, read_enabled, disable);
+  conn_log_trace("readDisable: enabled={} disable={} count={}", *this, read_enabled, disable,
+                 read_disable_count_);
+
+  // Reads may be disabled by several parties at once (e.g., the HTTP connection manager while a
+  // request is pending and a peer connection whose write buffer is over its high watermark), so
+  // the calls are counted and reads resume only once every party has enabled them again.
+  if (disable) {
+    if (++read_disable_count_ > 1) {
+      return;
+    }
+  } else {
+    ASSERT(read_disable_count_ > 0);
+    if (--read_disable_count_ > 0) {
+      return;
+    }
+  }
+
+  // A connection that is closing never reads again, however the count ends up.
+  if (fd_ == -1 || (state_ & InternalState::CloseWithFlush)) {
+    return;
+  }
 
   // When we disable reads, we still allow for early close notifications (the equivalent of
   // EPOLLRDHUP for an epoll backend). For backends that support it, this allows us to apply
@@ -216,7 +268,9 @@ void ConnectionImpl::readDisable(bool disable) {
     // We never ask for both early close and read at the same time. If we are reading, we want to
     // consume all available data.
     file_event_->setEnabled(Event::FileReadyType::Read | Event::FileReadyType::Write);
-    if (read_buffer_.length() > 0) {
+    // A splicing connection may have stopped reading before the socket was drained, so there may
+    // be data left that no edge will report.
+    if (read_buffer_.length() > 0 || splice_destination_ != nullptr) {
       file_event_->activate(Event::FileReadyType::Read);
     }
   }
@@ -230,10 +284,33 @@ void ConnectionImpl::raiseEvents(uint32_t events) {
   }
 }
 
-bool ConnectionImpl::readEnabled() { return state_ & InternalState::ReadEnabled; }
+bool ConnectionImpl::readEnabled() { return read_disable_count_ == 0; }
 
 void ConnectionImpl::addConnectionCallbacks(ConnectionCallbacks& cb) { callbacks_.push_back(&cb); }
 
+void ConnectionImpl::updateWriteBufferWatermarks() {
+  if (read_buffer_limit_ == 0) {
+    return;
+  }
+
+  // The low watermark is half of the high watermark so that a buffer hovering around the limit
+  // does not flap between the two states on every write.
+  const uint64_t buffered = write_buffer_.length();
+  if (!above_high_watermark_ && buffered > read_buffer_limit_) {
+    above_high_watermark_ = true;
+    conn_log_debug("write buffer above high watermark: {}", *this, buffered);
+    for (ConnectionCallbacks* callback : callbacks_) {
+      callback->onAboveWriteBufferHighWatermark();
+    }
+  } else if (above_high_watermark_ && buffered < read_buffer_limit_ / 2) {
+    above_high_watermark_ = false;
+    conn_log_debug("write buffer below low watermark: {}", *this, buffered);
+    for (ConnectionCallbacks* callback : callbacks_) {
+      callback->onBelowWriteBufferLowWatermark();
+    }
+  }
+}
+
 void ConnectionImpl::write(Buffer::Instance& data) {
   // NOTE: This is kind of a hack, but currently we don't support restart/continue on the write
   //       path, so we just pass around the buffer passed to us in this function. If we ever support
@@ -248,16 +325,16 @@ void ConnectionImpl::write(Buffer::Instance& data) {
 
   if (data.length() > 0) {
     conn_log_trace("writing {} bytes", *this, data.length());
-    // TODO(mattklein123): All data currently gets moved from the source buffer to the write buffer.
-    // This can lead to inefficient behavior if writing a bunch of small chunks. In this case, it
-    // would likely be more efficient to copy data below a certain size. VERY IMPORTANT: If this is
-    // ever changed, read the comment in Ssl::ConnectionImpl::doWriteToSocket() VERY carefully.
-    // That code assumes that we never change existing write_buffer_ chain elements between calls
-    // to SSL_write(). That code will have to change if we ever copy here.
+    // Data is moved from the source buffer to the write buffer. The buffer implementation copies
+    // small slices into the tail of the last write_buffer_ slice rather than adding new ones.
+    // VERY IMPORTANT: If this is ever changed, read the comment in
+    // Ssl::ConnectionImpl::doWriteToSocket() VERY carefully. That code assumes that existing
+    // write_buffer_ slices are never shrunk between calls to SSL_write().
     write_buffer_.move(data);
     if (!(state_ & InternalState::Connecting)) {
       file_event_->activate(Event::FileReadyType::Write);
     }
+    updateWriteBufferWatermarks();
   }
 }
 
@@ -266,7 +343,7 @@ void ConnectionImpl::onFileEvent(uint32_t events) {
 
   if (state_ & InternalState::ImmediateConnectionError) {
     conn_log_debug("raising immediate connect error", *this);
-    closeSocket(ConnectionEvent::RemoteClose);
+    onConnectError();
     return;
   }
 
@@ -296,12 +373,9 @@ ConnectionImpl::IoResult ConnectionImpl::doReadFromSocket() {
   PostIoAction action = PostIoAction::KeepOpen;
   uint64_t bytes_read = 0;
   do {
-    // 16K read is arbitrary. IIRC, libevent will currently clamp this to 4K. libevent will also
-    // use an ioctl() before every read to figure out how much data there is to read.
-    //
-    // TODO(mattklein123) PERF: Tune the read size and figure out a way of getting rid of the
-    // ioctl(). The extra syscall is not worth it.
-    int rc = read_buffer_.read(fd_, 16384);
+    const uint64_t requested = ConnectionImplUtility::readRequestSize(
+        read_size_, read_buffer_limit_, read_buffer_.length());
+    int rc = read_buffer_.read(fd_, requested);
     conn_log_trace("read returns: {}", *this, rc);
 
     // Remote close. Might need to raise data before raising close.
@@ -318,6 +392,7 @@ ConnectionImpl::IoResult ConnectionImpl::doReadFromSocket() {
       break;
     } else {
       bytes_read += rc;
+      ConnectionImplUtility::updateReadSize(requested, rc, read_size_);
       if (shouldDrainReadBuffer()) {
         setReadBufferReady();
         break;
@@ -331,7 +406,7 @@ ConnectionImpl::IoResult ConnectionImpl::doReadFromSocket() {
 void ConnectionImpl::onReadReady() {
   ASSERT(!(state_ & InternalState::Connecting));
 
-  IoResult result = doReadFromSocket();
+  IoResult result = splice_destination_ ? doSpliceFromSocket() : doReadFromSocket();
   uint64_t new_buffer_size = read_buffer_.length();
   updateReadBufferStats(result.bytes_processed_, new_buffer_size);
   onRead(new_buffer_size);
@@ -344,31 +419,21 @@ void ConnectionImpl::onReadReady() {
 }
 
 ConnectionImpl::IoResult ConnectionImpl::doWriteToSocket() {
-  PostIoAction action;
-  uint64_t bytes_written = 0;
-  do {
-    if (write_buffer_.length() == 0) {
-      action = PostIoAction::KeepOpen;
-      break;
-    }
-
-    int rc = write_buffer_.write(fd_);
-    conn_log_trace("write returns: {}", *this, rc);
-    if (rc == -1) {
-      conn_log_trace("write error: {}", *this, errno);
-      if (errno == EAGAIN) {
-        action = PostIoAction::KeepOpen;
-      } else {
-        action = PostIoAction::Close;
-      }
+  if (write_buffer_.length() == 0) {
+    return {PostIoAction::KeepOpen, 0};
+  }
 
-      break;
-    } else {
-      bytes_written += rc;
-    }
-  } while (true);
+  // The buffer keeps writing until it is empty or the socket is full, so there is no need to loop
+  // here and make a final write call that returns EAGAIN. If the socket is full we will get
+  // another write event once there is room.
+  int rc = write_buffer_.write(fd_);
+  conn_log_trace("write returns: {}", *this, rc);
+  if (rc == -1) {
+    conn_log_trace("write error: {}", *this, errno);
+    return {errno == EAGAIN ? PostIoAction::KeepOpen : PostIoAction::Close, 0};
+  }
 
-  return {action, bytes_written};
+  return {PostIoAction::KeepOpen, static_cast<uint64_t>(rc)};
 }
 
 void ConnectionImpl::onConnected() { raiseEvents(ConnectionEvent::Connected); }
@@ -386,6 +451,8 @@ void ConnectionImpl::onWriteReady() {
     if (error == 0) {
       conn_log_debug("connected", *this);
       state_ &= ~InternalState::Connecting;
+      // Cancel the connect attempts that lost the race.
+      alternate_connect_.reset();
       onConnected();
       // It's possible that we closed during the connect callback.
       if (state() != State::Open) {
@@ -394,26 +461,197 @@ void ConnectionImpl::onWriteReady() {
       }
     } else {
       conn_log_debug("delayed connection error: {}", *this, error);
-      closeSocket(ConnectionEvent::RemoteClose);
+      onConnectError();
       return;
     }
   }
 
+  doWrite();
+}
+
+void ConnectionImpl::doWrite() {
   IoResult result = doWriteToSocket();
   uint64_t new_buffer_size = write_buffer_.length();
+
+  // Spliced data was read after anything already in the write buffer, so it goes out after it.
+  bool splice_pipe_empty = true;
+  if (splice_pipe_) {
+    if (new_buffer_size == 0 && result.action_ == PostIoAction::KeepOpen) {
+      IoResult splice_result = doSpliceToSocket();
+      result.action_ = splice_result.action_;
+      result.bytes_processed_ += splice_result.bytes_processed_;
+    }
+
+    splice_pipe_empty = splice_pipe_->length_ == 0;
+  }
+
   updateWriteBufferStats(result.bytes_processed_, new_buffer_size);
+  if (result.action_ == PostIoAction::KeepOpen) {
+    updateWriteBufferWatermarks();
+  }
 
   if (result.action_ == PostIoAction::Close) {
     // It is possible (though unlikely) for the connection to have already been closed during the
     // write callback. This can happen if we manage to complete the SSL handshake in the write
     // callback, raise a connected event, and close the connection.
     closeSocket(ConnectionEvent::RemoteClose);
-  } else if ((state_ & InternalState::CloseWithFlush) && new_buffer_size == 0) {
+  } else if ((state_ & InternalState::CloseWithFlush) && new_buffer_size == 0 &&
+             splice_pipe_empty) {
     conn_log_debug("write flush complete", *this);
     closeSocket(ConnectionEvent::LocalClose);
   }
 }
 
+bool ConnectionImpl::spliceTo(Connection& destination, Stats::Counter& bytes_spliced) {
+#ifdef __linux__
+  ConnectionImpl* destination_impl = dynamic_cast<ConnectionImpl*>(&destination);
+  if (destination_impl == nullptr || destination_impl == this || ssl() != nullptr ||
+      destination.ssl() != nullptr || &destination.dispatcher() != &dispatcher_ ||
+      state() != State::Open || destination.state() != State::Open ||
+      filter_manager_.numReadFilters() > 1 ||
+      destination_impl->filter_manager_.numWriteFilters() > 0 || read_buffer_.length() > 0 ||
+      splice_destination_ != nullptr || destination_impl->splice_pipe_) {
+    return false;
+  }
+
+  int fds[2];
+  if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) == -1) {
+    conn_log_debug("splice pipe creation failed: {}", *this, errno);
+    return false;
+  }
+
+  // Let a single splice move as much as the largest read. The pipe works with the default size if
+  // this is not allowed.
+  fcntl(fds[1], F_SETPIPE_SZ, ConnectionImplUtility::MaxReadSize);
+
+  conn_log_debug("splicing to connection {}", *this, destination.id());
+  destination_impl->splice_pipe_.reset(new SplicePipe(fds[0], fds[1], *this, bytes_spliced));
+  splice_destination_ = destination_impl;
+
+  // Reads are edge triggered, so pick up anything that is already waiting on the socket.
+  if (state_ & InternalState::ReadEnabled) {
+    setReadBufferReady();
+  }
+
+  return true;
+#else
+  UNREFERENCED_PARAMETER(destination);
+  UNREFERENCED_PARAMETER(bytes_spliced);
+  return false;
+#endif
+}
+
+ConnectionImpl::SplicePipe::~SplicePipe() {
+  ::close(read_fd_);
+  ::close(write_fd_);
+}
+
+ConnectionImpl::IoResult ConnectionImpl::doSpliceFromSocket() {
+#ifdef __linux__
+  PostIoAction action = PostIoAction::KeepOpen;
+  uint64_t bytes_read = 0;
+  // Reads only happen into an empty pipe, so EAGAIN always means that the socket has been drained.
+  // If the destination cannot take everything, reading stops and the destination picks it up again
+  // once it has emptied the pipe.
+  while ((state_ & InternalState::ReadEnabled) && splice_destination_ != nullptr) {
+    SplicePipe& pipe = *splice_destination_->splice_pipe_;
+    if (pipe.length_ > 0) {
+      pipe.source_waiting_ = true;
+      break;
+    }
+
+    ssize_t rc = splice(fd_, nullptr, pipe.write_fd_, nullptr, ConnectionImplUtility::MaxReadSize,
+                        SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    conn_log_trace("splice from socket returns: {}", *this, rc);
+    if (rc == 0) {
+      action = PostIoAction::Close;
+      break;
+    } else if (rc == -1) {
+      conn_log_trace("splice from socket error: {}", *this, errno);
+      if (errno != EAGAIN) {
+        action = PostIoAction::Close;
+      }
+
+      break;
+    }
+
+    bytes_read += rc;
+    pipe.length_ += rc;
+    if (!(splice_destination_->state_ & InternalState::Connecting)) {
+      // This may close either connection.
+      splice_destination_->doWrite();
+      if (fd_ == -1) {
+        break;
+      }
+    }
+  }
+
+  return {action, bytes_read};
+#else
+  NOT_REACHED;
+#endif
+}
+
+ConnectionImpl::IoResult ConnectionImpl::doSpliceToSocket() {
+#ifdef __linux__
+  PostIoAction action = PostIoAction::KeepOpen;
+  uint64_t bytes_written = 0;
+  while (splice_pipe_->length_ > 0) {
+    ssize_t rc = splice(splice_pipe_->read_fd_, nullptr, fd_, nullptr, splice_pipe_->length_,
+                        SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    conn_log_trace("splice to socket returns: {}", *this, rc);
+    if (rc == -1) {
+      conn_log_trace("splice to socket error: {}", *this, errno);
+      if (errno != EAGAIN) {
+        action = PostIoAction::Close;
+      }
+
+      break;
+    }
+
+    splice_pipe_->length_ -= rc;
+    bytes_written += rc;
+  }
+
+  if (bytes_written > 0) {
+    splice_pipe_->bytes_spliced_.add(bytes_written);
+  }
+
+  if (splice_pipe_->length_ == 0 && splice_pipe_->source_waiting_) {
+    splice_pipe_->source_waiting_ = false;
+    splice_pipe_->source_->setReadBufferReady();
+  }
+
+  return {action, bytes_written};
+#else
+  NOT_REACHED;
+#endif
+}
+
+void ConnectionImpl::stopSplice() {
+  if (splice_destination_ != nullptr) {
+    // Data left in the pipe is still written by the destination.
+    splice_destination_->splice_pipe_->source_ = nullptr;
+    splice_destination_->splice_pipe_->source_waiting_ = false;
+    splice_destination_ = nullptr;
+  }
+
+  if (splice_pipe_) {
+    ConnectionImpl* source = splice_pipe_->source_;
+    if (source != nullptr) {
+      conn_log_debug("stopping splice from connection {}", *this, source->id());
+      source->splice_destination_ = nullptr;
+      // The source may have stopped reading to wait for the pipe. Data from now on goes through
+      // its read filters.
+      if (source->state_ & InternalState::ReadEnabled) {
+        source->setReadBufferReady();
+      }
+    }
+
+    splice_pipe_.reset();
+  }
+}
+
 void ConnectionImpl::doConnect() {
   conn_log_debug("connecting to {}", *this, remote_address_->asString());
   int rc = remote_address_->connect(fd_);
@@ -431,6 +669,169 @@ void ConnectionImpl::doConnect() {
       conn_log_debug("immediate connection error: {}", *this, errno);
     }
   }
+
+  if (alternate_connect_ && !alternate_connect_->pending_addresses_.empty()) {
+    alternate_connect_->attempt_timer_->enableTimer(ConnectionImplUtility::ConnectAttemptDelay);
+  }
+}
+
+ConnectionImpl::ConnectAttempt::~ConnectAttempt() {
+  file_event_.reset();
+  if (fd_ != -1) {
+    ::close(fd_);
+  }
+}
+
+void ConnectionImpl::addAlternateAddresses(
+    const std::vector<Address::InstanceConstSharedPtr>& addresses) {
+  ASSERT(!(state_ & InternalState::Connecting));
+  if (addresses.empty()) {
+    return;
+  }
+
+  if (!alternate_connect_) {
+    alternate_connect_.reset(new AlternateConnectState());
+    alternate_connect_->attempt_timer_ = dispatcher_.createTimer([this]() -> void {
+      // Skip addresses that fail immediately so that an attempt is started on every tick.
+      const size_t attempts = alternate_connect_->attempts_.size();
+      while (alternate_connect_->attempts_.size() == attempts &&
+             !alternate_connect_->pending_addresses_.empty()) {
+        startConnectAttempt();
+      }
+
+      if (!alternate_connect_->pending_addresses_.empty()) {
+        alternate_connect_->attempt_timer_->enableTimer(
+            ConnectionImplUtility::ConnectAttemptDelay);
+      }
+    });
+  }
+
+  alternate_connect_->pending_addresses_.insert(alternate_connect_->pending_addresses_.end(),
+                                                addresses.begin(), addresses.end());
+}
+
+void ConnectionImpl::applySocketOptions(SocketOptionsConstSharedPtr options) {
+  ASSERT(!(state_ & InternalState::Connecting));
+  socket_options_ = options;
+  if (fd_ != -1 && remote_address_->type() == Address::Type::Ip) {
+    applySocketOptions(fd_);
+  }
+}
+
+void ConnectionImpl::applySocketOptions(int fd) {
+  if (socket_options_ && !Utility::applySocketOptions(fd, *socket_options_)) {
+    conn_log_debug("not all socket options could be applied", *this);
+  }
+}
+
+void ConnectionImpl::startConnectAttempt() {
+  Address::InstanceConstSharedPtr address = alternate_connect_->pending_addresses_.front();
+  alternate_connect_->pending_addresses_.pop_front();
+
+  int fd = address->socket(Address::SocketType::Stream);
+  RELEASE_ASSERT(fd != -1);
+  if (address->type() == Address::Type::Ip) {
+    applySocketOptions(fd);
+  }
+  conn_log_debug("connect attempt to {}", *this, address->asString());
+  int rc = address->connect(fd);
+  if (rc == -1 && errno != EINPROGRESS) {
+    conn_log_debug("immediate connect attempt error: {}", *this, errno);
+    ::close(fd);
+    return;
+  }
+
+  ConnectAttempt* attempt = new ConnectAttempt(fd, address);
+  alternate_connect_->attempts_.emplace_back(attempt);
+  attempt->file_event_ = dispatcher_.createFileEvent(fd, [this, attempt](uint32_t) -> void {
+    onConnectAttemptEvent(*attempt);
+  }, Event::FileTriggerType::Edge, Event::FileReadyType::Write);
+}
+
+void ConnectionImpl::onConnectAttemptEvent(ConnectAttempt& attempt) {
+  int error;
+  socklen_t error_size = sizeof(error);
+  int rc = getsockopt(attempt.fd_, SOL_SOCKET, SO_ERROR, &error, &error_size);
+  ASSERT(0 == rc);
+  UNREFERENCED_PARAMETER(rc);
+
+  std::list<ConnectAttemptPtr>& attempts = alternate_connect_->attempts_;
+  auto it = std::find_if(attempts.begin(), attempts.end(),
+                         [&attempt](const ConnectAttemptPtr& entry) -> bool {
+                           return entry.get() == &attempt;
+                         });
+  ASSERT(it != attempts.end());
+  // This destroys the file event that is running this callback once we return.
+  ConnectAttemptPtr owned_attempt = std::move(*it);
+  attempts.erase(it);
+
+  if (error != 0) {
+    conn_log_debug("delayed connect attempt error: {}", *this, error);
+    return;
+  }
+
+  // The attempt won the race. It takes over the connection, which then raises the connected event
+  // once the new file event reports the socket as writable.
+  conn_log_debug("connect attempt to {} won", *this, owned_attempt->address_->asString());
+  alternate_connect_.reset();
+  state_ &= ~InternalState::ImmediateConnectionError;
+  owned_attempt->file_event_.reset();
+  const int fd = owned_attempt->fd_;
+  owned_attempt->fd_ = -1;
+  replaceSocket(fd, owned_attempt->address_);
+}
+
+void ConnectionImpl::onConnectError() {
+  state_ &= ~(InternalState::Connecting | InternalState::ImmediateConnectionError);
+
+  // Hand the connection to the oldest attempt in progress, or to the next address, before
+  // giving up.
+  while (alternate_connect_) {
+    if (!alternate_connect_->attempts_.empty()) {
+      ConnectAttemptPtr attempt = std::move(alternate_connect_->attempts_.front());
+      alternate_connect_->attempts_.pop_front();
+      attempt->file_event_.reset();
+      const int fd = attempt->fd_;
+      attempt->fd_ = -1;
+      state_ |= InternalState::Connecting;
+      replaceSocket(fd, attempt->address_);
+      return;
+    }
+
+    if (alternate_connect_->pending_addresses_.empty()) {
+      break;
+    }
+
+    startConnectAttempt();
+  }
+
+  closeSocket(ConnectionEvent::RemoteClose);
+}
+
+void ConnectionImpl::replaceSocket(int fd, Address::InstanceConstSharedPtr remote_address) {
+  conn_log_debug("replacing socket to {} with socket to {}", *this, remote_address_->asString(),
+                 remote_address->asString());
+
+  // Carry over options that were set on the socket before connect().
+  if (remote_address_->type() == Address::Type::Ip) {
+    int no_delay = 0;
+    socklen_t no_delay_size = sizeof(no_delay);
+    if (getsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &no_delay, &no_delay_size) == 0 && no_delay) {
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+    }
+  }
+
+  file_event_.reset();
+  ::close(fd_);
+  fd_ = fd;
+  remote_address_ = remote_address;
+  local_address_ = getNullLocalAddress(*remote_address);
+  createFileEvent();
+  if (!(state_ & InternalState::ReadEnabled)) {
+    file_event_->setEnabled(Event::FileReadyType::Write | Event::FileReadyType::Closed);
+  }
+
+  onSocketReplaced(fd);
 }
 
 void ConnectionImpl::setBufferStats(const BufferStats& stats) {
@@ -438,6 +839,11 @@ void ConnectionImpl::setBufferStats(const BufferStats& stats) {
   buffer_stats_.reset(new BufferStats(stats));
 }
 
+void ConnectionImpl::setBufferAccount(Buffer::MemoryAccountSharedPtr account) {
+  read_buffer_.setAccount(account);
+  write_buffer_.setAccount(account);
+}
+
 void ConnectionImpl::updateReadBufferStats(uint64_t num_read, uint64_t new_size) {
   if (!buffer_stats_) {
     return;
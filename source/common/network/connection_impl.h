@@ -1,10 +1,12 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <list>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "envoy/network/connection.h"
 
@@ -22,6 +24,10 @@ namespace Network {
  */
 class ConnectionImplUtility {
 public:
+  static const uint64_t MinReadSize = 4096;
+  static const uint64_t DefaultReadSize = 16384;
+  static const uint64_t MaxReadSize = 262144;
+
   /**
    * Update the buffer stats for a connection.
    * @param delta supplies the data read/written.
@@ -34,6 +40,31 @@ public:
    */
   static void updateBufferStats(uint64_t delta, uint64_t new_total, uint64_t& previous_total,
                                 Stats::Counter& stat_total, Stats::Gauge& stat_current);
+
+  /**
+   * Compute how much to read from a socket in a single call.
+   * @param read_size supplies the connection's current adaptive read size.
+   * @param read_buffer_limit supplies the connection's read buffer limit, or 0 for no limit.
+   * @param buffered supplies the number of bytes already in the read buffer.
+   * @return uint64_t the number of bytes to request. Reads stop close to the buffer limit rather
+   *         than overshooting it by a whole read, but are never smaller than MinReadSize.
+   */
+  static uint64_t readRequestSize(uint64_t read_size, uint32_t read_buffer_limit,
+                                  uint64_t buffered);
+
+  /**
+   * Adapt a connection's read size to the result of a read. The read size doubles when a full
+   * sized read fills the whole request, and halves when a read returns less than a quarter of it,
+   * staying between MinReadSize and MaxReadSize.
+   * @param requested supplies the number of bytes that were requested.
+   * @param bytes_read supplies the number of bytes that were read.
+   * @param read_size supplies the read size to update.
+   */
+  static void updateReadSize(uint64_t requested, uint64_t bytes_read, uint64_t& read_size);
+
+  // How long a connect attempt may be in progress before the next alternate address is tried.
+  // This is the connection attempt delay recommended by RFC 8305.
+  static const std::chrono::milliseconds ConnectAttemptDelay;
 };
 
 /**
@@ -64,19 +95,36 @@ public:
   void noDelay(bool enable) override;
   void readDisable(bool disable) override;
   bool readEnabled() override;
-  const Address::Instance& remoteAddress() override { return *remote_address_; }
-  const Address::Instance& localAddress() override { return *local_address_; }
+  const Address::Instance& remoteAddress() const override { return *remote_address_; }
+  const Address::Instance& localAddress() const override { return *local_address_; }
+  const std::string& requestedServerName() override { return requested_server_name_; }
+  const std::vector<std::string>& requestedApplicationProtocols() override {
+    return requested_application_protocols_;
+  }
   void setBufferStats(const BufferStats& stats) override;
   Ssl::Connection* ssl() override { return nullptr; }
   State state() override;
   void write(Buffer::Instance& data) override;
   void setReadBufferLimit(uint32_t limit) override { read_buffer_limit_ = limit; }
   uint32_t readBufferLimit() const override { return read_buffer_limit_; }
+  void setBufferAccount(Buffer::MemoryAccountSharedPtr account) override;
+  bool spliceTo(Connection& destination, Stats::Counter& bytes_spliced) override;
 
   // Network::BufferSource
   Buffer::Instance& getReadBuffer() override { return read_buffer_; }
   Buffer::Instance& getWriteBuffer() override { return *current_write_buffer_; }
 
+  /**
+   * Record what the listener peeked from the client's TLS ClientHello before the connection was
+   * created. @see Connection::requestedServerName().
+   */
+  void setRequestedServerName(const std::string& server_name) {
+    requested_server_name_ = server_name;
+  }
+  void setRequestedApplicationProtocols(const std::vector<std::string>& application_protocols) {
+    requested_application_protocols_ = application_protocols;
+  }
+
 protected:
   enum class PostIoAction { Close, KeepOpen };
 
@@ -87,6 +135,15 @@ protected:
 
   virtual void closeSocket(uint32_t close_type);
   void doConnect();
+  // Supply alternate addresses to race against remote_address_ in doConnect().
+  // @see ClientConnection::setAlternateAddresses().
+  void addAlternateAddresses(const std::vector<Address::InstanceConstSharedPtr>& addresses);
+  // @see ClientConnection::setSocketOptions().
+  void applySocketOptions(SocketOptionsConstSharedPtr options);
+  void applySocketOptions(int fd);
+  // Called when the socket of the connection has been replaced by fd, the socket of another connect
+  // attempt. Derived classes that bind state to the fd should rebind it here.
+  virtual void onSocketReplaced(int) {}
   void raiseEvents(uint32_t events);
   // Should the read buffer be drained?
   bool shouldDrainReadBuffer() {
@@ -98,10 +155,16 @@ protected:
   // fair sharing of CPU resources, the underlying event loop does not make any fairness guarantees.
   // Reconsider how to make fairness happen.
   void setReadBufferReady() { file_event_->activate(Event::FileReadyType::Read); }
+  // Run the write path in the event loop even if the socket has not become writable. This is used
+  // to continue work that was waiting on something other than the socket.
+  void setWriteReady() { file_event_->activate(Event::FileReadyType::Write); }
+  virtual IoResult doWriteToSocket();
 
   FilterManagerImpl filter_manager_;
   Address::InstanceConstSharedPtr remote_address_;
   Address::InstanceConstSharedPtr local_address_;
+  std::string requested_server_name_;
+  std::vector<std::string> requested_application_protocols_;
   Buffer::OwnedImpl read_buffer_;
   Buffer::OwnedImpl write_buffer_;
   uint32_t read_buffer_limit_ = 0;
@@ -116,15 +179,71 @@ private:
   };
   // clang-format on
 
+  /**
+   * A connect attempt to an alternate address that is racing the socket of the connection.
+   */
+  struct ConnectAttempt {
+    ConnectAttempt(int fd, Address::InstanceConstSharedPtr address) : fd_(fd), address_(address) {}
+    ~ConnectAttempt();
+
+    int fd_;
+    const Address::InstanceConstSharedPtr address_;
+    Event::FileEventPtr file_event_;
+  };
+
+  typedef std::unique_ptr<ConnectAttempt> ConnectAttemptPtr;
+
+  /**
+   * The pipe that a spliced connection moves data through. It is owned by the destination so that
+   * data still in the pipe can be flushed after the source has closed.
+   */
+  struct SplicePipe {
+    SplicePipe(int read_fd, int write_fd, ConnectionImpl& source, Stats::Counter& bytes_spliced)
+        : read_fd_(read_fd), write_fd_(write_fd), source_(&source), bytes_spliced_(bytes_spliced) {}
+    ~SplicePipe();
+
+    const int read_fd_;
+    const int write_fd_;
+    // The connection that reads into the pipe, or nullptr once it has stopped.
+    ConnectionImpl* source_;
+    Stats::Counter& bytes_spliced_;
+    uint64_t length_{};
+    // Whether the source stopped reading until the pipe is empty.
+    bool source_waiting_{};
+  };
+
+  typedef std::unique_ptr<SplicePipe> SplicePipePtr;
+
+  /**
+   * State of a connect() that races alternate addresses. It only exists while connecting.
+   */
+  struct AlternateConnectState {
+    // Addresses that have not been attempted yet, in order of preference.
+    std::list<Address::InstanceConstSharedPtr> pending_addresses_;
+    // Attempts in progress other than the socket of the connection, oldest first.
+    std::list<ConnectAttemptPtr> attempts_;
+    Event::TimerPtr attempt_timer_;
+  };
+
+  void createFileEvent();
+  void startConnectAttempt();
+  void onConnectAttemptEvent(ConnectAttempt& attempt);
+  void onConnectError();
+  void replaceSocket(int fd, Address::InstanceConstSharedPtr remote_address);
   virtual IoResult doReadFromSocket();
-  virtual IoResult doWriteToSocket();
+  IoResult doSpliceFromSocket();
+  IoResult doSpliceToSocket();
+  void stopSplice();
   virtual void onConnected();
   void onFileEvent(uint32_t events);
   void onRead(uint64_t read_buffer_size);
   void onReadReady();
   void onWriteReady();
+  void doWrite();
   void updateReadBufferStats(uint64_t num_read, uint64_t new_size);
   void updateWriteBufferStats(uint64_t num_written, uint64_t new_size);
+  // Raise the write buffer watermark callbacks if the write buffer crossed a watermark.
+  void updateWriteBufferWatermarks();
 
   static std::atomic<uint64_t> next_global_id_;
 
@@ -134,10 +253,20 @@ private:
   const uint64_t id_;
   std::list<ConnectionCallbacks*> callbacks_;
   uint32_t state_{InternalState::ReadEnabled};
+  // How many more times reads were disabled than enabled again.
+  uint32_t read_disable_count_{};
+  bool above_high_watermark_{};
   Buffer::Instance* current_write_buffer_{};
   uint64_t last_read_buffer_size_{};
   uint64_t last_write_buffer_size_{};
+  uint64_t read_size_{ConnectionImplUtility::DefaultReadSize};
   std::unique_ptr<BufferStats> buffer_stats_;
+  std::unique_ptr<AlternateConnectState> alternate_connect_;
+  SocketOptionsConstSharedPtr socket_options_;
+  // Set while this connection splices its reads to another connection.
+  ConnectionImpl* splice_destination_{};
+  // Set while another connection splices its reads to this connection.
+  SplicePipePtr splice_pipe_;
 };
 
 /**
@@ -149,6 +278,13 @@ public:
 
   // Network::ClientConnection
   void connect() override { doConnect(); }
+  void setAlternateAddresses(
+      const std::vector<Address::InstanceConstSharedPtr>& addresses) override {
+    addAlternateAddresses(addresses);
+  }
+  void setSocketOptions(SocketOptionsConstSharedPtr options) override {
+    applySocketOptions(options);
+  }
 };
 
 } // Network
@@ -1,13 +1,19 @@
 #include "common/network/dns_impl.h"
 
+#include <arpa/inet.h>
+#include <arpa/nameser.h>
 #include <netdb.h>
 #include <netinet/ip.h>
 #include <sys/socket.h>
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
+#include <cstring>
+#include <limits>
 #include <list>
 #include <memory>
+#include <mutex>
 #include <string>
 
 #include "common/common/assert.h"
@@ -19,16 +25,148 @@
 namespace Envoy {
 namespace Network {
 
+namespace {
+
+// The number of TTLs read from a reply. Addresses beyond this are still used.
+const int MaxAddrTtls = 32;
+
+std::list<Address::InstanceConstSharedPtr> addressListFromHostent(const hostent& hostent) {
+  std::list<Address::InstanceConstSharedPtr> address_list;
+  if (hostent.h_addrtype == AF_INET) {
+    for (int i = 0; hostent.h_addr_list[i] != nullptr; ++i) {
+      ASSERT(hostent.h_length == sizeof(in_addr));
+      sockaddr_in address;
+      memset(&address, 0, sizeof(address));
+      address.sin_family = AF_INET;
+      address.sin_port = 0;
+      address.sin_addr = *reinterpret_cast<in_addr*>(hostent.h_addr_list[i]);
+      address_list.emplace_back(new Address::Ipv4Instance(&address));
+    }
+  } else if (hostent.h_addrtype == AF_INET6) {
+    for (int i = 0; hostent.h_addr_list[i] != nullptr; ++i) {
+      ASSERT(hostent.h_length == sizeof(in6_addr));
+      sockaddr_in6 address;
+      memset(&address, 0, sizeof(address));
+      address.sin6_family = AF_INET6;
+      address.sin6_port = 0;
+      address.sin6_addr = *reinterpret_cast<in6_addr*>(hostent.h_addr_list[i]);
+      address_list.emplace_back(new Address::Ipv6Instance(address));
+    }
+  }
+
+  return address_list;
+}
+
+bool parseIpLiteral(const std::string& dns_name, int family,
+                    std::list<Address::InstanceConstSharedPtr>& address_list) {
+  if (family == AF_INET) {
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    if (inet_pton(AF_INET, dns_name.c_str(), &address.sin_addr) != 1) {
+      return false;
+    }
+    address.sin_family = AF_INET;
+    address_list.emplace_back(new Address::Ipv4Instance(&address));
+  } else {
+    sockaddr_in6 address;
+    memset(&address, 0, sizeof(address));
+    if (inet_pton(AF_INET6, dns_name.c_str(), &address.sin6_addr) != 1) {
+      return false;
+    }
+    address.sin6_family = AF_INET6;
+    address_list.emplace_back(new Address::Ipv6Instance(address));
+  }
+
+  return true;
+}
+
+// ares_library_init() and ares_library_cleanup() maintain an unsynchronized reference count and
+// resolvers are created and destroyed on several threads.
+std::mutex ares_library_lock;
+
+} // namespace
+
+bool DnsCacheImpl::find(const Key& key, Entry& entry) const {
+  EntryMapConstSharedPtr entries = std::atomic_load(&entries_);
+  auto it = entries->find(key);
+  if (it == entries->end()) {
+    return false;
+  }
+
+  entry = it->second;
+  return true;
+}
+
+bool DnsCacheImpl::join(const Key& key, const FollowerSharedPtr& follower) {
+  std::unique_lock<std::mutex> lock(lock_);
+  auto it = resolutions_.find(key);
+  if (it == resolutions_.end()) {
+    resolutions_[key];
+    return true;
+  }
+
+  if (follower) {
+    it->second.push_back(follower);
+  }
+  return false;
+}
+
+void DnsCacheImpl::leave(const Key& key, const FollowerSharedPtr& follower) {
+  std::unique_lock<std::mutex> lock(lock_);
+  auto it = resolutions_.find(key);
+  if (it != resolutions_.end()) {
+    it->second.remove(follower);
+  }
+}
+
+void DnsCacheImpl::complete(const Key& key,
+                            const std::list<Address::InstanceConstSharedPtr>& address_list,
+                            Optional<std::chrono::seconds> cache_ttl, MonotonicTime now) {
+  std::unique_lock<std::mutex> lock(lock_);
+  if (cache_ttl.valid()) {
+    // Entries that can no longer be served, not even stale, are dropped while copying.
+    std::shared_ptr<EntryMap> entries(new EntryMap());
+    for (const auto& entry : *entries_) {
+      if (now < entry.second.expiry_time_ + DnsResolverImpl::MaxStaleTime) {
+        entries->insert(entry);
+      }
+    }
+    (*entries)[key] = {address_list, now + cache_ttl.value()};
+    std::atomic_store(&entries_, EntryMapConstSharedPtr{entries});
+  }
+
+  auto it = resolutions_.find(key);
+  ASSERT(it != resolutions_.end());
+  // Posting while holding the lock guarantees that the dispatchers of the followers still exist.
+  for (const FollowerSharedPtr& follower : it->second) {
+    std::list<Address::InstanceConstSharedPtr> follower_address_list = address_list;
+    follower->dispatcher_.post([follower, follower_address_list]() mutable -> void {
+      if (!follower->cancelled_) {
+        follower->callback_(std::move(follower_address_list));
+      }
+    });
+  }
+  resolutions_.erase(it);
+}
+
+const std::chrono::seconds DnsResolverImpl::NegativeCacheTtl(5);
+const std::chrono::seconds DnsResolverImpl::MaxStaleTime(60);
+
 DnsResolverImpl::DnsResolverImpl(
     Event::Dispatcher& dispatcher,
-    const std::vector<Network::Address::InstanceConstSharedPtr>& resolvers)
+    const std::vector<Network::Address::InstanceConstSharedPtr>& resolvers,
+    DnsCacheSharedPtr cache)
     : dispatcher_(dispatcher),
-      timer_(dispatcher.createTimer([this] { onEventCallback(ARES_SOCKET_BAD, 0); })) {
+      timer_(dispatcher.createTimer([this] { onEventCallback(ARES_SOCKET_BAD, 0); })),
+      cache_(cache) {
   // This is also done in main(), to satisfy the requirement that c-ares is
   // initialized prior to threading. The additional call to ares_library_init()
   // here is a nop in normal execution, but exists for testing where we don't
   // launch via main().
-  ares_library_init(ARES_LIB_INIT_ALL);
+  {
+    std::unique_lock<std::mutex> lock(ares_library_lock);
+    ares_library_init(ARES_LIB_INIT_ALL);
+  }
   ares_options options;
 
   initializeChannel(&options, 0);
@@ -45,8 +183,21 @@ DnsResolverImpl::DnsResolverImpl(
 }
 
 DnsResolverImpl::~DnsResolverImpl() {
+  // Resolvers on other threads may wait for the resolutions this resolver performs, so they are
+  // completed as failed. No local callbacks are invoked.
+  for (auto& pending : pending_resolutions_) {
+    if (pending.second->follower_) {
+      pending.second->follower_->cancelled_ = true;
+      cache_->leave(pending.first, pending.second->follower_);
+    } else {
+      cache_->complete(pending.first, {}, Optional<std::chrono::seconds>(),
+                       time_source_->currentTime());
+    }
+  }
+
   timer_->disableTimer();
   ares_destroy(channel_);
+  std::unique_lock<std::mutex> lock(ares_library_lock);
   ares_library_cleanup();
 }
 
@@ -58,61 +209,6 @@ void DnsResolverImpl::initializeChannel(ares_options* options, int optmask) {
   ares_init_options(&channel_, options, optmask | ARES_OPT_SOCK_STATE_CB);
 }
 
-void DnsResolverImpl::PendingResolution::onAresHostCallback(int status, hostent* hostent) {
-  // We receive ARES_EDESTRUCTION when destructing with pending queries.
-  if (status == ARES_EDESTRUCTION) {
-    ASSERT(owned_);
-    delete this;
-    return;
-  }
-  if (status == ARES_SUCCESS || !fallback_if_failed_) {
-    completed_ = true;
-  }
-
-  std::list<Address::InstanceConstSharedPtr> address_list;
-  if (status == ARES_SUCCESS) {
-    if (hostent->h_addrtype == AF_INET) {
-      for (int i = 0; hostent->h_addr_list[i] != nullptr; ++i) {
-        ASSERT(hostent->h_length == sizeof(in_addr));
-        sockaddr_in address;
-        memset(&address, 0, sizeof(address));
-        address.sin_family = AF_INET;
-        address.sin_port = 0;
-        address.sin_addr = *reinterpret_cast<in_addr*>(hostent->h_addr_list[i]);
-        address_list.emplace_back(new Address::Ipv4Instance(&address));
-      }
-    } else if (hostent->h_addrtype == AF_INET6) {
-      for (int i = 0; hostent->h_addr_list[i] != nullptr; ++i) {
-        ASSERT(hostent->h_length == sizeof(in6_addr));
-        sockaddr_in6 address;
-        memset(&address, 0, sizeof(address));
-        address.sin6_family = AF_INET6;
-        address.sin6_port = 0;
-        address.sin6_addr = *reinterpret_cast<in6_addr*>(hostent->h_addr_list[i]);
-        address_list.emplace_back(new Address::Ipv6Instance(address));
-      }
-    }
-  }
-
-  if (completed_) {
-    if (!cancelled_) {
-      callback_(std::move(address_list));
-    }
-    if (owned_) {
-      delete this;
-      return;
-    }
-  }
-
-  if (status != ARES_SUCCESS && fallback_if_failed_) {
-    fallback_if_failed_ = false;
-    getHostByName(AF_INET);
-    // Note: Nothing can follow this call to getHostByName due to deletion of this
-    // object upon synchronous resolution.
-    return;
-  }
-}
-
 void DnsResolverImpl::updateAresTimer() {
   // Update the timeout for events.
   timeval timeout;
@@ -155,38 +251,215 @@ void DnsResolverImpl::onAresSocketStateChange(int fd, int read, int write) {
 
 ActiveDnsQuery* DnsResolverImpl::resolve(const std::string& dns_name,
                                          DnsLookupFamily dns_lookup_family, ResolveCb callback) {
-  // TODO(hennna): Add DNS caching which will allow testing the edge case of a
-  // failed intial call to getHostbyName followed by a synchronous IPv4
-  // resolution.
-  std::unique_ptr<PendingResolution> pending_resolution(
-      new PendingResolution(callback, channel_, dns_name));
-  if (dns_lookup_family == DnsLookupFamily::Auto) {
-    pending_resolution->fallback_if_failed_ = true;
+  const CacheKey key(dns_name, dns_lookup_family);
+  DnsCacheImpl::Entry entry;
+  if (cache_->find(key, entry)) {
+    const MonotonicTime now = time_source_->currentTime();
+    if (now < entry.expiry_time_) {
+      callback(std::move(entry.address_list_));
+      return nullptr;
+    }
+
+    if (!entry.address_list_.empty() && now < entry.expiry_time_ + MaxStaleTime) {
+      // Serve the expired addresses and refresh them in the background. A refresh that fails
+      // with anything but the non existence of the name leaves the entry in place.
+      startResolution(key, nullptr);
+      callback(std::move(entry.address_list_));
+      return nullptr;
+    }
   }
 
-  if (dns_lookup_family == DnsLookupFamily::V4Only) {
-    pending_resolution->getHostByName(AF_INET);
-  } else {
-    pending_resolution->getHostByName(AF_INET6);
+  return startResolution(key, callback);
+}
+
+ActiveDnsQuery* DnsResolverImpl::startResolution(const CacheKey& key, ResolveCb callback) {
+  auto existing = pending_resolutions_.find(key);
+  if (existing != pending_resolutions_.end()) {
+    if (!callback) {
+      return nullptr;
+    }
+
+    existing->second->waiters_.emplace_back(new Waiter(callback));
+    return existing->second->waiters_.back().get();
   }
 
-  if (pending_resolution->completed_) {
-    // Resolution does not need asynchronous behavior or network events. For
-    // example, localhost lookup.
+  // A resolver on another thread that shares the cache may already be resolving the name. A
+  // background refresh then has nothing left to do.
+  DnsCacheImpl::FollowerSharedPtr follower;
+  if (callback) {
+    follower.reset(new DnsCacheImpl::Follower(
+        dispatcher_,
+        [this, key](std::list<Address::InstanceConstSharedPtr>&& address_list) -> void {
+          auto it = pending_resolutions_.find(key);
+          ASSERT(it != pending_resolutions_.end());
+          onResolutionComplete(*it->second, std::move(address_list),
+                               Optional<std::chrono::seconds>());
+        }));
+  }
+  const bool resolve_locally = cache_->join(key, follower);
+  if (!resolve_locally && !callback) {
     return nullptr;
+  }
+
+  PendingResolution* pending = new PendingResolution(*this, key);
+  pending_resolutions_.emplace(key, PendingResolutionPtr{pending});
+  Waiter* waiter = nullptr;
+  if (callback) {
+    pending->waiters_.emplace_back(new Waiter(callback));
+    waiter = pending->waiters_.back().get();
+  }
+
+  if (!resolve_locally) {
+    pending->follower_ = follower;
+    return waiter;
+  }
+
+  if (key.second == DnsLookupFamily::Auto) {
+    pending->fallback_if_failed_ = true;
+  }
+
+  if (key.second == DnsLookupFamily::V4Only) {
+    pending->startQuery(AF_INET);
   } else {
-    // The PendingResolution will self-delete when the request completes
-    // (including if cancelled or if ~DnsResolverImpl() happens).
-    pending_resolution->owned_ = true;
-    return pending_resolution.release();
+    pending->startQuery(AF_INET6);
+  }
+
+  // Resolution does not need asynchronous behavior or network events when it is served from the
+  // hosts file or is an IP literal, for example a localhost lookup. The callback has then already
+  // been invoked.
+  auto it = pending_resolutions_.find(key);
+  if (it == pending_resolutions_.end() || it->second.get() != pending) {
+    return nullptr;
+  }
+
+  return waiter;
+}
+
+void DnsResolverImpl::onResolutionComplete(
+    PendingResolution& pending, std::list<Address::InstanceConstSharedPtr>&& address_list,
+    Optional<std::chrono::seconds> cache_ttl) {
+  // The resolver that performed the resolution caches the result for everybody.
+  if (!pending.follower_) {
+    cache_->complete(pending.key_, address_list, cache_ttl, time_source_->currentTime());
+  }
+
+  // Take ownership so that a callback that resolves the same name starts a new resolution.
+  auto it = pending_resolutions_.find(pending.key_);
+  ASSERT(it != pending_resolutions_.end() && it->second.get() == &pending);
+  PendingResolutionPtr owned = std::move(it->second);
+  pending_resolutions_.erase(it);
+
+  for (const WaiterPtr& waiter : owned->waiters_) {
+    if (!waiter->cancelled_) {
+      std::list<Address::InstanceConstSharedPtr> waiter_address_list = address_list;
+      waiter->callback_(std::move(waiter_address_list));
+    }
+  }
+}
+
+void DnsResolverImpl::PendingResolution::startQuery(int family) {
+  family_ = family;
+  const std::string& dns_name = key_.first;
+
+  // This mirrors the "fb" lookup order of ares_gethostbyname(): the hosts file first and then
+  // DNS. Local results are cheap to produce again so they are not cached.
+  std::list<Address::InstanceConstSharedPtr> address_list;
+  hostent* hostent;
+  if (ares_gethostbyname_file(parent_.channel_, dns_name.c_str(), family, &hostent) ==
+      ARES_SUCCESS) {
+    address_list = addressListFromHostent(*hostent);
+    ares_free_hostent(hostent);
+    parent_.onResolutionComplete(*this, std::move(address_list), Optional<std::chrono::seconds>());
+    return;
+  }
+
+  if (parseIpLiteral(dns_name, family, address_list)) {
+    parent_.onResolutionComplete(*this, std::move(address_list), Optional<std::chrono::seconds>());
+    return;
+  }
+
+  // ares_search() rather than ares_gethostbyname() since only the raw reply carries the TTLs.
+  ares_search(parent_.channel_, dns_name.c_str(), ns_c_in, family == AF_INET ? ns_t_a : ns_t_aaaa,
+              [](void* arg, int status, int, unsigned char* abuf, int alen) {
+                static_cast<PendingResolution*>(arg)->onAresSearchCallback(status, abuf, alen);
+              }, this);
+}
+
+void DnsResolverImpl::PendingResolution::onAresSearchCallback(int status, unsigned char* abuf,
+                                                              int alen) {
+  // We receive ARES_EDESTRUCTION when destructing with pending queries. The resolver still owns
+  // this resolution and frees it.
+  if (status == ARES_EDESTRUCTION) {
+    return;
+  }
+
+  std::list<Address::InstanceConstSharedPtr> address_list;
+  Optional<std::chrono::seconds> cache_ttl;
+  if (status == ARES_SUCCESS) {
+    hostent* hostent = nullptr;
+    int ttl = std::numeric_limits<int>::max();
+    int naddrttls = MaxAddrTtls;
+    if (family_ == AF_INET) {
+      ares_addrttl addrttls[MaxAddrTtls];
+      status = ares_parse_a_reply(abuf, alen, &hostent, addrttls, &naddrttls);
+      for (int i = 0; status == ARES_SUCCESS && i < naddrttls; ++i) {
+        ttl = std::min(ttl, addrttls[i].ttl);
+      }
+    } else {
+      ares_addr6ttl addrttls[MaxAddrTtls];
+      status = ares_parse_aaaa_reply(abuf, alen, &hostent, addrttls, &naddrttls);
+      for (int i = 0; status == ARES_SUCCESS && i < naddrttls; ++i) {
+        ttl = std::min(ttl, addrttls[i].ttl);
+      }
+    }
+
+    if (status == ARES_SUCCESS) {
+      address_list = addressListFromHostent(*hostent);
+      cache_ttl.value(std::chrono::seconds(naddrttls > 0 ? std::max(ttl, 0) : 0));
+    }
+    if (hostent != nullptr) {
+      ares_free_hostent(hostent);
+    }
+  }
+
+  if (status != ARES_SUCCESS) {
+    if (fallback_if_failed_) {
+      fallback_if_failed_ = false;
+      startQuery(AF_INET);
+      // Note: Nothing can follow this call to startQuery due to deletion of this
+      // object upon synchronous resolution.
+      return;
+    }
+
+    // Only the non existence of the name is cached. Other failures, such as timeouts, are retried
+    // on the next resolution.
+    if (status == ARES_ENOTFOUND || status == ARES_ENODATA) {
+      cache_ttl.value(NegativeCacheTtl);
+    }
   }
+
+  parent_.onResolutionComplete(*this, std::move(address_list), cache_ttl);
+  // Note: this object has been deleted.
+}
+
+ThreadLocalDnsResolverImpl::ThreadLocalDnsResolverImpl(
+    ThreadLocal::Instance& tls,
+    const std::vector<Network::Address::InstanceConstSharedPtr>& resolvers)
+    : tls_(tls), tls_slot_(tls.allocateSlot()) {
+  DnsCacheSharedPtr cache(new DnsCacheImpl());
+  tls_.set(tls_slot_,
+           [resolvers, cache](Event::Dispatcher& dispatcher)
+               -> ThreadLocal::ThreadLocalObjectSharedPtr {
+                 return ThreadLocal::ThreadLocalObjectSharedPtr{
+                     new ThreadLocalResolver(dispatcher, resolvers, cache)};
+               });
 }
 
-void DnsResolverImpl::PendingResolution::getHostByName(int family) {
-  ares_gethostbyname(channel_, dns_name_.c_str(),
-                     family, [](void* arg, int status, int, hostent* hostent) {
-                       static_cast<PendingResolution*>(arg)->onAresHostCallback(status, hostent);
-                     }, this);
+ActiveDnsQuery* ThreadLocalDnsResolverImpl::resolve(const std::string& dns_name,
+                                                    DnsLookupFamily dns_lookup_family,
+                                                    ResolveCb callback) {
+  DnsResolverImpl& resolver = tls_.getTyped<ThreadLocalResolver>(tls_slot_).resolver_;
+  return resolver.resolve(dns_name, dns_lookup_family, callback);
 }
 
 } // Network
@@ -2,15 +2,24 @@
 
 #include <netdb.h>
 
+#include <chrono>
 #include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "envoy/common/optional.h"
+#include "envoy/common/time.h"
 #include "envoy/event/dispatcher.h"
 #include "envoy/event/file_event.h"
 #include "envoy/network/dns.h"
+#include "envoy/thread_local/thread_local.h"
 
-#include "common/common/linked_object.h"
 #include "common/common/utility.h"
 
 #include "ares.h"
@@ -20,61 +29,170 @@ namespace Network {
 
 class DnsResolverImplPeer;
 
+/**
+ * Cache of DNS results that can be shared by resolvers running on different threads. Lookups copy
+ * the entry out of an immutable snapshot of the cache, so they never wait for a writer, which
+ * instead copies the snapshot and swaps it in. Names are inserted far less often than they are
+ * looked up.
+ *
+ * The cache also coalesces resolutions across resolvers: the first resolver to miss a name
+ * resolves it, and every other resolver that misses it in the meantime is handed the result on
+ * its own dispatcher.
+ */
+class DnsCacheImpl {
+public:
+  typedef std::pair<std::string, DnsLookupFamily> Key;
+
+  struct Entry {
+    std::list<Address::InstanceConstSharedPtr> address_list_;
+    MonotonicTime expiry_time_;
+  };
+
+  /**
+   * A resolver waiting for the result of a resolution that another resolver performs.
+   */
+  struct Follower {
+    Follower(Event::Dispatcher& dispatcher, DnsResolver::ResolveCb callback)
+        : dispatcher_(dispatcher), callback_(callback) {}
+
+    // The dispatcher the callback is posted to.
+    Event::Dispatcher& dispatcher_;
+    const DnsResolver::ResolveCb callback_;
+    // Set when the waiting resolver goes away. Only accessed on the thread of dispatcher_.
+    bool cancelled_ = false;
+  };
+
+  typedef std::shared_ptr<Follower> FollowerSharedPtr;
+
+  DnsCacheImpl() : entries_(new EntryMap()) {}
+
+  /**
+   * Look up an entry, which may have expired.
+   * @param key supplies the DNS name and lookup family.
+   * @param entry is set to the entry if there is one.
+   * @return bool whether there is an entry for key.
+   */
+  bool find(const Key& key, Entry& entry) const;
+
+  /**
+   * Register interest in the resolution of a name.
+   * @param key supplies the DNS name and lookup family.
+   * @param follower supplies the callback to hand the result to if another resolver is already
+   *        resolving key. May be null if the caller has no use for the result.
+   * @return bool true if no resolver was resolving key and the caller must now resolve it and
+   *         call complete(). false if follower, if any, will be handed the result.
+   */
+  bool join(const Key& key, const FollowerSharedPtr& follower);
+
+  /**
+   * Stop waiting for the resolution of a name. Must be called on the thread of the follower's
+   * dispatcher before that dispatcher is destroyed.
+   */
+  void leave(const Key& key, const FollowerSharedPtr& follower);
+
+  /**
+   * Complete a resolution started by join(), cache its result and hand it to all followers.
+   * @param key supplies the DNS name and lookup family.
+   * @param address_list supplies the result.
+   * @param cache_ttl supplies how long the result may be cached for, if at all.
+   * @param now supplies the current time.
+   */
+  void complete(const Key& key, const std::list<Address::InstanceConstSharedPtr>& address_list,
+                Optional<std::chrono::seconds> cache_ttl, MonotonicTime now);
+
+private:
+  typedef std::map<Key, Entry> EntryMap;
+  typedef std::shared_ptr<const EntryMap> EntryMapConstSharedPtr;
+
+  // Only replaced while holding lock_, but read without it.
+  EntryMapConstSharedPtr entries_;
+  std::mutex lock_;
+  // Resolutions in flight and the followers waiting for them.
+  std::map<Key, std::list<FollowerSharedPtr>> resolutions_;
+};
+
+typedef std::shared_ptr<DnsCacheImpl> DnsCacheSharedPtr;
+
 /**
  * Implementation of DnsResolver that uses c-ares. All calls and callbacks are assumed to
  * happen on the thread that owns the creating dispatcher.
+ *
+ * Results are cached per DNS name and lookup family for the TTL of the returned records, and
+ * resolutions that fail because the name does not exist are cached for NegativeCacheTtl. Once a
+ * positive entry expires it is still served for up to MaxStaleTime while it is refreshed in the
+ * background. Concurrent resolutions of the same name and lookup family share one query, also
+ * across resolvers on other threads that share the cache.
  */
 class DnsResolverImpl : public DnsResolver {
 public:
   DnsResolverImpl(Event::Dispatcher& dispatcher,
-                  const std::vector<Network::Address::InstanceConstSharedPtr>& resolvers);
+                  const std::vector<Network::Address::InstanceConstSharedPtr>& resolvers,
+                  DnsCacheSharedPtr cache);
   ~DnsResolverImpl() override;
 
   // Network::DnsResolver
   ActiveDnsQuery* resolve(const std::string& dns_name, DnsLookupFamily dns_lookup_family,
                           ResolveCb callback) override;
 
+  // How long the non existence of a name is cached for.
+  static const std::chrono::seconds NegativeCacheTtl;
+  // How long an expired positive entry is served for while it is being refreshed.
+  static const std::chrono::seconds MaxStaleTime;
+
 private:
   friend class DnsResolverImplPeer;
-  struct PendingResolution : public ActiveDnsQuery {
-    // Network::ActiveDnsQuery
-    PendingResolution(ResolveCb callback, ares_channel channel, const std::string& dns_name)
-        : callback_(callback), channel_(channel), dns_name_(dns_name) {}
+  typedef DnsCacheImpl::Key CacheKey;
+
+  struct Waiter : public ActiveDnsQuery {
+    Waiter(ResolveCb callback) : callback_(callback) {}
 
+    // Network::ActiveDnsQuery
     void cancel() override {
-      // c-ares only supports channel-wide cancellation, so we just allow the
-      // network events to continue but don't invoke the callback on completion.
+      // c-ares only supports channel-wide cancellation, and other waiters may share the query, so
+      // we just allow the network events to continue but don't invoke the callback on completion.
       cancelled_ = true;
     }
 
+    // Caller supplied callback to invoke on query completion or error.
+    const ResolveCb callback_;
+    // Was the query cancelled via cancel()?
+    bool cancelled_ = false;
+  };
+
+  typedef std::unique_ptr<Waiter> WaiterPtr;
+
+  struct PendingResolution {
+    PendingResolution(DnsResolverImpl& parent, const CacheKey& key) : parent_(parent), key_(key) {}
+
     /**
-     * c-ares ares_gethostbyname() query callback.
-     * @param status return status of call to ares_gethostbyname.
-     * @param hostent structure that stores information about a given host.
+     * c-ares ares_search() query callback.
+     * @param status return status of call to ares_search.
+     * @param abuf the DNS response.
+     * @param alen the length of the DNS response.
      */
-    void onAresHostCallback(int status, hostent* hostent);
+    void onAresSearchCallback(int status, unsigned char* abuf, int alen);
     /**
-     * wrapper function of call to ares_gethostbyname.
+     * Resolve the name from the hosts file or as an IP literal if possible, and otherwise issue a
+     * query via ares_search().
      * @param family currently AF_INET and AF_INET6 are supported.
      */
-    void getHostByName(int family);
+    void startQuery(int family);
 
-    // Caller supplied callback to invoke on query completion or error.
-    const ResolveCb callback_;
-    // Does the object own itself? Resource reclamation occurs via self-deleting
-    // on query completion or error.
-    bool owned_ = false;
-    // Has the query completed? Only meaningful if !owned_;
-    bool completed_ = false;
-    // Was the query cancelled via cancel()?
-    bool cancelled_ = false;
+    DnsResolverImpl& parent_;
+    const CacheKey key_;
+    // Callers waiting for the result. Empty for a background refresh.
+    std::list<WaiterPtr> waiters_;
     // If dns_lookup_family is "fallback", fallback to v4 address if v6
     // resolution failed.
     bool fallback_if_failed_ = false;
-    const ares_channel channel_;
-    const std::string dns_name_;
+    // The family of the query in flight.
+    int family_ = AF_UNSPEC;
+    // Set if another resolver sharing the cache performs the resolution and hands over the result.
+    DnsCacheImpl::FollowerSharedPtr follower_;
   };
 
+  typedef std::unique_ptr<PendingResolution> PendingResolutionPtr;
+
   // Callback for events on sockets tracked in events_.
   void onEventCallback(int fd, uint32_t events);
   // c-ares callback when a socket state changes, indicating that libevent
@@ -84,11 +202,54 @@ private:
   void initializeChannel(ares_options* options, int optmask);
   // Update timer for c-ares timeouts.
   void updateAresTimer();
+  // Add callback, if any, to the resolution of key, starting the resolution unless one is already
+  // in flight. @return the handle of the callback if it has not been invoked yet.
+  ActiveDnsQuery* startResolution(const CacheKey& key, ResolveCb callback);
+  // Called exactly once for each resolution, possibly from within startResolution().
+  // @param cache_ttl supplies how long the result may be cached for, if at all.
+  void onResolutionComplete(PendingResolution& pending,
+                            std::list<Address::InstanceConstSharedPtr>&& address_list,
+                            Optional<std::chrono::seconds> cache_ttl);
 
   Event::Dispatcher& dispatcher_;
   Event::TimerPtr timer_;
   ares_channel channel_;
   std::unordered_map<int, Event::FileEventPtr> events_;
+  MonotonicTimeSource* time_source_{&ProdMonotonicTimeSource::instance_};
+  DnsCacheSharedPtr cache_;
+  std::map<CacheKey, PendingResolutionPtr> pending_resolutions_;
+};
+
+/**
+ * DnsResolver that can be used on the main thread and on every worker. Each thread resolves on its
+ * own DnsResolverImpl, so a lookup never hops to another thread, while all of them share one
+ * DnsCacheImpl so that a name is cached and resolved once for the whole process.
+ */
+class ThreadLocalDnsResolverImpl : public DnsResolver {
+public:
+  ThreadLocalDnsResolverImpl(
+      ThreadLocal::Instance& tls,
+      const std::vector<Network::Address::InstanceConstSharedPtr>& resolvers);
+
+  // Network::DnsResolver
+  ActiveDnsQuery* resolve(const std::string& dns_name, DnsLookupFamily dns_lookup_family,
+                          ResolveCb callback) override;
+
+private:
+  struct ThreadLocalResolver : public ThreadLocal::ThreadLocalObject {
+    ThreadLocalResolver(Event::Dispatcher& dispatcher,
+                        const std::vector<Network::Address::InstanceConstSharedPtr>& resolvers,
+                        DnsCacheSharedPtr cache)
+        : resolver_(dispatcher, resolvers, cache) {}
+
+    // ThreadLocal::ThreadLocalObject
+    void shutdown() override {}
+
+    DnsResolverImpl resolver_;
+  };
+
+  ThreadLocal::Instance& tls_;
+  const uint32_t tls_slot_;
 };
 
 } // Network
@@ -1,6 +1,6 @@
 #include "common/network/filter_manager_impl.h"
 
-#include <list>
+#include <vector>
 
 #include "envoy/network/connection.h"
 
@@ -11,6 +11,9 @@ namespace Network {
 
 void FilterManagerImpl::addWriteFilter(WriteFilterSharedPtr filter) {
   ASSERT(connection_.state() == Connection::State::Open);
+  if (downstream_filters_.empty()) {
+    downstream_filters_.reserve(ExpectedFilters);
+  }
   downstream_filters_.emplace_back(filter);
 }
 
@@ -21,9 +24,12 @@ void FilterManagerImpl::addFilter(FilterSharedPtr filter) {
 
 void FilterManagerImpl::addReadFilter(ReadFilterSharedPtr filter) {
   ASSERT(connection_.state() == Connection::State::Open);
-  ActiveReadFilterPtr new_filter(new ActiveReadFilter{*this, filter});
+  if (upstream_filters_.empty()) {
+    upstream_filters_.reserve(ExpectedFilters);
+  }
+  ActiveReadFilterPtr new_filter(new ActiveReadFilter{*this, filter, upstream_filters_.size()});
   filter->initializeReadFilterCallbacks(*new_filter);
-  new_filter->moveIntoListBack(std::move(new_filter), upstream_filters_);
+  upstream_filters_.emplace_back(std::move(new_filter));
 }
 
 void FilterManagerImpl::destroyFilters() {
@@ -40,17 +46,12 @@ bool FilterManagerImpl::initializeReadFilters() {
 }
 
 void FilterManagerImpl::onContinueReading(ActiveReadFilter* filter) {
-  std::list<ActiveReadFilterPtr>::iterator entry;
-  if (!filter) {
-    entry = upstream_filters_.begin();
-  } else {
-    entry = std::next(filter->entry());
-  }
-
-  for (; entry != upstream_filters_.end(); entry++) {
-    if (!(*entry)->initialized_) {
-      (*entry)->initialized_ = true;
-      FilterStatus status = (*entry)->filter_->onNewConnection();
+  // Filters may be added while iterating, so iterate by index and check the size every time.
+  for (size_t i = filter ? filter->index_ + 1 : 0; i < upstream_filters_.size(); i++) {
+    ActiveReadFilter& entry = *upstream_filters_[i];
+    if (!entry.initialized_) {
+      entry.initialized_ = true;
+      FilterStatus status = entry.filter_->onNewConnection();
       if (status == FilterStatus::StopIteration) {
         return;
       }
@@ -58,7 +59,7 @@ void FilterManagerImpl::onContinueReading(ActiveReadFilter* filter) {
 
     Buffer::Instance& read_buffer = buffer_source_.getReadBuffer();
     if (read_buffer.length() > 0) {
-      FilterStatus status = (*entry)->filter_->onData(read_buffer);
+      FilterStatus status = entry.filter_->onData(read_buffer);
       if (status == FilterStatus::StopIteration) {
         return;
       }
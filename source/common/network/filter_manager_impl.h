@@ -1,12 +1,10 @@
 #pragma once
 
-#include <list>
 #include <memory>
+#include <vector>
 
 #include "envoy/network/filter.h"
 
-#include "common/common/linked_object.h"
-
 namespace Envoy {
 namespace Network {
 
@@ -29,7 +27,9 @@ public:
 };
 
 /**
- * This is a filter manager for TCP (L4) filters. It is split out for ease of testing.
+ * This is a filter manager for TCP (L4) filters. It is split out for ease of testing. Filters are
+ * only ever appended, so they are kept in vectors and iterated by index. Most chains have one or
+ * two filters, which then take a single allocation per direction.
  */
 class FilterManagerImpl {
 public:
@@ -43,11 +43,13 @@ public:
   bool initializeReadFilters();
   void onRead();
   FilterStatus onWrite();
+  size_t numReadFilters() const { return upstream_filters_.size(); }
+  size_t numWriteFilters() const { return downstream_filters_.size(); }
 
 private:
-  struct ActiveReadFilter : public ReadFilterCallbacks, LinkedObject<ActiveReadFilter> {
-    ActiveReadFilter(FilterManagerImpl& parent, ReadFilterSharedPtr filter)
-        : parent_(parent), filter_(filter) {}
+  struct ActiveReadFilter : public ReadFilterCallbacks {
+    ActiveReadFilter(FilterManagerImpl& parent, ReadFilterSharedPtr filter, size_t index)
+        : parent_(parent), filter_(filter), index_(index) {}
 
     Connection& connection() override { return parent_.connection_; }
     void continueReading() override { parent_.onContinueReading(this); }
@@ -60,6 +62,8 @@ private:
 
     FilterManagerImpl& parent_;
     ReadFilterSharedPtr filter_;
+    // The position of the filter in upstream_filters_.
+    const size_t index_;
     bool initialized_{};
   };
 
@@ -67,11 +71,15 @@ private:
 
   void onContinueReading(ActiveReadFilter* filter);
 
+  // The number of filters to make room for when the first filter is added. Covers the common
+  // chains, such as tcp_proxy alone or ratelimit followed by tcp_proxy, with one allocation.
+  static const size_t ExpectedFilters = 2;
+
   Connection& connection_;
   BufferSource& buffer_source_;
   Upstream::HostDescriptionConstSharedPtr host_description_;
-  std::list<ActiveReadFilterPtr> upstream_filters_;
-  std::list<WriteFilterSharedPtr> downstream_filters_;
+  std::vector<ActiveReadFilterPtr> upstream_filters_;
+  std::vector<WriteFilterSharedPtr> downstream_filters_;
 };
 
 } // Network
@@ -0,0 +1,223 @@
+#include "common/network/lc_trie.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+
+#include "common/common/assert.h"
+
+namespace Envoy {
+namespace Network {
+
+namespace {
+
+// Maximum number of address bits a single node branches on. This bounds the size of the child
+// array of a node to 64K entries.
+const uint32_t MAX_BRANCH = 16;
+
+// Minimum fraction of a node's child slots that must be backed by a node of the binary trie.
+const double FILL_FACTOR = 0.5;
+
+// Layout of a packed node: the branch count in the upper bits and an index in the lower bits.
+const uint32_t INDEX_BITS = 27;
+const uint32_t INDEX_MASK = (1U << INDEX_BITS) - 1;
+
+/**
+ * @return count (1 to MAX_BRANCH) bits of key starting at bit position, most significant first.
+ */
+uint32_t extractBits(const std::array<uint8_t, 16>& key, uint32_t position, uint32_t count) {
+  const uint32_t first_byte = position / 8;
+  uint32_t window = 0;
+  for (uint32_t i = first_byte; i < first_byte + 4; i++) {
+    window = (window << 8) | (i < key.size() ? key[i] : 0);
+  }
+  return (window << (position % 8)) >> (32 - count);
+}
+
+/**
+ * Node of the uncompressed binary trie used while building the LC-trie.
+ */
+struct BinaryNode {
+  bool isLeaf() const { return !children_[0]; }
+
+  std::unique_ptr<BinaryNode> children_[2];
+  // Before leaf pushing, the tags of the prefixes that end at this node.
+  std::vector<std::string> tags_;
+  // After leaf pushing, the index in the tag lists of the tags of a leaf.
+  uint32_t tag_list_{};
+};
+
+class TrieBuilder {
+public:
+  TrieBuilder(std::vector<std::vector<std::string>>& tag_lists) : tag_lists_(tag_lists) {
+    for (uint32_t i = 0; i < tag_lists_.size(); i++) {
+      tag_list_indexes_[tag_lists_[i]] = i;
+    }
+  }
+
+  /**
+   * Push the tags of every node down to the leaves, completing the trie so that each internal
+   * node has two children. Sibling leaves with the same tags are merged into their parent.
+   */
+  void pushLeaves(BinaryNode& node, const std::vector<std::string>& inherited_tags) {
+    std::vector<std::string> tags = inherited_tags;
+    tags.insert(tags.end(), node.tags_.begin(), node.tags_.end());
+    std::sort(tags.begin(), tags.end());
+    tags.erase(std::unique(tags.begin(), tags.end()), tags.end());
+    node.tags_.clear();
+
+    if (node.isLeaf() && !node.children_[1]) {
+      node.tag_list_ = internTags(tags);
+      return;
+    }
+
+    for (std::unique_ptr<BinaryNode>& child : node.children_) {
+      if (!child) {
+        child.reset(new BinaryNode());
+      }
+      pushLeaves(*child, tags);
+    }
+
+    if (node.children_[0]->isLeaf() && node.children_[1]->isLeaf() &&
+        node.children_[0]->tag_list_ == node.children_[1]->tag_list_) {
+      node.tag_list_ = node.children_[0]->tag_list_;
+      node.children_[0].reset();
+      node.children_[1].reset();
+    }
+  }
+
+  /**
+   * Write the level compressed form of the subtree at node into nodes[index].
+   */
+  void compress(const BinaryNode& node, uint32_t index, std::vector<uint32_t>& nodes) {
+    if (node.isLeaf()) {
+      nodes[index] = node.tag_list_;
+      return;
+    }
+
+    // Branch on as many bits as keeps the child array at least FILL_FACTOR full of nodes that
+    // exist in the binary trie. One bit always qualifies since internal nodes have two children.
+    uint32_t branch = 1;
+    std::vector<const BinaryNode*> level{&node};
+    for (uint32_t bits = 1; bits <= MAX_BRANCH; bits++) {
+      std::vector<const BinaryNode*> next_level;
+      for (const BinaryNode* level_node : level) {
+        if (!level_node->isLeaf()) {
+          next_level.push_back(level_node->children_[0].get());
+          next_level.push_back(level_node->children_[1].get());
+        }
+      }
+
+      if (next_level.size() < FILL_FACTOR * (1U << bits)) {
+        break;
+      }
+      branch = bits;
+      level = std::move(next_level);
+    }
+
+    const uint32_t first_child = nodes.size();
+    RELEASE_ASSERT(first_child + (1U << branch) <= INDEX_MASK);
+    nodes.resize(first_child + (1U << branch));
+    nodes[index] = (branch << INDEX_BITS) | first_child;
+
+    // Slots that fall under a leaf shallower than the branch depth get a copy of that leaf.
+    for (uint32_t slot = 0; slot < (1U << branch); slot++) {
+      const BinaryNode* child = &node;
+      for (uint32_t bit = branch; bit > 0 && !child->isLeaf(); bit--) {
+        child = child->children_[(slot >> (bit - 1)) & 1].get();
+      }
+      compress(*child, first_child + slot, nodes);
+    }
+  }
+
+private:
+  uint32_t internTags(const std::vector<std::string>& tags) {
+    auto it = tag_list_indexes_.find(tags);
+    if (it != tag_list_indexes_.end()) {
+      return it->second;
+    }
+
+    RELEASE_ASSERT(tag_lists_.size() <= INDEX_MASK);
+    const uint32_t index = tag_lists_.size();
+    tag_lists_.push_back(tags);
+    tag_list_indexes_[tags] = index;
+    return index;
+  }
+
+  std::vector<std::vector<std::string>>& tag_lists_;
+  std::map<std::vector<std::string>, uint32_t> tag_list_indexes_;
+};
+
+} // namespace
+
+LcTrie::Prefix::Prefix(const std::string& tag, uint32_t ipv4_address, uint32_t length)
+    : tag_(tag), version_(Address::IpVersion::v4), address_{}, length_(length) {
+  ASSERT(length <= 32);
+  memcpy(address_.data(), &ipv4_address, sizeof(ipv4_address));
+}
+
+LcTrie::Prefix::Prefix(const std::string& tag, const std::array<uint8_t, 16>& ipv6_address,
+                       uint32_t length)
+    : tag_(tag), version_(Address::IpVersion::v6), address_(ipv6_address), length_(length) {
+  ASSERT(length <= 128);
+}
+
+LcTrie::LcTrie(const std::vector<Prefix>& prefixes)
+    : tag_lists_(1), ipv4_trie_(prefixes, Address::IpVersion::v4, tag_lists_),
+      ipv6_trie_(prefixes, Address::IpVersion::v6, tag_lists_) {}
+
+const std::vector<std::string>& LcTrie::getTags(const Address::Instance& address) const {
+  if (address.type() != Address::Type::Ip) {
+    return tag_lists_[0];
+  }
+
+  if (address.ip()->version() == Address::IpVersion::v4) {
+    Key key{};
+    const uint32_t ipv4_address = address.ip()->ipv4()->address();
+    memcpy(key.data(), &ipv4_address, sizeof(ipv4_address));
+    return tag_lists_[ipv4_trie_.lookup(key)];
+  } else {
+    return tag_lists_[ipv6_trie_.lookup(address.ip()->ipv6()->address())];
+  }
+}
+
+LcTrie::Trie::Trie(const std::vector<Prefix>& prefixes, Address::IpVersion version,
+                   std::vector<std::vector<std::string>>& tag_lists) {
+  BinaryNode root;
+  for (const Prefix& prefix : prefixes) {
+    if (prefix.version_ != version) {
+      continue;
+    }
+
+    BinaryNode* node = &root;
+    for (uint32_t i = 0; i < prefix.length_; i++) {
+      std::unique_ptr<BinaryNode>& child = node->children_[extractBits(prefix.address_, i, 1)];
+      if (!child) {
+        child.reset(new BinaryNode());
+      }
+      node = child.get();
+    }
+    node->tags_.push_back(prefix.tag_);
+  }
+
+  TrieBuilder builder(tag_lists);
+  builder.pushLeaves(root, {});
+  nodes_.resize(1);
+  builder.compress(root, 0, nodes_);
+}
+
+uint32_t LcTrie::Trie::lookup(const Key& key) const {
+  uint32_t node = nodes_[0];
+  uint32_t position = 0;
+  while (node >> INDEX_BITS) {
+    const uint32_t branch = node >> INDEX_BITS;
+    node = nodes_[(node & INDEX_MASK) + extractBits(key, position, branch)];
+    position += branch;
+  }
+
+  return node & INDEX_MASK;
+}
+
+} // Network
+} // Envoy
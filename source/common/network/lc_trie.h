@@ -0,0 +1,99 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "envoy/network/address.h"
+
+namespace Envoy {
+namespace Network {
+
+/**
+ * Level compressed trie (LC-trie) that maps IP addresses to the tags of every prefix that contains
+ * them. The trie is built once from a set of tagged IPv4 and IPv6 prefixes and is read only
+ * afterwards, so a single instance can be shared across worker threads.
+ *
+ * During construction the prefixes are inserted into a binary trie whose tags are then pushed
+ * down to the leaves, so that the leaves form a prefix free partition of the address space. The
+ * binary trie is then level compressed: each node branches on as many address bits as keeps at
+ * least FILL_FACTOR of its slots backed by a real node, and slots covered by a shorter leaf
+ * reference a copy of that leaf. A lookup therefore walks a handful of array entries and never
+ * needs to compare against the original prefixes.
+ *
+ * See "IP-address lookup using LC-tries" by S. Nilsson and G. Karlsson.
+ */
+class LcTrie {
+public:
+  /**
+   * A tagged prefix to insert into the trie.
+   */
+  struct Prefix {
+    /**
+     * @param tag supplies the tag to return for addresses within the prefix.
+     * @param ipv4_address supplies the IPv4 address of the prefix in network byte order. Bits
+     *        past length are ignored.
+     * @param length supplies the number of leading address bits that make up the prefix.
+     */
+    Prefix(const std::string& tag, uint32_t ipv4_address, uint32_t length);
+
+    /**
+     * @param tag supplies the tag to return for addresses within the prefix.
+     * @param ipv6_address supplies the IPv6 address of the prefix. Bits past length are ignored.
+     * @param length supplies the number of leading address bits that make up the prefix.
+     */
+    Prefix(const std::string& tag, const std::array<uint8_t, 16>& ipv6_address, uint32_t length);
+
+    std::string tag_;
+    Address::IpVersion version_;
+    // Address bytes in network byte order. Only the first 4 bytes are used for IPv4.
+    std::array<uint8_t, 16> address_;
+    uint32_t length_;
+  };
+
+  LcTrie(const std::vector<Prefix>& prefixes);
+
+  /**
+   * @param address supplies the address to look up.
+   * @return the sorted, de-duplicated tags of all prefixes containing the address. The list is
+   *         empty if no prefix contains the address or the address is not an IP address.
+   */
+  const std::vector<std::string>& getTags(const Address::Instance& address) const;
+
+  /**
+   * @return the number of entries in the compressed node arrays. Used for testing.
+   */
+  size_t size() const { return ipv4_trie_.size() + ipv6_trie_.size(); }
+
+private:
+  typedef std::array<uint8_t, 16> Key;
+
+  /**
+   * LC-trie for a single IP version. Nodes are packed into 32 bits: the upper bits hold the
+   * number of address bits the node branches on (0 for a leaf) and the lower bits hold the index
+   * of the first child, or the index of the leaf's tag list in tag_lists_.
+   */
+  class Trie {
+  public:
+    Trie(const std::vector<Prefix>& prefixes, Address::IpVersion version,
+         std::vector<std::vector<std::string>>& tag_lists);
+
+    /**
+     * @return the index in tag_lists_ of the tags for the key.
+     */
+    uint32_t lookup(const Key& key) const;
+    size_t size() const { return nodes_.size(); }
+
+  private:
+    std::vector<uint32_t> nodes_;
+  };
+
+  // Index 0 is always the empty tag list.
+  std::vector<std::vector<std::string>> tag_lists_;
+  Trie ipv4_trie_;
+  Trie ipv6_trie_;
+};
+
+} // Network
+} // Envoy
@@ -3,6 +3,10 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 
+#ifdef __linux__
+#include <linux/filter.h>
+#endif
+
 #include <string>
 
 #include "envoy/common/exception.h"
@@ -30,7 +34,8 @@ void ListenSocketImpl::doBind() {
   }
 }
 
-TcpListenSocket::TcpListenSocket(Address::InstanceConstSharedPtr address, bool bind_to_port) {
+TcpListenSocket::TcpListenSocket(Address::InstanceConstSharedPtr address, bool bind_to_port,
+                                 bool reuse_port) {
   local_address_ = address;
   fd_ = local_address_->socket(Address::SocketType::Stream);
   RELEASE_ASSERT(fd_ != -1);
@@ -39,6 +44,11 @@ TcpListenSocket::TcpListenSocket(Address::InstanceConstSharedPtr address, bool b
   int rc = setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
   RELEASE_ASSERT(rc != -1);
 
+  if (reuse_port) {
+    rc = setsockopt(fd_, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+    RELEASE_ASSERT(rc != -1);
+  }
+
   if (bind_to_port) {
     doBind();
   }
@@ -49,6 +59,28 @@ TcpListenSocket::TcpListenSocket(int fd, Address::InstanceConstSharedPtr address
   local_address_ = address;
 }
 
+void TcpListenSocket::steerReusePortByCpu(uint32_t group_size) {
+  ASSERT(group_size > 0);
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+  // A = current CPU; A %= group_size; return A. If the returned index does not refer to a socket
+  // in the group (e.g. while a hot restart parent still holds its sockets), the kernel falls back
+  // to the default flow hash.
+  struct sock_filter code[] = {
+      {BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)},
+      {BPF_ALU | BPF_MOD | BPF_K, 0, 0, group_size},
+      {BPF_RET | BPF_A, 0, 0, 0},
+  };
+  struct sock_fprog program = {sizeof(code) / sizeof(code[0]), code};
+  if (setsockopt(fd_, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program)) == -1) {
+    throw EnvoyException(fmt::format("cannot attach reuse port program to '{}': {}",
+                                     local_address_->asString(), strerror(errno)));
+  }
+#else
+  throw EnvoyException(fmt::format("cannot attach reuse port program to '{}': not supported",
+                                   local_address_->asString()));
+#endif
+}
+
 UdsListenSocket::UdsListenSocket(const std::string& uds_path) {
   remove(uds_path.c_str());
   local_address_.reset(new Address::PipeInstance(uds_path));
@@ -39,8 +39,22 @@ protected:
  */
 class TcpListenSocket : public ListenSocketImpl {
 public:
-  TcpListenSocket(Address::InstanceConstSharedPtr address, bool bind_to_port);
+  /**
+   * @param reuse_port supplies whether to set SO_REUSEPORT so that several sockets can listen on
+   *        the same address and have the kernel distribute new connections among them.
+   */
+  TcpListenSocket(Address::InstanceConstSharedPtr address, bool bind_to_port,
+                  bool reuse_port = false);
   TcpListenSocket(int fd, Address::InstanceConstSharedPtr address);
+
+  /**
+   * Attach a program to the SO_REUSEPORT group that this socket belongs to which hands each new
+   * connection to the socket at index (CPU that received the connection % group_size), where
+   * sockets are indexed in the order in which they started listening. Throws EnvoyException if
+   * the program cannot be attached.
+   * @param group_size supplies the number of sockets in the group.
+   */
+  void steerReusePortByCpu(uint32_t group_size);
 };
 
 typedef std::unique_ptr<TcpListenSocket> TcpListenSocketPtr;
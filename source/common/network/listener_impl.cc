@@ -1,11 +1,20 @@
 #include "common/network/listener_impl.h"
 
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
 #include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
 
 #include "envoy/common/exception.h"
 #include "envoy/network/connection_handler.h"
 
+#include "common/common/assert.h"
 #include "common/common/empty_string.h"
+#include "common/common/macros.h"
 #include "common/event/dispatcher_impl.h"
 #include "common/event/file_event_impl.h"
 #include "common/network/address_impl.h"
@@ -26,6 +35,16 @@ Address::InstanceConstSharedPtr ListenerImpl::getOriginalDst(int fd) {
 void ListenerImpl::listenCallback(evconnlistener*, evutil_socket_t fd, sockaddr* remote_addr,
                                   int remote_addr_len, void* arg) {
   ListenerImpl* listener = static_cast<ListenerImpl*>(arg);
+  ConnectionBalancer* balancer = listener->options_.connection_balancer_;
+  if (balancer && balancer->balance(*listener, fd, remote_addr, remote_addr_len)) {
+    return;
+  }
+
+  listener->onAccept(fd, remote_addr, remote_addr_len);
+}
+
+void ListenerImpl::onAccept(int fd, sockaddr* remote_addr, int remote_addr_len) {
+  ListenerImpl* listener = this;
 
   Address::InstanceConstSharedPtr final_local_address = listener->socket_.localAddress();
   if (listener->options_.use_original_dst_ && final_local_address->type() == Address::Type::Ip) {
@@ -47,6 +66,11 @@ void ListenerImpl::listenCallback(evconnlistener*, evutil_socket_t fd, sockaddr*
 
       if (new_listener != nullptr) {
         listener = new_listener;
+        // The accepted socket inherited the options of the listen socket it arrived on, not those
+        // of the listener that now handles it.
+        if (listener->options_.socket_options_) {
+          Utility::applySocketOptions(fd, *listener->options_.socket_options_);
+        }
       }
     }
   }
@@ -77,9 +101,17 @@ ListenerImpl::ListenerImpl(Network::ConnectionHandler& conn_handler,
                            ListenerCallbacks& cb, Stats::Scope& scope,
                            const Network::ListenerOptions& listener_options)
     : connection_handler_(conn_handler), dispatcher_(dispatcher), socket_(socket), cb_(cb),
-      proxy_protocol_(scope), options_(listener_options), listener_(nullptr) {
+      proxy_protocol_(scope), tls_inspector_(scope), options_(listener_options),
+      listener_(nullptr) {
 
   if (options_.bind_to_port_) {
+    // Accepted sockets inherit the options of the listen socket, so they are only set once here.
+    if (options_.socket_options_ &&
+        !applyListenSocketOptions(socket.fd(), *options_.socket_options_)) {
+      throw CreateListenerException(
+          fmt::format("cannot set socket options on: {}", socket.localAddress()->asString()));
+    }
+
     listener_.reset(
         evconnlistener_new(&dispatcher_.base(), listenCallback, this, 0, -1, socket.fd()));
 
@@ -89,9 +121,77 @@ ListenerImpl::ListenerImpl(Network::ConnectionHandler& conn_handler,
     }
 
     evconnlistener_set_error_cb(listener_.get(), errorCallback);
+
+    if (options_.connection_balancer_) {
+      wakeup_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      RELEASE_ASSERT(wakeup_fd_ != -1);
+      wakeup_event_ = dispatcher_.createFileEvent(
+          wakeup_fd_, [this](uint32_t) -> void { onPendingConnections(); },
+          Event::FileTriggerType::Level, Event::FileReadyType::Read);
+      options_.connection_balancer_->registerHandler(*this);
+    }
   }
 }
 
+ListenerImpl::~ListenerImpl() {
+  if (wakeup_fd_ != -1) {
+    // Once unregistered no other listener can post to us, so anything still queued can be closed.
+    options_.connection_balancer_->unregisterHandler(*this);
+    for (const auto& pending : pending_connections_.popAll()) {
+      ::close(pending->fd_);
+    }
+
+    wakeup_event_.reset();
+    ::close(wakeup_fd_);
+  }
+}
+
+uint64_t ListenerImpl::numConnections() {
+  return connection_handler_.numConnections() + num_pending_connections_;
+}
+
+void ListenerImpl::post(int fd, const sockaddr* remote_addr, int remote_addr_len) {
+  ASSERT(wakeup_fd_ != -1);
+  ASSERT(remote_addr_len <= static_cast<int>(sizeof(sockaddr_storage)));
+  std::unique_ptr<PendingConnection> pending(new PendingConnection());
+  pending->fd_ = fd;
+  memcpy(&pending->remote_addr_, remote_addr, remote_addr_len);
+  pending->remote_addr_len_ = remote_addr_len;
+
+  num_pending_connections_++;
+  if (pending_connections_.push(std::move(pending))) {
+    // Only the first connection queued since the last drain needs to wake up the dispatcher.
+    const uint64_t value = 1;
+    const ssize_t rc = ::write(wakeup_fd_, &value, sizeof(value));
+    RELEASE_ASSERT(rc == sizeof(value));
+  }
+}
+
+void ListenerImpl::onPendingConnections() {
+  // Reset the wakeup before draining, so that a post that finds the queue empty after the drain
+  // always results in another wakeup.
+  uint64_t value;
+  const ssize_t rc = ::read(wakeup_fd_, &value, sizeof(value));
+  UNREFERENCED_PARAMETER(rc);
+
+  for (const auto& pending : pending_connections_.popAll()) {
+    num_pending_connections_--;
+    onAccept(pending->fd_, reinterpret_cast<sockaddr*>(&pending->remote_addr_),
+             pending->remote_addr_len_);
+  }
+}
+
+bool ListenerImpl::applyListenSocketOptions(int fd, const SocketOptions& options) {
+  bool applied = Utility::applySocketOptions(fd, options);
+  if (options.tcp_fast_open_queue_length_.valid()) {
+    const int queue_length = options.tcp_fast_open_queue_length_.value();
+    if (setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN, &queue_length, sizeof(queue_length)) != 0) {
+      applied = false;
+    }
+  }
+  return applied;
+}
+
 void ListenerImpl::errorCallback(evconnlistener*, void*) {
   // We should never get an error callback. This can happen if we run out of FDs or memory. In those
   // cases just crash.
@@ -100,18 +200,39 @@ void ListenerImpl::errorCallback(evconnlistener*, void*) {
 
 void ListenerImpl::newConnection(int fd, Address::InstanceConstSharedPtr remote_address,
                                  Address::InstanceConstSharedPtr local_address) {
-  ConnectionPtr new_connection(new ConnectionImpl(dispatcher_, fd, remote_address, local_address));
+  if (options_.inspect_tls_client_hello_) {
+    tls_inspector_.newConnection(dispatcher_, fd, remote_address, local_address, *this);
+  } else {
+    createConnection(fd, remote_address, local_address, nullptr);
+  }
+}
+
+void ListenerImpl::createConnection(int fd, Address::InstanceConstSharedPtr remote_address,
+                                    Address::InstanceConstSharedPtr local_address,
+                                    const TlsClientHelloParser::ClientHello* hello) {
+  std::unique_ptr<ConnectionImpl> new_connection =
+      allocateConnection(fd, remote_address, local_address);
+  if (hello && hello->is_tls_) {
+    new_connection->setRequestedServerName(hello->server_name_);
+    new_connection->setRequestedApplicationProtocols(hello->application_protocols_);
+  }
   new_connection->setReadBufferLimit(options_.per_connection_buffer_limit_bytes_);
   cb_.onNewConnection(std::move(new_connection));
 }
 
-void SslListenerImpl::newConnection(int fd, Address::InstanceConstSharedPtr remote_address,
+std::unique_ptr<ConnectionImpl>
+ListenerImpl::allocateConnection(int fd, Address::InstanceConstSharedPtr remote_address,
+                                 Address::InstanceConstSharedPtr local_address) {
+  return std::unique_ptr<ConnectionImpl>(
+      new ConnectionImpl(dispatcher_, fd, remote_address, local_address));
+}
+
+std::unique_ptr<ConnectionImpl>
+SslListenerImpl::allocateConnection(int fd, Address::InstanceConstSharedPtr remote_address,
                                     Address::InstanceConstSharedPtr local_address) {
-  ConnectionPtr new_connection(new Ssl::ConnectionImpl(dispatcher_, fd, remote_address,
-                                                       local_address, ssl_ctx_,
-                                                       Ssl::ConnectionImpl::InitialState::Server));
-  new_connection->setReadBufferLimit(options_.per_connection_buffer_limit_bytes_);
-  cb_.onNewConnection(std::move(new_connection));
+  return std::unique_ptr<ConnectionImpl>(
+      new Ssl::ConnectionImpl(dispatcher_, fd, remote_address, local_address, ssl_ctx_,
+                              Ssl::ConnectionImpl::InitialState::Server));
 }
 
 } // Network
@@ -1,12 +1,22 @@
 #pragma once
 
+#include <sys/socket.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "envoy/event/file_event.h"
 #include "envoy/network/connection_handler.h"
 #include "envoy/network/listener.h"
 
+#include "common/common/mpsc_queue.h"
 #include "common/event/dispatcher_impl.h"
 #include "common/event/libevent.h"
+#include "common/network/connection_impl.h"
 #include "common/network/listen_socket_impl.h"
 #include "common/network/proxy_protocol.h"
+#include "common/network/tls_inspector.h"
 
 #include "event2/event.h"
 
@@ -14,13 +24,16 @@ namespace Envoy {
 namespace Network {
 
 /**
- * libevent implementation of Network::Listener.
+ * libevent implementation of Network::Listener. If the listener options supply a connection
+ * balancer, the listener takes part in balancing: accepted sockets that are handed to it by other
+ * listeners are queued on a lock free queue and picked up by the listener's own dispatcher.
  */
-class ListenerImpl : public Listener {
+class ListenerImpl : public Listener, public BalancedConnectionHandler {
 public:
   ListenerImpl(Network::ConnectionHandler& conn_handler, Event::DispatcherImpl& dispatcher,
                ListenSocket& socket, ListenerCallbacks& cb, Stats::Scope& scope,
                const ListenerOptions& listener_options);
+  ~ListenerImpl();
 
   /**
    * Accept/process a new connection.
@@ -31,27 +44,68 @@ public:
   virtual void newConnection(int fd, Address::InstanceConstSharedPtr remote_address,
                              Address::InstanceConstSharedPtr local_address);
 
+  /**
+   * Create the connection for an accepted socket once any inspection of it is done.
+   * @param fd supplies the new connection's fd.
+   * @param remote_address supplies the remote address for the new connection.
+   * @param local_address supplies the local address for the new connection.
+   * @param hello supplies the TLS ClientHello sent on the connection, or nullptr if it was not
+   *        inspected.
+   */
+  void createConnection(int fd, Address::InstanceConstSharedPtr remote_address,
+                        Address::InstanceConstSharedPtr local_address,
+                        const TlsClientHelloParser::ClientHello* hello);
+
   /**
    * @return the socket supplied to the listener at construction time
    */
   ListenSocket& socket() { return socket_; }
 
+  // Network::BalancedConnectionHandler
+  uint64_t numConnections() override;
+  void post(int fd, const sockaddr* remote_addr, int remote_addr_len) override;
+
 protected:
   virtual Address::InstanceConstSharedPtr getOriginalDst(int fd);
+  virtual std::unique_ptr<ConnectionImpl>
+  allocateConnection(int fd, Address::InstanceConstSharedPtr remote_address,
+                     Address::InstanceConstSharedPtr local_address);
 
   Network::ConnectionHandler& connection_handler_;
   Event::DispatcherImpl& dispatcher_;
   ListenSocket& socket_;
   ListenerCallbacks& cb_;
   ProxyProtocol proxy_protocol_;
+  TlsInspector tls_inspector_;
   const ListenerOptions options_;
 
 private:
+  /**
+   * An accepted socket that was handed to this listener by another listener.
+   */
+  struct PendingConnection {
+    int fd_;
+    sockaddr_storage remote_addr_;
+    int remote_addr_len_;
+    PendingConnection* next_;
+  };
+
+  /**
+   * Apply socket options to a listen socket, including the TCP Fast Open queue length.
+   * @return bool whether all of the options were applied.
+   */
+  static bool applyListenSocketOptions(int fd, const SocketOptions& options);
   static void errorCallback(evconnlistener* listener, void* context);
   static void listenCallback(evconnlistener*, evutil_socket_t fd, sockaddr* remote_addr,
                              int remote_addr_len, void* arg);
+  void onAccept(int fd, sockaddr* remote_addr, int remote_addr_len);
+  void onPendingConnections();
 
   Event::Libevent::ListenerPtr listener_;
+  MpscQueue<PendingConnection> pending_connections_;
+  std::atomic<uint64_t> num_pending_connections_{};
+  int wakeup_fd_{-1};
+  Event::FileEventPtr wakeup_event_;
 };
 
 class SslListenerImpl : public ListenerImpl {
@@ -62,8 +116,10 @@ public:
       : ListenerImpl(conn_handler, dispatcher, socket, cb, scope, listener_options),
         ssl_ctx_(ssl_ctx) {}
 
+protected:
   // ListenerImpl
-  void newConnection(int fd, Address::InstanceConstSharedPtr remote_address,
+  std::unique_ptr<ConnectionImpl>
+  allocateConnection(int fd, Address::InstanceConstSharedPtr remote_address,
                      Address::InstanceConstSharedPtr local_address) override;
 
 private:
@@ -2,7 +2,9 @@
 
 #include <unistd.h>
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <memory>
 #include <string>
 
@@ -20,6 +22,36 @@
 namespace Envoy {
 namespace Network {
 
+namespace {
+
+const char V1_SIGNATURE[] = "PROXY ";
+const size_t V1_SIGNATURE_LENGTH = sizeof(V1_SIGNATURE) - 1;
+const char V2_SIGNATURE[] = "\r\n\r\n\0\r\nQUIT\n";
+const size_t V2_SIGNATURE_LENGTH = sizeof(V2_SIGNATURE) - 1;
+
+const uint8_t V2_VERSION = 2;
+const uint8_t V2_COMMAND_LOCAL = 0;
+const uint8_t V2_COMMAND_PROXY = 1;
+const uint8_t V2_FAMILY_UNSPEC = 0;
+const uint8_t V2_FAMILY_INET = 1;
+const uint8_t V2_FAMILY_INET6 = 2;
+const uint8_t V2_FAMILY_UNIX = 3;
+const uint8_t V2_TRANSPORT_STREAM = 1;
+
+// The lengths of the source and destination addresses and ports of each address family.
+const size_t V2_INET_ADDRESSES_LENGTH = 12;
+const size_t V2_INET6_ADDRESSES_LENGTH = 36;
+const size_t V2_UNIX_ADDRESSES_LENGTH = 216;
+
+// The length of the type and length of a TLV.
+const size_t V2_TLV_HEADER_LENGTH = 3;
+
+} // namespace
+
+const size_t ProxyProtocolParser::MAX_V1_LENGTH;
+const size_t ProxyProtocolParser::V2_HEADER_LENGTH;
+const size_t ProxyProtocolParser::MAX_LENGTH;
+
 ProxyProtocol::ProxyProtocol(Stats::Scope& scope)
     : stats_{ALL_PROXY_PROTOCOL_STATS(POOL_COUNTER(scope))} {}
 
@@ -31,7 +63,7 @@ void ProxyProtocol::newConnection(Event::Dispatcher& dispatcher, int fd, Listene
 ProxyProtocol::ActiveConnection::ActiveConnection(ProxyProtocol& parent,
                                                   Event::Dispatcher& dispatcher, int fd,
                                                   ListenerImpl& listener)
-    : parent_(parent), fd_(fd), listener_(listener), search_index_(1) {
+    : parent_(parent), fd_(fd), listener_(listener) {
   file_event_ = dispatcher.createFileEvent(fd, [this](uint32_t events) {
     ASSERT(events == Event::FileReadyType::Read);
     UNREFERENCED_PARAMETER(events);
@@ -55,14 +87,76 @@ void ProxyProtocol::ActiveConnection::onRead() {
 }
 
 void ProxyProtocol::ActiveConnection::onReadWorker() {
-  std::string proxy_line;
-  if (!readLine(fd_, proxy_line)) {
+  // Peek at everything that has arrived so far. The header is only consumed once it is complete,
+  // so each read event parses it again from the start.
+  ssize_t nread = recv(fd_, buf_, sizeof(buf_), MSG_PEEK);
+  if (nread == -1 && errno == EAGAIN) {
     return;
+  } else if (nread < 1) {
+    throw EnvoyException("failed to read proxy protocol");
+  }
+
+  ProxyProtocolParser::Header header;
+  if (!ProxyProtocolParser::parse(buf_, nread, header)) {
+    return;
+  }
+
+  // Consume exactly the header, leaving whatever follows it for the connection.
+  nread = recv(fd_, buf_, header.length_, 0);
+  if (nread < 0 || static_cast<size_t>(nread) != header.length_) {
+    throw EnvoyException("failed to read proxy protocol");
+  }
+
+  ListenerImpl& listener = listener_;
+  int fd = fd_;
+  fd_ = -1;
+
+  removeFromList(parent_.connections_);
+
+  Address::InstanceConstSharedPtr remote_address = header.remote_address_;
+  if (!remote_address) {
+    remote_address = Address::peerAddressFromFd(fd);
+  }
+  listener.newConnection(fd, remote_address, listener.socket().localAddress());
+}
+
+void ProxyProtocol::ActiveConnection::close() {
+  ::close(fd_);
+  fd_ = -1;
+  removeFromList(parent_.connections_);
+}
+
+bool ProxyProtocolParser::parse(const char* data, size_t length, Header& header) {
+  // Both signatures are checked against however much of them has arrived, so that a connection
+  // that does not start with a header is rejected as soon as possible.
+  if (memcmp(data, V2_SIGNATURE, std::min(length, V2_SIGNATURE_LENGTH)) == 0) {
+    return parseV2(data, length, header);
+  } else if (memcmp(data, V1_SIGNATURE, std::min(length, V1_SIGNATURE_LENGTH)) == 0) {
+    return parseV1(data, length, header);
+  }
+
+  throw EnvoyException("failed to read proxy protocol");
+}
+
+bool ProxyProtocolParser::parseV1(const char* data, size_t length, Header& header) {
+  const char* end = nullptr;
+  for (size_t i = 1; i < std::min(length, MAX_V1_LENGTH); i++) {
+    if (data[i] == '\n' && data[i - 1] == '\r') {
+      end = data + i - 1;
+      break;
+    }
+  }
+
+  if (!end) {
+    if (length >= MAX_V1_LENGTH) {
+      throw EnvoyException("failed to read proxy protocol");
+    }
+    return false;
   }
 
   // Parse proxy protocol line with format: PROXY TCP4/TCP6 SOURCE_ADDRESS DESTINATION_ADDRESS
   // SOURCE_PORT DESTINATION_PORT.
-  const auto line_parts = StringUtil::split(proxy_line, " ", true);
+  const auto line_parts = StringUtil::split(std::string(data, end), " ", true);
 
   if (line_parts.size() != 6 || line_parts[0] != "PROXY") {
     throw EnvoyException("failed to read proxy protocol");
@@ -77,8 +171,7 @@ void ProxyProtocol::ActiveConnection::onReadWorker() {
     throw EnvoyException("failed to read proxy protocol");
   }
 
-  // Error check the source and destination fields. Currently the source port, destination address,
-  // and destination port fields are ignored. Remote address refers to the source address.
+  // Error check the source and destination fields. Remote address refers to the source address.
   Address::InstanceConstSharedPtr remote_address = Utility::parseInternetAddress(line_parts[2]);
   Address::InstanceConstSharedPtr destination_address =
       Utility::parseInternetAddress(line_parts[3]);
@@ -101,60 +194,110 @@ void ProxyProtocol::ActiveConnection::onReadWorker() {
   } catch (const std::out_of_range& ex) {
     throw EnvoyException(ex.what());
   }
-  UNREFERENCED_PARAMETER(remote_port);
-  UNREFERENCED_PARAMETER(destination_port);
 
-  ListenerImpl& listener = listener_;
-  int fd = fd_;
-  fd_ = -1;
+  header.length_ = end - data + 2;
+  header.remote_address_ = Utility::getAddressWithPort(*remote_address, remote_port);
+  header.destination_address_ = Utility::getAddressWithPort(*destination_address, destination_port);
+  return true;
+}
 
-  removeFromList(parent_.connections_);
+bool ProxyProtocolParser::parseV2(const char* data, size_t length, Header& header) {
+  if (length < V2_HEADER_LENGTH) {
+    return false;
+  }
 
-  // TODO(mattklein123): Parse the remote port instead of passing zero.
-  listener.newConnection(fd, remote_address, listener.socket().localAddress());
-}
+  const uint8_t version_command = data[12];
+  const uint8_t family_protocol = data[13];
+  const size_t header_length =
+      V2_HEADER_LENGTH + ((static_cast<uint8_t>(data[14]) << 8) | static_cast<uint8_t>(data[15]));
+  if ((version_command >> 4) != V2_VERSION || header_length > MAX_LENGTH) {
+    throw EnvoyException("failed to read proxy protocol");
+  }
 
-void ProxyProtocol::ActiveConnection::close() {
-  ::close(fd_);
-  fd_ = -1;
-  removeFromList(parent_.connections_);
-}
+  const uint8_t command = version_command & 0x0f;
+  if (command != V2_COMMAND_LOCAL && command != V2_COMMAND_PROXY) {
+    throw EnvoyException("failed to read proxy protocol");
+  }
+
+  if (length < header_length) {
+    return false;
+  }
+
+  const char* addresses = data + V2_HEADER_LENGTH;
+  const size_t addresses_length = header_length - V2_HEADER_LENGTH;
+  const uint8_t family = family_protocol >> 4;
+  size_t address_block_length;
+  switch (family) {
+  case V2_FAMILY_UNSPEC:
+    address_block_length = 0;
+    break;
+  case V2_FAMILY_INET:
+    address_block_length = V2_INET_ADDRESSES_LENGTH;
+    break;
+  case V2_FAMILY_INET6:
+    address_block_length = V2_INET6_ADDRESSES_LENGTH;
+    break;
+  case V2_FAMILY_UNIX:
+    address_block_length = V2_UNIX_ADDRESSES_LENGTH;
+    break;
+  default:
+    throw EnvoyException("failed to read proxy protocol");
+  }
 
-bool ProxyProtocol::ActiveConnection::readLine(int fd, std::string& s) {
-  while (buf_off_ < MAX_PROXY_PROTO_LEN) {
-    ssize_t nread = recv(fd, buf_ + buf_off_, MAX_PROXY_PROTO_LEN - buf_off_, MSG_PEEK);
+  if (addresses_length < address_block_length) {
+    throw EnvoyException("failed to read proxy protocol");
+  }
 
-    if (nread == -1 && errno == EAGAIN) {
-      return false;
-    } else if (nread < 1) {
+  // A LOCAL command carries no proxied connection, and the addresses of a family other than IPv4
+  // and IPv6 are skipped, so that in both cases the real addresses of the connection are used.
+  if (command == V2_COMMAND_PROXY && (family == V2_FAMILY_INET || family == V2_FAMILY_INET6)) {
+    if ((family_protocol & 0x0f) != V2_TRANSPORT_STREAM) {
       throw EnvoyException("failed to read proxy protocol");
     }
 
-    bool found = false;
-    // continue searching buf_ from where we left off
-    for (; search_index_ < buf_off_ + nread; search_index_++) {
-      if (buf_[search_index_] == '\n' && buf_[search_index_ - 1] == '\r') {
-        search_index_++;
-        found = true;
-        break;
-      }
+    if (family == V2_FAMILY_INET) {
+      sockaddr_in remote{}, destination{};
+      remote.sin_family = destination.sin_family = AF_INET;
+      memcpy(&remote.sin_addr, addresses, 4);
+      memcpy(&destination.sin_addr, addresses + 4, 4);
+      memcpy(&remote.sin_port, addresses + 8, 2);
+      memcpy(&destination.sin_port, addresses + 10, 2);
+      header.remote_address_ = std::make_shared<Address::Ipv4Instance>(&remote);
+      header.destination_address_ = std::make_shared<Address::Ipv4Instance>(&destination);
+    } else {
+      sockaddr_in6 remote{}, destination{};
+      remote.sin6_family = destination.sin6_family = AF_INET6;
+      memcpy(&remote.sin6_addr, addresses, 16);
+      memcpy(&destination.sin6_addr, addresses + 16, 16);
+      memcpy(&remote.sin6_port, addresses + 32, 2);
+      memcpy(&destination.sin6_port, addresses + 34, 2);
+      header.remote_address_ = std::make_shared<Address::Ipv6Instance>(remote);
+      header.destination_address_ = std::make_shared<Address::Ipv6Instance>(destination);
     }
+  }
 
-    nread = recv(fd, buf_ + buf_off_, search_index_ - buf_off_, 0);
+  parseV2Tlvs(addresses + address_block_length, addresses_length - address_block_length, header);
+  header.length_ = header_length;
+  return true;
+}
 
-    if (nread < 1) {
+void ProxyProtocolParser::parseV2Tlvs(const char* data, size_t length, Header& header) {
+  while (length > 0) {
+    if (length < V2_TLV_HEADER_LENGTH) {
       throw EnvoyException("failed to read proxy protocol");
     }
 
-    buf_off_ += nread;
-
-    if (found) {
-      s.assign(buf_, buf_off_);
-      return true;
+    const size_t value_length =
+        (static_cast<uint8_t>(data[1]) << 8) | static_cast<uint8_t>(data[2]);
+    if (length - V2_TLV_HEADER_LENGTH < value_length) {
+      throw EnvoyException("failed to read proxy protocol");
     }
-  }
 
-  throw EnvoyException("failed to read proxy protocol");
+    header.tlvs_.push_back(
+        {static_cast<uint8_t>(data[0]), data + V2_TLV_HEADER_LENGTH, value_length});
+    data += V2_TLV_HEADER_LENGTH + value_length;
+    length -= V2_TLV_HEADER_LENGTH + value_length;
+  }
 }
 
 } // Network
@@ -1,10 +1,13 @@
 #pragma once
 
+#include <cstdint>
 #include <list>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "envoy/event/dispatcher.h"
+#include "envoy/network/address.h"
 #include "envoy/stats/stats_macros.h"
 
 #include "common/common/linked_object.h"
@@ -30,8 +33,64 @@ struct ProxyProtocolStats {
 };
 
 /**
- * Implementation the PROXY Protocol V1
- * (http://www.haproxy.org/download/1.5/doc/proxy-protocol.txt)
+ * Parser for PROXY protocol V1 and V2 headers
+ * (http://www.haproxy.org/download/1.8/doc/proxy-protocol.txt). A header is parsed in place from
+ * the bytes received so far, so that a connection can peek at its socket and then consume exactly
+ * the header, leaving the data that follows it in the socket.
+ */
+class ProxyProtocolParser {
+public:
+  /**
+   * A V2 type-length-value vector. The value points into the parsed data.
+   */
+  struct Tlv {
+    uint8_t type_;
+    const char* value_;
+    size_t length_;
+  };
+
+  struct Header {
+    // The length of the whole header, i.e. the number of bytes to consume before the data of the
+    // proxied connection.
+    size_t length_{};
+    // The source and destination of the proxied connection. These are null for a V2 LOCAL
+    // command or an address family other than IPv4 and IPv6, in which case the real addresses of
+    // the connection should be used.
+    Address::InstanceConstSharedPtr remote_address_;
+    Address::InstanceConstSharedPtr destination_address_;
+    // The TLVs that follow the addresses of a V2 header.
+    std::vector<Tlv> tlvs_;
+  };
+
+  /**
+   * Parse a PROXY protocol header from the start of some data.
+   * @param data supplies the data received so far.
+   * @param length supplies the length of the data.
+   * @param header supplies the header to fill in. Any TLVs point into data.
+   * @return bool true if a complete header was parsed, false if more data is needed.
+   * throws EnvoyException if the data does not start with a valid header, or with a header that is
+   * longer than MAX_LENGTH.
+   */
+  static bool parse(const char* data, size_t length, Header& header);
+
+  // The longest V1 header, including the terminating '\r\n'.
+  static const size_t MAX_V1_LENGTH = 108;
+  // The length of the fixed part of a V2 header, before the addresses and TLVs.
+  static const size_t V2_HEADER_LENGTH = 16;
+  // The longest header that is accepted. This leaves room for a V2 header with a few hundred bytes
+  // of TLVs after the longest (unix) address block.
+  static const size_t MAX_LENGTH = 1024;
+
+private:
+  static bool parseV1(const char* data, size_t length, Header& header);
+  static bool parseV2(const char* data, size_t length, Header& header);
+  static void parseV2Tlvs(const char* data, size_t length, Header& header);
+};
+
+/**
+ * Implementation of the PROXY protocol for listeners. Each new connection peeks at its socket until
+ * a whole header has arrived, and then consumes exactly the header before being handed to the
+ * listener.
  */
 class ProxyProtocol {
 public:
@@ -42,17 +101,8 @@ public:
     ~ActiveConnection();
 
   private:
-    static const size_t MAX_PROXY_PROTO_LEN = 108;
-
     void onRead();
     void onReadWorker();
-
-    /**
-     * Helper function that attempts to read a line (delimited by '\r\n') from the socket.
-     * throws EnvoyException on any socket errors.
-     * @return bool true if a line should be read, false if more data is needed.
-     */
-    bool readLine(int fd, std::string& s);
     void close();
 
     ProxyProtocol& parent_;
@@ -60,14 +110,8 @@ public:
     ListenerImpl& listener_;
     Event::FileEventPtr file_event_;
 
-    // The offset in buf_ that has been fully read
-    size_t buf_off_{};
-
-    // The index in buf_ where the search for '\r\n' should continue from
-    size_t search_index_;
-
-    // Stores the portion of the first line that has been read so far.
-    char buf_[MAX_PROXY_PROTO_LEN];
+    // Receives the data peeked from the socket, and then the header as it is consumed.
+    char buf_[ProxyProtocolParser::MAX_LENGTH];
   };
 
   ProxyProtocol(Stats::Scope& scope);
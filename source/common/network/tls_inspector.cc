@@ -0,0 +1,279 @@
+#include "common/network/tls_inspector.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/file_event.h"
+#include "envoy/stats/stats.h"
+
+#include "common/common/assert.h"
+#include "common/common/macros.h"
+#include "common/network/listener_impl.h"
+
+namespace Envoy {
+namespace Network {
+
+namespace {
+
+const uint8_t CONTENT_TYPE_HANDSHAKE = 22;
+const uint8_t TLS_MAJOR_VERSION = 3;
+const uint8_t HANDSHAKE_TYPE_CLIENT_HELLO = 1;
+const size_t HANDSHAKE_HEADER_LENGTH = 4;
+const uint16_t EXTENSION_SERVER_NAME = 0;
+const uint16_t EXTENSION_APPLICATION_LAYER_PROTOCOL_NEGOTIATION = 16;
+const uint8_t SERVER_NAME_TYPE_HOST_NAME = 0;
+
+/**
+ * Bounds checked reader of the big endian, length prefixed fields of TLS messages. Reads past the
+ * end fail and leave the reader failed, so that a message can be read field by field and checked
+ * once at the end.
+ */
+class Reader {
+public:
+  Reader(const uint8_t* data, size_t length) : data_(data), end_(data + length) {}
+
+  bool ok() const { return ok_; }
+  bool empty() const { return data_ == end_; }
+
+  uint32_t readInt(size_t bytes) {
+    if (!have(bytes)) {
+      return 0;
+    }
+    uint32_t value = 0;
+    for (size_t i = 0; i < bytes; i++) {
+      value = (value << 8) | data_[i];
+    }
+    data_ += bytes;
+    return value;
+  }
+
+  /**
+   * Read a field that is prefixed by its length.
+   * @param length_bytes supplies the size of the length prefix.
+   */
+  Reader readPrefixed(size_t length_bytes) {
+    const uint32_t length = readInt(length_bytes);
+    if (!have(length)) {
+      return Reader(nullptr, 0, false);
+    }
+    Reader field(data_, length);
+    data_ += length;
+    return field;
+  }
+
+  std::string readString(size_t length_bytes) {
+    Reader field = readPrefixed(length_bytes);
+    return std::string(reinterpret_cast<const char*>(field.data_), field.end_ - field.data_);
+  }
+
+  void skip(size_t bytes) {
+    if (have(bytes)) {
+      data_ += bytes;
+    }
+  }
+
+private:
+  Reader(const uint8_t* data, size_t length, bool ok) : data_(data), end_(data + length), ok_(ok) {}
+
+  bool have(size_t bytes) {
+    if (!ok_ || static_cast<size_t>(end_ - data_) < bytes) {
+      ok_ = false;
+      data_ = end_;
+      return false;
+    }
+    return true;
+  }
+
+  const uint8_t* data_;
+  const uint8_t* end_;
+  bool ok_{true};
+};
+
+bool parseExtension(uint16_t type, Reader& extension, TlsClientHelloParser::ClientHello& hello) {
+  if (type == EXTENSION_SERVER_NAME) {
+    Reader names = extension.readPrefixed(2);
+    while (names.ok() && !names.empty()) {
+      const uint8_t name_type = names.readInt(1);
+      std::string name = names.readString(2);
+      if (name_type == SERVER_NAME_TYPE_HOST_NAME && hello.server_name_.empty()) {
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        hello.server_name_ = std::move(name);
+      }
+    }
+    return names.ok();
+  } else if (type == EXTENSION_APPLICATION_LAYER_PROTOCOL_NEGOTIATION) {
+    Reader protocols = extension.readPrefixed(2);
+    while (protocols.ok() && !protocols.empty()) {
+      hello.application_protocols_.push_back(protocols.readString(1));
+    }
+    return protocols.ok();
+  }
+
+  return true;
+}
+
+bool parseClientHello(const uint8_t* data, size_t length,
+                      TlsClientHelloParser::ClientHello& hello) {
+  Reader reader(data, length);
+  reader.skip(2);         // client_version
+  reader.skip(32);        // random
+  reader.readPrefixed(1); // session_id
+  reader.readPrefixed(2); // cipher_suites
+  reader.readPrefixed(1); // compression_methods
+  if (!reader.ok()) {
+    return false;
+  }
+
+  // Extensions are optional.
+  if (reader.empty()) {
+    return true;
+  }
+
+  Reader extensions = reader.readPrefixed(2);
+  while (extensions.ok() && !extensions.empty()) {
+    const uint16_t type = extensions.readInt(2);
+    Reader extension = extensions.readPrefixed(2);
+    if (!extensions.ok()) {
+      return false;
+    }
+    if (!parseExtension(type, extension, hello)) {
+      return false;
+    }
+  }
+
+  return extensions.ok();
+}
+
+} // namespace
+
+const size_t TlsClientHelloParser::RECORD_HEADER_LENGTH;
+const size_t TlsClientHelloParser::MAX_LENGTH;
+const std::chrono::milliseconds TlsInspector::TIMEOUT(15000);
+
+bool TlsClientHelloParser::parse(const uint8_t* data, size_t length, ClientHello& hello) {
+  hello = ClientHello();
+
+  // Reject data that is not a TLS handshake record as soon as the first bytes show it.
+  if ((length >= 1 && data[0] != CONTENT_TYPE_HANDSHAKE) ||
+      (length >= 2 && data[1] != TLS_MAJOR_VERSION) ||
+      (length >= RECORD_HEADER_LENGTH + 1 && data[RECORD_HEADER_LENGTH] !=
+                                                  HANDSHAKE_TYPE_CLIENT_HELLO)) {
+    return true;
+  }
+
+  if (length < RECORD_HEADER_LENGTH + HANDSHAKE_HEADER_LENGTH) {
+    return false;
+  }
+
+  const size_t record_length = (data[3] << 8) | data[4];
+  const size_t hello_length = (data[6] << 16) | (data[7] << 8) | data[8];
+  if (record_length > MAX_LENGTH - RECORD_HEADER_LENGTH ||
+      HANDSHAKE_HEADER_LENGTH + hello_length > record_length) {
+    // Either not TLS, or a ClientHello that spans several records, which is not inspected.
+    hello.is_tls_ = record_length <= MAX_LENGTH - RECORD_HEADER_LENGTH;
+    return true;
+  }
+
+  const size_t total_length = RECORD_HEADER_LENGTH + HANDSHAKE_HEADER_LENGTH + hello_length;
+  if (length < total_length) {
+    return false;
+  }
+
+  if (!parseClientHello(data + RECORD_HEADER_LENGTH + HANDSHAKE_HEADER_LENGTH, hello_length,
+                        hello)) {
+    hello = ClientHello();
+    return true;
+  }
+
+  hello.is_tls_ = true;
+  return true;
+}
+
+TlsInspector::TlsInspector(Stats::Scope& scope)
+    : stats_{ALL_TLS_INSPECTOR_STATS(POOL_COUNTER(scope))} {}
+
+void TlsInspector::newConnection(Event::Dispatcher& dispatcher, int fd,
+                                 Address::InstanceConstSharedPtr remote_address,
+                                 Address::InstanceConstSharedPtr local_address,
+                                 ListenerImpl& listener) {
+  std::unique_ptr<ActiveConnection> p{
+      new ActiveConnection(*this, dispatcher, fd, remote_address, local_address, listener)};
+  p->moveIntoList(std::move(p), connections_);
+}
+
+TlsInspector::ActiveConnection::ActiveConnection(TlsInspector& parent,
+                                                 Event::Dispatcher& dispatcher, int fd,
+                                                 Address::InstanceConstSharedPtr remote_address,
+                                                 Address::InstanceConstSharedPtr local_address,
+                                                 ListenerImpl& listener)
+    : parent_(parent), fd_(fd), remote_address_(remote_address), local_address_(local_address),
+      listener_(listener) {
+  file_event_ = dispatcher.createFileEvent(fd, [this](uint32_t events) {
+    ASSERT(events == Event::FileReadyType::Read);
+    UNREFERENCED_PARAMETER(events);
+    onRead();
+  }, Event::FileTriggerType::Edge, Event::FileReadyType::Read);
+  timer_ = dispatcher.createTimer([this]() -> void { onTimeout(); });
+  timer_->enableTimer(TIMEOUT);
+}
+
+TlsInspector::ActiveConnection::~ActiveConnection() {
+  if (fd_ != -1) {
+    ::close(fd_);
+  }
+}
+
+void TlsInspector::ActiveConnection::onRead() {
+  // Peek at everything that has arrived so far, and parse the ClientHello again from the start.
+  const ssize_t nread = recv(fd_, buf_, sizeof(buf_), MSG_PEEK);
+  if (nread == -1 && errno == EAGAIN) {
+    return;
+  } else if (nread < 1) {
+    close();
+    return;
+  }
+
+  TlsClientHelloParser::ClientHello hello;
+  if (TlsClientHelloParser::parse(buf_, nread, hello)) {
+    done(hello);
+  }
+}
+
+void TlsInspector::ActiveConnection::onTimeout() {
+  parent_.stats_.downstream_cx_tls_inspector_timeout_.inc();
+  done(TlsClientHelloParser::ClientHello());
+}
+
+void TlsInspector::ActiveConnection::done(const TlsClientHelloParser::ClientHello& hello) {
+  if (hello.is_tls_) {
+    parent_.stats_.downstream_cx_tls_inspector_tls_found_.inc();
+  } else {
+    parent_.stats_.downstream_cx_tls_inspector_tls_not_found_.inc();
+  }
+
+  ListenerImpl& listener = listener_;
+  const int fd = fd_;
+  fd_ = -1;
+  Address::InstanceConstSharedPtr remote_address = remote_address_;
+  Address::InstanceConstSharedPtr local_address = local_address_;
+
+  // The connection is destroyed here, so that its file event is gone before the listener creates
+  // a new one for the same fd.
+  removeFromList(parent_.connections_);
+  listener.createConnection(fd, remote_address, local_address, &hello);
+}
+
+void TlsInspector::ActiveConnection::close() {
+  ::close(fd_);
+  fd_ = -1;
+  removeFromList(parent_.connections_);
+}
+
+} // Network
+} // Envoy
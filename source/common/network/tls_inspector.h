@@ -0,0 +1,124 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
+#include "envoy/network/address.h"
+#include "envoy/stats/stats_macros.h"
+
+#include "common/common/linked_object.h"
+
+namespace Envoy {
+namespace Network {
+
+class ListenerImpl;
+
+/**
+ * All stats for the TLS inspector. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_TLS_INSPECTOR_STATS(COUNTER)                                                           \
+  COUNTER(downstream_cx_tls_inspector_tls_found)                                                   \
+  COUNTER(downstream_cx_tls_inspector_tls_not_found)                                               \
+  COUNTER(downstream_cx_tls_inspector_timeout)
+// clang-format on
+
+/**
+ * Definition of all stats for the TLS inspector. @see stats_macros.h
+ */
+struct TlsInspectorStats {
+  ALL_TLS_INSPECTOR_STATS(GENERATE_COUNTER_STRUCT)
+};
+
+/**
+ * Parser for the parts of a TLS ClientHello (https://tools.ietf.org/html/rfc5246#section-7.4.1.2)
+ * that are used to select a listener filter chain: the server name indication and the offered
+ * application protocols. Only a ClientHello that fits in the first TLS record is inspected, which
+ * is the case for all but pathological clients.
+ */
+class TlsClientHelloParser {
+public:
+  struct ClientHello {
+    // Whether the data starts with a TLS handshake record holding a well formed ClientHello. If
+    // false the other fields are empty.
+    bool is_tls_{};
+    // The host name of the server name extension, lower cased, or empty if there is none.
+    std::string server_name_;
+    // The protocols of the application layer protocol negotiation extension, in the client's
+    // order of preference.
+    std::vector<std::string> application_protocols_;
+  };
+
+  /**
+   * Parse a ClientHello from the start of some data.
+   * @param data supplies the data received so far.
+   * @param length supplies the length of the data.
+   * @param hello supplies the result to fill in.
+   * @return bool true if parsing is done, either because the whole ClientHello was parsed or
+   *         because the data is not a ClientHello, and false if more data is needed.
+   */
+  static bool parse(const uint8_t* data, size_t length, ClientHello& hello);
+
+  // The length of a TLS record header.
+  static const size_t RECORD_HEADER_LENGTH = 5;
+  // The longest TLS record, and so the most data that is ever peeked.
+  static const size_t MAX_LENGTH = RECORD_HEADER_LENGTH + 16384;
+};
+
+/**
+ * Peeks at the TLS ClientHello of new connections for listeners that select filter chains by
+ * server name or application protocol. Nothing is consumed from the socket, so the connection
+ * still sees the whole handshake, whether it terminates TLS or proxies it.
+ */
+class TlsInspector {
+public:
+  class ActiveConnection : public LinkedObject<ActiveConnection> {
+  public:
+    ActiveConnection(TlsInspector& parent, Event::Dispatcher& dispatcher, int fd,
+                     Address::InstanceConstSharedPtr remote_address,
+                     Address::InstanceConstSharedPtr local_address, ListenerImpl& listener);
+    ~ActiveConnection();
+
+  private:
+    void onRead();
+    void onTimeout();
+    void done(const TlsClientHelloParser::ClientHello& hello);
+    void close();
+
+    TlsInspector& parent_;
+    int fd_;
+    Address::InstanceConstSharedPtr remote_address_;
+    Address::InstanceConstSharedPtr local_address_;
+    ListenerImpl& listener_;
+    Event::FileEventPtr file_event_;
+    Event::TimerPtr timer_;
+    uint8_t buf_[TlsClientHelloParser::MAX_LENGTH];
+  };
+
+  TlsInspector(Stats::Scope& scope);
+
+  /**
+   * Start inspecting a new connection. Once the ClientHello has been parsed, or it is clear that
+   * the client is not sending one, the connection is created by the listener.
+   */
+  void newConnection(Event::Dispatcher& dispatcher, int fd,
+                     Address::InstanceConstSharedPtr remote_address,
+                     Address::InstanceConstSharedPtr local_address, ListenerImpl& listener);
+
+  // How long to wait for a ClientHello. Connections of protocols where the server speaks first
+  // are created without one once this expires.
+  static const std::chrono::milliseconds TIMEOUT;
+
+private:
+  TlsInspectorStats stats_;
+  std::list<std::unique_ptr<ActiveConnection>> connections_;
+};
+
+} // Network
+} // Envoy
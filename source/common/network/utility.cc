@@ -4,6 +4,7 @@
 #include <ifaddrs.h>
 #include <linux/netfilter_ipv4.h>
 #include <netinet/ip.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
 
 #include <cstdint>
@@ -22,10 +23,17 @@
 
 #include "spdlog/spdlog.h"
 
+// Added in Linux 4.11 and missing from older libc headers.
+#ifndef TCP_FASTOPEN_CONNECT
+#define TCP_FASTOPEN_CONNECT 30
+#endif
+
 namespace Envoy {
 namespace Network {
 
-IpList::IpList(const std::vector<std::string>& subnets) {
+IpList::IpList(const std::vector<std::string>& subnets)
+    : trie_(std::vector<LcTrie::Prefix>()) {
+  std::vector<LcTrie::Prefix> prefixes;
   for (const std::string& entry : subnets) {
     std::vector<std::string> parts = StringUtil::split(entry, '/');
     if (parts.size() != 2) {
@@ -62,7 +70,10 @@ IpList::IpList(const std::vector<std::string>& subnets) {
     }
 
     ipv4_list_.push_back(list_entry);
+    prefixes.emplace_back("", addr.s_addr, mask);
   }
+
+  trie_ = LcTrie(prefixes);
 }
 
 bool IpList::contains(const Address::Instance& address) const {
@@ -70,14 +81,14 @@ bool IpList::contains(const Address::Instance& address) const {
     return false;
   }
 
+  // TODO(mattklein123): IPv6 support
+  return !trie_.getTags(address).empty();
+}
+
+void IpList::forEachRange(std::function<void(uint32_t first, uint32_t last)> callback) const {
   for (const Ipv4Entry& entry : ipv4_list_) {
-    // TODO(mattklein123): IPv6 support
-    if ((ntohl(address.ip()->ipv4()->address()) & entry.ipv4_mask_) == entry.ipv4_address_) {
-      return true;
-    }
+    callback(entry.ipv4_address_, entry.ipv4_address_ | ~entry.ipv4_mask_);
   }
-
-  return false;
 }
 
 IpList::IpList(const Json::Object& config, const std::string& member_name)
@@ -363,5 +374,64 @@ bool Utility::portInRangeList(const Address::Instance& address, const std::list<
   return false;
 }
 
+SocketOptionsConstSharedPtr Utility::parseSocketOptions(const Json::Object& config) {
+  if (!config.hasObject("socket_options")) {
+    return nullptr;
+  }
+
+  const auto parse = [](const Json::Object& json, const std::string& name,
+                        Optional<uint32_t>& value) -> void {
+    if (json.hasObject(name)) {
+      value.value(json.getInteger(name));
+    }
+  };
+
+  Json::ObjectSharedPtr json = config.getObject("socket_options");
+  std::shared_ptr<SocketOptions> options(new SocketOptions());
+  if (json->hasObject("keepalive")) {
+    Json::ObjectSharedPtr keepalive = json->getObject("keepalive");
+    options->keepalive_ = true;
+    parse(*keepalive, "probes", options->keepalive_probes_);
+    parse(*keepalive, "time_s", options->keepalive_time_);
+    parse(*keepalive, "interval_s", options->keepalive_interval_);
+  }
+  parse(*json, "user_timeout_ms", options->user_timeout_ms_);
+  parse(*json, "send_buffer_bytes", options->send_buffer_bytes_);
+  parse(*json, "receive_buffer_bytes", options->receive_buffer_bytes_);
+  parse(*json, "notsent_lowat_bytes", options->notsent_lowat_bytes_);
+  options->tcp_fast_open_ = json->getBoolean("tcp_fast_open", false);
+  parse(*json, "tcp_fast_open_queue_length", options->tcp_fast_open_queue_length_);
+  return options;
+}
+
+bool Utility::applySocketOptions(int fd, const SocketOptions& options) {
+  bool applied = true;
+  const auto set = [fd, &applied](int level, int name, int value) -> void {
+    if (setsockopt(fd, level, name, &value, sizeof(value)) != 0) {
+      applied = false;
+    }
+  };
+  const auto setIfValid = [&set](int level, int name, const Optional<uint32_t>& value) -> void {
+    if (value.valid()) {
+      set(level, name, value.value());
+    }
+  };
+
+  if (options.keepalive_) {
+    set(SOL_SOCKET, SO_KEEPALIVE, 1);
+    setIfValid(IPPROTO_TCP, TCP_KEEPCNT, options.keepalive_probes_);
+    setIfValid(IPPROTO_TCP, TCP_KEEPIDLE, options.keepalive_time_);
+    setIfValid(IPPROTO_TCP, TCP_KEEPINTVL, options.keepalive_interval_);
+  }
+  setIfValid(IPPROTO_TCP, TCP_USER_TIMEOUT, options.user_timeout_ms_);
+  setIfValid(SOL_SOCKET, SO_SNDBUF, options.send_buffer_bytes_);
+  setIfValid(SOL_SOCKET, SO_RCVBUF, options.receive_buffer_bytes_);
+  setIfValid(IPPROTO_TCP, TCP_NOTSENT_LOWAT, options.notsent_lowat_bytes_);
+  if (options.tcp_fast_open_) {
+    set(IPPROTO_TCP, TCP_FASTOPEN_CONNECT, 1);
+  }
+  return applied;
+}
+
 } // Network
 } // Envoy
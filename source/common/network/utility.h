@@ -1,30 +1,41 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
 #include <list>
 #include <string>
 #include <vector>
 
 #include "envoy/json/json_object.h"
 #include "envoy/network/connection.h"
+#include "envoy/network/socket_options.h"
 #include "envoy/stats/stats.h"
 
+#include "common/network/lc_trie.h"
+
 namespace Envoy {
 namespace Network {
 
 /**
  * Utility class for keeping a list of IPV4 addresses and masks, and then determining whether an
- * IP address is in the address/mask list.
+ * IP address is in the address/mask list. Lookups go through an LC-trie built from the list so
+ * their cost does not grow linearly with the number of entries.
  */
 class IpList {
 public:
   IpList(const std::vector<std::string>& subnets);
   IpList(const Json::Object& config, const std::string& member_name);
-  IpList(){};
+  IpList() : trie_(std::vector<LcTrie::Prefix>()){};
 
   bool contains(const Address::Instance& address) const;
   bool empty() const { return ipv4_list_.empty(); }
 
+  /**
+   * Call a function with the first and last address of each range in the list. Addresses are
+   * IPv4 addresses in host byte order.
+   */
+  void forEachRange(std::function<void(uint32_t first, uint32_t last)> callback) const;
+
 private:
   struct Ipv4Entry {
     uint32_t ipv4_address_;
@@ -32,6 +43,7 @@ private:
   };
 
   std::vector<Ipv4Entry> ipv4_list_;
+  LcTrie trie_;
 };
 
 /**
@@ -42,6 +54,8 @@ public:
   PortRange(uint32_t min, uint32_t max) : min_(min), max_(max) {}
 
   bool contains(uint32_t port) const { return (port >= min_ && port <= max_); }
+  uint32_t min() const { return min_; }
+  uint32_t max() const { return max_; }
 
 private:
   const uint32_t min_;
@@ -181,6 +195,23 @@ public:
    */
   static bool portInRangeList(const Address::Instance& address, const std::list<PortRange>& list);
 
+  /**
+   * Parse the socket_options object of a cluster or listener configuration.
+   * @param config supplies the cluster or listener configuration.
+   * @return the socket options, or nullptr if the configuration has none.
+   */
+  static SocketOptionsConstSharedPtr parseSocketOptions(const Json::Object& config);
+
+  /**
+   * Apply socket options to a TCP socket. The TCP Fast Open queue length only applies to listen
+   * sockets and is left to the caller.
+   * @param fd supplies the socket.
+   * @param options supplies the options to apply.
+   * @return bool whether all of the options were applied. Options that fail, for instance because
+   *         the kernel does not support them, do not keep the remaining options from being applied.
+   */
+  static bool applySocketOptions(int fd, const SocketOptions& options);
+
 private:
   static void throwWithMalformedIp(const std::string& ip_address);
 };
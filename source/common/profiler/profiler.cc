@@ -1,10 +1,13 @@
 #include "common/profiler/profiler.h"
 
+#include <cstdint>
+#include <cstdlib>
 #include <string>
 
 #ifdef TCMALLOC
 
 #include "gperftools/heap-profiler.h"
+#include "gperftools/malloc_extension.h"
 #include "gperftools/profiler.h"
 
 namespace Envoy {
@@ -12,16 +15,27 @@ namespace Profiler {
 
 bool Cpu::profilerEnabled() { return ProfilingIsEnabledForAllThreads(); }
 
+bool Cpu::setSamplingFrequency(uint32_t frequency_hz) {
+  // gperftools reads the frequency from the environment when the profiler first starts.
+  return frequency_hz > 0 &&
+         setenv("CPUPROFILE_FREQUENCY", std::to_string(frequency_hz).c_str(), 1) == 0;
+}
+
 bool Cpu::startProfiler(const std::string& output_path) {
   return ProfilerStart(output_path.c_str());
 }
 
 void Cpu::stopProfiler() { ProfilerStop(); }
 
+bool Heap::heapSample(std::string& output) {
+  MallocExtension::instance()->GetHeapSample(&output);
+  return true;
+}
+
 void Heap::forceLink() {
   // Currently this is here to force the inclusion of the heap profiler during static linking.
   // Without this call the heap profiler will not be included and cannot be started via env
-  // variable. In the future we can add admin support.
+  // variable.
   HeapProfilerDump("");
 }
 
@@ -34,8 +48,10 @@ namespace Envoy {
 namespace Profiler {
 
 bool Cpu::profilerEnabled() { return false; }
+bool Cpu::setSamplingFrequency(uint32_t) { return false; }
 bool Cpu::startProfiler(const std::string&) { return false; }
 void Cpu::stopProfiler() {}
+bool Heap::heapSample(std::string&) { return false; }
 
 } // Profiler
 } // Envoy
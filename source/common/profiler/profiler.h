@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 
 namespace Envoy {
@@ -15,6 +16,13 @@ public:
    */
   static bool profilerEnabled();
 
+  /**
+   * Set the number of samples the profiler takes per second. This only has an effect if it is
+   * called before the profiler is started for the first time.
+   * @return bool whether the sampling frequency could be set.
+   */
+  static bool setSamplingFrequency(uint32_t frequency_hz);
+
   /**
    * Start the profiler and write to the specified path.
    * @return bool whether the call to start the profiler succeeded.
@@ -31,6 +39,15 @@ public:
  * Process wide heap profiling
  */
 class Heap {
+public:
+  /**
+   * Write the sampled heap allocations in pprof format. Allocations are only sampled if tcmalloc
+   * was started with TCMALLOC_SAMPLE_PARAMETER set in the environment.
+   * @param output supplies the string to write the profile to.
+   * @return bool whether a heap sample could be taken.
+   */
+  static bool heapSample(std::string& output);
+
 private:
   static void forceLink();
 };
@@ -0,0 +1,229 @@
+#include "common/ratelimit/local_ratelimit_impl.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "common/common/assert.h"
+#include "common/json/config_schemas.h"
+#include "common/ratelimit/ratelimit_impl.h"
+
+namespace Envoy {
+namespace RateLimit {
+
+namespace {
+
+// The fraction of each limit that is always spread evenly over all threads, so that a thread that
+// was idle during the last interval can still admit requests until the next rebalance.
+const double EvenShare = 0.1;
+
+} // namespace
+
+LocalRateLimiter::LocalRateLimiter(const Json::Object& config, ThreadLocal::Instance& tls,
+                                   Event::Dispatcher& dispatcher, Stats::Store& stats,
+                                   MonotonicTimeSource& time_source, uint32_t num_workers)
+    : Json::Validator(config, Json::Schema::LOCAL_RATE_LIMIT_SERVICE_SCHEMA), tls_(tls),
+      tls_slot_(tls.allocateSlot()), time_source_(time_source),
+      rebalance_interval_(config.getInteger("rebalance_interval_ms", 1000)),
+      stats_{ALL_LOCAL_RATE_LIMIT_STATS(POOL_COUNTER_PREFIX(stats, "ratelimit.local."))} {
+  for (const Json::ObjectSharedPtr& limit_json : config.getObjectArray("limits")) {
+    Descriptor descriptor;
+    for (const Json::ObjectSharedPtr& entry : limit_json->getObjectArray("descriptor")) {
+      descriptor.entries_.push_back({entry->getString("key"), entry->getString("value")});
+    }
+
+    const std::string key = limitKey(limit_json->getString("domain"), descriptor);
+    if (limit_index_.count(key) > 0) {
+      throw EnvoyException(fmt::format("local rate limit: duplicate limit in domain '{}'",
+                                       limit_json->getString("domain")));
+    }
+
+    const int64_t requests_per_second = limit_json->getInteger("requests_per_second");
+    limit_index_[key] = limits_.size();
+    limits_.push_back({static_cast<double>(requests_per_second),
+                       static_cast<double>(limit_json->getInteger("burst", requests_per_second))});
+  }
+
+  if (config.hasObject("hybrid")) {
+    remote_threshold_ = config.getObject("hybrid")->getInteger("threshold_percent", 10) / 100.0;
+  }
+
+  // Until the first rebalance every worker gets an equal share. The main thread also gets thread
+  // local data but does not normally serve requests, so it is not counted here. Its share shrinks
+  // at the first rebalance.
+  const double initial_share = 1.0 / std::max(1U, num_workers);
+  tls.set(tls_slot_,
+          [this, initial_share](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+            std::shared_ptr<ThreadLocalBuckets> local(new ThreadLocalBuckets());
+            MonotonicTime now = time_source_.currentTime();
+            for (const Limit& limit : limits_) {
+              local->buckets_.emplace_back(
+                  new Bucket(limit.burst_ * initial_share, initial_share, now));
+            }
+
+            std::unique_lock<std::mutex> lock(lock_);
+            thread_buckets_.push_back(local->buckets_);
+            return local;
+          });
+
+  rebalance_timer_ = dispatcher.createTimer([this]() -> void {
+    rebalance();
+    rebalance_timer_->enableTimer(rebalance_interval_);
+  });
+  rebalance_timer_->enableTimer(rebalance_interval_);
+}
+
+std::string LocalRateLimiter::limitKey(const std::string& domain, const Descriptor& descriptor) {
+  std::string key = domain;
+  for (const DescriptorEntry& entry : descriptor.entries_) {
+    key.push_back('\0');
+    key.append(entry.key_);
+    key.push_back('\0');
+    key.append(entry.value_);
+  }
+
+  return key;
+}
+
+int64_t LocalRateLimiter::findLimit(const std::string& domain, const Descriptor& descriptor) const {
+  auto it = limit_index_.find(limitKey(domain, descriptor));
+  return it == limit_index_.end() ? -1 : static_cast<int64_t>(it->second);
+}
+
+LocalRateLimiter::Bucket& LocalRateLimiter::bucket(uint64_t limit_index) {
+  Bucket& bucket = *tls_.getTyped<ThreadLocalBuckets>(tls_slot_).buckets_[limit_index];
+  const Limit& limit = limits_[limit_index];
+  const double share = bucket.share_;
+
+  MonotonicTime now = time_source_.currentTime();
+  const double elapsed_seconds =
+      std::chrono::duration_cast<std::chrono::duration<double>>(now - bucket.last_refill_).count();
+  bucket.tokens_ = std::min(limit.burst_ * share,
+                            bucket.tokens_ + elapsed_seconds * limit.requests_per_second_ * share);
+  bucket.last_refill_ = now;
+  return bucket;
+}
+
+void LocalRateLimiter::rebalance() {
+  std::unique_lock<std::mutex> lock(lock_);
+  if (thread_buckets_.empty()) {
+    return;
+  }
+
+  const double threads = thread_buckets_.size();
+  std::vector<uint64_t> demand(thread_buckets_.size());
+  for (uint64_t limit_index = 0; limit_index < limits_.size(); limit_index++) {
+    uint64_t total_demand = 0;
+    for (uint64_t thread = 0; thread < thread_buckets_.size(); thread++) {
+      demand[thread] = thread_buckets_[thread][limit_index]->demand_.exchange(0);
+      total_demand += demand[thread];
+    }
+
+    // Without traffic there is nothing to learn from, so the previous split is kept.
+    if (total_demand == 0) {
+      continue;
+    }
+
+    for (uint64_t thread = 0; thread < thread_buckets_.size(); thread++) {
+      thread_buckets_[thread][limit_index]->share_ =
+          EvenShare / threads + (1 - EvenShare) * demand[thread] / total_demand;
+    }
+  }
+}
+
+void LocalClientImpl::cancel() {
+  // Only calls to the remote service are asynchronous.
+  ASSERT(remote_ && callbacks_ != nullptr);
+  remote_->cancel();
+  callbacks_ = nullptr;
+}
+
+void LocalClientImpl::limit(RequestCallbacks& callbacks, const std::string& domain,
+                            const std::vector<Descriptor>& descriptors,
+                            const Tracing::TransportContext& context) {
+  ASSERT(callbacks_ == nullptr);
+  buckets_.clear();
+  bool unmatched = false;
+  bool near_exhaustion = false;
+  for (const Descriptor& descriptor : descriptors) {
+    int64_t limit_index = limiter_->findLimit(domain, descriptor);
+    if (limit_index < 0) {
+      unmatched = true;
+      continue;
+    }
+
+    LocalRateLimiter::Bucket& bucket = limiter_->bucket(limit_index);
+    bucket.demand_++;
+    near_exhaustion |=
+        bucket.tokens_ < limiter_->remoteThreshold() * limiter_->capacity(limit_index, bucket);
+    buckets_.push_back(&bucket);
+  }
+
+  // In hybrid mode anything that the local buckets cannot answer confidently goes to the remote
+  // service.
+  if (remote_ && (unmatched || near_exhaustion)) {
+    limiter_->stats().remote_check_.inc();
+    callbacks_ = &callbacks;
+    remote_->limit(*this, domain, descriptors, context);
+    return;
+  }
+
+  callbacks.complete(localDecision());
+}
+
+void LocalClientImpl::complete(LimitStatus status) {
+  ASSERT(callbacks_ != nullptr);
+  RequestCallbacks* callbacks = callbacks_;
+  callbacks_ = nullptr;
+
+  switch (status) {
+  case LimitStatus::OK:
+    // The request still uses up local tokens so that the local buckets stay accurate.
+    for (LocalRateLimiter::Bucket* bucket : buckets_) {
+      bucket->tokens_ = std::max(0.0, bucket->tokens_ - 1);
+    }
+    break;
+  case LimitStatus::OverLimit:
+    break;
+  case LimitStatus::Error:
+    status = localDecision();
+    break;
+  }
+
+  callbacks->complete(status);
+}
+
+LimitStatus LocalClientImpl::localDecision() {
+  for (LocalRateLimiter::Bucket* bucket : buckets_) {
+    if (bucket->tokens_ < 1) {
+      limiter_->stats().over_limit_.inc();
+      return LimitStatus::OverLimit;
+    }
+  }
+
+  for (LocalRateLimiter::Bucket* bucket : buckets_) {
+    bucket->tokens_ -= 1;
+  }
+
+  limiter_->stats().ok_.inc();
+  return LimitStatus::OK;
+}
+
+LocalFactoryImpl::LocalFactoryImpl(const Json::Object& config, Upstream::ClusterManager& cm,
+                                   ThreadLocal::Instance& tls, Event::Dispatcher& dispatcher,
+                                   Stats::Store& stats, MonotonicTimeSource& time_source,
+                                   uint32_t num_workers)
+    : limiter_(new LocalRateLimiter(config, tls, dispatcher, stats, time_source, num_workers)) {
+  if (config.hasObject("hybrid")) {
+    remote_factory_.reset(
+        new GrpcFactoryImpl(*config.getObject("hybrid"), cm, tls, stats, time_source));
+  }
+}
+
+ClientPtr LocalFactoryImpl::create(const Optional<std::chrono::milliseconds>& timeout) {
+  return ClientPtr{
+      new LocalClientImpl(limiter_, remote_factory_ ? remote_factory_->create(timeout) : nullptr)};
+}
+
+} // RateLimit
+} // Envoy
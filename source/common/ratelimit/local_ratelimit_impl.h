@@ -0,0 +1,176 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "envoy/common/time.h"
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
+#include "envoy/ratelimit/ratelimit.h"
+#include "envoy/stats/stats_macros.h"
+#include "envoy/thread_local/thread_local.h"
+#include "envoy/upstream/cluster_manager.h"
+
+#include "common/json/json_loader.h"
+#include "common/json/json_validator.h"
+
+namespace Envoy {
+namespace RateLimit {
+
+/**
+ * All stats for the local rate limit service. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_LOCAL_RATE_LIMIT_STATS(COUNTER)                                                        \
+  COUNTER(ok)                                                                                      \
+  COUNTER(over_limit)                                                                              \
+  COUNTER(remote_check)
+// clang-format on
+
+/**
+ * Struct definition for all local rate limit stats. @see stats_macros.h
+ */
+struct LocalRateLimitStats {
+  ALL_LOCAL_RATE_LIMIT_STATS(GENERATE_COUNTER_STRUCT)
+};
+
+/**
+ * Token buckets for the statically configured descriptors. Every thread has its own bucket per
+ * descriptor so that checking a limit never contends with other workers. Each thread's bucket is
+ * filled at a share of the configured rate. The shares are rebalanced on the main thread
+ * periodically, in proportion to how many requests each thread checked against the bucket in the
+ * previous interval, so the sum over all workers stays at the configured rate.
+ */
+class LocalRateLimiter : Json::Validator {
+public:
+  LocalRateLimiter(const Json::Object& config, ThreadLocal::Instance& tls,
+                   Event::Dispatcher& dispatcher, Stats::Store& stats,
+                   MonotonicTimeSource& time_source, uint32_t num_workers);
+
+  /**
+   * A token bucket owned by a single thread. Only the demand and share are read or written by the
+   * main thread during rebalancing.
+   */
+  struct Bucket {
+    Bucket(double tokens, double share, MonotonicTime now)
+        : tokens_(tokens), last_refill_(now), share_(share) {}
+
+    double tokens_;
+    MonotonicTime last_refill_;
+    std::atomic<uint64_t> demand_{};
+    std::atomic<double> share_;
+  };
+
+  /**
+   * @return the index of the limit configured for a descriptor, or -1 if the descriptor is not
+   *         configured. This is thread safe.
+   */
+  int64_t findLimit(const std::string& domain, const Descriptor& descriptor) const;
+
+  /**
+   * @return the calling thread's bucket for a limit, refilled up to the current time.
+   */
+  Bucket& bucket(uint64_t limit_index);
+
+  /**
+   * @return double the fraction of a bucket's capacity below which hybrid mode consults the remote
+   *         service.
+   */
+  double remoteThreshold() const { return remote_threshold_; }
+
+  /**
+   * @return double the maximum number of tokens that a bucket can currently hold.
+   */
+  double capacity(uint64_t limit_index, const Bucket& bucket) const {
+    return limits_[limit_index].burst_ * bucket.share_;
+  }
+
+  LocalRateLimitStats& stats() { return stats_; }
+
+  /**
+   * Recalculate every thread's share of each limit. Called periodically on the main thread.
+   */
+  void rebalance();
+
+private:
+  struct Limit {
+    double requests_per_second_;
+    double burst_;
+  };
+
+  struct ThreadLocalBuckets : public ThreadLocal::ThreadLocalObject {
+    // ThreadLocal::ThreadLocalObject
+    void shutdown() override {}
+
+    std::vector<std::shared_ptr<Bucket>> buckets_;
+  };
+
+  static std::string limitKey(const std::string& domain, const Descriptor& descriptor);
+
+  std::vector<Limit> limits_;
+  std::unordered_map<std::string, uint64_t> limit_index_;
+  ThreadLocal::Instance& tls_;
+  const uint32_t tls_slot_;
+  MonotonicTimeSource& time_source_;
+  const std::chrono::milliseconds rebalance_interval_;
+  double remote_threshold_{};
+  LocalRateLimitStats stats_;
+  Event::TimerPtr rebalance_timer_;
+  // Every thread's buckets, indexed by thread and then by limit. Guarded by lock_ because threads
+  // register themselves as their thread local data is created.
+  std::mutex lock_;
+  std::vector<std::vector<std::shared_ptr<Bucket>>> thread_buckets_;
+};
+
+typedef std::shared_ptr<LocalRateLimiter> LocalRateLimiterSharedPtr;
+
+/**
+ * Rate limit client that answers from the local token buckets. In hybrid mode requests that match
+ * no local limit, or that would leave a bucket close to empty, are sent to the remote service
+ * instead. If the remote service fails the local buckets decide.
+ */
+class LocalClientImpl : public Client, public RequestCallbacks {
+public:
+  LocalClientImpl(LocalRateLimiterSharedPtr limiter, ClientPtr&& remote)
+      : limiter_(limiter), remote_(std::move(remote)) {}
+
+  // RateLimit::Client
+  void cancel() override;
+  void limit(RequestCallbacks& callbacks, const std::string& domain,
+             const std::vector<Descriptor>& descriptors,
+             const Tracing::TransportContext& context) override;
+
+  // RateLimit::RequestCallbacks
+  void complete(LimitStatus status) override;
+
+private:
+  LimitStatus localDecision();
+
+  LocalRateLimiterSharedPtr limiter_;
+  ClientPtr remote_;
+  RequestCallbacks* callbacks_{};
+  std::vector<LocalRateLimiter::Bucket*> buckets_;
+};
+
+class LocalFactoryImpl : public ClientFactory {
+public:
+  LocalFactoryImpl(const Json::Object& config, Upstream::ClusterManager& cm,
+                   ThreadLocal::Instance& tls, Event::Dispatcher& dispatcher, Stats::Store& stats,
+                   MonotonicTimeSource& time_source, uint32_t num_workers);
+
+  // RateLimit::ClientFactory
+  ClientPtr create(const Optional<std::chrono::milliseconds>& timeout) override;
+
+private:
+  LocalRateLimiterSharedPtr limiter_;
+  ClientFactoryPtr remote_factory_;
+};
+
+} // RateLimit
+} // Envoy
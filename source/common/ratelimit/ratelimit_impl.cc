@@ -2,6 +2,8 @@
 
 #include <chrono>
 #include <cstdint>
+#include <iterator>
+#include <list>
 #include <string>
 #include <vector>
 
@@ -17,15 +19,30 @@
 namespace Envoy {
 namespace RateLimit {
 
+namespace {
+
+// Bounds the memory used by the over limit cache on each worker. Once it is full, new over limit
+// descriptors are not cached until expired ones have been removed.
+const uint64_t MaxOverLimitCacheEntries = 10000;
+
+} // namespace
+
 GrpcClientImpl::GrpcClientImpl(Grpc::RpcChannelFactory& factory,
-                               const Optional<std::chrono::milliseconds>& timeout)
-    : channel_(factory.create(*this, timeout)), service_(channel_.get()) {}
+                               const Optional<std::chrono::milliseconds>& timeout,
+                               RequestCoalescer* coalescer)
+    : channel_(factory.create(*this, timeout)), service_(channel_.get()), timeout_(timeout),
+      coalescer_(coalescer) {}
 
 GrpcClientImpl::~GrpcClientImpl() { ASSERT(!callbacks_); }
 
 void GrpcClientImpl::cancel() {
   ASSERT(callbacks_);
-  channel_->cancel();
+  if (coalesced_request_) {
+    coalesced_request_->remove(*this);
+    coalesced_request_ = nullptr;
+  } else {
+    channel_->cancel();
+  }
   callbacks_ = nullptr;
 }
 
@@ -47,11 +64,37 @@ void GrpcClientImpl::limit(RequestCallbacks& callbacks, const std::string& domai
                            const std::vector<Descriptor>& descriptors,
                            const Tracing::TransportContext& context) {
   ASSERT(!callbacks_);
+  pb::lyft::ratelimit::RateLimitRequest request;
+  createRequest(request, domain, descriptors);
+
+  if (coalescer_) {
+    if (coalescer_->overLimit(request)) {
+      callbacks.complete(LimitStatus::OverLimit);
+      return;
+    }
+
+    if (coalescer_->coalescing()) {
+      callbacks_ = &callbacks;
+      coalesced_request_ = &coalescer_->join(*this, request, context, timeout_);
+      return;
+    }
+  }
+
+  send(callbacks, request, context);
+}
+
+void GrpcClientImpl::send(RequestCallbacks& callbacks,
+                          const pb::lyft::ratelimit::RateLimitRequest& request,
+                          const Tracing::TransportContext& context) {
+  ASSERT(!callbacks_);
   callbacks_ = &callbacks;
   context_ = context;
 
-  pb::lyft::ratelimit::RateLimitRequest request;
-  createRequest(request, domain, descriptors);
+  // The request is only needed later to cache the descriptors that are over limit.
+  if (coalescer_) {
+    request_ = request;
+  }
+
   service_.ShouldRateLimit(nullptr, &request, &response_, nullptr);
 }
 
@@ -72,6 +115,10 @@ void GrpcClientImpl::onSuccess() {
     status = LimitStatus::OverLimit;
   }
 
+  if (coalescer_) {
+    coalescer_->onResponse(request_, response_);
+  }
+
   callbacks_->complete(status);
   callbacks_ = nullptr;
 }
@@ -81,20 +128,196 @@ void GrpcClientImpl::onFailure(const Optional<uint64_t>&, const std::string&) {
   callbacks_ = nullptr;
 }
 
-GrpcFactoryImpl::GrpcFactoryImpl(const Json::Object& config, Upstream::ClusterManager& cm)
-    : cluster_name_(config.getString("cluster_name")), cm_(cm) {
+void GrpcClientImpl::onCoalescedComplete(LimitStatus status) {
+  ASSERT(callbacks_ && coalesced_request_);
+  coalesced_request_ = nullptr;
+  RequestCallbacks* callbacks = callbacks_;
+  callbacks_ = nullptr;
+  callbacks->complete(status);
+}
+
+CoalescedRequest::CoalescedRequest(RequestCoalescer& parent, const std::string& key,
+                                   const pb::lyft::ratelimit::RateLimitRequest& request,
+                                   const Tracing::TransportContext& context,
+                                   const Optional<std::chrono::milliseconds>& timeout)
+    : parent_(parent), key_(key), request_(request), context_(context),
+      rpc_(parent.factory_, timeout, &parent) {
+  window_timer_ = parent.dispatcher_.createTimer([this]() -> void { parent_.onWindowEnd(*this); });
+  window_timer_->enableTimer(parent.window_);
+}
+
+void CoalescedRequest::remove(GrpcClientImpl& client) {
+  clients_.remove(&client);
+  // Once sent the request is left to complete so that its answer still fills the over limit cache.
+  if (clients_.empty() && !sent_) {
+    parent_.onAbandoned(*this);
+  }
+}
+
+void CoalescedRequest::send() {
+  ASSERT(!sent_ && !clients_.empty());
+  sent_ = true;
+  if (clients_.size() > 1) {
+    request_.set_hits_addend(clients_.size());
+  }
+
+  rpc_.send(*this, request_, context_);
+}
+
+void CoalescedRequest::cancel() {
+  if (sent_) {
+    rpc_.cancel();
+  }
+}
+
+void CoalescedRequest::complete(LimitStatus status) {
+  std::list<GrpcClientImpl*> clients = std::move(clients_);
+  clients_.clear();
+  for (GrpcClientImpl* client : clients) {
+    client->onCoalescedComplete(status);
+  }
+
+  parent_.onComplete(*this);
+}
+
+RequestCoalescer::RequestCoalescer(Grpc::RpcChannelFactory& factory, Event::Dispatcher& dispatcher,
+                                   std::chrono::milliseconds window,
+                                   MonotonicTimeSource& time_source, RateLimitClientStats& stats)
+    : factory_(factory), dispatcher_(dispatcher), window_(window), time_source_(time_source),
+      stats_(stats) {}
+
+std::string RequestCoalescer::descriptorKey(
+    const std::string& domain, const pb::lyft::ratelimit::RateLimitDescriptor& descriptor) {
+  std::string key = domain;
+  for (const pb::lyft::ratelimit::RateLimitDescriptor::Entry& entry : descriptor.entries()) {
+    key.push_back('\0');
+    key.append(entry.key());
+    key.push_back('\0');
+    key.append(entry.value());
+  }
+
+  return key;
+}
+
+bool RequestCoalescer::overLimit(const pb::lyft::ratelimit::RateLimitRequest& request) {
+  if (over_limit_until_.empty()) {
+    return false;
+  }
+
+  MonotonicTime now = time_source_.currentTime();
+  for (const pb::lyft::ratelimit::RateLimitDescriptor& descriptor : request.descriptors()) {
+    auto it = over_limit_until_.find(descriptorKey(request.domain(), descriptor));
+    if (it == over_limit_until_.end()) {
+      continue;
+    }
+
+    if (now < it->second) {
+      stats_.rq_over_limit_cached_.inc();
+      return true;
+    }
+
+    over_limit_until_.erase(it);
+  }
+
+  return false;
+}
+
+void RequestCoalescer::onResponse(const pb::lyft::ratelimit::RateLimitRequest& request,
+                                  const pb::lyft::ratelimit::RateLimitResponse& response) {
+  if (response.statuses_size() != request.descriptors_size()) {
+    return;
+  }
+
+  MonotonicTime now = time_source_.currentTime();
+  for (int i = 0; i < response.statuses_size(); i++) {
+    const pb::lyft::ratelimit::RateLimitResponse::DescriptorStatus& status = response.statuses(i);
+    if (status.code() != pb::lyft::ratelimit::RateLimitResponse_Code_OVER_LIMIT ||
+        status.duration_until_reset_ms() == 0) {
+      continue;
+    }
+
+    if (over_limit_until_.size() >= MaxOverLimitCacheEntries) {
+      for (auto it = over_limit_until_.begin(); it != over_limit_until_.end();) {
+        it = now < it->second ? std::next(it) : over_limit_until_.erase(it);
+      }
+
+      if (over_limit_until_.size() >= MaxOverLimitCacheEntries) {
+        return;
+      }
+    }
+
+    over_limit_until_[descriptorKey(request.domain(), request.descriptors(i))] =
+        now + std::chrono::milliseconds(status.duration_until_reset_ms());
+  }
+}
+
+CoalescedRequest& RequestCoalescer::join(GrpcClientImpl& client,
+                                         const pb::lyft::ratelimit::RateLimitRequest& request,
+                                         const Tracing::TransportContext& context,
+                                         const Optional<std::chrono::milliseconds>& timeout) {
+  const std::string key = request.SerializeAsString();
+  CoalescedRequestPtr& pending = pending_[key];
+  if (pending) {
+    stats_.rq_coalesced_.inc();
+  } else {
+    // The first request's tracing context and timeout are used for the shared RPC.
+    pending.reset(new CoalescedRequest(*this, key, request, context, timeout));
+  }
+
+  pending->add(client);
+  return *pending;
+}
+
+void RequestCoalescer::onWindowEnd(CoalescedRequest& request) {
+  auto it = pending_.find(request.key());
+  ASSERT(it != pending_.end());
+  in_flight_[&request] = std::move(it->second);
+  pending_.erase(it);
+  request.send();
+}
+
+void RequestCoalescer::onAbandoned(CoalescedRequest& request) { pending_.erase(request.key()); }
+
+void RequestCoalescer::onComplete(CoalescedRequest& request) {
+  auto it = in_flight_.find(&request);
+  ASSERT(it != in_flight_.end());
+  // The request is still on the stack of its own RPC callbacks.
+  dispatcher_.deferredDelete(std::move(it->second));
+  in_flight_.erase(it);
+}
+
+void RequestCoalescer::shutdown() {
+  for (auto& request : in_flight_) {
+    request.second->cancel();
+  }
+}
+
+GrpcFactoryImpl::GrpcFactoryImpl(const Json::Object& config, Upstream::ClusterManager& cm,
+                                 ThreadLocal::Instance& tls, Stats::Store& stats,
+                                 MonotonicTimeSource& time_source)
+    : cluster_name_(config.getString("cluster_name")), cm_(cm), tls_(tls),
+      tls_slot_(tls.allocateSlot()),
+      stats_{ALL_RATE_LIMIT_CLIENT_STATS(POOL_COUNTER_PREFIX(stats, "ratelimit.client."))} {
   if (!cm_.get(cluster_name_)) {
     throw EnvoyException(fmt::format("unknown rate limit service cluster '{}'", cluster_name_));
   }
+
+  const std::chrono::milliseconds window(config.getInteger("coalesce_window_ms", 0));
+  tls.set(tls_slot_, [this, window, &time_source](
+                         Event::Dispatcher& dispatcher) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+    return std::make_shared<RequestCoalescer>(*this, dispatcher, window, time_source, stats_);
+  });
 }
 
 ClientPtr GrpcFactoryImpl::create(const Optional<std::chrono::milliseconds>& timeout) {
-  return ClientPtr{new GrpcClientImpl(*this, timeout)};
+  return ClientPtr{
+      new GrpcClientImpl(*this, timeout, &tls_.getTyped<RequestCoalescer>(tls_slot_))};
 }
 
 Grpc::RpcChannelPtr GrpcFactoryImpl::create(Grpc::RpcChannelCallbacks& callbacks,
                                             const Optional<std::chrono::milliseconds>& timeout) {
-  return Grpc::RpcChannelPtr{new Grpc::RpcChannelImpl(cm_, cluster_name_, callbacks, timeout)};
+  return Grpc::RpcChannelPtr{
+      new Grpc::StreamingRpcChannelImpl(cm_, cluster_name_, callbacks, timeout)};
 }
 
 } // RateLimit
@@ -2,11 +2,20 @@
 
 #include <chrono>
 #include <cstdint>
+#include <list>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "envoy/common/time.h"
+#include "envoy/event/deferred_deletable.h"
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
 #include "envoy/grpc/rpc_channel.h"
 #include "envoy/ratelimit/ratelimit.h"
+#include "envoy/stats/stats_macros.h"
+#include "envoy/thread_local/thread_local.h"
 #include "envoy/tracing/context.h"
 #include "envoy/upstream/cluster_manager.h"
 
@@ -16,10 +25,30 @@
 namespace Envoy {
 namespace RateLimit {
 
+/**
+ * All stats for the gRPC rate limit client. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_RATE_LIMIT_CLIENT_STATS(COUNTER)                                                       \
+  COUNTER(rq_coalesced)                                                                            \
+  COUNTER(rq_over_limit_cached)
+// clang-format on
+
+/**
+ * Struct definition for all gRPC rate limit client stats. @see stats_macros.h
+ */
+struct RateLimitClientStats {
+  ALL_RATE_LIMIT_CLIENT_STATS(GENERATE_COUNTER_STRUCT)
+};
+
+class CoalescedRequest;
+class RequestCoalescer;
+
 class GrpcClientImpl : public Client, public Grpc::RpcChannelCallbacks {
 public:
   GrpcClientImpl(Grpc::RpcChannelFactory& factory,
-                 const Optional<std::chrono::milliseconds>& timeout);
+                 const Optional<std::chrono::milliseconds>& timeout,
+                 RequestCoalescer* coalescer = nullptr);
   ~GrpcClientImpl();
 
   static void createRequest(pb::lyft::ratelimit::RateLimitRequest& request,
@@ -36,17 +65,128 @@ public:
   void onSuccess() override;
   void onFailure(const Optional<uint64_t>& grpc_status, const std::string& message) override;
 
+  /**
+   * Send a request to the service directly, without checking the over limit cache or coalescing.
+   */
+  void send(RequestCallbacks& callbacks, const pb::lyft::ratelimit::RateLimitRequest& request,
+            const Tracing::TransportContext& context);
+
+  /**
+   * Called when the coalesced request that this client joined completes.
+   */
+  void onCoalescedComplete(LimitStatus status);
+
 private:
   Grpc::RpcChannelPtr channel_;
   pb::lyft::ratelimit::RateLimitService::Stub service_;
+  const Optional<std::chrono::milliseconds> timeout_;
+  RequestCoalescer* coalescer_;
+  CoalescedRequest* coalesced_request_{};
   RequestCallbacks* callbacks_{};
+  pb::lyft::ratelimit::RateLimitRequest request_;
   pb::lyft::ratelimit::RateLimitResponse response_;
   Tracing::TransportContext context_;
 };
 
+/**
+ * A rate limit request shared by identical requests made on one worker within the coalesce
+ * window. It is sent when the window ends, with a hits_addend that counts every client that joined,
+ * and its result is passed to every client that is still waiting.
+ */
+class CoalescedRequest : public RequestCallbacks, public Event::DeferredDeletable {
+public:
+  CoalescedRequest(RequestCoalescer& parent, const std::string& key,
+                   const pb::lyft::ratelimit::RateLimitRequest& request,
+                   const Tracing::TransportContext& context,
+                   const Optional<std::chrono::milliseconds>& timeout);
+
+  const std::string& key() const { return key_; }
+  void add(GrpcClientImpl& client) { clients_.push_back(&client); }
+  void remove(GrpcClientImpl& client);
+  void send();
+  void cancel();
+
+  // RateLimit::RequestCallbacks
+  void complete(LimitStatus status) override;
+
+private:
+  RequestCoalescer& parent_;
+  const std::string key_;
+  pb::lyft::ratelimit::RateLimitRequest request_;
+  const Tracing::TransportContext context_;
+  GrpcClientImpl rpc_;
+  Event::TimerPtr window_timer_;
+  std::list<GrpcClientImpl*> clients_;
+  bool sent_{};
+};
+
+typedef std::unique_ptr<CoalescedRequest> CoalescedRequestPtr;
+
+/**
+ * Per worker state shared by all of the gRPC clients that a factory creates. It remembers the
+ * descriptors that the service reported as over limit until their limit resets, and if a coalesce
+ * window is configured, turns identical requests made within the window into a single RPC.
+ */
+class RequestCoalescer : public ThreadLocal::ThreadLocalObject {
+public:
+  RequestCoalescer(Grpc::RpcChannelFactory& factory, Event::Dispatcher& dispatcher,
+                   std::chrono::milliseconds window, MonotonicTimeSource& time_source,
+                   RateLimitClientStats& stats);
+
+  /**
+   * @return whether any descriptor in a request is still over limit according to an earlier
+   *         response.
+   */
+  bool overLimit(const pb::lyft::ratelimit::RateLimitRequest& request);
+
+  /**
+   * Remember the descriptors of a request that the response says are over limit until a known
+   * reset time.
+   */
+  void onResponse(const pb::lyft::ratelimit::RateLimitRequest& request,
+                  const pb::lyft::ratelimit::RateLimitResponse& response);
+
+  /**
+   * @return whether requests should be coalesced.
+   */
+  bool coalescing() const { return window_.count() > 0; }
+
+  /**
+   * Add a client to the pending request that is identical to its own, creating one if needed.
+   * @return CoalescedRequest& the request that the client joined.
+   */
+  CoalescedRequest& join(GrpcClientImpl& client,
+                         const pb::lyft::ratelimit::RateLimitRequest& request,
+                         const Tracing::TransportContext& context,
+                         const Optional<std::chrono::milliseconds>& timeout);
+
+  // ThreadLocal::ThreadLocalObject
+  void shutdown() override;
+
+private:
+  friend class CoalescedRequest;
+
+  static std::string descriptorKey(const std::string& domain,
+                                   const pb::lyft::ratelimit::RateLimitDescriptor& descriptor);
+  void onWindowEnd(CoalescedRequest& request);
+  void onAbandoned(CoalescedRequest& request);
+  void onComplete(CoalescedRequest& request);
+
+  Grpc::RpcChannelFactory& factory_;
+  Event::Dispatcher& dispatcher_;
+  const std::chrono::milliseconds window_;
+  MonotonicTimeSource& time_source_;
+  RateLimitClientStats& stats_;
+  std::unordered_map<std::string, MonotonicTime> over_limit_until_;
+  std::unordered_map<std::string, CoalescedRequestPtr> pending_;
+  std::unordered_map<CoalescedRequest*, CoalescedRequestPtr> in_flight_;
+};
+
 class GrpcFactoryImpl : public ClientFactory, public Grpc::RpcChannelFactory {
 public:
-  GrpcFactoryImpl(const Json::Object& config, Upstream::ClusterManager& cm);
+  GrpcFactoryImpl(const Json::Object& config, Upstream::ClusterManager& cm,
+                  ThreadLocal::Instance& tls, Stats::Store& stats,
+                  MonotonicTimeSource& time_source);
 
   // RateLimit::ClientFactory
   ClientPtr create(const Optional<std::chrono::milliseconds>& timeout) override;
@@ -58,6 +198,9 @@ public:
 private:
   const std::string cluster_name_;
   Upstream::ClusterManager& cm_;
+  ThreadLocal::Instance& tls_;
+  const uint32_t tls_slot_;
+  RateLimitClientStats stats_;
 };
 
 class NullClientImpl : public Client {
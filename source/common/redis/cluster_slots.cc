@@ -0,0 +1,148 @@
+#include "common/redis/cluster_slots.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/common/utility.h"
+#include "common/redis/codec_impl.h"
+
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+namespace Redis {
+
+namespace {
+
+/**
+ * CRC16-CCITT (XMODEM): polynomial 0x1021 and initial value 0, as used by Redis Cluster.
+ */
+class Crc16Table {
+public:
+  Crc16Table() {
+    for (uint32_t i = 0; i < table_.size(); i++) {
+      uint16_t crc = i << 8;
+      for (uint32_t bit = 0; bit < 8; bit++) {
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+      }
+      table_[i] = crc;
+    }
+  }
+
+  uint16_t crc16(const char* data, size_t length) const {
+    uint16_t crc = 0;
+    for (size_t i = 0; i < length; i++) {
+      crc = (crc << 8) ^ table_[((crc >> 8) ^ static_cast<uint8_t>(data[i])) & 0xff];
+    }
+    return crc;
+  }
+
+private:
+  std::array<uint16_t, 256> table_;
+};
+
+struct SingleValueCallbacks : public DecoderCallbacks {
+  // Redis::DecoderCallbacks
+  void onRespValue(RespValuePtr&& value) override { value_ = std::move(value); }
+
+  RespValuePtr value_;
+};
+
+} // namespace
+
+uint32_t ClusterSlotUtility::keySlot(const std::string& key) {
+  static const Crc16Table table;
+
+  // Only the part between the first '{' and the next '}' is hashed, if it is not empty.
+  const size_t start = key.find('{');
+  if (start != std::string::npos) {
+    const size_t end = key.find('}', start + 1);
+    if (end != std::string::npos && end != start + 1) {
+      return table.crc16(key.data() + start + 1, end - start - 1) % NumSlots;
+    }
+  }
+
+  return table.crc16(key.data(), key.size()) % NumSlots;
+}
+
+bool ClusterSlotUtility::parseSlots(const RespValue& value, std::vector<SlotRange>& ranges) {
+  if (value.raw()) {
+    // Array elements of values that retain their raw bytes are only available in the raw bytes.
+    SingleValueCallbacks callbacks;
+    DecoderImpl decoder(callbacks);
+    Buffer::OwnedImpl raw;
+    raw.add(*value.raw());
+    try {
+      decoder.decode(raw);
+    } catch (ProtocolError&) {
+      return false;
+    }
+    return callbacks.value_ && !callbacks.value_->raw() && parseSlots(*callbacks.value_, ranges);
+  }
+
+  if (value.type() != RespType::Array) {
+    return false;
+  }
+
+  // Every entry is [start, end, [ip, port, ...], replicas...].
+  for (const RespValue& entry : value.asArray()) {
+    if (entry.type() != RespType::Array || entry.asArray().size() < 3) {
+      return false;
+    }
+
+    const RespValue& start = entry.asArray()[0];
+    const RespValue& end = entry.asArray()[1];
+    const RespValue& primary = entry.asArray()[2];
+    if (start.type() != RespType::Integer || end.type() != RespType::Integer ||
+        start.asInteger() < 0 || start.asInteger() > end.asInteger() ||
+        end.asInteger() >= NumSlots || primary.type() != RespType::Array ||
+        primary.asArray().size() < 2 || primary.asArray()[0].type() != RespType::BulkString ||
+        primary.asArray()[0].asString().empty() ||
+        primary.asArray()[1].type() != RespType::Integer) {
+      return false;
+    }
+
+    ranges.push_back({static_cast<uint32_t>(start.asInteger()),
+                      static_cast<uint32_t>(end.asInteger()),
+                      formatAddress(primary.asArray()[0].asString(),
+                                    primary.asArray()[1].asInteger())});
+  }
+
+  return true;
+}
+
+bool ClusterSlotUtility::parseRedirect(const RespValue& value, Redirect& redirect) {
+  if (value.type() != RespType::Error) {
+    return false;
+  }
+
+  const std::vector<std::string> parts = StringUtil::split(value.asString(), ' ');
+  if (parts.size() != 3 || (parts[0] != "MOVED" && parts[0] != "ASK")) {
+    return false;
+  }
+
+  // The address is printed as <ip>:<port> without brackets around IPv6 addresses.
+  uint64_t slot;
+  uint64_t port;
+  const size_t colon = parts[2].rfind(':');
+  if (!StringUtil::atoul(parts[1].c_str(), slot) || slot >= NumSlots ||
+      colon == std::string::npos || colon == 0 ||
+      !StringUtil::atoul(parts[2].c_str() + colon + 1, port)) {
+    return false;
+  }
+
+  redirect.ask_ = parts[0] == "ASK";
+  redirect.slot_ = slot;
+  redirect.address_ = formatAddress(parts[2].substr(0, colon), port);
+  return true;
+}
+
+std::string ClusterSlotUtility::formatAddress(const std::string& ip, int64_t port) {
+  return ip.find(':') == std::string::npos ? fmt::format("{}:{}", ip, port)
+                                           : fmt::format("[{}]:{}", ip, port);
+}
+
+} // Redis
+} // Envoy
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "envoy/redis/codec.h"
+
+namespace Envoy {
+namespace Redis {
+
+/**
+ * Utilities for routing keys to the hash slots of a Redis Cluster, as described in
+ * https://redis.io/topics/cluster-spec.
+ */
+class ClusterSlotUtility {
+public:
+  static const uint32_t NumSlots = 16384;
+
+  /**
+   * A range of slots served by one primary, as returned by CLUSTER SLOTS.
+   */
+  struct SlotRange {
+    uint32_t start_;
+    uint32_t end_;
+    // The address of the primary, formatted like Network::Address::Instance::asString().
+    std::string primary_;
+  };
+
+  /**
+   * A MOVED or ASK redirection error.
+   */
+  struct Redirect {
+    // MOVED means the slot moved for good. ASK only redirects the one request.
+    bool ask_;
+    uint32_t slot_;
+    // The address of the node to redirect to, formatted like SlotRange::primary_.
+    std::string address_;
+  };
+
+  /**
+   * @return the slot of a key: the CRC16 of the key modulo 16384. If the key contains a non empty
+   *         hash tag ("{...}"), only the tag is hashed so that related keys share a slot.
+   */
+  static uint32_t keySlot(const std::string& key);
+
+  /**
+   * Parse a CLUSTER SLOTS response.
+   * @param value supplies the response. Values that retain their raw bytes are decoded again.
+   * @param ranges supplies the vector the slot ranges are appended to.
+   * @return whether the response was well formed.
+   */
+  static bool parseSlots(const RespValue& value, std::vector<SlotRange>& ranges);
+
+  /**
+   * Parse a "MOVED <slot> <ip>:<port>" or "ASK <slot> <ip>:<port>" error.
+   * @param value supplies the error.
+   * @param redirect supplies the redirect to fill in.
+   * @return whether the value was a redirection.
+   */
+  static bool parseRedirect(const RespValue& value, Redirect& redirect);
+
+private:
+  static std::string formatAddress(const std::string& ip, int64_t port);
+};
+
+} // Redis
+} // Envoy
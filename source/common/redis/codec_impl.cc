@@ -13,6 +13,10 @@ namespace Envoy {
 namespace Redis {
 
 std::string RespValue::toString() const {
+  if (raw_ && (type_ == RespType::Array || type_ == RespType::BulkString)) {
+    return fmt::format("<{} raw bytes>", raw_->length());
+  }
+
   switch (type_) {
   case RespType::Array: {
     std::string ret = "[";
@@ -91,6 +95,7 @@ void RespValue::cleanup() {
 
 void RespValue::type(RespType type) {
   cleanup();
+  raw_.reset();
 
   // Need to use placement new because of the union.
   type_ = type;
@@ -116,16 +121,24 @@ void DecoderImpl::decode(Buffer::Instance& data) {
   uint64_t num_slices = data.getRawSlices(nullptr, 0);
   Buffer::RawSlice slices[num_slices];
   data.getRawSlices(slices, num_slices);
+  parsed_length_ = 0;
   for (const Buffer::RawSlice& slice : slices) {
-    parseSlice(slice);
+    parseSlice(slice, data);
   }
 
-  data.drain(data.length());
+  if (retain_raw_) {
+    // The rest of the buffer belongs to a value that is still being decoded.
+    pending_raw_.move(data);
+  } else {
+    data.drain(data.length());
+  }
 }
 
-void DecoderImpl::parseSlice(const Buffer::RawSlice& slice) {
+void DecoderImpl::parseSlice(const Buffer::RawSlice& slice, Buffer::Instance& data) {
   const char* buffer = reinterpret_cast<const char*>(slice.mem_);
   uint64_t remaining = slice.len_;
+  // Bytes of this slice that have already been moved out of the input buffer.
+  uint64_t moved_length = 0;
 
   while (remaining || state_ == State::ValueComplete) {
     log_trace("parse slice: {} remaining", remaining);
@@ -133,7 +146,7 @@ void DecoderImpl::parseSlice(const Buffer::RawSlice& slice) {
     case State::ValueRootStart: {
       log_trace("parse slice: ValueRootStart");
       pending_value_root_.reset(new RespValue());
-      pending_value_stack_.push_front({pending_value_root_.get(), 0});
+      pending_value_stack_.push_front({pending_value_root_.get(), 0, 0});
       state_ = State::ValueStart;
       break;
     }
@@ -222,10 +235,15 @@ void DecoderImpl::parseSlice(const Buffer::RawSlice& slice) {
           state_ = State::ValueComplete;
         } else if (pending_integer_.integer_ == 0) {
           state_ = State::ValueComplete;
+        } else if (retain_raw_) {
+          current_value.array_size_ = pending_integer_.integer_;
+          pending_value_stack_.push_front({&discarded_value_, 0, 0});
+          state_ = State::ValueStart;
         } else {
+          current_value.array_size_ = pending_integer_.integer_;
           std::vector<RespValue> values(pending_integer_.integer_);
           current_value.value_->asArray().swap(values);
-          pending_value_stack_.push_front({&current_value.value_->asArray()[0], 0});
+          pending_value_stack_.push_front({&current_value.value_->asArray()[0], 0, 0});
           state_ = State::ValueStart;
         }
       } else if (current_value.value_->type() == RespType::Integer) {
@@ -258,7 +276,9 @@ void DecoderImpl::parseSlice(const Buffer::RawSlice& slice) {
       ASSERT(!pending_integer_.negative_);
       uint64_t length_to_copy =
           std::min(static_cast<uint64_t>(pending_integer_.integer_), remaining);
-      pending_value_stack_.front().value_->asString().append(buffer, length_to_copy);
+      if (!retain_raw_) {
+        pending_value_stack_.front().value_->asString().append(buffer, length_to_copy);
+      }
       pending_integer_.integer_ -= length_to_copy;
       remaining -= length_to_copy;
       buffer += length_to_copy;
@@ -300,7 +320,7 @@ void DecoderImpl::parseSlice(const Buffer::RawSlice& slice) {
       log_trace("parse slice: SimpleString: {}", buffer[0]);
       if (buffer[0] == '\r') {
         state_ = State::LF;
-      } else {
+      } else if (pending_value_stack_.front().value_ != &discarded_value_) {
         pending_value_stack_.front().value_->asString().push_back(buffer[0]);
       }
 
@@ -314,15 +334,29 @@ void DecoderImpl::parseSlice(const Buffer::RawSlice& slice) {
       ASSERT(!pending_value_stack_.empty());
       pending_value_stack_.pop_front();
       if (pending_value_stack_.empty()) {
+        if (retain_raw_) {
+          // Move the bytes of the value out of the input buffer. Whole slices change owner, so the
+          // memory of slices that are still being parsed stays valid.
+          const uint64_t parsed_slice_length = slice.len_ - remaining;
+          Buffer::InstancePtr raw(new Buffer::OwnedImpl());
+          raw->move(pending_raw_);
+          raw->move(data, parsed_length_ + parsed_slice_length - moved_length);
+          pending_value_root_->raw() = std::move(raw);
+          parsed_length_ = 0;
+          moved_length = parsed_slice_length;
+        }
+
         callbacks_.onRespValue(std::move(pending_value_root_));
         state_ = State::ValueRootStart;
       } else {
         PendingValue& current_value = pending_value_stack_.front();
-        ASSERT(current_value.value_->type() == RespType::Array);
-        if (current_value.current_array_element_ < current_value.value_->asArray().size() - 1) {
+        ASSERT(current_value.array_size_ > 0);
+        if (current_value.current_array_element_ < current_value.array_size_ - 1) {
           current_value.current_array_element_++;
-          pending_value_stack_.push_front(
-              {&current_value.value_->asArray()[current_value.current_array_element_], 0});
+          RespValue* element =
+              retain_raw_ ? &discarded_value_
+                          : &current_value.value_->asArray()[current_value.current_array_element_];
+          pending_value_stack_.push_front({element, 0, 0});
           state_ = State::ValueStart;
         }
       }
@@ -331,9 +365,16 @@ void DecoderImpl::parseSlice(const Buffer::RawSlice& slice) {
     }
     }
   }
+
+  parsed_length_ += slice.len_ - moved_length;
 }
 
 void EncoderImpl::encode(const RespValue& value, Buffer::Instance& out) {
+  if (value.raw()) {
+    out.add(*value.raw());
+    return;
+  }
+
   switch (value.type()) {
   case RespType::Array: {
     encodeArray(value.asArray(), out);
@@ -7,6 +7,7 @@
 
 #include "envoy/redis/codec.h"
 
+#include "common/buffer/buffer_impl.h"
 #include "common/common/logger.h"
 
 namespace Envoy {
@@ -19,7 +20,15 @@ namespace Redis {
  */
 class DecoderImpl : public Decoder, Logger::Loggable<Logger::Id::redis> {
 public:
-  DecoderImpl(DecoderCallbacks& callbacks) : callbacks_(callbacks) {}
+  /**
+   * @param callbacks supplies the callbacks to fire for each decoded top level value.
+   * @param retain_raw supplies whether each top level value should keep the bytes it was decoded
+   *        from (see RespValue::raw()). The bytes are moved out of the input buffer rather than
+   *        copied, and bulk string contents and array elements are not materialized. This suits
+   *        values that are mostly forwarded untouched, such as upstream responses.
+   */
+  DecoderImpl(DecoderCallbacks& callbacks, bool retain_raw = false)
+      : callbacks_(callbacks), retain_raw_(retain_raw) {}
 
   // Redis::Decoder
   void decode(Buffer::Instance& data) override;
@@ -51,15 +60,23 @@ private:
   struct PendingValue {
     RespValue* value_;
     uint64_t current_array_element_;
+    uint64_t array_size_;
   };
 
-  void parseSlice(const Buffer::RawSlice& slice);
+  void parseSlice(const Buffer::RawSlice& slice, Buffer::Instance& data);
 
   DecoderCallbacks& callbacks_;
+  const bool retain_raw_;
   State state_{State::ValueRootStart};
   PendingInteger pending_integer_;
   RespValuePtr pending_value_root_;
   std::forward_list<PendingValue> pending_value_stack_;
+  // When retaining raw bytes, array elements are parsed into this value and then discarded.
+  RespValue discarded_value_;
+  // Bytes of previous slices that have been parsed but are still at the front of the input buffer.
+  uint64_t parsed_length_{};
+  // Bytes of the value being decoded that arrived in previous calls to decode().
+  Buffer::OwnedImpl pending_raw_;
 };
 
 /**
@@ -67,10 +84,18 @@ private:
  */
 class DecoderFactoryImpl : public DecoderFactory {
 public:
+  /**
+   * @param retain_raw supplies whether created decoders retain the raw bytes of each value.
+   */
+  DecoderFactoryImpl(bool retain_raw = false) : retain_raw_(retain_raw) {}
+
   // Redis::DecoderFactory
   DecoderPtr create(DecoderCallbacks& callbacks) override {
-    return DecoderPtr{new DecoderImpl(callbacks)};
+    return DecoderPtr{new DecoderImpl(callbacks, retain_raw_)};
   }
+
+private:
+  const bool retain_raw_;
 };
 
 /**
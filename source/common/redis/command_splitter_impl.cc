@@ -1,8 +1,10 @@
 #include "common/redis/command_splitter_impl.h"
 
 #include <cstdint>
+#include <map>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "common/common/assert.h"
@@ -51,6 +53,53 @@ void AllParamsToOneServerCommandHandler::SplitRequestImpl::onFailure() {
   callbacks_.onResponse(Utility::makeError("upstream failure"));
 }
 
+SplitRequestPtr GETCommandHandler::startRequest(const RespValue& request,
+                                                SplitCallbacks& callbacks) {
+  const std::string& key = request.asArray()[1].asString();
+  ReadCache* read_cache =
+      read_cache_ && request.asArray().size() == 2 && read_cache_->cacheable(key) ? read_cache_
+                                                                                  : nullptr;
+  if (read_cache) {
+    RespValuePtr cached_response = read_cache->lookup(key);
+    if (cached_response) {
+      log_debug("redis: cached response: '{}'", cached_response->toString());
+      callbacks.onResponse(std::move(cached_response));
+      return nullptr;
+    }
+  }
+
+  std::unique_ptr<SplitRequestImpl> request_handle(
+      new SplitRequestImpl(callbacks, read_cache, key));
+  request_handle->handle_ = conn_pool_.makeReadRequest(key, request, *request_handle);
+  if (!request_handle->handle_) {
+    callbacks.onResponse(Utility::makeError("no upstream host"));
+    return nullptr;
+  }
+
+  return std::move(request_handle);
+}
+
+GETCommandHandler::SplitRequestImpl::~SplitRequestImpl() { ASSERT(!handle_); }
+
+void GETCommandHandler::SplitRequestImpl::cancel() {
+  handle_->cancel();
+  handle_ = nullptr;
+}
+
+void GETCommandHandler::SplitRequestImpl::onResponse(RespValuePtr&& response) {
+  handle_ = nullptr;
+  log_debug("redis: response: '{}'", response->toString());
+  if (read_cache_) {
+    read_cache_->insert(key_, *response, epoch_);
+  }
+  callbacks_.onResponse(std::move(response));
+}
+
+void GETCommandHandler::SplitRequestImpl::onFailure() {
+  handle_ = nullptr;
+  callbacks_.onResponse(Utility::makeError("upstream failure"));
+}
+
 SplitRequestPtr MGETCommandHandler::startRequest(const RespValue& request,
                                                  SplitCallbacks& callbacks) {
   std::unique_ptr<SplitRequestImpl> request_handle(
@@ -72,7 +121,7 @@ SplitRequestPtr MGETCommandHandler::startRequest(const RespValue& request,
     single_mget.asArray()[1].asString() = request.asArray()[i].asString();
     log_debug("redis: parallel get: '{}'", single_mget.toString());
     pending_request.handle_ =
-        conn_pool_.makeRequest(request.asArray()[i].asString(), single_mget, pending_request);
+        conn_pool_.makeReadRequest(request.asArray()[i].asString(), single_mget, pending_request);
     if (!pending_request.handle_) {
       pending_request.onResponse(Utility::makeError("no upstream host"));
     }
@@ -123,6 +172,8 @@ void MGETCommandHandler::SplitRequestImpl::onResponse(RespValuePtr&& value, uint
   case RespType::BulkString:
   case RespType::Error: {
     pending_response_->asArray()[index].asString().swap(value->asString());
+    // Keep the bytes received from upstream, if any, so the value is not copied out of them.
+    pending_response_->asArray()[index].raw() = std::move(value->raw());
     break;
   }
   case RespType::Null:
@@ -140,16 +191,188 @@ void MGETCommandHandler::SplitRequestImpl::onFailure(uint32_t index) {
   onResponse(Utility::makeError("upstream failure"), index);
 }
 
+SplitRequestPtr SplitKeysCommandHandler::startRequest(const RespValue& request,
+                                                      SplitCallbacks& callbacks) {
+  const std::vector<RespValue>& args = request.asArray();
+  if ((args.size() - 1) % args_per_key_ != 0) {
+    callbacks.onResponse(Utility::makeError(
+        fmt::format("wrong number of arguments for '{}' command", args[0].asString())));
+    return nullptr;
+  }
+
+  // Resolve the host of every key up front so that each per-host request can be sized exactly.
+  // Keys are also grouped by slot, as a Redis Cluster rejects requests that span slots.
+  const uint32_t num_keys = (args.size() - 1) / args_per_key_;
+  std::vector<Upstream::HostConstSharedPtr> hosts;
+  std::map<std::pair<Upstream::HostConstSharedPtr, uint32_t>, uint32_t> host_indexes;
+  std::vector<uint32_t> key_host_indexes(num_keys);
+  std::vector<uint32_t> host_key_counts;
+  for (uint32_t key = 0; key < num_keys; key++) {
+    const std::string& hash_key = args[1 + key * args_per_key_].asString();
+    Upstream::HostConstSharedPtr host = conn_pool_.chooseHost(hash_key);
+    if (!host) {
+      callbacks.onResponse(Utility::makeError("no upstream host"));
+      return nullptr;
+    }
+
+    auto it = host_indexes.emplace(std::make_pair(host, conn_pool_.slot(hash_key)), hosts.size())
+                  .first;
+    if (it->second == hosts.size()) {
+      hosts.push_back(host);
+      host_key_counts.push_back(0);
+    }
+    key_host_indexes[key] = it->second;
+    host_key_counts[it->second]++;
+  }
+
+  std::unique_ptr<SplitRequestImpl> request_handle(
+      new SplitRequestImpl(callbacks, response_type_, hosts.size()));
+  if (hosts.size() == 1) {
+    // All of the keys live on one host so the original request can be sent as is.
+    log_debug("redis: single host request: '{}'", request.toString());
+    request_handle->makeRequest(conn_pool_, hosts[0], request);
+    return request_handle->pending_responses_ > 0 ? std::move(request_handle) : nullptr;
+  }
+
+  // RespValue can't be copied or moved, so every per-host array is created at its final size and
+  // then filled in key order. host_key_counts is reused as the next free slot of each array.
+  std::vector<RespValue> host_requests(hosts.size());
+  for (uint32_t i = 0; i < hosts.size(); i++) {
+    std::vector<RespValue> values(1 + host_key_counts[i] * args_per_key_);
+    values[0].type(RespType::BulkString);
+    values[0].asString() = args[0].asString();
+    host_requests[i].type(RespType::Array);
+    host_requests[i].asArray().swap(values);
+    host_key_counts[i] = 1;
+  }
+
+  for (uint32_t key = 0; key < num_keys; key++) {
+    const uint32_t i = key_host_indexes[key];
+    std::vector<RespValue>& values = host_requests[i].asArray();
+    for (uint32_t arg = 1 + key * args_per_key_; arg < 1 + (key + 1) * args_per_key_; arg++) {
+      RespValue& value = values[host_key_counts[i]++];
+      value.type(RespType::BulkString);
+      value.asString() = args[arg].asString();
+    }
+  }
+
+  for (uint32_t i = 0; i < hosts.size(); i++) {
+    log_debug("redis: per host request: '{}'", host_requests[i].toString());
+    request_handle->makeRequest(conn_pool_, hosts[i], host_requests[i]);
+  }
+
+  return request_handle->pending_responses_ > 0 ? std::move(request_handle) : nullptr;
+}
+
+SplitKeysCommandHandler::SplitRequestImpl::SplitRequestImpl(SplitCallbacks& callbacks,
+                                                            ResponseType response_type,
+                                                            uint32_t num_requests)
+    : callbacks_(callbacks), response_type_(response_type), pending_responses_(num_requests) {
+  pending_requests_.reserve(num_requests);
+}
+
+SplitKeysCommandHandler::SplitRequestImpl::~SplitRequestImpl() {
+#ifndef NDEBUG
+  for (const PendingRequest& request : pending_requests_) {
+    ASSERT(!request.handle_);
+  }
+#endif
+}
+
+void SplitKeysCommandHandler::SplitRequestImpl::makeRequest(
+    ConnPool::Instance& conn_pool, const Upstream::HostConstSharedPtr& host,
+    const RespValue& request) {
+  pending_requests_.emplace_back(*this);
+  PendingRequest& pending_request = pending_requests_.back();
+  pending_request.handle_ = conn_pool.makeRequestToHost(host, request, pending_request);
+  if (!pending_request.handle_) {
+    pending_request.onFailure();
+  }
+}
+
+void SplitKeysCommandHandler::SplitRequestImpl::cancel() {
+  for (PendingRequest& request : pending_requests_) {
+    if (request.handle_) {
+      request.handle_->cancel();
+      request.handle_ = nullptr;
+    }
+  }
+}
+
+void SplitKeysCommandHandler::SplitRequestImpl::PendingRequest::onResponse(RespValuePtr&& value) {
+  handle_ = nullptr;
+  parent_.onResponse(*value);
+}
+
+void SplitKeysCommandHandler::SplitRequestImpl::PendingRequest::onFailure() {
+  handle_ = nullptr;
+  parent_.onFailure();
+}
+
+void SplitKeysCommandHandler::SplitRequestImpl::onResponse(const RespValue& value) {
+  switch (response_type_) {
+  case ResponseType::Ok: {
+    if (value.type() != RespType::SimpleString || value.asString() != "OK") {
+      error_count_++;
+    }
+    break;
+  }
+  case ResponseType::IntegerSum: {
+    if (value.type() == RespType::Integer) {
+      integer_sum_ += value.asInteger();
+    } else {
+      error_count_++;
+    }
+    break;
+  }
+  }
+
+  ASSERT(pending_responses_ > 0);
+  if (--pending_responses_ > 0) {
+    return;
+  }
+
+  RespValuePtr response;
+  if (error_count_ > 0) {
+    response = Utility::makeError(fmt::format("finished with {} error(s)", error_count_));
+  } else if (response_type_ == ResponseType::Ok) {
+    response.reset(new RespValue());
+    response->type(RespType::SimpleString);
+    response->asString() = "OK";
+  } else {
+    response.reset(new RespValue());
+    response->type(RespType::Integer);
+    response->asInteger() = integer_sum_;
+  }
+
+  log_debug("redis: response: '{}'", response->toString());
+  callbacks_.onResponse(std::move(response));
+}
+
+void SplitKeysCommandHandler::SplitRequestImpl::onFailure() {
+  RespValue error;
+  error.type(RespType::Error);
+  onResponse(error);
+}
+
 InstanceImpl::InstanceImpl(ConnPool::InstancePtr&& conn_pool, Stats::Scope& scope,
-                           const std::string& stat_prefix)
-    : conn_pool_(std::move(conn_pool)), all_to_one_handler_(*conn_pool_),
+                           const std::string& stat_prefix, ReadCachePtr&& read_cache)
+    : conn_pool_(std::move(conn_pool)), read_cache_(std::move(read_cache)),
+      all_to_one_handler_(*conn_pool_), get_handler_(*conn_pool_, read_cache_.get()),
       mget_handler_(*conn_pool_),
+      mset_handler_(*conn_pool_, 2, SplitKeysCommandHandler::ResponseType::Ok),
+      sum_handler_(*conn_pool_, 1, SplitKeysCommandHandler::ResponseType::IntegerSum),
       stats_{ALL_COMMAND_SPLITTER_STATS(POOL_COUNTER_PREFIX(scope, stat_prefix + "splitter."))} {
   // TODO(mattklein123) PERF: Make this a trie (like in header_map_impl).
-  addHandler(scope, stat_prefix, "expire", all_to_one_handler_);
-  addHandler(scope, stat_prefix, "incr", all_to_one_handler_);
-  addHandler(scope, stat_prefix, "incrby", all_to_one_handler_);
-  addHandler(scope, stat_prefix, "mget", mget_handler_);
+  addHandler(scope, stat_prefix, "del", sum_handler_, WrittenKeys::All);
+  addHandler(scope, stat_prefix, "exists", sum_handler_, WrittenKeys::None);
+  addHandler(scope, stat_prefix, "expire", all_to_one_handler_, WrittenKeys::First);
+  addHandler(scope, stat_prefix, "get", get_handler_, WrittenKeys::None);
+  addHandler(scope, stat_prefix, "incr", all_to_one_handler_, WrittenKeys::First);
+  addHandler(scope, stat_prefix, "incrby", all_to_one_handler_, WrittenKeys::First);
+  addHandler(scope, stat_prefix, "mget", mget_handler_, WrittenKeys::None);
+  addHandler(scope, stat_prefix, "mset", mset_handler_, WrittenKeys::EveryOther);
+  addHandler(scope, stat_prefix, "set", all_to_one_handler_, WrittenKeys::First);
 }
 
 SplitRequestPtr InstanceImpl::makeRequest(const RespValue& request, SplitCallbacks& callbacks) {
@@ -177,22 +400,49 @@ SplitRequestPtr InstanceImpl::makeRequest(const RespValue& request, SplitCallbac
 
   log_debug("redis: splitting '{}'", request.toString());
   handler->second.total_.inc();
+  if (read_cache_) {
+    invalidateWrittenKeys(request, handler->second.written_keys_);
+  }
   return handler->second.handler_.get().startRequest(request, callbacks);
 }
 
+void InstanceImpl::invalidateWrittenKeys(const RespValue& request, WrittenKeys written_keys) {
+  const std::vector<RespValue>& args = request.asArray();
+  switch (written_keys) {
+  case WrittenKeys::None:
+    break;
+  case WrittenKeys::First:
+    if (read_cache_->cacheable(args[1].asString())) {
+      read_cache_->invalidate(args[1].asString());
+    }
+    break;
+  case WrittenKeys::All:
+  case WrittenKeys::EveryOther: {
+    const uint64_t step = written_keys == WrittenKeys::All ? 1 : 2;
+    for (uint64_t i = 1; i < args.size(); i += step) {
+      if (read_cache_->cacheable(args[i].asString())) {
+        read_cache_->invalidate(args[i].asString());
+      }
+    }
+    break;
+  }
+  }
+}
+
 void InstanceImpl::onInvalidRequest(SplitCallbacks& callbacks) {
   stats_.invalid_request_.inc();
   callbacks.onResponse(Utility::makeError("invalid request"));
 }
 
 void InstanceImpl::addHandler(Stats::Scope& scope, const std::string& stat_prefix,
-                              const std::string& name, CommandHandler& handler) {
+                              const std::string& name, CommandHandler& handler,
+                              WrittenKeys written_keys) {
   std::string to_lower_name(name);
   to_lower_table_.toLowerCase(to_lower_name);
   command_map_.emplace(
       to_lower_name,
       HandlerData{scope.counter(fmt::format("{}command.{}.total", stat_prefix, to_lower_name)),
-                  handler});
+                  handler, written_keys});
 }
 
 } // CommandSplitter
@@ -10,6 +10,7 @@
 
 #include "common/common/logger.h"
 #include "common/common/to_lower_table.h"
+#include "common/redis/read_cache.h"
 
 namespace Envoy {
 namespace Redis {
@@ -61,6 +62,45 @@ private:
   };
 };
 
+/**
+ * Handler for GET. The request is sent as a read via ConnPool::Instance::makeReadRequest(), and if
+ * a read cache is configured, responses for cacheable keys are served from and added to it.
+ */
+class GETCommandHandler : public CommandHandler,
+                          CommandHandlerBase,
+                          Logger::Loggable<Logger::Id::redis> {
+public:
+  GETCommandHandler(ConnPool::Instance& conn_pool, ReadCache* read_cache)
+      : CommandHandlerBase(conn_pool), read_cache_(read_cache) {}
+
+  // Redis::CommandSplitter::CommandHandler
+  SplitRequestPtr startRequest(const RespValue& request, SplitCallbacks& callbacks) override;
+
+private:
+  struct SplitRequestImpl : public SplitRequest, public ConnPool::PoolCallbacks {
+    SplitRequestImpl(SplitCallbacks& callbacks, ReadCache* read_cache, const std::string& key)
+        : callbacks_(callbacks), read_cache_(read_cache),
+          key_(read_cache ? key : std::string()), epoch_(read_cache ? read_cache->epoch() : 0) {}
+    ~SplitRequestImpl();
+
+    // Redis::CommandSplitter::SplitRequest
+    void cancel() override;
+
+    // Redis::ConnPool::PoolCallbacks
+    void onResponse(RespValuePtr&& value) override;
+    void onFailure() override;
+
+    SplitCallbacks& callbacks_;
+    // Only set if the response should be cached.
+    ReadCache* read_cache_;
+    const std::string key_;
+    const uint64_t epoch_;
+    ConnPool::PoolRequest* handle_{};
+  };
+
+  ReadCache* read_cache_;
+};
+
 class MGETCommandHandler : public CommandHandler,
                            CommandHandlerBase,
                            Logger::Loggable<Logger::Id::redis> {
@@ -102,6 +142,67 @@ private:
   };
 };
 
+/**
+ * Handler for multi-key commands such as MSET, DEL and EXISTS. The keys of the request are grouped
+ * by the upstream host they hash to and each host is sent a single command carrying all of its keys
+ * (and, for MSET, their values). The per-host responses are folded into one response as they
+ * arrive, so no per-key response values are allocated.
+ */
+class SplitKeysCommandHandler : public CommandHandler,
+                                CommandHandlerBase,
+                                Logger::Loggable<Logger::Id::redis> {
+public:
+  enum class ResponseType {
+    // Every host must reply with OK and the client is sent a single OK (MSET).
+    Ok,
+    // Every host replies with an integer and the client is sent the sum (DEL, EXISTS).
+    IntegerSum
+  };
+
+  SplitKeysCommandHandler(ConnPool::Instance& conn_pool, uint32_t args_per_key,
+                          ResponseType response_type)
+      : CommandHandlerBase(conn_pool), args_per_key_(args_per_key),
+        response_type_(response_type) {}
+
+  // Redis::CommandSplitter::CommandHandler
+  SplitRequestPtr startRequest(const RespValue& request, SplitCallbacks& callbacks) override;
+
+private:
+  struct SplitRequestImpl : public SplitRequest {
+    struct PendingRequest : public ConnPool::PoolCallbacks {
+      PendingRequest(SplitRequestImpl& parent) : parent_(parent) {}
+
+      // Redis::ConnPool::PoolCallbacks
+      void onResponse(RespValuePtr&& value) override;
+      void onFailure() override;
+
+      SplitRequestImpl& parent_;
+      ConnPool::PoolRequest* handle_{};
+    };
+
+    SplitRequestImpl(SplitCallbacks& callbacks, ResponseType response_type, uint32_t num_requests);
+    ~SplitRequestImpl();
+
+    void makeRequest(ConnPool::Instance& conn_pool, const Upstream::HostConstSharedPtr& host,
+                     const RespValue& request);
+    void onResponse(const RespValue& value);
+    void onFailure();
+
+    // Redis::CommandSplitter::SplitRequest
+    void cancel() override;
+
+    SplitCallbacks& callbacks_;
+    const ResponseType response_type_;
+    std::vector<PendingRequest> pending_requests_;
+    uint32_t pending_responses_;
+    uint32_t error_count_{};
+    int64_t integer_sum_{};
+  };
+
+  const uint32_t args_per_key_;
+  const ResponseType response_type_;
+};
+
 /**
  * All splitter stats. @see stats_macros.h
  */
@@ -120,25 +221,43 @@ struct InstanceStats {
 
 class InstanceImpl : public Instance, Logger::Loggable<Logger::Id::redis> {
 public:
+  /**
+   * @param conn_pool supplies the connection pool to send requests to.
+   * @param scope supplies the scope to create stats in.
+   * @param stat_prefix supplies the prefix of all stats.
+   * @param read_cache supplies the optional cache for GET responses.
+   */
   InstanceImpl(ConnPool::InstancePtr&& conn_pool, Stats::Scope& scope,
-               const std::string& stat_prefix);
+               const std::string& stat_prefix, ReadCachePtr&& read_cache);
 
   // Redis::CommandSplitter::Instance
   SplitRequestPtr makeRequest(const RespValue& request, SplitCallbacks& callbacks) override;
 
 private:
+  /**
+   * The arguments of a command that are keys it writes. Cached reads of these keys are invalidated
+   * when the command is seen.
+   */
+  enum class WrittenKeys { None, First, All, EveryOther };
+
   struct HandlerData {
     Stats::Counter& total_;
     std::reference_wrapper<CommandHandler> handler_;
+    WrittenKeys written_keys_;
   };
 
   void addHandler(Stats::Scope& scope, const std::string& stat_prefix, const std::string& name,
-                  CommandHandler& handler);
+                  CommandHandler& handler, WrittenKeys written_keys);
+  void invalidateWrittenKeys(const RespValue& request, WrittenKeys written_keys);
   void onInvalidRequest(SplitCallbacks& callbacks);
 
   ConnPool::InstancePtr conn_pool_;
+  ReadCachePtr read_cache_;
   AllParamsToOneServerCommandHandler all_to_one_handler_;
+  GETCommandHandler get_handler_;
   MGETCommandHandler mget_handler_;
+  SplitKeysCommandHandler mset_handler_;
+  SplitKeysCommandHandler sum_handler_;
   std::unordered_map<std::string, HandlerData> command_map_;
   InstanceStats stats_;
   const ToLowerTable to_lower_table_;
@@ -7,6 +7,8 @@
 
 #include "common/common/assert.h"
 #include "common/json/config_schemas.h"
+#include "common/network/utility.h"
+#include "common/upstream/upstream_impl.h"
 
 namespace Envoy {
 namespace Redis {
@@ -14,7 +16,11 @@ namespace ConnPool {
 
 ConfigImpl::ConfigImpl(const Json::Object& config)
     : Validator(config, Json::Schema::REDIS_CONN_POOL_SCHEMA),
-      op_timeout_(config.getInteger("op_timeout_ms")) {}
+      op_timeout_(config.getInteger("op_timeout_ms")),
+      max_batch_size_(config.getInteger("max_batch_size", 1)),
+      batch_flush_delay_(config.getInteger("batch_flush_delay_ms", 0)),
+      replica_cluster_(config.getString("replica_cluster", "")),
+      cluster_mode_(config.getBoolean("cluster_mode", false)) {}
 
 ClientPtr ClientImpl::create(Upstream::HostConstSharedPtr host, Event::Dispatcher& dispatcher,
                              EncoderPtr&& encoder, DecoderFactory& decoder_factory,
@@ -32,7 +38,8 @@ ClientPtr ClientImpl::create(Upstream::HostConstSharedPtr host, Event::Dispatche
 
 ClientImpl::ClientImpl(Upstream::HostConstSharedPtr host, Event::Dispatcher& dispatcher,
                        EncoderPtr&& encoder, DecoderFactory& decoder_factory, const Config& config)
-    : host_(host), encoder_(std::move(encoder)), decoder_(decoder_factory.create(*this)),
+    : host_(host), dispatcher_(dispatcher), encoder_(std::move(encoder)),
+      decoder_(decoder_factory.create(*this)),
       config_(config),
       connect_or_op_timer_(dispatcher.createTimer([this]() -> void { onConnectOrOpTimeout(); })) {
   host->cluster().stats().upstream_cx_total_.inc();
@@ -40,6 +47,9 @@ ClientImpl::ClientImpl(Upstream::HostConstSharedPtr host, Event::Dispatcher& dis
   host->stats().cx_total_.inc();
   host->stats().cx_active_.inc();
   connect_or_op_timer_->enableTimer(host->cluster().connectTimeout());
+  if (config_.maxBatchSize() > 1) {
+    batch_stats_.reset(new BatchStats(generateBatchStats(host->cluster().statsScope())));
+  }
 }
 
 ClientImpl::~ClientImpl() {
@@ -49,13 +59,33 @@ ClientImpl::~ClientImpl() {
   host_->stats().cx_active_.dec();
 }
 
+BatchStats ClientImpl::generateBatchStats(Stats::Scope& scope) {
+  return {ALL_REDIS_BATCH_STATS(POOL_COUNTER_PREFIX(scope, "redis."))};
+}
+
 void ClientImpl::close() { connection_->close(Network::ConnectionCloseType::NoFlush); }
 
 PoolRequest* ClientImpl::makeRequest(const RespValue& request, PoolCallbacks& callbacks) {
   ASSERT(connection_->state() == Network::Connection::State::Open);
   pending_requests_.emplace_back(*this, callbacks);
   encoder_->encode(request, encoder_buffer_);
-  connection_->write(encoder_buffer_);
+
+  // Requests are encoded into the same buffer until the batch is full or its flush delay expires,
+  // so that a single write to the connection carries the whole batch.
+  if (config_.maxBatchSize() <= 1) {
+    connection_->write(encoder_buffer_);
+  } else if (++batch_size_ >= config_.maxBatchSize()) {
+    batch_stats_->batch_flushed_full_.inc();
+    flushBatch();
+  } else if (batch_size_ == 1) {
+    if (!batch_flush_timer_) {
+      batch_flush_timer_ = dispatcher_.createTimer([this]() -> void {
+        batch_stats_->batch_flushed_delay_.inc();
+        flushBatch();
+      });
+    }
+    batch_flush_timer_->enableTimer(config_.batchFlushDelay());
+  }
 
   // Only boost the op timeout if we are not already connected. Otherwise, we are governed by
   // the connect timeout and the timer will be reset when/if connection occurs. This allows a
@@ -67,6 +97,16 @@ PoolRequest* ClientImpl::makeRequest(const RespValue& request, PoolCallbacks& ca
   return &pending_requests_.back();
 }
 
+void ClientImpl::flushBatch() {
+  ASSERT(batch_size_ > 0);
+  batch_flush_timer_->disableTimer();
+  batch_stats_->batch_total_.inc();
+  batch_stats_->batch_rq_total_.add(batch_size_);
+  host_->cluster().statsScope().deliverHistogramToSinks("redis.batch_size", batch_size_);
+  batch_size_ = 0;
+  connection_->write(encoder_buffer_);
+}
+
 void ClientImpl::onConnectOrOpTimeout() {
   if (connected_) {
     host_->cluster().stats().upstream_rq_timeout_.inc();
@@ -108,6 +148,12 @@ void ClientImpl::onEvent(uint32_t events) {
       pending_requests_.pop_front();
     }
 
+    // Requests of a batch that was not written yet have just been failed.
+    if (batch_size_ > 0) {
+      batch_flush_timer_->disableTimer();
+      batch_size_ = 0;
+    }
+    encoder_buffer_.drain(encoder_buffer_.length());
     connect_or_op_timer_->disableTimer();
   } else if (events & Network::ConnectionEvent::Connected) {
     connected_ = true;
@@ -144,11 +190,13 @@ ClientImpl::PendingRequest::PendingRequest(ClientImpl& parent, PoolCallbacks& ca
   parent.host_->cluster().stats().upstream_rq_active_.inc();
   parent.host_->stats().rq_total_.inc();
   parent.host_->stats().rq_active_.inc();
+  parent.host_->incActiveRequests();
 }
 
 ClientImpl::PendingRequest::~PendingRequest() {
   parent_.host_->cluster().stats().upstream_rq_active_.dec();
   parent_.host_->stats().rq_active_.dec();
+  parent_.host_->decActiveRequests();
 }
 
 void ClientImpl::PendingRequest::cancel() {
@@ -166,11 +214,18 @@ ClientPtr ClientFactoryImpl::create(Upstream::HostConstSharedPtr host,
                             config);
 }
 
+const std::string InstanceImpl::REPLICA_OF_METADATA_KEY = "redis_replica_of";
+
 InstanceImpl::InstanceImpl(const std::string& cluster_name, Upstream::ClusterManager& cm,
                            ClientFactory& client_factory, ThreadLocal::Instance& tls,
                            const Json::Object& config)
     : cm_(cm), client_factory_(client_factory), tls_(tls), tls_slot_(tls.allocateSlot()),
       config_(config) {
+  if (!config_.replicaCluster().empty() && !cm.get(config_.replicaCluster())) {
+    throw EnvoyException(
+        fmt::format("redis: unknown replica cluster '{}'", config_.replicaCluster()));
+  }
+
   tls.set(tls_slot_, [this, cluster_name](
                          Event::Dispatcher& dispatcher) -> ThreadLocal::ThreadLocalObjectSharedPtr {
     return std::make_shared<ThreadLocalPool>(*this, dispatcher, cluster_name);
@@ -182,6 +237,76 @@ PoolRequest* InstanceImpl::makeRequest(const std::string& hash_key, const RespVa
   return tls_.getTyped<ThreadLocalPool>(tls_slot_).makeRequest(hash_key, value, callbacks);
 }
 
+PoolRequest* InstanceImpl::makeReadRequest(const std::string& hash_key, const RespValue& value,
+                                           PoolCallbacks& callbacks) {
+  return tls_.getTyped<ThreadLocalPool>(tls_slot_).makeReadRequest(hash_key, value, callbacks);
+}
+
+Upstream::HostConstSharedPtr InstanceImpl::chooseHost(const std::string& hash_key) {
+  return tls_.getTyped<ThreadLocalPool>(tls_slot_).chooseHost(hash_key);
+}
+
+uint32_t InstanceImpl::slot(const std::string& hash_key) {
+  return config_.clusterMode() ? ClusterSlotUtility::keySlot(hash_key) : 0;
+}
+
+PoolRequest* InstanceImpl::makeRequestToHost(const Upstream::HostConstSharedPtr& host,
+                                             const RespValue& value, PoolCallbacks& callbacks) {
+  return tls_.getTyped<ThreadLocalPool>(tls_slot_).makeRequestToHost(host, value, callbacks);
+}
+
+InstanceImpl::ClusterRequest::ClusterRequest(ThreadLocalPool& parent, const RespValue& request,
+                                             PoolCallbacks& callbacks)
+    : parent_(parent), callbacks_(callbacks) {
+  request_.type(request.type());
+  request_.raw().reset(new Buffer::OwnedImpl());
+  EncoderImpl().encode(request, *request_.raw());
+}
+
+void InstanceImpl::ClusterRequest::remove() {
+  parent_.dispatcher_.deferredDelete(removeFromList(parent_.cluster_requests_));
+}
+
+void InstanceImpl::ClusterRequest::cancel() {
+  handle_->cancel();
+  remove();
+}
+
+void InstanceImpl::ClusterRequest::onResponse(RespValuePtr&& value) {
+  ClusterSlotUtility::Redirect redirect;
+  if (redirections_ < MAX_REDIRECTIONS && ClusterSlotUtility::parseRedirect(*value, redirect)) {
+    Upstream::HostConstSharedPtr host = parent_.hostForAddress(redirect.address_);
+    if (host) {
+      redirections_++;
+      if (redirect.ask_) {
+        // The slot is being migrated. Only this request goes to the target, which must be told
+        // to serve it first.
+        parent_.cluster_stats_->cluster_ask_.inc();
+        parent_.makeClientRequest(host, parent_.asking_command_, parent_.null_callbacks_);
+      } else {
+        parent_.cluster_stats_->cluster_moved_.inc();
+        if (!parent_.slots_.empty()) {
+          parent_.slots_[redirect.slot_] = host;
+        }
+        parent_.refreshSlots(host);
+      }
+
+      handle_ = parent_.makeClientRequest(host, request_, *this);
+      if (handle_) {
+        return;
+      }
+    }
+  }
+
+  callbacks_.onResponse(std::move(value));
+  remove();
+}
+
+void InstanceImpl::ClusterRequest::onFailure() {
+  callbacks_.onFailure();
+  remove();
+}
+
 InstanceImpl::ThreadLocalPool::ThreadLocalPool(InstanceImpl& parent, Event::Dispatcher& dispatcher,
                                                const std::string& cluster_name)
     : parent_(parent), dispatcher_(dispatcher), cluster_(parent_.cm_.get(cluster_name)) {
@@ -190,6 +315,51 @@ InstanceImpl::ThreadLocalPool::ThreadLocalPool(InstanceImpl& parent, Event::Disp
       [this](const std::vector<Upstream::HostSharedPtr>&,
              const std::vector<Upstream::HostSharedPtr>& hosts_removed)
           -> void { onHostsRemoved(hosts_removed); });
+
+  if (!parent_.config_.replicaCluster().empty()) {
+    replica_cluster_ = parent_.cm_.get(parent_.config_.replicaCluster());
+    replica_cluster_->hostSet().addMemberUpdateCb(
+        [this](const std::vector<Upstream::HostSharedPtr>&,
+               const std::vector<Upstream::HostSharedPtr>& hosts_removed) -> void {
+          onHostsRemoved(hosts_removed);
+          refreshReplicas();
+        });
+    refreshReplicas();
+  }
+
+  if (parent_.config_.clusterMode()) {
+    cluster_stats_.reset(new ClusterModeStats{
+        ALL_REDIS_CLUSTER_STATS(POOL_COUNTER_PREFIX(cluster_->info()->statsScope(), "redis."))});
+
+    slots_command_.type(RespType::Array);
+    std::vector<RespValue> slots_args(2);
+    slots_args[0].type(RespType::BulkString);
+    slots_args[0].asString() = "CLUSTER";
+    slots_args[1].type(RespType::BulkString);
+    slots_args[1].asString() = "SLOTS";
+    slots_command_.asArray().swap(slots_args);
+
+    asking_command_.type(RespType::Array);
+    std::vector<RespValue> asking_args(1);
+    asking_args[0].type(RespType::BulkString);
+    asking_args[0].asString() = "ASKING";
+    asking_command_.asArray().swap(asking_args);
+
+    // The slots may point at hosts that are gone. They are loaded again on the next request.
+    cluster_->hostSet().addMemberUpdateCb([this](const std::vector<Upstream::HostSharedPtr>&,
+                                                 const std::vector<Upstream::HostSharedPtr>&)
+                                              -> void { slots_.clear(); });
+  }
+}
+
+void InstanceImpl::ThreadLocalPool::refreshReplicas() {
+  replicas_.clear();
+  for (const Upstream::HostSharedPtr& host : replica_cluster_->hostSet().hosts()) {
+    auto primary = host->metadata().find(REPLICA_OF_METADATA_KEY);
+    if (primary != host->metadata().end()) {
+      replicas_[primary->second].push_back(host);
+    }
+  }
 }
 
 void InstanceImpl::ThreadLocalPool::onHostsRemoved(
@@ -207,12 +377,166 @@ void InstanceImpl::ThreadLocalPool::onHostsRemoved(
 PoolRequest* InstanceImpl::ThreadLocalPool::makeRequest(const std::string& hash_key,
                                                         const RespValue& request,
                                                         PoolCallbacks& callbacks) {
+  Upstream::HostConstSharedPtr host = chooseHost(hash_key);
+  if (!host) {
+    return nullptr;
+  }
+
+  return makeRequestToHost(host, request, callbacks);
+}
+
+PoolRequest* InstanceImpl::ThreadLocalPool::makeReadRequest(const std::string& hash_key,
+                                                            const RespValue& request,
+                                                            PoolCallbacks& callbacks) {
+  Upstream::HostConstSharedPtr host = chooseHost(hash_key);
+  if (!host) {
+    return nullptr;
+  }
+
+  Upstream::HostConstSharedPtr replica = replica_cluster_ ? chooseReplica(*host) : nullptr;
+  return makeRequestToHost(replica ? replica : host, request, callbacks);
+}
+
+Upstream::HostConstSharedPtr
+InstanceImpl::ThreadLocalPool::chooseReplica(const Upstream::HostDescription& primary) {
+  auto replicas = replicas_.find(primary.address()->asString());
+  if (replicas == replicas_.end()) {
+    return nullptr;
+  }
+
+  // Round robin over the healthy replicas. The primary serves the read if none is healthy.
+  const std::vector<Upstream::HostSharedPtr>& hosts = replicas->second;
+  for (size_t i = 0; i < hosts.size(); i++) {
+    const Upstream::HostSharedPtr& host = hosts[replica_rr_index_++ % hosts.size()];
+    if (host->healthy()) {
+      return host;
+    }
+  }
+
+  return nullptr;
+}
+
+Upstream::HostConstSharedPtr
+InstanceImpl::ThreadLocalPool::chooseHost(const std::string& hash_key) {
+  if (parent_.config_.clusterMode()) {
+    if (slots_.empty()) {
+      refreshSlots(nullptr);
+    } else {
+      const Upstream::HostConstSharedPtr& host = slots_[ClusterSlotUtility::keySlot(hash_key)];
+      if (host) {
+        return host;
+      }
+    }
+
+    // Until the slots are known, any node will do: a wrong one redirects the request.
+  }
+
   LbContextImpl lb_context(hash_key);
-  Upstream::HostConstSharedPtr host = cluster_->loadBalancer().chooseHost(&lb_context);
+  return cluster_->loadBalancer().chooseHost(&lb_context);
+}
+
+Upstream::HostConstSharedPtr
+InstanceImpl::ThreadLocalPool::hostForAddress(const std::string& address) {
+  for (const Upstream::HostSharedPtr& host : cluster_->hostSet().hosts()) {
+    if (host->address()->asString() == address) {
+      return host;
+    }
+  }
+
+  // Nodes the upstream cluster does not know about are still part of the Redis Cluster.
+  Upstream::HostSharedPtr& node = cluster_nodes_[address];
+  if (!node) {
+    try {
+      node.reset(new Upstream::HostImpl(cluster_->info(), "",
+                                        Network::Utility::parseInternetAddressAndPort(address),
+                                        false, 1, ""));
+    } catch (const EnvoyException&) {
+      cluster_nodes_.erase(address);
+      return nullptr;
+    }
+  }
+
+  return node;
+}
+
+void InstanceImpl::ThreadLocalPool::refreshSlots(Upstream::HostConstSharedPtr host) {
+  if (slots_request_) {
+    return;
+  }
+
   if (!host) {
+    host = cluster_->loadBalancer().chooseHost(nullptr);
+    if (!host) {
+      return;
+    }
+  }
+
+  cluster_stats_->cluster_slots_refresh_.inc();
+  slots_request_ = makeClientRequest(host, slots_command_, *this);
+}
+
+void InstanceImpl::ThreadLocalPool::onResponse(RespValuePtr&& value) {
+  slots_request_ = nullptr;
+
+  std::vector<ClusterSlotUtility::SlotRange> ranges;
+  if (!ClusterSlotUtility::parseSlots(*value, ranges) || ranges.empty()) {
+    cluster_stats_->cluster_slots_refresh_failure_.inc();
+    return;
+  }
+
+  std::vector<Upstream::HostConstSharedPtr> slots(ClusterSlotUtility::NumSlots);
+  std::unordered_map<std::string, Upstream::HostConstSharedPtr> primaries;
+  for (const ClusterSlotUtility::SlotRange& range : ranges) {
+    Upstream::HostConstSharedPtr& host = primaries[range.primary_];
+    if (!host) {
+      host = hostForAddress(range.primary_);
+    }
+    for (uint32_t slot = range.start_; slot <= range.end_; slot++) {
+      slots[slot] = host;
+    }
+  }
+  slots_.swap(slots);
+
+  // Close the connections to nodes that no longer serve any slot.
+  std::vector<Upstream::HostSharedPtr> nodes_removed;
+  for (auto it = cluster_nodes_.begin(); it != cluster_nodes_.end();) {
+    if (primaries.count(it->first) == 0) {
+      nodes_removed.push_back(it->second);
+      it = cluster_nodes_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  onHostsRemoved(nodes_removed);
+}
+
+void InstanceImpl::ThreadLocalPool::onFailure() {
+  slots_request_ = nullptr;
+  cluster_stats_->cluster_slots_refresh_failure_.inc();
+}
+
+PoolRequest*
+InstanceImpl::ThreadLocalPool::makeRequestToHost(const Upstream::HostConstSharedPtr& host,
+                                                 const RespValue& request,
+                                                 PoolCallbacks& callbacks) {
+  if (!parent_.config_.clusterMode()) {
+    return makeClientRequest(host, request, callbacks);
+  }
+
+  ClusterRequestPtr cluster_request(new ClusterRequest(*this, request, callbacks));
+  cluster_request->handle_ = makeClientRequest(host, request, *cluster_request);
+  if (!cluster_request->handle_) {
     return nullptr;
   }
 
+  cluster_request->moveIntoList(std::move(cluster_request), cluster_requests_);
+  return cluster_requests_.front().get();
+}
+
+PoolRequest*
+InstanceImpl::ThreadLocalPool::makeClientRequest(const Upstream::HostConstSharedPtr& host,
+                                                 const RespValue& request,
+                                                 PoolCallbacks& callbacks) {
   ThreadLocalActiveClientPtr& client = client_map_[host];
   if (!client) {
     client.reset(new ThreadLocalActiveClient(*this));
@@ -9,12 +9,16 @@
 #include <vector>
 
 #include "envoy/redis/conn_pool.h"
+#include "envoy/stats/stats_macros.h"
 #include "envoy/thread_local/thread_local.h"
 #include "envoy/upstream/cluster_manager.h"
 
 #include "common/buffer/buffer_impl.h"
+#include "common/common/hash.h"
+#include "common/common/linked_object.h"
 #include "common/json/json_validator.h"
 #include "common/network/filter_impl.h"
+#include "common/redis/cluster_slots.h"
 #include "common/redis/codec_impl.h"
 
 namespace Envoy {
@@ -23,14 +27,69 @@ namespace ConnPool {
 
 // TODO(mattklein123): Circuit breaking
 
+/**
+ * All redis connection pool batching stats. The stats are kept in the scope of the upstream
+ * cluster and are only updated when batching is enabled. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_REDIS_BATCH_STATS(COUNTER)                                                             \
+  COUNTER(batch_total)                                                                             \
+  COUNTER(batch_rq_total)                                                                          \
+  COUNTER(batch_flushed_full)                                                                      \
+  COUNTER(batch_flushed_delay)
+// clang-format on
+
+/**
+ * Struct definition for all redis connection pool batching stats. @see stats_macros.h
+ */
+struct BatchStats {
+  ALL_REDIS_BATCH_STATS(GENERATE_COUNTER_STRUCT)
+};
+
+/**
+ * All redis connection pool cluster mode stats. The stats are kept in the scope of the upstream
+ * cluster and are only updated when cluster mode is enabled. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_REDIS_CLUSTER_STATS(COUNTER)                                                           \
+  COUNTER(cluster_moved)                                                                           \
+  COUNTER(cluster_ask)                                                                             \
+  COUNTER(cluster_slots_refresh)                                                                   \
+  COUNTER(cluster_slots_refresh_failure)
+// clang-format on
+
+/**
+ * Struct definition for all redis connection pool cluster mode stats. @see stats_macros.h
+ */
+struct ClusterModeStats {
+  ALL_REDIS_CLUSTER_STATS(GENERATE_COUNTER_STRUCT)
+};
+
 class ConfigImpl : public Config, Json::Validator {
 public:
   ConfigImpl(const Json::Object& config);
 
   std::chrono::milliseconds opTimeout() const override { return op_timeout_; }
+  uint32_t maxBatchSize() const override { return max_batch_size_; }
+  std::chrono::milliseconds batchFlushDelay() const override { return batch_flush_delay_; }
+
+  /**
+   * @return the name of the cluster holding the read replicas, or empty if there are none.
+   */
+  const std::string& replicaCluster() const { return replica_cluster_; }
+
+  /**
+   * @return whether the upstream cluster is a Redis Cluster. Keys are then routed by hash slot and
+   *         MOVED/ASK redirections are followed.
+   */
+  bool clusterMode() const { return cluster_mode_; }
 
 private:
   const std::chrono::milliseconds op_timeout_;
+  const uint32_t max_batch_size_;
+  const std::chrono::milliseconds batch_flush_delay_;
+  const std::string replica_cluster_;
+  const bool cluster_mode_;
 };
 
 class ClientImpl : public Client, public DecoderCallbacks, public Network::ConnectionCallbacks {
@@ -75,6 +134,8 @@ private:
 
   ClientImpl(Upstream::HostConstSharedPtr host, Event::Dispatcher& dispatcher, EncoderPtr&& encoder,
              DecoderFactory& decoder_factory, const Config& config);
+  static BatchStats generateBatchStats(Stats::Scope& scope);
+  void flushBatch();
   void onConnectOrOpTimeout();
   void onData(Buffer::Instance& data);
 
@@ -83,15 +144,23 @@ private:
 
   // Network::ConnectionCallbacks
   void onEvent(uint32_t events) override;
+  void onAboveWriteBufferHighWatermark() override {}
+  void onBelowWriteBufferLowWatermark() override {}
 
   Upstream::HostConstSharedPtr host_;
+  Event::Dispatcher& dispatcher_;
   Network::ClientConnectionPtr connection_;
   EncoderPtr encoder_;
+  // Holds the encoded requests of the current batch until they are written to the connection.
   Buffer::OwnedImpl encoder_buffer_;
   DecoderPtr decoder_;
   const Config& config_;
   std::list<PendingRequest> pending_requests_;
   Event::TimerPtr connect_or_op_timer_;
+  // Only used when batching is enabled. The timer is created once the first request is batched.
+  Event::TimerPtr batch_flush_timer_;
+  std::unique_ptr<BatchStats> batch_stats_;
+  uint32_t batch_size_{};
   bool connected_{};
 };
 
@@ -104,7 +173,8 @@ public:
   static ClientFactoryImpl instance_;
 
 private:
-  DecoderFactoryImpl decoder_factory_;
+  // Responses are mostly forwarded downstream untouched, so they keep their raw bytes.
+  DecoderFactoryImpl decoder_factory_{true};
 };
 
 class InstanceImpl : public Instance {
@@ -113,9 +183,22 @@ public:
                ClientFactory& client_factory, ThreadLocal::Instance& tls,
                const Json::Object& config);
 
+  // Hosts of the replica cluster name the primary they replicate under this metadata key. The
+  // value is the address of the primary as printed by Network::Address::Instance::asString().
+  static const std::string REPLICA_OF_METADATA_KEY;
+
   // Redis::ConnPool::Instance
   PoolRequest* makeRequest(const std::string& hash_key, const RespValue& request,
                            PoolCallbacks& callbacks) override;
+  PoolRequest* makeReadRequest(const std::string& hash_key, const RespValue& request,
+                               PoolCallbacks& callbacks) override;
+  Upstream::HostConstSharedPtr chooseHost(const std::string& hash_key) override;
+  uint32_t slot(const std::string& hash_key) override;
+  PoolRequest* makeRequestToHost(const Upstream::HostConstSharedPtr& host,
+                                 const RespValue& request, PoolCallbacks& callbacks) override;
+
+  // The maximum number of MOVED/ASK redirections followed for a single request in cluster mode.
+  static const uint32_t MAX_REDIRECTIONS = 3;
 
 private:
   struct ThreadLocalPool;
@@ -125,6 +208,8 @@ private:
 
     // Network::ConnectionCallbacks
     void onEvent(uint32_t events) override;
+    void onAboveWriteBufferHighWatermark() override {}
+    void onBelowWriteBufferLowWatermark() override {}
 
     ThreadLocalPool& parent_;
     Upstream::HostConstSharedPtr host_;
@@ -133,13 +218,66 @@ private:
 
   typedef std::unique_ptr<ThreadLocalActiveClient> ThreadLocalActiveClientPtr;
 
-  struct ThreadLocalPool : public ThreadLocal::ThreadLocalObject {
+  /**
+   * A request made in cluster mode. It follows the MOVED/ASK redirections of the Redis Cluster
+   * before the response is passed to the caller.
+   */
+  struct ClusterRequest : public PoolRequest,
+                          public PoolCallbacks,
+                          public Event::DeferredDeletable,
+                          public LinkedObject<ClusterRequest> {
+    ClusterRequest(ThreadLocalPool& parent, const RespValue& request, PoolCallbacks& callbacks);
+
+    void remove();
+
+    // Redis::ConnPool::PoolRequest
+    void cancel() override;
+
+    // Redis::ConnPool::PoolCallbacks
+    void onResponse(RespValuePtr&& value) override;
+    void onFailure() override;
+
+    ThreadLocalPool& parent_;
+    // A copy of the request, which the caller is not required to keep until the response.
+    RespValue request_;
+    PoolCallbacks& callbacks_;
+    PoolRequest* handle_{};
+    uint32_t redirections_{};
+  };
+
+  typedef std::unique_ptr<ClusterRequest> ClusterRequestPtr;
+
+  /**
+   * Drops responses nobody waits for, such as those to ASKING.
+   */
+  struct NullPoolCallbacks : public PoolCallbacks {
+    // Redis::ConnPool::PoolCallbacks
+    void onResponse(RespValuePtr&&) override {}
+    void onFailure() override {}
+  };
+
+  struct ThreadLocalPool : public ThreadLocal::ThreadLocalObject, public PoolCallbacks {
     ThreadLocalPool(InstanceImpl& parent, Event::Dispatcher& dispatcher,
                     const std::string& cluster_name);
 
     PoolRequest* makeRequest(const std::string& hash_key, const RespValue& request,
                              PoolCallbacks& callbacks);
+    PoolRequest* makeReadRequest(const std::string& hash_key, const RespValue& request,
+                                 PoolCallbacks& callbacks);
+    Upstream::HostConstSharedPtr chooseHost(const std::string& hash_key);
+    Upstream::HostConstSharedPtr chooseReplica(const Upstream::HostDescription& primary);
+    void refreshReplicas();
+    PoolRequest* makeRequestToHost(const Upstream::HostConstSharedPtr& host,
+                                   const RespValue& request, PoolCallbacks& callbacks);
+    PoolRequest* makeClientRequest(const Upstream::HostConstSharedPtr& host,
+                                   const RespValue& request, PoolCallbacks& callbacks);
     void onHostsRemoved(const std::vector<Upstream::HostSharedPtr>& hosts_removed);
+    Upstream::HostConstSharedPtr hostForAddress(const std::string& address);
+    void refreshSlots(Upstream::HostConstSharedPtr host);
+
+    // Redis::ConnPool::PoolCallbacks for CLUSTER SLOTS responses.
+    void onResponse(RespValuePtr&& value) override;
+    void onFailure() override;
 
     // ThreadLocal::ThreadLocalObject
     void shutdown() override;
@@ -147,14 +285,31 @@ private:
     InstanceImpl& parent_;
     Event::Dispatcher& dispatcher_;
     Upstream::ThreadLocalCluster* cluster_;
+    Upstream::ThreadLocalCluster* replica_cluster_{};
+    // The replicas of each primary, keyed by the address of the primary.
+    std::unordered_map<std::string, std::vector<Upstream::HostSharedPtr>> replicas_;
+    uint64_t replica_rr_index_{};
     std::unordered_map<Upstream::HostConstSharedPtr, ThreadLocalActiveClientPtr> client_map_;
+    // Only used in cluster mode. The primary of each slot, empty until CLUSTER SLOTS is answered.
+    std::vector<Upstream::HostConstSharedPtr> slots_;
+    // Nodes of the Redis Cluster that are not hosts of the upstream cluster, keyed by address.
+    std::unordered_map<std::string, Upstream::HostSharedPtr> cluster_nodes_;
+    PoolRequest* slots_request_{};
+    RespValue slots_command_;
+    RespValue asking_command_;
+    NullPoolCallbacks null_callbacks_;
+    std::list<ClusterRequestPtr> cluster_requests_;
+    std::unique_ptr<ClusterModeStats> cluster_stats_;
   };
 
   struct LbContextImpl : public Upstream::LoadBalancerContext {
-    LbContextImpl(const std::string& hash_key) : hash_key_(std::hash<std::string>()(hash_key)) {}
+    LbContextImpl(const std::string& hash_key) : hash_key_(HashUtil::xxHash64(hash_key)) {}
 
     // Upstream::LoadBalancerContext
     const Optional<uint64_t>& hashKey() const override { return hash_key_; }
+    const Upstream::HostMetadata* metadataMatchCriteria() const override { return nullptr; }
+    const Network::Connection* downstreamConnection() const override { return nullptr; }
+    const Http::HeaderMap* downstreamHeaders() const override { return nullptr; }
 
     const Optional<uint64_t> hash_key_;
   };
@@ -81,7 +81,14 @@ void ProxyFilter::onResponse(PendingRequest& request, RespValuePtr&& value) {
   // The response we got might not be in order, so flush out what we can. (A new response may
   // unlock several out of order responses).
   while (!pending_requests_.empty() && pending_requests_.front().pending_response_) {
-    encoder_->encode(*pending_requests_.front().pending_response_, encoder_buffer_);
+    RespValuePtr& response = pending_requests_.front().pending_response_;
+    if (response->raw()) {
+      // Responses passed through from upstream still hold the bytes they were decoded from, which
+      // can be moved to the downstream connection without encoding them again.
+      encoder_buffer_.move(*response->raw());
+    } else {
+      encoder_->encode(*response, encoder_buffer_);
+    }
     pending_requests_.pop_front();
   }
 
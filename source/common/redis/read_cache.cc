@@ -0,0 +1,134 @@
+#include "common/redis/read_cache.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/json/config_schemas.h"
+#include "common/redis/codec_impl.h"
+
+namespace Envoy {
+namespace Redis {
+
+ReadCache::ReadCache(const Json::Object& config, ThreadLocal::Instance& tls,
+                     MonotonicTimeSource& time_source, Stats::Scope& scope,
+                     const std::string& stat_prefix)
+    : Json::Validator(config, Json::Schema::REDIS_READ_CACHE_SCHEMA),
+      key_prefixes_(config.getStringArray("key_prefixes")),
+      max_entries_(config.getInteger("max_entries")), ttl_(config.getInteger("ttl_ms")), tls_(tls),
+      tls_slot_(tls.allocateSlot()), time_source_(time_source),
+      stats_(generateStats(scope, stat_prefix + "read_cache.")) {
+  tls.set(tls_slot_, [](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+    return std::make_shared<ThreadLocalCache>();
+  });
+}
+
+ReadCacheStats ReadCache::generateStats(Stats::Scope& scope, const std::string& prefix) {
+  return {ALL_REDIS_READ_CACHE_STATS(POOL_COUNTER_PREFIX(scope, prefix))};
+}
+
+bool ReadCache::cacheable(const std::string& key) const {
+  for (const std::string& prefix : key_prefixes_) {
+    if (key.compare(0, prefix.size(), prefix) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+RespValuePtr ReadCache::lookup(const std::string& key) {
+  ThreadLocalCache& cache = tls_.getTyped<ThreadLocalCache>(tls_slot_);
+  auto it = cache.entries_.find(key);
+  if (it == cache.entries_.end()) {
+    stats_.miss_.inc();
+    return nullptr;
+  }
+
+  Entry& entry = it->second;
+  if (entry.expiry_ <= time_source_.currentTime()) {
+    cache.erase(key);
+    stats_.miss_.inc();
+    return nullptr;
+  }
+
+  cache.lru_.splice(cache.lru_.begin(), cache.lru_, entry.lru_position_);
+  stats_.hit_.inc();
+
+  // The copy keeps the encoded form so that it is written downstream without being encoded again.
+  RespValuePtr response(new RespValue());
+  response->type(entry.type_);
+  response->raw().reset(new Buffer::OwnedImpl(entry.encoded_));
+  return response;
+}
+
+uint64_t ReadCache::epoch() { return tls_.getTyped<ThreadLocalCache>(tls_slot_).epoch_; }
+
+void ReadCache::insert(const std::string& key, const RespValue& response, uint64_t epoch) {
+  if (response.type() != RespType::BulkString && response.type() != RespType::Null) {
+    return;
+  }
+
+  ThreadLocalCache& cache = tls_.getTyped<ThreadLocalCache>(tls_slot_);
+  if (cache.epoch_ != epoch) {
+    return;
+  }
+
+  // Responses passed through from upstream are cached in the form they were received in.
+  Buffer::OwnedImpl encoded;
+  if (!response.raw()) {
+    EncoderImpl().encode(response, encoded);
+  }
+  const Buffer::Instance& source = response.raw() ? *response.raw() : encoded;
+
+  cache.erase(key);
+  if (cache.entries_.size() >= max_entries_) {
+    cache.erase(*cache.lru_.back());
+    stats_.evicted_.inc();
+  }
+
+  auto it = cache.entries_.emplace(key, Entry()).first;
+  Entry& entry = it->second;
+  entry.type_ = response.type();
+  entry.encoded_.reserve(source.length());
+  uint64_t num_slices = source.getRawSlices(nullptr, 0);
+  Buffer::RawSlice slices[num_slices];
+  source.getRawSlices(slices, num_slices);
+  for (const Buffer::RawSlice& slice : slices) {
+    entry.encoded_.append(static_cast<const char*>(slice.mem_), slice.len_);
+  }
+  entry.expiry_ = time_source_.currentTime() + ttl_;
+  cache.lru_.push_front(&it->first);
+  entry.lru_position_ = cache.lru_.begin();
+  stats_.insert_.inc();
+}
+
+void ReadCache::invalidate(const std::string& key) {
+  stats_.invalidated_.inc();
+  tls_.getTyped<ThreadLocalCache>(tls_slot_).invalidate(key);
+
+  // The thread local instance and the slot outlive this cache, so capture them rather than this.
+  ThreadLocal::Instance& tls = tls_;
+  const uint32_t tls_slot = tls_slot_;
+  tls_.runOnAllThreads([&tls, tls_slot, key]() -> void {
+    tls.getTyped<ThreadLocalCache>(tls_slot).invalidate(key);
+  });
+}
+
+void ReadCache::ThreadLocalCache::invalidate(const std::string& key) {
+  epoch_++;
+  erase(key);
+}
+
+void ReadCache::ThreadLocalCache::erase(const std::string& key) {
+  auto it = entries_.find(key);
+  if (it != entries_.end()) {
+    lru_.erase(it->second.lru_position_);
+    entries_.erase(it);
+  }
+}
+
+} // Redis
+} // Envoy
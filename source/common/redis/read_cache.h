@@ -0,0 +1,119 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "envoy/common/time.h"
+#include "envoy/json/json_object.h"
+#include "envoy/redis/codec.h"
+#include "envoy/stats/stats_macros.h"
+#include "envoy/thread_local/thread_local.h"
+
+#include "common/json/json_validator.h"
+
+namespace Envoy {
+namespace Redis {
+
+/**
+ * All redis read cache stats. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_REDIS_READ_CACHE_STATS(COUNTER)                                                        \
+  COUNTER(hit)                                                                                     \
+  COUNTER(miss)                                                                                    \
+  COUNTER(insert)                                                                                  \
+  COUNTER(evicted)                                                                                 \
+  COUNTER(invalidated)
+// clang-format on
+
+/**
+ * Struct definition for all redis read cache stats. @see stats_macros.h
+ */
+struct ReadCacheStats {
+  ALL_REDIS_READ_CACHE_STATS(GENERATE_COUNTER_STRUCT)
+};
+
+/**
+ * A bounded per worker cache of GET responses for keys that start with one of the configured
+ * prefixes. Entries expire after a fixed TTL and the least recently used entry is evicted when a
+ * worker's cache is full. Writes seen by the proxy invalidate the written keys on every worker.
+ * Writes made by other redis clients are not seen, so a cached response may be stale for up to the
+ * TTL.
+ */
+class ReadCache : Json::Validator {
+public:
+  ReadCache(const Json::Object& config, ThreadLocal::Instance& tls,
+            MonotonicTimeSource& time_source, Stats::Scope& scope, const std::string& stat_prefix);
+
+  /**
+   * @return whether responses for the key may be cached.
+   */
+  bool cacheable(const std::string& key) const;
+
+  /**
+   * @return RespValuePtr a copy of this worker's unexpired cached response for the key, or nullptr.
+   */
+  RespValuePtr lookup(const std::string& key);
+
+  /**
+   * @return the invalidation epoch of this worker. It changes whenever a key is invalidated on the
+   *         worker, and is passed to insert() so that a response that was in flight while its key
+   *         was written is not cached.
+   */
+  uint64_t epoch();
+
+  /**
+   * Cache the response of a GET for the key on this worker. Only bulk string and null responses
+   * are cached, and only if no key was invalidated since the epoch was read.
+   * @param key supplies the key.
+   * @param response supplies the response.
+   * @param epoch supplies the value of epoch() from when the request was sent.
+   */
+  void insert(const std::string& key, const RespValue& response, uint64_t epoch);
+
+  /**
+   * Remove the key from the cache of this worker now and from the caches of all other workers
+   * as soon as they process the invalidation.
+   */
+  void invalidate(const std::string& key);
+
+private:
+  struct Entry {
+    RespType type_;
+    std::string encoded_;
+    MonotonicTime expiry_;
+    std::list<const std::string*>::iterator lru_position_;
+  };
+
+  struct ThreadLocalCache : public ThreadLocal::ThreadLocalObject {
+    void erase(const std::string& key);
+    void invalidate(const std::string& key);
+
+    // ThreadLocal::ThreadLocalObject
+    void shutdown() override {}
+
+    std::unordered_map<std::string, Entry> entries_;
+    // Keys of entries_, most recently used first.
+    std::list<const std::string*> lru_;
+    uint64_t epoch_{};
+  };
+
+  static ReadCacheStats generateStats(Stats::Scope& scope, const std::string& prefix);
+
+  const std::vector<std::string> key_prefixes_;
+  const uint64_t max_entries_;
+  const std::chrono::milliseconds ttl_;
+  ThreadLocal::Instance& tls_;
+  const uint32_t tls_slot_;
+  MonotonicTimeSource& time_source_;
+  ReadCacheStats stats_;
+};
+
+typedef std::unique_ptr<ReadCache> ReadCachePtr;
+
+} // Redis
+} // Envoy
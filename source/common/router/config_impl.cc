@@ -1,10 +1,12 @@
 #include "common/router/config_impl.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
+#include <cstring>
 #include <map>
 #include <memory>
-#include <regex>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -15,11 +17,13 @@
 
 #include "common/common/assert.h"
 #include "common/common/empty_string.h"
+#include "common/common/hash.h"
 #include "common/common/utility.h"
 #include "common/http/headers.h"
 #include "common/http/utility.h"
 #include "common/json/config_schemas.h"
 #include "common/json/json_loader.h"
+#include "common/memory/accounting.h"
 #include "common/router/retry_state_impl.h"
 
 #include "spdlog/spdlog.h"
@@ -40,6 +44,8 @@ RetryPolicyImpl::RetryPolicyImpl(const Json::Object& config) {
       config.getObject("retry_policy")->getInteger("per_try_timeout_ms", 0));
   num_retries_ = config.getObject("retry_policy")->getInteger("num_retries", 1);
   retry_on_ = RetryStateImpl::parseRetryOn(config.getObject("retry_policy")->getString("retry_on"));
+  hedge_delay_ = std::chrono::milliseconds(
+      config.getObject("retry_policy")->getInteger("hedge_delay_ms", 0));
 }
 
 ShadowPolicyImpl::ShadowPolicyImpl(const Json::Object& config) {
@@ -58,9 +64,7 @@ Optional<uint64_t> HashPolicyImpl::generateHash(const Http::HeaderMap& headers)
   Optional<uint64_t> hash;
   const Http::HeaderEntry* header = headers.get(header_name_);
   if (header) {
-    // TODO(mattklein123): Compile in murmur3/city/etc. and potentially allow the user to choose so
-    // we know exactly what we are going to get.
-    hash.value(std::hash<std::string>()(header->value().c_str()));
+    hash.value(HashUtil::xxHash64(header->value().c_str(), header->value().size(), 0));
   }
   return hash;
 }
@@ -68,7 +72,7 @@ Optional<uint64_t> HashPolicyImpl::generateHash(const Http::HeaderMap& headers)
 const uint64_t RouteEntryImplBase::WeightedClusterEntry::MAX_CLUSTER_WEIGHT = 100UL;
 
 RouteEntryImplBase::RouteEntryImplBase(const VirtualHostImpl& vhost, const Json::Object& route,
-                                       Runtime::Loader& loader)
+                                       Runtime::Loader& loader, Upstream::ClusterManager& cm)
     : case_sensitive_(route.getBoolean("case_sensitive", true)),
       prefix_rewrite_(route.getString("prefix_rewrite", "")),
       host_rewrite_(route.getString("host_rewrite", "")), vhost_(vhost),
@@ -80,7 +84,8 @@ RouteEntryImplBase::RouteEntryImplBase(const VirtualHostImpl& vhost, const Json:
       host_redirect_(route.getString("host_redirect", "")),
       path_redirect_(route.getString("path_redirect", "")), retry_policy_(route),
       rate_limit_policy_(route), shadow_policy_(route),
-      priority_(ConfigUtility::parsePriority(route)), opaque_config_(parseOpaqueConfig(route)) {
+      priority_(ConfigUtility::parsePriority(route)), opaque_config_(parseOpaqueConfig(route)),
+      metadata_match_criteria_(parseMetadataMatchCriteria(route)) {
 
   route.validateSchema(Json::Schema::ROUTE_ENTRY_CONFIGURATION_SCHEMA);
 
@@ -108,6 +113,11 @@ RouteEntryImplBase::RouteEntryImplBase(const VirtualHostImpl& vhost, const Json:
     }
   }
 
+  // Resolve the cluster now so that the router does not need to hash its name on every request.
+  if (!cluster_name_.empty()) {
+    cluster_id_.value(cm.clusterId(cluster_name_));
+  }
+
   // If this is a weighted_cluster, we create N internal route entries
   // (called WeightedClusterEntry), such that each object is a simple
   // single cluster, pointing back to the parent.
@@ -124,7 +134,8 @@ RouteEntryImplBase::RouteEntryImplBase(const VirtualHostImpl& vhost, const Json:
       const std::string cluster_name = cluster->getString("name");
       std::unique_ptr<WeightedClusterEntry> cluster_entry(
           new WeightedClusterEntry(this, runtime_key_prefix + "." + cluster_name, loader_,
-                                   cluster_name, cluster->getInteger("weight")));
+                                   cluster_name, cm.clusterId(cluster_name),
+                                   cluster->getInteger("weight")));
       weighted_clusters_.emplace_back(std::move(cluster_entry));
       total_weight += weighted_clusters_.back()->clusterWeight();
     }
@@ -257,6 +268,18 @@ RouteEntryImplBase::parseOpaqueConfig(const Json::Object& route) {
   return ret;
 }
 
+Upstream::HostMetadata RouteEntryImplBase::parseMetadataMatchCriteria(const Json::Object& route) {
+  Upstream::HostMetadata ret;
+  if (route.hasObject("metadata_match")) {
+    Json::ObjectSharedPtr obj = route.getObject("metadata_match");
+    obj->iterate([&ret](const std::string& name, const Json::Object& value) {
+      ret.emplace(name, value.asString());
+      return true;
+    });
+  }
+  return ret;
+}
+
 const RedirectEntry* RouteEntryImplBase::redirectEntry() const {
   // A route for a request can exclusively be a route entry or a redirect entry.
   if (isRedirect()) {
@@ -295,7 +318,8 @@ RouteConstSharedPtr RouteEntryImplBase::clusterEntry(const Http::HeaderMap& head
       //       in the connection manager to account for this, but we may eventually want to have
       //       a chain of references that goes back to the route table root. That is complicated
       //       though.
-      return std::make_shared<DynanmicRouteEntry>(this, final_cluster_name);
+      return std::make_shared<DynanmicRouteEntry>(this, final_cluster_name,
+                                                  Optional<Upstream::ClusterId>());
     }
   }
 
@@ -348,8 +372,8 @@ void RouteEntryImplBase::validateClusters(Upstream::ClusterManager& cm) const {
 }
 
 PrefixRouteEntryImpl::PrefixRouteEntryImpl(const VirtualHostImpl& vhost, const Json::Object& route,
-                                           Runtime::Loader& loader)
-    : RouteEntryImplBase(vhost, route, loader), prefix_(route.getString("prefix")) {}
+                                           Runtime::Loader& loader, Upstream::ClusterManager& cm)
+    : RouteEntryImplBase(vhost, route, loader, cm), prefix_(route.getString("prefix")) {}
 
 void PrefixRouteEntryImpl::finalizeRequestHeaders(Http::HeaderMap& headers) const {
   RouteEntryImplBase::finalizeRequestHeaders(headers);
@@ -367,8 +391,8 @@ RouteConstSharedPtr PrefixRouteEntryImpl::matches(const Http::HeaderMap& headers
 }
 
 PathRouteEntryImpl::PathRouteEntryImpl(const VirtualHostImpl& vhost, const Json::Object& route,
-                                       Runtime::Loader& loader)
-    : RouteEntryImplBase(vhost, route, loader), path_(route.getString("path")) {}
+                                       Runtime::Loader& loader, Upstream::ClusterManager& cm)
+    : RouteEntryImplBase(vhost, route, loader, cm), path_(route.getString("path")) {}
 
 void PathRouteEntryImpl::finalizeRequestHeaders(Http::HeaderMap& headers) const {
   RouteEntryImplBase::finalizeRequestHeaders(headers);
@@ -402,7 +426,7 @@ VirtualHostImpl::VirtualHostImpl(const Json::Object& virtual_host,
                                  const ConfigImpl& global_route_config, Runtime::Loader& runtime,
                                  Upstream::ClusterManager& cm, bool validate_clusters)
     : name_(virtual_host.getString("name")), rate_limit_policy_(virtual_host),
-      global_route_config_(global_route_config) {
+      global_route_config_(global_route_config), virtual_cluster_catch_all_(name_) {
 
   virtual_host.validateSchema(Json::Schema::VIRTUAL_HOST_CONFIGURATION_SCHEMA);
 
@@ -432,10 +456,24 @@ VirtualHostImpl::VirtualHostImpl(const Json::Object& virtual_host,
     }
 
     if (has_prefix) {
-      routes_.emplace_back(new PrefixRouteEntryImpl(*this, *route, runtime));
+      routes_.emplace_back(new PrefixRouteEntryImpl(*this, *route, runtime, cm));
     } else {
       ASSERT(has_path);
-      routes_.emplace_back(new PathRouteEntryImpl(*this, *route, runtime));
+      routes_.emplace_back(new PathRouteEntryImpl(*this, *route, runtime, cm));
+    }
+
+    const uint32_t index = routes_.size() - 1;
+    std::string key = route->getString(has_prefix ? "prefix" : "path");
+    PathTrie* paths = &case_sensitive_paths_;
+    if (!routes_.back()->caseSensitive()) {
+      std::transform(key.begin(), key.end(), key.begin(), tolower);
+      paths = &case_insensitive_paths_;
+    }
+    if (has_prefix) {
+      paths->addPrefix(key, index);
+      matches_query_string_ |= key.find('?') != std::string::npos;
+    } else {
+      paths->addExact(key, index);
     }
 
     if (validate_clusters) {
@@ -450,9 +488,22 @@ VirtualHostImpl::VirtualHostImpl(const Json::Object& virtual_host,
   }
 
   if (virtual_host.hasObject("virtual_clusters")) {
+    re2::RE2::Options options;
+    options.set_log_errors(false);
+    virtual_cluster_patterns_.reset(new re2::RE2::Set(options, re2::RE2::ANCHOR_BOTH));
     for (const Json::ObjectSharedPtr& virtual_cluster :
          virtual_host.getObjectArray("virtual_clusters")) {
-      virtual_clusters_.push_back(VirtualClusterEntry(*virtual_cluster));
+      const std::string pattern = virtual_cluster->getString("pattern");
+      std::string error;
+      if (virtual_cluster_patterns_->Add(pattern, &error) < 0) {
+        throw EnvoyException(fmt::format("invalid regex '{}': {}", pattern, error));
+      }
+      virtual_clusters_.push_back(VirtualClusterEntry(*virtual_cluster, name_));
+    }
+
+    if (!virtual_cluster_patterns_->Compile()) {
+      throw EnvoyException(
+          fmt::format("virtual host {}: virtual cluster patterns are too large", name_));
     }
   }
 }
@@ -467,34 +518,42 @@ bool VirtualHostImpl::usesRuntime() const {
   return uses;
 }
 
-VirtualHostImpl::VirtualClusterEntry::VirtualClusterEntry(const Json::Object& virtual_cluster) {
+VirtualHostImpl::VirtualClusterEntry::VirtualClusterEntry(const Json::Object& virtual_cluster,
+                                                          const std::string& vhost_name) {
   if (virtual_cluster.hasObject("method")) {
     method_ = virtual_cluster.getString("method");
   }
 
-  pattern_ = std::regex{virtual_cluster.getString("pattern"), std::regex::optimize};
   name_ = virtual_cluster.getString("name");
   priority_ = ConfigUtility::parsePriority(virtual_cluster);
+  code_stats_.reset(
+      new Http::CodeStatsImpl(fmt::format("vhost.{}.vcluster.{}.", vhost_name, name_)));
 }
 
 const VirtualHostImpl* RouteMatcher::findWildcardVirtualHost(const std::string& host) const {
+  if (host.empty()) {
+    return nullptr;
+  }
+
   // We do a longest wildcard suffix match against the host that's passed in.
   // (e.g. foo-bar.baz.com should match *-bar.baz.com before matching *.baz.com)
-  // This is done by scanning the length => wildcards map looking for every
-  // wildcard whose size is < length.
-  for (const auto& iter : wildcard_virtual_host_suffixes_) {
-    const uint32_t wildcard_length = iter.first;
-    const auto& wildcard_map = iter.second;
-    // >= because *.foo.com shouldn't match .foo.com.
-    if (wildcard_length >= host.size()) {
-      continue;
-    }
-    const auto& match = wildcard_map.find(host.substr(host.size() - wildcard_length));
-    if (match != wildcard_map.end()) {
-      return match->second.get();
+  // The last character of the reversed host is left out because *.foo.com shouldn't match
+  // .foo.com.
+  const std::string reversed_host(host.rbegin(), host.rend());
+  std::vector<uint32_t> matches;
+  wildcard_suffixes_.find(reversed_host.c_str(), reversed_host.size() - 1, 0, matches);
+
+  // Matches come out from the shortest suffix to the longest. For duplicate suffixes the first
+  // configured one wins.
+  const std::pair<size_t, VirtualHostSharedPtr>* longest = nullptr;
+  for (uint32_t index : matches) {
+    const std::pair<size_t, VirtualHostSharedPtr>& wildcard = wildcard_virtual_hosts_[index];
+    if (longest == nullptr || wildcard.first > longest->first) {
+      longest = &wildcard;
     }
   }
-  return nullptr;
+
+  return longest != nullptr ? longest->second.get() : nullptr;
 }
 
 RouteMatcher::RouteMatcher(const Json::Object& json_config, const ConfigImpl& global_route_config,
@@ -503,11 +562,14 @@ RouteMatcher::RouteMatcher(const Json::Object& json_config, const ConfigImpl& gl
 
   json_config.validateSchema(Json::Schema::ROUTE_CONFIGURATION_SCHEMA);
 
+  std::set<std::string> matched_headers;
   for (const Json::ObjectSharedPtr& virtual_host_config :
        json_config.getObjectArray("virtual_hosts")) {
     VirtualHostSharedPtr virtual_host(new VirtualHostImpl(*virtual_host_config, global_route_config,
                                                           runtime, cm, validate_clusters));
     uses_runtime_ |= virtual_host->usesRuntime();
+    virtual_host->addMatchedHeaders(matched_headers);
+    matches_query_string_ |= virtual_host->matchesQueryString();
 
     for (const std::string& domain : virtual_host_config->getStringArray("domains")) {
       if ("*" == domain) {
@@ -516,7 +578,10 @@ RouteMatcher::RouteMatcher(const Json::Object& json_config, const ConfigImpl& gl
         }
         default_virtual_host_ = virtual_host;
       } else if (domain.size() > 0 && '*' == domain[0]) {
-        wildcard_virtual_host_suffixes_[domain.size() - 1].emplace(domain.substr(1), virtual_host);
+        const std::string suffix = domain.substr(1);
+        wildcard_suffixes_.addPrefix(std::string(suffix.rbegin(), suffix.rend()),
+                                     wildcard_virtual_hosts_.size());
+        wildcard_virtual_hosts_.emplace_back(suffix.size(), virtual_host);
       } else {
         if (virtual_hosts_.find(domain) != virtual_hosts_.end()) {
           throw EnvoyException(fmt::format(
@@ -527,10 +592,17 @@ RouteMatcher::RouteMatcher(const Json::Object& json_config, const ConfigImpl& gl
       }
     }
   }
+
+  for (const std::string& name : matched_headers) {
+    matched_headers_.emplace_back(name);
+  }
 }
 
 RouteConstSharedPtr VirtualHostImpl::getRouteFromEntries(const Http::HeaderMap& headers,
-                                                         uint64_t random_value) const {
+                                                         uint64_t random_value,
+                                                         bool& cacheable) const {
+  cacheable = true;
+
   // First check for ssl redirect.
   if (ssl_requirements_ == SslRequirements::ALL && headers.ForwardedProto()->value() != "https") {
     return SSL_REDIRECT_ROUTE;
@@ -539,9 +611,31 @@ RouteConstSharedPtr VirtualHostImpl::getRouteFromEntries(const Http::HeaderMap&
     return SSL_REDIRECT_ROUTE;
   }
 
-  // Check for a route that matches the request.
-  for (const RouteEntryImplBaseConstSharedPtr& route : routes_) {
-    RouteConstSharedPtr route_entry = route->matches(headers, random_value);
+  // Find the routes whose prefix or path matches the request. Exact paths are compared with the
+  // path up to the query string, while prefixes are compared with the whole path.
+  const Http::HeaderString& path = headers.Path()->value();
+  const char* query_string_start = static_cast<const char*>(memchr(path.c_str(), '?', path.size()));
+  const size_t path_length =
+      query_string_start != nullptr ? query_string_start - path.c_str() : path.size();
+
+  std::vector<uint32_t> candidates;
+  case_sensitive_paths_.find(path.c_str(), path.size(), path_length, candidates);
+  if (!case_insensitive_paths_.empty()) {
+    std::string lower_case_path(path.c_str(), path.size());
+    std::transform(lower_case_path.begin(), lower_case_path.end(), lower_case_path.begin(),
+                   tolower);
+    case_insensitive_paths_.find(lower_case_path.c_str(), lower_case_path.size(), path_length,
+                                 candidates);
+  }
+
+  // The tries return candidates ordered by key length rather than by route.
+  std::sort(candidates.begin(), candidates.end());
+
+  // Check the remaining predicates of the candidates in route order. The result can only be
+  // cached if none of the routes that were checked depend on runtime or a random value.
+  for (uint32_t index : candidates) {
+    cacheable &= routes_[index]->deterministic();
+    RouteConstSharedPtr route_entry = routes_[index]->matches(headers, random_value);
     if (nullptr != route_entry) {
       return route_entry;
     }
@@ -550,9 +644,22 @@ RouteConstSharedPtr VirtualHostImpl::getRouteFromEntries(const Http::HeaderMap&
   return nullptr;
 }
 
+void VirtualHostImpl::addMatchedHeaders(std::set<std::string>& headers) const {
+  if (ssl_requirements_ != SslRequirements::NONE) {
+    headers.insert(Http::Headers::get().ForwardedProto.get());
+    headers.insert(Http::Headers::get().EnvoyInternalRequest.get());
+  }
+
+  for (const RouteEntryImplBaseConstSharedPtr& route : routes_) {
+    for (const ConfigUtility::HeaderData& header : route->configHeaders()) {
+      headers.insert(header.name_.get());
+    }
+  }
+}
+
 const VirtualHostImpl* RouteMatcher::findVirtualHost(const Http::HeaderMap& headers) const {
   // Fast path the case where we only have a default virtual host.
-  if (virtual_hosts_.empty() && default_virtual_host_) {
+  if (virtual_hosts_.empty() && wildcard_suffixes_.empty() && default_virtual_host_) {
     return default_virtual_host_.get();
   }
 
@@ -561,7 +668,7 @@ const VirtualHostImpl* RouteMatcher::findVirtualHost(const Http::HeaderMap& head
   if (iter != virtual_hosts_.end()) {
     return iter->second.get();
   }
-  if (!wildcard_virtual_host_suffixes_.empty()) {
+  if (!wildcard_suffixes_.empty()) {
     const VirtualHostImpl* vhost = findWildcardVirtualHost(host);
     if (vhost != nullptr) {
       return vhost;
@@ -570,41 +677,73 @@ const VirtualHostImpl* RouteMatcher::findVirtualHost(const Http::HeaderMap& head
   return default_virtual_host_.get();
 }
 
-RouteConstSharedPtr RouteMatcher::route(const Http::HeaderMap& headers,
-                                        uint64_t random_value) const {
+RouteConstSharedPtr RouteMatcher::route(const Http::HeaderMap& headers, uint64_t random_value,
+                                        bool& cacheable) const {
   const VirtualHostImpl* virtual_host = findVirtualHost(headers);
   if (virtual_host) {
-    return virtual_host->getRouteFromEntries(headers, random_value);
+    return virtual_host->getRouteFromEntries(headers, random_value, cacheable);
   } else {
+    cacheable = true;
     return nullptr;
   }
 }
 
-const VirtualHostImpl::CatchAllVirtualCluster VirtualHostImpl::VIRTUAL_CLUSTER_CATCH_ALL;
+std::string RouteMatcher::routeCacheKey(const Http::HeaderMap& headers) const {
+  std::string key = headers.Host()->value().c_str();
+  key.push_back('\0');
+
+  // Unless some prefix includes a query string, route selection only looks at the path up to the
+  // query string, so requests that only differ in their query string share an entry.
+  const Http::HeaderString& path = headers.Path()->value();
+  const char* path_end = nullptr;
+  if (!matches_query_string_) {
+    path_end = static_cast<const char*>(memchr(path.c_str(), '?', path.size()));
+  }
+  key.append(path.c_str(), path_end != nullptr ? path_end - path.c_str() : path.size());
+
+  for (const Http::LowerCaseString& name : matched_headers_) {
+    key.push_back('\0');
+    const Http::HeaderEntry* header = headers.get(name);
+    if (header != nullptr) {
+      // Distinguish an empty header from an absent one.
+      key.push_back('+');
+      key.append(header->value().c_str(), header->value().size());
+    }
+  }
+
+  return key;
+}
+
 const SslRedirector SslRedirectRoute::SSL_REDIRECTOR;
 const std::shared_ptr<const SslRedirectRoute> VirtualHostImpl::SSL_REDIRECT_ROUTE{
     new SslRedirectRoute()};
 
 const VirtualCluster*
 VirtualHostImpl::virtualClusterFromEntries(const Http::HeaderMap& headers) const {
-  for (const VirtualClusterEntry& entry : virtual_clusters_) {
-    bool method_matches =
-        !entry.method_.valid() || headers.Method()->value().c_str() == entry.method_.value();
+  if (virtual_clusters_.empty()) {
+    return nullptr;
+  }
 
-    if (method_matches && std::regex_match(headers.Path()->value().c_str(), entry.pattern_)) {
+  // The set reports every matching pattern in no particular order. The first virtual cluster in
+  // configuration order whose method also matches wins.
+  const Http::HeaderString& path = headers.Path()->value();
+  std::vector<int> matches;
+  virtual_cluster_patterns_->Match(re2::StringPiece(path.c_str(), path.size()), &matches);
+  std::sort(matches.begin(), matches.end());
+  for (int index : matches) {
+    const VirtualClusterEntry& entry = virtual_clusters_[index];
+    if (!entry.method_.valid() || headers.Method()->value().c_str() == entry.method_.value()) {
       return &entry;
     }
   }
 
-  if (virtual_clusters_.size() > 0) {
-    return &VIRTUAL_CLUSTER_CATCH_ALL;
-  }
-
-  return nullptr;
+  return &virtual_cluster_catch_all_;
 }
 
 ConfigImpl::ConfigImpl(const Json::Object& config, Runtime::Loader& runtime,
-                       Upstream::ClusterManager& cm, bool validate_clusters) {
+                       Upstream::ClusterManager& cm, bool validate_clusters)
+    : route_cache_size_(config.getInteger("route_cache_size", 0)) {
+  Memory::AccountingScope accounting(Memory::Subsystem::RouteTable);
   route_matcher_.reset(new RouteMatcher(config, *this, runtime, cm, validate_clusters));
 
   if (config.hasObject("internal_only_headers")) {
@@ -634,5 +773,10 @@ ConfigImpl::ConfigImpl(const Json::Object& config, Runtime::Loader& runtime,
   }
 }
 
+ConfigImpl::~ConfigImpl() {
+  Memory::AccountingScope accounting(Memory::Subsystem::RouteTable);
+  route_matcher_.reset();
+}
+
 } // Router
 } // Envoy
@@ -5,7 +5,7 @@
 #include <list>
 #include <map>
 #include <memory>
-#include <regex>
+#include <set>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -15,9 +15,13 @@
 #include "envoy/runtime/runtime.h"
 #include "envoy/upstream/cluster_manager.h"
 
+#include "common/http/codes.h"
 #include "common/router/config_utility.h"
+#include "common/router/path_trie.h"
 #include "common/router/router_ratelimit.h"
 
+#include "re2/set.h"
+
 namespace Envoy {
 namespace Router {
 
@@ -70,9 +74,18 @@ public:
   VirtualHostImpl(const Json::Object& virtual_host, const ConfigImpl& global_route_config,
                   Runtime::Loader& runtime, Upstream::ClusterManager& cm, bool validate_clusters);
 
-  RouteConstSharedPtr getRouteFromEntries(const Http::HeaderMap& headers,
-                                          uint64_t random_value) const;
+  RouteConstSharedPtr getRouteFromEntries(const Http::HeaderMap& headers, uint64_t random_value,
+                                          bool& cacheable) const;
   bool usesRuntime() const;
+  /**
+   * Add the names of the request headers, other than the host and path, that route selection in
+   * this virtual host depends on.
+   */
+  void addMatchedHeaders(std::set<std::string>& headers) const;
+  /**
+   * @return true if some route in this virtual host matches on the query string.
+   */
+  bool matchesQueryString() const { return matches_query_string_; }
   const VirtualCluster* virtualClusterFromEntries(const Http::HeaderMap& headers) const;
   const std::list<std::pair<Http::LowerCaseString, std::string>>& requestHeadersToAdd() const {
     return request_headers_to_add_;
@@ -87,38 +100,54 @@ private:
   enum class SslRequirements { NONE, EXTERNAL_ONLY, ALL };
 
   struct VirtualClusterEntry : public VirtualCluster {
-    VirtualClusterEntry(const Json::Object& virtual_cluster);
+    VirtualClusterEntry(const Json::Object& virtual_cluster, const std::string& vhost_name);
 
     // Router::VirtualCluster
     const std::string& name() const override { return name_; }
     Upstream::ResourcePriority priority() const override { return priority_; }
+    Http::CodeStats& codeStats() const override { return *code_stats_; }
 
-    std::regex pattern_;
     Optional<std::string> method_;
     std::string name_;
     Upstream::ResourcePriority priority_;
+    std::unique_ptr<Http::CodeStatsImpl> code_stats_;
   };
 
   struct CatchAllVirtualCluster : public VirtualCluster {
+    CatchAllVirtualCluster(const std::string& vhost_name)
+        : code_stats_(fmt::format("vhost.{}.vcluster.{}.", vhost_name, name_)) {}
+
     // Router::VirtualCluster
     const std::string& name() const override { return name_; }
     Upstream::ResourcePriority priority() const override {
       return Upstream::ResourcePriority::Default;
     }
+    Http::CodeStats& codeStats() const override { return code_stats_; }
 
-    std::string name_{"other"};
+    const std::string name_{"other"};
+    mutable Http::CodeStatsImpl code_stats_;
   };
-
-  static const CatchAllVirtualCluster VIRTUAL_CLUSTER_CATCH_ALL;
   static const std::shared_ptr<const SslRedirectRoute> SSL_REDIRECT_ROUTE;
 
   const std::string name_;
   std::vector<RouteEntryImplBaseConstSharedPtr> routes_;
+  // Index the prefix and path of every route so that a request is only matched against the
+  // routes whose path could match it. The values are indices into routes_, and checking the
+  // candidates in that order preserves first match wins. Keys of case insensitive routes are
+  // stored lower cased.
+  PathTrie case_sensitive_paths_;
+  PathTrie case_insensitive_paths_;
   std::vector<VirtualClusterEntry> virtual_clusters_;
+  // The patterns of all virtual clusters compiled together, so that a single pass over the path
+  // finds every virtual cluster whose pattern matches it. Pattern i belongs to
+  // virtual_clusters_[i].
+  std::unique_ptr<re2::RE2::Set> virtual_cluster_patterns_;
   SslRequirements ssl_requirements_;
   const RateLimitPolicyImpl rate_limit_policy_;
   const ConfigImpl& global_route_config_;
+  const CatchAllVirtualCluster virtual_cluster_catch_all_;
   std::list<std::pair<Http::LowerCaseString, std::string>> request_headers_to_add_;
+  bool matches_query_string_{};
 };
 
 typedef std::shared_ptr<VirtualHostImpl> VirtualHostSharedPtr;
@@ -134,11 +163,13 @@ public:
   std::chrono::milliseconds perTryTimeout() const override { return per_try_timeout_; }
   uint32_t numRetries() const override { return num_retries_; }
   uint32_t retryOn() const override { return retry_on_; }
+  std::chrono::milliseconds hedgeDelay() const override { return hedge_delay_; }
 
 private:
   std::chrono::milliseconds per_try_timeout_{0};
   uint32_t num_retries_{};
   uint32_t retry_on_{};
+  std::chrono::milliseconds hedge_delay_{0};
 };
 
 /**
@@ -182,9 +213,16 @@ class RouteEntryImplBase : public RouteEntry,
                            public std::enable_shared_from_this<RouteEntryImplBase> {
 public:
   RouteEntryImplBase(const VirtualHostImpl& vhost, const Json::Object& route,
-                     Runtime::Loader& loader);
+                     Runtime::Loader& loader, Upstream::ClusterManager& cm);
 
   bool isRedirect() const { return !host_redirect_.empty() || !path_redirect_.empty(); }
+  bool caseSensitive() const { return case_sensitive_; }
+  // Whether the route chosen for a request only depends on the request's host, path and the
+  // headers that routes match on, and not on runtime or on a random value.
+  bool deterministic() const {
+    return !runtime_.valid() && weighted_clusters_.empty() && cluster_header_name_.get().empty();
+  }
+  const std::vector<ConfigUtility::HeaderData>& configHeaders() const { return config_headers_; }
   bool usesRuntime() const { return runtime_.valid(); }
 
   bool matchRoute(const Http::HeaderMap& headers, uint64_t random_value) const;
@@ -195,6 +233,7 @@ public:
 
   // Router::RouteEntry
   const std::string& clusterName() const override;
+  const Optional<Upstream::ClusterId>& clusterId() const override { return cluster_id_; }
   void finalizeRequestHeaders(Http::HeaderMap& headers) const override;
   const HashPolicy* hashPolicy() const override { return hash_policy_.get(); }
   Upstream::ResourcePriority priority() const override { return priority_; }
@@ -211,6 +250,9 @@ public:
     return opaque_config_;
   }
   bool includeVirtualHostRateLimits() const override { return include_vh_rate_limits_; }
+  const Upstream::HostMetadata& metadataMatchCriteria() const override {
+    return metadata_match_criteria_;
+  }
 
   // Router::RedirectEntry
   std::string newPath(const Http::HeaderMap& headers) const override;
@@ -236,11 +278,13 @@ private:
 
   class DynanmicRouteEntry : public RouteEntry, public Route {
   public:
-    DynanmicRouteEntry(const RouteEntryImplBase* parent, const std::string& name)
-        : parent_(parent), cluster_name_(name) {}
+    DynanmicRouteEntry(const RouteEntryImplBase* parent, const std::string& name,
+                       const Optional<Upstream::ClusterId>& id)
+        : parent_(parent), cluster_name_(name), cluster_id_(id) {}
 
     // Router::RouteEntry
     const std::string& clusterName() const override { return cluster_name_; }
+    const Optional<Upstream::ClusterId>& clusterId() const override { return cluster_id_; }
 
     void finalizeRequestHeaders(Http::HeaderMap& headers) const override {
       return parent_->finalizeRequestHeaders(headers);
@@ -266,6 +310,9 @@ private:
     bool includeVirtualHostRateLimits() const override {
       return parent_->includeVirtualHostRateLimits();
     }
+    const Upstream::HostMetadata& metadataMatchCriteria() const override {
+      return parent_->metadataMatchCriteria();
+    }
 
     // Router::Route
     const RedirectEntry* redirectEntry() const override { return nullptr; }
@@ -274,6 +321,7 @@ private:
   private:
     const RouteEntryImplBase* parent_;
     const std::string cluster_name_;
+    const Optional<Upstream::ClusterId> cluster_id_;
   };
 
   /**
@@ -285,8 +333,9 @@ private:
   class WeightedClusterEntry : public DynanmicRouteEntry {
   public:
     WeightedClusterEntry(const RouteEntryImplBase* parent, const std::string runtime_key,
-                         Runtime::Loader& loader, const std::string& name, uint64_t weight)
-        : DynanmicRouteEntry(parent, name), runtime_key_(runtime_key), loader_(loader),
+                         Runtime::Loader& loader, const std::string& name, Upstream::ClusterId id,
+                         uint64_t weight)
+        : DynanmicRouteEntry(parent, name, id), runtime_key_(runtime_key), loader_(loader),
           cluster_weight_(weight) {}
 
     uint64_t clusterWeight() const {
@@ -307,12 +356,15 @@ private:
 
   static std::multimap<std::string, std::string> parseOpaqueConfig(const Json::Object& route);
 
+  static Upstream::HostMetadata parseMetadataMatchCriteria(const Json::Object& route);
+
   // Default timeout is 15s if nothing is specified in the route config.
   static const uint64_t DEFAULT_ROUTE_TIMEOUT_MS = 15000;
 
   const VirtualHostImpl& vhost_;
   const bool auto_host_rewrite_;
   const std::string cluster_name_;
+  Optional<Upstream::ClusterId> cluster_id_;
   const Http::LowerCaseString cluster_header_name_;
   const std::chrono::milliseconds timeout_;
   const Optional<RuntimeData> runtime_;
@@ -330,6 +382,7 @@ private:
 
   // TODO(danielhochman): refactor multimap into unordered_map since JSON is unordered map.
   const std::multimap<std::string, std::string> opaque_config_;
+  const Upstream::HostMetadata metadata_match_criteria_;
 };
 
 /**
@@ -338,7 +391,7 @@ private:
 class PrefixRouteEntryImpl : public RouteEntryImplBase {
 public:
   PrefixRouteEntryImpl(const VirtualHostImpl& vhost, const Json::Object& route,
-                       Runtime::Loader& loader);
+                       Runtime::Loader& loader, Upstream::ClusterManager& cm);
 
   // Router::RouteEntry
   void finalizeRequestHeaders(Http::HeaderMap& headers) const override;
@@ -356,7 +409,7 @@ private:
 class PathRouteEntryImpl : public RouteEntryImplBase {
 public:
   PathRouteEntryImpl(const VirtualHostImpl& vhost, const Json::Object& route,
-                     Runtime::Loader& loader);
+                     Runtime::Loader& loader, Upstream::ClusterManager& cm);
 
   // Router::RouteEntry
   void finalizeRequestHeaders(Http::HeaderMap& headers) const override;
@@ -377,27 +430,26 @@ public:
   RouteMatcher(const Json::Object& config, const ConfigImpl& global_http_config,
                Runtime::Loader& runtime, Upstream::ClusterManager& cm, bool validate_clusters);
 
-  RouteConstSharedPtr route(const Http::HeaderMap& headers, uint64_t random_value) const;
+  RouteConstSharedPtr route(const Http::HeaderMap& headers, uint64_t random_value,
+                            bool& cacheable) const;
   bool usesRuntime() const { return uses_runtime_; }
+  std::string routeCacheKey(const Http::HeaderMap& headers) const;
 
 private:
   const VirtualHostImpl* findVirtualHost(const Http::HeaderMap& headers) const;
   const VirtualHostImpl* findWildcardVirtualHost(const std::string& host) const;
 
   std::unordered_map<std::string, VirtualHostSharedPtr> virtual_hosts_;
-  // std::greater as a minor optimization to iterate from more to less specific
-  //
-  // A note on using an unordered_map versus a vector of (string, VirtualHostSharedPtr) pairs:
-  //
-  // Based on local benchmarks, each vector entry costs around 20ns for recall and (string)
-  // comparison with a fixed cost of about 25ns. For unordered_map, the empty map costs about 65ns
-  // and climbs to about 110ns once there are any entries.
-  //
-  // The break-even is 4 entries.
-  std::map<int64_t, std::unordered_map<std::string, VirtualHostSharedPtr>, std::greater<int64_t>>
-      wildcard_virtual_host_suffixes_;
+  // Wildcard domain suffixes are stored reversed, so that a single walk from the end of the host
+  // finds every wildcard that matches it no matter how many there are. The values are indices
+  // into wildcard_virtual_hosts_, which holds the length of each suffix and its virtual host.
+  PathTrie wildcard_suffixes_;
+  std::vector<std::pair<size_t, VirtualHostSharedPtr>> wildcard_virtual_hosts_;
   VirtualHostSharedPtr default_virtual_host_;
   bool uses_runtime_{};
+  // The request headers, other than the host and path, that route selection depends on.
+  std::vector<Http::LowerCaseString> matched_headers_;
+  bool matches_query_string_{};
 };
 
 /**
@@ -407,14 +459,38 @@ class ConfigImpl : public Config {
 public:
   ConfigImpl(const Json::Object& config, Runtime::Loader& runtime, Upstream::ClusterManager& cm,
              bool validate_clusters);
+  ~ConfigImpl();
 
   const std::list<std::pair<Http::LowerCaseString, std::string>>& requestHeadersToAdd() const {
     return request_headers_to_add_;
   }
 
+  /**
+   * Determine the route for a request, and whether the result can be reused for every request
+   * with the same route cache key.
+   */
+  RouteConstSharedPtr route(const Http::HeaderMap& headers, uint64_t random_value,
+                            bool& cacheable) const {
+    return route_matcher_->route(headers, random_value, cacheable);
+  }
+
+  /**
+   * @return the key that identifies requests for which route() returns the same cacheable route.
+   *         It is made of the host, the path and the values of any headers that routes match on.
+   */
+  std::string routeCacheKey(const Http::HeaderMap& headers) const {
+    return route_matcher_->routeCacheKey(headers);
+  }
+
+  /**
+   * @return the number of routes each worker should cache, or 0 if routes should not be cached.
+   */
+  uint32_t routeCacheSize() const { return route_cache_size_; }
+
   // Router::Config
   RouteConstSharedPtr route(const Http::HeaderMap& headers, uint64_t random_value) const override {
-    return route_matcher_->route(headers, random_value);
+    bool cacheable;
+    return route(headers, random_value, cacheable);
   }
 
   const std::list<Http::LowerCaseString>& internalOnlyHeaders() const override {
@@ -438,8 +514,11 @@ private:
   std::list<std::pair<Http::LowerCaseString, std::string>> response_headers_to_add_;
   std::list<Http::LowerCaseString> response_headers_to_remove_;
   std::list<std::pair<Http::LowerCaseString, std::string>> request_headers_to_add_;
+  uint32_t route_cache_size_;
 };
 
+typedef std::shared_ptr<const ConfigImpl> ConfigImplConstSharedPtr;
+
 /**
  * Implementation of Config that is empty.
  */
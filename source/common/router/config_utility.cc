@@ -1,14 +1,38 @@
 #include "common/router/config_utility.h"
 
-#include <regex>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "envoy/common/exception.h"
+
 #include "common/common/assert.h"
 
+#include "spdlog/spdlog.h"
+
 namespace Envoy {
 namespace Router {
 
+ConfigUtility::HeaderData::HeaderData(const Json::Object& config)
+    : Json::Validator(config, Json::Schema::HEADER_DATA_CONFIGURATION_SCHEMA),
+      name_(config.getString("name")), value_(config.getString("value", EMPTY_STRING)),
+      is_regex_(config.getBoolean("regex", false)) {
+  if (is_regex_) {
+    regex_pattern_ = parseRegex(value_);
+  }
+}
+
+std::unique_ptr<re2::RE2> ConfigUtility::parseRegex(const std::string& pattern) {
+  re2::RE2::Options options;
+  options.set_log_errors(false);
+  std::unique_ptr<re2::RE2> regex(new re2::RE2(pattern, options));
+  if (!regex->ok()) {
+    throw EnvoyException(fmt::format("invalid regex '{}': {}", pattern, regex->error()));
+  }
+
+  return regex;
+}
+
 Upstream::ResourcePriority ConfigUtility::parsePriority(const Json::Object& config) {
   std::string priority_string = config.getString("priority", "default");
   if (priority_string == "default") {
@@ -32,7 +56,9 @@ bool ConfigUtility::matchHeaders(const Http::HeaderMap& request_headers,
         matches &= (header != nullptr) && (header->value() == cfg_header_data.value_.c_str());
       } else {
         matches &= (header != nullptr) &&
-                   std::regex_match(header->value().c_str(), cfg_header_data.regex_pattern_);
+                   re2::RE2::FullMatch(
+                       re2::StringPiece(header->value().c_str(), header->value().size()),
+                       *cfg_header_data.regex_pattern_);
       }
       if (!matches) {
         break;
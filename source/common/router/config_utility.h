@@ -1,6 +1,6 @@
 #pragma once
 
-#include <regex>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -12,6 +12,8 @@
 #include "common/json/config_schemas.h"
 #include "common/json/json_validator.h"
 
+#include "re2/re2.h"
+
 namespace Envoy {
 namespace Router {
 
@@ -24,16 +26,13 @@ public:
     // An empty header value allows for matching to be only based on header presence.
     // Regex is an opt-in. Unless explicitly mentioned, the header values will be used for
     // exact string matching.
-    HeaderData(const Json::Object& config)
-        : Json::Validator(config, Json::Schema::HEADER_DATA_CONFIGURATION_SCHEMA),
-          name_(config.getString("name")), value_(config.getString("value", EMPTY_STRING)),
-          regex_pattern_(value_, std::regex::optimize),
-          is_regex_(config.getBoolean("regex", false)) {}
+    HeaderData(const Json::Object& config);
 
     const Http::LowerCaseString name_;
     const std::string value_;
-    const std::regex regex_pattern_;
     const bool is_regex_;
+    // Shared so that header data stays copyable. Only set if is_regex_ is true.
+    std::shared_ptr<const re2::RE2> regex_pattern_;
   };
 
   /**
@@ -41,6 +40,14 @@ public:
    */
   static Upstream::ResourcePriority parsePriority(const Json::Object& config);
 
+  /**
+   * Compile a regex from the route configuration. Matching with the result runs in time linear
+   * in the size of the input.
+   * @param pattern supplies the regex.
+   * @return the compiled regex. Throws EnvoyException if the pattern is not valid.
+   */
+  static std::unique_ptr<re2::RE2> parseRegex(const std::string& pattern);
+
   /**
    * See if the specified headers are present in the request headers.
    * @param headers supplies the list of headers to match
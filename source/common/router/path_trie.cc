@@ -0,0 +1,94 @@
+#include "common/router/path_trie.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "common/common/assert.h"
+
+namespace Envoy {
+namespace Router {
+
+void PathTrie::addPrefix(const std::string& prefix, uint32_t value) {
+  insert(prefix).prefix_values_.push_back(value);
+}
+
+void PathTrie::addExact(const std::string& key, uint32_t value) {
+  insert(key).exact_values_.push_back(value);
+}
+
+PathTrie::Node& PathTrie::insert(const std::string& key) {
+  empty_ = false;
+  Node* node = &root_;
+  size_t position = 0;
+  while (position < key.size()) {
+    Edge* next = nullptr;
+    for (Edge& edge : node->edges_) {
+      if (edge.label_[0] == key[position]) {
+        next = &edge;
+        break;
+      }
+    }
+
+    if (next == nullptr) {
+      node->edges_.push_back({key.substr(position), std::unique_ptr<Node>(new Node())});
+      return *node->edges_.back().node_;
+    }
+
+    size_t common = 1;
+    while (common < next->label_.size() && position + common < key.size() &&
+           next->label_[common] == key[position + common]) {
+      common++;
+    }
+
+    if (common < next->label_.size()) {
+      // The key diverges from the edge part way through, so split the edge at that point.
+      std::unique_ptr<Node> middle(new Node());
+      middle->edges_.push_back({next->label_.substr(common), std::move(next->node_)});
+      next->label_.resize(common);
+      next->node_ = std::move(middle);
+    }
+
+    node = next->node_.get();
+    position += common;
+  }
+
+  return *node;
+}
+
+void PathTrie::find(const char* input, size_t length, size_t exact_length,
+                    std::vector<uint32_t>& values) const {
+  ASSERT(exact_length <= length);
+  const Node* node = &root_;
+  size_t position = 0;
+  while (true) {
+    values.insert(values.end(), node->prefix_values_.begin(), node->prefix_values_.end());
+    if (position == exact_length) {
+      values.insert(values.end(), node->exact_values_.begin(), node->exact_values_.end());
+    }
+
+    if (position == length) {
+      return;
+    }
+
+    const Edge* next = nullptr;
+    for (const Edge& edge : node->edges_) {
+      if (edge.label_[0] == input[position]) {
+        next = &edge;
+        break;
+      }
+    }
+
+    if (next == nullptr || next->label_.size() > length - position ||
+        memcmp(next->label_.data(), input + position, next->label_.size()) != 0) {
+      return;
+    }
+
+    node = next->node_.get();
+    position += next->label_.size();
+  }
+}
+
+} // Router
+} // Envoy
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/common/non_copyable.h"
+
+namespace Envoy {
+namespace Router {
+
+/**
+ * A radix trie of route match keys. Each key is either a prefix, which matches every input that
+ * starts with it, or an exact key, which matches an input whose first exact_length characters
+ * (e.g. the path before the query string) equal it. A lookup visits only the nodes along the
+ * input, so its cost depends on the length of the input and not on the number of keys.
+ */
+class PathTrie : NonCopyable {
+public:
+  /**
+   * Add a key that matches any input starting with it.
+   * @param prefix supplies the key.
+   * @param value supplies the value returned by find() when the key matches.
+   */
+  void addPrefix(const std::string& prefix, uint32_t value);
+
+  /**
+   * Add a key that only matches inputs equal to it.
+   * @param key supplies the key.
+   * @param value supplies the value returned by find() when the key matches.
+   */
+  void addExact(const std::string& key, uint32_t value);
+
+  /**
+   * Append the values of all keys matching an input. Values come out ordered by the length of
+   * their key, shortest first, and in insertion order for equal keys.
+   * @param input supplies the input to match.
+   * @param length supplies the length of the input.
+   * @param exact_length supplies the length of the part of the input that exact keys match. This
+   *        must not be greater than length.
+   * @param values supplies the vector to append matching values to.
+   */
+  void find(const char* input, size_t length, size_t exact_length,
+            std::vector<uint32_t>& values) const;
+
+  /**
+   * @return true if no keys have been added.
+   */
+  bool empty() const { return empty_; }
+
+private:
+  struct Node;
+
+  struct Edge {
+    std::string label_;
+    std::unique_ptr<Node> node_;
+  };
+
+  struct Node {
+    std::vector<uint32_t> prefix_values_;
+    std::vector<uint32_t> exact_values_;
+    // Labels of the edges leaving a node all start with a different character.
+    std::vector<Edge> edges_;
+  };
+
+  Node& insert(const std::string& key);
+
+  Node root_;
+  bool empty_{true};
+};
+
+} // Router
+} // Envoy
@@ -8,6 +8,7 @@
 #include "common/common/assert.h"
 #include "common/json/config_schemas.h"
 #include "common/router/config_impl.h"
+#include "common/router/route_cache_impl.h"
 
 #include "spdlog/spdlog.h"
 
@@ -28,7 +29,7 @@ RouteConfigProviderPtr RouteConfigProviderUtil::create(
 
   if (has_route_config) {
     return RouteConfigProviderPtr{
-        new StaticRouteConfigProviderImpl(*config.getObject("route_config"), runtime, cm)};
+        new StaticRouteConfigProviderImpl(*config.getObject("route_config"), runtime, cm, tls)};
   } else {
     Json::ObjectSharedPtr rds_config = config.getObject("rds");
     rds_config->validateSchema(Json::Schema::RDS_CONFIGURATION_SCHEMA);
@@ -41,8 +42,28 @@ RouteConfigProviderPtr RouteConfigProviderUtil::create(
 
 StaticRouteConfigProviderImpl::StaticRouteConfigProviderImpl(const Json::Object& config,
                                                              Runtime::Loader& runtime,
-                                                             Upstream::ClusterManager& cm)
-    : config_(new ConfigImpl(config, runtime, cm, true)) {}
+                                                             Upstream::ClusterManager& cm,
+                                                             ThreadLocal::Instance& tls)
+    : tls_(tls) {
+  ConfigImplConstSharedPtr config_impl(new ConfigImpl(config, runtime, cm, true));
+  config_ = config_impl;
+  if (config_impl->routeCacheSize() > 0) {
+    use_tls_ = true;
+    tls_slot_ = tls_.allocateSlot();
+    tls_.set(tls_slot_,
+             [config_impl](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+               return std::make_shared<ThreadLocalConfig>(RouteCacheImpl::forWorker(config_impl));
+             });
+  }
+}
+
+Router::ConfigConstSharedPtr StaticRouteConfigProviderImpl::config() {
+  if (use_tls_) {
+    return tls_.getTyped<ThreadLocalConfig>(tls_slot_).config_;
+  }
+
+  return config_;
+}
 
 RdsRouteConfigProviderImpl::RdsRouteConfigProviderImpl(
     const Json::Object& config, Runtime::Loader& runtime, Upstream::ClusterManager& cm,
@@ -51,7 +72,9 @@ RdsRouteConfigProviderImpl::RdsRouteConfigProviderImpl(
     ThreadLocal::Instance& tls)
 
     : RestApiFetcher(cm, config.getString("cluster"), dispatcher, random,
-                     std::chrono::milliseconds(config.getInteger("refresh_delay_ms", 30000))),
+                     std::chrono::milliseconds(config.getInteger("refresh_delay_ms", 30000)),
+                     apiType(config.getString("api_type", "rest")), scope, stat_prefix + "rds.",
+                     config.getString("snapshot_path", "")),
       runtime_(runtime), local_info_(local_info), tls_(tls), tls_slot_(tls.allocateSlot()),
       route_config_name_(config.getString("route_config_name")),
       stats_({ALL_RDS_STATS(POOL_COUNTER_PREFIX(scope, stat_prefix + "rds."))}) {
@@ -90,20 +113,26 @@ void RdsRouteConfigProviderImpl::parseResponse(const Http::Message& response) {
   uint64_t new_hash = response_json->hash();
   if (new_hash != last_config_hash_ || !initialized_) {
     response_json->validateSchema(Json::Schema::ROUTE_CONFIGURATION_SCHEMA);
-    ConfigConstSharedPtr new_config(new ConfigImpl(*response_json, runtime_, cm_, false));
+    ConfigImplConstSharedPtr new_config(new ConfigImpl(*response_json, runtime_, cm_, false));
     initialized_ = true;
     last_config_hash_ = new_hash;
     stats_.config_reload_.inc();
     log_debug("rds: loading new configuration: config_name={} hash={}", route_config_name_,
               new_hash);
     tls_.runOnAllThreads([this, new_config]() -> void {
-      tls_.getTyped<ThreadLocalConfig>(tls_slot_).config_ = new_config;
+      // Each worker starts over with an empty route cache for the new configuration.
+      tls_.getTyped<ThreadLocalConfig>(tls_slot_).config_ = RouteCacheImpl::forWorker(new_config);
     });
   }
 
   stats_.update_success_.inc();
 }
 
+void RdsRouteConfigProviderImpl::onResponseUnchanged(const Http::Message&) {
+  log_debug("rds: response unchanged");
+  stats_.update_success_.inc();
+}
+
 void RdsRouteConfigProviderImpl::onFetchComplete() {
   if (initialize_callback_) {
     initialize_callback_();
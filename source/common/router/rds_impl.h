@@ -34,18 +34,34 @@ public:
 };
 
 /**
- * Implementation of RouteConfigProvider that holds a static route configuration.
+ * The route configuration used by a single worker.
+ */
+struct ThreadLocalConfig : public ThreadLocal::ThreadLocalObject {
+  ThreadLocalConfig(ConfigConstSharedPtr initial_config) : config_(initial_config) {}
+
+  // ThreadLocal::ThreadLocalObject
+  void shutdown() override {}
+
+  ConfigConstSharedPtr config_;
+};
+
+/**
+ * Implementation of RouteConfigProvider that holds a static route configuration. If the
+ * configuration enables route caching each worker gets its own cache.
  */
 class StaticRouteConfigProviderImpl : public RouteConfigProvider {
 public:
   StaticRouteConfigProviderImpl(const Json::Object& config, Runtime::Loader& runtime,
-                                Upstream::ClusterManager& cm);
+                                Upstream::ClusterManager& cm, ThreadLocal::Instance& tls);
 
   // Router::RouteConfigProvider
-  Router::ConfigConstSharedPtr config() override { return config_; }
+  Router::ConfigConstSharedPtr config() override;
 
 private:
   ConfigConstSharedPtr config_;
+  ThreadLocal::Instance& tls_;
+  bool use_tls_{};
+  uint32_t tls_slot_{};
 };
 
 /**
@@ -87,19 +103,11 @@ public:
   // Http::RestApiFetcher
   void createRequest(Http::Message& request) override;
   void parseResponse(const Http::Message& response) override;
+  void onResponseUnchanged(const Http::Message& response) override;
   void onFetchComplete() override;
   void onFetchFailure(EnvoyException* e) override;
 
 private:
-  struct ThreadLocalConfig : public ThreadLocal::ThreadLocalObject {
-    ThreadLocalConfig(ConfigConstSharedPtr initial_config) : config_(initial_config) {}
-
-    // ThreadLocal::ThreadLocalObject
-    void shutdown() override {}
-
-    ConfigConstSharedPtr config_;
-  };
-
   RdsRouteConfigProviderImpl(const Json::Object& config, Runtime::Loader& runtime,
                              Upstream::ClusterManager& cm, Event::Dispatcher& dispatcher,
                              Runtime::RandomGenerator& random,
@@ -10,6 +10,7 @@
 #include "common/http/codes.h"
 #include "common/http/headers.h"
 #include "common/http/utility.h"
+#include "common/runtime/key_registry.h"
 
 namespace Envoy {
 namespace Router {
@@ -20,6 +21,12 @@ const uint32_t RetryPolicy::RETRY_ON_5XX;
 const uint32_t RetryPolicy::RETRY_ON_CONNECT_FAILURE;
 const uint32_t RetryPolicy::RETRY_ON_RETRIABLE_4XX;
 
+static const Runtime::Key RuntimeBaseRetryBackoff =
+    Runtime::KeyRegistry::registerKey("upstream.base_retry_backoff_ms");
+static const Runtime::Key RuntimeUseRetry = Runtime::KeyRegistry::registerKey("upstream.use_retry");
+static const Runtime::Key RuntimeUseHedging =
+    Runtime::KeyRegistry::registerKey("upstream.use_hedging");
+
 RetryStatePtr RetryStateImpl::create(const RetryPolicy& route_policy,
                                      Http::HeaderMap& request_headers,
                                      const Upstream::ClusterInfo& cluster, Runtime::Loader& runtime,
@@ -29,7 +36,8 @@ RetryStatePtr RetryStateImpl::create(const RetryPolicy& route_policy,
   RetryStatePtr ret;
 
   // We short circuit here and do not both with an allocation if there is no chance we will retry.
-  if (request_headers.EnvoyRetryOn() || route_policy.retryOn()) {
+  if (request_headers.EnvoyRetryOn() || route_policy.retryOn() ||
+      route_policy.hedgeDelay().count() > 0) {
     ret.reset(new RetryStateImpl(route_policy, request_headers, cluster, runtime, random,
                                  dispatcher, priority));
   }
@@ -44,7 +52,7 @@ RetryStateImpl::RetryStateImpl(const RetryPolicy& route_policy, Http::HeaderMap&
                                Runtime::RandomGenerator& random, Event::Dispatcher& dispatcher,
                                Upstream::ResourcePriority priority)
     : cluster_(cluster), runtime_(runtime), random_(random), dispatcher_(dispatcher),
-      priority_(priority) {
+      priority_(priority), hedging_enabled_(route_policy.hedgeDelay().count() > 0) {
 
   if (request_headers.EnvoyRetryOn()) {
     retry_on_ = parseRetryOn(request_headers.EnvoyRetryOn()->value().c_str());
@@ -62,13 +70,21 @@ RetryStateImpl::RetryStateImpl(const RetryPolicy& route_policy, Http::HeaderMap&
   retries_remaining_ = std::max(retries_remaining_, route_policy.numRetries());
 }
 
-RetryStateImpl::~RetryStateImpl() { resetRetry(); }
+RetryStateImpl::~RetryStateImpl() {
+  resetRetry();
+
+  // An outstanding hedge holds its retry resource until the first response or the end of the
+  // request, both of which destroy the retry state.
+  if (hedge_active_) {
+    cluster_.resourceManager(priority_).retries().dec();
+  }
+}
 
 void RetryStateImpl::enableBackoffTimer() {
   // We use a fully jittered exponential backoff algorithm.
   current_retry_++;
   uint32_t multiplier = (1 << current_retry_) - 1;
-  uint64_t base = runtime_.snapshot().getInteger("upstream.base_retry_backoff_ms", 25);
+  uint64_t base = runtime_.snapshot().getInteger(RuntimeBaseRetryBackoff, 25);
   uint64_t timeout = random_.random() % (base * multiplier);
 
   if (!retry_timer_) {
@@ -118,7 +134,7 @@ bool RetryStateImpl::shouldRetry(const Http::HeaderMap* response_headers,
     return false;
   }
 
-  if (!runtime_.snapshot().featureEnabled("upstream.use_retry", 100)) {
+  if (!runtime_.snapshot().featureEnabled(RuntimeUseRetry, 100)) {
     return false;
   }
 
@@ -140,6 +156,27 @@ bool RetryStateImpl::shouldRetry(const Http::HeaderMap* response_headers,
   return true;
 }
 
+bool RetryStateImpl::shouldHedge() {
+  if (!hedging_enabled_ || hedge_active_ || retries_remaining_ == 0) {
+    return false;
+  }
+
+  if (!runtime_.snapshot().featureEnabled(RuntimeUseHedging, 100)) {
+    return false;
+  }
+
+  if (!cluster_.resourceManager(priority_).retries().canCreate()) {
+    cluster_.stats().upstream_rq_hedge_overflow_.inc();
+    return false;
+  }
+
+  retries_remaining_--;
+  hedge_active_ = true;
+  cluster_.resourceManager(priority_).retries().inc();
+  cluster_.stats().upstream_rq_hedge_.inc();
+  return true;
+}
+
 bool RetryStateImpl::wouldRetry(const Http::HeaderMap* response_headers,
                                 const Optional<Http::StreamResetReason>& reset_reason) {
   if (retry_on_ & RetryPolicy::RETRY_ON_5XX) {
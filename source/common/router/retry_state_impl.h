@@ -28,10 +28,11 @@ public:
   static uint32_t parseRetryOn(const std::string& config);
 
   // Router::RetryState
-  bool enabled() override { return retry_on_ != 0; }
+  bool enabled() override { return retry_on_ != 0 || hedging_enabled_; }
   bool shouldRetry(const Http::HeaderMap* response_headers,
                    const Optional<Http::StreamResetReason>& reset_reason,
                    DoRetryCallback callback) override;
+  bool shouldHedge() override;
 
 private:
   RetryStateImpl(const RetryPolicy& route_policy, Http::HeaderMap& request_headers,
@@ -54,6 +55,8 @@ private:
   DoRetryCallback callback_;
   Event::TimerPtr retry_timer_;
   Upstream::ResourcePriority priority_;
+  const bool hedging_enabled_;
+  bool hedge_active_{};
 };
 
 } // Router
@@ -0,0 +1,47 @@
+#include "common/router/route_cache_impl.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace Envoy {
+namespace Router {
+
+RouteCacheImpl::RouteCacheImpl(ConfigImplConstSharedPtr config)
+    : config_(config), max_entries_(config->routeCacheSize()) {}
+
+ConfigConstSharedPtr RouteCacheImpl::forWorker(ConfigImplConstSharedPtr config) {
+  if (config->routeCacheSize() == 0) {
+    return config;
+  }
+
+  return std::make_shared<RouteCacheImpl>(config);
+}
+
+RouteConstSharedPtr RouteCacheImpl::route(const Http::HeaderMap& headers,
+                                          uint64_t random_value) const {
+  std::string key = config_->routeCacheKey(headers);
+  auto it = entries_.find(key);
+  if (it != entries_.end()) {
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->route_;
+  }
+
+  bool cacheable;
+  RouteConstSharedPtr route = config_->route(headers, random_value, cacheable);
+  if (!cacheable) {
+    return route;
+  }
+
+  if (entries_.size() == max_entries_) {
+    entries_.erase(lru_.back().key_);
+    lru_.pop_back();
+  }
+
+  lru_.push_front({key, route});
+  entries_.emplace(std::move(key), lru_.begin());
+  return route;
+}
+
+} // Router
+} // Envoy
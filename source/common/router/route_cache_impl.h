@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include "envoy/router/router.h"
+
+#include "common/router/config_impl.h"
+
+namespace Envoy {
+namespace Router {
+
+/**
+ * A Config that remembers the routes chosen for recently seen requests. Lookups are keyed on
+ * ConfigImpl::routeCacheKey() and only routes that ConfigImpl reports as cacheable are stored,
+ * so requests that hit a runtime or weighted cluster choice are always routed from scratch. The
+ * least recently used entry is evicted once the cache is full.
+ *
+ * The cache is not thread safe. Each worker wraps the shared ConfigImpl in its own instance, and a
+ * new instance is created whenever the route configuration changes so stale entries are never
+ * returned.
+ */
+class RouteCacheImpl : public Config {
+public:
+  RouteCacheImpl(ConfigImplConstSharedPtr config);
+
+  /**
+   * @return ConfigConstSharedPtr the configuration a worker should use: a new cache wrapping the
+   *         configuration if it enables route caching, or the configuration itself otherwise.
+   */
+  static ConfigConstSharedPtr forWorker(ConfigImplConstSharedPtr config);
+
+  /**
+   * @return the number of routes that are currently cached.
+   */
+  size_t size() const { return entries_.size(); }
+
+  // Router::Config
+  RouteConstSharedPtr route(const Http::HeaderMap& headers, uint64_t random_value) const override;
+
+  const std::list<Http::LowerCaseString>& internalOnlyHeaders() const override {
+    return config_->internalOnlyHeaders();
+  }
+
+  const std::list<std::pair<Http::LowerCaseString, std::string>>&
+  responseHeadersToAdd() const override {
+    return config_->responseHeadersToAdd();
+  }
+
+  const std::list<Http::LowerCaseString>& responseHeadersToRemove() const override {
+    return config_->responseHeadersToRemove();
+  }
+
+  bool usesRuntime() const override { return config_->usesRuntime(); }
+
+private:
+  struct Entry {
+    std::string key_;
+    RouteConstSharedPtr route_;
+  };
+
+  typedef std::list<Entry> EntryList;
+
+  const ConfigImplConstSharedPtr config_;
+  const size_t max_entries_;
+  // Entries ordered from most to least recently used.
+  mutable EntryList lru_;
+  mutable std::unordered_map<std::string, EntryList::iterator> entries_;
+};
+
+} // Router
+} // Envoy
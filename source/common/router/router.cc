@@ -1,8 +1,11 @@
 #include "common/router/router.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "envoy/event/dispatcher.h"
 #include "envoy/event/timer.h"
@@ -12,6 +15,7 @@
 #include "envoy/upstream/cluster_manager.h"
 #include "envoy/upstream/upstream.h"
 
+#include "common/buffer/buffer_impl.h"
 #include "common/common/assert.h"
 #include "common/common/empty_string.h"
 #include "common/common/enum_to_int.h"
@@ -19,14 +23,44 @@
 #include "common/http/codes.h"
 #include "common/http/header_map_impl.h"
 #include "common/http/headers.h"
-#include "common/http/message_impl.h"
 #include "common/http/utility.h"
+#include "common/memory/accounting.h"
 #include "common/router/config_impl.h"
 #include "common/router/retry_state_impl.h"
 
 namespace Envoy {
 namespace Router {
 
+namespace {
+
+// References one slice of a response body that is sent to several downstream requests. The body
+// is freed once every request is done with it.
+class SharedSliceFragment : public Buffer::BufferFragment {
+public:
+  SharedSliceFragment(std::shared_ptr<const Buffer::Instance> body, const Buffer::RawSlice& slice)
+      : body_(body), slice_(slice) {}
+
+  // Buffer::BufferFragment
+  const void* data() const override { return slice_.mem_; }
+  size_t size() const override { return slice_.len_; }
+  void done() override { delete this; }
+
+private:
+  const std::shared_ptr<const Buffer::Instance> body_;
+  const Buffer::RawSlice slice_;
+};
+
+void addSharedBody(Buffer::Instance& buffer, std::shared_ptr<const Buffer::Instance> body) {
+  uint64_t num_slices = body->getRawSlices(nullptr, 0);
+  Buffer::RawSlice slices[num_slices];
+  body->getRawSlices(slices, num_slices);
+  for (const Buffer::RawSlice& slice : slices) {
+    buffer.addBufferFragment(*new SharedSliceFragment(body, slice));
+  }
+}
+
+} // namespace
+
 void FilterUtility::setUpstreamScheme(Http::HeaderMap& headers,
                                       const Upstream::ClusterInfo& cluster) {
   if (cluster.sslContext()) {
@@ -92,10 +126,64 @@ FilterUtility::TimeoutData FilterUtility::finalTimeout(const RouteEntry& route,
   return timeout;
 }
 
+RequestCoalescer::RequestCoalescer(ThreadLocal::Instance& tls,
+                                   const std::vector<Http::LowerCaseString>& vary_headers)
+    : tls_(tls), tls_slot_(tls.allocateSlot()), vary_headers_(vary_headers) {
+  tls.set(tls_slot_, [](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+    return std::make_shared<ThreadLocalLeaders>();
+  });
+}
+
+std::string RequestCoalescer::key(const Http::HeaderMap& headers,
+                                  const std::string& cluster_name) const {
+  const Http::HeaderString& method = headers.Method()->value();
+  if (method != Http::Headers::get().MethodValues.Get.c_str() &&
+      method != Http::Headers::get().MethodValues.Head.c_str()) {
+    return "";
+  }
+
+  // Responses to requests with credentials are only shared if the credentials must match.
+  for (const Http::LowerCaseString* credentials :
+       {&Http::Headers::get().Authorization, &Http::Headers::get().Cookie}) {
+    if (headers.get(*credentials) &&
+        std::find(vary_headers_.begin(), vary_headers_.end(), *credentials) ==
+            vary_headers_.end()) {
+      return "";
+    }
+  }
+
+  // Header values cannot contain a newline, so it separates the parts of the key unambiguously.
+  std::string key = cluster_name + "\n" + method.c_str() + "\n" + headers.Host()->value().c_str() +
+                    "\n" + headers.Path()->value().c_str();
+  for (const Http::LowerCaseString& vary_header : vary_headers_) {
+    const Http::HeaderEntry* entry = headers.get(vary_header);
+    key += entry ? std::string("\n=") + entry->value().c_str() : "\n";
+  }
+
+  return key;
+}
+
+Filter* RequestCoalescer::leader(const std::string& key) {
+  ThreadLocalLeaders& leaders = tls_.getTyped<ThreadLocalLeaders>(tls_slot_);
+  auto it = leaders.leaders_.find(key);
+  return it == leaders.leaders_.end() ? nullptr : it->second;
+}
+
+void RequestCoalescer::setLeader(const std::string& key, Filter& filter) {
+  tls_.getTyped<ThreadLocalLeaders>(tls_slot_).leaders_[key] = &filter;
+}
+
+void RequestCoalescer::removeLeader(const std::string& key) {
+  tls_.getTyped<ThreadLocalLeaders>(tls_slot_).leaders_.erase(key);
+}
+
 Filter::~Filter() {
   // Upstream resources should already have been cleaned.
   ASSERT(!upstream_request_);
   ASSERT(!retry_state_);
+  ASSERT(leader_key_.empty());
+  ASSERT(followers_.empty());
+  ASSERT(!leader_);
 }
 
 const std::string& Filter::upstreamZone(Upstream::HostDescriptionConstSharedPtr upstream_host) {
@@ -116,7 +204,8 @@ void Filter::chargeUpstreamCode(const Http::HeaderMap& response_headers,
         config_.global_store_, cluster_->statsScope(), EMPTY_STRING, response_headers,
         internal_request, route_entry_->virtualHost().name(),
         request_vcluster_ ? request_vcluster_->name() : EMPTY_STRING,
-        config_.local_info_.zoneName(), upstreamZone(upstream_host), is_canary};
+        config_.local_info_.zoneName(), upstreamZone(upstream_host), is_canary,
+        &cluster_->codeStats(), request_vcluster_ ? &request_vcluster_->codeStats() : nullptr};
 
     Http::CodeUtility::chargeResponseStat(info);
 
@@ -124,7 +213,7 @@ void Filter::chargeUpstreamCode(const Http::HeaderMap& response_headers,
       Http::CodeUtility::ResponseStatInfo info{
           config_.global_store_, cluster_->statsScope(), alt_stat_prefix_, response_headers,
           internal_request, EMPTY_STRING, EMPTY_STRING, config_.local_info_.zoneName(),
-          upstreamZone(upstream_host), is_canary};
+          upstreamZone(upstream_host), is_canary, nullptr, nullptr};
 
       Http::CodeUtility::chargeResponseStat(info);
     }
@@ -167,18 +256,61 @@ Http::FilterHeadersStatus Filter::decodeHeaders(Http::HeaderMap& headers, bool e
 
   // A route entry matches for the request.
   route_entry_ = route_->routeEntry();
-  Upstream::ThreadLocalCluster* cluster = config_.cm_.get(route_entry_->clusterName());
+  Upstream::ThreadLocalCluster* cluster = getThreadLocalCluster();
   if (!cluster) {
-    config_.stats_.no_cluster_.inc();
-    stream_log_debug("unknown cluster '{}'", *callbacks_, route_entry_->clusterName());
+    // The cluster may be fetched on demand, in which case the request waits for it.
+    cluster_discovery_ = config_.cm_.discoverCluster(
+        route_entry_->clusterName(), [this]() -> void { onClusterDiscoveryComplete(); });
+    if (cluster_discovery_) {
+      stream_log_debug("waiting for the discovery of cluster '{}'", *callbacks_,
+                       route_entry_->clusterName());
+      config_.stats_.rq_cluster_discovery_.inc();
+      discovery_end_stream_ = end_stream;
+      return Http::FilterHeadersStatus::StopIteration;
+    }
 
-    callbacks_->requestInfo().setResponseFlag(Http::AccessLog::ResponseFlag::NoRouteFound);
-    Http::HeaderMapPtr response_headers{new Http::HeaderMapImpl{
-        {Http::Headers::get().Status, std::to_string(enumToInt(Http::Code::NotFound))}}};
-    callbacks_->encodeHeaders(std::move(response_headers), true);
+    sendNoClusterResponse();
     return Http::FilterHeadersStatus::StopIteration;
   }
-  cluster_ = cluster->info();
+
+  routeRequest(*cluster, end_stream);
+  return Http::FilterHeadersStatus::StopIteration;
+}
+
+void Filter::sendNoClusterResponse() {
+  config_.stats_.no_cluster_.inc();
+  stream_log_debug("unknown cluster '{}'", *callbacks_, route_entry_->clusterName());
+
+  callbacks_->requestInfo().setResponseFlag(Http::AccessLog::ResponseFlag::NoRouteFound);
+  Http::HeaderMapPtr response_headers{new Http::HeaderMapImpl{
+      {Http::Headers::get().Status, std::to_string(enumToInt(Http::Code::NotFound))}}};
+  callbacks_->encodeHeaders(std::move(response_headers), true);
+}
+
+void Filter::onClusterDiscoveryComplete() {
+  cluster_discovery_ = nullptr;
+  Upstream::ThreadLocalCluster* cluster = getThreadLocalCluster();
+  if (!cluster) {
+    sendNoClusterResponse();
+    return;
+  }
+
+  // The body and trailers that arrived in the meantime were buffered. They are sent as if they
+  // arrived now, once the upstream request has started.
+  const Buffer::Instance* buffered_body = callbacks_->decodingBuffer();
+  routeRequest(*cluster, discovery_end_stream_ && !buffered_body && !downstream_trailers_);
+  if (upstream_request_ && buffered_body) {
+    Buffer::OwnedImpl data(*buffered_body);
+    decodeData(data, discovery_end_stream_ && !downstream_trailers_);
+  }
+  if (upstream_request_ && downstream_trailers_) {
+    decodeTrailers(*downstream_trailers_);
+  }
+}
+
+void Filter::routeRequest(Upstream::ThreadLocalCluster& cluster, bool end_stream) {
+  Http::HeaderMap& headers = *downstream_headers_;
+  cluster_ = cluster.info();
 
   // Set up stat prefixes, etc.
   request_vcluster_ = route_entry_->virtualCluster(headers);
@@ -197,22 +329,28 @@ Http::FilterHeadersStatus Filter::decodeHeaders(Http::HeaderMap& headers, bool e
     chargeUpstreamCode(Http::Code::ServiceUnavailable, nullptr);
     Http::Utility::sendLocalReply(*callbacks_, Http::Code::ServiceUnavailable, "maintenance mode");
     cluster_->stats().upstream_rq_maintenance_mode_.inc();
-    return Http::FilterHeadersStatus::StopIteration;
+    return;
   }
 
-  // See if we need to set up for hashing.
+  // See if we need to set up for hashing, subset selection, original destination or dynamic
+  // forward proxy routing.
+  Optional<uint64_t> hash;
   if (route_entry_->hashPolicy()) {
-    Optional<uint64_t> hash = route_entry_->hashPolicy()->generateHash(headers);
-    if (hash.valid()) {
-      lb_context_.reset(new LoadBalancerContextImpl(hash));
-    }
+    hash = route_entry_->hashPolicy()->generateHash(headers);
+  }
+  const Upstream::HostMetadata& metadata_match = route_entry_->metadataMatchCriteria();
+  if (hash.valid() || !metadata_match.empty() ||
+      cluster_->lbType() == Upstream::LoadBalancerType::OriginalDst ||
+      cluster_->lbType() == Upstream::LoadBalancerType::DynamicForwardProxy) {
+    lb_context_.reset(
+        new LoadBalancerContextImpl(hash, metadata_match, callbacks_->connection(), &headers));
   }
 
   // Fetch a connection pool for the upstream cluster.
   Http::ConnectionPool::Instance* conn_pool = getConnPool();
   if (!conn_pool) {
     sendNoHealthyUpstreamResponse();
-    return Http::FilterHeadersStatus::StopIteration;
+    return;
   }
 
   timeout_ = FilterUtility::finalTimeout(*route_entry_, headers);
@@ -225,6 +363,18 @@ Http::FilterHeadersStatus Filter::decodeHeaders(Http::HeaderMap& headers, bool e
 
   route_entry_->finalizeRequestHeaders(headers);
   FilterUtility::setUpstreamScheme(headers, *cluster_);
+
+  // Only requests without a body are coalesced, since telling whether two bodies are identical
+  // would mean buffering them.
+  if (end_stream && maybeCoalesce()) {
+    return;
+  }
+
+  sendUpstreamRequest(*conn_pool, end_stream);
+}
+
+void Filter::sendUpstreamRequest(Http::ConnectionPool::Instance& conn_pool, bool end_stream) {
+  Http::HeaderMap& headers = *downstream_headers_;
   retry_state_ = createRetryState(route_entry_->retryPolicy(), headers, *cluster_, config_.runtime_,
                                   config_.random_, callbacks_->dispatcher(), finalPriority());
   do_shadowing_ = FilterUtility::shouldShadow(route_entry_->shadowPolicy(), config_.runtime_,
@@ -244,31 +394,144 @@ Http::FilterHeadersStatus Filter::decodeHeaders(Http::HeaderMap& headers, bool e
   ASSERT(headers.Host());
   ASSERT(headers.Path());
 
-  upstream_request_.reset(new UpstreamRequest(*this, *conn_pool));
+  callbacks_->addDownstreamWatermarkCallbacks(downstream_watermark_callbacks_);
+  upstream_request_.reset(new UpstreamRequest(*this, conn_pool));
   upstream_request_->encodeHeaders(end_stream);
+  // Possible that we got an immediate reset. Even then we could still shadow, but that is a riskier
+  // change and seems unnecessary right now.
+  if (upstream_request_) {
+    maybeStartShadowing(end_stream);
+  }
   if (end_stream) {
     onRequestComplete();
   }
+}
 
-  return Http::FilterHeadersStatus::StopIteration;
+bool Filter::maybeCoalesce() {
+  RequestCoalescer* coalescer = config_.coalescer();
+  if (!coalescer) {
+    return false;
+  }
+
+  const std::string key = coalescer->key(*downstream_headers_, cluster_->name());
+  if (key.empty()) {
+    return false;
+  }
+
+  Filter* leader = coalescer->leader(key);
+  if (!leader) {
+    leader_key_ = key;
+    coalescer->setLeader(key, *this);
+    return false;
+  }
+
+  stream_log_debug("waiting for the response of an identical request", *callbacks_);
+  config_.stats_.rq_coalesced_.inc();
+  leader_ = leader;
+  follower_position_ = leader->followers_.insert(leader->followers_.end(), this);
+  return true;
+}
+
+void Filter::onLeaderGone() {
+  // The request this one waited for went away before its response started. This one is sent
+  // upstream instead, on behalf of the requests that are still waiting if it is the first of them.
+  if (maybeCoalesce()) {
+    return;
+  }
+
+  Http::ConnectionPool::Instance* conn_pool = getConnPool();
+  if (!conn_pool) {
+    sendNoHealthyUpstreamResponse();
+    return;
+  }
+
+  sendUpstreamRequest(*conn_pool, true);
+}
+
+void Filter::stopLeading() {
+  // Identical requests that arrive from now on cannot share the response.
+  if (!leader_key_.empty()) {
+    config_.coalescer()->removeLeader(leader_key_);
+    leader_key_.clear();
+  }
+}
+
+void Filter::forEachFollower(const FollowerCb& cb) {
+  // Sending to a follower can destroy it or other followers. Destroyed followers remove themselves
+  // from the list and move next_follower_ past themselves.
+  next_follower_ = followers_.begin();
+  while (next_follower_ != followers_.end()) {
+    Filter& follower = **next_follower_++;
+    cb(follower);
+  }
+}
+
+void Filter::releaseFollowers(const FollowerCb& cb) {
+  // Followers are detached before the callback so that they are on their own if it destroys them.
+  while (!followers_.empty()) {
+    Filter& follower = *followers_.front();
+    followers_.pop_front();
+    follower.leader_ = nullptr;
+    cb(follower);
+  }
+  next_follower_ = followers_.end();
+}
+
+Upstream::ThreadLocalCluster* Filter::getThreadLocalCluster() {
+  const Optional<Upstream::ClusterId>& cluster_id = route_entry_->clusterId();
+  if (cluster_id.valid()) {
+    return config_.cm_.getById(cluster_id.value());
+  }
+
+  return config_.cm_.get(route_entry_->clusterName());
 }
 
 Http::ConnectionPool::Instance* Filter::getConnPool() {
-  return config_.cm_.httpConnPoolForCluster(route_entry_->clusterName(), finalPriority(),
-                                            lb_context_.get());
+  // The cluster is looked up again since it may have been removed while waiting for a retry.
+  Upstream::ThreadLocalCluster* cluster = getThreadLocalCluster();
+  if (!cluster) {
+    return nullptr;
+  }
+
+  return cluster->connPool(finalPriority(), lb_context_.get());
 }
 
 void Filter::sendNoHealthyUpstreamResponse() {
+  sendLocalReplyToFollowers(Http::Code::ServiceUnavailable, "no healthy upstream",
+                            Http::AccessLog::ResponseFlag::NoHealthyUpstream);
   callbacks_->requestInfo().setResponseFlag(Http::AccessLog::ResponseFlag::NoHealthyUpstream);
   chargeUpstreamCode(Http::Code::ServiceUnavailable, nullptr);
   Http::Utility::sendLocalReply(*callbacks_, Http::Code::ServiceUnavailable, "no healthy upstream");
 }
 
+void Filter::sendLocalReplyToFollowers(Http::Code code, const std::string& body,
+                                       Http::AccessLog::ResponseFlag response_flag) {
+  // The requests that waited for this one share its failure rather than each trying an upstream
+  // that just failed.
+  stopLeading();
+  releaseFollowers([code, &body, response_flag](Filter& follower) -> void {
+    follower.callbacks_->requestInfo().setResponseFlag(response_flag);
+    Http::Utility::sendLocalReply(*follower.callbacks_, code, body);
+  });
+}
+
 Http::FilterDataStatus Filter::decodeData(Buffer::Instance& data, bool end_stream) {
-  bool buffering = (retry_state_ && retry_state_->enabled()) || do_shadowing_;
+  if (cluster_discovery_) {
+    discovery_end_stream_ = end_stream;
+    return Http::FilterDataStatus::StopIterationAndBuffer;
+  }
+
+  if (shadow_stream_) {
+    shadow_stream_->sendData(data, end_stream);
+    if (end_stream) {
+      shadow_stream_ = nullptr;
+    }
+  }
 
-  // If we are going to buffer for retries or shadowing, we need to make a copy before encoding
-  // since it's all moves from here on.
+  bool buffering = retry_state_ && retry_state_->enabled();
+
+  // If we are going to buffer for retries, we need to make a copy before encoding since it's all
+  // moves from here on.
   if (buffering) {
     Buffer::OwnedImpl copy(data);
     upstream_request_->encodeData(copy, end_stream);
@@ -280,13 +543,22 @@ Http::FilterDataStatus Filter::decodeData(Buffer::Instance& data, bool end_strea
     onRequestComplete();
   }
 
-  // If we are potentially going to retry or shadow this request we need to buffer.
+  // If we are potentially going to retry this request we need to buffer.
   return buffering ? Http::FilterDataStatus::StopIterationAndBuffer
                    : Http::FilterDataStatus::StopIterationNoBuffer;
 }
 
 Http::FilterTrailersStatus Filter::decodeTrailers(Http::HeaderMap& trailers) {
   downstream_trailers_ = &trailers;
+  if (cluster_discovery_) {
+    discovery_end_stream_ = true;
+    return Http::FilterTrailersStatus::StopIteration;
+  }
+
+  if (shadow_stream_) {
+    shadow_stream_->sendTrailers(trailers);
+    shadow_stream_ = nullptr;
+  }
   upstream_request_->encodeTrailers(trailers);
   onRequestComplete();
   return Http::FilterTrailersStatus::StopIteration;
@@ -294,11 +566,19 @@ Http::FilterTrailersStatus Filter::decodeTrailers(Http::HeaderMap& trailers) {
 
 void Filter::cleanup() {
   upstream_request_.reset();
+  if (hedge_request_) {
+    hedge_request_->resetStream();
+    hedge_request_.reset();
+  }
   retry_state_.reset();
   if (response_timeout_) {
     response_timeout_->disableTimer();
     response_timeout_.reset();
   }
+  if (hedge_timer_) {
+    hedge_timer_->disableTimer();
+    hedge_timer_.reset();
+  }
 }
 
 Upstream::ResourcePriority Filter::finalPriority() {
@@ -310,50 +590,149 @@ Upstream::ResourcePriority Filter::finalPriority() {
   }
 }
 
-void Filter::maybeDoShadowing() {
+void Filter::maybeStartShadowing(bool end_stream) {
   if (!do_shadowing_) {
     return;
   }
 
+  // The body is forwarded as it arrives rather than buffered until the request is complete.
   ASSERT(!route_entry_->shadowPolicy().cluster().empty());
-  Http::MessagePtr request(new Http::RequestMessageImpl(
-      Http::HeaderMapPtr{new Http::HeaderMapImpl(*downstream_headers_)}));
-  if (callbacks_->decodingBuffer()) {
-    request->body().reset(new Buffer::OwnedImpl(*callbacks_->decodingBuffer()));
-  }
-  if (downstream_trailers_) {
-    request->trailers(Http::HeaderMapPtr{new Http::HeaderMapImpl(*downstream_trailers_)});
-  }
-
-  config_.shadowWriter().shadow(route_entry_->shadowPolicy().cluster(), std::move(request),
-                                timeout_.global_timeout_);
+  shadow_stream_ = config_.shadowWriter().streamShadow(
+      route_entry_->shadowPolicy().cluster(),
+      Http::HeaderMapPtr{new Http::HeaderMapImpl(*downstream_headers_)}, end_stream,
+      timeout_.global_timeout_);
 }
 
 void Filter::onRequestComplete() {
   downstream_end_stream_ = true;
-  downstream_request_complete_time_ = std::chrono::steady_clock::now();
+  downstream_request_complete_time_ = callbacks_->dispatcher().loopTimeSource().currentTime();
 
   // Possible that we got an immediate reset.
   if (upstream_request_) {
-    // Even if we got an immediate reset, we could still shadow, but that is a riskier change and
-    // seems unnecessary right now.
-    maybeDoShadowing();
-
     upstream_request_->setupPerTryTimeout();
     if (timeout_.global_timeout_.count() > 0) {
       response_timeout_ =
-          callbacks_->dispatcher().createTimer([this]() -> void { onResponseTimeout(); });
+          callbacks_->dispatcher().createCoarseTimer([this]() -> void { onResponseTimeout(); });
       response_timeout_->enableTimer(timeout_.global_timeout_);
     }
+
+    const std::chrono::milliseconds hedge_delay = route_entry_->retryPolicy().hedgeDelay();
+    if (hedge_delay.count() > 0 && retry_state_) {
+      hedge_timer_ = callbacks_->dispatcher().createTimer([this]() -> void { onHedgeTimeout(); });
+      hedge_timer_->enableTimer(hedge_delay);
+    }
+  }
+}
+
+void Filter::onHedgeTimeout() {
+  // Only the first attempt is hedged, and only while it has not started to respond.
+  if (!upstream_request_ || hedge_request_ || downstream_response_started_ || !retry_state_) {
+    return;
+  }
+
+  // Connection pools are per host, so getting the same pool back means that the load balancer
+  // picked the same host again and a hedge would not help.
+  Http::ConnectionPool::Instance* conn_pool = getConnPool();
+  if (!conn_pool || conn_pool == &upstream_request_->conn_pool_ || !retry_state_->shouldHedge()) {
+    return;
+  }
+
+  stream_log_debug("sending hedged request", *callbacks_);
+  hedge_request_.reset(new UpstreamRequest(*this, *conn_pool));
+  sendBufferedRequest(hedge_request_);
+}
+
+bool Filter::maybeDropHedgedRequest(UpstreamRequest& upstream_request, UpstreamResetType type) {
+  if (!hedge_request_) {
+    return false;
+  }
+
+  // The other request is still running so this failure is not surfaced downstream. The failed
+  // request is destroyed here so the caller must return immediately.
+  stream_log_debug("hedged upstream request failed", *callbacks_);
+  if (upstream_request.upstream_host_) {
+    upstream_request.upstream_host_->outlierDetector().putHttpResponseCode(
+        enumToInt(type == UpstreamResetType::Reset ? Http::Code::ServiceUnavailable
+                                                   : timeout_response_code_));
+  }
+
+  if (&upstream_request == hedge_request_.get()) {
+    hedge_request_.reset();
+  } else {
+    ASSERT(&upstream_request == upstream_request_.get());
+    upstream_request_ = std::move(hedge_request_);
+    if (upstream_request_->upstream_host_) {
+      callbacks_->requestInfo().onUpstreamHostSelected(upstream_request_->upstream_host_);
+    }
+  }
+
+  return true;
+}
+
+void Filter::maybeSelectHedgeWinner(UpstreamRequest& upstream_request) {
+  if (!hedge_request_) {
+    return;
+  }
+
+  if (&upstream_request == hedge_request_.get()) {
+    stream_log_debug("hedged request responded first", *callbacks_);
+    cluster_->stats().upstream_rq_hedge_win_.inc();
+    upstream_request_->resetStream();
+    upstream_request_ = std::move(hedge_request_);
+    callbacks_->requestInfo().onUpstreamHostSelected(upstream_request_->upstream_host_);
+  } else {
+    ASSERT(&upstream_request == upstream_request_.get());
+    hedge_request_->resetStream();
+    hedge_request_.reset();
   }
 }
 
 void Filter::onDestroy() {
+  if (cluster_discovery_) {
+    cluster_discovery_->cancel();
+    cluster_discovery_ = nullptr;
+  }
+
   if (upstream_request_) {
     upstream_request_->resetStream();
   }
 
+  // The primary request was not completed, so neither is the shadow.
+  if (shadow_stream_) {
+    shadow_stream_->cancel();
+    shadow_stream_ = nullptr;
+  }
+
+  if (leader_) {
+    if (leader_->next_follower_ == follower_position_) {
+      leader_->next_follower_++;
+    }
+    leader_->followers_.erase(follower_position_);
+    leader_ = nullptr;
+  }
+
+  // A response that has started cannot be completed for the followers without this request.
+  stopLeading();
+  releaseFollowers([this](Filter& follower) -> void {
+    if (downstream_response_started_) {
+      follower.callbacks_->resetStream();
+    } else {
+      follower.onLeaderGone();
+    }
+  });
+
   cleanup();
+  callbacks_->removeDownstreamWatermarkCallbacks(downstream_watermark_callbacks_);
+}
+
+void Filter::onDownstreamWatermark(bool above_high_watermark) {
+  // Both racing requests read into the same downstream, so both are paused.
+  downstream_above_write_buffer_high_watermark_ = above_high_watermark;
+  for (UpstreamRequest* upstream_request : {upstream_request_.get(), hedge_request_.get()}) {
+    if (upstream_request) {
+      upstream_request->updateReadDisable();
+    }
+  }
 }
 
 void Filter::onResponseTimeout() {
@@ -402,24 +781,24 @@ void Filter::onUpstreamReset(UpstreamResetType type,
   // If we have not yet sent anything downstream, send a response with an appropriate status code.
   // Otherwise just reset the ongoing response.
   if (downstream_response_started_) {
+    releaseFollowers([](Filter& follower) -> void { follower.callbacks_->resetStream(); });
     callbacks_->resetStream();
   } else {
     Http::Code code;
     const char* body;
+    Http::AccessLog::ResponseFlag response_flags;
     if (type == UpstreamResetType::GlobalTimeout || type == UpstreamResetType::PerTryTimeout) {
-      callbacks_->requestInfo().setResponseFlag(
-          Http::AccessLog::ResponseFlag::UpstreamRequestTimeout);
-
+      response_flags = Http::AccessLog::ResponseFlag::UpstreamRequestTimeout;
       code = timeout_response_code_;
       body = code == Http::Code::GatewayTimeout ? "upstream request timeout" : "";
     } else {
-      Http::AccessLog::ResponseFlag response_flags =
-          streamResetReasonToResponseFlag(reset_reason.value());
-      callbacks_->requestInfo().setResponseFlag(response_flags);
+      response_flags = streamResetReasonToResponseFlag(reset_reason.value());
       code = Http::Code::ServiceUnavailable;
       body = "upstream connect error or disconnect/reset before headers";
     }
 
+    sendLocalReplyToFollowers(code, body, response_flags);
+    callbacks_->requestInfo().setResponseFlag(response_flags);
     chargeUpstreamCode(code, upstream_host);
     Http::Utility::sendLocalReply(*callbacks_, code, body);
   }
@@ -470,7 +849,8 @@ void Filter::onUpstreamHeaders(Http::HeaderMapPtr&& headers, bool end_stream) {
   // premature response.
   if (DateUtil::timePointValid(downstream_request_complete_time_)) {
     std::chrono::milliseconds ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::steady_clock::now() - downstream_request_complete_time_);
+        callbacks_->dispatcher().loopTimeSource().currentTime() -
+        downstream_request_complete_time_);
     headers->insertEnvoyUpstreamServiceTime().value(ms.count());
   }
 
@@ -484,6 +864,19 @@ void Filter::onUpstreamHeaders(Http::HeaderMapPtr&& headers, bool end_stream) {
     onUpstreamComplete();
   }
 
+  // The response goes to the requests that waited for this one as well. Identical requests that
+  // arrive from now on have missed its start.
+  stopLeading();
+  const FollowerCb send_headers = [&headers, end_stream](Filter& follower) -> void {
+    follower.callbacks_->encodeHeaders(Http::HeaderMapPtr{new Http::HeaderMapImpl(*headers)},
+                                       end_stream);
+  };
+  if (end_stream) {
+    releaseFollowers(send_headers);
+  } else {
+    forEachFollower(send_headers);
+  }
+
   callbacks_->encodeHeaders(std::move(headers), end_stream);
 }
 
@@ -492,11 +885,31 @@ void Filter::onUpstreamData(Buffer::Instance& data, bool end_stream) {
     onUpstreamComplete();
   }
 
+  if (!followers_.empty()) {
+    // Every request is sent references to the same copy of the data.
+    std::shared_ptr<Buffer::OwnedImpl> body(new Buffer::OwnedImpl());
+    body->move(data);
+    const FollowerCb send_data = [&body, end_stream](Filter& follower) -> void {
+      Buffer::OwnedImpl follower_data;
+      addSharedBody(follower_data, body);
+      follower.callbacks_->encodeData(follower_data, end_stream);
+    };
+    if (end_stream) {
+      releaseFollowers(send_data);
+    } else {
+      forEachFollower(send_data);
+    }
+    addSharedBody(data, body);
+  }
+
   callbacks_->encodeData(data, end_stream);
 }
 
 void Filter::onUpstreamTrailers(Http::HeaderMapPtr&& trailers) {
   onUpstreamComplete();
+  releaseFollowers([&trailers](Filter& follower) -> void {
+    follower.callbacks_->encodeTrailers(Http::HeaderMapPtr{new Http::HeaderMapImpl(*trailers)});
+  });
   callbacks_->encodeTrailers(std::move(trailers));
 }
 
@@ -508,7 +921,8 @@ void Filter::onUpstreamComplete() {
   if (config_.emit_dynamic_stats_ && !callbacks_->requestInfo().healthCheck() &&
       DateUtil::timePointValid(downstream_request_complete_time_)) {
     std::chrono::milliseconds response_time = std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::steady_clock::now() - downstream_request_complete_time_);
+        callbacks_->dispatcher().loopTimeSource().currentTime() -
+        downstream_request_complete_time_);
 
     upstream_request_->upstream_host_->outlierDetector().putResponseTime(response_time);
 
@@ -519,7 +933,8 @@ void Filter::onUpstreamComplete() {
         config_.global_store_, cluster_->statsScope(), EMPTY_STRING, response_time,
         upstream_request_->upstream_canary_, internal_request, route_entry_->virtualHost().name(),
         request_vcluster_ ? request_vcluster_->name() : EMPTY_STRING,
-        config_.local_info_.zoneName(), upstreamZone(upstream_request_->upstream_host_)};
+        config_.local_info_.zoneName(), upstreamZone(upstream_request_->upstream_host_),
+        &cluster_->codeStats(), request_vcluster_ ? &request_vcluster_->codeStats() : nullptr};
 
     Http::CodeUtility::chargeResponseTiming(info);
 
@@ -527,7 +942,8 @@ void Filter::onUpstreamComplete() {
       Http::CodeUtility::ResponseTimingInfo info{
           config_.global_store_, cluster_->statsScope(), alt_stat_prefix_, response_time,
           upstream_request_->upstream_canary_, internal_request, EMPTY_STRING, EMPTY_STRING,
-          config_.local_info_.zoneName(), upstreamZone(upstream_request_->upstream_host_)};
+          config_.local_info_.zoneName(), upstreamZone(upstream_request_->upstream_host_),
+          nullptr, nullptr};
 
       Http::CodeUtility::chargeResponseTiming(info);
     }
@@ -552,6 +968,9 @@ bool Filter::setupRetry(bool end_stream) {
   }
 
   upstream_request_.reset();
+  if (hedge_timer_) {
+    hedge_timer_->disableTimer();
+  }
   return true;
 }
 
@@ -566,20 +985,24 @@ void Filter::doRetry() {
   ASSERT(response_timeout_ || timeout_.global_timeout_.count() == 0);
   ASSERT(!upstream_request_);
   upstream_request_.reset(new UpstreamRequest(*this, *conn_pool));
-  upstream_request_->encodeHeaders(!callbacks_->decodingBuffer() && !downstream_trailers_);
+  sendBufferedRequest(upstream_request_);
+}
+
+void Filter::sendBufferedRequest(UpstreamRequestPtr& upstream_request) {
+  upstream_request->encodeHeaders(!callbacks_->decodingBuffer() && !downstream_trailers_);
   // It's possible we got immediately reset.
-  if (upstream_request_) {
+  if (upstream_request) {
     if (callbacks_->decodingBuffer()) {
       // If we are doing a retry we need to make a copy.
       Buffer::OwnedImpl copy(*callbacks_->decodingBuffer());
-      upstream_request_->encodeData(copy, !downstream_trailers_);
+      upstream_request->encodeData(copy, !downstream_trailers_);
     }
 
     if (downstream_trailers_) {
-      upstream_request_->encodeTrailers(*downstream_trailers_);
+      upstream_request->encodeTrailers(*downstream_trailers_);
     }
 
-    upstream_request_->setupPerTryTimeout();
+    upstream_request->setupPerTryTimeout();
   }
 }
 
@@ -588,9 +1011,19 @@ Filter::UpstreamRequest::~UpstreamRequest() {
     // Allows for testing.
     per_try_timeout_->disableTimer();
   }
+
+  // Leave neither side paused on behalf of a request that is gone. For HTTP/1 the upstream
+  // connection goes back to the pool and must read the next response.
+  if (read_disabled_ && request_encoder_) {
+    request_encoder_->getStream().readDisable(false);
+  }
+  if (above_write_buffer_high_watermark_) {
+    parent_.callbacks_->onDecoderFilterBelowWriteBufferLowWatermark();
+  }
 }
 
 void Filter::UpstreamRequest::decodeHeaders(Http::HeaderMapPtr&& headers, bool end_stream) {
+  parent_.maybeSelectHedgeWinner(*this);
   parent_.onUpstreamHeaders(std::move(headers), end_stream);
 }
 
@@ -603,6 +1036,9 @@ void Filter::UpstreamRequest::decodeTrailers(Http::HeaderMapPtr&& trailers) {
 }
 
 void Filter::UpstreamRequest::encodeHeaders(bool end_stream) {
+  // The connection manager has the request being decoded in scope, unless the connection pool
+  // calls back later.
+  Memory::RequestPhaseScope phase(Memory::RequestPhase::UpstreamEncode);
   ASSERT(!encode_complete_);
   encode_complete_ = end_stream;
 
@@ -616,6 +1052,7 @@ void Filter::UpstreamRequest::encodeHeaders(bool end_stream) {
 }
 
 void Filter::UpstreamRequest::encodeData(Buffer::Instance& data, bool end_stream) {
+  Memory::RequestPhaseScope phase(Memory::RequestPhase::UpstreamEncode);
   ASSERT(!encode_complete_);
   encode_complete_ = end_stream;
 
@@ -633,6 +1070,7 @@ void Filter::UpstreamRequest::encodeData(Buffer::Instance& data, bool end_stream
 }
 
 void Filter::UpstreamRequest::encodeTrailers(const Http::HeaderMap& trailers) {
+  Memory::RequestPhaseScope phase(Memory::RequestPhase::UpstreamEncode);
   ASSERT(!encode_complete_);
   encode_complete_ = true;
   encode_trailers_ = true;
@@ -647,11 +1085,41 @@ void Filter::UpstreamRequest::encodeTrailers(const Http::HeaderMap& trailers) {
 
 void Filter::UpstreamRequest::onResetStream(Http::StreamResetReason reason) {
   request_encoder_ = nullptr;
-  if (!calling_encode_headers_) {
+  if (calling_encode_headers_) {
+    deferred_reset_reason_ = reason;
+  } else if (!parent_.maybeDropHedgedRequest(*this, UpstreamResetType::Reset)) {
     parent_.onUpstreamReset(UpstreamResetType::Reset, Optional<Http::StreamResetReason>(reason));
+  }
+}
+
+void Filter::UpstreamRequest::onAboveWriteBufferHighWatermark() {
+  // The upstream cannot take the request as fast as it arrives, so stop reading it.
+  ASSERT(!above_write_buffer_high_watermark_);
+  above_write_buffer_high_watermark_ = true;
+  parent_.cluster_->stats().upstream_flow_control_backed_up_total_.inc();
+  parent_.callbacks_->onDecoderFilterAboveWriteBufferHighWatermark();
+}
+
+void Filter::UpstreamRequest::onBelowWriteBufferLowWatermark() {
+  ASSERT(above_write_buffer_high_watermark_);
+  above_write_buffer_high_watermark_ = false;
+  parent_.cluster_->stats().upstream_flow_control_drained_total_.inc();
+  parent_.callbacks_->onDecoderFilterBelowWriteBufferLowWatermark();
+}
+
+void Filter::UpstreamRequest::updateReadDisable() {
+  const bool disable = parent_.downstream_above_write_buffer_high_watermark_;
+  if (!request_encoder_ || disable == read_disabled_) {
+    return;
+  }
+
+  read_disabled_ = disable;
+  if (disable) {
+    parent_.cluster_->stats().upstream_flow_control_paused_reading_total_.inc();
   } else {
-    deferred_reset_reason_ = reason;
+    parent_.cluster_->stats().upstream_flow_control_resumed_reading_total_.inc();
   }
+  request_encoder_->getStream().readDisable(disable);
 }
 
 void Filter::UpstreamRequest::resetStream() {
@@ -664,6 +1132,8 @@ void Filter::UpstreamRequest::resetStream() {
 
   if (request_encoder_) {
     stream_log_debug("resetting pool request", *parent_.callbacks_);
+    // The stream goes away with the reset, so there is nothing left to read to enable again.
+    read_disabled_ = false;
     request_encoder_->getStream().removeCallbacks(*this);
     request_encoder_->getStream().resetStream(Http::StreamResetReason::LocalReset);
   }
@@ -683,6 +1153,10 @@ void Filter::UpstreamRequest::onPerTryTimeout() {
   parent_.cluster_->stats().upstream_rq_per_try_timeout_.inc();
   upstream_host_->stats().rq_timeout_.inc();
   resetStream();
+  if (parent_.maybeDropHedgedRequest(*this, UpstreamResetType::PerTryTimeout)) {
+    return;
+  }
+
   parent_.onUpstreamReset(UpstreamResetType::PerTryTimeout,
                           Optional<Http::StreamResetReason>(Http::StreamResetReason::LocalReset));
 }
@@ -712,6 +1186,8 @@ void Filter::UpstreamRequest::onPoolReady(Http::StreamEncoder& request_encoder,
 
   conn_pool_stream_handle_ = nullptr;
   request_encoder_ = &request_encoder;
+  // The downstream may have backed up while the request waited for a connection.
+  updateReadDisable();
   calling_encode_headers_ = true;
   if (parent_.route_entry_->autoHostRewrite() && !host->hostname().empty()) {
     parent_.downstream_headers_->Host()->value(host->hostname());
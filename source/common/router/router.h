@@ -2,8 +2,12 @@
 
 #include <chrono>
 #include <cstdint>
+#include <functional>
+#include <list>
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "envoy/http/codec.h"
 #include "envoy/http/codes.h"
@@ -12,6 +16,7 @@
 #include "envoy/router/shadow_writer.h"
 #include "envoy/runtime/runtime.h"
 #include "envoy/stats/stats_macros.h"
+#include "envoy/thread_local/thread_local.h"
 #include "envoy/upstream/cluster_manager.h"
 
 #include "common/common/logger.h"
@@ -27,6 +32,8 @@ namespace Router {
   COUNTER(no_route)                                                                                \
   COUNTER(no_cluster)                                                                              \
   COUNTER(rq_redirect)                                                                             \
+  COUNTER(rq_coalesced)                                                                            \
+  COUNTER(rq_cluster_discovery)                                                                    \
   COUNTER(rq_total)
 // clang-format on
 
@@ -72,6 +79,55 @@ public:
   static TimeoutData finalTimeout(const RouteEntry& route, Http::HeaderMap& request_headers);
 };
 
+class Filter;
+
+/**
+ * Tracks the requests that each worker is sending upstream on behalf of identical requests, so
+ * that a request that arrives while an identical one is in flight can wait for its response rather
+ * than being sent upstream again.
+ */
+class RequestCoalescer {
+public:
+  /**
+   * @param tls supplies the thread local instance the in flight requests are tracked in.
+   * @param vary_headers supplies the request headers that must match, in addition to the method,
+   *        authority and path, for requests to share a response.
+   */
+  RequestCoalescer(ThreadLocal::Instance& tls,
+                   const std::vector<Http::LowerCaseString>& vary_headers);
+
+  /**
+   * @param headers supplies the final headers of the request.
+   * @param cluster_name supplies the cluster the request is routed to.
+   * @return the key that identifies requests that can share a response, or an empty string if the
+   *         request must not share its response.
+   */
+  std::string key(const Http::HeaderMap& headers, const std::string& cluster_name) const;
+
+  /**
+   * @return the filter that is sending the request with the key upstream on this worker, or
+   *         nullptr if there is none.
+   */
+  Filter* leader(const std::string& key);
+
+  void setLeader(const std::string& key, Filter& filter);
+  void removeLeader(const std::string& key);
+
+private:
+  struct ThreadLocalLeaders : public ThreadLocal::ThreadLocalObject {
+    // ThreadLocal::ThreadLocalObject
+    void shutdown() override {}
+
+    std::unordered_map<std::string, Filter*> leaders_;
+  };
+
+  ThreadLocal::Instance& tls_;
+  const uint32_t tls_slot_;
+  const std::vector<Http::LowerCaseString> vary_headers_;
+};
+
+typedef std::unique_ptr<RequestCoalescer> RequestCoalescerPtr;
+
 /**
  * Configuration for the router filter.
  */
@@ -80,13 +136,19 @@ public:
   FilterConfig(const std::string& stat_prefix, const LocalInfo::LocalInfo& local_info,
                Stats::Store& stats, Upstream::ClusterManager& cm, Runtime::Loader& runtime,
                Runtime::RandomGenerator& random, ShadowWriterPtr&& shadow_writer,
-               bool emit_dynamic_stats)
+               bool emit_dynamic_stats, RequestCoalescerPtr&& coalescer)
       : global_store_(stats), local_info_(local_info), cm_(cm), runtime_(runtime), random_(random),
         stats_{ALL_ROUTER_STATS(POOL_COUNTER_PREFIX(stats, stat_prefix))},
-        emit_dynamic_stats_(emit_dynamic_stats), shadow_writer_(std::move(shadow_writer)) {}
+        emit_dynamic_stats_(emit_dynamic_stats), shadow_writer_(std::move(shadow_writer)),
+        coalescer_(std::move(coalescer)) {}
 
   ShadowWriter& shadowWriter() { return *shadow_writer_; }
 
+  /**
+   * @return the request coalescer, or nullptr if identical requests are not coalesced.
+   */
+  RequestCoalescer* coalescer() { return coalescer_.get(); }
+
   Stats::Store& global_store_;
   const LocalInfo::LocalInfo& local_info_;
   Upstream::ClusterManager& cm_;
@@ -97,6 +159,7 @@ public:
 
 private:
   ShadowWriterPtr shadow_writer_;
+  RequestCoalescerPtr coalescer_;
 };
 
 typedef std::shared_ptr<FilterConfig> FilterConfigSharedPtr;
@@ -107,8 +170,9 @@ typedef std::shared_ptr<FilterConfig> FilterConfigSharedPtr;
 class Filter : Logger::Loggable<Logger::Id::router>, public Http::StreamDecoderFilter {
 public:
   Filter(FilterConfig& config)
-      : config_(config), downstream_response_started_(false), downstream_end_stream_(false),
-        do_shadowing_(false) {}
+      : config_(config), downstream_watermark_callbacks_(*this),
+        downstream_response_started_(false), downstream_end_stream_(false), do_shadowing_(false),
+        downstream_above_write_buffer_high_watermark_(false), discovery_end_stream_(false) {}
 
   ~Filter();
 
@@ -129,7 +193,8 @@ private:
                            public Http::ConnectionPool::Callbacks {
     UpstreamRequest(Filter& parent, Http::ConnectionPool::Instance& pool)
         : parent_(parent), conn_pool_(pool), calling_encode_headers_(false),
-          upstream_canary_(false), encode_complete_(false), encode_trailers_(false) {}
+          upstream_canary_(false), encode_complete_(false), encode_trailers_(false),
+          read_disabled_(false), above_write_buffer_high_watermark_(false) {}
 
     ~UpstreamRequest();
 
@@ -139,6 +204,8 @@ private:
     void resetStream();
     void setupPerTryTimeout();
     void onPerTryTimeout();
+    // Disable or enable reading the response so that it matches the downstream watermark state.
+    void updateReadDisable();
 
     void onUpstreamHostSelected(Upstream::HostDescriptionConstSharedPtr host) {
       upstream_host_ = host;
@@ -152,6 +219,8 @@ private:
 
     // Http::StreamCallbacks
     void onResetStream(Http::StreamResetReason reason) override;
+    void onAboveWriteBufferHighWatermark() override;
+    void onBelowWriteBufferLowWatermark() override;
 
     // Http::ConnectionPool::Callbacks
     void onPoolFailure(Http::ConnectionPool::PoolFailureReason reason,
@@ -172,21 +241,56 @@ private:
     bool upstream_canary_ : 1;
     bool encode_complete_ : 1;
     bool encode_trailers_ : 1;
+    // Whether reads of the response are disabled because the downstream is backed up.
+    bool read_disabled_ : 1;
+    // Whether the upstream stream is backed up and reads of the request are disabled.
+    bool above_write_buffer_high_watermark_ : 1;
   };
 
   typedef std::unique_ptr<UpstreamRequest> UpstreamRequestPtr;
 
+  /**
+   * Receives the watermark events of the downstream the response is written to. Kept apart from
+   * UpstreamRequest, whose stream callbacks have the same names but face the upstream.
+   */
+  struct DownstreamWatermarkCallbacksImpl : public Http::DownstreamWatermarkCallbacks {
+    DownstreamWatermarkCallbacksImpl(Filter& parent) : parent_(parent) {}
+
+    // Http::DownstreamWatermarkCallbacks
+    void onAboveWriteBufferHighWatermark() override { parent_.onDownstreamWatermark(true); }
+    void onBelowWriteBufferLowWatermark() override { parent_.onDownstreamWatermark(false); }
+
+    Filter& parent_;
+  };
+
   struct LoadBalancerContextImpl : public Upstream::LoadBalancerContext {
-    LoadBalancerContextImpl(const Optional<uint64_t>& hash) : hash_(hash) {}
+    LoadBalancerContextImpl(const Optional<uint64_t>& hash,
+                            const Upstream::HostMetadata& metadata_match,
+                            const Network::Connection* downstream_connection,
+                            const Http::HeaderMap* downstream_headers)
+        : hash_(hash), metadata_match_(metadata_match),
+          downstream_connection_(downstream_connection), downstream_headers_(downstream_headers) {}
 
     // Upstream::LoadBalancerContext
     const Optional<uint64_t>& hashKey() const override { return hash_; }
+    const Upstream::HostMetadata* metadataMatchCriteria() const override {
+      return metadata_match_.empty() ? nullptr : &metadata_match_;
+    }
+    const Network::Connection* downstreamConnection() const override {
+      return downstream_connection_;
+    }
+    const Http::HeaderMap* downstreamHeaders() const override { return downstream_headers_; }
 
     const Optional<uint64_t> hash_;
+    const Upstream::HostMetadata& metadata_match_;
+    const Network::Connection* downstream_connection_;
+    const Http::HeaderMap* downstream_headers_;
   };
 
   enum class UpstreamResetType { Reset, GlobalTimeout, PerTryTimeout };
 
+  typedef std::function<void(Filter& follower)> FollowerCb;
+
   Http::AccessLog::ResponseFlag
   streamResetReasonToResponseFlag(Http::StreamResetReason reset_reason);
 
@@ -203,7 +307,15 @@ private:
                                          Upstream::ResourcePriority priority) PURE;
   Upstream::ResourcePriority finalPriority();
   Http::ConnectionPool::Instance* getConnPool();
-  void maybeDoShadowing();
+  Upstream::ThreadLocalCluster* getThreadLocalCluster();
+  bool maybeCoalesce();
+  void maybeStartShadowing(bool end_stream);
+  bool maybeDropHedgedRequest(UpstreamRequest& upstream_request, UpstreamResetType type);
+  void onDownstreamWatermark(bool above_high_watermark);
+  void maybeSelectHedgeWinner(UpstreamRequest& upstream_request);
+  void onClusterDiscoveryComplete();
+  void onHedgeTimeout();
+  void onLeaderGone();
   void onRequestComplete();
   void onResponseTimeout();
   void onUpstreamHeaders(Http::HeaderMapPtr&& headers, bool end_stream);
@@ -212,9 +324,18 @@ private:
   void onUpstreamComplete();
   void onUpstreamReset(UpstreamResetType type,
                        const Optional<Http::StreamResetReason>& reset_reason);
+  void routeRequest(Upstream::ThreadLocalCluster& cluster, bool end_stream);
+  void sendNoClusterResponse();
   void sendNoHealthyUpstreamResponse();
+  void sendLocalReplyToFollowers(Http::Code code, const std::string& body,
+                                 Http::AccessLog::ResponseFlag response_flag);
+  void sendUpstreamRequest(Http::ConnectionPool::Instance& conn_pool, bool end_stream);
   bool setupRetry(bool end_stream);
   void doRetry();
+  void sendBufferedRequest(UpstreamRequestPtr& upstream_request);
+  void stopLeading();
+  void forEachFollower(const FollowerCb& cb);
+  void releaseFollowers(const FollowerCb& cb);
 
   FilterConfig& config_;
   Http::StreamDecoderFilterCallbacks* callbacks_{};
@@ -227,15 +348,34 @@ private:
   FilterUtility::TimeoutData timeout_;
   Http::Code timeout_response_code_ = Http::Code::GatewayTimeout;
   UpstreamRequestPtr upstream_request_;
+  // A second copy of the request that races upstream_request_ until one of them responds.
+  UpstreamRequestPtr hedge_request_;
+  Event::TimerPtr hedge_timer_;
+  // The request body is streamed to the shadow cluster through this until the request ends.
+  ShadowStream* shadow_stream_{};
   RetryStatePtr retry_state_;
   Http::HeaderMap* downstream_headers_{};
   Http::HeaderMap* downstream_trailers_{};
   MonotonicTime downstream_request_complete_time_;
   std::unique_ptr<LoadBalancerContextImpl> lb_context_;
+  DownstreamWatermarkCallbacksImpl downstream_watermark_callbacks_;
+  // Set while identical requests can join this one, which is sent upstream on behalf of them all.
+  std::string leader_key_;
+  // The identical requests that wait for the response of this one.
+  std::list<Filter*> followers_;
+  std::list<Filter*>::iterator next_follower_{followers_.end()};
+  // The request whose response this one waits for, and the position of this one in its followers.
+  Filter* leader_{};
+  std::list<Filter*>::iterator follower_position_;
+  // Set while the request waits for its cluster to be discovered.
+  Upstream::ClusterDiscoveryRequest* cluster_discovery_{};
 
   bool downstream_response_started_ : 1;
   bool downstream_end_stream_ : 1;
   bool do_shadowing_ : 1;
+  bool downstream_above_write_buffer_high_watermark_ : 1;
+  // Whether the request ended while its cluster was being discovered.
+  bool discovery_end_stream_ : 1;
 };
 
 class ProdFilter : public Filter {
@@ -3,20 +3,30 @@
 #include <chrono>
 #include <string>
 
+#include "common/buffer/buffer_impl.h"
 #include "common/common/assert.h"
+#include "common/http/header_map_impl.h"
 #include "common/http/headers.h"
 
 namespace Envoy {
 namespace Router {
 
-void ShadowWriterImpl::shadow(const std::string& cluster, Http::MessagePtr&& request,
-                              std::chrono::milliseconds timeout) {
+namespace {
+
+void addShadowSuffix(Http::HeaderMap& headers) {
   // Switch authority to add a shadow postfix. This allows upstream logging to make a more sense.
   // TODO PERF: Avoid copy.
-  std::string host = request->headers().Host()->value().c_str();
+  std::string host = headers.Host()->value().c_str();
   ASSERT(!host.empty());
   host += "-shadow";
-  request->headers().Host()->value(host);
+  headers.Host()->value(host);
+}
+
+} // namespace
+
+void ShadowWriterImpl::shadow(const std::string& cluster, Http::MessagePtr&& request,
+                              std::chrono::milliseconds timeout) {
+  addShadowSuffix(request->headers());
 
   // Configuration should guarantee that cluster exists before calling here. This is basically
   // fire and forget. We don't handle cancelling.
@@ -24,5 +34,132 @@ void ShadowWriterImpl::shadow(const std::string& cluster, Http::MessagePtr&& req
       .send(std::move(request), *this, Optional<std::chrono::milliseconds>(timeout));
 }
 
+ShadowStream* ShadowWriterImpl::streamShadow(const std::string& cluster,
+                                             Http::HeaderMapPtr&& headers, bool end_stream,
+                                             std::chrono::milliseconds timeout) {
+  addShadowSuffix(*headers);
+
+  // Configuration should guarantee that cluster exists before calling here.
+  Upstream::ThreadLocalCluster* thread_local_cluster = cm_.get(cluster);
+  ASSERT(thread_local_cluster);
+  std::unique_ptr<ShadowStreamImpl> shadow_stream(
+      new ShadowStreamImpl(std::move(headers), thread_local_cluster->info()));
+  if (!shadow_stream->start(cm_.httpAsyncClientForCluster(cluster), end_stream, timeout)) {
+    return nullptr;
+  }
+
+  // From here on the stream owns itself.
+  if (end_stream) {
+    shadow_stream.release()->releaseHandle();
+    return nullptr;
+  }
+  return shadow_stream.release();
+}
+
+bool ShadowWriterImpl::ShadowStreamImpl::start(Http::AsyncClient& client, bool end_stream,
+                                               std::chrono::milliseconds timeout) {
+  stream_ = client.start(*this, Optional<std::chrono::milliseconds>(timeout));
+  if (!stream_) {
+    return false;
+  }
+
+  local_complete_ = end_stream;
+  stream_->sendHeaders(*headers_, end_stream);
+  return true;
+}
+
+void ShadowWriterImpl::ShadowStreamImpl::releaseHandle() {
+  ASSERT(!released_);
+  released_ = true;
+  if (!stream_) {
+    delete this;
+  }
+}
+
+void ShadowWriterImpl::ShadowStreamImpl::sendData(const Buffer::Instance& data, bool end_stream) {
+  ASSERT(!released_);
+  if (canSend()) {
+    Buffer::OwnedImpl copy;
+    copy.add(data);
+    local_complete_ = end_stream;
+    stream_->sendData(copy, end_stream);
+  }
+
+  if (end_stream) {
+    releaseHandle();
+  }
+}
+
+void ShadowWriterImpl::ShadowStreamImpl::sendTrailers(const Http::HeaderMap& trailers) {
+  ASSERT(!released_);
+  if (canSend()) {
+    trailers_.reset(new Http::HeaderMapImpl(trailers));
+    local_complete_ = true;
+    stream_->sendTrailers(*trailers_);
+  }
+
+  releaseHandle();
+}
+
+void ShadowWriterImpl::ShadowStreamImpl::cancel() {
+  if (stream_) {
+    stream_->reset();
+  }
+
+  releaseHandle();
+}
+
+bool ShadowWriterImpl::ShadowStreamImpl::canSend() {
+  if (!stream_) {
+    return false;
+  }
+
+  if (!remote_complete_) {
+    if (!stream_->isAboveWriteBufferHighWatermark()) {
+      return true;
+    }
+
+    // Buffering for a shadow upstream that cannot keep up would cost memory on behalf of a
+    // request nobody waits for, so the shadow is dropped instead.
+    cluster_->stats().upstream_rq_shadow_dropped_.inc();
+  }
+
+  // Once the response is complete, the stream only waits for the request to end. Nobody needs
+  // the rest of it.
+  stream_->reset();
+  return false;
+}
+
+void ShadowWriterImpl::ShadowStreamImpl::onHeaders(Http::HeaderMapPtr&&, bool end_stream) {
+  if (end_stream) {
+    onRemoteComplete();
+  }
+}
+
+void ShadowWriterImpl::ShadowStreamImpl::onData(Buffer::Instance&, bool end_stream) {
+  if (end_stream) {
+    onRemoteComplete();
+  }
+}
+
+void ShadowWriterImpl::ShadowStreamImpl::onReset() {
+  stream_ = nullptr;
+  remote_complete_ = true;
+  if (released_) {
+    delete this;
+  }
+}
+
+void ShadowWriterImpl::ShadowStreamImpl::onRemoteComplete() {
+  remote_complete_ = true;
+  if (local_complete_) {
+    // The async stream goes away once both directions are complete.
+    stream_ = nullptr;
+    if (released_) {
+      delete this;
+    }
+  }
+}
+
 } // Router
 } // Envoy
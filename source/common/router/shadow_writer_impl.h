@@ -20,12 +20,55 @@ public:
   // Router::ShadowWriter
   void shadow(const std::string& cluster, Http::MessagePtr&& request,
               std::chrono::milliseconds timeout) override;
+  ShadowStream* streamShadow(const std::string& cluster, Http::HeaderMapPtr&& headers,
+                             bool end_stream, std::chrono::milliseconds timeout) override;
 
   // Http::AsyncClient::Callbacks
   void onSuccess(Http::MessagePtr&&) override {}
   void onFailure(Http::AsyncClient::FailureReason) override {}
 
 private:
+  /**
+   * A streamed shadow request. It deletes itself once the router has released the handle and the
+   * async stream is gone. The writer is shared by all workers, so it does not track these.
+   */
+  class ShadowStreamImpl : public ShadowStream, public Http::AsyncClient::StreamCallbacks {
+  public:
+    ShadowStreamImpl(Http::HeaderMapPtr&& headers, Upstream::ClusterInfoConstSharedPtr cluster)
+        : headers_(std::move(headers)), cluster_(cluster) {}
+
+    bool start(Http::AsyncClient& client, bool end_stream, std::chrono::milliseconds timeout);
+    void releaseHandle();
+
+    // Router::ShadowStream
+    void sendData(const Buffer::Instance& data, bool end_stream) override;
+    void sendTrailers(const Http::HeaderMap& trailers) override;
+    void cancel() override;
+
+    // Http::AsyncClient::StreamCallbacks
+    void onHeaders(Http::HeaderMapPtr&&, bool end_stream) override;
+    void onData(Buffer::Instance&, bool end_stream) override;
+    void onTrailers(Http::HeaderMapPtr&&) override { onRemoteComplete(); }
+    void onReset() override;
+
+  private:
+    /**
+     * @return whether more of the request can be sent. Resets the stream if the response has
+     *         already completed, or if the shadow upstream has fallen behind.
+     */
+    bool canSend();
+    void onRemoteComplete();
+
+    // The async stream refers to the headers and trailers until it is gone.
+    Http::HeaderMapPtr headers_;
+    Http::HeaderMapPtr trailers_;
+    Upstream::ClusterInfoConstSharedPtr cluster_;
+    Http::AsyncClient::Stream* stream_{};
+    bool local_complete_{};
+    bool remote_complete_{};
+    bool released_{};
+  };
+
   Upstream::ClusterManager& cm_;
 };
 
@@ -0,0 +1,32 @@
+#include "common/runtime/key_registry.h"
+
+namespace Envoy {
+namespace Runtime {
+
+Key KeyRegistry::registerKey(const std::string& name) {
+  Registry& registry = KeyRegistry::registry();
+  std::unique_lock<std::mutex> lock(registry.lock_);
+  auto it = registry.indexes_.find(name);
+  if (it == registry.indexes_.end()) {
+    it = registry.indexes_.emplace(name, registry.names_.size()).first;
+    registry.names_.push_back(name);
+  }
+
+  return Key(name, it->second);
+}
+
+std::vector<std::string> KeyRegistry::keys() {
+  Registry& registry = KeyRegistry::registry();
+  std::unique_lock<std::mutex> lock(registry.lock_);
+  return registry.names_;
+}
+
+KeyRegistry::Registry& KeyRegistry::registry() {
+  // Keys are registered from static initializers in other translation units, so the registry must
+  // be constructed on first use. It is never destroyed for the same reason.
+  static Registry* registry = new Registry();
+  return *registry;
+}
+
+} // Runtime
+} // Envoy
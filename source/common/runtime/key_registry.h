@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "envoy/runtime/runtime.h"
+
+namespace Envoy {
+namespace Runtime {
+
+/**
+ * Process wide registry that assigns dense indexes to runtime keys. Keys are never removed, so the
+ * number of indexes is bounded by the number of distinct key names in code and configuration.
+ */
+class KeyRegistry {
+public:
+  /**
+   * Register a key, or find it if it is already registered. Thread safe.
+   * @param name supplies the name of the key.
+   * @return Key the key, with the same index for every registration of the same name.
+   */
+  static Key registerKey(const std::string& name);
+
+  /**
+   * @return std::vector<std::string> the names of all registered keys, indexed by Key::index().
+   *         Thread safe.
+   */
+  static std::vector<std::string> keys();
+
+private:
+  struct Registry {
+    std::mutex lock_;
+    std::unordered_map<std::string, uint32_t> indexes_;
+    std::vector<std::string> names_;
+  };
+
+  static Registry& registry();
+};
+
+} // Runtime
+} // Envoy
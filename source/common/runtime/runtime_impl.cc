@@ -1,9 +1,9 @@
 #include "common/runtime/runtime_impl.h"
 
-#include <fcntl.h>
-#include <unistd.h>
+#include <sys/stat.h>
 
 #include <cstdint>
+#include <cstring>
 #include <random>
 #include <string>
 
@@ -11,42 +11,63 @@
 #include "envoy/stats/stats.h"
 #include "envoy/thread_local/thread_local.h"
 
+#include "common/common/hex.h"
 #include "common/common/utility.h"
 #include "common/filesystem/filesystem_impl.h"
+#include "common/runtime/key_registry.h"
 
 #include "spdlog/spdlog.h"
 
 namespace Envoy {
 namespace Runtime {
 
-const size_t RandomGeneratorImpl::UUID_LENGTH = 36;
+const size_t RandomGeneratorImpl::UUID_LENGTH;
 
-std::string RandomGeneratorImpl::uuid() {
-  int fd = open("/proc/sys/kernel/random/uuid", O_RDONLY);
-  if (-1 == fd) {
-    throw EnvoyException(fmt::format("unable to open uuid, errno: {}", strerror(errno)));
+RandomGeneratorImpl::Xoshiro256::Xoshiro256() {
+  // Seeding reads the kernel entropy pool once per thread. Unlike a seed derived from the time and
+  // the thread id, it keeps the UUIDs of different threads and hosts apart.
+  std::random_device device;
+  uint64_t all_bits = 0;
+  for (uint64_t& word : state_) {
+    word = (static_cast<uint64_t>(device()) << 32) | device();
+    all_bits |= word;
   }
 
-  char generated_uuid[UUID_LENGTH + 1];
-  ssize_t bytes_read = read(fd, generated_uuid, UUID_LENGTH);
-  close(fd);
-  generated_uuid[UUID_LENGTH] = '\0';
-
-  if (bytes_read != UUID_LENGTH) {
-    throw EnvoyException(fmt::format("cannot read the uuid: bytes read - {}, bytes expected - {}",
-                                     bytes_read, UUID_LENGTH));
+  // The all zero state is the one state the generator never leaves.
+  if (all_bits == 0) {
+    state_[0] = 1;
   }
+}
 
-  return std::string(generated_uuid);
+std::string RandomGeneratorImpl::uuid() {
+  // A version 4 UUID is 122 random bits, so two draws supply all of it. The version nibble is the
+  // first digit of the third group and the variant bits lead the fourth group.
+  const uint64_t high = (random() & 0xffffffffffff0fffULL) | 0x0000000000004000ULL;
+  const uint64_t low = (random() & 0x3fffffffffffffffULL) | 0x8000000000000000ULL;
+
+  char digits[32];
+  Hex::uint64ToHex(high, digits);
+  Hex::uint64ToHex(low, digits + 16);
+
+  std::string uuid(UUID_LENGTH, '-');
+  memcpy(&uuid[0], digits, 8);
+  memcpy(&uuid[9], digits + 8, 4);
+  memcpy(&uuid[14], digits + 12, 4);
+  memcpy(&uuid[19], digits + 16, 4);
+  memcpy(&uuid[24], digits + 20, 12);
+  return uuid;
 }
 
+std::atomic<uint64_t> SnapshotImpl::next_generation_{1};
+
 SnapshotImpl::SnapshotImpl(const std::string& root_path, const std::string& override_path,
-                           RuntimeStats& stats, RandomGenerator& generator)
-    : generator_(generator) {
+                           RuntimeStats& stats, RandomGenerator& generator,
+                           const SnapshotImpl* previous)
+    : generator_(generator), generation_(next_generation_++) {
   try {
-    walkDirectory(root_path, "");
+    walkDirectory(root_path, "", previous);
     if (Filesystem::directoryExists(override_path)) {
-      walkDirectory(override_path, "");
+      walkDirectory(override_path, "", previous);
       stats.override_dir_exists_.inc();
     } else {
       stats.override_dir_not_exists_.inc();
@@ -59,6 +80,15 @@ SnapshotImpl::SnapshotImpl(const std::string& root_path, const std::string& over
   }
 
   stats.num_keys_.set(values_.size());
+
+  const std::vector<std::string> keys = KeyRegistry::keys();
+  integer_values_.resize(keys.size());
+  for (uint32_t i = 0; i < keys.size(); i++) {
+    auto entry = values_.find(keys[i]);
+    if (entry != values_.end()) {
+      integer_values_[i] = entry->second->uint_value_;
+    }
+  }
 }
 
 const std::string& SnapshotImpl::get(const std::string& key) const {
@@ -66,20 +96,21 @@ const std::string& SnapshotImpl::get(const std::string& key) const {
   if (entry == values_.end()) {
     return EMPTY_STRING;
   } else {
-    return entry->second.string_value_;
+    return entry->second->string_value_;
   }
 }
 
 uint64_t SnapshotImpl::getInteger(const std::string& key, uint64_t default_value) const {
   auto entry = values_.find(key);
-  if (entry == values_.end() || !entry->second.uint_value_.valid()) {
+  if (entry == values_.end() || !entry->second->uint_value_.valid()) {
     return default_value;
   } else {
-    return entry->second.uint_value_.value();
+    return entry->second->uint_value_.value();
   }
 }
 
-void SnapshotImpl::walkDirectory(const std::string& path, const std::string& prefix) {
+void SnapshotImpl::walkDirectory(const std::string& path, const std::string& prefix,
+                                 const SnapshotImpl* previous) {
   log_debug("walking directory: {}", path);
   Directory current_dir(path);
   while (true) {
@@ -103,39 +134,65 @@ void SnapshotImpl::walkDirectory(const std::string& path, const std::string& pre
 
     if (entry->d_type == DT_DIR && std::string(entry->d_name) != "." &&
         std::string(entry->d_name) != "..") {
-      walkDirectory(full_path, full_prefix);
+      walkDirectory(full_path, full_prefix, previous);
     } else if (entry->d_type == DT_REG) {
-      // Suck the file into a string. This is not very efficient but it should be good enough
-      // for small files. Also, as noted elsewhere, none of this is non-blocking which could
-      // theoretically lead to issues.
-      log_debug("reading file: {}", full_path);
-      Entry entry;
-      entry.string_value_ = Filesystem::fileReadToEnd(full_path);
-      StringUtil::rtrim(entry.string_value_);
-
-      // As a perf optimization, attempt to convert the string into an integer. If we don't
-      // succeed that's fine.
-      uint64_t converted;
-      if (StringUtil::atoul(entry.string_value_.c_str(), converted)) {
-        entry.uint_value_.value(converted);
-      }
-
-      values_[full_prefix] = entry;
+      values_[full_prefix] = &loadFile(full_path, previous);
     }
   }
 }
 
+const SnapshotImpl::Entry& SnapshotImpl::loadFile(const std::string& path,
+                                                  const SnapshotImpl* previous) {
+  struct stat info;
+  if (stat(path.c_str(), &info) != 0) {
+    throw EnvoyException(fmt::format("unable to stat file: {}", path));
+  }
+
+  File& file = files_[path];
+  file.size_ = info.st_size;
+  file.mtime_ns_ = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+
+  // Runtime trees are usually deployed as a copy of the previous tree with a few files changed, so
+  // most files can be taken from the previous snapshot without reading them again.
+  if (previous) {
+    auto previous_file = previous->files_.find(path);
+    if (previous_file != previous->files_.end() && previous_file->second.size_ == file.size_ &&
+        previous_file->second.mtime_ns_ == file.mtime_ns_) {
+      file.entry_ = previous_file->second.entry_;
+      return file.entry_;
+    }
+  }
+
+  // Suck the file into a string. This is not very efficient but it should be good enough for small
+  // files. Also, as noted elsewhere, none of this is non-blocking which could theoretically lead to
+  // issues.
+  log_debug("reading file: {}", path);
+  Entry& entry = file.entry_;
+  entry.string_value_ = Filesystem::fileReadToEnd(path);
+  StringUtil::rtrim(entry.string_value_);
+
+  // As a perf optimization, attempt to convert the string into an integer. If we don't succeed
+  // that's fine.
+  uint64_t converted;
+  if (StringUtil::atoul(entry.string_value_.c_str(), converted)) {
+    entry.uint_value_.value(converted);
+  }
+  return entry;
+}
+
 LoaderImpl::LoaderImpl(Event::Dispatcher& dispatcher, ThreadLocal::Instance& tls,
                        const std::string& root_symlink_path, const std::string& subdir,
                        const std::string& override_dir, Stats::Store& store,
                        RandomGenerator& generator)
-    : watcher_(dispatcher.createFilesystemWatcher()), tls_(tls), tls_slot_(tls.allocateSlot()),
-      generator_(generator), root_path_(root_symlink_path + "/" + subdir),
+    : watcher_(dispatcher.createFilesystemWatcher()), generator_(generator),
+      root_path_(root_symlink_path + "/" + subdir),
       override_path_(root_symlink_path + "/" + override_dir), stats_(generateStats(store)) {
   watcher_->addWatch(root_symlink_path, Filesystem::Watcher::Events::MovedTo,
                      [this](uint32_t) -> void { onSymlinkSwap(); });
 
-  onSymlinkSwap();
+  current_snapshot_.reset(
+      new SnapshotImpl(root_path_, override_path_, stats_, generator_, nullptr));
+  shared_snapshot_.reset(new ThreadLocal::SharedSnapshot(tls, current_snapshot_));
 }
 
 RuntimeStats LoaderImpl::generateStats(Stats::Store& store) {
@@ -146,13 +203,12 @@ RuntimeStats LoaderImpl::generateStats(Stats::Store& store) {
 }
 
 void LoaderImpl::onSymlinkSwap() {
-  current_snapshot_.reset(new SnapshotImpl(root_path_, override_path_, stats_, generator_));
-  ThreadLocal::ThreadLocalObjectSharedPtr ptr_copy = current_snapshot_;
-  tls_.set(tls_slot_, [ptr_copy](Event::Dispatcher&)
-                          -> ThreadLocal::ThreadLocalObjectSharedPtr { return ptr_copy; });
+  current_snapshot_.reset(
+      new SnapshotImpl(root_path_, override_path_, stats_, generator_, current_snapshot_.get()));
+  shared_snapshot_->publish(current_snapshot_);
 }
 
-Snapshot& LoaderImpl::snapshot() { return tls_.getTyped<Snapshot>(tls_slot_); }
+Snapshot& LoaderImpl::snapshot() { return shared_snapshot_->getTyped<Snapshot>(); }
 
 } // Runtime
 } // Envoy
@@ -2,12 +2,13 @@
 
 #include <dirent.h>
 
-#include <chrono>
+#include <atomic>
 #include <cstdint>
 #include <memory>
 #include <random>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "envoy/common/exception.h"
 #include "envoy/common/optional.h"
@@ -18,6 +19,7 @@
 #include "common/common/empty_string.h"
 #include "common/common/logger.h"
 #include "common/common/thread.h"
+#include "common/thread_local/shared_snapshot.h"
 
 #include "spdlog/spdlog.h"
 
@@ -25,23 +27,46 @@ namespace Envoy {
 namespace Runtime {
 
 /**
- * Implementation of RandomGenerator that uses per-thread RANLUX generators seeded with current
- * time.
+ * Implementation of RandomGenerator that uses per-thread xoshiro256++ generators seeded from the
+ * kernel entropy pool. The numbers are not suitable for cryptographic use.
  */
 class RandomGeneratorImpl : public RandomGenerator {
 public:
   // Runtime::RandomGenerator
-  uint64_t random() override { return threadLocalGenerator()(); }
+  uint64_t random() override { return threadLocalGenerator().next(); }
   std::string uuid() override;
 
-  static const size_t UUID_LENGTH;
+  static const size_t UUID_LENGTH = 36;
 
 private:
-  static std::ranlux48& threadLocalGenerator() {
-    std::chrono::nanoseconds now = std::chrono::duration_cast<std::chrono::nanoseconds>(
-        std::chrono::system_clock::now().time_since_epoch());
-    static thread_local std::ranlux48 generator(now.count() ^ Thread::Thread::currentThreadId());
+  /**
+   * xoshiro256++ by Blackman and Vigna: a handful of shifts, rotations and additions per number,
+   * against the dozens of discarded subtract-with-carry steps of std::ranlux48.
+   */
+  class Xoshiro256 {
+  public:
+    Xoshiro256();
+
+    uint64_t next() {
+      const uint64_t result = rotl(state_[0] + state_[3], 23) + state_[0];
+      const uint64_t t = state_[1] << 17;
+      state_[2] ^= state_[0];
+      state_[3] ^= state_[1];
+      state_[1] ^= state_[2];
+      state_[0] ^= state_[3];
+      state_[2] ^= t;
+      state_[3] = rotl(state_[3], 45);
+      return result;
+    }
+
+  private:
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    uint64_t state_[4];
+  };
 
+  static Xoshiro256& threadLocalGenerator() {
+    static thread_local Xoshiro256 generator;
     return generator;
   }
 };
@@ -72,26 +97,21 @@ class SnapshotImpl : public Snapshot,
                      public ThreadLocal::ThreadLocalObject,
                      Logger::Loggable<Logger::Id::runtime> {
 public:
+  /**
+   * @param previous supplies the snapshot being replaced, if any. Files whose size and modification
+   *        time did not change since it was loaded are not read again but copied from it.
+   */
   SnapshotImpl(const std::string& root_path, const std::string& override_path, RuntimeStats& stats,
-               RandomGenerator& generator);
+               RandomGenerator& generator, const SnapshotImpl* previous);
 
   // Runtime::Snapshot
   bool featureEnabled(const std::string& key, uint64_t default_value, uint64_t random_value,
                       uint16_t num_buckets) const override {
-    return random_value % static_cast<uint64_t>(num_buckets) <
-           std::min(getInteger(key, default_value), static_cast<uint64_t>(num_buckets));
+    return enabled(getInteger(key, default_value), random_value, num_buckets);
   }
 
   bool featureEnabled(const std::string& key, uint64_t default_value) const override {
-    // Avoid PNRG if we know we don't need it.
-    uint64_t cutoff = std::min(getInteger(key, default_value), 100UL);
-    if (cutoff == 0) {
-      return false;
-    } else if (cutoff == 100) {
-      return true;
-    } else {
-      return generator_.random() % 100 < cutoff;
-    }
+    return enabled(getInteger(key, default_value));
   }
 
   bool featureEnabled(const std::string& key, uint64_t default_value,
@@ -101,6 +121,31 @@ public:
 
   const std::string& get(const std::string& key) const override;
   uint64_t getInteger(const std::string&, uint64_t default_value) const override;
+  uint64_t generation() const override { return generation_; }
+
+  bool featureEnabled(const Key& key, uint64_t default_value, uint64_t random_value,
+                      uint16_t num_buckets) const override {
+    return enabled(getInteger(key, default_value), random_value, num_buckets);
+  }
+
+  bool featureEnabled(const Key& key, uint64_t default_value) const override {
+    return enabled(getInteger(key, default_value));
+  }
+
+  bool featureEnabled(const Key& key, uint64_t default_value,
+                      uint64_t random_value) const override {
+    return featureEnabled(key, default_value, random_value, 100);
+  }
+
+  uint64_t getInteger(const Key& key, uint64_t default_value) const override {
+    if (key.index() >= integer_values_.size()) {
+      // The key was registered after this snapshot was loaded.
+      return getInteger(key.name(), default_value);
+    }
+
+    const Optional<uint64_t>& value = integer_values_[key.index()];
+    return value.valid() ? value.value() : default_value;
+  }
 
   // ThreadLocal::ThreadLocalObject
   void shutdown() override {}
@@ -124,17 +169,52 @@ private:
     Optional<uint64_t> uint_value_;
   };
 
-  void walkDirectory(const std::string& path, const std::string& prefix);
+  struct File {
+    Entry entry_;
+    // The quick check used to tell whether the file changed, the same one rsync uses.
+    off_t size_;
+    int64_t mtime_ns_;
+  };
+
+  static bool enabled(uint64_t value, uint64_t random_value, uint16_t num_buckets) {
+    return random_value % static_cast<uint64_t>(num_buckets) <
+           std::min(value, static_cast<uint64_t>(num_buckets));
+  }
+
+  bool enabled(uint64_t value) const {
+    // Avoid PNRG if we know we don't need it.
+    uint64_t cutoff = std::min(value, 100UL);
+    if (cutoff == 0) {
+      return false;
+    } else if (cutoff == 100) {
+      return true;
+    } else {
+      return generator_.random() % 100 < cutoff;
+    }
+  }
+
+  void walkDirectory(const std::string& path, const std::string& prefix,
+                     const SnapshotImpl* previous);
+  const Entry& loadFile(const std::string& path, const SnapshotImpl* previous);
+
+  static std::atomic<uint64_t> next_generation_;
 
-  std::unordered_map<std::string, Entry> values_;
+  // Every file read, by full path. Keys overridden by the override directory have two.
+  std::unordered_map<std::string, File> files_;
+  // Points into files_.
+  std::unordered_map<std::string, const Entry*> values_;
+  // The integer values of the registered keys, indexed by Key::index().
+  std::vector<Optional<uint64_t>> integer_values_;
   RandomGenerator& generator_;
+  const uint64_t generation_;
 };
 
 /**
  * Implementation of Loader that watches a symlink for swapping and loads a specified subdirectory
  * from disk. A single snapshot is shared among all threads and referenced by shared_ptr such that
  * a new runtime can be swapped in by the main thread while workers are still using the previous
- * version.
+ * version. Workers pick up a new snapshot the next time they read the runtime rather than being
+ * posted to on every swap.
  */
 class LoaderImpl : public Loader {
 public:
@@ -150,13 +230,12 @@ private:
   void onSymlinkSwap();
 
   Filesystem::WatcherPtr watcher_;
-  ThreadLocal::Instance& tls_;
-  uint32_t tls_slot_;
   RandomGenerator& generator_;
   std::string root_path_;
   std::string override_path_;
   std::shared_ptr<SnapshotImpl> current_snapshot_;
   RuntimeStats stats_;
+  std::unique_ptr<ThreadLocal::SharedSnapshot> shared_snapshot_;
 };
 
 /**
@@ -174,6 +253,9 @@ private:
     NullSnapshotImpl(RandomGenerator& generator) : generator_(generator) {}
 
     // Runtime::Snapshot
+    using Snapshot::featureEnabled;
+    using Snapshot::getInteger;
+
     bool featureEnabled(const std::string&, uint64_t default_value, uint64_t random_value,
                         uint16_t num_buckets) const override {
       return random_value % static_cast<uint64_t>(num_buckets) <
@@ -201,6 +283,8 @@ private:
       return default_value;
     }
 
+    uint64_t generation() const override { return 0; }
+
     RandomGenerator& generator_;
   };
 
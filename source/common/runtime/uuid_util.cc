@@ -3,17 +3,17 @@
 #include <cstdint>
 #include <string>
 
-#include "common/common/utility.h"
+#include "common/common/hex.h"
 #include "common/runtime/runtime_impl.h"
 
 namespace Envoy {
-bool UuidUtils::uuidModBy(const std::string& uuid, uint16_t& out, uint16_t mod) {
-  if (uuid.length() < 8) {
+bool UuidUtils::uuidModBy(const char* uuid, size_t length, uint16_t& out, uint16_t mod) {
+  if (length < 8) {
     return false;
   }
 
   uint64_t value;
-  if (!StringUtil::atoul(uuid.substr(0, 8).c_str(), value, 16)) {
+  if (!Hex::hexToUint64(uuid, 8, value)) {
     return false;
   }
 
@@ -21,8 +21,8 @@ bool UuidUtils::uuidModBy(const std::string& uuid, uint16_t& out, uint16_t mod)
   return true;
 }
 
-UuidTraceStatus UuidUtils::isTraceableUuid(const std::string& uuid) {
-  if (uuid.length() != Runtime::RandomGeneratorImpl::UUID_LENGTH) {
+UuidTraceStatus UuidUtils::isTraceableUuid(const char* uuid, size_t length) {
+  if (length != Runtime::RandomGeneratorImpl::UUID_LENGTH) {
     return UuidTraceStatus::NoTrace;
   }
 
@@ -38,8 +38,8 @@ UuidTraceStatus UuidUtils::isTraceableUuid(const std::string& uuid) {
   }
 }
 
-bool UuidUtils::setTraceableUuid(std::string& uuid, UuidTraceStatus trace_status) {
-  if (uuid.length() != Runtime::RandomGeneratorImpl::UUID_LENGTH) {
+bool UuidUtils::setTraceableUuid(char* uuid, size_t length, UuidTraceStatus trace_status) {
+  if (length != Runtime::RandomGeneratorImpl::UUID_LENGTH) {
     return false;
   }
 
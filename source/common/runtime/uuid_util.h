@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 namespace Envoy {
@@ -16,7 +18,14 @@ public:
    * @param out will contain the result of the operation.
    * @param mod modulo used in the operation.
    */
-  static bool uuidModBy(const std::string& uuid, uint16_t& out, uint16_t mod);
+  static bool uuidModBy(const std::string& uuid, uint16_t& out, uint16_t mod) {
+    return uuidModBy(uuid.c_str(), uuid.size(), out, mod);
+  }
+
+  /**
+   * Same as above, for a uuid that is not held in a std::string. Does not allocate.
+   */
+  static bool uuidModBy(const char* uuid, size_t length, uint16_t& out, uint16_t mod);
 
   /**
    * Modify uuid in a way it can be detected if uuid is traceable or not.
@@ -24,12 +33,26 @@ public:
    * @param trace_status is to specify why we modify uuid.
    * @return true on success, false on failure.
    */
-  static bool setTraceableUuid(std::string& uuid, UuidTraceStatus trace_status);
+  static bool setTraceableUuid(std::string& uuid, UuidTraceStatus trace_status) {
+    return setTraceableUuid(&uuid[0], uuid.size(), trace_status);
+  }
+
+  /**
+   * Same as above, modifying a uuid of the given length in place.
+   */
+  static bool setTraceableUuid(char* uuid, size_t length, UuidTraceStatus trace_status);
 
   /**
    * @return status of the uuid, to differentiate reason for tracing, etc.
    */
-  static UuidTraceStatus isTraceableUuid(const std::string& uuid);
+  static UuidTraceStatus isTraceableUuid(const std::string& uuid) {
+    return isTraceableUuid(uuid.c_str(), uuid.size());
+  }
+
+  /**
+   * Same as above, for a uuid that is not held in a std::string. Does not allocate.
+   */
+  static UuidTraceStatus isTraceableUuid(const char* uuid, size_t length);
 
 private:
   // Byte on this position has predefined value of 4 for UUID4.
@@ -1,5 +1,6 @@
 #include "common/ssl/connection_impl.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -8,6 +9,7 @@
 #include "common/common/empty_string.h"
 #include "common/common/hex.h"
 #include "common/network/utility.h"
+#include "common/ssl/kernel_tls_impl.h"
 
 #include "openssl/err.h"
 #include "openssl/x509v3.h"
@@ -27,6 +29,9 @@ getNullLocalAddress(const Network::Address::Instance& address) {
   // Default to IPv4 any address.
   return Network::Utility::getIpv4AnyAddress();
 }
+
+// The largest amount of application data that fits in a single TLS record.
+const uint64_t MaxTlsRecordPayload = 16384;
 } // namespace
 
 ConnectionImpl::ConnectionImpl(Event::DispatcherImpl& dispatcher, int fd,
@@ -38,7 +43,12 @@ ConnectionImpl::ConnectionImpl(Event::DispatcherImpl& dispatcher, int fd,
   BIO* bio = BIO_new_socket(fd, 0);
   SSL_set_bio(ssl_.get(), bio, bio);
 
-  SSL_set_mode(ssl_.get(), SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+  // Release the library's record buffers whenever they are empty so that an idle connection does
+  // not hold on to them. BoringSSL always does this, OpenSSL only does so in this mode.
+  SSL_set_mode(ssl_.get(), SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER | SSL_MODE_RELEASE_BUFFERS);
+  if (ctx_.privateKeyOffload()) {
+    PrivateKeyOffload::setCallbacks(ssl_.get(), *this);
+  }
   if (state == InitialState::Client) {
     SSL_set_connect_state(ssl_.get());
   } else {
@@ -66,11 +76,14 @@ Network::ConnectionImpl::IoResult ConnectionImpl::doReadFromSocket() {
   PostIoAction action = PostIoAction::KeepOpen;
   uint64_t bytes_read = 0;
   while (keep_reading) {
-    // We use 2 slices here so that we can use the remainder of an existing buffer chain element
-    // if there is extra space. 16K read is arbitrary and can be tuned later.
+    // SSL_read() returns data from at most one record. Reserve what is left of the record that is
+    // being read if there is one, and a whole record otherwise. We use 2 slices here so that we can
+    // use the remainder of an existing buffer chain element if there is extra space.
+    const int pending = SSL_pending(ssl_.get());
     Buffer::RawSlice slices[2];
     uint64_t slices_to_commit = 0;
-    uint64_t num_slices = read_buffer_.reserve(16384, slices, 2);
+    uint64_t num_slices =
+        read_buffer_.reserve(pending > 0 ? pending : SSL3_RT_MAX_PLAIN_LENGTH, slices, 2);
     for (uint64_t i = 0; i < num_slices; i++) {
       int rc = SSL_read(ssl_.get(), slices[i].mem_, slices[i].len_);
       conn_log_trace("ssl read returns: {}", *this, rc);
@@ -96,12 +109,12 @@ Network::ConnectionImpl::IoResult ConnectionImpl::doReadFromSocket() {
       }
     }
 
-    if (slices_to_commit > 0) {
-      read_buffer_.commit(slices, slices_to_commit);
-      if (shouldDrainReadBuffer()) {
-        setReadBufferReady();
-        keep_reading = false;
-      }
+    // Commit even if nothing was read so that the unused reservation is freed. Otherwise an idle
+    // connection keeps a record sized slice around until its next read.
+    read_buffer_.commit(slices, slices_to_commit);
+    if (slices_to_commit > 0 && shouldDrainReadBuffer()) {
+      setReadBufferReady();
+      keep_reading = false;
     }
   }
 
@@ -119,6 +132,13 @@ Network::ConnectionImpl::PostIoAction ConnectionImpl::doHandshake() {
     }
 
     handshake_complete_ = true;
+    if (ctx_.kernelTlsTx() && KernelTls::enableTx(ssl_.get())) {
+      conn_log_debug("kernel TLS transmit enabled", *this);
+      ctx_.stats().kernel_tls_tx_.inc();
+      kernel_tls_tx_ = true;
+    }
+
+    onHandshakeComplete();
     raiseEvents(Network::ConnectionEvent::Connected);
 
     // It's possible that we closed during the handshake callback.
@@ -129,6 +149,8 @@ Network::ConnectionImpl::PostIoAction ConnectionImpl::doHandshake() {
     switch (err) {
     case SSL_ERROR_WANT_READ:
     case SSL_ERROR_WANT_WRITE:
+    // The handshake continues from onPrivateKeyOperationComplete().
+    case SSL_ERROR_WANT_PRIVATE_KEY_OPERATION:
       return PostIoAction::KeepOpen;
     default:
       drainErrorQueue();
@@ -137,6 +159,11 @@ Network::ConnectionImpl::PostIoAction ConnectionImpl::doHandshake() {
   }
 }
 
+void ConnectionImpl::onPrivateKeyOperationComplete() {
+  // The write path runs doHandshake() again, which picks up the result of the operation.
+  setWriteReady();
+}
+
 void ConnectionImpl::drainErrorQueue() {
   bool saw_error = false;
   while (uint64_t err = ERR_get_error()) {
@@ -159,27 +186,41 @@ Network::ConnectionImpl::IoResult ConnectionImpl::doWriteToSocket() {
     }
   }
 
+  if (kernel_tls_tx_) {
+    // The kernel frames and encrypts plaintext written to the socket.
+    return Network::ConnectionImpl::doWriteToSocket();
+  }
+
   uint64_t original_buffer_length = write_buffer_.length();
   uint64_t total_bytes_written = 0;
   bool keep_writing = true;
   while ((original_buffer_length != total_bytes_written) && keep_writing) {
     // Protect against stack overflow if the buffer has a very large buffer chain.
-    // TODO(mattklein123): See the comment on getRawSlices() for why we have to also check
-    // original_buffer_length != total_bytes_written during loop iteration.
     // TODO(mattklein123): As it relates to our fairness efforts, we might want to limit the number
     // of iterations of this loop, either by pure iterations, bytes written, etc.
     const uint64_t MAX_SLICES = 32;
+
+    // Each SSL_write() produces at least one TLS record and usually its own socket write. Small
+    // slices such as response headers are coalesced with what follows them into a full record so
+    // that small responses go out in a single record and a single packet. Repeated linearize()
+    // calls are a no-op once the front slice is large enough.
+    write_buffer_.linearize(
+        static_cast<uint32_t>(std::min(write_buffer_.length(), MaxTlsRecordPayload)));
+
     Buffer::RawSlice slices[MAX_SLICES];
-    uint64_t num_slices = write_buffer_.getRawSlices(slices, MAX_SLICES);
+    uint64_t num_slices = std::min(MAX_SLICES, write_buffer_.getRawSlices(slices, MAX_SLICES));
 
     uint64_t inner_bytes_written = 0;
     for (uint64_t i = 0; (i < num_slices) && (original_buffer_length != total_bytes_written); i++) {
       // SSL_write() requires that if a previous call returns SSL_ERROR_WANT_WRITE, we need to call
       // it again with the same parameters. Most implementations keep track of the last write size.
       // In our case we don't need to do that because: a) SSL_write() will not write partial
-      // buffers. b) We only move() into the write buffer, which means that it's impossible for a
-      // particular chain to increase in size. So as long as we start writing where we left off we
-      // are guaranteed to call SSL_write() with the same parameters.
+      // buffers. b) We only move() into the write buffer, which means that a particular slice can
+      // only grow if small data is coalesced into its tail. c) linearize() above only replaces the
+      // front slice with a larger copy of the same data, and SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER
+      // allows the pointer to change. So as long as we start writing where we left off we are
+      // guaranteed to call SSL_write() with the same data and a length that is at least as large
+      // as the previous call, which BoringSSL permits.
       int rc = SSL_write(ssl_.get(), slices[i].mem_, slices[i].len_);
       conn_log_trace("ssl write returns: {}", *this, rc);
       if (rc > 0) {
@@ -263,12 +304,35 @@ std::string ConnectionImpl::uriSanPeerCertificate() {
 ClientConnectionImpl::ClientConnectionImpl(Event::DispatcherImpl& dispatcher, Context& ctx,
                                            Network::Address::InstanceConstSharedPtr address)
     : ConnectionImpl(dispatcher, address->socket(Network::Address::SocketType::Stream), address,
-                     getNullLocalAddress(*address), ctx, InitialState::Client) {}
+                     getNullLocalAddress(*address), ctx, InitialState::Client),
+      client_ctx_(dynamic_cast<ClientContextImpl&>(ctx)) {
+  client_ctx_.resumeSession(ssl_.get(), remoteAddress().asString());
+}
 
 void ClientConnectionImpl::connect() { doConnect(); }
 
+void ClientConnectionImpl::onSocketReplaced(int fd) {
+  ConnectionImpl::onSocketReplaced(fd);
+  // Offer the session cached for the address that won instead.
+  SSL_set_session(ssl_.get(), nullptr);
+  client_ctx_.resumeSession(ssl_.get(), remoteAddress().asString());
+}
+
+void ClientConnectionImpl::onHandshakeComplete() {
+  client_ctx_.cacheSession(ssl_.get(), remoteAddress().asString());
+}
+
 void ConnectionImpl::closeSocket(uint32_t close_type) {
-  if (handshake_complete_ && state() != State::Closed) {
+  if (private_key_operation_) {
+    private_key_operation_->cancel();
+    private_key_operation_.reset();
+  }
+
+  if (kernel_tls_tx_ && state() != State::Closed) {
+    bool sent = KernelTls::sendCloseNotify(SSL_get_wfd(ssl_.get()));
+    conn_log_debug("kernel TLS close notify: sent={}", *this, sent);
+    UNREFERENCED_PARAMETER(sent);
+  } else if (handshake_complete_ && state() != State::Closed) {
     // Attempt to send a shutdown before closing the socket. It's possible this won't go out if
     // there is no room on the socket. We can extend the state machine to handle this at some point
     // if needed.
@@ -281,6 +345,12 @@ void ConnectionImpl::closeSocket(uint32_t close_type) {
   Network::ConnectionImpl::closeSocket(close_type);
 }
 
+void ConnectionImpl::onSocketReplaced(int fd) {
+  // The handshake has not started yet, so the SSL object only needs to use the new socket.
+  BIO* bio = BIO_new_socket(fd, 0);
+  SSL_set_bio(ssl_.get(), bio, bio);
+}
+
 std::string ConnectionImpl::nextProtocol() {
   const unsigned char* proto;
   unsigned int proto_len;
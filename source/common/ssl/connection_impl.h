@@ -5,11 +5,14 @@
 
 #include "common/network/connection_impl.h"
 #include "common/ssl/context_impl.h"
+#include "common/ssl/private_key_offload_impl.h"
 
 namespace Envoy {
 namespace Ssl {
 
-class ConnectionImpl : public Network::ConnectionImpl, public Connection {
+class ConnectionImpl : public Network::ConnectionImpl,
+                       public Connection,
+                       public PrivateKeyOperationCallbacks {
 public:
   enum class InitialState { Client, Server };
 
@@ -27,6 +30,23 @@ public:
   std::string sha256PeerCertificateDigest() override;
   std::string uriSanPeerCertificate() override;
 
+  // Ssl::PrivateKeyOperationCallbacks
+  Event::Dispatcher& privateKeyOperationDispatcher() override { return dispatcher(); }
+  PrivateKeyOperationSharedPtr& privateKeyOperation() override { return private_key_operation_; }
+  void onPrivateKeyOperationComplete() override;
+
+protected:
+  /**
+   * Called once the handshake has completed and the peer has been verified.
+   */
+  virtual void onHandshakeComplete() {}
+
+  // Network::ConnectionImpl
+  void onSocketReplaced(int fd) override;
+
+  ContextImpl& ctx_;
+  bssl::UniquePtr<SSL> ssl_;
+
 private:
   PostIoAction doHandshake();
   void drainErrorQueue();
@@ -37,9 +57,11 @@ private:
   IoResult doWriteToSocket() override;
   void onConnected() override;
 
-  ContextImpl& ctx_;
-  bssl::UniquePtr<SSL> ssl_;
   bool handshake_complete_{};
+  // Set once the kernel encrypts outgoing records. SSL_write() and SSL_shutdown() must not be used
+  // after that since BoringSSL's write sequence number is no longer advanced.
+  bool kernel_tls_tx_{};
+  PrivateKeyOperationSharedPtr private_key_operation_;
 };
 
 class ClientConnectionImpl final : public ConnectionImpl, public Network::ClientConnection {
@@ -49,6 +71,22 @@ public:
 
   // Network::ClientConnection
   void connect() override;
+  void setAlternateAddresses(
+      const std::vector<Network::Address::InstanceConstSharedPtr>& addresses) override {
+    addAlternateAddresses(addresses);
+  }
+  void setSocketOptions(Network::SocketOptionsConstSharedPtr options) override {
+    applySocketOptions(options);
+  }
+
+private:
+  // Network::ConnectionImpl
+  void onSocketReplaced(int fd) override;
+
+  // Ssl::ConnectionImpl
+  void onHandshakeComplete() override;
+
+  ClientContextImpl& client_ctx_;
 };
 
 } // Ssl
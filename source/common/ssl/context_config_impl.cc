@@ -37,11 +37,22 @@ ContextConfigImpl::ContextConfigImpl(const Json::Object& config) {
     cert_chain_file_ = config.getString("cert_chain_file");
     private_key_file_ = config.getString("private_key_file");
   }
+  if (config.hasObject("sni_certificates")) {
+    for (const Json::ObjectSharedPtr& certificate : config.getObjectArray("sni_certificates")) {
+      sni_certificates_.push_back(
+          {certificate->getString("cert_chain_file"), certificate->getString("private_key_file")});
+    }
+  }
   if (config.hasObject("verify_subject_alt_name")) {
     verify_subject_alt_name_list_ = config.getStringArray("verify_subject_alt_name");
   }
   verify_certificate_hash_ = config.getString("verify_certificate_hash", "");
   server_name_indication_ = config.getString("sni", "");
+  if (config.hasObject("session_ticket_key_paths")) {
+    session_ticket_key_paths_ = config.getStringArray("session_ticket_key_paths");
+  }
+  private_key_offload_threads_ = config.getInteger("private_key_offload_threads", 0);
+  kernel_tls_tx_ = config.getBoolean("kernel_tls_tx", false);
 }
 
 } // Ssl
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -22,11 +23,19 @@ public:
   const std::string& caCertFile() const override { return ca_cert_file_; }
   const std::string& certChainFile() const override { return cert_chain_file_; }
   const std::string& privateKeyFile() const override { return private_key_file_; }
+  const std::vector<CertificateFiles>& sniCertificates() const override {
+    return sni_certificates_;
+  }
   const std::vector<std::string>& verifySubjectAltNameList() const override {
     return verify_subject_alt_name_list_;
   };
   const std::string& verifyCertificateHash() const override { return verify_certificate_hash_; };
   const std::string& serverNameIndication() const override { return server_name_indication_; }
+  const std::vector<std::string>& sessionTicketKeyPaths() const override {
+    return session_ticket_key_paths_;
+  }
+  uint32_t privateKeyOffloadThreads() const override { return private_key_offload_threads_; }
+  bool kernelTlsTx() const override { return kernel_tls_tx_; }
 
 private:
   static const std::string DEFAULT_CIPHER_SUITES;
@@ -39,9 +48,13 @@ private:
   std::string ca_cert_file_;
   std::string cert_chain_file_;
   std::string private_key_file_;
+  std::vector<CertificateFiles> sni_certificates_;
   std::vector<std::string> verify_subject_alt_name_list_;
   std::string verify_certificate_hash_;
   std::string server_name_indication_;
+  std::vector<std::string> session_ticket_key_paths_;
+  uint32_t private_key_offload_threads_;
+  bool kernel_tls_tx_;
 };
 
 } // Ssl
@@ -10,7 +10,11 @@
 
 #include "common/common/assert.h"
 #include "common/common/hex.h"
+#include "common/common/utility.h"
+#include "common/filesystem/filesystem_impl.h"
 
+#include "openssl/hmac.h"
+#include "openssl/rand.h"
 #include "openssl/x509v3.h"
 #include "spdlog/spdlog.h"
 
@@ -20,75 +24,75 @@ namespace Ssl {
 const unsigned char ContextImpl::SERVER_SESSION_ID_CONTEXT = 1;
 
 ContextImpl::ContextImpl(ContextManagerImpl& parent, Stats::Scope& scope, ContextConfig& config)
-    : parent_(parent), ctx_(SSL_CTX_new(TLS_method())), scope_(scope),
-      stats_(generateStats(scope)) {
-  RELEASE_ASSERT(ctx_);
+    : parent_(parent), scope_(scope), stats_(generateStats(scope)),
+      kernel_tls_tx_(config.kernelTlsTx()) {
+  verify_subject_alt_name_list_ = config.verifySubjectAltNameList();
 
-  if (!SSL_CTX_set_strict_cipher_list(ctx_.get(), config.cipherSuites().c_str())) {
-    throw EnvoyException(
-        fmt::format("Failed to initialize cipher suites {}", config.cipherSuites()));
+  if (!config.verifyCertificateHash().empty()) {
+    std::string hash = config.verifyCertificateHash();
+    // remove ':' delimiters from hex string
+    hash.erase(std::remove(hash.begin(), hash.end(), ':'), hash.end());
+    verify_certificate_hash_ = Hex::decode(hash);
+  }
+}
+
+bssl::UniquePtr<SSL_CTX> ContextImpl::newCtx(const std::string& cipher_suites,
+                                             const std::string& ecdh_curves,
+                                             const std::string& ca_cert_file, X509* ca_cert) {
+  bssl::UniquePtr<SSL_CTX> ctx(SSL_CTX_new(TLS_method()));
+  RELEASE_ASSERT(ctx);
+
+  if (!SSL_CTX_set_strict_cipher_list(ctx.get(), cipher_suites.c_str())) {
+    throw EnvoyException(fmt::format("Failed to initialize cipher suites {}", cipher_suites));
   }
 
-  if (!SSL_CTX_set1_curves_list(ctx_.get(), config.ecdhCurves().c_str())) {
-    throw EnvoyException(fmt::format("Failed to initialize ECDH curves {}", config.ecdhCurves()));
+  if (!SSL_CTX_set1_curves_list(ctx.get(), ecdh_curves.c_str())) {
+    throw EnvoyException(fmt::format("Failed to initialize ECDH curves {}", ecdh_curves));
   }
 
-  if (!config.caCertFile().empty()) {
-    ca_cert_ = loadCert(config.caCertFile());
-    ca_file_path_ = config.caCertFile();
+  if (!ca_cert_file.empty()) {
+    ASSERT(ca_cert != nullptr);
     // set CA certificate
-    int rc = SSL_CTX_load_verify_locations(ctx_.get(), config.caCertFile().c_str(), nullptr);
+    int rc = SSL_CTX_load_verify_locations(ctx.get(), ca_cert_file.c_str(), nullptr);
     if (0 == rc) {
-      throw EnvoyException(
-          fmt::format("Failed to load verify locations file {}", config.caCertFile()));
+      throw EnvoyException(fmt::format("Failed to load verify locations file {}", ca_cert_file));
     }
 
     // This will send an acceptable CA list to browsers which will prevent pop ups.
-    rc = SSL_CTX_add_client_CA(ctx_.get(), ca_cert_.get());
+    rc = SSL_CTX_add_client_CA(ctx.get(), ca_cert);
     RELEASE_ASSERT(1 == rc);
 
     // enable peer certificate verification
-    SSL_CTX_set_verify(ctx_.get(), SSL_VERIFY_PEER, nullptr);
-  }
-
-  if (!config.certChainFile().empty()) {
-    cert_chain_ = loadCert(config.certChainFile());
-    cert_chain_file_path_ = config.certChainFile();
-    int rc = SSL_CTX_use_certificate_chain_file(ctx_.get(), config.certChainFile().c_str());
-    if (0 == rc) {
-      throw EnvoyException(
-          fmt::format("Failed to load certificate chain file {}", config.certChainFile()));
-    }
-
-    rc = SSL_CTX_use_PrivateKey_file(ctx_.get(), config.privateKeyFile().c_str(), SSL_FILETYPE_PEM);
-    if (0 == rc) {
-      throw EnvoyException(
-          fmt::format("Failed to load private key file {}", config.privateKeyFile()));
-    }
-  }
-
-  verify_subject_alt_name_list_ = config.verifySubjectAltNameList();
-
-  if (!config.verifyCertificateHash().empty()) {
-    std::string hash = config.verifyCertificateHash();
-    // remove ':' delimiters from hex string
-    hash.erase(std::remove(hash.begin(), hash.end(), ':'), hash.end());
-    verify_certificate_hash_ = Hex::decode(hash);
+    SSL_CTX_set_verify(ctx.get(), SSL_VERIFY_PEER, nullptr);
   }
 
-  SSL_CTX_set_options(ctx_.get(), SSL_OP_NO_SSLv3);
+  SSL_CTX_set_options(ctx.get(), SSL_OP_NO_SSLv3);
 
   // use the server's cipher list preferences
-  SSL_CTX_set_options(ctx_.get(), SSL_OP_CIPHER_SERVER_PREFERENCE);
+  SSL_CTX_set_options(ctx.get(), SSL_OP_CIPHER_SERVER_PREFERENCE);
 
-  SSL_CTX_set_session_id_context(ctx_.get(), &SERVER_SESSION_ID_CONTEXT,
+  SSL_CTX_set_session_id_context(ctx.get(), &SERVER_SESSION_ID_CONTEXT,
                                  sizeof SERVER_SESSION_ID_CONTEXT);
 
-  parsed_alpn_protocols_ = parseAlpnProtocols(config.alpnProtocols());
+  return ctx;
+}
+
+void ContextImpl::useCertificateChain(SSL_CTX* ctx, const CertificateFiles& files) {
+  int rc = SSL_CTX_use_certificate_chain_file(ctx, files.cert_chain_file_.c_str());
+  if (0 == rc) {
+    throw EnvoyException(
+        fmt::format("Failed to load certificate chain file {}", files.cert_chain_file_));
+  }
+
+  rc = SSL_CTX_use_PrivateKey_file(ctx, files.private_key_file_.c_str(), SSL_FILETYPE_PEM);
+  if (0 == rc) {
+    throw EnvoyException(
+        fmt::format("Failed to load private key file {}", files.private_key_file_));
+  }
 }
 
-int ServerContextImpl::alpnSelectCallback(const unsigned char** out, unsigned char* outlen,
-                                          const unsigned char* in, unsigned int inlen) {
+int ServerContextState::alpnSelectCallback(const unsigned char** out, unsigned char* outlen,
+                                           const unsigned char* in, unsigned int inlen) const {
   // Currently this uses the standard selection algorithm in priority order.
   const uint8_t* alpn_data = &parsed_alpn_protocols_[0];
   size_t alpn_data_size = parsed_alpn_protocols_.size();
@@ -133,14 +137,13 @@ std::vector<uint8_t> ContextImpl::parseAlpnProtocols(const std::string& alpn_pro
   return out;
 }
 
-bssl::UniquePtr<SSL> ContextImpl::newSsl() const {
-  return bssl::UniquePtr<SSL>(SSL_new(ctx_.get()));
-}
-
 bool ContextImpl::verifyPeer(SSL* ssl) const {
   bool verified = true;
 
   stats_.handshake_.inc();
+  if (SSL_session_reused(ssl)) {
+    stats_.session_reused_.inc();
+  }
 
   const char* cipher = SSL_get_cipher_name(ssl);
   scope_.counter(fmt::format("ssl.ciphers.{}", std::string{cipher})).inc();
@@ -238,10 +241,9 @@ SslStats ContextImpl::generateStats(Stats::Scope& store) {
                         POOL_TIMER_PREFIX(store, prefix))};
 }
 
-size_t ContextImpl::daysUntilFirstCertExpires() {
-  int daysUntilExpiration = getDaysUntilExpiration(ca_cert_.get());
-  daysUntilExpiration =
-      std::min<int>(getDaysUntilExpiration(cert_chain_.get()), daysUntilExpiration);
+size_t ContextImpl::daysUntilFirstCertExpires(const X509* ca_cert, const X509* cert_chain) {
+  int daysUntilExpiration = getDaysUntilExpiration(ca_cert);
+  daysUntilExpiration = std::min<int>(getDaysUntilExpiration(cert_chain), daysUntilExpiration);
   if (daysUntilExpiration < 0) { // Ensure that the return value is unsigned
     return 0;
   }
@@ -259,22 +261,12 @@ int32_t ContextImpl::getDaysUntilExpiration(const X509* cert) {
   return 0;
 }
 
-std::string ContextImpl::getCaCertInformation() {
-  if (ca_cert_ == nullptr) {
-    return "";
-  }
-  return fmt::format("Certificate Path: {}, Serial Number: {}, Days until Expiration: {}",
-                     getCaFileName(), getSerialNumber(ca_cert_.get()),
-                     getDaysUntilExpiration(ca_cert_.get()));
-}
-
-std::string ContextImpl::getCertChainInformation() {
-  if (cert_chain_ == nullptr) {
+std::string ContextImpl::getCertInformation(X509* cert, const std::string& path) {
+  if (cert == nullptr) {
     return "";
   }
-  return fmt::format("Certificate Path: {}, Serial Number: {}, Days until Expiration: {}",
-                     getCertChainFileName(), getSerialNumber(cert_chain_.get()),
-                     getDaysUntilExpiration(cert_chain_.get()));
+  return fmt::format("Certificate Path: {}, Serial Number: {}, Days until Expiration: {}", path,
+                     getSerialNumber(cert), getDaysUntilExpiration(cert));
 }
 
 std::string ContextImpl::getSerialNumber(X509* cert) {
@@ -304,10 +296,23 @@ bssl::UniquePtr<X509> ContextImpl::loadCert(const std::string& cert_file) {
 
 ClientContextImpl::ClientContextImpl(ContextManagerImpl& parent, Stats::Scope& scope,
                                      ContextConfig& config)
-    : ContextImpl(parent, scope, config) {
-  if (!parsed_alpn_protocols_.empty()) {
-    int rc = SSL_CTX_set_alpn_protos(ctx_.get(), &parsed_alpn_protocols_[0],
-                                     parsed_alpn_protocols_.size());
+    : ContextImpl(parent, scope, config), ca_cert_file_(config.caCertFile()),
+      cert_chain_file_(config.certChainFile()) {
+  if (!ca_cert_file_.empty()) {
+    ca_cert_ = loadCert(ca_cert_file_);
+  }
+
+  ctx_ = newCtx(config.cipherSuites(), config.ecdhCurves(), ca_cert_file_, ca_cert_.get());
+
+  if (!cert_chain_file_.empty()) {
+    cert_chain_ = loadCert(cert_chain_file_);
+    useCertificateChain(ctx_.get(), {cert_chain_file_, config.privateKeyFile()});
+  }
+
+  const std::vector<uint8_t> parsed_alpn_protocols = parseAlpnProtocols(config.alpnProtocols());
+  if (!parsed_alpn_protocols.empty()) {
+    int rc = SSL_CTX_set_alpn_protos(ctx_.get(), &parsed_alpn_protocols[0],
+                                     parsed_alpn_protocols.size());
     RELEASE_ASSERT(rc == 0);
     UNREFERENCED_PARAMETER(rc);
   }
@@ -316,7 +321,7 @@ ClientContextImpl::ClientContextImpl(ContextManagerImpl& parent, Stats::Scope& s
 }
 
 bssl::UniquePtr<SSL> ClientContextImpl::newSsl() const {
-  bssl::UniquePtr<SSL> ssl_con(ContextImpl::newSsl());
+  bssl::UniquePtr<SSL> ssl_con(SSL_new(ctx_.get()));
 
   if (!server_name_indication_.empty()) {
     int rc = SSL_set_tlsext_host_name(ssl_con.get(), server_name_indication_.c_str());
@@ -327,20 +332,335 @@ bssl::UniquePtr<SSL> ClientContextImpl::newSsl() const {
   return ssl_con;
 }
 
-ServerContextImpl::ServerContextImpl(ContextManagerImpl& parent, Stats::Scope& scope,
-                                     ContextConfig& config, Runtime::Loader& runtime)
-    : ContextImpl(parent, scope, config), runtime_(runtime) {
-  parsed_alt_alpn_protocols_ = parseAlpnProtocols(config.altAlpnProtocols());
+size_t ClientContextImpl::daysUntilFirstCertExpires() {
+  return ContextImpl::daysUntilFirstCertExpires(ca_cert_.get(), cert_chain_.get());
+}
+
+std::string ClientContextImpl::getCaCertInformation() {
+  return getCertInformation(ca_cert_.get(), ca_cert_file_);
+}
+
+std::string ClientContextImpl::getCertChainInformation() {
+  return getCertInformation(cert_chain_.get(), cert_chain_file_);
+}
+
+const size_t ClientContextImpl::MaxCachedSessions;
+
+void ClientContextImpl::resumeSession(SSL* ssl, const std::string& host) {
+  std::unique_lock<std::mutex> lock(session_lock_);
+  auto it = sessions_.find(host);
+  if (it != sessions_.end()) {
+    // SSL_set_session() takes its own reference to the session.
+    SSL_set_session(ssl, it->second.get());
+  }
+}
+
+void ClientContextImpl::cacheSession(SSL* ssl, const std::string& host) {
+  bssl::UniquePtr<SSL_SESSION> session(SSL_get1_session(ssl));
+  if (!session) {
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(session_lock_);
+  auto it = sessions_.find(host);
+  if (it != sessions_.end()) {
+    it->second = std::move(session);
+    return;
+  }
+
+  // Hosts come and go with cluster membership. Rather than tracking them, drop an arbitrary entry
+  // once the cache is full. At worst this costs that host a full handshake.
+  if (sessions_.size() >= MaxCachedSessions) {
+    sessions_.erase(sessions_.begin());
+  }
+  sessions_.emplace(host, std::move(session));
+}
+
+ServerContextState::ServerContextState(const ContextConfig& config, Runtime::Loader& runtime)
+    : ServerContextState(settings(config), runtime) {}
+
+ServerContextState::ServerContextState(const Settings& settings, Runtime::Loader& runtime)
+    : settings_(settings), runtime_(runtime),
+      parsed_alpn_protocols_(ContextImpl::parseAlpnProtocols(settings.alpn_protocols_)),
+      parsed_alt_alpn_protocols_(ContextImpl::parseAlpnProtocols(settings.alt_alpn_protocols_)) {
+  if (!settings_.ca_cert_file_.empty()) {
+    ca_cert_ = ContextImpl::loadCert(settings_.ca_cert_file_);
+  }
+
+  for (const std::string& path : settings_.session_ticket_key_paths_) {
+    session_ticket_keys_.push_back(loadSessionTicketKey(path));
+  }
+
+  for (const CertificateFiles& files : settings_.certificates_) {
+    addCertificate(files);
+  }
+}
+
+ServerContextState::Settings ServerContextState::settings(const ContextConfig& config) {
+  Settings settings;
+  settings.cipher_suites_ = config.cipherSuites();
+  settings.ecdh_curves_ = config.ecdhCurves();
+  settings.ca_cert_file_ = config.caCertFile();
+  settings.certificates_.push_back({config.certChainFile(), config.privateKeyFile()});
+  settings.certificates_.insert(settings.certificates_.end(), config.sniCertificates().begin(),
+                                config.sniCertificates().end());
+  settings.alpn_protocols_ = config.alpnProtocols();
+  settings.alt_alpn_protocols_ = config.altAlpnProtocols();
+  settings.session_ticket_key_paths_ = config.sessionTicketKeyPaths();
+  settings.private_key_offload_threads_ = config.privateKeyOffloadThreads();
+  return settings;
+}
+
+std::string ServerContextState::key(const ContextConfig& config) {
+  const Settings settings = ServerContextState::settings(config);
+  std::vector<std::string> parts{settings.cipher_suites_,
+                                 settings.ecdh_curves_,
+                                 settings.ca_cert_file_,
+                                 settings.alpn_protocols_,
+                                 settings.alt_alpn_protocols_,
+                                 std::to_string(settings.private_key_offload_threads_),
+                                 std::to_string(settings.certificates_.size())};
+  for (const CertificateFiles& files : settings.certificates_) {
+    parts.push_back(files.cert_chain_file_);
+    parts.push_back(files.private_key_file_);
+  }
+  parts.insert(parts.end(), settings.session_ticket_key_paths_.begin(),
+               settings.session_ticket_key_paths_.end());
+
+  // None of the settings can contain a NUL, so they can not run into each other.
+  return StringUtil::join(parts, std::string(1, '\0'));
+}
+
+ServerContextStateSharedPtr ServerContextState::reload() const {
+  return ServerContextStateSharedPtr{new ServerContextState(settings_, runtime_)};
+}
+
+void ServerContextState::addCertificate(const CertificateFiles& files) {
+  Certificate certificate;
+  certificate.ctx_ = ContextImpl::newCtx(settings_.cipher_suites_, settings_.ecdh_curves_,
+                                         settings_.ca_cert_file_, ca_cert_.get());
+  SSL_CTX* ctx = certificate.ctx_.get();
+
+  if (!files.cert_chain_file_.empty()) {
+    certificate.cert_ = ContextImpl::loadCert(files.cert_chain_file_);
+    ContextImpl::useCertificateChain(ctx, files);
+
+    if (settings_.private_key_offload_threads_ > 0 && !files.private_key_file_.empty()) {
+      certificate.private_key_offload_.reset(
+          new PrivateKeyOffload(files.private_key_file_, settings_.private_key_offload_threads_));
+      certificate.private_key_offload_->install(ctx);
+    }
+  }
+
+  // Every SSL_CTX gets the same callbacks, since a connection switches to the SSL_CTX of its
+  // certificate part way through its handshake. The callbacks find the state through the SSL.
+  if (settings_.certificates_.size() > 1) {
+    SSL_CTX_set_tlsext_servername_callback(ctx, [](SSL* ssl, int*, void*) -> int {
+      return fromSsl(ssl).selectCertificate(ssl);
+    });
+  }
 
   if (!parsed_alpn_protocols_.empty()) {
-    SSL_CTX_set_alpn_select_cb(ctx_.get(),
-                               [](SSL*, const unsigned char** out, unsigned char* outlen,
-                                  const unsigned char* in, unsigned int inlen, void* arg) -> int {
-                                 return static_cast<ServerContextImpl*>(arg)
-                                     ->alpnSelectCallback(out, outlen, in, inlen);
+    SSL_CTX_set_alpn_select_cb(ctx,
+                               [](SSL* ssl, const unsigned char** out, unsigned char* outlen,
+                                  const unsigned char* in, unsigned int inlen, void*) -> int {
+                                 return fromSsl(ssl).alpnSelectCallback(out, outlen, in, inlen);
                                },
-                               this);
+                               nullptr);
+  }
+
+  if (!session_ticket_keys_.empty()) {
+    SSL_CTX_set_tlsext_ticket_key_cb(
+        ctx, [](SSL* ssl, uint8_t* key_name, uint8_t* iv, EVP_CIPHER_CTX* cipher_ctx,
+                HMAC_CTX* hmac_ctx, int encrypt) -> int {
+          return fromSsl(ssl).sessionTicketProcess(key_name, iv, cipher_ctx, hmac_ctx, encrypt);
+        });
+  }
+
+  if (certificate.cert_) {
+    for (const std::string& name : serverNames(certificate.cert_.get())) {
+      if (StringUtil::startsWith(name.c_str(), "*.")) {
+        wildcard_server_names_.emplace(name.substr(2), ctx);
+      } else {
+        server_names_.emplace(name, ctx);
+      }
+    }
+  }
+
+  certificates_.push_back(std::move(certificate));
+}
+
+std::vector<std::string> ServerContextState::serverNames(X509* cert) {
+  std::vector<std::string> names;
+  STACK_OF(GENERAL_NAME)* altnames = static_cast<STACK_OF(GENERAL_NAME)*>(
+      X509_get_ext_d2i(cert, NID_subject_alt_name, nullptr, nullptr));
+
+  if (altnames) {
+    int n = sk_GENERAL_NAME_num(altnames);
+    for (int i = 0; i < n; i++) {
+      GENERAL_NAME* altname = sk_GENERAL_NAME_value(altnames, i);
+      if (altname->type == GEN_DNS) {
+        ASN1_STRING* str = altname->d.dNSName;
+        names.emplace_back(reinterpret_cast<const char*>(ASN1_STRING_data(str)),
+                           ASN1_STRING_length(str));
+      }
+    }
+
+    sk_GENERAL_NAME_pop_free(altnames, GENERAL_NAME_free);
   }
+
+  // A certificate without DNS names is served for its common name.
+  if (names.empty()) {
+    X509_NAME* subject = X509_get_subject_name(cert);
+    const int index = X509_NAME_get_index_by_NID(subject, NID_commonName, -1);
+    if (index >= 0) {
+      ASN1_STRING* str = X509_NAME_ENTRY_get_data(X509_NAME_get_entry(subject, index));
+      names.emplace_back(reinterpret_cast<const char*>(ASN1_STRING_data(str)),
+                         ASN1_STRING_length(str));
+    }
+  }
+
+  for (std::string& name : names) {
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+  }
+  return names;
+}
+
+int ServerContextState::sslIndex() {
+  // Each SSL holds a reference to the state it was created from, which is dropped when the SSL is
+  // freed.
+  static const int index = SSL_get_ex_new_index(
+      0, nullptr, nullptr, nullptr,
+      [](void*, void* ptr, CRYPTO_EX_DATA*, int, long, void*) -> void {
+        delete static_cast<std::shared_ptr<const ServerContextState>*>(ptr);
+      });
+  RELEASE_ASSERT(index >= 0);
+  return index;
+}
+
+const ServerContextState& ServerContextState::fromSsl(const SSL* ssl) {
+  void* state = SSL_get_ex_data(ssl, sslIndex());
+  ASSERT(state != nullptr);
+  return **static_cast<std::shared_ptr<const ServerContextState>*>(state);
+}
+
+bssl::UniquePtr<SSL> ServerContextState::newSsl() const {
+  bssl::UniquePtr<SSL> ssl(SSL_new(certificates_.front().ctx_.get()));
+  int rc = SSL_set_ex_data(ssl.get(), sslIndex(),
+                           new std::shared_ptr<const ServerContextState>(shared_from_this()));
+  RELEASE_ASSERT(rc == 1);
+  UNREFERENCED_PARAMETER(rc);
+  return ssl;
+}
+
+SSL_CTX* ServerContextState::findCtx(std::string server_name) const {
+  std::transform(server_name.begin(), server_name.end(), server_name.begin(), ::tolower);
+  auto it = server_names_.find(server_name);
+  if (it != server_names_.end()) {
+    return it->second;
+  }
+
+  // A wildcard name covers a single label.
+  const size_t dot = server_name.find('.');
+  if (dot != std::string::npos) {
+    it = wildcard_server_names_.find(server_name.substr(dot + 1));
+    if (it != wildcard_server_names_.end()) {
+      return it->second;
+    }
+  }
+
+  return nullptr;
+}
+
+int ServerContextState::selectCertificate(SSL* ssl) const {
+  // Clients that do not indicate a server name, or indicate one that no certificate serves, are
+  // served the default certificate.
+  const char* server_name = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+  if (server_name != nullptr) {
+    SSL_CTX* ctx = findCtx(server_name);
+    if (ctx != nullptr && ctx != SSL_get_SSL_CTX(ssl)) {
+      SSL_set_SSL_CTX(ssl, ctx);
+    }
+  }
+
+  return SSL_TLSEXT_ERR_OK;
+}
+
+ServerContextState::SessionTicketKey
+ServerContextState::loadSessionTicketKey(const std::string& path) {
+  const std::string data = Filesystem::fileReadToEnd(path);
+  SessionTicketKey key;
+  if (data.size() != key.name_.size() + key.hmac_key_.size() + key.aes_key_.size()) {
+    throw EnvoyException(fmt::format("Invalid session ticket key file '{}': expected {} bytes",
+                                     path, sizeof(SessionTicketKey)));
+  }
+
+  const uint8_t* pos = reinterpret_cast<const uint8_t*>(data.data());
+  std::copy(pos, pos + key.name_.size(), key.name_.begin());
+  pos += key.name_.size();
+  std::copy(pos, pos + key.hmac_key_.size(), key.hmac_key_.begin());
+  pos += key.hmac_key_.size();
+  std::copy(pos, pos + key.aes_key_.size(), key.aes_key_.begin());
+  return key;
+}
+
+int ServerContextState::sessionTicketProcess(uint8_t* key_name, uint8_t* iv, EVP_CIPHER_CTX* ctx,
+                                             HMAC_CTX* hmac_ctx, int encrypt) const {
+  const EVP_MD* hmac = EVP_sha256();
+  const EVP_CIPHER* cipher = EVP_aes_256_cbc();
+
+  if (encrypt == 1) {
+    // New tickets are always encrypted with the first key.
+    const SessionTicketKey& key = session_ticket_keys_.front();
+    static_assert(sizeof(key.name_) == SSL_TICKET_KEY_NAME_LEN, "Expected 16-byte ticket key name");
+    if (!RAND_bytes(iv, EVP_CIPHER_iv_length(cipher))) {
+      return -1;
+    }
+
+    std::copy(key.name_.begin(), key.name_.end(), key_name);
+    if (!EVP_EncryptInit_ex(ctx, cipher, nullptr, key.aes_key_.data(), iv) ||
+        !HMAC_Init_ex(hmac_ctx, key.hmac_key_.data(), key.hmac_key_.size(), hmac, nullptr)) {
+      return -1;
+    }
+
+    return 1;
+  }
+
+  for (size_t i = 0; i < session_ticket_keys_.size(); i++) {
+    const SessionTicketKey& key = session_ticket_keys_[i];
+    if (std::equal(key.name_.begin(), key.name_.end(), key_name)) {
+      if (!HMAC_Init_ex(hmac_ctx, key.hmac_key_.data(), key.hmac_key_.size(), hmac, nullptr) ||
+          !EVP_DecryptInit_ex(ctx, cipher, nullptr, key.aes_key_.data(), iv)) {
+        return -1;
+      }
+
+      // Tickets encrypted with an older key are accepted and then replaced with one encrypted
+      // with the current key.
+      return i == 0 ? 1 : 2;
+    }
+  }
+
+  // Unknown key, which falls back to a full handshake.
+  return 0;
+}
+
+ServerContextImpl::ServerContextImpl(ContextManagerImpl& parent, Stats::Scope& scope,
+                                     ContextConfig& config, ServerContextStateSharedPtr state)
+    : ContextImpl(parent, scope, config), state_(state) {}
+
+size_t ServerContextImpl::daysUntilFirstCertExpires() {
+  ServerContextStateSharedPtr state = this->state();
+  return ContextImpl::daysUntilFirstCertExpires(state->caCert(), state->certChain());
+}
+
+std::string ServerContextImpl::getCaCertInformation() {
+  ServerContextStateSharedPtr state = this->state();
+  return getCertInformation(state->caCert(), state->caCertFile());
+}
+
+std::string ServerContextImpl::getCertChainInformation() {
+  ServerContextStateSharedPtr state = this->state();
+  return getCertInformation(state->certChain(), state->certChainFile());
 }
 
 } // Ssl
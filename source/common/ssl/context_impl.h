@@ -1,6 +1,11 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "envoy/runtime/runtime.h"
@@ -11,6 +16,7 @@
 
 #include "common/ssl/context_impl.h"
 #include "common/ssl/context_manager_impl.h"
+#include "common/ssl/private_key_offload_impl.h"
 
 #include "openssl/ssl.h"
 
@@ -27,7 +33,9 @@ namespace Ssl {
   COUNTER(handshake)                                                                               \
   COUNTER(no_certificate)                                                                          \
   COUNTER(fail_verify_san)                                                                         \
-  COUNTER(fail_verify_cert_hash)
+  COUNTER(fail_verify_cert_hash)                                                                   \
+  COUNTER(session_reused)                                                                          \
+  COUNTER(kernel_tls_tx)
 // clang-format on
 
 /**
@@ -41,7 +49,10 @@ class ContextImpl : public virtual Context {
 public:
   ~ContextImpl() { parent_.releaseContext(this); }
 
-  virtual bssl::UniquePtr<SSL> newSsl() const;
+  /**
+   * @return a new SSL for a connection that uses this context.
+   */
+  virtual bssl::UniquePtr<SSL> newSsl() const PURE;
 
   /**
    * Performs all configured cert verifications on the connection
@@ -67,12 +78,46 @@ public:
    */
   static bool dNSNameMatch(const std::string& dnsName, const char* pattern);
 
+  /**
+   * Create an SSL_CTX with the settings that client and server contexts share.
+   * @param cipher_suites supplies the ':' delimited list of cipher suites.
+   * @param ecdh_curves supplies the ':' delimited list of ECDH curves.
+   * @param ca_cert_file supplies the CA certificate file that peers are verified against, or "" not
+   *        to verify peers.
+   * @param ca_cert supplies the certificate loaded from ca_cert_file, if any.
+   * throws EnvoyException if the cipher suites, ECDH curves or CA certificate file are invalid.
+   */
+  static bssl::UniquePtr<SSL_CTX> newCtx(const std::string& cipher_suites,
+                                         const std::string& ecdh_curves,
+                                         const std::string& ca_cert_file, X509* ca_cert);
+
+  /**
+   * Make an SSL_CTX identify itself with a certificate chain.
+   * throws EnvoyException if the certificate chain or private key file can not be loaded.
+   */
+  static void useCertificateChain(SSL_CTX* ctx, const CertificateFiles& files);
+
+  /**
+   * Load the first certificate of a PEM file.
+   * throws EnvoyException if the file can not be loaded.
+   */
+  static bssl::UniquePtr<X509> loadCert(const std::string& cert_file);
+
+  static std::vector<uint8_t> parseAlpnProtocols(const std::string& alpn_protocols);
+
   SslStats& stats() { return stats_; }
 
-  // Ssl::Context
-  size_t daysUntilFirstCertExpires() override;
-  std::string getCaCertInformation() override;
-  std::string getCertChainInformation() override;
+  /**
+   * @return true if the private key operations of this context's handshakes are offloaded, in
+   *         which case each connection must register with PrivateKeyOffload::setCallbacks().
+   */
+  virtual bool privateKeyOffload() const { return false; }
+
+  /**
+   * @return true if connections should hand TLS record encryption to the kernel after the
+   *         handshake.
+   */
+  bool kernelTlsTx() const { return kernel_tls_tx_; }
 
 protected:
   ContextImpl(ContextManagerImpl& parent, Stats::Scope& scope, ContextConfig& config);
@@ -95,48 +140,196 @@ protected:
    */
   static bool verifyCertificateHash(X509* cert, const std::vector<uint8_t>& certificate_hash);
 
-  std::vector<uint8_t> parseAlpnProtocols(const std::string& alpn_protocols);
   static SslStats generateStats(Stats::Scope& scope);
-  int32_t getDaysUntilExpiration(const X509* cert);
-  bssl::UniquePtr<X509> loadCert(const std::string& cert_file);
+  static int32_t getDaysUntilExpiration(const X509* cert);
+  static size_t daysUntilFirstCertExpires(const X509* ca_cert, const X509* cert_chain);
+  static std::string getCertInformation(X509* cert, const std::string& path);
   static std::string getSerialNumber(X509* cert);
-  std::string getCaFileName() { return ca_file_path_; };
-  std::string getCertChainFileName() { return cert_chain_file_path_; };
 
   ContextManagerImpl& parent_;
-  bssl::UniquePtr<SSL_CTX> ctx_;
   std::vector<std::string> verify_subject_alt_name_list_;
   std::vector<uint8_t> verify_certificate_hash_;
   Stats::Scope& scope_;
   SslStats stats_;
-  std::vector<uint8_t> parsed_alpn_protocols_;
-  bssl::UniquePtr<X509> ca_cert_;
-  bssl::UniquePtr<X509> cert_chain_;
-  std::string ca_file_path_;
-  std::string cert_chain_file_path_;
+  const bool kernel_tls_tx_;
 };
 
 class ClientContextImpl : public ContextImpl, public ClientContext {
 public:
   ClientContextImpl(ContextManagerImpl& parent, Stats::Scope& scope, ContextConfig& config);
 
+  // ContextImpl
   bssl::UniquePtr<SSL> newSsl() const override;
 
+  /**
+   * Offer the session most recently negotiated with a host, if there is one, so that the
+   * handshake can resume it. This can be called from any thread.
+   * @param ssl supplies the connection that has not started its handshake yet.
+   * @param host supplies the key of the upstream host.
+   */
+  void resumeSession(SSL* ssl, const std::string& host);
+
+  /**
+   * Remember the session negotiated by a completed handshake for later connections to the same
+   * host. This can be called from any thread.
+   * @param ssl supplies the connection that completed its handshake.
+   * @param host supplies the key of the upstream host.
+   */
+  void cacheSession(SSL* ssl, const std::string& host);
+
+  // Ssl::Context
+  size_t daysUntilFirstCertExpires() override;
+  std::string getCaCertInformation() override;
+  std::string getCertChainInformation() override;
+
+  // The maximum number of hosts whose sessions are remembered.
+  static const size_t MaxCachedSessions = 1024;
+
 private:
+  std::string ca_cert_file_;
+  bssl::UniquePtr<X509> ca_cert_;
+  std::string cert_chain_file_;
+  bssl::UniquePtr<X509> cert_chain_;
+  bssl::UniquePtr<SSL_CTX> ctx_;
   std::string server_name_indication_;
+  std::mutex session_lock_;
+  std::unordered_map<std::string, bssl::UniquePtr<SSL_SESSION>> sessions_;
 };
 
-class ServerContextImpl : public ContextImpl, public ServerContext {
+/**
+ * The SSL_CTXs that server connections are created from: one for the default certificate and one
+ * for each SNI certificate, along with the server names that select them and the state that their
+ * callbacks use. All the server contexts whose configs build identical SSL_CTXs share one, so that
+ * each certificate is only loaded once. It never changes once built. A reload builds a new one that
+ * new connections use, while existing connections keep a reference to the one they started with.
+ */
+class ServerContextState : public std::enable_shared_from_this<ServerContextState> {
 public:
-  ServerContextImpl(ContextManagerImpl& parent, Stats::Scope& scope, ContextConfig& config,
-                    Runtime::Loader& runtime);
+  /**
+   * throws EnvoyException if any of the files of the config can not be loaded.
+   */
+  ServerContextState(const ContextConfig& config, Runtime::Loader& runtime);
+
+  /**
+   * @return a key that is the same for the configs that build identical states.
+   */
+  static std::string key(const ContextConfig& config);
+
+  /**
+   * @return a new state built from the same config, which reads every certificate, private key and
+   *         session ticket key file again.
+   * throws EnvoyException if any of the files can not be loaded.
+   */
+  std::shared_ptr<ServerContextState> reload() const;
+
+  /**
+   * @return a new SSL for a server connection. It selects its certificate from the server name
+   *         that the client indicates, and holds a reference to this state for as long as it lives.
+   */
+  bssl::UniquePtr<SSL> newSsl() const;
+
+  /**
+   * @return the SSL_CTX of the certificate that serves a server name, or nullptr if no certificate
+   *         does. A name that a certificate has exactly takes precedence over a wildcard name, and
+   *         earlier certificates take precedence over later ones.
+   */
+  SSL_CTX* findCtx(std::string server_name) const;
+
+  bool privateKeyOffload() const { return settings_.private_key_offload_threads_ > 0; }
+  X509* caCert() const { return ca_cert_.get(); }
+  const std::string& caCertFile() const { return settings_.ca_cert_file_; }
+  X509* certChain() const { return certificates_.front().cert_.get(); }
+  const std::string& certChainFile() const {
+    return settings_.certificates_.front().cert_chain_file_;
+  }
 
 private:
+  /**
+   * The parts of a ContextConfig that a state is built from, kept so that it can be built again.
+   */
+  struct Settings {
+    std::string cipher_suites_;
+    std::string ecdh_curves_;
+    std::string ca_cert_file_;
+    // The default certificate followed by the SNI certificates.
+    std::vector<CertificateFiles> certificates_;
+    std::string alpn_protocols_;
+    std::string alt_alpn_protocols_;
+    std::vector<std::string> session_ticket_key_paths_;
+    uint32_t private_key_offload_threads_;
+  };
+
+  /**
+   * A session ticket key in the 80 byte file format shared with other TLS servers: a 16 byte key
+   * name followed by a 32 byte HMAC secret and a 32 byte AES key.
+   */
+  struct SessionTicketKey {
+    std::array<uint8_t, 16> name_;
+    std::array<uint8_t, 32> hmac_key_;
+    std::array<uint8_t, 32> aes_key_;
+  };
+
+  struct Certificate {
+    bssl::UniquePtr<SSL_CTX> ctx_;
+    bssl::UniquePtr<X509> cert_;
+    PrivateKeyOffloadPtr private_key_offload_;
+  };
+
+  ServerContextState(const Settings& settings, Runtime::Loader& runtime);
+
+  static Settings settings(const ContextConfig& config);
+  static const ServerContextState& fromSsl(const SSL* ssl);
+  static int sslIndex();
+  static std::vector<std::string> serverNames(X509* cert);
+  static SessionTicketKey loadSessionTicketKey(const std::string& path);
+
+  void addCertificate(const CertificateFiles& files);
+  int selectCertificate(SSL* ssl) const;
   int alpnSelectCallback(const unsigned char** out, unsigned char* outlen, const unsigned char* in,
-                         unsigned int inlen);
+                         unsigned int inlen) const;
+  int sessionTicketProcess(uint8_t* key_name, uint8_t* iv, EVP_CIPHER_CTX* ctx,
+                           HMAC_CTX* hmac_ctx, int encrypt) const;
 
+  const Settings settings_;
   Runtime::Loader& runtime_;
+  bssl::UniquePtr<X509> ca_cert_;
+  std::vector<uint8_t> parsed_alpn_protocols_;
   std::vector<uint8_t> parsed_alt_alpn_protocols_;
+  std::vector<SessionTicketKey> session_ticket_keys_;
+  std::vector<Certificate> certificates_;
+  // The certificates that serve each server name, by name and by the domain of wildcard names.
+  std::unordered_map<std::string, SSL_CTX*> server_names_;
+  std::unordered_map<std::string, SSL_CTX*> wildcard_server_names_;
+};
+
+typedef std::shared_ptr<ServerContextState> ServerContextStateSharedPtr;
+
+class ServerContextImpl : public ContextImpl, public ServerContext {
+public:
+  ServerContextImpl(ContextManagerImpl& parent, Stats::Scope& scope, ContextConfig& config,
+                    ServerContextStateSharedPtr state);
+
+  /**
+   * @return the state that new connections are created from. This can be called from any thread.
+   */
+  ServerContextStateSharedPtr state() const { return std::atomic_load(&state_); }
+
+  /**
+   * Swap in the state that new connections are created from. This can be called from any thread.
+   */
+  void state(ServerContextStateSharedPtr state) { std::atomic_store(&state_, state); }
+
+  // ContextImpl
+  bssl::UniquePtr<SSL> newSsl() const override { return state()->newSsl(); }
+  bool privateKeyOffload() const override { return state()->privateKeyOffload(); }
+
+  // Ssl::Context
+  size_t daysUntilFirstCertExpires() override;
+  std::string getCaCertInformation() override;
+  std::string getCertChainInformation() override;
+
+private:
+  ServerContextStateSharedPtr state_;
 };
 
 } // Ssl
@@ -2,10 +2,17 @@
 
 #include <functional>
 #include <mutex>
+#include <string>
+#include <vector>
+
+#include "envoy/common/exception.h"
 
 #include "common/common/assert.h"
+#include "common/common/utility.h"
 #include "common/ssl/context_impl.h"
 
+#include "spdlog/spdlog.h"
+
 namespace Envoy {
 namespace Ssl {
 
@@ -28,12 +35,67 @@ ClientContextPtr ContextManagerImpl::createSslClientContext(Stats::Scope& scope,
 
 ServerContextPtr ContextManagerImpl::createSslServerContext(Stats::Scope& scope,
                                                             ContextConfig& config) {
-  ServerContextPtr context(new ServerContextImpl(*this, scope, config, runtime_));
+  ServerContextStateSharedPtr state;
+  {
+    // The state is built under the lock so that contexts created concurrently from the same config
+    // do not each build one.
+    std::unique_lock<std::mutex> lock(contexts_lock_);
+    for (auto it = server_states_.begin(); it != server_states_.end();) {
+      if (it->second.expired()) {
+        it = server_states_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    const std::string key = ServerContextState::key(config);
+    state = server_states_[key].lock();
+    if (!state) {
+      state.reset(new ServerContextState(config, runtime_));
+      server_states_[key] = state;
+    }
+  }
+
+  ServerContextPtr context(new ServerContextImpl(*this, scope, config, state));
   std::unique_lock<std::mutex> lock(contexts_lock_);
   contexts_.emplace_back(context.get());
   return context;
 }
 
+void ContextManagerImpl::reloadServerContexts() {
+  std::unique_lock<std::mutex> lock(contexts_lock_);
+  std::vector<std::string> errors;
+  for (auto& server_state : server_states_) {
+    ServerContextStateSharedPtr old_state = server_state.second.lock();
+    if (!old_state) {
+      continue;
+    }
+
+    // A state that fails to reload is left in place, so its contexts keep serving the
+    // certificates they already have.
+    ServerContextStateSharedPtr new_state;
+    try {
+      new_state = old_state->reload();
+    } catch (const EnvoyException& e) {
+      errors.push_back(e.what());
+      continue;
+    }
+
+    server_state.second = new_state;
+    for (Context* context : contexts_) {
+      ServerContextImpl* server_context = dynamic_cast<ServerContextImpl*>(context);
+      if (server_context != nullptr && server_context->state() == old_state) {
+        server_context->state(new_state);
+      }
+    }
+  }
+
+  if (!errors.empty()) {
+    throw EnvoyException(
+        fmt::format("Failed to reload server contexts: {}", StringUtil::join(errors, ", ")));
+  }
+}
+
 size_t ContextManagerImpl::daysUntilFirstCertExpires() {
   std::unique_lock<std::mutex> lock(contexts_lock_);
   size_t ret = std::numeric_limits<int>::max();
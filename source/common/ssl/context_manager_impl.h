@@ -2,7 +2,10 @@
 
 #include <functional>
 #include <list>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <unordered_map>
 
 #include "envoy/runtime/runtime.h"
 #include "envoy/ssl/context_manager.h"
@@ -10,12 +13,17 @@
 namespace Envoy {
 namespace Ssl {
 
+class ServerContextState;
+
 /**
  * The SSL context manager has the following threading model:
  * Contexts can be allocated via any thread (through in practice they are only allocated on the main
  * thread). They can be released from any thread (and in practice are since cluster information can
  * be released from any thread). Context allocation/free is a very uncommon thing so we just do a
  * global lock to protect it all.
+ *
+ * Server contexts whose configs build identical SSL_CTXs share a ServerContextState, which the
+ * manager looks up by ServerContextState::key() for as long as any context still uses it.
  */
 class ContextManagerImpl final : public ContextManager {
 public:
@@ -34,10 +42,12 @@ public:
   Ssl::ServerContextPtr createSslServerContext(Stats::Scope& scope, ContextConfig& config) override;
   size_t daysUntilFirstCertExpires() override;
   void iterateContexts(std::function<void(Context&)> callback) override;
+  void reloadServerContexts() override;
 
 private:
   Runtime::Loader& runtime_;
   std::list<Context*> contexts_;
+  std::unordered_map<std::string, std::weak_ptr<ServerContextState>> server_states_;
   std::mutex contexts_lock_;
 };
 
@@ -0,0 +1,145 @@
+#include "common/ssl/kernel_tls_impl.h"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "openssl/mem.h"
+
+#if __has_include(<linux/tls.h>)
+#include <linux/tls.h>
+// Sending alerts through the kernel arrived after TLS_TX so both are required.
+#ifdef TLS_SET_RECORD_TYPE
+#define ENVOY_KERNEL_TLS 1
+#endif
+#endif
+
+namespace Envoy {
+namespace Ssl {
+
+#ifdef ENVOY_KERNEL_TLS
+
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+
+namespace {
+
+// AES-128-GCM in TLS 1.2 has no MAC key, a 16 byte key and a 4 byte implicit IV (the salt).
+const size_t AesGcm128KeyBlockLen = 2 * TLS_CIPHER_AES_GCM_128_KEY_SIZE +
+                                    2 * TLS_CIPHER_AES_GCM_128_SALT_SIZE;
+
+const uint8_t TlsRecordTypeAlert = 21;
+
+bool isAesGcm128(const SSL_CIPHER* cipher) {
+  switch (SSL_CIPHER_get_id(cipher)) {
+  case TLS1_CK_RSA_WITH_AES_128_GCM_SHA256:
+  case TLS1_CK_ECDHE_RSA_WITH_AES_128_GCM_SHA256:
+  case TLS1_CK_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256:
+    return true;
+  default:
+    return false;
+  }
+}
+
+void storeBigEndian(uint64_t value, unsigned char* out) {
+  for (int i = 7; i >= 0; i--) {
+    out[i] = static_cast<unsigned char>(value & 0xff);
+    value >>= 8;
+  }
+}
+
+} // namespace
+
+bool KernelTls::enableTx(SSL* ssl) {
+  const SSL_CIPHER* cipher = SSL_get_current_cipher(ssl);
+  if (SSL_version(ssl) != TLS1_2_VERSION || cipher == nullptr || !isAesGcm128(cipher)) {
+    return false;
+  }
+
+  // The key block is laid out as client key, server key, client salt and server salt. Anything
+  // else means the cipher is not what the kernel expects.
+  if (SSL_get_key_block_len(ssl) != AesGcm128KeyBlockLen) {
+    return false;
+  }
+
+  std::vector<uint8_t> key_block(AesGcm128KeyBlockLen);
+  if (!SSL_generate_key_block(ssl, key_block.data(), key_block.size())) {
+    return false;
+  }
+
+  const bool is_server = SSL_is_server(ssl);
+  const uint8_t* key = key_block.data() + (is_server ? TLS_CIPHER_AES_GCM_128_KEY_SIZE : 0);
+  const uint8_t* salt = key_block.data() + 2 * TLS_CIPHER_AES_GCM_128_KEY_SIZE +
+                        (is_server ? TLS_CIPHER_AES_GCM_128_SALT_SIZE : 0);
+
+  tls12_crypto_info_aes_gcm_128 crypto_info;
+  memset(&crypto_info, 0, sizeof(crypto_info));
+  crypto_info.info.version = TLS_1_2_VERSION;
+  crypto_info.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+  memcpy(crypto_info.key, key, TLS_CIPHER_AES_GCM_128_KEY_SIZE);
+  memcpy(crypto_info.salt, salt, TLS_CIPHER_AES_GCM_128_SALT_SIZE);
+  // BoringSSL uses the record sequence number as the explicit nonce, and so does the kernel.
+  const uint64_t sequence = SSL_get_write_sequence(ssl);
+  storeBigEndian(sequence, crypto_info.iv);
+  storeBigEndian(sequence, crypto_info.rec_seq);
+
+  const int fd = SSL_get_wfd(ssl);
+  if (fd < 0) {
+    return false;
+  }
+
+  // Attaching the ULP fails on kernels without kTLS. Until TLS_TX succeeds the socket behaves
+  // like a plain TCP socket, so falling back to SSL_write() is always safe.
+  if (setsockopt(fd, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) != 0) {
+    return false;
+  }
+
+  bool enabled = setsockopt(fd, SOL_TLS, TLS_TX, &crypto_info, sizeof(crypto_info)) == 0;
+  OPENSSL_cleanse(&crypto_info, sizeof(crypto_info));
+  OPENSSL_cleanse(key_block.data(), key_block.size());
+  return enabled;
+}
+
+bool KernelTls::sendCloseNotify(int fd) {
+  // close_notify is a warning level alert with description 0.
+  uint8_t alert[2] = {1, 0};
+  struct iovec iov;
+  iov.iov_base = alert;
+  iov.iov_len = sizeof(alert);
+
+  char control[CMSG_SPACE(sizeof(TlsRecordTypeAlert))];
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_TLS;
+  cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(TlsRecordTypeAlert));
+  memcpy(CMSG_DATA(cmsg), &TlsRecordTypeAlert, sizeof(TlsRecordTypeAlert));
+
+  return sendmsg(fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) == sizeof(alert);
+}
+
+#else
+
+bool KernelTls::enableTx(SSL*) { return false; }
+
+bool KernelTls::sendCloseNotify(int) { return false; }
+
+#endif
+
+} // Ssl
+} // Envoy
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "openssl/ssl.h"
+
+namespace Envoy {
+namespace Ssl {
+
+/**
+ * Hands the encryption of outgoing TLS records to the kernel (Linux kTLS). Once transmit offload
+ * is enabled on a connection, plaintext written to its socket is framed and encrypted by the
+ * kernel, so bulk writes no longer pass through SSL_write() and need no copy into a userspace
+ * record buffer. Decryption of incoming records stays with BoringSSL.
+ */
+class KernelTls {
+public:
+  /**
+   * Install the write keys of a connection into the kernel. Only TLS 1.2 connections that
+   * negotiated AES-128-GCM can be offloaded. This must be called right after the handshake
+   * completes, before any application data has been written with SSL_write().
+   * @param ssl supplies the connection, whose BIO must be a socket BIO.
+   * @return true if the kernel now encrypts everything written to the socket. On false the
+   *         connection is unchanged and must keep writing with SSL_write().
+   */
+  static bool enableTx(SSL* ssl);
+
+  /**
+   * Send a close_notify alert on a socket that has transmit offload enabled. SSL_shutdown() can
+   * no longer be used since BoringSSL does not know the kernel's write sequence number.
+   * @param fd supplies the socket.
+   * @return true if the alert was handed to the kernel.
+   */
+  static bool sendCloseNotify(int fd);
+};
+
+} // Ssl
+} // Envoy
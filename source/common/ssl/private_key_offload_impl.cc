@@ -0,0 +1,312 @@
+#include "common/ssl/private_key_offload_impl.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "envoy/common/exception.h"
+
+#include "common/common/assert.h"
+
+#include "openssl/ec.h"
+#include "openssl/ec_key.h"
+#include "openssl/evp.h"
+#include "openssl/pem.h"
+#include "openssl/rsa.h"
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+namespace Ssl {
+
+namespace {
+
+struct SignatureAlgorithm {
+  uint16_t id_;
+  const EVP_MD* (*digest_)();
+  bool is_pss_;
+};
+
+// clang-format off
+const SignatureAlgorithm SignatureAlgorithms[] = {
+  {SSL_SIGN_RSA_PKCS1_MD5_SHA1,        EVP_md5_sha1, false},
+  {SSL_SIGN_RSA_PKCS1_SHA1,            EVP_sha1,     false},
+  {SSL_SIGN_RSA_PKCS1_SHA256,          EVP_sha256,   false},
+  {SSL_SIGN_RSA_PKCS1_SHA384,          EVP_sha384,   false},
+  {SSL_SIGN_RSA_PKCS1_SHA512,          EVP_sha512,   false},
+  {SSL_SIGN_RSA_PSS_SHA256,            EVP_sha256,   true},
+  {SSL_SIGN_RSA_PSS_SHA384,            EVP_sha384,   true},
+  {SSL_SIGN_RSA_PSS_SHA512,            EVP_sha512,   true},
+  {SSL_SIGN_ECDSA_SHA1,                EVP_sha1,     false},
+  {SSL_SIGN_ECDSA_SECP256R1_SHA256,    EVP_sha256,   false},
+  {SSL_SIGN_ECDSA_SECP384R1_SHA384,    EVP_sha384,   false},
+  {SSL_SIGN_ECDSA_SECP521R1_SHA512,    EVP_sha512,   false},
+};
+// clang-format on
+
+bool signWithKey(EVP_PKEY* key, uint16_t signature_algorithm, const std::vector<uint8_t>& in,
+                 std::vector<uint8_t>& out) {
+  const SignatureAlgorithm* algorithm = nullptr;
+  for (const SignatureAlgorithm& candidate : SignatureAlgorithms) {
+    if (candidate.id_ == signature_algorithm) {
+      algorithm = &candidate;
+      break;
+    }
+  }
+
+  if (algorithm == nullptr) {
+    return false;
+  }
+
+  bssl::ScopedEVP_MD_CTX ctx;
+  EVP_PKEY_CTX* pkey_ctx;
+  if (!EVP_DigestSignInit(ctx.get(), &pkey_ctx, algorithm->digest_(), nullptr, key)) {
+    return false;
+  }
+
+  if (algorithm->is_pss_ && (!EVP_PKEY_CTX_set_rsa_padding(pkey_ctx, RSA_PKCS1_PSS_PADDING) ||
+                             !EVP_PKEY_CTX_set_rsa_pss_saltlen(pkey_ctx, -1))) {
+    return false;
+  }
+
+  size_t out_len = EVP_PKEY_size(key);
+  out.resize(out_len);
+  if (!EVP_DigestSignUpdate(ctx.get(), in.data(), in.size()) ||
+      !EVP_DigestSignFinal(ctx.get(), out.data(), &out_len)) {
+    return false;
+  }
+
+  out.resize(out_len);
+  return true;
+}
+
+bool decryptWithKey(EVP_PKEY* key, const std::vector<uint8_t>& in, std::vector<uint8_t>& out) {
+  // BoringSSL removes the padding itself so the decryption is raw RSA.
+  RSA* rsa = EVP_PKEY_get0_RSA(key);
+  if (rsa == nullptr) {
+    return false;
+  }
+
+  size_t out_len;
+  out.resize(RSA_size(rsa));
+  if (!RSA_decrypt(rsa, &out_len, out.data(), out.size(), in.data(), in.size(), RSA_NO_PADDING)) {
+    return false;
+  }
+
+  out.resize(out_len);
+  return true;
+}
+
+} // namespace
+
+void PrivateKeyOperation::cancel() {
+  std::unique_lock<std::mutex> lock(lock_);
+  callbacks_ = nullptr;
+}
+
+void PrivateKeyOperation::complete(bool success, std::vector<uint8_t>&& output) {
+  success_ = success;
+  output_ = std::move(output);
+
+  // The lock keeps the connection, and therefore its dispatcher, from going away while posting.
+  std::unique_lock<std::mutex> lock(lock_);
+  if (callbacks_ != nullptr) {
+    PrivateKeyOperationSharedPtr self = shared_from_this();
+    dispatcher_.post([self]() -> void {
+      self->done_ = true;
+      // The connection may have been closed after the post. cancel() runs on this thread so there
+      // is no need to lock here.
+      if (self->callbacks_ != nullptr) {
+        self->callbacks_->onPrivateKeyOperationComplete();
+      }
+    });
+  }
+}
+
+enum ssl_private_key_result_t PrivateKeyOperation::result(uint8_t* out, size_t* out_len,
+                                                          size_t max_out) const {
+  ASSERT(done_);
+  if (!success_ || output_.size() > max_out) {
+    return ssl_private_key_failure;
+  }
+
+  std::copy(output_.begin(), output_.end(), out);
+  *out_len = output_.size();
+  return ssl_private_key_success;
+}
+
+PrivateKeyOffload::PrivateKeyOffload(const std::string& private_key_file, uint32_t num_threads) {
+  ASSERT(num_threads > 0);
+  std::unique_ptr<FILE, decltype(&fclose)> fp(fopen(private_key_file.c_str(), "r"), &fclose);
+  if (fp.get() != nullptr) {
+    key_.reset(PEM_read_PrivateKey(fp.get(), nullptr, nullptr, nullptr));
+  }
+  if (!key_) {
+    throw EnvoyException(fmt::format("Failed to load private key file {}", private_key_file));
+  }
+
+  if (EVP_PKEY_id(key_.get()) != EVP_PKEY_RSA && EVP_PKEY_id(key_.get()) != EVP_PKEY_EC) {
+    throw EnvoyException(
+        fmt::format("Private key offload requires an RSA or ECDSA key: {}", private_key_file));
+  }
+
+  for (uint32_t i = 0; i < num_threads; i++) {
+    threads_.emplace_back(new Thread::Thread([this]() -> void { threadRoutine(); }));
+  }
+}
+
+PrivateKeyOffload::~PrivateKeyOffload() {
+  {
+    std::unique_lock<std::mutex> lock(lock_);
+    shutdown_ = true;
+  }
+  cv_.notify_all();
+
+  for (Thread::ThreadPtr& thread : threads_) {
+    thread->join();
+  }
+}
+
+void PrivateKeyOffload::install(SSL_CTX* ctx) {
+  int rc = SSL_CTX_set_ex_data(ctx, sslCtxIndex(), this);
+  RELEASE_ASSERT(rc == 1);
+  UNREFERENCED_PARAMETER(rc);
+  SSL_CTX_set_private_key_method(ctx, &method());
+}
+
+void PrivateKeyOffload::setCallbacks(SSL* ssl, PrivateKeyOperationCallbacks& callbacks) {
+  int rc = SSL_set_ex_data(ssl, sslIndex(), &callbacks);
+  RELEASE_ASSERT(rc == 1);
+  UNREFERENCED_PARAMETER(rc);
+}
+
+const SSL_PRIVATE_KEY_METHOD& PrivateKeyOffload::method() {
+  static const SSL_PRIVATE_KEY_METHOD* method = []() -> const SSL_PRIVATE_KEY_METHOD* {
+    SSL_PRIVATE_KEY_METHOD* method = new SSL_PRIVATE_KEY_METHOD();
+    method->type = keyType;
+    method->max_signature_len = maxSignatureLen;
+    method->sign = sign;
+    method->sign_complete = complete;
+    method->decrypt = decrypt;
+    method->decrypt_complete = complete;
+    return method;
+  }();
+  return *method;
+}
+
+int PrivateKeyOffload::sslCtxIndex() {
+  static const int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+  RELEASE_ASSERT(index >= 0);
+  return index;
+}
+
+int PrivateKeyOffload::sslIndex() {
+  static const int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+  RELEASE_ASSERT(index >= 0);
+  return index;
+}
+
+PrivateKeyOffload& PrivateKeyOffload::fromSsl(SSL* ssl) {
+  void* offload = SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), sslCtxIndex());
+  ASSERT(offload != nullptr);
+  return *static_cast<PrivateKeyOffload*>(offload);
+}
+
+PrivateKeyOperationCallbacks& PrivateKeyOffload::callbacksFromSsl(SSL* ssl) {
+  void* callbacks = SSL_get_ex_data(ssl, sslIndex());
+  ASSERT(callbacks != nullptr);
+  return *static_cast<PrivateKeyOperationCallbacks*>(callbacks);
+}
+
+int PrivateKeyOffload::keyType(SSL* ssl) {
+  EVP_PKEY* key = fromSsl(ssl).key_.get();
+  if (EVP_PKEY_id(key) == EVP_PKEY_RSA) {
+    return NID_rsaEncryption;
+  }
+
+  // ECDSA keys are identified by their curve.
+  return EC_GROUP_get_curve_name(EC_KEY_get0_group(EVP_PKEY_get0_EC_KEY(key)));
+}
+
+size_t PrivateKeyOffload::maxSignatureLen(SSL* ssl) {
+  return EVP_PKEY_size(fromSsl(ssl).key_.get());
+}
+
+enum ssl_private_key_result_t PrivateKeyOffload::sign(SSL* ssl, uint8_t*, size_t*, size_t,
+                                                      uint16_t signature_algorithm,
+                                                      const uint8_t* in, size_t in_len) {
+  PrivateKeyOffload& offload = fromSsl(ssl);
+  EVP_PKEY* key = offload.key_.get();
+  std::vector<uint8_t> input(in, in + in_len);
+  return offload.start(callbacksFromSsl(ssl),
+                       [key, signature_algorithm, input](std::vector<uint8_t>& output) -> bool {
+                         return signWithKey(key, signature_algorithm, input, output);
+                       });
+}
+
+enum ssl_private_key_result_t PrivateKeyOffload::decrypt(SSL* ssl, uint8_t*, size_t*, size_t,
+                                                         const uint8_t* in, size_t in_len) {
+  PrivateKeyOffload& offload = fromSsl(ssl);
+  EVP_PKEY* key = offload.key_.get();
+  std::vector<uint8_t> input(in, in + in_len);
+  return offload.start(callbacksFromSsl(ssl),
+                       [key, input](std::vector<uint8_t>& output) -> bool {
+                         return decryptWithKey(key, input, output);
+                       });
+}
+
+enum ssl_private_key_result_t PrivateKeyOffload::complete(SSL* ssl, uint8_t* out, size_t* out_len,
+                                                          size_t max_out) {
+  PrivateKeyOperationSharedPtr& operation = callbacksFromSsl(ssl).privateKeyOperation();
+  if (!operation) {
+    return ssl_private_key_failure;
+  }
+
+  // The handshake can be driven by socket events while the operation is still running.
+  if (!operation->done()) {
+    return ssl_private_key_retry;
+  }
+
+  enum ssl_private_key_result_t result = operation->result(out, out_len, max_out);
+  operation.reset();
+  return result;
+}
+
+enum ssl_private_key_result_t PrivateKeyOffload::start(PrivateKeyOperationCallbacks& callbacks,
+                                                       Operation operation) {
+  PrivateKeyOperationSharedPtr pending = std::make_shared<PrivateKeyOperation>(callbacks);
+  callbacks.privateKeyOperation() = pending;
+
+  {
+    std::unique_lock<std::mutex> lock(lock_);
+    queue_.emplace_back([pending, operation]() -> void {
+      std::vector<uint8_t> output;
+      bool success = operation(output);
+      pending->complete(success, std::move(output));
+    });
+  }
+  cv_.notify_one();
+
+  return ssl_private_key_retry;
+}
+
+void PrivateKeyOffload::threadRoutine() {
+  std::unique_lock<std::mutex> lock(lock_);
+  while (true) {
+    cv_.wait(lock, [this]() -> bool { return shutdown_ || !queue_.empty(); });
+    if (shutdown_) {
+      // Any queued operations belong to connections that are going away with their listener.
+      return;
+    }
+
+    std::function<void()> work = std::move(queue_.front());
+    queue_.pop_front();
+
+    lock.unlock();
+    work();
+    lock.lock();
+  }
+}
+
+} // Ssl
+} // Envoy
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "envoy/common/pure.h"
+#include "envoy/event/dispatcher.h"
+
+#include "common/common/non_copyable.h"
+#include "common/common/thread.h"
+
+#include "openssl/ssl.h"
+
+namespace Envoy {
+namespace Ssl {
+
+class PrivateKeyOperation;
+typedef std::shared_ptr<PrivateKeyOperation> PrivateKeyOperationSharedPtr;
+
+/**
+ * Implemented by connections whose handshakes use a PrivateKeyOffload.
+ */
+class PrivateKeyOperationCallbacks {
+public:
+  virtual ~PrivateKeyOperationCallbacks() {}
+
+  /**
+   * @return Event::Dispatcher& the dispatcher that the connection runs on.
+   */
+  virtual Event::Dispatcher& privateKeyOperationDispatcher() PURE;
+
+  /**
+   * @return PrivateKeyOperationSharedPtr& storage for the connection's pending operation.
+   */
+  virtual PrivateKeyOperationSharedPtr& privateKeyOperation() PURE;
+
+  /**
+   * Called on the connection's dispatcher once the pending operation has finished. The
+   * connection should continue its handshake.
+   */
+  virtual void onPrivateKeyOperationComplete() PURE;
+};
+
+/**
+ * A private key operation running on an offload thread. The result is handed back to the
+ * connection on its dispatcher.
+ */
+class PrivateKeyOperation : public std::enable_shared_from_this<PrivateKeyOperation> {
+public:
+  PrivateKeyOperation(PrivateKeyOperationCallbacks& callbacks)
+      : callbacks_(&callbacks), dispatcher_(callbacks.privateKeyOperationDispatcher()) {}
+
+  /**
+   * Stop the connection from being told about the result. This must be called on the
+   * connection's dispatcher before the connection goes away.
+   */
+  void cancel();
+
+  /**
+   * Record the result of the operation and wake up the connection. This is called on the offload
+   * thread.
+   */
+  void complete(bool success, std::vector<uint8_t>&& output);
+
+  /**
+   * @return true once the result has been handed back to the connection's dispatcher.
+   */
+  bool done() const { return done_; }
+
+  /**
+   * Copy out the result of a finished operation.
+   */
+  enum ssl_private_key_result_t result(uint8_t* out, size_t* out_len, size_t max_out) const;
+
+private:
+  std::mutex lock_;
+  PrivateKeyOperationCallbacks* callbacks_;
+  Event::Dispatcher& dispatcher_;
+  bool success_{};
+  std::vector<uint8_t> output_;
+  bool done_{};
+};
+
+/**
+ * Moves the private key operations of TLS handshakes off the worker threads. The SSL_CTX is given
+ * a private key method that hands each signature or decryption to a small pool of threads and
+ * returns ssl_private_key_retry. The handshake resumes on the connection's dispatcher once the
+ * operation has finished, so a burst of full handshakes no longer stalls every other connection
+ * on the worker.
+ */
+class PrivateKeyOffload : NonCopyable {
+public:
+  /**
+   * @param private_key_file supplies the PEM private key that matches the certificate chain.
+   * @param num_threads supplies the number of threads that run private key operations.
+   */
+  PrivateKeyOffload(const std::string& private_key_file, uint32_t num_threads);
+  ~PrivateKeyOffload();
+
+  /**
+   * Make handshakes on an SSL_CTX use the offload for private key operations.
+   */
+  void install(SSL_CTX* ctx);
+
+  /**
+   * Associate a connection with an SSL created from an SSL_CTX that the offload is installed on.
+   * This must be called before the handshake starts.
+   */
+  static void setCallbacks(SSL* ssl, PrivateKeyOperationCallbacks& callbacks);
+
+private:
+  typedef std::function<bool(std::vector<uint8_t>& output)> Operation;
+
+  static const SSL_PRIVATE_KEY_METHOD& method();
+  static int sslCtxIndex();
+  static int sslIndex();
+  static PrivateKeyOffload& fromSsl(SSL* ssl);
+  static PrivateKeyOperationCallbacks& callbacksFromSsl(SSL* ssl);
+
+  static int keyType(SSL* ssl);
+  static size_t maxSignatureLen(SSL* ssl);
+  static enum ssl_private_key_result_t sign(SSL* ssl, uint8_t* out, size_t* out_len,
+                                            size_t max_out, uint16_t signature_algorithm,
+                                            const uint8_t* in, size_t in_len);
+  static enum ssl_private_key_result_t decrypt(SSL* ssl, uint8_t* out, size_t* out_len,
+                                               size_t max_out, const uint8_t* in, size_t in_len);
+  static enum ssl_private_key_result_t complete(SSL* ssl, uint8_t* out, size_t* out_len,
+                                                size_t max_out);
+
+  enum ssl_private_key_result_t start(PrivateKeyOperationCallbacks& callbacks,
+                                      Operation operation);
+  void threadRoutine();
+
+  bssl::UniquePtr<EVP_PKEY> key_;
+  std::mutex lock_;
+  std::condition_variable cv_;
+  std::list<std::function<void()>> queue_;
+  bool shutdown_{};
+  std::vector<Thread::ThreadPtr> threads_;
+};
+
+typedef std::unique_ptr<PrivateKeyOffload> PrivateKeyOffloadPtr;
+
+} // Ssl
+} // Envoy
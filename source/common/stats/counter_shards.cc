@@ -0,0 +1,92 @@
+#include "common/stats/counter_shards.h"
+
+namespace Envoy {
+namespace Stats {
+
+const uint32_t CounterShards::NO_INDEX;
+const uint32_t CounterShards::SLOTS_PER_CHUNK;
+const uint32_t CounterShards::MAX_CHUNKS;
+
+thread_local CounterShards::ThreadShards* CounterShards::thread_shards_{};
+
+CounterShards::ThreadShards::~ThreadShards() {
+  for (std::atomic<Chunk*>& chunk : chunks_) {
+    delete chunk.load();
+  }
+}
+
+CounterShards& CounterShards::instance() {
+  static CounterShards* instance = new CounterShards();
+  return *instance;
+}
+
+uint32_t CounterShards::acquire(const void* key) {
+  std::unique_lock<std::mutex> lock(lock_);
+  auto it = keys_.find(key);
+  if (it != keys_.end()) {
+    it->second.ref_count_++;
+    return it->second.index_;
+  }
+
+  uint32_t index;
+  if (!free_indexes_.empty()) {
+    index = free_indexes_.back();
+    free_indexes_.pop_back();
+  } else if (folded_.size() < MAX_CHUNKS * SLOTS_PER_CHUNK) {
+    index = folded_.size();
+    folded_.push_back(0);
+  } else {
+    return NO_INDEX;
+  }
+
+  folded_[index] = sumLockHeld(index);
+  keys_.emplace(key, Key{index, 1});
+  return index;
+}
+
+void CounterShards::release(const void* key) {
+  std::unique_lock<std::mutex> lock(lock_);
+  auto it = keys_.find(key);
+  if (it == keys_.end()) {
+    // The key did not get an index.
+    return;
+  }
+
+  if (--it->second.ref_count_ == 0) {
+    free_indexes_.push_back(it->second.index_);
+    keys_.erase(it);
+  }
+}
+
+uint64_t CounterShards::fold(uint32_t index) {
+  if (index == NO_INDEX) {
+    return 0;
+  }
+
+  std::unique_lock<std::mutex> lock(lock_);
+  const uint64_t current = sumLockHeld(index);
+  const uint64_t delta = current - folded_[index];
+  folded_[index] = current;
+  return delta;
+}
+
+uint64_t CounterShards::sumLockHeld(uint32_t index) {
+  uint64_t sum = 0;
+  for (const std::unique_ptr<ThreadShards>& shards : threads_) {
+    const Chunk* chunk = shards->chunks_[index / SLOTS_PER_CHUNK].load(std::memory_order_acquire);
+    if (chunk) {
+      sum += (*chunk)[index % SLOTS_PER_CHUNK].load(std::memory_order_relaxed);
+    }
+  }
+  return sum;
+}
+
+CounterShards::ThreadShards* CounterShards::registerThread() {
+  std::unique_lock<std::mutex> lock(lock_);
+  threads_.emplace_back(new ThreadShards());
+  thread_shards_ = threads_.back().get();
+  return thread_shards_;
+}
+
+} // Stats
+} // Envoy
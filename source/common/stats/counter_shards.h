@@ -0,0 +1,123 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Envoy {
+namespace Stats {
+
+/**
+ * Per thread shards of counter values. Each counter is assigned an index, and every thread that
+ * increments counters owns a slot per index in memory that no other thread writes. Incrementing a
+ * counter is then a plain load and store to a thread private cache line, instead of an atomic
+ * read-modify-write on a cache line that all workers contend on. The value of a counter is the sum
+ * of its slots over all threads, which is only computed when the counter is read.
+ *
+ * Slots only ever grow, including the slots of threads that have exited, so the value is folded
+ * into the counter's backing store by adding the growth of the sum since the previous fold. An
+ * index that is released and reused may have non zero slots, so folding starts from the sum at the
+ * time the index is acquired.
+ *
+ * Indexes are acquired by key, so that counters that share a backing store, as with overlapping
+ * scopes, also share an index and see each other's increments when they fold.
+ */
+class CounterShards {
+public:
+  static const uint32_t NO_INDEX = UINT32_MAX;
+  static const uint32_t SLOTS_PER_CHUNK = 1024;
+  static const uint32_t MAX_CHUNKS = 1024;
+
+  /**
+   * @return the process wide shards. They are never destroyed, so that counters can be destroyed
+   *         at any time.
+   */
+  static CounterShards& instance();
+
+  /**
+   * Acquire the index of a key, allocating it if the key does not have one yet.
+   * @param key supplies the key, usually the address of the counter's backing store.
+   * @return the index, or NO_INDEX if all MAX_CHUNKS * SLOTS_PER_CHUNK indexes are in use.
+   */
+  uint32_t acquire(const void* key);
+
+  /**
+   * Release the index of a key. The index is freed once every acquire has been released.
+   * @param key supplies the key.
+   */
+  void release(const void* key);
+
+  /**
+   * Add to the calling thread's slot of an index.
+   * @param index supplies the index, which must have been allocated.
+   * @param amount supplies the amount to add.
+   */
+  void add(uint32_t index, uint64_t amount) {
+    ThreadShards* shards = thread_shards_;
+    if (!shards) {
+      shards = registerThread();
+    }
+
+    // Only the owning thread writes the slot, so a relaxed load and store is enough. Readers see
+    // either the old or the new value.
+    std::atomic<uint64_t>& slot = shards->slot(index);
+    slot.store(slot.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+  }
+
+  /**
+   * Compute how much the sum of the slots of an index over all threads grew since the index was
+   * last folded or acquired.
+   * @param index supplies the index, which may be NO_INDEX.
+   * @return the growth of the sum.
+   */
+  uint64_t fold(uint32_t index);
+
+private:
+  typedef std::array<std::atomic<uint64_t>, SLOTS_PER_CHUNK> Chunk;
+
+  /**
+   * The slots of one thread. Chunks are allocated by the owning thread the first time it touches
+   * an index in them.
+   */
+  struct ThreadShards {
+    ~ThreadShards();
+
+    std::atomic<uint64_t>& slot(uint32_t index) {
+      std::atomic<Chunk*>& chunk = chunks_[index / SLOTS_PER_CHUNK];
+      Chunk* current = chunk.load(std::memory_order_relaxed);
+      if (!current) {
+        current = new Chunk();
+        chunk.store(current, std::memory_order_release);
+      }
+      return (*current)[index % SLOTS_PER_CHUNK];
+    }
+
+    std::array<std::atomic<Chunk*>, MAX_CHUNKS> chunks_{};
+  };
+
+  struct Key {
+    uint32_t index_;
+    uint32_t ref_count_;
+  };
+
+  uint64_t sumLockHeld(uint32_t index);
+  ThreadShards* registerThread();
+
+  static thread_local ThreadShards* thread_shards_;
+
+  std::mutex lock_;
+  // The shards of every thread that ever added to a counter. They are kept after a thread exits,
+  // since their slots still count towards the sums.
+  std::vector<std::unique_ptr<ThreadShards>> threads_;
+  std::unordered_map<const void*, Key> keys_;
+  // The sum of each index at its last fold.
+  std::vector<uint64_t> folded_;
+  std::vector<uint32_t> free_indexes_;
+};
+
+} // Stats
+} // Envoy
@@ -0,0 +1,150 @@
+#include "common/stats/histogram_impl.h"
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "common/common/assert.h"
+
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+namespace Stats {
+
+const uint32_t HistogramBuckets::SubBucketBits;
+const uint32_t HistogramBuckets::SubBucketCount;
+const uint32_t HistogramBuckets::MaxValueBits;
+const uint64_t HistogramBuckets::MaxValue;
+const uint32_t HistogramBuckets::BucketCount;
+
+uint64_t HistogramBuckets::lowerBound(uint32_t index) {
+  ASSERT(index < BucketCount);
+  if (index < SubBucketCount) {
+    return index;
+  }
+
+  const uint32_t shift = index / SubBucketCount - 1;
+  return static_cast<uint64_t>(index % SubBucketCount + SubBucketCount) << shift;
+}
+
+uint64_t HistogramBuckets::upperBound(uint32_t index) {
+  if (index < SubBucketCount) {
+    return index;
+  }
+
+  const uint32_t shift = index / SubBucketCount - 1;
+  return lowerBound(index) + (1ULL << shift) - 1;
+}
+
+const std::vector<HistogramStatisticsImpl::ExportedQuantile>&
+HistogramStatisticsImpl::exportedQuantiles() {
+  static const std::vector<ExportedQuantile> quantiles{
+      {0.5, "p50"}, {0.9, "p90"}, {0.95, "p95"}, {0.99, "p99"}, {0.999, "p999"}, {1.0, "max"}};
+  return quantiles;
+}
+
+void HistogramStatisticsImpl::add(const HistogramStatisticsImpl& other) {
+  for (uint32_t i = 0; i < HistogramBuckets::BucketCount; i++) {
+    counts_[i] += other.counts_[i];
+  }
+  sample_count_ += other.sample_count_;
+  sample_sum_ += other.sample_sum_;
+}
+
+void HistogramStatisticsImpl::clear() {
+  counts_.fill(0);
+  sample_count_ = 0;
+  sample_sum_ = 0;
+}
+
+uint64_t HistogramStatisticsImpl::quantile(double quantile) const {
+  ASSERT(quantile >= 0 && quantile <= 1);
+  if (sample_count_ == 0) {
+    return 0;
+  }
+
+  uint64_t rank = static_cast<uint64_t>(std::ceil(quantile * sample_count_));
+  if (rank == 0) {
+    rank = 1;
+  } else if (rank > sample_count_) {
+    rank = sample_count_;
+  }
+
+  uint64_t seen = 0;
+  for (uint32_t i = 0; i < HistogramBuckets::BucketCount; i++) {
+    seen += counts_[i];
+    if (seen >= rank) {
+      return HistogramBuckets::upperBound(i);
+    }
+  }
+
+  NOT_REACHED;
+}
+
+void HistogramStatisticsImpl::iterateBuckets(const BucketCb& cb) const {
+  for (uint32_t i = 0; i < HistogramBuckets::BucketCount; i++) {
+    if (counts_[i] > 0) {
+      cb(HistogramBuckets::upperBound(i), counts_[i]);
+    }
+  }
+}
+
+std::string HistogramStatisticsImpl::summary() const {
+  std::string summary = fmt::format("count={}", sample_count_);
+  for (const ExportedQuantile& exported : exportedQuantiles()) {
+    summary += fmt::format(" {}={}", exported.name_, quantile(exported.quantile_));
+  }
+
+  return summary;
+}
+
+ThreadLocalHistogramImpl::ThreadLocalHistogramImpl() {
+  for (std::atomic<uint32_t>& count : counts_) {
+    count.store(0, std::memory_order_relaxed);
+  }
+  sum_.store(0, std::memory_order_relaxed);
+  merged_counts_.fill(0);
+}
+
+void ThreadLocalHistogramImpl::mergeInto(HistogramStatisticsImpl& interval) {
+  for (uint32_t i = 0; i < HistogramBuckets::BucketCount; i++) {
+    const uint32_t count = counts_[i].load(std::memory_order_relaxed);
+    if (count != merged_counts_[i]) {
+      // Unsigned subtraction handles a count that wrapped since the previous merge.
+      interval.addCount(i, static_cast<uint32_t>(count - merged_counts_[i]));
+      merged_counts_[i] = count;
+    }
+  }
+
+  const uint64_t sum = sum_.load(std::memory_order_relaxed);
+  interval.addSum(sum - merged_sum_);
+  merged_sum_ = sum;
+}
+
+void ParentHistogramImpl::addTlsHistogram(ThreadLocalHistogramSharedPtr histogram) {
+  std::unique_lock<std::mutex> lock(lock_);
+  tls_histograms_.emplace_back(std::move(histogram));
+}
+
+void ParentHistogramImpl::merge() {
+  interval_statistics_.clear();
+
+  std::unique_lock<std::mutex> lock(lock_);
+  for (auto it = tls_histograms_.begin(); it != tls_histograms_.end();) {
+    // Check whether the owning thread has released the histogram before merging, so that any
+    // samples recorded before the release are not lost.
+    const bool released = it->use_count() == 1;
+    (*it)->mergeInto(interval_statistics_);
+    if (released) {
+      it = tls_histograms_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  cumulative_statistics_.add(interval_statistics_);
+}
+
+} // Stats
+} // Envoy
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "envoy/stats/stats.h"
+
+#include "common/stats/stats_impl.h"
+
+namespace Envoy {
+namespace Stats {
+
+/**
+ * Log-linear bucketing in the style of HdrHistogram. Values below SubBucketCount each get their own
+ * bucket. Above that, every power of two range is split into SubBucketCount equal width buckets,
+ * which bounds the relative error of any reported value to 1 / SubBucketCount. Values above
+ * MaxValue are counted in the last bucket.
+ */
+class HistogramBuckets {
+public:
+  static const uint32_t SubBucketBits = 4;
+  static const uint32_t SubBucketCount = 1 << SubBucketBits;
+  static const uint32_t MaxValueBits = 36;
+  static const uint64_t MaxValue = (1ULL << MaxValueBits) - 1;
+  static const uint32_t BucketCount = (MaxValueBits - SubBucketBits + 1) * SubBucketCount;
+
+  /**
+   * @return the index of the bucket that counts the supplied value.
+   */
+  static uint32_t index(uint64_t value) {
+    if (value < SubBucketCount) {
+      return value;
+    }
+
+    if (value > MaxValue) {
+      value = MaxValue;
+    }
+
+    const uint32_t shift = 63 - __builtin_clzll(value) - SubBucketBits;
+    return (shift + 1) * SubBucketCount + (value >> shift) - SubBucketCount;
+  }
+
+  /**
+   * @return the smallest value counted by a bucket.
+   */
+  static uint64_t lowerBound(uint32_t index);
+
+  /**
+   * @return the largest value counted by a bucket.
+   */
+  static uint64_t upperBound(uint32_t index);
+};
+
+/**
+ * Bucketed statistics for a set of samples. Quantiles report the largest value counted by the
+ * bucket containing the requested rank.
+ */
+class HistogramStatisticsImpl : public HistogramStatistics {
+public:
+  struct ExportedQuantile {
+    double quantile_;
+    std::string name_;
+  };
+
+  HistogramStatisticsImpl() { clear(); }
+
+  /**
+   * @return the quantiles reported by summary() and exported to sinks, along with their names.
+   */
+  static const std::vector<ExportedQuantile>& exportedQuantiles();
+
+  void addCount(uint32_t index, uint64_t count) {
+    counts_[index] += count;
+    sample_count_ += count;
+  }
+  void addSum(uint64_t sum) { sample_sum_ += sum; }
+  void add(const HistogramStatisticsImpl& other);
+  void clear();
+
+  // Stats::HistogramStatistics
+  uint64_t sampleCount() const override { return sample_count_; }
+  uint64_t sampleSum() const override { return sample_sum_; }
+  uint64_t quantile(double quantile) const override;
+  void iterateBuckets(const BucketCb& cb) const override;
+  std::string summary() const override;
+
+private:
+  std::array<uint64_t, HistogramBuckets::BucketCount> counts_;
+  uint64_t sample_count_;
+  uint64_t sample_sum_;
+};
+
+/**
+ * The per thread half of a histogram. Samples are only ever recorded by a single thread, so
+ * recording is a relaxed load and store of the bucket count with no read-modify-write. The main
+ * thread reads the counts concurrently during merge and computes interval deltas against the
+ * counts it saw during the previous merge. Bucket counts are allowed to wrap between merges.
+ */
+class ThreadLocalHistogramImpl {
+public:
+  ThreadLocalHistogramImpl();
+
+  /**
+   * Record a sample. This must only be called on the owning thread.
+   */
+  void recordValue(uint64_t value) {
+    std::atomic<uint32_t>& count = counts_[HistogramBuckets::index(value)];
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    sum_.store(sum_.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+  }
+
+  /**
+   * Add the samples recorded since the previous call to the supplied statistics. This must only be
+   * called on the main thread.
+   */
+  void mergeInto(HistogramStatisticsImpl& interval);
+
+private:
+  std::array<std::atomic<uint32_t>, HistogramBuckets::BucketCount> counts_;
+  std::atomic<uint64_t> sum_;
+
+  // Only accessed on the main thread during merge.
+  std::array<uint32_t, HistogramBuckets::BucketCount> merged_counts_;
+  uint64_t merged_sum_{};
+};
+
+typedef std::shared_ptr<ThreadLocalHistogramImpl> ThreadLocalHistogramSharedPtr;
+
+/**
+ * A histogram that owns the per thread histograms that feed it. Per thread histograms that are no
+ * longer referenced by any thread are dropped after their final samples have been merged.
+ */
+class ParentHistogramImpl : public MetricImpl<Histogram> {
+public:
+  ParentHistogramImpl(const std::string& name, std::string&& tag_extracted_name,
+                      std::vector<Tag>&& tags)
+      : MetricImpl(std::move(tag_extracted_name), std::move(tags)), name_(name) {}
+
+  /**
+   * Register a per thread histogram. This can be called from any thread.
+   */
+  void addTlsHistogram(ThreadLocalHistogramSharedPtr histogram);
+
+  /**
+   * Add samples that were not recorded by this process, e.g. by a parent process before a hot
+   * restart, to the cumulative statistics. This must only be called on the main thread.
+   */
+  void addCumulative(const HistogramStatisticsImpl& statistics) {
+    cumulative_statistics_.add(statistics);
+  }
+
+  // Stats::Histogram
+  void merge() override;
+  const HistogramStatistics& intervalStatistics() const override { return interval_statistics_; }
+  const HistogramStatistics& cumulativeStatistics() const override {
+    return cumulative_statistics_;
+  }
+  std::string name() const override { return name_; }
+
+private:
+  const std::string name_;
+  std::mutex lock_;
+  std::list<ThreadLocalHistogramSharedPtr> tls_histograms_;
+  HistogramStatisticsImpl interval_statistics_;
+  HistogramStatisticsImpl cumulative_statistics_;
+};
+
+typedef std::shared_ptr<ParentHistogramImpl> ParentHistogramImplSharedPtr;
+
+} // Stats
+} // Envoy
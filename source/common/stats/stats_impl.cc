@@ -10,9 +10,81 @@
 namespace Envoy {
 namespace Stats {
 
+namespace {
+
+const std::vector<Tag>& noTags() {
+  static const std::vector<Tag> tags;
+  return tags;
+}
+
+} // namespace
+
+const std::vector<Tag>& PrimitiveCounter::tags() const { return noTags(); }
+
+const std::vector<Tag>& PrimitiveGauge::tags() const { return noTags(); }
+
+void CounterImpl::markChanged() {
+  if (!changed_.exchange(true)) {
+    changed_stats_->addCounter(shared_from_this());
+  }
+}
+
+void GaugeImpl::markChanged() {
+  if (!changed_.exchange(true)) {
+    changed_stats_->addGauge(shared_from_this());
+  }
+}
+
+void ChangedStats::addCounter(std::weak_ptr<CounterImpl>&& counter) {
+  std::unique_lock<std::mutex> lock(lock_);
+  counters_.emplace_back(std::move(counter));
+}
+
+void ChangedStats::addGauge(std::weak_ptr<GaugeImpl>&& gauge) {
+  std::unique_lock<std::mutex> lock(lock_);
+  gauges_.emplace_back(std::move(gauge));
+}
+
+void ChangedStats::flush(const StoreRoot::ChangedCounterCb& counter_cb,
+                         const StoreRoot::ChangedGaugeCb& gauge_cb) {
+  {
+    std::unique_lock<std::mutex> lock(lock_);
+    flushing_counters_.swap(counters_);
+    flushing_gauges_.swap(gauges_);
+  }
+
+  // The flag is cleared before the stat is read, so a change racing with the flush is either
+  // included now or adds the stat again for the next flush.
+  for (const std::weak_ptr<CounterImpl>& weak_counter : flushing_counters_) {
+    std::shared_ptr<CounterImpl> counter = weak_counter.lock();
+    if (counter) {
+      counter->clearChanged();
+      const uint64_t delta = counter->latch();
+      if (delta > 0) {
+        counter_cb(*counter, delta);
+      }
+    }
+  }
+
+  for (const std::weak_ptr<GaugeImpl>& weak_gauge : flushing_gauges_) {
+    std::shared_ptr<GaugeImpl> gauge = weak_gauge.lock();
+    if (gauge) {
+      gauge->clearChanged();
+      gauge_cb(*gauge);
+    }
+  }
+
+  flushing_counters_.clear();
+  flushing_gauges_.clear();
+}
+
+TimespanPtr TimerImpl::allocateSpan() {
+  return TimespanPtr{new TimespanImpl(*this, ProdMonotonicTimeSource::instance_)};
+}
+
 void TimerImpl::TimespanImpl::complete(const std::string& dynamic_name) {
   std::chrono::milliseconds ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-      std::chrono::steady_clock::now() - start_);
+      time_source_.currentTime() - start_);
   parent_.parent_.deliverTimingToSinks(dynamic_name, ms);
 }
 
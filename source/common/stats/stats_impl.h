@@ -6,13 +6,16 @@
 #include <functional>
 #include <list>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "envoy/common/time.h"
 #include "envoy/stats/stats.h"
 
 #include "common/common/assert.h"
+#include "common/stats/counter_shards.h"
 
 namespace Envoy {
 namespace Stats {
@@ -64,63 +67,284 @@ public:
 };
 
 /**
- * Counter implementation that wraps a RawStatData.
+ * Holds the tag extracted name and tags of a stat, which are computed once when the stat is
+ * created.
  */
-class CounterImpl : public Counter {
+template <class Base> class MetricImpl : public Base {
 public:
-  CounterImpl(RawStatData& data, RawStatDataAllocator& alloc) : data_(data), alloc_(alloc) {}
-  ~CounterImpl() { alloc_.free(data_); }
+  MetricImpl(std::string&& tag_extracted_name, std::vector<Tag>&& tags)
+      : tag_extracted_name_(std::move(tag_extracted_name)), tags_(std::move(tags)) {}
+
+  // Stats::Metric
+  const std::string& tagExtractedName() const override { return tag_extracted_name_; }
+  const std::vector<Tag>& tags() const override { return tags_; }
+
+private:
+  const std::string tag_extracted_name_;
+  const std::vector<Tag> tags_;
+};
+
+class ChangedStats;
+
+/**
+ * Counter implementation that wraps a RawStatData. Increments go to the calling thread's shard of
+ * the counter, see CounterShards, and are folded into the RawStatData when the counter is read,
+ * latched or destroyed. Since stats are latched every flush interval, the RawStatData in shared
+ * memory, which a hot restarted process takes over, lags by at most one flush interval. If no
+ * shard index is left the counter updates the RawStatData directly.
+ */
+class CounterImpl : public MetricImpl<Counter>, public std::enable_shared_from_this<CounterImpl> {
+public:
+  /**
+   * @param changed_stats supplies the list to add the counter to when it changes, or nullptr if
+   *        changes are not tracked. If supplied, the counter must be owned by a shared_ptr.
+   */
+  CounterImpl(RawStatData& data, RawStatDataAllocator& alloc, std::string&& tag_extracted_name,
+              std::vector<Tag>&& tags, ChangedStats* changed_stats = nullptr)
+      : MetricImpl(std::move(tag_extracted_name), std::move(tags)), data_(data), alloc_(alloc),
+        changed_stats_(changed_stats), shard_index_(CounterShards::instance().acquire(&data)) {}
+  ~CounterImpl() {
+    fold();
+    CounterShards::instance().release(&data_);
+    alloc_.free(data_);
+  }
+
+  /**
+   * Mark the counter as unchanged, so that its next change adds it to the changed stats again.
+   */
+  void clearChanged() { changed_ = false; }
 
   // Stats::Counter
   void add(uint64_t amount) override {
-    data_.value_ += amount;
-    data_.pending_increment_ += amount;
-    data_.flags_ |= RawStatData::Flags::Used;
+    if (shard_index_ != CounterShards::NO_INDEX) {
+      CounterShards::instance().add(shard_index_, amount);
+    } else {
+      data_.value_ += amount;
+      data_.pending_increment_ += amount;
+    }
+    // Only the first change writes the shared flags.
+    if (!(data_.flags_.load(std::memory_order_relaxed) & RawStatData::Flags::Used)) {
+      data_.flags_ |= RawStatData::Flags::Used;
+    }
+    changed();
   }
 
   void inc() override { add(1); }
-  uint64_t latch() override { return data_.pending_increment_.exchange(0); }
-  std::string name() override { return data_.name_; }
-  void reset() override { data_.value_ = 0; }
+  uint64_t latch() override {
+    fold();
+    return data_.pending_increment_.exchange(0);
+  }
+  std::string name() const override { return data_.name_; }
+  void reset() override {
+    fold();
+    data_.value_ = 0;
+  }
   bool used() override { return data_.flags_ & RawStatData::Flags::Used; }
-  uint64_t value() override { return data_.value_; }
+  uint64_t value() override {
+    fold();
+    return data_.value_;
+  }
 
 private:
+  void fold() {
+    const uint64_t delta = CounterShards::instance().fold(shard_index_);
+    if (delta > 0) {
+      data_.value_ += delta;
+      data_.pending_increment_ += delta;
+    }
+  }
+
+  void changed() {
+    // The relaxed load keeps the common case, a counter that already changed during this flush
+    // interval, free of any further atomic read-modify-write.
+    if (changed_stats_ && !changed_.load(std::memory_order_relaxed)) {
+      markChanged();
+    }
+  }
+  void markChanged();
+
   RawStatData& data_;
   RawStatDataAllocator& alloc_;
+  ChangedStats* const changed_stats_;
+  std::atomic<bool> changed_{};
+  // Shared with the other counters of the same RawStatData.
+  const uint32_t shard_index_;
 };
 
 /**
  * Gauge implementation that wraps a RawStatData.
  */
-class GaugeImpl : public Gauge {
+class GaugeImpl : public MetricImpl<Gauge>, public std::enable_shared_from_this<GaugeImpl> {
 public:
-  GaugeImpl(RawStatData& data, RawStatDataAllocator& alloc) : data_(data), alloc_(alloc) {}
+  /**
+   * @param changed_stats supplies the list to add the gauge to when it changes, or nullptr if
+   *        changes are not tracked. If supplied, the gauge must be owned by a shared_ptr.
+   */
+  GaugeImpl(RawStatData& data, RawStatDataAllocator& alloc, std::string&& tag_extracted_name,
+            std::vector<Tag>&& tags, ChangedStats* changed_stats = nullptr)
+      : MetricImpl(std::move(tag_extracted_name), std::move(tags)), data_(data), alloc_(alloc),
+        changed_stats_(changed_stats) {}
   ~GaugeImpl() { alloc_.free(data_); }
 
+  /**
+   * Mark the gauge as unchanged, so that its next change adds it to the changed stats again.
+   */
+  void clearChanged() { changed_ = false; }
+
   // Stats::Gauge
   virtual void add(uint64_t amount) override {
     data_.value_ += amount;
     data_.flags_ |= RawStatData::Flags::Used;
+    changed();
   }
   virtual void dec() override { sub(1); }
   virtual void inc() override { add(1); }
-  virtual std::string name() override { return data_.name_; }
+  virtual std::string name() const override { return data_.name_; }
   virtual void set(uint64_t value) override {
     data_.value_ = value;
     data_.flags_ |= RawStatData::Flags::Used;
+    changed();
   }
   virtual void sub(uint64_t amount) override {
     ASSERT(data_.value_ >= amount);
     ASSERT(used());
     data_.value_ -= amount;
+    changed();
   }
   bool used() override { return data_.flags_ & RawStatData::Flags::Used; }
   virtual uint64_t value() override { return data_.value_; }
 
 private:
+  void changed() {
+    if (changed_stats_ && !changed_.load(std::memory_order_relaxed)) {
+      markChanged();
+    }
+  }
+  void markChanged();
+
   RawStatData& data_;
   RawStatDataAllocator& alloc_;
+  ChangedStats* const changed_stats_;
+  std::atomic<bool> changed_{};
+};
+
+/**
+ * Counter that is a plain atomic value, not backed by a RawStatData and not known to any store.
+ * It is meant for stats that many objects keep under the same names, such as the per host stats,
+ * where a store per object costs far more than the values themselves. The name is shared with the
+ * other objects and the counter has no tags.
+ */
+class PrimitiveCounter : public Counter {
+public:
+  /**
+   * @param name supplies the name, which must outlive the counter.
+   */
+  PrimitiveCounter(const std::string& name) : name_(name) {}
+
+  // Stats::Metric
+  std::string name() const override { return name_; }
+  const std::string& tagExtractedName() const override { return name_; }
+  const std::vector<Tag>& tags() const override;
+
+  // Stats::Counter
+  void add(uint64_t amount) override {
+    value_ += amount;
+    if (!used_.load(std::memory_order_relaxed)) {
+      used_ = true;
+    }
+  }
+  void inc() override { add(1); }
+  uint64_t latch() override {
+    const uint64_t value = value_;
+    return value - latched_.exchange(value);
+  }
+  void reset() override {
+    value_ = 0;
+    latched_ = 0;
+  }
+  bool used() override { return used_; }
+  uint64_t value() override { return value_; }
+
+private:
+  const std::string& name_;
+  std::atomic<uint64_t> value_{};
+  // The value at the last latch.
+  std::atomic<uint64_t> latched_{};
+  std::atomic<bool> used_{};
+};
+
+/**
+ * Gauge counterpart of PrimitiveCounter.
+ */
+class PrimitiveGauge : public Gauge {
+public:
+  /**
+   * @param name supplies the name, which must outlive the gauge.
+   */
+  PrimitiveGauge(const std::string& name) : name_(name) {}
+
+  // Stats::Metric
+  std::string name() const override { return name_; }
+  const std::string& tagExtractedName() const override { return name_; }
+  const std::vector<Tag>& tags() const override;
+
+  // Stats::Gauge
+  void add(uint64_t amount) override {
+    value_ += amount;
+    markUsed();
+  }
+  void dec() override { sub(1); }
+  void inc() override { add(1); }
+  void set(uint64_t value) override {
+    value_ = value;
+    markUsed();
+  }
+  void sub(uint64_t amount) override {
+    ASSERT(value_ >= amount);
+    ASSERT(used());
+    value_ -= amount;
+  }
+  bool used() override { return used_; }
+  uint64_t value() override { return value_; }
+
+private:
+  void markUsed() {
+    if (!used_.load(std::memory_order_relaxed)) {
+      used_ = true;
+    }
+  }
+
+  const std::string& name_;
+  std::atomic<uint64_t> value_{};
+  std::atomic<bool> used_{};
+};
+
+/**
+ * The counters and gauges of a store that changed since they were last flushed. A stat is added
+ * when it goes from unchanged to changed, so writers take the lock at most once per stat and flush
+ * interval, and a flush only visits the stats that changed. Only weak references are kept so that
+ * the stats of deleted scopes are not kept alive.
+ */
+class ChangedStats {
+public:
+  void addCounter(std::weak_ptr<CounterImpl>&& counter);
+  void addGauge(std::weak_ptr<GaugeImpl>&& gauge);
+
+  /**
+   * Visit the stats that changed since the previous call and mark them as unchanged. Counters are
+   * latched, and skipped if the latched increment is zero. This must only be called from one
+   * thread at a time.
+   */
+  void flush(const StoreRoot::ChangedCounterCb& counter_cb,
+             const StoreRoot::ChangedGaugeCb& gauge_cb);
+
+private:
+  std::mutex lock_;
+  std::vector<std::weak_ptr<CounterImpl>> counters_;
+  std::vector<std::weak_ptr<GaugeImpl>> gauges_;
+  // Swapped with the lists above by flush(), and kept to reuse their capacity.
+  std::vector<std::weak_ptr<CounterImpl>> flushing_counters_;
+  std::vector<std::weak_ptr<GaugeImpl>> flushing_gauges_;
 };
 
 /**
@@ -131,7 +355,10 @@ public:
   TimerImpl(const std::string& name, Store& parent) : name_(name), parent_(parent) {}
 
   // Stats::Timer
-  TimespanPtr allocateSpan() override { return TimespanPtr{new TimespanImpl(*this)}; }
+  TimespanPtr allocateSpan() override;
+  TimespanPtr allocateSpan(MonotonicTimeSource& time_source) override {
+    return TimespanPtr{new TimespanImpl(*this, time_source)};
+  }
   std::string name() override { return name_; }
 
 private:
@@ -140,7 +367,8 @@ private:
    */
   class TimespanImpl : public Timespan {
   public:
-    TimespanImpl(TimerImpl& parent) : parent_(parent), start_(std::chrono::steady_clock::now()) {}
+    TimespanImpl(TimerImpl& parent, MonotonicTimeSource& time_source)
+        : parent_(parent), time_source_(time_source), start_(time_source.currentTime()) {}
 
     // Stats::Timespan
     void complete() override { complete(parent_.name_); }
@@ -148,6 +376,7 @@ private:
 
   private:
     TimerImpl& parent_;
+    MonotonicTimeSource& time_source_;
     MonotonicTime start_;
   };
 
@@ -201,15 +430,18 @@ private:
 };
 
 /**
- * Store implementation that is isolated from other stores.
+ * Store implementation that is isolated from other stores. Tags are not extracted from the names of
+ * its stats.
  */
 class IsolatedStoreImpl : public Store {
 public:
   IsolatedStoreImpl()
-      : counters_([this](const std::string& name)
-                      -> CounterImpl* { return new CounterImpl(*alloc_.alloc(name), alloc_); }),
-        gauges_([this](const std::string& name)
-                    -> GaugeImpl* { return new GaugeImpl(*alloc_.alloc(name), alloc_); }),
+      : counters_([this](const std::string& name) -> CounterImpl* {
+          return new CounterImpl(*alloc_.alloc(name), alloc_, std::string(name), {});
+        }),
+        gauges_([this](const std::string& name) -> GaugeImpl* {
+          return new GaugeImpl(*alloc_.alloc(name), alloc_, std::string(name), {});
+        }),
         timers_([this](const std::string& name)
                     -> TimerImpl* { return new TimerImpl(name, *this); }) {}
 
@@ -223,6 +455,8 @@ public:
   // Stats::Store
   std::list<CounterSharedPtr> counters() const override { return counters_.toList(); }
   std::list<GaugeSharedPtr> gauges() const override { return gauges_.toList(); }
+  // The isolated store does not record histogram samples.
+  std::list<HistogramSharedPtr> histograms() const override { return {}; }
   ScopePtr createScope(const std::string& name) override {
     return ScopePtr{new ScopeImpl(*this, name)};
   }
@@ -1,7 +1,11 @@
 #include "common/stats/statsd.h"
 
+#include <sys/socket.h>
+
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
+#include <cstring>
 #include <string>
 
 #include "envoy/common/exception.h"
@@ -12,6 +16,7 @@
 #include "common/common/assert.h"
 #include "common/network/address_impl.h"
 #include "common/network/utility.h"
+#include "common/stats/histogram_impl.h"
 
 #include "spdlog/spdlog.h"
 
@@ -19,7 +24,10 @@ namespace Envoy {
 namespace Stats {
 namespace Statsd {
 
-Writer::Writer(Network::Address::InstanceConstSharedPtr address) {
+const uint32_t Writer::MaxDatagramsPerSend;
+
+Writer::Writer(Network::Address::InstanceConstSharedPtr address, uint32_t max_datagram_size)
+    : max_datagram_size_(max_datagram_size) {
   fd_ = address->socket(Network::Address::SocketType::Datagram);
   ASSERT(fd_ != -1);
 
@@ -47,36 +55,99 @@ void Writer::writeGauge(const std::string& name, uint64_t value) {
   send(message);
 }
 
-void Writer::writeTimer(const std::string& name, const std::chrono::milliseconds& ms) {
-  std::string message(fmt::format("envoy.{}:{}|ms", name, ms.count()));
-  send(message);
+void Writer::flush() {
+  if (buffer_.size() > datagram_start_) {
+    endDatagram();
+  }
+
+  if (!shutdown_) {
+    iovec iovecs[MaxDatagramsPerSend];
+    mmsghdr messages[MaxDatagramsPerSend];
+    memset(messages, 0, sizeof(messages));
+    size_t start = 0;
+    size_t sent = 0;
+    while (sent < datagram_ends_.size()) {
+      const size_t count = std::min<size_t>(MaxDatagramsPerSend, datagram_ends_.size() - sent);
+      for (size_t i = 0; i < count; i++) {
+        const size_t end = datagram_ends_[sent + i];
+        iovecs[i].iov_base = &buffer_[start];
+        iovecs[i].iov_len = end - start;
+        messages[i].msg_hdr.msg_iov = &iovecs[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+        start = end;
+      }
+
+      // As with unbatched sends, stats are dropped if the socket would block.
+      int rc = sendmmsg(fd_, messages, count, MSG_DONTWAIT);
+      if (rc <= 0) {
+        break;
+      }
+
+      sent += rc;
+      start = datagram_ends_[sent - 1];
+    }
+  }
+
+  buffer_.clear();
+  datagram_ends_.clear();
+  datagram_start_ = 0;
+}
+
+void Writer::endDatagram() {
+  datagram_ends_.push_back(buffer_.size());
+  datagram_start_ = buffer_.size();
 }
 
 void Writer::send(const std::string& message) {
   if (shutdown_) {
     return;
   }
-  ::send(fd_, message.c_str(), message.size(), MSG_DONTWAIT);
+
+  if (max_datagram_size_ == 0) {
+    ::send(fd_, message.c_str(), message.size(), MSG_DONTWAIT);
+    return;
+  }
+
+  // Start a new datagram if the message does not fit in the current one. A message that is larger
+  // than the maximum datagram size is sent in a datagram of its own.
+  const size_t datagram_size = buffer_.size() - datagram_start_;
+  if (datagram_size > 0 && datagram_size + 1 + message.size() > max_datagram_size_) {
+    endDatagram();
+  }
+
+  if (buffer_.size() > datagram_start_) {
+    buffer_.push_back('\n');
+  }
+  buffer_.append(message);
 }
 
 UdpStatsdSink::UdpStatsdSink(ThreadLocal::Instance& tls,
-                             Network::Address::InstanceConstSharedPtr address)
-    : tls_(tls), tls_slot_(tls.allocateSlot()), server_address_(address) {
+                             Network::Address::InstanceConstSharedPtr address,
+                             uint32_t max_datagram_size)
+    : tls_(tls), tls_slot_(tls.allocateSlot()), server_address_(address),
+      max_datagram_size_(max_datagram_size) {
   tls.set(tls_slot_, [this](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
-    return std::make_shared<Writer>(this->server_address_);
+    return std::make_shared<Writer>(this->server_address_, this->max_datagram_size_);
   });
 }
 
-void UdpStatsdSink::flushCounter(const std::string& name, uint64_t delta) {
-  tls_.getTyped<Writer>(tls_slot_).writeCounter(name, delta);
+void UdpStatsdSink::flushCounter(const Counter& counter, uint64_t delta) {
+  tls_.getTyped<Writer>(tls_slot_).writeCounter(counter.name(), delta);
 }
 
-void UdpStatsdSink::flushGauge(const std::string& name, uint64_t value) {
-  tls_.getTyped<Writer>(tls_slot_).writeGauge(name, value);
+void UdpStatsdSink::flushGauge(const Gauge& gauge, uint64_t value) {
+  tls_.getTyped<Writer>(tls_slot_).writeGauge(gauge.name(), value);
 }
 
-void UdpStatsdSink::onTimespanComplete(const std::string& name, std::chrono::milliseconds ms) {
-  tls_.getTyped<Writer>(tls_slot_).writeTimer(name, ms);
+void UdpStatsdSink::flushHistogram(const Histogram& histogram,
+                                   const HistogramStatistics& statistics) {
+  Writer& writer = tls_.getTyped<Writer>(tls_slot_);
+  const std::string name = histogram.name();
+  writer.writeCounter(name + ".count", statistics.sampleCount());
+  for (const HistogramStatisticsImpl::ExportedQuantile& exported :
+       HistogramStatisticsImpl::exportedQuantiles()) {
+    writer.writeGauge(name + "." + exported.name_, statistics.quantile(exported.quantile_));
+  }
 }
 
 TcpStatsdSink::TcpStatsdSink(const LocalInfo::LocalInfo& local_info,
@@ -122,9 +193,16 @@ void TcpStatsdSink::TlsSink::onEvent(uint32_t events) {
   }
 }
 
-void TcpStatsdSink::TlsSink::onTimespanComplete(const std::string& name,
-                                                std::chrono::milliseconds ms) {
-  write(fmt::format("envoy.{}:{}|ms\n", name, ms.count()));
+void TcpStatsdSink::TlsSink::flushHistogram(const std::string& name,
+                                            const HistogramStatistics& statistics) {
+  // All lines for a histogram are written together.
+  std::string stats = fmt::format("envoy.{}.count:{}|c\n", name, statistics.sampleCount());
+  for (const HistogramStatisticsImpl::ExportedQuantile& exported :
+       HistogramStatisticsImpl::exportedQuantiles()) {
+    stats += fmt::format("envoy.{}.{}:{}|g\n", name, exported.name_,
+                         statistics.quantile(exported.quantile_));
+  }
+  write(stats);
 }
 
 void TcpStatsdSink::TlsSink::shutdown() {
@@ -142,9 +220,9 @@ void TcpStatsdSink::TlsSink::write(const std::string& stat) {
   // Guard against the stats connection backing up. In this case we probably have no visibility
   // into what is going on externally, but we also increment a stat that should be viewable
   // locally.
-  // NOTE: In the current implementation, we write most stats on the main thread, but timers
-  //       get emitted on the worker threads. Since this is using global buffered data, it's
-  //       possible that we are about to kill the connection that is not actually backed up.
+  // NOTE: In the current implementation all stats are written on the main thread during flush.
+  //       Since this is using global buffered data, if stats are ever written from other threads
+  //       it's possible that we are about to kill a connection that is not actually backed up.
   //       This is essentially a panic state, so it's not worth keeping per thread buffer stats,
   //       since if we stay over, the other threads will eventually kill their connections too.
   // TODO(mattklein123): The use of the stat is somewhat of a hack, and should be replaced with
@@ -160,7 +238,7 @@ void TcpStatsdSink::TlsSink::write(const std::string& stat) {
 
   if (!connection_) {
     Upstream::Host::CreateConnectionData info =
-        parent_.cluster_manager_.tcpConnForCluster(parent_.cluster_info_->name());
+        parent_.cluster_manager_.tcpConnForCluster(parent_.cluster_info_->name(), nullptr);
     if (!info.connection_) {
       return;
     }
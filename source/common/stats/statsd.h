@@ -3,6 +3,7 @@
 #include <chrono>
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include "envoy/local_info/local_info.h"
 #include "envoy/network/connection.h"
@@ -15,42 +16,66 @@ namespace Stats {
 namespace Statsd {
 
 /**
- * This is a simple UDP localhost writer for statsd messages.
+ * This is a simple UDP localhost writer for statsd messages. If a maximum datagram size is
+ * supplied, messages are buffered and packed newline separated into datagrams of up to that size,
+ * and the datagrams are sent together with sendmmsg() when flush() is called. Otherwise each
+ * message is sent as it is written.
  */
 class Writer : public ThreadLocal::ThreadLocalObject {
 public:
-  Writer(Network::Address::InstanceConstSharedPtr address);
+  Writer(Network::Address::InstanceConstSharedPtr address, uint32_t max_datagram_size);
   ~Writer();
 
   void writeCounter(const std::string& name, uint64_t increment);
   void writeGauge(const std::string& name, uint64_t value);
-  void writeTimer(const std::string& name, const std::chrono::milliseconds& ms);
+
+  /**
+   * Send all buffered messages.
+   */
+  void flush();
+
   void shutdown() override;
   // Called in unit test to validate address.
   int getFdForTests() const { return fd_; };
 
 private:
+  // The maximum number of datagrams passed to a single sendmmsg() call.
+  static const uint32_t MaxDatagramsPerSend = 64;
+
+  void endDatagram();
   void send(const std::string& message);
 
   int fd_;
   bool shutdown_{};
+  const uint32_t max_datagram_size_;
+  // Buffered datagrams are stored back to back. datagram_ends_ holds the end offset of each
+  // completed datagram, and the datagram under construction starts at datagram_start_.
+  std::string buffer_;
+  std::vector<size_t> datagram_ends_;
+  size_t datagram_start_{};
 };
 
 /**
- * Implementation of Sink that writes to a UDP statsd address.
+ * Implementation of Sink that writes to a UDP statsd address. Statsd has no notion of tags, so
+ * metrics are written with their full names. Histograms are written as a counter
+ * of the samples in the flush interval named <histogram>.count, along with a gauge for each
+ * exported quantile named <histogram>.<quantile>. The TCP sink uses the same format.
  */
 class UdpStatsdSink : public Sink {
 public:
-  UdpStatsdSink(ThreadLocal::Instance& tls, Network::Address::InstanceConstSharedPtr address);
+  /**
+   * @param max_datagram_size supplies the maximum size of each datagram when batching metrics, or
+   *        0 to send each metric in its own datagram.
+   */
+  UdpStatsdSink(ThreadLocal::Instance& tls, Network::Address::InstanceConstSharedPtr address,
+                uint32_t max_datagram_size = 0);
 
   // Stats::Sink
-  void flushCounter(const std::string& name, uint64_t delta) override;
-  void flushGauge(const std::string& name, uint64_t value) override;
-  void onHistogramComplete(const std::string& name, uint64_t value) override {
-    // For statsd histograms are just timers.
-    onTimespanComplete(name, std::chrono::milliseconds(value));
-  }
-  void onTimespanComplete(const std::string& name, std::chrono::milliseconds ms) override;
+  void beginFlush() override {}
+  void flushCounter(const Counter& counter, uint64_t delta) override;
+  void flushGauge(const Gauge& gauge, uint64_t value) override;
+  void flushHistogram(const Histogram& histogram, const HistogramStatistics& statistics) override;
+  void endFlush() override { tls_.getTyped<Writer>(tls_slot_).flush(); }
   // Called in unit test to validate writer construction and address.
   int getFdForTests() { return tls_.getTyped<Writer>(tls_slot_).getFdForTests(); }
 
@@ -58,6 +83,7 @@ private:
   ThreadLocal::Instance& tls_;
   const uint32_t tls_slot_;
   Network::Address::InstanceConstSharedPtr server_address_;
+  const uint32_t max_datagram_size_;
 };
 
 /**
@@ -70,22 +96,20 @@ public:
                 Stats::Scope& scope);
 
   // Stats::Sink
-  void flushCounter(const std::string& name, uint64_t delta) override {
-    tls_.getTyped<TlsSink>(tls_slot_).flushCounter(name, delta);
+  void beginFlush() override {}
+  void flushCounter(const Counter& counter, uint64_t delta) override {
+    tls_.getTyped<TlsSink>(tls_slot_).flushCounter(counter.name(), delta);
   }
 
-  void flushGauge(const std::string& name, uint64_t value) override {
-    tls_.getTyped<TlsSink>(tls_slot_).flushGauge(name, value);
+  void flushGauge(const Gauge& gauge, uint64_t value) override {
+    tls_.getTyped<TlsSink>(tls_slot_).flushGauge(gauge.name(), value);
   }
 
-  void onHistogramComplete(const std::string& name, uint64_t value) override {
-    // For statsd histograms are just timers.
-    onTimespanComplete(name, std::chrono::milliseconds(value));
+  void flushHistogram(const Histogram& histogram, const HistogramStatistics& statistics) override {
+    tls_.getTyped<TlsSink>(tls_slot_).flushHistogram(histogram.name(), statistics);
   }
 
-  void onTimespanComplete(const std::string& name, std::chrono::milliseconds ms) override {
-    tls_.getTyped<TlsSink>(tls_slot_).onTimespanComplete(name, ms);
-  }
+  void endFlush() override {}
 
 private:
   struct TlsSink : public ThreadLocal::ThreadLocalObject, public Network::ConnectionCallbacks {
@@ -94,7 +118,7 @@ private:
 
     void flushCounter(const std::string& name, uint64_t delta);
     void flushGauge(const std::string& name, uint64_t value);
-    void onTimespanComplete(const std::string& name, std::chrono::milliseconds ms);
+    void flushHistogram(const std::string& name, const HistogramStatistics& statistics);
     void write(const std::string& stat);
 
     // ThreadLocal::ThreadLocalObject
@@ -102,6 +126,8 @@ private:
 
     // Network::ConnectionCallbacks
     void onEvent(uint32_t events) override;
+    void onAboveWriteBufferHighWatermark() override {}
+    void onBelowWriteBufferLowWatermark() override {}
 
     TcpStatsdSink& parent_;
     Event::Dispatcher& dispatcher_;
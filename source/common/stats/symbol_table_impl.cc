@@ -0,0 +1,115 @@
+#include "common/stats/symbol_table_impl.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "common/common/assert.h"
+
+namespace Envoy {
+namespace Stats {
+
+void StatName::appendSymbol(Symbol symbol) {
+  while (symbol >= 0x80) {
+    encoded_.push_back(static_cast<char>(0x80 | (symbol & 0x7f)));
+    symbol >>= 7;
+  }
+  encoded_.push_back(static_cast<char>(symbol));
+}
+
+std::vector<Symbol> StatName::symbols() const {
+  std::vector<Symbol> symbols;
+  Symbol symbol = 0;
+  uint32_t shift = 0;
+  for (char c : encoded_) {
+    const uint8_t byte = static_cast<uint8_t>(c);
+    symbol |= static_cast<Symbol>(byte & 0x7f) << shift;
+    if (byte & 0x80) {
+      shift += 7;
+    } else {
+      symbols.push_back(symbol);
+      symbol = 0;
+      shift = 0;
+    }
+  }
+
+  ASSERT(shift == 0);
+  return symbols;
+}
+
+StatName SymbolTable::encode(const std::string& name) {
+  StatName stat_name;
+  std::unique_lock<std::mutex> lock(lock_);
+  forEachToken(name, [this, &stat_name](std::string&& token) -> void {
+    stat_name.appendSymbol(toSymbolLockHeld(token));
+  });
+  return stat_name;
+}
+
+std::string SymbolTable::decode(const StatName& name) const {
+  std::string decoded;
+  bool first = true;
+  std::unique_lock<std::mutex> lock(lock_);
+  for (Symbol symbol : name.symbols()) {
+    if (!first) {
+      decoded.push_back('.');
+    }
+    first = false;
+    ASSERT(symbol < decode_map_.size());
+    decoded.append(decode_map_[symbol]);
+  }
+
+  return decoded;
+}
+
+Symbol SymbolTable::toSymbol(const std::string& token) {
+  std::unique_lock<std::mutex> lock(lock_);
+  return toSymbolLockHeld(token);
+}
+
+Symbol SymbolTable::toSymbolLockHeld(const std::string& token) {
+  auto result = encode_map_.emplace(token, decode_map_.size());
+  if (result.second) {
+    decode_map_.push_back(token);
+  }
+
+  return result.first->second;
+}
+
+size_t SymbolTable::numSymbols() const {
+  std::unique_lock<std::mutex> lock(lock_);
+  return decode_map_.size();
+}
+
+void SymbolTable::forEachToken(const std::string& name,
+                               std::function<void(std::string&&)> callback) {
+  size_t start = 0;
+  while (true) {
+    size_t end = name.find('.', start);
+    if (end == std::string::npos) {
+      callback(name.substr(start));
+      return;
+    }
+
+    callback(name.substr(start, end - start));
+    start = end + 1;
+  }
+}
+
+StatName SymbolCache::encode(const std::string& name) {
+  StatName stat_name;
+  SymbolTable::forEachToken(name, [this, &stat_name](std::string&& token) -> void {
+    auto symbol = symbols_.find(token);
+    if (symbol == symbols_.end()) {
+      Symbol new_symbol = table_.toSymbol(token);
+      symbols_.emplace(std::move(token), new_symbol);
+      stat_name.appendSymbol(new_symbol);
+    } else {
+      stat_name.appendSymbol(symbol->second);
+    }
+  });
+  return stat_name;
+}
+
+} // Stats
+} // Envoy
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common/common/non_copyable.h"
+
+namespace Envoy {
+namespace Stats {
+
+typedef uint32_t Symbol;
+
+/**
+ * A stat name encoded against a SymbolTable. The name is split on '.' and each token is replaced
+ * by its symbol, stored as a base 128 varint. Names made of tokens that are interned early (i.e.
+ * most of them) take about one byte per token, so typical names fit in the small string buffer of
+ * the underlying std::string and need no heap allocation.
+ */
+class StatName {
+public:
+  StatName() {}
+
+  bool operator==(const StatName& rhs) const { return encoded_ == rhs.encoded_; }
+  bool operator!=(const StatName& rhs) const { return encoded_ != rhs.encoded_; }
+
+  /**
+   * @return the size in bytes of the encoding.
+   */
+  size_t size() const { return encoded_.size(); }
+
+  /**
+   * Append a symbol to the encoding.
+   */
+  void appendSymbol(Symbol symbol);
+
+  /**
+   * @return the symbols in the encoding in order.
+   */
+  std::vector<Symbol> symbols() const;
+
+  /**
+   * Hash functor for use in unordered containers.
+   */
+  struct Hash {
+    size_t operator()(const StatName& name) const {
+      return std::hash<std::string>()(name.encoded_);
+    }
+  };
+
+private:
+  std::string encoded_;
+};
+
+/**
+ * Interns the '.' separated tokens of stat names. Symbols are never released. The number of
+ * distinct tokens is small compared to the number of names built from them, and never reusing a
+ * symbol allows per thread caches of symbols to be consulted without any synchronization.
+ * All methods are thread safe.
+ */
+class SymbolTable : NonCopyable {
+public:
+  /**
+   * @return the encoding of a name, interning any tokens that have not been seen before.
+   */
+  StatName encode(const std::string& name);
+
+  /**
+   * @return the name that an encoding was created from.
+   */
+  std::string decode(const StatName& name) const;
+
+  /**
+   * @return the symbol for a single token, interning it if it has not been seen before.
+   */
+  Symbol toSymbol(const std::string& token);
+
+  /**
+   * @return the number of distinct tokens that have been interned.
+   */
+  size_t numSymbols() const;
+
+  /**
+   * Invoke a callback for each token of a name.
+   */
+  static void forEachToken(const std::string& name, std::function<void(std::string&&)> callback);
+
+private:
+  Symbol toSymbolLockHeld(const std::string& token);
+
+  mutable std::mutex lock_;
+  std::unordered_map<std::string, Symbol> encode_map_;
+  std::vector<std::string> decode_map_;
+};
+
+/**
+ * A single thread's view of a SymbolTable. Tokens that the thread has already seen are encoded
+ * without touching the shared table.
+ */
+class SymbolCache : NonCopyable {
+public:
+  SymbolCache(SymbolTable& table) : table_(table) {}
+
+  /**
+   * @return the encoding of a name. This is identical to SymbolTable::encode().
+   */
+  StatName encode(const std::string& name);
+
+private:
+  SymbolTable& table_;
+  std::unordered_map<std::string, Symbol> symbols_;
+};
+
+} // Stats
+} // Envoy
@@ -0,0 +1,74 @@
+#include "common/stats/tag_extractor_impl.h"
+
+#include <string>
+#include <vector>
+
+#include "envoy/common/exception.h"
+
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+namespace Stats {
+
+namespace {
+
+std::regex parseRegex(const std::string& name, const std::string& regex) {
+  try {
+    return std::regex(regex);
+  } catch (const std::regex_error& e) {
+    throw EnvoyException(fmt::format("invalid regex '{}' for tag '{}': {}", regex, name, e.what()));
+  }
+}
+
+} // namespace
+
+TagExtractorImpl::TagExtractorImpl(const std::string& name, const std::string& regex)
+    : name_(name), regex_(parseRegex(name, regex)) {
+  if (regex_.mark_count() == 0) {
+    throw EnvoyException(
+        fmt::format("regex '{}' for tag '{}' has no capture group", regex, name));
+  }
+}
+
+bool TagExtractorImpl::extractTag(std::string& name, std::vector<Tag>& tags) const {
+  std::smatch match;
+  if (!std::regex_search(name, match, regex_)) {
+    return false;
+  }
+
+  const std::ssub_match& value = match.size() > 2 ? match[2] : match[1];
+  tags.push_back({name_, value.str()});
+  name.erase(match.position(1), match.length(1));
+  return true;
+}
+
+TagProducerImpl::TagProducerImpl() : TagProducerImpl(defaultTagExtractors()) {}
+
+TagProducerImpl::TagProducerImpl(std::vector<TagExtractorImpl>&& extractors)
+    : extractors_(std::move(extractors)) {}
+
+std::string TagProducerImpl::produceTags(const std::string& name, std::vector<Tag>& tags) const {
+  std::string base_name = name;
+  for (const TagExtractorImpl& extractor : extractors_) {
+    extractor.extractTag(base_name, tags);
+  }
+  return base_name;
+}
+
+std::vector<TagExtractorImpl> TagProducerImpl::defaultTagExtractors() {
+  std::vector<TagExtractorImpl> extractors;
+  // cluster.<cluster_name>.
+  extractors.emplace_back("envoy.cluster_name", "^cluster\\.((.+?)\\.)");
+  // vhost.<virtual_host_name>.vcluster.<virtual_cluster_name>.
+  extractors.emplace_back("envoy.virtual_host", "^vhost\\.((.+?)\\.)");
+  extractors.emplace_back("envoy.virtual_cluster", "^vhost\\.vcluster\\.((.+?)\\.)");
+  // http.<stat_prefix>.
+  extractors.emplace_back("envoy.http_conn_manager_prefix", "^http\\.((.+?)\\.)");
+  // *_rq_<code> and *_rq_<code class>
+  extractors.emplace_back("envoy.response_code", "_rq(_(\\d{3}))$");
+  extractors.emplace_back("envoy.response_code_class", "_rq(_(\\dxx))$");
+  return extractors;
+}
+
+} // Stats
+} // Envoy
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "envoy/stats/stats.h"
+
+namespace Envoy {
+namespace Stats {
+
+/**
+ * Extracts one tag from stat names with a regex. The first capture group of the regex is removed
+ * from the name, and the second capture group, or the first one if there is only one, is the value
+ * of the tag. For example "^cluster\.((.+?)\.)" turns "cluster.foo.upstream_rq_200" into
+ * "cluster.upstream_rq_200" with the value "foo".
+ */
+class TagExtractorImpl {
+public:
+  /**
+   * @param name supplies the name of the tag.
+   * @param regex supplies the regex. Throws EnvoyException if it is invalid or has no capture
+   *        group.
+   */
+  TagExtractorImpl(const std::string& name, const std::string& regex);
+
+  const std::string& name() const { return name_; }
+
+  /**
+   * Extract the tag from a stat name.
+   * @param name supplies the stat name, from which the tag is removed if the regex matches.
+   * @param tags supplies the tags to add the tag to if the regex matches.
+   * @return true if the regex matched.
+   */
+  bool extractTag(std::string& name, std::vector<Tag>& tags) const;
+
+private:
+  const std::string name_;
+  const std::regex regex_;
+};
+
+/**
+ * Splits stat names into a base name and tags by running a list of tag extractors over them in
+ * order. Each extractor sees the name as left by the previous ones.
+ */
+class TagProducerImpl : public TagProducer {
+public:
+  /**
+   * Create a producer with the default extractors, @see defaultTagExtractors().
+   */
+  TagProducerImpl();
+  TagProducerImpl(std::vector<TagExtractorImpl>&& extractors);
+
+  // Stats::TagProducer
+  std::string produceTags(const std::string& name, std::vector<Tag>& tags) const override;
+
+  /**
+   * @return the extractors for the tags Envoy embeds in its own stat names: the cluster, the
+   *         virtual host and virtual cluster, the HTTP connection manager prefix and the response
+   *         code and code class.
+   */
+  static std::vector<TagExtractorImpl> defaultTagExtractors();
+
+private:
+  const std::vector<TagExtractorImpl> extractors_;
+};
+
+} // Stats
+} // Envoy
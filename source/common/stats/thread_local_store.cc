@@ -7,6 +7,10 @@
 #include <mutex>
 #include <string>
 #include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "common/memory/accounting.h"
 
 namespace Envoy {
 namespace Stats {
@@ -28,7 +32,7 @@ std::list<CounterSharedPtr> ThreadLocalStoreImpl::counters() const {
   std::unique_lock<std::mutex> lock(lock_);
   for (ScopeImpl* scope : scopes_) {
     for (auto counter : scope->central_cache_.counters_) {
-      if (names.insert(counter.first).second) {
+      if (names.insert(counter.second->name()).second) {
         ret.push_back(counter.second);
       }
     }
@@ -38,12 +42,28 @@ std::list<CounterSharedPtr> ThreadLocalStoreImpl::counters() const {
 }
 
 ScopePtr ThreadLocalStoreImpl::createScope(const std::string& name) {
+  Memory::AccountingScope accounting(Memory::Subsystem::Stats);
   std::unique_ptr<ScopeImpl> new_scope(new ScopeImpl(*this, name));
   std::unique_lock<std::mutex> lock(lock_);
   scopes_.emplace(new_scope.get());
   return std::move(new_scope);
 }
 
+void ThreadLocalStoreImpl::addParentHistogram(
+    const std::string& name, uint64_t sample_sum,
+    const std::vector<std::pair<uint64_t, uint64_t>>& buckets) {
+  HistogramStatisticsImpl statistics;
+  for (const std::pair<uint64_t, uint64_t>& bucket : buckets) {
+    statistics.addCount(HistogramBuckets::index(bucket.first), bucket.second);
+  }
+  statistics.addSum(sample_sum);
+
+  // The default scope keeps the histogram alive even if this process never records to it.
+  Memory::AccountingScope accounting(Memory::Subsystem::Stats);
+  std::unique_lock<std::mutex> lock(lock_);
+  static_cast<ScopeImpl&>(*default_scope_).centralHistogram(name).addCumulative(statistics);
+}
+
 std::list<GaugeSharedPtr> ThreadLocalStoreImpl::gauges() const {
   // Handle de-dup due to overlapping scopes.
   std::list<GaugeSharedPtr> ret;
@@ -51,7 +71,7 @@ std::list<GaugeSharedPtr> ThreadLocalStoreImpl::gauges() const {
   std::unique_lock<std::mutex> lock(lock_);
   for (ScopeImpl* scope : scopes_) {
     for (auto gauge : scope->central_cache_.gauges_) {
-      if (names.insert(gauge.first).second) {
+      if (names.insert(gauge.second->name()).second) {
         ret.push_back(gauge.second);
       }
     }
@@ -60,13 +80,27 @@ std::list<GaugeSharedPtr> ThreadLocalStoreImpl::gauges() const {
   return ret;
 }
 
+std::list<HistogramSharedPtr> ThreadLocalStoreImpl::histograms() const {
+  // Overlapping scopes share parent histograms, so there is no need to de-dup.
+  std::list<HistogramSharedPtr> ret;
+  std::unique_lock<std::mutex> lock(lock_);
+  for (auto histogram : histograms_) {
+    HistogramSharedPtr parent = histogram.second.lock();
+    if (parent) {
+      ret.push_back(parent);
+    }
+  }
+
+  return ret;
+}
+
 void ThreadLocalStoreImpl::initializeThreading(Event::Dispatcher& main_thread_dispatcher,
                                                ThreadLocal::Instance& tls) {
   main_thread_dispatcher_ = &main_thread_dispatcher;
   tls_ = &tls;
   tls_slot_ = tls_->allocateSlot();
-  tls_->set(tls_slot_, [](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
-    return std::make_shared<TlsCache>();
+  tls_->set(tls_slot_, [this](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+    return std::make_shared<TlsCache>(symbol_table_);
   });
 }
 
@@ -75,11 +109,31 @@ void ThreadLocalStoreImpl::shutdownThreading() {
   shutting_down_ = true;
 }
 
+void ThreadLocalStoreImpl::setTagProducer(TagProducerPtr&& tag_producer) {
+  std::unique_lock<std::mutex> lock(lock_);
+  tag_producer_ = std::move(tag_producer);
+}
+
+std::string ThreadLocalStoreImpl::produceTags(const std::string& final_name,
+                                              std::vector<Tag>& tags) {
+  return tag_producer_ ? tag_producer_->produceTags(final_name, tags) : final_name;
+}
+
 void ThreadLocalStoreImpl::releaseScopeCrossThread(ScopeImpl* scope) {
   std::unique_lock<std::mutex> lock(lock_);
   ASSERT(scopes_.count(scope) == 1);
   scopes_.erase(scope);
 
+  // Drop any histograms that were only referenced by the deleted scope.
+  scope->central_histograms_.clear();
+  for (auto it = histograms_.begin(); it != histograms_.end();) {
+    if (it->second.expired()) {
+      it = histograms_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
   // This can happen from any thread. We post() back to the main thread which will initiate the
   // cache flush operation.
   if (!shutting_down_ && main_thread_dispatcher_) {
@@ -88,6 +142,7 @@ void ThreadLocalStoreImpl::releaseScopeCrossThread(ScopeImpl* scope) {
 }
 
 void ThreadLocalStoreImpl::clearScopeFromCaches(ScopeImpl* scope) {
+
   // If we are shutting down we no longer perform cache flushes as workers may be shutting down
   // at the same time.
   if (!shutting_down_) {
@@ -110,20 +165,36 @@ ThreadLocalStoreImpl::SafeAllocData ThreadLocalStoreImpl::safeAlloc(const std::s
   }
 }
 
-ThreadLocalStoreImpl::ScopeImpl::~ScopeImpl() { parent_.releaseScopeCrossThread(this); }
+ThreadLocalStoreImpl::ScopeImpl::~ScopeImpl() {
+  Memory::AccountingScope accounting(Memory::Subsystem::Stats);
+  parent_.releaseScopeCrossThread(this);
+  // Free the stats now rather than after the destructor so that they are accounted for.
+  central_cache_ = TlsCacheEntry();
+}
+
+ThreadLocalStoreImpl::TlsCacheEntry*
+ThreadLocalStoreImpl::ScopeImpl::tlsCacheEntry(const std::string& name, StatName& stat_name) {
+  if (parent_.shutting_down_ || !parent_.tls_) {
+    return nullptr;
+  }
+
+  TlsCache& tls_cache = parent_.tls_->getTyped<TlsCache>(parent_.tls_slot_);
+  stat_name = tls_cache.symbols_.encode(name);
+  return &tls_cache.scope_cache_[this];
+}
 
 Counter& ThreadLocalStoreImpl::ScopeImpl::counter(const std::string& name) {
-  // Determine the final name based on the prefix and the passed name.
-  std::string final_name = prefix_ + name;
+  Memory::AccountingScope accounting(Memory::Subsystem::Stats);
 
   // We now try to acquire a *reference* to the TLS cache shared pointer. This might remain null
   // if we don't have TLS initialized currently. The de-referenced pointer might be null if there
-  // is no cache entry.
+  // is no cache entry. Both caches are keyed by the encoded name without the scope prefix, so the
+  // final name is only built when a new stat is allocated.
+  StatName stat_name;
   CounterSharedPtr* tls_ref = nullptr;
-  if (!parent_.shutting_down_ && parent_.tls_) {
-    tls_ref = &parent_.tls_->getTyped<TlsCache>(parent_.tls_slot_)
-                   .scope_cache_[this]
-                   .counters_[final_name];
+  TlsCacheEntry* tls_entry = tlsCacheEntry(name, stat_name);
+  if (tls_entry) {
+    tls_ref = &tls_entry->counters_[stat_name];
   }
 
   // If we have a valid cache entry, return it.
@@ -134,10 +205,17 @@ Counter& ThreadLocalStoreImpl::ScopeImpl::counter(const std::string& name) {
   // We must now look in the central store so we must be locked. We grab a reference to the
   // central store location. It might contain nothing. In this case, we allocate a new stat.
   std::unique_lock<std::mutex> lock(parent_.lock_);
-  CounterSharedPtr& central_ref = central_cache_.counters_[final_name];
+  if (!tls_entry) {
+    stat_name = parent_.symbol_table_.encode(name);
+  }
+  CounterSharedPtr& central_ref = central_cache_.counters_[stat_name];
   if (!central_ref) {
+    const std::string final_name = prefix_ + name;
+    std::vector<Tag> tags;
+    std::string tag_extracted_name = parent_.produceTags(final_name, tags);
     SafeAllocData alloc = parent_.safeAlloc(final_name);
-    central_ref.reset(new CounterImpl(alloc.data_, alloc.free_));
+    central_ref.reset(new CounterImpl(alloc.data_, alloc.free_, std::move(tag_extracted_name),
+                                      std::move(tags), &parent_.changed_stats_));
   }
 
   // If we have a TLS location to store or allocation into, do it.
@@ -149,30 +227,77 @@ Counter& ThreadLocalStoreImpl::ScopeImpl::counter(const std::string& name) {
   return *central_ref;
 }
 
+ParentHistogramImpl&
+ThreadLocalStoreImpl::ScopeImpl::centralHistogram(const std::string& final_name) {
+  ParentHistogramImplSharedPtr& central_ref = central_histograms_[final_name];
+  if (!central_ref) {
+    // Overlapping scopes share the same parent histogram so that samples are not split across
+    // scopes while one is being swapped for another.
+    std::weak_ptr<ParentHistogramImpl>& shared_ref = parent_.histograms_[final_name];
+    central_ref = shared_ref.lock();
+    if (!central_ref) {
+      std::vector<Tag> tags;
+      std::string tag_extracted_name = parent_.produceTags(final_name, tags);
+      central_ref = std::make_shared<ParentHistogramImpl>(final_name, std::move(tag_extracted_name),
+                                                          std::move(tags));
+      shared_ref = central_ref;
+    }
+  }
+
+  return *central_ref;
+}
+
 void ThreadLocalStoreImpl::ScopeImpl::deliverHistogramToSinks(const std::string& name,
                                                               uint64_t value) {
-  std::string final_name = prefix_ + name;
-  for (Sink& sink : parent_.timer_sinks_) {
-    sink.onHistogramComplete(final_name, value);
+  Memory::AccountingScope accounting(Memory::Subsystem::Stats);
+
+  // Worker threads may still be recording while we shut down, and without TLS there is nowhere
+  // safe for them to record to.
+  if (parent_.shutting_down_) {
+    return;
   }
+
+  // Before threading is initialized record directly into a central thread local histogram. This
+  // path takes the lock which serializes the writers.
+  StatName stat_name;
+  TlsCacheEntry* tls_entry = tlsCacheEntry(name, stat_name);
+  if (!tls_entry) {
+    std::unique_lock<std::mutex> lock(parent_.lock_);
+    ThreadLocalHistogramSharedPtr& central_ref =
+        central_cache_.histograms_[parent_.symbol_table_.encode(name)];
+    if (!central_ref) {
+      central_ref = std::make_shared<ThreadLocalHistogramImpl>();
+      centralHistogram(prefix_ + name).addTlsHistogram(central_ref);
+    }
+    central_ref->recordValue(value);
+    return;
+  }
+
+  ThreadLocalHistogramSharedPtr& tls_ref = tls_entry->histograms_[stat_name];
+  if (!tls_ref) {
+    tls_ref = std::make_shared<ThreadLocalHistogramImpl>();
+    std::unique_lock<std::mutex> lock(parent_.lock_);
+    centralHistogram(prefix_ + name).addTlsHistogram(tls_ref);
+  }
+
+  tls_ref->recordValue(value);
 }
 
 void ThreadLocalStoreImpl::ScopeImpl::deliverTimingToSinks(const std::string& name,
                                                            std::chrono::milliseconds ms) {
-  std::string final_name = prefix_ + name;
-  for (Sink& sink : parent_.timer_sinks_) {
-    sink.onTimespanComplete(final_name, ms);
-  }
+  deliverHistogramToSinks(name, ms.count());
 }
 
 Gauge& ThreadLocalStoreImpl::ScopeImpl::gauge(const std::string& name) {
+  Memory::AccountingScope accounting(Memory::Subsystem::Stats);
+
   // See comments in counter(). There is no super clean way (via templates or otherwise) to
   // share this code so I'm leaving it largely duplicated for now.
-  std::string final_name = prefix_ + name;
+  StatName stat_name;
   GaugeSharedPtr* tls_ref = nullptr;
-  if (!parent_.shutting_down_ && parent_.tls_) {
-    tls_ref =
-        &parent_.tls_->getTyped<TlsCache>(parent_.tls_slot_).scope_cache_[this].gauges_[final_name];
+  TlsCacheEntry* tls_entry = tlsCacheEntry(name, stat_name);
+  if (tls_entry) {
+    tls_ref = &tls_entry->gauges_[stat_name];
   }
 
   if (tls_ref && *tls_ref) {
@@ -180,10 +305,17 @@ Gauge& ThreadLocalStoreImpl::ScopeImpl::gauge(const std::string& name) {
   }
 
   std::unique_lock<std::mutex> lock(parent_.lock_);
-  GaugeSharedPtr& central_ref = central_cache_.gauges_[final_name];
+  if (!tls_entry) {
+    stat_name = parent_.symbol_table_.encode(name);
+  }
+  GaugeSharedPtr& central_ref = central_cache_.gauges_[stat_name];
   if (!central_ref) {
+    const std::string final_name = prefix_ + name;
+    std::vector<Tag> tags;
+    std::string tag_extracted_name = parent_.produceTags(final_name, tags);
     SafeAllocData alloc = parent_.safeAlloc(final_name);
-    central_ref.reset(new GaugeImpl(alloc.data_, alloc.free_));
+    central_ref.reset(new GaugeImpl(alloc.data_, alloc.free_, std::move(tag_extracted_name),
+                                    std::move(tags), &parent_.changed_stats_));
   }
 
   if (tls_ref) {
@@ -194,13 +326,15 @@ Gauge& ThreadLocalStoreImpl::ScopeImpl::gauge(const std::string& name) {
 }
 
 Timer& ThreadLocalStoreImpl::ScopeImpl::timer(const std::string& name) {
+  Memory::AccountingScope accounting(Memory::Subsystem::Stats);
+
   // See comments in counter(). There is no super clean way (via templates or otherwise) to
   // share this code so I'm leaving it largely duplicated for now.
-  std::string final_name = prefix_ + name;
+  StatName stat_name;
   TimerSharedPtr* tls_ref = nullptr;
-  if (!parent_.shutting_down_ && parent_.tls_) {
-    tls_ref =
-        &parent_.tls_->getTyped<TlsCache>(parent_.tls_slot_).scope_cache_[this].timers_[final_name];
+  TlsCacheEntry* tls_entry = tlsCacheEntry(name, stat_name);
+  if (tls_entry) {
+    tls_ref = &tls_entry->timers_[stat_name];
   }
 
   if (tls_ref && *tls_ref) {
@@ -208,9 +342,12 @@ Timer& ThreadLocalStoreImpl::ScopeImpl::timer(const std::string& name) {
   }
 
   std::unique_lock<std::mutex> lock(parent_.lock_);
-  TimerSharedPtr& central_ref = central_cache_.timers_[final_name];
+  if (!tls_entry) {
+    stat_name = parent_.symbol_table_.encode(name);
+  }
+  TimerSharedPtr& central_ref = central_cache_.timers_[stat_name];
   if (!central_ref) {
-    central_ref.reset(new TimerImpl(final_name, parent_));
+    central_ref.reset(new TimerImpl(prefix_ + name, parent_));
   }
 
   if (tls_ref) {
@@ -8,10 +8,14 @@
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "envoy/thread_local/thread_local.h"
 
+#include "common/stats/histogram_impl.h"
 #include "common/stats/stats_impl.h"
+#include "common/stats/symbol_table_impl.h"
 
 namespace Envoy {
 namespace Stats {
@@ -23,6 +27,15 @@ namespace Stats {
  * - Overallaping scopes with proper reference counting (2 scopes with the same name will point to
  *   the same backing stats).
  * - Scope deletion.
+ * - Lock free per thread histograms that are merged on the main thread at flush time.
+ * - Tags are extracted from the final name once, when the central stat is created, so that sinks
+ *   and the admin endpoint can export dimensional stats without parsing names on every flush.
+ * - Counters and gauges add themselves to a list of changed stats the first time they change after
+ *   a flush, so a flush only visits the stats that changed rather than de-duping and latching all
+ *   of them. With overlapping scopes a changed gauge may be visited once per scope.
+ * - Compact cache keys. Stat names are encoded against a symbol table, and the caches are keyed by
+ *   the encoded name without the scope prefix. Each thread keeps its own copy of the symbols it
+ *   has seen so that cache hits do not take any lock.
  *
  * This implementation is complicated so here is a rough overview of the threading model.
  * - The store can be used before threading is initialized. This is needed during server init.
@@ -40,6 +53,10 @@ namespace Stats {
  *         repopulated on the next access.
  * - Since it's possible to have overlapping scopes, we de-dup stats when counters() or gauges() is
  *   called since these are very uncommon operations.
+ * - Histogram samples are recorded into a histogram owned by the recording thread. The thread local
+ *   histograms are registered with a parent histogram that is shared by overlapping scopes, and
+ *   the parent merges them when Histogram::merge() is called on the main thread. Samples recorded
+ *   while shutting down are dropped.
  * - Though this implementation is designed to work with a fixed shared memory space, it will fall
  *   back to heap allocated stats if needed. NOTE: In this case, overlapping scopes will not share
  *   the same backing store. This is to keep things simple, it could be done in the future if
@@ -65,18 +82,26 @@ public:
   std::list<CounterSharedPtr> counters() const override;
   ScopePtr createScope(const std::string& name) override;
   std::list<GaugeSharedPtr> gauges() const override;
+  std::list<HistogramSharedPtr> histograms() const override;
 
   // Stats::StoreRoot
-  void addSink(Sink& sink) override { timer_sinks_.push_back(sink); }
   void initializeThreading(Event::Dispatcher& main_thread_dispatcher,
                            ThreadLocal::Instance& tls) override;
   void shutdownThreading() override;
+  void setTagProducer(TagProducerPtr&& tag_producer) override;
+  void forEachChangedStat(const ChangedCounterCb& counter_cb,
+                          const ChangedGaugeCb& gauge_cb) override {
+    changed_stats_.flush(counter_cb, gauge_cb);
+  }
+  void addParentHistogram(const std::string& name, uint64_t sample_sum,
+                          const std::vector<std::pair<uint64_t, uint64_t>>& buckets) override;
 
 private:
   struct TlsCacheEntry {
-    std::unordered_map<std::string, CounterSharedPtr> counters_;
-    std::unordered_map<std::string, GaugeSharedPtr> gauges_;
-    std::unordered_map<std::string, TimerSharedPtr> timers_;
+    std::unordered_map<StatName, CounterSharedPtr, StatName::Hash> counters_;
+    std::unordered_map<StatName, GaugeSharedPtr, StatName::Hash> gauges_;
+    std::unordered_map<StatName, TimerSharedPtr, StatName::Hash> timers_;
+    std::unordered_map<StatName, ThreadLocalHistogramSharedPtr, StatName::Hash> histograms_;
   };
 
   struct ScopeImpl : public Scope {
@@ -91,16 +116,31 @@ private:
     Gauge& gauge(const std::string& name) override;
     Timer& timer(const std::string& name) override;
 
+    /**
+     * @return the parent histogram for a final name. The store lock must be held.
+     */
+    ParentHistogramImpl& centralHistogram(const std::string& final_name);
+
+    /**
+     * @return the calling thread's cache entry for the scope, or nullptr if the thread local cache
+     *         is not available. If an entry is returned, stat_name is set to the encoding of name.
+     */
+    TlsCacheEntry* tlsCacheEntry(const std::string& name, StatName& stat_name);
+
     ThreadLocalStoreImpl& parent_;
     const std::string prefix_;
     TlsCacheEntry central_cache_;
+    std::unordered_map<std::string, ParentHistogramImplSharedPtr> central_histograms_;
   };
 
   struct TlsCache : public ThreadLocal::ThreadLocalObject {
+    TlsCache(SymbolTable& symbol_table) : symbols_(symbol_table) {}
+
     // ThreadLocal::ThreadLocalObject
     void shutdown() override { scope_cache_.clear(); }
 
     std::unordered_map<ScopeImpl*, TlsCacheEntry> scope_cache_;
+    SymbolCache symbols_;
   };
 
   struct SafeAllocData {
@@ -108,6 +148,11 @@ private:
     RawStatDataAllocator& free_;
   };
 
+  /**
+   * @return the tag extracted name of a final name, adding the extracted tags to tags. The store
+   *         lock must be held.
+   */
+  std::string produceTags(const std::string& final_name, std::vector<Tag>& tags);
   void clearScopeFromCaches(ScopeImpl* scope);
   void releaseScopeCrossThread(ScopeImpl* scope);
   SafeAllocData safeAlloc(const std::string& name);
@@ -117,12 +162,15 @@ private:
   ThreadLocal::Instance* tls_{};
   uint32_t tls_slot_;
   mutable std::mutex lock_;
+  SymbolTable symbol_table_;
   std::unordered_set<ScopeImpl*> scopes_;
+  std::unordered_map<std::string, std::weak_ptr<ParentHistogramImpl>> histograms_;
+  TagProducerPtr tag_producer_;
   ScopePtr default_scope_;
-  std::list<std::reference_wrapper<Sink>> timer_sinks_;
   std::atomic<bool> shutting_down_{};
   Counter& num_last_resort_stats_;
   HeapRawStatDataAllocator heap_allocator_;
+  ChangedStats changed_stats_;
 };
 
 } // Stats
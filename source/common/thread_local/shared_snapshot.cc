@@ -0,0 +1,64 @@
+#include "common/thread_local/shared_snapshot.h"
+
+#include <memory>
+#include <mutex>
+
+namespace Envoy {
+namespace ThreadLocal {
+
+SharedSnapshot::SharedSnapshot(Instance& tls, ThreadLocalObjectSharedPtr initial)
+    : tls_(tls), tls_slot_(tls.allocateSlot()), published_(std::make_shared<Published>()) {
+  published_->object_ = initial;
+  PublishedSharedPtr published = published_;
+  tls_.set(tls_slot_, [published](Event::Dispatcher& dispatcher) -> ThreadLocalObjectSharedPtr {
+    return std::make_shared<ThreadCopy>(published, dispatcher);
+  });
+}
+
+void SharedSnapshot::publish(ThreadLocalObjectSharedPtr object) {
+  {
+    std::unique_lock<std::mutex> lock(published_->lock_);
+    published_->object_ = object;
+    published_->generation_++;
+  }
+
+  // The main thread swaps right away so that the object is visible as soon as publish() returns.
+  tls_.getTyped<ThreadCopy>(tls_slot_).refresh();
+}
+
+const ThreadLocalObjectSharedPtr& SharedSnapshot::get() {
+  ThreadCopy& copy = tls_.getTyped<ThreadCopy>(tls_slot_);
+  if (!copy.refresh_pending_ &&
+      copy.generation_ != published_->generation_.load(std::memory_order_acquire)) {
+    // The caller may hold references into the current object further up the stack, so the new
+    // one is only swapped in from the event loop.
+    copy.refresh_pending_ = true;
+    std::weak_ptr<ThreadCopy> weak_copy = copy.shared_from_this();
+    copy.dispatcher_.post([weak_copy]() -> void {
+      std::shared_ptr<ThreadCopy> copy = weak_copy.lock();
+      if (copy) {
+        copy->refresh();
+      }
+    });
+  }
+
+  return copy.object_;
+}
+
+SharedSnapshot::ThreadCopy::ThreadCopy(PublishedSharedPtr published,
+                                       Event::Dispatcher& dispatcher)
+    : published_(published), dispatcher_(dispatcher) {
+  refresh();
+}
+
+void SharedSnapshot::ThreadCopy::refresh() {
+  // Release the previous object outside of the lock in case this was the last reference.
+  ThreadLocalObjectSharedPtr previous = std::move(object_);
+  std::unique_lock<std::mutex> lock(published_->lock_);
+  object_ = published_->object_;
+  generation_ = published_->generation_;
+  refresh_pending_ = false;
+}
+
+} // ThreadLocal
+} // Envoy
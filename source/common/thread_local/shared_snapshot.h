@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include "envoy/event/dispatcher.h"
+#include "envoy/thread_local/thread_local.h"
+
+namespace Envoy {
+namespace ThreadLocal {
+
+/**
+ * Shares an immutable object, such as a configuration snapshot, with all threads without posting
+ * to each of them when it changes. The main thread publishes a new object in constant time by
+ * bumping a generation. Each thread notices the new generation the next time it reads the object,
+ * keeps using the object it has for the rest of the current event, and swaps in the new one from
+ * its own dispatcher. Threads that are idle never do any work, and the main thread's cost of an
+ * update does not grow with the number of workers.
+ *
+ * Objects returned by get() are therefore valid until the calling thread returns to its event
+ * loop, the same guarantee as for objects set with Instance::set(). The main thread sees a
+ * published object right away.
+ */
+class SharedSnapshot {
+public:
+  /**
+   * @param tls supplies the thread local instance. A slot is allocated and set once, so all
+   *            threads must be registered before the snapshot is constructed.
+   * @param initial supplies the first object to share.
+   */
+  SharedSnapshot(Instance& tls, ThreadLocalObjectSharedPtr initial);
+
+  /**
+   * Share a new object with all threads. Must be called from the main thread.
+   */
+  void publish(ThreadLocalObjectSharedPtr object);
+
+  /**
+   * @return the calling thread's copy of the shared object.
+   */
+  const ThreadLocalObjectSharedPtr& get();
+
+  /**
+   * Helper on top of get() that casts the shared object to the specified type.
+   */
+  template <class T> T& getTyped() { return dynamic_cast<T&>(*get()); }
+
+private:
+  struct Published {
+    std::mutex lock_;
+    ThreadLocalObjectSharedPtr object_;
+    std::atomic<uint64_t> generation_{};
+  };
+
+  typedef std::shared_ptr<Published> PublishedSharedPtr;
+
+  struct ThreadCopy : public ThreadLocalObject, public std::enable_shared_from_this<ThreadCopy> {
+    ThreadCopy(PublishedSharedPtr published, Event::Dispatcher& dispatcher);
+
+    void refresh();
+
+    // ThreadLocal::ThreadLocalObject
+    void shutdown() override { object_.reset(); }
+
+    PublishedSharedPtr published_;
+    Event::Dispatcher& dispatcher_;
+    ThreadLocalObjectSharedPtr object_;
+    uint64_t generation_{};
+    bool refresh_pending_{};
+  };
+
+  Instance& tls_;
+  const uint32_t tls_slot_;
+  PublishedSharedPtr published_;
+};
+
+} // ThreadLocal
+} // Envoy
@@ -18,7 +18,7 @@ std::list<std::reference_wrapper<Event::Dispatcher>> InstanceImpl::registered_th
 
 InstanceImpl::~InstanceImpl() { reset(); }
 
-ThreadLocalObjectSharedPtr InstanceImpl::get(uint32_t index) {
+const ThreadLocalObjectSharedPtr& InstanceImpl::get(uint32_t index) {
   ASSERT(thread_local_data_.data_.size() > index);
   return thread_local_data_.data_[index];
 }
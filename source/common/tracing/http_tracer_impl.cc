@@ -1,5 +1,6 @@
 #include "common/tracing/http_tracer_impl.h"
 
+#include <cstring>
 #include <string>
 
 #include "common/common/assert.h"
@@ -10,6 +11,7 @@
 #include "common/http/header_map_impl.h"
 #include "common/http/headers.h"
 #include "common/http/utility.h"
+#include "common/runtime/runtime_impl.h"
 #include "common/runtime/uuid_util.h"
 
 #include "spdlog/spdlog.h"
@@ -45,32 +47,39 @@ void HttpTracerUtility::mutateHeaders(Http::HeaderMap& request_headers, Runtime:
     return;
   }
 
-  // TODO PERF: Avoid copy.
-  std::string x_request_id = request_headers.RequestId()->value().c_str();
-
+  const Http::HeaderString& request_id = request_headers.RequestId()->value();
   uint16_t result;
   // Skip if x-request-id is corrupted.
-  if (!UuidUtils::uuidModBy(x_request_id, result, 10000)) {
+  if (!UuidUtils::uuidModBy(request_id.c_str(), request_id.size(), result, 10000)) {
     return;
   }
 
+  // Only a well formed uuid4 can carry the trace status, so anything else is left untouched.
+  if (request_id.size() != Runtime::RandomGeneratorImpl::UUID_LENGTH) {
+    return;
+  }
+
+  // The uuid is modified on the stack and copied back into the header's inline storage.
+  char x_request_id[Runtime::RandomGeneratorImpl::UUID_LENGTH];
+  memcpy(x_request_id, request_id.c_str(), sizeof(x_request_id));
+
   // Do not apply tracing transformations if we are currently tracing.
-  if (UuidTraceStatus::NoTrace == UuidUtils::isTraceableUuid(x_request_id)) {
+  if (UuidTraceStatus::NoTrace == UuidUtils::isTraceableUuid(x_request_id, sizeof(x_request_id))) {
     if (request_headers.ClientTraceId() &&
         runtime.snapshot().featureEnabled("tracing.client_enabled", 100)) {
-      UuidUtils::setTraceableUuid(x_request_id, UuidTraceStatus::Client);
+      UuidUtils::setTraceableUuid(x_request_id, sizeof(x_request_id), UuidTraceStatus::Client);
     } else if (request_headers.EnvoyForceTrace()) {
-      UuidUtils::setTraceableUuid(x_request_id, UuidTraceStatus::Forced);
+      UuidUtils::setTraceableUuid(x_request_id, sizeof(x_request_id), UuidTraceStatus::Forced);
     } else if (runtime.snapshot().featureEnabled("tracing.random_sampling", 10000, result, 10000)) {
-      UuidUtils::setTraceableUuid(x_request_id, UuidTraceStatus::Sampled);
+      UuidUtils::setTraceableUuid(x_request_id, sizeof(x_request_id), UuidTraceStatus::Sampled);
     }
   }
 
   if (!runtime.snapshot().featureEnabled("tracing.global_enabled", 100, result)) {
-    UuidUtils::setTraceableUuid(x_request_id, UuidTraceStatus::NoTrace);
+    UuidUtils::setTraceableUuid(x_request_id, sizeof(x_request_id), UuidTraceStatus::NoTrace);
   }
 
-  request_headers.RequestId()->value(x_request_id);
+  request_headers.RequestId()->value().setCopy(x_request_id, sizeof(x_request_id));
 }
 
 const std::string HttpTracerUtility::INGRESS_OPERATION = "ingress";
@@ -98,9 +107,8 @@ Decision HttpTracerUtility::isTracing(const Http::AccessLog::RequestInfo& reques
     return {Reason::NotTraceableRequestId, false};
   }
 
-  // TODO PERF: Avoid copy.
-  UuidTraceStatus trace_status =
-      UuidUtils::isTraceableUuid(request_headers.RequestId()->value().c_str());
+  const Http::HeaderString& request_id = request_headers.RequestId()->value();
+  UuidTraceStatus trace_status = UuidUtils::isTraceableUuid(request_id.c_str(), request_id.size());
 
   switch (trace_status) {
   case UuidTraceStatus::Client:
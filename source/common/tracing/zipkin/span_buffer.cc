@@ -1,33 +1,57 @@
 #include "common/tracing/zipkin/span_buffer.h"
 
+#include "common/common/assert.h"
+#include "common/tracing/zipkin/thrift_writer.h"
+
 namespace Envoy {
 namespace Zipkin {
 
-// TODO(fabolive): Need to avoid the copy to improve performance.
 bool SpanBuffer::addSpan(const Span& span) {
-  if (span_buffer_.size() == span_buffer_.capacity()) {
+  if (pending_spans_ == max_spans_) {
     // Buffer full
     return false;
   }
-  span_buffer_.push_back(std::move(span));
+
+  if (encoding_ == SpanEncoding::Thrift) {
+    ThriftWriter writer(encoded_spans_);
+    span.toThrift(writer);
+  } else {
+    if (pending_spans_) {
+      encoded_spans_.add(",", 1);
+    }
+    encoded_spans_.add(span.toJson());
+  }
+  pending_spans_++;
 
   return true;
 }
 
 std::string SpanBuffer::toStringifiedJsonArray() {
+  ASSERT(encoding_ == SpanEncoding::Json);
   std::string stringified_json_array = "[";
 
-  if (pendingSpans()) {
-    stringified_json_array += span_buffer_[0].toJson();
-    const uint64_t size = span_buffer_.size();
-    for (uint64_t i = 1; i < size; i++) {
-      stringified_json_array += ",";
-      stringified_json_array += span_buffer_[i].toJson();
-    }
+  const uint64_t num_slices = encoded_spans_.getRawSlices(nullptr, 0);
+  Buffer::RawSlice slices[num_slices];
+  encoded_spans_.getRawSlices(slices, num_slices);
+  for (uint64_t i = 0; i < num_slices; i++) {
+    stringified_json_array.append(static_cast<const char*>(slices[i].mem_), slices[i].len_);
   }
   stringified_json_array += "]";
 
   return stringified_json_array;
 }
+
+void SpanBuffer::moveTo(Buffer::Instance& body) {
+  if (encoding_ == SpanEncoding::Thrift) {
+    ThriftWriter writer(body);
+    writer.writeListBegin(ThriftWriter::Type::Struct, pending_spans_);
+    body.move(encoded_spans_);
+  } else {
+    body.add("[", 1);
+    body.move(encoded_spans_);
+    body.add("]", 1);
+  }
+  pending_spans_ = 0;
+}
 } // Zipkin
 } // Envoy
@@ -1,13 +1,22 @@
 #pragma once
 
+#include "common/buffer/buffer_impl.h"
 #include "common/tracing/zipkin/zipkin_core_types.h"
 
 namespace Envoy {
 namespace Zipkin {
 
+/**
+ * Encodings in which spans can be sent to Zipkin.
+ */
+enum class SpanEncoding { Json, Thrift };
+
 /**
  * This class implements a simple buffer to store Zipkin tracing spans
  * prior to flushing them.
+ *
+ * Spans are encoded as soon as they are added, so the buffer holds the bytes of the request body
+ * rather than copies of the spans.
  */
 class SpanBuffer {
 public:
@@ -21,15 +30,18 @@ public:
    * Constructor that initializes a buffer with the given size.
    *
    * @param size The desired buffer size.
+   * @param encoding The encoding of the buffered spans.
    */
-  SpanBuffer(uint64_t size) { allocateBuffer(size); }
+  SpanBuffer(uint64_t size, SpanEncoding encoding = SpanEncoding::Json) : encoding_(encoding) {
+    allocateBuffer(size);
+  }
 
   /**
-   * Allocates space for an empty buffer or resizes a previously-allocated one.
+   * Sets the maximum number of spans the buffer can hold.
    *
    * @param size The desired buffer size.
    */
-  void allocateBuffer(uint64_t size) { span_buffer_.reserve(size); }
+  void allocateBuffer(uint64_t size) { max_spans_ = size; }
 
   /**
    * Adds the given Zipkin span to the buffer.
@@ -44,22 +56,40 @@ public:
    * Empties the buffer. This method is supposed to be called when all buffered spans
    * have been sent to to the Zipkin service.
    */
-  void clear() { span_buffer_.clear(); }
+  void clear() {
+    encoded_spans_.drain(encoded_spans_.length());
+    pending_spans_ = 0;
+  }
 
   /**
    * @return the number of spans currently buffered.
    */
-  uint64_t pendingSpans() { return span_buffer_.size(); }
+  uint64_t pendingSpans() { return pending_spans_; }
+
+  /**
+   * @return the encoding of the buffered spans.
+   */
+  SpanEncoding encoding() const { return encoding_; }
 
   /**
    * @return the contents of the buffer as a stringified array of JSONs, where
-   * each JSON in the array corresponds to one Zipkin span.
+   * each JSON in the array corresponds to one Zipkin span. Only valid for the JSON encoding.
    */
   std::string toStringifiedJsonArray();
 
+  /**
+   * Moves the buffered spans, framed as a complete request body in the buffer's encoding, into
+   * the given buffer and empties this one.
+   *
+   * @param body The buffer the request body is added to.
+   */
+  void moveTo(Buffer::Instance& body);
+
 private:
-  // We use a pre-allocated vector to improve performance
-  std::vector<Span> span_buffer_;
+  SpanEncoding encoding_{SpanEncoding::Json};
+  uint64_t max_spans_{};
+  uint64_t pending_spans_{};
+  Buffer::OwnedImpl encoded_spans_;
 };
 } // Zipkin
 } // Envoy
@@ -1,72 +1,45 @@
 #include "common/tracing/zipkin/span_context.h"
 
-#include "common/common/utility.h"
+#include <cstring>
+
+#include "common/common/hex.h"
 #include "common/tracing/zipkin/zipkin_core_constants.h"
 
 namespace Envoy {
 namespace Zipkin {
 
 namespace {
-// The functions below are needed due to the "C++ static initialization order fiasco."
-
-/**
- * @return String that separates the span-context fields in its string-serialized form.
- */
-static const std::string& fieldSeparator() {
-  static const std::string* field_separator = new std::string(";");
-
-  return *field_separator;
-}
-
-/**
- * @return String value corresponding to an empty span context.
- */
-static const std::string& unitializedSpanContext() {
-  static const std::string* unitialized_span_context =
-      new std::string("0000000000000000" + fieldSeparator() + "0000000000000000" +
-                      fieldSeparator() + "0000000000000000");
-
-  return *unitialized_span_context;
-}
 
-/**
- * @return String with regular expression to match a 16-digit hexadecimal number.
- */
-static const std::string& hexDigitGroupRegexStr() {
-  static const std::string* hex_digit_group_regex_str = new std::string("([0-9,a-z]{16})");
-
-  return *hex_digit_group_regex_str;
-}
+const char FIELD_SEPARATOR = ';';
 
 /**
- * @return a string with a regular expression to match a valid string-serialized span context.
+ * Sets the member of the given annotation set that corresponds to the two-letter annotation value.
  *
- * Note that a function is needed because we cannot concatenate static strings from
- * different compilation units at initialization time (the initialization order is not
- * guaranteed). In this case, the compilation units are ZipkinCoreConstants and SpanContext.
+ * @return false if the value is not one of "cs", "cr", "ss", or "sr".
  */
-static const std::string& spanContextRegexStr() {
-  // ^([0-9,a-z]{16});([0-9,a-z]{16});([0-9,a-z]{16})((;(cs|sr|cr|ss))*)$
-  static const std::string* span_context_regex_str = new std::string(
-      "^" + hexDigitGroupRegexStr() + fieldSeparator() + hexDigitGroupRegexStr() +
-      fieldSeparator() + hexDigitGroupRegexStr() + "((" + fieldSeparator() + "(" +
-      ZipkinCoreConstants::get().CLIENT_SEND + "|" + ZipkinCoreConstants::get().SERVER_RECV + "|" +
-      ZipkinCoreConstants::get().CLIENT_RECV + "|" + ZipkinCoreConstants::get().SERVER_SEND +
-      "))*)$");
-
-  return *span_context_regex_str;
+bool setAnnotation(const char* value, AnnotationSet& annotations) {
+  if (ZipkinCoreConstants::get().CLIENT_RECV.compare(0, std::string::npos, value, 2) == 0) {
+    annotations.cr_ = true;
+  } else if (ZipkinCoreConstants::get().CLIENT_SEND.compare(0, std::string::npos, value, 2) == 0) {
+    annotations.cs_ = true;
+  } else if (ZipkinCoreConstants::get().SERVER_RECV.compare(0, std::string::npos, value, 2) == 0) {
+    annotations.sr_ = true;
+  } else if (ZipkinCoreConstants::get().SERVER_SEND.compare(0, std::string::npos, value, 2) == 0) {
+    annotations.ss_ = true;
+  } else {
+    return false;
+  }
+
+  return true;
 }
 
 /**
- * @return a regex to match a valid string-serialization of a span context.
- *
- * Note that a function is needed because the string used to build the regex
- * cannot be initialized statically.
+ * Appends ";<annotation value>" to out.
  */
-static const std::regex& spanContextRegex() {
-  static const std::regex* span_context_regex = new std::regex(spanContextRegexStr());
-
-  return *span_context_regex;
+void appendAnnotation(const std::string& value, char*& out) {
+  *out++ = FIELD_SEPARATOR;
+  memcpy(out, value.c_str(), value.size());
+  out += value.size();
 }
 } // namespace
 
@@ -90,65 +63,71 @@ SpanContext::SpanContext(const Span& span) {
   is_initialized_ = true;
 }
 
-const std::string SpanContext::serializeToString() {
-  if (!is_initialized_) {
-    return unitializedSpanContext();
-  }
-
-  std::string result;
-  result = traceIdAsHexString() + fieldSeparator() + idAsHexString() + fieldSeparator() +
-           parentIdAsHexString();
+const std::string SpanContext::serializeToString() const {
+  char buffer[MAX_SERIALIZED_LENGTH];
+  return std::string(buffer, serializeTo(buffer));
+}
 
-  if (annotation_values_.cr_) {
-    result += fieldSeparator() + ZipkinCoreConstants::get().CLIENT_RECV;
-  }
-  if (annotation_values_.cs_) {
-    result += fieldSeparator() + ZipkinCoreConstants::get().CLIENT_SEND;
-  }
-  if (annotation_values_.sr_) {
-    result += fieldSeparator() + ZipkinCoreConstants::get().SERVER_RECV;
-  }
-  if (annotation_values_.ss_) {
-    result += fieldSeparator() + ZipkinCoreConstants::get().SERVER_SEND;
+size_t SpanContext::serializeTo(char* out) const {
+  // An uninitialized context has zero ids and no annotations.
+  char* position = out;
+  Hex::uint64ToHex(trace_id_, position);
+  position[16] = FIELD_SEPARATOR;
+  Hex::uint64ToHex(id_, position + 17);
+  position[33] = FIELD_SEPARATOR;
+  Hex::uint64ToHex(parent_id_, position + 34);
+  position += IDS_LENGTH;
+
+  if (is_initialized_) {
+    if (annotation_values_.cr_) {
+      appendAnnotation(ZipkinCoreConstants::get().CLIENT_RECV, position);
+    }
+    if (annotation_values_.cs_) {
+      appendAnnotation(ZipkinCoreConstants::get().CLIENT_SEND, position);
+    }
+    if (annotation_values_.sr_) {
+      appendAnnotation(ZipkinCoreConstants::get().SERVER_RECV, position);
+    }
+    if (annotation_values_.ss_) {
+      appendAnnotation(ZipkinCoreConstants::get().SERVER_SEND, position);
+    }
   }
 
-  return result;
+  return position - out;
 }
 
-void SpanContext::populateFromString(const std::string& span_context_str) {
-  std::smatch match;
-
+void SpanContext::populateFromString(const char* data, size_t length) {
   trace_id_ = parent_id_ = id_ = 0;
-  annotation_values_.cs_ = annotation_values_.cr_ = annotation_values_.ss_ =
-      annotation_values_.sr_ = false;
-
-  if (std::regex_search(span_context_str, match, spanContextRegex())) {
-    // This is a valid string encoding of the context
-    trace_id_ = std::stoull(match.str(1), nullptr, 16);
-    id_ = std::stoull(match.str(2), nullptr, 16);
-    parent_id_ = std::stoull(match.str(3), nullptr, 16);
-
-    std::string matched_annotations = match.str(4);
-    if (matched_annotations.size() > 0) {
-      std::vector<std::string> annotation_value_strings =
-          StringUtil::split(matched_annotations, fieldSeparator());
-      for (const std::string& annotation_value : annotation_value_strings) {
-        if (annotation_value == ZipkinCoreConstants::get().CLIENT_RECV) {
-          annotation_values_.cr_ = true;
-        } else if (annotation_value == ZipkinCoreConstants::get().CLIENT_SEND) {
-          annotation_values_.cs_ = true;
-        } else if (annotation_value == ZipkinCoreConstants::get().SERVER_RECV) {
-          annotation_values_.sr_ = true;
-        } else if (annotation_value == ZipkinCoreConstants::get().SERVER_SEND) {
-          annotation_values_.ss_ = true;
-        }
-      }
-    }
+  annotation_values_ = AnnotationSet();
+  is_initialized_ = false;
 
-    is_initialized_ = true;
-  } else {
-    is_initialized_ = false;
+  // The expected format is "<trace id>;<span id>;<parent id>" followed by any number of
+  // ";<annotation>", where each id is exactly 16 hex digits and each annotation is two letters.
+  if (length < IDS_LENGTH || data[16] != FIELD_SEPARATOR || data[33] != FIELD_SEPARATOR) {
+    return;
+  }
+
+  uint64_t trace_id;
+  uint64_t id;
+  uint64_t parent_id;
+  if (!Hex::hexToUint64(data, 16, trace_id) || !Hex::hexToUint64(data + 17, 16, id) ||
+      !Hex::hexToUint64(data + 34, 16, parent_id)) {
+    return;
   }
+
+  AnnotationSet annotations;
+  for (size_t position = IDS_LENGTH; position < length; position += 3) {
+    if (length - position < 3 || data[position] != FIELD_SEPARATOR ||
+        !setAnnotation(data + position + 1, annotations)) {
+      return;
+    }
+  }
+
+  trace_id_ = trace_id;
+  id_ = id;
+  parent_id_ = parent_id;
+  annotation_values_ = annotations;
+  is_initialized_ = true;
 }
 } // Zipkin
 } // Envoy
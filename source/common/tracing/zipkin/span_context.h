@@ -1,6 +1,6 @@
 #pragma once
 
-#include <regex>
+#include <string>
 
 #include "common/tracing/zipkin/util.h"
 #include "common/tracing/zipkin/zipkin_core_types.h"
@@ -65,7 +65,18 @@ public:
    * Example of a returned string corresponding to a span with no annotations:
    * "25c6f38dd0600e78;56707c7b3e1092af;c49193ea42335d1c"
    */
-  const std::string serializeToString();
+  const std::string serializeToString() const;
+
+  /**
+   * Serializes the SpanContext object, in the format produced by serializeToString(), into the
+   * given buffer without allocating.
+   *
+   * @param out The buffer the string-encoded SpanContext is written to. It must have room for
+   * MAX_SERIALIZED_LENGTH characters and is not null terminated.
+   *
+   * @return the number of characters written.
+   */
+  size_t serializeTo(char* out) const;
 
   /**
    * Initializes a SpanContext object based on the given string.
@@ -73,7 +84,17 @@ public:
    * @param span_context_str The string-encoding of a SpanContext in the same format produced by the
    * method serializeToString().
    */
-  void populateFromString(const std::string& span_context_str);
+  void populateFromString(const std::string& span_context_str) {
+    populateFromString(span_context_str.c_str(), span_context_str.size());
+  }
+
+  /**
+   * Initializes a SpanContext object based on the given string, without allocating.
+   *
+   * @param data The string-encoding of a SpanContext.
+   * @param length The length of the string-encoding.
+   */
+  void populateFromString(const char* data, size_t length);
 
   /**
    * @return the span id as an integer
@@ -110,6 +131,16 @@ public:
    */
   AnnotationSet annotationSet() const { return annotation_values_; }
 
+  /**
+   * Length of the three ids of a string-encoded SpanContext and their separators.
+   */
+  static const size_t IDS_LENGTH = 3 * 16 + 2;
+
+  /**
+   * Maximum length of a string-encoded SpanContext: the ids followed by all four annotations.
+   */
+  static const size_t MAX_SERIALIZED_LENGTH = IDS_LENGTH + 4 * 3;
+
 private:
   uint64_t trace_id_;
   uint64_t id_;
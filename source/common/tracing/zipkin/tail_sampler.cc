@@ -0,0 +1,77 @@
+#include "common/tracing/zipkin/tail_sampler.h"
+
+#include <algorithm>
+
+namespace Envoy {
+namespace Zipkin {
+
+TailSamplingLimiter::TailSamplingLimiter(uint64_t max_exports_per_second,
+                                         MonotonicTimeSource& time_source)
+    : rate_(max_exports_per_second), time_source_(time_source), tokens_(rate_),
+      last_refill_(time_source.currentTime()) {}
+
+bool TailSamplingLimiter::tryExport() {
+  std::unique_lock<std::mutex> lock(lock_);
+  const MonotonicTime now = time_source_.currentTime();
+  const double elapsed_seconds =
+      std::chrono::duration_cast<std::chrono::duration<double>>(now - last_refill_).count();
+  tokens_ = std::min(rate_, tokens_ + elapsed_seconds * rate_);
+  last_refill_ = now;
+
+  if (tokens_ < 1) {
+    return false;
+  }
+
+  tokens_--;
+  return true;
+}
+
+TailSampler::TailSampler(const TailSamplingConfig& config, TailSamplingLimiter& limiter,
+                         MonotonicTimeSource& time_source)
+    : latency_threshold_us_(
+          std::chrono::duration_cast<std::chrono::microseconds>(config.latency_threshold_)
+              .count()),
+      limiter_(limiter), time_source_(time_source), slots_(config.max_buffered_spans_) {}
+
+TailSampler::Decision TailSampler::addSpan(const Span& span, const ExportCb& export_cb) {
+  if (!breached(span)) {
+    if (!slots_.empty()) {
+      // Assignment reuses the storage of the span being overwritten.
+      Slot& slot = slots_[next_slot_];
+      slot.span_ = span;
+      slot.live_ = true;
+      next_slot_ = (next_slot_ + 1) % slots_.size();
+    }
+    return Decision::Buffered;
+  }
+
+  if (!limiter_.tryExport()) {
+    return Decision::RateLimited;
+  }
+
+  // Walk the ring from the oldest slot so that spans are exported in completion order.
+  for (uint64_t i = 0; i < slots_.size(); i++) {
+    Slot& slot = slots_[(next_slot_ + i) % slots_.size()];
+    if (slot.live_ && slot.span_.traceId() == span.traceId()) {
+      export_cb(slot.span_);
+      slot.live_ = false;
+    }
+  }
+  export_cb(span);
+
+  return Decision::Exported;
+}
+
+bool TailSampler::breached(const Span& span) {
+  if (span.error()) {
+    return true;
+  }
+
+  const int64_t now_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                             time_source_.currentTime().time_since_epoch())
+                             .count();
+  return now_us - span.startTime() >= latency_threshold_us_;
+}
+
+} // Zipkin
+} // Envoy
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "envoy/common/time.h"
+
+#include "common/tracing/zipkin/zipkin_core_types.h"
+
+namespace Envoy {
+namespace Zipkin {
+
+/**
+ * Configuration of tail based sampling, shared by all workers.
+ */
+struct TailSamplingConfig {
+  // Spans that take at least this long are exported.
+  std::chrono::milliseconds latency_threshold_;
+  // Number of completed spans each worker keeps around waiting for a decision.
+  uint64_t max_buffered_spans_;
+  // Maximum number of traces exported per second across all workers.
+  uint64_t max_exports_per_second_;
+};
+
+/**
+ * Token bucket bounding the rate of tail sampled exports across all workers. It is only consulted
+ * for spans that breached, which are rare, so a lock is cheap enough here.
+ */
+class TailSamplingLimiter {
+public:
+  TailSamplingLimiter(uint64_t max_exports_per_second, MonotonicTimeSource& time_source);
+
+  /**
+   * @return true if a trace may be exported now, consuming one token.
+   */
+  bool tryExport();
+
+private:
+  const double rate_;
+  MonotonicTimeSource& time_source_;
+  std::mutex lock_;
+  double tokens_;
+  MonotonicTime last_refill_;
+};
+
+/**
+ * Per worker ring buffer of recently completed spans, used to decide which spans to export after
+ * the request has completed instead of when it started.
+ *
+ * A span that failed or breached the latency threshold is exported together with the buffered
+ * spans of the same trace, provided the export budget allows it. Any other span is kept in the
+ * ring buffer, overwriting the oldest one, in case a later span of its trace breaches. Spans that
+ * are overwritten are dropped without ever being serialized.
+ */
+class TailSampler {
+public:
+  enum class Decision { Buffered, Exported, RateLimited };
+
+  typedef std::function<void(const Span& span)> ExportCb;
+
+  TailSampler(const TailSamplingConfig& config, TailSamplingLimiter& limiter,
+              MonotonicTimeSource& time_source);
+
+  /**
+   * Decide what to do with a completed span.
+   *
+   * @param span The completed span.
+   * @param export_cb Called for every span to export, oldest first and the given span last.
+   *
+   * @return the decision taken for the span.
+   */
+  Decision addSpan(const Span& span, const ExportCb& export_cb);
+
+private:
+  struct Slot {
+    Span span_;
+    bool live_{};
+  };
+
+  bool breached(const Span& span);
+
+  const int64_t latency_threshold_us_;
+  TailSamplingLimiter& limiter_;
+  MonotonicTimeSource& time_source_;
+  std::vector<Slot> slots_;
+  uint64_t next_slot_{};
+};
+
+typedef std::unique_ptr<TailSampler> TailSamplerPtr;
+
+} // Zipkin
+} // Envoy
@@ -0,0 +1,60 @@
+#include "common/tracing/zipkin/thrift_writer.h"
+
+namespace Envoy {
+namespace Zipkin {
+
+void ThriftWriter::writeFieldBegin(Type type, int16_t id) {
+  const uint8_t header[] = {static_cast<uint8_t>(type), static_cast<uint8_t>(id >> 8),
+                            static_cast<uint8_t>(id)};
+  buffer_.add(header, sizeof(header));
+}
+
+void ThriftWriter::writeFieldStop() {
+  const uint8_t stop = static_cast<uint8_t>(Type::Stop);
+  buffer_.add(&stop, sizeof(stop));
+}
+
+void ThriftWriter::writeListBegin(Type element_type, uint32_t size) {
+  const uint8_t type = static_cast<uint8_t>(element_type);
+  buffer_.add(&type, sizeof(type));
+  writeI32(size);
+}
+
+void ThriftWriter::writeBool(bool value) {
+  const uint8_t byte = value ? 1 : 0;
+  buffer_.add(&byte, sizeof(byte));
+}
+
+void ThriftWriter::writeI16(int16_t value) {
+  const uint16_t v = value;
+  const uint8_t bytes[] = {static_cast<uint8_t>(v >> 8), static_cast<uint8_t>(v)};
+  buffer_.add(bytes, sizeof(bytes));
+}
+
+void ThriftWriter::writeI32(int32_t value) {
+  const uint32_t v = value;
+  const uint8_t bytes[] = {static_cast<uint8_t>(v >> 24), static_cast<uint8_t>(v >> 16),
+                           static_cast<uint8_t>(v >> 8), static_cast<uint8_t>(v)};
+  buffer_.add(bytes, sizeof(bytes));
+}
+
+void ThriftWriter::writeI64(int64_t value) {
+  const uint64_t v = value;
+  uint8_t bytes[8];
+  for (int i = 0; i < 8; i++) {
+    bytes[i] = static_cast<uint8_t>(v >> (56 - 8 * i));
+  }
+  buffer_.add(bytes, sizeof(bytes));
+}
+
+void ThriftWriter::writeString(const std::string& value) {
+  writeBinary(value.data(), value.size());
+}
+
+void ThriftWriter::writeBinary(const void* data, uint32_t size) {
+  writeI32(size);
+  buffer_.add(data, size);
+}
+
+} // Zipkin
+} // Envoy
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "envoy/buffer/buffer.h"
+
+namespace Envoy {
+namespace Zipkin {
+
+/**
+ * Writes values in the Thrift binary protocol directly into a buffer. Zipkin collectors accept a
+ * list of spans encoded this way with the application/x-thrift content type.
+ */
+class ThriftWriter {
+public:
+  /**
+   * Thrift type identifiers.
+   */
+  enum class Type : uint8_t {
+    Stop = 0,
+    Bool = 2,
+    I16 = 6,
+    I32 = 8,
+    I64 = 10,
+    String = 11,
+    Struct = 12,
+    List = 15
+  };
+
+  ThriftWriter(Buffer::Instance& buffer) : buffer_(buffer) {}
+
+  /**
+   * Write the header of a struct field. It must be followed by the value of the field.
+   */
+  void writeFieldBegin(Type type, int16_t id);
+
+  /**
+   * Write the marker that ends a struct.
+   */
+  void writeFieldStop();
+
+  /**
+   * Write the header of a list. It must be followed by size values of element_type.
+   */
+  void writeListBegin(Type element_type, uint32_t size);
+
+  void writeBool(bool value);
+  void writeI16(int16_t value);
+  void writeI32(int32_t value);
+  void writeI64(int64_t value);
+  void writeString(const std::string& value);
+  void writeBinary(const void* data, uint32_t size);
+
+private:
+  Buffer::Instance& buffer_;
+};
+
+} // Zipkin
+} // Envoy
@@ -37,6 +37,9 @@ public:
   const std::string ALWAYS_SAMPLE = "1";
 
   const std::string DEFAULT_COLLECTOR_ENDPOINT = "/api/v1/spans";
+
+  const std::string JSON_CONTENT_TYPE = "application/json";
+  const std::string THRIFT_CONTENT_TYPE = "application/x-thrift";
 };
 
 typedef ConstSingleton<ZipkinCoreConstantValues> ZipkinCoreConstants;
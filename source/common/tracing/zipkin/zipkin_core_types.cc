@@ -1,5 +1,9 @@
 #include "common/tracing/zipkin/zipkin_core_types.h"
 
+#include <arpa/inet.h>
+
+#include <array>
+
 #include "common/common/utility.h"
 #include "common/tracing/zipkin/span_context.h"
 #include "common/tracing/zipkin/util.h"
@@ -25,7 +29,7 @@ Endpoint& Endpoint::operator=(const Endpoint& ep) {
   return *this;
 }
 
-const std::string Endpoint::toJson() {
+const std::string Endpoint::toJson() const {
   rapidjson::StringBuffer s;
   rapidjson::Writer<rapidjson::StringBuffer> writer(s);
   writer.StartObject();
@@ -54,6 +58,30 @@ const std::string Endpoint::toJson() {
   return json_string;
 }
 
+void Endpoint::toThrift(ThriftWriter& writer) const {
+  int32_t ipv4 = 0;
+  uint16_t port = 0;
+  if (address_) {
+    port = address_->ip()->port();
+    if (address_->ip()->version() == Network::Address::IpVersion::v4) {
+      ipv4 = ntohl(address_->ip()->ipv4()->address());
+    }
+  }
+
+  writer.writeFieldBegin(ThriftWriter::Type::I32, 1);
+  writer.writeI32(ipv4);
+  writer.writeFieldBegin(ThriftWriter::Type::I16, 2);
+  writer.writeI16(port);
+  writer.writeFieldBegin(ThriftWriter::Type::String, 3);
+  writer.writeString(service_name_);
+  if (address_ && address_->ip()->version() == Network::Address::IpVersion::v6) {
+    const std::array<uint8_t, 16> ipv6 = address_->ip()->ipv6()->address();
+    writer.writeFieldBegin(ThriftWriter::Type::String, 4);
+    writer.writeBinary(ipv6.data(), ipv6.size());
+  }
+  writer.writeFieldStop();
+}
+
 Annotation::Annotation(const Annotation& ann) {
   timestamp_ = ann.timestamp();
   value_ = ann.value();
@@ -78,7 +106,7 @@ void Annotation::changeEndpointServiceName(const std::string& service_name) {
   }
 }
 
-const std::string Annotation::toJson() {
+const std::string Annotation::toJson() const {
   rapidjson::StringBuffer s;
   rapidjson::Writer<rapidjson::StringBuffer> writer(s);
   writer.StartObject();
@@ -91,13 +119,25 @@ const std::string Annotation::toJson() {
   std::string json_string = s.GetString();
 
   if (endpoint_.valid()) {
-    Util::mergeJsons(json_string, static_cast<Endpoint>(endpoint_.value()).toJson(),
+    Util::mergeJsons(json_string, endpoint_.value().toJson(),
                      ZipkinJsonFieldNames::get().ANNOTATION_ENDPOINT.c_str());
   }
 
   return json_string;
 }
 
+void Annotation::toThrift(ThriftWriter& writer) const {
+  writer.writeFieldBegin(ThriftWriter::Type::I64, 1);
+  writer.writeI64(timestamp_);
+  writer.writeFieldBegin(ThriftWriter::Type::String, 2);
+  writer.writeString(value_);
+  if (endpoint_.valid()) {
+    writer.writeFieldBegin(ThriftWriter::Type::Struct, 3);
+    endpoint_.value().toThrift(writer);
+  }
+  writer.writeFieldStop();
+}
+
 BinaryAnnotation::BinaryAnnotation(const BinaryAnnotation& ann) {
   key_ = ann.key();
   value_ = ann.value();
@@ -118,7 +158,7 @@ BinaryAnnotation& BinaryAnnotation::operator=(const BinaryAnnotation& ann) {
   return *this;
 }
 
-const std::string BinaryAnnotation::toJson() {
+const std::string BinaryAnnotation::toJson() const {
   rapidjson::StringBuffer s;
   rapidjson::Writer<rapidjson::StringBuffer> writer(s);
   writer.StartObject();
@@ -131,13 +171,31 @@ const std::string BinaryAnnotation::toJson() {
   std::string json_string = s.GetString();
 
   if (endpoint_.valid()) {
-    Util::mergeJsons(json_string, static_cast<Endpoint>(endpoint_.value()).toJson(),
+    Util::mergeJsons(json_string, endpoint_.value().toJson(),
                      ZipkinJsonFieldNames::get().BINARY_ANNOTATION_ENDPOINT.c_str());
   }
 
   return json_string;
 }
 
+void BinaryAnnotation::toThrift(ThriftWriter& writer) const {
+  // Values of the AnnotationType enum of the Zipkin Thrift IDL.
+  const int32_t THRIFT_BOOL = 0;
+  const int32_t THRIFT_STRING = 6;
+
+  writer.writeFieldBegin(ThriftWriter::Type::String, 1);
+  writer.writeString(key_);
+  writer.writeFieldBegin(ThriftWriter::Type::String, 2);
+  writer.writeString(value_);
+  writer.writeFieldBegin(ThriftWriter::Type::I32, 3);
+  writer.writeI32(annotation_type_ == BOOL ? THRIFT_BOOL : THRIFT_STRING);
+  if (endpoint_.valid()) {
+    writer.writeFieldBegin(ThriftWriter::Type::Struct, 4);
+    endpoint_.value().toThrift(writer);
+  }
+  writer.writeFieldStop();
+}
+
 const std::string Span::EMPTY_HEX_STRING_ = "0000000000000000";
 
 Span::Span(const Span& span) {
@@ -160,6 +218,7 @@ Span::Span(const Span& span) {
     trace_id_high_ = span.traceIdHigh();
   }
   monotonic_start_time_ = span.startTime();
+  error_ = span.error();
   tracer_ = span.tracer();
 }
 
@@ -169,7 +228,7 @@ void Span::setServiceName(const std::string& service_name) {
   }
 }
 
-const std::string Span::toJson() {
+const std::string Span::toJson() const {
   rapidjson::StringBuffer s;
   rapidjson::Writer<rapidjson::StringBuffer> writer(s);
   writer.StartObject();
@@ -217,6 +276,54 @@ const std::string Span::toJson() {
   return json_string;
 }
 
+void Span::toThrift(ThriftWriter& writer) const {
+  writer.writeFieldBegin(ThriftWriter::Type::I64, 1);
+  writer.writeI64(trace_id_);
+  writer.writeFieldBegin(ThriftWriter::Type::String, 3);
+  writer.writeString(name_);
+  writer.writeFieldBegin(ThriftWriter::Type::I64, 4);
+  writer.writeI64(id_);
+
+  if (parent_id_.valid() && parent_id_.value()) {
+    writer.writeFieldBegin(ThriftWriter::Type::I64, 5);
+    writer.writeI64(parent_id_.value());
+  }
+
+  writer.writeFieldBegin(ThriftWriter::Type::List, 6);
+  writer.writeListBegin(ThriftWriter::Type::Struct, annotations_.size());
+  for (const Annotation& annotation : annotations_) {
+    annotation.toThrift(writer);
+  }
+
+  writer.writeFieldBegin(ThriftWriter::Type::List, 8);
+  writer.writeListBegin(ThriftWriter::Type::Struct, binary_annotations_.size());
+  for (const BinaryAnnotation& binary_annotation : binary_annotations_) {
+    binary_annotation.toThrift(writer);
+  }
+
+  if (debug_) {
+    writer.writeFieldBegin(ThriftWriter::Type::Bool, 9);
+    writer.writeBool(true);
+  }
+
+  if (timestamp_.valid()) {
+    writer.writeFieldBegin(ThriftWriter::Type::I64, 10);
+    writer.writeI64(timestamp_.value());
+  }
+
+  if (duration_.valid()) {
+    writer.writeFieldBegin(ThriftWriter::Type::I64, 11);
+    writer.writeI64(duration_.value());
+  }
+
+  if (trace_id_high_.valid()) {
+    writer.writeFieldBegin(ThriftWriter::Type::I64, 12);
+    writer.writeI64(trace_id_high_.value());
+  }
+
+  writer.writeFieldStop();
+}
+
 void Span::finish() {
   // Assumption: Span will have only one annotation when this method is called
   SpanContext context(*this);
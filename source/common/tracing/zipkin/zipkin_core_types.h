@@ -7,6 +7,7 @@
 #include "envoy/network/address.h"
 
 #include "common/common/hex.h"
+#include "common/tracing/zipkin/thrift_writer.h"
 #include "common/tracing/zipkin/tracer_interface.h"
 #include "common/tracing/zipkin/util.h"
 
@@ -28,7 +29,15 @@ public:
    * All classes defining Zipkin abstractions need to implement this method to convert
    * the corresponding abstraction to a Zipkin-compliant JSON.
    */
-  virtual const std::string toJson() PURE;
+  virtual const std::string toJson() const PURE;
+
+  /**
+   * All classes defining Zipkin abstractions need to implement this method to write
+   * the corresponding abstraction as a Zipkin-compliant Thrift struct.
+   *
+   * @param writer The writer that encodes the struct.
+   */
+  virtual void toThrift(ThriftWriter& writer) const PURE;
 };
 
 /**
@@ -86,7 +95,14 @@ public:
    *
    * @return a stringified JSON.
    */
-  const std::string toJson() override;
+  const std::string toJson() const override;
+
+  /**
+   * Writes the endpoint as a Zipkin-compliant Thrift struct.
+   *
+   * @param writer The writer that encodes the struct.
+   */
+  void toThrift(ThriftWriter& writer) const override;
 
 private:
   std::string service_name_;
@@ -178,7 +194,14 @@ public:
    *
    * @return a stringified JSON.
    */
-  const std::string toJson() override;
+  const std::string toJson() const override;
+
+  /**
+   * Writes the annotation as a Zipkin-compliant Thrift struct.
+   *
+   * @param writer The writer that encodes the struct.
+   */
+  void toThrift(ThriftWriter& writer) const override;
 
 private:
   uint64_t timestamp_;
@@ -277,7 +300,14 @@ public:
    *
    * @return a stringified JSON.
    */
-  const std::string toJson() override;
+  const std::string toJson() const override;
+
+  /**
+   * Writes the binary annotation as a Zipkin-compliant Thrift struct.
+   *
+   * @param writer The writer that encodes the struct.
+   */
+  void toThrift(ThriftWriter& writer) const override;
 
 private:
   std::string key_;
@@ -302,7 +332,8 @@ public:
    * Default constructor. Creates an empty span.
    */
   Span()
-      : trace_id_(0), name_(), id_(0), debug_(false), monotonic_start_time_(0), tracer_(nullptr) {}
+      : trace_id_(0), name_(), id_(0), debug_(false), monotonic_start_time_(0), error_(false),
+        tracer_(nullptr) {}
 
   /**
    * Sets the span's trace id attribute.
@@ -405,6 +436,12 @@ public:
    */
   void setStartTime(const int64_t time) { monotonic_start_time_ = time; }
 
+  /**
+   * Marks the span as failed. This is local state used for sampling decisions and is not sent
+   * to Zipkin.
+   */
+  void setError() { error_ = true; }
+
   /**
    * @return the span's annotations.
    */
@@ -477,6 +514,11 @@ public:
    */
   int64_t startTime() const { return monotonic_start_time_; }
 
+  /**
+   * @return whether or not the span was marked as failed.
+   */
+  bool error() const { return error_; }
+
   /**
    * Replaces the service-name attribute of the span's basic annotations with the provided value.
    *
@@ -494,7 +536,15 @@ public:
     *
     * @return a stringified JSON.
     */
-  const std::string toJson() override;
+  const std::string toJson() const override;
+
+  /**
+   * Writes the span as a Zipkin-compliant Thrift struct. A list of spans encoded this way can be
+   * sent to Zipkin with the application/x-thrift content type.
+   *
+   * @param writer The writer that encodes the struct.
+   */
+  void toThrift(ThriftWriter& writer) const override;
 
   /**
    * Associates a Tracer object with the span. The tracer's reportSpan() method is invoked
@@ -541,6 +591,7 @@ private:
   Optional<int64_t> duration_;
   Optional<uint64_t> trace_id_high_;
   int64_t monotonic_start_time_;
+  bool error_;
   TracerInterface* tracer_;
 };
 } // Zipkin
@@ -1,6 +1,8 @@
 #include "common/tracing/zipkin/zipkin_tracer_impl.h"
 
 #include "common/common/enum_to_int.h"
+#include "common/common/hex.h"
+#include "common/common/utility.h"
 #include "common/http/headers.h"
 #include "common/http/message_impl.h"
 #include "common/http/utility.h"
@@ -17,19 +19,31 @@ ZipkinSpan::ZipkinSpan(Zipkin::Span& span, Zipkin::Tracer& tracer) : span_(span)
 void ZipkinSpan::finishSpan() { span_.finish(); }
 
 void ZipkinSpan::setTag(const std::string& name, const std::string& value) {
+  if (name == ZipkinCoreConstants::get().ERROR && value == "true") {
+    // Recorded regardless of the annotations so that tail sampling sees failed server spans too.
+    span_.setError();
+  }
+
   if (this->hasCSAnnotation()) {
     span_.setTag(name, value);
   }
 }
 
 void ZipkinSpan::injectContext(Http::HeaderMap& request_headers) {
+  // The ids are formatted on the stack and copied into the headers' inline storage, so injecting
+  // the context does not allocate.
+  char hex_id[16];
+
   // Set the trace-id and span-id headers properly, based on the newly-created span structure.
-  request_headers.insertXB3TraceId().value(span_.traceIdAsHexString());
-  request_headers.insertXB3SpanId().value(span_.idAsHexString());
+  Hex::uint64ToHex(span_.traceId(), hex_id);
+  request_headers.insertXB3TraceId().value().setCopy(hex_id, sizeof(hex_id));
+  Hex::uint64ToHex(span_.id(), hex_id);
+  request_headers.insertXB3SpanId().value().setCopy(hex_id, sizeof(hex_id));
 
   // Set the parent-span header properly, based on the newly-created span structure.
   if (span_.isSetParentId()) {
-    request_headers.insertXB3ParentSpanId().value(span_.parentIdAsHexString());
+    Hex::uint64ToHex(span_.parentId(), hex_id);
+    request_headers.insertXB3ParentSpanId().value().setCopy(hex_id, sizeof(hex_id));
   }
 
   // Set the sampled header.
@@ -37,7 +51,9 @@ void ZipkinSpan::injectContext(Http::HeaderMap& request_headers) {
 
   // Set the ot-span-context header with the new context.
   SpanContext context(span_);
-  request_headers.insertOtSpanContext().value(context.serializeToString());
+  char serialized_context[SpanContext::MAX_SERIALIZED_LENGTH];
+  request_headers.insertOtSpanContext().value().setCopy(serialized_context,
+                                                        context.serializeTo(serialized_context));
 }
 
 Tracing::SpanPtr ZipkinSpan::spawnChild(const std::string& name, SystemTime start_time) {
@@ -46,7 +62,7 @@ Tracing::SpanPtr ZipkinSpan::spawnChild(const std::string& name, SystemTime star
 }
 
 bool ZipkinSpan::hasCSAnnotation() {
-  auto annotations = span_.annotations();
+  const std::vector<Annotation>& annotations = span_.annotations();
   if (annotations.size() > 0) {
     // We currently expect only one annotation to be in the span when this function is called.
     return annotations[0].value() == ZipkinCoreConstants::get().CLIENT_SEND;
@@ -73,13 +89,34 @@ Driver::Driver(const Json::Object& config, Upstream::ClusterManager& cluster_man
 
   const std::string collector_endpoint =
       config.getString("collector_endpoint", ZipkinCoreConstants::get().DEFAULT_COLLECTOR_ENDPOINT);
+  const SpanEncoding encoding = config.getString("collector_encoding", "json") == "thrift"
+                                    ? SpanEncoding::Thrift
+                                    : SpanEncoding::Json;
+
+  Optional<TailSamplingConfig> tail_sampling;
+  if (config.hasObject("tail_sampling")) {
+    Json::ObjectSharedPtr tail_sampling_config = config.getObject("tail_sampling");
+    tail_sampling.value(
+        {std::chrono::milliseconds(tail_sampling_config->getInteger("latency_threshold_ms")),
+         static_cast<uint64_t>(tail_sampling_config->getInteger("max_buffered_spans", 1000)),
+         static_cast<uint64_t>(tail_sampling_config->getInteger("max_exports_per_second", 100))});
+    tail_sampling_limiter_.reset(new TailSamplingLimiter(
+        tail_sampling.value().max_exports_per_second_, ProdMonotonicTimeSource::instance_));
+  }
 
-  tls_.set(tls_slot_, [this, collector_endpoint, &random_generator](Event::Dispatcher& dispatcher)
-                          -> ThreadLocal::ThreadLocalObjectSharedPtr {
+  tls_.set(tls_slot_, [this, collector_endpoint, encoding, tail_sampling, &random_generator](
+                          Event::Dispatcher& dispatcher) -> ThreadLocal::ThreadLocalObjectSharedPtr {
                             TracerPtr tracer(new Tracer(local_info_.clusterName(),
                                                         local_info_.address(), random_generator));
+                            TailSamplerPtr tail_sampler;
+                            if (tail_sampling.valid()) {
+                              tail_sampler.reset(new TailSampler(
+                                  tail_sampling.value(), *tail_sampling_limiter_,
+                                  ProdMonotonicTimeSource::instance_));
+                            }
                             tracer->setReporter(ReporterImpl::NewInstance(
-                                std::ref(*this), std::ref(dispatcher), collector_endpoint));
+                                std::ref(*this), std::ref(dispatcher), collector_endpoint,
+                                encoding, std::move(tail_sampler)));
                             return ThreadLocal::ThreadLocalObjectSharedPtr{
                                 new TlsTracer(std::move(tracer), *this)};
                           });
@@ -97,7 +134,8 @@ Tracing::SpanPtr Driver::startSpan(Http::HeaderMap& request_headers, const std::
     // properly set the span id and the parent span id.
     SpanContext context;
 
-    context.populateFromString(request_headers.OtSpanContext()->value().c_str());
+    const Http::HeaderString& span_context = request_headers.OtSpanContext()->value();
+    context.populateFromString(span_context.c_str(), span_context.size());
 
     // Create either a child or a shared-context Zipkin span.
     //
@@ -122,8 +160,10 @@ Tracing::SpanPtr Driver::startSpan(Http::HeaderMap& request_headers, const std::
 }
 
 ReporterImpl::ReporterImpl(Driver& driver, Event::Dispatcher& dispatcher,
-                           const std::string& collector_endpoint)
-    : driver_(driver), collector_endpoint_(collector_endpoint) {
+                           const std::string& collector_endpoint, SpanEncoding encoding,
+                           TailSamplerPtr&& tail_sampler)
+    : driver_(driver), span_buffer_(0, encoding), tail_sampler_(std::move(tail_sampler)),
+      collector_endpoint_(collector_endpoint) {
   flush_timer_ = dispatcher.createTimer([this]() -> void {
     driver_.tracerStats().timer_flushed_.inc();
     flushSpans();
@@ -138,18 +178,39 @@ ReporterImpl::ReporterImpl(Driver& driver, Event::Dispatcher& dispatcher,
 }
 
 ReporterPtr ReporterImpl::NewInstance(Driver& driver, Event::Dispatcher& dispatcher,
-                                      const std::string& collector_endpoint) {
-  return ReporterPtr(new ReporterImpl(driver, dispatcher, collector_endpoint));
+                                      const std::string& collector_endpoint,
+                                      SpanEncoding encoding, TailSamplerPtr&& tail_sampler) {
+  return ReporterPtr(new ReporterImpl(driver, dispatcher, collector_endpoint, encoding,
+                                      std::move(tail_sampler)));
 }
 
-// TODO(fabolive): Need to avoid the copy to improve performance.
 void ReporterImpl::reportSpan(const Span& span) {
-  span_buffer_.addSpan(span);
+  if (!tail_sampler_) {
+    bufferSpan(span);
+    return;
+  }
+
+  switch (tail_sampler_->addSpan(span, [this](const Span& exported) { bufferSpan(exported); })) {
+  case TailSampler::Decision::Buffered:
+    break;
+  case TailSampler::Decision::Exported:
+    driver_.tracerStats().tail_sampling_exported_.inc();
+    break;
+  case TailSampler::Decision::RateLimited:
+    driver_.tracerStats().tail_sampling_rate_limited_.inc();
+    break;
+  }
+}
+
+void ReporterImpl::bufferSpan(const Span& span) {
+  if (!span_buffer_.addSpan(span)) {
+    driver_.tracerStats().spans_dropped_.inc();
+  }
 
   const uint64_t min_flush_spans =
       driver_.runtime().snapshot().getInteger("tracing.zipkin.min_flush_spans", 5U);
 
-  if (span_buffer_.pendingSpans() == min_flush_spans) {
+  if (span_buffer_.pendingSpans() >= min_flush_spans) {
     flushSpans();
   }
 }
@@ -162,34 +223,46 @@ void ReporterImpl::enableTimer() {
 
 void ReporterImpl::flushSpans() {
   if (span_buffer_.pendingSpans()) {
+    const uint64_t max_pending_reports =
+        driver_.runtime().snapshot().getInteger("tracing.zipkin.max_pending_reports", 10U);
+    if (pending_reports_ >= max_pending_reports) {
+      // The collector is not keeping up. Drop the batch rather than queueing more requests.
+      driver_.tracerStats().spans_dropped_.add(span_buffer_.pendingSpans());
+      span_buffer_.clear();
+      return;
+    }
+
     driver_.tracerStats().spans_sent_.add(span_buffer_.pendingSpans());
 
-    const std::string request_body = span_buffer_.toStringifiedJsonArray();
     Http::MessagePtr message(new Http::RequestMessageImpl());
     message->headers().insertMethod().value(Http::Headers::get().MethodValues.Post);
     message->headers().insertPath().value(collector_endpoint_);
     message->headers().insertHost().value(driver_.cluster()->name());
-    message->headers().insertContentType().value(std::string("application/json"));
+    message->headers().insertContentType().value(
+        span_buffer_.encoding() == SpanEncoding::Thrift
+            ? ZipkinCoreConstants::get().THRIFT_CONTENT_TYPE
+            : ZipkinCoreConstants::get().JSON_CONTENT_TYPE);
 
     Buffer::InstancePtr body(new Buffer::OwnedImpl());
-    body->add(request_body);
+    span_buffer_.moveTo(*body);
     message->body() = std::move(body);
 
     const uint64_t timeout =
         driver_.runtime().snapshot().getInteger("tracing.zipkin.request_timeout", 5000U);
+    pending_reports_++;
     driver_.clusterManager()
         .httpAsyncClientForCluster(driver_.cluster()->name())
         .send(std::move(message), *this, std::chrono::milliseconds(timeout));
-
-    span_buffer_.clear();
   }
 }
 
 void ReporterImpl::onFailure(Http::AsyncClient::FailureReason) {
+  pending_reports_--;
   driver_.tracerStats().reports_failed_.inc();
 }
 
 void ReporterImpl::onSuccess(Http::MessagePtr&& http_response) {
+  pending_reports_--;
   if (Http::Utility::getResponseStatus(http_response->headers()) !=
       enumToInt(Http::Code::Accepted)) {
     driver_.tracerStats().reports_dropped_.inc();
@@ -9,6 +9,7 @@
 #include "common/http/header_map_impl.h"
 #include "common/json/json_loader.h"
 #include "common/tracing/zipkin/span_buffer.h"
+#include "common/tracing/zipkin/tail_sampler.h"
 #include "common/tracing/zipkin/tracer.h"
 
 namespace Envoy {
@@ -16,10 +17,13 @@ namespace Zipkin {
 
 #define ZIPKIN_TRACER_STATS(COUNTER)                                                               \
   COUNTER(spans_sent)                                                                              \
+  COUNTER(spans_dropped)                                                                           \
   COUNTER(timer_flushed)                                                                           \
   COUNTER(reports_sent)                                                                            \
   COUNTER(reports_dropped)                                                                         \
-  COUNTER(reports_failed)
+  COUNTER(reports_failed)                                                                          \
+  COUNTER(tail_sampling_exported)                                                                  \
+  COUNTER(tail_sampling_rate_limited)
 
 struct ZipkinTracerStats {
   ZIPKIN_TRACER_STATS(GENERATE_COUNTER_STRUCT)
@@ -130,12 +134,14 @@ private:
   Runtime::Loader& runtime_;
   const LocalInfo::LocalInfo& local_info_;
   const uint32_t tls_slot_;
+  // Shared by the tail samplers of all workers. Null unless tail sampling is configured.
+  std::unique_ptr<TailSamplingLimiter> tail_sampling_limiter_;
 };
 
 /**
  * This class derives from the abstract Zipkin::Reporter.
  * It buffers spans and relies on Http::AsyncClient to send spans to
- * Zipkin using JSON over HTTP.
+ * Zipkin using JSON or Thrift over HTTP.
  *
  * Two runtime parameters control the span buffering/flushing behavior, namely:
  * tracing.zipkin.min_flush_spans and tracing.zipkin.flush_interval_ms.
@@ -144,7 +150,13 @@ private:
  * either when the buffer is full, or when a timer, set to `tracing.zipkin.flush_interval_ms`,
  * expires, whichever happens first.
  *
- * The default values for the runtime parameters are 5 spans and 5000ms.
+ * At most `tracing.zipkin.max_pending_reports` requests are outstanding at a time. Spans that
+ * arrive while the buffer is full, or batches flushed while that many requests are outstanding,
+ * are dropped and counted in the spans_dropped stat.
+ *
+ * The default values for the runtime parameters are 5 spans, 5000ms and 10 requests.
+ *
+ * If a tail sampler is given, only the spans it decides to export are buffered.
  */
 class ReporterImpl : public Reporter, Http::AsyncClient::Callbacks {
 public:
@@ -156,9 +168,12 @@ public:
    * @param collector_endpoint String representing the Zipkin endpoint to be used
    * when making HTTP POST requests carrying spans. This value comes from the
    * Zipkin-related tracing configuration.
+   * @param encoding The encoding of the spans sent to Zipkin.
+   * @param tail_sampler Decides which completed spans are sent, or null to send all of them.
    */
   ReporterImpl(Driver& driver, Event::Dispatcher& dispatcher,
-               const std::string& collector_endpoint);
+               const std::string& collector_endpoint, SpanEncoding encoding,
+               TailSamplerPtr&& tail_sampler);
 
   /**
    * Implementation of Zipkin::Reporter::reportSpan().
@@ -182,11 +197,14 @@ public:
    * @param collector_endpoint String representing the Zipkin endpoint to be used
    * when making HTTP POST requests carrying spans. This value comes from the
    * Zipkin-related tracing configuration.
+   * @param encoding The encoding of the spans sent to Zipkin.
+   * @param tail_sampler Decides which completed spans are sent, or null to send all of them.
    *
    * @return Pointer to the newly-created ZipkinReporter.
    */
   static ReporterPtr NewInstance(Driver& driver, Event::Dispatcher& dispatcher,
-                                 const std::string& collector_endpoint);
+                                 const std::string& collector_endpoint, SpanEncoding encoding,
+                                 TailSamplerPtr&& tail_sampler = nullptr);
 
 private:
   /**
@@ -194,6 +212,11 @@ private:
    */
   void enableTimer();
 
+  /**
+   * Adds the span to the span buffer and calls flushSpans() if the buffer is full.
+   */
+  void bufferSpan(const Span& span);
+
   /**
    * Removes all spans from the span buffer and sends them to Zipkin using Http::AsyncClient.
    */
@@ -202,7 +225,9 @@ private:
   Driver& driver_;
   Event::TimerPtr flush_timer_;
   SpanBuffer span_buffer_;
+  TailSamplerPtr tail_sampler_;
   const std::string collector_endpoint_;
+  uint64_t pending_reports_{};
 };
 } // Zipkin
 } // Envoy
@@ -0,0 +1,49 @@
+#include "common/upstream/alias_table.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "common/common/assert.h"
+
+namespace Envoy {
+namespace Upstream {
+
+const uint64_t AliasTable::Scale;
+
+AliasTable::AliasTable(const std::vector<uint64_t>& weights)
+    : prob_(weights.size(), Scale), alias_(weights.size()) {
+  // Scale the weights so that their average is Scale, then pair each under full column with an
+  // over full one that donates the rest of the column.
+  const size_t size = weights.size();
+  uint64_t total_weight = 0;
+  for (uint64_t weight : weights) {
+    total_weight += weight;
+  }
+  ASSERT(total_weight > 0);
+
+  std::vector<uint64_t> scaled(size);
+  std::vector<uint32_t> small;
+  std::vector<uint32_t> large;
+  for (size_t i = 0; i < size; ++i) {
+    alias_[i] = i;
+    scaled[i] = weights[i] * size * Scale / total_weight;
+    (scaled[i] < Scale ? small : large).push_back(i);
+  }
+
+  while (!small.empty() && !large.empty()) {
+    const uint32_t under = small.back();
+    small.pop_back();
+    const uint32_t over = large.back();
+    large.pop_back();
+
+    prob_[under] = scaled[under];
+    alias_[under] = over;
+    scaled[over] -= Scale - scaled[under];
+    (scaled[over] < Scale ? small : large).push_back(over);
+  }
+
+  // Whatever is left is full up to integer rounding and keeps its own column.
+}
+
+} // Upstream
+} // Envoy
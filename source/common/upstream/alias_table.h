@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Envoy {
+namespace Upstream {
+
+/**
+ * Alias table built with Vose's method. It samples an index in proportion to its weight in constant
+ * time: the random value picks a column and a coin within it, and the column either keeps its own
+ * index or gives way to its alias. Building the table is O(N) in the number of weights.
+ */
+class AliasTable {
+public:
+  // Resolution of the per column probabilities.
+  static const uint64_t Scale = 10000;
+
+  AliasTable() {}
+
+  /**
+   * @param weights supplies the weight of each index. At least one weight must be non zero.
+   */
+  explicit AliasTable(const std::vector<uint64_t>& weights);
+
+  /**
+   * @param random supplies a uniformly distributed random value. The low part selects the column
+   *        and the high part the coin, so the value must cover more than size() * Scale values.
+   * @return the sampled index.
+   */
+  uint32_t pick(uint64_t random) const {
+    const uint64_t column = random % alias_.size();
+    const uint64_t coin = (random / alias_.size()) % Scale;
+    return coin < prob_[column] ? column : alias_[column];
+  }
+
+  /**
+   * @return the number of indices in the table. 0 if the table has not been built.
+   */
+  size_t size() const { return alias_.size(); }
+
+private:
+  std::vector<uint64_t> prob_;
+  std::vector<uint32_t> alias_;
+};
+
+} // Upstream
+} // Envoy
@@ -5,7 +5,10 @@
 #include <vector>
 
 #include "common/common/assert.h"
+#include "common/common/enum_to_int.h"
 #include "common/http/headers.h"
+#include "common/http/message_impl.h"
+#include "common/http/utility.h"
 #include "common/json/config_schemas.h"
 #include "common/json/json_loader.h"
 
@@ -29,14 +32,101 @@ CdsApiImpl::CdsApiImpl(const Json::Object& config, ClusterManager& cm,
                        Event::Dispatcher& dispatcher, Runtime::RandomGenerator& random,
                        const LocalInfo::LocalInfo& local_info, Stats::Scope& scope)
     : RestApiFetcher(cm, config.getObject("cluster")->getString("name"), dispatcher, random,
-                     std::chrono::milliseconds(config.getInteger("refresh_delay_ms", 30000))),
-      local_info_(local_info),
-      stats_({ALL_CDS_STATS(POOL_COUNTER_PREFIX(scope, "cluster_manager.cds."))}) {
+                     std::chrono::milliseconds(config.getInteger("refresh_delay_ms", 30000)),
+                     apiType(config.getString("api_type", "rest")), scope,
+                     "cluster_manager.cds.", config.getString("snapshot_path", "")),
+      dispatcher_(dispatcher), local_info_(local_info),
+      stats_({ALL_CDS_STATS(POOL_COUNTER_PREFIX(scope, "cluster_manager.cds."))}),
+      on_demand_(config.getBoolean("on_demand", false)) {
   if (local_info.clusterName().empty() || local_info.nodeName().empty()) {
     throw EnvoyException("cds: setting --service-cluster and --service-node are required");
   }
 }
 
+CdsApiImpl::~CdsApiImpl() {
+  for (auto& request : on_demand_requests_) {
+    request.second->request_->cancel();
+  }
+}
+
+bool CdsApiImpl::requestCluster(const std::string& cluster) {
+  if (!on_demand_) {
+    return false;
+  }
+
+  dispatcher_.post([this, cluster]() -> void { startOnDemandRequest(cluster); });
+  return true;
+}
+
+void CdsApiImpl::startOnDemandRequest(const std::string& cluster) {
+  OnDemandRequestPtr& request = on_demand_requests_[cluster];
+  if (request) {
+    return;
+  }
+
+  log_debug("cds: starting on demand request for cluster '{}'", cluster);
+  stats_.on_demand_attempt_.inc();
+  request.reset(new OnDemandRequest(*this, cluster));
+  Http::MessagePtr message(new Http::RequestMessageImpl());
+  message->headers().insertMethod().value(Http::Headers::get().MethodValues.Get);
+  message->headers().insertPath().value(fmt::format(
+      "/v1/clusters/{}/{}/{}", local_info_.clusterName(), local_info_.nodeName(), cluster));
+  message->headers().insertHost().value(remote_cluster_name_);
+  OnDemandRequest& request_reference = *request;
+  Http::AsyncClient::Request* active_request =
+      cm_.httpAsyncClientForCluster(remote_cluster_name_)
+          .send(std::move(message), request_reference,
+                Optional<std::chrono::milliseconds>(std::chrono::milliseconds(1000)));
+  // The request may have failed inline, in which case it has already been completed.
+  if (active_request) {
+    request_reference.request_ = active_request;
+  }
+}
+
+void CdsApiImpl::OnDemandRequest::onSuccess(Http::MessagePtr&& response) {
+  request_ = nullptr;
+  const std::string cluster = cluster_;
+  try {
+    const uint64_t response_code = Http::Utility::getResponseStatus(response->headers());
+    if (response_code != enumToInt(Http::Code::OK)) {
+      throw EnvoyException(fmt::format("unexpected response code {}", response_code));
+    }
+
+    Json::ObjectSharedPtr response_json =
+        Json::Factory::loadFromString(response->bodyAsString());
+    response_json->validateSchema(Json::Schema::CDS_SCHEMA);
+    for (const Json::ObjectSharedPtr& config : response_json->getObjectArray("clusters")) {
+      const std::string name = config->getString("name");
+      parent_.on_demand_clusters_.insert(name);
+      if (parent_.cm_.addOrUpdatePrimaryCluster(*config)) {
+        parent_.log().info("cds: add/update on demand cluster '{}'", name);
+      }
+    }
+    parent_.stats_.on_demand_success_.inc();
+  } catch (const EnvoyException& e) {
+    parent_.log().warn("cds: on demand fetch of cluster '{}' failed: {}", cluster, e.what());
+    parent_.stats_.on_demand_failure_.inc();
+  }
+
+  parent_.onDemandRequestComplete(cluster);
+}
+
+void CdsApiImpl::OnDemandRequest::onFailure(Http::AsyncClient::FailureReason) {
+  request_ = nullptr;
+  const std::string cluster = cluster_;
+  parent_.log().info("cds: on demand fetch of cluster '{}' failed: network error", cluster);
+  parent_.stats_.on_demand_failure_.inc();
+  parent_.onDemandRequestComplete(cluster);
+}
+
+void CdsApiImpl::onDemandRequestComplete(const std::string& cluster) {
+  // This destroys the request.
+  on_demand_requests_.erase(cluster);
+  if (cluster_request_complete_callback_) {
+    cluster_request_complete_callback_(cluster);
+  }
+}
+
 void CdsApiImpl::createRequest(Http::Message& request) {
   log_debug("cds: starting request");
   stats_.update_attempt_.inc();
@@ -62,6 +152,10 @@ void CdsApiImpl::parseResponse(const Http::Message& response) {
   }
 
   for (auto cluster : clusters_to_remove) {
+    if (on_demand_clusters_.count(cluster.first) > 0) {
+      continue;
+    }
+
     if (cm_.removePrimaryCluster(cluster.first)) {
       log().info("cds: remove cluster '{}'", cluster.first);
     }
@@ -70,6 +164,11 @@ void CdsApiImpl::parseResponse(const Http::Message& response) {
   stats_.update_success_.inc();
 }
 
+void CdsApiImpl::onResponseUnchanged(const Http::Message&) {
+  log_debug("cds: response unchanged");
+  stats_.update_success_.inc();
+}
+
 void CdsApiImpl::onFetchComplete() {
   if (initialize_callback_) {
     initialize_callback_();
@@ -1,6 +1,10 @@
 #pragma once
 
 #include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "envoy/event/dispatcher.h"
 #include "envoy/json/json_object.h"
@@ -19,7 +23,10 @@ namespace Upstream {
 #define ALL_CDS_STATS(COUNTER)                                                                     \
   COUNTER(update_attempt)                                                                          \
   COUNTER(update_success)                                                                          \
-  COUNTER(update_failure)
+  COUNTER(update_failure)                                                                          \
+  COUNTER(on_demand_attempt)                                                                       \
+  COUNTER(on_demand_success)                                                                       \
+  COUNTER(on_demand_failure)
 // clang-format on
 
 /**
@@ -30,7 +37,9 @@ struct CdsStats {
 };
 
 /**
- * REST fetching implementation of the CDS API.
+ * REST fetching implementation of the CDS API. With on demand fetches enabled, single clusters can
+ * also be fetched when they are first needed. Clusters fetched on demand are kept when a periodic
+ * fetch does not return them.
  */
 class CdsApiImpl : public CdsApi, Http::RestApiFetcher, Logger::Loggable<Logger::Id::upstream> {
 public:
@@ -43,21 +52,55 @@ public:
   void setInitializedCb(std::function<void()> callback) override {
     initialize_callback_ = callback;
   }
+  bool requestCluster(const std::string& cluster) override;
+  void
+  setClusterRequestCompleteCb(std::function<void(const std::string& cluster)> callback) override {
+    cluster_request_complete_callback_ = callback;
+  }
 
 private:
+  /**
+   * A fetch of a single cluster.
+   */
+  struct OnDemandRequest : public Http::AsyncClient::Callbacks {
+    OnDemandRequest(CdsApiImpl& parent, const std::string& cluster)
+        : parent_(parent), cluster_(cluster) {}
+
+    // Http::AsyncClient::Callbacks
+    void onSuccess(Http::MessagePtr&& response) override;
+    void onFailure(Http::AsyncClient::FailureReason reason) override;
+
+    CdsApiImpl& parent_;
+    const std::string cluster_;
+    Http::AsyncClient::Request* request_{};
+  };
+
+  typedef std::unique_ptr<OnDemandRequest> OnDemandRequestPtr;
+
   CdsApiImpl(const Json::Object& config, ClusterManager& cm, Event::Dispatcher& dispatcher,
              Runtime::RandomGenerator& random, const LocalInfo::LocalInfo& local_info,
              Stats::Scope& scope);
+  ~CdsApiImpl();
+
+  void startOnDemandRequest(const std::string& cluster);
+  void onDemandRequestComplete(const std::string& cluster);
 
   // Http::RestApiFetcher
   void createRequest(Http::Message& request) override;
   void parseResponse(const Http::Message& response) override;
+  void onResponseUnchanged(const Http::Message& response) override;
   void onFetchComplete() override;
   void onFetchFailure(EnvoyException* e) override;
 
+  Event::Dispatcher& dispatcher_;
   const LocalInfo::LocalInfo& local_info_;
   CdsStats stats_;
   std::function<void()> initialize_callback_;
+  const bool on_demand_;
+  std::function<void(const std::string& cluster)> cluster_request_complete_callback_;
+  // Keyed by the name of the cluster that is being fetched.
+  std::unordered_map<std::string, OnDemandRequestPtr> on_demand_requests_;
+  std::unordered_set<std::string> on_demand_clusters_;
 };
 
 } // Upstream
@@ -4,13 +4,16 @@
 #include <cstdint>
 #include <functional>
 #include <list>
+#include <memory>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 #include "envoy/event/dispatcher.h"
 #include "envoy/network/dns.h"
 #include "envoy/runtime/runtime.h"
 
+#include "common/common/assert.h"
 #include "common/common/enum_to_int.h"
 #include "common/common/utility.h"
 #include "common/http/async_client_impl.h"
@@ -19,8 +22,12 @@
 #include "common/json/config_schemas.h"
 #include "common/router/shadow_writer_impl.h"
 #include "common/upstream/cds_api_impl.h"
+#include "common/upstream/dynamic_forward_proxy_cluster.h"
 #include "common/upstream/load_balancer_impl.h"
+#include "common/upstream/maglev_lb.h"
+#include "common/upstream/original_dst_cluster.h"
 #include "common/upstream/ring_hash_lb.h"
+#include "common/upstream/subset_lb.h"
 
 #include "spdlog/spdlog.h"
 
@@ -41,8 +48,8 @@ void ClusterManagerInitHelper::addCluster(Cluster& cluster) {
     secondary_init_clusters_.push_back(&cluster);
     if (started_secondary_initialize_) {
       // This can happen if we get a second CDS update that adds new clusters after we have
-      // already started secondary init. In this case, just immediately initialize.
-      cluster.initialize();
+      // already started secondary init. In this case, initialize as soon as there is room.
+      startSecondaryInitialize();
     }
   }
 
@@ -72,6 +79,7 @@ void ClusterManagerInitHelper::removeCluster(Cluster& cluster) {
   // It is possible that the cluster we are removing has already been initialized, and is not
   // present in the initializer list. If so, this is fine.
   cluster_list->remove(&cluster);
+  secondary_active_clusters_.remove(&cluster);
   log().info("cm init: removing: cluster={} primary={} secondary={}", cluster.info()->name(),
              primary_init_clusters_.size(), secondary_init_clusters_.size());
   maybeFinishInitialize();
@@ -91,21 +99,14 @@ void ClusterManagerInitHelper::maybeFinishInitialize() {
   }
 
   // If we are still waiting for secondary clusters to initialize, see if we need to first call
-  // initialize on them. This is only done once.
-  if (!secondary_init_clusters_.empty()) {
+  // initialize on them. A slot may also have been freed by a secondary cluster that completed.
+  if (!secondary_init_clusters_.empty() || !secondary_active_clusters_.empty()) {
     if (!started_secondary_initialize_) {
       log().info("cm init: initializing secondary clusters");
       started_secondary_initialize_ = true;
-      // Cluster::initialize() method can modify the list of secondary_init_clusters_ to remove
-      // the item currently being initialized, so we eschew range-based-for and do this complicated
-      // dance to increment the iterator before calling initialize.
-      for (auto iter = secondary_init_clusters_.begin(); iter != secondary_init_clusters_.end();) {
-        Cluster* cluster = *iter;
-        ++iter;
-        cluster->initialize();
-      }
     }
 
+    startSecondaryInitialize();
     return;
   }
 
@@ -124,6 +125,20 @@ void ClusterManagerInitHelper::maybeFinishInitialize() {
   }
 }
 
+void ClusterManagerInitHelper::startSecondaryInitialize() {
+  ASSERT(started_secondary_initialize_);
+  // Cluster::initialize() can complete inline and re-enter via removeCluster(), so the cluster is
+  // moved to the active list before initialize() is called and the bound is checked every pass.
+  while (!secondary_init_clusters_.empty() &&
+         (max_concurrent_secondary_init_ == 0 ||
+          secondary_active_clusters_.size() < max_concurrent_secondary_init_)) {
+    Cluster* cluster = secondary_init_clusters_.front();
+    secondary_init_clusters_.pop_front();
+    secondary_active_clusters_.push_back(cluster);
+    cluster->initialize();
+  }
+}
+
 void ClusterManagerInitHelper::onStaticLoadComplete() {
   ASSERT(state_ == State::Loading);
   state_ = State::WaitingForStaticInitialize;
@@ -160,6 +175,12 @@ ClusterManagerImpl::ClusterManagerImpl(const Json::Object& config, ClusterManage
       cm_stats_(generateStats(stats)) {
 
   config.validateSchema(Json::Schema::CLUSTER_MANAGER_SCHEMA);
+  init_helper_.setMaxConcurrentSecondaryInit(
+      config.getInteger("max_concurrent_secondary_init", 0));
+  if (config.hasObject("idle_cluster_timeout_ms")) {
+    idle_cluster_timeout_.value(
+        std::chrono::milliseconds(config.getInteger("idle_cluster_timeout_ms")));
+  }
 
   if (config.hasObject("outlier_detection")) {
     std::string event_log_file_path =
@@ -176,7 +197,9 @@ ClusterManagerImpl::ClusterManagerImpl(const Json::Object& config, ClusterManage
 
     SdsConfig sds_config{
         config.getObject("sds")->getObject("cluster")->getString("name"),
-        std::chrono::milliseconds(config.getObject("sds")->getInteger("refresh_delay_ms"))};
+        std::chrono::milliseconds(config.getObject("sds")->getInteger("refresh_delay_ms")),
+        config.getObject("sds")->getString("api_type", "rest") == "stream",
+        config.getObject("sds")->getString("snapshot_dir", "")};
 
     sds_config_.value(sds_config);
   }
@@ -188,6 +211,16 @@ ClusterManagerImpl::ClusterManagerImpl(const Json::Object& config, ClusterManage
   // We can now potentially create the CDS API once the backing cluster exists.
   cds_api_ = factory_.createCds(config, *this);
   init_helper_.setCds(cds_api_.get());
+  if (cds_api_) {
+    // Clusters that an on demand fetch found have already been added to every thread when the
+    // threads that wait for them are told that the fetch is complete.
+    cds_api_->setClusterRequestCompleteCb([this](const std::string& cluster) -> void {
+      runOnAllThreads([this, cluster]() -> void {
+        tls_.getTyped<ThreadLocalClusterManagerImpl>(thread_local_slot_)
+            .onClusterDiscoveryComplete(cluster);
+      });
+    });
+  }
 
   for (const Json::ObjectSharedPtr& cluster : config.getObjectArray("clusters")) {
     loadCluster(*cluster, false);
@@ -214,7 +247,7 @@ ClusterManagerImpl::ClusterManagerImpl(const Json::Object& config, ClusterManage
   // also require this for dynamic clusters where an immediate resolve occurred in the cluster
   // constructor, prior to the member update callback being configured.
   for (auto& cluster : primary_clusters_) {
-    postInitializeCluster(*cluster.second.cluster_);
+    postInitializeCluster(cluster.second);
   }
 
   init_helper_.onStaticLoadComplete();
@@ -226,12 +259,39 @@ ClusterManagerStats ClusterManagerImpl::generateStats(Stats::Scope& scope) {
                                     POOL_GAUGE_PREFIX(scope, final_prefix))};
 }
 
-void ClusterManagerImpl::postInitializeCluster(Cluster& cluster) {
+LoadBalancerTableBuilderPtr ClusterManagerImpl::createLbTableBuilder(const ClusterInfo& cluster) {
+  // Subsets are formed on each worker from the hosts of the worker, so the load balancers of
+  // subsets keep their own tables.
+  if (cluster.lbSubsetInfo().isEnabled()) {
+    return nullptr;
+  }
+
+  switch (cluster.lbType()) {
+  case LoadBalancerType::LeastRequest:
+  case LoadBalancerType::Random:
+  case LoadBalancerType::RoundRobin:
+    return nullptr;
+  case LoadBalancerType::RingHash:
+    return LoadBalancerTableBuilderPtr{
+        new RingHashLoadBalancer::TableBuilder(runtime_, cluster.ringHashFunction())};
+  case LoadBalancerType::Maglev:
+    return LoadBalancerTableBuilderPtr{new MaglevLoadBalancer::TableBuilder()};
+  case LoadBalancerType::OriginalDst:
+  case LoadBalancerType::DynamicForwardProxy:
+    return nullptr;
+  }
+
+  NOT_REACHED;
+}
+
+void ClusterManagerImpl::postInitializeCluster(const PrimaryClusterData& cluster_data) {
+  const Cluster& cluster = *cluster_data.cluster_;
   if (cluster.hosts().empty()) {
     return;
   }
 
-  postThreadLocalClusterUpdate(cluster, cluster.hosts(), std::vector<HostSharedPtr>{});
+  postThreadLocalClusterUpdate(cluster, cluster_data.lb_table_builder_.get(), cluster.hosts(),
+                               std::vector<HostSharedPtr>{});
 }
 
 bool ClusterManagerImpl::addOrUpdatePrimaryCluster(const Json::Object& new_config) {
@@ -251,15 +311,14 @@ bool ClusterManagerImpl::addOrUpdatePrimaryCluster(const Json::Object& new_confi
 
   loadCluster(new_config, true);
   ClusterInfoConstSharedPtr new_cluster = primary_clusters_.at(cluster_name).cluster_->info();
-  tls_.runOnAllThreads([this, new_cluster]() -> void {
+  runOnAllThreads([this, new_cluster]() -> void {
     ThreadLocalClusterManagerImpl& cluster_manager =
         tls_.getTyped<ThreadLocalClusterManagerImpl>(thread_local_slot_);
 
-    cluster_manager.thread_local_clusters_[new_cluster->name()].reset(
-        new ThreadLocalClusterManagerImpl::ClusterEntry(cluster_manager, new_cluster));
+    cluster_manager.addCluster(new_cluster);
   });
 
-  postInitializeCluster(*primary_clusters_.at(cluster_name).cluster_);
+  postInitializeCluster(primary_clusters_.at(cluster_name));
   return true;
 }
 
@@ -273,11 +332,11 @@ bool ClusterManagerImpl::removePrimaryCluster(const std::string& cluster_name) {
   primary_clusters_.erase(existing_cluster);
   cm_stats_.cluster_removed_.inc();
   cm_stats_.total_clusters_.set(primary_clusters_.size());
-  tls_.runOnAllThreads([this, cluster_name]() -> void {
+  runOnAllThreads([this, cluster_name]() -> void {
     ThreadLocalClusterManagerImpl& cluster_manager =
         tls_.getTyped<ThreadLocalClusterManagerImpl>(thread_local_slot_);
 
-    cluster_manager.thread_local_clusters_.erase(cluster_name);
+    cluster_manager.removeCluster(cluster_name);
   });
 
   return true;
@@ -295,20 +354,24 @@ void ClusterManagerImpl::loadCluster(const Json::Object& cluster, bool added_via
     }
   }
 
+  LoadBalancerTableBuilderPtr lb_table_builder = createLbTableBuilder(*new_cluster->info());
+  LoadBalancerTableBuilder* lb_table_builder_reference = lb_table_builder.get();
   const Cluster& primary_cluster_reference = *new_cluster;
-  new_cluster->addMemberUpdateCb(
-      [&primary_cluster_reference, this](const std::vector<HostSharedPtr>& hosts_added,
-                                         const std::vector<HostSharedPtr>& hosts_removed) {
-        // This fires when a cluster is about to have an updated member set. We need to send this
-        // out to all of the thread local configurations.
-        postThreadLocalClusterUpdate(primary_cluster_reference, hosts_added, hosts_removed);
-      });
+  new_cluster->addMemberUpdateCb([&primary_cluster_reference, lb_table_builder_reference, this](
+      const std::vector<HostSharedPtr>& hosts_added,
+      const std::vector<HostSharedPtr>& hosts_removed) {
+    // This fires when a cluster is about to have an updated member set. We need to send this
+    // out to all of the thread local configurations.
+    postThreadLocalClusterUpdate(primary_cluster_reference, lb_table_builder_reference,
+                                 hosts_added, hosts_removed);
+  });
 
   // emplace() will do nothing if the key already exists. Always erase first.
   size_t num_erased = primary_clusters_.erase(primary_cluster_reference.info()->name());
   primary_clusters_.emplace(
       primary_cluster_reference.info()->name(),
-      PrimaryClusterData{cluster.hash(), added_via_api, std::move(new_cluster)});
+      PrimaryClusterData{cluster.hash(), added_via_api, std::move(lb_table_builder),
+                         std::move(new_cluster)});
 
   cm_stats_.total_clusters_.set(primary_clusters_.size());
   if (num_erased) {
@@ -322,9 +385,21 @@ ThreadLocalCluster* ClusterManagerImpl::get(const std::string& cluster) {
   ThreadLocalClusterManagerImpl& cluster_manager =
       tls_.getTyped<ThreadLocalClusterManagerImpl>(thread_local_slot_);
 
-  auto entry = cluster_manager.thread_local_clusters_.find(cluster);
-  if (entry != cluster_manager.thread_local_clusters_.end()) {
-    return entry->second.get();
+  return cluster_manager.clusterEntry(cluster);
+}
+
+ClusterId ClusterManagerImpl::clusterId(const std::string& cluster) {
+  std::unique_lock<std::mutex> lock(cluster_ids_lock_);
+  auto id = cluster_ids_.emplace(cluster, cluster_ids_.size());
+  return id.first->second;
+}
+
+ThreadLocalCluster* ClusterManagerImpl::getById(ClusterId id) {
+  ThreadLocalClusterManagerImpl& cluster_manager =
+      tls_.getTyped<ThreadLocalClusterManagerImpl>(thread_local_slot_);
+
+  if (id < cluster_manager.clusters_by_id_.size() && cluster_manager.clusters_by_id_[id]) {
+    return &cluster_manager.clusterEntry(*cluster_manager.clusters_by_id_[id]);
   } else {
     return nullptr;
   }
@@ -337,48 +412,126 @@ ClusterManagerImpl::httpConnPoolForCluster(const std::string& cluster, ResourceP
       tls_.getTyped<ThreadLocalClusterManagerImpl>(thread_local_slot_);
 
   // Select a host and create a connection pool for it if it does not already exist.
-  auto entry = cluster_manager.thread_local_clusters_.find(cluster);
-  if (entry == cluster_manager.thread_local_clusters_.end()) {
+  ThreadLocalClusterManagerImpl::ClusterEntry* entry = cluster_manager.clusterEntry(cluster);
+  if (entry == nullptr) {
     return nullptr;
   }
 
-  return entry->second->connPool(priority, context);
+  return entry->connPool(priority, context);
 }
 
 void ClusterManagerImpl::postThreadLocalClusterUpdate(
-    const Cluster& primary_cluster, const std::vector<HostSharedPtr>& hosts_added,
+    const Cluster& primary_cluster, LoadBalancerTableBuilder* lb_table_builder,
+    const std::vector<HostSharedPtr>& hosts_added,
     const std::vector<HostSharedPtr>& hosts_removed) {
   const std::string& name = primary_cluster.info()->name();
-  HostVectorConstSharedPtr hosts_copy(new std::vector<HostSharedPtr>(primary_cluster.hosts()));
-  HostVectorConstSharedPtr healthy_hosts_copy(
-      new std::vector<HostSharedPtr>(primary_cluster.healthyHosts()));
-  HostListsConstSharedPtr hosts_per_zone_copy(
-      new std::vector<std::vector<HostSharedPtr>>(primary_cluster.hostsPerZone()));
-  HostListsConstSharedPtr healthy_hosts_per_zone_copy(
-      new std::vector<std::vector<HostSharedPtr>>(primary_cluster.healthyHostsPerZone()));
-
-  tls_.runOnAllThreads([this, name, hosts_copy, healthy_hosts_copy, hosts_per_zone_copy,
-                        healthy_hosts_per_zone_copy, hosts_added, hosts_removed]() -> void {
-    ThreadLocalClusterManagerImpl::updateClusterMembership(
-        name, hosts_copy, healthy_hosts_copy, hosts_per_zone_copy, healthy_hosts_per_zone_copy,
-        hosts_added, hosts_removed, tls_, thread_local_slot_);
+  // The primary cluster never modifies a host list once it has been published, so every worker
+  // can share the same snapshot rather than receiving a copy of each list. Tables such as hash
+  // rings are built once here instead of once on every worker.
+  MembershipUpdate update{++membership_generation_,
+                          primary_cluster.hostsPtr(),
+                          primary_cluster.healthyHostsPtr(),
+                          primary_cluster.hostsPerZonePtr(),
+                          primary_cluster.healthyHostsPerZonePtr(),
+                          hosts_added,
+                          hosts_removed,
+                          lb_table_builder ? lb_table_builder->build(primary_cluster) : nullptr};
+  cm_stats_.membership_update_.inc();
+
+  // The main thread applies the update right away, so that the main thread users of the cluster,
+  // such as the discovery services, see it as soon as it is made.
+  ThreadLocalClusterManagerImpl& cluster_manager =
+      tls_.getTyped<ThreadLocalClusterManagerImpl>(thread_local_slot_);
+  cluster_manager.updateClusterMembership(name, update);
+
+  // The workers get all the updates made while the main thread handles an event, e.g. a discovery
+  // response or a DNS resolution, in a single post each, with the updates of each cluster merged.
+  if (pending_membership_updates_) {
+    auto pending_update = pending_membership_updates_->find(name);
+    if (pending_update != pending_membership_updates_->end()) {
+      mergeMembershipUpdate(pending_update->second, std::move(update));
+      return;
+    }
+
+    pending_membership_updates_->emplace(name, std::move(update));
+    return;
+  }
+
+  pending_membership_updates_.reset(new MembershipUpdateBatch());
+  pending_membership_updates_->emplace(name, std::move(update));
+  cluster_manager.thread_local_dispatcher_.post([this]() -> void { flushMembershipUpdates(); });
+}
+
+void ClusterManagerImpl::mergeMembershipUpdate(MembershipUpdate& pending_update,
+                                               MembershipUpdate&& update) {
+  cm_stats_.membership_update_merged_.inc();
+
+  // The later snapshots replace the pending ones. The hosts that changed are combined so that a
+  // host that was added and then removed again is in neither list.
+  const std::unordered_set<HostSharedPtr> removed(update.hosts_removed_.begin(),
+                                                  update.hosts_removed_.end());
+  const std::unordered_set<HostSharedPtr> pending_added(pending_update.hosts_added_.begin(),
+                                                        pending_update.hosts_added_.end());
+  std::vector<HostSharedPtr> hosts_added;
+  for (const HostSharedPtr& host : pending_update.hosts_added_) {
+    if (removed.count(host) == 0) {
+      hosts_added.push_back(host);
+    }
+  }
+  hosts_added.insert(hosts_added.end(), update.hosts_added_.begin(), update.hosts_added_.end());
+  for (const HostSharedPtr& host : update.hosts_removed_) {
+    if (pending_added.count(host) == 0) {
+      pending_update.hosts_removed_.push_back(host);
+    }
+  }
+
+  pending_update.generation_ = update.generation_;
+  pending_update.hosts_ = std::move(update.hosts_);
+  pending_update.healthy_hosts_ = std::move(update.healthy_hosts_);
+  pending_update.hosts_per_zone_ = std::move(update.hosts_per_zone_);
+  pending_update.healthy_hosts_per_zone_ = std::move(update.healthy_hosts_per_zone_);
+  pending_update.hosts_added_ = std::move(hosts_added);
+  pending_update.lb_table_ = std::move(update.lb_table_);
+}
+
+void ClusterManagerImpl::flushMembershipUpdates() {
+  if (!pending_membership_updates_) {
+    return;
+  }
+
+  cm_stats_.membership_update_batch_.inc();
+  std::shared_ptr<const MembershipUpdateBatch> batch(std::move(pending_membership_updates_));
+  tls_.runOnAllThreads([this, batch]() -> void {
+    ThreadLocalClusterManagerImpl& cluster_manager =
+        tls_.getTyped<ThreadLocalClusterManagerImpl>(thread_local_slot_);
+    for (const auto& update : *batch) {
+      cluster_manager.updateClusterMembership(update.first, update.second);
+    }
   });
 }
 
-Host::CreateConnectionData ClusterManagerImpl::tcpConnForCluster(const std::string& cluster) {
+void ClusterManagerImpl::runOnAllThreads(Event::PostCb cb) {
+  // Clusters may only be added or removed, and discoveries completed, once the threads have the
+  // membership updates made before, as they would without batching.
+  flushMembershipUpdates();
+  tls_.runOnAllThreads(cb);
+}
+
+Host::CreateConnectionData ClusterManagerImpl::tcpConnForCluster(const std::string& cluster,
+                                                                 LoadBalancerContext* context) {
   ThreadLocalClusterManagerImpl& cluster_manager =
       tls_.getTyped<ThreadLocalClusterManagerImpl>(thread_local_slot_);
 
-  auto entry = cluster_manager.thread_local_clusters_.find(cluster);
-  if (entry == cluster_manager.thread_local_clusters_.end()) {
+  ThreadLocalClusterManagerImpl::ClusterEntry* entry = cluster_manager.clusterEntry(cluster);
+  if (entry == nullptr) {
     throw EnvoyException(fmt::format("unknown cluster '{}'", cluster));
   }
 
-  HostConstSharedPtr logical_host = entry->second->lb_->chooseHost(nullptr);
+  HostConstSharedPtr logical_host = entry->lb_->chooseHost(context);
   if (logical_host) {
     return logical_host->createConnection(cluster_manager.thread_local_dispatcher_);
   } else {
-    entry->second->cluster_info_->stats().upstream_cx_none_healthy_.inc();
+    entry->cluster_info_->stats().upstream_cx_none_healthy_.inc();
     return {nullptr, nullptr};
   }
 }
@@ -386,57 +539,200 @@ Host::CreateConnectionData ClusterManagerImpl::tcpConnForCluster(const std::stri
 Http::AsyncClient& ClusterManagerImpl::httpAsyncClientForCluster(const std::string& cluster) {
   ThreadLocalClusterManagerImpl& cluster_manager =
       tls_.getTyped<ThreadLocalClusterManagerImpl>(thread_local_slot_);
-  auto entry = cluster_manager.thread_local_clusters_.find(cluster);
-  if (entry != cluster_manager.thread_local_clusters_.end()) {
-    return entry->second->http_async_client_;
+  ThreadLocalClusterManagerImpl::ClusterEntry* entry = cluster_manager.clusterEntry(cluster);
+  if (entry != nullptr) {
+    return entry->http_async_client_;
   } else {
     throw EnvoyException(fmt::format("unknown cluster '{}'", cluster));
   }
 }
 
+ClusterDiscoveryRequest* ClusterManagerImpl::discoverCluster(const std::string& cluster,
+                                                             ClusterDiscoveryCb callback) {
+  ThreadLocalClusterManagerImpl& cluster_manager =
+      tls_.getTyped<ThreadLocalClusterManagerImpl>(thread_local_slot_);
+
+  auto pending = cluster_manager.pending_cluster_discoveries_.find(cluster);
+  if (pending == cluster_manager.pending_cluster_discoveries_.end()) {
+    // The first discovery of the cluster on this thread starts a fetch, which joins the fetch of
+    // any other thread that waits for the same cluster.
+    if (!cds_api_ || !cds_api_->requestCluster(cluster)) {
+      return nullptr;
+    }
+
+    pending = cluster_manager.pending_cluster_discoveries_
+                  .emplace(cluster, std::list<ThreadLocalClusterManagerImpl::
+                                                  ClusterDiscoveryRequestImplPtr>{})
+                  .first;
+  }
+
+  std::list<ThreadLocalClusterManagerImpl::ClusterDiscoveryRequestImplPtr>& requests =
+      pending->second;
+  requests.emplace_back(new ThreadLocalClusterManagerImpl::ClusterDiscoveryRequestImpl(
+      cluster_manager, cluster, callback));
+  requests.back()->position_ = std::prev(requests.end());
+  return requests.back().get();
+}
+
 ClusterManagerImpl::ThreadLocalClusterManagerImpl::ThreadLocalClusterManagerImpl(
     ClusterManagerImpl& parent, Event::Dispatcher& dispatcher,
     const Optional<std::string>& local_cluster_name)
     : parent_(parent), thread_local_dispatcher_(dispatcher) {
-  // If local cluster is defined then we need to initialize it first.
+  // If local cluster is defined then we need to initialize it first. Its entry is always created
+  // since the load balancers of the other clusters use its host set.
   if (local_cluster_name.valid()) {
     auto& local_cluster = parent.primary_clusters_.at(local_cluster_name.value()).cluster_;
-    thread_local_clusters_[local_cluster_name.value()].reset(
-        new ClusterEntry(*this, local_cluster->info()));
+    local_host_set_ = &clusterEntry(addCluster(local_cluster->info())).host_set_;
   }
 
-  local_host_set_ = local_cluster_name.valid()
-                        ? &thread_local_clusters_[local_cluster_name.value()]->host_set_
-                        : nullptr;
-
   for (auto& cluster : parent.primary_clusters_) {
     // If local cluster name is set then we already initialized this cluster.
     if (local_cluster_name.valid() && local_cluster_name.value() == cluster.first) {
       continue;
     }
 
-    thread_local_clusters_[cluster.first].reset(
-        new ClusterEntry(*this, cluster.second.cluster_->info()));
+    addCluster(cluster.second.cluster_->info());
+  }
+
+  if (parent.idle_cluster_timeout_.valid()) {
+    idle_timer_ = dispatcher.createTimer([this]() -> void { onIdleTimer(); });
+    idle_timer_->enableTimer(parent.idle_cluster_timeout_.value());
   }
 }
 
 ClusterManagerImpl::ThreadLocalClusterManagerImpl::~ThreadLocalClusterManagerImpl() {
   ASSERT(thread_local_clusters_.empty());
   ASSERT(host_http_conn_pool_map_.empty());
+  ASSERT(shared_conn_pools_.empty());
+}
+
+ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterSlot&
+ClusterManagerImpl::ThreadLocalClusterManagerImpl::addCluster(ClusterInfoConstSharedPtr cluster) {
+  const ClusterId id = parent_.clusterId(cluster->name());
+  ClusterSlot& slot = thread_local_clusters_[cluster->name()];
+  // An updated cluster starts over without hosts. The primary cluster posts its hosts once it has
+  // been loaded.
+  slot = ClusterSlot();
+  slot.info_ = cluster;
+
+  if (id >= clusters_by_id_.size()) {
+    clusters_by_id_.resize(id + 1);
+  }
+  clusters_by_id_[id] = &slot;
+
+  // Warming opens connections as soon as hosts become healthy, so it needs the entry up front.
+  if (cluster->prefetchRatio() > 1.0) {
+    clusterEntry(slot);
+  }
+  return slot;
+}
+
+ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterEntry*
+ClusterManagerImpl::ThreadLocalClusterManagerImpl::clusterEntry(const std::string& name) {
+  auto slot = thread_local_clusters_.find(name);
+  if (slot == thread_local_clusters_.end()) {
+    return nullptr;
+  }
+
+  return &clusterEntry(slot->second);
+}
+
+ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterEntry&
+ClusterManagerImpl::ThreadLocalClusterManagerImpl::clusterEntry(ClusterSlot& slot) {
+  slot.used_ = true;
+  slot.idle_drained_ = false;
+  if (!slot.entry_) {
+    slot.entry_.reset(new ClusterEntry(*this, slot.info_));
+    if (slot.hosts_) {
+      slot.entry_->lb_table_ = slot.lb_table_;
+      slot.entry_->host_set_.updateHosts(slot.hosts_, slot.healthy_hosts_, slot.hosts_per_zone_,
+                                         slot.healthy_hosts_per_zone_, *slot.hosts_, {});
+    }
+  }
+
+  return *slot.entry_;
+}
+
+void ClusterManagerImpl::ThreadLocalClusterManagerImpl::onIdleTimer() {
+  // Clusters that have not been used for a whole interval give up the connection pools of their
+  // hosts. The entries themselves stay, since filters and drivers may keep a pointer to them, and
+  // the pools are created again on the next request. Warmed pools are kept on purpose, and shared
+  // pools are only drained once all of the clusters that share them are removed.
+  for (auto& cluster : thread_local_clusters_) {
+    ClusterSlot& slot = cluster.second;
+    if (slot.used_) {
+      slot.used_ = false;
+    } else if (slot.entry_ && !slot.idle_drained_ && slot.info_->prefetchRatio() <= 1.0 &&
+               slot.info_->connPoolSharingKey().empty()) {
+      slot.idle_drained_ = true;
+      drainConnPools(slot.entry_->host_set_.hosts());
+      parent_.cm_stats_.cluster_idle_drained_.inc();
+    }
+  }
+
+  idle_timer_->enableTimer(parent_.idle_cluster_timeout_.value());
+}
+
+void ClusterManagerImpl::ThreadLocalClusterManagerImpl::onClusterDiscoveryComplete(
+    const std::string& name) {
+  auto pending = pending_cluster_discoveries_.find(name);
+  if (pending == pending_cluster_discoveries_.end()) {
+    return;
+  }
+
+  // Each request leaves the list before its callback runs, since the callback may cancel other
+  // requests of the list.
+  std::list<ClusterDiscoveryRequestImplPtr>& requests = pending->second;
+  while (!requests.empty()) {
+    ClusterDiscoveryRequestImplPtr request = std::move(requests.front());
+    requests.pop_front();
+    request->callback_();
+  }
+  pending_cluster_discoveries_.erase(name);
+}
+
+void ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterDiscoveryRequestImpl::cancel() {
+  // The fetch goes on even if no request of this thread waits for it anymore. The empty list then
+  // keeps later requests from starting another fetch while it is in progress.
+  auto pending = parent_.pending_cluster_discoveries_.find(cluster_);
+  ASSERT(pending != parent_.pending_cluster_discoveries_.end());
+  pending->second.erase(position_);
+}
+
+void ClusterManagerImpl::ThreadLocalClusterManagerImpl::removeCluster(const std::string& name) {
+  const ClusterId id = parent_.clusterId(name);
+  if (id < clusters_by_id_.size()) {
+    clusters_by_id_[id] = nullptr;
+  }
+  thread_local_clusters_.erase(name);
 }
 
 void ClusterManagerImpl::ThreadLocalClusterManagerImpl::drainConnPools(
     const std::vector<HostSharedPtr>& hosts) {
   for (const HostSharedPtr& host : hosts) {
-    auto container = host_http_conn_pool_map_.find(host);
+    HostConstSharedPtr pool_host = host;
+    auto shared = shared_conn_pools_by_host_.find(host);
+    if (shared != shared_conn_pools_by_host_.end()) {
+      SharedConnPools& pools = *shared->second;
+      shared_conn_pools_by_host_.erase(shared);
+      ASSERT(pools.users_ > 0);
+      if (--pools.users_ > 0) {
+        continue;
+      }
+
+      pool_host = pools.host_;
+      shared_conn_pools_.erase(pools.key_);
+    }
+
+    auto container = host_http_conn_pool_map_.find(pool_host);
     if (container != host_http_conn_pool_map_.end()) {
-      drainConnPools(host, container->second);
+      drainConnPools(pool_host, container->second);
     }
   }
 }
 
 void ClusterManagerImpl::ThreadLocalClusterManagerImpl::drainConnPools(
-    HostSharedPtr old_host, ConnPoolsContainer& container) {
+    HostConstSharedPtr old_host, ConnPoolsContainer& container) {
   for (const Http::ConnectionPool::InstancePtr& pool : container.pools_) {
     if (pool) {
       container.drains_remaining_++;
@@ -462,24 +758,54 @@ void ClusterManagerImpl::ThreadLocalClusterManagerImpl::drainConnPools(
   }
 }
 
-void ClusterManagerImpl::ThreadLocalClusterManagerImpl::updateClusterMembership(
-    const std::string& name, HostVectorConstSharedPtr hosts, HostVectorConstSharedPtr healthy_hosts,
-    HostListsConstSharedPtr hosts_per_zone, HostListsConstSharedPtr healthy_hosts_per_zone,
-    const std::vector<HostSharedPtr>& hosts_added, const std::vector<HostSharedPtr>& hosts_removed,
-    ThreadLocal::Instance& tls, uint32_t thead_local_slot) {
+HostConstSharedPtr ClusterManagerImpl::ThreadLocalClusterManagerImpl::sharedConnPoolHost(
+    HostConstSharedPtr host, const std::string& sharing_key) {
+  SharedConnPools*& shared = shared_conn_pools_by_host_[host];
+  if (shared == nullptr) {
+    const std::string key = fmt::format("{}/{}", host->address()->asString(), sharing_key);
+    shared = &shared_conn_pools_[key];
+    if (!shared->host_) {
+      shared->key_ = key;
+      shared->host_ = host;
+    }
+    shared->users_++;
+  }
 
-  ThreadLocalClusterManagerImpl& config =
-      tls.getTyped<ThreadLocalClusterManagerImpl>(thead_local_slot);
+  return shared->host_;
+}
 
-  ASSERT(config.thread_local_clusters_.find(name) != config.thread_local_clusters_.end());
-  config.thread_local_clusters_[name]->host_set_.updateHosts(
-      hosts, healthy_hosts, hosts_per_zone, healthy_hosts_per_zone, hosts_added, hosts_removed);
+void ClusterManagerImpl::ThreadLocalClusterManagerImpl::updateClusterMembership(
+    const std::string& name, const MembershipUpdate& update) {
+  ASSERT(thread_local_clusters_.find(name) != thread_local_clusters_.end());
+  ClusterSlot& slot = thread_local_clusters_[name];
+  // The main thread applies each update when it is made, before the batch with it is posted.
+  if (slot.membership_generation_ >= update.generation_) {
+    return;
+  }
+
+  slot.membership_generation_ = update.generation_;
+  slot.hosts_ = update.hosts_;
+  slot.healthy_hosts_ = update.healthy_hosts_;
+  slot.hosts_per_zone_ = update.hosts_per_zone_;
+  slot.healthy_hosts_per_zone_ = update.healthy_hosts_per_zone_;
+  slot.lb_table_ = update.lb_table_;
+  if (slot.entry_) {
+    slot.entry_->lb_table_ = update.lb_table_;
+    slot.entry_->host_set_.updateHosts(update.hosts_, update.healthy_hosts_,
+                                       update.hosts_per_zone_, update.healthy_hosts_per_zone_,
+                                       update.hosts_added_, update.hosts_removed_);
+  }
 }
 
 void ClusterManagerImpl::ThreadLocalClusterManagerImpl::shutdown() {
   // Clear out connection pools as well as the thread local cluster map so that we release all
   // primary cluster pointers.
+  idle_timer_.reset();
+  pending_cluster_discoveries_.clear();
   host_http_conn_pool_map_.clear();
+  shared_conn_pools_by_host_.clear();
+  shared_conn_pools_.clear();
+  clusters_by_id_.clear();
   thread_local_clusters_.clear();
 }
 
@@ -491,27 +817,72 @@ ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterEntry::ClusterEntry(
                          parent.parent_.random_,
                          Router::ShadowWriterPtr{new Router::ShadowWriterImpl(parent.parent_)}) {
 
-  switch (cluster->lbType()) {
-  case LoadBalancerType::LeastRequest: {
-    lb_.reset(new LeastRequestLoadBalancer(host_set_, parent.local_host_set_, cluster->stats(),
-                                           parent.parent_.runtime_, parent.parent_.random_));
-    break;
-  }
-  case LoadBalancerType::Random: {
-    lb_.reset(new RandomLoadBalancer(host_set_, parent.local_host_set_, cluster->stats(),
-                                     parent.parent_.runtime_, parent.parent_.random_));
-    break;
-  }
-  case LoadBalancerType::RoundRobin: {
-    lb_.reset(new RoundRobinLoadBalancer(host_set_, parent.local_host_set_, cluster->stats(),
-                                         parent.parent_.runtime_, parent.parent_.random_));
-    break;
-  }
-  case LoadBalancerType::RingHash: {
+  const auto lb_factory = [&parent, cluster](HostSet& host_set) -> LoadBalancerPtr {
+    switch (cluster->lbType()) {
+    case LoadBalancerType::LeastRequest: {
+      return LoadBalancerPtr{new LeastRequestLoadBalancer(host_set, parent.local_host_set_,
+                                                          cluster->stats(), parent.parent_.runtime_,
+                                                          parent.parent_.random_)};
+    }
+    case LoadBalancerType::Random: {
+      return LoadBalancerPtr{new RandomLoadBalancer(host_set, parent.local_host_set_,
+                                                    cluster->stats(), parent.parent_.runtime_,
+                                                    parent.parent_.random_)};
+    }
+    case LoadBalancerType::RoundRobin: {
+      return LoadBalancerPtr{new RoundRobinLoadBalancer(host_set, parent.local_host_set_,
+                                                        cluster->stats(), parent.parent_.runtime_,
+                                                        parent.parent_.random_)};
+    }
+    case LoadBalancerType::RingHash: {
+      return LoadBalancerPtr{new RingHashLoadBalancer(
+          host_set, cluster->stats(), parent.parent_.runtime_, parent.parent_.random_,
+          cluster->ringHashFunction())};
+    }
+    case LoadBalancerType::Maglev: {
+      return LoadBalancerPtr{new MaglevLoadBalancer(host_set, cluster->stats(),
+                                                    parent.parent_.runtime_,
+                                                    parent.parent_.random_)};
+    }
+    case LoadBalancerType::OriginalDst:
+    case LoadBalancerType::DynamicForwardProxy:
+      // Original destination and dynamic forward proxy clusters do not support subsets, see
+      // ClusterInfoImpl.
+      break;
+    }
+
+    NOT_REACHED;
+  };
+
+  // The tables of hash based load balancers are built on the main thread, see
+  // createLbTableBuilder().
+  if (cluster->lbSubsetInfo().isEnabled()) {
+    lb_.reset(new SubsetLoadBalancer(host_set_, cluster->lbSubsetInfo(), cluster->stats(),
+                                     lb_factory));
+  } else if (cluster->lbType() == LoadBalancerType::RingHash) {
     lb_.reset(new RingHashLoadBalancer(host_set_, cluster->stats(), parent.parent_.runtime_,
-                                       parent.parent_.random_));
-    break;
-  }
+                                       parent.parent_.random_, lb_table_));
+  } else if (cluster->lbType() == LoadBalancerType::Maglev) {
+    lb_.reset(new MaglevLoadBalancer(host_set_, cluster->stats(), parent.parent_.runtime_,
+                                     parent.parent_.random_, lb_table_));
+  } else if (cluster->lbType() == LoadBalancerType::OriginalDst) {
+    // The hosts of original destination clusters are created by the load balancer of each worker,
+    // which drains their connection pools when it removes them.
+    lb_.reset(new OriginalDstCluster::LoadBalancer(
+        cluster, parent.thread_local_dispatcher_,
+        [&parent](const std::vector<HostSharedPtr>& hosts_removed) -> void {
+          parent.drainConnPools(hosts_removed);
+        }));
+  } else if (cluster->lbType() == LoadBalancerType::DynamicForwardProxy) {
+    // Likewise for dynamic forward proxy clusters, whose names are resolved through the resolver
+    // shared by all workers.
+    lb_.reset(new DynamicForwardProxyCluster::LoadBalancer(
+        cluster, parent.thread_local_dispatcher_, parent.parent_.factory_.dnsResolver(),
+        [&parent](const std::vector<HostSharedPtr>& hosts_removed) -> void {
+          parent.drainConnPools(hosts_removed);
+        }));
+  } else {
+    lb_ = lb_factory(host_set_);
   }
 
   host_set_.addMemberUpdateCb([this](const std::vector<HostSharedPtr>&,
@@ -520,6 +891,11 @@ ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterEntry::ClusterEntry(
     // Even if two hosts actually point to the same address this will be safe, since if a
     // host is readded it will be a different physical HostSharedPtr.
     parent_.drainConnPools(hosts_removed);
+
+    // This also runs when hosts pass their health checks, which is when they are worth warming.
+    if (cluster_info_->prefetchRatio() > 1.0) {
+      warmConnPools();
+    }
   });
 }
 
@@ -542,6 +918,13 @@ ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterEntry::connPool(
     return nullptr;
   }
 
+  return &connPool(host, priority);
+}
+
+Http::ConnectionPool::Instance&
+ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterEntry::connPool(
+    HostConstSharedPtr host, ResourcePriority priority) {
+  host = connPoolHost(host);
   ConnPoolsContainer& container = parent_.host_http_conn_pool_map_[host];
   ASSERT(enumToInt(priority) < container.pools_.size());
   if (!container.pools_[enumToInt(priority)]) {
@@ -549,7 +932,28 @@ ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterEntry::connPool(
         parent_.parent_.factory_.allocateConnPool(parent_.thread_local_dispatcher_, host, priority);
   }
 
-  return container.pools_[enumToInt(priority)].get();
+  return *container.pools_[enumToInt(priority)];
+}
+
+HostConstSharedPtr
+ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterEntry::connPoolHost(
+    HostConstSharedPtr host) {
+  if (cluster_info_->connPoolSharingKey().empty()) {
+    return host;
+  }
+
+  return parent_.sharedConnPoolHost(host, cluster_info_->connPoolSharingKey());
+}
+
+void ClusterManagerImpl::ThreadLocalClusterManagerImpl::ClusterEntry::warmConnPools() {
+  // Only healthy hosts that this thread has never sent a request to are warmed. Hosts that
+  // already have pools keep connections open in proportion to their own traffic.
+  for (const HostSharedPtr& host : host_set_.healthyHosts()) {
+    if (parent_.host_http_conn_pool_map_.find(connPoolHost(host)) ==
+        parent_.host_http_conn_pool_map_.end()) {
+      connPool(host, ResourcePriority::Default).warm();
+    }
+  }
 }
 
 ClusterManagerPtr ProdClusterManagerFactory::clusterManagerFromJson(
@@ -566,10 +970,10 @@ ProdClusterManagerFactory::allocateConnPool(Event::Dispatcher& dispatcher, HostC
   if ((host->cluster().features() & ClusterInfo::Features::HTTP2) &&
       runtime_.snapshot().featureEnabled("upstream.use_http2", 100)) {
     return Http::ConnectionPool::InstancePtr{
-        new Http::Http2::ProdConnPoolImpl(dispatcher, host, priority)};
+        new Http::Http2::ProdConnPoolImpl(dispatcher, random_, host, priority)};
   } else {
     return Http::ConnectionPool::InstancePtr{
-        new Http::Http1::ConnPoolImplProd(dispatcher, host, priority)};
+        new Http::Http1::ConnPoolImplProd(dispatcher, random_, host, priority)};
   }
 }
 
@@ -1,14 +1,18 @@
 #pragma once
 
 #include <array>
+#include <chrono>
 #include <cstdint>
 #include <functional>
 #include <list>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
 #include "envoy/http/codes.h"
 #include "envoy/local_info/local_info.h"
 #include "envoy/runtime/runtime.h"
@@ -50,6 +54,7 @@ public:
                              const Optional<SdsConfig>& sds_config,
                              Outlier::EventLoggerSharedPtr outlier_event_logger) override;
   CdsApiPtr createCds(const Json::Object& config, ClusterManager& cm) override;
+  Network::DnsResolverSharedPtr dnsResolver() override { return dns_resolver_; }
 
 private:
   Runtime::Loader& runtime_;
@@ -74,6 +79,12 @@ public:
   void setCds(CdsApi* cds);
   void setInitializedCb(std::function<void()> callback);
 
+  /**
+   * Bound the number of secondary clusters that are initializing at the same time. Further
+   * secondary clusters are initialized as the ones in progress complete. 0 means unbounded.
+   */
+  void setMaxConcurrentSecondaryInit(uint32_t max) { max_concurrent_secondary_init_ = max; }
+
 private:
   enum class State {
     Loading,
@@ -84,11 +95,16 @@ private:
   };
 
   void maybeFinishInitialize();
+  void startSecondaryInitialize();
 
   CdsApi* cds_{};
   std::function<void()> initialized_callback_;
   std::list<Cluster*> primary_init_clusters_;
+  // Secondary clusters that have not been initialized yet.
   std::list<Cluster*> secondary_init_clusters_;
+  // Secondary clusters that are initializing.
+  std::list<Cluster*> secondary_active_clusters_;
+  uint32_t max_concurrent_secondary_init_{};
   State state_{State::Loading};
   bool started_secondary_initialize_{};
 };
@@ -101,6 +117,10 @@ private:
   COUNTER(cluster_added)                                                                           \
   COUNTER(cluster_modified)                                                                        \
   COUNTER(cluster_removed)                                                                         \
+  COUNTER(cluster_idle_drained)                                                                    \
+  COUNTER(membership_update)                                                                       \
+  COUNTER(membership_update_merged)                                                                \
+  COUNTER(membership_update_batch)                                                                 \
   GAUGE  (total_clusters)
 // clang-format on
 
@@ -136,18 +156,43 @@ public:
     return clusters_map;
   }
   ThreadLocalCluster* get(const std::string& cluster) override;
+  ClusterId clusterId(const std::string& cluster) override;
+  ThreadLocalCluster* getById(ClusterId id) override;
   Http::ConnectionPool::Instance* httpConnPoolForCluster(const std::string& cluster,
                                                          ResourcePriority priority,
                                                          LoadBalancerContext* context) override;
-  Host::CreateConnectionData tcpConnForCluster(const std::string& cluster) override;
+  Host::CreateConnectionData tcpConnForCluster(const std::string& cluster,
+                                               LoadBalancerContext* context) override;
   Http::AsyncClient& httpAsyncClientForCluster(const std::string& cluster) override;
   bool removePrimaryCluster(const std::string& cluster) override;
+  ClusterDiscoveryRequest* discoverCluster(const std::string& cluster,
+                                           ClusterDiscoveryCb callback) override;
   void shutdown() override {
     cds_api_.reset();
     primary_clusters_.clear();
+    pending_membership_updates_.reset();
   }
 
 private:
+  /**
+   * The hosts of a primary cluster after a membership update, along with the hosts that changed.
+   * The host lists and load balancer table are shared with the primary cluster.
+   */
+  struct MembershipUpdate {
+    // Increases with every update, so that a thread can tell whether it already has an update.
+    uint64_t generation_;
+    HostVectorConstSharedPtr hosts_;
+    HostVectorConstSharedPtr healthy_hosts_;
+    HostListsConstSharedPtr hosts_per_zone_;
+    HostListsConstSharedPtr healthy_hosts_per_zone_;
+    std::vector<HostSharedPtr> hosts_added_;
+    std::vector<HostSharedPtr> hosts_removed_;
+    LoadBalancerTableConstSharedPtr lb_table_;
+  };
+
+  // Keyed by cluster name.
+  typedef std::unordered_map<std::string, MembershipUpdate> MembershipUpdateBatch;
+
   /**
    * Thread local cached cluster data. Each thread local cluster gets updates from the parent
    * central dynamic cluster (if applicable). It maintains load balancer state and any created
@@ -161,20 +206,37 @@ private:
       uint64_t drains_remaining_{};
     };
 
+    /**
+     * Connection pools shared by the hosts of clusters that have the same connection pool sharing
+     * key and the same address. The pools are created with the first of the hosts, and drained once
+     * all of them have been removed.
+     */
+    struct SharedConnPools {
+      std::string key_;
+      // The key of the pools in host_http_conn_pool_map_.
+      HostConstSharedPtr host_;
+      uint64_t users_{};
+    };
+
     struct ClusterEntry : public ThreadLocalCluster {
       ClusterEntry(ThreadLocalClusterManagerImpl& parent, ClusterInfoConstSharedPtr cluster);
       ~ClusterEntry();
 
-      Http::ConnectionPool::Instance* connPool(ResourcePriority priority,
-                                               LoadBalancerContext* context);
+      Http::ConnectionPool::Instance& connPool(HostConstSharedPtr host, ResourcePriority priority);
+      HostConstSharedPtr connPoolHost(HostConstSharedPtr host);
+      void warmConnPools();
 
       // Upstream::ThreadLocalCluster
       const HostSet& hostSet() override { return host_set_; }
       ClusterInfoConstSharedPtr info() override { return cluster_info_; }
       LoadBalancer& loadBalancer() override { return *lb_; }
+      Http::ConnectionPool::Instance* connPool(ResourcePriority priority,
+                                               LoadBalancerContext* context) override;
 
       ThreadLocalClusterManagerImpl& parent_;
       HostSetImpl host_set_;
+      // Shared with every worker. Replaced before the hosts of host_set_ are updated.
+      LoadBalancerTableConstSharedPtr lb_table_;
       LoadBalancerPtr lb_;
       ClusterInfoConstSharedPtr cluster_info_;
       Http::AsyncClientImpl http_async_client_;
@@ -182,44 +244,103 @@ private:
 
     typedef std::unique_ptr<ClusterEntry> ClusterEntryPtr;
 
+    struct ClusterDiscoveryRequestImpl : public ClusterDiscoveryRequest {
+      ClusterDiscoveryRequestImpl(ThreadLocalClusterManagerImpl& parent, const std::string& cluster,
+                                  ClusterDiscoveryCb callback)
+          : parent_(parent), cluster_(cluster), callback_(callback) {}
+
+      // Upstream::ClusterDiscoveryRequest
+      void cancel() override;
+
+      ThreadLocalClusterManagerImpl& parent_;
+      const std::string cluster_;
+      ClusterDiscoveryCb callback_;
+      std::list<std::unique_ptr<ClusterDiscoveryRequestImpl>>::iterator position_;
+    };
+
+    typedef std::unique_ptr<ClusterDiscoveryRequestImpl> ClusterDiscoveryRequestImplPtr;
+
+    /**
+     * A cluster known to this thread. The cluster entry, with its host set, load balancer and
+     * async client, is only created the first time the thread uses the cluster, so that a thread
+     * does not pay for the thousands of clusters of a large CDS deployment that it never routes
+     * to. Until then membership updates only replace the latest host lists and load balancer
+     * table, which are shared with the primary cluster.
+     */
+    struct ClusterSlot {
+      ClusterInfoConstSharedPtr info_;
+      HostVectorConstSharedPtr hosts_;
+      HostVectorConstSharedPtr healthy_hosts_;
+      HostListsConstSharedPtr hosts_per_zone_;
+      HostListsConstSharedPtr healthy_hosts_per_zone_;
+      LoadBalancerTableConstSharedPtr lb_table_;
+      ClusterEntryPtr entry_;
+      // Whether the cluster has been used since the previous idle sweep.
+      bool used_{};
+      // Whether the connection pools of the cluster were drained since it was last used.
+      bool idle_drained_{};
+      // The generation of the last membership update applied to the cluster.
+      uint64_t membership_generation_{};
+    };
+
     ThreadLocalClusterManagerImpl(ClusterManagerImpl& parent, Event::Dispatcher& dispatcher,
                                   const Optional<std::string>& local_cluster_name);
     ~ThreadLocalClusterManagerImpl();
+    ClusterSlot& addCluster(ClusterInfoConstSharedPtr cluster);
+    void removeCluster(const std::string& name);
+    ClusterEntry* clusterEntry(const std::string& name);
+    ClusterEntry& clusterEntry(ClusterSlot& slot);
+    void onIdleTimer();
+    void onClusterDiscoveryComplete(const std::string& name);
     void drainConnPools(const std::vector<HostSharedPtr>& hosts);
-    void drainConnPools(HostSharedPtr old_host, ConnPoolsContainer& container);
-    static void updateClusterMembership(const std::string& name, HostVectorConstSharedPtr hosts,
-                                        HostVectorConstSharedPtr healthy_hosts,
-                                        HostListsConstSharedPtr hosts_per_zone,
-                                        HostListsConstSharedPtr healthy_hosts_per_zone,
-                                        const std::vector<HostSharedPtr>& hosts_added,
-                                        const std::vector<HostSharedPtr>& hosts_removed,
-                                        ThreadLocal::Instance& tls, uint32_t thread_local_slot);
+    void drainConnPools(HostConstSharedPtr old_host, ConnPoolsContainer& container);
+    HostConstSharedPtr sharedConnPoolHost(HostConstSharedPtr host, const std::string& sharing_key);
+    void updateClusterMembership(const std::string& name, const MembershipUpdate& update);
 
     // ThreadLocal::ThreadLocalObject
     void shutdown() override;
 
     ClusterManagerImpl& parent_;
     Event::Dispatcher& thread_local_dispatcher_;
-    std::unordered_map<std::string, ClusterEntryPtr> thread_local_clusters_;
+    std::unordered_map<std::string, ClusterSlot> thread_local_clusters_;
+    // Indexed by ClusterId. Entries are nullptr for IDs that do not have a cluster on this thread.
+    std::vector<ClusterSlot*> clusters_by_id_;
+    Event::TimerPtr idle_timer_;
+    // The discoveries of this thread that wait for an on demand fetch, keyed by cluster name.
+    std::unordered_map<std::string, std::list<ClusterDiscoveryRequestImplPtr>>
+        pending_cluster_discoveries_;
     std::unordered_map<HostConstSharedPtr, ConnPoolsContainer> host_http_conn_pool_map_;
+    std::unordered_map<std::string, SharedConnPools> shared_conn_pools_;
+    // The shared pools used by each host of a cluster that shares its connection pools.
+    std::unordered_map<HostConstSharedPtr, SharedConnPools*> shared_conn_pools_by_host_;
     const HostSet* local_host_set_{};
   };
 
   struct PrimaryClusterData {
-    PrimaryClusterData(uint64_t config_hash, bool added_via_api, ClusterPtr&& cluster)
-        : config_hash_(config_hash), added_via_api_(added_via_api), cluster_(std::move(cluster)) {}
+    PrimaryClusterData(uint64_t config_hash, bool added_via_api,
+                       LoadBalancerTableBuilderPtr&& lb_table_builder, ClusterPtr&& cluster)
+        : config_hash_(config_hash), added_via_api_(added_via_api),
+          lb_table_builder_(std::move(lb_table_builder)), cluster_(std::move(cluster)) {}
 
     const uint64_t config_hash_;
     const bool added_via_api_;
+    // Builds the load balancer tables that all workers share, if the load balancer of the cluster
+    // uses any. Declared before cluster_ since the member update callbacks of the cluster use it.
+    LoadBalancerTableBuilderPtr lb_table_builder_;
     ClusterPtr cluster_;
   };
 
   static ClusterManagerStats generateStats(Stats::Scope& scope);
+  LoadBalancerTableBuilderPtr createLbTableBuilder(const ClusterInfo& cluster);
   void loadCluster(const Json::Object& cluster, bool added_via_api);
-  void postInitializeCluster(Cluster& cluster);
+  void postInitializeCluster(const PrimaryClusterData& cluster_data);
   void postThreadLocalClusterUpdate(const Cluster& primary_cluster,
+                                    LoadBalancerTableBuilder* lb_table_builder,
                                     const std::vector<HostSharedPtr>& hosts_added,
                                     const std::vector<HostSharedPtr>& hosts_removed);
+  void mergeMembershipUpdate(MembershipUpdate& pending_update, MembershipUpdate&& update);
+  void flushMembershipUpdates();
+  void runOnAllThreads(Event::PostCb cb);
 
   ClusterManagerFactory& factory_;
   Runtime::Loader& runtime_;
@@ -228,12 +349,19 @@ private:
   Runtime::RandomGenerator& random_;
   uint32_t thread_local_slot_;
   std::unordered_map<std::string, PrimaryClusterData> primary_clusters_;
+  std::mutex cluster_ids_lock_;
+  std::unordered_map<std::string, ClusterId> cluster_ids_;
   Optional<SdsConfig> sds_config_;
+  Optional<std::chrono::milliseconds> idle_cluster_timeout_;
   Outlier::EventLoggerSharedPtr outlier_event_logger_;
   const LocalInfo::LocalInfo& local_info_;
   CdsApiPtr cds_api_;
   ClusterManagerStats cm_stats_;
   ClusterManagerInitHelper init_helper_;
+  uint64_t membership_generation_{};
+  // The membership updates made since the last batch was posted to the threads, if any. A flush
+  // is posted to the main thread when the first of them is made.
+  std::unique_ptr<MembershipUpdateBatch> pending_membership_updates_;
 };
 
 } // Upstream
@@ -0,0 +1,179 @@
+#include "common/upstream/dynamic_forward_proxy_cluster.h"
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <vector>
+
+#include "envoy/common/exception.h"
+
+#include "common/common/utility.h"
+#include "common/network/utility.h"
+
+namespace Envoy {
+namespace Upstream {
+
+DynamicForwardProxyCluster::LoadBalancer::LoadBalancer(ClusterInfoConstSharedPtr info,
+                                                       Event::Dispatcher& dispatcher,
+                                                       Network::DnsResolverSharedPtr dns_resolver,
+                                                       HostsRemovedCb hosts_removed_cb)
+    : info_(info), dns_resolver_(dns_resolver), hosts_removed_cb_(hosts_removed_cb),
+      cleanup_timer_(dispatcher.createTimer([this]() -> void { cleanup(); })) {
+  cleanup_timer_->enableTimer(info_->hostCleanupInterval());
+}
+
+DynamicForwardProxyCluster::LoadBalancer::~LoadBalancer() {
+  std::vector<HostSharedPtr> hosts_removed;
+  for (const auto& entry : hosts_) {
+    if (entry.second.active_query_) {
+      entry.second.active_query_->cancel();
+    }
+    if (entry.second.host_) {
+      hosts_removed.push_back(entry.second.host_);
+    }
+  }
+
+  if (!hosts_removed.empty()) {
+    hosts_removed_cb_(hosts_removed);
+  }
+}
+
+HostConstSharedPtr
+DynamicForwardProxyCluster::LoadBalancer::chooseHost(const LoadBalancerContext* context) {
+  if (context == nullptr || context->downstreamHeaders() == nullptr ||
+      context->downstreamHeaders()->Host() == nullptr) {
+    return nullptr;
+  }
+
+  const std::string authority = context->downstreamHeaders()->Host()->value().c_str();
+  auto it = hosts_.find(authority);
+  if (it == hosts_.end()) {
+    std::string dns_name;
+    uint32_t port;
+    if (!parseAuthority(authority, *info_, dns_name, port)) {
+      return nullptr;
+    }
+    it = hosts_.emplace(authority, HostEntry(dns_name, port)).first;
+  }
+
+  // A name that failed to resolve is retried right away, which the DNS cache answers for as long
+  // as it caches the failure.
+  HostEntry& entry = it->second;
+  entry.used_ = true;
+  if (!entry.host_ && entry.active_query_ == nullptr) {
+    resolve(authority, entry);
+  }
+  return entry.host_;
+}
+
+void DynamicForwardProxyCluster::LoadBalancer::resolve(const std::string& authority,
+                                                       HostEntry& entry) {
+  // The callback runs before resolve() returns when the result is cached.
+  entry.active_query_ = dns_resolver_->resolve(
+      entry.dns_name_, info_->dnsLookupFamily(),
+      [this, authority](std::list<Network::Address::InstanceConstSharedPtr>&& address_list)
+          -> void { onResolved(authority, std::move(address_list)); });
+}
+
+void DynamicForwardProxyCluster::LoadBalancer::onResolved(
+    const std::string& authority,
+    std::list<Network::Address::InstanceConstSharedPtr>&& address_list) {
+  auto it = hosts_.find(authority);
+  ASSERT(it != hosts_.end());
+  HostEntry& entry = it->second;
+  entry.active_query_ = nullptr;
+
+  // A failed refresh keeps the previous address.
+  if (address_list.empty()) {
+    return;
+  }
+
+  Network::Address::InstanceConstSharedPtr address =
+      Network::Utility::getAddressWithPort(*address_list.front(), entry.port_);
+  if (entry.host_ && entry.host_->address()->asString() == address->asString()) {
+    return;
+  }
+
+  HostSharedPtr previous_host = entry.host_;
+  entry.host_.reset(new HostImpl(info_, entry.dns_name_, address, false, 1, ""));
+  if (previous_host) {
+    hosts_removed_cb_({previous_host});
+  }
+}
+
+void DynamicForwardProxyCluster::LoadBalancer::cleanup() {
+  std::vector<HostSharedPtr> hosts_removed;
+  for (auto it = hosts_.begin(); it != hosts_.end();) {
+    HostEntry& entry = it->second;
+    if (entry.used_) {
+      entry.used_ = false;
+      if (entry.active_query_ == nullptr) {
+        resolve(it->first, entry);
+      }
+      ++it;
+    } else {
+      if (entry.active_query_) {
+        entry.active_query_->cancel();
+      }
+      if (entry.host_) {
+        hosts_removed.push_back(entry.host_);
+      }
+      it = hosts_.erase(it);
+    }
+  }
+
+  if (!hosts_removed.empty()) {
+    hosts_removed_cb_(hosts_removed);
+  }
+  cleanup_timer_->enableTimer(info_->hostCleanupInterval());
+}
+
+DynamicForwardProxyCluster::DynamicForwardProxyCluster(const Json::Object& config,
+                                                       Runtime::Loader& runtime,
+                                                       Stats::Store& stats,
+                                                       Ssl::ContextManager& ssl_context_manager)
+    : ClusterImplBase(config, runtime, stats, ssl_context_manager) {
+  if (config.hasObject("hosts")) {
+    throw EnvoyException("dynamic_forward_proxy clusters must have no hosts");
+  }
+}
+
+bool DynamicForwardProxyCluster::parseAuthority(const std::string& authority,
+                                                const ClusterInfo& info, std::string& dns_name,
+                                                uint32_t& port) {
+  size_t port_start;
+  if (!authority.empty() && authority[0] == '[') {
+    // An IPv6 address.
+    const size_t end = authority.find(']');
+    if (end == std::string::npos) {
+      return false;
+    }
+    dns_name = authority.substr(1, end - 1);
+    port_start = end + 1;
+    if (port_start < authority.size() && authority[port_start] != ':') {
+      return false;
+    }
+  } else {
+    port_start = authority.find(':');
+    dns_name = authority.substr(0, port_start);
+  }
+
+  if (dns_name.empty()) {
+    return false;
+  }
+
+  port = info.sslContext() != nullptr ? 443 : 80;
+  if (port_start < authority.size()) {
+    uint64_t parsed_port;
+    if (!StringUtil::atoul(authority.c_str() + port_start + 1, parsed_port) || parsed_port == 0 ||
+        parsed_port > 65535) {
+      return false;
+    }
+    port = parsed_port;
+  }
+
+  return true;
+}
+
+} // Upstream
+} // Envoy
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
+#include "envoy/network/dns.h"
+
+#include "common/upstream/upstream_impl.h"
+
+namespace Envoy {
+namespace Upstream {
+
+/**
+ * The DynamicForwardProxyCluster is a cluster without configured hosts that routes each request to
+ * its authority (the host header). The hosts live in the load balancer of each worker, which
+ * resolves the DNS name of an authority the first time it sees it and keeps the host, along with
+ * its connection pools, for as long as requests to the authority keep arriving. Names are
+ * resolved through the server's DNS resolver, whose cache is shared by all workers, so a name is
+ * only queried once for the whole process no matter how many workers route to it.
+ *
+ * A host can only be chosen once its name has been resolved. The dynamic_forward_proxy HTTP filter
+ * holds requests until then, after which the load balancer is answered from the DNS cache.
+ */
+class DynamicForwardProxyCluster : public ClusterImplBase {
+public:
+  /**
+   * Worker local load balancer that maps authorities to hosts. Hosts that have not been chosen
+   * since the previous cleanup are removed every cleanup interval, and the names of the others are
+   * resolved again so that address changes are picked up.
+   */
+  class LoadBalancer : public Upstream::LoadBalancer {
+  public:
+    typedef std::function<void(const std::vector<HostSharedPtr>& hosts_removed)> HostsRemovedCb;
+
+    LoadBalancer(ClusterInfoConstSharedPtr info, Event::Dispatcher& dispatcher,
+                 Network::DnsResolverSharedPtr dns_resolver, HostsRemovedCb hosts_removed_cb);
+    ~LoadBalancer();
+
+    // Upstream::LoadBalancer
+    HostConstSharedPtr chooseHost(const LoadBalancerContext* context) override;
+
+  private:
+    struct HostEntry {
+      HostEntry(const std::string& dns_name, uint32_t port) : dns_name_(dns_name), port_(port) {}
+
+      const std::string dns_name_;
+      const uint32_t port_;
+      // Null until the name has been resolved for the first time.
+      HostSharedPtr host_;
+      Network::ActiveDnsQuery* active_query_{};
+      bool used_{};
+    };
+
+    void resolve(const std::string& authority, HostEntry& entry);
+    void onResolved(const std::string& authority,
+                    std::list<Network::Address::InstanceConstSharedPtr>&& address_list);
+    void cleanup();
+
+    ClusterInfoConstSharedPtr info_;
+    Network::DnsResolverSharedPtr dns_resolver_;
+    HostsRemovedCb hosts_removed_cb_;
+    // Keyed by the authority of the requests.
+    std::unordered_map<std::string, HostEntry> hosts_;
+    Event::TimerPtr cleanup_timer_;
+  };
+
+  DynamicForwardProxyCluster(const Json::Object& config, Runtime::Loader& runtime,
+                             Stats::Store& stats, Ssl::ContextManager& ssl_context_manager);
+
+  /**
+   * Split the authority of a request into the DNS name and the port to connect to.
+   * @param authority supplies the authority, e.g. "example.com:8080" or "[::1]".
+   * @param info supplies the cluster, whose connections use port 443 if they are secure and port
+   *        80 otherwise unless the authority has a port.
+   * @param dns_name is set to the DNS name, or IP address, of the authority.
+   * @param port is set to the port to connect to.
+   * @return bool whether the authority is valid.
+   */
+  static bool parseAuthority(const std::string& authority, const ClusterInfo& info,
+                             std::string& dns_name, uint32_t& port);
+
+  // Upstream::Cluster
+  void initialize() override {}
+  InitializePhase initializePhase() const override { return InitializePhase::Primary; }
+  void setInitializedCb(std::function<void()> callback) override { callback(); }
+};
+
+} // Upstream
+} // Envoy
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <queue>
+#include <vector>
+
+#include "common/common/assert.h"
+
+namespace Envoy {
+namespace Upstream {
+
+/**
+ * Earliest deadline first scheduler for weighted round robin. Each entry is given a deadline of
+ * 1/weight past the current time and the entry with the earliest deadline is picked next, so over
+ * time entries are picked in proportion to their weight and picks of heavy entries are interleaved
+ * with the others rather than bunched together. Ties are broken by insertion order, which makes
+ * entries of equal weight plain round robin. Pick is O(log N) and memory is O(N) regardless of the
+ * weights.
+ */
+template <class C> class EdfScheduler {
+public:
+  /**
+   * Add an entry to the scheduler.
+   * @param weight supplies the weight of the entry. Must be greater than 0.
+   * @param entry supplies the entry.
+   */
+  void add(double weight, std::shared_ptr<C> entry) {
+    ASSERT(weight > 0);
+    queue_.push({current_time_ + 1.0 / weight, order_offset_++, weight, entry});
+  }
+
+  /**
+   * Pick the entry with the earliest deadline and schedule it again.
+   * @return the picked entry or nullptr if the scheduler is empty.
+   */
+  std::shared_ptr<C> pick() {
+    if (queue_.empty()) {
+      return nullptr;
+    }
+
+    EdfEntry edf_entry = queue_.top();
+    queue_.pop();
+    current_time_ = edf_entry.deadline_;
+    add(edf_entry.weight_, edf_entry.entry_);
+    return edf_entry.entry_;
+  }
+
+  /**
+   * @return the number of entries in the scheduler.
+   */
+  size_t size() const { return queue_.size(); }
+
+private:
+  struct EdfEntry {
+    double deadline_;
+    uint64_t order_offset_;
+    double weight_;
+    std::shared_ptr<C> entry_;
+
+    // std::priority_queue is a max heap, so the comparison is reversed to put the earliest
+    // deadline on top.
+    bool operator<(const EdfEntry& other) const {
+      return deadline_ == other.deadline_ ? order_offset_ > other.order_offset_
+                                          : deadline_ > other.deadline_;
+    }
+  };
+
+  double current_time_{};
+  uint64_t order_offset_{};
+  std::priority_queue<EdfEntry> queue_;
+};
+
+} // Upstream
+} // Envoy
@@ -16,6 +16,8 @@
 #include "common/common/enum_to_int.h"
 #include "common/common/hex.h"
 #include "common/common/utility.h"
+#include "common/grpc/codec.h"
+#include "common/grpc/common.h"
 #include "common/http/codec_client.h"
 #include "common/http/header_map_impl.h"
 #include "common/http/headers.h"
@@ -23,8 +25,11 @@
 #include "common/json/config_schemas.h"
 #include "common/json/json_loader.h"
 #include "common/redis/conn_pool_impl.h"
+#include "common/upstream/grpc_health.pb.h"
 #include "common/upstream/host_utility.h"
 
+#include "spdlog/spdlog.h"
+
 namespace Envoy {
 namespace Upstream {
 
@@ -35,7 +40,7 @@ HealthCheckerPtr HealthCheckerFactory::create(const Json::Object& hc_config,
   hc_config.validateSchema(Json::Schema::CLUSTER_HEALTH_CHECK_SCHEMA);
 
   const std::string hc_type = hc_config.getString("type");
-  if (hc_type == "http") {
+  if (hc_type == "http" || hc_type == "grpc") {
     return HealthCheckerPtr{
         new ProdHttpHealthCheckerImpl(cluster, hc_config, dispatcher, runtime, random)};
   } else if (hc_type == "tcp") {
@@ -60,12 +65,28 @@ HealthCheckerImplBase::HealthCheckerImplBase(const Cluster& cluster, const Json:
       healthy_threshold_(config.getInteger("healthy_threshold")),
       stats_(generateStats(cluster.info()->statsScope())), runtime_(runtime), random_(random),
       interval_(config.getInteger("interval_ms")),
-      interval_jitter_(config.getInteger("interval_jitter_ms", 0)) {
+      interval_jitter_(config.getInteger("interval_jitter_ms", 0)),
+      share_across_clusters_(config.getBoolean("share_across_clusters", false)),
+      config_hash_(config.hash()) {
+  if (config.hasObject("timer_resolution_ms")) {
+    timer_wheel_.reset(new Event::TimerWheel(
+        dispatcher, std::chrono::milliseconds(config.getInteger("timer_resolution_ms")),
+        ProdMonotonicTimeSource::instance_));
+  }
+
   cluster_.addMemberUpdateCb([this](const std::vector<HostSharedPtr>& hosts_added,
                                     const std::vector<HostSharedPtr>& hosts_removed)
                                  -> void { onClusterMemberUpdate(hosts_added, hosts_removed); });
 }
 
+Event::TimerPtr HealthCheckerImplBase::createTimer(Event::TimerCb cb) {
+  if (timer_wheel_) {
+    return timer_wheel_->createTimer(cb);
+  }
+
+  return dispatcher_.createTimer(cb);
+}
+
 void HealthCheckerImplBase::decHealthy() {
   ASSERT(local_process_healthy_ > 0);
   local_process_healthy_--;
@@ -143,13 +164,20 @@ void HealthCheckerImplBase::runCallbacks(HostSharedPtr host, bool changed_state)
   }
 }
 
+std::unordered_map<std::string, HealthCheckerImplBase::ActiveHealthCheckSession*>&
+HealthCheckerImplBase::sharedSessions() {
+  static std::unordered_map<std::string, ActiveHealthCheckSession*>* shared_sessions =
+      new std::unordered_map<std::string, ActiveHealthCheckSession*>();
+  return *shared_sessions;
+}
+
 void HealthCheckerImplBase::start() { addHosts(cluster_.hosts()); }
 
 HealthCheckerImplBase::ActiveHealthCheckSession::ActiveHealthCheckSession(
     HealthCheckerImplBase& parent, HostSharedPtr host)
     : host_(host), parent_(parent),
-      interval_timer_(parent.dispatcher_.createTimer([this]() -> void { onIntervalBase(); })),
-      timeout_timer_(parent.dispatcher_.createTimer([this]() -> void { onTimeoutBase(); })) {
+      interval_timer_(parent.createTimer([this]() -> void { onIntervalBase(); })),
+      timeout_timer_(parent.createTimer([this]() -> void { onTimeoutBase(); })) {
 
   if (!host->healthFlagGet(Host::HealthFlag::FAILED_ACTIVE_HC)) {
     parent.incHealthy();
@@ -160,9 +188,58 @@ HealthCheckerImplBase::ActiveHealthCheckSession::~ActiveHealthCheckSession() {
   if (!host_->healthFlagGet(Host::HealthFlag::FAILED_ACTIVE_HC)) {
     parent_.decHealthy();
   }
+
+  if (leader_) {
+    leader_->followers_.remove(this);
+  } else if (!shared_key_.empty()) {
+    auto& shared_sessions = sharedSessions();
+    if (followers_.empty()) {
+      shared_sessions.erase(shared_key_);
+    } else {
+      // Hand the checks over to the oldest follower. It starts checking at its next interval so
+      // that no connections are created from within this destructor.
+      ActiveHealthCheckSession* new_leader = followers_.front();
+      followers_.pop_front();
+      new_leader->leader_ = nullptr;
+      new_leader->followers_.swap(followers_);
+      for (ActiveHealthCheckSession* follower : new_leader->followers_) {
+        follower->leader_ = new_leader;
+      }
+      shared_sessions[shared_key_] = new_leader;
+      new_leader->interval_timer_->enableTimer(new_leader->parent_.interval());
+    }
+  }
+}
+
+void HealthCheckerImplBase::ActiveHealthCheckSession::start() {
+  if (parent_.share_across_clusters_) {
+    shared_key_ = fmt::format("{}_{}", host_->address()->asString(), parent_.config_hash_);
+    auto& shared_sessions = sharedSessions();
+    auto leader = shared_sessions.find(shared_key_);
+    if (leader != shared_sessions.end()) {
+      // Another cluster already checks this address with the same config. Follow its results.
+      leader_ = leader->second;
+      leader_->followers_.push_back(this);
+      return;
+    }
+
+    shared_sessions[shared_key_] = this;
+  }
+
+  onIntervalBase();
 }
 
 void HealthCheckerImplBase::ActiveHealthCheckSession::handleSuccess() {
+  recordSuccess();
+  for (ActiveHealthCheckSession* follower : followers_) {
+    follower->recordSuccess();
+  }
+
+  timeout_timer_->disableTimer();
+  interval_timer_->enableTimer(parent_.interval());
+}
+
+void HealthCheckerImplBase::ActiveHealthCheckSession::recordSuccess() {
   // If we are healthy, reset the # of unhealthy to zero.
   num_unhealthy_ = 0;
 
@@ -181,12 +258,19 @@ void HealthCheckerImplBase::ActiveHealthCheckSession::handleSuccess() {
   parent_.stats_.success_.inc();
   first_check_ = false;
   parent_.runCallbacks(host_, changed_state);
+}
+
+void HealthCheckerImplBase::ActiveHealthCheckSession::handleFailure(bool network_failure) {
+  recordFailure(network_failure);
+  for (ActiveHealthCheckSession* follower : followers_) {
+    follower->recordFailure(network_failure);
+  }
 
   timeout_timer_->disableTimer();
   interval_timer_->enableTimer(parent_.interval());
 }
 
-void HealthCheckerImplBase::ActiveHealthCheckSession::handleFailure(bool network_failure) {
+void HealthCheckerImplBase::ActiveHealthCheckSession::recordFailure(bool network_failure) {
   // If we are unhealthy, reset the # of healthy to zero.
   num_healthy_ = 0;
 
@@ -206,9 +290,6 @@ void HealthCheckerImplBase::ActiveHealthCheckSession::handleFailure(bool network
 
   first_check_ = false;
   parent_.runCallbacks(host_, changed_state);
-
-  timeout_timer_->disableTimer();
-  interval_timer_->enableTimer(parent_.interval());
 }
 
 void HealthCheckerImplBase::ActiveHealthCheckSession::onIntervalBase() {
@@ -227,7 +308,10 @@ HttpHealthCheckerImpl::HttpHealthCheckerImpl(const Cluster& cluster, const Json:
                                              Runtime::Loader& runtime,
                                              Runtime::RandomGenerator& random)
     : HealthCheckerImplBase(cluster, config, dispatcher, runtime, random),
-      path_(config.getString("path")) {
+      grpc_(config.getString("type") == "grpc"),
+      path_(grpc_ ? EMPTY_STRING : config.getString("path")),
+      codec_type_(grpc_ || config.getBoolean("use_http2", false) ? Http::CodecClient::Type::HTTP2
+                                                                 : Http::CodecClient::Type::HTTP1) {
   if (config.hasObject("service_name")) {
     service_name_.value(config.getString("service_name"));
   }
@@ -254,7 +338,28 @@ void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::decodeHeaders(
   }
 }
 
+void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::decodeData(Buffer::Instance& data,
+                                                                    bool end_stream) {
+  if (parent_.grpc_) {
+    response_body_.move(data);
+  }
+
+  if (end_stream) {
+    onResponseComplete();
+  }
+}
+
+void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::decodeTrailers(
+    Http::HeaderMapPtr&& trailers) {
+  response_trailers_ = std::move(trailers);
+  onResponseComplete();
+}
+
 void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::onEvent(uint32_t events) {
+  if (events & Network::ConnectionEvent::Connected) {
+    connected_ = true;
+  }
+
   if (events & Network::ConnectionEvent::RemoteClose ||
       events & Network::ConnectionEvent::LocalClose) {
     // For the raw disconnect event, we are either between intervals in which case we already have
@@ -269,12 +374,31 @@ void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::onInterval() {
     Upstream::Host::CreateConnectionData conn = host_->createConnection(parent_.dispatcher_);
     client_.reset(parent_.createCodecClient(conn));
     client_->addConnectionCallbacks(*this);
+    connected_ = false;
     expect_reset_ = false;
   }
 
+  // The encoder is kept until the response completes so that a timed out HTTP/2 check can reset
+  // just its own stream.
   request_encoder_ = &client_->newStream(*this);
   request_encoder_->getStream().addCallbacks(*this);
 
+  if (parent_.grpc_) {
+    Http::HeaderMapImpl request_headers{
+        {Http::Headers::get().UserAgent, Http::Headers::get().UserAgentValues.EnvoyHealthChecker}};
+    Grpc::Common::prepareHeaders(request_headers, parent_.cluster_.info()->name(),
+                                 grpc::health::v1::Health::descriptor()->full_name(), "Check");
+
+    grpc::health::v1::HealthCheckRequest request;
+    if (parent_.service_name_.valid()) {
+      request.set_service(parent_.service_name_.value());
+    }
+
+    request_encoder_->encodeHeaders(request_headers, false);
+    request_encoder_->encodeData(*Grpc::Common::serializeBody(request), true);
+    return;
+  }
+
   Http::HeaderMapImpl request_headers{
       {Http::Headers::get().Method, "GET"},
       {Http::Headers::get().Host, parent_.cluster_.info()->name()},
@@ -282,10 +406,11 @@ void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::onInterval() {
       {Http::Headers::get().UserAgent, Http::Headers::get().UserAgentValues.EnvoyHealthChecker}};
 
   request_encoder_->encodeHeaders(request_headers, true);
-  request_encoder_ = nullptr;
 }
 
 void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::onResetStream(Http::StreamResetReason) {
+  request_encoder_ = nullptr;
+  resetResponse();
   if (expect_reset_) {
     return;
   }
@@ -318,8 +443,41 @@ bool HttpHealthCheckerImpl::HttpActiveHealthCheckSession::isHealthCheckSucceeded
   return true;
 }
 
+bool HttpHealthCheckerImpl::HttpActiveHealthCheckSession::isGrpcHealthCheckSucceeded() {
+  try {
+    Grpc::Common::validateResponse(*response_headers_, response_trailers_.get());
+  } catch (const Grpc::Exception& e) {
+    conn_log_debug("hc grpc error={} health_flags={}", *client_, e.what(),
+                   HostUtility::healthFlagsToString(*host_));
+    return false;
+  }
+
+  Grpc::Decoder decoder;
+  std::vector<Grpc::Frame> frames;
+  grpc::health::v1::HealthCheckResponse response;
+  if (!decoder.decode(response_body_, frames) || frames.size() != 1 ||
+      frames[0].flags_ != Grpc::GRPC_FH_DEFAULT ||
+      !Grpc::Common::parseBody(*frames[0].data_, response)) {
+    conn_log_debug("hc invalid grpc response health_flags={}", *client_,
+                   HostUtility::healthFlagsToString(*host_));
+    return false;
+  }
+
+  conn_log_debug("hc grpc status={} health_flags={}", *client_,
+                 grpc::health::v1::HealthCheckResponse::ServingStatus_Name(response.status()),
+                 HostUtility::healthFlagsToString(*host_));
+  return response.status() == grpc::health::v1::HealthCheckResponse::SERVING;
+}
+
+void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::resetResponse() {
+  response_headers_.reset();
+  response_trailers_.reset();
+  response_body_.drain(response_body_.length());
+}
+
 void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::onResponseComplete() {
-  if (isHealthCheckSucceeded()) {
+  request_encoder_ = nullptr;
+  if (parent_.grpc_ ? isGrpcHealthCheckSucceeded() : isHealthCheckSucceeded()) {
     handleSuccess();
   } else {
     handleFailure(false);
@@ -332,7 +490,7 @@ void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::onResponseComplete() {
     client_->close();
   }
 
-  response_headers_.reset();
+  resetResponse();
 }
 
 void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::onTimeout() {
@@ -341,12 +499,18 @@ void HttpHealthCheckerImpl::HttpActiveHealthCheckSession::onTimeout() {
 
   // If there is an active request it will get reset, so make sure we ignore the reset.
   expect_reset_ = true;
-  client_->close();
+  if (parent_.codec_type_ == Http::CodecClient::Type::HTTP2 && connected_ && request_encoder_) {
+    // Only give up on the timed out stream so that the next check reuses the connection.
+    request_encoder_->getStream().resetStream(Http::StreamResetReason::LocalReset);
+    expect_reset_ = false;
+  } else {
+    client_->close();
+  }
 }
 
 Http::CodecClient*
 ProdHttpHealthCheckerImpl::createCodecClient(Upstream::Host::CreateConnectionData& data) {
-  return new Http::CodecClientProd(Http::CodecClient::Type::HTTP1, std::move(data.connection_),
+  return new Http::CodecClientProd(codec_type_, std::move(data.connection_),
                                    data.host_description_);
 }
 
@@ -363,17 +527,7 @@ TcpHealthCheckMatcher::loadJsonBytes(const std::vector<Json::ObjectSharedPtr>& b
 }
 
 bool TcpHealthCheckMatcher::match(const MatchSegments& expected, const Buffer::Instance& buffer) {
-  uint64_t start_index = 0;
-  for (const std::vector<uint8_t>& segment : expected) {
-    ssize_t search_result = buffer.search(&segment[0], segment.size(), start_index);
-    if (search_result == -1) {
-      return false;
-    }
-
-    start_index = search_result + segment.size();
-  }
-
-  return true;
+  return buffer.searchSequence(expected, 0) != -1;
 }
 
 TcpHealthCheckerImpl::TcpHealthCheckerImpl(const Cluster& cluster, const Json::Object& config,
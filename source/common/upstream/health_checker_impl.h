@@ -16,7 +16,9 @@
 #include "envoy/runtime/runtime.h"
 #include "envoy/upstream/health_checker.h"
 
+#include "common/buffer/buffer_impl.h"
 #include "common/common/logger.h"
+#include "common/event/timer_wheel.h"
 #include "common/http/codec_client.h"
 #include "common/json/json_loader.h"
 #include "common/json/json_validator.h"
@@ -77,7 +79,7 @@ protected:
   class ActiveHealthCheckSession {
   public:
     virtual ~ActiveHealthCheckSession();
-    void start() { onIntervalBase(); }
+    void start();
 
   protected:
     ActiveHealthCheckSession(HealthCheckerImplBase& parent, HostSharedPtr host);
@@ -92,6 +94,8 @@ protected:
     void onIntervalBase();
     virtual void onTimeout() PURE;
     void onTimeoutBase();
+    void recordFailure(bool network_failure);
+    void recordSuccess();
 
     HealthCheckerImplBase& parent_;
     Event::TimerPtr interval_timer_;
@@ -99,6 +103,11 @@ protected:
     uint32_t num_unhealthy_{};
     uint32_t num_healthy_{};
     bool first_check_{true};
+    // When checks are shared across clusters, a single leader session per address and config
+    // performs the checks and feeds each result to its followers, which do not check themselves.
+    std::string shared_key_;
+    ActiveHealthCheckSession* leader_{};
+    std::list<ActiveHealthCheckSession*> followers_;
   };
 
   typedef std::unique_ptr<ActiveHealthCheckSession> ActiveHealthCheckSessionPtr;
@@ -109,6 +118,12 @@ protected:
 
   virtual ActiveHealthCheckSessionPtr makeSession(HostSharedPtr host) PURE;
 
+  /**
+   * Create a timer for a session. If the checker is configured with a timer resolution, the timer
+   * is scheduled on the checker's timer wheel, otherwise it is a dispatcher timer.
+   */
+  Event::TimerPtr createTimer(Event::TimerCb cb);
+
   const Cluster& cluster_;
   Event::Dispatcher& dispatcher_;
   const std::chrono::milliseconds timeout_;
@@ -129,17 +144,30 @@ private:
   void refreshHealthyStat();
   void runCallbacks(HostSharedPtr host, bool changed_state);
 
+  /**
+   * @return the process wide map of shared check key to leader session. Like all health checking
+   *         this is only accessed from the main thread.
+   */
+  static std::unordered_map<std::string, ActiveHealthCheckSession*>& sharedSessions();
+
   static const std::chrono::milliseconds NO_TRAFFIC_INTERVAL;
 
   std::list<HostStatusCb> callbacks_;
   const std::chrono::milliseconds interval_;
   const std::chrono::milliseconds interval_jitter_;
+  const bool share_across_clusters_;
+  const uint64_t config_hash_;
+  // Must be declared before the sessions so that it outlives their timers.
+  std::unique_ptr<Event::TimerWheel> timer_wheel_;
   std::unordered_map<HostSharedPtr, ActiveHealthCheckSessionPtr> active_sessions_;
   uint64_t local_process_healthy_{};
 };
 
 /**
- * HTTP health checker implementation. Connection keep alive is used where possible.
+ * HTTP health checker implementation. Connection keep alive is used where possible. Over HTTP/2
+ * every check is a new stream on the host's persistent connection and a check that times out only
+ * resets its own stream. The same checker also implements the gRPC health checking protocol, which
+ * always uses HTTP/2.
  */
 class HttpHealthCheckerImpl : public HealthCheckerImplBase {
 public:
@@ -157,6 +185,8 @@ private:
 
     void onResponseComplete();
     bool isHealthCheckSucceeded();
+    bool isGrpcHealthCheckSucceeded();
+    void resetResponse();
 
     // ActiveHealthCheckSession
     void onInterval() override;
@@ -164,12 +194,8 @@ private:
 
     // Http::StreamDecoder
     void decodeHeaders(Http::HeaderMapPtr&& headers, bool end_stream) override;
-    void decodeData(Buffer::Instance&, bool end_stream) override {
-      if (end_stream) {
-        onResponseComplete();
-      }
-    }
-    void decodeTrailers(Http::HeaderMapPtr&&) override { onResponseComplete(); }
+    void decodeData(Buffer::Instance& data, bool end_stream) override;
+    void decodeTrailers(Http::HeaderMapPtr&& trailers) override;
 
     // Http::StreamCallbacks
     void onResetStream(Http::StreamResetReason reason) override;
@@ -177,10 +203,17 @@ private:
     // Network::ConnectionCallbacks
     void onEvent(uint32_t events) override;
 
+    // Http::StreamCallbacks and Network::ConnectionCallbacks
+    void onAboveWriteBufferHighWatermark() override {}
+    void onBelowWriteBufferLowWatermark() override {}
+
     HttpHealthCheckerImpl& parent_;
     Http::CodecClientPtr client_;
     Http::StreamEncoder* request_encoder_{};
     Http::HeaderMapPtr response_headers_;
+    Http::HeaderMapPtr response_trailers_;
+    Buffer::OwnedImpl response_body_;
+    bool connected_{};
     bool expect_reset_{};
   };
 
@@ -193,8 +226,12 @@ private:
     return ActiveHealthCheckSessionPtr{new HttpActiveHealthCheckSession(*this, host)};
   }
 
+  const bool grpc_;
   const std::string path_;
   Optional<std::string> service_name_;
+
+protected:
+  const Http::CodecClient::Type codec_type_;
 };
 
 /**
@@ -253,7 +290,7 @@ public:
  */
 class TcpHealthCheckMatcher {
 public:
-  typedef std::list<std::vector<uint8_t>> MatchSegments;
+  typedef std::vector<std::vector<uint8_t>> MatchSegments;
 
   static MatchSegments loadJsonBytes(const std::vector<Json::ObjectSharedPtr>& byte_array);
   static bool match(const MatchSegments& expected, const Buffer::Instance& buffer);
@@ -277,6 +314,8 @@ private:
 
     // Network::ConnectionCallbacks
     void onEvent(uint32_t events) override { parent_.onEvent(events); }
+    void onAboveWriteBufferHighWatermark() override {}
+    void onBelowWriteBufferLowWatermark() override {}
 
     // Network::ReadFilter
     Network::FilterStatus onData(Buffer::Instance& data) override {
@@ -347,6 +386,11 @@ private:
       // Allow the main HC infra to control timeout.
       return parent_.timeout_ * 2;
     }
+    // Health checks send a single request at a time, so there is nothing to batch.
+    uint32_t maxBatchSize() const override { return 1; }
+    std::chrono::milliseconds batchFlushDelay() const override {
+      return std::chrono::milliseconds(0);
+    }
 
     // Redis::ConnPool::PoolCallbacks
     void onResponse(Redis::RespValuePtr&& value) override;
@@ -354,6 +398,8 @@ private:
 
     // Network::ConnectionCallbacks
     void onEvent(uint32_t events) override;
+    void onAboveWriteBufferHighWatermark() override {}
+    void onBelowWriteBufferLowWatermark() override {}
 
     RedisHealthCheckerImpl& parent_;
     Redis::ConnPool::ClientPtr client_;
@@ -1,6 +1,8 @@
 #include "common/upstream/load_balancer_impl.h"
 
+#include <algorithm>
 #include <cstdint>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -9,19 +11,34 @@
 #include "envoy/upstream/upstream.h"
 
 #include "common/common/assert.h"
+#include "common/runtime/key_registry.h"
 
 namespace Envoy {
 namespace Upstream {
 
-static const std::string RuntimeZoneEnabled = "upstream.zone_routing.enabled";
-static const std::string RuntimeMinClusterSize = "upstream.zone_routing.min_cluster_size";
-static const std::string RuntimePanicThreshold = "upstream.healthy_panic_threshold";
+static const Runtime::Key RuntimeZoneEnabled =
+    Runtime::KeyRegistry::registerKey("upstream.zone_routing.enabled");
+static const Runtime::Key RuntimeMinClusterSize =
+    Runtime::KeyRegistry::registerKey("upstream.zone_routing.min_cluster_size");
+static const Runtime::Key RuntimePanicThreshold =
+    Runtime::KeyRegistry::registerKey("upstream.healthy_panic_threshold");
+static const Runtime::Key RuntimeWeightEnabled =
+    Runtime::KeyRegistry::registerKey("upstream.weight_enabled");
+static const Runtime::Key RuntimeP2cEnabled =
+    Runtime::KeyRegistry::registerKey("upstream.least_request.p2c_enabled");
+static const Runtime::Key RuntimePeakEwmaEnabled =
+    Runtime::KeyRegistry::registerKey("upstream.least_request.peak_ewma_enabled");
 
 LoadBalancerBase::LoadBalancerBase(const HostSet& host_set, const HostSet* local_host_set,
                                    ClusterStats& stats, Runtime::Loader& runtime,
                                    Runtime::RandomGenerator& random)
     : stats_(stats), runtime_(runtime), random_(random), host_set_(host_set),
       local_host_set_(local_host_set) {
+  regeneratePriorityStructures();
+  host_set_.addMemberUpdateCb(
+      [this](const std::vector<HostSharedPtr>&, const std::vector<HostSharedPtr>&)
+          -> void { regeneratePriorityStructures(); });
+
   if (local_host_set_) {
     host_set_.addMemberUpdateCb(
         [this](const std::vector<HostSharedPtr>&, const std::vector<HostSharedPtr>&)
@@ -62,41 +79,147 @@ void LoadBalancerBase::regenerateZoneRoutingStructures() {
   // If we cannot route all requests to the same zone, calculate what percentage can be routed.
   // For example, if local percentage is 20% and upstream is 10%
   // we can route only 50% of requests directly.
-  local_percent_to_route_ = upstream_percentage[0] * 10000 / local_percentage[0];
+  const uint64_t local_percent_to_route = upstream_percentage[0] * 10000 / local_percentage[0];
 
   // Local zone does not have additional capacity (we have already routed what we could).
   // Now we need to figure out how much traffic we can route cross zone and to which exact zone
   // we should route. Percentage of requests routed cross zone to a specific zone needed be
   // proportional to the residual capacity upstream zone has.
-  //
-  // residual_capacity contains capacity left in a given zone, we keep accumulating residual
-  // capacity to make search for sampled value easier.
   // For example, if we have the following upstream and local percentage:
   // local_percentage: 40000 40000 20000
   // upstream_percentage: 25000 50000 25000
-  // Residual capacity would look like: 0 10000 5000. Now we need to sample proportionally to
-  // bucket sizes (residual capacity). For simplicity of finding where specific
-  // sampled value is, we accumulate values in residual capacity. This is what it will look like:
-  // residual_capacity: 0 10000 15000
-  // Now to find a zone to route (bucket) we could simply iterate over residual_capacity searching
-  // where sampled value is placed.
-  residual_capacity_.resize(num_zones);
-
-  // Local zone (index 0) does not have residual capacity as we have routed all we could.
-  residual_capacity_[0] = 0;
+  // Residual capacity would look like: 0 10000 5000.
+  std::vector<uint64_t> residual_capacity(num_zones);
+  uint64_t total_residual_capacity = 0;
   for (size_t i = 1; i < num_zones; ++i) {
     // Only route to the zones that have additional capacity.
     if (upstream_percentage[i] > local_percentage[i]) {
-      residual_capacity_[i] =
-          residual_capacity_[i - 1] + upstream_percentage[i] - local_percentage[i];
-    } else {
-      // Zone with index "i" does not have residual capacity, but we keep accumulating previous
-      // values to make search easier on the next step.
-      residual_capacity_[i] = residual_capacity_[i - 1];
+      residual_capacity[i] = upstream_percentage[i] - local_percentage[i];
+      total_residual_capacity += residual_capacity[i];
+    }
+  }
+
+  // The final probability of each zone is then the local share for zone 0 plus the cross zone
+  // share split by residual capacity. Both are expressed over a common denominator so the weights
+  // stay integral. This is *extremely* unlikely but it is possible due to rounding errors when
+  // calculating zone percentages that no zone has residual capacity. In that case the cross zone
+  // share is spread evenly over all zones.
+  const uint64_t cross_zone_percent = 10000 - local_percent_to_route;
+  std::vector<uint64_t> weights(num_zones);
+  zone_no_capacity_left_ = total_residual_capacity == 0;
+  if (zone_no_capacity_left_) {
+    weights[0] = local_percent_to_route * num_zones + cross_zone_percent;
+    for (size_t i = 1; i < num_zones; ++i) {
+      weights[i] = cross_zone_percent;
+    }
+  } else {
+    weights[0] = local_percent_to_route * total_residual_capacity;
+    for (size_t i = 1; i < num_zones; ++i) {
+      weights[i] = cross_zone_percent * residual_capacity[i];
     }
   }
+
+  zone_alias_table_ = AliasTable(weights);
 };
 
+uint64_t LoadBalancerBase::healthPercent(uint64_t healthy_hosts, uint64_t hosts) {
+  // The overprovisioning factor of 1.4, in percent.
+  static const uint64_t OverprovisioningFactor = 140;
+  return hosts == 0 ? 0 : std::min<uint64_t>(100, OverprovisioningFactor * healthy_hosts / hosts);
+}
+
+void LoadBalancerBase::regeneratePriorityStructures() {
+  const std::vector<HostSharedPtr>& hosts = host_set_.hosts();
+  priority_levels_.clear();
+  priority_routing_ = false;
+  if (hosts.empty()) {
+    return;
+  }
+
+  // All hosts belong to the same cluster, so any of them supplies the locality weights.
+  const std::unordered_map<std::string, uint32_t>& locality_weights =
+      hosts[0]->cluster().localityWeights();
+  priority_routing_ = !locality_weights.empty();
+  for (const HostSharedPtr& host : hosts) {
+    priority_routing_ |= host->priority() != 0;
+  }
+  if (!priority_routing_) {
+    return;
+  }
+
+  struct Locality {
+    uint64_t hosts_{};
+    std::vector<HostSharedPtr> healthy_hosts_;
+  };
+
+  // Ordered by priority and then by zone so that the structures do not depend on the host order.
+  std::map<uint32_t, std::map<std::string, Locality>> levels;
+  for (const HostSharedPtr& host : hosts) {
+    levels[host->priority()][host->zone()].hosts_++;
+  }
+  for (const HostSharedPtr& host : host_set_.healthyHosts()) {
+    levels[host->priority()][host->zone()].healthy_hosts_.push_back(host);
+  }
+
+  std::vector<uint64_t> level_health;
+  for (auto& level : levels) {
+    PriorityLevel priority_level;
+    std::vector<uint64_t> locality_weight;
+    uint64_t level_hosts = 0;
+    uint64_t level_healthy_hosts = 0;
+    for (auto& locality : level.second) {
+      const uint64_t healthy_hosts = locality.second.healthy_hosts_.size();
+      level_hosts += locality.second.hosts_;
+      level_healthy_hosts += healthy_hosts;
+      if (healthy_hosts == 0) {
+        continue;
+      }
+
+      // The health is scaled further so that large localities with few healthy hosts keep a non
+      // zero weight.
+      const auto weight = locality_weights.find(locality.first);
+      const uint64_t health = std::max<uint64_t>(
+          1, std::min<uint64_t>(10000, 14000 * healthy_hosts / locality.second.hosts_));
+      locality_weight.push_back((weight == locality_weights.end() ? 1 : weight->second) * health);
+      priority_level.locality_hosts_.emplace_back(std::move(locality.second.healthy_hosts_));
+    }
+
+    if (!locality_weight.empty()) {
+      priority_level.locality_table_ = AliasTable(locality_weight);
+    }
+    level_health.push_back(healthPercent(level_healthy_hosts, level_hosts));
+    priority_levels_.emplace_back(std::move(priority_level));
+  }
+
+  uint64_t total_health = 0;
+  for (uint64_t health : level_health) {
+    total_health += health;
+  }
+  priority_health_ = std::min<uint64_t>(100, total_health);
+  priority_load_.fill(0);
+  if (total_health == 0) {
+    return;
+  }
+
+  // If the levels together cannot take all of the traffic, it is spread in proportion to their
+  // health. The percents lost to rounding go to the lowest level with any health.
+  size_t percent = 0;
+  uint64_t remaining = 100;
+  for (size_t i = 0; i < level_health.size(); ++i) {
+    uint64_t load = total_health >= 100 ? std::min(remaining, level_health[i])
+                                        : 100 * level_health[i] / total_health;
+    remaining -= load;
+    for (; load > 0; --load) {
+      priority_load_[percent++] = i;
+    }
+    if (level_health[i] > 0) {
+      for (size_t j = percent; j < 100; ++j) {
+        priority_load_[j] = i;
+      }
+    }
+  }
+}
+
 bool LoadBalancerBase::earlyExitNonZoneRouting() {
   if (host_set_.healthyHostsPerZone().size() < 2) {
     return true;
@@ -126,6 +249,11 @@ bool LoadBalancerUtility::isGlobalPanic(const HostSet& host_set, ClusterStats& s
                                         Runtime::Loader& runtime) {
   uint64_t global_panic_threshold =
       std::min<uint64_t>(100, runtime.snapshot().getInteger(RuntimePanicThreshold, 50));
+  return isGlobalPanic(host_set, stats, global_panic_threshold);
+}
+
+bool LoadBalancerUtility::isGlobalPanic(const HostSet& host_set, ClusterStats& stats,
+                                        uint64_t global_panic_threshold) {
   double healthy_percent = host_set.hosts().size() == 0
                                ? 0
                                : 100.0 * host_set.healthyHosts().size() / host_set.hosts().size();
@@ -156,9 +284,7 @@ const std::vector<HostSharedPtr>& LoadBalancerBase::tryChooseLocalZoneHosts() {
   ASSERT(zone_routing_state_ != ZoneRoutingState::NoZoneRouting);
 
   // At this point it's guaranteed to be at least 2 zones.
-  size_t number_of_zones = host_set_.healthyHostsPerZone().size();
-
-  ASSERT(number_of_zones >= 2U);
+  ASSERT(host_set_.healthyHostsPerZone().size() >= 2U);
   ASSERT(local_host_set_->healthyHostsPerZone().size() == host_set_.healthyHostsPerZone().size());
 
   // Try to push all of the requests to the same zone first.
@@ -168,42 +294,45 @@ const std::vector<HostSharedPtr>& LoadBalancerBase::tryChooseLocalZoneHosts() {
   }
 
   ASSERT(zone_routing_state_ == ZoneRoutingState::ZoneResidual);
+  ASSERT(zone_alias_table_.size() == host_set_.healthyHostsPerZone().size());
 
-  // If we cannot route all requests to the same zone, we already calculated how much we can
-  // push to the local zone, check if we can push to local zone on current iteration.
-  if (random_.random() % 10000 < local_percent_to_route_) {
+  const uint32_t zone = zone_alias_table_.pick(random_.random());
+
+  if (zone == 0) {
     stats_.lb_zone_routing_sampled_.inc();
-    return host_set_.healthyHostsPerZone()[0];
+  } else {
+    stats_.lb_zone_routing_cross_zone_.inc();
+    if (zone_no_capacity_left_) {
+      stats_.lb_zone_no_capacity_left_.inc();
+    }
   }
 
-  // At this point we must route cross zone as we cannot route to the local zone.
-  stats_.lb_zone_routing_cross_zone_.inc();
+  return host_set_.healthyHostsPerZone()[zone];
+}
 
-  // This is *extremely* unlikely but possible due to rounding errors when calculating
-  // zone percentages. In this case just select random zone.
-  if (residual_capacity_[number_of_zones - 1] == 0) {
-    stats_.lb_zone_no_capacity_left_.inc();
-    return host_set_.healthyHostsPerZone()[random_.random() % number_of_zones];
+void LoadBalancerBase::refreshRuntimeValues() {
+  Runtime::Snapshot& snapshot = runtime_.snapshot();
+  if (&snapshot == runtime_snapshot_) {
+    return;
   }
 
-  // Random sampling to select specific zone for cross zone traffic based on the additional
-  // capacity in zones.
-  uint64_t threshold = random_.random() % residual_capacity_[number_of_zones - 1];
-
-  // This potentially can be optimized to be O(log(N)) where N is the number of zones.
-  // Linear scan should be faster for smaller N, in most of the scenarios N will be small.
-  int i = 0;
-  while (threshold > residual_capacity_[i]) {
-    i++;
+  runtime_snapshot_ = &snapshot;
+  global_panic_threshold_ = std::min<uint64_t>(100, snapshot.getInteger(RuntimePanicThreshold, 50));
+  if (local_host_set_) {
+    zone_routing_enabled_percent_ =
+        std::min<uint64_t>(100, snapshot.getInteger(RuntimeZoneEnabled, 100));
   }
-
-  return host_set_.healthyHostsPerZone()[i];
 }
 
 const std::vector<HostSharedPtr>& LoadBalancerBase::hostsToUse() {
   ASSERT(host_set_.healthyHosts().size() <= host_set_.hosts().size());
 
-  if (LoadBalancerUtility::isGlobalPanic(host_set_, stats_, runtime_)) {
+  refreshRuntimeValues();
+  if (priority_routing_) {
+    return choosePriorityHosts();
+  }
+
+  if (LoadBalancerUtility::isGlobalPanic(host_set_, stats_, global_panic_threshold_)) {
     return host_set_.hosts();
   }
 
@@ -211,11 +340,14 @@ const std::vector<HostSharedPtr>& LoadBalancerBase::hostsToUse() {
     return host_set_.healthyHosts();
   }
 
-  if (!runtime_.snapshot().featureEnabled(RuntimeZoneEnabled, 100)) {
+  // Only roll the dice for zone routing when it is partially enabled.
+  if (zone_routing_enabled_percent_ == 0 ||
+      (zone_routing_enabled_percent_ < 100 &&
+       random_.random() % 100 >= zone_routing_enabled_percent_)) {
     return host_set_.healthyHosts();
   }
 
-  if (LoadBalancerUtility::isGlobalPanic(*local_host_set_, stats_, runtime_)) {
+  if (LoadBalancerUtility::isGlobalPanic(*local_host_set_, stats_, global_panic_threshold_)) {
     stats_.lb_local_cluster_not_ok_.inc();
     return host_set_.healthyHosts();
   }
@@ -223,12 +355,62 @@ const std::vector<HostSharedPtr>& LoadBalancerBase::hostsToUse() {
   return tryChooseLocalZoneHosts();
 }
 
+const std::vector<HostSharedPtr>& LoadBalancerBase::choosePriorityHosts() {
+  if (priority_health_ == 0 || priority_health_ < global_panic_threshold_) {
+    stats_.lb_healthy_panic_.inc();
+    return host_set_.hosts();
+  }
+
+  // One random value picks both the level, from its low part, and the locality of the level.
+  const uint64_t random = random_.random();
+  const uint32_t level_index = priority_load_[random % 100];
+  if (level_index != 0) {
+    stats_.lb_priority_failover_.inc();
+  }
+
+  const PriorityLevel& level = priority_levels_[level_index];
+  ASSERT(!level.locality_hosts_.empty());
+  if (level.locality_hosts_.size() == 1) {
+    return level.locality_hosts_[0];
+  }
+  return level.locality_hosts_[level.locality_table_.pick(random / 100)];
+}
+
+bool LoadBalancerBase::useWeights() {
+  return stats_.max_host_weight_.value() > 1 &&
+         runtime_.snapshot().getInteger(RuntimeWeightEnabled, 1UL) != 0;
+}
+
+RoundRobinLoadBalancer::RoundRobinLoadBalancer(const HostSet& host_set,
+                                               const HostSet* local_host_set, ClusterStats& stats,
+                                               Runtime::Loader& runtime,
+                                               Runtime::RandomGenerator& random)
+    : LoadBalancerBase(host_set, local_host_set, stats, runtime, random) {
+  host_set.addMemberUpdateCb(
+      [this](const std::vector<HostSharedPtr>&, const std::vector<HostSharedPtr>&)
+          -> void { schedulers_.clear(); });
+}
+
 HostConstSharedPtr RoundRobinLoadBalancer::chooseHost(const LoadBalancerContext*) {
   const std::vector<HostSharedPtr>& hosts_to_use = hostsToUse();
   if (hosts_to_use.empty()) {
     return nullptr;
   }
 
+  if (useWeights()) {
+    // The size check covers host lists that are updated in place.
+    Scheduler& scheduler = schedulers_[&hosts_to_use];
+    if (scheduler.num_hosts_ != hosts_to_use.size()) {
+      scheduler = Scheduler();
+      scheduler.num_hosts_ = hosts_to_use.size();
+      for (const HostSharedPtr& host : hosts_to_use) {
+        scheduler.edf_.add(host->weight(), host);
+      }
+    }
+
+    return scheduler.edf_.pick();
+  }
+
   return hosts_to_use[rr_index_++ % hosts_to_use.size()];
 }
 
@@ -254,7 +436,11 @@ LeastRequestLoadBalancer::LeastRequestLoadBalancer(const HostSet& host_set,
 
 HostConstSharedPtr LeastRequestLoadBalancer::chooseHost(const LoadBalancerContext*) {
   bool is_weight_imbalanced = stats_.max_host_weight_.value() != 1;
-  bool is_weight_enabled = runtime_.snapshot().getInteger("upstream.weight_enabled", 1UL) != 0;
+  bool is_weight_enabled = runtime_.snapshot().getInteger(RuntimeWeightEnabled, 1UL) != 0;
+
+  if (runtime_.snapshot().getInteger(RuntimeP2cEnabled, 0) != 0) {
+    return chooseHostP2c(is_weight_imbalanced && is_weight_enabled);
+  }
 
   if (is_weight_imbalanced && hits_left_ > 0 && is_weight_enabled) {
     --hits_left_;
@@ -288,12 +474,73 @@ HostConstSharedPtr LeastRequestLoadBalancer::chooseHost(const LoadBalancerContex
   }
 }
 
+double LeastRequestLoadBalancer::p2cLoad(const Host& host, bool use_weight,
+                                         bool use_response_time) {
+  // Count the request being placed so that idle hosts are still ordered by weight and response
+  // time.
+  double load = host.activeRequests() + 1;
+  if (use_weight) {
+    load /= host.weight();
+  }
+  if (use_response_time) {
+    load *= host.outlierDetector().responseTimeEwma() + 1;
+  }
+
+  return load;
+}
+
+HostConstSharedPtr LeastRequestLoadBalancer::chooseHostP2c(bool use_weight) {
+  // Drop any state left over from weighted round robin mode.
+  hits_left_ = 0;
+  last_host_.reset();
+
+  const std::vector<HostSharedPtr>& hosts_to_use = hostsToUse();
+  if (hosts_to_use.empty()) {
+    return nullptr;
+  }
+
+  const bool use_response_time =
+      runtime_.snapshot().getInteger(RuntimePeakEwmaEnabled, 0) != 0;
+  const HostSharedPtr& host1 = hosts_to_use[random_.random() % hosts_to_use.size()];
+  const HostSharedPtr& host2 = hosts_to_use[random_.random() % hosts_to_use.size()];
+  if (p2cLoad(*host1, use_weight, use_response_time) <
+      p2cLoad(*host2, use_weight, use_response_time)) {
+    return host1;
+  } else {
+    return host2;
+  }
+}
+
+RandomLoadBalancer::RandomLoadBalancer(const HostSet& host_set, const HostSet* local_host_set,
+                                       ClusterStats& stats, Runtime::Loader& runtime,
+                                       Runtime::RandomGenerator& random)
+    : LoadBalancerBase(host_set, local_host_set, stats, runtime, random) {
+  host_set.addMemberUpdateCb(
+      [this](const std::vector<HostSharedPtr>&, const std::vector<HostSharedPtr>&)
+          -> void { alias_tables_.clear(); });
+}
+
 HostConstSharedPtr RandomLoadBalancer::chooseHost(const LoadBalancerContext*) {
   const std::vector<HostSharedPtr>& hosts_to_use = hostsToUse();
   if (hosts_to_use.empty()) {
     return nullptr;
   }
 
+  if (useWeights()) {
+    // The size check covers host lists that are updated in place.
+    AliasTable& alias_table = alias_tables_[&hosts_to_use];
+    if (alias_table.size() != hosts_to_use.size()) {
+      std::vector<uint64_t> weights;
+      weights.reserve(hosts_to_use.size());
+      for (const HostSharedPtr& host : hosts_to_use) {
+        weights.push_back(host->weight());
+      }
+      alias_table = AliasTable(weights);
+    }
+
+    return hosts_to_use[alias_table.pick(random_.random())];
+  }
+
   return hosts_to_use[random_.random() % hosts_to_use.size()];
 }
 
@@ -1,12 +1,17 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
+#include <unordered_map>
 #include <vector>
 
 #include "envoy/runtime/runtime.h"
 #include "envoy/upstream/load_balancer.h"
 #include "envoy/upstream/upstream.h"
 
+#include "common/upstream/alias_table.h"
+#include "common/upstream/edf_scheduler.h"
+
 namespace Envoy {
 namespace Upstream {
 
@@ -21,6 +26,12 @@ public:
    * requests to hosts regardless of whether they are healthy or not.
    */
   static bool isGlobalPanic(const HostSet& host_set, ClusterStats& stats, Runtime::Loader& runtime);
+
+  /**
+   * Same as above but with the panic threshold already read from runtime.
+   */
+  static bool isGlobalPanic(const HostSet& host_set, ClusterStats& stats,
+                            uint64_t global_panic_threshold);
 };
 
 /**
@@ -33,9 +44,17 @@ protected:
 
   /**
    * Pick the host list to use (healthy or all depending on how many in the set are not healthy).
+   * If the hosts have priorities or the cluster has locality weights, this is the healthy hosts of
+   * one locality of one priority level.
    */
   const std::vector<HostSharedPtr>& hostsToUse();
 
+  /**
+   * @return whether hosts should be picked according to their weight. This is the case when any
+   * host has a weight greater than 1 and weighting is enabled in runtime.
+   */
+  bool useWeights();
+
   ClusterStats& stats_;
   Runtime::Loader& runtime_;
   Runtime::RandomGenerator& random_;
@@ -43,6 +62,26 @@ protected:
 private:
   enum class ZoneRoutingState { NoZoneRouting, ZoneDirect, ZoneResidual };
 
+  struct PriorityLevel {
+    // The healthy hosts of each locality of the level that has any.
+    std::vector<std::vector<HostSharedPtr>> locality_hosts_;
+    // Alias table over locality_hosts_, weighted by the locality weight times the locality health.
+    AliasTable locality_table_;
+  };
+
+  /**
+   * @return the health of a group of hosts in percent, scaled by the overprovisioning factor and
+   *         capped at 100. A group keeps all of its traffic until less than 1/1.4 of its hosts are
+   *         healthy.
+   */
+  static uint64_t healthPercent(uint64_t healthy_hosts, uint64_t hosts);
+
+  /**
+   * Pick a priority level by its share of the traffic and then a locality of that level by its
+   * weight.
+   */
+  const std::vector<HostSharedPtr>& choosePriorityHosts();
+
   /**
    * @return decision on quick exit from zone aware routing based on cluster configuration.
    * This gets recalculated on update callback.
@@ -54,6 +93,13 @@ private:
    */
   const std::vector<HostSharedPtr>& tryChooseLocalZoneHosts();
 
+  /**
+   * Re-read the runtime values used on every pick if the runtime snapshot changed since the last
+   * pick.
+   */
+  void refreshRuntimeValues();
+
+
   /**
    * @return (number of hosts in a given zone)/(total number of hosts) in ret param.
    * The result is stored as integer number and scaled by 10000 multiplier for better precision.
@@ -67,29 +113,64 @@ private:
    */
   void regenerateZoneRoutingStructures();
 
+  /**
+   * Regenerate the priority levels and the share of the traffic each of them receives. Levels are
+   * filled in priority order: each level takes as much of the traffic that the levels above it
+   * could not take as its health allows.
+   */
+  void regeneratePriorityStructures();
+
   const HostSet& host_set_;
   const HostSet* local_host_set_;
 
-  uint64_t local_percent_to_route_{};
   ZoneRoutingState zone_routing_state_{ZoneRoutingState::NoZoneRouting};
-  std::vector<uint64_t> residual_capacity_;
+
+  // Alias table over the upstream zones used in the ZoneResidual state.
+  AliasTable zone_alias_table_;
+  // Set when no upstream zone has residual capacity and cross zone traffic is spread evenly.
+  bool zone_no_capacity_left_{};
+
+  // Set when any host has a priority other than 0 or the cluster has locality weights. Hosts are
+  // then picked by priority level and locality, and zone aware routing is not used.
+  bool priority_routing_{};
+  // The levels that have hosts, from the highest priority to the lowest.
+  std::vector<PriorityLevel> priority_levels_;
+  // Maps every percent of the traffic to the index of the level that receives it.
+  std::array<uint32_t, 100> priority_load_{};
+  // The health of all levels combined, capped at 100. Below the panic threshold all hosts are used.
+  uint64_t priority_health_{};
+
+  // Runtime values cached per snapshot. A new snapshot is always allocated while the previous one
+  // is still referenced, so a change of address means the values must be re-read.
+  const Runtime::Snapshot* runtime_snapshot_{};
+  uint64_t global_panic_threshold_{};
+  uint64_t zone_routing_enabled_percent_{};
 };
 
 /**
- * Implementation of LoadBalancer that performs RR selection across the hosts in the cluster.
+ * Implementation of LoadBalancer that performs RR selection across the hosts in the cluster. If host
+ * weights differ, an earliest deadline first schedule is used so that hosts are picked in proportion
+ * to their weight.
  */
 class RoundRobinLoadBalancer : public LoadBalancer, LoadBalancerBase {
 public:
   RoundRobinLoadBalancer(const HostSet& host_set, const HostSet* local_host_set_,
                          ClusterStats& stats, Runtime::Loader& runtime,
-                         Runtime::RandomGenerator& random)
-      : LoadBalancerBase(host_set, local_host_set_, stats, runtime, random) {}
+                         Runtime::RandomGenerator& random);
 
   // Upstream::LoadBalancer
   HostConstSharedPtr chooseHost(const LoadBalancerContext* context) override;
 
 private:
+  struct Scheduler {
+    size_t num_hosts_{};
+    EdfScheduler<Host> edf_;
+  };
+
   size_t rr_index_{};
+  // Weighted round robin schedulers keyed by the host list they were built from. They are built on
+  // first use and dropped whenever the host set changes.
+  std::unordered_map<const std::vector<HostSharedPtr>*, Scheduler> schedulers_;
 };
 
 /**
@@ -104,6 +185,12 @@ private:
  * This technique is acceptable for load testing but
  * will not work well in situations where requests take a long time.
  * In that case a different algorithm using a full scan will be required.
+ *
+ * If the upstream.least_request.p2c_enabled runtime key is set, two random hosts are always
+ * compared instead and weight is taken into account on every pick by dividing the number of active
+ * requests on each host by its weight. If upstream.least_request.peak_ewma_enabled is also set,
+ * the load of each host is additionally scaled by the peak EWMA of its response times as tracked by
+ * outlier detection.
  */
 class LeastRequestLoadBalancer : public LoadBalancer, LoadBalancerBase {
 public:
@@ -115,21 +202,33 @@ public:
   HostConstSharedPtr chooseHost(const LoadBalancerContext* context) override;
 
 private:
+  /**
+   * @return the load of a host used to compare hosts in P2C mode. Lower is better.
+   */
+  static double p2cLoad(const Host& host, bool use_weight, bool use_response_time);
+
+  HostConstSharedPtr chooseHostP2c(bool use_weight);
+
   HostSharedPtr last_host_;
   uint32_t hits_left_{};
 };
 
 /**
- * Random load balancer that picks a random host out of all hosts.
+ * Random load balancer that picks a random host out of all hosts. If host weights differ, hosts are
+ * picked in proportion to their weight using an alias table.
  */
 class RandomLoadBalancer : public LoadBalancer, LoadBalancerBase {
 public:
   RandomLoadBalancer(const HostSet& host_set, const HostSet* local_host_set, ClusterStats& stats,
-                     Runtime::Loader& runtime, Runtime::RandomGenerator& random)
-      : LoadBalancerBase(host_set, local_host_set, stats, runtime, random) {}
+                     Runtime::Loader& runtime, Runtime::RandomGenerator& random);
 
   // Upstream::LoadBalancer
   HostConstSharedPtr chooseHost(const LoadBalancerContext* context) override;
+
+private:
+  // Alias tables keyed by the host list they were built from. They are built on first use and
+  // dropped whenever the host set changes.
+  std::unordered_map<const std::vector<HostSharedPtr>*, AliasTable> alias_tables_;
 };
 
 } // Upstream
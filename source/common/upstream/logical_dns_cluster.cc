@@ -1,7 +1,9 @@
 #include "common/upstream/logical_dns_cluster.h"
 
+#include <algorithm>
 #include <chrono>
 #include <list>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -25,15 +27,6 @@ LogicalDnsCluster::LogicalDnsCluster(const Json::Object& config, Runtime::Loader
     throw EnvoyException("logical_dns clusters must have a single host");
   }
 
-  std::string dns_lookup_family = config.getString("dns_lookup_family", "v4_only");
-  if (dns_lookup_family == "v6_only") {
-    dns_lookup_family_ = Network::DnsLookupFamily::V6Only;
-  } else if (dns_lookup_family == "auto") {
-    dns_lookup_family_ = Network::DnsLookupFamily::Auto;
-  } else {
-    ASSERT(dns_lookup_family == "v4_only");
-    dns_lookup_family_ = Network::DnsLookupFamily::V4Only;
-  }
   dns_url_ = hosts_json[0]->getString("url");
   hostname_ = Network::Utility::hostFromTcpUrl(dns_url_);
   Network::Utility::portFromTcpUrl(dns_url_);
@@ -59,7 +52,7 @@ void LogicalDnsCluster::startResolve() {
   info_->stats().update_attempt_.inc();
 
   active_dns_query_ = dns_resolver_->resolve(
-      dns_address, dns_lookup_family_,
+      dns_address, info_->dnsLookupFamily(),
       [this, dns_address](
           std::list<Network::Address::InstanceConstSharedPtr>&& address_list) -> void {
         active_dns_query_ = nullptr;
@@ -68,16 +61,27 @@ void LogicalDnsCluster::startResolve() {
 
         if (!address_list.empty()) {
           // TODO(mattklein123): Move port handling into the DNS interface.
-          ASSERT(address_list.front() != nullptr);
-          Network::Address::InstanceConstSharedPtr new_address =
-              Network::Utility::getAddressWithPort(*address_list.front(),
-                                                   Network::Utility::portFromTcpUrl(dns_url_));
-          if (!current_resolved_address_ || !(*new_address == *current_resolved_address_)) {
-            current_resolved_address_ = new_address;
-            // Capture URL to avoid a race with another update.
-            tls_.runOnAllThreads([this, new_address]() -> void {
-              tls_.getTyped<PerThreadCurrentHostData>(tls_slot_).current_resolved_address_ =
-                  new_address;
+          const uint32_t port = Network::Utility::portFromTcpUrl(dns_url_);
+          std::shared_ptr<std::vector<Network::Address::InstanceConstSharedPtr>> new_addresses =
+              std::make_shared<std::vector<Network::Address::InstanceConstSharedPtr>>();
+          for (const Network::Address::InstanceConstSharedPtr& address : address_list) {
+            ASSERT(address != nullptr);
+            new_addresses->emplace_back(Network::Utility::getAddressWithPort(*address, port));
+          }
+
+          if (!current_resolved_addresses_ ||
+              current_resolved_addresses_->size() != new_addresses->size() ||
+              !std::equal(new_addresses->begin(), new_addresses->end(),
+                          current_resolved_addresses_->begin(),
+                          [](const Network::Address::InstanceConstSharedPtr& lhs,
+                             const Network::Address::InstanceConstSharedPtr& rhs)
+                              -> bool { return *lhs == *rhs; })) {
+            AddressListConstSharedPtr addresses = new_addresses;
+            current_resolved_addresses_ = addresses;
+            // Capture the list to avoid a race with another update.
+            tls_.runOnAllThreads([this, addresses]() -> void {
+              tls_.getTyped<PerThreadCurrentHostData>(tls_slot_).current_resolved_addresses_ =
+                  addresses;
             });
           }
 
@@ -117,10 +121,10 @@ Upstream::Host::CreateConnectionData
 LogicalDnsCluster::LogicalHost::createConnection(Event::Dispatcher& dispatcher) const {
   PerThreadCurrentHostData& data =
       parent_.tls_.getTyped<PerThreadCurrentHostData>(parent_.tls_slot_);
-  ASSERT(data.current_resolved_address_);
-  return {HostImpl::createConnection(dispatcher, *parent_.info_, data.current_resolved_address_),
+  ASSERT(data.current_resolved_addresses_);
+  return {HostImpl::createConnection(dispatcher, *parent_.info_, *data.current_resolved_addresses_),
           HostDescriptionConstSharedPtr{
-              new RealHostDescription(data.current_resolved_address_, shared_from_this())}};
+              new RealHostDescription(data.current_resolved_addresses_, shared_from_this())}};
 }
 
 } // Upstream
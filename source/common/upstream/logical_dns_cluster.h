@@ -3,7 +3,9 @@
 #include <chrono>
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "envoy/thread_local/thread_local.h"
 
@@ -15,9 +17,9 @@ namespace Upstream {
 
 /**
  * The LogicalDnsCluster is a type of cluster that creates a single logical host that wraps
- * an async DNS resolver. The DNS resolver will continuously resolve, and swap in the first IP
- * address in the resolution set. However the logical owning host will not change. Any created
- * connections against this host will use the currently resolved IP. This means that a connection
+ * an async DNS resolver. The DNS resolver will continuously resolve, and swap in the resolution
+ * set. However the logical owning host will not change. Any created connections against this host
+ * will use the first currently resolved IP, racing the rest of the set against it. This means that a connection
  * pool using the logical host may end up with connections to many different real IPs.
  *
  * This cluster type is useful for large web services that use DNS in a round robin fashion, such
@@ -58,10 +60,12 @@ private:
     LogicalDnsCluster& parent_;
   };
 
+  typedef std::shared_ptr<const std::vector<Network::Address::InstanceConstSharedPtr>>
+      AddressListConstSharedPtr;
+
   struct RealHostDescription : public HostDescription {
-    RealHostDescription(Network::Address::InstanceConstSharedPtr address,
-                        HostConstSharedPtr logical_host)
-        : address_(address), logical_host_(logical_host) {}
+    RealHostDescription(AddressListConstSharedPtr address_list, HostConstSharedPtr logical_host)
+        : address_list_(address_list), logical_host_(logical_host) {}
 
     // Upstream:HostDescription
     bool canary() const override { return false; }
@@ -71,10 +75,17 @@ private:
     }
     const HostStats& stats() const override { return logical_host_->stats(); }
     const std::string& hostname() const override { return logical_host_->hostname(); }
-    Network::Address::InstanceConstSharedPtr address() const override { return address_; }
+    Network::Address::InstanceConstSharedPtr address() const override {
+      return address_list_->front();
+    }
+    std::vector<Network::Address::InstanceConstSharedPtr> addressList() const override {
+      return *address_list_;
+    }
     const std::string& zone() const override { return EMPTY_STRING; }
+    uint32_t priority() const override { return 0; }
+    const HostMetadata& metadata() const override { return logical_host_->metadata(); }
 
-    Network::Address::InstanceConstSharedPtr address_;
+    AddressListConstSharedPtr address_list_;
     HostConstSharedPtr logical_host_;
   };
 
@@ -82,14 +93,13 @@ private:
     // ThreadLocal::ThreadLocalObject
     void shutdown() override {}
 
-    Network::Address::InstanceConstSharedPtr current_resolved_address_;
+    AddressListConstSharedPtr current_resolved_addresses_;
   };
 
   void startResolve();
 
   Network::DnsResolverSharedPtr dns_resolver_;
   const std::chrono::milliseconds dns_refresh_rate_ms_;
-  Network::DnsLookupFamily dns_lookup_family_;
   ThreadLocal::Instance& tls_;
   uint32_t tls_slot_;
   std::function<void()> initialize_callback_;
@@ -98,7 +108,7 @@ private:
   Event::TimerPtr resolve_timer_;
   std::string dns_url_;
   std::string hostname_;
-  Network::Address::InstanceConstSharedPtr current_resolved_address_;
+  AddressListConstSharedPtr current_resolved_addresses_;
   HostSharedPtr logical_host_;
   Network::ActiveDnsQuery* active_dns_query_{};
 };
@@ -0,0 +1,118 @@
+#include "common/upstream/maglev_lb.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/common/assert.h"
+#include "common/upstream/load_balancer_impl.h"
+
+namespace Envoy {
+namespace Upstream {
+
+const uint64_t MaglevLoadBalancer::TableSize;
+
+MaglevLoadBalancer::MaglevLoadBalancer(HostSet& host_set, ClusterStats& stats,
+                                       Runtime::Loader& runtime, Runtime::RandomGenerator& random)
+    : host_set_(host_set), stats_(stats), runtime_(runtime), random_(random), table_(own_table_) {
+  host_set_.addMemberUpdateCb(
+      [this](const std::vector<HostSharedPtr>&, const std::vector<HostSharedPtr>&) -> void {
+        own_table_ = TableBuilder().build(host_set_);
+      });
+
+  own_table_ = TableBuilder().build(host_set_);
+}
+
+MaglevLoadBalancer::MaglevLoadBalancer(HostSet& host_set, ClusterStats& stats,
+                                       Runtime::Loader& runtime, Runtime::RandomGenerator& random,
+                                       const LoadBalancerTableConstSharedPtr& table)
+    : host_set_(host_set), stats_(stats), runtime_(runtime), random_(random), table_(table) {}
+
+HostConstSharedPtr MaglevLoadBalancer::chooseHost(const LoadBalancerContext* context) {
+  // A cluster that never had hosts has no tables yet.
+  if (!table_) {
+    return nullptr;
+  }
+
+  const Tables& tables = static_cast<const Tables&>(*table_);
+  if (LoadBalancerUtility::isGlobalPanic(host_set_, stats_, runtime_)) {
+    return tables.all_hosts_table_.chooseHost(context, random_);
+  } else {
+    return tables.healthy_hosts_table_.chooseHost(context, random_);
+  }
+}
+
+LoadBalancerTableConstSharedPtr MaglevLoadBalancer::TableBuilder::build(const HostSet& host_set) {
+  std::shared_ptr<Tables> tables = std::make_shared<Tables>();
+  tables->all_hosts_table_.create(host_set.hosts());
+  tables->healthy_hosts_table_.create(host_set.healthyHosts());
+  return tables;
+}
+
+HostConstSharedPtr MaglevLoadBalancer::Table::chooseHost(const LoadBalancerContext* context,
+                                                         Runtime::RandomGenerator& random) const {
+  if (hosts_.empty()) {
+    return nullptr;
+  }
+
+  // If there is no hash in the context, just choose a random value (this effectively becomes
+  // the random LB but it won't crash if someone configures it this way).
+  uint64_t h;
+  if (!context || !context->hashKey().valid()) {
+    h = random.random();
+  } else {
+    h = context->hashKey().value();
+  }
+
+  return hosts_[table_[h % TableSize]];
+}
+
+void MaglevLoadBalancer::Table::create(const std::vector<HostSharedPtr>& hosts) {
+  log_trace("maglev: building table");
+  if (hosts.empty()) {
+    return;
+  }
+
+  // Each host visits the table slots in the order offset, offset + skip, offset + 2 * skip, ...
+  // (mod TableSize) and the hosts take turns claiming the next free slot in their permutation
+  // until the table is full. Since the table size is prime and skip is never zero, every
+  // permutation covers the whole table.
+  struct Permutation {
+    uint64_t next_;
+    uint64_t skip_;
+  };
+
+  std::vector<Permutation> permutations;
+  permutations.reserve(hosts.size());
+  hosts_.reserve(hosts.size());
+  for (const auto& host : hosts) {
+    const std::string& address = host->address()->asString();
+    const uint64_t offset = std::hash<std::string>()(address) % TableSize;
+    const uint64_t skip = std::hash<std::string>()(address + "_skip") % (TableSize - 1) + 1;
+    permutations.push_back({offset, skip});
+    hosts_.push_back(host);
+  }
+
+  const uint32_t empty = hosts.size();
+  table_.assign(TableSize, empty);
+  uint64_t filled = 0;
+  while (true) {
+    for (uint32_t i = 0; i < hosts_.size(); i++) {
+      Permutation& permutation = permutations[i];
+      while (table_[permutation.next_] != empty) {
+        permutation.next_ = (permutation.next_ + permutation.skip_) % TableSize;
+      }
+
+      table_[permutation.next_] = i;
+      permutation.next_ = (permutation.next_ + permutation.skip_) % TableSize;
+      if (++filled == TableSize) {
+        log_trace("maglev: built table for {} hosts", hosts_.size());
+        return;
+      }
+    }
+  }
+}
+
+} // Upstream
+} // Envoy
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "envoy/runtime/runtime.h"
+#include "envoy/upstream/load_balancer.h"
+
+#include "common/common/logger.h"
+
+namespace Envoy {
+namespace Upstream {
+
+/**
+ * A load balancer that implements consistent hashing using Maglev lookup tables. See section 3.4 of
+ * "Maglev: A Fast and Reliable Software Network Load Balancer". Each host fills slots of a fixed
+ * size table in the order of its own permutation of the table, so choosing a host is a single
+ * table index and rebuilding the table takes O(TableSize * log(TableSize)) probes in expectation
+ * regardless of the number of hosts. As with the ring hash load balancer, a table is kept for all
+ * hosts as well as a table for healthy hosts, zone aware routing is not supported, and hosts are
+ * not weighted. Also like the ring hash load balancer, the tables are immutable once built and a
+ * cluster manager shares the tables it builds with a TableBuilder across all workers.
+ */
+class MaglevLoadBalancer : public LoadBalancer, Logger::Loggable<Logger::Id::upstream> {
+public:
+  // The table size must be prime so that every skip value generates a full permutation. It should
+  // be much larger than the number of hosts to keep the share of each host close to equal.
+  static const uint64_t TableSize = 65537;
+
+  /**
+   * Builds the shared lookup tables of a cluster.
+   */
+  class TableBuilder : public LoadBalancerTableBuilder {
+  public:
+    // Upstream::LoadBalancerTableBuilder
+    LoadBalancerTableConstSharedPtr build(const HostSet& host_set) override;
+  };
+
+  /**
+   * Build a load balancer that maintains its own lookup tables.
+   */
+  MaglevLoadBalancer(HostSet& host_set, ClusterStats& stats, Runtime::Loader& runtime,
+                     Runtime::RandomGenerator& random);
+
+  /**
+   * Build a load balancer that picks from shared lookup tables.
+   * @param table supplies the tables built by a TableBuilder for the current hosts of host_set.
+   *        The owner replaces the tables before the hosts of host_set change.
+   */
+  MaglevLoadBalancer(HostSet& host_set, ClusterStats& stats, Runtime::Loader& runtime,
+                     Runtime::RandomGenerator& random,
+                     const LoadBalancerTableConstSharedPtr& table);
+
+  // Upstream::LoadBalancer
+  HostConstSharedPtr chooseHost(const LoadBalancerContext* context) override;
+
+private:
+  struct Table {
+    HostConstSharedPtr chooseHost(const LoadBalancerContext* context,
+                                  Runtime::RandomGenerator& random) const;
+    void create(const std::vector<HostSharedPtr>& hosts);
+
+    std::vector<HostConstSharedPtr> hosts_;
+    // Index into hosts_ for every slot of the table.
+    std::vector<uint32_t> table_;
+  };
+
+  struct Tables : public LoadBalancerTable {
+    Table all_hosts_table_;
+    Table healthy_hosts_table_;
+  };
+
+  HostSet& host_set_;
+  ClusterStats& stats_;
+  Runtime::Loader& runtime_;
+  Runtime::RandomGenerator& random_;
+  // Only used by a load balancer that maintains its own tables.
+  LoadBalancerTableConstSharedPtr own_table_;
+  const LoadBalancerTableConstSharedPtr& table_;
+};
+
+} // Upstream
+} // Envoy
@@ -0,0 +1,84 @@
+#include "common/upstream/original_dst_cluster.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "envoy/common/exception.h"
+#include "envoy/network/connection.h"
+
+#include "common/network/utility.h"
+
+namespace Envoy {
+namespace Upstream {
+
+OriginalDstCluster::LoadBalancer::LoadBalancer(ClusterInfoConstSharedPtr info,
+                                               Event::Dispatcher& dispatcher,
+                                               HostsRemovedCb hosts_removed_cb)
+    : info_(info), hosts_removed_cb_(hosts_removed_cb),
+      cleanup_timer_(dispatcher.createTimer([this]() -> void { cleanup(); })) {
+  cleanup_timer_->enableTimer(info_->hostCleanupInterval());
+}
+
+OriginalDstCluster::LoadBalancer::~LoadBalancer() {
+  std::vector<HostSharedPtr> hosts_removed;
+  for (const auto& entry : hosts_) {
+    hosts_removed.push_back(entry.second.host_);
+  }
+
+  if (!hosts_removed.empty()) {
+    hosts_removed_cb_(hosts_removed);
+  }
+}
+
+HostConstSharedPtr
+OriginalDstCluster::LoadBalancer::chooseHost(const LoadBalancerContext* context) {
+  if (context == nullptr || context->downstreamConnection() == nullptr) {
+    return nullptr;
+  }
+
+  const Network::Address::Instance& destination =
+      context->downstreamConnection()->localAddress();
+  if (destination.type() != Network::Address::Type::Ip) {
+    return nullptr;
+  }
+
+  HostEntry& entry = hosts_[destination.asString()];
+  if (!entry.host_) {
+    entry.host_.reset(new HostImpl(
+        info_, "", Network::Utility::parseInternetAddressAndPort(destination.asString()), false, 1,
+        ""));
+  }
+  entry.used_ = true;
+  return entry.host_;
+}
+
+void OriginalDstCluster::LoadBalancer::cleanup() {
+  std::vector<HostSharedPtr> hosts_removed;
+  for (auto it = hosts_.begin(); it != hosts_.end();) {
+    if (it->second.used_) {
+      it->second.used_ = false;
+      ++it;
+    } else {
+      hosts_removed.push_back(it->second.host_);
+      it = hosts_.erase(it);
+    }
+  }
+
+  if (!hosts_removed.empty()) {
+    hosts_removed_cb_(hosts_removed);
+  }
+  cleanup_timer_->enableTimer(info_->hostCleanupInterval());
+}
+
+OriginalDstCluster::OriginalDstCluster(const Json::Object& config, Runtime::Loader& runtime,
+                                       Stats::Store& stats,
+                                       Ssl::ContextManager& ssl_context_manager)
+    : ClusterImplBase(config, runtime, stats, ssl_context_manager) {
+  if (config.hasObject("hosts")) {
+    throw EnvoyException("original_dst clusters must have no hosts");
+  }
+}
+
+} // Upstream
+} // Envoy
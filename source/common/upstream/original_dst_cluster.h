@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
+
+#include "common/upstream/upstream_impl.h"
+
+namespace Envoy {
+namespace Upstream {
+
+/**
+ * The OriginalDstCluster is a cluster without configured hosts that routes each connection to the
+ * address it was originally destined to. With 'use_original_dst' on the listener, this is the local
+ * address of the downstream connection, as recovered with SO_ORIGINAL_DST. The hosts live in the
+ * load balancer of each worker, which creates a host the first time it sees a destination and
+ * keeps it, along with its connection pools, for as long as connections to the destination keep
+ * arriving.
+ */
+class OriginalDstCluster : public ClusterImplBase {
+public:
+  /**
+   * Worker local load balancer that maps destinations to hosts. Hosts that have not been chosen
+   * since the previous cleanup are removed every cleanup interval.
+   */
+  class LoadBalancer : public Upstream::LoadBalancer {
+  public:
+    typedef std::function<void(const std::vector<HostSharedPtr>& hosts_removed)> HostsRemovedCb;
+
+    LoadBalancer(ClusterInfoConstSharedPtr info, Event::Dispatcher& dispatcher,
+                 HostsRemovedCb hosts_removed_cb);
+    ~LoadBalancer();
+
+    // Upstream::LoadBalancer
+    HostConstSharedPtr chooseHost(const LoadBalancerContext* context) override;
+
+  private:
+    struct HostEntry {
+      HostSharedPtr host_;
+      bool used_{};
+    };
+
+    void cleanup();
+
+    ClusterInfoConstSharedPtr info_;
+    HostsRemovedCb hosts_removed_cb_;
+    // Keyed by the destination address and port.
+    std::unordered_map<std::string, HostEntry> hosts_;
+    Event::TimerPtr cleanup_timer_;
+  };
+
+  OriginalDstCluster(const Json::Object& config, Runtime::Loader& runtime, Stats::Store& stats,
+                     Ssl::ContextManager& ssl_context_manager);
+
+  // Upstream::Cluster
+  void initialize() override {}
+  InitializePhase initializePhase() const override { return InitializePhase::Primary; }
+  void setInitializedCb(std::function<void()> callback) override { callback(); }
+};
+
+} // Upstream
+} // Envoy
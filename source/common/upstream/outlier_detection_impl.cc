@@ -1,6 +1,9 @@
 #include "common/upstream/outlier_detection_impl.h"
 
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <cmath>
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -31,6 +34,11 @@ DetectorSharedPtr DetectorImplFactory::createForCluster(Cluster& cluster,
   }
 }
 
+DetectorHostSinkImpl::DetectorHostSinkImpl(std::shared_ptr<DetectorImpl> detector,
+                                           HostSharedPtr host)
+    : detector_(detector), host_(host),
+      request_accumulator_(detector && detector->config().enforcingLatency() > 0) {}
+
 void DetectorHostSinkImpl::eject(MonotonicTime ejection_time) {
   ASSERT(!host_.lock()->healthFlagGet(Host::HealthFlag::FAILED_OUTLIER_CHECK));
   host_.lock()->healthFlagSet(Host::HealthFlag::FAILED_OUTLIER_CHECK);
@@ -42,13 +50,24 @@ void DetectorHostSinkImpl::uneject(MonotonicTime unejection_time) {
   last_unejection_time_.value(unejection_time);
 }
 
-void DetectorHostSinkImpl::updateCurrentSuccessRateBucket() {
-  success_rate_accumulator_bucket_.store(success_rate_accumulator_.updateCurrentWriter());
+constexpr double DetectorHostSinkImpl::ResponseTimeEwmaAlpha;
+
+void DetectorHostSinkImpl::putResponseTime(std::chrono::milliseconds time) {
+  // Host sinks are shared by all workers, so the update is a compare and swap loop.
+  const double sample = time.count();
+  double ewma = response_time_ewma_.load(std::memory_order_relaxed);
+  double new_ewma;
+  do {
+    new_ewma = sample >= ewma ? sample : ewma + (sample - ewma) * ResponseTimeEwmaAlpha;
+  } while (!response_time_ewma_.compare_exchange_weak(ewma, new_ewma, std::memory_order_relaxed));
+
+  request_accumulator_.putResponseTime(time);
 }
 
 void DetectorHostSinkImpl::putHttpResponseCode(uint64_t response_code) {
-  success_rate_accumulator_bucket_.load()->total_request_counter_++;
-  if (Http::CodeUtility::is5xx(response_code)) {
+  const bool is_5xx = Http::CodeUtility::is5xx(response_code);
+  request_accumulator_.putResult(!is_5xx);
+  if (is_5xx) {
     std::shared_ptr<DetectorImpl> detector = detector_.lock();
     if (!detector) {
       // It's possible for the cluster/detector to go away while we still have a host in use.
@@ -60,8 +79,9 @@ void DetectorHostSinkImpl::putHttpResponseCode(uint64_t response_code) {
                                                   detector->config().consecutive5xx())) {
       detector->onConsecutive5xx(host_.lock());
     }
-  } else {
-    success_rate_accumulator_bucket_.load()->success_request_counter_++;
+  } else if (consecutive_5xx_.load(std::memory_order_relaxed) != 0) {
+    // Only write when there is something to reset. Successes are by far the common case and this
+    // keeps the cache line shared between workers instead of bouncing it on every response.
     consecutive_5xx_ = 0;
   }
 }
@@ -82,7 +102,14 @@ DetectorConfig::DetectorConfig(const Json::Object& json_config)
       enforcing_consecutive_5xx_(
           static_cast<uint64_t>(json_config.getInteger("enforcing_consecutive_5xx", 100))),
       enforcing_success_rate_(
-          static_cast<uint64_t>(json_config.getInteger("enforcing_success_rate", 100))) {}
+          static_cast<uint64_t>(json_config.getInteger("enforcing_success_rate", 100))),
+      latency_minimum_hosts_(
+          static_cast<uint64_t>(json_config.getInteger("latency_minimum_hosts", 5))),
+      latency_request_volume_(
+          static_cast<uint64_t>(json_config.getInteger("latency_request_volume", 100))),
+      latency_stdev_factor_(
+          static_cast<uint64_t>(json_config.getInteger("latency_stdev_factor", 1900))),
+      enforcing_latency_(static_cast<uint64_t>(json_config.getInteger("enforcing_latency", 0))) {}
 
 DetectorImpl::DetectorImpl(const Cluster& cluster, const Json::Object& json_config,
                            Event::Dispatcher& dispatcher, Runtime::Loader& runtime,
@@ -90,12 +117,12 @@ DetectorImpl::DetectorImpl(const Cluster& cluster, const Json::Object& json_conf
     : config_(json_config), dispatcher_(dispatcher), runtime_(runtime), time_source_(time_source),
       stats_(generateStats(cluster.info()->statsScope())),
       interval_timer_(dispatcher.createTimer([this]() -> void { onIntervalTimer(); })),
-      event_logger_(event_logger), success_rate_average_(-1), success_rate_ejection_threshold_(-1) {
-}
+      event_logger_(event_logger), success_rate_average_(-1), success_rate_ejection_threshold_(-1),
+      latency_ejection_threshold_(-1) {}
 
 DetectorImpl::~DetectorImpl() {
-  for (auto host : host_sinks_) {
-    if (host.first->healthFlagGet(Host::HealthFlag::FAILED_OUTLIER_CHECK)) {
+  for (const HostSharedPtr& host : hosts_) {
+    if (host->healthFlagGet(Host::HealthFlag::FAILED_OUTLIER_CHECK)) {
       ASSERT(stats_.ejections_active_.value() > 0);
       stats_.ejections_active_.dec();
     }
@@ -124,13 +151,12 @@ void DetectorImpl::initialize(const Cluster& cluster) {
     }
 
     for (const HostSharedPtr& host : hosts_removed) {
-      ASSERT(host_sinks_.count(host) == 1);
       if (host->healthFlagGet(Host::HealthFlag::FAILED_OUTLIER_CHECK)) {
         ASSERT(stats_.ejections_active_.value() > 0);
         stats_.ejections_active_.dec();
       }
 
-      host_sinks_.erase(host);
+      removeHostSink(host);
     }
   });
 
@@ -138,12 +164,31 @@ void DetectorImpl::initialize(const Cluster& cluster) {
 }
 
 void DetectorImpl::addHostSink(HostSharedPtr host) {
-  ASSERT(host_sinks_.count(host) == 0);
+  ASSERT(host_index_.count(host) == 0);
   DetectorHostSinkImpl* sink = new DetectorHostSinkImpl(shared_from_this(), host);
-  host_sinks_[host] = sink;
+  host_index_[host] = hosts_.size();
+  hosts_.push_back(host);
+  sinks_.push_back(sink);
   host->setOutlierDetector(DetectorHostSinkPtr{sink});
 }
 
+void DetectorImpl::removeHostSink(HostSharedPtr host) {
+  auto it = host_index_.find(host);
+  ASSERT(it != host_index_.end());
+  const uint32_t index = it->second;
+  host_index_.erase(it);
+
+  // Move the last host into the hole so the arrays stay dense.
+  const uint32_t last = hosts_.size() - 1;
+  if (index != last) {
+    hosts_[index] = std::move(hosts_[last]);
+    sinks_[index] = sinks_[last];
+    host_index_[hosts_[index]] = index;
+  }
+  hosts_.pop_back();
+  sinks_.pop_back();
+}
+
 void DetectorImpl::armIntervalTimer() {
   interval_timer_->enableTimer(std::chrono::milliseconds(
       runtime_.snapshot().getInteger("outlier_detection.interval_ms", config_.intervalMs())));
@@ -179,6 +224,9 @@ bool DetectorImpl::enforceEjection(EjectionType type) {
   case EjectionType::SuccessRate:
     return runtime_.snapshot().featureEnabled("outlier_detection.enforcing_success_rate",
                                               config_.enforcingSuccessRate());
+  case EjectionType::Latency:
+    return runtime_.snapshot().featureEnabled("outlier_detection.enforcing_latency",
+                                              config_.enforcingLatency());
   }
 
   NOT_REACHED;
@@ -188,12 +236,12 @@ void DetectorImpl::ejectHost(HostSharedPtr host, EjectionType type) {
   uint64_t max_ejection_percent = std::min<uint64_t>(
       100, runtime_.snapshot().getInteger("outlier_detection.max_ejection_percent",
                                           config_.maxEjectionPercent()));
-  double ejected_percent = 100.0 * stats_.ejections_active_.value() / host_sinks_.size();
+  double ejected_percent = 100.0 * stats_.ejections_active_.value() / hosts_.size();
   if (ejected_percent < max_ejection_percent) {
     stats_.ejections_total_.inc();
     if (enforceEjection(type)) {
       stats_.ejections_active_.inc();
-      host_sinks_[host]->eject(time_source_.currentTime());
+      sinks_[host_index_[host]]->eject(time_source_.currentTime());
       runCallbacks(host);
 
       if (event_logger_) {
@@ -238,7 +286,7 @@ void DetectorImpl::onConsecutive5xx(HostSharedPtr host) {
 void DetectorImpl::onConsecutive5xxWorker(HostSharedPtr host) {
   // This comes in cross thread. There is a chance that the host has already been removed from
   // the set. If so, just ignore it.
-  if (host_sinks_.count(host) == 0) {
+  if (host_index_.count(host) == 0) {
     return;
   }
 
@@ -250,9 +298,47 @@ void DetectorImpl::onConsecutive5xxWorker(HostSharedPtr host) {
   ejectHost(host, EjectionType::Consecutive5xx);
 }
 
-Utility::EjectionPair Utility::successRateEjectionThreshold(
-    double success_rate_sum, const std::vector<HostSuccessRatePair>& valid_success_rate_hosts,
-    double success_rate_stdev_factor) {
+void Utility::meanAndStdev(const std::vector<double>& data, double& mean, double& stdev) {
+  ASSERT(!data.empty());
+  // Both passes run over contiguous doubles with four independent accumulators. This breaks the
+  // loop carried dependency on a single sum so the compiler can vectorize the loops without having
+  // to reassociate floating point math (i.e., without -ffast-math).
+  const size_t size = data.size();
+  const size_t unrolled_size = size - (size % 4);
+  const double* values = data.data();
+
+  double sum[4] = {0, 0, 0, 0};
+  for (size_t i = 0; i < unrolled_size; i += 4) {
+    sum[0] += values[i];
+    sum[1] += values[i + 1];
+    sum[2] += values[i + 2];
+    sum[3] += values[i + 3];
+  }
+  for (size_t i = unrolled_size; i < size; i++) {
+    sum[0] += values[i];
+  }
+  mean = ((sum[0] + sum[1]) + (sum[2] + sum[3])) / size;
+
+  double variance[4] = {0, 0, 0, 0};
+  for (size_t i = 0; i < unrolled_size; i += 4) {
+    const double d0 = values[i] - mean;
+    const double d1 = values[i + 1] - mean;
+    const double d2 = values[i + 2] - mean;
+    const double d3 = values[i + 3] - mean;
+    variance[0] += d0 * d0;
+    variance[1] += d1 * d1;
+    variance[2] += d2 * d2;
+    variance[3] += d3 * d3;
+  }
+  for (size_t i = unrolled_size; i < size; i++) {
+    const double d = values[i] - mean;
+    variance[0] += d * d;
+  }
+  stdev = std::sqrt(((variance[0] + variance[1]) + (variance[2] + variance[3])) / size);
+}
+
+Utility::EjectionPair Utility::successRateEjectionThreshold(const std::vector<double>& success_rates,
+                                                            double success_rate_stdev_factor) {
   // This function is using mean and standard deviation as statistical measures for outlier
   // detection. First the mean is calculated by dividing the sum of success rate data over the
   // number of data points. Then variance is calculated by taking the mean of the
@@ -268,66 +354,118 @@ Utility::EjectionPair Utility::successRateEjectionThreshold(
   // variance = 400
   // stdev = 20
   // threshold returned = 52
-  double mean = success_rate_sum / valid_success_rate_hosts.size();
-  double variance = 0;
-  std::for_each(valid_success_rate_hosts.begin(), valid_success_rate_hosts.end(),
-                [&variance, mean](HostSuccessRatePair v) {
-                  variance += std::pow(v.success_rate_ - mean, 2);
-                });
-  variance /= valid_success_rate_hosts.size();
-  double stdev = std::sqrt(variance);
-
+  double mean;
+  double stdev;
+  meanAndStdev(success_rates, mean, stdev);
   return {mean, (mean - (success_rate_stdev_factor * stdev))};
 }
 
+Utility::LatencyEjectionPair Utility::latencyEjectionThreshold(const std::vector<double>& latencies,
+                                                               double latency_stdev_factor) {
+  // This mirrors successRateEjectionThreshold() with the threshold on the upper side of the mean,
+  // since a higher response time is worse.
+  double mean;
+  double stdev;
+  meanAndStdev(latencies, mean, stdev);
+  return {mean, (mean + (latency_stdev_factor * stdev))};
+}
+
+void DetectorImpl::processLatencyEjections() {
+  latency_ejection_threshold_ = -1;
+  if (config_.enforcingLatency() == 0) {
+    // Response times are not tracked.
+    return;
+  }
+
+  uint64_t latency_minimum_hosts = runtime_.snapshot().getInteger(
+      "outlier_detection.latency_minimum_hosts", config_.latencyMinimumHosts());
+  uint64_t latency_request_volume = runtime_.snapshot().getInteger(
+      "outlier_detection.latency_request_volume", config_.latencyRequestVolume());
+  if (hosts_.size() < latency_minimum_hosts) {
+    return;
+  }
+
+  valid_indices_.clear();
+  valid_values_.clear();
+  for (uint32_t i = 0; i < hosts_.size(); i++) {
+    if (!hosts_[i]->healthFlagGet(Host::HealthFlag::FAILED_OUTLIER_CHECK)) {
+      Optional<double> host_latency =
+          sinks_[i]->requestAccumulator().getResponseTimeP99(latency_request_volume);
+
+      if (host_latency.valid()) {
+        valid_indices_.push_back(i);
+        valid_values_.push_back(host_latency.value());
+        sinks_[i]->responseTimeP99(host_latency.value());
+      }
+    }
+  }
+
+  if (valid_values_.size() >= latency_minimum_hosts) {
+    double latency_stdev_factor = runtime_.snapshot().getInteger(
+                                      "outlier_detection.latency_stdev_factor",
+                                      config_.latencyStdevFactor()) /
+                                  1000.0;
+    Utility::LatencyEjectionPair ejection_pair =
+        Utility::latencyEjectionThreshold(valid_values_, latency_stdev_factor);
+    latency_ejection_threshold_ = ejection_pair.ejection_threshold_;
+    for (size_t i = 0; i < valid_values_.size(); i++) {
+      const HostSharedPtr& host = hosts_[valid_indices_[i]];
+      // A host may have been ejected for its success rate during this interval already.
+      if (valid_values_[i] > latency_ejection_threshold_ &&
+          !host->healthFlagGet(Host::HealthFlag::FAILED_OUTLIER_CHECK)) {
+        stats_.ejections_latency_.inc();
+        ejectHost(host, EjectionType::Latency);
+      }
+    }
+  }
+}
+
 void DetectorImpl::processSuccessRateEjections() {
   uint64_t success_rate_minimum_hosts = runtime_.snapshot().getInteger(
       "outlier_detection.success_rate_minimum_hosts", config_.successRateMinimumHosts());
   uint64_t success_rate_request_volume = runtime_.snapshot().getInteger(
       "outlier_detection.success_rate_request_volume", config_.successRateRequestVolume());
-  std::vector<HostSuccessRatePair> valid_success_rate_hosts;
-  double success_rate_sum = 0;
 
   // Reset the Detector's success rate mean and stdev.
   success_rate_average_ = -1;
   success_rate_ejection_threshold_ = -1;
 
   // Exit early if there are not enough hosts.
-  if (host_sinks_.size() < success_rate_minimum_hosts) {
+  if (hosts_.size() < success_rate_minimum_hosts) {
     return;
   }
 
-  // reserve upper bound of vector size to avoid reallocation.
-  valid_success_rate_hosts.reserve(host_sinks_.size());
-
-  for (const auto& host : host_sinks_) {
+  // The scratch arrays keep their capacity across intervals so steady state sweeps do not
+  // allocate.
+  valid_indices_.clear();
+  valid_values_.clear();
+  for (uint32_t i = 0; i < hosts_.size(); i++) {
     // Don't do work if the host is already ejected.
-    if (!host.first->healthFlagGet(Host::HealthFlag::FAILED_OUTLIER_CHECK)) {
+    if (!hosts_[i]->healthFlagGet(Host::HealthFlag::FAILED_OUTLIER_CHECK)) {
       Optional<double> host_success_rate =
-          host.second->successRateAccumulator().getSuccessRate(success_rate_request_volume);
+          sinks_[i]->requestAccumulator().getSuccessRate(success_rate_request_volume);
 
       if (host_success_rate.valid()) {
-        valid_success_rate_hosts.emplace_back(
-            HostSuccessRatePair(host.first, host_success_rate.value()));
-        success_rate_sum += host_success_rate.value();
-        host.second->successRate(host_success_rate.value());
+        valid_indices_.push_back(i);
+        valid_values_.push_back(host_success_rate.value());
+        sinks_[i]->successRate(host_success_rate.value());
       }
     }
   }
 
-  if (valid_success_rate_hosts.size() >= success_rate_minimum_hosts) {
+  if (valid_values_.size() >= success_rate_minimum_hosts) {
     double success_rate_stdev_factor =
         runtime_.snapshot().getInteger("outlier_detection.success_rate_stdev_factor",
                                        config_.successRateStdevFactor()) /
         1000.0;
-    Utility::EjectionPair ejection_pair = Utility::successRateEjectionThreshold(
-        success_rate_sum, valid_success_rate_hosts, success_rate_stdev_factor);
+    Utility::EjectionPair ejection_pair =
+        Utility::successRateEjectionThreshold(valid_values_, success_rate_stdev_factor);
     success_rate_average_ = ejection_pair.success_rate_average_;
     success_rate_ejection_threshold_ = ejection_pair.ejection_threshold_;
-    for (const auto& host_success_rate_pair : valid_success_rate_hosts) {
-      if (host_success_rate_pair.success_rate_ < success_rate_ejection_threshold_) {
+    for (size_t i = 0; i < valid_values_.size(); i++) {
+      if (valid_values_[i] < success_rate_ejection_threshold_) {
         stats_.ejections_success_rate_.inc();
-        ejectHost(host_success_rate_pair.host_, EjectionType::SuccessRate);
+        ejectHost(hosts_[valid_indices_[i]], EjectionType::SuccessRate);
       }
     }
   }
@@ -336,17 +474,20 @@ void DetectorImpl::processSuccessRateEjections() {
 void DetectorImpl::onIntervalTimer() {
   MonotonicTime now = time_source_.currentTime();
 
-  for (auto host : host_sinks_) {
-    checkHostForUneject(host.first, host.second, now);
+  for (uint32_t i = 0; i < hosts_.size(); i++) {
+    DetectorHostSinkImpl* sink = sinks_[i];
+    checkHostForUneject(hosts_[i], sink, now);
 
-    // Need to update the writer bucket to keep the data valid.
-    host.second->updateCurrentSuccessRateBucket();
+    // Merge the worker shards into the interval that just finished.
+    sink->requestAccumulator().updateInterval();
     // Refresh host success rate stat for the /clusters endpoint. If there is a new valid value, it
     // will get updated in processSuccessRateEjections().
-    host.second->successRate(-1);
+    sink->successRate(-1);
+    sink->responseTimeP99(-1);
   }
 
   processSuccessRateEjections();
+  processLatencyEjections();
 
   armIntervalTimer();
 }
@@ -387,6 +528,20 @@ void EventLoggerImpl::logEject(HostDescriptionConstSharedPtr host, Detector& det
     "\"cluster_average_success_rate\": \"{}\", " +
     "\"cluster_success_rate_ejection_threshold\": \"{}\"" +
     "}}\n";
+
+  static const std::string json_latency =
+    std::string("{{") +
+    "\"time\": \"{}\", " +
+    "\"secs_since_last_action\": \"{}\", " +
+    "\"cluster\": \"{}\", " +
+    "\"upstream_url\": \"{}\", " +
+    "\"action\": \"eject\", " +
+    "\"type\": \"{}\", " +
+    "\"num_ejections\": \"{}\", " +
+    "\"enforced\": \"{}\", " +
+    "\"host_p99_response_time_ms\": \"{}\", " +
+    "\"cluster_latency_ejection_threshold_ms\": \"{}\"" +
+    "}}\n";
   // clang-format on
   SystemTime now = time_source_.currentTime();
   MonotonicTime monotonic_now = monotonic_time_source_.currentTime();
@@ -407,6 +562,14 @@ void EventLoggerImpl::logEject(HostDescriptionConstSharedPtr host, Detector& det
         host->outlierDetector().numEjections(), enforced, host->outlierDetector().successRate(),
         detector.successRateAverage(), detector.successRateEjectionThreshold()));
     break;
+  case EjectionType::Latency:
+    file_->write(fmt::format(
+        json_latency, AccessLogDateTimeFormatter::fromTime(now),
+        secsSinceLastAction(host->outlierDetector().lastUnejectionTime(), monotonic_now),
+        host->cluster().name(), host->address()->asString(), typeToString(type),
+        host->outlierDetector().numEjections(), enforced, host->outlierDetector().responseTimeP99(),
+        detector.latencyEjectionThreshold()));
+    break;
   }
 }
 
@@ -437,6 +600,8 @@ std::string EventLoggerImpl::typeToString(EjectionType type) {
     return "5xx";
   case EjectionType::SuccessRate:
     return "SuccessRate";
+  case EjectionType::Latency:
+    return "Latency";
   }
 
   NOT_REACHED;
@@ -450,23 +615,131 @@ int EventLoggerImpl::secsSinceLastAction(const Optional<MonotonicTime>& lastActi
   return -1;
 }
 
-SuccessRateAccumulatorBucket* SuccessRateAccumulator::updateCurrentWriter() {
-  // Right now current is being written to and backup is not. Flush the backup and swap.
-  backup_success_rate_bucket_->success_request_counter_ = 0;
-  backup_success_rate_bucket_->total_request_counter_ = 0;
+const uint32_t RequestAccumulator::NUM_SHARDS;
+const uint32_t RequestAccumulator::NUM_RESPONSE_TIME_BUCKETS;
+
+RequestAccumulator::RequestAccumulator(bool track_response_times)
+    : shards_(new Shard[NUM_SHARDS]) {
+  static_assert(sizeof(Shard) == 64, "shards must be one cache line");
+  if (track_response_times) {
+    response_time_shards_.reset(new ResponseTimeShard[NUM_SHARDS]);
+    for (uint32_t i = 0; i < NUM_SHARDS; i++) {
+      for (std::atomic<uint32_t>& bucket : response_time_shards_[i].buckets_) {
+        bucket = 0;
+      }
+    }
+    last_response_time_buckets_.resize(NUM_RESPONSE_TIME_BUCKETS);
+    interval_response_time_buckets_.resize(NUM_RESPONSE_TIME_BUCKETS);
+  }
+}
+
+uint32_t RequestAccumulator::shardIndex() {
+  // Threads are assigned shards round robin the first time they record a result for any host.
+  static std::atomic<uint32_t> next_shard{0};
+  static thread_local uint32_t shard = next_shard++ % NUM_SHARDS;
+  return shard;
+}
+
+void RequestAccumulator::putResult(bool success) {
+  Shard& shard = shards_[shardIndex()];
+  shard.total_requests_.fetch_add(1, std::memory_order_relaxed);
+  if (success) {
+    shard.success_requests_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void RequestAccumulator::putResponseTime(std::chrono::milliseconds time) {
+  if (!response_time_shards_) {
+    return;
+  }
+
+  response_time_shards_[shardIndex()].buckets_[responseTimeBucket(time)].fetch_add(
+      1, std::memory_order_relaxed);
+}
+
+namespace {
+// Upper bounds in milliseconds of all but the last response time histogram bucket.
+const std::array<uint64_t, RequestAccumulator::NUM_RESPONSE_TIME_BUCKETS - 1>&
+responseTimeBucketBounds() {
+  static const std::array<uint64_t, RequestAccumulator::NUM_RESPONSE_TIME_BUCKETS - 1> bounds{
+      {1,    2,    3,    4,    5,    7,    10,   15,   20,    30,    40,
+       50,   75,   100,  150,  200,  300,  400,  500,  750,   1000,  1500,
+       2000, 3000, 4000, 5000, 7500, 10000, 15000, 20000, 30000}};
+  return bounds;
+}
+} // namespace
+
+uint32_t RequestAccumulator::responseTimeBucket(std::chrono::milliseconds time) {
+  const auto& bounds = responseTimeBucketBounds();
+  const uint64_t sample = std::max<int64_t>(0, time.count());
+  return std::lower_bound(bounds.begin(), bounds.end(), sample) - bounds.begin();
+}
 
-  current_success_rate_bucket_.swap(backup_success_rate_bucket_);
+void RequestAccumulator::updateInterval() {
+  uint64_t success_requests = 0;
+  uint64_t total_requests = 0;
+  for (uint32_t i = 0; i < NUM_SHARDS; i++) {
+    success_requests += shards_[i].success_requests_.load(std::memory_order_relaxed);
+    total_requests += shards_[i].total_requests_.load(std::memory_order_relaxed);
+  }
+
+  interval_total_requests_ = total_requests - last_total_requests_;
+  // Counters are read without synchronizing with the workers, so a success may be seen before
+  // the request it belongs to.
+  interval_success_requests_ =
+      std::min(success_requests - last_success_requests_, interval_total_requests_);
+  last_success_requests_ = success_requests;
+  last_total_requests_ = total_requests;
+
+  if (response_time_shards_) {
+    for (uint32_t bucket = 0; bucket < NUM_RESPONSE_TIME_BUCKETS; bucket++) {
+      uint32_t count = 0;
+      for (uint32_t i = 0; i < NUM_SHARDS; i++) {
+        count += response_time_shards_[i].buckets_[bucket].load(std::memory_order_relaxed);
+      }
 
-  return current_success_rate_bucket_.get();
+      // Unsigned arithmetic keeps the delta correct when a bucket wraps.
+      interval_response_time_buckets_[bucket] = count - last_response_time_buckets_[bucket];
+      last_response_time_buckets_[bucket] = count;
+    }
+  }
 }
 
-Optional<double> SuccessRateAccumulator::getSuccessRate(uint64_t success_rate_request_volume) {
-  if (backup_success_rate_bucket_->total_request_counter_ < success_rate_request_volume) {
+Optional<double> RequestAccumulator::getSuccessRate(uint64_t success_rate_request_volume) const {
+  if (interval_total_requests_ < success_rate_request_volume) {
     return Optional<double>();
   }
 
-  return Optional<double>(backup_success_rate_bucket_->success_request_counter_ * 100.0 /
-                          backup_success_rate_bucket_->total_request_counter_);
+  return Optional<double>(interval_success_requests_ * 100.0 / interval_total_requests_);
+}
+
+Optional<double> RequestAccumulator::getResponseTimeP99(uint64_t latency_request_volume) const {
+  if (!response_time_shards_) {
+    return Optional<double>();
+  }
+
+  uint64_t total = 0;
+  for (uint32_t count : interval_response_time_buckets_) {
+    total += count;
+  }
+
+  if (total == 0 || total < latency_request_volume) {
+    return Optional<double>();
+  }
+
+  // The sample at the 99th percentile rank is reported as the upper bound of its bucket. Samples
+  // beyond the last bound are reported as twice that bound.
+  const auto& bounds = responseTimeBucketBounds();
+  const uint64_t rank = (total * 99 + 99) / 100;
+  uint64_t seen = 0;
+  for (uint32_t bucket = 0; bucket < bounds.size(); bucket++) {
+    seen += interval_response_time_buckets_[bucket];
+    if (seen >= rank) {
+      return Optional<double>(bounds[bucket]);
+    }
+  }
+
+  return Optional<double>(bounds.back() * 2);
 }
 
 } // Outlier
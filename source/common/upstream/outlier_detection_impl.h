@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <cstdint>
@@ -33,6 +34,8 @@ public:
   const Optional<MonotonicTime>& lastEjectionTime() override { return time_; }
   const Optional<MonotonicTime>& lastUnejectionTime() override { return time_; }
   double successRate() const override { return -1; }
+  double responseTimeEwma() const override { return 0; }
+  double responseTimeP99() const override { return -1; }
 
 private:
   const Optional<MonotonicTime> time_;
@@ -49,50 +52,87 @@ public:
 };
 
 /**
- * Thin struct to facilitate calculations for success rate outlier detection.
+ * Per host request accumulator used for success rate and latency outlier detection. Workers record
+ * results into one of a fixed number of shards, picked per thread, so that workers serving the
+ * same host do not contend on a shared cache line. The shards only hold monotonically increasing
+ * counters. The main thread merges them once per detection interval and keeps the deltas of the
+ * interval that just finished, so nothing has to be reset or swapped under the workers.
  */
-struct HostSuccessRatePair {
-  HostSuccessRatePair(HostSharedPtr host, double success_rate)
-      : host_(host), success_rate_(success_rate) {}
-  HostSharedPtr host_;
-  double success_rate_;
-};
+class RequestAccumulator {
+public:
+  // Number of shards per host. Threads beyond this share shards, which is still correct.
+  static const uint32_t NUM_SHARDS = 8;
+  // Number of response time histogram buckets. The last bucket has no upper bound.
+  static const uint32_t NUM_RESPONSE_TIME_BUCKETS = 32;
 
-struct SuccessRateAccumulatorBucket {
-  std::atomic<uint64_t> success_request_counter_;
-  std::atomic<uint64_t> total_request_counter_;
-};
+  RequestAccumulator(bool track_response_times);
 
-/**
- * The SuccessRateAccumulator uses the SuccessRateAccumulatorBucket to get per host success rate
- * stats. This implementation has a fixed window size of time, and thus only needs a
- * bucket to write to, and a bucket to accumulate/run stats over.
- */
-class SuccessRateAccumulator {
-public:
-  SuccessRateAccumulator()
-      : current_success_rate_bucket_(new SuccessRateAccumulatorBucket()),
-        backup_success_rate_bucket_(new SuccessRateAccumulatorBucket()) {}
+  /**
+   * Record the outcome of a request. Called from any thread.
+   */
+  void putResult(bool success);
 
   /**
-   * This function updates the bucket to write data to.
-   * @return a pointer to the SuccessRateAccumulatorBucket.
+   * Record a response time. Called from any thread. A no-op if response times are not tracked.
    */
-  SuccessRateAccumulatorBucket* updateCurrentWriter();
+  void putResponseTime(std::chrono::milliseconds time);
+
   /**
-   * This function returns the success rate of a host over a window of time if the request volume is
-   * high enough. The underlying window of time could be dynamically adjusted. In the current
-   * implementation it is a fixed time window.
+   * Merge all shards and make the requests recorded since the previous call the current interval.
+   * Must only be called from the main thread.
+   */
+  void updateInterval();
+
+  /**
+   * This function returns the success rate of a host over the last interval if the request volume
+   * is high enough.
    * @param success_rate_request_volume the threshold of requests an accumulator has to have in
    *                                    order to be able to return a significant success rate value.
    * @return a valid Optional<double> with the success rate. If there were not enough requests, an
    *         invalid Optional<double> is returned.
    */
-  Optional<double> getSuccessRate(uint64_t success_rate_request_volume);
+  Optional<double> getSuccessRate(uint64_t success_rate_request_volume) const;
+
+  /**
+   * This function returns the 99th percentile response time of a host over the last interval, at
+   * the resolution of the response time histogram, if the request volume is high enough.
+   * @param latency_request_volume the number of response times an accumulator has to have in order
+   *                               to be able to return a significant value.
+   * @return a valid Optional<double> with the response time in milliseconds. If there were not
+   *         enough response times, or they are not tracked, an invalid Optional<double> is
+   *         returned.
+   */
+  Optional<double> getResponseTimeP99(uint64_t latency_request_volume) const;
+
+  /**
+   * @return the histogram bucket a response time falls into.
+   */
+  static uint32_t responseTimeBucket(std::chrono::milliseconds time);
 
 private:
-  std::unique_ptr<SuccessRateAccumulatorBucket> current_success_rate_bucket_;
-  std::unique_ptr<SuccessRateAccumulatorBucket> backup_success_rate_bucket_;
+  // Sized to a cache line so that the counters of different shards never share one.
+  struct Shard {
+    std::atomic<uint64_t> success_requests_{0};
+    std::atomic<uint64_t> total_requests_{0};
+    char padding_[48];
+  };
+
+  struct ResponseTimeShard {
+    std::array<std::atomic<uint32_t>, NUM_RESPONSE_TIME_BUCKETS> buckets_;
+  };
+
+  static uint32_t shardIndex();
+
+  std::unique_ptr<Shard[]> shards_;
+  std::unique_ptr<ResponseTimeShard[]> response_time_shards_;
+
+  // Main thread only. Merged totals as of the last interval and the deltas of that interval.
+  uint64_t last_success_requests_{};
+  uint64_t last_total_requests_{};
+  uint64_t interval_success_requests_{};
+  uint64_t interval_total_requests_{};
+  std::vector<uint32_t> last_response_time_buckets_;
+  std::vector<uint32_t> interval_response_time_buckets_;
 };
 
 class DetectorImpl;
@@ -102,25 +142,28 @@ class DetectorImpl;
  */
 class DetectorHostSinkImpl : public DetectorHostSink {
 public:
-  DetectorHostSinkImpl(std::shared_ptr<DetectorImpl> detector, HostSharedPtr host)
-      : detector_(detector), host_(host), success_rate_(-1) {
-    // Point the success_rate_accumulator_bucket_ pointer to a bucket.
-    updateCurrentSuccessRateBucket();
-  }
+  // Weight given to a response time below the current average.
+  static constexpr double ResponseTimeEwmaAlpha = 0.1;
+
+  DetectorHostSinkImpl(std::shared_ptr<DetectorImpl> detector, HostSharedPtr host);
 
   void eject(MonotonicTime ejection_time);
   void uneject(MonotonicTime ejection_time);
-  void updateCurrentSuccessRateBucket();
-  SuccessRateAccumulator& successRateAccumulator() { return success_rate_accumulator_; }
+  RequestAccumulator& requestAccumulator() { return request_accumulator_; }
   void successRate(double new_success_rate) { success_rate_ = new_success_rate; }
+  void responseTimeP99(double new_response_time_p99) { response_time_p99_ = new_response_time_p99; }
 
   // Upstream::Outlier::DetectorHostSink
   uint32_t numEjections() override { return num_ejections_; }
   void putHttpResponseCode(uint64_t response_code) override;
-  void putResponseTime(std::chrono::milliseconds) override {}
+  void putResponseTime(std::chrono::milliseconds time) override;
   const Optional<MonotonicTime>& lastEjectionTime() override { return last_ejection_time_; }
   const Optional<MonotonicTime>& lastUnejectionTime() override { return last_unejection_time_; }
   double successRate() const override { return success_rate_; }
+  double responseTimeEwma() const override {
+    return response_time_ewma_.load(std::memory_order_relaxed);
+  }
+  double responseTimeP99() const override { return response_time_p99_; }
 
 private:
   std::weak_ptr<DetectorImpl> detector_;
@@ -129,9 +172,10 @@ private:
   Optional<MonotonicTime> last_ejection_time_;
   Optional<MonotonicTime> last_unejection_time_;
   uint32_t num_ejections_{};
-  SuccessRateAccumulator success_rate_accumulator_;
-  std::atomic<SuccessRateAccumulatorBucket*> success_rate_accumulator_bucket_;
-  double success_rate_;
+  RequestAccumulator request_accumulator_;
+  double success_rate_{-1};
+  double response_time_p99_{-1};
+  std::atomic<double> response_time_ewma_{0};
 };
 
 /**
@@ -143,7 +187,8 @@ private:
   GAUGE  (ejections_active)                                                                        \
   COUNTER(ejections_overflow)                                                                      \
   COUNTER(ejections_consecutive_5xx)                                                               \
-  COUNTER(ejections_success_rate)
+  COUNTER(ejections_success_rate)                                                                  \
+  COUNTER(ejections_latency)
 // clang-format on
 
 /**
@@ -169,6 +214,10 @@ public:
   uint64_t successRateStdevFactor() { return success_rate_stdev_factor_; }
   uint64_t enforcingConsecutive5xx() { return enforcing_consecutive_5xx_; }
   uint64_t enforcingSuccessRate() { return enforcing_success_rate_; }
+  uint64_t latencyMinimumHosts() { return latency_minimum_hosts_; }
+  uint64_t latencyRequestVolume() { return latency_request_volume_; }
+  uint64_t latencyStdevFactor() { return latency_stdev_factor_; }
+  uint64_t enforcingLatency() { return enforcing_latency_; }
 
 private:
   const uint64_t interval_ms_;
@@ -180,6 +229,10 @@ private:
   const uint64_t success_rate_stdev_factor_;
   const uint64_t enforcing_consecutive_5xx_;
   const uint64_t enforcing_success_rate_;
+  const uint64_t latency_minimum_hosts_;
+  const uint64_t latency_request_volume_;
+  const uint64_t latency_stdev_factor_;
+  const uint64_t enforcing_latency_;
 };
 
 /**
@@ -203,6 +256,7 @@ public:
   void addChangedStateCb(ChangeStateCb cb) override { callbacks_.push_back(cb); }
   double successRateAverage() const override { return success_rate_average_; }
   double successRateEjectionThreshold() const override { return success_rate_ejection_threshold_; }
+  double latencyEjectionThreshold() const override { return latency_ejection_threshold_; }
 
 private:
   DetectorImpl(const Cluster& cluster, const Json::Object& json_config,
@@ -219,7 +273,9 @@ private:
   void onIntervalTimer();
   void runCallbacks(HostSharedPtr host);
   bool enforceEjection(EjectionType type);
+  void processLatencyEjections();
   void processSuccessRateEjections();
+  void removeHostSink(HostSharedPtr host);
 
   DetectorConfig config_;
   Event::Dispatcher& dispatcher_;
@@ -228,10 +284,20 @@ private:
   DetectionStats stats_;
   Event::TimerPtr interval_timer_;
   std::list<ChangeStateCb> callbacks_;
-  std::unordered_map<HostSharedPtr, DetectorHostSinkImpl*> host_sinks_;
+  // Hosts and their sinks are kept in parallel dense arrays so that the interval sweep walks
+  // contiguous memory. host_index_ maps a host to its position for the cross thread lookups and for
+  // swap-with-last removal.
+  std::vector<HostSharedPtr> hosts_;
+  std::vector<DetectorHostSinkImpl*> sinks_;
+  std::unordered_map<HostSharedPtr, uint32_t> host_index_;
+  // Scratch arrays reused by every ejection sweep: the indices of the hosts with enough volume and
+  // their success rate or latency, laid out contiguously for the threshold computation.
+  std::vector<uint32_t> valid_indices_;
+  std::vector<double> valid_values_;
   EventLoggerSharedPtr event_logger_;
   double success_rate_average_;
   double success_rate_ejection_threshold_;
+  double latency_ejection_threshold_;
 };
 
 class EventLoggerImpl : public EventLogger {
@@ -269,15 +335,37 @@ public:
    * This function returns an EjectionPair for success rate outlier detection. The pair contains
    * the average success rate of all valid hosts in the cluster and the ejection threshold.
    * If a host's success rate is under this threshold, the host is an outlier.
-   * @param success_rate_sum is the sum of the data in the success_rate_data vector.
-   * @param valid_success_rate_hosts is the vector containing the individual success rate data
-   *        points.
+   * @param success_rates is the vector containing the individual success rate data points.
+   * @param success_rate_stdev_factor is the number of standard deviations under the mean at which
+   *        a host becomes an outlier.
    * @return EjectionPair.
    */
-  static EjectionPair
-  successRateEjectionThreshold(double success_rate_sum,
-                               const std::vector<HostSuccessRatePair>& valid_success_rate_hosts,
-                               double success_rate_stdev_factor);
+  static EjectionPair successRateEjectionThreshold(const std::vector<double>& success_rates,
+                                                   double success_rate_stdev_factor);
+
+  struct LatencyEjectionPair {
+    double latency_average_;
+    double ejection_threshold_;
+  };
+
+  /**
+   * This function returns a LatencyEjectionPair for latency outlier detection. The pair contains
+   * the average 99th percentile response time of all valid hosts in the cluster and the ejection
+   * threshold. If a host's 99th percentile response time is over this threshold, the host is an
+   * outlier.
+   * @param latencies is the vector containing the individual latency data points.
+   * @param latency_stdev_factor is the number of standard deviations over the mean at which a host
+   *        becomes an outlier.
+   * @return LatencyEjectionPair.
+   */
+  static LatencyEjectionPair latencyEjectionThreshold(const std::vector<double>& latencies,
+                                                      double latency_stdev_factor);
+
+private:
+  /**
+   * Computes the mean and the population standard deviation of a non empty data set.
+   */
+  static void meanAndStdev(const std::vector<double>& data, double& mean, double& stdev);
 };
 
 } // Outlier
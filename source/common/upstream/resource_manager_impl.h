@@ -1,11 +1,14 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <cstdint>
 #include <memory>
 #include <string>
 
+#include "envoy/common/optional.h"
 #include "envoy/runtime/runtime.h"
+#include "envoy/stats/stats.h"
 #include "envoy/upstream/resource_manager.h"
 
 #include "common/common/assert.h"
@@ -13,6 +16,20 @@
 namespace Envoy {
 namespace Upstream {
 
+/**
+ * Retry budget settings. When a budget is configured, the number of parallel retries is limited to
+ * a percentage of the active requests (including pending requests) instead of a fixed maximum.
+ */
+struct RetryBudget {
+  // The percentage of active requests that may be retries at any one time.
+  double budget_percent_{};
+  // The number of parallel retries that are always allowed regardless of how few requests are
+  // active, so that clusters with little traffic can still retry.
+  uint64_t min_retry_concurrency_{};
+  // Incremented every time the budget suppresses a retry.
+  Stats::Counter* overflow_{};
+};
+
 /**
  * Implementation of ResourceManager.
  * NOTE: This implementation makes some assumptions which favor simplicity over correctness.
@@ -26,11 +43,14 @@ class ResourceManagerImpl : public ResourceManager {
 public:
   ResourceManagerImpl(Runtime::Loader& runtime, const std::string& runtime_key,
                       uint64_t max_connections, uint64_t max_pending_requests,
-                      uint64_t max_requests, uint64_t max_retries)
+                      uint64_t max_requests, uint64_t max_retries,
+                      const Optional<RetryBudget>& retry_budget = Optional<RetryBudget>())
       : connections_(max_connections, runtime, runtime_key + "max_connections"),
         pending_requests_(max_pending_requests, runtime, runtime_key + "max_pending_requests"),
         requests_(max_requests, runtime, runtime_key + "max_requests"),
-        retries_(max_retries, runtime, runtime_key + "max_retries") {}
+        retries_(max_retries, runtime, runtime_key + "max_retries", retry_budget,
+                 runtime_key + "retry_budget.min_retry_concurrency", requests_,
+                 pending_requests_) {}
 
   // Upstream::ResourceManager
   Resource& connections() override { return connections_; }
@@ -59,10 +79,52 @@ private:
     const std::string runtime_key_;
   };
 
+  /**
+   * The retries resource. Without a budget this is a plain ResourceImpl. With a budget the maximum
+   * follows the number of requests that are currently active, which is read from the same atomics
+   * that the connection pools already maintain so no additional locking is needed.
+   */
+  struct RetriesImpl : public ResourceImpl {
+    RetriesImpl(uint64_t max, Runtime::Loader& runtime, const std::string& runtime_key,
+                const Optional<RetryBudget>& budget, const std::string& min_concurrency_key,
+                const ResourceImpl& requests, const ResourceImpl& pending_requests)
+        : ResourceImpl(max, runtime, runtime_key), budget_(budget),
+          min_concurrency_key_(min_concurrency_key), requests_(requests),
+          pending_requests_(pending_requests) {}
+
+    // Upstream::Resource
+    bool canCreate() override {
+      if (current_ < max()) {
+        return true;
+      }
+
+      if (budget_.valid()) {
+        budget_.value().overflow_->inc();
+      }
+      return false;
+    }
+    uint64_t max() override {
+      if (!budget_.valid()) {
+        return ResourceImpl::max();
+      }
+
+      const RetryBudget& budget = budget_.value();
+      const uint64_t active = requests_.current_ + pending_requests_.current_;
+      const uint64_t allowed = static_cast<uint64_t>(active * budget.budget_percent_ / 100);
+      return std::max(allowed, runtime_.snapshot().getInteger(min_concurrency_key_,
+                                                               budget.min_retry_concurrency_));
+    }
+
+    const Optional<RetryBudget> budget_;
+    const std::string min_concurrency_key_;
+    const ResourceImpl& requests_;
+    const ResourceImpl& pending_requests_;
+  };
+
   ResourceImpl connections_;
   ResourceImpl pending_requests_;
   ResourceImpl requests_;
-  ResourceImpl retries_;
+  RetriesImpl retries_;
 };
 
 typedef std::unique_ptr<ResourceManagerImpl> ResourceManagerImplPtr;
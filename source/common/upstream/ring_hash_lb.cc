@@ -1,10 +1,15 @@
 #include "common/upstream/ring_hash_lb.h"
 
+#include <algorithm>
 #include <cstdint>
+#include <iterator>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "common/common/assert.h"
+#include "common/common/hash.h"
+#include "common/common/utility.h"
 #include "common/upstream/load_balancer_impl.h"
 
 namespace Envoy {
@@ -12,24 +17,70 @@ namespace Upstream {
 
 RingHashLoadBalancer::RingHashLoadBalancer(HostSet& host_set, ClusterStats& stats,
                                            Runtime::Loader& runtime,
-                                           Runtime::RandomGenerator& random)
-    : host_set_(host_set), stats_(stats), runtime_(runtime), random_(random) {
-  host_set_.addMemberUpdateCb([this](const std::vector<HostSharedPtr>&,
-                                     const std::vector<HostSharedPtr>&) -> void { refresh(); });
-
-  refresh();
+                                           Runtime::RandomGenerator& random,
+                                           RingHashFunction hash_function)
+    : host_set_(host_set), stats_(stats), runtime_(runtime), random_(random),
+      table_builder_(new TableBuilder(runtime, hash_function)), table_(own_table_) {
+  host_set_.addMemberUpdateCb(
+      [this](const std::vector<HostSharedPtr>&, const std::vector<HostSharedPtr>&) -> void {
+        own_table_ = table_builder_->build(host_set_);
+      });
+
+  own_table_ = table_builder_->build(host_set_);
 }
 
+RingHashLoadBalancer::RingHashLoadBalancer(HostSet& host_set, ClusterStats& stats,
+                                           Runtime::Loader& runtime,
+                                           Runtime::RandomGenerator& random,
+                                           const LoadBalancerTableConstSharedPtr& table)
+    : host_set_(host_set), stats_(stats), runtime_(runtime), random_(random), table_(table) {}
+
 HostConstSharedPtr RingHashLoadBalancer::chooseHost(const LoadBalancerContext* context) {
-  if (LoadBalancerUtility::isGlobalPanic(host_set_, stats_, runtime_)) {
-    return all_hosts_ring_.chooseHost(context, random_);
-  } else {
-    return healthy_hosts_ring_.chooseHost(context, random_);
+  // A cluster that never had hosts has no rings yet.
+  if (!table_) {
+    return nullptr;
+  }
+
+  const Rings& rings = static_cast<const Rings&>(*table_);
+  const Ring& ring = LoadBalancerUtility::isGlobalPanic(host_set_, stats_, runtime_)
+                         ? rings.all_hosts_ring_
+                         : rings.healthy_hosts_ring_;
+  return ring.chooseHost(context, random_, loadBound(ring));
+}
+
+LoadBalancerTableConstSharedPtr
+RingHashLoadBalancer::TableBuilder::build(const HostSet& host_set) {
+  const Rings* previous = static_cast<const Rings*>(last_table_.get());
+  std::shared_ptr<Rings> rings = std::make_shared<Rings>();
+  rings->all_hosts_ring_.create(runtime_, host_set.hosts(), hash_function_,
+                                previous ? &previous->all_hosts_ring_ : nullptr);
+  rings->healthy_hosts_ring_.create(runtime_, host_set.healthyHosts(), hash_function_,
+                                    previous ? &previous->healthy_hosts_ring_ : nullptr);
+  last_table_ = rings;
+  return last_table_;
+}
+
+uint64_t RingHashLoadBalancer::loadBound(const Ring& ring) {
+  uint64_t bounded_load_percent =
+      runtime_.snapshot().getInteger("upstream.ring_hash.bounded_load_percent", 0);
+  if (bounded_load_percent == 0 || ring.hosts_.empty()) {
+    return 0;
   }
+
+  // A bound below the average load could leave every host over it.
+  bounded_load_percent = std::max<uint64_t>(100, bounded_load_percent);
+
+  // The request being balanced is counted so that an idle cluster admits a request on every host.
+  // The cluster wide active request count is used as the total load, which avoids summing the
+  // counters of all hosts on every pick.
+  const uint64_t total_load = stats_.upstream_rq_active_.value() + 1;
+  const uint64_t hosts = 100 * ring.hosts_.size();
+  return (total_load * bounded_load_percent + hosts - 1) / hosts;
 }
 
 HostConstSharedPtr RingHashLoadBalancer::Ring::chooseHost(const LoadBalancerContext* context,
-                                                          Runtime::RandomGenerator& random) {
+                                                          Runtime::RandomGenerator& random,
+                                                          uint64_t load_bound) const {
   if (ring_.empty()) {
     return nullptr;
   }
@@ -43,6 +94,24 @@ HostConstSharedPtr RingHashLoadBalancer::Ring::chooseHost(const LoadBalancerCont
     h = context->hashKey().value();
   }
 
+  const size_t entry = findEntry(h);
+  if (load_bound == 0) {
+    return ring_[entry].host_;
+  }
+
+  // Walk the ring until a host below the bound is found. The bound is at least the average load,
+  // so some host is below it unless the active request counters moved in the meantime.
+  for (size_t i = 0; i < ring_.size(); i++) {
+    const HostConstSharedPtr& host = ring_[(entry + i) % ring_.size()].host_;
+    if (host->activeRequests() < load_bound) {
+      return host;
+    }
+  }
+
+  return ring_[entry].host_;
+}
+
+size_t RingHashLoadBalancer::Ring::findEntry(uint64_t h) const {
   // Ported from https://github.com/RJ/ketama/blob/master/libketama/ketama.c (ketama_get_server)
   // I've generally kept the variable names to make the code easier to compare.
   // NOTE: The algorithm depends on using signed integers for lowp, midp, and highp. Do not
@@ -53,14 +122,14 @@ HostConstSharedPtr RingHashLoadBalancer::Ring::chooseHost(const LoadBalancerCont
     int64_t midp = (lowp + highp) / 2;
 
     if (midp == static_cast<int64_t>(ring_.size())) {
-      return ring_[0].host_;
+      return 0;
     }
 
     uint64_t midval = ring_[midp].hash_;
     uint64_t midval1 = midp == 0 ? 0 : ring_[midp - 1].hash_;
 
     if (h <= midval && h > midval1) {
-      return ring_[midp].host_;
+      return midp;
     }
 
     if (midval < h) {
@@ -70,27 +139,42 @@ HostConstSharedPtr RingHashLoadBalancer::Ring::chooseHost(const LoadBalancerCont
     }
 
     if (lowp > highp) {
-      return ring_[0].host_;
+      return 0;
     }
   }
 }
 
+void RingHashLoadBalancer::Ring::addHostEntries(const HostSharedPtr& host,
+                                                uint64_t hashes_per_host,
+                                                RingHashFunction hash_function,
+                                                std::vector<RingEntry>& entries) {
+  // The key of every entry is the host address followed by the entry index. The key buffer is
+  // reused so that building the entries of a host only rewrites the index digits.
+  std::string hash_key(host->address()->asString() + "_");
+  const size_t prefix_length = hash_key.size();
+  char index[32];
+  for (uint64_t i = 0; i < hashes_per_host; i++) {
+    hash_key.resize(prefix_length);
+    hash_key.append(index, StringUtil::itoa(index, sizeof(index), i));
+    const uint64_t hash = hash_function == RingHashFunction::XxHash64
+                              ? HashUtil::xxHash64(hash_key)
+                              : std::hash<std::string>()(hash_key);
+    log_trace("ring hash: hash_key={} hash={}", hash_key, hash);
+    entries.push_back({hash, host});
+  }
+}
+
 void RingHashLoadBalancer::Ring::create(Runtime::Loader& runtime,
-                                        const std::vector<HostSharedPtr>& hosts) {
-  log_trace("ring hash: building ring");
-  ring_.clear();
+                                        const std::vector<HostSharedPtr>& hosts,
+                                        RingHashFunction hash_function, const Ring* previous) {
   if (hosts.empty()) {
+    log_trace("ring hash: empty ring");
     return;
   }
 
   // Currently we specify the minimum size of the ring, and determine the replication factor
   // based on the number of hosts. It's possible we might want to support more sophisticated
   // configuration in the future.
-  // NOTE: Currently we keep a ring for healthy hosts and unhealthy hosts, and this is done per
-  //       thread. This is the simplest implementation, but it's expensive from a memory
-  //       standpoint and duplicates the regeneration computation. In the future we might want
-  //       to generate the rings centrally and then just RCU them out to each thread. This is
-  //       sufficient for getting started.
   uint64_t min_ring_size = runtime.snapshot().getInteger("upstream.ring_hash.min_ring_size", 1024);
 
   uint64_t hashes_per_host = 1;
@@ -101,19 +185,46 @@ void RingHashLoadBalancer::Ring::create(Runtime::Loader& runtime,
     }
   }
 
-  log_trace("ring hash: min_ring_size={} hashes_per_host={}", min_ring_size, hashes_per_host);
-  ring_.reserve(hosts.size() * hashes_per_host);
+  auto entry_less = [](const RingEntry& lhs, const RingEntry& rhs)
+                        -> bool { return lhs.hash_ < rhs.hash_; };
+
+  hosts_.reserve(hosts.size());
   for (const auto& host : hosts) {
-    for (uint64_t i = 0; i < hashes_per_host; i++) {
-      std::string hash_key(host->address()->asString() + "_" + std::to_string(i));
-      uint64_t hash = std::hash<std::string>()(hash_key);
-      log_trace("ring hash: hash_key={} hash={}", hash_key, hash);
-      ring_.push_back({hash, host});
+    hosts_.insert(host.get());
+  }
+  hashes_per_host_ = hashes_per_host;
+
+  ring_.reserve(hosts.size() * hashes_per_host);
+  if (!previous || previous->ring_.empty() || hashes_per_host != previous->hashes_per_host_) {
+    log_trace("ring hash: building ring min_ring_size={} hashes_per_host={}", min_ring_size,
+              hashes_per_host);
+    for (const auto& host : hosts) {
+      addHostEntries(host, hashes_per_host, hash_function, ring_);
+    }
+
+    std::sort(ring_.begin(), ring_.end(), entry_less);
+  } else {
+    // Keep the entries of the hosts that remain, then hash only the added hosts and merge their
+    // sorted entries into the ring. This produces the same ring as a full rebuild.
+    log_trace("ring hash: updating ring hashes_per_host={}", hashes_per_host);
+    std::copy_if(previous->ring_.begin(), previous->ring_.end(), std::back_inserter(ring_),
+                 [this](const RingEntry& entry) -> bool {
+                   return hosts_.count(entry.host_.get()) != 0;
+                 });
+
+    std::vector<RingEntry> added_entries;
+    for (const auto& host : hosts) {
+      if (previous->hosts_.count(host.get()) == 0) {
+        addHostEntries(host, hashes_per_host, hash_function, added_entries);
+      }
     }
+
+    std::sort(added_entries.begin(), added_entries.end(), entry_less);
+    const size_t kept_size = ring_.size();
+    ring_.insert(ring_.end(), added_entries.begin(), added_entries.end());
+    std::inplace_merge(ring_.begin(), ring_.begin() + kept_size, ring_.end(), entry_less);
   }
 
-  std::sort(ring_.begin(), ring_.end(), [](const RingEntry& lhs, const RingEntry& rhs)
-                                            -> bool { return lhs.hash_ < rhs.hash_; });
 #ifndef NDEBUG
   for (auto entry : ring_) {
     log_trace("ring hash: host={} hash={}", entry.host_->address()->asString(), entry.hash_);
@@ -121,10 +232,5 @@ void RingHashLoadBalancer::Ring::create(Runtime::Loader& runtime,
 #endif
 }
 
-void RingHashLoadBalancer::refresh() {
-  all_hosts_ring_.create(runtime_, host_set_.hosts());
-  healthy_hosts_ring_.create(runtime_, host_set_.healthyHosts());
-}
-
 } // Upstream
 } // Envoy
@@ -1,10 +1,13 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
+#include <unordered_set>
 #include <vector>
 
 #include "envoy/runtime/runtime.h"
 #include "envoy/upstream/load_balancer.h"
+#include "envoy/upstream/load_balancer_type.h"
 
 #include "common/common/logger.h"
 
@@ -14,16 +17,56 @@ namespace Upstream {
 /**
  * A load balancer that implements consistent modulo hashing ("ketama"). Currently, zone aware
  * routing is not supported. A ring is kept for all hosts as well as a ring for healthy hosts.
- * Unless we are in panic mode, the healthy host ring is used.
+ * Unless we are in panic mode, the healthy host ring is used. Hosts are placed on the ring with
+ * either std::hash, which is the historical default but whose output depends on the standard
+ * library, or xxHash64, which is faster and stable across builds and platforms.
+ *
+ * The rings are immutable once built. A cluster manager builds them once on the main thread with a
+ * TableBuilder and shares them with the load balancers of all workers. A load balancer that is not
+ * given shared rings, such as the load balancer of a subset, builds its own.
+ *
+ * Optionally, "consistent hashing with bounded loads" is applied to protect against hot shards:
+ * when the host a key hashes to already has at least the configured multiple of the average
+ * number of active requests, the pick walks the ring to the next host that is below that bound.
+ *
  * In the future it would be nice to support:
  * 1) Weighting.
  * 2) Per-zone rings and optional zone aware routing (not all applications will want this).
- * 3) Max request fallback to support hot shards (not all applications will want this).
  */
 class RingHashLoadBalancer : public LoadBalancer, Logger::Loggable<Logger::Id::upstream> {
 public:
+  /**
+   * Builds the shared rings of a cluster.
+   */
+  class TableBuilder : public LoadBalancerTableBuilder {
+  public:
+    TableBuilder(Runtime::Loader& runtime, RingHashFunction hash_function)
+        : runtime_(runtime), hash_function_(hash_function) {}
+
+    // Upstream::LoadBalancerTableBuilder
+    LoadBalancerTableConstSharedPtr build(const HostSet& host_set) override;
+
+  private:
+    Runtime::Loader& runtime_;
+    const RingHashFunction hash_function_;
+    // Kept so that the next build only hashes the hosts that were added.
+    LoadBalancerTableConstSharedPtr last_table_;
+  };
+
+  /**
+   * Build a load balancer that maintains its own rings.
+   */
   RingHashLoadBalancer(HostSet& host_set, ClusterStats& stats, Runtime::Loader& runtime,
-                       Runtime::RandomGenerator& random);
+                       Runtime::RandomGenerator& random, RingHashFunction hash_function);
+
+  /**
+   * Build a load balancer that picks from shared rings.
+   * @param table supplies the rings built by a TableBuilder for the current hosts of host_set.
+   *        The owner replaces the rings before the hosts of host_set change.
+   */
+  RingHashLoadBalancer(HostSet& host_set, ClusterStats& stats, Runtime::Loader& runtime,
+                       Runtime::RandomGenerator& random,
+                       const LoadBalancerTableConstSharedPtr& table);
 
   // Upstream::LoadBalancer
   HostConstSharedPtr chooseHost(const LoadBalancerContext* context) override;
@@ -35,21 +78,44 @@ private:
   };
 
   struct Ring {
+    /**
+     * @param load_bound supplies the number of active requests at which a host is skipped in favor
+     *        of the next host on the ring. 0 disables the bound.
+     */
     HostConstSharedPtr chooseHost(const LoadBalancerContext* context,
-                                  Runtime::RandomGenerator& random);
-    void create(Runtime::Loader& runtime, const std::vector<HostSharedPtr>& hosts);
+                                  Runtime::RandomGenerator& random, uint64_t load_bound) const;
+    size_t findEntry(uint64_t h) const;
+    /**
+     * @param previous supplies a ring built for an earlier host list, or nullptr. If its
+     *        replication factor still applies, only the hosts that were added are hashed.
+     */
+    void create(Runtime::Loader& runtime, const std::vector<HostSharedPtr>& hosts,
+                RingHashFunction hash_function, const Ring* previous);
+    static void addHostEntries(const HostSharedPtr& host, uint64_t hashes_per_host,
+                               RingHashFunction hash_function, std::vector<RingEntry>& entries);
 
     std::vector<RingEntry> ring_;
+    // The hosts that the ring was built from and the replication factor it was built with. These
+    // allow a membership change to be applied by only hashing the hosts that were added.
+    std::unordered_set<const Host*> hosts_;
+    uint64_t hashes_per_host_{};
+  };
+
+  struct Rings : public LoadBalancerTable {
+    Ring all_hosts_ring_;
+    Ring healthy_hosts_ring_;
   };
 
-  void refresh();
+  uint64_t loadBound(const Ring& ring);
 
   HostSet& host_set_;
   ClusterStats& stats_;
   Runtime::Loader& runtime_;
   Runtime::RandomGenerator& random_;
-  Ring all_hosts_ring_;
-  Ring healthy_hosts_ring_;
+  // Only used by a load balancer that maintains its own rings.
+  std::unique_ptr<TableBuilder> table_builder_;
+  LoadBalancerTableConstSharedPtr own_table_;
+  const LoadBalancerTableConstSharedPtr& table_;
 };
 
 } // Upstream
@@ -19,7 +19,13 @@ SdsClusterImpl::SdsClusterImpl(const Json::Object& config, Runtime::Loader& runt
                                Runtime::RandomGenerator& random)
     : BaseDynamicClusterImpl(config, runtime, stats, ssl_context_manager),
       RestApiFetcher(cm, sds_config.sds_cluster_name_, dispatcher, random,
-                     sds_config.refresh_delay_),
+                     sds_config.refresh_delay_,
+                     sds_config.stream_ ? ApiType::Stream : ApiType::Rest, info_->statsScope(),
+                     "sds.",
+                     sds_config.snapshot_dir_.empty()
+                         ? ""
+                         : fmt::format("{}/sds_{}", sds_config.snapshot_dir_,
+                                       config.getString("service_name"))),
       local_info_(local_info), service_name_(config.getString("service_name")) {}
 
 void SdsClusterImpl::parseResponse(const Http::Message& response) {
@@ -30,16 +36,20 @@ void SdsClusterImpl::parseResponse(const Http::Message& response) {
     bool canary = false;
     uint32_t weight = 1;
     std::string zone = "";
+    uint32_t priority = 0;
+    HostMetadata metadata;
     if (host->hasObject("tags")) {
       canary = host->getObject("tags")->getBoolean("canary", canary);
       weight = host->getObject("tags")->getInteger("load_balancing_weight", weight);
       zone = host->getObject("tags")->getString("az", zone);
+      priority = host->getObject("tags")->getInteger("priority", priority);
+      metadata = HostDescriptionImpl::parseMetadata(*host->getObject("tags"));
     }
 
     new_hosts.emplace_back(new HostImpl(
         info_, "", Network::Address::InstanceConstSharedPtr{new Network::Address::Ipv4Instance(
                        host->getString("ip_address"), host->getInteger("port"))},
-        canary, weight, zone));
+        canary, weight, zone, metadata, priority));
   }
 
   HostVectorSharedPtr current_hosts_copy(new std::vector<HostSharedPtr>(hosts()));
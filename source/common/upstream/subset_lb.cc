@@ -0,0 +1,173 @@
+#include "common/upstream/subset_lb.h"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace Envoy {
+namespace Upstream {
+
+size_t SubsetLoadBalancer::HostMetadataHash::operator()(const HostMetadata& metadata) const {
+  size_t hash = 0;
+  for (const auto& entry : metadata) {
+    hash = hash * 31 + std::hash<std::string>()(entry.first);
+    hash = hash * 31 + std::hash<std::string>()(entry.second);
+  }
+  return hash;
+}
+
+SubsetLoadBalancer::SubsetLoadBalancer(HostSet& host_set, const LbSubsetInfo& subset_info,
+                                       ClusterStats& stats, SubsetLoadBalancerFactoryCb lb_factory)
+    : host_set_(host_set), subset_info_(subset_info), stats_(stats), lb_factory_(lb_factory) {
+  if (subset_info_.fallbackPolicy() == LbSubsetInfo::FallbackPolicy::AnyEndpoint) {
+    fallback_lb_ = lb_factory_(host_set_);
+  }
+
+  update(host_set_.hosts(), {});
+  host_set_.addMemberUpdateCb([this](const std::vector<HostSharedPtr>& hosts_added,
+                                     const std::vector<HostSharedPtr>& hosts_removed) -> void {
+    update(hosts_added, hosts_removed);
+  });
+}
+
+SubsetLoadBalancer::~SubsetLoadBalancer() { stats_.lb_subsets_active_.sub(subsets_.size()); }
+
+HostConstSharedPtr SubsetLoadBalancer::chooseHost(const LoadBalancerContext* context) {
+  const HostMetadata* criteria = context ? context->metadataMatchCriteria() : nullptr;
+  if (criteria) {
+    auto subset = subsets_.find(*criteria);
+    if (subset != subsets_.end()) {
+      stats_.lb_subsets_selected_.inc();
+      return subset->second->lb_->chooseHost(context);
+    }
+  }
+
+  if (!fallback_lb_) {
+    return nullptr;
+  }
+
+  stats_.lb_subsets_fallback_.inc();
+  return fallback_lb_->chooseHost(context);
+}
+
+void SubsetLoadBalancer::addHost(const HostSharedPtr& host) {
+  std::vector<Subset*>& host_subsets = host_subsets_[host];
+  for (const std::set<std::string>& keys : subset_info_.subsetKeys()) {
+    // A host only belongs to a subset of a key set if it has a value for every key of the set.
+    HostMetadata values;
+    for (const std::string& key : keys) {
+      auto value = host->metadata().find(key);
+      if (value == host->metadata().end()) {
+        break;
+      }
+      values.emplace(*value);
+    }
+    if (values.size() != keys.size()) {
+      continue;
+    }
+
+    SubsetPtr& subset = subsets_[values];
+    if (!subset) {
+      subset.reset(new Subset());
+      subset->lb_ = lb_factory_(subset->host_set_);
+      stats_.lb_subsets_created_.inc();
+      stats_.lb_subsets_active_.inc();
+    }
+
+    // The same key set may be configured more than once.
+    if (std::find(host_subsets.begin(), host_subsets.end(), subset.get()) == host_subsets.end()) {
+      host_subsets.push_back(subset.get());
+    }
+  }
+}
+
+void SubsetLoadBalancer::update(const std::vector<HostSharedPtr>& hosts_added,
+                                const std::vector<HostSharedPtr>& hosts_removed) {
+  for (const HostSharedPtr& host : hosts_added) {
+    addHost(host);
+  }
+
+  for (auto& subset : subsets_) {
+    subset.second->hosts_.clear();
+    subset.second->healthy_hosts_.clear();
+    subset.second->hosts_per_zone_.assign(host_set_.hostsPerZone().size(), {});
+    subset.second->healthy_hosts_per_zone_.assign(host_set_.healthyHostsPerZone().size(), {});
+    subset.second->hosts_added_.clear();
+    subset.second->hosts_removed_.clear();
+  }
+
+  const auto for_each_subset = [this](const std::vector<HostSharedPtr>& hosts,
+                                      std::function<void(Subset&, const HostSharedPtr&)> cb) {
+    for (const HostSharedPtr& host : hosts) {
+      auto host_subsets = host_subsets_.find(host);
+      if (host_subsets == host_subsets_.end()) {
+        continue;
+      }
+      for (Subset* subset : host_subsets->second) {
+        cb(*subset, host);
+      }
+    }
+  };
+
+  for_each_subset(hosts_added, [](Subset& subset, const HostSharedPtr& host) -> void {
+    subset.hosts_added_.push_back(host);
+  });
+  for_each_subset(hosts_removed, [](Subset& subset, const HostSharedPtr& host) -> void {
+    subset.hosts_removed_.push_back(host);
+  });
+  for (const HostSharedPtr& host : hosts_removed) {
+    host_subsets_.erase(host);
+  }
+
+  // Rebuild the host lists of every subset with a single pass over the parent lists. This keeps
+  // the relative order of hosts and the zone indexes of the parent.
+  for_each_subset(host_set_.hosts(), [](Subset& subset, const HostSharedPtr& host) -> void {
+    subset.hosts_.push_back(host);
+  });
+  for_each_subset(host_set_.healthyHosts(), [](Subset& subset, const HostSharedPtr& host) -> void {
+    subset.healthy_hosts_.push_back(host);
+  });
+  for (size_t zone = 0; zone < host_set_.hostsPerZone().size(); zone++) {
+    for_each_subset(host_set_.hostsPerZone()[zone],
+                    [zone](Subset& subset, const HostSharedPtr& host) -> void {
+                      subset.hosts_per_zone_[zone].push_back(host);
+                    });
+  }
+  for (size_t zone = 0; zone < host_set_.healthyHostsPerZone().size(); zone++) {
+    for_each_subset(host_set_.healthyHostsPerZone()[zone],
+                    [zone](Subset& subset, const HostSharedPtr& host) -> void {
+                      subset.healthy_hosts_per_zone_[zone].push_back(host);
+                    });
+  }
+
+  for (auto it = subsets_.begin(); it != subsets_.end();) {
+    Subset& subset = *it->second;
+    if (subset.hosts_.empty()) {
+      it = subsets_.erase(it);
+      stats_.lb_subsets_removed_.inc();
+      stats_.lb_subsets_active_.dec();
+      continue;
+    }
+
+    // Only subsets whose membership or health changed notify their load balancer.
+    if (!subset.hosts_added_.empty() || !subset.hosts_removed_.empty() ||
+        subset.healthy_hosts_ != subset.host_set_.healthyHosts() ||
+        subset.healthy_hosts_per_zone_ != subset.host_set_.healthyHostsPerZone()) {
+      subset.host_set_.updateHosts(
+          std::make_shared<const std::vector<HostSharedPtr>>(std::move(subset.hosts_)),
+          std::make_shared<const std::vector<HostSharedPtr>>(std::move(subset.healthy_hosts_)),
+          std::make_shared<const std::vector<std::vector<HostSharedPtr>>>(
+              std::move(subset.hosts_per_zone_)),
+          std::make_shared<const std::vector<std::vector<HostSharedPtr>>>(
+              std::move(subset.healthy_hosts_per_zone_)),
+          subset.hosts_added_, subset.hosts_removed_);
+    }
+    ++it;
+  }
+}
+
+} // Upstream
+} // Envoy
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "envoy/upstream/load_balancer.h"
+#include "envoy/upstream/upstream.h"
+
+#include "common/common/logger.h"
+#include "common/upstream/upstream_impl.h"
+
+namespace Envoy {
+namespace Upstream {
+
+/**
+ * Creates the load balancer used for a subset (or for the fallback over all hosts).
+ */
+typedef std::function<LoadBalancerPtr(HostSet& host_set)> SubsetLoadBalancerFactoryCb;
+
+/**
+ * A load balancer that partitions a host set into subsets by host metadata. For every configured
+ * key set a subset is kept per distinct combination of values that hosts carry for those keys.
+ * Subsets are indexed by their metadata values so that the subset matching the metadata criteria
+ * of a request is found with a single hash lookup, and the host is then chosen by a regular load
+ * balancer that only sees the hosts of the subset. Subsets are maintained from the member update
+ * callbacks of the parent host set: a host's subsets are computed once when it is added, and each
+ * update rebuilds the subset host lists in one pass over the parent lists.
+ */
+class SubsetLoadBalancer : public LoadBalancer, Logger::Loggable<Logger::Id::upstream> {
+public:
+  SubsetLoadBalancer(HostSet& host_set, const LbSubsetInfo& subset_info, ClusterStats& stats,
+                     SubsetLoadBalancerFactoryCb lb_factory);
+  ~SubsetLoadBalancer();
+
+  // Upstream::LoadBalancer
+  HostConstSharedPtr chooseHost(const LoadBalancerContext* context) override;
+
+private:
+  struct Subset {
+    HostSetImpl host_set_;
+    // Declared after host_set_ so that the load balancer is destroyed first.
+    LoadBalancerPtr lb_;
+
+    // Scratch lists filled while rebuilding the subset during a parent update.
+    std::vector<HostSharedPtr> hosts_;
+    std::vector<HostSharedPtr> healthy_hosts_;
+    std::vector<std::vector<HostSharedPtr>> hosts_per_zone_;
+    std::vector<std::vector<HostSharedPtr>> healthy_hosts_per_zone_;
+    std::vector<HostSharedPtr> hosts_added_;
+    std::vector<HostSharedPtr> hosts_removed_;
+  };
+
+  typedef std::unique_ptr<Subset> SubsetPtr;
+
+  struct HostMetadataHash {
+    size_t operator()(const HostMetadata& metadata) const;
+  };
+
+  void addHost(const HostSharedPtr& host);
+  void update(const std::vector<HostSharedPtr>& hosts_added,
+              const std::vector<HostSharedPtr>& hosts_removed);
+
+  HostSet& host_set_;
+  const LbSubsetInfo& subset_info_;
+  ClusterStats& stats_;
+  SubsetLoadBalancerFactoryCb lb_factory_;
+  LoadBalancerPtr fallback_lb_;
+  std::unordered_map<HostMetadata, SubsetPtr, HostMetadataHash> subsets_;
+  // The subsets each host of the parent host set belongs to. Host metadata does not change during
+  // the lifetime of a host, so this is only computed when a host is added.
+  std::unordered_map<HostSharedPtr, std::vector<Subset*>> host_subsets_;
+};
+
+} // Upstream
+} // Envoy
@@ -5,6 +5,7 @@
 #include <list>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -26,6 +27,8 @@
 #include "common/ssl/context_config_impl.h"
 #include "common/upstream/health_checker_impl.h"
 #include "common/upstream/logical_dns_cluster.h"
+#include "common/upstream/dynamic_forward_proxy_cluster.h"
+#include "common/upstream/original_dst_cluster.h"
 #include "common/upstream/sds.h"
 
 #include "spdlog/spdlog.h"
@@ -33,19 +36,59 @@
 namespace Envoy {
 namespace Upstream {
 
+const HostStatsStorage::Names& HostStatsStorage::names() {
+  static const Names names;
+  return names;
+}
+
+HostStats HostStatsStorage::stats() {
+#define HOST_STAT_REF(NAME) NAME##_,
+  return {ALL_HOST_STATS(HOST_STAT_REF, HOST_STAT_REF)};
+#undef HOST_STAT_REF
+}
+
 Outlier::DetectorHostSinkNullImpl HostDescriptionImpl::null_outlier_detector_;
 
+std::list<Stats::CounterSharedPtr> HostImpl::counters() const {
+  // The stats live in the host, so the pointers share ownership of the host.
+  HostConstSharedPtr host = shared_from_this();
+  std::list<Stats::CounterSharedPtr> counters;
+#define HOST_COUNTER_PTR(NAME) counters.emplace_back(host, &stats_storage_.NAME##_);
+#define IGNORE_HOST_STAT(NAME)
+  ALL_HOST_STATS(HOST_COUNTER_PTR, IGNORE_HOST_STAT)
+#undef HOST_COUNTER_PTR
+  return counters;
+}
+
+std::list<Stats::GaugeSharedPtr> HostImpl::gauges() const {
+  HostConstSharedPtr host = shared_from_this();
+  std::list<Stats::GaugeSharedPtr> gauges;
+#define HOST_GAUGE_PTR(NAME) gauges.emplace_back(host, &stats_storage_.NAME##_);
+  ALL_HOST_STATS(IGNORE_HOST_STAT, HOST_GAUGE_PTR)
+#undef HOST_GAUGE_PTR
+#undef IGNORE_HOST_STAT
+  return gauges;
+}
+
 Host::CreateConnectionData HostImpl::createConnection(Event::Dispatcher& dispatcher) const {
-  return {createConnection(dispatcher, *cluster_, address_), shared_from_this()};
+  return {createConnection(dispatcher, *cluster_, {address_}), shared_from_this()};
 }
 
-Network::ClientConnectionPtr
-HostImpl::createConnection(Event::Dispatcher& dispatcher, const ClusterInfo& cluster,
-                           Network::Address::InstanceConstSharedPtr address) {
+Network::ClientConnectionPtr HostImpl::createConnection(
+    Event::Dispatcher& dispatcher, const ClusterInfo& cluster,
+    const std::vector<Network::Address::InstanceConstSharedPtr>& address_list) {
+  ASSERT(!address_list.empty());
+  const Network::Address::InstanceConstSharedPtr& address = address_list.front();
   Network::ClientConnectionPtr connection =
       cluster.sslContext() ? dispatcher.createSslClientConnection(*cluster.sslContext(), address)
                            : dispatcher.createClientConnection(address);
   connection->setReadBufferLimit(cluster.perConnectionBufferLimitBytes());
+  if (cluster.socketOptions()) {
+    connection->setSocketOptions(cluster.socketOptions());
+  }
+  if (address_list.size() > 1) {
+    connection->setAlternateAddresses({address_list.begin() + 1, address_list.end()});
+  }
   return connection;
 }
 
@@ -70,14 +113,28 @@ ClusterInfoImpl::ClusterInfoImpl(const Json::Object& config, Runtime::Loader& ru
                                  Stats::Store& stats, Ssl::ContextManager& ssl_context_manager)
     : runtime_(runtime), name_(config.getString("name")),
       max_requests_per_connection_(config.getInteger("max_requests_per_connection", 0)),
+      max_requests_per_connection_jitter_percent_(
+          config.getInteger("max_requests_per_connection_jitter_percent", 0)),
       connect_timeout_(std::chrono::milliseconds(config.getInteger("connect_timeout_ms"))),
       per_connection_buffer_limit_bytes_(
           config.getInteger("per_connection_buffer_limit_bytes", 1024 * 1024)),
+      prefetch_ratio_(config.getDouble("prefetch_ratio", 1.0)),
       stats_scope_(stats.createScope(fmt::format("cluster.{}.", name_))),
       stats_(generateStats(*stats_scope_)), features_(parseFeatures(config)),
       http2_settings_(Http::Utility::parseHttp2Settings(config)),
-      resource_managers_(config, runtime, name_),
-      maintenance_mode_runtime_key_(fmt::format("upstream.maintenance_mode.{}", name_)) {
+      http1_pipeline_depth_(config.getInteger("http1_pipeline_depth", 1)),
+      resource_managers_(config, runtime, name_, stats_),
+      maintenance_mode_runtime_key_(fmt::format("upstream.maintenance_mode.{}", name_)),
+      lb_subset_(config), ring_hash_function_(parseRingHashFunction(config)),
+      host_cleanup_interval_(config.getInteger("cleanup_interval_ms", 5000)),
+      dns_lookup_family_(parseDnsLookupFamily(config)),
+      locality_weights_(parseLocalityWeights(config)),
+      conn_pool_sharing_key_(parseConnPoolSharingKey(config, features_)),
+      socket_options_(Network::Utility::parseSocketOptions(config)) {
+
+  if (config.hasObject("idle_timeout_ms")) {
+    idle_timeout_.value(std::chrono::milliseconds(config.getInteger("idle_timeout_ms")));
+  }
 
   ssl_ctx_ = nullptr;
   if (config.hasObject("ssl_context")) {
@@ -94,9 +151,67 @@ ClusterInfoImpl::ClusterInfoImpl(const Json::Object& config, Runtime::Loader& ru
     lb_type_ = LoadBalancerType::Random;
   } else if (string_lb_type == "ring_hash") {
     lb_type_ = LoadBalancerType::RingHash;
+  } else if (string_lb_type == "maglev") {
+    lb_type_ = LoadBalancerType::Maglev;
+  } else if (string_lb_type == "original_dst_lb") {
+    lb_type_ = LoadBalancerType::OriginalDst;
+  } else if (string_lb_type == "dynamic_forward_proxy_lb") {
+    lb_type_ = LoadBalancerType::DynamicForwardProxy;
   } else {
     throw EnvoyException(fmt::format("cluster: unknown LB type '{}'", string_lb_type));
   }
+
+  // Original destination hosts only exist in the load balancer, so the cluster type and the load
+  // balancer type only work together.
+  if ((lb_type_ == LoadBalancerType::OriginalDst) != (config.getString("type") == "original_dst")) {
+    throw EnvoyException(
+        "cluster: LB type 'original_dst_lb' may only be used with cluster type 'original_dst'");
+  }
+  if (lb_type_ == LoadBalancerType::OriginalDst && lb_subset_.isEnabled()) {
+    throw EnvoyException(
+        "cluster: LB type 'original_dst_lb' may not be used with lb_subset_config");
+  }
+  if ((lb_type_ == LoadBalancerType::DynamicForwardProxy) !=
+      (config.getString("type") == "dynamic_forward_proxy")) {
+    throw EnvoyException("cluster: LB type 'dynamic_forward_proxy_lb' may only be used with "
+                         "cluster type 'dynamic_forward_proxy'");
+  }
+  if (lb_type_ == LoadBalancerType::DynamicForwardProxy && lb_subset_.isEnabled()) {
+    throw EnvoyException(
+        "cluster: LB type 'dynamic_forward_proxy_lb' may not be used with lb_subset_config");
+  }
+}
+
+HostMetadata HostDescriptionImpl::parseMetadata(const Json::Object& config) {
+  HostMetadata metadata;
+  if (config.hasObject("metadata")) {
+    config.getObject("metadata")->iterate(
+        [&metadata](const std::string& key, const Json::Object& value) {
+          metadata.emplace(key, value.asString());
+          return true;
+        });
+  }
+  return metadata;
+}
+
+LbSubsetInfoImpl::LbSubsetInfoImpl(const Json::Object& config) {
+  if (!config.hasObject("lb_subset_config")) {
+    return;
+  }
+
+  Json::ObjectSharedPtr subset_config = config.getObject("lb_subset_config");
+  const std::string fallback_policy = subset_config->getString("fallback_policy", "any_endpoint");
+  if (fallback_policy == "no_fallback") {
+    fallback_policy_ = FallbackPolicy::NoFallback;
+  }
+
+  for (const Json::ObjectSharedPtr& keys : subset_config->getObjectArray("subset_keys")) {
+    std::set<std::string> key_set;
+    for (const Json::ObjectSharedPtr& key : keys->asObjectArray()) {
+      key_set.insert(key->asString());
+    }
+    subset_keys_.emplace_back(std::move(key_set));
+  }
 }
 
 const HostListsConstSharedPtr ClusterImplBase::empty_host_lists_{
@@ -130,7 +245,7 @@ ClusterPtr ClusterImplBase::create(const Json::Object& cluster, ClusterManager&
     for (const auto& resolver_addr : resolver_addrs) {
       resolvers.push_back(Network::Utility::parseInternetAddressAndPort(resolver_addr));
     }
-    selected_dns_resolver = std::make_shared<Network::DnsResolverImpl>(dispatcher, resolvers);
+    selected_dns_resolver = dispatcher.createDnsResolver(resolvers);
   }
 
   if (string_type == "static") {
@@ -141,6 +256,11 @@ ClusterPtr ClusterImplBase::create(const Json::Object& cluster, ClusterManager&
   } else if (string_type == "logical_dns") {
     new_cluster.reset(new LogicalDnsCluster(cluster, runtime, stats, ssl_context_manager,
                                             selected_dns_resolver, tls, dispatcher));
+  } else if (string_type == "original_dst") {
+    new_cluster.reset(new OriginalDstCluster(cluster, runtime, stats, ssl_context_manager));
+  } else if (string_type == "dynamic_forward_proxy") {
+    new_cluster.reset(
+        new DynamicForwardProxyCluster(cluster, runtime, stats, ssl_context_manager));
   } else {
     ASSERT(string_type == "sds");
     if (!sds_config.valid()) {
@@ -209,6 +329,57 @@ uint64_t ClusterInfoImpl::parseFeatures(const Json::Object& config) {
   return features;
 }
 
+std::string ClusterInfoImpl::parseConnPoolSharingKey(const Json::Object& config,
+                                                     uint64_t features) {
+  if (!config.getBoolean("share_connection_pools", false)) {
+    return "";
+  }
+
+  // Clusters with the same SSL context configuration make interchangeable connections, even
+  // though each of them has its own SSL context.
+  return fmt::format("{}/{}/{}", (features & Features::HTTP2) ? "http2" : "http1",
+                     config.hasObject("ssl_context") ? config.getObject("ssl_context")->hash() : 0,
+                     config.getInteger("http1_pipeline_depth", 1));
+}
+
+RingHashFunction ClusterInfoImpl::parseRingHashFunction(const Json::Object& config) {
+  if (!config.hasObject("ring_hash_lb_config")) {
+    return RingHashFunction::StdHash;
+  }
+
+  const std::string hash_function =
+      config.getObject("ring_hash_lb_config")->getString("hash_function", "std_hash");
+  if (hash_function == "xx_hash") {
+    return RingHashFunction::XxHash64;
+  }
+  ASSERT(hash_function == "std_hash");
+  return RingHashFunction::StdHash;
+}
+
+Network::DnsLookupFamily ClusterInfoImpl::parseDnsLookupFamily(const Json::Object& config) {
+  const std::string dns_lookup_family = config.getString("dns_lookup_family", "v4_only");
+  if (dns_lookup_family == "v6_only") {
+    return Network::DnsLookupFamily::V6Only;
+  } else if (dns_lookup_family == "auto") {
+    return Network::DnsLookupFamily::Auto;
+  }
+  ASSERT(dns_lookup_family == "v4_only");
+  return Network::DnsLookupFamily::V4Only;
+}
+
+std::unordered_map<std::string, uint32_t>
+ClusterInfoImpl::parseLocalityWeights(const Json::Object& config) {
+  std::unordered_map<std::string, uint32_t> locality_weights;
+  if (config.hasObject("locality_weights")) {
+    Json::ObjectSharedPtr weights = config.getObject("locality_weights");
+    weights->iterate([&locality_weights, &weights](const std::string& zone, const Json::Object&) {
+      locality_weights.emplace(zone, weights->getInteger(zone));
+      return true;
+    });
+  }
+  return locality_weights;
+}
+
 ResourceManager& ClusterInfoImpl::resourceManager(ResourcePriority priority) const {
   ASSERT(enumToInt(priority) < resource_managers_.managers_.size());
   return *resource_managers_.managers_[enumToInt(priority)];
@@ -257,15 +428,18 @@ void ClusterImplBase::reloadHealthyHosts() {
 
 ClusterInfoImpl::ResourceManagers::ResourceManagers(const Json::Object& config,
                                                     Runtime::Loader& runtime,
-                                                    const std::string& cluster_name) {
-  managers_[enumToInt(ResourcePriority::Default)] = load(config, runtime, cluster_name, "default");
-  managers_[enumToInt(ResourcePriority::High)] = load(config, runtime, cluster_name, "high");
+                                                    const std::string& cluster_name,
+                                                    ClusterStats& stats) {
+  managers_[enumToInt(ResourcePriority::Default)] =
+      load(config, runtime, cluster_name, "default", stats);
+  managers_[enumToInt(ResourcePriority::High)] = load(config, runtime, cluster_name, "high", stats);
 }
 
 ResourceManagerImplPtr ClusterInfoImpl::ResourceManagers::load(const Json::Object& config,
                                                                Runtime::Loader& runtime,
                                                                const std::string& cluster_name,
-                                                               const std::string& priority) {
+                                                               const std::string& priority,
+                                                               ClusterStats& stats) {
   uint64_t max_connections = 1024;
   uint64_t max_pending_requests = 1024;
   uint64_t max_requests = 1024;
@@ -279,8 +453,19 @@ ResourceManagerImplPtr ClusterInfoImpl::ResourceManagers::load(const Json::Objec
   max_requests = settings->getInteger("max_requests", max_requests);
   max_retries = settings->getInteger("max_retries", max_retries);
 
-  return ResourceManagerImplPtr{new ResourceManagerImpl(
-      runtime, runtime_prefix, max_connections, max_pending_requests, max_requests, max_retries)};
+  Optional<RetryBudget> retry_budget;
+  if (settings->hasObject("retry_budget")) {
+    Json::ObjectSharedPtr budget_json = settings->getObject("retry_budget");
+    RetryBudget budget;
+    budget.budget_percent_ = budget_json->getDouble("budget_percent", 20.0);
+    budget.min_retry_concurrency_ = budget_json->getInteger("min_retry_concurrency", 3);
+    budget.overflow_ = &stats.upstream_rq_retry_budget_overflow_;
+    retry_budget.value(budget);
+  }
+
+  return ResourceManagerImplPtr{new ResourceManagerImpl(runtime, runtime_prefix, max_connections,
+                                                        max_pending_requests, max_requests,
+                                                        max_retries, retry_budget)};
 }
 
 StaticClusterImpl::StaticClusterImpl(const Json::Object& config, Runtime::Loader& runtime,
@@ -290,7 +475,9 @@ StaticClusterImpl::StaticClusterImpl(const Json::Object& config, Runtime::Loader
   HostVectorSharedPtr new_hosts(new std::vector<HostSharedPtr>());
   for (const Json::ObjectSharedPtr& host : hosts_json) {
     new_hosts->emplace_back(HostSharedPtr{new HostImpl(
-        info_, "", Network::Utility::resolveUrl(host->getString("url")), false, 1, "")});
+        info_, "", Network::Utility::resolveUrl(host->getString("url")), false, 1,
+        host->getString("zone", ""), HostDescriptionImpl::parseMetadata(*host),
+        host->getInteger("priority", 0))});
   }
 
   updateHosts(new_hosts, createHealthyHostList(*new_hosts), empty_host_lists_, empty_host_lists_,
@@ -303,6 +490,7 @@ bool BaseDynamicClusterImpl::updateDynamicHostList(const std::vector<HostSharedP
                                                    std::vector<HostSharedPtr>& hosts_removed,
                                                    bool depend_on_hc) {
   uint64_t max_host_weight = 1;
+  bool weight_changed = false;
 
   // Go through and see if the list we have is different from what we just got. If it is, we
   // make a new host list and raise a change notification. This uses an N^2 search given that
@@ -319,14 +507,19 @@ bool BaseDynamicClusterImpl::updateDynamicHostList(const std::vector<HostSharedP
 
     bool found = false;
     for (auto i = current_hosts.begin(); i != current_hosts.end();) {
-      // If we find a host matched based on address, we keep it. However we do change weight inline
-      // so do that here.
-      if (*(*i)->address() == *host->address()) {
+      // If we find a host matched based on address, metadata and priority, we keep it. However we
+      // do change weight inline so do that here. A host whose metadata or priority changed is
+      // replaced so that subsets and priority levels built from them see it move.
+      if (*(*i)->address() == *host->address() && (*i)->metadata() == host->metadata() &&
+          (*i)->priority() == host->priority()) {
         if (host->weight() > max_host_weight) {
           max_host_weight = host->weight();
         }
 
-        (*i)->weight(host->weight());
+        if ((*i)->weight() != host->weight()) {
+          (*i)->weight(host->weight());
+          weight_changed = true;
+        }
         final_hosts.push_back(*i);
         i = current_hosts.erase(i);
         found = true;
@@ -368,7 +561,9 @@ bool BaseDynamicClusterImpl::updateDynamicHostList(const std::vector<HostSharedP
 
   info_->stats().max_host_weight_.set(max_host_weight);
 
-  if (!hosts_added.empty() || !current_hosts.empty()) {
+  // A weight change alone is also raised as a change so that load balancers rebuild their weighted
+  // structures.
+  if (!hosts_added.empty() || !current_hosts.empty() || weight_changed) {
     hosts_removed = std::move(current_hosts);
     current_hosts = std::move(final_hosts);
     return true;
@@ -388,17 +583,6 @@ StrictDnsClusterImpl::StrictDnsClusterImpl(const Json::Object& config, Runtime::
     : BaseDynamicClusterImpl(config, runtime, stats, ssl_context_manager),
       dns_resolver_(dns_resolver), dns_refresh_rate_ms_(std::chrono::milliseconds(
                                        config.getInteger("dns_refresh_rate_ms", 5000))) {
-
-  std::string dns_lookup_family = config.getString("dns_lookup_family", "v4_only");
-  if (dns_lookup_family == "v6_only") {
-    dns_lookup_family_ = Network::DnsLookupFamily::V6Only;
-  } else if (dns_lookup_family == "auto") {
-    dns_lookup_family_ = Network::DnsLookupFamily::Auto;
-  } else {
-    ASSERT(dns_lookup_family == "v4_only");
-    dns_lookup_family_ = Network::DnsLookupFamily::V4Only;
-  }
-
   for (const Json::ObjectSharedPtr& host : config.getObjectArray("hosts")) {
     resolve_targets_.emplace_back(new ResolveTarget(*this, dispatcher, host->getString("url")));
   }
@@ -443,7 +627,7 @@ void StrictDnsClusterImpl::ResolveTarget::startResolve() {
   parent_.info_->stats().update_attempt_.inc();
 
   active_query_ = parent_.dns_resolver_->resolve(
-      dns_address_, parent_.dns_lookup_family_,
+      dns_address_, parent_.info_->dnsLookupFamily(),
       [this](std::list<Network::Address::InstanceConstSharedPtr>&& address_list) -> void {
         active_query_ = nullptr;
         log_debug("async DNS resolution complete for {}", dns_address_);
@@ -7,7 +7,9 @@
 #include <functional>
 #include <list>
 #include <memory>
+#include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "envoy/event/timer.h"
@@ -23,6 +25,8 @@
 
 #include "common/common/enum_to_int.h"
 #include "common/common/logger.h"
+#include "common/grpc/method_stats_impl.h"
+#include "common/http/codes.h"
 #include "common/stats/stats_impl.h"
 #include "common/upstream/outlier_detection_impl.h"
 #include "common/upstream/resource_manager_impl.h"
@@ -30,6 +34,31 @@
 namespace Envoy {
 namespace Upstream {
 
+/**
+ * The per host stats, see ALL_HOST_STATS, as a fixed layout of primitive stats that is stored in
+ * the host itself. The names are shared by all hosts.
+ */
+struct HostStatsStorage {
+#define GENERATE_HOST_STAT_NAME(NAME) const std::string NAME##_{#NAME};
+  struct Names {
+    ALL_HOST_STATS(GENERATE_HOST_STAT_NAME, GENERATE_HOST_STAT_NAME)
+  };
+#undef GENERATE_HOST_STAT_NAME
+
+  static const Names& names();
+
+#define GENERATE_HOST_COUNTER(NAME) Stats::PrimitiveCounter NAME##_{names().NAME##_};
+#define GENERATE_HOST_GAUGE(NAME) Stats::PrimitiveGauge NAME##_{names().NAME##_};
+  ALL_HOST_STATS(GENERATE_HOST_COUNTER, GENERATE_HOST_GAUGE)
+#undef GENERATE_HOST_COUNTER
+#undef GENERATE_HOST_GAUGE
+
+  /**
+   * @return the stats struct that refers to the stats in this storage.
+   */
+  HostStats stats();
+};
+
 /**
  * Implementation of Upstream::HostDescription.
  */
@@ -37,9 +66,10 @@ class HostDescriptionImpl : virtual public HostDescription {
 public:
   HostDescriptionImpl(ClusterInfoConstSharedPtr cluster, const std::string& hostname,
                       Network::Address::InstanceConstSharedPtr address, bool canary,
-                      const std::string& zone)
+                      const std::string& zone, const HostMetadata& metadata = {},
+                      uint32_t priority = 0)
       : cluster_(cluster), hostname_(hostname), address_(address), canary_(canary), zone_(zone),
-        stats_{ALL_HOST_STATS(POOL_COUNTER(stats_store_), POOL_GAUGE(stats_store_))} {}
+        metadata_(metadata), priority_(priority), stats_(stats_storage_.stats()) {}
 
   // Upstream::HostDescription
   bool canary() const override { return canary_; }
@@ -54,7 +84,19 @@ public:
   const HostStats& stats() const override { return stats_; }
   const std::string& hostname() const override { return hostname_; }
   Network::Address::InstanceConstSharedPtr address() const override { return address_; }
+  std::vector<Network::Address::InstanceConstSharedPtr> addressList() const override {
+    return {address_};
+  }
   const std::string& zone() const override { return zone_; }
+  uint32_t priority() const override { return priority_; }
+  const HostMetadata& metadata() const override { return metadata_; }
+
+  /**
+   * Parse the optional "metadata" object of a host definition.
+   * @param config supplies the JSON object that may contain a "metadata" object of strings.
+   * @return HostMetadata the parsed metadata. Empty if there is none.
+   */
+  static HostMetadata parseMetadata(const Json::Object& config);
 
 protected:
   ClusterInfoConstSharedPtr cluster_;
@@ -62,7 +104,9 @@ protected:
   Network::Address::InstanceConstSharedPtr address_;
   const bool canary_;
   const std::string zone_;
-  Stats::IsolatedStoreImpl stats_store_;
+  const HostMetadata metadata_;
+  const uint32_t priority_;
+  mutable HostStatsStorage stats_storage_;
   HostStats stats_;
   Outlier::DetectorHostSinkPtr outlier_detector_;
 
@@ -79,15 +123,15 @@ class HostImpl : public HostDescriptionImpl,
 public:
   HostImpl(ClusterInfoConstSharedPtr cluster, const std::string& hostname,
            Network::Address::InstanceConstSharedPtr address, bool canary, uint32_t initial_weight,
-           const std::string& zone)
-      : HostDescriptionImpl(cluster, hostname, address, canary, zone) {
+           const std::string& zone, const HostMetadata& metadata = {}, uint32_t priority = 0)
+      : HostDescriptionImpl(cluster, hostname, address, canary, zone, metadata, priority) {
     weight(initial_weight);
   }
 
   // Upstream::Host
-  std::list<Stats::CounterSharedPtr> counters() const override { return stats_store_.counters(); }
+  std::list<Stats::CounterSharedPtr> counters() const override;
   CreateConnectionData createConnection(Event::Dispatcher& dispatcher) const override;
-  std::list<Stats::GaugeSharedPtr> gauges() const override { return stats_store_.gauges(); }
+  std::list<Stats::GaugeSharedPtr> gauges() const override;
   void healthFlagClear(HealthFlag flag) override { health_flags_ &= ~enumToInt(flag); }
   bool healthFlagGet(HealthFlag flag) const override { return health_flags_ & enumToInt(flag); }
   void healthFlagSet(HealthFlag flag) override { health_flags_ |= enumToInt(flag); }
@@ -97,22 +141,42 @@ public:
   bool healthy() const override { return !health_flags_; }
   uint32_t weight() const override { return weight_; }
   void weight(uint32_t new_weight) override;
+  uint64_t activeRequests() const override {
+    return active_requests_.value_.load(std::memory_order_relaxed);
+  }
+  void incActiveRequests() const override {
+    active_requests_.value_.fetch_add(1, std::memory_order_relaxed);
+  }
+  void decActiveRequests() const override {
+    active_requests_.value_.fetch_sub(1, std::memory_order_relaxed);
+  }
 
 protected:
+  /**
+   * Create a connection to the first of address_list that races the remaining addresses.
+   */
   static Network::ClientConnectionPtr
   createConnection(Event::Dispatcher& dispatcher, const ClusterInfo& cluster,
-                   Network::Address::InstanceConstSharedPtr address);
+                   const std::vector<Network::Address::InstanceConstSharedPtr>& address_list);
 
 private:
+  static const size_t CacheLineSize = 64;
+
+  /**
+   * A counter that does not share a cache line with anything else, so that workers updating it do
+   * not contend with reads of the rest of the host.
+   */
+  struct PaddedCounter {
+    uint8_t padding_before_[CacheLineSize];
+    std::atomic<uint64_t> value_{};
+    uint8_t padding_after_[CacheLineSize - sizeof(std::atomic<uint64_t>)];
+  };
+
   std::atomic<uint64_t> health_flags_{};
   std::atomic<uint32_t> weight_;
+  mutable PaddedCounter active_requests_;
 };
 
-typedef std::shared_ptr<std::vector<HostSharedPtr>> HostVectorSharedPtr;
-typedef std::shared_ptr<const std::vector<HostSharedPtr>> HostVectorConstSharedPtr;
-typedef std::shared_ptr<std::vector<std::vector<HostSharedPtr>>> HostListsSharedPtr;
-typedef std::shared_ptr<const std::vector<std::vector<HostSharedPtr>>> HostListsConstSharedPtr;
-
 /**
  * Base class for all clusters as well as thread local host sets.
  */
@@ -144,6 +208,12 @@ public:
   const std::vector<std::vector<HostSharedPtr>>& healthyHostsPerZone() const override {
     return *healthy_hosts_per_zone_;
   }
+  HostVectorConstSharedPtr hostsPtr() const override { return hosts_; }
+  HostVectorConstSharedPtr healthyHostsPtr() const override { return healthy_hosts_; }
+  HostListsConstSharedPtr hostsPerZonePtr() const override { return hosts_per_zone_; }
+  HostListsConstSharedPtr healthyHostsPerZonePtr() const override {
+    return healthy_hosts_per_zone_;
+  }
   void addMemberUpdateCb(MemberUpdateCb callback) const override;
 
 protected:
@@ -160,6 +230,23 @@ private:
 
 typedef std::unique_ptr<HostSetImpl> HostSetImplPtr;
 
+/**
+ * Implementation of LbSubsetInfo that reads the optional "lb_subset_config" object of a cluster.
+ */
+class LbSubsetInfoImpl : public LbSubsetInfo {
+public:
+  LbSubsetInfoImpl(const Json::Object& config);
+
+  // Upstream::LbSubsetInfo
+  bool isEnabled() const override { return !subset_keys_.empty(); }
+  FallbackPolicy fallbackPolicy() const override { return fallback_policy_; }
+  const std::vector<std::set<std::string>>& subsetKeys() const override { return subset_keys_; }
+
+private:
+  FallbackPolicy fallback_policy_{FallbackPolicy::AnyEndpoint};
+  std::vector<std::set<std::string>> subset_keys_;
+};
+
 /**
  * Implementation of ClusterInfo that reads from JSON.
  */
@@ -177,21 +264,43 @@ public:
   }
   uint64_t features() const override { return features_; }
   const Http::Http2Settings& http2Settings() const override { return http2_settings_; }
+  uint32_t http1PipelineDepth() const override { return http1_pipeline_depth_; }
   LoadBalancerType lbType() const override { return lb_type_; }
+  const LbSubsetInfo& lbSubsetInfo() const override { return lb_subset_; }
+  RingHashFunction ringHashFunction() const override { return ring_hash_function_; }
+  std::chrono::milliseconds hostCleanupInterval() const override {
+    return host_cleanup_interval_;
+  }
+  Network::DnsLookupFamily dnsLookupFamily() const override { return dns_lookup_family_; }
+  const std::unordered_map<std::string, uint32_t>& localityWeights() const override {
+    return locality_weights_;
+  }
   bool maintenanceMode() const override;
   uint64_t maxRequestsPerConnection() const override { return max_requests_per_connection_; }
+  uint32_t maxRequestsPerConnectionJitterPercent() const override {
+    return max_requests_per_connection_jitter_percent_;
+  }
+  const Optional<std::chrono::milliseconds>& idleTimeout() const override { return idle_timeout_; }
+  const std::string& connPoolSharingKey() const override { return conn_pool_sharing_key_; }
   const std::string& name() const override { return name_; }
+  double prefetchRatio() const override { return prefetch_ratio_; }
   ResourceManager& resourceManager(ResourcePriority priority) const override;
   Ssl::ClientContext* sslContext() const override { return ssl_ctx_.get(); }
+  const Network::SocketOptionsConstSharedPtr& socketOptions() const override {
+    return socket_options_;
+  }
   ClusterStats& stats() const override { return stats_; }
   Stats::Scope& statsScope() const override { return *stats_scope_; }
+  Http::CodeStats& codeStats() const override { return code_stats_; }
+  Grpc::MethodStatsTable& grpcMethodStats() const override { return grpc_method_stats_; }
 
 private:
   struct ResourceManagers {
     ResourceManagers(const Json::Object& config, Runtime::Loader& runtime,
-                     const std::string& cluster_name);
+                     const std::string& cluster_name, ClusterStats& stats);
     ResourceManagerImplPtr load(const Json::Object& config, Runtime::Loader& runtime,
-                                const std::string& cluster_name, const std::string& priority);
+                                const std::string& cluster_name, const std::string& priority,
+                                ClusterStats& stats);
 
     typedef std::array<ResourceManagerImplPtr, NumResourcePriorities> Managers;
 
@@ -199,20 +308,38 @@ private:
   };
 
   static uint64_t parseFeatures(const Json::Object& config);
+  static RingHashFunction parseRingHashFunction(const Json::Object& config);
+  static Network::DnsLookupFamily parseDnsLookupFamily(const Json::Object& config);
+  static std::unordered_map<std::string, uint32_t>
+  parseLocalityWeights(const Json::Object& config);
+  static std::string parseConnPoolSharingKey(const Json::Object& config, uint64_t features);
 
   Runtime::Loader& runtime_;
   const std::string name_;
   const uint64_t max_requests_per_connection_;
+  const uint32_t max_requests_per_connection_jitter_percent_;
+  Optional<std::chrono::milliseconds> idle_timeout_;
   const std::chrono::milliseconds connect_timeout_;
   const uint32_t per_connection_buffer_limit_bytes_;
+  const double prefetch_ratio_;
   Stats::ScopePtr stats_scope_;
   mutable ClusterStats stats_;
+  mutable Http::CodeStatsImpl code_stats_{""};
+  mutable Grpc::MethodStatsTableImpl grpc_method_stats_;
   Ssl::ClientContextPtr ssl_ctx_;
   const uint64_t features_;
   const Http::Http2Settings http2_settings_;
+  const uint32_t http1_pipeline_depth_;
   mutable ResourceManagers resource_managers_;
   const std::string maintenance_mode_runtime_key_;
   LoadBalancerType lb_type_;
+  const LbSubsetInfoImpl lb_subset_;
+  const RingHashFunction ring_hash_function_;
+  const std::chrono::milliseconds host_cleanup_interval_;
+  const Network::DnsLookupFamily dns_lookup_family_;
+  const std::unordered_map<std::string, uint32_t> locality_weights_;
+  const std::string conn_pool_sharing_key_;
+  const Network::SocketOptionsConstSharedPtr socket_options_;
 };
 
 /**
@@ -350,7 +477,6 @@ private:
   Network::DnsResolverSharedPtr dns_resolver_;
   std::list<ResolveTargetPtr> resolve_targets_;
   const std::chrono::milliseconds dns_refresh_rate_ms_;
-  Network::DnsLookupFamily dns_lookup_family_;
 };
 
 } // Upstream
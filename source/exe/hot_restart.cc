@@ -9,6 +9,8 @@
 
 #include <cstdint>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "envoy/event/dispatcher.h"
 #include "envoy/event/file_event.h"
@@ -24,7 +26,11 @@ namespace Server {
 
 // Increment this whenever there is a shared memory / RPC change that will prevent a hot restart
 // from working. Operations code can then cope with this and do a full restart.
-const uint64_t SharedMemory::VERSION = 8;
+const uint64_t SharedMemory::VERSION = 10;
+
+const uint32_t SharedMemory::INVALID_SLOT;
+const uint64_t HotRestartImpl::MaxRpcSize;
+const uint32_t HotRestartImpl::MaxSocketsPerRpc;
 
 SharedMemory& SharedMemory::initialize(Options& options) {
   int flags = O_RDWR;
@@ -42,26 +48,36 @@ SharedMemory& SharedMemory::initialize(Options& options) {
     PANIC(fmt::format("cannot open shared memory region {} check user permissions", shmem_name));
   }
 
+  const uint64_t max_stats = options.maxStats();
+  if (max_stats >= INVALID_SLOT) {
+    throw EnvoyException(fmt::format("max stats {} is too large for shared memory", max_stats));
+  }
+
+  const uint64_t shmem_size = size(max_stats);
   if (options.restartEpoch() == 0) {
-    int rc = ftruncate(shmem_fd, sizeof(SharedMemory));
+    int rc = ftruncate(shmem_fd, shmem_size);
     RELEASE_ASSERT(rc != -1);
     UNREFERENCED_PARAMETER(rc);
   }
 
   SharedMemory* shmem = reinterpret_cast<SharedMemory*>(
-      mmap(nullptr, sizeof(SharedMemory), PROT_READ | PROT_WRITE, MAP_SHARED, shmem_fd, 0));
+      mmap(nullptr, shmem_size, PROT_READ | PROT_WRITE, MAP_SHARED, shmem_fd, 0));
   RELEASE_ASSERT(shmem != MAP_FAILED);
 
   if (options.restartEpoch() == 0) {
-    shmem->size_ = sizeof(SharedMemory);
+    shmem->size_ = shmem_size;
     shmem->version_ = VERSION;
+    shmem->max_stats_ = max_stats;
+    shmem->num_buckets_ = numBuckets(max_stats);
     shmem->initializeMutex(shmem->log_lock_);
     shmem->initializeMutex(shmem->access_log_lock_);
     shmem->initializeMutex(shmem->stat_lock_);
     shmem->initializeMutex(shmem->init_lock_);
+    shmem->initializeStats();
   } else {
-    RELEASE_ASSERT(shmem->size_ == sizeof(SharedMemory));
+    RELEASE_ASSERT(shmem->size_ == shmem_size);
     RELEASE_ASSERT(shmem->version_ == VERSION);
+    RELEASE_ASSERT(shmem->max_stats_ == max_stats);
   }
 
   // Here we catch the case where a new Envoy starts up when the current Envoy has not yet fully
@@ -85,7 +101,100 @@ void SharedMemory::initializeMutex(pthread_mutex_t& mutex) {
   pthread_mutex_init(&mutex, &attribute);
 }
 
-std::string SharedMemory::version() { return fmt::format("{}.{}", VERSION, sizeof(SharedMemory)); }
+uint64_t SharedMemory::numBuckets(uint64_t max_stats) {
+  // Keep the load factor at or below one so that chains stay short.
+  uint64_t num_buckets = 1;
+  while (num_buckets < max_stats) {
+    num_buckets <<= 1;
+  }
+  return num_buckets;
+}
+
+uint64_t SharedMemory::slotsOffset(uint64_t max_stats) {
+  const uint64_t offset = sizeof(SharedMemory) + numBuckets(max_stats) * sizeof(uint32_t);
+  return (offset + alignof(StatSlot) - 1) / alignof(StatSlot) * alignof(StatSlot);
+}
+
+uint64_t SharedMemory::size(uint64_t max_stats) {
+  return slotsOffset(max_stats) + max_stats * sizeof(StatSlot);
+}
+
+uint32_t SharedMemory::bucket(const char* name, size_t length, uint64_t num_buckets) {
+  // 32 bit FNV-1a.
+  uint32_t hash = 2166136261U;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= static_cast<uint8_t>(name[i]);
+    hash *= 16777619U;
+  }
+  return hash & (num_buckets - 1);
+}
+
+void SharedMemory::initializeStats() {
+  uint32_t* chains = buckets();
+  for (uint64_t i = 0; i < num_buckets_; i++) {
+    chains[i] = INVALID_SLOT;
+  }
+
+  StatSlot* stat_slots = slots();
+  for (uint64_t i = 0; i < max_stats_; i++) {
+    new (&stat_slots[i]) StatSlot();
+    stat_slots[i].next_ = i + 1 < max_stats_ ? i + 1 : INVALID_SLOT;
+  }
+  free_slot_ = max_stats_ > 0 ? 0 : INVALID_SLOT;
+}
+
+Stats::RawStatData* SharedMemory::allocStat(const std::string& name) {
+  // Stats are matched on their truncated name, so the truncated name is what gets hashed.
+  const size_t length = name.size() < Stats::RawStatData::MAX_NAME_SIZE
+                            ? name.size()
+                            : Stats::RawStatData::MAX_NAME_SIZE;
+  uint32_t& chain = buckets()[bucket(name.c_str(), length, num_buckets_)];
+  StatSlot* stat_slots = slots();
+  for (uint32_t index = chain; index != INVALID_SLOT; index = stat_slots[index].next_) {
+    if (stat_slots[index].data_.matches(name)) {
+      stat_slots[index].data_.ref_count_++;
+      return &stat_slots[index].data_;
+    }
+  }
+
+  if (free_slot_ == INVALID_SLOT) {
+    return nullptr;
+  }
+
+  const uint32_t index = free_slot_;
+  StatSlot& slot = stat_slots[index];
+  free_slot_ = slot.next_;
+  slot.data_.initialize(name);
+  slot.next_ = chain;
+  chain = index;
+  return &slot.data_;
+}
+
+void SharedMemory::freeStat(Stats::RawStatData& data) {
+  ASSERT(data.ref_count_ > 0);
+  if (--data.ref_count_ > 0) {
+    return;
+  }
+
+  // RawStatData is the first member of StatSlot.
+  StatSlot* stat_slots = slots();
+  const uint32_t index = reinterpret_cast<StatSlot*>(&data) - stat_slots;
+  ASSERT(index < max_stats_);
+  uint32_t* link = &buckets()[bucket(data.name_, strlen(data.name_), num_buckets_)];
+  while (*link != index) {
+    ASSERT(*link != INVALID_SLOT);
+    link = &stat_slots[*link].next_;
+  }
+  *link = stat_slots[index].next_;
+
+  memset(&data, 0, sizeof(Stats::RawStatData));
+  stat_slots[index].next_ = free_slot_;
+  free_slot_ = index;
+}
+
+std::string SharedMemory::version(uint64_t max_stats) {
+  return fmt::format("{}.{}.{}", VERSION, sizeof(SharedMemory), max_stats);
+}
 
 HotRestartImpl::HotRestartImpl(Options& options)
     : options_(options), shmem_(SharedMemory::initialize(options)), log_lock_(shmem_.log_lock_),
@@ -108,28 +217,13 @@ HotRestartImpl::HotRestartImpl(Options& options)
 Stats::RawStatData* HotRestartImpl::alloc(const std::string& name) {
   // Try to find the existing slot in shared memory, otherwise allocate a new one.
   std::unique_lock<Thread::BasicLockable> lock(stat_lock_);
-  for (Stats::RawStatData& data : shmem_.stats_slots_) {
-    if (!data.initialized()) {
-      data.initialize(name);
-      return &data;
-    } else if (data.matches(name)) {
-      data.ref_count_++;
-      return &data;
-    }
-  }
-
-  return nullptr;
+  return shmem_.allocStat(name);
 }
 
 void HotRestartImpl::free(Stats::RawStatData& data) {
   // We must hold the lock since the reference decrement can race with an initialize above.
   std::unique_lock<Thread::BasicLockable> lock(stat_lock_);
-  ASSERT(data.ref_count_ > 0);
-  if (--data.ref_count_ > 0) {
-    return;
-  }
-
-  memset(&data, 0, sizeof(Stats::RawStatData));
+  shmem_.freeStat(data);
 }
 
 int HotRestartImpl::bindDomainSocket(uint64_t id) {
@@ -174,18 +268,37 @@ void HotRestartImpl::drainParentListeners() {
   shmem_.flags_ &= ~SharedMemory::Flags::INITIALIZING;
 }
 
-int HotRestartImpl::duplicateParentListenSocket(const std::string& address) {
+std::vector<int>
+HotRestartImpl::duplicateParentListenSockets(const std::vector<std::string>& addresses) {
+  std::vector<int> fds;
   if (options_.restartEpoch() == 0) {
-    return -1;
+    fds.resize(addresses.size(), -1);
+    return fds;
   }
 
-  RpcGetListenSocketRequest rpc;
-  ASSERT(address.length() < sizeof(rpc.address_));
-  StringUtil::strlcpy(rpc.address_, address.c_str(), sizeof(rpc.address_));
-  sendMessage(parent_address_, rpc);
-  RpcGetListenSocketReply* reply =
-      receiveTypedRpc<RpcGetListenSocketReply, RpcMessageType::GetListenSocketReply>();
-  return reply->fd_;
+  // Ask for as many sockets per round trip as fit in a single message.
+  size_t next = 0;
+  while (next < addresses.size()) {
+    RpcGetListenSocketsRequest rpc;
+    size_t offset = 0;
+    while (next < addresses.size() && rpc.num_addresses_ < MaxSocketsPerRpc &&
+           offset + addresses[next].size() < sizeof(rpc.addresses_)) {
+      memcpy(&rpc.addresses_[offset], addresses[next].c_str(), addresses[next].size() + 1);
+      offset += addresses[next].size() + 1;
+      rpc.num_addresses_++;
+      next++;
+    }
+    RELEASE_ASSERT(rpc.num_addresses_ > 0);
+    rpc.length_ += offset;
+
+    sendMessage(parent_address_, rpc);
+    RpcGetListenSocketsReply* reply =
+        receiveTypedRpc<RpcGetListenSocketsReply, RpcMessageType::GetListenSocketsReply>();
+    RELEASE_ASSERT(reply->num_sockets_ == rpc.num_addresses_);
+    fds.insert(fds.end(), reply->fds_, reply->fds_ + reply->num_sockets_);
+  }
+
+  return fds;
 }
 
 void HotRestartImpl::getParentStats(GetParentStatsInfo& info) {
@@ -220,6 +333,55 @@ void HotRestartImpl::getParentStats(GetParentStatsInfo& info) {
   info.num_connections_ = reply->num_connections_;
 }
 
+void HotRestartImpl::mergeParentHistograms(Stats::StoreRoot& store) {
+  // See large comment in getParentStats() on why this operation is locked.
+  std::unique_lock<Thread::BasicLockable> lock(init_lock_);
+  if (options_.restartEpoch() == 0) {
+    return;
+  }
+
+  // Histograms are requested one reply at a time, so that the parent never has more than one
+  // message outstanding on its non-blocking socket.
+  RpcGetHistogramsRequest rpc;
+  while (true) {
+    sendMessage(parent_address_, rpc);
+    RpcBase* base_message = receiveRpc(true);
+    RELEASE_ASSERT(base_message->type_ == RpcMessageType::GetHistogramsReply);
+    RpcGetHistogramsReply* reply = reinterpret_cast<RpcGetHistogramsReply*>(base_message);
+
+    const uint8_t* data = reply->data_;
+    const uint8_t* end = reinterpret_cast<uint8_t*>(reply) + reply->length_;
+    auto read = [&data, end](void* value, size_t size) -> void {
+      RELEASE_ASSERT(size <= static_cast<size_t>(end - data));
+      memcpy(value, data, size);
+      data += size;
+    };
+
+    for (uint32_t i = 0; i < reply->num_histograms_; i++) {
+      uint32_t name_length;
+      read(&name_length, sizeof(name_length));
+      std::string name(name_length, 0);
+      read(&name[0], name_length);
+      uint64_t sample_sum;
+      read(&sample_sum, sizeof(sample_sum));
+      uint32_t num_buckets;
+      read(&num_buckets, sizeof(num_buckets));
+      std::vector<std::pair<uint64_t, uint64_t>> buckets(num_buckets);
+      for (std::pair<uint64_t, uint64_t>& bucket : buckets) {
+        read(&bucket.first, sizeof(bucket.first));
+        read(&bucket.second, sizeof(bucket.second));
+      }
+      store.addParentHistogram(name, sample_sum, buckets);
+    }
+    RELEASE_ASSERT(data == end);
+
+    if (reply->next_ == 0) {
+      return;
+    }
+    rpc.first_ = reply->next_;
+  }
+}
+
 void HotRestartImpl::initialize(Event::Dispatcher& dispatcher, Server::Instance& server) {
   socket_event_ = dispatcher.createFileEvent(my_domain_socket_, [this](uint32_t events) -> void {
     ASSERT(events == Event::FileReadyType::Read);
@@ -241,16 +403,16 @@ HotRestartImpl::RpcBase* HotRestartImpl::receiveRpc(bool block) {
   iov[0].iov_base = &rpc_buffer_[0];
   iov[0].iov_len = rpc_buffer_.size();
 
-  // We always setup to receive an FD even though most messages do not pass one.
-  uint8_t control_buffer[CMSG_SPACE(sizeof(int))];
-  memset(control_buffer, 0, CMSG_SPACE(sizeof(int)));
+  // We always setup to receive a full batch of FDs even though most messages do not pass any.
+  uint8_t control_buffer[CMSG_SPACE(sizeof(int) * MaxSocketsPerRpc)];
+  memset(control_buffer, 0, sizeof(control_buffer));
 
   msghdr message;
   memset(&message, 0, sizeof(message));
   message.msg_iov = iov;
   message.msg_iovlen = 1;
   message.msg_control = control_buffer;
-  message.msg_controllen = CMSG_SPACE(sizeof(int));
+  message.msg_controllen = sizeof(control_buffer);
 
   int rc = recvmsg(my_domain_socket_, &message, 0);
   if (!block && rc == -1 && errno == EAGAIN) {
@@ -270,17 +432,26 @@ HotRestartImpl::RpcBase* HotRestartImpl::receiveRpc(bool block) {
   RpcBase* rpc = reinterpret_cast<RpcBase*>(&rpc_buffer_[0]);
   RELEASE_ASSERT(static_cast<uint64_t>(rc) == rpc->length_);
 
-  // We should only get control data in a GetListenSocketReply. If that's the case, pull the
-  // cloned fd out of the control data and stick it into the RPC so that higher level code does
-  // need to deal with any of this.
+  // We should only get control data in a GetListenSocketsReply. If that's the case, pull the
+  // cloned fds out of the control data and stick them into the RPC, in place of the parent's fds,
+  // so that higher level code does need to deal with any of this.
   for (cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg != nullptr;
        cmsg = CMSG_NXTHDR(&message, cmsg)) {
 
     if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
-        rpc->type_ == RpcMessageType::GetListenSocketReply) {
-
-      reinterpret_cast<RpcGetListenSocketReply*>(rpc)->fd_ =
-          *reinterpret_cast<int*>(CMSG_DATA(cmsg));
+        rpc->type_ == RpcMessageType::GetListenSocketsReply) {
+
+      RpcGetListenSocketsReply* reply = reinterpret_cast<RpcGetListenSocketsReply*>(rpc);
+      const int* fds = reinterpret_cast<int*>(CMSG_DATA(cmsg));
+      const size_t num_fds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      size_t next_fd = 0;
+      for (uint32_t i = 0; i < reply->num_sockets_ && i < MaxSocketsPerRpc; i++) {
+        if (reply->fds_[i] != -1) {
+          RELEASE_ASSERT(next_fd < num_fds);
+          reply->fds_[i] = fds[next_fd++];
+        }
+      }
+      RELEASE_ASSERT(next_fd == num_fds);
     } else {
       RELEASE_ASSERT(false);
     }
@@ -289,7 +460,7 @@ HotRestartImpl::RpcBase* HotRestartImpl::receiveRpc(bool block) {
   return rpc;
 }
 
-void HotRestartImpl::sendMessage(sockaddr_un& address, RpcBase& rpc) {
+void HotRestartImpl::sendMessage(sockaddr_un& address, RpcBase& rpc, const std::vector<int>& fds) {
   iovec iov[1];
   iov[0].iov_base = &rpc;
   iov[0].iov_len = rpc.length_;
@@ -300,44 +471,111 @@ void HotRestartImpl::sendMessage(sockaddr_un& address, RpcBase& rpc) {
   message.msg_namelen = sizeof(address);
   message.msg_iov = iov;
   message.msg_iovlen = 1;
-  int rc = sendmsg(my_domain_socket_, &message, 0);
-  RELEASE_ASSERT(rc != -1);
-  UNREFERENCED_PARAMETER(rc);
-}
 
-void HotRestartImpl::onGetListenSocket(RpcGetListenSocketRequest& rpc) {
-  RpcGetListenSocketReply reply;
-  reply.fd_ = server_->getListenSocketFd(std::string(rpc.address_));
-  if (reply.fd_ == -1) {
-    // In this case there is no fd to duplicate so we just send a normal message.
-    sendMessage(child_address_, reply);
-  } else {
-    iovec iov[1];
-    iov[0].iov_base = &reply;
-    iov[0].iov_len = reply.length_;
-
-    uint8_t control_buffer[CMSG_SPACE(sizeof(int))];
-    memset(control_buffer, 0, CMSG_SPACE(sizeof(int)));
-
-    msghdr message;
-    memset(&message, 0, sizeof(message));
-    message.msg_name = &child_address_;
-    message.msg_namelen = sizeof(child_address_);
-    message.msg_iov = iov;
-    message.msg_iovlen = 1;
+  // Any fds are duplicated into the receiving process as control data.
+  ASSERT(fds.size() <= MaxSocketsPerRpc);
+  uint8_t control_buffer[CMSG_SPACE(sizeof(int) * MaxSocketsPerRpc)];
+  if (!fds.empty()) {
+    memset(control_buffer, 0, sizeof(control_buffer));
     message.msg_control = control_buffer;
-    message.msg_controllen = CMSG_SPACE(sizeof(int));
+    message.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
 
     cmsghdr* control_message = CMSG_FIRSTHDR(&message);
     control_message->cmsg_level = SOL_SOCKET;
     control_message->cmsg_type = SCM_RIGHTS;
-    control_message->cmsg_len = CMSG_LEN(sizeof(int));
-    *reinterpret_cast<int*>(CMSG_DATA(control_message)) = reply.fd_;
+    control_message->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    memcpy(CMSG_DATA(control_message), fds.data(), sizeof(int) * fds.size());
+  }
 
-    int rc = sendmsg(my_domain_socket_, &message, 0);
-    RELEASE_ASSERT(rc != -1);
-    UNREFERENCED_PARAMETER(rc);
+  int rc = sendmsg(my_domain_socket_, &message, 0);
+  RELEASE_ASSERT(rc != -1);
+  UNREFERENCED_PARAMETER(rc);
+}
+
+void HotRestartImpl::onGetListenSockets(RpcGetListenSocketsRequest& rpc) {
+  RELEASE_ASSERT(rpc.num_addresses_ <= MaxSocketsPerRpc);
+  RpcGetListenSocketsReply reply;
+  std::vector<int> fds;
+  const char* address = rpc.addresses_;
+  const char* end = reinterpret_cast<char*>(&rpc) + rpc.length_;
+  for (uint32_t i = 0; i < rpc.num_addresses_; i++) {
+    const size_t length = strnlen(address, end - address);
+    RELEASE_ASSERT(length < static_cast<size_t>(end - address));
+    reply.fds_[i] = server_->getListenSocketFd(std::string(address, length));
+    if (reply.fds_[i] != -1) {
+      fds.push_back(reply.fds_[i]);
+    }
+    address += length + 1;
   }
+  reply.num_sockets_ = rpc.num_addresses_;
+
+  // In case there are no fds to duplicate this is just a normal message.
+  sendMessage(child_address_, reply, fds);
+}
+
+bool HotRestartImpl::appendHistogram(RpcGetHistogramsReply& reply,
+                                     const Stats::Histogram& histogram) {
+  std::vector<std::pair<uint64_t, uint64_t>> buckets;
+  histogram.cumulativeStatistics().iterateBuckets(
+      [&buckets](uint64_t value, uint64_t count) -> void { buckets.emplace_back(value, count); });
+
+  const std::string name = histogram.name();
+  const uint32_t name_length = name.size();
+  const uint64_t sample_sum = histogram.cumulativeStatistics().sampleSum();
+  const uint32_t num_buckets = buckets.size();
+  const uint64_t size = sizeof(name_length) + name_length + sizeof(sample_sum) +
+                        sizeof(num_buckets) + num_buckets * 2 * sizeof(uint64_t);
+  if (reply.length_ + size > MaxRpcSize) {
+    return false;
+  }
+
+  uint8_t* data = reinterpret_cast<uint8_t*>(&reply) + reply.length_;
+  auto write = [&data](const void* value, size_t size) -> void {
+    memcpy(data, value, size);
+    data += size;
+  };
+  write(&name_length, sizeof(name_length));
+  write(name.data(), name_length);
+  write(&sample_sum, sizeof(sample_sum));
+  write(&num_buckets, sizeof(num_buckets));
+  for (const std::pair<uint64_t, uint64_t>& bucket : buckets) {
+    write(&bucket.first, sizeof(bucket.first));
+    write(&bucket.second, sizeof(bucket.second));
+  }
+
+  reply.length_ += size;
+  reply.num_histograms_++;
+  return true;
+}
+
+void HotRestartImpl::onGetHistograms(RpcGetHistogramsRequest& rpc) {
+  // Snapshot the histograms for the whole exchange so that the child's indexes stay valid.
+  if (rpc.first_ == 0) {
+    histogram_snapshot_.clear();
+    for (const Stats::HistogramSharedPtr& histogram : server_->stats().histograms()) {
+      histogram_snapshot_.push_back(histogram);
+    }
+  }
+
+  RpcGetHistogramsReply reply;
+  uint64_t index = rpc.first_;
+  while (index < histogram_snapshot_.size()) {
+    if (!appendHistogram(reply, *histogram_snapshot_[index])) {
+      // A histogram that does not fit even in an empty reply is skipped.
+      if (reply.num_histograms_ == 0) {
+        index++;
+      }
+      break;
+    }
+    index++;
+  }
+
+  if (index < histogram_snapshot_.size()) {
+    reply.next_ = index;
+  } else {
+    histogram_snapshot_.clear();
+  }
+  sendMessage(child_address_, reply);
 }
 
 void HotRestartImpl::onSocketEvent() {
@@ -356,10 +594,16 @@ void HotRestartImpl::onSocketEvent() {
       break;
     }
 
-    case RpcMessageType::GetListenSocketRequest: {
-      RpcGetListenSocketRequest* message =
-          reinterpret_cast<RpcGetListenSocketRequest*>(base_message);
-      onGetListenSocket(*message);
+    case RpcMessageType::GetListenSocketsRequest: {
+      RpcGetListenSocketsRequest* message =
+          reinterpret_cast<RpcGetListenSocketsRequest*>(base_message);
+      onGetListenSockets(*message);
+      break;
+    }
+
+    case RpcMessageType::GetHistogramsRequest: {
+      RpcGetHistogramsRequest* message = reinterpret_cast<RpcGetHistogramsRequest*>(base_message);
+      onGetHistograms(*message);
       break;
     }
 
@@ -419,7 +663,7 @@ void HotRestartImpl::terminateParent() {
 
 void HotRestartImpl::shutdown() { socket_event_.reset(); }
 
-std::string HotRestartImpl::version() { return SharedMemory::version(); }
+std::string HotRestartImpl::version() { return SharedMemory::version(options_.maxStats()); }
 
 } // Server
 } // Envoy
@@ -7,6 +7,7 @@
 #include <atomic>
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include "envoy/server/hot_restart.h"
 #include "envoy/server/options.h"
@@ -19,17 +20,32 @@ namespace Server {
 
 /**
  * Shared memory segment. This structure is laid directly into shared memory and is used amongst
- * all running envoy processes.
+ * all running envoy processes. It is followed in the segment by the stat hash index and the stat
+ * slots, both of which are sized from Options::maxStats().
  */
 class SharedMemory {
 public:
-  static std::string version();
+  /**
+   * @return the hot restart compatibility version of a segment sized for max_stats stats.
+   */
+  static std::string version(uint64_t max_stats);
 
 private:
   struct Flags {
     static const uint64_t INITIALIZING = 0x1;
   };
 
+  /**
+   * A stat along with the index of the next slot in the same hash chain, or in the free list if the
+   * slot is not in use.
+   */
+  struct StatSlot {
+    Stats::RawStatData data_;
+    uint32_t next_;
+  };
+
+  static const uint32_t INVALID_SLOT = UINT32_MAX;
+
   SharedMemory() {}
 
   /**
@@ -38,21 +54,66 @@ private:
    */
   static SharedMemory& initialize(Options& options);
 
+  /**
+   * @return the number of hash chains used to index max_stats stats.
+   */
+  static uint64_t numBuckets(uint64_t max_stats);
+
+  /**
+   * @return the offset from the start of the segment at which the stat slots start.
+   */
+  static uint64_t slotsOffset(uint64_t max_stats);
+
+  /**
+   * @return the total size of a segment sized for max_stats stats.
+   */
+  static uint64_t size(uint64_t max_stats);
+
+  /**
+   * @return the hash chain for a stat name. This must be stable across builds since it is used by
+   *         every process sharing the segment, so std::hash is not suitable.
+   */
+  static uint32_t bucket(const char* name, size_t length, uint64_t num_buckets);
+
   /**
    * Initialize a pthread mutex for process shared locking.
    */
   void initializeMutex(pthread_mutex_t& mutex);
 
+  /**
+   * Empty the hash index and place every stat slot on the free list.
+   */
+  void initializeStats();
+
+  /**
+   * Find the stat with the supplied name or allocate a new one. stat_lock_ must be held.
+   * @return the stat, or nullptr if every slot is in use.
+   */
+  Stats::RawStatData* allocStat(const std::string& name);
+
+  /**
+   * Drop a reference to a stat, returning its slot to the free list when the last reference goes
+   * away. stat_lock_ must be held.
+   */
+  void freeStat(Stats::RawStatData& data);
+
+  uint32_t* buckets() { return reinterpret_cast<uint32_t*>(this + 1); }
+  StatSlot* slots() {
+    return reinterpret_cast<StatSlot*>(reinterpret_cast<uint8_t*>(this) + slotsOffset(max_stats_));
+  }
+
   static const uint64_t VERSION;
 
   uint64_t size_;
   uint64_t version_;
+  uint64_t max_stats_;
+  uint64_t num_buckets_;
   std::atomic<uint64_t> flags_;
   pthread_mutex_t log_lock_;
   pthread_mutex_t access_log_lock_;
   pthread_mutex_t stat_lock_;
   pthread_mutex_t init_lock_;
-  std::array<Stats::RawStatData, 16384> stats_slots_;
+  uint32_t free_slot_;
 
   friend class HotRestartImpl;
 };
@@ -113,8 +174,9 @@ public:
 
   // Server::HotRestart
   void drainParentListeners() override;
-  int duplicateParentListenSocket(const std::string& address) override;
+  std::vector<int> duplicateParentListenSockets(const std::vector<std::string>& addresses) override;
   void getParentStats(GetParentStatsInfo& info) override;
+  void mergeParentHistograms(Stats::StoreRoot& store) override;
   void initialize(Event::Dispatcher& dispatcher, Server::Instance& server) override;
   void shutdownParentAdmin(ShutdownParentAdminInfo& info) override;
   void terminateParent() override;
@@ -126,16 +188,23 @@ public:
   void free(Stats::RawStatData& data) override;
 
 private:
+  // The largest message sent over the domain socket.
+  static const uint64_t MaxRpcSize = 64 * 1024;
+  // The kernel passes at most SCM_MAX_FD (253) fds in a single message.
+  static const uint32_t MaxSocketsPerRpc = 200;
+
   enum class RpcMessageType {
     DrainListenersRequest = 1,
-    GetListenSocketRequest = 2,
-    GetListenSocketReply = 3,
+    GetListenSocketsRequest = 2,
+    GetListenSocketsReply = 3,
     ShutdownAdminRequest = 4,
     ShutdownAdminReply = 5,
     TerminateRequest = 6,
     UnknownRequestReply = 7,
     GetStatsRequest = 8,
-    GetStatsReply = 9
+    GetStatsReply = 9,
+    GetHistogramsRequest = 10,
+    GetHistogramsReply = 11
   };
 
   struct RpcBase {
@@ -146,16 +215,22 @@ private:
     uint64_t length_;
   } __attribute__((packed));
 
-  struct RpcGetListenSocketRequest : public RpcBase {
-    RpcGetListenSocketRequest() : RpcBase(RpcMessageType::GetListenSocketRequest, sizeof(*this)) {}
+  struct RpcGetListenSocketsRequest : public RpcBase {
+    RpcGetListenSocketsRequest()
+        : RpcBase(RpcMessageType::GetListenSocketsRequest, sizeof(*this) - sizeof(addresses_)) {}
 
-    char address_[256]{0};
+    uint32_t num_addresses_{0};
+    // Null terminated addresses, one after the other. Only the used part is sent.
+    char addresses_[MaxRpcSize - sizeof(RpcBase) - sizeof(uint32_t)];
   } __attribute__((packed));
 
-  struct RpcGetListenSocketReply : public RpcBase {
-    RpcGetListenSocketReply() : RpcBase(RpcMessageType::GetListenSocketReply, sizeof(*this)) {}
+  struct RpcGetListenSocketsReply : public RpcBase {
+    RpcGetListenSocketsReply() : RpcBase(RpcMessageType::GetListenSocketsReply, sizeof(*this)) {}
 
-    int fd_{0};
+    uint32_t num_sockets_{0};
+    // The fd for each requested address, or -1 if there is no socket for it. The fds themselves
+    // are passed as control data, in the same order.
+    int fds_[MaxSocketsPerRpc]{0};
   } __attribute__((packed));
 
   struct RpcShutdownAdminReply : public RpcBase {
@@ -172,6 +247,26 @@ private:
     uint64_t unused_[16]{0};
   } __attribute__((packed));
 
+  struct RpcGetHistogramsRequest : public RpcBase {
+    RpcGetHistogramsRequest() : RpcBase(RpcMessageType::GetHistogramsRequest, sizeof(*this)) {}
+
+    // The index of the first histogram to send. The parent snapshots its histograms when this is 0.
+    uint64_t first_{0};
+  } __attribute__((packed));
+
+  struct RpcGetHistogramsReply : public RpcBase {
+    RpcGetHistogramsReply()
+        : RpcBase(RpcMessageType::GetHistogramsReply, sizeof(*this) - sizeof(data_)) {}
+
+    // The index of the first histogram of the next reply, or 0 if this is the last reply.
+    uint64_t next_{0};
+    uint32_t num_histograms_{0};
+    // Each histogram is encoded as its name length (uint32_t), name, sample sum (uint64_t), number
+    // of buckets (uint32_t), then the value and count (uint64_t each) of every bucket. Only the
+    // used part is sent.
+    uint8_t data_[MaxRpcSize - sizeof(RpcBase) - sizeof(uint64_t) - sizeof(uint32_t)];
+  } __attribute__((packed));
+
   template <class rpc_class, RpcMessageType rpc_type> rpc_class* receiveTypedRpc() {
     RpcBase* base_message = receiveRpc(true);
     RELEASE_ASSERT(base_message->length_ == sizeof(rpc_class));
@@ -179,12 +274,19 @@ private:
     return reinterpret_cast<rpc_class*>(base_message);
   }
 
+  /**
+   * Append a histogram to a reply if there is room for it.
+   * @return whether the histogram was appended.
+   */
+  static bool appendHistogram(RpcGetHistogramsReply& reply, const Stats::Histogram& histogram);
+
   int bindDomainSocket(uint64_t id);
   sockaddr_un createDomainSocketAddress(uint64_t id);
-  void onGetListenSocket(RpcGetListenSocketRequest& rpc);
+  void onGetListenSockets(RpcGetListenSocketsRequest& rpc);
+  void onGetHistograms(RpcGetHistogramsRequest& rpc);
   void onSocketEvent();
   RpcBase* receiveRpc(bool block);
-  void sendMessage(sockaddr_un& address, RpcBase& rpc);
+  void sendMessage(sockaddr_un& address, RpcBase& rpc, const std::vector<int>& fds = {});
 
   Options& options_;
   SharedMemory& shmem_;
@@ -196,8 +298,9 @@ private:
   sockaddr_un parent_address_;
   sockaddr_un child_address_;
   Event::FileEventPtr socket_event_;
-  std::array<uint8_t, 4096> rpc_buffer_;
+  std::array<uint8_t, MaxRpcSize> rpc_buffer_;
   Server::Instance* server_{};
+  std::vector<Stats::HistogramSharedPtr> histogram_snapshot_;
   bool parent_terminated_{};
 };
 
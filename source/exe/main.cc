@@ -27,7 +27,7 @@ int main(int argc, char** argv) {
   Envoy::SignalAction handle_sigs;
 #endif
 
-  Envoy::OptionsImpl options(argc, argv, Envoy::Server::SharedMemory::version(),
+  Envoy::OptionsImpl options(argc, argv, &Envoy::Server::SharedMemory::version,
                              spdlog::level::warn);
 
   std::unique_ptr<Envoy::Server::HotRestartImpl> restarter;
@@ -2,6 +2,7 @@
 #include <memory>
 
 #include "common/common/compiler_requirements.h"
+#include "common/common/utility.h"
 #include "common/event/libevent.h"
 #include "common/local_info/local_info_impl.h"
 #include "common/network/utility.h"
@@ -26,7 +27,7 @@ class ProdComponentFactory : public ComponentFactory {
 public:
   // Server::DrainManagerFactory
   DrainManagerPtr createDrainManager(Instance& server) override {
-    return DrainManagerPtr{new DrainManagerImpl(server)};
+    return DrainManagerPtr{new DrainManagerImpl(server, ProdMonotonicTimeSource::instance_)};
   }
 
   Runtime::LoaderPtr createRuntime(Server::Instance& server,
@@ -55,12 +56,14 @@ int main_common(Envoy::OptionsImpl& options, Envoy::Server::HotRestartImpl& rest
 
   ares_library_init(ARES_LIB_INIT_ALL);
 
-  Envoy::Logger::Registry::initialize(options.logLevel(), restarter.logLock());
+  Envoy::Logger::Registry::initialize(options.logLevel(), restarter.logLock(),
+                                      options.asyncLogLines());
   Envoy::DefaultTestHooks default_test_hooks;
   Envoy::Stats::ThreadLocalStoreImpl stats_store(restarter);
   Envoy::Server::InstanceImpl server(options, default_test_hooks, restarter, stats_store,
                                      restarter.accessLogLock(), component_factory, local_info);
   server.run();
+  Envoy::Logger::Registry::getSink()->stopAsync();
   ares_library_cleanup();
   return 0;
 }
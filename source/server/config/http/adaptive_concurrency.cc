@@ -0,0 +1,38 @@
+#include "server/config/http/adaptive_concurrency.h"
+
+#include <string>
+
+#include "common/common/utility.h"
+#include "common/http/filter/adaptive_concurrency_filter.h"
+
+namespace Envoy {
+namespace Server {
+namespace Configuration {
+
+HttpFilterFactoryCb AdaptiveConcurrencyFilterConfig::createFilterFactory(
+    HttpFilterType type, const Json::Object& json_config, const std::string& stats_prefix,
+    Server::Instance& server) {
+  if (type != HttpFilterType::Both) {
+    throw EnvoyException(fmt::format(
+        "{} http filter must be configured as both a decoder and encoder filter.", name()));
+  }
+
+  Http::AdaptiveConcurrencyFilterConfigSharedPtr config(new Http::AdaptiveConcurrencyFilterConfig(
+      json_config, stats_prefix, server.stats(), ProdMonotonicTimeSource::instance_));
+  return [config](Http::FilterChainFactoryCallbacks& callbacks) -> void {
+    callbacks.addStreamFilter(
+        Http::StreamFilterSharedPtr{new Http::AdaptiveConcurrencyFilter(config)});
+  };
+}
+
+std::string AdaptiveConcurrencyFilterConfig::name() { return "adaptive_concurrency"; }
+
+/**
+ * Static registration for the adaptive concurrency filter. @see
+ * RegisterNamedHttpFilterConfigFactory.
+ */
+static RegisterNamedHttpFilterConfigFactory<AdaptiveConcurrencyFilterConfig> register_;
+
+} // Configuration
+} // Server
+} // Envoy
@@ -21,11 +21,14 @@ HttpFilterFactoryCb BufferFilterConfig::createFilterFactory(HttpFilterType type,
   }
 
   json_config.validateSchema(Json::Schema::BUFFER_HTTP_FILTER_SCHEMA);
+  const Json::ObjectSharedPtr spill_to_disk = json_config.getObject("spill_to_disk", true);
 
   Http::BufferFilterConfigConstSharedPtr config(new Http::BufferFilterConfig{
       Http::BufferFilter::generateStats(stats_prefix, server.stats()),
       static_cast<uint64_t>(json_config.getInteger("max_request_bytes")),
-      std::chrono::seconds(json_config.getInteger("max_request_time_s"))});
+      std::chrono::seconds(json_config.getInteger("max_request_time_s")),
+      spill_to_disk->getString("directory", ""),
+      static_cast<uint64_t>(spill_to_disk->getInteger("memory_limit_bytes", 65536))});
   return [config](Http::FilterChainFactoryCallbacks& callbacks) -> void {
     callbacks.addStreamDecoderFilter(
         Http::StreamDecoderFilterSharedPtr{new Http::BufferFilter(config)});
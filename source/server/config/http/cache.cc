@@ -0,0 +1,38 @@
+#include "server/config/http/cache.h"
+
+#include <string>
+
+#include "common/common/utility.h"
+#include "common/http/filter/cache_filter.h"
+
+namespace Envoy {
+namespace Server {
+namespace Configuration {
+
+HttpFilterFactoryCb CacheFilterConfig::createFilterFactory(HttpFilterType type,
+                                                           const Json::Object& json_config,
+                                                           const std::string& stats_prefix,
+                                                           Server::Instance& server) {
+  if (type != HttpFilterType::Both) {
+    throw EnvoyException(fmt::format(
+        "{} http filter must be configured as both a decoder and encoder filter.", name()));
+  }
+
+  Http::CacheFilterConfigSharedPtr config(
+      new Http::CacheFilterConfig(json_config, stats_prefix, server.stats(), server.threadLocal(),
+                                  ProdMonotonicTimeSource::instance_));
+  return [config](Http::FilterChainFactoryCallbacks& callbacks) -> void {
+    callbacks.addStreamFilter(Http::StreamFilterSharedPtr{new Http::CacheFilter(config)});
+  };
+}
+
+std::string CacheFilterConfig::name() { return "cache"; }
+
+/**
+ * Static registration for the cache filter. @see RegisterNamedHttpFilterConfigFactory.
+ */
+static RegisterNamedHttpFilterConfigFactory<CacheFilterConfig> register_;
+
+} // Configuration
+} // Server
+} // Envoy
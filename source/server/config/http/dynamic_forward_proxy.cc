@@ -0,0 +1,37 @@
+#include "server/config/http/dynamic_forward_proxy.h"
+
+#include <string>
+
+#include "common/http/filter/dynamic_forward_proxy_filter.h"
+
+namespace Envoy {
+namespace Server {
+namespace Configuration {
+
+HttpFilterFactoryCb DynamicForwardProxyFilterConfig::createFilterFactory(
+    HttpFilterType type, const Json::Object& json_config, const std::string& stat_prefix,
+    Server::Instance& server) {
+  if (type != HttpFilterType::Decoder) {
+    throw EnvoyException(fmt::format(
+        "{} dynamic forward proxy filter must be configured as a decoder filter.", name()));
+  }
+
+  Http::DynamicForwardProxyFilterConfigSharedPtr config(new Http::DynamicForwardProxyFilterConfig(
+      json_config, stat_prefix, server.stats(), server.clusterManager(), server.dnsResolver()));
+  return [config](Http::FilterChainFactoryCallbacks& callbacks) -> void {
+    callbacks.addStreamDecoderFilter(
+        Http::StreamDecoderFilterSharedPtr{new Http::DynamicForwardProxyFilter(config)});
+  };
+}
+
+std::string DynamicForwardProxyFilterConfig::name() { return "dynamic_forward_proxy"; }
+
+/**
+ * Static registration for the dynamic forward proxy filter. @see
+ * RegisterNamedHttpFilterConfigFactory.
+ */
+static RegisterNamedHttpFilterConfigFactory<DynamicForwardProxyFilterConfig> register_;
+
+} // Configuration
+} // Server
+} // Envoy
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+
+#include "envoy/server/instance.h"
+
+#include "server/config/network/http_connection_manager.h"
+
+namespace Envoy {
+namespace Server {
+namespace Configuration {
+
+/**
+ * Config registration for the dynamic forward proxy filter. @see NamedHttpFilterConfigFactory.
+ */
+class DynamicForwardProxyFilterConfig : public NamedHttpFilterConfigFactory {
+public:
+  HttpFilterFactoryCb createFilterFactory(HttpFilterType type, const Json::Object& json_config,
+                                          const std::string& stat_prefix,
+                                          Server::Instance& server) override;
+
+  std::string name() override;
+};
+
+} // Configuration
+} // Server
+} // Envoy
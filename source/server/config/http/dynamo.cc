@@ -1,5 +1,6 @@
 #include "server/config/http/dynamo.h"
 
+#include <memory>
 #include <string>
 
 #include "common/dynamo/dynamo_filter.h"
@@ -17,9 +18,11 @@ HttpFilterFactoryCb DynamoFilterConfig::createFilterFactory(HttpFilterType type,
         "{} http filter must be configured as both a decoder and encoder filter.", name()));
   }
 
-  return [&server, stat_prefix](Http::FilterChainFactoryCallbacks& callbacks) -> void {
-    callbacks.addStreamFilter(Http::StreamFilterSharedPtr{
-        new Dynamo::DynamoFilter(server.runtime(), stat_prefix, server.stats())});
+  Dynamo::DynamoStatsSharedPtr stats =
+      std::make_shared<Dynamo::DynamoStats>(stat_prefix, server.stats(), server.threadLocal());
+  return [&server, stats](Http::FilterChainFactoryCallbacks& callbacks) -> void {
+    callbacks.addStreamFilter(
+        Http::StreamFilterSharedPtr{new Dynamo::DynamoFilter(server.runtime(), stats)});
   };
 }
 
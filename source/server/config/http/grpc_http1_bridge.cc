@@ -3,23 +3,26 @@
 #include <string>
 
 #include "common/grpc/http1_bridge_filter.h"
+#include "common/json/config_schemas.h"
 
 namespace Envoy {
 namespace Server {
 namespace Configuration {
 
-HttpFilterFactoryCb GrpcHttp1BridgeFilterConfig::createFilterFactory(HttpFilterType type,
-                                                                     const Json::Object&,
-                                                                     const std::string&,
-                                                                     Server::Instance& server) {
+HttpFilterFactoryCb
+GrpcHttp1BridgeFilterConfig::createFilterFactory(HttpFilterType type,
+                                                 const Json::Object& json_config,
+                                                 const std::string&, Server::Instance& server) {
   if (type != HttpFilterType::Both) {
     throw EnvoyException(fmt::format(
         "{} http filter must be configured as both a decoder and encoder filter.", name()));
   }
 
-  return [&server](Http::FilterChainFactoryCallbacks& callbacks) -> void {
-    callbacks.addStreamFilter(
-        Http::StreamFilterSharedPtr{new Grpc::Http1BridgeFilter(server.clusterManager())});
+  json_config.validateSchema(Json::Schema::GRPC_HTTP1_BRIDGE_HTTP_FILTER_SCHEMA);
+  const bool streaming = json_config.getString("mode", "buffered") == "streaming";
+  return [&server, streaming](Http::FilterChainFactoryCallbacks& callbacks) -> void {
+    callbacks.addStreamFilter(Http::StreamFilterSharedPtr{
+        new Grpc::Http1BridgeFilter(server.clusterManager(), streaming)});
   };
 }
 
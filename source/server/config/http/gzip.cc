@@ -0,0 +1,38 @@
+#include "server/config/http/gzip.h"
+
+#include <string>
+
+#include "common/common/utility.h"
+#include "common/http/filter/gzip_filter.h"
+
+namespace Envoy {
+namespace Server {
+namespace Configuration {
+
+HttpFilterFactoryCb GzipFilterConfig::createFilterFactory(HttpFilterType type,
+                                                           const Json::Object& json_config,
+                                                           const std::string& stats_prefix,
+                                                           Server::Instance& server) {
+  if (type != HttpFilterType::Both) {
+    throw EnvoyException(fmt::format(
+        "{} http filter must be configured as both a decoder and encoder filter.", name()));
+  }
+
+  Http::GzipFilterConfigSharedPtr config(
+      new Http::GzipFilterConfig(json_config, stats_prefix, server.stats(), server.threadLocal(),
+                                  ProdMonotonicTimeSource::instance_));
+  return [config](Http::FilterChainFactoryCallbacks& callbacks) -> void {
+    callbacks.addStreamFilter(Http::StreamFilterSharedPtr{new Http::GzipFilter(config)});
+  };
+}
+
+std::string GzipFilterConfig::name() { return "gzip"; }
+
+/**
+ * Static registration for the gzip filter. @see RegisterNamedHttpFilterConfigFactory.
+ */
+static RegisterNamedHttpFilterConfigFactory<GzipFilterConfig> register_;
+
+} // Configuration
+} // Server
+} // Envoy
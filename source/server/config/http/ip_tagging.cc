@@ -11,14 +11,15 @@ namespace Configuration {
 
 HttpFilterFactoryCb IpTaggingFilterConfig::createFilterFactory(HttpFilterType type,
                                                                const Json::Object& json_config,
-                                                               const std::string&,
-                                                               Server::Instance&) {
+                                                               const std::string& stat_prefix,
+                                                               Server::Instance& server) {
   if (type != HttpFilterType::Decoder) {
     throw EnvoyException(
         fmt::format("{} ip tagging filter must be configured as a decoder filter.", name()));
   }
 
-  Http::IpTaggingFilterConfigSharedPtr config(new Http::IpTaggingFilterConfig(json_config));
+  Http::IpTaggingFilterConfigSharedPtr config(
+      new Http::IpTaggingFilterConfig(json_config, stat_prefix, server.stats()));
   return [config](Http::FilterChainFactoryCallbacks& callbacks) -> void {
     callbacks.addStreamDecoderFilter(
         Http::StreamDecoderFilterSharedPtr{new Http::IpTaggingFilter(config)});
@@ -1,6 +1,7 @@
 #include "server/config/http/router.h"
 
 #include <string>
+#include <vector>
 
 #include "common/json/config_schemas.h"
 #include "common/router/router.h"
@@ -21,11 +22,23 @@ HttpFilterFactoryCb RouterFilterConfig::createFilterFactory(HttpFilterType type,
 
   json_config.validateSchema(Json::Schema::ROUTER_HTTP_FILTER_SCHEMA);
 
+  Router::RequestCoalescerPtr coalescer;
+  if (json_config.hasObject("request_coalescing")) {
+    Json::ObjectSharedPtr coalescing = json_config.getObject("request_coalescing");
+    std::vector<Http::LowerCaseString> vary_headers;
+    if (coalescing->hasObject("vary_headers")) {
+      for (const std::string& header : coalescing->getStringArray("vary_headers")) {
+        vary_headers.emplace_back(header);
+      }
+    }
+    coalescer.reset(new Router::RequestCoalescer(server.threadLocal(), vary_headers));
+  }
+
   Router::FilterConfigSharedPtr config(new Router::FilterConfig(
       stat_prefix, server.localInfo(), server.stats(), server.clusterManager(), server.runtime(),
       server.random(),
       Router::ShadowWriterPtr{new Router::ShadowWriterImpl(server.clusterManager())},
-      json_config.getBoolean("dynamic_stats", true)));
+      json_config.getBoolean("dynamic_stats", true), std::move(coalescer)));
 
   return [config](Http::FilterChainFactoryCallbacks& callbacks)
       -> void { callbacks.addStreamDecoderFilter(std::make_shared<Router::ProdFilter>(*config)); };
@@ -12,6 +12,7 @@
 #include "envoy/stats/stats.h"
 
 #include "common/http/access_log/access_log_impl.h"
+#include "common/http/access_log/grpc_access_log_impl.h"
 #include "common/http/http1/codec_impl.h"
 #include "common/http/http2/codec_impl.h"
 #include "common/http/utility.h"
@@ -77,7 +78,9 @@ HttpConnectionManagerConfig::HttpConnectionManagerConfig(const Json::Object& con
       stats_(Http::ConnectionManagerImpl::generateStats(stats_prefix_, server.stats())),
       tracing_stats_(
           Http::ConnectionManagerImpl::generateTracingStats(stats_prefix_, server.stats())),
+      http1_settings_(Http::Utility::parseHttp1Settings(config)),
       http2_settings_(Http::Utility::parseHttp2Settings(config)),
+      header_limits_(Http::Utility::parseHeaderLimits(config)),
       drain_timeout_(config.getInteger("drain_timeout_ms", 5000)),
       generate_request_id_(config.getBoolean("generate_request_id", true)),
       date_provider_(server.dispatcher(), server.threadLocal()) {
@@ -125,6 +128,18 @@ HttpConnectionManagerConfig::HttpConnectionManagerConfig(const Json::Object& con
 
   if (config.hasObject("access_log")) {
     for (const Json::ObjectSharedPtr& access_log : config.getObjectArray("access_log")) {
+      if (access_log->hasObject("grpc_cluster")) {
+        Http::AccessLog::FilterPtr filter;
+        if (access_log->hasObject("filter")) {
+          filter = Http::AccessLog::FilterImpl::fromJson(*access_log->getObject("filter"),
+                                                         server.runtime());
+        }
+        access_logs_.emplace_back(new Http::AccessLog::GrpcAccessLog(
+            *access_log, std::move(filter), server.clusterManager(), server.threadLocal(),
+            server.stats()));
+        continue;
+      }
+
       Http::AccessLog::InstanceSharedPtr current_access_log =
           Http::AccessLog::InstanceImpl::fromJson(*access_log, server.runtime(),
                                                   server.accessLogManager());
@@ -161,7 +176,7 @@ HttpConnectionManagerConfig::HttpConnectionManagerConfig(const Json::Object& con
     if (search_it != namedFilterConfigFactories().end()) {
       HttpFilterFactoryCb callback =
           search_it->second->createFilterFactory(type, *config_object, stats_prefix_, server);
-      filter_factories_.push_back(callback);
+      filter_factories_.push_back({string_name, callback});
     } else {
       // DEPRECATED
       // This name wasn't found in the named map, so search in the deprecated list registry.
@@ -170,7 +185,7 @@ HttpConnectionManagerConfig::HttpConnectionManagerConfig(const Json::Object& con
         HttpFilterFactoryCb callback = config_factory->tryCreateFilterFactory(
             type, string_name, *config_object, stats_prefix_, server);
         if (callback) {
-          filter_factories_.push_back(callback);
+          filter_factories_.push_back({string_name, callback});
           found_filter = true;
           break;
         }
@@ -190,18 +205,21 @@ HttpConnectionManagerConfig::createCodec(Network::Connection& connection,
                                          Http::ServerConnectionCallbacks& callbacks) {
   switch (codec_type_) {
   case CodecType::HTTP1:
-    return Http::ServerConnectionPtr{new Http::Http1::ServerConnectionImpl(connection, callbacks)};
+    return Http::ServerConnectionPtr{
+        new Http::Http1::ServerConnectionImpl(connection, callbacks, header_limits_,
+                                              http1_settings_)};
   case CodecType::HTTP2:
     return Http::ServerConnectionPtr{new Http::Http2::ServerConnectionImpl(
-        connection, callbacks, server_.stats(), http2_settings_)};
+        connection, callbacks, server_.stats(), http2_settings_, header_limits_)};
   case CodecType::AUTO:
     if (HttpConnectionManagerConfigUtility::determineNextProtocol(connection, data) ==
         Http::Http2::ALPN_STRING) {
       return Http::ServerConnectionPtr{new Http::Http2::ServerConnectionImpl(
-          connection, callbacks, server_.stats(), http2_settings_)};
+          connection, callbacks, server_.stats(), http2_settings_, header_limits_)};
     } else {
       return Http::ServerConnectionPtr{
-          new Http::Http1::ServerConnectionImpl(connection, callbacks)};
+          new Http::Http1::ServerConnectionImpl(connection, callbacks, header_limits_,
+                                                http1_settings_)};
     }
   }
 
@@ -209,8 +227,9 @@ HttpConnectionManagerConfig::createCodec(Network::Connection& connection,
 }
 
 void HttpConnectionManagerConfig::createFilterChain(Http::FilterChainFactoryCallbacks& callbacks) {
-  for (const HttpFilterFactoryCb& factory : filter_factories_) {
-    factory(callbacks);
+  for (const FilterFactory& factory : filter_factories_) {
+    callbacks.setFilterName(factory.name_);
+    factory.factory_(callbacks);
   }
 }
 
@@ -189,14 +189,21 @@ private:
   HttpFilterType stringToType(const std::string& type);
 
   Server::Instance& server_;
-  std::list<HttpFilterFactoryCb> filter_factories_;
+  struct FilterFactory {
+    const std::string name_;
+    const HttpFilterFactoryCb factory_;
+  };
+
+  std::list<FilterFactory> filter_factories_;
   std::list<Http::AccessLog::InstanceSharedPtr> access_logs_;
   const std::string stats_prefix_;
   Http::ConnectionManagerStats stats_;
   Http::ConnectionManagerTracingStats tracing_stats_;
   bool use_remote_address_{};
   CodecType codec_type_;
+  const Http::Http1Settings http1_settings_;
   const Http::Http2Settings http2_settings_;
+  const Http::HeaderLimits header_limits_;
   std::string server_name_;
   Http::TracingConnectionManagerConfigPtr tracing_config_;
   Optional<std::string> user_agent_;
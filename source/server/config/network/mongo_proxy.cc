@@ -24,8 +24,10 @@ NetworkFilterFactoryCb MongoProxyFilterConfigFactory::createFilterFactory(
   std::string stat_prefix = "mongo." + config.getString("stat_prefix") + ".";
   Mongo::AccessLogSharedPtr access_log;
   if (config.hasObject("access_log")) {
-    access_log.reset(
-        new Mongo::AccessLog(config.getString("access_log"), server.accessLogManager()));
+    access_log.reset(new Mongo::AccessLog(
+        config.getString("access_log"), server.accessLogManager(), server.runtime(),
+        server.random(), stat_prefix + "access_log.", server.stats(),
+        config.getInteger("access_log_max_pending", Mongo::AccessLog::DEFAULT_MAX_PENDING)));
   }
 
   return [stat_prefix, &server, access_log](Network::FilterManager& filter_manager) -> void {
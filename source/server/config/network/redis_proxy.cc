@@ -3,10 +3,12 @@
 #include <memory>
 #include <string>
 
+#include "common/common/utility.h"
 #include "common/redis/codec_impl.h"
 #include "common/redis/command_splitter_impl.h"
 #include "common/redis/conn_pool_impl.h"
 #include "common/redis/proxy_filter.h"
+#include "common/redis/read_cache.h"
 
 namespace Envoy {
 namespace Server {
@@ -25,9 +27,16 @@ NetworkFilterFactoryCb RedisProxyFilterConfigFactory::createFilterFactory(
       new Redis::ConnPool::InstanceImpl(filter_config->clusterName(), server.clusterManager(),
                                         Redis::ConnPool::ClientFactoryImpl::instance_,
                                         server.threadLocal(), *config.getObject("conn_pool")));
+  Redis::ReadCachePtr read_cache;
+  if (config.hasObject("read_cache")) {
+    read_cache.reset(new Redis::ReadCache(*config.getObject("read_cache"), server.threadLocal(),
+                                          ProdMonotonicTimeSource::instance_, server.stats(),
+                                          filter_config->statPrefix()));
+  }
   std::shared_ptr<Redis::CommandSplitter::Instance> splitter(
       new Redis::CommandSplitter::InstanceImpl(std::move(conn_pool), server.stats(),
-                                               filter_config->statPrefix()));
+                                               filter_config->statPrefix(),
+                                               std::move(read_cache)));
   return [splitter, filter_config](Network::FilterManager& filter_manager) -> void {
     Redis::DecoderFactoryImpl factory;
     filter_manager.addReadFilter(std::make_shared<Redis::ProxyFilter>(
@@ -0,0 +1,42 @@
+#include "server/config/network/tap.h"
+
+#include <string>
+
+#include "envoy/network/connection.h"
+#include "envoy/server/instance.h"
+
+#include "common/filter/tap.h"
+#include "common/json/config_schemas.h"
+
+namespace Envoy {
+namespace Server {
+namespace Configuration {
+
+NetworkFilterFactoryCb TapFilterConfigFactory::createFilterFactory(NetworkFilterType type,
+                                                                   const Json::Object& config,
+                                                                   Server::Instance& server) {
+  if (type != NetworkFilterType::Both) {
+    throw EnvoyException(fmt::format(
+        "{} network filter must be configured as both a read and write filter.", name()));
+  }
+
+  config.validateSchema(Json::Schema::TAP_NETWORK_FILTER_SCHEMA);
+
+  Filter::TapConfigSharedPtr tap_config(
+      new Filter::TapConfig(config, server.accessLogManager(), server.threadLocal(),
+                            server.runtime(), server.random(), server.stats()));
+  return [tap_config](Network::FilterManager& filter_manager) -> void {
+    filter_manager.addFilter(Network::FilterSharedPtr{new Filter::TapFilter(tap_config)});
+  };
+}
+
+std::string TapFilterConfigFactory::name() { return "tap"; }
+
+/**
+ * Static registration for the tap filter. @see RegisterNamedNetworkFilterConfigFactory.
+ */
+static RegisterNamedNetworkFilterConfigFactory<TapFilterConfigFactory> registered_;
+
+} // Configuration
+} // Server
+} // Envoy
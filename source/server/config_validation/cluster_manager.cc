@@ -39,7 +39,8 @@ ValidationClusterManager::httpConnPoolForCluster(const std::string&, ResourcePri
   return nullptr;
 }
 
-Host::CreateConnectionData ValidationClusterManager::tcpConnForCluster(const std::string&) {
+Host::CreateConnectionData ValidationClusterManager::tcpConnForCluster(const std::string&,
+                                                                       LoadBalancerContext*) {
   return Host::CreateConnectionData{nullptr, nullptr};
 }
 
@@ -46,7 +46,7 @@ public:
 
   Http::ConnectionPool::Instance* httpConnPoolForCluster(const std::string&, ResourcePriority,
                                                          LoadBalancerContext*) override;
-  Host::CreateConnectionData tcpConnForCluster(const std::string&) override;
+  Host::CreateConnectionData tcpConnForCluster(const std::string&, LoadBalancerContext*) override;
   Http::AsyncClient& httpAsyncClientForCluster(const std::string&) override;
 
 private:
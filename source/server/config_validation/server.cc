@@ -1,5 +1,13 @@
 #include "server/config_validation/server.h"
 
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/common/utility.h"
+
 #include "server/configuration_impl.h"
 
 namespace Envoy {
@@ -13,6 +21,10 @@ bool validateConfig(Options& options, ComponentFactory& component_factory,
   try {
     ValidationInstance server(options, stats_store, access_log_lock, component_factory, local_info);
     std::cout << "configuration '" << options.configPath() << "' OK" << std::endl;
+    for (const auto& phase_time : server.startupPhaseTimes()) {
+      std::cout << fmt::format("  {}: {}ms", phase_time.first, phase_time.second.count())
+                << std::endl;
+    }
     server.shutdown();
     return true;
   } catch (const EnvoyException& e) {
@@ -47,8 +59,14 @@ void ValidationInstance::initialize(Options& options, ComponentFactory& componen
   //
   // If we get all the way through that stripped-down initialization flow, to the point where we'd
   // be ready to serve, then the config has passed validation.
+  MonotonicTime start = ProdMonotonicTimeSource::instance_.currentTime();
   Json::ObjectSharedPtr config_json = Json::Factory::loadFromFile(options.configPath());
+  phaseComplete("parse", start);
+  Configuration::MainImpl::validateSchemas(*config_json, options.concurrency());
+  phaseComplete(fmt::format("schema validation ({} threads)", options.concurrency()), start);
   Configuration::InitialImpl initial_config(*config_json);
+  // The store does not extract tags, but invalid tag regexes must still fail validation.
+  initial_config.createTagProducer();
   thread_local_.registerThread(handler_.dispatcher(), true);
   runtime_loader_ = component_factory.createRuntime(*this, initial_config);
   ssl_context_manager_.reset(new Ssl::ContextManagerImpl(*runtime_loader_));
@@ -63,6 +81,14 @@ void ValidationInstance::initialize(Options& options, ComponentFactory& componen
 
   clusterManager().setInitializedCb([this]()
                                         -> void { init_manager_.initialize([]() -> void {}); });
+  phaseComplete("initialization", start);
+}
+
+void ValidationInstance::phaseComplete(const std::string& phase, MonotonicTime& start) {
+  const MonotonicTime now = ProdMonotonicTimeSource::instance_.currentTime();
+  phase_times_.emplace_back(phase,
+                            std::chrono::duration_cast<std::chrono::milliseconds>(now - start));
+  start = now;
 }
 
 void ValidationInstance::shutdown() {
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "envoy/common/optional.h"
 #include "envoy/server/drain_manager.h"
@@ -68,6 +73,7 @@ public:
   void getParentStats(HotRestart::GetParentStatsInfo&) override { NOT_IMPLEMENTED; }
   HotRestart& hotRestart() override { NOT_IMPLEMENTED; }
   Init::Manager& initManager() override { return init_manager_; }
+  uint64_t numConnections() override { NOT_IMPLEMENTED; }
   Runtime::RandomGenerator& random() override { return random_generator_; }
   RateLimit::ClientPtr
   rateLimitClient(const Optional<std::chrono::milliseconds>& timeout) override {
@@ -78,8 +84,10 @@ public:
   void shutdownAdmin() override { NOT_IMPLEMENTED; }
   bool healthCheckFailed() override { NOT_IMPLEMENTED; }
   Options& options() override { return options_; }
+  OverloadManager& overloadManager() override { NOT_IMPLEMENTED; }
   time_t startTimeCurrentEpoch() override { NOT_IMPLEMENTED; }
   time_t startTimeFirstEpoch() override { NOT_IMPLEMENTED; }
+  const StartupPhaseTimes& startupPhaseTimes() override { return phase_times_; }
   Stats::Store& stats() override { return stats_store_; }
   Tracing::HttpTracer& httpTracer() override { return config_->httpTracer(); }
   ThreadLocal::Instance& threadLocal() override { return thread_local_; }
@@ -87,6 +95,7 @@ public:
 
 private:
   void initialize(Options& options, ComponentFactory& component_factory);
+  void phaseComplete(const std::string& phase, MonotonicTime& start);
 
   Options& options_;
   Stats::IsolatedStoreImpl& stats_store_;
@@ -101,6 +110,7 @@ private:
   AccessLog::AccessLogManagerImpl access_log_manager_;
   std::unique_ptr<Upstream::ValidationClusterManagerFactory> cluster_manager_factory_;
   InitManagerImpl init_manager_;
+  StartupPhaseTimes phase_times_;
 };
 
 } // Server
@@ -1,5 +1,7 @@
 #include "server/configuration_impl.h"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <list>
 #include <memory>
@@ -12,10 +14,14 @@
 #include "envoy/ssl/context_manager.h"
 
 #include "common/common/assert.h"
+#include "common/common/thread.h"
 #include "common/common/utility.h"
 #include "common/json/config_schemas.h"
+#include "common/network/connection_balancer_impl.h"
+#include "common/ratelimit/local_ratelimit_impl.h"
 #include "common/ratelimit/ratelimit_impl.h"
 #include "common/ssl/context_config_impl.h"
+#include "common/stats/tag_extractor_impl.h"
 #include "common/upstream/cluster_manager_impl.h"
 
 #include "spdlog/spdlog.h"
@@ -37,6 +43,55 @@ MainImpl::MainImpl(Server::Instance& server,
                    Upstream::ClusterManagerFactory& cluster_manager_factory)
     : server_(server), cluster_manager_factory_(cluster_manager_factory) {}
 
+void MainImpl::validateSchemas(const Json::Object& config, uint32_t concurrency) {
+  std::vector<std::pair<Json::ObjectSharedPtr, const std::string*>> objects;
+  try {
+    if (config.hasObject("cluster_manager")) {
+      for (const Json::ObjectSharedPtr& cluster :
+           config.getObject("cluster_manager")->getObjectArray("clusters")) {
+        objects.emplace_back(cluster, &Json::Schema::CLUSTER_SCHEMA);
+      }
+    }
+    for (const Json::ObjectSharedPtr& listener : config.getObjectArray("listeners")) {
+      objects.emplace_back(listener, &Json::Schema::LISTENER_SCHEMA);
+    }
+  } catch (const Json::Exception&) {
+    // The config is malformed above the level of clusters and listeners. Leave it to the top level
+    // schemas to report that.
+    return;
+  }
+
+  // Each thread takes the next object that no other thread has taken yet. Only the error of the
+  // first invalid object is reported, as a serial validation would.
+  std::vector<std::string> errors(objects.size());
+  std::atomic<size_t> next{0};
+  auto validate = [&objects, &errors, &next]() -> void {
+    for (size_t i = next++; i < objects.size(); i = next++) {
+      try {
+        objects[i].first->validateSchema(*objects[i].second);
+      } catch (const Json::Exception& e) {
+        errors[i] = e.what();
+      }
+    }
+  };
+
+  std::vector<Thread::ThreadPtr> threads;
+  const size_t num_threads = std::min<size_t>(std::max<uint32_t>(concurrency, 1), objects.size());
+  for (size_t i = 1; i < num_threads; i++) {
+    threads.emplace_back(new Thread::Thread(validate));
+  }
+  validate();
+  for (Thread::ThreadPtr& thread : threads) {
+    thread->join();
+  }
+
+  for (const std::string& error : errors) {
+    if (!error.empty()) {
+      throw Json::Exception(error);
+    }
+  }
+}
+
 void MainImpl::initialize(const Json::Object& json) {
   cluster_manager_ = cluster_manager_factory_.clusterManagerFromJson(
       *json.getObject("cluster_manager"), server_.stats(), server_.threadLocal(), server_.runtime(),
@@ -64,6 +119,8 @@ void MainImpl::initialize(const Json::Object& json) {
     statsd_udp_ip_address_.value(json.getString("statsd_udp_ip_address"));
   }
 
+  statsd_udp_max_datagram_size_ = json.getInteger("statsd_udp_max_datagram_size", 0);
+
   if (json.hasObject("statsd_tcp_cluster_name")) {
     statsd_tcp_cluster_name_.value(json.getString("statsd_tcp_cluster_name"));
   }
@@ -79,16 +136,24 @@ void MainImpl::initialize(const Json::Object& json) {
       std::chrono::milliseconds(json.getInteger("watchdog_kill_timeout_ms", 0));
   watchdog_multikill_timeout_ =
       std::chrono::milliseconds(json.getInteger("watchdog_multikill_timeout_ms", 0));
+  watchdog_stall_samples_ = json.getInteger("watchdog_stall_samples", 0);
 
   initializeTracers(json);
 
   if (json.hasObject("rate_limit_service")) {
     Json::ObjectSharedPtr rate_limit_service_config = json.getObject("rate_limit_service");
     std::string type = rate_limit_service_config->getString("type");
-    ASSERT(type == "grpc_service");
-    UNREFERENCED_PARAMETER(type);
-    ratelimit_client_factory_.reset(new RateLimit::GrpcFactoryImpl(
-        *rate_limit_service_config->getObject("config"), *cluster_manager_));
+    if (type == "local") {
+      ratelimit_client_factory_.reset(new RateLimit::LocalFactoryImpl(
+          *rate_limit_service_config->getObject("config"), *cluster_manager_,
+          server_.threadLocal(), server_.dispatcher(), server_.stats(),
+          ProdMonotonicTimeSource::instance_, server_.options().concurrency()));
+    } else {
+      ASSERT(type == "grpc_service");
+      ratelimit_client_factory_.reset(new RateLimit::GrpcFactoryImpl(
+          *rate_limit_service_config->getObject("config"), *cluster_manager_,
+          server_.threadLocal(), server_.stats(), ProdMonotonicTimeSource::instance_));
+    }
   } else {
     ratelimit_client_factory_.reset(new RateLimit::NullFactoryImpl());
   }
@@ -153,12 +218,60 @@ MainImpl::ListenerConfig::ListenerConfig(MainImpl& parent, Json::Object& json) :
   }
 
   bind_to_port_ = json.getBoolean("bind_to_port", true);
+  reuse_port_ = json.getBoolean("reuse_port", false);
+  reuse_port_cpu_steering_ = json.getBoolean("reuse_port_cpu_steering", false);
+  if (reuse_port_cpu_steering_ && !reuse_port_) {
+    throw EnvoyException(fmt::format("listener {}: reuse_port_cpu_steering requires reuse_port",
+                                     address_->asString()));
+  }
+  if (json.getBoolean("balance_connections", false)) {
+    connection_balancer_.reset(new Network::ConnectionBalancerImpl());
+  }
   use_proxy_proto_ = json.getBoolean("use_proxy_proto", false);
   use_original_dst_ = json.getBoolean("use_original_dst", false);
   per_connection_buffer_limit_bytes_ =
       json.getInteger("per_connection_buffer_limit_bytes", 1024 * 1024);
+  socket_options_ = Network::Utility::parseSocketOptions(json);
+
+  if (json.hasObject("filters") == json.hasObject("filter_chains")) {
+    throw EnvoyException(fmt::format("listener {}: exactly one of filters or filter_chains must be "
+                                     "specified",
+                                     address_->asString()));
+  }
 
-  std::vector<Json::ObjectSharedPtr> filters = json.getObjectArray("filters");
+  if (json.hasObject("filters")) {
+    filter_chains_.emplace_back();
+    parseFilters(json.getObjectArray("filters"), filter_chains_.back());
+  } else {
+    std::vector<FilterChainTable::FilterChainMatch> matches;
+    for (const Json::ObjectSharedPtr& filter_chain : json.getObjectArray("filter_chains")) {
+      matches.emplace_back();
+      if (filter_chain->hasObject("filter_chain_match")) {
+        Json::ObjectSharedPtr match = filter_chain->getObject("filter_chain_match");
+        if (match->hasObject("destination_ip_ranges")) {
+          matches.back().destination_ip_ranges_ = match->getStringArray("destination_ip_ranges");
+        }
+        matches.back().destination_port_ = match->getInteger("destination_port", 0);
+        if (match->hasObject("server_names")) {
+          matches.back().server_names_ = match->getStringArray("server_names");
+        }
+        if (match->hasObject("application_protocols")) {
+          matches.back().application_protocols_ = match->getStringArray("application_protocols");
+        }
+      }
+
+      log().info("  filter chain #{}:", filter_chains_.size());
+      filter_chains_.emplace_back();
+      parseFilters(filter_chain->getObjectArray("filters"), filter_chains_.back());
+    }
+
+    filter_chain_table_.reset(new FilterChainTable(matches));
+    no_filter_chain_match_ = &scope_->counter("no_filter_chain_match");
+  }
+}
+
+void MainImpl::ListenerConfig::parseFilters(const std::vector<Json::ObjectSharedPtr>& filters,
+                                            std::list<NetworkFilterFactoryCb>& filter_factories) {
   for (size_t i = 0; i < filters.size(); i++) {
     std::string string_type = filters[i]->getString("type");
     std::string string_name = filters[i]->getString("name");
@@ -183,7 +296,7 @@ MainImpl::ListenerConfig::ListenerConfig(MainImpl& parent, Json::Object& json) :
     if (search_it != namedFilterConfigFactories().end()) {
       NetworkFilterFactoryCb callback =
           search_it->second->createFilterFactory(type, *config, parent_.server_);
-      filter_factories_.push_back(callback);
+      filter_factories.push_back(callback);
     } else {
       // DEPRECATED
       // This name wasn't found in the named map, so search in the deprecated list registry.
@@ -192,7 +305,7 @@ MainImpl::ListenerConfig::ListenerConfig(MainImpl& parent, Json::Object& json) :
         NetworkFilterFactoryCb callback =
             config_factory->tryCreateFilterFactory(type, string_name, *config, parent_.server_);
         if (callback) {
-          filter_factories_.push_back(callback);
+          filter_factories.push_back(callback);
           found_filter = true;
           break;
         }
@@ -207,7 +320,19 @@ MainImpl::ListenerConfig::ListenerConfig(MainImpl& parent, Json::Object& json) :
 }
 
 bool MainImpl::ListenerConfig::createFilterChain(Network::Connection& connection) {
-  return FilterChainUtility::buildFilterChain(connection, filter_factories_);
+  if (!filter_chain_table_) {
+    return FilterChainUtility::buildFilterChain(connection, filter_chains_[0]);
+  }
+
+  const Optional<size_t> filter_chain =
+      filter_chain_table_->find(connection.localAddress(), connection.requestedServerName(),
+                                connection.requestedApplicationProtocols());
+  if (!filter_chain.valid()) {
+    no_filter_chain_match_->inc();
+    return false;
+  }
+
+  return FilterChainUtility::buildFilterChain(connection, filter_chains_[filter_chain.value()]);
 }
 
 InitialImpl::InitialImpl(const Json::Object& json) {
@@ -215,6 +340,8 @@ InitialImpl::InitialImpl(const Json::Object& json) {
   Json::ObjectSharedPtr admin = json.getObject("admin");
   admin_.access_log_path_ = admin->getString("access_log_path");
   admin_.profile_path_ = admin->getString("profile_path", "/var/log/envoy/envoy.prof");
+  admin_.profile_frequency_hz_ = admin->getInteger("profile_frequency_hz", 0);
+  admin_.profile_window_ = std::chrono::milliseconds(admin->getInteger("profile_window_ms", 60000));
   admin_.address_ = Network::Utility::resolveUrl(admin->getString("address"));
 
   if (json.hasObject("flags_path")) {
@@ -228,6 +355,24 @@ InitialImpl::InitialImpl(const Json::Object& json) {
     runtime_->override_subdirectory_ =
         json.getObject("runtime")->getString("override_subdirectory", "");
   }
+
+  if (json.hasObject("stats_tags")) {
+    for (const Json::ObjectSharedPtr& tag : json.getObjectArray("stats_tags")) {
+      stats_tags_.emplace_back(tag->getString("tag_name"), tag->getString("regex"));
+    }
+  }
+  use_all_default_tags_ = json.getBoolean("use_all_default_tags", true);
+}
+
+Stats::TagProducerPtr InitialImpl::createTagProducer() {
+  std::vector<Stats::TagExtractorImpl> extractors;
+  if (use_all_default_tags_) {
+    extractors = Stats::TagProducerImpl::defaultTagExtractors();
+  }
+  for (const auto& tag : stats_tags_) {
+    extractors.emplace_back(tag.first, tag.second);
+  }
+  return Stats::TagProducerPtr{new Stats::TagProducerImpl(std::move(extractors))};
 }
 
 } // Configuration
@@ -8,6 +8,7 @@
 #include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "envoy/http/filter.h"
 #include "envoy/network/filter.h"
@@ -19,6 +20,8 @@
 #include "common/json/json_loader.h"
 #include "common/network/utility.h"
 
+#include "server/filter_chain_table.h"
+
 namespace Envoy {
 namespace Server {
 namespace Configuration {
@@ -164,6 +167,17 @@ public:
     }
   }
 
+  /**
+   * Validate the clusters and listeners of a config against their schemas, spread across a pool of
+   * threads. They are the bulk of large configs and are independent of each other, while building
+   * them has to happen on the main thread. Validated objects remember that they conform, so
+   * initialize() does not validate them again.
+   * @param config supplies the config.
+   * @param concurrency supplies the number of threads.
+   * throws Json::Exception for the first object, in config order, that does not conform.
+   */
+  static void validateSchemas(const Json::Object& config, uint32_t concurrency);
+
   /**
    * Initialize the configuration. This happens here vs. the constructor because the initialization
    * will call through the server to get the cluster manager so the server variable must be
@@ -180,6 +194,7 @@ public:
   // TODO(hennna): DEPRECATED - statsdUdpPort() will be removed in 1.4.0
   Optional<uint32_t> statsdUdpPort() override { return statsd_udp_port_; }
   Optional<std::string> statsdUdpIpAddress() override { return statsd_udp_ip_address_; }
+  uint32_t statsdUdpMaxDatagramSize() override { return statsd_udp_max_datagram_size_; }
   std::chrono::milliseconds statsFlushInterval() override { return stats_flush_interval_; }
   std::chrono::milliseconds wdMissTimeout() const override { return watchdog_miss_timeout_; }
   std::chrono::milliseconds wdMegaMissTimeout() const override {
@@ -189,6 +204,7 @@ public:
   std::chrono::milliseconds wdMultiKillTimeout() const override {
     return watchdog_multikill_timeout_;
   }
+  uint32_t wdStallSamples() const override { return watchdog_stall_samples_; }
 
 private:
   /**
@@ -208,25 +224,47 @@ private:
     Network::FilterChainFactory& filterChainFactory() override { return *this; }
     Network::Address::InstanceConstSharedPtr address() override { return address_; }
     bool bindToPort() override { return bind_to_port_; }
+    bool reusePort() override { return reuse_port_; }
+    bool reusePortCpuSteering() override { return reuse_port_cpu_steering_; }
+    Network::ConnectionBalancer* connectionBalancer() override {
+      return connection_balancer_.get();
+    }
     Ssl::ServerContext* sslContext() override { return ssl_context_.get(); }
     bool useProxyProto() override { return use_proxy_proto_; }
     bool useOriginalDst() override { return use_original_dst_; }
     uint32_t perConnectionBufferLimitBytes() override { return per_connection_buffer_limit_bytes_; }
+    bool inspectTlsClientHello() override {
+      return filter_chain_table_ && filter_chain_table_->needsClientHello();
+    }
+    const Network::SocketOptionsConstSharedPtr& socketOptions() override {
+      return socket_options_;
+    }
     Stats::Scope& scope() override { return *scope_; }
 
     // Network::FilterChainFactory
     bool createFilterChain(Network::Connection& connection) override;
 
   private:
+    void parseFilters(const std::vector<Json::ObjectSharedPtr>& filters,
+                      std::list<NetworkFilterFactoryCb>& filter_factories);
+
     MainImpl& parent_;
     Network::Address::InstanceConstSharedPtr address_;
     bool bind_to_port_{};
+    bool reuse_port_{};
+    bool reuse_port_cpu_steering_{};
+    Network::ConnectionBalancerPtr connection_balancer_;
     Stats::ScopePtr scope_;
     Ssl::ServerContextPtr ssl_context_;
     bool use_proxy_proto_{};
     bool use_original_dst_{};
     uint32_t per_connection_buffer_limit_bytes_{};
-    std::list<NetworkFilterFactoryCb> filter_factories_;
+    Network::SocketOptionsConstSharedPtr socket_options_;
+    // Filter chains are identified by their index in filter_chain_table_. A listener configured
+    // with a single list of filters has one chain and no table.
+    std::vector<std::list<NetworkFilterFactoryCb>> filter_chains_;
+    std::unique_ptr<FilterChainTable> filter_chain_table_;
+    Stats::Counter* no_filter_chain_match_{};
   };
 
   /**
@@ -266,12 +304,14 @@ private:
   Optional<std::string> statsd_tcp_cluster_name_;
   Optional<uint32_t> statsd_udp_port_;
   Optional<std::string> statsd_udp_ip_address_;
+  uint32_t statsd_udp_max_datagram_size_;
   RateLimit::ClientFactoryPtr ratelimit_client_factory_;
   std::chrono::milliseconds stats_flush_interval_;
   std::chrono::milliseconds watchdog_miss_timeout_;
   std::chrono::milliseconds watchdog_megamiss_timeout_;
   std::chrono::milliseconds watchdog_kill_timeout_;
   std::chrono::milliseconds watchdog_multikill_timeout_;
+  uint32_t watchdog_stall_samples_;
 };
 
 /**
@@ -332,16 +372,21 @@ public:
   Admin& admin() override { return admin_; }
   Optional<std::string> flagsPath() override { return flags_path_; }
   Runtime* runtime() override { return runtime_.get(); }
+  Stats::TagProducerPtr createTagProducer() override;
 
 private:
   struct AdminImpl : public Admin {
     // Server::Configuration::Initial::Admin
     const std::string& accessLogPath() override { return access_log_path_; }
     const std::string& profilePath() override { return profile_path_; }
+    uint32_t profileFrequencyHz() override { return profile_frequency_hz_; }
+    std::chrono::milliseconds profileWindow() override { return profile_window_; }
     Network::Address::InstanceConstSharedPtr address() override { return address_; }
 
     std::string access_log_path_;
     std::string profile_path_;
+    uint32_t profile_frequency_hz_;
+    std::chrono::milliseconds profile_window_;
     Network::Address::InstanceConstSharedPtr address_;
   };
 
@@ -359,6 +404,9 @@ private:
   AdminImpl admin_;
   Optional<std::string> flags_path_;
   std::unique_ptr<RuntimeImpl> runtime_;
+  // Pairs of tag name and regex.
+  std::vector<std::pair<std::string, std::string>> stats_tags_;
+  bool use_all_default_tags_;
 };
 
 } // Configuration
@@ -1,5 +1,8 @@
 #include "server/connection_handler_impl.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "envoy/event/dispatcher.h"
 #include "envoy/event/timer.h"
 #include "envoy/network/filter.h"
@@ -12,8 +15,25 @@
 namespace Envoy {
 namespace Server {
 
-ConnectionHandlerImpl::ConnectionHandlerImpl(spdlog::logger& logger, Api::ApiPtr&& api)
-    : logger_(logger), api_(std::move(api)), dispatcher_(api_->allocateDispatcher()) {}
+namespace {
+// Each round of the ResetLargestConnections action resets connections until they hold at least
+// 1/ResetDivisor of the handler's buffered data.
+const uint64_t ResetDivisor = 10;
+} // namespace
+
+ConnectionHandlerImpl::ConnectionHandlerImpl(spdlog::logger& logger, Api::ApiPtr&& api,
+                                             OverloadManager* overload_manager)
+    : logger_(logger), api_(std::move(api)), dispatcher_(api_->allocateDispatcher()) {
+  if (overload_manager) {
+    stop_accepting_connections_ =
+        &overload_manager->getActionState(OverloadActionName::StopAcceptingConnections);
+    reduce_buffer_limits_ =
+        &overload_manager->getActionState(OverloadActionName::ReduceBufferLimits);
+    reduced_buffer_limit_bytes_ = overload_manager->reducedBufferLimitBytes();
+    overload_manager->registerForAction(OverloadActionName::ResetLargestConnections, *dispatcher_,
+                                        [this]() -> void { resetLargestConnections(); });
+  }
+}
 
 ConnectionHandlerImpl::~ConnectionHandlerImpl() { closeConnections(); }
 
@@ -54,6 +74,34 @@ void ConnectionHandlerImpl::removeConnection(ActiveConnection& connection) {
   num_connections_--;
 }
 
+void ConnectionHandlerImpl::resetLargestConnections() {
+  std::vector<ActiveConnection*> largest;
+  largest.reserve(connections_.size());
+  for (const ActiveConnectionPtr& connection : connections_) {
+    largest.push_back(connection.get());
+  }
+  std::sort(largest.begin(), largest.end(), [](ActiveConnection* a, ActiveConnection* b) {
+    return a->buffer_account_->balance() > b->buffer_account_->balance();
+  });
+
+  // Closed connections are only destroyed once they have been removed from the list, so the
+  // pointers stay valid while closing.
+  const uint64_t target_bytes = std::max<uint64_t>(bufferedBytes() / ResetDivisor, 1);
+  uint64_t reset_bytes = 0;
+  for (ActiveConnection* connection : largest) {
+    const uint64_t balance = connection->buffer_account_->balance();
+    if (reset_bytes >= target_bytes || balance == 0) {
+      break;
+    }
+
+    conn_log(logger_, debug, "resetting connection: server overloaded with {} bytes buffered",
+             *connection->connection_, balance);
+    connection->stats_.downstream_cx_overload_reset_.inc();
+    connection->connection_->close(Network::ConnectionCloseType::NoFlush);
+    reset_bytes += balance;
+  }
+}
+
 ConnectionHandlerImpl::ActiveListener::ActiveListener(
     ConnectionHandlerImpl& parent, Network::ListenSocket& socket,
     Network::FilterChainFactory& factory, Stats::Scope& scope,
@@ -66,7 +114,7 @@ ConnectionHandlerImpl::ActiveListener::ActiveListener(ConnectionHandlerImpl& par
                                                       Network::ListenerPtr&& listener,
                                                       Network::FilterChainFactory& factory,
                                                       Stats::Scope& scope)
-    : parent_(parent), factory_(factory), stats_(generateStats(scope)) {
+    : parent_(parent), factory_(factory), scope_(scope), stats_(generateStats(scope)) {
   listener_ = std::move(listener);
 }
 
@@ -107,6 +155,21 @@ ConnectionHandlerImpl::findListenerByAddress(const Network::Address::Instance& a
 void ConnectionHandlerImpl::ActiveListener::onNewConnection(
     Network::ConnectionPtr&& new_connection) {
   conn_log(parent_.logger_, info, "new connection", *new_connection);
+  if (parent_.stop_accepting_connections_ && parent_.stop_accepting_connections_->isActive()) {
+    conn_log(parent_.logger_, debug, "closing connection: server overloaded", *new_connection);
+    stats_.downstream_cx_overload_reject_.inc();
+    new_connection->close(Network::ConnectionCloseType::NoFlush);
+    return;
+  }
+
+  if (parent_.reduce_buffer_limits_ && parent_.reduce_buffer_limits_->isActive()) {
+    // A limit of zero means unlimited.
+    const uint32_t limit = new_connection->readBufferLimit();
+    if (limit == 0 || limit > parent_.reduced_buffer_limit_bytes_) {
+      new_connection->setReadBufferLimit(parent_.reduced_buffer_limit_bytes_);
+    }
+  }
+
   bool empty_filter_chain = !factory_.createFilterChain(*new_connection);
 
   // If the connection is already closed, we can just let this connection immediately die.
@@ -118,7 +181,7 @@ void ConnectionHandlerImpl::ActiveListener::onNewConnection(
       new_connection->close(Network::ConnectionCloseType::NoFlush);
     } else {
       ActiveConnectionPtr active_connection(
-          new ActiveConnection(parent_, std::move(new_connection), stats_));
+          new ActiveConnection(parent_, std::move(new_connection), scope_, stats_));
       active_connection->moveIntoList(std::move(active_connection), parent_.connections_);
       parent_.num_connections_++;
     }
@@ -127,9 +190,12 @@ void ConnectionHandlerImpl::ActiveListener::onNewConnection(
 
 ConnectionHandlerImpl::ActiveConnection::ActiveConnection(ConnectionHandlerImpl& parent,
                                                           Network::ConnectionPtr&& new_connection,
-                                                          ListenerStats& stats)
-    : parent_(parent), connection_(std::move(new_connection)), stats_(stats),
-      conn_length_(stats_.downstream_cx_length_ms_.allocateSpan()) {
+                                                          Stats::Scope& scope, ListenerStats& stats)
+    : parent_(parent), connection_(std::move(new_connection)), scope_(scope), stats_(stats),
+      conn_length_(stats_.downstream_cx_length_ms_.allocateSpan(
+          parent_.dispatcher_->loopTimeSource())),
+      buffer_account_(new Buffer::MemoryAccountImpl(parent_.buffer_account_)) {
+  connection_->setBufferAccount(buffer_account_);
   // We just universally set no delay on connections. Theoretically we might at some point want
   // to make this configurable.
   connection_->noDelay(true);
@@ -142,6 +208,8 @@ ConnectionHandlerImpl::ActiveConnection::~ActiveConnection() {
   stats_.downstream_cx_active_.dec();
   stats_.downstream_cx_destroy_.inc();
   conn_length_->complete();
+  scope_.deliverHistogramToSinks("downstream_cx_buffered_bytes_peak",
+                                 buffer_account_->peakBalance());
 }
 
 ListenerStats ConnectionHandlerImpl::generateStats(Stats::Scope& scope) {
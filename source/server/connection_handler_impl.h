@@ -13,7 +13,9 @@
 #include "envoy/network/filter.h"
 #include "envoy/network/listen_socket.h"
 #include "envoy/network/listener.h"
+#include "envoy/server/overload_manager.h"
 
+#include "common/buffer/buffer_impl.h"
 #include "common/common/linked_object.h"
 #include "common/common/non_copyable.h"
 #include "common/network/listen_socket_impl.h"
@@ -25,6 +27,8 @@ namespace Envoy {
 #define ALL_LISTENER_STATS(COUNTER, GAUGE, TIMER)                                                  \
   COUNTER(downstream_cx_total)                                                                     \
   COUNTER(downstream_cx_destroy)                                                                   \
+  COUNTER(downstream_cx_overload_reject)                                                           \
+  COUNTER(downstream_cx_overload_reset)                                                            \
   GAUGE  (downstream_cx_active)                                                                    \
   TIMER  (downstream_cx_length_ms)
 // clang-format on
@@ -44,7 +48,12 @@ struct ListenerStats {
  */
 class ConnectionHandlerImpl : public Network::ConnectionHandler, NonCopyable {
 public:
-  ConnectionHandlerImpl(spdlog::logger& logger, Api::ApiPtr&& api);
+  /**
+   * @param overload_manager supplies the overload manager whose actions apply to new connections,
+   *        or nullptr if the connections of this handler are not subject to overload actions.
+   */
+  ConnectionHandlerImpl(spdlog::logger& logger, Api::ApiPtr&& api,
+                        OverloadManager* overload_manager);
   ~ConnectionHandlerImpl();
 
   Api::Api& api() { return *api_; }
@@ -55,6 +64,12 @@ public:
    */
   void closeConnections();
 
+  /**
+   * @return uint64_t the bytes held in the buffers of the handler's connections. May be called from
+   *         any thread.
+   */
+  uint64_t bufferedBytes() const { return buffer_account_->balance(); }
+
   // Network::ConnectionHandler
   uint64_t numConnections() override { return num_connections_; }
 
@@ -90,6 +105,7 @@ private:
     ConnectionHandlerImpl& parent_;
     Network::FilterChainFactory& factory_;
     Network::ListenerPtr listener_;
+    Stats::Scope& scope_;
     ListenerStats stats_;
   };
 
@@ -108,7 +124,7 @@ private:
                             public Event::DeferredDeletable,
                             public Network::ConnectionCallbacks {
     ActiveConnection(ConnectionHandlerImpl& parent, Network::ConnectionPtr&& new_connection,
-                     ListenerStats& stats);
+                     Stats::Scope& scope, ListenerStats& stats);
     ~ActiveConnection();
 
     // Network::ConnectionCallbacks
@@ -119,11 +135,15 @@ private:
         parent_.removeConnection(*this);
       }
     }
+    void onAboveWriteBufferHighWatermark() override {}
+    void onBelowWriteBufferLowWatermark() override {}
 
     ConnectionHandlerImpl& parent_;
     Network::ConnectionPtr connection_;
+    Stats::Scope& scope_;
     ListenerStats& stats_;
     Stats::TimespanPtr conn_length_;
+    Buffer::MemoryAccountImplSharedPtr buffer_account_;
   };
 
   typedef std::unique_ptr<ActiveConnection> ActiveConnectionPtr;
@@ -134,6 +154,13 @@ private:
    */
   void removeConnection(ActiveConnection& connection);
 
+  /**
+   * Reset the connections holding the most buffered data, largest first, until the reset
+   * connections hold a share of all of the handler's buffered data. Runs while the
+   * ResetLargestConnections overload action is active.
+   */
+  void resetLargestConnections();
+
   static ListenerStats generateStats(Stats::Scope& scope);
 
   spdlog::logger& logger_;
@@ -142,6 +169,11 @@ private:
   std::list<std::pair<Network::Address::InstanceConstSharedPtr, ActiveListenerPtr>> listeners_;
   std::list<ActiveConnectionPtr> connections_;
   std::atomic<uint64_t> num_connections_{};
+  const OverloadActionState* stop_accepting_connections_{};
+  const OverloadActionState* reduce_buffer_limits_{};
+  uint32_t reduced_buffer_limit_bytes_{};
+  // The buffers of all connections roll up into this account through their own accounts.
+  Buffer::MemoryAccountImplSharedPtr buffer_account_{new Buffer::MemoryAccountImpl()};
 };
 
 typedef std::unique_ptr<ConnectionHandlerImpl> ConnectionHandlerImplPtr;
@@ -1,5 +1,6 @@
 #include "server/drain_manager_impl.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 
@@ -13,7 +14,10 @@
 namespace Envoy {
 namespace Server {
 
-DrainManagerImpl::DrainManagerImpl(Instance& server) : server_(server) {}
+DrainManagerImpl::DrainManagerImpl(Instance& server, MonotonicTimeSource& time_source)
+    : server_(server), time_source_(time_source),
+      stats_{ALL_DRAIN_MANAGER_STATS(POOL_COUNTER_PREFIX(server.stats(), "server."),
+                                     POOL_GAUGE_PREFIX(server.stats(), "server."))} {}
 
 bool DrainManagerImpl::drainClose() {
   // If we are actively HC failed, always drain close.
@@ -21,27 +25,66 @@ bool DrainManagerImpl::drainClose() {
     return true;
   }
 
-  if (!draining()) {
+  // Keepalive is disabled under overload by closing connections once their response is done.
+  if (server_.overloadManager()
+          .getActionState(OverloadActionName::DisableHttpKeepAlive)
+          .isActive()) {
+    return true;
+  }
+
+  if (!draining_) {
     return false;
   }
 
-  // We use the tick time as in increasing chance that we shutdown connections.
-  return static_cast<uint64_t>(drain_time_completed_.count()) >
-         (server_.random().random() % server_.options().drainTime().count());
+  // Once the drain time is over every connection is drain closed.
+  const std::chrono::milliseconds drain_time = server_.options().drainTime();
+  const std::chrono::milliseconds elapsed =
+      std::chrono::duration_cast<std::chrono::milliseconds>(time_source_.currentTime() -
+                                                            drain_start_);
+  if (elapsed >= drain_time) {
+    stats_.drain_closed_.inc();
+    return true;
+  }
+
+  // Until then, drain closes are allowed at an even pace, so that the connections that were open
+  // when draining started are all closed by the end of the drain time. Allowance that goes unused,
+  // because not enough connections saw activity, only carries over for a second, so that it does
+  // not turn into a burst of closes later.
+  const uint64_t allowance = drain_target_ * elapsed.count() / drain_time.count();
+  const uint64_t burst = std::max<uint64_t>(1, drain_target_ * 1000 / drain_time.count());
+  const uint64_t floor = allowance > burst ? allowance - burst : 0;
+  uint64_t used = drain_allowance_used_.load();
+  do {
+    if (used < floor) {
+      used = floor;
+    }
+    if (used >= allowance) {
+      return false;
+    }
+  } while (!drain_allowance_used_.compare_exchange_weak(used, used + 1));
+
+  stats_.drain_closed_.inc();
+  return true;
 }
 
 void DrainManagerImpl::drainSequenceTick() {
-  log_trace("drain tick #{}", drain_time_completed_.count());
-  ASSERT(drain_time_completed_ < server_.options().drainTime());
-  drain_time_completed_ += std::chrono::seconds(1);
+  const std::chrono::seconds elapsed =
+      std::chrono::duration_cast<std::chrono::seconds>(time_source_.currentTime() - drain_start_);
+  log_trace("drain tick #{}", elapsed.count());
+  stats_.drain_remaining_.set(server_.numConnections());
 
-  if (drain_time_completed_ < server_.options().drainTime()) {
+  if (elapsed < server_.options().drainTime()) {
     drain_tick_timer_->enableTimer(std::chrono::milliseconds(1000));
   }
 }
 
 void DrainManagerImpl::startDrainSequence() {
   ASSERT(!drain_tick_timer_);
+  drain_start_ = time_source_.currentTime();
+  drain_target_ = server_.numConnections();
+  stats_.drain_target_.set(drain_target_);
+  draining_ = true;
+
   drain_tick_timer_ = server_.dispatcher().createTimer([this]() -> void { drainSequenceTick(); });
   drainSequenceTick();
 }
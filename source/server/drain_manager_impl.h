@@ -1,27 +1,49 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 
+#include "envoy/common/time.h"
 #include "envoy/server/drain_manager.h"
 #include "envoy/server/instance.h"
+#include "envoy/stats/stats_macros.h"
 
 #include "common/common/logger.h"
 
 namespace Envoy {
 namespace Server {
 
+/**
+ * All drain manager stats. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_DRAIN_MANAGER_STATS(COUNTER, GAUGE)                                                    \
+  COUNTER(drain_closed)                                                                            \
+  GAUGE  (drain_target)                                                                            \
+  GAUGE  (drain_remaining)
+// clang-format on
+
+/**
+ * Struct definition for all drain manager stats. @see stats_macros.h
+ */
+struct DrainManagerStats {
+  ALL_DRAIN_MANAGER_STATS(GENERATE_COUNTER_STRUCT, GENERATE_GAUGE_STRUCT)
+};
+
 /**
  * Implementation of drain manager that does the following by default:
  * 1) Terminates the parent process after 15 minutes.
- * 2) Drains the parent process over a period of 10 minutes where drain close becomes more
- *    likely each second that passes.
+ * 2) Drains the parent process over a period of 10 minutes. The connections that are open when
+ *    draining starts are drain closed at an even pace over the drain time, so that clients do not
+ *    all reconnect at once.
  */
 class DrainManagerImpl : Logger::Loggable<Logger::Id::main>, public DrainManager {
 public:
-  DrainManagerImpl(Instance& server);
+  DrainManagerImpl(Instance& server, MonotonicTimeSource& time_source);
 
   // Server::DrainManager
-  bool draining() override { return drain_tick_timer_ != nullptr; }
+  bool draining() override { return draining_; }
   bool drainClose() override;
   void startDrainSequence() override;
   void startParentShutdownSequence() override;
@@ -30,8 +52,16 @@ private:
   void drainSequenceTick();
 
   Instance& server_;
+  MonotonicTimeSource& time_source_;
+  DrainManagerStats stats_;
   Event::TimerPtr drain_tick_timer_;
-  std::chrono::seconds drain_time_completed_{};
+  // Written on the main thread before draining_ is set, and only read by workers after.
+  MonotonicTime drain_start_;
+  uint64_t drain_target_{};
+  std::atomic<bool> draining_{};
+  // The number of drain closes allowed so far. Workers take drain closes from the allowance of
+  // the time elapsed since draining started.
+  std::atomic<uint64_t> drain_allowance_used_{};
   Event::TimerPtr parent_shutdown_timer_;
 };
 
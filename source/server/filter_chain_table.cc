@@ -0,0 +1,190 @@
+#include "server/filter_chain_table.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "envoy/common/exception.h"
+
+#include "common/network/cidr_range.h"
+
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+namespace Server {
+
+namespace {
+
+const std::string ANY_IPV4_RANGE = "0.0.0.0/0";
+const std::string ANY_IPV6_RANGE = "::/0";
+
+} // namespace
+
+FilterChainTable::FilterChainTable(const std::vector<FilterChainMatch>& matches) {
+  for (size_t i = 0; i < matches.size(); i++) {
+    const FilterChainMatch& match = matches[i];
+    add(i, match, match.destination_port_ == 0 ? any_port_ : ports_[match.destination_port_]);
+    needs_client_hello_ |= !match.server_names_.empty() || !match.application_protocols_.empty();
+  }
+
+  buildTrie(any_port_);
+  for (auto& port : ports_) {
+    buildTrie(port.second);
+  }
+}
+
+void FilterChainTable::add(size_t index, const FilterChainMatch& match,
+                           DestinationIpTable& table) {
+  std::vector<std::string> ranges = match.destination_ip_ranges_;
+  if (ranges.empty()) {
+    ranges = {ANY_IPV4_RANGE, ANY_IPV6_RANGE};
+  }
+
+  for (const std::string& entry : ranges) {
+    const Network::Address::CidrRange range = Network::Address::CidrRange::create(entry);
+    if (!range.isValid()) {
+      throw EnvoyException(fmt::format("invalid destination ip range '{}' in filter chain", entry));
+    }
+
+    auto& destination = table.ranges_[range.asString()];
+    destination.first = range.length();
+    if (match.server_names_.empty()) {
+      addApplicationProtocols(index, match, destination.second.any_);
+    } else {
+      for (const std::string& server_name : match.server_names_) {
+        addServerName(index, match, server_name, destination.second);
+      }
+    }
+  }
+}
+
+void FilterChainTable::addServerName(size_t index, const FilterChainMatch& match,
+                                     const std::string& server_name, ServerNameTable& table) {
+  std::string name = server_name;
+  std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+  if (name.find('*') == std::string::npos) {
+    addApplicationProtocols(index, match, table.exact_[name]);
+  } else if (name.size() > 2 && name.compare(0, 2, "*.") == 0 &&
+             name.find('*', 1) == std::string::npos) {
+    addApplicationProtocols(index, match, table.wildcard_[name.substr(1)]);
+  } else {
+    throw EnvoyException(fmt::format(
+        "invalid server name '{}' in filter chain: only a leading '*.' wildcard is supported",
+        server_name));
+  }
+}
+
+void FilterChainTable::addApplicationProtocols(size_t index, const FilterChainMatch& match,
+                                               ApplicationProtocolTable& table) {
+  if (match.application_protocols_.empty()) {
+    if (table.any_.valid()) {
+      throw EnvoyException("multiple filter chains with the same filter_chain_match");
+    }
+    table.any_.value(index);
+    return;
+  }
+
+  for (const std::string& protocol : match.application_protocols_) {
+    if (!table.protocols_.emplace(protocol, index).second) {
+      throw EnvoyException("multiple filter chains with the same filter_chain_match");
+    }
+  }
+}
+
+void FilterChainTable::buildTrie(DestinationIpTable& table) {
+  std::vector<Network::LcTrie::Prefix> prefixes;
+  for (const auto& destination : table.ranges_) {
+    const Network::Address::CidrRange range =
+        Network::Address::CidrRange::create(destination.first);
+    if (range.version() == Network::Address::IpVersion::v4) {
+      prefixes.emplace_back(destination.first, range.ipv4()->address(), range.length());
+    } else {
+      prefixes.emplace_back(destination.first, range.ipv6()->address(), range.length());
+    }
+  }
+  table.trie_.reset(new Network::LcTrie(prefixes));
+}
+
+Optional<size_t>
+FilterChainTable::find(const Network::Address::Instance& local_address,
+                       const std::string& server_name,
+                       const std::vector<std::string>& application_protocols) const {
+  const DestinationIpTable* table = &any_port_;
+  if (local_address.type() == Network::Address::Type::Ip) {
+    auto port = ports_.find(local_address.ip()->port());
+    if (port != ports_.end()) {
+      table = &port->second;
+    }
+  }
+
+  const ServerNameTable* server_names = findDestinationIp(local_address, *table);
+  if (server_names == nullptr) {
+    return Optional<size_t>();
+  }
+
+  return findApplicationProtocol(application_protocols,
+                                 findServerName(server_name, *server_names));
+}
+
+const FilterChainTable::ServerNameTable*
+FilterChainTable::findDestinationIp(const Network::Address::Instance& local_address,
+                                    const DestinationIpTable& table) {
+  if (local_address.type() != Network::Address::Type::Ip) {
+    // Only chains that do not match on the destination IP apply to pipes.
+    auto destination = table.ranges_.find(ANY_IPV4_RANGE);
+    return destination == table.ranges_.end() ? nullptr : &destination->second.second;
+  }
+
+  const ServerNameTable* longest = nullptr;
+  int longest_length = -1;
+  for (const std::string& tag : table.trie_->getTags(local_address)) {
+    const auto& destination = table.ranges_.at(tag);
+    if (destination.first > longest_length) {
+      longest_length = destination.first;
+      longest = &destination.second;
+    }
+  }
+  return longest;
+}
+
+const FilterChainTable::ApplicationProtocolTable&
+FilterChainTable::findServerName(const std::string& server_name, const ServerNameTable& table) {
+  if (!server_name.empty()) {
+    auto exact = table.exact_.find(server_name);
+    if (exact != table.exact_.end()) {
+      return exact->second;
+    }
+
+    if (!table.wildcard_.empty()) {
+      // Try the suffixes from the longest to the shortest, so that "*.b.example.com" wins over
+      // "*.example.com" for "a.b.example.com".
+      for (size_t dot = server_name.find('.'); dot != std::string::npos;
+           dot = server_name.find('.', dot + 1)) {
+        auto wildcard = table.wildcard_.find(server_name.substr(dot));
+        if (wildcard != table.wildcard_.end()) {
+          return wildcard->second;
+        }
+      }
+    }
+  }
+
+  return table.any_;
+}
+
+Optional<size_t>
+FilterChainTable::findApplicationProtocol(const std::vector<std::string>& application_protocols,
+                                          const ApplicationProtocolTable& table) {
+  if (!table.protocols_.empty()) {
+    for (const std::string& protocol : application_protocols) {
+      auto match = table.protocols_.find(protocol);
+      if (match != table.protocols_.end()) {
+        return match->second;
+      }
+    }
+  }
+
+  return table.any_;
+}
+
+} // Server
+} // Envoy
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "envoy/common/optional.h"
+#include "envoy/network/address.h"
+
+#include "common/network/lc_trie.h"
+
+namespace Envoy {
+namespace Server {
+
+/**
+ * Precompiled lookup table that selects one of a listener's filter chains for a new connection.
+ * Chains are matched level by level, from the destination port, to the destination IP, to the
+ * requested server name, to the requested application protocols. At each level the most specific
+ * criterion that matches the connection wins, and chains that leave a level unset match any
+ * connection at that level but are only used if no more specific chain matches:
+ * - Destination port: an exact port, then chains without a port.
+ * - Destination IP: the longest prefix containing the local address. Chains without ranges act
+ *   as 0.0.0.0/0 and ::/0.
+ * - Server name: an exact name, then the longest wildcard ("*.example.com") suffix, then chains
+ *   without server names.
+ * - Application protocol: the first of the client's protocols, in its order of preference, that
+ *   a chain lists, then chains without application protocols.
+ * The choice at one level is final, so a connection that matches a level but none of the chains
+ * below it matches no chain.
+ */
+class FilterChainTable {
+public:
+  struct FilterChainMatch {
+    std::vector<std::string> destination_ip_ranges_;
+    // 0 matches any port.
+    uint32_t destination_port_{};
+    std::vector<std::string> server_names_;
+    std::vector<std::string> application_protocols_;
+  };
+
+  /**
+   * @param matches supplies the match criteria of each filter chain. The chains are identified by
+   *        their index.
+   * @throw EnvoyException if a range or server name is invalid, or two chains match the same
+   *        connections.
+   */
+  FilterChainTable(const std::vector<FilterChainMatch>& matches);
+
+  /**
+   * Find the filter chain for a connection.
+   * @param local_address supplies the local (destination) address of the connection.
+   * @param server_name supplies the server name requested in the TLS ClientHello, or empty.
+   * @param application_protocols supplies the application protocols offered in the TLS
+   *        ClientHello.
+   * @return the index of the matching chain, if any.
+   */
+  Optional<size_t> find(const Network::Address::Instance& local_address,
+                        const std::string& server_name,
+                        const std::vector<std::string>& application_protocols) const;
+
+  /**
+   * @return whether any chain matches on the TLS ClientHello, so that it has to be inspected
+   *         before a connection can be matched.
+   */
+  bool needsClientHello() const { return needs_client_hello_; }
+
+private:
+  struct ApplicationProtocolTable {
+    std::unordered_map<std::string, size_t> protocols_;
+    Optional<size_t> any_;
+  };
+
+  struct ServerNameTable {
+    std::unordered_map<std::string, ApplicationProtocolTable> exact_;
+    // Keyed by the suffix of the wildcard, including the leading dot.
+    std::unordered_map<std::string, ApplicationProtocolTable> wildcard_;
+    ApplicationProtocolTable any_;
+  };
+
+  struct DestinationIpTable {
+    // The trie tags each range with its key in ranges_.
+    std::unique_ptr<Network::LcTrie> trie_;
+    std::unordered_map<std::string, std::pair<int, ServerNameTable>> ranges_;
+  };
+
+  static void add(size_t index, const FilterChainMatch& match, DestinationIpTable& table);
+  static void addServerName(size_t index, const FilterChainMatch& match,
+                            const std::string& server_name, ServerNameTable& table);
+  static void addApplicationProtocols(size_t index, const FilterChainMatch& match,
+                                      ApplicationProtocolTable& table);
+  static void buildTrie(DestinationIpTable& table);
+  static const ServerNameTable* findDestinationIp(const Network::Address::Instance& local_address,
+                                                  const DestinationIpTable& table);
+  static const ApplicationProtocolTable& findServerName(const std::string& server_name,
+                                                        const ServerNameTable& table);
+  static Optional<size_t>
+  findApplicationProtocol(const std::vector<std::string>& application_protocols,
+                          const ApplicationProtocolTable& table);
+
+  std::unordered_map<uint32_t, DestinationIpTable> ports_;
+  DestinationIpTable any_port_;
+  bool needs_client_hello_{};
+};
+
+} // Server
+} // Envoy
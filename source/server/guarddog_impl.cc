@@ -2,8 +2,11 @@
 
 #include <chrono>
 #include <mutex>
+#include <string>
+#include <thread>
 
 #include "common/common/assert.h"
+#include "common/common/utility.h"
 
 #include "server/watchdog_impl.h"
 
@@ -12,6 +15,13 @@
 namespace Envoy {
 namespace Server {
 
+namespace {
+// How long a stalled thread has to run the sampling signal handler, and the interval between the
+// samples of a burst.
+const std::chrono::milliseconds StallSampleTimeout(100);
+const std::chrono::milliseconds StallSampleInterval(10);
+} // namespace
+
 GuardDogImpl::GuardDogImpl(Stats::Scope& stats_scope, const Server::Configuration::Main& config,
                            MonotonicTimeSource& tsource)
     : time_source_(tsource), miss_timeout_(config.wdMissTimeout()),
@@ -28,7 +38,13 @@ GuardDogImpl::GuardDogImpl(Stats::Scope& stats_scope, const Server::Configuratio
       }()),
       watchdog_miss_counter_(stats_scope.counter("server.watchdog_miss")),
       watchdog_megamiss_counter_(stats_scope.counter("server.watchdog_mega_miss")),
+      stall_samples_(std::min(config.wdStallSamples(), static_cast<uint32_t>(MaxStallSamples))),
       run_thread_(true) {
+  if (stall_samples_ > 0) {
+    stack_sampler_.reset(new StackSampler());
+    pending_stall_.reset(new StallRecord());
+    stalls_.resize(MaxStalls);
+  }
   start();
 }
 
@@ -38,11 +54,18 @@ void GuardDogImpl::threadRoutine() {
   do {
     const auto now = time_source_.currentTime();
     bool seen_one_multi_timeout(false);
-    std::lock_guard<std::mutex> guard(wd_lock_);
-    for (const auto& watched_dog : watched_dogs_) {
-      const auto delta = now - watched_dog->lastTouchTime();
+    std::unique_lock<std::mutex> guard(wd_lock_);
+    stalled_dogs_.reserve(watched_dogs_.size());
+    for (auto& watched : watched_dogs_) {
+      const auto& watched_dog = watched.dog_;
+      const auto touch_time = watched_dog->lastTouchTime();
+      const auto delta = now - touch_time;
       if (delta > miss_timeout_) {
         watchdog_miss_counter_.inc();
+        if (stack_sampler_ && watched.sampled_touch_time_ != touch_time) {
+          watched.sampled_touch_time_ = touch_time;
+          stalled_dogs_.emplace_back(watched_dog, touch_time);
+        }
       }
       if (delta > megamiss_timeout_) {
         watchdog_megamiss_counter_.inc();
@@ -62,6 +85,12 @@ void GuardDogImpl::threadRoutine() {
         }
       }
     }
+    // Sample outside of wd_lock_, which the main thread takes to compute the event loop lag.
+    guard.unlock();
+    for (const auto& stalled : stalled_dogs_) {
+      sampleStall(*stalled.first, stalled.second);
+    }
+    stalled_dogs_.clear();
   } while (waitOrDetectStop());
 }
 
@@ -75,7 +104,7 @@ WatchDogSharedPtr GuardDogImpl::createWatchDog(int32_t thread_id) {
       std::make_shared<WatchDogImpl>(thread_id, time_source_, wd_interval);
   {
     std::lock_guard<std::mutex> guard(wd_lock_);
-    watched_dogs_.push_back(new_watchdog);
+    watched_dogs_.push_back({new_watchdog, MonotonicTime()});
   }
   new_watchdog->touch();
   return new_watchdog;
@@ -83,7 +112,8 @@ WatchDogSharedPtr GuardDogImpl::createWatchDog(int32_t thread_id) {
 
 void GuardDogImpl::stopWatching(WatchDogSharedPtr wd) {
   std::lock_guard<std::mutex> guard(wd_lock_);
-  auto found_wd = std::find(watched_dogs_.begin(), watched_dogs_.end(), wd);
+  auto found_wd = std::find_if(watched_dogs_.begin(), watched_dogs_.end(),
+                               [&wd](const WatchedDog& watched) { return watched.dog_ == wd; });
   if (found_wd != watched_dogs_.end()) {
     watched_dogs_.erase(found_wd);
   } else {
@@ -91,6 +121,78 @@ void GuardDogImpl::stopWatching(WatchDogSharedPtr wd) {
   }
 }
 
+std::chrono::milliseconds GuardDogImpl::eventLoopLag() {
+  // A healthy event loop touches its WatchDog every touch interval, so only the time beyond that
+  // counts as lag.
+  const auto now = time_source_.currentTime();
+  const auto touch_interval = loop_interval_ / 2;
+  std::chrono::milliseconds lag(0);
+  std::lock_guard<std::mutex> guard(wd_lock_);
+  for (const auto& watched : watched_dogs_) {
+    const auto delta = std::chrono::duration_cast<std::chrono::milliseconds>(
+        now - watched.dog_->lastTouchTime() - touch_interval);
+    lag = std::max(lag, delta);
+  }
+  return lag;
+}
+
+void GuardDogImpl::sampleStall(const WatchDog& dog, MonotonicTime touch_time) {
+  StallRecord& record = *pending_stall_;
+  record.time_ = std::chrono::system_clock::now();
+  record.thread_id_ = dog.threadId();
+  record.stalled_for_ = std::chrono::duration_cast<std::chrono::milliseconds>(
+      time_source_.currentTime() - touch_time);
+  record.num_samples_ = 0;
+  for (uint32_t i = 0; i < stall_samples_; i++) {
+    if (i > 0) {
+      std::this_thread::sleep_for(StallSampleInterval);
+      if (dog.lastTouchTime() != touch_time) {
+        // The thread made progress, the rest of the burst would not show the stall.
+        break;
+      }
+    }
+    if (stack_sampler_->capture(dog.threadId(), StallSampleTimeout,
+                                record.samples_[record.num_samples_])) {
+      record.num_samples_++;
+    }
+  }
+
+  std::lock_guard<std::mutex> guard(stalls_lock_);
+  stalls_[next_stall_] = record;
+  next_stall_ = (next_stall_ + 1) % MaxStalls;
+  num_stalls_ = std::min(num_stalls_ + 1, static_cast<size_t>(MaxStalls));
+}
+
+std::string GuardDogImpl::stallReport() {
+  if (!stack_sampler_) {
+    return "stall sampling is disabled, see watchdog_stall_samples\n";
+  }
+
+  // Copy the records out so that symbolizing does not hold up the guard dog thread.
+  std::vector<StallRecord> stalls;
+  {
+    std::lock_guard<std::mutex> guard(stalls_lock_);
+    for (size_t i = 1; i <= num_stalls_; i++) {
+      stalls.push_back(stalls_[(next_stall_ + MaxStalls - i) % MaxStalls]);
+    }
+  }
+
+  DateFormatter date_formatter("%Y-%m-%dT%H:%M:%SZ");
+  std::string report;
+  for (const StallRecord& stall : stalls) {
+    report += fmt::format("thread {} stalled for {}ms at {}, {} samples\n", stall.thread_id_,
+                          stall.stalled_for_.count(), date_formatter.fromTime(stall.time_),
+                          stall.num_samples_);
+    for (size_t i = 0; i < stall.num_samples_; i++) {
+      report += fmt::format("  sample {}:\n", i);
+      for (const std::string& frame : StackSampler::symbolize(stall.samples_[i])) {
+        report += fmt::format("    {}\n", frame);
+      }
+    }
+  }
+  return report;
+}
+
 bool GuardDogImpl::waitOrDetectStop() {
   force_checked_event_.notify_all();
   std::lock_guard<std::mutex> guard(exit_lock_);
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <array>
 #include <chrono>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
+#include <string>
 #include <vector>
 
 #include "envoy/server/configuration.h"
@@ -14,6 +17,8 @@
 #include "common/common/thread.h"
 #include "common/event/libevent.h"
 
+#include "server/stack_sampler.h"
+
 namespace Envoy {
 namespace Server {
 /**
@@ -23,6 +28,10 @@ namespace Server {
  * intervals.  If it finds starved threads or suspected deadlocks it will take
  * the appropriate action depending on the config parameters described below.
  *
+ * When stall sampling is enabled, a thread that goes without touching its WatchDog for longer than
+ * the miss timeout is interrupted and its stack sampled a few times, so the stalls can be diagnosed
+ * without attaching a debugger. The samples of the most recent stalls are kept for stallReport().
+ *
  * Thread lifetime is tied to GuardDog object lifetime (RAII style).
  */
 class GuardDogImpl : public GuardDog {
@@ -48,12 +57,38 @@ public:
     force_checked_event_.wait(exit_lock_);
   }
 
+  /**
+   * @return std::string a human readable report of the most recently sampled stalls, most recent
+   *         first, with their stack samples symbolized.
+   */
+  std::string stallReport();
+
   // Server::GuardDog
   WatchDogSharedPtr createWatchDog(int32_t thread_id) override;
   void stopWatching(WatchDogSharedPtr wd) override;
+  std::chrono::milliseconds eventLoopLag() override;
 
 private:
+  static const size_t MaxStalls = 16;
+  static const size_t MaxStallSamples = 20;
+
+  struct WatchedDog {
+    WatchDogSharedPtr dog_;
+    // The last touch time of the dog when its current stall was sampled, so that each stall is
+    // sampled only once.
+    MonotonicTime sampled_touch_time_;
+  };
+
+  struct StallRecord {
+    SystemTime time_;
+    int32_t thread_id_;
+    std::chrono::milliseconds stalled_for_;
+    std::array<StackSampler::Stack, MaxStallSamples> samples_;
+    size_t num_samples_;
+  };
+
   void threadRoutine();
+  void sampleStall(const WatchDog& dog, MonotonicTime touch_time);
   /**
    * @return True if we should continue, false if signalled to stop.
    */
@@ -73,8 +108,20 @@ private:
   const std::chrono::milliseconds loop_interval_;
   Stats::Counter& watchdog_miss_counter_;
   Stats::Counter& watchdog_megamiss_counter_;
-  std::vector<WatchDogSharedPtr> watched_dogs_;
+  std::vector<WatchedDog> watched_dogs_;
   std::mutex wd_lock_;
+  const uint32_t stall_samples_;
+  std::unique_ptr<StackSampler> stack_sampler_;
+  // Stalls found by the current scan, sampled once wd_lock_ is released. Only used by the guard dog
+  // thread.
+  std::vector<std::pair<WatchDogSharedPtr, MonotonicTime>> stalled_dogs_;
+  // Stall records are filled in here and then copied into the ring under stalls_lock_, so that
+  // stallReport() never waits for a sample to be taken.
+  std::unique_ptr<StallRecord> pending_stall_;
+  std::vector<StallRecord> stalls_;
+  size_t next_stall_{};
+  size_t num_stalls_{};
+  std::mutex stalls_lock_;
   Thread::ThreadPtr thread_;
   std::mutex exit_lock_;
   std::condition_variable_any exit_event_;
@@ -1,9 +1,14 @@
 #include "server/http/admin.h"
 
+#include <unistd.h>
+
+#include <algorithm>
 #include <cstdint>
+#include <cstdio>
 #include <fstream>
 #include <string>
 #include <unordered_set>
+#include <vector>
 
 #include "envoy/filesystem/filesystem.h"
 #include "envoy/server/hot_restart.h"
@@ -15,9 +20,11 @@
 
 #include "common/buffer/buffer_impl.h"
 #include "common/common/assert.h"
+#include "common/common/empty_string.h"
 #include "common/common/enum_to_int.h"
 #include "common/common/utility.h"
 #include "common/common/version.h"
+#include "common/filesystem/filesystem_impl.h"
 #include "common/http/access_log/access_log_formatter.h"
 #include "common/http/access_log/access_log_impl.h"
 #include "common/http/codes.h"
@@ -25,9 +32,12 @@
 #include "common/http/headers.h"
 #include "common/http/http1/codec_impl.h"
 #include "common/json/json_loader.h"
+#include "common/memory/accounting.h"
+#include "common/memory/stats.h"
 #include "common/network/listen_socket_impl.h"
 #include "common/profiler/profiler.h"
 #include "common/router/config_impl.h"
+#include "common/stats/histogram_impl.h"
 #include "common/upstream/host_utility.h"
 
 #include "spdlog/spdlog.h"
@@ -109,72 +119,107 @@ bool AdminImpl::changeLogLevel(const Http::Utility::QueryParams& params) {
   return true;
 }
 
-void AdminImpl::addOutlierInfo(const std::string& cluster_name,
-                               const Upstream::Outlier::Detector* outlier_detector,
-                               Buffer::Instance& response) {
-  if (outlier_detector) {
-    response.add(fmt::format("{}::outlier::success_rate_average::{}", cluster_name,
-                             outlier_detector->successRateAverage()));
-    response.add(fmt::format("{}::outlier::success_rate_ejection_threshold::{}", cluster_name,
-                             outlier_detector->successRateEjectionThreshold()));
+ClustersWriter::ClustersWriter(Upstream::ClusterManager& cluster_manager) {
+  for (auto& cluster : cluster_manager.clusters()) {
+    Entry entry;
+    entry.info_ = cluster.second.get().info();
+    const Upstream::Outlier::Detector* outlier_detector = cluster.second.get().outlierDetector();
+    if (outlier_detector) {
+      entry.outlier_detection_ = true;
+      entry.success_rate_average_ = outlier_detector->successRateAverage();
+      entry.success_rate_ejection_threshold_ = outlier_detector->successRateEjectionThreshold();
+    }
+    entry.hosts_ = cluster.second.get().hostsPtr();
+    entries_.push_back(std::move(entry));
   }
 }
 
-void AdminImpl::addCircuitSettings(const std::string& cluster_name, const std::string& priority_str,
-                                   Upstream::ResourceManager& resource_manager,
-                                   Buffer::Instance& response) {
-  response.add(fmt::format("{}::{}_priority::max_connections::{}\n", cluster_name, priority_str,
-                           resource_manager.connections().max()));
-  response.add(fmt::format("{}::{}_priority::max_pending_requests::{}\n", cluster_name,
-                           priority_str, resource_manager.pendingRequests().max()));
-  response.add(fmt::format("{}::{}_priority::max_requests::{}\n", cluster_name, priority_str,
-                           resource_manager.requests().max()));
-  response.add(fmt::format("{}::{}_priority::max_retries::{}\n", cluster_name, priority_str,
-                           resource_manager.retries().max()));
+bool ClustersWriter::writeBatch(Buffer::Instance& response) {
+  batch_.clear();
+  uint32_t written = 0;
+  while (next_entry_ < entries_.size() && written < BatchSize) {
+    const Entry& entry = entries_[next_entry_];
+    if (next_host_ == 0) {
+      writeCluster(entry);
+      written++;
+    }
+
+    const size_t end = std::min<size_t>(entry.hosts_->size(), next_host_ + BatchSize - written);
+    for (; next_host_ < end; next_host_++) {
+      writeHost(entry.info_->name(), *(*entry.hosts_)[next_host_]);
+      written++;
+    }
+
+    if (next_host_ == entry.hosts_->size()) {
+      next_entry_++;
+      next_host_ = 0;
+    }
+  }
+
+  response.add(batch_);
+  return next_entry_ < entries_.size();
 }
 
-Http::Code AdminImpl::handlerClusters(const std::string&, Buffer::Instance& response) {
-  for (auto& cluster : server_.clusterManager().clusters()) {
-    addOutlierInfo(cluster.second.get().info()->name(), cluster.second.get().outlierDetector(),
-                   response);
-
-    addCircuitSettings(
-        cluster.second.get().info()->name(), "default",
-        cluster.second.get().info()->resourceManager(Upstream::ResourcePriority::Default),
-        response);
-    addCircuitSettings(
-        cluster.second.get().info()->name(), "high",
-        cluster.second.get().info()->resourceManager(Upstream::ResourcePriority::High), response);
-
-    for (auto& host : cluster.second.get().hosts()) {
-      std::map<std::string, uint64_t> all_stats;
-      for (const Stats::CounterSharedPtr& counter : host->counters()) {
-        all_stats[counter->name()] = counter->value();
-      }
+void ClustersWriter::writeCluster(const Entry& entry) {
+  const std::string& cluster_name = entry.info_->name();
+  if (entry.outlier_detection_) {
+    batch_ += fmt::format("{}::outlier::success_rate_average::{}", cluster_name,
+                          entry.success_rate_average_);
+    batch_ += fmt::format("{}::outlier::success_rate_ejection_threshold::{}", cluster_name,
+                          entry.success_rate_ejection_threshold_);
+  }
 
-      for (const Stats::GaugeSharedPtr& gauge : host->gauges()) {
-        all_stats[gauge->name()] = gauge->value();
-      }
+  writeCircuitSettings(cluster_name, "default",
+                       entry.info_->resourceManager(Upstream::ResourcePriority::Default));
+  writeCircuitSettings(cluster_name, "high",
+                       entry.info_->resourceManager(Upstream::ResourcePriority::High));
+}
 
-      for (auto stat : all_stats) {
-        response.add(fmt::format("{}::{}::{}::{}\n", cluster.second.get().info()->name(),
-                                 host->address()->asString(), stat.first, stat.second));
-      }
+void ClustersWriter::writeCircuitSettings(const std::string& cluster_name,
+                                          const std::string& priority_str,
+                                          Upstream::ResourceManager& resource_manager) {
+  batch_ += fmt::format("{}::{}_priority::max_connections::{}\n", cluster_name, priority_str,
+                        resource_manager.connections().max());
+  batch_ += fmt::format("{}::{}_priority::max_pending_requests::{}\n", cluster_name, priority_str,
+                        resource_manager.pendingRequests().max());
+  batch_ += fmt::format("{}::{}_priority::max_requests::{}\n", cluster_name, priority_str,
+                        resource_manager.requests().max());
+  batch_ += fmt::format("{}::{}_priority::max_retries::{}\n", cluster_name, priority_str,
+                        resource_manager.retries().max());
+}
 
-      response.add(fmt::format("{}::{}::health_flags::{}\n", cluster.second.get().info()->name(),
-                               host->address()->asString(),
-                               Upstream::HostUtility::healthFlagsToString(*host)));
-      response.add(fmt::format("{}::{}::weight::{}\n", cluster.second.get().info()->name(),
-                               host->address()->asString(), host->weight()));
-      response.add(fmt::format("{}::{}::zone::{}\n", cluster.second.get().info()->name(),
-                               host->address()->asString(), host->zone()));
-      response.add(fmt::format("{}::{}::canary::{}\n", cluster.second.get().info()->name(),
-                               host->address()->asString(), host->canary()));
-      response.add(fmt::format("{}::{}::success_rate::{}\n", cluster.second.get().info()->name(),
-                               host->address()->asString(), host->outlierDetector().successRate()));
-    }
+void ClustersWriter::writeHost(const std::string& cluster_name, const Upstream::Host& host) {
+  std::map<std::string, uint64_t> all_stats;
+  for (const Stats::CounterSharedPtr& counter : host.counters()) {
+    all_stats[counter->name()] = counter->value();
+  }
+
+  for (const Stats::GaugeSharedPtr& gauge : host.gauges()) {
+    all_stats[gauge->name()] = gauge->value();
   }
 
+  const std::string address = host.address()->asString();
+  for (auto stat : all_stats) {
+    batch_ += fmt::format("{}::{}::{}::{}\n", cluster_name, address, stat.first, stat.second);
+  }
+
+  batch_ += fmt::format("{}::{}::health_flags::{}\n", cluster_name, address,
+                        Upstream::HostUtility::healthFlagsToString(host));
+  batch_ += fmt::format("{}::{}::weight::{}\n", cluster_name, address, host.weight());
+  batch_ += fmt::format("{}::{}::zone::{}\n", cluster_name, address, host.zone());
+  batch_ += fmt::format("{}::{}::canary::{}\n", cluster_name, address, host.canary());
+  batch_ += fmt::format("{}::{}::success_rate::{}\n", cluster_name, address,
+                        host.outlierDetector().successRate());
+}
+
+BatchWriterPtr AdminImpl::createClustersWriter() {
+  return BatchWriterPtr{new ClustersWriter(server_.clusterManager())};
+}
+
+Http::Code AdminImpl::handlerClusters(const std::string&, Buffer::Instance& response) {
+  BatchWriterPtr writer = createClustersWriter();
+  while (writer->writeBatch(response)) {
+  }
   return Http::Code::OK;
 }
 
@@ -186,6 +231,11 @@ Http::Code AdminImpl::handlerCpuProfiler(const std::string& url, Buffer::Instanc
     return Http::Code::BadRequest;
   }
 
+  if (cpu_profile_recorder_.busy()) {
+    response.add("the CPU profiler is in use by /profile\n");
+    return Http::Code::Conflict;
+  }
+
   bool enable = query_params.begin()->second == "y";
   if (enable && !Profiler::Cpu::profilerEnabled()) {
     if (!Profiler::Cpu::startProfiler(profile_path_)) {
@@ -201,6 +251,17 @@ Http::Code AdminImpl::handlerCpuProfiler(const std::string& url, Buffer::Instanc
   return Http::Code::OK;
 }
 
+Http::Code AdminImpl::handlerHeapProfile(const std::string&, Buffer::Instance& response) {
+  std::string profile;
+  if (!Profiler::Heap::heapSample(profile)) {
+    response.add("heap profiling requires tcmalloc\n");
+    return Http::Code::NotImplemented;
+  }
+
+  response.add(profile);
+  return Http::Code::OK;
+}
+
 Http::Code AdminImpl::handlerHealthcheckFail(const std::string&, Buffer::Instance& response) {
   server_.failHealthcheck(true);
   response.add("OK\n");
@@ -259,25 +320,293 @@ Http::Code AdminImpl::handlerServerInfo(const std::string&, Buffer::Instance& re
                            current_time - server_.startTimeCurrentEpoch(),
                            current_time - server_.startTimeFirstEpoch(),
                            server_.options().restartEpoch()));
+  for (const auto& phase_time : server_.startupPhaseTimes()) {
+    response.add(fmt::format("startup {}: {}ms\n", phase_time.first, phase_time.second.count()));
+  }
   return Http::Code::OK;
 }
 
-Http::Code AdminImpl::handlerStats(const std::string&, Buffer::Instance& response) {
-  // We currently don't support timers locally (only via statsd) so just group all the counters
-  // and gauges together, alpha sort them, and spit them out.
-  std::map<std::string, uint64_t> all_stats;
-  for (const Stats::CounterSharedPtr& counter : server_.stats().counters()) {
-    all_stats.emplace(counter->name(), counter->value());
+StatsWriter::StatsWriter(Stats::Store& store, const Http::Utility::QueryParams& params)
+    : prometheus_(params.count("format") > 0 && params.at("format") == "prometheus"),
+      used_only_(params.count("usedonly") > 0) {
+  if (params.count("format") > 0 && !prometheus_) {
+    throw EnvoyException(fmt::format("unknown stats format '{}'", params.at("format")));
   }
 
-  for (const Stats::GaugeSharedPtr& gauge : server_.stats().gauges()) {
-    all_stats.emplace(gauge->name(), gauge->value());
+  if (params.count("filter") > 0) {
+    try {
+      filter_.reset(new std::regex(params.at("filter")));
+    } catch (const std::regex_error& e) {
+      throw EnvoyException(fmt::format("invalid filter '{}': {}", params.at("filter"), e.what()));
+    }
   }
 
-  for (auto stat : all_stats) {
-    response.add(fmt::format("{}: {}\n", stat.first, stat.second));
+  // In the text format counters and gauges are sorted together and histograms follow with a
+  // summary of all samples merged as of the last stats flush. In the Prometheus format all of the
+  // series of a metric must be adjacent, so everything is sorted together.
+  addEntries(store.counters(), &Entry::counter_, entries_);
+  addEntries(store.gauges(), &Entry::gauge_, entries_);
+  std::vector<Entry> histogram_entries;
+  addEntries(store.histograms(), &Entry::histogram_, prometheus_ ? entries_ : histogram_entries);
+
+  const auto by_name = [](const Entry& lhs, const Entry& rhs) { return lhs.name_ < rhs.name_; };
+  std::stable_sort(entries_.begin(), entries_.end(), by_name);
+  std::stable_sort(histogram_entries.begin(), histogram_entries.end(), by_name);
+  std::move(histogram_entries.begin(), histogram_entries.end(), std::back_inserter(entries_));
+}
+
+template <class StatSharedPtr>
+void StatsWriter::addEntries(const std::list<StatSharedPtr>& stats, StatSharedPtr Entry::*stat,
+                             std::vector<Entry>& entries) {
+  for (const StatSharedPtr& shared_stat : stats) {
+    Entry entry;
+    entry.name_ = shared_stat->name();
+    if (filter_ && !std::regex_search(entry.name_, *filter_)) {
+      continue;
+    }
+
+    // The store extracted the tags when the stat was created, so nothing is parsed here.
+    if (prometheus_) {
+      entry.name_ = "envoy_" + sanitizePrometheusName(shared_stat->tagExtractedName());
+    }
+    entry.tags_ = &shared_stat->tags();
+    entry.*stat = shared_stat;
+    entries.push_back(std::move(entry));
+  }
+}
+
+bool StatsWriter::writeBatch(Buffer::Instance& response) {
+  batch_.clear();
+  const size_t end = std::min(entries_.size(), next_entry_ + BatchSize);
+  for (; next_entry_ < end; next_entry_++) {
+    const Entry& entry = entries_[next_entry_];
+    if (used_only_ && !used(entry)) {
+      continue;
+    }
+
+    if (prometheus_) {
+      writePrometheus(entry);
+    } else {
+      writeText(entry);
+    }
+  }
+
+  response.add(batch_);
+  return next_entry_ < entries_.size();
+}
+
+bool StatsWriter::used(const Entry& entry) {
+  if (entry.counter_) {
+    return entry.counter_->used();
+  } else if (entry.gauge_) {
+    return entry.gauge_->used();
+  } else {
+    return entry.histogram_->cumulativeStatistics().sampleCount() > 0;
+  }
+}
+
+void StatsWriter::writeText(const Entry& entry) {
+  batch_.append(entry.name_);
+  batch_.append(": ");
+  if (entry.counter_) {
+    batch_.append(std::to_string(entry.counter_->value()));
+  } else if (entry.gauge_) {
+    batch_.append(std::to_string(entry.gauge_->value()));
+  } else {
+    batch_.append(entry.histogram_->cumulativeStatistics().summary());
+  }
+  batch_.append("\n");
+}
+
+void StatsWriter::writePrometheus(const Entry& entry) {
+  if (entry.name_ != last_metric_name_) {
+    last_metric_name_ = entry.name_;
+    batch_.append("# TYPE ");
+    batch_.append(entry.name_);
+    batch_.append(entry.counter_ ? " counter\n" : entry.gauge_ ? " gauge\n" : " summary\n");
+  }
+
+  if (entry.counter_) {
+    writeSample(entry, "", EMPTY_STRING, entry.counter_->value());
+  } else if (entry.gauge_) {
+    writeSample(entry, "", EMPTY_STRING, entry.gauge_->value());
+  } else {
+    // Histograms are written as summaries of all samples merged as of the last stats flush.
+    const Stats::HistogramStatistics& statistics = entry.histogram_->cumulativeStatistics();
+    for (const Stats::HistogramStatisticsImpl::ExportedQuantile& exported :
+         Stats::HistogramStatisticsImpl::exportedQuantiles()) {
+      writeSample(entry, "", fmt::format("quantile=\"{}\"", exported.quantile_),
+                  statistics.quantile(exported.quantile_));
+    }
+    writeSample(entry, "_sum", EMPTY_STRING, statistics.sampleSum());
+    writeSample(entry, "_count", EMPTY_STRING, statistics.sampleCount());
+  }
+}
+
+void StatsWriter::writeSample(const Entry& entry, const char* suffix,
+                              const std::string& extra_label, uint64_t value) {
+  batch_.append(entry.name_);
+  batch_.append(suffix);
+  if (!entry.tags_->empty() || !extra_label.empty()) {
+    writeLabels(*entry.tags_, extra_label);
+  }
+  batch_.append(" ");
+  batch_.append(std::to_string(value));
+  batch_.append("\n");
+}
+
+void StatsWriter::writeLabels(const std::vector<Stats::Tag>& tags, const std::string& extra_label) {
+  batch_.append("{");
+  bool first = true;
+  for (const Stats::Tag& tag : tags) {
+    if (!first) {
+      batch_.append(",");
+    }
+    first = false;
+    batch_.append(sanitizePrometheusName(tag.name_));
+    batch_.append("=\"");
+    for (char c : tag.value_) {
+      switch (c) {
+      case '\\':
+        batch_.append("\\\\");
+        break;
+      case '"':
+        batch_.append("\\\"");
+        break;
+      case '\n':
+        batch_.append("\\n");
+        break;
+      default:
+        batch_.push_back(c);
+      }
+    }
+    batch_.append("\"");
+  }
+  if (!extra_label.empty()) {
+    if (!first) {
+      batch_.append(",");
+    }
+    batch_.append(extra_label);
+  }
+  batch_.append("}");
+}
+
+std::string StatsWriter::sanitizePrometheusName(const std::string& name) {
+  // Prometheus names may only contain [a-zA-Z0-9_:]. Envoy's own names use '.' as a separator.
+  std::string sanitized = name;
+  for (char& c : sanitized) {
+    if (!isalnum(static_cast<unsigned char>(c)) && c != '_') {
+      c = '_';
+    }
+  }
+  return sanitized;
+}
+
+StatsWriterPtr AdminImpl::createStatsWriter(const std::string& url, Buffer::Instance& response) {
+  try {
+    return StatsWriterPtr{new StatsWriter(server_.stats(), Http::Utility::parseQueryString(url))};
+  } catch (const EnvoyException& e) {
+    response.add(fmt::format("{}\n", e.what()));
+    return nullptr;
+  }
+}
+
+Http::Code AdminImpl::handlerStats(const std::string& url, Buffer::Instance& response) {
+  StatsWriterPtr writer = createStatsWriter(url, response);
+  if (!writer) {
+    return Http::Code::BadRequest;
+  }
+
+  while (writer->writeBatch(response)) {
+  }
+  return Http::Code::OK;
+}
+
+Http::Code AdminImpl::handlerMemory(const std::string&, Buffer::Instance& response) {
+  response.add(fmt::format("allocated: {}\n", Memory::Stats::totalCurrentlyAllocated()));
+  response.add(fmt::format("heap_size: {}\n", Memory::Stats::totalCurrentlyReserved()));
+  if (!Memory::Accounting::enabled()) {
+    response.add("memory accounting is off, see --memory-accounting\n");
+    return Http::Code::OK;
+  }
+
+  for (size_t i = 0; i < Memory::Accounting::NumSubsystems; i++) {
+    const Memory::Subsystem subsystem = static_cast<Memory::Subsystem>(i);
+    const Memory::Accounting::Totals totals = Memory::Accounting::totals(subsystem);
+    const char* name = Memory::Accounting::name(subsystem);
+    response.add(fmt::format("{}.allocated_bytes: {}\n", name, totals.allocated_bytes_));
+    response.add(fmt::format("{}.freed_bytes: {}\n", name, totals.freed_bytes_));
+    response.add(fmt::format("{}.net_bytes: {}\n", name, totals.netBytes()));
+  }
+
+  return Http::Code::OK;
+}
+
+Http::Code AdminImpl::handlerRequestAllocations(const std::string& url,
+                                                Buffer::Instance& response) {
+  Http::Utility::QueryParams query_params = Http::Utility::parseQueryString(url);
+  if (query_params.size() != 1 || query_params.begin()->first != "enable" ||
+      (query_params.begin()->second != "y" && query_params.begin()->second != "n")) {
+    response.add("?enable=<y|n>\n");
+    return Http::Code::BadRequest;
+  }
+
+  const bool enable = query_params.begin()->second == "y";
+  if (Memory::RequestAllocations::enable(enable) != enable) {
+    response.add("request allocation accounting requires tcmalloc\n");
+    return Http::Code::NotImplemented;
   }
 
+  response.add("OK\n");
+  return Http::Code::OK;
+}
+
+Http::Code AdminImpl::handlerProfile(const std::string& url, Buffer::Instance& response) {
+  if (Http::Utility::parseQueryString(url).count("seconds") > 0) {
+    // Profiles of a given duration are recorded asynchronously by AdminFilter.
+    response.add("?seconds=<N> is only supported over HTTP\n");
+    return Http::Code::BadRequest;
+  }
+
+  std::string profile;
+  if (!cpu_profile_recorder_.lastWindow(profile)) {
+    response.add("no continuous CPU profile window has completed\n");
+    return Http::Code::NotFound;
+  }
+
+  response.add(profile);
+  return Http::Code::OK;
+}
+
+Http::Code AdminImpl::startProfile(const std::string& url, std::chrono::milliseconds& duration,
+                                   Buffer::Instance& response) {
+  Http::Utility::QueryParams query_params = Http::Utility::parseQueryString(url);
+  auto seconds_param = query_params.find("seconds");
+  uint64_t seconds;
+  if (seconds_param == query_params.end() ||
+      !StringUtil::atoul(seconds_param->second.c_str(), seconds) || seconds == 0 ||
+      seconds > MaxProfileSeconds) {
+    response.add(fmt::format("?seconds=<1-{}>\n", MaxProfileSeconds));
+    return Http::Code::BadRequest;
+  }
+
+  if (!cpu_profile_recorder_.beginCapture()) {
+    response.add("the CPU profiler is in use or could not be started\n");
+    return Http::Code::ServiceUnavailable;
+  }
+
+  duration = std::chrono::seconds(seconds);
+  return Http::Code::OK;
+}
+
+Http::Code AdminImpl::finishProfile(Buffer::Instance& response) {
+  std::string profile;
+  if (!cpu_profile_recorder_.endCapture(profile)) {
+    response.add("unable to read the CPU profile\n");
+    return Http::Code::InternalServerError;
+  }
+
+  response.add(profile);
   return Http::Code::OK;
 }
 
@@ -315,12 +644,72 @@ Http::Code AdminImpl::handlerCerts(const std::string&, Buffer::Instance& respons
   return Http::Code::OK;
 }
 
+Http::Code AdminImpl::handlerReloadCerts(const std::string&, Buffer::Instance& response) {
+  try {
+    server_.sslContextManager().reloadServerContexts();
+  } catch (const EnvoyException& e) {
+    response.add(fmt::format("{}\n", e.what()));
+    return Http::Code::InternalServerError;
+  }
+
+  response.add("OK\n");
+  return Http::Code::OK;
+}
+
+void AdminFilter::onDestroy() {
+  if (stream_timer_) {
+    stream_timer_->disableTimer();
+  }
+  if (profile_timer_) {
+    // The client went away before the profile was done. Stop it so that the profiler is free.
+    profile_timer_.reset();
+    Buffer::OwnedImpl discarded;
+    parent_.finishProfile(discarded);
+  }
+}
+
 void AdminFilter::onComplete() {
   std::string path = request_headers_->Path()->value().c_str();
   stream_log_info("request complete: path: {}", *callbacks_, path);
 
   Buffer::OwnedImpl response;
-  Http::Code code = parent_.runCallback(path, response);
+  Http::Code code;
+  if (path.find("/stats") == 0) {
+    // Stats are streamed since there can be a very large number of them.
+    StatsWriterPtr stats_writer = parent_.createStatsWriter(path, response);
+    if (stats_writer) {
+      Http::HeaderMapPtr headers{new Http::HeaderMapImpl{
+          {Http::Headers::get().Status, std::to_string(enumToInt(Http::Code::OK))}}};
+      if (stats_writer->prometheus()) {
+        headers->insertContentType().value(std::string("text/plain; version=0.0.4"));
+      }
+      callbacks_->encodeHeaders(std::move(headers), false);
+      writer_ = std::move(stats_writer);
+      streamResponse();
+      return;
+    }
+    code = Http::Code::BadRequest;
+  } else if (path.find("/clusters") == 0) {
+    // So are clusters, since there can be a very large number of hosts.
+    Http::HeaderMapPtr headers{new Http::HeaderMapImpl{
+        {Http::Headers::get().Status, std::to_string(enumToInt(Http::Code::OK))}}};
+    callbacks_->encodeHeaders(std::move(headers), false);
+    writer_ = parent_.createClustersWriter();
+    streamResponse();
+    return;
+  } else if (path.find("/profile") == 0 &&
+             Http::Utility::parseQueryString(path).count("seconds") > 0) {
+    // The response is sent once the profile has run for the requested duration.
+    std::chrono::milliseconds duration;
+    code = parent_.startProfile(path, duration, response);
+    if (code == Http::Code::OK) {
+      profile_timer_ = callbacks_->dispatcher().createTimer([this]() -> void { finishProfile(); });
+      profile_timer_->enableTimer(duration);
+      return;
+    }
+  } else {
+    code = parent_.runCallback(path, response);
+  }
 
   Http::HeaderMapPtr headers{
       new Http::HeaderMapImpl{{Http::Headers::get().Status, std::to_string(enumToInt(code))}}};
@@ -331,6 +720,126 @@ void AdminFilter::onComplete() {
   }
 }
 
+void AdminFilter::streamResponse() {
+  Buffer::OwnedImpl batch;
+  const bool more = writer_->writeBatch(batch);
+  callbacks_->encodeData(batch, !more);
+  if (!more) {
+    writer_.reset();
+    return;
+  }
+
+  if (!stream_timer_) {
+    stream_timer_ = callbacks_->dispatcher().createTimer([this]() -> void { streamResponse(); });
+  }
+  stream_timer_->enableTimer(std::chrono::milliseconds(0));
+}
+
+void AdminFilter::finishProfile() {
+  profile_timer_.reset();
+  Buffer::OwnedImpl response;
+  Http::Code code = parent_.finishProfile(response);
+  Http::HeaderMapPtr headers{
+      new Http::HeaderMapImpl{{Http::Headers::get().Status, std::to_string(enumToInt(code))}}};
+  if (code == Http::Code::OK) {
+    headers->insertContentType().value(std::string("application/octet-stream"));
+  }
+  callbacks_->encodeHeaders(std::move(headers), response.length() == 0);
+  if (response.length() > 0) {
+    callbacks_->encodeData(response, true);
+  }
+}
+
+CpuProfileRecorder::CpuProfileRecorder(Event::Dispatcher& dispatcher, const std::string& path)
+    : dispatcher_(dispatcher), window_path_(path + ".window"), last_window_path_(path + ".last"),
+      capture_path_(path + ".capture") {}
+
+CpuProfileRecorder::~CpuProfileRecorder() {
+  if (busy()) {
+    Profiler::Cpu::stopProfiler();
+  }
+}
+
+bool CpuProfileRecorder::startContinuous(uint32_t frequency_hz, std::chrono::milliseconds window) {
+  if (!Profiler::Cpu::setSamplingFrequency(frequency_hz)) {
+    return false;
+  }
+
+  window_ = window;
+  window_timer_ = dispatcher_.createTimer([this]() -> void {
+    endWindow();
+    startWindow();
+  });
+  continuous_ = true;
+  startWindow();
+  return continuous_;
+}
+
+bool CpuProfileRecorder::beginCapture() {
+  if (capturing_ || (!continuous_ && Profiler::Cpu::profilerEnabled())) {
+    return false;
+  }
+
+  if (continuous_) {
+    endWindow();
+  }
+  if (!Profiler::Cpu::startProfiler(capture_path_)) {
+    if (continuous_) {
+      startWindow();
+    }
+    return false;
+  }
+
+  capturing_ = true;
+  return true;
+}
+
+bool CpuProfileRecorder::endCapture(std::string& profile) {
+  ASSERT(capturing_);
+  Profiler::Cpu::stopProfiler();
+  capturing_ = false;
+  const bool read = readProfile(capture_path_, profile);
+  ::unlink(capture_path_.c_str());
+  if (continuous_) {
+    startWindow();
+  }
+
+  return read;
+}
+
+bool CpuProfileRecorder::lastWindow(std::string& profile) {
+  return have_last_window_ && readProfile(last_window_path_, profile);
+}
+
+void CpuProfileRecorder::startWindow() {
+  if (!Profiler::Cpu::startProfiler(window_path_)) {
+    log().error("unable to start the CPU profiler, continuous profiling is off");
+    continuous_ = false;
+    return;
+  }
+
+  window_timer_->enableTimer(window_);
+}
+
+void CpuProfileRecorder::endWindow() {
+  window_timer_->disableTimer();
+  Profiler::Cpu::stopProfiler();
+  // The profile is only complete once the profiler has stopped, so /profile never sees a partial
+  // window.
+  if (::rename(window_path_.c_str(), last_window_path_.c_str()) == 0) {
+    have_last_window_ = true;
+  }
+}
+
+bool CpuProfileRecorder::readProfile(const std::string& path, std::string& profile) {
+  if (!Filesystem::fileExists(path)) {
+    return false;
+  }
+
+  profile = Filesystem::fileReadToEnd(path);
+  return true;
+}
+
 AdminImpl::NullRouteConfigProvider::NullRouteConfigProvider()
     : config_(new Router::NullConfigImpl()) {}
 
@@ -338,6 +847,7 @@ AdminImpl::AdminImpl(const std::string& access_log_path, const std::string& prof
                      const std::string& address_out_path,
                      Network::Address::InstanceConstSharedPtr address, Server::Instance& server)
     : server_(server), profile_path_(profile_path),
+      cpu_profile_recorder_(server_.dispatcher(), profile_path_),
       socket_(new Network::TcpListenSocket(address, true)),
       stats_(Http::ConnectionManagerImpl::generateStats("http.admin.", server_.stats())),
       tracing_stats_(Http::ConnectionManagerImpl::generateTracingStats("http.admin.tracing.",
@@ -350,14 +860,26 @@ AdminImpl::AdminImpl(const std::string& access_log_path, const std::string& prof
            MAKE_HANDLER(handlerHealthcheckFail)},
           {"/healthcheck/ok", "cause the server to pass health checks",
            MAKE_HANDLER(handlerHealthcheckOk)},
+          {"/heapprofile", "print the sampled heap allocations in pprof format",
+           MAKE_HANDLER(handlerHeapProfile)},
           {"/hot_restart_version", "print the hot restart compatability version",
            MAKE_HANDLER(handlerHotRestartVersion)},
           {"/logging", "query/change logging levels", MAKE_HANDLER(handlerLogging)},
+          {"/memory", "print memory usage, per subsystem if memory accounting is on",
+           MAKE_HANDLER(handlerMemory)},
+          {"/profile", "print a CPU profile in pprof format", MAKE_HANDLER(handlerProfile)},
           {"/quitquitquit", "exit the server", MAKE_HANDLER(handlerQuitQuitQuit)},
+          {"/reload_certs", "reload the certificates and keys of listeners from their files",
+           MAKE_HANDLER(handlerReloadCerts)},
+          {"/request_allocations",
+           "enable/disable per request allocation histograms (?enable=<y|n>)",
+           MAKE_HANDLER(handlerRequestAllocations)},
           {"/reset_counters", "reset all counters to zero", MAKE_HANDLER(handlerResetCounters)},
           {"/server_info", "print server version/status information",
            MAKE_HANDLER(handlerServerInfo)},
-          {"/stats", "print server stats", MAKE_HANDLER(handlerStats)},
+          {"/stats",
+           "print server stats (?filter=<regex>, ?usedonly, ?format=prometheus)",
+           MAKE_HANDLER(handlerStats)},
           {"/listeners", "print listener addresses", MAKE_HANDLER(handlerListenerInfo)}} {
 
   if (!address_out_path.empty()) {
@@ -377,7 +899,8 @@ AdminImpl::AdminImpl(const std::string& access_log_path, const std::string& prof
 Http::ServerConnectionPtr AdminImpl::createCodec(Network::Connection& connection,
                                                  const Buffer::Instance&,
                                                  Http::ServerConnectionCallbacks& callbacks) {
-  return Http::ServerConnectionPtr{new Http::Http1::ServerConnectionImpl(connection, callbacks)};
+  return Http::ServerConnectionPtr{
+      new Http::Http1::ServerConnectionImpl(connection, callbacks, Http::HeaderLimits())};
 }
 
 bool AdminImpl::createFilterChain(Network::Connection& connection) {
@@ -388,6 +911,8 @@ bool AdminImpl::createFilterChain(Network::Connection& connection) {
 }
 
 void AdminImpl::createFilterChain(Http::FilterChainFactoryCallbacks& callbacks) {
+  static const std::string filter_name = "admin";
+  callbacks.setFilterName(filter_name);
   callbacks.addStreamDecoderFilter(Http::StreamDecoderFilterSharedPtr{new AdminFilter(*this)});
 }
 
@@ -1,14 +1,23 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 #include <list>
+#include <memory>
+#include <regex>
 #include <string>
+#include <vector>
 
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
 #include "envoy/http/filter.h"
 #include "envoy/network/listen_socket.h"
 #include "envoy/server/admin.h"
+#include "envoy/stats/stats.h"
+#include "envoy/upstream/cluster_manager.h"
 #include "envoy/upstream/outlier_detection.h"
 #include "envoy/upstream/resource_manager.h"
+#include "envoy/upstream/upstream.h"
 
 #include "common/common/logger.h"
 #include "common/http/conn_manager_impl.h"
@@ -20,6 +29,188 @@
 namespace Envoy {
 namespace Server {
 
+/**
+ * Writes a potentially large admin response a batch at a time, so that it can be streamed with
+ * other events on the main thread running in between batches.
+ */
+class BatchWriter {
+public:
+  virtual ~BatchWriter() {}
+
+  /**
+   * Write the next batch of the response.
+   * @param response supplies the buffer to write to.
+   * @return true if there is more of the response left to write.
+   */
+  virtual bool writeBatch(Buffer::Instance& response) PURE;
+};
+
+typedef std::unique_ptr<BatchWriter> BatchWriterPtr;
+
+/**
+ * Writes the stats for a /stats request a batch at a time. The stats are snapshotted and sorted by
+ * name when the writer is created, and their values are read as they are written.
+ *
+ * The query parameters of the request select what is written:
+ *   filter=<regex>     only stats whose name matches the regex.
+ *   usedonly           only stats that have been written to since they were created.
+ *   format=prometheus  the Prometheus text format, with the tags of the default tag extractors as
+ *                      labels.
+ */
+class StatsWriter : public BatchWriter {
+public:
+  /**
+   * @param store supplies the store to write the stats of.
+   * @param params supplies the query parameters of the request. Throws EnvoyException if they
+   *        are invalid.
+   */
+  StatsWriter(Stats::Store& store, const Http::Utility::QueryParams& params);
+
+  /**
+   * @return whether the stats are written in the Prometheus text format.
+   */
+  bool prometheus() const { return prometheus_; }
+
+  // Server::BatchWriter
+  bool writeBatch(Buffer::Instance& response) override;
+
+  static const uint32_t BatchSize = 1000;
+
+private:
+  struct Entry {
+    // The full name, or in the Prometheus format the metric name built from the tag extracted name.
+    std::string name_;
+    // The tags extracted by the store, owned by the stat.
+    const std::vector<Stats::Tag>* tags_{};
+    Stats::CounterSharedPtr counter_;
+    Stats::GaugeSharedPtr gauge_;
+    Stats::HistogramSharedPtr histogram_;
+  };
+
+  template <class StatSharedPtr>
+  void addEntries(const std::list<StatSharedPtr>& stats, StatSharedPtr Entry::*stat,
+                  std::vector<Entry>& entries);
+  static bool used(const Entry& entry);
+  void writeText(const Entry& entry);
+  void writePrometheus(const Entry& entry);
+  void writeSample(const Entry& entry, const char* suffix, const std::string& extra_label,
+                   uint64_t value);
+  void writeLabels(const std::vector<Stats::Tag>& tags, const std::string& extra_label);
+
+  static std::string sanitizePrometheusName(const std::string& name);
+
+  const bool prometheus_;
+  const bool used_only_;
+  std::unique_ptr<std::regex> filter_;
+  std::vector<Entry> entries_;
+  size_t next_entry_{};
+  std::string batch_;
+  // The Prometheus metric whose TYPE line was written last.
+  std::string last_metric_name_;
+};
+
+typedef std::unique_ptr<StatsWriter> StatsWriterPtr;
+
+/**
+ * Writes the cluster status for a /clusters request a batch of hosts at a time. The clusters, their
+ * outlier detection averages and their host lists are snapshotted when the writer is created, so a
+ * cluster that is removed or changes membership in between batches is still written consistently.
+ * Host stats are read as they are written.
+ */
+class ClustersWriter : public BatchWriter {
+public:
+  ClustersWriter(Upstream::ClusterManager& cluster_manager);
+
+  // Server::BatchWriter
+  bool writeBatch(Buffer::Instance& response) override;
+
+  // The number of hosts written per batch. The cluster wide settings count as one host.
+  static const uint32_t BatchSize = 100;
+
+private:
+  struct Entry {
+    Upstream::ClusterInfoConstSharedPtr info_;
+    bool outlier_detection_{};
+    double success_rate_average_{};
+    double success_rate_ejection_threshold_{};
+    Upstream::HostVectorConstSharedPtr hosts_;
+  };
+
+  void writeCluster(const Entry& entry);
+  void writeCircuitSettings(const std::string& cluster_name, const std::string& priority_str,
+                            Upstream::ResourceManager& resource_manager);
+  void writeHost(const std::string& cluster_name, const Upstream::Host& host);
+
+  std::vector<Entry> entries_;
+  size_t next_entry_{};
+  // The next host of entries_[next_entry_] to write. The cluster wide settings are written first,
+  // when this is 0.
+  size_t next_host_{};
+  std::string batch_;
+};
+
+/**
+ * Owns the process wide CPU profiler on behalf of /profile. With continuous profiling the profiler
+ * always runs at a low sampling frequency and is restarted every window, keeping the profile of the
+ * last complete window around. A capture records a profile of its own, cutting the current window
+ * short; a new window starts once the capture is done.
+ */
+class CpuProfileRecorder : Logger::Loggable<Logger::Id::admin> {
+public:
+  /**
+   * @param dispatcher supplies the dispatcher to run the window timer on.
+   * @param path supplies the path that the profiles are written next to.
+   */
+  CpuProfileRecorder(Event::Dispatcher& dispatcher, const std::string& path);
+  ~CpuProfileRecorder();
+
+  /**
+   * Turn on continuous profiling. Must be called before the profiler is first started.
+   * @return bool whether the profiler could be started.
+   */
+  bool startContinuous(uint32_t frequency_hz, std::chrono::milliseconds window);
+
+  /**
+   * @return bool whether the profiler is in use by the recorder.
+   */
+  bool busy() const { return continuous_ || capturing_; }
+
+  /**
+   * Start recording a profile. Fails if a capture is already in progress or the profiler was
+   * started by /cpuprofiler.
+   * @return bool whether the capture was started.
+   */
+  bool beginCapture();
+
+  /**
+   * Stop the capture started by beginCapture().
+   * @param profile supplies the string to write the profile to.
+   * @return bool whether the profile could be read.
+   */
+  bool endCapture(std::string& profile);
+
+  /**
+   * @param profile supplies the string to write the profile of the last complete window to.
+   * @return bool whether a window has completed yet.
+   */
+  bool lastWindow(std::string& profile);
+
+private:
+  void startWindow();
+  void endWindow();
+  static bool readProfile(const std::string& path, std::string& profile);
+
+  Event::Dispatcher& dispatcher_;
+  const std::string window_path_;
+  const std::string last_window_path_;
+  const std::string capture_path_;
+  std::chrono::milliseconds window_{};
+  Event::TimerPtr window_timer_;
+  bool continuous_{};
+  bool capturing_{};
+  bool have_last_window_{};
+};
+
 /**
  * Implementation of Server::admin.
  */
@@ -34,6 +225,43 @@ public:
             Server::Instance& server);
 
   Http::Code runCallback(const std::string& path, Buffer::Instance& response);
+
+  /**
+   * Create a writer for the stats requested by a /stats URL.
+   * @param url supplies the URL.
+   * @param response supplies the buffer to write an error to.
+   * @return the writer, or nullptr if the query parameters are invalid.
+   */
+  StatsWriterPtr createStatsWriter(const std::string& url, Buffer::Instance& response);
+
+  /**
+   * Create a writer for the cluster status requested by /clusters.
+   */
+  BatchWriterPtr createClustersWriter();
+
+  /**
+   * Start a CPU profile for a /profile?seconds=N request.
+   * @param url supplies the URL.
+   * @param duration supplies where to store how long the profile should run for.
+   * @param response supplies the buffer to write an error to.
+   * @return Http::Code OK if the profile was started and finishProfile() must be called once the
+   *         duration has passed.
+   */
+  Http::Code startProfile(const std::string& url, std::chrono::milliseconds& duration,
+                          Buffer::Instance& response);
+
+  /**
+   * Finish the CPU profile started by startProfile().
+   * @param response supplies the buffer to write the profile, or an error, to.
+   */
+  Http::Code finishProfile(Buffer::Instance& response);
+
+  /**
+   * @return CpuProfileRecorder& the recorder behind /profile.
+   */
+  CpuProfileRecorder& cpuProfileRecorder() { return cpu_profile_recorder_; }
+
+  static const uint64_t MaxProfileSeconds = 300;
   const Network::ListenSocket& socket() override { return *socket_; }
   Network::ListenSocket& mutable_socket() { return *socket_; }
 
@@ -100,11 +328,6 @@ private:
    * @return TRUE if level change succeeded, FALSE otherwise.
    */
   bool changeLogLevel(const Http::Utility::QueryParams& params);
-  void addCircuitSettings(const std::string& cluster_name, const std::string& priority_str,
-                          Upstream::ResourceManager& resource_manager, Buffer::Instance& response);
-  void addOutlierInfo(const std::string& cluster_name,
-                      const Upstream::Outlier::Detector* outlier_detector,
-                      Buffer::Instance& response);
 
   /**
    * URL handlers.
@@ -113,9 +336,14 @@ private:
   Http::Code handlerClusters(const std::string& url, Buffer::Instance& response);
   Http::Code handlerCpuProfiler(const std::string& url, Buffer::Instance& response);
   Http::Code handlerHealthcheckFail(const std::string& url, Buffer::Instance& response);
+  Http::Code handlerHeapProfile(const std::string& url, Buffer::Instance& response);
   Http::Code handlerHealthcheckOk(const std::string& url, Buffer::Instance& response);
   Http::Code handlerHotRestartVersion(const std::string& url, Buffer::Instance& response);
   Http::Code handlerLogging(const std::string& url, Buffer::Instance& response);
+  Http::Code handlerMemory(const std::string& url, Buffer::Instance& response);
+  Http::Code handlerProfile(const std::string& url, Buffer::Instance& response);
+  Http::Code handlerReloadCerts(const std::string& url, Buffer::Instance& response);
+  Http::Code handlerRequestAllocations(const std::string& url, Buffer::Instance& response);
   Http::Code handlerResetCounters(const std::string& url, Buffer::Instance& response);
   Http::Code handlerServerInfo(const std::string& url, Buffer::Instance& response);
   Http::Code handlerStats(const std::string& url, Buffer::Instance& response);
@@ -125,6 +353,7 @@ private:
   Server::Instance& server_;
   std::list<Http::AccessLog::InstanceSharedPtr> access_logs_;
   const std::string profile_path_;
+  CpuProfileRecorder cpu_profile_recorder_;
   Network::ListenSocketPtr socket_;
   Http::ConnectionManagerStats stats_;
   Http::ConnectionManagerTracingStats tracing_stats_;
@@ -143,7 +372,7 @@ public:
   AdminFilter(AdminImpl& parent);
 
   // Http::StreamFilterBase
-  void onDestroy() override {}
+  void onDestroy() override;
 
   // Http::StreamDecoderFilter
   Http::FilterHeadersStatus decodeHeaders(Http::HeaderMap& headers, bool end_stream) override;
@@ -159,9 +388,23 @@ private:
    */
   void onComplete();
 
+  /**
+   * Send the next batch of a streamed response, and schedule the one after it so that other events
+   * can run in between.
+   */
+  void streamResponse();
+
+  /**
+   * Send the CPU profile of a /profile?seconds=N request once its duration has passed.
+   */
+  void finishProfile();
+
   AdminImpl& parent_;
   Http::StreamDecoderFilterCallbacks* callbacks_{};
   Http::HeaderMap* request_headers_{};
+  BatchWriterPtr writer_;
+  Event::TimerPtr stream_timer_;
+  Event::TimerPtr profile_timer_;
 };
 
 } // Server
@@ -3,16 +3,19 @@
 #include <chrono>
 #include <cstdint>
 #include <iostream>
+#include <limits>
 #include <string>
+#include <vector>
 
 #include "common/common/macros.h"
+#include "common/common/utility.h"
 #include "common/common/version.h"
 
 #include "spdlog/spdlog.h"
 #include "tclap/CmdLine.h"
 
 namespace Envoy {
-OptionsImpl::OptionsImpl(int argc, char** argv, const std::string& hot_restart_version,
+OptionsImpl::OptionsImpl(int argc, char** argv, const HotRestartVersionCb& hot_restart_version_cb,
                          spdlog::level::level_enum default_log_level) {
   std::string log_levels_string = "Log levels: ";
   for (size_t i = 0; i < ARRAY_SIZE(spdlog::level::level_names); i++) {
@@ -61,6 +64,22 @@ OptionsImpl::OptionsImpl(int argc, char** argv, const std::string& hot_restart_v
                                     "One of 'serve' (default; validate configs and then serve "
                                     "traffic normally) or 'validate' (validate configs and exit).",
                                     false, "serve", "string", cmd);
+  TCLAP::ValueArg<uint64_t> max_stats("", "max-stats",
+                                      "Maximum number of stats in the hot restart shared memory "
+                                      "region",
+                                      false, 16384, "uint64_t", cmd);
+  TCLAP::ValueArg<std::string> worker_cpus("", "worker-cpus",
+                                           "CPUs to pin worker threads to, e.g. '2-5,8'", false, "",
+                                           "string", cmd);
+  TCLAP::ValueArg<std::string> main_thread_cpus(
+      "", "main-thread-cpus", "CPUs to pin the main thread to, e.g. '0,1'", false, "", "string",
+      cmd);
+  TCLAP::SwitchArg memory_accounting("", "memory-accounting",
+                                     "Attribute heap allocations to subsystems", cmd, false);
+  TCLAP::ValueArg<uint32_t> async_log_lines(
+      "", "async-log-lines",
+      "Write log lines from a writer thread, dropping lines once this many are queued", false, 0,
+      "uint32_t", cmd);
 
   try {
     cmd.parse(argc, argv);
@@ -70,7 +89,7 @@ OptionsImpl::OptionsImpl(int argc, char** argv, const std::string& hot_restart_v
   }
 
   if (hot_restart_version_option.getValue()) {
-    std::cerr << hot_restart_version;
+    std::cerr << hot_restart_version_cb(max_stats.getValue());
     exit(0);
   }
 
@@ -112,5 +131,37 @@ OptionsImpl::OptionsImpl(int argc, char** argv, const std::string& hot_restart_v
   file_flush_interval_msec_ = std::chrono::milliseconds(file_flush_interval_msec.getValue());
   drain_time_ = std::chrono::seconds(drain_time_s.getValue());
   parent_shutdown_time_ = std::chrono::seconds(parent_shutdown_time_s.getValue());
+  max_stats_ = max_stats.getValue();
+  memory_accounting_ = memory_accounting.getValue();
+  async_log_lines_ = async_log_lines.getValue();
+
+  if (!parseCpuList(worker_cpus.getValue(), worker_cpus_)) {
+    std::cerr << "error: invalid CPU list '" << worker_cpus.getValue() << "'" << std::endl;
+    exit(1);
+  }
+  if (!parseCpuList(main_thread_cpus.getValue(), main_thread_cpus_)) {
+    std::cerr << "error: invalid CPU list '" << main_thread_cpus.getValue() << "'" << std::endl;
+    exit(1);
+  }
+}
+
+bool OptionsImpl::parseCpuList(const std::string& list, std::vector<uint32_t>& cpus) {
+  // A comma separated list of CPUs and inclusive ranges of CPUs, as used by taskset(1).
+  for (const std::string& item : StringUtil::split(list, ',')) {
+    const std::vector<std::string> bounds = StringUtil::split(item, "-", true);
+    uint64_t first;
+    uint64_t last;
+    if (bounds.empty() || bounds.size() > 2 || !StringUtil::atoul(bounds[0].c_str(), first) ||
+        !StringUtil::atoul(bounds.back().c_str(), last) || first > last ||
+        last > std::numeric_limits<uint16_t>::max()) {
+      return false;
+    }
+
+    for (uint64_t cpu = first; cpu <= last; cpu++) {
+      cpus.push_back(cpu);
+    }
+  }
+
+  return true;
 }
 } // Envoy
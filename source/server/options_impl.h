@@ -2,7 +2,9 @@
 
 #include <chrono>
 #include <cstdint>
+#include <functional>
 #include <string>
+#include <vector>
 
 #include "envoy/server/options.h"
 
@@ -14,7 +16,12 @@ namespace Envoy {
  */
 class OptionsImpl : public Server::Options {
 public:
-  OptionsImpl(int argc, char** argv, const std::string& hot_restart_version,
+  /**
+   * Callback that returns the hot restart compatibility version for a maximum number of stats.
+   */
+  typedef std::function<std::string(uint64_t max_stats)> HotRestartVersionCb;
+
+  OptionsImpl(int argc, char** argv, const HotRestartVersionCb& hot_restart_version_cb,
               spdlog::level::level_enum default_log_level);
 
   const std::string& serviceClusterName() { return service_cluster_; }
@@ -33,8 +40,15 @@ public:
   uint64_t restartEpoch() override { return restart_epoch_; }
   Server::Mode mode() const override { return mode_; }
   std::chrono::milliseconds fileFlushIntervalMsec() override { return file_flush_interval_msec_; }
+  uint64_t maxStats() override { return max_stats_; }
+  const std::vector<uint32_t>& workerCpus() override { return worker_cpus_; }
+  const std::vector<uint32_t>& mainThreadCpus() override { return main_thread_cpus_; }
+  bool memoryAccounting() override { return memory_accounting_; }
+  uint32_t asyncLogLines() override { return async_log_lines_; }
 
 private:
+  static bool parseCpuList(const std::string& list, std::vector<uint32_t>& cpus);
+
   uint64_t base_id_;
   uint32_t concurrency_;
   std::string config_path_;
@@ -49,5 +63,10 @@ private:
   std::chrono::seconds drain_time_;
   std::chrono::seconds parent_shutdown_time_;
   Server::Mode mode_;
+  uint64_t max_stats_;
+  std::vector<uint32_t> worker_cpus_;
+  std::vector<uint32_t> main_thread_cpus_;
+  bool memory_accounting_;
+  uint32_t async_log_lines_;
 };
 } // Envoy
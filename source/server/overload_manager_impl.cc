@@ -0,0 +1,151 @@
+#include "server/overload_manager_impl.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "envoy/common/exception.h"
+
+#include "common/common/assert.h"
+#include "common/http/header_map_impl.h"
+#include "common/json/config_schemas.h"
+#include "common/memory/stats.h"
+
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+namespace Server {
+
+namespace {
+
+const std::array<std::string, 4> ResourceNames{
+    {"heap_size", "active_connections", "event_loop_lag", "buffered_bytes"}};
+const std::array<std::string, 5> ActionNames{
+    {"stop_accepting_connections", "disable_http_keepalive", "reduce_buffer_limits",
+     "shrink_heap", "reset_largest_connections"}};
+
+template <size_t N>
+size_t indexOf(const std::array<std::string, N>& names, const std::string& name) {
+  const auto it = std::find(names.begin(), names.end(), name);
+  // The schema only allows known names.
+  ASSERT(it != names.end());
+  return it - names.begin();
+}
+
+} // namespace
+
+const size_t OverloadManagerImpl::NumResources;
+const size_t OverloadManagerImpl::NumActions;
+
+OverloadManagerImpl::OverloadManagerImpl(const Json::Object& config,
+                                         Event::Dispatcher& dispatcher,
+                                         ThreadLocal::Instance& tls, Stats::Scope& stats_scope)
+    : dispatcher_(dispatcher), tls_(tls) {
+  config.validateSchema(Json::Schema::OVERLOAD_MANAGER_SCHEMA);
+  refresh_interval_ = std::chrono::milliseconds(config.getInteger("refresh_interval_ms", 250));
+  reduced_buffer_limit_bytes_ = config.getInteger("reduced_buffer_limit_bytes", 16384);
+
+  const Json::ObjectSharedPtr resources = config.getObject("resources", true);
+  resources_[static_cast<size_t>(OverloadResource::HeapSize)].max_ =
+      resources->getInteger("heap_size_bytes", 0);
+  resources_[static_cast<size_t>(OverloadResource::ActiveConnections)].max_ =
+      resources->getInteger("active_connections", 0);
+  resources_[static_cast<size_t>(OverloadResource::EventLoopLag)].max_ =
+      resources->getInteger("event_loop_lag_ms", 0);
+  resources_[static_cast<size_t>(OverloadResource::BufferedBytes)].max_ =
+      resources->getInteger("buffered_bytes", 0);
+  for (size_t i = 0; i < NumResources; i++) {
+    if (resources_[i].max_ > 0) {
+      resources_[i].pressure_gauge_ =
+          &stats_scope.gauge(fmt::format("overload.{}.pressure", ResourceNames[i]));
+    }
+  }
+
+  if (config.hasObject("actions")) {
+    for (const Json::ObjectSharedPtr& action_json : config.getObjectArray("actions")) {
+      const std::string name = action_json->getString("name");
+      Action& action = actions_[indexOf(ActionNames, name)];
+      for (const Json::ObjectSharedPtr& trigger_json : action_json->getObjectArray("triggers")) {
+        const std::string resource_name = trigger_json->getString("resource");
+        const size_t resource = indexOf(ResourceNames, resource_name);
+        if (resources_[resource].max_ == 0) {
+          throw EnvoyException(
+              fmt::format("overload action '{}' triggers on resource '{}' which has no maximum",
+                          name, resource_name));
+        }
+        const uint64_t threshold_percent = trigger_json->getInteger("threshold_percent");
+        action.triggers_.push_back({static_cast<OverloadResource>(resource), threshold_percent});
+      }
+      action.active_gauge_ = &stats_scope.gauge(fmt::format("overload.{}.active", name));
+    }
+  }
+}
+
+void OverloadManagerImpl::registerResource(OverloadResource resource, UsageCb usage_cb) {
+  ASSERT(!refresh_timer_);
+  resources_[static_cast<size_t>(resource)].usage_cb_ = usage_cb;
+}
+
+void OverloadManagerImpl::registerForAction(OverloadActionName action,
+                                            Event::Dispatcher& dispatcher, ActionCb cb) {
+  ASSERT(!refresh_timer_);
+  actions_[static_cast<size_t>(action)].callbacks_.push_back({dispatcher, cb});
+}
+
+void OverloadManagerImpl::start() {
+  ASSERT(!refresh_timer_);
+  refresh_timer_ = dispatcher_.createTimer([this]() -> void { refresh(); });
+  refresh();
+}
+
+void OverloadManagerImpl::refresh() {
+  for (Resource& resource : resources_) {
+    if (resource.max_ > 0 && resource.usage_cb_) {
+      resource.pressure_percent_ = resource.usage_cb_() * 100 / resource.max_;
+      resource.pressure_gauge_->set(resource.pressure_percent_);
+    }
+  }
+
+  for (size_t i = 0; i < NumActions; i++) {
+    Action& action = actions_[i];
+    bool active = false;
+    for (const Trigger& trigger : action.triggers_) {
+      if (resources_[static_cast<size_t>(trigger.resource_)].pressure_percent_ >=
+          trigger.threshold_percent_) {
+        active = true;
+        break;
+      }
+    }
+
+    if (active != action.state_.isActive()) {
+      action.state_.setActive(active);
+      action.active_gauge_->set(active ? 1 : 0);
+      onActionChanged(static_cast<OverloadActionName>(i), active);
+    }
+
+    if (active) {
+      for (const Callback& callback : action.callbacks_) {
+        callback.dispatcher_.post(callback.cb_);
+      }
+    }
+  }
+
+  refresh_timer_->enableTimer(refresh_interval_);
+}
+
+void OverloadManagerImpl::onActionChanged(OverloadActionName action, bool active) {
+  log().warn("overload action {} {}", ActionNames[static_cast<size_t>(action)],
+             active ? "activated" : "deactivated");
+
+  if (action == OverloadActionName::ShrinkHeap && active) {
+    // Free memory is released once when the action is activated. Doing it on every refresh while
+    // the pressure lasts would mostly churn the caches that the workers refill right away.
+    tls_.runOnAllThreads([]() -> void { Http::HeaderEntryFreeList::threadLocal().release(); });
+    Memory::Stats::releaseFreeMemory();
+  }
+}
+
+} // Server
+} // Envoy
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
+#include "envoy/json/json_object.h"
+#include "envoy/server/overload_manager.h"
+#include "envoy/stats/stats.h"
+#include "envoy/thread_local/thread_local.h"
+
+#include "common/common/logger.h"
+
+namespace Envoy {
+namespace Server {
+
+/**
+ * Resources watched by the overload manager.
+ */
+enum class OverloadResource {
+  // Bytes allocated from the heap.
+  HeapSize,
+  // Downstream connections open on all workers.
+  ActiveConnections,
+  // How far the most delayed event loop is behind, in milliseconds.
+  EventLoopLag,
+  // Bytes held in the buffers of downstream connections on all workers.
+  BufferedBytes
+};
+
+/**
+ * Overload manager that runs on the main thread. Every refresh interval it reads the usage of each
+ * configured resource, computes its pressure as the percentage of the configured maximum in use,
+ * and switches each action on while any of its triggers is at or above its threshold. Workers only
+ * ever read the resulting action states.
+ */
+class OverloadManagerImpl : Logger::Loggable<Logger::Id::main>, public OverloadManager {
+public:
+  typedef std::function<uint64_t()> UsageCb;
+
+  /**
+   * @param config supplies the overload_manager configuration. Throws EnvoyException if an action
+   *        triggers on a resource that has no configured maximum.
+   */
+  OverloadManagerImpl(const Json::Object& config, Event::Dispatcher& dispatcher,
+                      ThreadLocal::Instance& tls, Stats::Scope& stats_scope);
+
+  /**
+   * Set how the usage of a resource is read. Resources without a configured maximum are never
+   * read. Must be called before start().
+   */
+  void registerResource(OverloadResource resource, UsageCb usage_cb);
+
+  // Server::OverloadManager
+  void start() override;
+  const OverloadActionState& getActionState(OverloadActionName action) override {
+    return actions_[static_cast<size_t>(action)].state_;
+  }
+  uint32_t reducedBufferLimitBytes() override { return reduced_buffer_limit_bytes_; }
+  void registerForAction(OverloadActionName action, Event::Dispatcher& dispatcher,
+                         ActionCb cb) override;
+
+private:
+  static const size_t NumResources = 4;
+  static const size_t NumActions = 5;
+
+  struct Resource {
+    uint64_t max_{};
+    UsageCb usage_cb_;
+    uint64_t pressure_percent_{};
+    Stats::Gauge* pressure_gauge_{};
+  };
+
+  struct Trigger {
+    OverloadResource resource_;
+    uint64_t threshold_percent_;
+  };
+
+  struct Callback {
+    Event::Dispatcher& dispatcher_;
+    ActionCb cb_;
+  };
+
+  struct Action {
+    OverloadActionState state_;
+    std::vector<Trigger> triggers_;
+    std::vector<Callback> callbacks_;
+    Stats::Gauge* active_gauge_{};
+  };
+
+  void refresh();
+  void onActionChanged(OverloadActionName action, bool active);
+
+  Event::Dispatcher& dispatcher_;
+  ThreadLocal::Instance& tls_;
+  std::chrono::milliseconds refresh_interval_;
+  uint32_t reduced_buffer_limit_bytes_;
+  std::array<Resource, NumResources> resources_;
+  std::array<Action, NumActions> actions_;
+  Event::TimerPtr refresh_timer_;
+};
+
+} // Server
+} // Envoy
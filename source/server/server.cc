@@ -2,9 +2,11 @@
 
 #include <signal.h>
 
+#include <chrono>
 #include <cstdint>
 #include <functional>
 #include <string>
+#include <vector>
 
 #include "envoy/event/dispatcher.h"
 #include "envoy/event/signal.h"
@@ -15,10 +17,15 @@
 #include "envoy/upstream/cluster_manager.h"
 
 #include "common/api/api_impl.h"
+#include "common/common/thread.h"
 #include "common/common/utility.h"
 #include "common/common/version.h"
+#include "common/json/config_schemas.h"
+#include "common/json/json_loader.h"
+#include "common/memory/accounting.h"
 #include "common/memory/stats.h"
 #include "common/network/address_impl.h"
+#include "common/network/dns_impl.h"
 #include "common/network/utility.h"
 #include "common/runtime/runtime_impl.h"
 #include "common/stats/statsd.h"
@@ -65,9 +72,10 @@ InstanceImpl::InstanceImpl(Options& options, TestHooks& hooks, HotRestart& resta
                            const LocalInfo::LocalInfo& local_info)
     : options_(options), restarter_(restarter), start_time_(time(nullptr)),
       original_start_time_(start_time_), stats_store_(store),
-      server_stats_{ALL_SERVER_STATS(POOL_GAUGE_PREFIX(stats_store_, "server."))},
-      handler_(log(), Api::ApiPtr{new Api::Impl(options.fileFlushIntervalMsec())}),
-      dns_resolver_(handler_.dispatcher().createDnsResolver({})), local_info_(local_info),
+      server_stats_{ALL_SERVER_STATS(POOL_COUNTER_PREFIX(stats_store_, "server."),
+                                     POOL_GAUGE_PREFIX(stats_store_, "server."))},
+      handler_(log(), Api::ApiPtr{new Api::Impl(options.fileFlushIntervalMsec())}, nullptr),
+      local_info_(local_info),
       access_log_manager_(handler_.api(), handler_.dispatcher(), access_log_lock, store) {
 
   failHealthcheck(false);
@@ -90,7 +98,10 @@ InstanceImpl::InstanceImpl(Options& options, TestHooks& hooks, HotRestart& resta
   }
 }
 
-InstanceImpl::~InstanceImpl() { restarter_.shutdown(); }
+InstanceImpl::~InstanceImpl() {
+  Json::SchemaRegistry::setStatsScope(nullptr);
+  restarter_.shutdown();
+}
 
 Upstream::ClusterManager& InstanceImpl::clusterManager() { return config_->clusterManager(); }
 
@@ -119,36 +130,61 @@ void InstanceImpl::flushStats() {
   server_stats_.memory_allocated_.set(Memory::Stats::totalCurrentlyAllocated() +
                                       info.memory_allocated_);
   server_stats_.memory_heap_size_.set(Memory::Stats::totalCurrentlyReserved());
+  for (size_t i = 0; i < memory_accounting_gauges_.size(); i++) {
+    memory_accounting_gauges_[i]->set(
+        Memory::Accounting::totals(static_cast<Memory::Subsystem>(i)).netBytes());
+  }
   server_stats_.parent_connections_.set(info.num_connections_);
   server_stats_.total_connections_.set(numConnections() + info.num_connections_);
   server_stats_.days_until_first_cert_expiring_.set(
       sslContextManager().daysUntilFirstCertExpires());
+  const uint64_t log_lines_dropped = Logger::Registry::getSink()->droppedLines();
+  server_stats_.log_lines_dropped_.add(log_lines_dropped - log_lines_dropped_);
+  log_lines_dropped_ = log_lines_dropped;
 
-  for (const Stats::CounterSharedPtr& counter : stats_store_.counters()) {
-    uint64_t delta = counter->latch();
-    if (counter->used()) {
-      for (const auto& sink : stat_sinks_) {
-        sink->flushCounter(counter->name(), delta);
-      }
-    }
+  for (const auto& sink : stat_sinks_) {
+    sink->beginFlush();
   }
 
-  for (const Stats::GaugeSharedPtr& gauge : stats_store_.gauges()) {
-    if (gauge->used()) {
+  // Only the counters and gauges that changed since the last flush are visited. Unchanged
+  // counters have nothing to report, and statsd keeps the last value of a gauge that is not
+  // written again.
+  stats_store_.forEachChangedStat(
+      [this](Stats::Counter& counter, uint64_t delta) -> void {
+        for (const auto& sink : stat_sinks_) {
+          sink->flushCounter(counter, delta);
+        }
+      },
+      [this](Stats::Gauge& gauge) -> void {
+        for (const auto& sink : stat_sinks_) {
+          sink->flushGauge(gauge, gauge.value());
+        }
+      });
+
+  for (const Stats::HistogramSharedPtr& histogram : stats_store_.histograms()) {
+    histogram->merge();
+    const Stats::HistogramStatistics& statistics = histogram->intervalStatistics();
+    if (statistics.sampleCount() > 0) {
       for (const auto& sink : stat_sinks_) {
-        sink->flushGauge(gauge->name(), gauge->value());
+        sink->flushHistogram(*histogram, statistics);
       }
     }
   }
 
+  for (const auto& sink : stat_sinks_) {
+    sink->endFlush();
+  }
+
   stat_flush_timer_->enableTimer(config_->statsFlushInterval());
 }
 
 int InstanceImpl::getListenSocketFd(const std::string& address) {
   Network::Address::InstanceConstSharedPtr addr = Network::Utility::resolveUrl(address);
   for (const auto& entry : socket_map_) {
-    if (entry.second->localAddress()->asString() == addr->asString()) {
-      return entry.second->fd();
+    // For SO_REUSEPORT listeners only the first socket is passed on. The child creates the rest
+    // of its per worker sockets itself, and they join the same reuse port group.
+    if (entry.second[0]->localAddress()->asString() == addr->asString()) {
+      return entry.second[0]->fd();
     }
   }
 
@@ -158,7 +194,7 @@ int InstanceImpl::getListenSocketFd(const std::string& address) {
 Network::ListenSocket* InstanceImpl::getListenSocketByIndex(uint32_t index) {
   if (index < config_->listeners().size()) {
     auto it = std::next(config_->listeners().begin(), index);
-    return socket_map_[it->get()].get();
+    return socket_map_[it->get()][0].get();
   }
   return nullptr;
 }
@@ -174,19 +210,54 @@ void InstanceImpl::initialize(Options& options, TestHooks& hooks,
                               ComponentFactory& component_factory) {
   log().warn("initializing epoch {} (hot restart version={})", options.restartEpoch(),
              restarter_.version());
+  phase_start_ = ProdMonotonicTimeSource::instance_.currentTime();
+
+  if (options.memoryAccounting()) {
+    if (Memory::Accounting::enable()) {
+      for (size_t i = 0; i < Memory::Accounting::NumSubsystems; i++) {
+        memory_accounting_gauges_.push_back(&stats_store_.gauge(
+            fmt::format("server.memory_accounting.{}.net_bytes",
+                        Memory::Accounting::name(static_cast<Memory::Subsystem>(i)))));
+      }
+    } else {
+      log().warn("memory accounting requires tcmalloc");
+    }
+  }
+
+  // Record the time spent validating configuration against each of the schemas.
+  Json::Schema::registerNames();
+  Json::SchemaRegistry::setStatsScope(&stats_store_);
 
   // Handle configuration that needs to take place prior to the main configuration load.
   Json::ObjectSharedPtr config_json = Json::Factory::loadFromFile(options.configPath());
+  phaseComplete("parse");
+
+  // Validating clusters and listeners dominates the load of large configs. It is spread across as
+  // many threads as there will be workers, before threading is initialized for stats, and the
+  // objects are then built serially on this thread without validating them again.
+  Configuration::MainImpl::validateSchemas(*config_json, options.concurrency());
+  phaseComplete(fmt::format("schema validation ({} threads)", options.concurrency()));
+
   Configuration::InitialImpl initial_config(*config_json);
   log().info("admin address: {}", initial_config.admin().address()->asString());
 
+  // Tags are extracted when a stat is created, so the producer is set before the admin listener
+  // and the rest of the configuration start creating stats.
+  stats_store_.setTagProducer(initial_config.createTagProducer());
+
   HotRestart::ShutdownParentAdminInfo info;
   info.original_start_time_ = original_start_time_;
   restarter_.shutdownParentAdmin(info);
   original_start_time_ = info.original_start_time_;
+  restarter_.mergeParentHistograms(stats_store_);
   admin_.reset(new AdminImpl(initial_config.admin().accessLogPath(),
                              initial_config.admin().profilePath(), options.adminAddressPath(),
                              initial_config.admin().address(), *this));
+  if (initial_config.admin().profileFrequencyHz() > 0 &&
+      !admin_->cpuProfileRecorder().startContinuous(initial_config.admin().profileFrequencyHz(),
+                                                    initial_config.admin().profileWindow())) {
+    log().warn("unable to start continuous CPU profiling");
+  }
 
   admin_scope_ = stats_store_.createScope("listener.admin.");
   handler_.addListener(*admin_, admin_->mutable_socket(), *admin_scope_,
@@ -194,10 +265,29 @@ void InstanceImpl::initialize(Options& options, TestHooks& hooks,
 
   loadServerFlags(initial_config.flagsPath());
 
+  // Check the CPUs to pin threads to before any thread is pinned, since pinning the main thread
+  // narrows the CPUs it may hand out.
+  const std::vector<uint32_t>& worker_cpus = options.workerCpus();
+  Thread::Thread::checkCpus(worker_cpus);
+  Thread::Thread::checkCpus(options.mainThreadCpus());
+
+  // The overload manager is needed by the workers, but it only starts monitoring once the guard dog
+  // it reads the event loop lag from exists.
+  overload_manager_.reset(
+      new OverloadManagerImpl(*config_json->getObject("overload_manager", true),
+                              handler_.dispatcher(), thread_local_, stats_store_));
+
   // Workers get created first so they register for thread local updates.
   for (uint32_t i = 0; i < std::max(1U, options.concurrency()); i++) {
-    workers_.emplace_back(new Worker(thread_local_, options.fileFlushIntervalMsec()));
+    std::vector<uint32_t> cpus;
+    if (!worker_cpus.empty()) {
+      cpus.push_back(worker_cpus[i % worker_cpus.size()]);
+    }
+    workers_.emplace_back(
+        new Worker(thread_local_, options.fileFlushIntervalMsec(), cpus, *overload_manager_));
+    workers_.back()->dispatcher().initializeStats(stats_store_, fmt::format("server.worker_{}.", i));
   }
+  handler_.dispatcher().initializeStats(stats_store_, "server.main_thread.");
 
   // The main thread is also registered for thread local updates so that code that does not care
   // whether it runs on the main thread or on workers can still use TLS.
@@ -206,6 +296,10 @@ void InstanceImpl::initialize(Options& options, TestHooks& hooks,
   // We can now initialize stats for threading.
   stats_store_.initializeThreading(handler_.dispatcher(), thread_local_);
 
+  // Every thread gets its own resolver so that workers can resolve names without going through the
+  // main thread. The resolvers share their cache and in flight resolutions.
+  dns_resolver_.reset(new Network::ThreadLocalDnsResolverImpl(thread_local_, {}));
+
   // Runtime gets initialized before the main configuration since during main configuration
   // load things may grab a reference to the loader for later use.
   runtime_loader_ = component_factory.createRuntime(*this, initial_config);
@@ -223,23 +317,45 @@ void InstanceImpl::initialize(Options& options, TestHooks& hooks,
       new Configuration::MainImpl(*this, *cluster_manager_factory_);
   config_.reset(main_config);
   main_config->initialize(*config_json);
+  phaseComplete("configuration");
+
+  // First we try to get the sockets from our parent if applicable, all at once rather than one
+  // round trip per listener.
+  std::vector<std::string> addresses;
+  for (const Configuration::ListenerPtr& listener : config_->listeners()) {
+    ASSERT(listener->address()->type() == Network::Address::Type::Ip);
+    addresses.push_back(fmt::format("tcp://{}", listener->address()->asString()));
+  }
+  const std::vector<int> parent_fds = restarter_.duplicateParentListenSockets(addresses);
+  ASSERT(parent_fds.size() == addresses.size());
 
+  size_t listener_index = 0;
   for (const Configuration::ListenerPtr& listener : config_->listeners()) {
-    // For each listener config we share a single TcpListenSocket among all threaded listeners.
+    // For each listener config we share a single TcpListenSocket among all threaded listeners,
+    // unless the listener uses SO_REUSEPORT in which case each worker gets a socket of its own.
     // UdsListenerSockets are not managed and do not participate in hot restart as they are only
     // used for testing.
+    std::vector<Network::TcpListenSocketPtr>& sockets = socket_map_[listener.get()];
+    const bool reuse_port = listener->reusePort() && listener->bindToPort();
 
-    // First we try to get the socket from our parent if applicable.
-
-    ASSERT(listener->address()->type() == Network::Address::Type::Ip);
-    std::string addr = fmt::format("tcp://{}", listener->address()->asString());
-    int fd = restarter_.duplicateParentListenSocket(addr);
+    const int fd = parent_fds[listener_index];
     if (fd != -1) {
-      log().info("obtained socket for address {} from parent", addr);
-      socket_map_[listener.get()].reset(new Network::TcpListenSocket(fd, listener->address()));
-    } else {
-      socket_map_[listener.get()].reset(
-          new Network::TcpListenSocket(listener->address(), listener->bindToPort()));
+      log().info("obtained socket for address {} from parent", addresses[listener_index]);
+      sockets.emplace_back(new Network::TcpListenSocket(fd, listener->address()));
+    }
+    listener_index++;
+
+    // Any further reuse port sockets bind to the address of the first one, which matters if the
+    // configured port is zero.
+    const size_t num_sockets = reuse_port ? workers_.size() : 1;
+    while (sockets.size() < num_sockets) {
+      sockets.emplace_back(new Network::TcpListenSocket(
+          sockets.empty() ? listener->address() : sockets[0]->localAddress(),
+          listener->bindToPort(), reuse_port));
+    }
+
+    if (reuse_port && listener->reusePortCpuSteering()) {
+      sockets[0]->steerReusePortByCpu(num_sockets);
     }
   }
 
@@ -268,23 +384,52 @@ void InstanceImpl::initialize(Options& options, TestHooks& hooks,
 
   // GuardDog (deadlock detection) object and thread setup before workers are
   // started and before our own run() loop runs.
-  guard_dog_.reset(
-      new Server::GuardDogImpl(*admin_scope_, *config_, ProdMonotonicTimeSource::instance_));
+  GuardDogImpl* guard_dog =
+      new Server::GuardDogImpl(*admin_scope_, *config_, ProdMonotonicTimeSource::instance_);
+  guard_dog_.reset(guard_dog);
+  admin_->addHandler("/watchdog_stalls", "print stack samples of recently stalled threads",
+                     [guard_dog](const std::string&, Buffer::Instance& response) -> Http::Code {
+                       response.add(guard_dog->stallReport());
+                       return Http::Code::OK;
+                     });
+
+  overload_manager_->registerResource(OverloadResource::HeapSize, []() -> uint64_t {
+    return Memory::Stats::totalCurrentlyAllocated();
+  });
+  overload_manager_->registerResource(OverloadResource::ActiveConnections,
+                                      [this]() -> uint64_t { return numConnections(); });
+  overload_manager_->registerResource(OverloadResource::EventLoopLag, [this]() -> uint64_t {
+    return guard_dog_->eventLoopLag().count();
+  });
+  overload_manager_->registerResource(OverloadResource::BufferedBytes, [this]() -> uint64_t {
+    uint64_t buffered_bytes = 0;
+    for (const WorkerPtr& worker : workers_) {
+      buffered_bytes += worker->bufferedBytes();
+    }
+    return buffered_bytes;
+  });
+  overload_manager_->start();
 
   // Register for cluster manager init notification. We don't start serving worker traffic until
   // upstream clusters are initialized which may involve running the event loop. Note however that
   // this can fire immediately if all clusters have already initialized.
+  phaseComplete("initialization");
   clusterManager().setInitializedCb([this, &hooks]() -> void {
+    phaseComplete("cluster initialization");
     log().warn("all clusters initialized. initializing init manager");
-    init_manager_.initialize([this, &hooks]() -> void { startWorkers(hooks); });
+    init_manager_.initialize([this, &hooks]() -> void {
+      phaseComplete("init manager");
+      startWorkers(hooks);
+    });
   });
 }
 
 void InstanceImpl::startWorkers(TestHooks& hooks) {
   log().warn("all dependencies initialized. starting workers");
+  uint32_t index = 0;
   for (const WorkerPtr& worker : workers_) {
     try {
-      worker->initializeConfiguration(*config_, socket_map_, *guard_dog_);
+      worker->initializeConfiguration(*config_, socket_map_, index++, *guard_dog_);
     } catch (const Network::CreateListenerException& e) {
       // It is possible that we fail to start listening on a port, even though we were able to
       // bind to it above. This happens when there is a race between two applications to listen
@@ -295,13 +440,29 @@ void InstanceImpl::startWorkers(TestHooks& hooks) {
     }
   }
 
+  // The main thread is pinned only once the workers are running, so that workers without CPUs of
+  // their own don't inherit its affinity.
+  if (!options_.mainThreadCpus().empty()) {
+    Thread::Thread::setCurrentThreadAffinity(options_.mainThreadCpus());
+  }
+
   // At this point we are ready to take traffic and all listening ports are up. Notify our parent
   // if applicable that they can stop listening and drain.
+  phaseComplete("workers");
+
   restarter_.drainParentListeners();
   drain_manager_->startParentShutdownSequence();
   hooks.onServerInitialized();
 }
 
+void InstanceImpl::phaseComplete(const std::string& phase) {
+  const MonotonicTime now = ProdMonotonicTimeSource::instance_.currentTime();
+  startup_phase_times_.emplace_back(
+      phase, std::chrono::duration_cast<std::chrono::milliseconds>(now - phase_start_));
+  log().info("startup phase {} took {}ms", phase, startup_phase_times_.back().second.count());
+  phase_start_ = now;
+}
+
 Runtime::LoaderPtr InstanceUtil::createRuntime(Instance& server,
                                                Server::Configuration::Initial& config) {
   if (config.runtime()) {
@@ -325,8 +486,8 @@ void InstanceImpl::initializeStatSinks() {
     log().info("statsd UDP ip address: {}", config_->statsdUdpIpAddress().value());
     stat_sinks_.emplace_back(new Stats::Statsd::UdpStatsdSink(
         thread_local_,
-        Network::Utility::parseInternetAddressAndPort(config_->statsdUdpIpAddress().value())));
-    stats_store_.addSink(*stat_sinks_.back());
+        Network::Utility::parseInternetAddressAndPort(config_->statsdUdpIpAddress().value()),
+        config_->statsdUdpMaxDatagramSize()));
   } else if (config_->statsdUdpPort().valid()) {
     // TODO(hennna): DEPRECATED - statsdUdpPort will be removed in 1.4.0.
     log().warn("statsd_local_udp_port has been DEPRECATED and will be removed in 1.4.0. "
@@ -334,8 +495,8 @@ void InstanceImpl::initializeStatSinks() {
     log().info("statsd UDP port: {}", config_->statsdUdpPort().value());
     Network::Address::InstanceConstSharedPtr address(
         new Network::Address::Ipv4Instance(config_->statsdUdpPort().value()));
-    stat_sinks_.emplace_back(new Stats::Statsd::UdpStatsdSink(thread_local_, address));
-    stats_store_.addSink(*stat_sinks_.back());
+    stat_sinks_.emplace_back(new Stats::Statsd::UdpStatsdSink(
+        thread_local_, address, config_->statsdUdpMaxDatagramSize()));
   }
 
   if (config_->statsdTcpClusterName().valid()) {
@@ -343,7 +504,6 @@ void InstanceImpl::initializeStatSinks() {
     stat_sinks_.emplace_back(
         new Stats::Statsd::TcpStatsdSink(local_info_, config_->statsdTcpClusterName().value(),
                                          thread_local_, config_->clusterManager(), stats_store_));
-    stats_store_.addSink(*stat_sinks_.back());
   }
 }
 
@@ -8,6 +8,7 @@
 #include <string>
 
 #include "envoy/common/optional.h"
+#include "envoy/common/time.h"
 #include "envoy/server/drain_manager.h"
 #include "envoy/server/instance.h"
 #include "envoy/ssl/context_manager.h"
@@ -22,6 +23,7 @@
 
 #include "server/connection_handler_impl.h"
 #include "server/http/admin.h"
+#include "server/overload_manager_impl.h"
 #include "server/test_hooks.h"
 #include "server/worker.h"
 
@@ -32,7 +34,7 @@ namespace Server {
  * All server wide stats. @see stats_macros.h
  */
 // clang-format off
-#define ALL_SERVER_STATS(GAUGE)                                                                    \
+#define ALL_SERVER_STATS(COUNTER, GAUGE)                                                           \
   GAUGE(uptime)                                                                                    \
   GAUGE(memory_allocated)                                                                          \
   GAUGE(memory_heap_size)                                                                          \
@@ -40,11 +42,12 @@ namespace Server {
   GAUGE(parent_connections)                                                                        \
   GAUGE(total_connections)                                                                         \
   GAUGE(version)                                                                                   \
-  GAUGE(days_until_first_cert_expiring)
+  GAUGE(days_until_first_cert_expiring)                                                            \
+  COUNTER(log_lines_dropped)
 // clang-format on
 
 struct ServerStats {
-  ALL_SERVER_STATS(GENERATE_GAUGE_STRUCT)
+  ALL_SERVER_STATS(GENERATE_COUNTER_STRUCT, GENERATE_GAUGE_STRUCT)
 };
 
 /**
@@ -125,6 +128,7 @@ public:
   void getParentStats(HotRestart::GetParentStatsInfo& info) override;
   HotRestart& hotRestart() override { return restarter_; }
   Init::Manager& initManager() override { return init_manager_; }
+  uint64_t numConnections() override;
   Runtime::RandomGenerator& random() override { return random_generator_; }
   RateLimit::ClientPtr
   rateLimitClient(const Optional<std::chrono::milliseconds>& timeout) override {
@@ -135,8 +139,10 @@ public:
   void shutdownAdmin() override;
   bool healthCheckFailed() override;
   Options& options() override { return options_; }
+  OverloadManager& overloadManager() override { return *overload_manager_; }
   time_t startTimeCurrentEpoch() override { return start_time_; }
   time_t startTimeFirstEpoch() override { return original_start_time_; }
+  const StartupPhaseTimes& startupPhaseTimes() override { return startup_phase_times_; }
   Stats::Store& stats() override { return stats_store_; }
   Tracing::HttpTracer& httpTracer() override;
   ThreadLocal::Instance& threadLocal() override { return thread_local_; }
@@ -147,16 +153,24 @@ private:
   void initialize(Options& options, TestHooks& hooks, ComponentFactory& component_factory);
   void initializeStatSinks();
   void loadServerFlags(const Optional<std::string>& flags_path);
-  uint64_t numConnections();
+  void phaseComplete(const std::string& phase);
   void startWorkers(TestHooks& hooks);
 
   Options& options_;
   HotRestart& restarter_;
   const time_t start_time_;
   time_t original_start_time_;
+  // Startup is timed from the start of initialize() until the workers are started.
+  MonotonicTime phase_start_;
+  StartupPhaseTimes startup_phase_times_;
   Stats::StoreRoot& stats_store_;
   std::list<Stats::SinkPtr> stat_sinks_;
   ServerStats server_stats_;
+  // The lines dropped by the log sink as of the last stats flush.
+  uint64_t log_lines_dropped_{};
+  // The net bytes of each subsystem, indexed by Memory::Subsystem. Empty unless memory accounting
+  // is on.
+  std::vector<Stats::Gauge*> memory_accounting_gauges_;
   ThreadLocal::InstanceImpl thread_local_;
   SocketMap socket_map_;
   ConnectionHandlerImpl handler_;
@@ -178,6 +192,7 @@ private:
   std::unique_ptr<Upstream::ProdClusterManagerFactory> cluster_manager_factory_;
   InitManagerImpl init_manager_;
   std::unique_ptr<Server::GuardDog> guard_dog_;
+  std::unique_ptr<OverloadManagerImpl> overload_manager_;
 };
 
 } // Server
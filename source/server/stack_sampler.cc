@@ -0,0 +1,126 @@
+#include "server/stack_sampler.h"
+
+#include <cxxabi.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "common/common/assert.h"
+
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+namespace Server {
+
+namespace {
+
+// State of the sample in flight. The sampler moves Idle -> Requested before signalling the target
+// and the handler moves Requested -> Capturing -> Done. If the handler does not run in time the
+// sampler takes the request back with Requested -> Idle, so a late handler finds nothing to do.
+enum class SampleState : int { Idle, Requested, Capturing, Done };
+
+std::atomic<SampleState> sample_state{SampleState::Idle};
+std::atomic<int32_t> sample_thread_id{0};
+void* sample_frames[StackSampler::MaxDepth];
+int sample_depth;
+
+// The handler frame and the signal trampoline are at the top of every sample.
+const int SkippedFrames = 2;
+
+int sampleSignal() { return SIGRTMIN; }
+
+void sampleHandler(int, siginfo_t*, void*) {
+  const int saved_errno = errno;
+  if (static_cast<int32_t>(syscall(SYS_gettid)) == sample_thread_id.load()) {
+    SampleState expected = SampleState::Requested;
+    if (sample_state.compare_exchange_strong(expected, SampleState::Capturing)) {
+      // backtrace() is async signal safe once libgcc is loaded, which the constructor ensures.
+      sample_depth = backtrace(sample_frames, StackSampler::MaxDepth);
+      sample_state.store(SampleState::Done);
+    }
+  }
+  errno = saved_errno;
+}
+
+} // namespace
+
+StackSampler::StackSampler() {
+  // The first backtrace() call loads libgcc, which allocates. Do it here rather than in the
+  // handler.
+  void* warmup[1];
+  backtrace(warmup, 1);
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_sigaction = sampleHandler;
+  action.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  RELEASE_ASSERT(sigaction(sampleSignal(), &action, nullptr) == 0);
+}
+
+StackSampler::~StackSampler() { signal(sampleSignal(), SIG_IGN); }
+
+bool StackSampler::capture(int32_t thread_id, std::chrono::milliseconds timeout, Stack& stack) {
+  ASSERT(sample_state.load() == SampleState::Idle);
+  sample_thread_id.store(thread_id);
+  sample_state.store(SampleState::Requested);
+  if (syscall(SYS_tgkill, getpid(), thread_id, sampleSignal()) != 0) {
+    sample_state.store(SampleState::Idle);
+    return false;
+  }
+
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  while (sample_state.load() != SampleState::Done) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      SampleState expected = SampleState::Requested;
+      if (sample_state.compare_exchange_strong(expected, SampleState::Idle)) {
+        return false;
+      }
+      // The handler is already capturing, and it does not block, so wait for it to finish.
+    }
+    std::this_thread::yield();
+  }
+
+  stack.depth_ = 0;
+  for (int i = SkippedFrames; i < sample_depth; i++) {
+    stack.frames_[stack.depth_++] = sample_frames[i];
+  }
+  sample_state.store(SampleState::Idle);
+  return true;
+}
+
+std::vector<std::string> StackSampler::symbolize(const Stack& stack) {
+  std::vector<std::string> lines;
+  char** symbols =
+      backtrace_symbols(const_cast<void* const*>(stack.frames_.data()), stack.depth_);
+  for (size_t i = 0; i < stack.depth_; i++) {
+    // backtrace_symbols() formats a frame as "object(mangled+offset) [address]".
+    std::string symbol = symbols != nullptr ? symbols[i] : "";
+    const size_t begin = symbol.find('(');
+    const size_t end = symbol.find('+', begin);
+    if (begin != std::string::npos && end != std::string::npos && end > begin + 1) {
+      const std::string mangled = symbol.substr(begin + 1, end - begin - 1);
+      int status;
+      char* demangled = abi::__cxa_demangle(mangled.c_str(), nullptr, nullptr, &status);
+      if (status == 0) {
+        symbol = demangled;
+      } else {
+        symbol = mangled;
+      }
+      free(demangled);
+    }
+    lines.push_back(fmt::format("{} {}", stack.frames_[i], symbol));
+  }
+  free(symbols);
+  return lines;
+}
+
+} // Server
+} // Envoy
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Envoy {
+namespace Server {
+
+/**
+ * Captures the stack of another thread of this process. The target thread is interrupted with a
+ * real time signal whose handler records the raw return addresses into a static buffer; nothing
+ * is allocated or locked on the target thread, so a thread that is stuck while holding the
+ * allocator or another lock can still be sampled. Addresses are resolved to symbols later with
+ * symbolize(), off the sampled thread.
+ *
+ * Only one sample can be in flight at a time. A process has a single sampler, owned by whoever
+ * detects stalled threads (the GuardDog), and capture() is only called from one thread.
+ */
+class StackSampler {
+public:
+  static const size_t MaxDepth = 64;
+
+  struct Stack {
+    std::array<void*, MaxDepth> frames_;
+    size_t depth_{};
+  };
+
+  StackSampler();
+  ~StackSampler();
+
+  /**
+   * Capture the stack of a thread of this process.
+   * @param thread_id supplies the kernel id of the thread to sample.
+   * @param timeout supplies how long to wait for the thread to run the signal handler.
+   * @param stack supplies the stack to fill.
+   * @return bool whether the stack was captured. A thread that does not exist any more, or that
+   *         has the signal blocked, is not captured.
+   */
+  bool capture(int32_t thread_id, std::chrono::milliseconds timeout, Stack& stack);
+
+  /**
+   * Resolve the frames of a captured stack to "address symbol" lines, demangling C++ symbols.
+   * Frames without a symbol are returned with the address and object name only.
+   */
+  static std::vector<std::string> symbolize(const Stack& stack);
+};
+
+} // Server
+} // Envoy
@@ -1,6 +1,8 @@
 #include "server/worker.h"
 
 #include <chrono>
+#include <cstdint>
+#include <vector>
 
 #include "envoy/event/dispatcher.h"
 #include "envoy/event/timer.h"
@@ -11,28 +13,37 @@
 #include "common/common/thread.h"
 
 namespace Envoy {
-Worker::Worker(ThreadLocal::Instance& tls, std::chrono::milliseconds file_flush_interval_msec)
+Worker::Worker(ThreadLocal::Instance& tls, std::chrono::milliseconds file_flush_interval_msec,
+               const std::vector<uint32_t>& cpus, Server::OverloadManager& overload_manager)
     : tls_(tls), handler_(new Server::ConnectionHandlerImpl(
-                     log(), Api::ApiPtr{new Api::Impl(file_flush_interval_msec)})) {
+                     log(), Api::ApiPtr{new Api::Impl(file_flush_interval_msec)},
+                     &overload_manager)),
+      cpus_(cpus) {
   tls_.registerThread(handler_->dispatcher(), false);
 }
 
 Worker::~Worker() {}
 
 void Worker::initializeConfiguration(Server::Configuration::Main& config,
-                                     const SocketMap& socket_map, Server::GuardDog& guard_dog) {
+                                     const SocketMap& socket_map, uint32_t index,
+                                     Server::GuardDog& guard_dog) {
   for (const Server::Configuration::ListenerPtr& listener : config.listeners()) {
+    const std::vector<Network::TcpListenSocketPtr>& sockets = socket_map.at(listener.get());
+    Network::ListenSocket& socket = *sockets[sockets.size() == 1 ? 0 : index];
     const Network::ListenerOptions listener_options = {
         .bind_to_port_ = listener->bindToPort(),
         .use_proxy_proto_ = listener->useProxyProto(),
         .use_original_dst_ = listener->useOriginalDst(),
-        .per_connection_buffer_limit_bytes_ = listener->perConnectionBufferLimitBytes()};
+        .per_connection_buffer_limit_bytes_ = listener->perConnectionBufferLimitBytes(),
+        .connection_balancer_ = listener->connectionBalancer(),
+        .inspect_tls_client_hello_ = listener->inspectTlsClientHello(),
+        .socket_options_ = listener->socketOptions()};
     if (listener->sslContext()) {
-      handler_->addSslListener(listener->filterChainFactory(), *listener->sslContext(),
-                               *socket_map.at(listener.get()), listener->scope(), listener_options);
+      handler_->addSslListener(listener->filterChainFactory(), *listener->sslContext(), socket,
+                               listener->scope(), listener_options);
     } else {
-      handler_->addListener(listener->filterChainFactory(), *socket_map.at(listener.get()),
-                            listener->scope(), listener_options);
+      handler_->addListener(listener->filterChainFactory(), socket, listener->scope(),
+                            listener_options);
     }
   }
 
@@ -41,7 +52,8 @@ void Worker::initializeConfiguration(Server::Configuration::Main& config,
   no_exit_timer_ = handler_->dispatcher().createTimer([this]() -> void { onNoExitTimer(); });
   onNoExitTimer();
 
-  thread_.reset(new Thread::Thread([this, &guard_dog]() -> void { threadRoutine(guard_dog); }));
+  thread_.reset(
+      new Thread::Thread([this, &guard_dog]() -> void { threadRoutine(guard_dog); }, cpus_));
 }
 
 void Worker::exit() {
@@ -1,10 +1,14 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
+#include <map>
 #include <memory>
+#include <vector>
 
 #include "envoy/server/configuration.h"
 #include "envoy/server/guarddog.h"
+#include "envoy/server/overload_manager.h"
 #include "envoy/thread_local/thread_local.h"
 
 #include "common/common/thread.h"
@@ -13,20 +17,43 @@
 #include "server/connection_handler_impl.h"
 
 namespace Envoy {
-typedef std::map<Server::Configuration::Listener*, Network::TcpListenSocketPtr> SocketMap;
+/**
+ * The listen sockets of each listener. A listener that uses SO_REUSEPORT has one socket per worker,
+ * indexed by worker. Any other listener has a single socket that is shared by all workers.
+ */
+typedef std::map<Server::Configuration::Listener*, std::vector<Network::TcpListenSocketPtr>>
+    SocketMap;
 
 /**
  * A server threaded worker that wraps up a worker thread, event loop, etc.
  */
 class Worker : Logger::Loggable<Logger::Id::main> {
 public:
-  Worker(ThreadLocal::Instance& tls, std::chrono::milliseconds file_flush_interval_msec);
+  /**
+   * @param cpus supplies the CPUs the worker thread may run on, or an empty list to not pin it.
+   * @param overload_manager supplies the overload manager whose actions apply to the worker's
+   *        connections.
+   */
+  Worker(ThreadLocal::Instance& tls, std::chrono::milliseconds file_flush_interval_msec,
+         const std::vector<uint32_t>& cpus, Server::OverloadManager& overload_manager);
   ~Worker();
 
   Event::Dispatcher& dispatcher() { return handler_->dispatcher(); }
   Network::ConnectionHandler* handler() { return handler_.get(); }
+
+  /**
+   * @return uint64_t the bytes held in the buffers of the worker's connections. Called from the
+   *         main thread.
+   */
+  uint64_t bufferedBytes() { return handler_->bufferedBytes(); }
+
+  /**
+   * Start listening and enter the worker's dispatch loop.
+   * @param index supplies the index of the worker, used to pick the worker's own socket for
+   *        listeners that have a socket per worker.
+   */
   void initializeConfiguration(Server::Configuration::Main& config, const SocketMap& socket_map,
-                               Server::GuardDog& guard_dog);
+                               uint32_t index, Server::GuardDog& guard_dog);
 
   /**
    * Exit the worker. Will block until the worker thread joins. Called from the main thread.
@@ -40,6 +67,7 @@ private:
   ThreadLocal::Instance& tls_;
   Server::ConnectionHandlerImplPtr handler_;
   Event::TimerPtr no_exit_timer_;
+  const std::vector<uint32_t> cpus_;
   Thread::ThreadPtr thread_;
 };
 
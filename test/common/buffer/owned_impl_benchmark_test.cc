@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include "common/buffer/buffer_impl.h"
+
+#include "gtest/gtest.h"
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+namespace Buffer {
+
+/**
+ * This test is for benchmarking only and should not be run as part of unit tests. It measures the
+ * buffer operations on the proxy data path: appending socket reads, moving data between the
+ * connection and codec buffers, draining what was written, and searching for a delimiter.
+ */
+class DISABLED_OwnedImplBenchmark : public testing::Test {
+public:
+  static const uint32_t NumIterations = 100000;
+  static const uint32_t ChunkSize = 1024;
+  static const uint32_t ChunksPerBuffer = 16;
+
+  template <class Op> void run(const std::string& name, Op op) {
+    uint64_t checksum = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NumIterations; i++) {
+      checksum += op();
+    }
+    std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_NE(0U, checksum);
+    std::cout << fmt::format("{}: {}ns/op", name, elapsed.count() / NumIterations) << std::endl;
+  }
+
+  void fill(OwnedImpl& buffer) {
+    for (uint32_t i = 0; i < ChunksPerBuffer; i++) {
+      buffer.add(chunk_.data(), chunk_.size());
+    }
+  }
+
+  const std::string chunk_ = std::string(ChunkSize, 'a');
+};
+
+const uint32_t DISABLED_OwnedImplBenchmark::NumIterations;
+const uint32_t DISABLED_OwnedImplBenchmark::ChunkSize;
+const uint32_t DISABLED_OwnedImplBenchmark::ChunksPerBuffer;
+
+TEST_F(DISABLED_OwnedImplBenchmark, Add) {
+  OwnedImpl buffer;
+  run("buffer_add_16k", [&]() -> uint64_t {
+    fill(buffer);
+    const uint64_t length = buffer.length();
+    buffer.drain(length);
+    return length;
+  });
+}
+
+TEST_F(DISABLED_OwnedImplBenchmark, Move) {
+  OwnedImpl source;
+  OwnedImpl destination;
+  run("buffer_move_16k", [&]() -> uint64_t {
+    fill(source);
+    destination.move(source);
+    const uint64_t length = destination.length();
+    destination.drain(length);
+    return length;
+  });
+  run("buffer_move_partial_16k", [&]() -> uint64_t {
+    fill(source);
+    // Move less than a chunk at a time, as a codec does when a frame ends mid slice.
+    while (source.length() > 0) {
+      destination.move(source, std::min<uint64_t>(source.length(), ChunkSize - 100));
+    }
+    const uint64_t length = destination.length();
+    destination.drain(length);
+    return length;
+  });
+}
+
+TEST_F(DISABLED_OwnedImplBenchmark, Drain) {
+  OwnedImpl buffer;
+  run("buffer_drain_small_16k", [&]() -> uint64_t {
+    fill(buffer);
+    // Drain in small pieces, as a writer does after a short write.
+    uint64_t drains = 0;
+    while (buffer.length() > 0) {
+      buffer.drain(std::min<uint64_t>(buffer.length(), 100));
+      drains++;
+    }
+    return drains;
+  });
+}
+
+TEST_F(DISABLED_OwnedImplBenchmark, Search) {
+  OwnedImpl buffer;
+  fill(buffer);
+  buffer.add("\r\n\r\n");
+  run("buffer_search_16k",
+      [&]() -> uint64_t { return static_cast<uint64_t>(buffer.search("\r\n\r\n", 4, 0)); });
+}
+
+} // Buffer
+} // Envoy
@@ -0,0 +1,424 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "common/buffer/buffer_impl.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Buffer {
+
+static std::string bufferToString(const Instance& buffer) {
+  std::string output;
+  uint64_t num_slices = buffer.getRawSlices(nullptr, 0);
+  RawSlice slices[num_slices];
+  buffer.getRawSlices(slices, num_slices);
+  for (RawSlice& slice : slices) {
+    output.append(static_cast<const char*>(slice.mem_), slice.len_);
+  }
+  return output;
+}
+
+TEST(OwnedImplTest, AddAndDrain) {
+  OwnedImpl buffer;
+  EXPECT_EQ(0UL, buffer.length());
+  EXPECT_EQ(0UL, buffer.getRawSlices(nullptr, 0));
+
+  buffer.add("hello");
+  buffer.add(std::string(" world"));
+  EXPECT_EQ(11UL, buffer.length());
+  EXPECT_EQ("hello world", bufferToString(buffer));
+
+  buffer.drain(6);
+  EXPECT_EQ("world", bufferToString(buffer));
+  buffer.drain(5);
+  EXPECT_EQ(0UL, buffer.length());
+  EXPECT_EQ(0UL, buffer.getRawSlices(nullptr, 0));
+}
+
+TEST(OwnedImplTest, LargeAddSpansSlices) {
+  std::string data(100000, 'a');
+  data[50000] = 'b';
+  OwnedImpl buffer;
+  buffer.add("x");
+  buffer.add(data);
+  EXPECT_EQ(100001UL, buffer.length());
+  EXPECT_EQ("x" + data, bufferToString(buffer));
+  EXPECT_EQ(50001, buffer.search("b", 1, 0));
+}
+
+TEST(OwnedImplTest, ReserveCommit) {
+  OwnedImpl buffer;
+  RawSlice iovec;
+  EXPECT_EQ(1UL, buffer.reserve(100, &iovec, 1));
+  EXPECT_GE(iovec.len_, 100UL);
+  memcpy(iovec.mem_, "abc", 3);
+  iovec.len_ = 3;
+  buffer.commit(&iovec, 1);
+  EXPECT_EQ("abc", bufferToString(buffer));
+
+  // A split reservation can use the tail of the existing slice.
+  RawSlice iovecs[2];
+  uint64_t num_iovecs = buffer.reserve(100000, iovecs, 2);
+  EXPECT_EQ(2UL, num_iovecs);
+  EXPECT_EQ(static_cast<char*>(iovec.mem_) + 3, iovecs[0].mem_);
+  memset(iovecs[0].mem_, 'd', iovecs[0].len_);
+  memset(iovecs[1].mem_, 'e', 10);
+  iovecs[1].len_ = 10;
+  buffer.commit(iovecs, 2);
+  EXPECT_EQ(3 + iovecs[0].len_ + 10, buffer.length());
+  EXPECT_EQ("abc" + std::string(iovecs[0].len_, 'd') + std::string(10, 'e'),
+            bufferToString(buffer));
+
+  // Uncommitted reservations do not show up in the buffer.
+  uint64_t length = buffer.length();
+  buffer.reserve(16384, iovecs, 2);
+  EXPECT_EQ(length, buffer.length());
+  EXPECT_EQ(2UL, buffer.getRawSlices(nullptr, 0));
+}
+
+TEST(OwnedImplTest, CommitFreesUnusedReservation) {
+  OwnedImpl buffer("abc");
+  RawSlice iovecs[2];
+  EXPECT_EQ(2UL, buffer.reserve(100000, iovecs, 2));
+  memset(iovecs[0].mem_, 'd', 1);
+  iovecs[0].len_ = 1;
+  buffer.commit(iovecs, 1);
+  EXPECT_EQ("abcd", bufferToString(buffer));
+
+  // The slice allocated for the rest of the reservation is gone, so the next reservation continues
+  // in the first slice.
+  RawSlice iovec;
+  EXPECT_EQ(1UL, buffer.reserve(1, &iovec, 1));
+  EXPECT_EQ(static_cast<uint8_t*>(iovecs[0].mem_) + 1, iovec.mem_);
+
+  // The same happens when nothing is committed at all.
+  EXPECT_EQ(1UL, buffer.reserve(100000, &iovec, 1));
+  EXPECT_NE(static_cast<uint8_t*>(iovecs[0].mem_) + 1, iovec.mem_);
+  buffer.commit(&iovec, 0);
+  EXPECT_EQ(1UL, buffer.reserve(1, &iovec, 1));
+  EXPECT_EQ(static_cast<uint8_t*>(iovecs[0].mem_) + 1, iovec.mem_);
+  EXPECT_EQ("abcd", bufferToString(buffer));
+}
+
+TEST(OwnedImplTest, Linearize) {
+  OwnedImpl buffer;
+  RawSlice iovec;
+  buffer.reserve(10, &iovec, 1);
+  memset(iovec.mem_, 'a', iovec.len_);
+  buffer.commit(&iovec, 1);
+  buffer.add("bcd");
+  EXPECT_EQ(2UL, buffer.getRawSlices(nullptr, 0));
+
+  std::string expected = std::string(iovec.len_, 'a') + "bc";
+  void* mem = buffer.linearize(expected.size());
+  EXPECT_EQ(expected, std::string(static_cast<char*>(mem), expected.size()));
+  EXPECT_EQ(expected + "d", bufferToString(buffer));
+}
+
+TEST(OwnedImplTest, Move) {
+  OwnedImpl buffer1("hello");
+  OwnedImpl buffer2(" world");
+  buffer1.move(buffer2);
+  EXPECT_EQ(0UL, buffer2.length());
+  EXPECT_EQ("hello world", bufferToString(buffer1));
+
+  // Large slices are moved without copying.
+  std::string data(8192, 'a');
+  OwnedImpl buffer3(data);
+  RawSlice slice;
+  buffer3.getRawSlices(&slice, 1);
+  buffer1.move(buffer3);
+  EXPECT_EQ(2UL, buffer1.getRawSlices(nullptr, 0));
+  RawSlice slices[2];
+  buffer1.getRawSlices(slices, 2);
+  EXPECT_EQ(slice.mem_, slices[1].mem_);
+}
+
+TEST(OwnedImplTest, MovePartial) {
+  std::string data(8192, 'a');
+  OwnedImpl source("hello");
+  source.add(data);
+  source.add(OwnedImpl(std::string(8192, 'b')));
+
+  OwnedImpl destination;
+  destination.move(source, 3);
+  EXPECT_EQ("hel", bufferToString(destination));
+  EXPECT_EQ(5UL + 8192 * 2 - 3, source.length());
+
+  destination.move(source, source.length() - 1);
+  EXPECT_EQ("b", bufferToString(source));
+  EXPECT_EQ("hello" + data + std::string(8191, 'b'), bufferToString(destination));
+}
+
+TEST(OwnedImplTest, MovePartialSplitsSlice) {
+  OwnedImpl source(std::string(8192, 'a') + std::string(100, 'b'));
+  ASSERT_EQ(1UL, source.getRawSlices(nullptr, 0));
+  RawSlice slice;
+  source.getRawSlices(&slice, 1);
+
+  // The slice moves and the 100 bytes left behind are copied into a new slice.
+  OwnedImpl destination("x");
+  destination.move(source, 8192);
+  EXPECT_EQ(std::string(100, 'b'), bufferToString(source));
+  EXPECT_EQ("x" + std::string(8192, 'a'), bufferToString(destination));
+  RawSlice slices[2];
+  ASSERT_EQ(2UL, destination.getRawSlices(slices, 2));
+  EXPECT_EQ(slice.mem_, slices[1].mem_);
+  EXPECT_EQ(8192UL, slices[1].len_);
+
+  // The slice was truncated, so data added to the destination does not overwrite the source.
+  destination.add("y");
+  EXPECT_EQ(std::string(100, 'b'), bufferToString(source));
+  EXPECT_EQ("x" + std::string(8192, 'a') + "y", bufferToString(destination));
+}
+
+TEST(OwnedImplTest, MovePartialFragment) {
+  std::string data(8192, 'a');
+  bool released = false;
+  BufferFragmentImpl fragment(data.data(), data.size(),
+                              [&](const void*, size_t, const BufferFragmentImpl*) {
+                                released = true;
+                              });
+  OwnedImpl source;
+  source.addBufferFragment(fragment);
+
+  // The unowned slice moves and is never appended to.
+  OwnedImpl destination;
+  destination.move(source, 8000);
+  destination.add("b");
+  EXPECT_EQ(192UL, source.length());
+  EXPECT_EQ(std::string(8000, 'a') + "b", bufferToString(destination));
+  EXPECT_EQ(std::string(8192, 'a'), data);
+  EXPECT_FALSE(released);
+  destination.drain(destination.length());
+  EXPECT_TRUE(released);
+}
+
+TEST(OwnedImplTest, Search) {
+  OwnedImpl buffer("abc");
+  RawSlice iovec;
+  buffer.reserve(100000, &iovec, 1);
+  memset(iovec.mem_, 'x', iovec.len_);
+  buffer.commit(&iovec, 1);
+  buffer.add("def");
+  const uint64_t search_base = 3 + iovec.len_;
+
+  EXPECT_EQ(0, buffer.search("abc", 3, 0));
+  EXPECT_EQ(-1, buffer.search("abc", 3, 1));
+  EXPECT_EQ(static_cast<ssize_t>(search_base), buffer.search("def", 3, 0));
+  EXPECT_EQ(static_cast<ssize_t>(search_base - 1), buffer.search("xde", 3, 0));
+  EXPECT_EQ(-1, buffer.search("deg", 3, 0));
+  EXPECT_EQ(-1, buffer.search("defg", 4, 0));
+  EXPECT_EQ(5, buffer.search(nullptr, 0, 5));
+}
+
+TEST(OwnedImplTest, SearchSequence) {
+  OwnedImpl buffer("abc");
+  RawSlice iovec;
+  buffer.reserve(100000, &iovec, 1);
+  memset(iovec.mem_, 'x', iovec.len_);
+  buffer.commit(&iovec, 1);
+  buffer.add("def");
+  const uint64_t search_base = 3 + iovec.len_;
+
+  auto patterns = [](const std::vector<std::string>& strings) {
+    std::vector<std::vector<uint8_t>> patterns;
+    for (const std::string& string : strings) {
+      patterns.emplace_back(string.begin(), string.end());
+    }
+    return patterns;
+  };
+
+  EXPECT_EQ(static_cast<ssize_t>(search_base + 3),
+            buffer.searchSequence(patterns({"ab", "c", "xd", "ef"}), 0));
+  EXPECT_EQ(5, buffer.searchSequence(patterns({"b", "", "xx"}), 0));
+  EXPECT_EQ(2, buffer.searchSequence(patterns({}), 2));
+  EXPECT_EQ(-1, buffer.searchSequence(patterns({"ab", "c", "xd", "ef"}), 1));
+
+  // Patterns are matched in order and may not overlap.
+  EXPECT_EQ(-1, buffer.searchSequence(patterns({"def", "abc"}), 0));
+  EXPECT_EQ(-1, buffer.searchSequence(patterns({"xd", "de"}), search_base - 1));
+  EXPECT_EQ(-1, buffer.searchSequence(patterns({"abc", "bc"}), 0));
+}
+
+TEST(OwnedImplTest, ReadWrite) {
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+
+  std::string data(20000, 'a');
+  OwnedImpl write_buffer(data);
+  int bytes_written = 0;
+  while (write_buffer.length() > 0) {
+    int rc = write_buffer.write(fds[1]);
+    ASSERT_GT(rc, 0);
+    bytes_written += rc;
+
+    OwnedImpl read_buffer;
+    EXPECT_EQ(rc, read_buffer.read(fds[0], rc));
+    EXPECT_EQ(std::string(rc, 'a'), bufferToString(read_buffer));
+  }
+  EXPECT_EQ(20000, bytes_written);
+
+  OwnedImpl empty;
+  EXPECT_EQ(0, empty.write(fds[1]));
+
+  close(fds[1]);
+  OwnedImpl read_buffer;
+  EXPECT_EQ(0, read_buffer.read(fds[0], 100));
+  close(fds[0]);
+}
+
+TEST(OwnedImplTest, WriteUntilFull) {
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  ASSERT_EQ(0, fcntl(fds[1], F_SETFL, O_NONBLOCK));
+
+  // More slices than a single writev() takes are written in one call.
+  OwnedImpl buffer;
+  for (int i = 0; i < 32; i++) {
+    buffer.move(*std::unique_ptr<Instance>(new OwnedImpl(std::string(1024, 'a'))));
+  }
+  EXPECT_EQ(32 * 1024, buffer.write(fds[1]));
+  EXPECT_EQ(0UL, buffer.length());
+
+  // Writing stops once the pipe is full, leaving the rest in the buffer.
+  buffer.add(std::string(1024 * 1024, 'b'));
+  int rc = buffer.write(fds[1]);
+  EXPECT_GT(rc, 0);
+  EXPECT_EQ(1024 * 1024 - rc, static_cast<int>(buffer.length()));
+  EXPECT_EQ(-1, buffer.write(fds[1]));
+  EXPECT_EQ(EAGAIN, errno);
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(OwnedImplTest, ManySlices) {
+  // Enough slices to force the slice ring out of its inline storage.
+  OwnedImpl buffer;
+  std::string expected;
+  for (int i = 0; i < 32; i++) {
+    std::string data(1024, 'a' + (i % 26));
+    buffer.move(*std::unique_ptr<Instance>(new OwnedImpl(data)));
+    expected += data;
+  }
+  EXPECT_EQ(expected, bufferToString(buffer));
+
+  buffer.drain(10000);
+  EXPECT_EQ(expected.substr(10000), bufferToString(buffer));
+}
+
+TEST(OwnedImplTest, AddBufferFragmentNoCleanup) {
+  std::string input(8192, 'a');
+  BufferFragmentImpl frag(input.c_str(), input.size(), nullptr);
+  OwnedImpl buffer;
+  buffer.addBufferFragment(frag);
+  EXPECT_EQ(8192UL, buffer.length());
+
+  RawSlice slice;
+  EXPECT_EQ(1UL, buffer.getRawSlices(&slice, 1));
+  EXPECT_EQ(input.c_str(), slice.mem_);
+
+  buffer.drain(2000);
+  EXPECT_EQ(6192UL, buffer.length());
+  buffer.drain(6192);
+  EXPECT_EQ(0UL, buffer.length());
+}
+
+TEST(OwnedImplTest, AddBufferFragmentWithCleanup) {
+  std::string input(8192, 'a');
+  bool release_callback_called = false;
+  BufferFragmentImpl frag(input.c_str(), input.size(),
+                          [&](const void* data, size_t size, const BufferFragmentImpl*) {
+                            EXPECT_EQ(input.c_str(), data);
+                            EXPECT_EQ(input.size(), size);
+                            release_callback_called = true;
+                          });
+
+  OwnedImpl buffer;
+  buffer.addBufferFragment(frag);
+  buffer.add("b");
+
+  // Moving the fragment transfers it without copying or releasing it.
+  OwnedImpl destination;
+  destination.move(buffer);
+  EXPECT_FALSE(release_callback_called);
+  RawSlice slices[2];
+  EXPECT_EQ(2UL, destination.getRawSlices(slices, 2));
+  EXPECT_EQ(input.c_str(), slices[0].mem_);
+  EXPECT_EQ(input + "b", bufferToString(destination));
+
+  destination.drain(2000);
+  EXPECT_FALSE(release_callback_called);
+  destination.drain(6192);
+  EXPECT_TRUE(release_callback_called);
+  EXPECT_EQ("b", bufferToString(destination));
+}
+
+TEST(OwnedImplTest, AddBufferFragmentReleasedOnDestruction) {
+  std::string input("hello");
+  bool release_callback_called = false;
+  BufferFragmentImpl frag(
+      input.c_str(), input.size(),
+      [&](const void*, size_t, const BufferFragmentImpl*) { release_callback_called = true; });
+
+  {
+    OwnedImpl buffer;
+    buffer.addBufferFragment(frag);
+    EXPECT_EQ("hello", bufferToString(buffer));
+  }
+  EXPECT_TRUE(release_callback_called);
+}
+
+TEST(OwnedImplTest, MemoryAccount) {
+  MemoryAccountImplSharedPtr worker_account(new MemoryAccountImpl());
+  MemoryAccountImplSharedPtr account(new MemoryAccountImpl(worker_account));
+
+  // Memory held before the account is set is charged right away.
+  OwnedImpl buffer("hello");
+  buffer.setAccount(account);
+  const uint64_t slice_bytes = account->balance();
+  EXPECT_GE(slice_bytes, 5U);
+  EXPECT_EQ(slice_bytes, worker_account->balance());
+
+  buffer.add(std::string(8192, 'a'));
+  const uint64_t buffer_bytes = account->balance();
+  EXPECT_GT(buffer_bytes, 8192U + slice_bytes);
+
+  // Moving to a buffer with another account moves the charge.
+  MemoryAccountImplSharedPtr other_account(new MemoryAccountImpl(worker_account));
+  OwnedImpl other;
+  other.setAccount(other_account);
+  other.move(buffer);
+  EXPECT_EQ(0U, account->balance());
+  EXPECT_EQ(buffer_bytes, other_account->balance());
+  EXPECT_EQ(buffer_bytes, worker_account->balance());
+
+  // Moving to a buffer without an account leaves the charge with the account that had it.
+  OwnedImpl unaccounted;
+  unaccounted.move(other);
+  EXPECT_EQ(buffer_bytes, other_account->balance());
+
+  unaccounted.drain(unaccounted.length());
+  EXPECT_EQ(0U, other_account->balance());
+  EXPECT_EQ(0U, worker_account->balance());
+  EXPECT_EQ(buffer_bytes, account->peakBalance());
+}
+
+TEST(OwnedImplTest, MemoryAccountSkipsFragments) {
+  std::string input("hello");
+  BufferFragmentImpl frag(input.c_str(), input.size(), nullptr);
+  MemoryAccountImplSharedPtr account(new MemoryAccountImpl());
+
+  OwnedImpl buffer;
+  buffer.setAccount(account);
+  buffer.addBufferFragment(frag);
+  EXPECT_EQ(0U, account->balance());
+}
+
+} // Buffer
+} // Envoy
@@ -0,0 +1,97 @@
+#include <cstdint>
+#include <random>
+#include <string>
+
+#include "common/buffer/spill_buffer_impl.h"
+
+#include "test/test_common/environment.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Buffer {
+
+static std::string bufferToString(const Instance& buffer) {
+  std::string output;
+  uint64_t num_slices = buffer.getRawSlices(nullptr, 0);
+  RawSlice slices[num_slices];
+  buffer.getRawSlices(slices, num_slices);
+  for (RawSlice& slice : slices) {
+    output.append(static_cast<const char*>(slice.mem_), slice.len_);
+  }
+  return output;
+}
+
+static std::string testData(uint64_t size) {
+  std::minstd_rand random;
+  std::string data(size, 0);
+  for (uint64_t i = 0; i < size; i++) {
+    data[i] = static_cast<char>(random());
+  }
+  return data;
+}
+
+class SpillBufferImplTest : public testing::Test {
+public:
+  // Adds the data in pieces the size of a typical socket read.
+  void addInPieces(Instance& buffer, const std::string& data) {
+    for (uint64_t offset = 0; offset < data.size(); offset += 16384) {
+      OwnedImpl piece(data.substr(offset, 16384));
+      buffer.move(piece);
+    }
+  }
+
+  const std::string directory_{TestEnvironment::temporaryDirectory()};
+};
+
+TEST_F(SpillBufferImplTest, SmallBufferStaysInMemory) {
+  SpillBufferImpl buffer(directory_, 4096);
+  buffer.add(testData(4096 + SpillBufferImpl::SpillChunkSize - 1));
+  EXPECT_EQ(0U, buffer.bytesSpilled());
+  EXPECT_FALSE(buffer.spillFailed());
+}
+
+TEST_F(SpillBufferImplTest, SpillsPastMemoryLimit) {
+  const std::string data = testData(1024 * 1024 + 123);
+  SpillBufferImpl buffer(directory_, 8192);
+  addInPieces(buffer, data);
+
+  // Everything but the memory limit and at most one chunk plus one piece has been spilled.
+  EXPECT_FALSE(buffer.spillFailed());
+  EXPECT_GE(buffer.bytesSpilled(), data.size() - 8192 - SpillBufferImpl::SpillChunkSize - 16384);
+  EXPECT_EQ(data.size(), buffer.length());
+  EXPECT_EQ(data, bufferToString(buffer));
+
+  // Spilled data can be drained and searched like any other.
+  buffer.drain(100000);
+  EXPECT_EQ(data.substr(100000), bufferToString(buffer));
+  EXPECT_EQ(400000, buffer.search(data.data() + 500000, 100, 0));
+}
+
+TEST_F(SpillBufferImplTest, CopySharesSpilledData) {
+  const std::string data = testData(512 * 1024);
+  SpillBufferImpl buffer(directory_, 0);
+  addInPieces(buffer, data);
+  EXPECT_GT(buffer.bytesSpilled(), 0U);
+
+  // Copies outlive the original buffer and its file.
+  OwnedImpl copy;
+  copy.add(buffer);
+  OwnedImpl moved;
+  moved.move(buffer, 300000);
+  buffer.drain(buffer.length());
+  EXPECT_EQ(data, bufferToString(copy));
+  EXPECT_EQ(data.substr(0, 300000), bufferToString(moved));
+}
+
+TEST_F(SpillBufferImplTest, KeepsDataInMemoryIfSpillFails) {
+  const std::string data = testData(256 * 1024);
+  SpillBufferImpl buffer(directory_ + "/does/not/exist", 0);
+  addInPieces(buffer, data);
+  EXPECT_TRUE(buffer.spillFailed());
+  EXPECT_EQ(0U, buffer.bytesSpilled());
+  EXPECT_EQ(data, bufferToString(buffer));
+}
+
+} // Buffer
+} // Envoy
@@ -4,10 +4,23 @@
 #include "common/common/base64.h"
 
 #include "test/test_common/printers.h"
+#include "test/test_common/utility.h"
 
 #include "gtest/gtest.h"
 
 namespace Envoy {
+namespace {
+
+// Builds a buffer with a separate slice for every chunk_size bytes of input.
+void addInChunks(const std::string& input, uint64_t chunk_size, Buffer::Instance& buffer) {
+  for (uint64_t i = 0; i < input.size(); i += chunk_size) {
+    Buffer::OwnedImpl chunk(input.substr(i, chunk_size));
+    buffer.move(chunk);
+  }
+}
+
+} // namespace
+
 TEST(Base64Test, EmptyBufferEncode) {
   {
     Buffer::OwnedImpl buffer;
@@ -74,6 +87,13 @@ TEST(Base64Test, Decode) {
   }
 }
 
+TEST(Base64Test, DecodeInvalid) {
+  // Characters outside of the alphabet end a quartet early, including ones with the high bit set.
+  EXPECT_EQ("f", Base64::decode("Zm*v"));
+  EXPECT_EQ("fo", Base64::decode("Zm8\xff"));
+  EXPECT_EQ("foofo", Base64::decode("Zm9vZm8="));
+}
+
 TEST(Base64Test, MultiSlicesBufferEncode) {
   Buffer::OwnedImpl buffer;
   buffer.add("foob", 4);
@@ -95,4 +115,54 @@ TEST(Base64Test, BinaryBufferEncode) {
   EXPECT_EQ("AAECAwgKCQCqvA==", Base64::encode(buffer, 10));
   EXPECT_EQ("AAECAwgKCQCqvN4=", Base64::encode(buffer, 30));
 }
+
+TEST(Base64Test, BufferToBufferEncode) {
+  const std::string test_string("\0\0\0\0als;jkopqitu[\0opbjlcxnb35g]b[\xaa\b\n", 36);
+  for (uint64_t chunk_size = 1; chunk_size <= 7; chunk_size++) {
+    for (uint64_t length = 0; length <= test_string.size(); length++) {
+      Buffer::OwnedImpl input;
+      addInChunks(test_string, chunk_size, input);
+      Buffer::OwnedImpl output("prefix");
+      Base64::encode(input, length, output);
+      EXPECT_EQ("prefix" + Base64::encode(test_string.data(), length),
+                TestUtility::bufferToString(output));
+      EXPECT_EQ(test_string.size(), input.length());
+    }
+  }
+
+  Buffer::OwnedImpl input("foo");
+  Buffer::OwnedImpl output;
+  Base64::encode(input, 10, output);
+  EXPECT_EQ("Zm9v", TestUtility::bufferToString(output));
+}
+
+TEST(Base64Test, BufferToBufferDecode) {
+  const std::string test_string("\0\0\0\0als;jkopqitu[\0opbjlcxnb35g]b[\xaa\b\n", 34);
+  const std::string encoded = Base64::encode(test_string.data(), test_string.size());
+  for (uint64_t chunk_size = 1; chunk_size <= 7; chunk_size++) {
+    Buffer::OwnedImpl input;
+    addInChunks(encoded, chunk_size, input);
+    Buffer::OwnedImpl output;
+    EXPECT_TRUE(Base64::decode(input, input.length(), output));
+    EXPECT_EQ(test_string, TestUtility::bufferToString(output));
+  }
+
+  // Each quartet may be padded, so separately encoded chunks decode as one stream.
+  {
+    Buffer::OwnedImpl input;
+    addInChunks("Zm8=Zm9vYg==YmFy", 3, input);
+    Buffer::OwnedImpl output;
+    EXPECT_TRUE(Base64::decode(input, 12, output));
+    EXPECT_EQ("fofoob", TestUtility::bufferToString(output));
+  }
+
+  {
+    Buffer::OwnedImpl input("Zm9vYmFy");
+    Buffer::OwnedImpl output;
+    EXPECT_TRUE(Base64::decode(input, 0, output));
+    EXPECT_FALSE(Base64::decode(input, 6, output));
+    EXPECT_FALSE(Base64::decode(input, 12, output));
+    EXPECT_EQ(0U, output.length());
+  }
+}
 } // Envoy
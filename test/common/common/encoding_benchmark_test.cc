@@ -0,0 +1,90 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/common/base64.h"
+#include "common/common/hex.h"
+
+#include "gtest/gtest.h"
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+
+/**
+ * This test is for benchmarking only and should not be run as part of unit tests. It measures the
+ * base64 and hex codecs on inputs the size of a gRPC-Web text frame, both from contiguous memory
+ * and from a buffer split into several slices.
+ */
+class DISABLED_EncodingBenchmark : public testing::Test {
+public:
+  static const uint32_t NumIterations = 100000;
+  static const uint32_t InputSize = 4096;
+  static const uint32_t SliceSize = 1000;
+
+  DISABLED_EncodingBenchmark() {
+    for (uint32_t i = 0; i < InputSize; i++) {
+      input_.push_back(static_cast<char>(i * 131));
+    }
+    encoded_ = Base64::encode(input_.data(), input_.size());
+    for (uint32_t i = 0; i < input_.size(); i += SliceSize) {
+      Buffer::OwnedImpl slice(input_.substr(i, SliceSize));
+      input_buffer_.move(slice);
+    }
+    for (uint32_t i = 0; i < encoded_.size(); i += SliceSize) {
+      Buffer::OwnedImpl slice(encoded_.substr(i, SliceSize));
+      encoded_buffer_.move(slice);
+    }
+  }
+
+  template <class Op> void run(const std::string& name, Op op) {
+    uint64_t checksum = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NumIterations; i++) {
+      checksum += op();
+    }
+    std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_NE(0U, checksum);
+    std::cout << fmt::format("{}: {}ns/op", name, elapsed.count() / NumIterations) << std::endl;
+  }
+
+  std::string input_;
+  std::string encoded_;
+  Buffer::OwnedImpl input_buffer_;
+  Buffer::OwnedImpl encoded_buffer_;
+};
+
+const uint32_t DISABLED_EncodingBenchmark::NumIterations;
+const uint32_t DISABLED_EncodingBenchmark::InputSize;
+const uint32_t DISABLED_EncodingBenchmark::SliceSize;
+
+TEST_F(DISABLED_EncodingBenchmark, Base64) {
+  run("base64_encode_4k",
+      [&]() -> uint64_t { return Base64::encode(input_.data(), input_.size()).size(); });
+  run("base64_decode_4k", [&]() -> uint64_t { return Base64::decode(encoded_).size(); });
+
+  Buffer::OwnedImpl output;
+  run("base64_encode_buffer_4k", [&]() -> uint64_t {
+    Base64::encode(input_buffer_, input_buffer_.length(), output);
+    const uint64_t length = output.length();
+    output.drain(length);
+    return length;
+  });
+  run("base64_decode_buffer_4k", [&]() -> uint64_t {
+    Base64::decode(encoded_buffer_, encoded_buffer_.length(), output);
+    const uint64_t length = output.length();
+    output.drain(length);
+    return length;
+  });
+}
+
+TEST_F(DISABLED_EncodingBenchmark, Hex) {
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(input_.data());
+  const std::string hex = Hex::encode(data, input_.size());
+  run("hex_encode_4k", [&]() -> uint64_t { return Hex::encode(data, input_.size()).size(); });
+  run("hex_decode_4k", [&]() -> uint64_t { return Hex::decode(hex).size(); });
+}
+
+} // Envoy
@@ -0,0 +1,37 @@
+#include "common/common/free_list.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+
+TEST(FreeListTest, ReusesBlocks) {
+  FreeList free_list(4);
+  void* block = free_list.allocate(64);
+  free_list.deallocate(block, 64);
+  EXPECT_EQ(1U, free_list.size());
+  EXPECT_EQ(block, free_list.allocate(64));
+  EXPECT_EQ(0U, free_list.size());
+  free_list.deallocate(block, 64);
+}
+
+TEST(FreeListTest, Bounded) {
+  FreeList free_list(2);
+  void* blocks[3];
+  for (void*& block : blocks) {
+    block = free_list.allocate(32);
+  }
+  for (void* block : blocks) {
+    free_list.deallocate(block, 32);
+  }
+  EXPECT_EQ(2U, free_list.size());
+}
+
+TEST(FreeListTest, Release) {
+  FreeList free_list(4);
+  free_list.deallocate(free_list.allocate(16), 16);
+  EXPECT_EQ(1U, free_list.size());
+  free_list.release();
+  EXPECT_EQ(0U, free_list.size());
+}
+
+} // Envoy
@@ -0,0 +1,31 @@
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+
+#include "common/common/hash.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+TEST(Hash, XxHash64) {
+  EXPECT_EQ(0xef46db3751d8e999U, HashUtil::xxHash64(""));
+  EXPECT_EQ(0xd24ec4f1a98c6e5bU, HashUtil::xxHash64("a"));
+  EXPECT_EQ(0x44bc2cf5ad770999U, HashUtil::xxHash64("abc"));
+  EXPECT_EQ(0xfbcea83c8a378bf1U, HashUtil::xxHash64("Nobody inspects the spammish repetition"));
+}
+
+TEST(Hash, XxHash64Seed) {
+  EXPECT_NE(HashUtil::xxHash64("abc"), HashUtil::xxHash64("abc", 1));
+  EXPECT_EQ(HashUtil::xxHash64("abc", 1), HashUtil::xxHash64("abcd", 3, 1));
+}
+
+TEST(Hash, XxHash64AllLengths) {
+  // Every prefix length exercises a different mix of the stripe, 8, 4 and 1 byte paths.
+  const std::string input(100, 'x');
+  std::unordered_set<uint64_t> hashes;
+  for (size_t length = 0; length <= input.size(); length++) {
+    EXPECT_TRUE(hashes.insert(HashUtil::xxHash64(input.data(), length, 0)).second);
+  }
+  EXPECT_EQ(0x92f0de5a88a3c094U, HashUtil::xxHash64(input));
+}
+} // Envoy
@@ -25,7 +25,15 @@ TEST(Hex, RoundTrip) {
   EXPECT_EQ(bytes, decoded);
 }
 
-TEST(Hex, BadHex) { EXPECT_THROW(Hex::decode("abcde"), EnvoyException); }
+TEST(Hex, BadHex) {
+  EXPECT_THROW(Hex::decode("abcde"), EnvoyException);
+  EXPECT_THROW(Hex::decode("0x"), EnvoyException);
+  EXPECT_THROW(Hex::decode("ag"), EnvoyException);
+  // Signs and whitespace are not hex digits either.
+  EXPECT_THROW(Hex::decode("+f"), EnvoyException);
+  EXPECT_THROW(Hex::decode(" f"), EnvoyException);
+  EXPECT_THROW(Hex::decode("00-1"), EnvoyException);
+}
 
 TEST(Hex, DecodeUppercase) { Hex::decode("ABCDEFAB"); }
 
@@ -33,5 +41,29 @@ TEST(Hex, UIntToHex) {
   std::string base16_string = Hex::uint64ToHex(2722130815203937912ULL);
   EXPECT_EQ("25c6f38dd0600e78", base16_string);
   EXPECT_EQ("0000000000000000", Hex::uint64ToHex(0ULL));
+
+  char out[17] = {};
+  Hex::uint64ToHex(0xffffffffffffffffULL, out);
+  EXPECT_STREQ("ffffffffffffffff", out);
+}
+
+TEST(Hex, HexToUInt) {
+  uint64_t value = 1;
+  EXPECT_TRUE(Hex::hexToUint64("25c6f38dd0600e78", 16, value));
+  EXPECT_EQ(2722130815203937912ULL, value);
+  EXPECT_TRUE(Hex::hexToUint64("FFFFFFFFFFFFFFFF", 16, value));
+  EXPECT_EQ(0xffffffffffffffffULL, value);
+  EXPECT_TRUE(Hex::hexToUint64("0a", 2, value));
+  EXPECT_EQ(10ULL, value);
+
+  // Only the given number of digits is read.
+  EXPECT_TRUE(Hex::hexToUint64("0000000fzz", 8, value));
+  EXPECT_EQ(15ULL, value);
+
+  value = 1;
+  EXPECT_FALSE(Hex::hexToUint64("25c6f38dd0600e7g", 16, value));
+  EXPECT_FALSE(Hex::hexToUint64("-1", 2, value));
+  EXPECT_FALSE(Hex::hexToUint64(" 1", 2, value));
+  EXPECT_EQ(1ULL, value);
 }
 } // Envoy
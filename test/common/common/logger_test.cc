@@ -0,0 +1,73 @@
+#include <memory>
+#include <string>
+
+#include "common/common/logger.h"
+#include "common/common/thread.h"
+
+#include "gtest/gtest.h"
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+namespace Logger {
+
+class LockingStderrSinkTest : public testing::Test {
+public:
+  LockingStderrSinkTest() : sink_(new LockingStderrSink()), logger_("test", sink_) {
+    sink_->setLock(lock_);
+    logger_.set_pattern("%v");
+    logger_.set_level(spdlog::level::trace);
+  }
+
+  Thread::MutexBasicLockable lock_;
+  std::shared_ptr<LockingStderrSink> sink_;
+  spdlog::logger logger_;
+};
+
+TEST_F(LockingStderrSinkTest, AsyncWritesLinesInOrder) {
+  testing::internal::CaptureStderr();
+  sink_->startAsync(100);
+  for (int i = 0; i < 10; i++) {
+    logger_.info("line {}", i);
+  }
+  sink_->stopAsync();
+
+  std::string expected;
+  for (int i = 0; i < 10; i++) {
+    expected += fmt::format("line {}\n", i);
+  }
+  EXPECT_EQ(expected, testing::internal::GetCapturedStderr());
+  EXPECT_EQ(0U, sink_->droppedLines());
+}
+
+TEST_F(LockingStderrSinkTest, AsyncWritesErrorsSynchronously) {
+  sink_->startAsync(100);
+  testing::internal::CaptureStderr();
+  logger_.error("error");
+  EXPECT_EQ("error\n", testing::internal::GetCapturedStderr());
+  sink_->stopAsync();
+}
+
+TEST_F(LockingStderrSinkTest, AsyncDropsLinesWhenFull) {
+  testing::internal::CaptureStderr();
+  sink_->startAsync(2);
+
+  // With the lock held the writer can take at most one batch of 2 lines, and 2 more fit in the
+  // queue.
+  lock_.lock();
+  for (int i = 0; i < 10; i++) {
+    logger_.info("line {}", i);
+  }
+  EXPECT_LE(6U, sink_->droppedLines());
+  lock_.unlock();
+
+  sink_->stopAsync();
+  testing::internal::GetCapturedStderr();
+
+  // Lines are written synchronously again.
+  testing::internal::CaptureStderr();
+  logger_.info("sync");
+  EXPECT_EQ("sync\n", testing::internal::GetCapturedStderr());
+}
+
+} // Logger
+} // Envoy
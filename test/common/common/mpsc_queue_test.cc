@@ -0,0 +1,69 @@
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "common/common/mpsc_queue.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+
+struct TestItem {
+  TestItem(uint32_t producer, uint32_t value) : producer_(producer), value_(value) {}
+
+  uint32_t producer_;
+  uint32_t value_;
+  TestItem* next_{};
+};
+
+TEST(MpscQueueTest, PushPopAll) {
+  MpscQueue<TestItem> queue;
+  EXPECT_TRUE(queue.popAll().empty());
+
+  EXPECT_TRUE(queue.push(std::unique_ptr<TestItem>{new TestItem(0, 1)}));
+  EXPECT_FALSE(queue.push(std::unique_ptr<TestItem>{new TestItem(0, 2)}));
+  EXPECT_FALSE(queue.push(std::unique_ptr<TestItem>{new TestItem(0, 3)}));
+
+  std::vector<std::unique_ptr<TestItem>> items = queue.popAll();
+  ASSERT_EQ(3UL, items.size());
+  EXPECT_EQ(1U, items[0]->value_);
+  EXPECT_EQ(2U, items[1]->value_);
+  EXPECT_EQ(3U, items[2]->value_);
+
+  EXPECT_TRUE(queue.push(std::unique_ptr<TestItem>{new TestItem(0, 4)}));
+
+  // Items still queued are freed with the queue.
+}
+
+TEST(MpscQueueTest, ConcurrentProducers) {
+  const uint32_t num_producers = 4;
+  const uint32_t num_items = 10000;
+  MpscQueue<TestItem> queue;
+
+  std::vector<std::thread> producers;
+  for (uint32_t producer = 0; producer < num_producers; producer++) {
+    producers.emplace_back([&queue, producer]() -> void {
+      for (uint32_t value = 0; value < num_items; value++) {
+        queue.push(std::unique_ptr<TestItem>{new TestItem(producer, value)});
+      }
+    });
+  }
+
+  // Every item arrives exactly once, and each producer's items arrive in order.
+  std::vector<uint32_t> next_value(num_producers, 0);
+  uint32_t received = 0;
+  while (received < num_producers * num_items) {
+    for (const auto& item : queue.popAll()) {
+      EXPECT_EQ(next_value[item->producer_], item->value_);
+      next_value[item->producer_]++;
+      received++;
+    }
+  }
+
+  for (std::thread& producer : producers) {
+    producer.join();
+  }
+}
+
+} // Envoy
@@ -26,5 +26,32 @@ TEST(ToLowerTableTest, All) {
     table.toLowerCase(input);
     EXPECT_EQ(input, "\x90hello\x90");
   }
+  {
+    std::string input("X-ENVOY-UPSTREAM-RQ-TIMEOUT-MS@[`{\xC1\xDA");
+    table.toLowerCase(input);
+    EXPECT_EQ(input, "x-envoy-upstream-rq-timeout-ms@[`{\xC1\xDA");
+  }
+}
+
+TEST(ToLowerTableTest, MatchesTableForAllBytes) {
+  ToLowerTable table;
+  std::string input;
+  for (size_t c = 0; c < 256; c++) {
+    input.push_back(static_cast<char>(c));
+  }
+
+  std::string expected = input;
+  for (char& c : expected) {
+    if (c >= 'A' && c <= 'Z') {
+      c |= 0x20;
+    }
+  }
+
+  // Exercise every alignment of the word at a time path.
+  for (size_t offset = 0; offset < 8; offset++) {
+    std::string converted = input.substr(offset);
+    table.toLowerCase(converted);
+    EXPECT_EQ(expected.substr(offset), converted);
+  }
 }
 } // Envoy
@@ -74,6 +74,12 @@ TEST(StringUtil, rtrim) {
   }
 }
 
+TEST(StringUtil, trim) {
+  EXPECT_EQ("", StringUtil::trim(" \t "));
+  EXPECT_EQ("hello", StringUtil::trim("hello"));
+  EXPECT_EQ("hello \t world", StringUtil::trim("\t hello \t world  "));
+}
+
 TEST(StringUtil, strlcpy) {
   {
     char dest[6];
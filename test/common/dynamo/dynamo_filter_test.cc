@@ -8,6 +8,7 @@
 #include "test/mocks/http/mocks.h"
 #include "test/mocks/runtime/mocks.h"
 #include "test/mocks/stats/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
 #include "test/test_common/printers.h"
 #include "test/test_common/utility.h"
 
@@ -24,21 +25,44 @@ namespace Dynamo {
 
 class DynamoFilterTest : public testing::Test {
 public:
-  void setup(bool enabled) {
+  void setup(bool enabled, uint32_t max_cache_entries = DynamoStats::DEFAULT_MAX_ENTRIES) {
     ON_CALL(loader_.snapshot_, featureEnabled("dynamodb.filter_enabled", 100))
         .WillByDefault(Return(enabled));
     EXPECT_CALL(loader_.snapshot_, featureEnabled("dynamodb.filter_enabled", 100));
 
-    filter_.reset(new DynamoFilter(loader_, stat_prefix_, stats_));
+    dynamo_stats_.reset(new DynamoStats(stat_prefix_, stats_, tls_, max_cache_entries));
+    newFilter();
+  }
+
+  void newFilter() {
+    filter_.reset(new DynamoFilter(loader_, dynamo_stats_));
 
     filter_->setDecoderFilterCallbacks(decoder_callbacks_);
     filter_->setEncoderFilterCallbacks(encoder_callbacks_);
   }
 
+  // Send a GetItem request for the locations table, with a response that consumed capacity of
+  // one partition.
+  void getItem(const std::string& status) {
+    Http::TestHeaderMapImpl request_headers{{"x-amz-target", "version.GetItem"}};
+    Buffer::OwnedImpl request_data("{\"TableName\":\"locations\"}");
+    EXPECT_EQ(Http::FilterHeadersStatus::Continue, filter_->decodeHeaders(request_headers, false));
+    EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->decodeData(request_data, true));
+
+    Http::TestHeaderMapImpl response_headers{{":status", status}};
+    Buffer::OwnedImpl response_data(
+        R"EOF({"ConsumedCapacity": {"Partitions": {"partition_1" : 2.0}}})EOF");
+    EXPECT_EQ(Http::FilterHeadersStatus::Continue,
+              filter_->encodeHeaders(response_headers, false));
+    EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(response_data, true));
+  }
+
   std::unique_ptr<DynamoFilter> filter_;
   NiceMock<Runtime::MockLoader> loader_;
   std::string stat_prefix_{"prefix."};
   Stats::MockStore stats_;
+  NiceMock<ThreadLocal::MockInstance> tls_;
+  DynamoStatsSharedPtr dynamo_stats_;
   NiceMock<Http::MockStreamDecoderFilterCallbacks> decoder_callbacks_;
   NiceMock<Http::MockStreamEncoderFilterCallbacks> encoder_callbacks_;
 };
@@ -113,10 +137,10 @@ TEST_F(DynamoFilterTest, handleErrorTypeTableMissing) {
   EXPECT_CALL(stats_, counter("prefix.dynamodb.error.no_table.ValidationException"));
   EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(*error_data, true));
 
+  // The trailing } makes the next response body invalid.
+  EXPECT_EQ(Http::FilterHeadersStatus::Continue, filter_->encodeHeaders(response_headers, false));
   error_data->add("}", 1);
-  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer,
-            filter_->encodeData(*error_data, false));
-  EXPECT_CALL(encoder_callbacks_, encodingBuffer()).WillRepeatedly(Return(error_data.get()));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(*error_data, false));
   EXPECT_CALL(stats_, counter("prefix.dynamodb.invalid_resp_body"));
   EXPECT_CALL(stats_, counter("prefix.dynamodb.operation_missing"));
   EXPECT_CALL(stats_, counter("prefix.dynamodb.table_missing"));
@@ -184,8 +208,7 @@ TEST_F(DynamoFilterTest, BatchMultipleTables) {
 )EOF";
   buffer->add(buffer_content);
 
-  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer, filter_->decodeData(*buffer, false));
-  EXPECT_CALL(decoder_callbacks_, decodingBuffer()).WillRepeatedly(Return(buffer.get()));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->decodeData(*buffer, false));
   EXPECT_EQ(Http::FilterTrailersStatus::Continue, filter_->decodeTrailers(request_headers));
 
   Http::TestHeaderMapImpl response_headers{{":status", "200"}};
@@ -223,8 +246,7 @@ TEST_F(DynamoFilterTest, BatchMultipleTablesUnprocessedKeys) {
 )EOF";
   buffer->add(buffer_content);
 
-  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer, filter_->decodeData(*buffer, false));
-  EXPECT_CALL(decoder_callbacks_, decodingBuffer()).WillRepeatedly(Return(buffer.get()));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->decodeData(*buffer, false));
   EXPECT_EQ(Http::FilterTrailersStatus::Continue, filter_->decodeTrailers(request_headers));
 
   Http::TestHeaderMapImpl response_headers{{":status", "200"}};
@@ -257,7 +279,7 @@ TEST_F(DynamoFilterTest, BatchMultipleTablesUnprocessedKeys) {
 
   EXPECT_CALL(stats_, counter("prefix.dynamodb.error.table_1.BatchFailureUnprocessedKeys"));
   EXPECT_CALL(stats_, counter("prefix.dynamodb.error.table_2.BatchFailureUnprocessedKeys"));
-  EXPECT_CALL(encoder_callbacks_, encodingBuffer()).WillRepeatedly(Return(response_data.get()));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(*response_data, false));
   EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(empty_data, true));
 }
 
@@ -279,8 +301,7 @@ TEST_F(DynamoFilterTest, BatchMultipleTablesNoUnprocessedKeys) {
 )EOF";
   buffer->add(buffer_content);
 
-  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer, filter_->decodeData(*buffer, false));
-  EXPECT_CALL(decoder_callbacks_, decodingBuffer()).WillRepeatedly(Return(buffer.get()));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->decodeData(*buffer, false));
   EXPECT_EQ(Http::FilterTrailersStatus::Continue, filter_->decodeTrailers(request_headers));
 
   Http::TestHeaderMapImpl response_headers{{":status", "200"}};
@@ -309,7 +330,7 @@ TEST_F(DynamoFilterTest, BatchMultipleTablesNoUnprocessedKeys) {
 )EOF";
   response_data->add(response_content);
 
-  EXPECT_CALL(encoder_callbacks_, encodingBuffer()).WillOnce(Return(response_data.get()));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(*response_data, false));
   EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(empty_data, true));
 }
 
@@ -331,8 +352,7 @@ TEST_F(DynamoFilterTest, BatchMultipleTablesInvalidResponseBody) {
 )EOF";
   buffer->add(buffer_content);
 
-  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer, filter_->decodeData(*buffer, false));
-  EXPECT_CALL(decoder_callbacks_, decodingBuffer()).WillRepeatedly(Return(buffer.get()));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->decodeData(*buffer, false));
   EXPECT_EQ(Http::FilterTrailersStatus::Continue, filter_->decodeTrailers(request_headers));
 
   Http::TestHeaderMapImpl response_headers{{":status", "200"}};
@@ -365,7 +385,7 @@ TEST_F(DynamoFilterTest, BatchMultipleTablesInvalidResponseBody) {
   response_data->add("}", 1);
 
   EXPECT_CALL(stats_, counter("prefix.dynamodb.invalid_resp_body"));
-  EXPECT_CALL(encoder_callbacks_, encodingBuffer()).WillOnce(Return(response_data.get()));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(*response_data, false));
   EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(empty_data, true));
 }
 
@@ -376,12 +396,11 @@ TEST_F(DynamoFilterTest, bothOperationAndTableCorrect) {
   Buffer::InstancePtr buffer(new Buffer::OwnedImpl());
   std::string buffer_content = "{\"TableName\":\"locations\"";
   buffer->add(buffer_content);
-  EXPECT_CALL(decoder_callbacks_, decodingBuffer()).WillRepeatedly(Return(buffer.get()));
   Buffer::OwnedImpl data;
   data.add("}", 1);
 
   EXPECT_EQ(Http::FilterHeadersStatus::Continue, filter_->decodeHeaders(request_headers, false));
-  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer, filter_->decodeData(data, false));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->decodeData(*buffer, false));
   EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->decodeData(data, true));
 
   EXPECT_CALL(stats_, counter("prefix.dynamodb.operation.GetItem.upstream_rq_total_2xx"));
@@ -431,12 +450,11 @@ TEST_F(DynamoFilterTest, PartitionIdStats) {
   Buffer::InstancePtr buffer(new Buffer::OwnedImpl());
   std::string buffer_content = "{\"TableName\":\"locations\"";
   buffer->add(buffer_content);
-  ON_CALL(decoder_callbacks_, decodingBuffer()).WillByDefault(Return(buffer.get()));
   Buffer::OwnedImpl data;
   data.add("}", 1);
 
   EXPECT_EQ(Http::FilterHeadersStatus::Continue, filter_->decodeHeaders(request_headers, false));
-  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer, filter_->decodeData(data, false));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->decodeData(*buffer, false));
   EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->decodeData(data, true));
 
   EXPECT_CALL(stats_, counter("prefix.dynamodb.operation.GetItem.upstream_rq_total_2xx"));
@@ -485,7 +503,7 @@ TEST_F(DynamoFilterTest, PartitionIdStats) {
 
   response_data->add(response_content);
 
-  EXPECT_CALL(encoder_callbacks_, encodingBuffer()).WillOnce(Return(response_data.get()));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(*response_data, false));
   EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(empty_data, true));
 }
 
@@ -503,10 +521,9 @@ TEST_F(DynamoFilterTest, NoPartitionIdStatsForMultipleTables) {
 }
 )EOF";
   buffer->add(buffer_content);
-  ON_CALL(decoder_callbacks_, decodingBuffer()).WillByDefault(Return(buffer.get()));
 
   EXPECT_EQ(Http::FilterHeadersStatus::Continue, filter_->decodeHeaders(request_headers, false));
-  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer, filter_->decodeData(*buffer, false));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->decodeData(*buffer, false));
   EXPECT_EQ(Http::FilterTrailersStatus::Continue, filter_->decodeTrailers(request_headers));
 
   EXPECT_CALL(stats_, counter("prefix.dynamodb.multiple_tables"));
@@ -549,7 +566,7 @@ TEST_F(DynamoFilterTest, NoPartitionIdStatsForMultipleTables) {
 
   response_data->add(response_content);
 
-  EXPECT_CALL(encoder_callbacks_, encodingBuffer()).WillOnce(Return(response_data.get()));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(*response_data, false));
   EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(empty_data, true));
 }
 
@@ -566,10 +583,9 @@ TEST_F(DynamoFilterTest, PartitionIdStatsForSingleTableBatchOperation) {
 }
 )EOF";
   buffer->add(buffer_content);
-  ON_CALL(decoder_callbacks_, decodingBuffer()).WillByDefault(Return(buffer.get()));
 
   EXPECT_EQ(Http::FilterHeadersStatus::Continue, filter_->decodeHeaders(request_headers, false));
-  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer, filter_->decodeData(*buffer, false));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->decodeData(*buffer, false));
   EXPECT_EQ(Http::FilterTrailersStatus::Continue, filter_->decodeTrailers(request_headers));
 
   EXPECT_CALL(stats_, counter("prefix.dynamodb.multiple_tables")).Times(0);
@@ -622,9 +638,62 @@ TEST_F(DynamoFilterTest, PartitionIdStatsForSingleTableBatchOperation) {
 
   response_data->add(response_content);
 
-  EXPECT_CALL(encoder_callbacks_, encodingBuffer()).WillOnce(Return(response_data.get()));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(*response_data, false));
   EXPECT_EQ(Http::FilterDataStatus::Continue, filter_->encodeData(empty_data, true));
 }
 
+TEST_F(DynamoFilterTest, StatsCached) {
+  setup(true);
+
+  // Counters are looked up by name once per worker, and then charged through the cache.
+  EXPECT_CALL(stats_, counter("prefix.dynamodb.operation.GetItem.upstream_rq_total"));
+  EXPECT_CALL(stats_, counter("prefix.dynamodb.operation.GetItem.upstream_rq_total_2xx"));
+  EXPECT_CALL(stats_, counter("prefix.dynamodb.operation.GetItem.upstream_rq_total_200"));
+  EXPECT_CALL(stats_, counter("prefix.dynamodb.table.locations.upstream_rq_total"));
+  EXPECT_CALL(stats_, counter("prefix.dynamodb.table.locations.upstream_rq_total_2xx"));
+  EXPECT_CALL(stats_, counter("prefix.dynamodb.table.locations.upstream_rq_total_200"));
+  EXPECT_CALL(stats_,
+              counter("prefix.dynamodb.table.locations.capacity.GetItem.__partition_id=ition_1"));
+  EXPECT_CALL(stats_.counter_, inc()).Times(12);
+  EXPECT_CALL(stats_, deliverTimingToSinks(_, _)).Times(6);
+  EXPECT_CALL(stats_.counter_, add(2)).Times(2);
+  EXPECT_CALL(stats_, deliverTimingToSinks("prefix.dynamodb.operation.GetItem.upstream_rq_time", _))
+      .Times(2);
+  EXPECT_CALL(stats_, deliverTimingToSinks("prefix.dynamodb.table.locations.upstream_rq_time", _))
+      .Times(2);
+  EXPECT_CALL(stats_, deliverTimingToSinks("prefix.dynamodb.table.locations.upstream_rq_time_200",
+                                           _))
+      .Times(2);
+
+  getItem("200");
+  newFilter();
+  getItem("200");
+
+  // The operation, the table, one status code for each, and the partition.
+  EXPECT_EQ(5U, dynamo_stats_->cachedEntries());
+}
+
+TEST_F(DynamoFilterTest, StatsCacheBounded) {
+  setup(true, 6);
+
+  EXPECT_CALL(stats_, counter(_)).Times(testing::AnyNumber());
+  EXPECT_CALL(stats_, deliverTimingToSinks(_, _)).Times(testing::AnyNumber());
+  EXPECT_CALL(stats_, counter("prefix.dynamodb.operation.GetItem.upstream_rq_total_404"))
+      .Times(2);
+  EXPECT_CALL(stats_, counter("prefix.dynamodb.table.locations.upstream_rq_total_404"));
+
+  getItem("200");
+  EXPECT_EQ(5U, dynamo_stats_->cachedEntries());
+
+  // The operation's new status code fills the cache, so it is cleared before the table's stats
+  // are charged, and the operation's stats are looked up again by the next request.
+  newFilter();
+  getItem("404");
+  EXPECT_EQ(3U, dynamo_stats_->cachedEntries());
+  newFilter();
+  getItem("404");
+  EXPECT_EQ(5U, dynamo_stats_->cachedEntries());
+}
+
 } // Dynamo
 } // Envoy
@@ -1,9 +1,9 @@
 #include <string>
 #include <vector>
 
+#include "common/buffer/buffer_impl.h"
 #include "common/dynamo/dynamo_request_parser.h"
 #include "common/http/header_map_impl.h"
-#include "common/json/json_loader.h"
 
 #include "test/test_common/printers.h"
 #include "test/test_common/utility.h"
@@ -39,6 +39,33 @@ TEST(DynamoRequestParser, parseOperation) {
   }
 }
 
+// Parse a body split into chunks of the given size, as if it arrived in separate data frames.
+template <class Parser> bool parseBody(Parser& parser, const std::string& body, size_t chunk_size) {
+  for (size_t i = 0; i < body.size(); i += chunk_size) {
+    Buffer::OwnedImpl data(body.substr(i, chunk_size));
+    parser.parse(data);
+  }
+  return parser.complete();
+}
+
+RequestParser::TableDescriptor parseTable(const std::string& operation, const std::string& body) {
+  // The result does not depend on how the body is split.
+  RequestBodyParser split_parser(operation);
+  EXPECT_TRUE(parseBody(split_parser, body, 1));
+
+  RequestBodyParser parser(operation);
+  EXPECT_TRUE(parseBody(parser, body, body.size()));
+  EXPECT_EQ(split_parser.table().table_name, parser.table().table_name);
+  EXPECT_EQ(split_parser.table().is_single_table, parser.table().is_single_table);
+  return parser.table();
+}
+
+ResponseBodyParser parseResponse(const std::string& body) {
+  ResponseBodyParser parser;
+  EXPECT_TRUE(parseBody(parser, body, 3));
+  return parser;
+}
+
 TEST(DynamoRequestParser, parseTableNameSingleOperation) {
   std::vector<std::string> supported_single_operations{"GetItem", "Query",      "Scan",
                                                        "PutItem", "UpdateItem", "DeleteItem"};
@@ -46,52 +73,45 @@ TEST(DynamoRequestParser, parseTableNameSingleOperation) {
   {
     std::string json_string = R"EOF(
     {
-      "TableName": "Pets",
       "Key": {
         "AnimalType": {"S": "Dog"},
-        "Name": {"S": "Fido"}
-      }
+        "Name": {"S": "Fido", "TableName": "Nested"}
+      },
+      "TableName": "Pets"
     }
     )EOF";
-    Json::ObjectSharedPtr json_data = Json::Factory::loadFromString(json_string);
 
     // Supported operation
     for (const std::string& operation : supported_single_operations) {
-      EXPECT_EQ("Pets", RequestParser::parseTable(operation, *json_data).table_name);
+      EXPECT_EQ("Pets", parseTable(operation, json_string).table_name);
     }
 
     // Not supported operation
-    EXPECT_EQ("", RequestParser::parseTable("NotSupportedOperation", *json_data).table_name);
+    EXPECT_EQ("", parseTable("NotSupportedOperation", json_string).table_name);
   }
 
-  {
-    Json::ObjectSharedPtr json_data = Json::Factory::loadFromString("{\"TableName\":\"Pets\"}");
-    EXPECT_EQ("Pets", RequestParser::parseTable("GetItem", *json_data).table_name);
-  }
+  EXPECT_EQ("Pets", parseTable("GetItem", "{\"TableName\":\"Pets\"}").table_name);
+  EXPECT_EQ("P\"e/t\u00e9s",
+            parseTable("GetItem", "{\"TableName\":\"P\\\"e\\/t\\u00e9s\"}").table_name);
+
+  // A TableName that is not a string is ignored.
+  EXPECT_EQ("", parseTable("GetItem", "{\"TableName\":[\"Pets\"]}").table_name);
 }
 
 TEST(DynamoRequestParser, parseErrorType) {
-  {
-    EXPECT_EQ(
-        "ResourceNotFoundException",
-        RequestParser::parseErrorType(
-            *Json::Factory::loadFromString(
-                "{\"__type\":\"com.amazonaws.dynamodb.v20120810#ResourceNotFoundException\"}")));
-  }
+  EXPECT_EQ("ResourceNotFoundException",
+            parseResponse(
+                "{\"__type\":\"com.amazonaws.dynamodb.v20120810#ResourceNotFoundException\"}")
+                .errorType());
 
-  {
-    EXPECT_EQ(
-        "ResourceNotFoundException",
-        RequestParser::parseErrorType(
-            *Json::Factory::loadFromString(
+  EXPECT_EQ("ResourceNotFoundException",
+            parseResponse(
                 "{\"__type\":\"com.amazonaws.dynamodb.v20120810#ResourceNotFoundException\","
-                "\"message\":\"Requested resource not found: Table: tablename not found\"}")));
-  }
+                "\"message\":\"Requested resource not found: Table: tablename not found\"}")
+                .errorType());
 
-  {
-    EXPECT_EQ("", RequestParser::parseErrorType(
-                      *Json::Factory::loadFromString("{\"__type\":\"UnKnownError\"}")));
-  }
+  EXPECT_EQ("", parseResponse("{\"__type\":\"UnKnownError\"}").errorType());
+  EXPECT_EQ("", parseResponse("{}").errorType());
 }
 
 TEST(DynamoRequestParser, parseTableNameBatchOperation) {
@@ -104,9 +124,8 @@ TEST(DynamoRequestParser, parseTableNameBatchOperation) {
       }
     }
     )EOF";
-    Json::ObjectSharedPtr json_data = Json::Factory::loadFromString(json_string);
 
-    RequestParser::TableDescriptor table = RequestParser::parseTable("BatchGetItem", *json_data);
+    RequestParser::TableDescriptor table = parseTable("BatchGetItem", json_string);
     EXPECT_EQ("", table.table_name);
     EXPECT_FALSE(table.is_single_table);
   }
@@ -120,9 +139,8 @@ TEST(DynamoRequestParser, parseTableNameBatchOperation) {
       }
     }
     )EOF";
-    Json::ObjectSharedPtr json_data = Json::Factory::loadFromString(json_string);
 
-    RequestParser::TableDescriptor table = RequestParser::parseTable("BatchGetItem", *json_data);
+    RequestParser::TableDescriptor table = parseTable("BatchGetItem", json_string);
     EXPECT_EQ("table_2", table.table_name);
     EXPECT_TRUE(table.is_single_table);
   }
@@ -137,9 +155,8 @@ TEST(DynamoRequestParser, parseTableNameBatchOperation) {
       }
     }
     )EOF";
-    Json::ObjectSharedPtr json_data = Json::Factory::loadFromString(json_string);
 
-    RequestParser::TableDescriptor table = RequestParser::parseTable("BatchGetItem", *json_data);
+    RequestParser::TableDescriptor table = parseTable("BatchGetItem", json_string);
     EXPECT_EQ("", table.table_name);
     EXPECT_FALSE(table.is_single_table);
   }
@@ -148,120 +165,127 @@ TEST(DynamoRequestParser, parseTableNameBatchOperation) {
     std::string json_string = R"EOF(
     {
       "RequestItems": {
-        "table_2": { "test1" : "something" },
-        "table_2": { "test2" : "something" }
-      }
+        "table_2": [
+          {"PutRequest": {"Item": {"table_3": {"S": "something"}}}},
+          {"DeleteRequest": {"Key": {"id": {"N": "-1.5e+3"}, "flag": {"BOOL": false}}}}
+        ],
+        "table_2": {"Keys": [true, null, [], {}], "ConsistentRead": true}
+      },
+      "ReturnConsumedCapacity": "TOTAL"
     }
     )EOF";
-    Json::ObjectSharedPtr json_data = Json::Factory::loadFromString(json_string);
 
-    RequestParser::TableDescriptor table = RequestParser::parseTable("BatchWriteItem", *json_data);
+    RequestParser::TableDescriptor table = parseTable("BatchWriteItem", json_string);
     EXPECT_EQ("table_2", table.table_name);
     EXPECT_TRUE(table.is_single_table);
   }
 
   {
-    Json::ObjectSharedPtr json_data = Json::Factory::loadFromString("{}");
-    RequestParser::TableDescriptor table =
-        RequestParser::parseTable("BatchWriteItem", *Json::Factory::loadFromString("{}"));
+    RequestParser::TableDescriptor table = parseTable("BatchWriteItem", "{}");
     EXPECT_EQ("", table.table_name);
     EXPECT_TRUE(table.is_single_table);
   }
 
   {
-    Json::ObjectSharedPtr json_data = Json::Factory::loadFromString("{\"RequestItems\":{}}");
-    RequestParser::TableDescriptor table = RequestParser::parseTable("BatchWriteItem", *json_data);
+    RequestParser::TableDescriptor table = parseTable("BatchWriteItem", "{\"RequestItems\":{}}");
     EXPECT_EQ("", table.table_name);
     EXPECT_TRUE(table.is_single_table);
   }
 
   {
-    Json::ObjectSharedPtr json_data = Json::Factory::loadFromString("{}");
-    RequestParser::TableDescriptor table = RequestParser::parseTable("BatchGetItem", *json_data);
+    RequestParser::TableDescriptor table = parseTable("BatchGetItem", "{}");
     EXPECT_EQ("", table.table_name);
     EXPECT_TRUE(table.is_single_table);
   }
 }
+
 TEST(DynamoRequestParser, parseBatchUnProcessedKeys) {
-  {
-    Json::ObjectSharedPtr json_data = Json::Factory::loadFromString("{}");
-    std::vector<std::string> unprocessed_tables =
-        RequestParser::parseBatchUnProcessedKeys(*json_data);
-    EXPECT_EQ(0u, unprocessed_tables.size());
-  }
-  {
-    std::vector<std::string> unprocessed_tables = RequestParser::parseBatchUnProcessedKeys(
-        *Json::Factory::loadFromString("{\"UnprocessedKeys\":{}}"));
-    EXPECT_EQ(0u, unprocessed_tables.size());
-  }
+  EXPECT_EQ(0u, parseResponse("{}").unprocessedTables().size());
+  EXPECT_EQ(0u, parseResponse("{\"UnprocessedKeys\":{}}").unprocessedTables().size());
+  EXPECT_EQ(std::vector<std::string>{"table_1"},
+            parseResponse("{\"UnprocessedKeys\":{\"table_1\" :{}}}").unprocessedTables());
 
+  std::string json_string = R"EOF(
   {
-    std::vector<std::string> unprocessed_tables = RequestParser::parseBatchUnProcessedKeys(
-        *Json::Factory::loadFromString("{\"UnprocessedKeys\":{\"table_1\" :{}}}"));
-    EXPECT_EQ("table_1", unprocessed_tables[0]);
-    EXPECT_EQ(1u, unprocessed_tables.size());
+    "UnprocessedKeys": {
+      "table_1": { "test1" : "something" },
+      "table_2": { "test2" : "something" }
+    }
   }
+  )EOF";
+  EXPECT_EQ((std::vector<std::string>{"table_1", "table_2"}),
+            parseResponse(json_string).unprocessedTables());
+}
 
+TEST(DynamoRequestParser, parsePartitionIds) {
+  EXPECT_EQ(0u, parseResponse("{}").partitions().size());
+  EXPECT_EQ(0u, parseResponse("{\"ConsumedCapacity\":{}}").partitions().size());
+  EXPECT_EQ(0u, parseResponse("{\"ConsumedCapacity\":{ \"Partitions\":{}}}").partitions().size());
+
+  std::string json_string = R"EOF(
   {
-    std::string json_string = R"EOF(
-    {
-      "UnprocessedKeys": {
-        "table_1": { "test1" : "something" },
-        "table_2": { "test2" : "something" }
+    "ConsumedCapacity": {
+      "Partitions": {
+        "partition_1" : 0.5,
+        "partition_2" : 3.0,
+        "partition_3" : 12,
+        "partition_4" : "ignored"
       }
     }
-    )EOF";
-    Json::ObjectSharedPtr json_data = Json::Factory::loadFromString(json_string);
-
-    std::vector<std::string> unprocessed_tables =
-        RequestParser::parseBatchUnProcessedKeys(*json_data);
-    EXPECT_TRUE(find(unprocessed_tables.begin(), unprocessed_tables.end(), "table_1") !=
-                unprocessed_tables.end());
-    EXPECT_TRUE(find(unprocessed_tables.begin(), unprocessed_tables.end(), "table_2") !=
-                unprocessed_tables.end());
-    EXPECT_EQ(2u, unprocessed_tables.size());
   }
+  )EOF";
+  ResponseBodyParser parser = parseResponse(json_string);
+  ASSERT_EQ(3u, parser.partitions().size());
+  EXPECT_EQ("partition_1", parser.partitions()[0].partition_id_);
+  EXPECT_EQ(1u, parser.partitions()[0].capacity_);
+  EXPECT_EQ("partition_2", parser.partitions()[1].partition_id_);
+  EXPECT_EQ(3u, parser.partitions()[1].capacity_);
+  EXPECT_EQ("partition_3", parser.partitions()[2].partition_id_);
+  EXPECT_EQ(12u, parser.partitions()[2].capacity_);
 }
 
-TEST(DynamoRequestParser, parsePartitionIds) {
-  {
-    std::vector<RequestParser::PartitionDescriptor> partitions =
-        RequestParser::parsePartitions(*Json::Factory::loadFromString("{}"));
-    EXPECT_EQ(0u, partitions.size());
+TEST(DynamoRequestParser, InvalidBody) {
+  const std::vector<std::string> bodies{"",
+                                        " ",
+                                        "[]",
+                                        "\"TableName\"",
+                                        "{",
+                                        "{}}",
+                                        "{} x",
+                                        "{\"TableName\"}",
+                                        "{\"TableName\":}",
+                                        "{\"TableName\":\"Pets\",}",
+                                        "{\"TableName\":\"Pets\" \"Key\":1}",
+                                        "{TableName:\"Pets\"}",
+                                        "{\"a\":[1,]}",
+                                        "{\"a\":[1}",
+                                        "{\"a\":{]}",
+                                        "{\"a\":\"\x01\"}",
+                                        "{\"a\":\"\\x\"}",
+                                        "{\"a\":\"\\u12g4\"}",
+                                        "{\"a\":tru}",
+                                        "{\"a\":nul}",
+                                        "{\"a\":01}",
+                                        "{\"a\":-}",
+                                        "{\"a\":--1}",
+                                        "{\"a\":1.}",
+                                        "{\"a\":.5}",
+                                        "{\"a\":1e}",
+                                        "{\"a\":1e+}",
+                                        "{\"a\":+1}"};
+  for (const std::string& body : bodies) {
+    RequestBodyParser parser("GetItem");
+    EXPECT_FALSE(parseBody(parser, body, 1)) << body;
+    EXPECT_EQ(body.empty(), parser.empty());
   }
-  {
-    std::vector<RequestParser::PartitionDescriptor> partitions =
-        RequestParser::parsePartitions(*Json::Factory::loadFromString("{\"ConsumedCapacity\":{}}"));
-    EXPECT_EQ(0u, partitions.size());
-  }
-  {
-    std::vector<RequestParser::PartitionDescriptor> partitions = RequestParser::parsePartitions(
-        *Json::Factory::loadFromString("{\"ConsumedCapacity\":{ \"Partitions\":{}}}"));
-    EXPECT_EQ(0u, partitions.size());
-  }
-  {
-    std::string json_string = R"EOF(
-    {
-      "ConsumedCapacity": {
-        "Partitions": {
-          "partition_1" : 0.5,
-          "partition_2" : 3.0
-        }
-      }
-    }
-    )EOF";
-    Json::ObjectSharedPtr json_data = Json::Factory::loadFromString(json_string);
-
-    std::vector<RequestParser::PartitionDescriptor> partitions =
-        RequestParser::parsePartitions(*json_data);
-    for (const RequestParser::PartitionDescriptor& partition : partitions) {
-      if (partition.partition_id_ == "partition_1") {
-        EXPECT_EQ(1u, partition.capacity_);
-      } else {
-        EXPECT_EQ(3u, partition.capacity_);
-      }
-    }
-    EXPECT_EQ(2u, partitions.size());
+
+  const std::vector<std::string> valid_bodies{"{}",
+                                              " {\"a\" : [ ] } \r\n",
+                                              "{\"a\":[1,-0,0.5,1E5,-2.5e-3,\"\\u0041\"]}",
+                                              "{\"a\":{\"b\":{\"c\":{\"d\":[{}]}}}}"};
+  for (const std::string& body : valid_bodies) {
+    RequestBodyParser parser("GetItem");
+    EXPECT_TRUE(parseBody(parser, body, 1)) << body;
   }
 }
 
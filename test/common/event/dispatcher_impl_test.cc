@@ -1,14 +1,23 @@
+#include <chrono>
+#include <cstdint>
 #include <functional>
+#include <thread>
+#include <vector>
 
+#include "common/common/thread.h"
 #include "common/event/dispatcher_impl.h"
 
 #include "test/mocks/common.h"
+#include "test/mocks/stats/mocks.h"
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
 namespace Envoy {
 using testing::InSequence;
+using testing::Invoke;
+using testing::NiceMock;
+using testing::_;
 
 namespace Event {
 
@@ -51,5 +60,125 @@ TEST(DispatcherImplTest, DeferredDelete) {
   dispatcher.clearDeferredDeleteList();
 }
 
+TEST(DispatcherImplTest, Post) {
+  DispatcherImpl dispatcher;
+  std::vector<uint32_t> order;
+
+  // Callbacks posted from a callback run in the same pass, after the ones already queued.
+  dispatcher.post([&]() -> void {
+    order.push_back(1);
+    dispatcher.post([&]() -> void { order.push_back(3); });
+  });
+  dispatcher.post([&]() -> void { order.push_back(2); });
+  dispatcher.run(Dispatcher::RunType::NonBlock);
+  EXPECT_EQ((std::vector<uint32_t>{1, 2, 3}), order);
+}
+
+TEST(DispatcherImplTest, PostFromOtherThreads) {
+  static const uint32_t NumThreads = 4;
+  static const uint32_t NumPosts = 1000;
+
+  DispatcherImpl dispatcher;
+  std::vector<std::vector<uint32_t>> received(NumThreads);
+  uint32_t num_received = 0;
+
+  // Keep the loop running until every post has been seen.
+  TimerPtr keepalive = dispatcher.createTimer([]() -> void {});
+  keepalive->enableTimer(std::chrono::hours(1));
+
+  std::vector<Thread::ThreadPtr> threads;
+  for (uint32_t i = 0; i < NumThreads; i++) {
+    threads.emplace_back(new Thread::Thread([&, i]() -> void {
+      for (uint32_t j = 0; j < NumPosts; j++) {
+        dispatcher.post([&, i, j]() -> void {
+          received[i].push_back(j);
+          if (++num_received == NumThreads * NumPosts) {
+            dispatcher.exit();
+          }
+        });
+      }
+    }));
+  }
+
+  dispatcher.run(Dispatcher::RunType::Block);
+  for (Thread::ThreadPtr& thread : threads) {
+    thread->join();
+  }
+
+  // Each thread's posts run in the order they were made.
+  for (uint32_t i = 0; i < NumThreads; i++) {
+    ASSERT_EQ(NumPosts, received[i].size());
+    for (uint32_t j = 0; j < NumPosts; j++) {
+      EXPECT_EQ(j, received[i][j]);
+    }
+  }
+}
+
+TEST(DispatcherImplTest, CoarseTimer) {
+  DispatcherImpl dispatcher;
+  std::vector<uint32_t> order;
+
+  // Coarse timers that fall due in the same wheel tick fire together, in the order enabled.
+  TimerPtr timer1 = dispatcher.createCoarseTimer([&]() -> void { order.push_back(1); });
+  TimerPtr timer2 = dispatcher.createCoarseTimer([&]() -> void {
+    order.push_back(2);
+    dispatcher.exit();
+  });
+  TimerPtr disabled = dispatcher.createCoarseTimer([&]() -> void { order.push_back(3); });
+  timer1->enableTimer(std::chrono::milliseconds(1));
+  timer2->enableTimer(std::chrono::milliseconds(1));
+  disabled->enableTimer(std::chrono::milliseconds(1));
+  disabled->disableTimer();
+
+  MonotonicTime start = std::chrono::steady_clock::now();
+  dispatcher.run(Dispatcher::RunType::Block);
+  EXPECT_EQ((std::vector<uint32_t>{1, 2}), order);
+  EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(1));
+}
+
+TEST(DispatcherImplTest, LoopTime) {
+  DispatcherImpl dispatcher;
+  MonotonicTimeSource& loop_time = dispatcher.loopTimeSource();
+  std::vector<MonotonicTime> times;
+
+  // The loop time does not move while an event is handled, and moves on for the next event.
+  TimerPtr timer2 = dispatcher.createTimer([&]() -> void {
+    times.push_back(loop_time.currentTime());
+    dispatcher.exit();
+  });
+  TimerPtr timer1 = dispatcher.createTimer([&]() -> void {
+    times.push_back(loop_time.currentTime());
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    times.push_back(loop_time.currentTime());
+    timer2->enableTimer(std::chrono::milliseconds(1));
+  });
+  timer1->enableTimer(std::chrono::milliseconds(0));
+  dispatcher.run(Dispatcher::RunType::Block);
+
+  ASSERT_EQ(3U, times.size());
+  EXPECT_EQ(times[0], times[1]);
+  EXPECT_GE(times[2] - times[1], std::chrono::milliseconds(2));
+}
+
+TEST(DispatcherImplTest, Stats) {
+  NiceMock<Stats::MockStore> store;
+  DispatcherImpl dispatcher;
+  dispatcher.initializeStats(store, "test.");
+
+  EXPECT_CALL(store, deliverHistogramToSinks("test.dispatcher.post_queue_depth", 2));
+  dispatcher.post([]() -> void {});
+  dispatcher.post([]() -> void {});
+  dispatcher.run(Dispatcher::RunType::NonBlock);
+
+  EXPECT_CALL(store, deliverHistogramToSinks("test.dispatcher.deferred_delete_size", 1));
+  dispatcher.deferredDelete(DeferredDeletablePtr{new TestDeferredDeletable([]() -> void {})});
+  dispatcher.clearDeferredDeleteList();
+
+  // The load probe keeps the loop running until it reports.
+  EXPECT_CALL(store, deliverHistogramToSinks("test.dispatcher.loop_delay_us", _))
+      .WillOnce(Invoke([&](const std::string&, uint64_t) -> void { dispatcher.exit(); }));
+  dispatcher.run(Dispatcher::RunType::Block);
+}
+
 } // Event
 } // Envoy
@@ -0,0 +1,75 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "common/common/thread.h"
+#include "common/event/dispatcher_impl.h"
+
+#include "gtest/gtest.h"
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+namespace Event {
+
+/**
+ * This test is for benchmarking only and should not be run as part of unit tests. It measures the
+ * latency from post() to the callback running on the dispatcher thread while several threads post
+ * concurrently.
+ */
+class DISABLED_DispatcherPostBenchmark : public testing::Test {
+public:
+  static const uint32_t NumPostsPerThread = 250000;
+
+  void run(uint32_t num_threads) {
+    DispatcherImpl dispatcher;
+    std::vector<uint64_t> latencies_ns;
+    latencies_ns.reserve(num_threads * NumPostsPerThread);
+
+    // Keep the loop running while the queue is momentarily empty.
+    TimerPtr keepalive = dispatcher.createTimer([]() -> void {});
+    keepalive->enableTimer(std::chrono::hours(1));
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<Thread::ThreadPtr> threads;
+    for (uint32_t i = 0; i < num_threads; i++) {
+      threads.emplace_back(new Thread::Thread([&]() -> void {
+        for (uint32_t j = 0; j < NumPostsPerThread; j++) {
+          const std::chrono::steady_clock::time_point posted = std::chrono::steady_clock::now();
+          dispatcher.post([&, posted]() -> void {
+            latencies_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                       std::chrono::steady_clock::now() - posted)
+                                       .count());
+            if (latencies_ns.size() == num_threads * NumPostsPerThread) {
+              dispatcher.exit();
+            }
+          });
+        }
+      }));
+    }
+
+    dispatcher.run(Dispatcher::RunType::Block);
+    const std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+    for (Thread::ThreadPtr& thread : threads) {
+      thread->join();
+    }
+
+    std::sort(latencies_ns.begin(), latencies_ns.end());
+    const size_t count = latencies_ns.size();
+    std::cout << fmt::format("threads={} posts={} throughput={}/s p50={}ns p99={}ns max={}ns",
+                             num_threads, count, count * 1000000000ULL / elapsed.count(),
+                             latencies_ns[count / 2], latencies_ns[count * 99 / 100],
+                             latencies_ns[count - 1])
+              << std::endl;
+  }
+};
+
+TEST_F(DISABLED_DispatcherPostBenchmark, Contention) {
+  for (uint32_t num_threads : {1, 2, 4, 8}) {
+    run(num_threads);
+  }
+}
+
+} // Event
+} // Envoy
@@ -0,0 +1,125 @@
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "common/event/timer_wheel.h"
+
+#include "test/mocks/common.h"
+#include "test/mocks/event/mocks.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::Invoke;
+using testing::NiceMock;
+using testing::_;
+
+namespace Envoy {
+namespace Event {
+
+class TimerWheelTest : public testing::Test {
+public:
+  TimerWheelTest() {
+    ON_CALL(time_source_, currentTime()).WillByDefault(Invoke([this]() -> MonotonicTime {
+      return start_time_ + now_;
+    }));
+    tick_timer_ = new MockTimer(&dispatcher_);
+    wheel_.reset(new TimerWheel(dispatcher_, std::chrono::milliseconds(10), time_source_));
+  }
+
+  void advanceAndTick(std::chrono::milliseconds ms) {
+    now_ += ms;
+    tick_timer_->callback_();
+  }
+
+  NiceMock<MockMonotonicTimeSource> time_source_;
+  const MonotonicTime start_time_{std::chrono::hours(1)};
+  std::chrono::milliseconds now_{};
+  MockDispatcher dispatcher_;
+  MockTimer* tick_timer_;
+  std::unique_ptr<TimerWheel> wheel_;
+  std::vector<std::string> fired_;
+};
+
+TEST_F(TimerWheelTest, TimersInSameTickShareEvent) {
+  TimerPtr timer1 = wheel_->createTimer([this]() -> void { fired_.push_back("timer1"); });
+  TimerPtr timer2 = wheel_->createTimer([this]() -> void { fired_.push_back("timer2"); });
+
+  EXPECT_CALL(*tick_timer_, enableTimer(std::chrono::milliseconds(10)));
+  timer1->enableTimer(std::chrono::milliseconds(15));
+  timer2->enableTimer(std::chrono::milliseconds(18));
+  EXPECT_EQ(2UL, wheel_->pendingTimers());
+
+  // Neither timer is due yet, so the wheel just keeps ticking.
+  EXPECT_CALL(*tick_timer_, enableTimer(std::chrono::milliseconds(10)));
+  advanceAndTick(std::chrono::milliseconds(10));
+  EXPECT_TRUE(fired_.empty());
+
+  // Both timers round up to the same tick and fire from a single event. The wheel goes idle.
+  EXPECT_CALL(*tick_timer_, enableTimer(_)).Times(0);
+  advanceAndTick(std::chrono::milliseconds(10));
+  EXPECT_EQ((std::vector<std::string>{"timer1", "timer2"}), fired_);
+  EXPECT_EQ(0UL, wheel_->pendingTimers());
+}
+
+TEST_F(TimerWheelTest, DisableAndReenable) {
+  TimerPtr timer1 = wheel_->createTimer([this]() -> void { fired_.push_back("timer1"); });
+  TimerPtr timer2;
+  timer2 = wheel_->createTimer([&]() -> void {
+    fired_.push_back("timer2");
+    // Re-enabling a timer from its own callback schedules it for a later tick.
+    timer2->enableTimer(std::chrono::milliseconds(0));
+  });
+  TimerPtr timer3 = wheel_->createTimer([this]() -> void { fired_.push_back("timer3"); });
+
+  EXPECT_CALL(*tick_timer_, enableTimer(std::chrono::milliseconds(10))).Times(2);
+  timer1->enableTimer(std::chrono::milliseconds(10));
+  timer2->enableTimer(std::chrono::milliseconds(10));
+  timer3->enableTimer(std::chrono::milliseconds(10));
+  timer1->disableTimer();
+  timer1->disableTimer();
+  timer3.reset();
+  EXPECT_EQ(1UL, wheel_->pendingTimers());
+
+  advanceAndTick(std::chrono::milliseconds(10));
+  EXPECT_EQ((std::vector<std::string>{"timer2"}), fired_);
+  EXPECT_EQ(1UL, wheel_->pendingTimers());
+
+  timer2->disableTimer();
+  EXPECT_CALL(*tick_timer_, enableTimer(_)).Times(0);
+  advanceAndTick(std::chrono::milliseconds(10));
+  EXPECT_EQ((std::vector<std::string>{"timer2"}), fired_);
+}
+
+TEST_F(TimerWheelTest, CallbackDisablesReadyTimer) {
+  TimerPtr timer2 = wheel_->createTimer([this]() -> void { fired_.push_back("timer2"); });
+  TimerPtr timer1 = wheel_->createTimer([&]() -> void {
+    fired_.push_back("timer1");
+    timer2->disableTimer();
+  });
+
+  EXPECT_CALL(*tick_timer_, enableTimer(_));
+  timer1->enableTimer(std::chrono::milliseconds(5));
+  timer2->enableTimer(std::chrono::milliseconds(5));
+  advanceAndTick(std::chrono::milliseconds(10));
+  EXPECT_EQ((std::vector<std::string>{"timer1"}), fired_);
+  EXPECT_EQ(0UL, wheel_->pendingTimers());
+}
+
+TEST_F(TimerWheelTest, TimeoutLongerThanOneRevolution) {
+  TimerPtr timer = wheel_->createTimer([this]() -> void { fired_.push_back("timer"); });
+
+  // 512 slots at 10ms is a 5.12s revolution. A 6s timer shares a slot with tick 88 of the first
+  // revolution but must not fire until the second one.
+  EXPECT_CALL(*tick_timer_, enableTimer(_)).Times(2);
+  timer->enableTimer(std::chrono::milliseconds(6000));
+  advanceAndTick(std::chrono::milliseconds(880));
+  EXPECT_TRUE(fired_.empty());
+
+  // The loop was blocked for longer than a full revolution, all due timers still fire.
+  advanceAndTick(std::chrono::milliseconds(6000));
+  EXPECT_EQ((std::vector<std::string>{"timer"}), fired_);
+}
+
+} // Event
+} // Envoy
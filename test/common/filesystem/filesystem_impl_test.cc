@@ -1,6 +1,8 @@
 #include <chrono>
 #include <fstream>
+#include <future>
 #include <string>
+#include <vector>
 
 #include "common/common/thread.h"
 #include "common/event/dispatcher_impl.h"
@@ -63,6 +65,19 @@ TEST(FileSystemImpl, fileReadToEndDoesNotExist) {
                EnvoyException);
 }
 
+TEST(FileSystemImpl, fileWriteAtomically) {
+  const std::string file_path = TestEnvironment::temporaryPath("envoy_write_atomically");
+  unlink(file_path.c_str());
+
+  Filesystem::fileWriteAtomically(file_path, "first");
+  EXPECT_EQ("first", Filesystem::fileReadToEnd(file_path));
+  Filesystem::fileWriteAtomically(file_path, std::string("sec\0ond", 7));
+  EXPECT_EQ(std::string("sec\0ond", 7), Filesystem::fileReadToEnd(file_path));
+  EXPECT_FALSE(Filesystem::fileExists(fmt::format("{}.{}.tmp", file_path, getpid())));
+
+  EXPECT_THROW(Filesystem::fileWriteAtomically("/dev/blahblah/file", "data"), EnvoyException);
+}
+
 TEST(FileSystemImpl, flushToLogFilePeriodically) {
   NiceMock<Event::MockDispatcher> dispatcher;
   NiceMock<Event::MockTimer>* timer = new NiceMock<Event::MockTimer>(&dispatcher);
@@ -116,6 +131,34 @@ TEST(FileSystemImpl, flushToLogFilePeriodically) {
   }
 }
 
+TEST(FileSystemImpl, flushWithoutCrossProcessLock) {
+  NiceMock<Event::MockDispatcher> dispatcher;
+  NiceMock<Event::MockTimer>* timer = new NiceMock<Event::MockTimer>(&dispatcher);
+
+  Thread::MutexBasicLockable mutex;
+  Stats::IsolatedStoreImpl stats_store;
+  NiceMock<Filesystem::MockOsSysCalls> os_sys_calls;
+
+  EXPECT_CALL(os_sys_calls, open_(_, _, _)).WillOnce(Return(5));
+  Filesystem::FileImpl file("", dispatcher, mutex, os_sys_calls, stats_store,
+                            std::chrono::milliseconds(40));
+
+  EXPECT_CALL(os_sys_calls, write_(_, _, _))
+      .WillOnce(Invoke([](int, const void*, size_t num_bytes) -> ssize_t { return num_bytes; }));
+
+  // Another process holding the lock does not hold up a flush that fits in a single write.
+  std::unique_lock<Thread::BasicLockable> cross_process_lock(mutex);
+  file.write("test");
+  timer->callback_();
+
+  {
+    std::unique_lock<Thread::BasicLockable> lock(os_sys_calls.write_mutex_);
+    while (os_sys_calls.num_writes_ != 1) {
+      os_sys_calls.write_event_.wait(os_sys_calls.write_mutex_);
+    }
+  }
+}
+
 TEST(FileSystemImpl, reopenFile) {
   NiceMock<Event::MockDispatcher> dispatcher;
   NiceMock<Event::MockTimer>* timer = new NiceMock<Event::MockTimer>(&dispatcher);
@@ -277,4 +320,86 @@ TEST(FilesystemImpl, bigDataChunkShouldBeFlushedWithoutTimer) {
     }
   }
 }
+
+TEST(FilesystemImpl, writesFromMultipleThreadsAreFlushedTogether) {
+  NiceMock<Event::MockDispatcher> dispatcher;
+  NiceMock<Event::MockTimer>* timer = new NiceMock<Event::MockTimer>(&dispatcher);
+
+  Thread::MutexBasicLockable mutex;
+  Stats::IsolatedStoreImpl stats_store;
+  NiceMock<Filesystem::MockOsSysCalls> os_sys_calls;
+
+  EXPECT_CALL(os_sys_calls, open_(_, _, _)).WillOnce(Return(5));
+  Filesystem::FileImpl file("", dispatcher, mutex, os_sys_calls, stats_store,
+                            std::chrono::milliseconds(40));
+
+  std::vector<Thread::ThreadPtr> threads;
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back(new Thread::Thread([&file]() -> void {
+      for (int j = 0; j < 10; j++) {
+        file.write("0123456789");
+      }
+    }));
+  }
+  for (Thread::ThreadPtr& thread : threads) {
+    thread->join();
+  }
+
+  EXPECT_EQ(40U, stats_store.gauge("filesystem.write_total_pending").value());
+  EXPECT_EQ(400U, stats_store.gauge("filesystem.write_total_buffered").value());
+
+  // All buffered lines go out in a single gathered write.
+  EXPECT_CALL(os_sys_calls, write_(5, _, 400)).WillOnce(Return(400));
+  timer->callback_();
+
+  {
+    std::unique_lock<Thread::BasicLockable> lock(os_sys_calls.write_mutex_);
+    while (os_sys_calls.num_writes_ != 1) {
+      os_sys_calls.write_event_.wait(os_sys_calls.write_mutex_);
+    }
+  }
+
+  EXPECT_EQ(0U, stats_store.gauge("filesystem.write_total_pending").value());
+  EXPECT_EQ(40U, stats_store.counter("filesystem.write_buffered").value());
+  EXPECT_EQ(1U, stats_store.counter("filesystem.write_completed").value());
+}
+
+TEST(FilesystemImpl, writesAreDroppedWhenBufferIsFull) {
+  NiceMock<Event::MockDispatcher> dispatcher;
+  Thread::MutexBasicLockable mutex;
+  Stats::IsolatedStoreImpl stats_store;
+  NiceMock<Filesystem::MockOsSysCalls> os_sys_calls;
+
+  Filesystem::FileImpl file("", dispatcher, mutex, os_sys_calls, stats_store,
+                            std::chrono::milliseconds(40));
+
+  // Block the flush thread in its first write so that data piles up behind it.
+  std::promise<void> write_started;
+  std::promise<void> unblock_write;
+  std::shared_future<void> unblocked = unblock_write.get_future().share();
+  const std::string chunk(1024 * 1024, 'a');
+  EXPECT_CALL(os_sys_calls, write_(_, _, _))
+      .WillOnce(Invoke([&](int, const void*, size_t num_bytes) -> ssize_t {
+        write_started.set_value();
+        unblocked.wait();
+        return num_bytes;
+      }))
+      .WillRepeatedly(Invoke([](int, const void*, size_t num_bytes) -> ssize_t {
+        return num_bytes;
+      }));
+
+  file.write(chunk);
+  write_started.get_future().wait();
+
+  // 64 chunks fill the buffer exactly, the next one is dropped.
+  for (int i = 0; i < 64; i++) {
+    file.write(chunk);
+  }
+  EXPECT_EQ(0U, stats_store.counter("filesystem.write_dropped").value());
+  file.write(chunk);
+  EXPECT_EQ(1U, stats_store.counter("filesystem.write_dropped").value());
+  EXPECT_EQ(64U, stats_store.gauge("filesystem.write_total_pending").value());
+
+  unblock_write.set_value();
+}
 } // Envoy
@@ -1,7 +1,10 @@
 #include <chrono>
 #include <memory>
+#include <random>
 #include <string>
+#include <vector>
 
+#include "common/common/hex.h"
 #include "common/filesystem/filesystem_impl.h"
 #include "common/filter/auth/client_ssl.h"
 #include "common/http/message_impl.h"
@@ -33,9 +36,58 @@ namespace Auth {
 namespace ClientSsl {
 
 TEST(ClientSslAuthAllowedPrincipalsTest, EmptyString) {
-  AllowedPrincipals principals;
-  principals.add("");
+  AllowedPrincipals principals({""});
   EXPECT_EQ(0UL, principals.size());
+  EXPECT_FALSE(principals.allowed(""));
+}
+
+TEST(ClientSslAuthAllowedPrincipalsTest, Lookup) {
+  const std::string digest1 = "1b7d42ef0025ad89c1c911d6c10d7e86a4cb7c5863b2980abcbad1895f8b5314";
+  const std::string digest2 = "e9c3f2cc9b887fe286380e294a1c4e939b25295a54436ef913a9190d7a6ae2f7";
+  AllowedPrincipals principals(
+      {digest2, digest1, digest2, "digest", digest1.substr(1), digest1 + "0",
+       "zb7d42ef0025ad89c1c911d6c10d7e86a4cb7c5863b2980abcbad1895f8b5314"});
+  EXPECT_EQ(2UL, principals.size());
+  EXPECT_TRUE(principals.allowed(digest1));
+  EXPECT_TRUE(principals.allowed(digest2));
+  EXPECT_TRUE(
+      principals.allowed("1B7D42EF0025AD89C1C911D6C10D7E86A4CB7C5863B2980ABCBAD1895F8B5314"));
+  EXPECT_FALSE(
+      principals.allowed("0b7d42ef0025ad89c1c911d6c10d7e86a4cb7c5863b2980abcbad1895f8b5314"));
+  EXPECT_FALSE(principals.allowed("digest"));
+  EXPECT_FALSE(principals.allowed(""));
+
+  EXPECT_TRUE(principals == AllowedPrincipals({digest1, digest2}));
+  EXPECT_TRUE(principals != AllowedPrincipals({digest1}));
+  EXPECT_FALSE(AllowedPrincipals().allowed(digest1));
+}
+
+TEST(ClientSslAuthAllowedPrincipalsTest, ManyPrincipals) {
+  std::mt19937_64 random(0);
+  auto randomDigest = [&random]() -> std::string {
+    std::string digest;
+    for (uint32_t i = 0; i < 4; i++) {
+      digest += Hex::uint64ToHex(random());
+    }
+    return digest;
+  };
+
+  std::vector<std::string> digests;
+  for (uint32_t i = 0; i < 10000; i++) {
+    digests.push_back(randomDigest());
+  }
+  // Digests that share their leading bits land in the same index slot.
+  digests.push_back(digests[0].substr(0, 32) + std::string(32, '0'));
+  digests.push_back(digests[0].substr(0, 32) + std::string(32, 'f'));
+
+  AllowedPrincipals principals(digests);
+  EXPECT_EQ(digests.size(), principals.size());
+  for (const std::string& digest : digests) {
+    EXPECT_TRUE(principals.allowed(digest));
+  }
+  for (uint32_t i = 0; i < 10000; i++) {
+    EXPECT_FALSE(principals.allowed(randomDigest()));
+  }
 }
 
 class ClientSslAuthFilterTest : public testing::Test {
@@ -236,6 +288,41 @@ TEST_F(ClientSslAuthFilterTest, Ssl) {
   EXPECT_EQ(4U, stats_store_.counter("auth.clientssl.vpn.update_failure").value());
 }
 
+TEST_F(ClientSslAuthFilterTest, UnchangedPrincipals) {
+  setup();
+  const std::string response_1 = Filesystem::fileReadToEnd(
+      TestEnvironment::runfilesPath("test/common/filter/auth/test_data/vpn_response_1.json"));
+  auto respond = [this](const std::string& body) -> void {
+    EXPECT_CALL(*interval_timer_, enableTimer(_));
+    Http::MessagePtr message(new Http::ResponseMessageImpl(
+        Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "200"}}}));
+    message->body().reset(new Buffer::OwnedImpl(body));
+    callbacks_->onSuccess(std::move(message));
+  };
+
+  EXPECT_CALL(tls_, set(_, _));
+  respond(response_1);
+  EXPECT_EQ(1U, stats_store_.gauge("auth.clientssl.vpn.total_principals").value());
+
+  // The response changes, but the principals do not, so the workers keep the set they have.
+  setupRequest();
+  interval_timer_->callback_();
+  EXPECT_CALL(tls_, set(_, _)).Times(0);
+  respond(response_1 + "\n");
+  EXPECT_TRUE(config_->allowedPrincipals().allowed(
+      "1b7d42ef0025ad89c1c911d6c10d7e86a4cb7c5863b2980abcbad1895f8b5314"));
+
+  // The principals change.
+  setupRequest();
+  interval_timer_->callback_();
+  EXPECT_CALL(tls_, set(_, _));
+  respond(R"EOF({"certificates": []})EOF");
+  EXPECT_EQ(0U, stats_store_.gauge("auth.clientssl.vpn.total_principals").value());
+  EXPECT_EQ(0U, config_->allowedPrincipals().size());
+
+  EXPECT_EQ(3U, stats_store_.counter("auth.clientssl.vpn.update_success").value());
+}
+
 } // ClientSsl
 } // Auth
 } // Filter
@@ -0,0 +1,217 @@
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/filter/tap.h"
+#include "common/network/address_impl.h"
+#include "common/stats/stats_impl.h"
+
+#include "test/mocks/access_log/mocks.h"
+#include "test/mocks/event/mocks.h"
+#include "test/mocks/network/mocks.h"
+#include "test/mocks/runtime/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace Envoy {
+using testing::_;
+using testing::NiceMock;
+using testing::Return;
+using testing::ReturnRef;
+using testing::SaveArg;
+
+namespace Filter {
+
+class TapFilterTest : public testing::Test {
+public:
+  struct Record {
+    TapEvent event_;
+    uint64_t connection_id_;
+    uint64_t timestamp_;
+    std::string data_;
+  };
+
+  void setup(const std::string& extra_config = "") {
+    std::string json = R"EOF(
+    {
+      "stat_prefix": "name",
+      "path": "/tmp/trace")EOF" +
+                       extra_config + "}";
+
+    timer_ = new NiceMock<Event::MockTimer>(&tls_.dispatcher_);
+    Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
+    config_.reset(new TapConfig(*config, log_manager_, tls_, runtime_, random_, stats_store_));
+    filter_.reset(new TapFilter(config_));
+    filter_->initializeReadFilterCallbacks(read_callbacks_);
+    ON_CALL(read_callbacks_.connection_, remoteAddress())
+        .WillByDefault(ReturnRef(remote_address_));
+  }
+
+  // Decodes the records of a trace. @see TapBuffer.
+  static std::vector<Record> decode(const std::string& trace) {
+    std::vector<Record> records;
+    size_t offset = 0;
+    auto read_int = [&trace, &offset](uint32_t bytes) -> uint64_t {
+      uint64_t value = 0;
+      for (uint32_t i = 0; i < bytes; i++) {
+        value |= static_cast<uint64_t>(static_cast<uint8_t>(trace[offset++])) << (i * 8);
+      }
+      return value;
+    };
+
+    while (offset < trace.size()) {
+      Record record;
+      record.event_ = static_cast<TapEvent>(read_int(1));
+      record.connection_id_ = read_int(8);
+      record.timestamp_ = read_int(8);
+      const uint64_t length = read_int(4);
+      record.data_ = trace.substr(offset, length);
+      offset += length;
+      records.push_back(record);
+    }
+    EXPECT_EQ(trace.size(), offset);
+    return records;
+  }
+
+  NiceMock<ThreadLocal::MockInstance> tls_;
+  NiceMock<AccessLog::MockAccessLogManager> log_manager_;
+  NiceMock<Runtime::MockLoader> runtime_;
+  NiceMock<Runtime::MockRandomGenerator> random_;
+  Stats::IsolatedStoreImpl stats_store_;
+  Event::MockTimer* timer_;
+  TapConfigSharedPtr config_;
+  std::unique_ptr<TapFilter> filter_;
+  NiceMock<Network::MockReadFilterCallbacks> read_callbacks_;
+  Network::Address::Ipv4Instance remote_address_{"10.0.0.1", 443};
+};
+
+TEST_F(TapFilterTest, SampledOut) {
+  setup();
+  EXPECT_CALL(runtime_.snapshot_, featureEnabled("tap.sample_percent", 100, _))
+      .WillOnce(Return(false));
+  EXPECT_CALL(read_callbacks_.connection_, addConnectionCallbacks(_)).Times(0);
+  EXPECT_EQ(Network::FilterStatus::Continue, filter_->onNewConnection());
+
+  Buffer::OwnedImpl data("hello");
+  EXPECT_EQ(Network::FilterStatus::Continue, filter_->onData(data));
+  EXPECT_EQ(Network::FilterStatus::Continue, filter_->onWrite(data));
+  EXPECT_EQ(5UL, data.length());
+
+  EXPECT_CALL(*log_manager_.file_, write(_)).Times(0);
+  config_->buffer().flush();
+  EXPECT_EQ(1UL, stats_store_.counter("tap.name.cx_sampled_out").value());
+  EXPECT_EQ(0UL, stats_store_.counter("tap.name.cx_tapped").value());
+}
+
+TEST_F(TapFilterTest, RecordConnection) {
+  setup(R"EOF(, "sample_percent": 50)EOF");
+  EXPECT_CALL(random_, random()).WillOnce(Return(42));
+  EXPECT_CALL(runtime_.snapshot_, featureEnabled("tap.sample_percent", 50, 42))
+      .WillOnce(Return(true));
+
+  // Only the first record of a batch arms the flush timer.
+  EXPECT_CALL(*timer_, enableTimer(TapBuffer::FlushInterval));
+  filter_->onNewConnection();
+
+  Buffer::OwnedImpl request;
+  request.add("GET / HTTP/1.1\r\n");
+  request.add("\r\n");
+  filter_->onData(request);
+  Buffer::OwnedImpl response("HTTP/1.1 200 OK\r\n\r\n");
+  filter_->onWrite(response);
+  read_callbacks_.connection_.raiseEvents(Network::ConnectionEvent::RemoteClose);
+
+  std::string trace;
+  EXPECT_CALL(*log_manager_.file_, write(_)).WillOnce(SaveArg<0>(&trace));
+  EXPECT_CALL(*timer_, disableTimer());
+  timer_->callback_();
+
+  const uint64_t id = read_callbacks_.connection_.id();
+  std::vector<Record> records = decode(trace);
+  ASSERT_EQ(4UL, records.size());
+  EXPECT_EQ(TapEvent::Connected, records[0].event_);
+  EXPECT_EQ("10.0.0.1:443", records[0].data_);
+  EXPECT_EQ(TapEvent::Read, records[1].event_);
+  EXPECT_EQ("GET / HTTP/1.1\r\n\r\n", records[1].data_);
+  EXPECT_EQ(TapEvent::Write, records[2].event_);
+  EXPECT_EQ("HTTP/1.1 200 OK\r\n\r\n", records[2].data_);
+  EXPECT_EQ(TapEvent::Closed, records[3].event_);
+  EXPECT_EQ("", records[3].data_);
+  for (const Record& record : records) {
+    EXPECT_EQ(id, record.connection_id_);
+    EXPECT_LE(records[0].timestamp_, record.timestamp_);
+  }
+
+  // Data is only recorded, never consumed.
+  EXPECT_EQ(18UL, request.length());
+  EXPECT_EQ(1UL, stats_store_.counter("tap.name.cx_tapped").value());
+  EXPECT_EQ(37UL, stats_store_.counter("tap.name.captured_bytes").value());
+  EXPECT_EQ(0UL, stats_store_.counter("tap.name.cx_truncated").value());
+}
+
+TEST_F(TapFilterTest, Truncate) {
+  setup(R"EOF(, "max_connection_bytes": 8)EOF");
+  ON_CALL(runtime_.snapshot_, featureEnabled("tap.sample_percent", 100, _))
+      .WillByDefault(Return(true));
+  filter_->onNewConnection();
+
+  Buffer::OwnedImpl data("hello");
+  filter_->onData(data);
+  filter_->onWrite(data);
+  filter_->onData(data);
+
+  std::string trace;
+  EXPECT_CALL(*log_manager_.file_, write(_)).WillOnce(SaveArg<0>(&trace));
+  config_->buffer().flush();
+
+  std::vector<Record> records = decode(trace);
+  ASSERT_EQ(3UL, records.size());
+  EXPECT_EQ("hello", records[1].data_);
+  EXPECT_EQ(TapEvent::Write, records[2].event_);
+  EXPECT_EQ("hel", records[2].data_);
+  EXPECT_EQ(1UL, stats_store_.counter("tap.name.cx_truncated").value());
+  EXPECT_EQ(8UL, stats_store_.counter("tap.name.captured_bytes").value());
+}
+
+TEST_F(TapFilterTest, FlushWhenFull) {
+  setup(R"EOF(, "max_connection_bytes": 1048576)EOF");
+  ON_CALL(runtime_.snapshot_, featureEnabled("tap.sample_percent", 100, _))
+      .WillByDefault(Return(true));
+  filter_->onNewConnection();
+
+  // A batch that reaches FlushBytes is handed to the file right away.
+  Buffer::OwnedImpl data(std::string(TapBuffer::FlushBytes, 'a'));
+  std::string trace;
+  EXPECT_CALL(*log_manager_.file_, write(_)).WillOnce(SaveArg<0>(&trace));
+  filter_->onData(data);
+
+  std::vector<Record> records = decode(trace);
+  ASSERT_EQ(2UL, records.size());
+  EXPECT_EQ(TapBuffer::FlushBytes, records[1].data_.size());
+
+  // Nothing is left to flush when the worker shuts down.
+  EXPECT_CALL(*log_manager_.file_, write(_)).Times(0);
+  tls_.shutdownThread_();
+}
+
+TEST_F(TapFilterTest, FlushOnShutdown) {
+  setup();
+  ON_CALL(runtime_.snapshot_, featureEnabled("tap.sample_percent", 100, _))
+      .WillByDefault(Return(true));
+  filter_->onNewConnection();
+
+  std::string trace;
+  EXPECT_CALL(*log_manager_.file_, write(_)).WillOnce(SaveArg<0>(&trace));
+  tls_.shutdownThread_();
+
+  std::vector<Record> records = decode(trace);
+  ASSERT_EQ(1UL, records.size());
+  EXPECT_EQ(TapEvent::Connected, records[0].event_);
+}
+
+} // Filter
+} // Envoy
@@ -21,6 +21,7 @@
 namespace Envoy {
 using testing::_;
 using testing::NiceMock;
+using testing::Ref;
 using testing::Return;
 using testing::ReturnRef;
 using testing::SaveArg;
@@ -272,6 +273,64 @@ TEST(TcpProxyConfigTest, Routes) {
   }
 }
 
+TEST(TcpProxyConfigTest, FirstMatchingRouteWins) {
+  std::string json = R"EOF(
+    {
+      "stat_prefix": "name",
+      "route_config": {
+        "routes": [
+          {
+            "source_ip_list": [
+              "1.0.0.0/8"
+            ],
+            "destination_ports": "1-100",
+            "cluster": "first"
+          },
+          {
+            "destination_ports": "50-60,55,4000-5000",
+            "cluster": "second"
+          },
+          {
+            "source_ip_list": [
+              "0.0.0.0/0"
+            ],
+            "cluster": "third"
+          },
+          {
+            "cluster": "catch_all"
+          }
+        ]
+      }
+    }
+    )EOF";
+
+  Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json);
+  NiceMock<Upstream::MockClusterManager> cm_;
+
+  TcpProxyConfig config_obj(*json_config, cm_,
+                            cm_.thread_local_cluster_.cluster_.info_->stats_store_);
+
+  auto route = [&](const Network::Address::Instance& remote_address,
+                   uint32_t local_port) -> std::string {
+    NiceMock<Network::MockConnection> connection;
+    Network::Address::Ipv4Instance local_address("10.0.0.1", local_port);
+    EXPECT_CALL(connection, localAddress()).WillRepeatedly(ReturnRef(local_address));
+    EXPECT_CALL(connection, remoteAddress()).WillRepeatedly(ReturnRef(remote_address));
+    return config_obj.getRouteFromEntries(connection);
+  };
+
+  EXPECT_EQ("first", route(Network::Address::Ipv4Instance("1.2.3.4"), 55));
+  EXPECT_EQ("first", route(Network::Address::Ipv4Instance("1.2.3.4"), 1));
+  EXPECT_EQ("second", route(Network::Address::Ipv4Instance("2.2.3.4"), 55));
+  EXPECT_EQ("second", route(Network::Address::Ipv4Instance("1.2.3.4"), 5000));
+  EXPECT_EQ("third", route(Network::Address::Ipv4Instance("1.2.3.4"), 101));
+  EXPECT_EQ("third", route(Network::Address::Ipv4Instance("255.255.255.255"), 65535));
+
+  // Source IP lists only contain IPv4 ranges.
+  EXPECT_EQ("second", route(Network::Address::Ipv6Instance("::1"), 55));
+  EXPECT_EQ("catch_all", route(Network::Address::Ipv6Instance("::1"), 101));
+}
+
 TEST(TcpProxyConfigTest, EmptyRouteConfig) {
   std::string json = R"EOF(
     {
@@ -369,6 +428,78 @@ TEST_F(TcpProxyTest, UpstreamDisconnect) {
   upstream_connection_->raiseEvents(Network::ConnectionEvent::RemoteClose);
 }
 
+TEST_F(TcpProxyTest, SpliceAfterConnected) {
+  std::string json = R"EOF(
+  {
+    "stat_prefix": "name",
+    "route_config": {
+      "routes": [
+        {
+          "cluster": "fake_cluster"
+        }
+      ]
+    },
+    "splice": true
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
+  config_.reset(new TcpProxyConfig(
+      *config, cluster_manager_, cluster_manager_.thread_local_cluster_.cluster_.info_->stats_store_));
+  setup(true);
+
+  EXPECT_CALL(filter_callbacks_.connection_, spliceTo(_, _)).Times(0);
+  EXPECT_CALL(*upstream_connection_, spliceTo(_, _)).Times(0);
+  Buffer::OwnedImpl buffer("hello");
+  EXPECT_CALL(*upstream_connection_, write(BufferEqual(&buffer)));
+  filter_->onData(buffer);
+
+  EXPECT_CALL(filter_callbacks_.connection_, spliceTo(Ref(*upstream_connection_), _))
+      .WillOnce(Return(true));
+  EXPECT_CALL(*upstream_connection_, spliceTo(Ref(filter_callbacks_.connection_), _))
+      .WillOnce(Return(false));
+  upstream_connection_->raiseEvents(Network::ConnectionEvent::Connected);
+  EXPECT_EQ(1U, config_->stats().downstream_cx_spliced_.value());
+
+  // The upstream direction was not spliced so it still goes through the filter.
+  Buffer::OwnedImpl response("world");
+  EXPECT_CALL(filter_callbacks_.connection_, write(BufferEqual(&response)));
+  upstream_read_filter_->onData(response);
+}
+
+TEST_F(TcpProxyTest, NoSpliceByDefault) {
+  setup(true);
+
+  EXPECT_CALL(filter_callbacks_.connection_, spliceTo(_, _)).Times(0);
+  EXPECT_CALL(*upstream_connection_, spliceTo(_, _)).Times(0);
+  upstream_connection_->raiseEvents(Network::ConnectionEvent::Connected);
+  EXPECT_EQ(0U, config_->stats().downstream_cx_spliced_.value());
+}
+
+TEST_F(TcpProxyTest, FlowControl) {
+  setup(true);
+  EXPECT_CALL(*connect_timer_, disableTimer());
+  upstream_connection_->raiseEvents(Network::ConnectionEvent::Connected);
+
+  // A slow downstream pauses reads from the upstream connection.
+  EXPECT_CALL(*upstream_connection_, readDisable(true));
+  filter_callbacks_.connection_.raiseWatermarkEvent(true);
+  EXPECT_CALL(*upstream_connection_, readDisable(false));
+  filter_callbacks_.connection_.raiseWatermarkEvent(false);
+
+  // And a slow upstream pauses reads from the downstream connection.
+  EXPECT_CALL(filter_callbacks_.connection_, readDisable(true));
+  upstream_connection_->raiseWatermarkEvent(true);
+  EXPECT_CALL(filter_callbacks_.connection_, readDisable(false));
+  upstream_connection_->raiseWatermarkEvent(false);
+
+  Stats::Store& store = cluster_manager_.thread_local_cluster_.cluster_.info_->stats_store_;
+  EXPECT_EQ(1U, store.counter("tcp.name.upstream_flow_control_paused_reading_total").value());
+  EXPECT_EQ(1U, store.counter("tcp.name.upstream_flow_control_resumed_reading_total").value());
+  EXPECT_EQ(1U, store.counter("tcp.name.downstream_flow_control_paused_reading_total").value());
+  EXPECT_EQ(1U, store.counter("tcp.name.downstream_flow_control_resumed_reading_total").value());
+}
+
 TEST_F(TcpProxyTest, DownstreamDisconnectRemote) {
   setup(true);
 
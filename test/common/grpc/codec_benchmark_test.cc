@@ -0,0 +1,66 @@
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/grpc/codec.h"
+
+#include "gtest/gtest.h"
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+namespace Grpc {
+
+/**
+ * This test is for benchmarking only and should not be run as part of unit tests. It measures how
+ * fast the decoder splits buffers that hold many small messages, as seen by the HTTP/1.1 bridge
+ * and the gRPC stats paths.
+ */
+class DISABLED_GrpcDecoderBenchmark : public testing::Test {
+public:
+  static const uint32_t NumBuffers = 10000;
+
+  void run(uint32_t message_size, uint32_t messages_per_buffer) {
+    std::string input;
+    std::array<uint8_t, 5> header;
+    Encoder().newFrame(GRPC_FH_DEFAULT, message_size, header);
+    for (uint32_t i = 0; i < messages_per_buffer; i++) {
+      input.append(reinterpret_cast<const char*>(header.data()), header.size());
+      input.append(message_size, 'a');
+    }
+
+    Decoder decoder;
+    std::vector<Frame> frames;
+    uint64_t decoded_bytes = 0;
+    std::chrono::nanoseconds elapsed{};
+    for (uint32_t i = 0; i < NumBuffers; i++) {
+      Buffer::OwnedImpl buffer(input);
+      frames.clear();
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      EXPECT_TRUE(decoder.decode(buffer, frames));
+      elapsed += std::chrono::steady_clock::now() - start;
+      for (const Frame& frame : frames) {
+        decoded_bytes += frame.length_;
+      }
+    }
+
+    const uint64_t messages = static_cast<uint64_t>(NumBuffers) * messages_per_buffer;
+    EXPECT_EQ(messages * message_size, decoded_bytes);
+    std::cout << fmt::format("message_size={} messages_per_buffer={} decode={}ns/message",
+                             message_size, messages_per_buffer, elapsed.count() / messages)
+              << std::endl;
+  }
+};
+
+TEST_F(DISABLED_GrpcDecoderBenchmark, SmallMessages) {
+  run(16, 256);
+  run(64, 64);
+}
+
+TEST_F(DISABLED_GrpcDecoderBenchmark, LargeMessages) { run(16384, 4); }
+
+} // Grpc
+} // Envoy
@@ -8,6 +8,7 @@
 
 #include "test/proto/helloworld.pb.h"
 #include "test/test_common/printers.h"
+#include "test/test_common/utility.h"
 
 #include "gtest/gtest.h"
 
@@ -164,5 +165,51 @@ TEST(GrpcCodecTest, decodeMultipleFrame) {
   }
 }
 
+TEST(GrpcCodecTest, decodeFramesSplitAcrossCalls) {
+  helloworld::HelloRequest request;
+  request.set_name("hello");
+
+  std::string input;
+  std::array<uint8_t, 5> header;
+  Encoder encoder;
+  encoder.newFrame(GRPC_FH_DEFAULT, request.ByteSize(), header);
+  for (int i = 0; i < 3; i++) {
+    input.append(reinterpret_cast<const char*>(header.data()), 5);
+    input.append(request.SerializeAsString());
+  }
+
+  // Every split point, including ones inside the frame header, yields the same frames.
+  for (uint64_t split = 1; split < input.size(); split++) {
+    std::vector<Frame> frames;
+    Decoder decoder;
+    Buffer::OwnedImpl buffer1(input.substr(0, split));
+    EXPECT_TRUE(decoder.decode(buffer1, frames));
+    EXPECT_EQ(0U, buffer1.length());
+    Buffer::OwnedImpl buffer2(input.substr(split));
+    EXPECT_TRUE(decoder.decode(buffer2, frames));
+    EXPECT_EQ(0U, buffer2.length());
+
+    ASSERT_EQ(3U, frames.size());
+    for (Frame& frame : frames) {
+      EXPECT_EQ(static_cast<uint64_t>(request.ByteSize()), frame.length_);
+      helloworld::HelloRequest result;
+      EXPECT_TRUE(
+          result.ParseFromArray(frame.data_->linearize(frame.data_->length()), frame.length_));
+      EXPECT_EQ("hello", result.name());
+    }
+  }
+}
+
+TEST(GrpcCodecTest, decodeInvalidFrameAfterValidFrame) {
+  Buffer::OwnedImpl buffer("\0\0\0\0\1a\2\0\0\0\1b", 12);
+
+  std::vector<Frame> frames;
+  Decoder decoder;
+  EXPECT_FALSE(decoder.decode(buffer, frames));
+  ASSERT_EQ(1U, frames.size());
+  EXPECT_EQ("a", TestUtility::bufferToString(*frames[0].data_));
+  EXPECT_EQ(std::string("\2\0\0\0\1b", 6), TestUtility::bufferToString(buffer));
+}
+
 } // Grpc
 } // Envoy
@@ -1,8 +1,15 @@
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/buffer/buffer_impl.h"
 #include "common/grpc/common.h"
 #include "common/http/headers.h"
 
 #include "test/mocks/upstream/mocks.h"
 #include "test/proto/helloworld.pb.h"
+#include "test/test_common/utility.h"
 
 #include "gtest/gtest.h"
 
@@ -31,5 +38,38 @@ TEST(GrpcCommonTest, prepareHeaders) {
   EXPECT_STREQ("application/grpc", message->headers().ContentType()->value().c_str());
 }
 
+TEST(GrpcCommonTest, serializeAndParseBody) {
+  helloworld::HelloRequest request;
+  request.set_name(std::string(100, 'a'));
+
+  // Serialize after existing data.
+  Buffer::OwnedImpl body("foo");
+  Common::serializeBody(request, body);
+  body.drain(3 + 5);
+  const std::string serialized = TestUtility::bufferToString(body);
+  EXPECT_EQ(request.SerializeAsString(), serialized);
+
+  // Parse from a buffer whose data is spread over several slices.
+  std::vector<std::unique_ptr<Buffer::BufferFragmentImpl>> fragments;
+  Buffer::OwnedImpl sliced;
+  for (size_t i = 0; i < serialized.size(); i += 30) {
+    fragments.emplace_back(new Buffer::BufferFragmentImpl(
+        serialized.data() + i, std::min<size_t>(30, serialized.size() - i), nullptr));
+    sliced.addBufferFragment(*fragments.back());
+  }
+  EXPECT_LT(1U, sliced.getRawSlices(nullptr, 0));
+
+  helloworld::HelloRequest parsed;
+  EXPECT_TRUE(Common::parseBody(sliced, parsed));
+  EXPECT_EQ(request.name(), parsed.name());
+
+  Buffer::OwnedImpl empty;
+  EXPECT_TRUE(Common::parseBody(empty, parsed));
+  EXPECT_EQ("", parsed.name());
+
+  Buffer::OwnedImpl bad("aaaaaaaa");
+  EXPECT_FALSE(Common::parseBody(bad, parsed));
+}
+
 } // Grpc
 } // Envoy
@@ -1,3 +1,6 @@
+#include <string>
+#include <vector>
+
 #include "common/buffer/buffer_impl.h"
 #include "common/common/base64.h"
 #include "common/grpc/grpc_web_filter.h"
@@ -80,6 +83,54 @@ TEST_F(GrpcWebFilterTest, SupportedContentTypes) {
   }
 }
 
+TEST_F(GrpcWebFilterTest, TextRequestInChunks) {
+  Http::TestHeaderMapImpl request_headers;
+  request_headers.addViaCopy(Http::Headers::get().ContentType,
+                             Http::Headers::get().ContentTypeValues.GrpcWebText);
+  EXPECT_EQ(Http::FilterHeadersStatus::Continue, filter_.decodeHeaders(request_headers, false));
+
+  // Chunks of every size are decoded as they arrive, holding back at most a partial quartet.
+  const std::string encoded(B64_MESSAGE, B64_MESSAGE_SIZE);
+  for (uint64_t chunk_size = 1; chunk_size <= 7; chunk_size++) {
+    std::string decoded;
+    for (uint64_t i = 0; i < encoded.size(); i += chunk_size) {
+      Buffer::OwnedImpl request_buffer(encoded.substr(i, chunk_size));
+      const bool end_stream = i + chunk_size >= encoded.size();
+      const Http::FilterDataStatus status = filter_.decodeData(request_buffer, end_stream);
+      if (status == Http::FilterDataStatus::Continue) {
+        decoded += TestUtility::bufferToString(request_buffer);
+      } else {
+        EXPECT_EQ(Http::FilterDataStatus::StopIterationNoBuffer, status);
+        EXPECT_EQ(0U, request_buffer.length());
+      }
+    }
+    EXPECT_EQ(std::string(TEXT_MESSAGE, TEXT_MESSAGE_SIZE), decoded);
+  }
+}
+
+TEST_F(GrpcWebFilterTest, TextResponseInChunks) {
+  Http::TestHeaderMapImpl request_headers;
+  request_headers.addViaCopy(Http::Headers::get().ContentType,
+                             Http::Headers::get().ContentTypeValues.GrpcWeb);
+  request_headers.addViaCopy(Http::Headers::get().Accept,
+                             Http::Headers::get().ContentTypeValues.GrpcWebText);
+  EXPECT_EQ(Http::FilterHeadersStatus::Continue, filter_.decodeHeaders(request_headers, false));
+
+  // Two frames split across three chunks are each encoded once complete.
+  const std::string frames = std::string(TEXT_MESSAGE, TEXT_MESSAGE_SIZE) +
+                             std::string(TEXT_MESSAGE, TEXT_MESSAGE_SIZE);
+  const std::vector<std::string> chunks{frames.substr(0, 3), frames.substr(3, TEXT_MESSAGE_SIZE),
+                                        frames.substr(TEXT_MESSAGE_SIZE + 3)};
+  std::string encoded;
+  for (const std::string& chunk : chunks) {
+    Buffer::OwnedImpl response_buffer(chunk);
+    filter_.encodeData(response_buffer, false);
+    encoded += TestUtility::bufferToString(response_buffer);
+  }
+  EXPECT_EQ(std::string(B64_MESSAGE, B64_MESSAGE_SIZE) + std::string(B64_MESSAGE, B64_MESSAGE_SIZE),
+            encoded);
+}
+
 TEST_P(GrpcWebFilterTest, Unary) {
   // Tests request headers.
   Http::TestHeaderMapImpl request_headers;
@@ -12,6 +12,7 @@
 
 namespace Envoy {
 using testing::_;
+using testing::Invoke;
 using testing::NiceMock;
 using testing::Return;
 using testing::ReturnPointee;
@@ -21,7 +22,7 @@ namespace Grpc {
 
 class GrpcHttp1BridgeFilterTest : public testing::Test {
 public:
-  GrpcHttp1BridgeFilterTest() : filter_(cm_) {
+  GrpcHttp1BridgeFilterTest(bool streaming = false) : filter_(cm_, streaming) {
     filter_.setDecoderFilterCallbacks(decoder_callbacks_);
     filter_.setEncoderFilterCallbacks(encoder_callbacks_);
     ON_CALL(decoder_callbacks_.request_info_, protocol()).WillByDefault(ReturnPointee(&protocol_));
@@ -89,6 +90,9 @@ TEST_F(GrpcHttp1BridgeFilterTest, StatsHttp2NormalResponse) {
   Buffer::OwnedImpl data("hello");
   EXPECT_EQ(Http::FilterDataStatus::Continue, filter_.encodeData(data, false));
   Http::TestHeaderMapImpl response_trailers{{"grpc-status", "0"}};
+  EXPECT_CALL(
+      cm_.thread_local_cluster_.cluster_.info_->stats_store_,
+      deliverTimingToSinks("grpc.lyft.users.BadCompanions.GetBadCompanions.upstream_rq_time", _));
   EXPECT_EQ(Http::FilterTrailersStatus::Continue, filter_.encodeTrailers(response_trailers));
   EXPECT_EQ(1UL, cm_.thread_local_cluster_.cluster_.info_->stats_store_
                      .counter("grpc.lyft.users.BadCompanions.GetBadCompanions.success")
@@ -176,5 +180,45 @@ TEST_F(GrpcHttp1BridgeFilterTest, HandlingBadGrpcStatus) {
   EXPECT_EQ("foo", response_headers.get_("grpc-message"));
 }
 
+class GrpcHttp1BridgeStreamingFilterTest : public GrpcHttp1BridgeFilterTest {
+public:
+  GrpcHttp1BridgeStreamingFilterTest() : GrpcHttp1BridgeFilterTest(true) {}
+};
+
+TEST_F(GrpcHttp1BridgeStreamingFilterTest, HandlingNormalResponse) {
+  Http::TestHeaderMapImpl request_headers{{"content-type", "application/grpc"},
+                                          {":path", "/lyft.users.BadCompanions/GetBadCompanions"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::Continue, filter_.decodeHeaders(request_headers, true));
+
+  Http::TestHeaderMapImpl response_headers{{":status", "200"}, {"content-length", "5"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::Continue, filter_.encodeHeaders(response_headers, false));
+  EXPECT_FALSE(response_headers.has("content-length"));
+  Buffer::OwnedImpl data("hello");
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_.encodeData(data, false));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, filter_.encodeData(data, false));
+
+  Buffer::OwnedImpl trailers_frame;
+  EXPECT_CALL(encoder_callbacks_, addEncodedData(_))
+      .WillOnce(Invoke([&](Buffer::Instance& data) -> void { trailers_frame.move(data); }));
+  Http::TestHeaderMapImpl response_trailers{{"grpc-status", "1"}, {"grpc-message", "foo"}};
+  EXPECT_EQ(Http::FilterTrailersStatus::Continue, filter_.encodeTrailers(response_trailers));
+  EXPECT_EQ(std::string("\x80\0\0\0\x21", 5) + "grpc-status:1\r\ngrpc-message:foo\r\n",
+            TestUtility::bufferToString(trailers_frame));
+
+  // The status cannot be mapped since the headers have already been sent.
+  EXPECT_EQ("200", response_headers.get_(":status"));
+  EXPECT_FALSE(response_headers.has("grpc-status"));
+}
+
+TEST_F(GrpcHttp1BridgeStreamingFilterTest, HeaderOnlyResponse) {
+  Http::TestHeaderMapImpl request_headers{{"content-type", "application/grpc"},
+                                          {":path", "/lyft.users.BadCompanions/GetBadCompanions"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::Continue, filter_.decodeHeaders(request_headers, true));
+
+  Http::TestHeaderMapImpl response_headers{{":status", "200"}, {"grpc-status", "1"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::Continue, filter_.encodeHeaders(response_headers, true));
+  EXPECT_EQ("1", response_headers.get_("grpc-status"));
+}
+
 } // Grpc
 } // Envoy
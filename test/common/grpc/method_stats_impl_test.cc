@@ -0,0 +1,57 @@
+#include "common/grpc/method_stats_impl.h"
+#include "common/stats/stats_impl.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Grpc {
+
+TEST(GrpcMethodStatsTableImplTest, Find) {
+  Stats::IsolatedStoreImpl store;
+  MethodStatsTableImpl table;
+
+  const MethodStats* stats = table.find(store, "/service/method");
+  ASSERT_NE(nullptr, stats);
+  EXPECT_EQ(&store.counter("grpc.service.method.success"), &stats->success_);
+  EXPECT_EQ(&store.counter("grpc.service.method.failure"), &stats->failure_);
+  EXPECT_EQ(&store.counter("grpc.service.method.total"), &stats->total_);
+  EXPECT_EQ(&store.timer("grpc.service.method.upstream_rq_time"), &stats->upstream_rq_time_);
+
+  EXPECT_EQ(stats, table.find(store, "/service/method"));
+  EXPECT_NE(stats, table.find(store, "/service/other_method"));
+}
+
+TEST(GrpcMethodStatsTableImplTest, NotAMethod) {
+  Stats::IsolatedStoreImpl store;
+  MethodStatsTableImpl table;
+
+  EXPECT_EQ(nullptr, table.find(store, "/"));
+  EXPECT_EQ(nullptr, table.find(store, "/service"));
+  EXPECT_EQ(nullptr, table.find(store, "/package/service/method"));
+}
+
+TEST(GrpcMethodStatsTableImplTest, Overflow) {
+  Stats::IsolatedStoreImpl store;
+  MethodStatsTableImpl table(2);
+
+  const MethodStats* first = table.find(store, "/service/first");
+  const MethodStats* second = table.find(store, "/service/second");
+  ASSERT_NE(nullptr, first);
+  ASSERT_NE(nullptr, second);
+
+  const MethodStats* overflow = table.find(store, "/service/third");
+  ASSERT_NE(nullptr, overflow);
+  EXPECT_EQ(&store.counter("grpc.overflow.success"), &overflow->success_);
+  EXPECT_EQ(&store.counter("grpc.overflow.failure"), &overflow->failure_);
+  EXPECT_EQ(&store.counter("grpc.overflow.total"), &overflow->total_);
+  EXPECT_EQ(&store.timer("grpc.overflow.upstream_rq_time"), &overflow->upstream_rq_time_);
+  EXPECT_EQ(overflow, table.find(store, "/service/fourth"));
+
+  // Methods interned before the table filled up keep their own stats.
+  EXPECT_EQ(first, table.find(store, "/service/first"));
+  EXPECT_EQ(second, table.find(store, "/service/second"));
+  EXPECT_EQ(nullptr, table.find(store, "/service"));
+}
+
+} // Grpc
+} // Envoy
@@ -19,6 +19,7 @@ namespace Envoy {
 using testing::_;
 using testing::Invoke;
 using testing::Return;
+using testing::WithArg;
 
 namespace Grpc {
 
@@ -323,5 +324,173 @@ TEST_F(GrpcRequestImplTest, RequestTimeoutSet) {
   http_callbacks_->onSuccess(std::move(response_http_message));
 }
 
+class StreamingRpcChannelImplTest : public testing::Test {
+public:
+  StreamingRpcChannelImplTest() {
+    ON_CALL(*cm_.thread_local_cluster_.cluster_.info_, features())
+        .WillByDefault(Return(Upstream::ClusterInfo::Features::HTTP2));
+  }
+
+  void expectStream() {
+    EXPECT_CALL(cm_, httpAsyncClientForCluster("fake_cluster"))
+        .WillOnce(ReturnRef(cm_.async_client_));
+    EXPECT_CALL(cm_.async_client_, start(_, _))
+        .WillOnce(Invoke([&](Http::AsyncClient::StreamCallbacks& callbacks,
+                             const Optional<std::chrono::milliseconds>&)
+                             -> Http::AsyncClient::Stream* {
+          stream_callbacks_ = &callbacks;
+          return &stream_;
+        }));
+  }
+
+  void sayHello() {
+    request_.set_name("a name");
+    EXPECT_CALL(grpc_callbacks_, onPreRequestCustomizeHeaders(_));
+    EXPECT_CALL(stream_, sendHeaders(_, false))
+        .WillOnce(Invoke([&](Http::HeaderMap& headers, bool) -> void {
+          Http::TestHeaderMapImpl expected_headers{{":method", "POST"},
+                                                   {":path", "/helloworld.Greeter/SayHello"},
+                                                   {":authority", "fake_cluster"},
+                                                   {"content-type", "application/grpc"}};
+          EXPECT_THAT(headers, HeaderMapEqualRef(&expected_headers));
+        }));
+    EXPECT_CALL(stream_, sendData(_, true))
+        .WillOnce(WithArg<0>(Invoke([&](Buffer::Instance& data) -> void {
+          EXPECT_EQ(TestUtility::bufferToString(*Common::serializeBody(request_)),
+                    TestUtility::bufferToString(data));
+          data.drain(data.length());
+        })));
+    service_.SayHello(nullptr, &request_, &response_, nullptr);
+  }
+
+  void respond(const helloworld::HelloReply& reply) {
+    stream_callbacks_->onHeaders(
+        Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "200"}}}, false);
+
+    // Deliver the body in two pieces so that it has to be reassembled.
+    Buffer::InstancePtr body = Common::serializeBody(reply);
+    Buffer::OwnedImpl first;
+    first.move(*body, 3);
+    stream_callbacks_->onData(first, false);
+    stream_callbacks_->onData(*body, false);
+    stream_callbacks_->onTrailers(
+        Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{"grpc-status", "0"}}});
+  }
+
+  NiceMock<Upstream::MockClusterManager> cm_;
+  MockRpcChannelCallbacks grpc_callbacks_;
+  StreamingRpcChannelImpl channel_{cm_, "fake_cluster", grpc_callbacks_,
+                                   Optional<std::chrono::milliseconds>()};
+  helloworld::Greeter::Stub service_{&channel_};
+  Http::MockAsyncClientStream stream_;
+  Http::AsyncClient::StreamCallbacks* stream_callbacks_{};
+  helloworld::HelloRequest request_;
+  helloworld::HelloReply response_;
+};
+
+TEST_F(StreamingRpcChannelImplTest, NoError) {
+  helloworld::HelloReply inner_response;
+  inner_response.set_message("hello a name");
+
+  // The channel can be used for one call after another.
+  for (uint32_t i = 0; i < 2; i++) {
+    expectStream();
+    sayHello();
+    EXPECT_CALL(grpc_callbacks_, onSuccess());
+    respond(inner_response);
+    EXPECT_EQ(inner_response.SerializeAsString(), response_.SerializeAsString());
+  }
+
+  EXPECT_EQ(2UL, cm_.thread_local_cluster_.cluster_.info_->stats_store_
+                     .counter("grpc.helloworld.Greeter.SayHello.success")
+                     .value());
+}
+
+TEST_F(StreamingRpcChannelImplTest, HeaderOnlyFailure) {
+  expectStream();
+  sayHello();
+
+  EXPECT_CALL(grpc_callbacks_, onFailure(Optional<uint64_t>(3), "hello"));
+  stream_callbacks_->onHeaders(
+      Http::HeaderMapPtr{new Http::TestHeaderMapImpl{
+          {":status", "200"}, {"grpc-status", "3"}, {"grpc-message", "hello"}}},
+      true);
+  EXPECT_EQ(1UL, cm_.thread_local_cluster_.cluster_.info_->stats_store_
+                     .counter("grpc.helloworld.Greeter.SayHello.failure")
+                     .value());
+}
+
+TEST_F(StreamingRpcChannelImplTest, NoResponseTrailers) {
+  expectStream();
+  sayHello();
+
+  stream_callbacks_->onHeaders(
+      Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "200"}}}, false);
+  Buffer::OwnedImpl data("aaaaaaaa");
+  EXPECT_CALL(grpc_callbacks_, onFailure(Optional<uint64_t>(), "no response trailers"));
+  stream_callbacks_->onData(data, true);
+}
+
+TEST_F(StreamingRpcChannelImplTest, BadMessageInResponse) {
+  expectStream();
+  sayHello();
+
+  stream_callbacks_->onHeaders(
+      Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "200"}}}, false);
+  Buffer::OwnedImpl data("aaaaaaaa");
+  stream_callbacks_->onData(data, false);
+  EXPECT_CALL(grpc_callbacks_, onFailure(Optional<uint64_t>(), "bad serialized body"));
+  stream_callbacks_->onTrailers(
+      Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{"grpc-status", "0"}}});
+}
+
+TEST_F(StreamingRpcChannelImplTest, StreamReset) {
+  expectStream();
+  sayHello();
+
+  EXPECT_CALL(grpc_callbacks_, onFailure(Optional<uint64_t>(), "stream reset"));
+  stream_callbacks_->onReset();
+}
+
+TEST_F(StreamingRpcChannelImplTest, NoStream) {
+  EXPECT_CALL(cm_, httpAsyncClientForCluster("fake_cluster"))
+      .WillOnce(ReturnRef(cm_.async_client_));
+  EXPECT_CALL(cm_.async_client_, start(_, _))
+      .WillOnce(Invoke([&](Http::AsyncClient::StreamCallbacks& callbacks,
+                           const Optional<std::chrono::milliseconds>&)
+                           -> Http::AsyncClient::Stream* {
+        callbacks.onReset();
+        return nullptr;
+      }));
+  EXPECT_CALL(grpc_callbacks_, onPreRequestCustomizeHeaders(_));
+  EXPECT_CALL(grpc_callbacks_, onFailure(Optional<uint64_t>(), "stream reset"));
+
+  request_.set_name("a name");
+  service_.SayHello(nullptr, &request_, &response_, nullptr);
+}
+
+TEST_F(StreamingRpcChannelImplTest, LocalReplyDuringHeaders) {
+  expectStream();
+  EXPECT_CALL(grpc_callbacks_, onPreRequestCustomizeHeaders(_));
+  EXPECT_CALL(stream_, sendHeaders(_, false)).WillOnce(Invoke([&](Http::HeaderMap&, bool) -> void {
+    stream_callbacks_->onHeaders(
+        Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "503"}}}, true);
+  }));
+  EXPECT_CALL(grpc_callbacks_, onFailure(Optional<uint64_t>(), "non-200 response code"));
+  EXPECT_CALL(stream_, sendData(_, _)).Times(0);
+  EXPECT_CALL(stream_, reset()).WillOnce(Invoke([&]() -> void { stream_callbacks_->onReset(); }));
+
+  request_.set_name("a name");
+  service_.SayHello(nullptr, &request_, &response_, nullptr);
+}
+
+TEST_F(StreamingRpcChannelImplTest, Cancel) {
+  expectStream();
+  sayHello();
+
+  EXPECT_CALL(stream_, reset()).WillOnce(Invoke([&]() -> void { stream_callbacks_->onReset(); }));
+  channel_.cancel();
+}
+
 } // Grpc
 } // Envoy
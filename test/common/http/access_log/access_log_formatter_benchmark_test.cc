@@ -0,0 +1,75 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include "common/common/utility.h"
+#include "common/http/access_log/access_log_formatter.h"
+#include "common/http/access_log/request_info_impl.h"
+#include "common/http/header_map_impl.h"
+
+#include "test/test_common/utility.h"
+
+#include "gtest/gtest.h"
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+namespace Http {
+namespace AccessLog {
+
+/**
+ * This test is for benchmarking only and should not be run as part of unit tests. It measures the
+ * cost of formatting one access log line with the default format, both into a fresh string and
+ * into a reused line buffer as done by the access log.
+ */
+class DISABLED_AccessLogFormatterBenchmark : public testing::Test {
+public:
+  static const uint32_t NumLines = 1000000;
+
+  DISABLED_AccessLogFormatterBenchmark()
+      : formatter_(AccessLogFormatUtils::defaultAccessLogFormatter()),
+        request_info_(Protocol::Http11, ProdMonotonicTimeSource::instance_) {
+    request_info_.bytes_received_ = 1234;
+    request_info_.bytes_sent_ = 56789;
+    request_info_.response_code_.value(200);
+  }
+
+  Http::TestHeaderMapImpl request_headers_{
+      {":method", "GET"},
+      {":path", "/api/v1/users/12345"},
+      {":authority", "api.example.com"},
+      {"user-agent", "Mozilla/5.0 (X11; Linux x86_64)"},
+      {"x-forwarded-for", "10.0.0.1"},
+      {"x-request-id", "ba7a2d8c-3ff3-4b7b-a1e7-b1d6f4e4f0d6"}};
+  Http::TestHeaderMapImpl response_headers_{{":status", "200"},
+                                            {"x-envoy-upstream-service-time", "12"}};
+  FormatterPtr formatter_;
+  RequestInfoImpl request_info_;
+};
+
+TEST_F(DISABLED_AccessLogFormatterBenchmark, DefaultFormat) {
+  uint64_t total_length = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < NumLines; i++) {
+    total_length += formatter_->format(request_headers_, response_headers_, request_info_).size();
+  }
+  std::chrono::nanoseconds format_elapsed = std::chrono::steady_clock::now() - start;
+
+  std::string line;
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < NumLines; i++) {
+    line.clear();
+    formatter_->formatTo(line, request_headers_, response_headers_, request_info_);
+    total_length -= line.size();
+  }
+  std::chrono::nanoseconds format_to_elapsed = std::chrono::steady_clock::now() - start;
+
+  EXPECT_EQ(0U, total_length);
+  std::cout << fmt::format("format={}ns/line formatTo={}ns/line",
+                           format_elapsed.count() / NumLines, format_to_elapsed.count() / NumLines)
+            << std::endl;
+}
+
+} // AccessLog
+} // Http
+} // Envoy
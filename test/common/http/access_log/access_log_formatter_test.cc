@@ -247,6 +247,30 @@ TEST(AccessLogFormatterTest, CompositeFormatterSuccess) {
   }
 }
 
+TEST(AccessLogFormatterTest, CompositeFormatterAppends) {
+  NiceMock<MockRequestInfo> request_info;
+  TestHeaderMapImpl request_header{{":method", "GET"}};
+  TestHeaderMapImpl response_header;
+
+  // 2018-04-03T23:06:09.123Z followed by a time within the same second and one in the next.
+  SystemTime time{std::chrono::milliseconds(1522796769123)};
+  EXPECT_CALL(request_info, startTime()).WillOnce(Return(time));
+  EXPECT_CALL(request_info, bytesReceived()).WillRepeatedly(Return(18446744073709551615UL));
+  FormatterImpl formatter("%START_TIME% %REQ(:METHOD)% %BYTES_RECEIVED% %RESPONSE_FLAGS%\n");
+
+  std::string output = "previous line\n";
+  formatter.formatTo(output, request_header, response_header, request_info);
+  EXPECT_EQ("previous line\n2018-04-03T23:06:09.123Z GET 18446744073709551615 -\n", output);
+
+  EXPECT_CALL(request_info, startTime()).WillOnce(Return(time + std::chrono::milliseconds(5)));
+  EXPECT_EQ("2018-04-03T23:06:09.128Z GET 18446744073709551615 -\n",
+            formatter.format(request_header, response_header, request_info));
+
+  EXPECT_CALL(request_info, startTime()).WillOnce(Return(time + std::chrono::milliseconds(900)));
+  EXPECT_EQ("2018-04-03T23:06:10.023Z GET 18446744073709551615 -\n",
+            formatter.format(request_header, response_header, request_info));
+}
+
 TEST(AccessLogFormatterTest, ParserFailures) {
   AccessLogFormatParser parser;
 
@@ -480,7 +480,7 @@ TEST(AccessLogFilterTest, DurationWithRuntimeKey) {
   NiceMock<Runtime::MockLoader> runtime;
 
   Json::ObjectSharedPtr filter_object = loader->getObject("filter");
-  DurationFilter filter(*filter_object, runtime);
+  FilterImpl filter(*filter_object, runtime);
   TestHeaderMapImpl request_headers{{":method", "GET"}, {":path", "/"}};
   TestRequestInfo request_info;
 
@@ -512,7 +512,7 @@ TEST(AccessLogFilterTest, StatusCodeWithRuntimeKey) {
   NiceMock<Runtime::MockLoader> runtime;
 
   Json::ObjectSharedPtr filter_object = loader->getObject("filter");
-  StatusCodeFilter filter(*filter_object, runtime);
+  FilterImpl filter(*filter_object, runtime);
 
   TestHeaderMapImpl request_headers{{":method", "GET"}, {":path", "/"}};
   TestRequestInfo info;
@@ -525,6 +525,75 @@ TEST(AccessLogFilterTest, StatusCodeWithRuntimeKey) {
   EXPECT_FALSE(filter.evaluate(info, request_headers));
 }
 
+TEST(AccessLogFilterTest, RuntimeValueReadOncePerSnapshot) {
+  std::string filter_json = R"EOF(
+    {
+      "filter": {"type": "logical_or", "filters": [
+          {"type": "duration", "op": ">=", "value": 1000000, "runtime_key": "key"},
+          {"type": "status_code", "op": ">=", "value": 1000000, "runtime_key": "key"}
+        ]
+      }
+    }
+    )EOF";
+
+  Json::ObjectSharedPtr loader = Json::Factory::loadFromString(filter_json);
+  NiceMock<Runtime::MockLoader> runtime;
+  FilterPtr filter = FilterImpl::fromJson(*loader->getObject("filter"), runtime);
+  TestHeaderMapImpl request_headers{{":method", "GET"}, {":path", "/"}};
+  TestRequestInfo info;
+  info.duration_ = 100;
+  info.response_code_.value(200);
+
+  // Both predicates share the value, which is read once for as long as the snapshot is unchanged.
+  EXPECT_CALL(runtime.snapshot_, generation()).WillRepeatedly(Return(5));
+  EXPECT_CALL(runtime.snapshot_, getInteger("key", 1000000)).WillOnce(Return(150));
+  EXPECT_TRUE(filter->evaluate(info, request_headers));
+  info.duration_ = 10;
+  EXPECT_TRUE(filter->evaluate(info, request_headers));
+  info.response_code_.value(100);
+  EXPECT_FALSE(filter->evaluate(info, request_headers));
+
+  EXPECT_CALL(runtime.snapshot_, generation()).WillRepeatedly(Return(6));
+  EXPECT_CALL(runtime.snapshot_, getInteger("key", 1000000)).WillOnce(Return(50));
+  EXPECT_TRUE(filter->evaluate(info, request_headers));
+}
+
+TEST(AccessLogFilterTest, ShortCircuit) {
+  std::string filter_json = R"EOF(
+    {
+      "filter": {"type": "logical_and", "filters": [
+          {"type": "not_healthcheck"},
+          {"type": "logical_or", "filters": [
+              {"type": "status_code", "op": "=", "value": 500},
+              {"type": "duration", "op": ">=", "value": 10, "runtime_key": "key"}
+            ]
+          }
+        ]
+      }
+    }
+    )EOF";
+
+  Json::ObjectSharedPtr loader = Json::Factory::loadFromString(filter_json);
+  NiceMock<Runtime::MockLoader> runtime;
+  FilterPtr filter = FilterImpl::fromJson(*loader->getObject("filter"), runtime);
+  TestHeaderMapImpl request_headers{{":method", "GET"}, {":path", "/"}};
+  TestRequestInfo info;
+  info.duration_ = 100;
+
+  // Predicates after the one that decides the result are not evaluated.
+  info.hc_request_ = true;
+  EXPECT_CALL(runtime.snapshot_, getInteger(_, _)).Times(0);
+  EXPECT_FALSE(filter->evaluate(info, request_headers));
+
+  info.hc_request_ = false;
+  info.response_code_.value(500);
+  EXPECT_TRUE(filter->evaluate(info, request_headers));
+
+  info.response_code_.value(200);
+  EXPECT_CALL(runtime.snapshot_, getInteger("key", 10)).WillOnce(Return(1000));
+  EXPECT_FALSE(filter->evaluate(info, request_headers));
+}
+
 } // AccessLog
 } // Http
 } // Envoy
@@ -0,0 +1,240 @@
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "common/grpc/common.h"
+#include "common/http/access_log/grpc_access_log_impl.h"
+#include "common/json/json_loader.h"
+#include "common/stats/stats_impl.h"
+
+#include "test/mocks/event/mocks.h"
+#include "test/mocks/http/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
+#include "test/mocks/upstream/mocks.h"
+#include "test/test_common/printers.h"
+#include "test/test_common/utility.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::Invoke;
+using testing::NiceMock;
+using testing::Return;
+using testing::ReturnRef;
+using testing::_;
+
+namespace Envoy {
+namespace Http {
+namespace AccessLog {
+
+class GrpcAccessLogTest : public testing::Test {
+public:
+  void initialize(const std::string& json) {
+    Json::ObjectSharedPtr loader = Json::Factory::loadFromString(json);
+    timer_ = new Event::MockTimer(&tls_.dispatcher_);
+    EXPECT_CALL(*timer_, enableTimer(std::chrono::milliseconds(10)));
+    log_.reset(new GrpcAccessLog(*loader, nullptr, cm_, tls_, stats_store_));
+
+    ON_CALL(request_info_, responseCode()).WillByDefault(ReturnRef(response_code_));
+    ON_CALL(request_info_, protocol()).WillByDefault(Return(Protocol::Http11));
+    ON_CALL(request_info_, duration()).WillByDefault(Return(std::chrono::milliseconds(5)));
+  }
+
+  void expectStream() {
+    EXPECT_CALL(cm_, httpAsyncClientForCluster("collector")).WillOnce(ReturnRef(cm_.async_client_));
+    EXPECT_CALL(cm_.async_client_, start(_, _))
+        .WillOnce(Invoke([&](AsyncClient::StreamCallbacks& callbacks,
+                             const Optional<std::chrono::milliseconds>&) -> AsyncClient::Stream* {
+          stream_callbacks_ = &callbacks;
+          return &stream_;
+        }));
+    EXPECT_CALL(stream_, sendHeaders(_, false)).WillOnce(Invoke([](HeaderMap& headers, bool) {
+      EXPECT_STREQ("/envoy.accesslog.AccessLogService/StreamAccessLogs",
+                   headers.Path()->value().c_str());
+    }));
+  }
+
+  void expectMessage(const std::string& log_name, uint32_t entries) {
+    EXPECT_CALL(stream_, sendData(_, false))
+        .WillOnce(Invoke([log_name, entries](Buffer::Instance& data, bool) {
+          data.drain(5);
+          envoy::accesslog::StreamAccessLogsMessage message;
+          EXPECT_TRUE(Grpc::Common::parseBody(data, message));
+          EXPECT_EQ(log_name, message.log_name());
+          EXPECT_EQ(entries, static_cast<uint32_t>(message.http_logs_size()));
+          data.drain(data.length());
+        }));
+  }
+
+  uint64_t counter(const std::string& name) {
+    return stats_store_.counter("access_log.grpc." + name).value();
+  }
+
+  const std::string default_json_{R"EOF(
+    {
+      "grpc_cluster": "collector",
+      "log_name": "my_log",
+      "flush_interval_ms": 10,
+      "max_batch_bytes": 1000000
+    }
+    )EOF"};
+
+  NiceMock<Upstream::MockClusterManager> cm_;
+  NiceMock<ThreadLocal::MockInstance> tls_;
+  Stats::IsolatedStoreImpl stats_store_;
+  Event::MockTimer* timer_{};
+  std::unique_ptr<GrpcAccessLog> log_;
+  MockAsyncClientStream stream_;
+  AsyncClient::StreamCallbacks* stream_callbacks_{};
+  NiceMock<MockRequestInfo> request_info_;
+  Optional<uint32_t> response_code_{200};
+  TestHeaderMapImpl request_headers_{{":method", "GET"}, {":path", "/"}};
+};
+
+TEST_F(GrpcAccessLogTest, PopulateEntry) {
+  TestHeaderMapImpl request_headers{{":method", "POST"},
+                                    {":path", "/rewritten"},
+                                    {"x-envoy-original-path", "/original"},
+                                    {":authority", "example.com"},
+                                    {"user-agent", "curl"},
+                                    {"x-forwarded-for", "10.0.0.2"},
+                                    {"x-request-id", "abc"}};
+  NiceMock<MockRequestInfo> request_info;
+  Optional<uint32_t> response_code{503};
+  EXPECT_CALL(request_info, responseCode()).WillRepeatedly(ReturnRef(response_code));
+  EXPECT_CALL(request_info, protocol()).WillRepeatedly(Return(Protocol::Http2));
+  EXPECT_CALL(request_info, duration()).WillRepeatedly(Return(std::chrono::milliseconds(7)));
+  EXPECT_CALL(request_info, bytesReceived()).WillRepeatedly(Return(10));
+  EXPECT_CALL(request_info, bytesSent()).WillRepeatedly(Return(20));
+  EXPECT_CALL(request_info, getResponseFlag(_)).WillRepeatedly(Return(false));
+  EXPECT_CALL(request_info, getResponseFlag(ResponseFlag::NoHealthyUpstream))
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(request_info, getResponseFlag(ResponseFlag::RateLimited))
+      .WillRepeatedly(Return(true));
+
+  envoy::accesslog::HttpAccessLogEntry entry;
+  GrpcAccessLog::populateEntry(request_headers, request_info, entry);
+  EXPECT_EQ(envoy::accesslog::HttpAccessLogEntry::HTTP2, entry.protocol());
+  EXPECT_EQ(503U, entry.response_code());
+  EXPECT_EQ(7U, entry.duration_ms());
+  EXPECT_EQ(10U, entry.bytes_received());
+  EXPECT_EQ(20U, entry.bytes_sent());
+  EXPECT_EQ(static_cast<uint32_t>(ResponseFlag::NoHealthyUpstream | ResponseFlag::RateLimited),
+            entry.response_flags());
+  EXPECT_EQ("POST", entry.method());
+  EXPECT_EQ("/original", entry.path());
+  EXPECT_EQ("example.com", entry.authority());
+  EXPECT_EQ("curl", entry.user_agent());
+  EXPECT_EQ("10.0.0.2", entry.forwarded_for());
+  EXPECT_EQ("abc", entry.request_id());
+  EXPECT_EQ("10.0.0.1:443", entry.upstream_host());
+  EXPECT_EQ("fake_cluster", entry.upstream_cluster());
+}
+
+TEST_F(GrpcAccessLogTest, UnknownCluster) {
+  EXPECT_CALL(cm_, get("collector")).WillOnce(Return(nullptr));
+  Json::ObjectSharedPtr loader = Json::Factory::loadFromString(default_json_);
+  EXPECT_THROW_WITH_MESSAGE(GrpcAccessLog(*loader, nullptr, cm_, tls_, stats_store_),
+                            EnvoyException, "unknown access log service cluster 'collector'");
+}
+
+TEST_F(GrpcAccessLogTest, FlushOnTimerReusesStream) {
+  initialize(default_json_);
+
+  // Nothing is sent, and no stream is opened, while there are no entries.
+  EXPECT_CALL(*timer_, enableTimer(std::chrono::milliseconds(10)));
+  timer_->callback_();
+
+  log_->log(&request_headers_, nullptr, request_info_);
+  log_->log(&request_headers_, nullptr, request_info_);
+  expectStream();
+  expectMessage("my_log", 2);
+  EXPECT_CALL(*timer_, enableTimer(std::chrono::milliseconds(10)));
+  timer_->callback_();
+
+  // Later batches go on the same stream and no longer carry the log name.
+  log_->log(&request_headers_, nullptr, request_info_);
+  expectMessage("", 1);
+  EXPECT_CALL(*timer_, enableTimer(std::chrono::milliseconds(10)));
+  timer_->callback_();
+  EXPECT_EQ(3U, counter("logs_written"));
+
+  EXPECT_CALL(stream_, reset());
+  tls_.shutdownThread();
+}
+
+TEST_F(GrpcAccessLogTest, FlushWhenBatchIsFull) {
+  initialize(R"EOF(
+    {
+      "grpc_cluster": "collector",
+      "flush_interval_ms": 10,
+      "max_batch_bytes": 1
+    }
+    )EOF");
+
+  expectStream();
+  expectMessage("", 1);
+  log_->log(&request_headers_, nullptr, request_info_);
+  expectMessage("", 1);
+  log_->log(&request_headers_, nullptr, request_info_);
+  EXPECT_EQ(2U, counter("logs_written"));
+}
+
+TEST_F(GrpcAccessLogTest, DropWhenStreamCannotBeOpened) {
+  initialize(default_json_);
+
+  EXPECT_CALL(cm_.async_client_, start(_, _))
+      .WillOnce(Invoke([](AsyncClient::StreamCallbacks& callbacks,
+                          const Optional<std::chrono::milliseconds>&) -> AsyncClient::Stream* {
+        callbacks.onReset();
+        return nullptr;
+      }));
+  log_->log(&request_headers_, nullptr, request_info_);
+  EXPECT_CALL(*timer_, enableTimer(std::chrono::milliseconds(10)));
+  timer_->callback_();
+  EXPECT_EQ(1U, counter("logs_dropped"));
+  EXPECT_EQ(0U, counter("stream_closed"));
+
+  // The next flush tries again.
+  log_->log(&request_headers_, nullptr, request_info_);
+  expectStream();
+  expectMessage("my_log", 1);
+  EXPECT_CALL(*timer_, enableTimer(std::chrono::milliseconds(10)));
+  timer_->callback_();
+  EXPECT_EQ(1U, counter("logs_written"));
+}
+
+TEST_F(GrpcAccessLogTest, StreamResetAndRemoteClose) {
+  initialize(default_json_);
+
+  log_->log(&request_headers_, nullptr, request_info_);
+  expectStream();
+  expectMessage("my_log", 1);
+  EXPECT_CALL(*timer_, enableTimer(std::chrono::milliseconds(10)));
+  timer_->callback_();
+
+  // A reset drops the stream and the next batch opens a new one.
+  stream_callbacks_->onReset();
+  EXPECT_EQ(1U, counter("stream_closed"));
+  log_->log(&request_headers_, nullptr, request_info_);
+  expectStream();
+  expectMessage("my_log", 1);
+  EXPECT_CALL(*timer_, enableTimer(std::chrono::milliseconds(10)));
+  timer_->callback_();
+
+  // When the collector ends the stream our side is reset before a new one is opened.
+  stream_callbacks_->onHeaders(HeaderMapPtr{new TestHeaderMapImpl{{":status", "200"}}}, false);
+  stream_callbacks_->onTrailers(HeaderMapPtr{new TestHeaderMapImpl{{"grpc-status", "0"}}});
+  EXPECT_EQ(2U, counter("stream_closed"));
+  log_->log(&request_headers_, nullptr, request_info_);
+  EXPECT_CALL(stream_, reset());
+  expectStream();
+  expectMessage("my_log", 1);
+  EXPECT_CALL(*timer_, enableTimer(std::chrono::milliseconds(10)));
+  timer_->callback_();
+  EXPECT_EQ(3U, counter("logs_written"));
+}
+
+} // AccessLog
+} // Http
+} // Envoy
@@ -587,6 +587,39 @@ TEST_F(AsyncClientImplTest, CancelRequest) {
   request->cancel();
 }
 
+TEST_F(AsyncClientImplTest, RecycleStorage) {
+  EXPECT_CALL(cm_.conn_pool_, newStream(_, _))
+      .Times(4)
+      .WillRepeatedly(Invoke([&](StreamDecoder&, ConnectionPool::Callbacks& callbacks)
+                                 -> ConnectionPool::Cancellable* {
+                                   callbacks.onPoolReady(stream_encoder_, cm_.conn_pool_.host_);
+                                   return nullptr;
+                                 }));
+  EXPECT_CALL(stream_encoder_.stream_, resetStream(_)).Times(4);
+
+  // A completed request's storage is reused by the next request.
+  AsyncClient::Request* request =
+      client_.send(std::move(message_), callbacks_, Optional<std::chrono::milliseconds>());
+  request->cancel();
+  message_.reset(new RequestMessageImpl());
+  HttpTestUtility::addDefaultHeaders(message_->headers());
+  EXPECT_EQ(request,
+            client_.send(std::move(message_), callbacks_, Optional<std::chrono::milliseconds>()));
+  request->cancel();
+
+  // Streams are recycled separately.
+  TestHeaderMapImpl headers;
+  HttpTestUtility::addDefaultHeaders(headers);
+  AsyncClient::Stream* stream =
+      client_.start(stream_callbacks_, Optional<std::chrono::milliseconds>());
+  stream->sendHeaders(headers, false);
+  EXPECT_CALL(stream_callbacks_, onReset()).Times(2);
+  stream->reset();
+  EXPECT_EQ(stream, client_.start(stream_callbacks_, Optional<std::chrono::milliseconds>()));
+  stream->sendHeaders(headers, false);
+  stream->reset();
+}
+
 TEST_F(AsyncClientImplTest, DestroyWithActiveStream) {
   EXPECT_CALL(cm_.conn_pool_, newStream(_, _))
       .WillOnce(Invoke([&](StreamDecoder&, ConnectionPool::Callbacks& callbacks)
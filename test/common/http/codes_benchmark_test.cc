@@ -0,0 +1,74 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include "common/common/empty_string.h"
+#include "common/http/codes.h"
+#include "common/stats/stats_impl.h"
+
+#include "test/test_common/utility.h"
+
+#include "gtest/gtest.h"
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+namespace Http {
+
+/**
+ * This test is for benchmarking only and should not be run as part of unit tests. It measures the
+ * cost per request of charging the response code and timing stats the way the router does, by
+ * name and through the cluster and virtual cluster CodeStats.
+ */
+class DISABLED_CodesBenchmark : public testing::Test {
+public:
+  static const uint32_t NumRequests = 1000000;
+
+  template <class Function> void measure(const std::string& name, Function f) {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NumRequests; i++) {
+      f(i);
+    }
+    const std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << fmt::format("{}: {} requests in {}ms, {}ns each", name, NumRequests,
+                             elapsed.count() / 1000000, elapsed.count() / NumRequests)
+              << std::endl;
+  }
+
+  void charge(uint32_t i, CodeStats* cluster_code_stats, CodeStats* vcluster_code_stats) {
+    // Mostly successes with the occasional error, from canaries now and then.
+    const TestHeaderMapImpl& headers = i % 100 == 0 ? error_headers_ : ok_headers_;
+    const bool canary = i % 10 == 0;
+    CodeUtility::ResponseStatInfo stat_info{
+        global_store_, cluster_scope_, EMPTY_STRING, headers,       false,
+        vhost_name_,   vcluster_name_, EMPTY_STRING, EMPTY_STRING, canary,
+        cluster_code_stats, vcluster_code_stats};
+    CodeUtility::chargeResponseStat(stat_info);
+
+    CodeUtility::ResponseTimingInfo timing_info{
+        global_store_, cluster_scope_, EMPTY_STRING, std::chrono::milliseconds(5),
+        canary,        false,          vhost_name_,  vcluster_name_,
+        EMPTY_STRING,  EMPTY_STRING,   cluster_code_stats, vcluster_code_stats};
+    CodeUtility::chargeResponseTiming(timing_info);
+  }
+
+  Stats::IsolatedStoreImpl global_store_;
+  Stats::IsolatedStoreImpl cluster_scope_;
+  TestHeaderMapImpl ok_headers_{{":status", "200"}};
+  TestHeaderMapImpl error_headers_{{":status", "503"}};
+  const std::string vhost_name_{"vhost"};
+  const std::string vcluster_name_{"vcluster"};
+};
+
+TEST_F(DISABLED_CodesBenchmark, ChargeResponse) {
+  measure("by name", [this](uint32_t i) -> void { charge(i, nullptr, nullptr); });
+
+  CodeStatsImpl cluster_code_stats("");
+  CodeStatsImpl vcluster_code_stats("vhost.vhost.vcluster.vcluster.");
+  measure("CodeStats", [&](uint32_t i) -> void {
+    charge(i, &cluster_code_stats, &vcluster_code_stats);
+  });
+}
+
+} // Http
+} // Envoy
@@ -1,5 +1,6 @@
 #include <chrono>
 #include <cstdint>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -31,7 +32,7 @@ public:
 
     CodeUtility::ResponseStatInfo info{global_store_, cluster_scope_, "prefix.", headers,
                                        internal_request, request_vhost_name, request_vcluster_name,
-                                       from_az, to_az, canary};
+                                       from_az, to_az, canary, nullptr, nullptr};
 
     CodeUtility::chargeResponseStat(info);
   }
@@ -169,13 +170,86 @@ TEST_F(CodeUtilityTest, PerZoneStats) {
   EXPECT_EQ(1U, cluster_scope_.counter("prefix.zone.from_az.to_az.upstream_rq_2xx").value());
 }
 
+TEST_F(CodeUtilityTest, CodeStats) {
+  CodeStatsImpl cluster_code_stats("prefix.");
+  CodeStatsImpl vcluster_code_stats("vhost.test-vhost.vcluster.test-cluster.");
+  TestHeaderMapImpl headers{{":status", "503"}};
+  std::string vhost_name = "test-vhost";
+  std::string vcluster_name = "test-cluster";
+  std::string from_az = "from_az";
+  std::string to_az = "to_az";
+  CodeUtility::ResponseStatInfo info{global_store_, cluster_scope_,      "prefix.",
+                                     headers,       true,                vhost_name,
+                                     vcluster_name, from_az,             to_az,
+                                     true,          &cluster_code_stats, &vcluster_code_stats};
+  CodeUtility::chargeResponseStat(info);
+  CodeUtility::chargeResponseStat(info);
+
+  EXPECT_EQ(2U, cluster_scope_.counter("prefix.upstream_rq_5xx").value());
+  EXPECT_EQ(2U, cluster_scope_.counter("prefix.upstream_rq_503").value());
+  EXPECT_EQ(2U, cluster_scope_.counter("prefix.canary.upstream_rq_5xx").value());
+  EXPECT_EQ(2U, cluster_scope_.counter("prefix.canary.upstream_rq_503").value());
+  EXPECT_EQ(2U, cluster_scope_.counter("prefix.internal.upstream_rq_5xx").value());
+  EXPECT_EQ(2U, cluster_scope_.counter("prefix.internal.upstream_rq_503").value());
+  EXPECT_EQ(2U, cluster_scope_.counter("prefix.zone.from_az.to_az.upstream_rq_5xx").value());
+  EXPECT_EQ(2U, cluster_scope_.counter("prefix.zone.from_az.to_az.upstream_rq_503").value());
+  EXPECT_EQ(
+      2U, global_store_.counter("vhost.test-vhost.vcluster.test-cluster.upstream_rq_5xx").value());
+  EXPECT_EQ(
+      2U, global_store_.counter("vhost.test-vhost.vcluster.test-cluster.upstream_rq_503").value());
+  EXPECT_EQ(8U, cluster_scope_.counters().size());
+  EXPECT_EQ(2U, global_store_.counters().size());
+}
+
+TEST(CodeStatsTest, SameCountersAsNames) {
+  Stats::IsolatedStoreImpl by_name;
+  Stats::IsolatedStoreImpl by_handle;
+  CodeStatsImpl code_stats("prefix.");
+
+  // Well known codes, codes that are not well known and codes outside of the classes.
+  for (uint64_t code : {200, 200, 201, 302, 404, 503, 100, 299, 420, 599, 600}) {
+    for (bool canary : {false, true}) {
+      for (bool internal_request : {false, true}) {
+        TestHeaderMapImpl headers{{":status", std::to_string(code)}};
+        CodeUtility::ResponseStatInfo info{
+            by_name,      by_name,      "prefix.", headers, internal_request, EMPTY_STRING,
+            EMPTY_STRING, EMPTY_STRING, EMPTY_STRING, canary, nullptr, nullptr};
+        CodeUtility::chargeResponseStat(info);
+        code_stats.chargeResponseStat(by_handle, static_cast<Code>(code), canary,
+                                      internal_request);
+      }
+    }
+    CodeUtility::chargeBasicResponseStat(by_name, "prefix.", static_cast<Code>(code));
+    code_stats.chargeBasicResponseStat(by_handle, static_cast<Code>(code));
+  }
+
+  std::map<std::string, uint64_t> expected;
+  for (const Stats::CounterSharedPtr& counter : by_name.counters()) {
+    expected[counter->name()] = counter->value();
+  }
+  std::map<std::string, uint64_t> actual;
+  for (const Stats::CounterSharedPtr& counter : by_handle.counters()) {
+    actual[counter->name()] = counter->value();
+  }
+  EXPECT_EQ(expected, actual);
+}
+
+TEST(CodeStatsTest, CodeIndex) {
+  EXPECT_EQ(0U, CodeStatsImpl::codeIndex(100));
+  EXPECT_EQ(1U, CodeStatsImpl::codeIndex(200));
+  EXPECT_EQ(CodeStatsImpl::NumCodes - 1, CodeStatsImpl::codeIndex(511));
+  EXPECT_EQ(CodeStatsImpl::NumCodes, CodeStatsImpl::codeIndex(0));
+  EXPECT_EQ(CodeStatsImpl::NumCodes, CodeStatsImpl::codeIndex(299));
+  EXPECT_EQ(CodeStatsImpl::NumCodes, CodeStatsImpl::codeIndex(600));
+}
+
 TEST(CodeUtilityResponseTimingTest, All) {
   Stats::MockStore global_store;
   Stats::MockStore cluster_scope;
 
   CodeUtility::ResponseTimingInfo info{global_store, cluster_scope, "prefix.",
                                        std::chrono::milliseconds(5), true, true, "vhost_name",
-                                       "req_vcluster_name", "from_az", "to_az"};
+                                       "req_vcluster_name", "from_az", "to_az", nullptr, nullptr};
 
   EXPECT_CALL(cluster_scope,
               deliverTimingToSinks("prefix.upstream_rq_time", std::chrono::milliseconds(5)));
@@ -191,5 +265,32 @@ TEST(CodeUtilityResponseTimingTest, All) {
   CodeUtility::chargeResponseTiming(info);
 }
 
+TEST(CodeUtilityResponseTimingTest, CodeStats) {
+  Stats::MockStore global_store;
+  Stats::MockStore cluster_scope;
+  CodeStatsImpl cluster_code_stats("prefix.");
+  CodeStatsImpl vcluster_code_stats("vhost.vhost_name.vcluster.req_vcluster_name.");
+
+  CodeUtility::ResponseTimingInfo info{global_store,         cluster_scope,
+                                       "prefix.",            std::chrono::milliseconds(5),
+                                       true,                 false,
+                                       "vhost_name",         "req_vcluster_name",
+                                       "from_az",            "to_az",
+                                       &cluster_code_stats, &vcluster_code_stats};
+
+  EXPECT_CALL(cluster_scope,
+              deliverTimingToSinks("prefix.upstream_rq_time", std::chrono::milliseconds(5)));
+  EXPECT_CALL(cluster_scope,
+              deliverTimingToSinks("prefix.canary.upstream_rq_time", std::chrono::milliseconds(5)));
+  EXPECT_CALL(cluster_scope, deliverTimingToSinks("prefix.external.upstream_rq_time",
+                                                  std::chrono::milliseconds(5)));
+  EXPECT_CALL(global_store,
+              deliverTimingToSinks("vhost.vhost_name.vcluster.req_vcluster_name.upstream_rq_time",
+                                   std::chrono::milliseconds(5)));
+  EXPECT_CALL(cluster_scope, deliverTimingToSinks("prefix.zone.from_az.to_az.upstream_rq_time",
+                                                  std::chrono::milliseconds(5)));
+  CodeUtility::chargeResponseTiming(info);
+}
+
 } // Http
 } // Envoy
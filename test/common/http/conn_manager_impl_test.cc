@@ -28,6 +28,7 @@
 #include "test/mocks/network/mocks.h"
 #include "test/mocks/runtime/mocks.h"
 #include "test/mocks/ssl/mocks.h"
+#include "test/mocks/stats/mocks.h"
 #include "test/mocks/tracing/mocks.h"
 #include "test/test_common/printers.h"
 
@@ -67,7 +68,8 @@ public:
         stats_{{ALL_HTTP_CONN_MAN_STATS(POOL_COUNTER(fake_stats_), POOL_GAUGE(fake_stats_),
                                         POOL_TIMER(fake_stats_))},
                "",
-               fake_stats_},
+               fake_stats_,
+               UserAgentContextPtr{new UserAgentContext("", fake_stats_)}},
         tracing_stats_{CONN_MAN_TRACING_STATS(POOL_COUNTER(fake_stats_))} {
     tracing_config_.reset(new TracingConnectionManagerConfig(
         {Tracing::OperationName::Ingress, {LowerCaseString(":method")}}));
@@ -164,7 +166,7 @@ public:
   NiceMock<Envoy::AccessLog::MockAccessLogManager> log_manager_;
   std::string access_log_path_;
   std::list<AccessLog::InstanceSharedPtr> access_logs_;
-  Stats::IsolatedStoreImpl fake_stats_;
+  NiceMock<Stats::MockIsolatedStatsStore> fake_stats_;
   NiceMock<Network::MockReadFilterCallbacks> filter_callbacks_;
   MockServerConnection* codec_;
   NiceMock<MockFilterChainFactory> filter_factory_;
@@ -972,6 +974,81 @@ TEST_F(HttpConnectionManagerImplTest, FilterAddBodyInline) {
       HeaderMapPtr{new TestHeaderMapImpl{{":status", "200"}}}, true);
 }
 
+TEST_F(HttpConnectionManagerImplTest, ClearRouteCache) {
+  InSequence s;
+  setup(false, "");
+
+  EXPECT_CALL(*codec_, dispatch(_)).WillOnce(Invoke([&](Buffer::Instance&) -> void {
+    StreamDecoder* decoder = &conn_manager_->newStream(response_encoder_);
+    HeaderMapPtr headers{new TestHeaderMapImpl{{":authority", "host"}, {":path", "/"}}};
+    decoder->decodeHeaders(std::move(headers), true);
+  }));
+
+  setupFilterChain(2, 0);
+
+  std::shared_ptr<Router::MockRoute> route2(new NiceMock<Router::MockRoute>());
+  EXPECT_CALL(*route_config_provider_.route_config_, route(_, _));
+  EXPECT_CALL(*decoder_filters_[0], decodeHeaders(_, true))
+      .WillOnce(Invoke([&](HeaderMap& headers, bool) -> FilterHeadersStatus {
+        EXPECT_EQ(route_config_provider_.route_config_->route_,
+                  decoder_filters_[0]->callbacks_->route());
+        headers.addCopy(LowerCaseString("x-route"), "2");
+        decoder_filters_[0]->callbacks_->clearRouteCache();
+        return FilterHeadersStatus::Continue;
+      }));
+  EXPECT_CALL(*decoder_filters_[1], decodeHeaders(_, true))
+      .WillOnce(InvokeWithoutArgs([&]() -> FilterHeadersStatus {
+        EXPECT_EQ(route2, decoder_filters_[1]->callbacks_->route());
+        EXPECT_EQ(route2, decoder_filters_[1]->callbacks_->route());
+        return FilterHeadersStatus::StopIteration;
+      }));
+  EXPECT_CALL(*route_config_provider_.route_config_, route(_, _))
+      .WillOnce(Invoke([&](const HeaderMap& headers, uint64_t) -> Router::RouteConstSharedPtr {
+        EXPECT_STREQ("2", headers.get(LowerCaseString("x-route"))->value().c_str());
+        return route2;
+      }));
+
+  Buffer::OwnedImpl fake_input("1234");
+  conn_manager_->onData(fake_input);
+  EXPECT_EQ(1U, stats_.named_.downstream_rq_route_recalc_.value());
+}
+
+TEST_F(HttpConnectionManagerImplTest, FilterTiming) {
+  setup(false, "");
+  EXPECT_CALL(runtime_.snapshot_,
+              featureEnabled("http_connection_manager.filter_timing_sampling", 0, _, 10000))
+      .WillOnce(Return(true));
+
+  EXPECT_CALL(*codec_, dispatch(_)).WillOnce(Invoke([&](Buffer::Instance&) -> void {
+    StreamDecoder* decoder = &conn_manager_->newStream(response_encoder_);
+    HeaderMapPtr headers{new TestHeaderMapImpl{{":authority", "host"}, {":path", "/"}}};
+    decoder->decodeHeaders(std::move(headers), true);
+  }));
+
+  MockStreamDecoderFilter* decoder_filter = new NiceMock<MockStreamDecoderFilter>();
+  MockStreamEncoderFilter* encoder_filter = new NiceMock<MockStreamEncoderFilter>();
+  const std::string decoder_filter_name = "auth";
+  EXPECT_CALL(filter_factory_, createFilterChain(_))
+      .WillOnce(Invoke([&](FilterChainFactoryCallbacks& callbacks) -> void {
+        callbacks.addStreamEncoderFilter(StreamEncoderFilterSharedPtr{encoder_filter});
+        callbacks.setFilterName(decoder_filter_name);
+        callbacks.addStreamDecoderFilter(StreamDecoderFilterSharedPtr{decoder_filter});
+      }));
+
+  EXPECT_CALL(*decoder_filter, decodeHeaders(_, true))
+      .WillOnce(Return(FilterHeadersStatus::StopIteration));
+  EXPECT_CALL(fake_stats_, deliverHistogramToSinks("filter.auth.decode_headers_cpu_ns", _));
+  Buffer::OwnedImpl fake_input("1234");
+  conn_manager_->onData(fake_input);
+
+  EXPECT_CALL(*encoder_filter, encodeHeaders(_, true))
+      .WillOnce(Return(FilterHeadersStatus::Continue));
+  EXPECT_CALL(fake_stats_, deliverHistogramToSinks("filter.unnamed.encode_headers_cpu_ns", _));
+  EXPECT_CALL(response_encoder_, encodeHeaders(_, true));
+  decoder_filter->callbacks_->encodeHeaders(
+      HeaderMapPtr{new TestHeaderMapImpl{{":status", "200"}}}, true);
+}
+
 TEST_F(HttpConnectionManagerImplTest, FilterAddBodyContinuation) {
   InSequence s;
   setup(false, "");
@@ -1039,6 +1116,8 @@ TEST_F(HttpConnectionManagerImplTest, MultipleFilters) {
 
   setupFilterChain(3, 2);
 
+  // The route is resolved once before the filters run and then cached.
+  EXPECT_CALL(*route_config_provider_.route_config_, route(_, _));
   EXPECT_CALL(*decoder_filters_[0], decodeHeaders(_, false))
       .WillOnce(InvokeWithoutArgs([&]() -> FilterHeadersStatus {
         EXPECT_EQ(route_config_provider_.route_config_->route_,
@@ -1047,9 +1126,6 @@ TEST_F(HttpConnectionManagerImplTest, MultipleFilters) {
         return FilterHeadersStatus::StopIteration;
       }));
 
-  // Test route caching.
-  EXPECT_CALL(*route_config_provider_.route_config_, route(_, _));
-
   EXPECT_CALL(*decoder_filters_[0], decodeData(_, false))
       .WillOnce(Return(FilterDataStatus::StopIterationAndBuffer));
   EXPECT_CALL(*decoder_filters_[0], decodeData(_, true))
@@ -1108,6 +1184,64 @@ TEST_F(HttpConnectionManagerImplTest, MultipleFilters) {
   EXPECT_EQ(ssl_connection_.get(), encoder_filters_[1]->callbacks_->ssl());
 }
 
+TEST_F(HttpConnectionManagerImplTest, FlowControl) {
+  InSequence s;
+  setup(false, "");
+
+  StreamDecoder* decoder = nullptr;
+  EXPECT_CALL(*codec_, dispatch(_)).WillOnce(Invoke([&](Buffer::Instance&) -> void {
+    decoder = &conn_manager_->newStream(response_encoder_);
+    HeaderMapPtr headers{new TestHeaderMapImpl{{":authority", "host"}, {":path", "/"}}};
+    decoder->decodeHeaders(std::move(headers), false);
+  }));
+
+  setupFilterChain(1, 0);
+
+  EXPECT_CALL(*decoder_filters_[0], decodeHeaders(_, false))
+      .WillOnce(Return(FilterHeadersStatus::StopIteration));
+
+  Buffer::OwnedImpl fake_input("1234");
+  conn_manager_->onData(fake_input);
+
+  // A filter whose upstream is backed up pauses reading from the downstream stream.
+  EXPECT_CALL(response_encoder_.stream_, readDisable(true));
+  decoder_filters_[0]->callbacks_->onDecoderFilterAboveWriteBufferHighWatermark();
+  EXPECT_CALL(response_encoder_.stream_, readDisable(false));
+  decoder_filters_[0]->callbacks_->onDecoderFilterBelowWriteBufferLowWatermark();
+  EXPECT_EQ(1U, stats_.named_.downstream_flow_control_paused_reading_total_.value());
+  EXPECT_EQ(1U, stats_.named_.downstream_flow_control_resumed_reading_total_.value());
+
+  // Watermark events on the downstream stream reach the registered callbacks.
+  MockDownstreamWatermarkCallbacks callbacks;
+  decoder_filters_[0]->callbacks_->addDownstreamWatermarkCallbacks(callbacks);
+  EXPECT_CALL(callbacks, onAboveWriteBufferHighWatermark());
+  response_encoder_.stream_.callbacks_.front()->onAboveWriteBufferHighWatermark();
+
+  // Callbacks added while the stream is backed up are told right away.
+  MockDownstreamWatermarkCallbacks late_callbacks;
+  EXPECT_CALL(late_callbacks, onAboveWriteBufferHighWatermark());
+  decoder_filters_[0]->callbacks_->addDownstreamWatermarkCallbacks(late_callbacks);
+
+  EXPECT_CALL(callbacks, onBelowWriteBufferLowWatermark());
+  EXPECT_CALL(late_callbacks, onBelowWriteBufferLowWatermark());
+  response_encoder_.stream_.callbacks_.front()->onBelowWriteBufferLowWatermark();
+
+  decoder_filters_[0]->callbacks_->removeDownstreamWatermarkCallbacks(callbacks);
+  decoder_filters_[0]->callbacks_->removeDownstreamWatermarkCallbacks(late_callbacks);
+  EXPECT_CALL(callbacks, onAboveWriteBufferHighWatermark()).Times(0);
+  response_encoder_.stream_.callbacks_.front()->onAboveWriteBufferHighWatermark();
+
+  EXPECT_CALL(*decoder_filters_[0], decodeData(_, true))
+      .WillOnce(Return(FilterDataStatus::StopIterationNoBuffer));
+  Buffer::OwnedImpl request_end;
+  decoder->decodeData(request_end, true);
+
+  EXPECT_CALL(response_encoder_, encodeHeaders(_, true));
+  expectOnDestroy();
+  HeaderMapPtr response_headers{new TestHeaderMapImpl{{":status", "200"}}};
+  decoder_filters_[0]->callbacks_->encodeHeaders(std::move(response_headers), true);
+}
+
 TEST(HttpConnectionManagerTracingStatsTest, verifyTracingStats) {
   Stats::IsolatedStoreImpl stats;
   ConnectionManagerTracingStats tracing_stats{CONN_MAN_TRACING_STATS(POOL_COUNTER(stats))};
@@ -11,7 +11,9 @@
 #include "gtest/gtest.h"
 
 namespace Envoy {
+using testing::AtMost;
 using testing::NiceMock;
+using testing::_;
 
 namespace Http {
 
@@ -26,7 +28,11 @@ TEST(DateProviderImplTest, All) {
   provider.setDateHeader(headers);
   EXPECT_NE(nullptr, headers.Date());
 
-  EXPECT_CALL(*timer, enableTimer(std::chrono::milliseconds(500)));
+  // The date is only posted to the threads again if it changed, which happens at most once for two
+  // refreshes well within a second.
+  EXPECT_CALL(tls, set(_, _)).Times(AtMost(1));
+  EXPECT_CALL(*timer, enableTimer(std::chrono::milliseconds(500))).Times(2);
+  timer->callback_();
   timer->callback_();
 
   headers.removeDate();
@@ -0,0 +1,200 @@
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "common/http/filter/adaptive_concurrency_filter.h"
+#include "common/http/header_map_impl.h"
+#include "common/json/json_loader.h"
+#include "common/stats/stats_impl.h"
+
+#include "test/mocks/common.h"
+#include "test/mocks/http/mocks.h"
+#include "test/test_common/printers.h"
+#include "test/test_common/utility.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace Envoy {
+using testing::_;
+using testing::Invoke;
+using testing::NiceMock;
+using testing::Return;
+
+namespace Http {
+
+class AdaptiveConcurrencyFilterTest : public testing::Test {
+public:
+  AdaptiveConcurrencyFilterTest() {
+    ON_CALL(time_source_, currentTime()).WillByDefault(Invoke([this]() -> MonotonicTime {
+      return time_;
+    }));
+  }
+
+  void setup(const std::string& json) {
+    Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
+    config_.reset(new AdaptiveConcurrencyFilterConfig(*config, "test.", store_, time_source_));
+  }
+
+  std::unique_ptr<AdaptiveConcurrencyFilter> createFilter() {
+    std::unique_ptr<AdaptiveConcurrencyFilter> filter(new AdaptiveConcurrencyFilter(config_));
+    filter->setDecoderFilterCallbacks(decoder_callbacks_);
+    filter->setEncoderFilterCallbacks(encoder_callbacks_);
+    return filter;
+  }
+
+  void advance(std::chrono::milliseconds ms) { time_ += ms; }
+
+  uint64_t limitGauge() {
+    return store_.gauge("cluster.fake_cluster.adaptive_concurrency.concurrency_limit").value();
+  }
+
+  const std::string default_config_{R"EOF(
+  {
+    "initial_concurrency_limit": 2,
+    "min_concurrency_limit": 1,
+    "max_concurrency_limit": 20,
+    "sample_window_ms": 100,
+    "min_rtt_window_ms": 1000
+  }
+  )EOF"};
+
+  Stats::IsolatedStoreImpl store_;
+  NiceMock<MockMonotonicTimeSource> time_source_;
+  MonotonicTime time_;
+  AdaptiveConcurrencyFilterConfigSharedPtr config_;
+  NiceMock<MockStreamDecoderFilterCallbacks> decoder_callbacks_;
+  NiceMock<MockStreamEncoderFilterCallbacks> encoder_callbacks_;
+};
+
+TEST_F(AdaptiveConcurrencyFilterTest, BadConfig) {
+  EXPECT_THROW(setup(R"EOF({"min_concurrency_limit": 10, "max_concurrency_limit": 5})EOF"),
+               EnvoyException);
+  EXPECT_THROW(setup(R"EOF({"sample_window_ms": 0})EOF"), Json::Exception);
+}
+
+TEST_F(AdaptiveConcurrencyFilterTest, NoRoute) {
+  setup(default_config_);
+  EXPECT_CALL(decoder_callbacks_, route()).WillOnce(Return(nullptr));
+
+  std::unique_ptr<AdaptiveConcurrencyFilter> filter = createFilter();
+  TestHeaderMapImpl request_headers;
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter->decodeHeaders(request_headers, true));
+  TestHeaderMapImpl response_headers{{":status", "404"}};
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter->encodeHeaders(response_headers, true));
+  filter->onDestroy();
+}
+
+TEST_F(AdaptiveConcurrencyFilterTest, BlockAboveLimit) {
+  setup(default_config_);
+  EXPECT_EQ(2U, limitGauge());
+
+  TestHeaderMapImpl request_headers;
+  std::unique_ptr<AdaptiveConcurrencyFilter> filter1 = createFilter();
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter1->decodeHeaders(request_headers, true));
+  std::unique_ptr<AdaptiveConcurrencyFilter> filter2 = createFilter();
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter2->decodeHeaders(request_headers, true));
+
+  std::unique_ptr<AdaptiveConcurrencyFilter> filter3 = createFilter();
+  TestHeaderMapImpl local_response{{":status", "503"},
+                                   {"content-length", "35"},
+                                   {"content-type", "text/plain"}};
+  EXPECT_CALL(decoder_callbacks_.request_info_,
+              setResponseFlag(Http::AccessLog::ResponseFlag::UpstreamOverflow));
+  EXPECT_CALL(decoder_callbacks_, encodeHeaders_(HeaderMapEqualRef(&local_response), false));
+  EXPECT_CALL(decoder_callbacks_, encodeData(_, true));
+  EXPECT_EQ(FilterHeadersStatus::StopIteration, filter3->decodeHeaders(request_headers, true));
+  filter3->onDestroy();
+  EXPECT_EQ(1U, store_.counter("test.adaptive_concurrency.rq_blocked").value());
+
+  // A finished request frees its slot.
+  TestHeaderMapImpl response_headers{{":status", "200"}, {"x-envoy-upstream-service-time", "5"}};
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter1->encodeHeaders(response_headers, true));
+  filter1->onDestroy();
+  std::unique_ptr<AdaptiveConcurrencyFilter> filter4 = createFilter();
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter4->decodeHeaders(request_headers, true));
+
+  // So does a reset one.
+  filter2->onDestroy();
+  filter4->onDestroy();
+}
+
+TEST_F(AdaptiveConcurrencyFilterTest, LimitFollowsRtt) {
+  setup(default_config_);
+  ConcurrencyLimiter& limiter = config_->limiter("fake_cluster");
+
+  // No queueing, so the limit grows by its square root.
+  ASSERT_TRUE(limiter.tryAcquire());
+  advance(std::chrono::milliseconds(100));
+  limiter.release(std::chrono::milliseconds(10));
+  EXPECT_EQ(3U, limiter.limit());
+  EXPECT_EQ(3U, limitGauge());
+  EXPECT_EQ(10U, store_.gauge("cluster.fake_cluster.adaptive_concurrency.min_rtt_ms").value());
+
+  // Samples are not acted on until the window has ended.
+  ASSERT_TRUE(limiter.tryAcquire());
+  limiter.release(std::chrono::milliseconds(10));
+  EXPECT_EQ(3U, limiter.limit());
+
+  advance(std::chrono::milliseconds(100));
+  ASSERT_TRUE(limiter.tryAcquire());
+  limiter.release(std::chrono::milliseconds(10));
+  EXPECT_EQ(5U, limiter.limit());
+
+  // The RTT doubles so the limit is halved, plus headroom.
+  advance(std::chrono::milliseconds(100));
+  ASSERT_TRUE(limiter.tryAcquire());
+  limiter.release(std::chrono::milliseconds(20));
+  EXPECT_EQ(5U, limiter.limit());
+
+  // Severe queueing is bounded to halving the limit, and the headroom keeps it from collapsing.
+  for (uint32_t i = 0; i < 5; i++) {
+    advance(std::chrono::milliseconds(100));
+    ASSERT_TRUE(limiter.tryAcquire());
+    limiter.release(std::chrono::milliseconds(500));
+  }
+  EXPECT_EQ(5U, limiter.limit());
+
+  // Releases without an RTT do not count as samples.
+  advance(std::chrono::milliseconds(100));
+  ASSERT_TRUE(limiter.tryAcquire());
+  limiter.release(Optional<std::chrono::milliseconds>());
+  EXPECT_EQ(5U, limiter.limit());
+
+  // Once the minimum RTT window has passed the minimum is taken from the next window.
+  advance(std::chrono::milliseconds(1000));
+  ASSERT_TRUE(limiter.tryAcquire());
+  limiter.release(std::chrono::milliseconds(30));
+  EXPECT_EQ(30U, store_.gauge("cluster.fake_cluster.adaptive_concurrency.min_rtt_ms").value());
+  EXPECT_EQ(7U, limiter.limit());
+}
+
+TEST_F(AdaptiveConcurrencyFilterTest, MaxLimit) {
+  setup(R"EOF({"initial_concurrency_limit": 4, "max_concurrency_limit": 5})EOF");
+  ConcurrencyLimiter& limiter = config_->limiter("fake_cluster");
+
+  for (uint32_t i = 0; i < 3; i++) {
+    advance(std::chrono::milliseconds(100));
+    ASSERT_TRUE(limiter.tryAcquire());
+    limiter.release(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(5U, limiter.limit());
+}
+
+TEST_F(AdaptiveConcurrencyFilterTest, RttFromResponse) {
+  setup(default_config_);
+  std::unique_ptr<AdaptiveConcurrencyFilter> filter = createFilter();
+
+  TestHeaderMapImpl request_headers;
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter->decodeHeaders(request_headers, true));
+  advance(std::chrono::milliseconds(100));
+  TestHeaderMapImpl response_headers{{":status", "200"}, {"x-envoy-upstream-service-time", "8"}};
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter->encodeHeaders(response_headers, true));
+  filter->onDestroy();
+
+  EXPECT_EQ(3U, limitGauge());
+  EXPECT_EQ(8U, store_.gauge("cluster.fake_cluster.adaptive_concurrency.min_rtt_ms").value());
+}
+
+} // Http
+} // Envoy
@@ -9,6 +9,7 @@
 
 #include "test/mocks/buffer/mocks.h"
 #include "test/mocks/http/mocks.h"
+#include "test/test_common/environment.h"
 #include "test/test_common/printers.h"
 
 #include "gmock/gmock.h"
@@ -118,5 +119,32 @@ TEST_F(BufferFilterTest, TxResetAfterEndStream) {
   filter_.onDestroy();
 }
 
+TEST_F(BufferFilterTest, SpillToDisk) {
+  config_->spill_directory_ = TestEnvironment::temporaryDirectory();
+  config_->spill_memory_limit_bytes_ = 1024;
+  expectTimerCreate();
+
+  TestHeaderMapImpl headers;
+  EXPECT_EQ(FilterHeadersStatus::StopIteration, filter_.decodeHeaders(headers, false));
+
+  // The spill buffer is put in place before the first data is buffered.
+  EXPECT_CALL(callbacks_, decodingBuffer()).WillOnce(Return(nullptr));
+  EXPECT_CALL(callbacks_, setDecodingBuffer_(_));
+  Buffer::OwnedImpl data1(std::string(256 * 1024, 'a'));
+  EXPECT_EQ(FilterDataStatus::StopIterationAndBuffer, filter_.decodeData(data1, false));
+
+  // Mimic the connection manager buffering the data.
+  ON_CALL(callbacks_, decodingBuffer()).WillByDefault(Return(callbacks_.buffer_.get()));
+  callbacks_.buffer_->move(data1);
+
+  EXPECT_CALL(callbacks_, setDecodingBuffer_(_)).Times(0);
+  Buffer::OwnedImpl data2("b");
+  EXPECT_EQ(FilterDataStatus::Continue, filter_.decodeData(data2, true));
+
+  filter_.onDestroy();
+  EXPECT_EQ(1U, config_->stats_.rq_spilled_.value());
+  EXPECT_EQ(0U, config_->stats_.rq_spill_failed_.value());
+}
+
 } // Http
 } // Envoy
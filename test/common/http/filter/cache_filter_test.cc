@@ -0,0 +1,348 @@
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/http/filter/cache_filter.h"
+#include "common/http/header_map_impl.h"
+#include "common/json/json_loader.h"
+#include "common/stats/stats_impl.h"
+
+#include "test/mocks/buffer/mocks.h"
+#include "test/mocks/common.h"
+#include "test/mocks/http/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
+#include "test/test_common/printers.h"
+#include "test/test_common/utility.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace Envoy {
+using testing::_;
+using testing::Invoke;
+using testing::NiceMock;
+
+namespace Http {
+
+class CacheFilterTest : public testing::Test {
+public:
+  CacheFilterTest() {
+    ON_CALL(time_source_, currentTime()).WillByDefault(Invoke([this]() -> MonotonicTime {
+      return time_;
+    }));
+    setup("{}");
+  }
+
+  void setup(const std::string& json) {
+    Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
+    config_.reset(new CacheFilterConfig(*config, "test.", store_, tls_, time_source_));
+  }
+
+  struct TestFilter {
+    TestFilter(CacheFilterConfigSharedPtr config) : filter_(config) {
+      filter_.setDecoderFilterCallbacks(decoder_callbacks_);
+      filter_.setEncoderFilterCallbacks(encoder_callbacks_);
+    }
+
+    ~TestFilter() { filter_.onDestroy(); }
+
+    NiceMock<MockStreamDecoderFilterCallbacks> decoder_callbacks_;
+    NiceMock<MockStreamEncoderFilterCallbacks> encoder_callbacks_;
+    CacheFilter filter_;
+  };
+
+  // Send a response from upstream through a filter that let its request through.
+  void respond(TestFilter& filter, TestHeaderMapImpl&& headers, const std::string& body) {
+    EXPECT_EQ(FilterHeadersStatus::Continue, filter.filter_.encodeHeaders(headers, body.empty()));
+    if (!body.empty()) {
+      Buffer::OwnedImpl data(body);
+      EXPECT_EQ(FilterDataStatus::Continue, filter.filter_.encodeData(data, true));
+    }
+  }
+
+  // Populate the cache with a response to request_headers_.
+  void fill(TestHeaderMapImpl&& response_headers, const std::string& body) {
+    TestFilter filter(config_);
+    EXPECT_EQ(FilterHeadersStatus::Continue, filter.filter_.decodeHeaders(request_headers_, true));
+    respond(filter, std::move(response_headers), body);
+  }
+
+  // Expect a request to be served from the cache.
+  void expectHit(TestFilter& filter, const std::string& age, const std::string& body) {
+    EXPECT_CALL(filter.decoder_callbacks_, encodeHeaders_(_, false))
+        .WillOnce(Invoke([&](HeaderMap& headers, bool) -> void {
+          EXPECT_STREQ("200", headers.Status()->value().c_str());
+          EXPECT_STREQ(age.c_str(), headers.get(Headers::get().Age)->value().c_str());
+        }));
+    EXPECT_CALL(filter.decoder_callbacks_, encodeData(BufferStringEqual(body), true));
+  }
+
+  uint64_t counter(const std::string& name) {
+    return store_.counter("test.cache." + name).value();
+  }
+
+  Stats::IsolatedStoreImpl store_;
+  NiceMock<ThreadLocal::MockInstance> tls_;
+  NiceMock<MockMonotonicTimeSource> time_source_;
+  MonotonicTime time_;
+  CacheFilterConfigSharedPtr config_;
+  TestHeaderMapImpl request_headers_{
+      {":method", "GET"}, {":authority", "host"}, {":path", "/flags"}};
+};
+
+TEST_F(CacheFilterTest, BadConfig) {
+  EXPECT_THROW(setup(R"EOF({"max_size_bytes": 0})EOF"), Json::Exception);
+  EXPECT_THROW(setup(R"EOF({"unknown": 1})EOF"), Json::Exception);
+}
+
+TEST_F(CacheFilterTest, MissThenHit) {
+  fill({{":status", "200"}, {"cache-control", "public, max-age=60"}}, "hello");
+  EXPECT_EQ(1U, counter("rq_miss"));
+  EXPECT_EQ(1U, counter("insert"));
+
+  time_ += std::chrono::seconds(10);
+  TestFilter filter(config_);
+  expectHit(filter, "10", "hello");
+  EXPECT_EQ(FilterHeadersStatus::StopIteration,
+            filter.filter_.decodeHeaders(request_headers_, true));
+  EXPECT_EQ(1U, counter("rq_hit"));
+
+  // A different path is a different key.
+  TestHeaderMapImpl other_request{{":method", "GET"}, {":authority", "host"}, {":path", "/other"}};
+  TestFilter other_filter(config_);
+  EXPECT_EQ(FilterHeadersStatus::Continue, other_filter.filter_.decodeHeaders(other_request, true));
+  EXPECT_EQ(2U, counter("rq_miss"));
+}
+
+TEST_F(CacheFilterTest, HitsShareBody) {
+  fill({{":status", "200"}, {"cache-control", "max-age=60"}}, "hello");
+
+  const void* replayed[2];
+  for (const void*& data : replayed) {
+    TestFilter filter(config_);
+    EXPECT_CALL(filter.decoder_callbacks_, encodeData(_, true))
+        .WillOnce(Invoke([&](Buffer::Instance& body, bool) -> void {
+          Buffer::RawSlice slice;
+          EXPECT_EQ(1U, body.getRawSlices(&slice, 1));
+          data = slice.mem_;
+        }));
+    filter.filter_.decodeHeaders(request_headers_, true);
+  }
+
+  // Both responses were replayed from the cached copy of the body.
+  EXPECT_EQ(replayed[0], replayed[1]);
+}
+
+TEST_F(CacheFilterTest, SharedMaxAgeAndInitialAge) {
+  fill({{":status", "200"}, {"cache-control", "max-age=1, s-maxage=60"}, {"age", "20"}}, "hello");
+
+  time_ += std::chrono::seconds(30);
+  TestFilter filter(config_);
+  expectHit(filter, "50", "hello");
+  filter.filter_.decodeHeaders(request_headers_, true);
+
+  // The response is stale once its age reaches s-maxage.
+  time_ += std::chrono::seconds(10);
+  TestFilter stale_filter(config_);
+  EXPECT_EQ(FilterHeadersStatus::Continue,
+            stale_filter.filter_.decodeHeaders(request_headers_, true));
+}
+
+TEST_F(CacheFilterTest, UncacheableRequests) {
+  fill({{":status", "200"}, {"cache-control", "max-age=60"}}, "hello");
+
+  TestHeaderMapImpl requests[] = {
+      {{":method", "POST"}, {":authority", "host"}, {":path", "/flags"}},
+      {{":method", "GET"}, {":authority", "host"}, {":path", "/flags"}, {"authorization", "x"}},
+      {{":method", "GET"}, {":authority", "host"}, {":path", "/flags"}, {"if-none-match", "x"}},
+      {{":method", "GET"},
+       {":authority", "host"},
+       {":path", "/flags"},
+       {"cache-control", "no-cache"}}};
+  for (TestHeaderMapImpl& request : requests) {
+    TestFilter filter(config_);
+    EXPECT_CALL(filter.decoder_callbacks_, encodeHeaders_(_, _)).Times(0);
+    EXPECT_EQ(FilterHeadersStatus::Continue, filter.filter_.decodeHeaders(request, true));
+  }
+
+  // Requests with a body are passed through as well.
+  TestFilter filter(config_);
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter.filter_.decodeHeaders(request_headers_, false));
+  EXPECT_EQ(1U, counter("rq_miss"));
+  EXPECT_EQ(0U, counter("rq_hit"));
+}
+
+TEST_F(CacheFilterTest, UncacheableResponses) {
+  fill({{":status", "200"}}, "hello");
+  fill({{":status", "200"}, {"cache-control", "max-age=60, private"}}, "hello");
+  fill({{":status", "200"}, {"cache-control", "no-store"}}, "hello");
+  fill({{":status", "404"}, {"cache-control", "max-age=60"}}, "hello");
+  fill({{":status", "200"}, {"cache-control", "max-age=60"}, {"vary", "*"}}, "hello");
+  EXPECT_EQ(0U, counter("insert"));
+
+  // Responses with trailers are not cached.
+  {
+    TestFilter filter(config_);
+    filter.filter_.decodeHeaders(request_headers_, true);
+    TestHeaderMapImpl headers{{":status", "200"}, {"cache-control", "max-age=60"}};
+    filter.filter_.encodeHeaders(headers, false);
+    Buffer::OwnedImpl data("hello");
+    filter.filter_.encodeData(data, false);
+    TestHeaderMapImpl trailers{{"grpc-status", "0"}};
+    filter.filter_.encodeTrailers(trailers);
+  }
+  EXPECT_EQ(0U, counter("insert"));
+}
+
+TEST_F(CacheFilterTest, SizeLimits) {
+  setup(R"EOF({"max_size_bytes": 100, "max_entry_bytes": 60})EOF");
+
+  // Too large for an entry.
+  fill({{":status", "200"}, {"cache-control", "max-age=60"}}, std::string(60, 'a'));
+  EXPECT_EQ(0U, counter("insert"));
+
+  fill({{":status", "200"}, {"cache-control", "max-age=60"}}, "hello");
+  request_headers_.Path()->value(std::string("/other"));
+  fill({{":status", "200"}, {"cache-control", "max-age=60"}}, "world");
+  EXPECT_EQ(2U, counter("insert"));
+
+  // A third entry does not fit, so the least recently used one is evicted.
+  request_headers_.Path()->value(std::string("/flags"));
+  {
+    TestFilter filter(config_);
+    expectHit(filter, "0", "hello");
+    filter.filter_.decodeHeaders(request_headers_, true);
+  }
+  request_headers_.Path()->value(std::string("/third"));
+  fill({{":status", "200"}, {"cache-control", "max-age=60"}}, "third");
+  EXPECT_EQ(1U, counter("evicted"));
+
+  request_headers_.Path()->value(std::string("/flags"));
+  TestFilter filter(config_);
+  expectHit(filter, "0", "hello");
+  filter.filter_.decodeHeaders(request_headers_, true);
+  request_headers_.Path()->value(std::string("/other"));
+  TestFilter evicted_filter(config_);
+  EXPECT_EQ(FilterHeadersStatus::Continue,
+            evicted_filter.filter_.decodeHeaders(request_headers_, true));
+}
+
+TEST_F(CacheFilterTest, Vary) {
+  request_headers_.addViaCopy("accept-encoding", "gzip");
+  fill({{":status", "200"}, {"cache-control", "max-age=60"}, {"vary", "Accept-Encoding"}},
+       "hello");
+
+  {
+    TestFilter filter(config_);
+    expectHit(filter, "0", "hello");
+    filter.filter_.decodeHeaders(request_headers_, true);
+  }
+
+  TestHeaderMapImpl other_request{{":method", "GET"},
+                                  {":authority", "host"},
+                                  {":path", "/flags"},
+                                  {"accept-encoding", "br"}};
+  TestFilter filter(config_);
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter.filter_.decodeHeaders(other_request, true));
+}
+
+TEST_F(CacheFilterTest, Revalidate) {
+  fill({{":status", "200"}, {"cache-control", "max-age=60"}, {"etag", "\"v1\""}}, "hello");
+  time_ += std::chrono::seconds(60);
+
+  // The stale response is revalidated, and the 304 is turned back into the cached response.
+  {
+    TestFilter filter(config_);
+    EXPECT_EQ(FilterHeadersStatus::Continue,
+              filter.filter_.decodeHeaders(request_headers_, true));
+    EXPECT_STREQ("\"v1\"", request_headers_.get_("if-none-match").c_str());
+
+    EXPECT_CALL(filter.encoder_callbacks_, addEncodedData(BufferStringEqual("hello")));
+    TestHeaderMapImpl headers{{":status", "304"}, {"cache-control", "max-age=30"}};
+    EXPECT_EQ(FilterHeadersStatus::Continue, filter.filter_.encodeHeaders(headers, true));
+    EXPECT_EQ((TestHeaderMapImpl{{":status", "200"},
+                                 {"cache-control", "max-age=60"},
+                                 {"etag", "\"v1\""},
+                                 {"age", "0"}}),
+              headers);
+  }
+  EXPECT_EQ(1U, counter("rq_revalidated"));
+  request_headers_.remove(Headers::get().IfNoneMatch);
+
+  // The response is fresh again, for the lifetime given by the 304.
+  time_ += std::chrono::seconds(29);
+  {
+    TestFilter filter(config_);
+    expectHit(filter, "29", "hello");
+    filter.filter_.decodeHeaders(request_headers_, true);
+  }
+
+  // A changed response replaces the cached one.
+  time_ += std::chrono::seconds(1);
+  fill({{":status", "200"}, {"cache-control", "max-age=60"}, {"etag", "\"v2\""}}, "world");
+  request_headers_.remove(Headers::get().IfNoneMatch);
+  TestFilter filter(config_);
+  expectHit(filter, "0", "world");
+  filter.filter_.decodeHeaders(request_headers_, true);
+}
+
+TEST_F(CacheFilterTest, NoRevalidationWithoutEtag) {
+  fill({{":status", "200"}, {"cache-control", "max-age=60"}}, "hello");
+  time_ += std::chrono::seconds(60);
+
+  TestFilter filter(config_);
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter.filter_.decodeHeaders(request_headers_, true));
+  EXPECT_EQ(nullptr, request_headers_.get(Headers::get().IfNoneMatch));
+}
+
+TEST_F(CacheFilterTest, CoalesceMisses) {
+  TestFilter leader(config_);
+  EXPECT_EQ(FilterHeadersStatus::Continue, leader.filter_.decodeHeaders(request_headers_, true));
+
+  // Requests for the same key wait for the leader's response.
+  TestHeaderMapImpl waiter_request{{":method", "GET"}, {":authority", "host"}, {":path", "/flags"}};
+  TestFilter waiter(config_);
+  EXPECT_EQ(FilterHeadersStatus::StopIteration,
+            waiter.filter_.decodeHeaders(waiter_request, true));
+  std::unique_ptr<TestFilter> cancelled(new TestFilter(config_));
+  EXPECT_EQ(FilterHeadersStatus::StopIteration,
+            cancelled->filter_.decodeHeaders(waiter_request, true));
+  EXPECT_EQ(2U, counter("rq_coalesced"));
+  EXPECT_CALL(cancelled->decoder_callbacks_, encodeHeaders_(_, _)).Times(0);
+  cancelled.reset();
+
+  expectHit(waiter, "0", "hello");
+  respond(leader, {{":status", "200"}, {"cache-control", "max-age=60"}}, "hello");
+  EXPECT_EQ(1U, counter("rq_miss"));
+}
+
+TEST_F(CacheFilterTest, CoalescedMissNotCacheable) {
+  TestFilter leader(config_);
+  leader.filter_.decodeHeaders(request_headers_, true);
+  TestHeaderMapImpl waiter_request{{":method", "GET"}, {":authority", "host"}, {":path", "/flags"}};
+  TestFilter waiter(config_);
+  waiter.filter_.decodeHeaders(waiter_request, true);
+
+  // Waiting requests go upstream themselves if the response was not cached.
+  EXPECT_CALL(waiter.decoder_callbacks_, continueDecoding());
+  respond(leader, {{":status", "503"}}, "");
+}
+
+TEST_F(CacheFilterTest, CoalescedMissLeaderReset) {
+  std::unique_ptr<TestFilter> leader(new TestFilter(config_));
+  leader->filter_.decodeHeaders(request_headers_, true);
+  TestHeaderMapImpl waiter_request{{":method", "GET"}, {":authority", "host"}, {":path", "/flags"}};
+  TestFilter waiter(config_);
+  waiter.filter_.decodeHeaders(waiter_request, true);
+
+  EXPECT_CALL(waiter.decoder_callbacks_, continueDecoding());
+  leader.reset();
+
+  // The key can be filled again.
+  TestFilter filter(config_);
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter.filter_.decodeHeaders(request_headers_, true));
+}
+
+} // Http
+} // Envoy
@@ -0,0 +1,115 @@
+#include <memory>
+#include <string>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/http/filter/dynamic_forward_proxy_filter.h"
+#include "common/http/header_map_impl.h"
+#include "common/json/json_loader.h"
+#include "common/stats/stats_impl.h"
+
+#include "test/mocks/http/mocks.h"
+#include "test/mocks/network/mocks.h"
+#include "test/mocks/upstream/mocks.h"
+#include "test/test_common/utility.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace Envoy {
+using testing::DoAll;
+using testing::Invoke;
+using testing::NiceMock;
+using testing::Return;
+using testing::SaveArg;
+using testing::_;
+
+namespace Http {
+
+class DynamicForwardProxyFilterTest : public testing::Test {
+public:
+  DynamicForwardProxyFilterTest() {
+    Json::ObjectSharedPtr config = Json::Factory::loadFromString("{}");
+    config_.reset(
+        new DynamicForwardProxyFilterConfig(*config, "prefix.", stats_store_, cm_, dns_resolver_));
+    filter_.reset(new DynamicForwardProxyFilter(config_));
+    filter_->setDecoderFilterCallbacks(filter_callbacks_);
+    cm_.thread_local_cluster_.cluster_.info_->lb_type_ =
+        Upstream::LoadBalancerType::DynamicForwardProxy;
+  }
+
+  Stats::IsolatedStoreImpl stats_store_;
+  NiceMock<Upstream::MockClusterManager> cm_;
+  std::shared_ptr<NiceMock<Network::MockDnsResolver>> dns_resolver_{
+      new NiceMock<Network::MockDnsResolver>()};
+  DynamicForwardProxyFilterConfigSharedPtr config_;
+  std::unique_ptr<DynamicForwardProxyFilter> filter_;
+  NiceMock<MockStreamDecoderFilterCallbacks> filter_callbacks_;
+  TestHeaderMapImpl request_headers_{{":authority", "example.com:8080"}};
+};
+
+TEST_F(DynamicForwardProxyFilterTest, BadConfig) {
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(R"EOF({"foo": "bar"})EOF");
+  EXPECT_THROW(DynamicForwardProxyFilterConfig(*config, "prefix.", stats_store_, cm_,
+                                               dns_resolver_),
+               Json::Exception);
+}
+
+TEST_F(DynamicForwardProxyFilterTest, OtherCluster) {
+  cm_.thread_local_cluster_.cluster_.info_->lb_type_ = Upstream::LoadBalancerType::RoundRobin;
+  EXPECT_CALL(*dns_resolver_, resolve(_, _, _)).Times(0);
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter_->decodeHeaders(request_headers_, false));
+  EXPECT_EQ(0U, stats_store_.counter("prefix.dynamic_forward_proxy.dns_query").value());
+}
+
+TEST_F(DynamicForwardProxyFilterTest, NoRoute) {
+  EXPECT_CALL(filter_callbacks_, route()).WillOnce(Return(nullptr));
+  EXPECT_CALL(*dns_resolver_, resolve(_, _, _)).Times(0);
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter_->decodeHeaders(request_headers_, false));
+}
+
+TEST_F(DynamicForwardProxyFilterTest, Cached) {
+  EXPECT_CALL(*dns_resolver_, resolve("example.com", Network::DnsLookupFamily::V4Only, _))
+      .WillOnce(Invoke([](const std::string&, Network::DnsLookupFamily,
+                          Network::DnsResolver::ResolveCb cb) -> Network::ActiveDnsQuery* {
+        cb(TestUtility::makeDnsResponse({"10.0.0.1"}));
+        return nullptr;
+      }));
+  EXPECT_CALL(filter_callbacks_, continueDecoding()).Times(0);
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter_->decodeHeaders(request_headers_, false));
+
+  Buffer::OwnedImpl data("hello");
+  EXPECT_EQ(FilterDataStatus::Continue, filter_->decodeData(data, false));
+  EXPECT_EQ(FilterTrailersStatus::Continue, filter_->decodeTrailers(request_headers_));
+  EXPECT_EQ(1U, stats_store_.counter("prefix.dynamic_forward_proxy.dns_query").value());
+}
+
+TEST_F(DynamicForwardProxyFilterTest, Resolve) {
+  Network::DnsResolver::ResolveCb resolve_cb;
+  EXPECT_CALL(*dns_resolver_, resolve("example.com", _, _))
+      .WillOnce(DoAll(SaveArg<2>(&resolve_cb), Return(&dns_resolver_->active_query_)));
+  EXPECT_EQ(FilterHeadersStatus::StopIteration, filter_->decodeHeaders(request_headers_, false));
+
+  Buffer::OwnedImpl data("hello");
+  EXPECT_EQ(FilterDataStatus::StopIterationAndBuffer, filter_->decodeData(data, false));
+  EXPECT_EQ(FilterTrailersStatus::StopIteration, filter_->decodeTrailers(request_headers_));
+
+  // A failed resolution lets the router answer the request.
+  EXPECT_CALL(filter_callbacks_, continueDecoding());
+  resolve_cb({});
+  EXPECT_EQ(1U, stats_store_.counter("prefix.dynamic_forward_proxy.dns_query_failure").value());
+
+  EXPECT_CALL(dns_resolver_->active_query_, cancel()).Times(0);
+  filter_->onDestroy();
+}
+
+TEST_F(DynamicForwardProxyFilterTest, Reset) {
+  EXPECT_CALL(*dns_resolver_, resolve("example.com", _, _))
+      .WillOnce(Return(&dns_resolver_->active_query_));
+  EXPECT_EQ(FilterHeadersStatus::StopIteration, filter_->decodeHeaders(request_headers_, true));
+
+  EXPECT_CALL(dns_resolver_->active_query_, cancel());
+  filter_->onDestroy();
+}
+
+} // Http
+} // Envoy
@@ -0,0 +1,242 @@
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/http/filter/gzip_filter.h"
+#include "common/http/header_map_impl.h"
+#include "common/json/json_loader.h"
+#include "common/stats/stats_impl.h"
+
+#include "test/mocks/common.h"
+#include "test/mocks/http/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
+#include "test/test_common/printers.h"
+#include "test/test_common/utility.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "zlib.h"
+
+namespace Envoy {
+using testing::_;
+using testing::Invoke;
+using testing::NiceMock;
+
+namespace Http {
+
+class GzipFilterTest : public testing::Test {
+public:
+  GzipFilterTest() {
+    ON_CALL(time_source_, currentTime()).WillByDefault(Invoke([this]() -> MonotonicTime {
+      time_ += std::chrono::microseconds(10);
+      return time_;
+    }));
+    setup("{}");
+  }
+
+  void setup(const std::string& json) {
+    Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
+    config_.reset(new GzipFilterConfig(*config, "test.", store_, tls_, time_source_));
+  }
+
+  struct TestFilter {
+    TestFilter(GzipFilterConfigSharedPtr config) : filter_(config) {
+      filter_.setDecoderFilterCallbacks(decoder_callbacks_);
+      filter_.setEncoderFilterCallbacks(encoder_callbacks_);
+    }
+
+    ~TestFilter() { filter_.onDestroy(); }
+
+    NiceMock<MockStreamDecoderFilterCallbacks> decoder_callbacks_;
+    NiceMock<MockStreamEncoderFilterCallbacks> encoder_callbacks_;
+    GzipFilter filter_;
+  };
+
+  // Send a response through a filter, one chunk at a time, and return the encoded body.
+  std::string respond(TestFilter& filter, HeaderMap& response_headers,
+                      const std::vector<std::string>& chunks) {
+    EXPECT_EQ(FilterHeadersStatus::Continue, filter.filter_.decodeHeaders(request_headers_, true));
+    EXPECT_EQ(FilterHeadersStatus::Continue,
+              filter.filter_.encodeHeaders(response_headers, chunks.empty()));
+    std::string body;
+    for (size_t i = 0; i < chunks.size(); i++) {
+      Buffer::OwnedImpl data(chunks[i]);
+      EXPECT_EQ(FilterDataStatus::Continue,
+                filter.filter_.encodeData(data, i == chunks.size() - 1));
+      body += TestUtility::bufferToString(data);
+    }
+    return body;
+  }
+
+  static std::string inflate(const std::string& compressed) {
+    z_stream zstream{};
+    EXPECT_EQ(Z_OK, inflateInit2(&zstream, 15 + 16));
+    std::string output(64 * 1024, '\0');
+    zstream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+    zstream.avail_in = compressed.size();
+    zstream.next_out = reinterpret_cast<Bytef*>(&output[0]);
+    zstream.avail_out = output.size();
+    EXPECT_EQ(Z_STREAM_END, ::inflate(&zstream, Z_FINISH));
+    output.resize(zstream.total_out);
+    inflateEnd(&zstream);
+    return output;
+  }
+
+  uint64_t counter(const std::string& name) { return store_.counter("test.gzip." + name).value(); }
+
+  Stats::IsolatedStoreImpl store_;
+  NiceMock<ThreadLocal::MockInstance> tls_;
+  NiceMock<MockMonotonicTimeSource> time_source_;
+  MonotonicTime time_;
+  GzipFilterConfigSharedPtr config_;
+  TestHeaderMapImpl request_headers_{
+      {":method", "GET"}, {":path", "/"}, {"accept-encoding", "deflate, gzip"}};
+  const std::string body_{std::string(1000, 'a') + std::string(1000, 'b')};
+};
+
+TEST_F(GzipFilterTest, BadConfig) {
+  EXPECT_THROW(setup(R"EOF({"compression_level": 10})EOF"), Json::Exception);
+  EXPECT_THROW(setup(R"EOF({"content_types": []})EOF"), Json::Exception);
+  EXPECT_THROW(setup(R"EOF({"unknown": 1})EOF"), Json::Exception);
+}
+
+TEST(GzipFilterAcceptEncodingTest, AcceptsGzip) {
+  EXPECT_TRUE(GzipFilter::acceptsGzip("gzip"));
+  EXPECT_TRUE(GzipFilter::acceptsGzip("deflate, GZIP;q=0.5"));
+  EXPECT_TRUE(GzipFilter::acceptsGzip("*"));
+  EXPECT_TRUE(GzipFilter::acceptsGzip("br, *;q=0.1"));
+  EXPECT_FALSE(GzipFilter::acceptsGzip(""));
+  EXPECT_FALSE(GzipFilter::acceptsGzip("deflate, br"));
+  EXPECT_FALSE(GzipFilter::acceptsGzip("gzip;q=0"));
+  EXPECT_FALSE(GzipFilter::acceptsGzip("gzip; q=0.000, *"));
+  EXPECT_FALSE(GzipFilter::acceptsGzip("*;q=0"));
+  EXPECT_FALSE(GzipFilter::acceptsGzip("gzipped"));
+}
+
+TEST_F(GzipFilterTest, Compress) {
+  TestFilter filter(config_);
+  TestHeaderMapImpl response_headers{{":status", "200"},
+                                     {"content-type", "text/html; charset=utf-8"},
+                                     {"content-length", "2000"},
+                                     {"vary", "Cookie"},
+                                     {"etag", "\"abc\""}};
+  const std::string compressed =
+      respond(filter, response_headers, {body_.substr(0, 500), body_.substr(500)});
+
+  EXPECT_EQ(body_, inflate(compressed));
+  EXPECT_EQ(nullptr, response_headers.ContentLength());
+  EXPECT_STREQ("gzip", response_headers.get_("content-encoding").c_str());
+  EXPECT_STREQ("Cookie, Accept-Encoding", response_headers.get_("vary").c_str());
+  EXPECT_STREQ("W/\"abc\"", response_headers.get_("etag").c_str());
+
+  EXPECT_EQ(1U, counter("compressed"));
+  EXPECT_EQ(0U, counter("not_compressed"));
+  EXPECT_EQ(2000U, counter("total_uncompressed_bytes"));
+  EXPECT_EQ(compressed.size(), counter("total_compressed_bytes"));
+  EXPECT_EQ(20U, counter("compression_time_us"));
+}
+
+TEST_F(GzipFilterTest, CompressWithTrailers) {
+  TestFilter filter(config_);
+  TestHeaderMapImpl response_headers{{":status", "200"}, {"content-type", "application/json"}};
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter.filter_.decodeHeaders(request_headers_, true));
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter.filter_.encodeHeaders(response_headers, false));
+  EXPECT_STREQ("Accept-Encoding", response_headers.get_("vary").c_str());
+
+  Buffer::OwnedImpl data(body_);
+  EXPECT_EQ(FilterDataStatus::Continue, filter.filter_.encodeData(data, false));
+  std::string compressed = TestUtility::bufferToString(data);
+  EXPECT_CALL(filter.encoder_callbacks_, addEncodedData(_))
+      .WillOnce(Invoke([&](Buffer::Instance& trailer_data) -> void {
+        compressed += TestUtility::bufferToString(trailer_data);
+      }));
+  TestHeaderMapImpl trailers{{"grpc-status", "0"}};
+  EXPECT_EQ(FilterTrailersStatus::Continue, filter.filter_.encodeTrailers(trailers));
+  EXPECT_EQ(body_, inflate(compressed));
+}
+
+TEST_F(GzipFilterTest, NotCompressed) {
+  auto expectNotCompressed = [this](TestHeaderMapImpl&& response_headers) -> void {
+    TestFilter filter(config_);
+    EXPECT_EQ(body_, respond(filter, response_headers, {body_}));
+    EXPECT_EQ(nullptr, response_headers.get(Headers::get().Vary));
+  };
+
+  expectNotCompressed({{":status", "200"}, {"content-type", "image/png"}});
+  expectNotCompressed({{":status", "200"}});
+  expectNotCompressed(
+      {{":status", "200"}, {"content-type", "text/html"}, {"content-length", "29"}});
+  expectNotCompressed(
+      {{":status", "200"}, {"content-type", "text/html"}, {"cache-control", "no-transform"}});
+  expectNotCompressed({{":status", "206"}, {"content-type", "text/html"}});
+
+  {
+    TestFilter filter(config_);
+    TestHeaderMapImpl response_headers{
+        {":status", "200"}, {"content-type", "text/html"}, {"content-encoding", "br"}};
+    EXPECT_EQ(body_, respond(filter, response_headers, {body_}));
+    EXPECT_STREQ("br", response_headers.get_("content-encoding").c_str());
+  }
+
+  request_headers_.remove(Headers::get().AcceptEncoding);
+  expectNotCompressed({{":status", "200"}, {"content-type", "text/html"}});
+
+  EXPECT_EQ(7U, counter("not_compressed"));
+  EXPECT_EQ(0U, counter("compressed"));
+  EXPECT_EQ(0U, counter("compressor_allocated"));
+}
+
+TEST_F(GzipFilterTest, CustomContentTypes) {
+  setup(R"EOF({"content_types": ["application/wasm"], "min_content_length": 0})EOF");
+  {
+    TestFilter filter(config_);
+    TestHeaderMapImpl response_headers{{":status", "200"}, {"content-type", "text/html"}};
+    EXPECT_EQ(body_, respond(filter, response_headers, {body_}));
+  }
+
+  TestFilter filter(config_);
+  TestHeaderMapImpl response_headers{
+      {":status", "200"}, {"content-type", "application/wasm"}, {"content-length", "1"}};
+  EXPECT_EQ("a", inflate(respond(filter, response_headers, {"a"})));
+}
+
+TEST_F(GzipFilterTest, CompressorReuse) {
+  for (int i = 0; i < 3; i++) {
+    TestFilter filter(config_);
+    TestHeaderMapImpl response_headers{{":status", "200"}, {"content-type", "text/plain"}};
+    EXPECT_EQ(body_, inflate(respond(filter, response_headers, {body_})));
+  }
+  EXPECT_EQ(1U, counter("compressor_allocated"));
+
+  // A stream that is destroyed part way through still returns its compressor, reset.
+  {
+    TestFilter filter(config_);
+    TestHeaderMapImpl response_headers{{":status", "200"}, {"content-type", "text/plain"}};
+    EXPECT_EQ(FilterHeadersStatus::Continue, filter.filter_.decodeHeaders(request_headers_, true));
+    EXPECT_EQ(FilterHeadersStatus::Continue, filter.filter_.encodeHeaders(response_headers, false));
+    Buffer::OwnedImpl data("partial");
+    EXPECT_EQ(FilterDataStatus::Continue, filter.filter_.encodeData(data, false));
+  }
+
+  // Concurrent streams each need their own compressor.
+  TestFilter filter1(config_);
+  TestFilter filter2(config_);
+  TestHeaderMapImpl response_headers1{{":status", "200"}, {"content-type", "text/plain"}};
+  TestHeaderMapImpl response_headers2{{":status", "200"}, {"content-type", "text/plain"}};
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter1.filter_.decodeHeaders(request_headers_, true));
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter2.filter_.decodeHeaders(request_headers_, true));
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter1.filter_.encodeHeaders(response_headers1, false));
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter2.filter_.encodeHeaders(response_headers2, false));
+  Buffer::OwnedImpl data1(body_);
+  Buffer::OwnedImpl data2("hello");
+  filter1.filter_.encodeData(data1, true);
+  filter2.filter_.encodeData(data2, true);
+  EXPECT_EQ(body_, inflate(TestUtility::bufferToString(data1)));
+  EXPECT_EQ("hello", inflate(TestUtility::bufferToString(data2)));
+  EXPECT_EQ(2U, counter("compressor_allocated"));
+}
+
+} // Http
+} // Envoy
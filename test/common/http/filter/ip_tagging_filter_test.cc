@@ -0,0 +1,170 @@
+#include <memory>
+#include <string>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/http/filter/ip_tagging_filter.h"
+#include "common/http/header_map_impl.h"
+#include "common/http/headers.h"
+#include "common/json/json_loader.h"
+#include "common/stats/stats_impl.h"
+
+#include "test/mocks/http/mocks.h"
+#include "test/test_common/utility.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace Envoy {
+using testing::NiceMock;
+
+namespace Http {
+
+class IpTaggingFilterTest : public testing::Test {
+public:
+  void SetUpTest(const std::string json) {
+    Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
+    config_.reset(new IpTaggingFilterConfig(*config, "prefix.", stats_store_));
+    filter_.reset(new IpTaggingFilter(config_));
+    filter_->setDecoderFilterCallbacks(filter_callbacks_);
+  }
+
+  const std::string internal_request_json_ = R"EOF(
+    {
+      "request_type" : "internal",
+      "ip_tags" : [
+        { "ip_tag_name" : "internal_request",
+          "ip_list" : ["1.2.3.0/24"]
+        }
+      ]
+    }
+  )EOF";
+
+  Stats::IsolatedStoreImpl stats_store_;
+  IpTaggingFilterConfigSharedPtr config_;
+  std::unique_ptr<IpTaggingFilter> filter_;
+  NiceMock<MockStreamDecoderFilterCallbacks> filter_callbacks_;
+};
+
+TEST_F(IpTaggingFilterTest, InternalRequest) {
+  SetUpTest(internal_request_json_);
+  EXPECT_EQ(FilterRequestType::Internal, config_->requestType());
+
+  TestHeaderMapImpl request_headers{{"x-envoy-internal", "true"}};
+  filter_callbacks_.downstream_address_ = "1.2.3.5";
+  EXPECT_CALL(filter_callbacks_, clearRouteCache());
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter_->decodeHeaders(request_headers, false));
+  EXPECT_EQ("internal_request", request_headers.get_(Headers::get().EnvoyIpTags));
+
+  Buffer::OwnedImpl data("hello");
+  EXPECT_EQ(FilterDataStatus::Continue, filter_->decodeData(data, false));
+  EXPECT_EQ(FilterTrailersStatus::Continue, filter_->decodeTrailers(request_headers));
+
+  EXPECT_EQ(1U, stats_store_.counter("prefix.ip_tagging.total").value());
+  EXPECT_EQ(1U, stats_store_.counter("prefix.ip_tagging.hit").value());
+  EXPECT_EQ(0U, stats_store_.counter("prefix.ip_tagging.no_hit").value());
+}
+
+TEST_F(IpTaggingFilterTest, ExternalRequestNotTagged) {
+  SetUpTest(internal_request_json_);
+
+  TestHeaderMapImpl request_headers;
+  filter_callbacks_.downstream_address_ = "1.2.3.5";
+  EXPECT_CALL(filter_callbacks_, clearRouteCache()).Times(0);
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter_->decodeHeaders(request_headers, false));
+  EXPECT_FALSE(request_headers.has(Headers::get().EnvoyIpTags));
+  EXPECT_EQ(0U, stats_store_.counter("prefix.ip_tagging.total").value());
+}
+
+TEST_F(IpTaggingFilterTest, ExternalRequest) {
+  const std::string external_request_json = R"EOF(
+    {
+      "request_type" : "external",
+      "ip_tags" : [
+        { "ip_tag_name" : "external_request",
+          "ip_list" : ["1.2.3.4/32"]
+        }
+      ]
+    }
+  )EOF";
+  SetUpTest(external_request_json);
+  EXPECT_EQ(FilterRequestType::External, config_->requestType());
+
+  TestHeaderMapImpl request_headers;
+  filter_callbacks_.downstream_address_ = "1.2.3.4";
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter_->decodeHeaders(request_headers, false));
+  EXPECT_EQ("external_request", request_headers.get_(Headers::get().EnvoyIpTags));
+
+  TestHeaderMapImpl internal_request_headers{{"x-envoy-internal", "true"}};
+  EXPECT_EQ(FilterHeadersStatus::Continue,
+            filter_->decodeHeaders(internal_request_headers, false));
+  EXPECT_FALSE(internal_request_headers.has(Headers::get().EnvoyIpTags));
+}
+
+TEST_F(IpTaggingFilterTest, MultipleTagsAndIpv6) {
+  const std::string json = R"EOF(
+    {
+      "ip_tags" : [
+        { "ip_tag_name" : "tag_b",
+          "ip_list" : ["1.2.3.0/24", "2001:abcd::/32"]
+        },
+        { "ip_tag_name" : "tag_a",
+          "ip_list" : ["1.2.0.0/16", "2001:abcd:ef01::/48"]
+        }
+      ]
+    }
+  )EOF";
+  SetUpTest(json);
+  EXPECT_EQ(FilterRequestType::Both, config_->requestType());
+
+  {
+    TestHeaderMapImpl request_headers;
+    filter_callbacks_.downstream_address_ = "1.2.3.4";
+    EXPECT_EQ(FilterHeadersStatus::Continue, filter_->decodeHeaders(request_headers, false));
+    EXPECT_EQ("tag_a,tag_b", request_headers.get_(Headers::get().EnvoyIpTags));
+  }
+
+  {
+    TestHeaderMapImpl request_headers{{"x-envoy-internal", "true"}};
+    filter_callbacks_.downstream_address_ = "2001:abcd:1::1";
+    EXPECT_EQ(FilterHeadersStatus::Continue, filter_->decodeHeaders(request_headers, false));
+    EXPECT_EQ("tag_b", request_headers.get_(Headers::get().EnvoyIpTags));
+  }
+
+  EXPECT_EQ(2U, stats_store_.counter("prefix.ip_tagging.hit").value());
+}
+
+TEST_F(IpTaggingFilterTest, NoHit) {
+  SetUpTest(internal_request_json_);
+
+  TestHeaderMapImpl request_headers{{"x-envoy-internal", "true"}};
+  filter_callbacks_.downstream_address_ = "1.2.4.1";
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter_->decodeHeaders(request_headers, false));
+  EXPECT_FALSE(request_headers.has(Headers::get().EnvoyIpTags));
+
+  // A missing or malformed downstream address is never tagged.
+  filter_callbacks_.downstream_address_ = "";
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter_->decodeHeaders(request_headers, false));
+  filter_callbacks_.downstream_address_ = "not_an_address";
+  EXPECT_EQ(FilterHeadersStatus::Continue, filter_->decodeHeaders(request_headers, false));
+  EXPECT_FALSE(request_headers.has(Headers::get().EnvoyIpTags));
+
+  EXPECT_EQ(3U, stats_store_.counter("prefix.ip_tagging.total").value());
+  EXPECT_EQ(3U, stats_store_.counter("prefix.ip_tagging.no_hit").value());
+}
+
+TEST_F(IpTaggingFilterTest, InvalidIpList) {
+  const std::string json = R"EOF(
+    {
+      "ip_tags" : [
+        { "ip_tag_name" : "tag",
+          "ip_list" : ["1.2.3.4"]
+        }
+      ]
+    }
+  )EOF";
+  EXPECT_THROW_WITH_MESSAGE(SetUpTest(json), EnvoyException,
+                            "invalid ip/mask combo '1.2.3.4' in ip tag 'tag'");
+}
+
+} // Http
+} // Envoy
@@ -0,0 +1,99 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/http/header_map_impl.h"
+
+#include "gtest/gtest.h"
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+namespace Http {
+
+/**
+ * This test is for benchmarking only and should not be run as part of unit tests. It measures the
+ * header map operations that every proxied request pays for: building the map as the codec
+ * decodes headers, looking up inline and non-inline headers, iterating, and copying.
+ */
+class DISABLED_HeaderMapImplBenchmark : public testing::Test {
+public:
+  static const uint32_t NumIterations = 1000000;
+
+  DISABLED_HeaderMapImplBenchmark() {
+    for (const auto& header : headers_) {
+      request_headers_.addCopy(header.first, header.second);
+    }
+  }
+
+  template <class Op> void run(const std::string& name, Op op) {
+    uint64_t checksum = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NumIterations; i++) {
+      checksum += op();
+    }
+    std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_NE(0U, checksum);
+    std::cout << fmt::format("{}: {}ns/op", name, elapsed.count() / NumIterations) << std::endl;
+  }
+
+  const std::vector<std::pair<LowerCaseString, std::string>> headers_{
+      {LowerCaseString(":method"), "GET"},
+      {LowerCaseString(":path"), "/api/v1/users/12345?fields=name,email"},
+      {LowerCaseString(":authority"), "api.example.com"},
+      {LowerCaseString(":scheme"), "https"},
+      {LowerCaseString("user-agent"), "Mozilla/5.0 (X11; Linux x86_64)"},
+      {LowerCaseString("accept"), "application/json"},
+      {LowerCaseString("accept-encoding"), "gzip, deflate"},
+      {LowerCaseString("cookie"), "session=0123456789abcdef; theme=dark"},
+      {LowerCaseString("x-forwarded-for"), "10.0.0.1"},
+      {LowerCaseString("x-request-id"), "ba7a2d8c-3ff3-4b7b-a1e7-b1d6f4e4f0d6"},
+      {LowerCaseString("x-custom-tenant"), "tenant-42"},
+      {LowerCaseString("x-custom-trace"), "1"}};
+  HeaderMapImpl request_headers_;
+};
+
+const uint32_t DISABLED_HeaderMapImplBenchmark::NumIterations;
+
+TEST_F(DISABLED_HeaderMapImplBenchmark, Insert) {
+  run("header_map_insert", [this]() -> uint64_t {
+    HeaderMapImpl headers;
+    for (const auto& header : headers_) {
+      headers.addCopy(header.first, header.second);
+    }
+    return headers.size();
+  });
+}
+
+TEST_F(DISABLED_HeaderMapImplBenchmark, Lookup) {
+  const LowerCaseString custom_header("x-custom-trace");
+  run("header_map_lookup_inline",
+      [this]() -> uint64_t { return request_headers_.Host()->value().size(); });
+  run("header_map_lookup_custom",
+      [&]() -> uint64_t { return request_headers_.get(custom_header)->value().size(); });
+}
+
+TEST_F(DISABLED_HeaderMapImplBenchmark, Iterate) {
+  run("header_map_iterate", [this]() -> uint64_t {
+    uint64_t size = 0;
+    request_headers_.iterate(
+        [](const HeaderEntry& header, void* context) -> void {
+          *static_cast<uint64_t*>(context) += header.value().size();
+        },
+        &size);
+    return size;
+  });
+}
+
+TEST_F(DISABLED_HeaderMapImplBenchmark, Copy) {
+  const HeaderMap& request_headers = request_headers_;
+  run("header_map_copy", [&]() -> uint64_t {
+    HeaderMapImpl copy(request_headers);
+    return copy.size();
+  });
+}
+
+} // Http
+} // Envoy
@@ -1,4 +1,5 @@
 #include <string>
+#include <vector>
 
 #include "common/http/header_map_impl.h"
 
@@ -238,6 +239,233 @@ TEST(HeaderStringTest, All) {
     EXPECT_EQ(9U, string.size());
     EXPECT_EQ(HeaderString::Type::Dynamic, string.type());
   }
+
+  // Copy static and inline
+  {
+    std::string static_string("HELLO");
+    HeaderString string1(static_string);
+    HeaderString string2;
+    string2.setCopy(string1);
+    EXPECT_EQ(HeaderString::Type::Inline, string2.type());
+    EXPECT_STREQ("HELLO", string2.c_str());
+
+    HeaderString string3;
+    string3.setCopy(string2);
+    EXPECT_EQ(HeaderString::Type::Inline, string3.type());
+    EXPECT_NE(string2.c_str(), string3.c_str());
+    EXPECT_STREQ("HELLO", string3.c_str());
+  }
+
+  // Copy dynamic shares storage until either copy is modified.
+  {
+    std::string large(4096, 'a');
+    HeaderString string1;
+    string1.setCopy(large.c_str(), large.size());
+    HeaderString string2;
+    string2.setCopy(string1);
+    HeaderString string3;
+    string3.setCopy(string1);
+    EXPECT_EQ(HeaderString::Type::Dynamic, string2.type());
+    EXPECT_EQ(string1.c_str(), string2.c_str());
+    EXPECT_EQ(string1.c_str(), string3.c_str());
+    EXPECT_EQ(4096U, string2.size());
+
+    string2.append("b", 1);
+    EXPECT_NE(string1.c_str(), string2.c_str());
+    EXPECT_EQ(large + "b", string2.c_str());
+    EXPECT_EQ(large, string1.c_str());
+
+    string3.buffer()[0] = 'b';
+    EXPECT_NE(string1.c_str(), string3.c_str());
+    EXPECT_EQ('b', string3.c_str()[0]);
+    EXPECT_EQ(large, string1.c_str());
+
+    string3.setCopy(string1);
+    string3.setCopy(string1.c_str() + 1, 4000);
+    EXPECT_EQ(large.substr(1, 4000), string3.c_str());
+    EXPECT_EQ(large, string1.c_str());
+
+    string3.setCopy(string1);
+    string3.setInteger(5);
+    EXPECT_STREQ("5", string3.c_str());
+    EXPECT_EQ(large, string1.c_str());
+
+    string3.setCopy(string1);
+    string3.clear();
+    EXPECT_TRUE(string3.empty());
+    EXPECT_EQ(large, string1.c_str());
+
+    // Moving a shared string moves its share.
+    string3.setCopy(string1);
+    HeaderString string4(std::move(string3));
+    EXPECT_EQ(string1.c_str(), string4.c_str());
+    string1.append("c", 1);
+    EXPECT_EQ(large, string4.c_str());
+    EXPECT_EQ(large + "c", string1.c_str());
+  }
+
+  // Set reference, from inline and from dynamic.
+  {
+    std::string ref_string("HELLO");
+    HeaderString string;
+    string.setReference(ref_string);
+    EXPECT_EQ(HeaderString::Type::Static, string.type());
+    EXPECT_EQ(ref_string.c_str(), string.c_str());
+    EXPECT_EQ(5U, string.size());
+
+    std::string large(4096, 'a');
+    string.setCopy(large.c_str(), large.size());
+    EXPECT_EQ(HeaderString::Type::Dynamic, string.type());
+    EXPECT_STREQ("HELLO", ref_string.c_str());
+    string.setReference(ref_string);
+    EXPECT_EQ(ref_string.c_str(), string.c_str());
+
+    // Modifying the string copies the reference first.
+    string.buffer()[0] = 'J';
+    EXPECT_EQ(HeaderString::Type::Inline, string.type());
+    EXPECT_STREQ("JELLO", string.c_str());
+    EXPECT_EQ("HELLO", ref_string);
+  }
+}
+
+TEST(HeaderStringTest, CountedReference) {
+  static const HeaderString::ReleaseCb release = [](void* context) -> void {
+    --*static_cast<uint32_t*>(context);
+  };
+  const std::string data("hello");
+  uint32_t references = 0;
+  auto reference = [&](HeaderString& string) -> void {
+    references++;
+    string.setReference(data.c_str(), data.size(), release, &references);
+  };
+
+  // Destroying the string gives back the reference.
+  {
+    HeaderString string;
+    reference(string);
+    EXPECT_EQ(HeaderString::Type::Reference, string.type());
+    EXPECT_EQ(data.c_str(), string.c_str());
+    EXPECT_EQ(5U, string.size());
+    EXPECT_EQ(1U, references);
+  }
+  EXPECT_EQ(0U, references);
+
+  // Moving moves the reference.
+  {
+    HeaderString string;
+    reference(string);
+    HeaderString string2(std::move(string));
+    EXPECT_EQ(HeaderString::Type::Inline, string.type());
+    EXPECT_TRUE(string.empty());
+    EXPECT_EQ(data.c_str(), string2.c_str());
+    EXPECT_EQ(1U, references);
+  }
+  EXPECT_EQ(0U, references);
+
+  // Modifying the string copies the data and gives back the reference.
+  {
+    HeaderString string;
+    reference(string);
+    string.append(" world", 6);
+    EXPECT_EQ(0U, references);
+    EXPECT_STREQ("hello world", string.c_str());
+
+    reference(string);
+    string.buffer()[0] = 'j';
+    EXPECT_EQ(0U, references);
+    EXPECT_STREQ("jello", string.c_str());
+    EXPECT_EQ("hello", data);
+
+    // Copying from the referenced data itself works.
+    reference(string);
+    string.setCopy(string.c_str() + 1, 3);
+    EXPECT_EQ(0U, references);
+    EXPECT_STREQ("ell", string.c_str());
+  }
+
+  // Overwriting the string gives back the reference.
+  {
+    HeaderString string;
+    reference(string);
+    string.clear();
+    EXPECT_EQ(0U, references);
+    EXPECT_TRUE(string.empty());
+
+    reference(string);
+    string.setInteger(5);
+    EXPECT_EQ(0U, references);
+    EXPECT_STREQ("5", string.c_str());
+
+    reference(string);
+    std::string large(4096, 'a');
+    HeaderString dynamic;
+    dynamic.setCopy(large.c_str(), large.size());
+    string.setCopy(dynamic);
+    EXPECT_EQ(0U, references);
+    EXPECT_EQ(large, string.c_str());
+
+    reference(string);
+    reference(string);
+    EXPECT_EQ(1U, references);
+    string.setReference(data);
+    EXPECT_EQ(0U, references);
+  }
+
+  // Copies of the string copy the data.
+  {
+    HeaderString string;
+    reference(string);
+    HeaderString copy;
+    copy.setCopy(string);
+    EXPECT_EQ(HeaderString::Type::Inline, copy.type());
+    EXPECT_STREQ("hello", copy.c_str());
+    EXPECT_EQ(1U, references);
+  }
+  EXPECT_EQ(0U, references);
+}
+
+TEST(HeaderMapImplTest, Copy) {
+  const std::string cookie(1024, 'c');
+  const std::string user_agent(1024, 'u');
+  HeaderMapImpl headers{{Headers::get().UserAgent, user_agent},
+                        {LowerCaseString("cookie"), cookie}};
+  const LowerCaseString static_key("static");
+  const std::string static_value("value");
+  headers.addStatic(static_key, static_value);
+  HeaderMapImpl copy(static_cast<const HeaderMap&>(headers));
+  EXPECT_TRUE(copy == headers);
+  EXPECT_EQ(headers.get(LowerCaseString("cookie"))->value().c_str(),
+            copy.get(LowerCaseString("cookie"))->value().c_str());
+  EXPECT_EQ(headers.UserAgent()->value().c_str(), copy.UserAgent()->value().c_str());
+  EXPECT_EQ(HeaderString::Type::Inline, copy.get(LowerCaseString("static"))->value().type());
+
+  copy.UserAgent()->value().append("v", 1);
+  EXPECT_EQ(user_agent + "v", copy.UserAgent()->value().c_str());
+  EXPECT_EQ(user_agent, headers.UserAgent()->value().c_str());
+  headers.remove(LowerCaseString("cookie"));
+  EXPECT_EQ(cookie, copy.get(LowerCaseString("cookie"))->value().c_str());
+}
+
+TEST(HeaderMapImplTest, InternedValues) {
+  HeaderMapImpl headers;
+  HeaderString key;
+  key.setCopy("content-type", 12);
+  HeaderString value;
+  value.setCopy("application/grpc", 16);
+  headers.addViaMove(std::move(key), std::move(value));
+  EXPECT_EQ(HeaderString::Type::Static, headers.ContentType()->value().type());
+  EXPECT_EQ(Headers::get().ContentTypeValues.Grpc.c_str(), headers.ContentType()->value().c_str());
+
+  // Changing an interned value does not change the interned string.
+  headers.ContentType()->value().buffer()[0] = 'A';
+  EXPECT_STREQ("Application/grpc", headers.ContentType()->value().c_str());
+  EXPECT_EQ("application/grpc", Headers::get().ContentTypeValues.Grpc);
+
+  // Other values and headers are copied.
+  HeaderMapImpl headers2{{Headers::get().ContentType, "application/grpc+proto"},
+                         {Headers::get().Path, "GET"}};
+  EXPECT_EQ(HeaderString::Type::Inline, headers2.ContentType()->value().type());
+  EXPECT_EQ(HeaderString::Type::Inline, headers2.Path()->value().type());
 }
 
 TEST(HeaderMapImplTest, InlineInsert) {
@@ -299,6 +527,19 @@ TEST(HeaderMapImplTest, DoubleInlineAdd) {
   EXPECT_EQ(1UL, headers.size());
 }
 
+TEST(HeaderMapImplTest, AddCopy) {
+  HeaderMapImpl headers;
+  {
+    LowerCaseString key("hello");
+    headers.addCopy(key, std::string("world"));
+    LowerCaseString inline_key(":status");
+    headers.addCopy(inline_key, std::string("200"));
+  }
+  EXPECT_STREQ("world", headers.get(LowerCaseString("hello"))->value().c_str());
+  EXPECT_STREQ("200", headers.Status()->value().c_str());
+  EXPECT_EQ(2UL, headers.size());
+}
+
 TEST(HeaderMapImplTest, Equality) {
   TestHeaderMapImpl headers1;
   TestHeaderMapImpl headers2;
@@ -319,5 +560,82 @@ TEST(HeaderMapImplTest, LargeCharInHeader) {
   EXPECT_STREQ("value", headers.get(static_key)->value().c_str());
 }
 
+TEST(HeaderMapImplTest, StaticLookupSameBucket) {
+  // These keys have the same length and last character so they hash to the same bucket.
+  TestHeaderMapImpl headers{{"x-request-id", "a"}, {"x-b3-sampled", "b"}, {"x-b3-samplee", "c"}};
+  EXPECT_STREQ("a", headers.RequestId()->value().c_str());
+  EXPECT_STREQ("b", headers.XB3Sampled()->value().c_str());
+  EXPECT_STREQ("c", headers.get(LowerCaseString("x-b3-samplee"))->value().c_str());
+
+  headers.remove(Headers::get().RequestId);
+  EXPECT_EQ(nullptr, headers.RequestId());
+  EXPECT_NE(nullptr, headers.XB3Sampled());
+  EXPECT_EQ(2UL, headers.size());
+}
+
+TEST(HeaderMapImplTest, HostLegacyMapsToAuthority) {
+  TestHeaderMapImpl headers{{"host", "example.com"}};
+  EXPECT_STREQ("example.com", headers.Host()->value().c_str());
+  EXPECT_STREQ(":authority", headers.Host()->key().c_str());
+}
+
+TEST(HeaderEntryFreeListTest, ReusesBlocks) {
+  HeaderEntryFreeList free_list;
+  void* block1 = free_list.allocate(64);
+  void* block2 = free_list.allocate(64);
+  EXPECT_EQ(0UL, free_list.size());
+
+  free_list.deallocate(block1, 64);
+  free_list.deallocate(block2, 64);
+  EXPECT_EQ(2UL, free_list.size());
+
+  // Blocks are reused in LIFO order so that recently freed memory is likely still hot in cache.
+  EXPECT_EQ(block2, free_list.allocate(64));
+  EXPECT_EQ(block1, free_list.allocate(64));
+  EXPECT_EQ(0UL, free_list.size());
+
+  free_list.deallocate(block1, 64);
+  free_list.deallocate(block2, 64);
+}
+
+TEST(HeaderEntryFreeListTest, Bounded) {
+  HeaderEntryFreeList free_list;
+  std::vector<void*> blocks;
+  for (size_t i = 0; i < HeaderEntryFreeList::MaxCachedBlocks + 10; i++) {
+    blocks.push_back(free_list.allocate(64));
+  }
+  for (void* block : blocks) {
+    free_list.deallocate(block, 64);
+  }
+  EXPECT_EQ(HeaderEntryFreeList::MaxCachedBlocks, free_list.size());
+}
+
+TEST(HeaderEntryFreeListTest, Release) {
+  HeaderEntryFreeList free_list;
+  free_list.deallocate(free_list.allocate(64), 64);
+  EXPECT_EQ(1UL, free_list.size());
+
+  free_list.release();
+  EXPECT_EQ(0UL, free_list.size());
+
+  // The list keeps caching blocks after a release.
+  free_list.deallocate(free_list.allocate(64), 64);
+  EXPECT_EQ(1UL, free_list.size());
+}
+
+TEST(HeaderMapImplTest, EntriesRecycledAcrossMaps) {
+  size_t cached;
+  {
+    TestHeaderMapImpl headers{{"hello", "world"}, {":path", "/"}};
+    EXPECT_EQ(2UL, headers.size());
+    cached = HeaderEntryFreeList::threadLocal().size();
+  }
+  EXPECT_EQ(cached + 2, HeaderEntryFreeList::threadLocal().size());
+
+  TestHeaderMapImpl headers{{"foo", "bar"}};
+  EXPECT_EQ(cached + 1, HeaderEntryFreeList::threadLocal().size());
+  EXPECT_STREQ("bar", headers.get(LowerCaseString("foo"))->value().c_str());
+}
+
 } // Http
 } // Envoy
@@ -7,6 +7,7 @@
 #include "common/http/exception.h"
 #include "common/http/header_map_impl.h"
 #include "common/http/http1/codec_impl.h"
+#include "common/http/http1/raw_header_block.h"
 
 #include "test/mocks/buffer/mocks.h"
 #include "test/mocks/http/mocks.h"
@@ -28,8 +29,45 @@ namespace Http1 {
 
 class Http1ServerConnectionImplTest : public ::testing::Test {
 public:
-  Http1ServerConnectionImplTest() : codec_(new ServerConnectionImpl(connection_, callbacks_)) {}
-
+  Http1ServerConnectionImplTest() { initialize(); }
+
+  void initialize() {
+    codec_.reset(new ServerConnectionImpl(connection_, callbacks_, limits_, http1_settings_));
+  }
+
+  /**
+   * Decode a request without a body and return its headers.
+   */
+  HeaderMapPtr decodeRequest(const std::string& request) {
+    Http::MockStreamDecoder decoder;
+    EXPECT_CALL(callbacks_, newStream(_)).WillOnce(ReturnRef(decoder));
+    HeaderMapPtr headers;
+    EXPECT_CALL(decoder, decodeHeaders_(_, true))
+        .WillOnce(Invoke(
+            [&](HeaderMapPtr& decoded, bool) -> void { headers = std::move(decoded); }));
+
+    Buffer::OwnedImpl buffer(request);
+    codec_->dispatch(buffer);
+    return headers;
+  }
+
+  /**
+   * Encode a request through an HTTP/1.1 client connection and return what it writes.
+   */
+  std::string forwardRequest(const HeaderMap& headers) {
+    NiceMock<Network::MockConnection> upstream_connection;
+    NiceMock<Http::MockConnectionCallbacks> upstream_callbacks;
+    ClientConnectionImpl upstream_codec(upstream_connection, upstream_callbacks);
+    std::string output;
+    ON_CALL(upstream_connection, write(_)).WillByDefault(AddBufferToString(&output));
+
+    Http::MockStreamDecoder response_decoder;
+    upstream_codec.newStream(response_decoder).encodeHeaders(headers, true);
+    return output;
+  }
+
+  HeaderLimits limits_;
+  Http1Settings http1_settings_;
   NiceMock<Network::MockConnection> connection_;
   NiceMock<Http::MockServerConnectionCallbacks> callbacks_;
   Http::ServerConnectionPtr codec_;
@@ -104,6 +142,33 @@ TEST_F(Http1ServerConnectionImplTest, BadRequestStartedStream) {
   EXPECT_EQ("HTTP/1.1 400 Bad Request\r\ncontent-length: 0\r\nconnection: close\r\n\r\n", output);
 }
 
+TEST_F(Http1ServerConnectionImplTest, HeaderLimits) {
+  limits_.max_bytes_ = 64;
+  limits_.max_count_ = 3;
+  initialize();
+
+  std::string output;
+  ON_CALL(connection_, write(_)).WillByDefault(AddBufferToString(&output));
+  Http::MockStreamDecoder decoder;
+  EXPECT_CALL(callbacks_, newStream(_)).WillRepeatedly(ReturnRef(decoder));
+
+  EXPECT_CALL(decoder, decodeHeaders_(_, true));
+  Buffer::OwnedImpl buffer("GET / HTTP/1.1\r\nA: " + std::string(50, 'a') +
+                           "\r\nB: b\r\nC: c\r\n\r\n");
+  codec_->dispatch(buffer);
+
+  // A request is rejected as soon as the header which exceeds a limit has been parsed.
+  initialize();
+  Buffer::OwnedImpl too_large("GET / HTTP/1.1\r\nA: " + std::string(64, 'a') + "\r\n");
+  EXPECT_THROW(codec_->dispatch(too_large), CodecProtocolException);
+  EXPECT_EQ("HTTP/1.1 400 Bad Request\r\ncontent-length: 0\r\nconnection: close\r\n\r\n",
+            output);
+
+  initialize();
+  Buffer::OwnedImpl too_many("GET / HTTP/1.1\r\nA: a\r\nB: b\r\nC: c\r\nD: d\r\n");
+  EXPECT_THROW(codec_->dispatch(too_many), CodecProtocolException);
+}
+
 TEST_F(Http1ServerConnectionImplTest, HostHeaderTranslation) {
   InSequence sequence;
 
@@ -118,6 +183,47 @@ TEST_F(Http1ServerConnectionImplTest, HostHeaderTranslation) {
   EXPECT_EQ(0U, buffer.length());
 }
 
+TEST_F(Http1ServerConnectionImplTest, ForwardRawHeaders) {
+  http1_settings_.forward_raw_headers_ = true;
+  initialize();
+
+  const std::string long_value(300, 'a');
+  HeaderMapPtr headers = decodeRequest("GET /x HTTP/1.1\r\nHost: h\r\nUser-Agent: curl\r\n"
+                                       "X-Long: " +
+                                       long_value + "\r\n\r\n");
+  EXPECT_NE(nullptr, RawHeaderBlock::fromValue(headers->Host()->value()));
+  EXPECT_NE(nullptr, RawHeaderBlock::fromValue(headers->UserAgent()->value()));
+  EXPECT_EQ(long_value, headers->get(LowerCaseString("x-long"))->value().c_str());
+  EXPECT_EQ(nullptr, RawHeaderBlock::fromValue(headers->Path()->value()));
+
+  // Added headers are encoded after the block.
+  headers->addCopy(LowerCaseString("x-request-id"), "1");
+  EXPECT_EQ("GET /x HTTP/1.1\r\nhost: h\r\nuser-agent: curl\r\nx-long: " + long_value +
+                "\r\nx-request-id: 1\r\ncontent-length: 0\r\n\r\n",
+            forwardRequest(*headers));
+}
+
+TEST_F(Http1ServerConnectionImplTest, ForwardRawHeadersModified) {
+  http1_settings_.forward_raw_headers_ = true;
+  initialize();
+
+  HeaderMapPtr headers = decodeRequest(
+      "GET /x HTTP/1.1\r\nHost: h\r\nUser-Agent: curl\r\nX-Custom: value\r\n\r\n");
+
+  // Modifying a value gives back its reference to the block.
+  headers->Host()->value(std::string("other"));
+  EXPECT_EQ(nullptr, RawHeaderBlock::fromValue(headers->Host()->value()));
+  headers->removeUserAgent();
+  EXPECT_EQ("GET /x HTTP/1.1\r\nhost: other\r\nx-custom: value\r\ncontent-length: 0\r\n\r\n",
+            forwardRequest(*headers));
+
+  // Interned values and headers that the codec removes do not leave the block in use.
+  initialize();
+  headers = decodeRequest("GET /y HTTP/1.1\r\nExpect: 100-continue\r\nTE: trailers\r\n\r\n");
+  EXPECT_EQ("GET /y HTTP/1.1\r\nte: trailers\r\ncontent-length: 0\r\n\r\n",
+            forwardRequest(*headers));
+}
+
 TEST_F(Http1ServerConnectionImplTest, CloseDuringHeadersComplete) {
   InSequence sequence;
 
@@ -176,6 +282,33 @@ TEST_F(Http1ServerConnectionImplTest, HeaderOnlyResponse) {
   EXPECT_EQ("HTTP/1.1 200 OK\r\ncontent-length: 0\r\n\r\n", output);
 }
 
+TEST_F(Http1ServerConnectionImplTest, StatusLines) {
+  EXPECT_EQ("HTTP/1.1 100 Continue\r\n", *ResponseStreamEncoderImpl::statusLine(100));
+  EXPECT_EQ("HTTP/1.1 503 Service Unavailable\r\n", *ResponseStreamEncoderImpl::statusLine(503));
+  EXPECT_EQ("HTTP/1.1 599 Unknown\r\n", *ResponseStreamEncoderImpl::statusLine(599));
+  EXPECT_EQ(nullptr, ResponseStreamEncoderImpl::statusLine(99));
+  EXPECT_EQ(nullptr, ResponseStreamEncoderImpl::statusLine(600));
+
+  NiceMock<Http::MockStreamDecoder> decoder;
+  Http::StreamEncoder* response_encoder = nullptr;
+  EXPECT_CALL(callbacks_, newStream(_))
+      .WillOnce(Invoke([&](Http::StreamEncoder& encoder) -> Http::StreamDecoder& {
+        response_encoder = &encoder;
+        return decoder;
+      }));
+
+  Buffer::OwnedImpl buffer("GET / HTTP/1.1\r\n\r\n");
+  codec_->dispatch(buffer);
+
+  std::string output;
+  ON_CALL(connection_, write(_)).WillByDefault(AddBufferToString(&output));
+
+  // Statuses without a precomputed line are still serialized.
+  TestHeaderMapImpl headers{{":status", "600"}};
+  response_encoder->encodeHeaders(headers, true);
+  EXPECT_EQ("HTTP/1.1 600 Unknown\r\ncontent-length: 0\r\n\r\n", output);
+}
+
 TEST_F(Http1ServerConnectionImplTest, ChunkedResponse) {
   NiceMock<Http::MockStreamDecoder> decoder;
   Http::StreamEncoder* response_encoder = nullptr;
@@ -350,6 +483,51 @@ TEST_F(Http1ClientConnectionImplTest, Reset) {
   request_encoder.getStream().resetStream(StreamResetReason::LocalReset);
 }
 
+TEST_F(Http1ClientConnectionImplTest, PipelinedResponses) {
+  NiceMock<Http::MockStreamDecoder> response_decoder1;
+  Http::StreamEncoder& request_encoder1 = codec_->newStream(response_decoder1);
+  request_encoder1.encodeHeaders(
+      TestHeaderMapImpl{{":method", "HEAD"}, {":path", "/"}, {":authority", "host"}}, true);
+
+  NiceMock<Http::MockStreamDecoder> response_decoder2;
+  Http::StreamEncoder& request_encoder2 = codec_->newStream(response_decoder2);
+  request_encoder2.encodeHeaders(
+      TestHeaderMapImpl{{":method", "GET"}, {":path", "/"}, {":authority", "host"}}, true);
+
+  // Responses are matched to the requests in order, each with its own HEAD state.
+  InSequence s;
+  EXPECT_CALL(response_decoder1, decodeHeaders_(_, true));
+  EXPECT_CALL(response_decoder2, decodeHeaders_(_, false));
+  EXPECT_CALL(response_decoder2, decodeData(BufferStringEqual("hello"), false));
+  EXPECT_CALL(response_decoder2, decodeData(BufferStringEqual(""), true));
+  Buffer::OwnedImpl response("HTTP/1.1 200 OK\r\nContent-Length: 20\r\n\r\n"
+                             "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello");
+  codec_->dispatch(response);
+}
+
+TEST_F(Http1ClientConnectionImplTest, PipelinedReset) {
+  NiceMock<Http::MockStreamDecoder> response_decoder1;
+  Http::StreamEncoder& request_encoder1 = codec_->newStream(response_decoder1);
+  request_encoder1.encodeHeaders(TestHeaderMapImpl{{":method", "GET"}, {":path", "/"}}, true);
+  NiceMock<Http::MockStreamDecoder> response_decoder2;
+  Http::StreamEncoder& request_encoder2 = codec_->newStream(response_decoder2);
+  request_encoder2.encodeHeaders(TestHeaderMapImpl{{":method", "GET"}, {":path", "/"}}, true);
+
+  // Resetting one pipelined request resets them all, and resetting the others again while that is
+  // in progress is harmless.
+  Http::MockStreamCallbacks callbacks1;
+  Http::MockStreamCallbacks callbacks2;
+  request_encoder1.getStream().addCallbacks(callbacks1);
+  request_encoder2.getStream().addCallbacks(callbacks2);
+  InSequence s;
+  EXPECT_CALL(callbacks1, onResetStream(StreamResetReason::LocalReset))
+      .WillOnce(Invoke([&](StreamResetReason) -> void {
+        request_encoder2.getStream().resetStream(StreamResetReason::LocalReset);
+      }));
+  EXPECT_CALL(callbacks2, onResetStream(StreamResetReason::LocalReset));
+  request_encoder1.getStream().resetStream(StreamResetReason::LocalReset);
+}
+
 TEST_F(Http1ClientConnectionImplTest, MultipleHeaderOnlyThenNoContentLength) {
   Http::MockStreamDecoder response_decoder;
   Http::StreamEncoder* request_encoder = &codec_->newStream(response_decoder);
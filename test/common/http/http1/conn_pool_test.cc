@@ -38,10 +38,10 @@ namespace Http1 {
  */
 class ConnPoolImplForTest : public ConnPoolImpl {
 public:
-  ConnPoolImplForTest(Event::MockDispatcher& dispatcher,
+  ConnPoolImplForTest(Event::MockDispatcher& dispatcher, Runtime::RandomGenerator& random,
                       Upstream::ClusterInfoConstSharedPtr cluster)
       : ConnPoolImpl(
-            dispatcher,
+            dispatcher, random,
             Upstream::HostSharedPtr{new Upstream::HostImpl(
                 cluster, "", Network::Utility::resolveUrl("tcp://127.0.0.1:9000"), false, 1, "")},
             Upstream::ResourcePriority::Default),
@@ -104,7 +104,7 @@ public:
  */
 class Http1ConnPoolImplTest : public testing::Test {
 public:
-  Http1ConnPoolImplTest() : conn_pool_(dispatcher_, cluster_) {}
+  Http1ConnPoolImplTest() : conn_pool_(dispatcher_, random_, cluster_) {}
 
   ~Http1ConnPoolImplTest() {
     // Make sure all gauges are 0.
@@ -114,6 +114,7 @@ public:
   }
 
   NiceMock<Event::MockDispatcher> dispatcher_;
+  NiceMock<Runtime::MockRandomGenerator> random_;
   std::shared_ptr<Upstream::MockClusterInfo> cluster_{new NiceMock<Upstream::MockClusterInfo>()};
   ConnPoolImplForTest conn_pool_;
   NiceMock<Runtime::MockLoader> runtime_;
@@ -495,6 +496,55 @@ TEST_F(Http1ConnPoolImplTest, MaxRequestsPerConnection) {
   EXPECT_EQ(1U, cluster_->stats_.upstream_cx_max_requests_.value());
 }
 
+/**
+ * Test that the jitter lowers the maximum requests of a connection.
+ */
+TEST_F(Http1ConnPoolImplTest, MaxRequestsPerConnectionJitter) {
+  cluster_->max_requests_per_connection_ = 4;
+  cluster_->max_requests_per_connection_jitter_percent_ = 50;
+  // The jitter is up to 2 requests, and 5 % 3 takes all of it.
+  EXPECT_CALL(random_, random()).WillOnce(Return(5));
+
+  ActiveTestRequest r1(*this, 0, ActiveTestRequest::Type::CreateConnection);
+  r1.startRequest();
+  r1.completeResponse(false);
+
+  ActiveTestRequest r2(*this, 0, ActiveTestRequest::Type::Immediate);
+  r2.startRequest();
+  EXPECT_CALL(conn_pool_, onClientDestroy());
+  r2.completeResponse(false);
+  dispatcher_.clearDeferredDeleteList();
+
+  EXPECT_EQ(1U, cluster_->stats_.upstream_cx_max_requests_.value());
+}
+
+/**
+ * Test that connections are closed once they have been idle for the idle timeout.
+ */
+TEST_F(Http1ConnPoolImplTest, IdleTimeout) {
+  cluster_->idle_timeout_.value(std::chrono::milliseconds(1000));
+  // The connect timer is created first, and the newest timer expectation matches first.
+  Event::MockTimer* idle_timer = new NiceMock<Event::MockTimer>(&dispatcher_);
+
+  ActiveTestRequest r1(*this, 0, ActiveTestRequest::Type::CreateConnection);
+  r1.startRequest();
+  EXPECT_CALL(*idle_timer, enableTimer(std::chrono::milliseconds(1000)));
+  r1.completeResponse(false);
+
+  // A request takes the connection out of the ready list, and puts it back when it completes.
+  EXPECT_CALL(*idle_timer, disableTimer());
+  ActiveTestRequest r2(*this, 0, ActiveTestRequest::Type::Immediate);
+  r2.startRequest();
+  EXPECT_CALL(*idle_timer, enableTimer(std::chrono::milliseconds(1000)));
+  r2.completeResponse(false);
+
+  EXPECT_CALL(conn_pool_, onClientDestroy());
+  idle_timer->callback_();
+  dispatcher_.clearDeferredDeleteList();
+
+  EXPECT_EQ(1U, cluster_->stats_.upstream_cx_idle_timeout_.value());
+}
+
 TEST_F(Http1ConnPoolImplTest, ConcurrentConnections) {
   InSequence s;
 
@@ -580,6 +630,188 @@ TEST_F(Http1ConnPoolImplTest, RemoteCloseToCompleteResponse) {
   dispatcher_.clearDeferredDeleteList();
 }
 
+/**
+ * Test that connections are opened ahead of demand when a prefetch ratio is configured.
+ */
+TEST_F(Http1ConnPoolImplTest, Prefetch) {
+  cluster_->prefetch_ratio_ = 2.0;
+
+  // The first request opens a second connection as well.
+  conn_pool_.expectClientCreate();
+  conn_pool_.expectClientCreate();
+  ActiveTestRequest r1(*this, 0, ActiveTestRequest::Type::Pending);
+  r1.expectNewStream();
+  EXPECT_CALL(*conn_pool_.test_clients_[0].connect_timer_, disableTimer());
+  conn_pool_.test_clients_[0].connection_->raiseEvents(Network::ConnectionEvent::Connected);
+  EXPECT_CALL(*conn_pool_.test_clients_[1].connect_timer_, disableTimer());
+  conn_pool_.test_clients_[1].connection_->raiseEvents(Network::ConnectionEvent::Connected);
+  EXPECT_EQ(2U, cluster_->stats_.upstream_cx_total_.value());
+  EXPECT_EQ(1U, cluster_->stats_.upstream_cx_prefetch_.value());
+  EXPECT_EQ(0U, cluster_->stats_.upstream_rq_prefetch_hit_.value());
+
+  // The second request uses the prefetched connection and two more connections are opened to
+  // keep up with two active requests.
+  conn_pool_.expectClientCreate();
+  conn_pool_.expectClientCreate();
+  ActiveTestRequest r2(*this, 1, ActiveTestRequest::Type::Immediate);
+  EXPECT_EQ(4U, cluster_->stats_.upstream_cx_total_.value());
+  EXPECT_EQ(3U, cluster_->stats_.upstream_cx_prefetch_.value());
+  EXPECT_EQ(1U, cluster_->stats_.upstream_rq_prefetch_hit_.value());
+
+  r1.startRequest();
+  r1.completeResponse(false);
+  r2.startRequest();
+  r2.completeResponse(false);
+
+  // Requests on a connection that has been used before are not counted as hits.
+  ActiveTestRequest r3(*this, 1, ActiveTestRequest::Type::Immediate);
+  EXPECT_EQ(1U, cluster_->stats_.upstream_rq_prefetch_hit_.value());
+  r3.startRequest();
+  r3.completeResponse(false);
+
+  std::vector<Network::MockClientConnection*> connections;
+  for (const ConnPoolImplForTest::TestCodecClient& client : conn_pool_.test_clients_) {
+    connections.push_back(client.connection_);
+  }
+  EXPECT_CALL(conn_pool_, onClientDestroy()).Times(4);
+  for (Network::MockClientConnection* connection : connections) {
+    connection->raiseEvents(Network::ConnectionEvent::RemoteClose);
+  }
+  dispatcher_.clearDeferredDeleteList();
+}
+
+/**
+ * Test that warming opens a single connection.
+ */
+TEST_F(Http1ConnPoolImplTest, Warm) {
+  conn_pool_.expectClientCreate();
+  conn_pool_.warm();
+  conn_pool_.warm();
+  EXPECT_EQ(1U, cluster_->stats_.upstream_cx_prefetch_.value());
+
+  EXPECT_CALL(*conn_pool_.test_clients_[0].connect_timer_, disableTimer());
+  conn_pool_.test_clients_[0].connection_->raiseEvents(Network::ConnectionEvent::Connected);
+
+  ActiveTestRequest r1(*this, 0, ActiveTestRequest::Type::Immediate);
+  EXPECT_EQ(1U, cluster_->stats_.upstream_rq_prefetch_hit_.value());
+  r1.startRequest();
+  r1.completeResponse(false);
+
+  EXPECT_CALL(conn_pool_, onClientDestroy());
+  conn_pool_.test_clients_[0].connection_->raiseEvents(Network::ConnectionEvent::RemoteClose);
+  dispatcher_.clearDeferredDeleteList();
+}
+
+/**
+ * Test that requests are pipelined once the request before them has been sent, up to the pipeline
+ * depth.
+ */
+TEST_F(Http1ConnPoolImplTest, Pipelining) {
+  InSequence s;
+
+  cluster_->http1_pipeline_depth_ = 2;
+  cluster_->resource_manager_.reset(
+      new Upstream::ResourceManagerImpl(runtime_, "fake_key", 1, 1024, 1024, 1));
+
+  // r2 cannot follow r1 before r1 has been sent, so it waits.
+  ActiveTestRequest r1(*this, 0, ActiveTestRequest::Type::CreateConnection);
+  ActiveTestRequest r2(*this, 0, ActiveTestRequest::Type::Pending);
+  r2.expectNewStream();
+  r1.startRequest();
+  EXPECT_EQ(1U, cluster_->stats_.upstream_rq_pipelined_.value());
+  r2.startRequest();
+
+  // The connection is full, so r3 waits until r1's response frees up a slot.
+  ActiveTestRequest r3(*this, 0, ActiveTestRequest::Type::Pending);
+  r3.expectNewStream();
+  r1.completeResponse(false);
+  EXPECT_EQ(2U, cluster_->stats_.upstream_rq_pipelined_.value());
+  r3.startRequest();
+
+  r2.completeResponse(true);
+  r3.completeResponse(false);
+
+  // An idle connection is used without pipelining.
+  ActiveTestRequest r4(*this, 0, ActiveTestRequest::Type::Immediate);
+  r4.startRequest();
+  r4.completeResponse(false);
+  EXPECT_EQ(2U, cluster_->stats_.upstream_rq_pipelined_.value());
+  EXPECT_EQ(1U, cluster_->stats_.upstream_cx_total_.value());
+
+  EXPECT_CALL(conn_pool_, onClientDestroy());
+  conn_pool_.test_clients_[0].connection_->raiseEvents(Network::ConnectionEvent::RemoteClose);
+  dispatcher_.clearDeferredDeleteList();
+}
+
+/**
+ * Test that a request is pipelined on the connection with the fewest requests in flight instead
+ * of opening a new connection.
+ */
+TEST_F(Http1ConnPoolImplTest, PipeliningPrefersExistingConnection) {
+  InSequence s;
+
+  cluster_->http1_pipeline_depth_ = 3;
+
+  ActiveTestRequest r1(*this, 0, ActiveTestRequest::Type::CreateConnection);
+  r1.startRequest();
+  ActiveTestRequest r2(*this, 0, ActiveTestRequest::Type::Immediate);
+  r2.startRequest();
+  EXPECT_EQ(1U, cluster_->stats_.upstream_rq_pipelined_.value());
+  EXPECT_EQ(1U, cluster_->stats_.upstream_cx_total_.value());
+
+  r1.completeResponse(false);
+  r2.completeResponse(false);
+
+  EXPECT_CALL(conn_pool_, onClientDestroy());
+  conn_pool_.test_clients_[0].connection_->raiseEvents(Network::ConnectionEvent::RemoteClose);
+  dispatcher_.clearDeferredDeleteList();
+}
+
+/**
+ * Test that the pool stops pipelining once a connection is lost with requests queued behind
+ * another one.
+ */
+TEST_F(Http1ConnPoolImplTest, PipeliningDisabledOnRemoteClose) {
+  InSequence s;
+
+  cluster_->http1_pipeline_depth_ = 2;
+  cluster_->resource_manager_.reset(
+      new Upstream::ResourceManagerImpl(runtime_, "fake_key", 1, 1024, 1024, 1));
+
+  ActiveTestRequest r1(*this, 0, ActiveTestRequest::Type::CreateConnection);
+  ActiveTestRequest r2(*this, 0, ActiveTestRequest::Type::Pending);
+  r2.expectNewStream();
+  r1.startRequest();
+  r2.startRequest();
+
+  // Both requests are reset with the connection.
+  Http::MockStreamCallbacks stream_callbacks1;
+  Http::MockStreamCallbacks stream_callbacks2;
+  r1.request_encoder_.getStream().addCallbacks(stream_callbacks1);
+  r2.request_encoder_.getStream().addCallbacks(stream_callbacks2);
+  EXPECT_CALL(stream_callbacks2, onResetStream(StreamResetReason::ConnectionTermination));
+  EXPECT_CALL(stream_callbacks1, onResetStream(StreamResetReason::ConnectionTermination));
+  EXPECT_CALL(conn_pool_, onClientDestroy());
+  conn_pool_.test_clients_[0].connection_->raiseEvents(Network::ConnectionEvent::RemoteClose);
+  dispatcher_.clearDeferredDeleteList();
+  EXPECT_EQ(1U, cluster_->stats_.upstream_cx_pipeline_disabled_.value());
+  EXPECT_EQ(1U, cluster_->stats_.upstream_cx_destroy_with_active_rq_.value());
+
+  // r4 waits for r3's response rather than being pipelined.
+  ActiveTestRequest r3(*this, 0, ActiveTestRequest::Type::CreateConnection);
+  r3.startRequest();
+  ActiveTestRequest r4(*this, 0, ActiveTestRequest::Type::Pending);
+  r4.expectNewStream();
+  r3.completeResponse(false);
+  r4.startRequest();
+  r4.completeResponse(false);
+  EXPECT_EQ(1U, cluster_->stats_.upstream_rq_pipelined_.value());
+
+  EXPECT_CALL(conn_pool_, onClientDestroy());
+  conn_pool_.test_clients_[0].connection_->raiseEvents(Network::ConnectionEvent::RemoteClose);
+  dispatcher_.clearDeferredDeleteList();
+}
+
 } // Http1
 } // Http
 } // Envoy
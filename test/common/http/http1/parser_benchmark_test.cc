@@ -0,0 +1,151 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include "common/http/http1/parser.h"
+
+#include "gtest/gtest.h"
+#include "http_parser.h"
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+namespace Http {
+namespace Http1 {
+
+/**
+ * This test is for benchmarking only and should not be run as part of unit tests. It compares
+ * http_parser with Http1::Parser on pipelined requests. Both variants copy the url and the header
+ * names and values, which is what the codec does with them.
+ */
+class DISABLED_Http1ParserBenchmark : public testing::Test {
+public:
+  static const uint32_t NumBuffers = 2000;
+  static const uint32_t RequestsPerBuffer = 16;
+
+  struct HttpParserState {
+    std::string url_;
+    std::string field_;
+    std::string value_;
+    uint64_t headers_{};
+    uint64_t messages_{};
+    bool in_value_{};
+  };
+
+  struct Callbacks : public ParserCallbacks {
+    // Http1::ParserCallbacks
+    void onMessageBegin() override {}
+    void onUrl(const char* data, size_t length) override { url_.assign(data, length); }
+    void onHeader(const char* name, size_t name_length, const char* value,
+                  size_t value_length) override {
+      field_.assign(name, name_length);
+      value_.assign(value, value_length);
+      headers_++;
+    }
+    bool onHeadersComplete() override { return false; }
+    void onBody(const char*, size_t) override {}
+    void onMessageComplete() override { messages_++; }
+
+    std::string url_;
+    std::string field_;
+    std::string value_;
+    uint64_t headers_{};
+    uint64_t messages_{};
+  };
+
+  static void completeHeader(HttpParserState& state) {
+    if (state.in_value_) {
+      state.headers_++;
+      state.field_.clear();
+      state.value_.clear();
+      state.in_value_ = false;
+    }
+  }
+
+  static std::string request() {
+    return "GET /api/v1/resources/12345?expand=true&fields=name,owner HTTP/1.1\r\n"
+           "Host: service.example.com\r\n"
+           "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko)\r\n"
+           "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+           "Accept-Language: en-US,en;q=0.5\r\n"
+           "Accept-Encoding: gzip, deflate\r\n"
+           "Cookie: session=0123456789abcdef0123456789abcdef; theme=dark; locale=en\r\n"
+           "X-Request-Id: 3e4d5c6b-7a89-4b0c-9d1e-2f3a4b5c6d7e\r\n"
+           "X-Forwarded-For: 10.0.0.1, 10.0.0.2\r\n"
+           "Connection: keep-alive\r\n\r\n";
+  }
+
+  void runHttpParser(const std::string& input) {
+    http_parser_settings settings{};
+    settings.on_url = [](http_parser* parser, const char* at, size_t length) -> int {
+      static_cast<HttpParserState*>(parser->data)->url_.append(at, length);
+      return 0;
+    };
+    settings.on_header_field = [](http_parser* parser, const char* at, size_t length) -> int {
+      HttpParserState& state = *static_cast<HttpParserState*>(parser->data);
+      completeHeader(state);
+      state.field_.append(at, length);
+      return 0;
+    };
+    settings.on_header_value = [](http_parser* parser, const char* at, size_t length) -> int {
+      HttpParserState& state = *static_cast<HttpParserState*>(parser->data);
+      state.in_value_ = true;
+      state.value_.append(at, length);
+      return 0;
+    };
+    settings.on_headers_complete = [](http_parser* parser) -> int {
+      HttpParserState& state = *static_cast<HttpParserState*>(parser->data);
+      completeHeader(state);
+      state.url_.clear();
+      return 0;
+    };
+    settings.on_message_complete = [](http_parser* parser) -> int {
+      static_cast<HttpParserState*>(parser->data)->messages_++;
+      return 0;
+    };
+
+    HttpParserState state;
+    http_parser parser;
+    http_parser_init(&parser, HTTP_REQUEST);
+    parser.data = &state;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NumBuffers; i++) {
+      EXPECT_EQ(input.size(), http_parser_execute(&parser, &settings, input.data(), input.size()));
+    }
+    report("http_parser", start, input.size(), state.messages_, state.headers_);
+  }
+
+  void runParser(const std::string& input) {
+    Callbacks callbacks;
+    Parser parser(Parser::Type::Request, callbacks, HeaderLimits());
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NumBuffers; i++) {
+      EXPECT_EQ(input.size(), parser.execute(input.data(), input.size()));
+    }
+    report("Http1::Parser", start, input.size(), callbacks.messages_, callbacks.headers_);
+  }
+
+  void report(const std::string& name, std::chrono::steady_clock::time_point start,
+              uint64_t buffer_size, uint64_t messages, uint64_t headers) {
+    std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_EQ(static_cast<uint64_t>(NumBuffers) * RequestsPerBuffer, messages);
+    EXPECT_EQ(messages * 9, headers);
+    std::cout << fmt::format("{}: {}ns/request {:.0f}MB/s", name, elapsed.count() / messages,
+                             1000.0 * NumBuffers * buffer_size / elapsed.count())
+              << std::endl;
+  }
+};
+
+TEST_F(DISABLED_Http1ParserBenchmark, PipelinedRequests) {
+  std::string input;
+  for (uint32_t i = 0; i < RequestsPerBuffer; i++) {
+    input += request();
+  }
+
+  runHttpParser(input);
+  runParser(input);
+}
+
+} // Http1
+} // Http
+} // Envoy
@@ -0,0 +1,373 @@
+#include <string>
+#include <vector>
+
+#include "common/http/http1/parser.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Http {
+namespace Http1 {
+
+/**
+ * Records every parser event as a string so that tests can compare the whole event sequence.
+ */
+class RecordingCallbacks : public ParserCallbacks {
+public:
+  // Http1::ParserCallbacks
+  void onMessageBegin() override { events_.push_back("begin"); }
+  void onUrl(const char* data, size_t length) override {
+    events_.push_back("url=" + std::string(data, length));
+  }
+  void onHeader(const char* name, size_t name_length, const char* value,
+                size_t value_length) override {
+    events_.push_back(std::string(name, name_length) + ":" + std::string(value, value_length));
+  }
+  bool onHeadersComplete() override {
+    events_.push_back("headers");
+    if (pause_on_headers_) {
+      parser_->pause(true);
+    }
+    return skip_body_;
+  }
+  void onBody(const char* data, size_t length) override { body_.append(data, length); }
+  void onMessageComplete() override {
+    if (!body_.empty()) {
+      events_.push_back("body=" + body_);
+      body_.clear();
+    }
+    events_.push_back("complete");
+    if (pause_on_complete_) {
+      parser_->pause(true);
+    }
+  }
+
+  Parser* parser_{};
+  std::vector<std::string> events_;
+  std::string body_;
+  bool skip_body_{};
+  bool pause_on_headers_{};
+  bool pause_on_complete_{};
+};
+
+class Http1ParserTest : public testing::Test {
+public:
+  void setup(Parser::Type type, const HeaderLimits& header_limits = HeaderLimits()) {
+    parser_.reset(new Parser(type, callbacks_, header_limits));
+    callbacks_.parser_ = parser_.get();
+    callbacks_.events_.clear();
+  }
+
+  // Parse the input split into chunks of the given size, as if it arrived in separate reads.
+  void parse(const std::string& input, size_t chunk_size = 0) {
+    if (chunk_size == 0) {
+      chunk_size = input.size();
+    }
+    for (size_t i = 0; i < input.size(); i += chunk_size) {
+      const std::string chunk = input.substr(i, chunk_size);
+      EXPECT_EQ(chunk.size(), parser_->execute(chunk.data(), chunk.size()));
+      ASSERT_EQ(Parser::Error::None, parser_->error()) << Parser::errorName(parser_->error());
+    }
+  }
+
+  Parser::Error parseError(const std::string& input) {
+    parser_->execute(input.data(), input.size());
+    return parser_->error();
+  }
+
+  RecordingCallbacks callbacks_;
+  std::unique_ptr<Parser> parser_;
+};
+
+TEST_F(Http1ParserTest, SimpleRequest) {
+  const std::string request = "GET /hello?a=b HTTP/1.1\r\nHost: example.com\r\n"
+                              "X-Empty:\r\nX-Spaces: \t value with spaces \t\r\n\r\n";
+  const std::vector<std::string> expected{"begin",    "url=/hello?a=b",
+                                          "Host:example.com",
+                                          "X-Empty:", "X-Spaces:value with spaces",
+                                          "headers",  "complete"};
+
+  // The result does not depend on how the input is split.
+  for (size_t chunk_size : {0, 1, 2, 3, 7, 16}) {
+    setup(Parser::Type::Request);
+    parse(request, chunk_size);
+    EXPECT_EQ(expected, callbacks_.events_) << chunk_size;
+    EXPECT_EQ("GET", parser_->method());
+    EXPECT_EQ(1U, parser_->httpMajor());
+    EXPECT_EQ(1U, parser_->httpMinor());
+  }
+}
+
+TEST_F(Http1ParserTest, BareLineFeeds) {
+  setup(Parser::Type::Request);
+  parse("GET / HTTP/1.0\nA: b\n\n");
+  EXPECT_EQ((std::vector<std::string>{"begin", "url=/", "A:b", "headers", "complete"}),
+            callbacks_.events_);
+  EXPECT_EQ(0U, parser_->httpMinor());
+}
+
+TEST_F(Http1ParserTest, ContentLengthBody) {
+  for (size_t chunk_size : {0, 1, 5}) {
+    setup(Parser::Type::Request);
+    parse("POST / HTTP/1.1\r\ncontent-length: 11\r\n\r\nhello world", chunk_size);
+    EXPECT_EQ((std::vector<std::string>{"begin", "url=/", "content-length:11", "headers",
+                                        "body=hello world", "complete"}),
+              callbacks_.events_);
+    EXPECT_EQ(11U, parser_->contentLength().value());
+    EXPECT_FALSE(parser_->chunked());
+  }
+}
+
+TEST_F(Http1ParserTest, ChunkedBody) {
+  for (size_t chunk_size : {0, 1, 4}) {
+    setup(Parser::Type::Request);
+    parse("POST / HTTP/1.1\r\nTransfer-Encoding: gzip, Chunked\r\n\r\n"
+          "5;ext=1\r\nhello\r\n6 \r\n world\r\n0\r\nTrailer: ignored\r\n\r\n",
+          chunk_size);
+    EXPECT_EQ((std::vector<std::string>{"begin", "url=/", "Transfer-Encoding:gzip, Chunked",
+                                        "headers", "body=hello world", "complete"}),
+              callbacks_.events_);
+    EXPECT_TRUE(parser_->chunked());
+    EXPECT_FALSE(parser_->contentLength().valid());
+  }
+}
+
+TEST_F(Http1ParserTest, PipelinedRequests) {
+  const std::string requests = "GET /a HTTP/1.1\r\n\r\n\r\n"
+                               "POST /b HTTP/1.1\r\ncontent-length: 1\r\n\r\nx"
+                               "PUT /c HTTP/1.1\r\ntransfer-encoding: chunked\r\n\r\n"
+                               "2\r\nyz\r\n0\r\n\r\nGET /d HTTP/1.1\r\n\r\n";
+  const std::vector<std::string> expected{
+      "begin",   "url=/a",  "headers",  "complete", "begin",  "url=/b",  "content-length:1",
+      "headers", "body=x",  "complete", "begin",    "url=/c", "transfer-encoding:chunked",
+      "headers", "body=yz", "complete", "begin",    "url=/d", "headers", "complete"};
+
+  for (size_t chunk_size = 0; chunk_size <= requests.size(); chunk_size++) {
+    setup(Parser::Type::Request);
+    parse(requests, chunk_size);
+    EXPECT_EQ(expected, callbacks_.events_) << chunk_size;
+  }
+}
+
+TEST_F(Http1ParserTest, PauseOnMessageComplete) {
+  setup(Parser::Type::Request);
+  callbacks_.pause_on_complete_ = true;
+  const std::string first = "GET /a HTTP/1.1\r\n\r\n";
+  const std::string input = first + "GET /b HTTP/1.1\r\n\r\n";
+  EXPECT_EQ(first.size(), parser_->execute(input.data(), input.size()));
+  EXPECT_EQ(0U, parser_->execute(input.data() + first.size(), input.size() - first.size()));
+  EXPECT_EQ(4U, callbacks_.events_.size());
+
+  parser_->pause(false);
+  EXPECT_EQ(input.size() - first.size(),
+            parser_->execute(input.data() + first.size(), input.size() - first.size()));
+  EXPECT_EQ(8U, callbacks_.events_.size());
+}
+
+TEST_F(Http1ParserTest, PauseOnHeadersComplete) {
+  setup(Parser::Type::Request);
+  callbacks_.pause_on_headers_ = true;
+  const std::string head = "GET / HTTP/1.1\r\n\r\n";
+  EXPECT_EQ(head.size(), parser_->execute(head.data(), head.size()));
+  EXPECT_EQ((std::vector<std::string>{"begin", "url=/", "headers"}), callbacks_.events_);
+
+  // The body-less message is completed when parsing resumes.
+  callbacks_.pause_on_headers_ = false;
+  parser_->pause(false);
+  EXPECT_EQ(0U, parser_->execute(head.data(), 0));
+  EXPECT_EQ("complete", callbacks_.events_.back());
+}
+
+TEST_F(Http1ParserTest, Responses) {
+  setup(Parser::Type::Response);
+  parse("HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nokHTTP/1.1 204 No Content\r\n"
+        "Content-Length: 10\r\n\r\nHTTP/1.1 304\r\n\r\n");
+  EXPECT_EQ((std::vector<std::string>{"begin", "Content-Length:2", "headers", "body=ok",
+                                      "complete", "begin", "Content-Length:10", "headers",
+                                      "complete", "begin", "headers", "complete"}),
+            callbacks_.events_);
+  EXPECT_EQ(304U, parser_->statusCode());
+}
+
+TEST_F(Http1ParserTest, ResponseSkipBody) {
+  setup(Parser::Type::Response);
+  callbacks_.skip_body_ = true;
+  parse("HTTP/1.1 200 OK\r\nContent-Length: 20\r\n\r\n");
+  EXPECT_EQ("complete", callbacks_.events_.back());
+}
+
+TEST_F(Http1ParserTest, ResponseUntilEof) {
+  setup(Parser::Type::Response);
+  parse("HTTP/1.1 200 OK\r\n\r\nhello", 3);
+  EXPECT_EQ("headers", callbacks_.events_.back());
+  EXPECT_EQ(0U, parser_->execute(nullptr, 0));
+  EXPECT_EQ("complete", callbacks_.events_.back());
+  EXPECT_EQ("body=hello", callbacks_.events_[callbacks_.events_.size() - 2]);
+
+  // Nothing can follow the end of the connection.
+  EXPECT_EQ(Parser::Error::ClosedConnection, parseError("HTTP/1.1 200 OK\r\n\r\n"));
+}
+
+TEST_F(Http1ParserTest, ConnectionClose) {
+  setup(Parser::Type::Request);
+  parse("GET / HTTP/1.1\r\nConnection: foo, Close\r\n\r\n\r\n");
+  EXPECT_EQ(Parser::Error::ClosedConnection, parseError("GET / HTTP/1.1\r\n\r\n"));
+
+  // HTTP/1.0 connections are only reused when asked for.
+  setup(Parser::Type::Request);
+  parse("GET / HTTP/1.0\r\nConnection: keep-alive\r\n\r\nGET / HTTP/1.0\r\n\r\n");
+  EXPECT_EQ(Parser::Error::ClosedConnection, parseError("GET / HTTP/1.0\r\n\r\n"));
+}
+
+TEST_F(Http1ParserTest, Eof) {
+  setup(Parser::Type::Request);
+  EXPECT_EQ(0U, parser_->execute(nullptr, 0));
+  EXPECT_EQ(Parser::Error::None, parser_->error());
+
+  parse("POST / HTTP/1.1\r\ncontent-length: 5\r\n\r\nab");
+  parser_->execute(nullptr, 0);
+  EXPECT_EQ(Parser::Error::InvalidEofState, parser_->error());
+}
+
+TEST_F(Http1ParserTest, InvalidMethod) {
+  // Bad methods are found as soon as the bad byte arrives.
+  setup(Parser::Type::Request);
+  EXPECT_EQ(Parser::Error::InvalidMethod, parseError("bad"));
+  EXPECT_TRUE(callbacks_.events_.empty());
+
+  setup(Parser::Type::Request);
+  parse("G");
+  EXPECT_EQ((std::vector<std::string>{"begin"}), callbacks_.events_);
+  EXPECT_EQ(Parser::Error::InvalidMethod, parseError("g"));
+
+  setup(Parser::Type::Request);
+  EXPECT_EQ(Parser::Error::InvalidMethod, parseError(std::string(33, 'A')));
+
+  setup(Parser::Type::Request);
+  EXPECT_EQ(Parser::Error::InvalidMethod, parseError("GET\r\n"));
+
+  // Errors are sticky.
+  EXPECT_EQ(0U, parser_->execute("GET / HTTP/1.1\r\n\r\n", 18));
+}
+
+TEST_F(Http1ParserTest, InvalidStartLine) {
+  const std::vector<std::pair<std::string, Parser::Error>> requests{
+      {"GET  / HTTP/1.1\r\n", Parser::Error::InvalidUrl},
+      {"GET /\x01 HTTP/1.1\r\n", Parser::Error::InvalidUrl},
+      {"GET /\r\n", Parser::Error::InvalidUrl},
+      {"GET / HTTP/1.1 \r\n", Parser::Error::InvalidVersion},
+      {"GET / HTTPS/1.1\r\n", Parser::Error::InvalidVersion},
+      {"GET / HTTP/a.1\r\n", Parser::Error::InvalidVersion}};
+  for (const auto& request : requests) {
+    setup(Parser::Type::Request);
+    EXPECT_EQ(request.second, parseError(request.first)) << request.first;
+  }
+
+  const std::vector<std::pair<std::string, Parser::Error>> responses{
+      {"XTTP/1.1 200 OK\r\n", Parser::Error::InvalidVersion},
+      {"HTTX", Parser::Error::InvalidVersion},
+      {"HTTP/1.1 20 OK\r\n", Parser::Error::InvalidStatus},
+      {"HTTP/1.1 2000\r\n", Parser::Error::InvalidStatus},
+      {"HTTP/1.1 2x0 OK\r\n", Parser::Error::InvalidStatus}};
+  for (const auto& response : responses) {
+    setup(Parser::Type::Response);
+    EXPECT_EQ(response.second, parseError(response.first)) << response.first;
+  }
+}
+
+TEST_F(Http1ParserTest, InvalidHeaders) {
+  const std::vector<std::pair<std::string, Parser::Error>> headers{
+      {"Host : a\r\n", Parser::Error::InvalidHeaderToken},
+      {": a\r\n", Parser::Error::InvalidHeaderToken},
+      {"Host\r\n", Parser::Error::InvalidHeaderToken},
+      {" folded\r\n", Parser::Error::InvalidHeaderToken},
+      {"A: 0123456789\x01\r\n", Parser::Error::InvalidHeaderValue},
+      {"A: b\rc\r\n", Parser::Error::InvalidHeaderValue},
+      {"A: b\x7f\r\n", Parser::Error::InvalidHeaderValue},
+      {"Content-Length: 1x\r\n", Parser::Error::InvalidContentLength},
+      {"Content-Length:\r\n", Parser::Error::InvalidContentLength},
+      {"Content-Length: 99999999999999999999\r\n", Parser::Error::InvalidContentLength},
+      {"Content-Length: 1\r\nContent-Length: 2\r\n", Parser::Error::UnexpectedContentLength},
+      {"Content-Length: 1\r\nTransfer-Encoding: chunked\r\n\r\n",
+       Parser::Error::UnexpectedContentLength}};
+  for (const auto& header : headers) {
+    setup(Parser::Type::Request);
+    EXPECT_EQ(header.second, parseError("GET / HTTP/1.1\r\n" + header.first)) << header.first;
+  }
+
+  // Tabs and bytes with the high bit set are allowed in values.
+  setup(Parser::Type::Request);
+  parse("GET / HTTP/1.1\r\nA: b\tc\xff\xfe 0123456789\t\r\nContent-Length: 0\r\n"
+        "Content-Length: 0\r\n\r\n");
+  EXPECT_EQ("A:b\tc\xff\xfe 0123456789", callbacks_.events_[2]);
+}
+
+TEST_F(Http1ParserTest, InvalidChunks) {
+  const std::vector<std::string> chunks{"x\r\n", "\r\n", "5 x\r\n", "1\r\nab\r\n",
+                                        "10000000000000000\r\n"};
+  for (const std::string& chunk : chunks) {
+    setup(Parser::Type::Request);
+    EXPECT_EQ(Parser::Error::InvalidChunkSize,
+              parseError("POST / HTTP/1.1\r\ntransfer-encoding: chunked\r\n\r\n" + chunk))
+        << chunk;
+  }
+}
+
+TEST_F(Http1ParserTest, HeaderOverflow) {
+  const std::string large_header = "A: " + std::string(Parser::MaxHeadSize, 'a') + "\r\n";
+  setup(Parser::Type::Request);
+  EXPECT_EQ(Parser::Error::HeaderOverflow, parseError("GET / HTTP/1.1\r\n" + large_header));
+
+  // The limit also applies when the head arrives in pieces.
+  setup(Parser::Type::Request);
+  parse("GET / HTTP/1.1\r\n");
+  const std::string header = "A: " + std::string(1024, 'a') + "\r\n";
+  size_t parsed = 0;
+  while (parser_->error() == Parser::Error::None && parsed < Parser::MaxHeadSize) {
+    parser_->execute(header.data(), header.size());
+    parsed += header.size();
+  }
+  EXPECT_EQ(Parser::Error::HeaderOverflow, parser_->error());
+
+  // Trailers have their own limit.
+  setup(Parser::Type::Request);
+  EXPECT_EQ(Parser::Error::HeaderOverflow,
+            parseError("POST / HTTP/1.1\r\ntransfer-encoding: chunked\r\n\r\n0\r\n" +
+                       large_header));
+}
+
+TEST_F(Http1ParserTest, HeaderLimits) {
+  HeaderLimits header_limits;
+  header_limits.max_bytes_ = 16;
+  header_limits.max_count_ = 2;
+
+  // Names and values count towards the size, but not the separators or the start line.
+  setup(Parser::Type::Request, header_limits);
+  parse("GET /" + std::string(100, 'a') + " HTTP/1.1\r\nAbc: defgh\r\nIj:   klm  \r\n\r\n");
+  EXPECT_EQ("complete", callbacks_.events_.back());
+
+  setup(Parser::Type::Request, header_limits);
+  EXPECT_EQ(Parser::Error::HeaderOverflow,
+            parseError("GET / HTTP/1.1\r\nAbc: defgh\r\nIj: klmnopqr\r\n\r\n"));
+
+  setup(Parser::Type::Request, header_limits);
+  EXPECT_EQ(Parser::Error::TooManyHeaders,
+            parseError("GET / HTTP/1.1\r\nA: b\r\nC: d\r\nE: f\r\n\r\n"));
+
+  // The limits are enforced before the end of the headers has arrived, and apply to each message.
+  setup(Parser::Type::Request, header_limits);
+  parse("GET / HTTP/1.1\r\nA: b\r\nC: d\r\n\r\n");
+  EXPECT_EQ(Parser::Error::TooManyHeaders,
+            parseError("GET / HTTP/1.1\r\nA: b\r\nC: d\r\nE: f\r\n"));
+}
+
+TEST_F(Http1ParserTest, ErrorNames) {
+  EXPECT_STREQ("OK", Parser::errorName(Parser::Error::None));
+  EXPECT_STREQ("INVALID_METHOD", Parser::errorName(Parser::Error::InvalidMethod));
+  EXPECT_STREQ("TOO_MANY_HEADERS", Parser::errorName(Parser::Error::TooManyHeaders));
+  EXPECT_STREQ("CLOSED_CONNECTION", Parser::errorName(Parser::Error::ClosedConnection));
+}
+
+} // Http1
+} // Http
+} // Envoy
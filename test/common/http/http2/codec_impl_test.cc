@@ -22,6 +22,7 @@ using testing::AtLeast;
 using testing::InSequence;
 using testing::Invoke;
 using testing::NiceMock;
+using testing::ReturnRef;
 
 namespace Http {
 namespace Http2 {
@@ -62,7 +63,8 @@ public:
       : client_http2settings_(Http2SettingsFromTuple(::testing::get<0>(GetParam()))),
         client_(client_connection_, client_callbacks_, stats_store_, client_http2settings_),
         server_http2settings_(Http2SettingsFromTuple(::testing::get<1>(GetParam()))),
-        server_(server_connection_, server_callbacks_, stats_store_, server_http2settings_),
+        server_(server_connection_, server_callbacks_, stats_store_, server_http2settings_,
+                HeaderLimits()),
         request_encoder_(client_.newStream(response_decoder_)) {
     setupDefaultConnectionMocks();
 
@@ -280,6 +282,183 @@ INSTANTIATE_TEST_CASE_P(Http2CodecImplTestDefaultSettings, Http2CodecImplTest,
 INSTANTIATE_TEST_CASE_P(Http2CodecImplTestEdgeSettings, Http2CodecImplTest,
                         ::testing::Combine(HTTP2SETTINGS_EDGE_COMBIME, HTTP2SETTINGS_EDGE_COMBIME));
 
+TEST(Http2CodecHpackTest, NeverIndexHeadersAndCompressionStats) {
+  Stats::IsolatedStoreImpl client_stats;
+  Stats::IsolatedStoreImpl server_stats;
+  Http2Settings client_settings;
+  client_settings.hpack_never_index_headers_.emplace_back("Authorization");
+  Http2Settings server_settings;
+
+  NiceMock<Network::MockConnection> client_connection;
+  MockConnectionCallbacks client_callbacks;
+  ClientConnectionImpl client(client_connection, client_callbacks, client_stats, client_settings);
+  Http2CodecImplTest::ConnectionWrapper client_wrapper;
+  NiceMock<Network::MockConnection> server_connection;
+  NiceMock<MockServerConnectionCallbacks> server_callbacks;
+  ServerConnectionImpl server(server_connection, server_callbacks, server_stats, server_settings,
+                              HeaderLimits());
+  Http2CodecImplTest::ConnectionWrapper server_wrapper;
+
+  ON_CALL(client_connection, write(_))
+      .WillByDefault(
+          Invoke([&](Buffer::Instance& data) -> void { server_wrapper.dispatch(data, server); }));
+  ON_CALL(server_connection, write(_))
+      .WillByDefault(
+          Invoke([&](Buffer::Instance& data) -> void { client_wrapper.dispatch(data, client); }));
+  NiceMock<MockStreamDecoder> request_decoder;
+  ON_CALL(server_callbacks, newStream(_)).WillByDefault(ReturnRef(request_decoder));
+
+  Stats::Counter& uncompressed = client_stats.counter("http2.tx_headers_uncompressed_bytes");
+  Stats::Counter& compressed = client_stats.counter("http2.tx_headers_compressed_bytes");
+
+  TestHeaderMapImpl request_headers{{"authorization", std::string(100, 'a')},
+                                    {"x-custom", std::string(100, 'b')}};
+  HttpTestUtility::addDefaultHeaders(request_headers);
+  NiceMock<MockStreamDecoder> response_decoder;
+  client.newStream(response_decoder).encodeHeaders(request_headers, true);
+  const uint64_t first_uncompressed = uncompressed.value();
+  const uint64_t first_compressed = compressed.value();
+  EXPECT_LT(first_compressed, first_uncompressed);
+
+  // The second time around x-custom is a reference into the dynamic table but authorization is
+  // still sent as a literal.
+  client.newStream(response_decoder).encodeHeaders(request_headers, true);
+  EXPECT_EQ(2 * first_uncompressed, uncompressed.value());
+  const uint64_t second_compressed = compressed.value() - first_compressed;
+  EXPECT_LT(second_compressed, first_compressed);
+  EXPECT_GT(second_compressed, 50U);
+}
+
+TEST(Http2CodecWindowTest, WindowAutotuning) {
+  Stats::IsolatedStoreImpl client_stats;
+  Stats::IsolatedStoreImpl server_stats;
+  Http2Settings client_settings;
+  client_settings.initial_stream_window_size_ = Http2Settings::MIN_INITIAL_STREAM_WINDOW_SIZE;
+  client_settings.initial_connection_window_size_ =
+      Http2Settings::MIN_INITIAL_CONNECTION_WINDOW_SIZE;
+  client_settings.window_autotuning_ = true;
+  Http2Settings server_settings;
+
+  NiceMock<Network::MockConnection> client_connection;
+  MockConnectionCallbacks client_callbacks;
+  ClientConnectionImpl client(client_connection, client_callbacks, client_stats, client_settings);
+  Http2CodecImplTest::ConnectionWrapper client_wrapper;
+  NiceMock<Network::MockConnection> server_connection;
+  NiceMock<MockServerConnectionCallbacks> server_callbacks;
+  ServerConnectionImpl server(server_connection, server_callbacks, server_stats, server_settings,
+                              HeaderLimits());
+  Http2CodecImplTest::ConnectionWrapper server_wrapper;
+
+  ON_CALL(client_connection, write(_))
+      .WillByDefault(
+          Invoke([&](Buffer::Instance& data) -> void { server_wrapper.dispatch(data, server); }));
+  ON_CALL(server_connection, write(_))
+      .WillByDefault(
+          Invoke([&](Buffer::Instance& data) -> void { client_wrapper.dispatch(data, client); }));
+  NiceMock<MockStreamDecoder> request_decoder;
+  StreamEncoder* response_encoder{};
+  ON_CALL(server_callbacks, newStream(_))
+      .WillByDefault(Invoke([&](StreamEncoder& encoder) -> StreamDecoder& {
+        response_encoder = &encoder;
+        return request_decoder;
+      }));
+
+  TestHeaderMapImpl request_headers;
+  HttpTestUtility::addDefaultHeaders(request_headers);
+  NiceMock<MockStreamDecoder> response_decoder;
+  client.newStream(response_decoder).encodeHeaders(request_headers, true);
+  ASSERT_NE(nullptr, response_encoder);
+
+  // Hold on to what the server sends so that part of the first window is still in flight when the
+  // client sends its PING.
+  Buffer::OwnedImpl in_flight;
+  ON_CALL(server_connection, write(_))
+      .WillByDefault(Invoke([&](Buffer::Instance& data) -> void { in_flight.move(data); }));
+  TestHeaderMapImpl response_headers{{":status", "200"}};
+  response_encoder->encodeHeaders(response_headers, false);
+  Buffer::OwnedImpl body(std::string(1024 * 1024, 'a'));
+  response_encoder->encodeData(body, false);
+
+  Stats::Counter& increase = client_stats.counter("http2.window_autotuning_increase");
+  Buffer::OwnedImpl first_bytes;
+  first_bytes.move(in_flight, 1024);
+  client_wrapper.dispatch(first_bytes, client);
+  EXPECT_EQ(0U, increase.value());
+
+  // The rest of the window arrives before the PING ACK, so nearly a full window was received in
+  // one round trip.
+  Buffer::OwnedImpl rest;
+  rest.move(in_flight);
+  client_wrapper.dispatch(rest, client);
+  EXPECT_EQ(1U, increase.value());
+}
+
+TEST(Http2CodecHeaderLimitsTest, HeaderLimits) {
+  Stats::IsolatedStoreImpl client_stats;
+  Stats::IsolatedStoreImpl server_stats;
+  HeaderLimits header_limits;
+  header_limits.max_bytes_ = 1024;
+  header_limits.max_count_ = 10;
+
+  NiceMock<Network::MockConnection> client_connection;
+  MockConnectionCallbacks client_callbacks;
+  ClientConnectionImpl client(client_connection, client_callbacks, client_stats, Http2Settings());
+  Http2CodecImplTest::ConnectionWrapper client_wrapper;
+  NiceMock<Network::MockConnection> server_connection;
+  NiceMock<MockServerConnectionCallbacks> server_callbacks;
+  ServerConnectionImpl server(server_connection, server_callbacks, server_stats, Http2Settings(),
+                              header_limits);
+  Http2CodecImplTest::ConnectionWrapper server_wrapper;
+
+  ON_CALL(client_connection, write(_))
+      .WillByDefault(
+          Invoke([&](Buffer::Instance& data) -> void { server_wrapper.dispatch(data, server); }));
+  ON_CALL(server_connection, write(_))
+      .WillByDefault(
+          Invoke([&](Buffer::Instance& data) -> void { client_wrapper.dispatch(data, client); }));
+  MockStreamDecoder request_decoder;
+  ON_CALL(server_callbacks, newStream(_)).WillByDefault(ReturnRef(request_decoder));
+
+  // Headers within the limits are accepted, including trailers which have limits of their own.
+  TestHeaderMapImpl request_headers{{"x-custom", std::string(900, 'a')}};
+  HttpTestUtility::addDefaultHeaders(request_headers);
+  NiceMock<MockStreamDecoder> response_decoder;
+  EXPECT_CALL(request_decoder, decodeHeaders_(_, false));
+  StreamEncoder& request_encoder = client.newStream(response_decoder);
+  request_encoder.encodeHeaders(request_headers, false);
+  EXPECT_CALL(request_decoder, decodeTrailers_(_));
+  request_encoder.encodeTrailers(TestHeaderMapImpl{{"x-custom", std::string(900, 'a')}});
+
+  // Too many bytes.
+  {
+    TestHeaderMapImpl headers{{"x-custom", std::string(1024, 'a')}};
+    HttpTestUtility::addDefaultHeaders(headers);
+    MockStreamCallbacks callbacks;
+    StreamEncoder& encoder = client.newStream(response_decoder);
+    encoder.getStream().addCallbacks(callbacks);
+    EXPECT_CALL(request_decoder, decodeHeaders_(_, _)).Times(0);
+    EXPECT_CALL(callbacks, onResetStream(StreamResetReason::RemoteReset));
+    encoder.encodeHeaders(headers, true);
+    EXPECT_EQ(1U, server_stats.counter("http2.header_overflow").value());
+  }
+
+  // Too many headers.
+  {
+    TestHeaderMapImpl headers;
+    HttpTestUtility::addDefaultHeaders(headers);
+    for (int i = 0; i < 10; i++) {
+      headers.addViaCopy("x-custom-" + std::to_string(i), "a");
+    }
+    MockStreamCallbacks callbacks;
+    StreamEncoder& encoder = client.newStream(response_decoder);
+    encoder.getStream().addCallbacks(callbacks);
+    EXPECT_CALL(request_decoder, decodeHeaders_(_, _)).Times(0);
+    EXPECT_CALL(callbacks, onResetStream(StreamResetReason::RemoteReset));
+    encoder.encodeHeaders(headers, true);
+    EXPECT_EQ(1U, server_stats.counter("http2.too_many_headers").value());
+  }
+}
+
 TEST(Http2CodecUtility, reconstituteCrumbledCookies) {
   {
     HeaderString key;
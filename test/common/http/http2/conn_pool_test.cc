@@ -57,7 +57,8 @@ public:
     Event::MockTimer* connect_timer_;
   };
 
-  Http2ConnPoolImplTest() : pool_(dispatcher_, host_, Upstream::ResourcePriority::Default) {}
+  Http2ConnPoolImplTest()
+      : pool_(dispatcher_, random_, host_, Upstream::ResourcePriority::Default) {}
 
   ~Http2ConnPoolImplTest() {
     // Make sure all gauges are 0.
@@ -93,6 +94,7 @@ public:
   MOCK_METHOD0(onClientDestroy, void());
 
   NiceMock<Event::MockDispatcher> dispatcher_;
+  NiceMock<Runtime::MockRandomGenerator> random_;
   std::shared_ptr<Upstream::MockClusterInfo> cluster_{new NiceMock<Upstream::MockClusterInfo>()};
   Upstream::HostSharedPtr host_{new Upstream::HostImpl(
       cluster_, "", Network::Utility::resolveUrl("tcp://127.0.0.1:80"), false, 1, "")};
@@ -325,6 +327,73 @@ TEST_F(Http2ConnPoolImplTest, DrainPrimaryNoActiveRequest) {
   dispatcher_.clearDeferredDeleteList();
 }
 
+TEST_F(Http2ConnPoolImplTest, MaxRequestsPerConnectionJitter) {
+  cluster_->max_requests_per_connection_ = 4;
+  cluster_->max_requests_per_connection_jitter_percent_ = 50;
+  // The jitter is up to 2 requests, and 5 % 3 takes all of it.
+  EXPECT_CALL(random_, random()).WillOnce(Return(5)).WillOnce(Return(0));
+
+  expectClientCreate();
+  ActiveTestRequest r1(*this, 0);
+  EXPECT_CALL(r1.inner_encoder_, encodeHeaders(_, true));
+  r1.callbacks_.outer_encoder_->encodeHeaders(HeaderMapImpl{}, true);
+  expectClientConnect(0);
+  EXPECT_CALL(r1.decoder_, decodeHeaders_(_, true));
+  r1.inner_decoder_->decodeHeaders(HeaderMapPtr{new HeaderMapImpl{}}, true);
+
+  ActiveTestRequest r2(*this, 0);
+  EXPECT_CALL(r2.inner_encoder_, encodeHeaders(_, true));
+  r2.callbacks_.outer_encoder_->encodeHeaders(HeaderMapImpl{}, true);
+  EXPECT_CALL(r2.decoder_, decodeHeaders_(_, true));
+  r2.inner_decoder_->decodeHeaders(HeaderMapPtr{new HeaderMapImpl{}}, true);
+
+  // The first client has reached its limit and is closed, since it has no active streams.
+  expectClientCreate();
+  ActiveTestRequest r3(*this, 1);
+  EXPECT_CALL(*this, onClientDestroy());
+  dispatcher_.clearDeferredDeleteList();
+  EXPECT_CALL(r3.inner_encoder_, encodeHeaders(_, true));
+  r3.callbacks_.outer_encoder_->encodeHeaders(HeaderMapImpl{}, true);
+  expectClientConnect(1);
+  EXPECT_CALL(r3.decoder_, decodeHeaders_(_, true));
+  r3.inner_decoder_->decodeHeaders(HeaderMapPtr{new HeaderMapImpl{}}, true);
+
+  test_clients_[1].connection_->raiseEvents(Network::ConnectionEvent::RemoteClose);
+  EXPECT_CALL(*this, onClientDestroy());
+  dispatcher_.clearDeferredDeleteList();
+}
+
+TEST_F(Http2ConnPoolImplTest, IdleTimeout) {
+  cluster_->idle_timeout_.value(std::chrono::milliseconds(1000));
+  // The connect timer is created first, and the newest timer expectation matches first.
+  Event::MockTimer* idle_timer = new NiceMock<Event::MockTimer>(&dispatcher_);
+
+  expectClientCreate();
+  ActiveTestRequest r1(*this, 0);
+  EXPECT_CALL(r1.inner_encoder_, encodeHeaders(_, true));
+  r1.callbacks_.outer_encoder_->encodeHeaders(HeaderMapImpl{}, true);
+  // The client is not idle when it connects since it already has a stream.
+  EXPECT_CALL(*idle_timer, enableTimer(_)).Times(0);
+  expectClientConnect(0);
+  EXPECT_CALL(*idle_timer, enableTimer(std::chrono::milliseconds(1000)));
+  EXPECT_CALL(r1.decoder_, decodeHeaders_(_, true));
+  r1.inner_decoder_->decodeHeaders(HeaderMapPtr{new HeaderMapImpl{}}, true);
+
+  EXPECT_CALL(*idle_timer, disableTimer());
+  ActiveTestRequest r2(*this, 0);
+  EXPECT_CALL(r2.inner_encoder_, encodeHeaders(_, true));
+  r2.callbacks_.outer_encoder_->encodeHeaders(HeaderMapImpl{}, true);
+  EXPECT_CALL(*idle_timer, enableTimer(std::chrono::milliseconds(1000)));
+  EXPECT_CALL(r2.decoder_, decodeHeaders_(_, true));
+  r2.inner_decoder_->decodeHeaders(HeaderMapPtr{new HeaderMapImpl{}}, true);
+
+  idle_timer->callback_();
+  EXPECT_CALL(*this, onClientDestroy());
+  dispatcher_.clearDeferredDeleteList();
+
+  EXPECT_EQ(1U, cluster_->stats_.upstream_cx_idle_timeout_.value());
+}
+
 TEST_F(Http2ConnPoolImplTest, ConnectTimeout) {
   InSequence s;
 
@@ -402,6 +471,39 @@ TEST_F(Http2ConnPoolImplTest, GoAway) {
   dispatcher_.clearDeferredDeleteList();
 }
 
+TEST_F(Http2ConnPoolImplTest, MultipleConnections) {
+  cluster_->http2_settings_.max_connections_per_host_ = 2;
+
+  expectClientCreate();
+  ON_CALL(*test_clients_[0].codec_, maxConcurrentStreams()).WillByDefault(Return(4));
+  ActiveTestRequest r1(*this, 0);
+  expectClientConnect(0);
+  ActiveTestRequest r2(*this, 0);
+  ActiveTestRequest r3(*this, 0);
+
+  // With one of four streams left, a second connection is opened but the stream still goes to the
+  // connection that is already established.
+  expectClientCreate();
+  ON_CALL(*test_clients_[1].codec_, maxConcurrentStreams()).WillByDefault(Return(4));
+  ActiveTestRequest r4(*this, 0);
+
+  // The first connection is full, so the next stream waits for the second one.
+  ActiveTestRequest r5(*this, 1);
+  expectClientConnect(1);
+
+  // No more connections are opened beyond the limit.
+  ActiveTestRequest r6(*this, 1);
+  ActiveTestRequest r7(*this, 1);
+  ActiveTestRequest r8(*this, 1);
+  ActiveTestRequest r9(*this, 1);
+  EXPECT_EQ(2U, cluster_->stats_.upstream_cx_total_.value());
+
+  test_clients_[0].connection_->raiseEvents(Network::ConnectionEvent::RemoteClose);
+  test_clients_[1].connection_->raiseEvents(Network::ConnectionEvent::RemoteClose);
+  EXPECT_CALL(*this, onClientDestroy()).Times(2);
+  dispatcher_.clearDeferredDeleteList();
+}
+
 } // Http2
 } // Http
 } // Envoy
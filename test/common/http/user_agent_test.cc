@@ -7,12 +7,15 @@
 
 #include "gtest/gtest.h"
 
+using testing::_;
+
 namespace Envoy {
 namespace Http {
 
 TEST(UserAgentTest, All) {
   Stats::MockStore stat_store;
   Stats::MockTimespan span;
+  UserAgentContext context("test.", stat_store);
 
   EXPECT_CALL(stat_store.counter_, inc()).Times(4);
   EXPECT_CALL(stat_store, counter("test.user_agent.ios.downstream_cx_total"));
@@ -22,9 +25,8 @@ TEST(UserAgentTest, All) {
 
   {
     UserAgent ua;
-    ua.initializeFromHeaders(TestHeaderMapImpl{{"user-agent", "aaa iOS bbb"}}, "test.", stat_store);
-    ua.initializeFromHeaders(TestHeaderMapImpl{{"user-agent", "aaa android bbb"}}, "test.",
-                             stat_store);
+    ua.initializeFromHeaders(TestHeaderMapImpl{{"user-agent", "aaa iOS bbb"}}, context);
+    ua.initializeFromHeaders(TestHeaderMapImpl{{"user-agent", "aaa android bbb"}}, context);
     ua.completeConnectionLength(span);
   }
 
@@ -36,22 +38,31 @@ TEST(UserAgentTest, All) {
 
   {
     UserAgent ua;
-    ua.initializeFromHeaders(TestHeaderMapImpl{{"user-agent", "aaa android bbb"}}, "test.",
-                             stat_store);
+    ua.initializeFromHeaders(TestHeaderMapImpl{{"user-agent", "aaa android bbb"}}, context);
+    ua.completeConnectionLength(span);
+  }
+
+  {
+    UserAgent ua;
+    ua.initializeFromHeaders(TestHeaderMapImpl{{"user-agent", "aaa bbb"}}, context);
+    ua.initializeFromHeaders(TestHeaderMapImpl{{"user-agent", "aaa android bbb"}}, context);
     ua.completeConnectionLength(span);
   }
 
   {
     UserAgent ua;
-    ua.initializeFromHeaders(TestHeaderMapImpl{{"user-agent", "aaa bbb"}}, "test.", stat_store);
-    ua.initializeFromHeaders(TestHeaderMapImpl{{"user-agent", "aaa android bbb"}}, "test.",
-                             stat_store);
+    ua.initializeFromHeaders(TestHeaderMapImpl{}, context);
     ua.completeConnectionLength(span);
   }
 
+  // The stats of a type are only looked up for its first connection.
+  EXPECT_CALL(stat_store.counter_, inc()).Times(2);
+  EXPECT_CALL(stat_store, counter(_)).Times(0);
+  EXPECT_CALL(span, complete("test.user_agent.ios.downstream_cx_length_ms"));
+
   {
     UserAgent ua;
-    ua.initializeFromHeaders(TestHeaderMapImpl{}, "test.", stat_store);
+    ua.initializeFromHeaders(TestHeaderMapImpl{{"user-agent", "aaa iOS bbb"}}, context);
     ua.completeConnectionLength(span);
   }
 }
@@ -27,6 +27,8 @@ TEST(HttpUtility, parseQueryString) {
             Utility::parseQueryString("/hello?hello=&hello2=world2"));
   EXPECT_EQ(Utility::QueryParams({{"name", "admin"}, {"level", "trace"}}),
             Utility::parseQueryString("/logging?name=admin&level=trace"));
+  EXPECT_EQ(Utility::QueryParams({{"usedonly", ""}, {"filter", "foo"}}),
+            Utility::parseQueryString("/stats?usedonly&filter=foo"));
 }
 
 TEST(HttpUtility, getResponseStatus) {
@@ -72,6 +74,14 @@ TEST(HttpUtility, appendXff) {
     EXPECT_EQ("10.0.0.1, 127.0.0.1", headers.get_("x-forwarded-for"));
   }
 
+  {
+    TestHeaderMapImpl headers{{"x-forwarded-for", "10.0.0.1"}};
+    Network::Address::Ipv4Instance address("127.0.0.1");
+    Utility::appendXff(headers, address);
+    Utility::appendXff(headers, address);
+    EXPECT_EQ("10.0.0.1, 127.0.0.1, 127.0.0.1", headers.get_("x-forwarded-for"));
+  }
+
   {
     TestHeaderMapImpl headers{{"x-forwarded-for", "10.0.0.1"}};
     Network::Address::PipeInstance address("/foo");
@@ -87,6 +97,17 @@ TEST(HttpUtility, createSslRedirectPath) {
   }
 }
 
+TEST(HttpUtility, parseHttp1Settings) {
+  EXPECT_FALSE(
+      Utility::parseHttp1Settings(*Json::Factory::loadFromString("{}")).forward_raw_headers_);
+  EXPECT_TRUE(Utility::parseHttp1Settings(*Json::Factory::loadFromString(R"raw({
+                                            "http1_settings": {
+                                              "forward_raw_headers": true
+                                            }
+                                          })raw"))
+                  .forward_raw_headers_);
+}
+
 TEST(HttpUtility, parseHttp2Settings) {
   {
     auto http2_settings = Utility::parseHttp2Settings(*Json::Factory::loadFromString("{}"));
@@ -97,6 +118,11 @@ TEST(HttpUtility, parseHttp2Settings) {
               http2_settings.initial_stream_window_size_);
     EXPECT_EQ(Http2Settings::DEFAULT_INITIAL_CONNECTION_WINDOW_SIZE,
               http2_settings.initial_connection_window_size_);
+    EXPECT_EQ(Http2Settings::DEFAULT_HPACK_TABLE_SIZE, http2_settings.hpack_encoder_table_size_);
+    EXPECT_TRUE(http2_settings.hpack_never_index_headers_.empty());
+    EXPECT_FALSE(http2_settings.window_autotuning_);
+    EXPECT_EQ(Http2Settings::DEFAULT_MAX_CONNECTIONS_PER_HOST,
+              http2_settings.max_connections_per_host_);
   }
 
   {
@@ -105,13 +131,22 @@ TEST(HttpUtility, parseHttp2Settings) {
                                             "hpack_table_size": 1,
                                             "max_concurrent_streams": 2,
                                             "initial_stream_window_size": 3,
-                                            "initial_connection_window_size": 4
+                                            "initial_connection_window_size": 4,
+                                            "hpack_encoder_table_size": 5,
+                                            "hpack_never_index_headers": ["Authorization"],
+                                            "window_autotuning": true,
+                                            "max_connections_per_host": 6
                                           }
                                         })raw"));
     EXPECT_EQ(1U, http2_settings.hpack_table_size_);
     EXPECT_EQ(2U, http2_settings.max_concurrent_streams_);
     EXPECT_EQ(3U, http2_settings.initial_stream_window_size_);
     EXPECT_EQ(4U, http2_settings.initial_connection_window_size_);
+    EXPECT_EQ(5U, http2_settings.hpack_encoder_table_size_);
+    ASSERT_EQ(1U, http2_settings.hpack_never_index_headers_.size());
+    EXPECT_EQ("authorization", http2_settings.hpack_never_index_headers_[0].get());
+    EXPECT_TRUE(http2_settings.window_autotuning_);
+    EXPECT_EQ(6U, http2_settings.max_connections_per_host_);
   }
 
   {
@@ -146,6 +181,21 @@ TEST(HttpUtility, parseHttp2Settings) {
   }
 }
 
+TEST(HttpUtility, parseHeaderLimits) {
+  {
+    HeaderLimits header_limits = Utility::parseHeaderLimits(*Json::Factory::loadFromString("{}"));
+    EXPECT_EQ(HeaderLimits::DEFAULT_MAX_BYTES, header_limits.max_bytes_);
+    EXPECT_EQ(HeaderLimits::DEFAULT_MAX_COUNT, header_limits.max_count_);
+  }
+
+  {
+    HeaderLimits header_limits = Utility::parseHeaderLimits(*Json::Factory::loadFromString(
+        R"raw({"max_request_headers_kb": 8, "max_request_headers_count": 50})raw"));
+    EXPECT_EQ(8U * 1024, header_limits.max_bytes_);
+    EXPECT_EQ(50U, header_limits.max_count_);
+  }
+}
+
 TEST(HttpUtility, TwoAddressesInXFF) {
   const std::string first_address = "34.0.0.1";
   const std::string second_address = "10.0.0.1";
@@ -172,6 +222,30 @@ TEST(HttpUtility, OneAddressInXFF) {
   EXPECT_EQ(first_address, Utility::getLastAddressFromXFF(request_headers));
 }
 
+TEST(HttpUtility, MalformedXFF) {
+  // Empty entries are skipped.
+  {
+    TestHeaderMapImpl request_headers{{"x-forwarded-for", "34.0.0.1, 10.0.0.1, , "}};
+    EXPECT_EQ("10.0.0.1", Utility::getLastAddressFromXFF(request_headers));
+  }
+
+  {
+    TestHeaderMapImpl request_headers{{"x-forwarded-for", ", "}};
+    EXPECT_EQ("", Utility::getLastAddressFromXFF(request_headers));
+  }
+
+  // Addresses are only separated by a comma followed by a space.
+  {
+    TestHeaderMapImpl request_headers{{"x-forwarded-for", "34.0.0.1, 10.0.0.1,10.0.0.2"}};
+    EXPECT_EQ("10.0.0.1,10.0.0.2", Utility::getLastAddressFromXFF(request_headers));
+  }
+
+  {
+    TestHeaderMapImpl request_headers{{"x-forwarded-for", "34.0.0.1 ,10.0.0.1"}};
+    EXPECT_EQ("34.0.0.1 ,10.0.0.1", Utility::getLastAddressFromXFF(request_headers));
+  }
+}
+
 TEST(HttpUtility, TestParseCookie) {
   TestHeaderMapImpl headers{
       {"someheader", "10.0.0.1"},
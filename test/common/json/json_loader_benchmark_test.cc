@@ -0,0 +1,78 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include "common/json/json_loader.h"
+
+#include "gtest/gtest.h"
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+namespace Json {
+
+/**
+ * This test is for benchmarking only and should not be run as part of unit tests. It measures how
+ * long Json::Factory takes to load a small cluster definition, as parsed for every CDS cluster,
+ * and a large route table, as parsed for every RDS update.
+ */
+class DISABLED_JsonLoaderBenchmark : public testing::Test {
+public:
+  static const uint32_t NumRoutes = 1000;
+
+  void run(const std::string& name, const std::string& json, uint32_t iterations) {
+    uint64_t loaded = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+      loaded += !Factory::loadFromString(json)->empty();
+    }
+    std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_EQ(iterations, loaded);
+    std::cout << fmt::format("{}: bytes={} {}ns/op", name, json.size(),
+                             elapsed.count() / iterations)
+              << std::endl;
+  }
+
+  static std::string routeConfig() {
+    std::string routes;
+    for (uint32_t i = 0; i < NumRoutes; i++) {
+      routes += fmt::format(R"EOF({}{{"prefix": "/service/{}/", "cluster": "c{}",
+                                      "timeout_ms": 15000,
+                                      "retry_policy": {{"retry_on": "5xx,connect-failure",
+                                                        "num_retries": 3}}}})EOF",
+                            i == 0 ? "" : ",", i, i);
+    }
+    return fmt::format(R"EOF({{"virtual_hosts": [{{"name": "default", "domains": ["*"],
+                                                 "routes": [{}]}}]}})EOF",
+                       routes);
+  }
+};
+
+const uint32_t DISABLED_JsonLoaderBenchmark::NumRoutes;
+
+TEST_F(DISABLED_JsonLoaderBenchmark, Cluster) {
+  const std::string json = R"EOF(
+  {
+    "name": "service_42",
+    "connect_timeout_ms": 250,
+    "type": "sds",
+    "service_name": "service_42",
+    "lb_type": "least_request",
+    "max_requests_per_connection": 1000,
+    "features": "http2",
+    "circuit_breakers": {"default": {"max_connections": 1024, "max_pending_requests": 1024}},
+    "outlier_detection": {"consecutive_5xx": 5, "interval_ms": 10000},
+    "health_check": {"type": "http", "timeout_ms": 2000, "interval_ms": 10000,
+                     "unhealthy_threshold": 2, "healthy_threshold": 2,
+                     "path": "/healthcheck", "service_name": "service_42"}
+  }
+  )EOF";
+  run("json_load_cluster", json, 100000);
+}
+
+TEST_F(DISABLED_JsonLoaderBenchmark, RouteTable) {
+  run("json_load_route_table", routeConfig(), 100);
+}
+
+} // Json
+} // Envoy
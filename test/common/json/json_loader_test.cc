@@ -1,12 +1,18 @@
+#include <cstdint>
+#include <limits>
 #include <string>
 #include <vector>
 
 #include "common/json/json_loader.h"
 
+#include "test/mocks/stats/mocks.h"
 #include "test/test_common/utility.h"
 
+#include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
+using testing::_;
+
 namespace Envoy {
 namespace Json {
 
@@ -212,6 +218,90 @@ TEST(JsonLoaderTest, Double) {
   }
 }
 
+TEST(JsonLoaderTest, SubObjectOutlivesRoot) {
+  ObjectSharedPtr child;
+  std::vector<ObjectSharedPtr> array;
+  {
+    ObjectSharedPtr json = Factory::loadFromString(
+        "{\"child\": {\"name\": \"value\"}, \"array\": [{\"a\": 1}, {\"b\": 2}]}");
+    child = json->getObject("child");
+    array = json->getObjectArray("array");
+  }
+
+  EXPECT_EQ("value", child->getString("name"));
+  ASSERT_EQ(2, array.size());
+  EXPECT_EQ(1, array[0]->getInteger("a"));
+  EXPECT_EQ(2, array[1]->getInteger("b"));
+}
+
+TEST(JsonLoaderTest, LargeDocument) {
+  std::string json_string = "{\"items\": [";
+  for (uint32_t i = 0; i < 2000; i++) {
+    json_string +=
+        fmt::format("{}{{\"id\": {}, \"tags\": [\"a\", \"b\"]}}", i == 0 ? "" : ",", i);
+  }
+  json_string += "]}";
+
+  ObjectSharedPtr json = Factory::loadFromString(json_string);
+  std::vector<ObjectSharedPtr> items = json->getObjectArray("items");
+  ASSERT_EQ(2000, items.size());
+  for (uint32_t i = 0; i < items.size(); i++) {
+    EXPECT_EQ(i, items[i]->getInteger("id"));
+    EXPECT_EQ((std::vector<std::string>{"a", "b"}), items[i]->getStringArray("tags"));
+  }
+}
+
+class RecordingSaxHandler : public SaxHandler {
+public:
+  // Json::SaxHandler
+  bool onObjectStart() override { return record("{"); }
+  bool onKey(const char* data, size_t length) override {
+    return record(std::string(data, length) + ":");
+  }
+  bool onObjectEnd() override { return record("}"); }
+  bool onArrayStart() override { return record("["); }
+  bool onArrayEnd() override { return record("]"); }
+  bool onBoolean(bool value) override { return record(value ? "true" : "false"); }
+  bool onInteger(int64_t value) override { return record(std::to_string(value)); }
+  bool onDouble(double value) override { return record(fmt::format("{}", value)); }
+  bool onString(const char* data, size_t length) override {
+    return record("'" + std::string(data, length) + "'");
+  }
+  bool onNull() override { return record("null"); }
+
+  bool record(const std::string& event) {
+    events_.push_back(event);
+    return events_.size() < max_events_;
+  }
+
+  std::vector<std::string> events_;
+  size_t max_events_{std::numeric_limits<size_t>::max()};
+};
+
+TEST(JsonLoaderTest, Sax) {
+  {
+    RecordingSaxHandler handler;
+    Factory::parseFromString(
+        "{\"a\": [1, -2, 1.5, true, false, null], \"b\": {\"c\": \"d\"}}", handler);
+    EXPECT_EQ((std::vector<std::string>{"{", "a:", "[", "1", "-2", "1.5", "true", "false", "null",
+                                        "]", "b:", "{", "c:", "'d'", "}", "}"}),
+              handler.events_);
+  }
+
+  {
+    RecordingSaxHandler handler;
+    handler.max_events_ = 3;
+    Factory::parseFromString("{\"a\": 1, \"b\": 2}", handler);
+    EXPECT_EQ((std::vector<std::string>{"{", "a:", "1"}), handler.events_);
+  }
+
+  {
+    RecordingSaxHandler handler;
+    EXPECT_THROW(Factory::parseFromString("{\"a\": ", handler), Exception);
+    EXPECT_THROW(Factory::parseFromString("[9223372036854775808]", handler), Exception);
+  }
+}
+
 TEST(JsonLoaderTest, Hash) {
   ObjectSharedPtr json1 = Factory::loadFromString("{\"value1\": 10.5, \"value2\": -12.3}");
   ObjectSharedPtr json2 = Factory::loadFromString("{\"value2\": -12.3, \"value1\": 10.5}");
@@ -267,6 +357,14 @@ TEST(JsonLoaderTest, Schema) {
     EXPECT_THROW(json->validateSchema(invalid_schema), Exception);
     EXPECT_THROW(json->validateSchema(different_schema), Exception);
     EXPECT_NO_THROW(json->validateSchema(valid_schema));
+
+    // Compiled schemas are cached, which must not change the results of later validations.
+    EXPECT_THROW(json->validateSchema(invalid_json_schema), std::invalid_argument);
+    EXPECT_THROW(json->validateSchema(different_schema), Exception);
+    EXPECT_NO_THROW(json->validateSchema(valid_schema));
+    EXPECT_THROW(Factory::loadFromString("{\"value1\": \"not a number\"}")
+                     ->validateSchema(valid_schema),
+                 Exception);
   }
 
   {
@@ -284,6 +382,68 @@ TEST(JsonLoaderTest, Schema) {
   }
 }
 
+TEST(JsonLoaderTest, SchemaStats) {
+  std::string schema = R"EOF(
+  {
+    "properties": {
+      "value1": {"type" : "number"}
+    }
+  }
+  )EOF";
+
+  std::string other_schema = R"EOF(
+  {
+    "properties": {
+      "value2": {"type" : "number"}
+    }
+  }
+  )EOF";
+
+  ObjectSharedPtr json = Factory::loadFromString("{\"value1\": 10}");
+  Stats::MockIsolatedStatsStore store;
+  SchemaRegistry::setName(schema, "test");
+  SchemaRegistry::setStatsScope(&store);
+
+  EXPECT_CALL(store, deliverTimingToSinks("json.schema.test.validation_time", _)).Times(2);
+  json->validateSchema(schema);
+  EXPECT_THROW(Factory::loadFromString("{\"value1\": \"a\"}")->validateSchema(schema), Exception);
+
+  EXPECT_CALL(store, deliverTimingToSinks("json.schema.unnamed.validation_time", _));
+  json->validateSchema(other_schema);
+
+  SchemaRegistry::setStatsScope(nullptr);
+  json->validateSchema(schema);
+}
+
+TEST(JsonLoaderTest, SchemaValidatedOnce) {
+  std::string schema = R"EOF(
+  {
+    "properties": {
+      "value1": {"type" : "number"}
+    }
+  }
+  )EOF";
+
+  ObjectSharedPtr json = Factory::loadFromString("{\"value1\": 10, \"value2\": {\"value1\": 1}}");
+  ObjectSharedPtr invalid = Factory::loadFromString("{\"value1\": \"a\"}");
+  Stats::MockIsolatedStatsStore store;
+  SchemaRegistry::setName(schema, "validated_once");
+  SchemaRegistry::setStatsScope(&store);
+
+  // An object that conforms is only validated the first time, an object that does not conform
+  // every time.
+  EXPECT_CALL(store, deliverTimingToSinks("json.schema.validated_once.validation_time", _))
+      .Times(4);
+  json->validateSchema(schema);
+  json->validateSchema(schema);
+  json->getObject("value2")->validateSchema(schema);
+  json->getObject("value2")->validateSchema(schema);
+  EXPECT_THROW(invalid->validateSchema(schema), Exception);
+  EXPECT_THROW(invalid->validateSchema(schema), Exception);
+
+  SchemaRegistry::setStatsScope(nullptr);
+}
+
 TEST(JsonLoaderTest, NestedSchema) {
 
   std::string schema = R"EOF(
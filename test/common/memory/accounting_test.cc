@@ -0,0 +1,161 @@
+#include <cstdint>
+#include <string>
+
+#include "common/common/thread.h"
+#include "common/memory/accounting.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Memory {
+
+// The totals are process wide, so the tests look at how they change.
+class AccountingTest : public testing::Test {
+public:
+  AccountingTest()
+      : header_map_(Accounting::totals(Subsystem::HeaderMap)),
+        buffer_(Accounting::totals(Subsystem::Buffer)) {}
+
+  uint64_t allocated(Subsystem subsystem) {
+    return Accounting::totals(subsystem).allocated_bytes_ - initial(subsystem).allocated_bytes_;
+  }
+
+  uint64_t freed(Subsystem subsystem) {
+    return Accounting::totals(subsystem).freed_bytes_ - initial(subsystem).freed_bytes_;
+  }
+
+  const Accounting::Totals& initial(Subsystem subsystem) {
+    return subsystem == Subsystem::HeaderMap ? header_map_ : buffer_;
+  }
+
+  const Accounting::Totals header_map_;
+  const Accounting::Totals buffer_;
+};
+
+TEST_F(AccountingTest, Names) {
+  EXPECT_STREQ("header_map", Accounting::name(Subsystem::HeaderMap));
+  EXPECT_STREQ("buffer", Accounting::name(Subsystem::Buffer));
+  EXPECT_STREQ("stats", Accounting::name(Subsystem::Stats));
+  EXPECT_STREQ("route_table", Accounting::name(Subsystem::RouteTable));
+  EXPECT_STREQ("conn_pool", Accounting::name(Subsystem::ConnPool));
+}
+
+TEST_F(AccountingTest, ChargedOnlyWithinScope) {
+  Accounting::onAllocation(100);
+  EXPECT_FALSE(Accounting::charging());
+
+  {
+    AccountingScope scope(Subsystem::HeaderMap);
+    EXPECT_TRUE(Accounting::charging());
+    Accounting::onAllocation(100);
+    Accounting::onFree(40);
+  }
+
+  EXPECT_FALSE(Accounting::charging());
+  Accounting::onFree(100);
+  EXPECT_EQ(100U, allocated(Subsystem::HeaderMap));
+  EXPECT_EQ(40U, freed(Subsystem::HeaderMap));
+}
+
+TEST_F(AccountingTest, NestedScopes) {
+  AccountingScope outer(Subsystem::HeaderMap);
+  Accounting::onAllocation(10);
+  {
+    AccountingScope inner(Subsystem::Buffer);
+    Accounting::onAllocation(20);
+  }
+  Accounting::onAllocation(30);
+
+  EXPECT_EQ(40U, allocated(Subsystem::HeaderMap));
+  EXPECT_EQ(20U, allocated(Subsystem::Buffer));
+}
+
+TEST_F(AccountingTest, ThreadsThatExitAreKept) {
+  Thread::Thread thread([]() -> void {
+    AccountingScope scope(Subsystem::Buffer);
+    Accounting::onAllocation(1000);
+    Accounting::onFree(300);
+  });
+  thread.join();
+
+  EXPECT_EQ(1000U, allocated(Subsystem::Buffer));
+  EXPECT_EQ(300U, freed(Subsystem::Buffer));
+}
+
+TEST(RequestAllocationsTest, Names) {
+  EXPECT_STREQ("decode_headers", RequestAllocations::name(RequestPhase::DecodeHeaders));
+  EXPECT_STREQ("decode_body", RequestAllocations::name(RequestPhase::DecodeBody));
+  EXPECT_STREQ("routing", RequestAllocations::name(RequestPhase::Routing));
+  EXPECT_STREQ("upstream_encode", RequestAllocations::name(RequestPhase::UpstreamEncode));
+  EXPECT_STREQ("response_encode", RequestAllocations::name(RequestPhase::ResponseEncode));
+  EXPECT_STREQ("access_log", RequestAllocations::name(RequestPhase::AccessLog));
+}
+
+TEST(RequestAllocationsTest, ChargedOnlyWithinScope) {
+  RequestAllocations request;
+  Accounting::onAllocation(100);
+  {
+    RequestPhaseScope scope(&request, RequestPhase::DecodeHeaders);
+    Accounting::onAllocation(100);
+    Accounting::onAllocation(20);
+    Accounting::onFree(100);
+  }
+  Accounting::onAllocation(100);
+
+  EXPECT_EQ(2U, request.tally(RequestPhase::DecodeHeaders).allocations_);
+  EXPECT_EQ(120U, request.tally(RequestPhase::DecodeHeaders).bytes_);
+  EXPECT_EQ(0U, request.tally(RequestPhase::Routing).allocations_);
+}
+
+TEST(RequestAllocationsTest, NestedScopes) {
+  RequestAllocations request;
+  RequestAllocations other;
+  RequestPhaseScope outer(&request, RequestPhase::DecodeHeaders);
+  Accounting::onAllocation(10);
+  {
+    // A phase of the request already in scope, as used by the router.
+    RequestPhaseScope upstream(RequestPhase::UpstreamEncode);
+    Accounting::onAllocation(20);
+    {
+      RequestPhaseScope response(&other, RequestPhase::ResponseEncode);
+      Accounting::onAllocation(30);
+    }
+    {
+      RequestPhaseScope none(nullptr, RequestPhase::AccessLog);
+      Accounting::onAllocation(40);
+    }
+  }
+  Accounting::onAllocation(50);
+
+  EXPECT_EQ(2U, request.tally(RequestPhase::DecodeHeaders).allocations_);
+  EXPECT_EQ(60U, request.tally(RequestPhase::DecodeHeaders).bytes_);
+  EXPECT_EQ(1U, request.tally(RequestPhase::UpstreamEncode).allocations_);
+  EXPECT_EQ(20U, request.tally(RequestPhase::UpstreamEncode).bytes_);
+  EXPECT_EQ(30U, other.tally(RequestPhase::ResponseEncode).bytes_);
+  EXPECT_EQ(0U, request.tally(RequestPhase::AccessLog).allocations_);
+}
+
+TEST(RequestAllocationsTest, PhaseWithoutRequestChargesNothing) {
+  RequestPhaseScope upstream(RequestPhase::UpstreamEncode);
+  Accounting::onAllocation(10);
+}
+
+TEST(RequestAllocationsTest, Enable) {
+  // Accounting can only be turned on with tcmalloc.
+  EXPECT_EQ(Accounting::enable(), RequestAllocations::enable(true));
+  EXPECT_EQ(Accounting::enable(), RequestAllocations::enabled());
+  EXPECT_FALSE(RequestAllocations::enable(false));
+  EXPECT_FALSE(RequestAllocations::enabled());
+}
+
+TEST(AccountingTotalsTest, NetBytes) {
+  Accounting::Totals totals;
+  totals.allocated_bytes_ = 100;
+  totals.freed_bytes_ = 40;
+  EXPECT_EQ(60U, totals.netBytes());
+  totals.freed_bytes_ = 200;
+  EXPECT_EQ(0U, totals.netBytes());
+}
+
+} // Memory
+} // Envoy
@@ -6,12 +6,16 @@
 #include "common/mongo/codec_impl.h"
 
 #include "test/test_common/printers.h"
+#include "test/test_common/utility.h"
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
 namespace Envoy {
+using testing::_;
+using testing::ByRef;
 using testing::Eq;
+using testing::Invoke;
 using testing::NiceMock;
 using testing::Pointee;
 
@@ -152,10 +156,54 @@ TEST_F(MongoCodecImplTest, Reply) {
   EXPECT_NO_THROW(Json::Factory::loadFromString(reply.toString(false)));
 
   encoder_.encodeReply(reply);
-  EXPECT_CALL(callbacks_, decodeReply_(Pointee(Eq(reply))));
+  EXPECT_CALL(callbacks_, decodeReply_(Pointee(Eq(ByRef(reply)))));
   decoder_.onData(output_);
 }
 
+TEST_F(MongoCodecImplTest, ReplyDocumentsDecodedOnAccess) {
+  ReplyMessageImpl reply(2, 2);
+  reply.numberReturned(2);
+  reply.documents().push_back(Bson::DocumentImpl::create()->addString("hello", "world"));
+  reply.documents().push_back(Bson::DocumentImpl::create()->addInt32("foo", 1));
+  uint64_t byte_size = reply.documentsByteSize();
+  encoder_.encodeReply(reply);
+
+  ReplyMessagePtr decoded;
+  EXPECT_CALL(callbacks_, decodeReply_(_))
+      .WillOnce(Invoke([&](ReplyMessagePtr& message) -> void { decoded = std::move(message); }));
+  decoder_.onData(output_);
+  EXPECT_EQ(byte_size, decoded->documentsByteSize());
+  EXPECT_EQ(2, decoded->numberReturned());
+  EXPECT_EQ(2U, decoded->documents().size());
+  EXPECT_EQ(byte_size, decoded->documentsByteSize());
+  EXPECT_EQ(reply, *decoded);
+}
+
+TEST_F(MongoCodecImplTest, ReplyInvalidDocuments) {
+  ReplyMessageImpl reply(2, 2);
+  reply.numberReturned(2);
+  reply.documents().push_back(Bson::DocumentImpl::create());
+  encoder_.encodeReply(reply);
+
+  // The message is framed by its length, so bad documents are only detected once accessed.
+  ReplyMessagePtr decoded;
+  EXPECT_CALL(callbacks_, decodeReply_(_))
+      .WillOnce(Invoke([&](ReplyMessagePtr& message) -> void { decoded = std::move(message); }));
+  decoder_.onData(output_);
+  EXPECT_THROW(decoded->documents(), EnvoyException);
+}
+
+TEST_F(MongoCodecImplTest, ReplyTooShort) {
+  Bson::BufferHelper::writeInt32(output_, 16 + 19);
+  Bson::BufferHelper::writeInt32(output_, 0);
+  Bson::BufferHelper::writeInt32(output_, 0);
+  Bson::BufferHelper::writeInt32(output_, static_cast<int32_t>(Message::OpCode::OP_REPLY));
+  Bson::BufferHelper::writeInt64(output_, 0);
+  Bson::BufferHelper::writeInt64(output_, 0);
+  Bson::BufferHelper::writeInt32(output_, 0);
+  EXPECT_THROW(decoder_.onData(output_), EnvoyException);
+}
+
 TEST_F(MongoCodecImplTest, GetMoreEqual) {
   {
     GetMoreMessageImpl g1(0, 0);
@@ -297,13 +345,69 @@ TEST_F(MongoCodecImplTest, EncodeExceptions) {
 }
 
 TEST_F(MongoCodecImplTest, PartialMessages) {
-  output_.add("2");
-  decoder_.onData(output_);
-  output_.drain(output_.length());
+  QueryMessageImpl query(1, 1);
+  query.fullCollectionName("test");
+  query.query(Bson::DocumentImpl::create()->addString("hello", "world"));
+  encoder_.encodeQuery(query);
+  encoder_.encodeQuery(query);
+  const std::string encoded = TestUtility::bufferToString(output_);
+
+  // Data is not consumed, and a message split across any number of reads is decoded once it is
+  // complete.
+  EXPECT_CALL(callbacks_, decodeQuery_(Pointee(Eq(query)))).Times(0);
+  for (size_t i = 0; i < encoded.size() / 2 - 1; i++) {
+    Buffer::OwnedImpl data(encoded.substr(i, 1));
+    decoder_.onData(data);
+    EXPECT_EQ(1U, data.length());
+  }
 
-  Bson::BufferHelper::writeInt32(output_, 100);
-  decoder_.onData(output_);
-  EXPECT_EQ(4U, output_.length());
+  EXPECT_CALL(callbacks_, decodeQuery_(Pointee(Eq(query)))).Times(2);
+  Buffer::OwnedImpl data(encoded.substr(encoded.size() / 2 - 1));
+  decoder_.onData(data);
+}
+
+TEST_F(MongoCodecImplTest, SkipReplyDocuments) {
+  DecoderImpl decoder(callbacks_, true);
+  ReplyMessageImpl reply(2, 2);
+  reply.flags(1);
+  reply.cursorId(3);
+  reply.numberReturned(2);
+  reply.documents().push_back(Bson::DocumentImpl::create()->addString("hello", "world"));
+  reply.documents().push_back(Bson::DocumentImpl::create()->addInt32("foo", 1));
+  const uint64_t byte_size = reply.documentsByteSize();
+  encoder_.encodeReply(reply);
+  QueryMessageImpl query(1, 1);
+  query.fullCollectionName("test");
+  query.query(Bson::DocumentImpl::create());
+  encoder_.encodeQuery(query);
+  const std::string encoded = TestUtility::bufferToString(output_);
+
+  // The reply is dispatched as soon as the fields before its documents have arrived.
+  ReplyMessagePtr decoded;
+  EXPECT_CALL(callbacks_, decodeReply_(_))
+      .WillOnce(Invoke([&](ReplyMessagePtr& message) -> void { decoded = std::move(message); }));
+  Buffer::OwnedImpl header(encoded.substr(0, 36));
+  decoder.onData(header);
+  ASSERT_NE(nullptr, decoded);
+  EXPECT_EQ(1, decoded->flags());
+  EXPECT_EQ(3, decoded->cursorId());
+  EXPECT_EQ(2, decoded->numberReturned());
+  EXPECT_EQ(byte_size, decoded->documentsByteSize());
+  EXPECT_TRUE(decoded->documents().empty());
+
+  // The documents are passed over and the next message is decoded.
+  EXPECT_CALL(callbacks_, decodeQuery_(Pointee(Eq(query))));
+  Buffer::OwnedImpl rest(encoded.substr(36));
+  decoder.onData(rest);
+}
+
+TEST_F(MongoCodecImplTest, InvalidMessageLength) {
+  Bson::BufferHelper::writeInt32(output_, 15);
+  Bson::BufferHelper::writeInt32(output_, 0);
+  Bson::BufferHelper::writeInt32(output_, 0);
+  Bson::BufferHelper::writeInt32(output_, static_cast<int32_t>(Message::OpCode::OP_QUERY));
+  EXPECT_THROW_WITH_MESSAGE(decoder_.onData(output_), EnvoyException,
+                            "invalid mongo message length 15");
 }
 
 TEST_F(MongoCodecImplTest, InvalidMessage) {
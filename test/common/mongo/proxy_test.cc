@@ -1,5 +1,6 @@
 #include <chrono>
 #include <cstdint>
+#include <future>
 #include <memory>
 #include <string>
 
@@ -29,7 +30,19 @@ namespace Mongo {
 
 class MockDecoder : public Decoder {
 public:
-  MOCK_METHOD1(onData, void(Buffer::Instance& data));
+  MOCK_METHOD1(onData, void(const Buffer::Instance& data));
+};
+
+// The filter creates a decoder for each direction. Both forward to the same mock so that tests set
+// up what the next read or write decodes the same way.
+class ForwardingDecoder : public Decoder {
+public:
+  ForwardingDecoder(Decoder& decoder) : decoder_(decoder) {}
+
+  // Mongo::Decoder
+  void onData(const Buffer::Instance& data) override { decoder_.onData(data); }
+
+  Decoder& decoder_;
 };
 
 class TestStatStore : public Stats::IsolatedStoreImpl {
@@ -45,10 +58,10 @@ public:
   // ProxyFilter
   DecoderPtr createDecoder(DecoderCallbacks& callbacks) override {
     callbacks_ = &callbacks;
-    return DecoderPtr{decoder_};
+    return DecoderPtr{new ForwardingDecoder(*decoder_)};
   }
 
-  MockDecoder* decoder_{new MockDecoder()};
+  std::unique_ptr<MockDecoder> decoder_{new MockDecoder()};
   DecoderCallbacks* callbacks_{};
 };
 
@@ -61,9 +74,12 @@ public:
         .WillByDefault(Return(true));
     ON_CALL(runtime_.snapshot_, featureEnabled("mongo.logging_enabled", 100))
         .WillByDefault(Return(true));
+    ON_CALL(runtime_.snapshot_, featureEnabled("mongo.logging_sample_rate", 10000, _, 10000))
+        .WillByDefault(Return(true));
 
     EXPECT_CALL(log_manager_, createAccessLog(_)).WillOnce(Return(file_));
-    access_log_.reset(new AccessLog("test", log_manager_));
+    access_log_.reset(new AccessLog("test", log_manager_, runtime_, random_, "test.access_log.",
+                                    store_, AccessLog::DEFAULT_MAX_PENDING));
     filter_.reset(new TestProxyFilter("test.", store_, runtime_, access_log_));
     filter_->initializeReadFilterCallbacks(read_filter_callbacks_);
     filter_->onNewConnection();
@@ -72,6 +88,7 @@ public:
   Buffer::OwnedImpl fake_data_;
   NiceMock<TestStatStore> store_;
   NiceMock<Runtime::MockLoader> runtime_;
+  NiceMock<Runtime::MockRandomGenerator> random_;
   Event::MockDispatcher dispatcher_;
   std::shared_ptr<Filesystem::MockFile> file_{new NiceMock<Filesystem::MockFile>()};
   AccessLogSharedPtr access_log_;
@@ -84,7 +101,7 @@ TEST_F(MongoProxyFilterTest, Stats) {
   EXPECT_CALL(*file_, write(_)).Times(AtLeast(1));
 
   EXPECT_CALL(*filter_->decoder_, onData(_))
-      .WillOnce(Invoke([&](Buffer::Instance&) -> void {
+      .WillOnce(Invoke([&](const Buffer::Instance&) -> void {
         QueryMessagePtr message(new QueryMessageImpl(0, 0));
         message->fullCollectionName("db.test");
         message->flags(0b1110010);
@@ -98,10 +115,11 @@ TEST_F(MongoProxyFilterTest, Stats) {
   EXPECT_CALL(store_, deliverTimingToSinks("test.collection.test.query.reply_time_ms", _));
 
   EXPECT_CALL(*filter_->decoder_, onData(_))
-      .WillOnce(Invoke([&](Buffer::Instance&) -> void {
+      .WillOnce(Invoke([&](const Buffer::Instance&) -> void {
         ReplyMessagePtr message(new ReplyMessageImpl(0, 0));
         message->flags(0b11);
         message->cursorId(1);
+        message->numberReturned(1);
         message->documents().push_back(Bson::DocumentImpl::create()->addString("hello", "world"));
         filter_->callbacks_->decodeReply(std::move(message));
 
@@ -125,7 +143,7 @@ TEST_F(MongoProxyFilterTest, Stats) {
   EXPECT_EQ(1U, store_.counter("test.op_reply_valid_cursor").value());
 
   EXPECT_CALL(*filter_->decoder_, onData(_))
-      .WillOnce(Invoke([&](Buffer::Instance&) -> void {
+      .WillOnce(Invoke([&](const Buffer::Instance&) -> void {
         GetMoreMessagePtr message(new GetMoreMessageImpl(0, 0));
         message->fullCollectionName("db.test");
         message->cursorId(1);
@@ -134,7 +152,7 @@ TEST_F(MongoProxyFilterTest, Stats) {
   filter_->onData(fake_data_);
 
   EXPECT_CALL(*filter_->decoder_, onData(_))
-      .WillOnce(Invoke([&](Buffer::Instance&) -> void {
+      .WillOnce(Invoke([&](const Buffer::Instance&) -> void {
         InsertMessagePtr message(new InsertMessageImpl(0, 0));
         message->fullCollectionName("db.test");
         message->documents().push_back(Bson::DocumentImpl::create());
@@ -143,7 +161,7 @@ TEST_F(MongoProxyFilterTest, Stats) {
   filter_->onData(fake_data_);
 
   EXPECT_CALL(*filter_->decoder_, onData(_))
-      .WillOnce(Invoke([&](Buffer::Instance&) -> void {
+      .WillOnce(Invoke([&](const Buffer::Instance&) -> void {
         KillCursorsMessagePtr message(new KillCursorsMessageImpl(0, 0));
         message->numberOfCursorIds(1);
         message->cursorIds({1});
@@ -156,9 +174,62 @@ TEST_F(MongoProxyFilterTest, Stats) {
   EXPECT_EQ(1U, store_.counter("test.op_kill_cursors").value());
 }
 
+TEST_F(MongoProxyFilterTest, AccessLogSampledOut) {
+  EXPECT_CALL(random_, random()).WillOnce(Return(42));
+  EXPECT_CALL(runtime_.snapshot_, featureEnabled("mongo.logging_sample_rate", 10000, 42, 10000))
+      .WillOnce(Return(false));
+  EXPECT_CALL(*file_, write(_)).Times(0);
+
+  EXPECT_CALL(*filter_->decoder_, onData(_))
+      .WillOnce(Invoke([&](const Buffer::Instance&) -> void {
+        GetMoreMessagePtr message(new GetMoreMessageImpl(0, 0));
+        message->fullCollectionName("db.test");
+        message->cursorId(1);
+        filter_->callbacks_->decodeGetMore(std::move(message));
+      }));
+  filter_->onData(fake_data_);
+
+  filter_.reset();
+  access_log_.reset();
+  EXPECT_EQ(1U, store_.counter("test.op_get_more").value());
+  EXPECT_EQ(1U, store_.counter("test.access_log.sampled_out").value());
+  EXPECT_EQ(0U, store_.counter("test.access_log.written").value());
+}
+
+TEST_F(MongoProxyFilterTest, AccessLogDropsWhenFull) {
+  std::shared_ptr<Filesystem::MockFile> file(new NiceMock<Filesystem::MockFile>());
+  EXPECT_CALL(log_manager_, createAccessLog(_)).WillOnce(Return(file));
+  std::unique_ptr<AccessLog> access_log(
+      new AccessLog("test", log_manager_, runtime_, random_, "test.full.", store_, 1));
+
+  // Hold the flush thread in its first write so that the queue fills up behind it.
+  std::promise<void> write_started;
+  std::promise<void> write_release;
+  std::shared_future<void> release = write_release.get_future().share();
+  EXPECT_CALL(*file, write(_))
+      .WillOnce(Invoke([&](const std::string&) -> void {
+        write_started.set_value();
+        release.wait();
+      }))
+      .WillOnce(Return());
+
+  access_log->logMessage(MessagePtr{new KillCursorsMessageImpl(1, 0)}, true, nullptr);
+  write_started.get_future().wait();
+
+  access_log->logMessage(MessagePtr{new KillCursorsMessageImpl(2, 0)}, true, nullptr);
+  access_log->logMessage(MessagePtr{new KillCursorsMessageImpl(3, 0)}, true, nullptr);
+  EXPECT_EQ(1U, store_.counter("test.full.dropped").value());
+  EXPECT_EQ(1U, store_.gauge("test.full.pending").value());
+
+  write_release.set_value();
+  access_log.reset();
+  EXPECT_EQ(2U, store_.counter("test.full.written").value());
+  EXPECT_EQ(0U, store_.gauge("test.full.pending").value());
+}
+
 TEST_F(MongoProxyFilterTest, CommandStats) {
   EXPECT_CALL(*filter_->decoder_, onData(_))
-      .WillOnce(Invoke([&](Buffer::Instance&) -> void {
+      .WillOnce(Invoke([&](const Buffer::Instance&) -> void {
         QueryMessagePtr message(new QueryMessageImpl(0, 0));
         message->fullCollectionName("db.$cmd");
         message->flags(0b1110010);
@@ -172,10 +243,11 @@ TEST_F(MongoProxyFilterTest, CommandStats) {
   EXPECT_CALL(store_, deliverTimingToSinks("test.cmd.foo.reply_time_ms", _));
 
   EXPECT_CALL(*filter_->decoder_, onData(_))
-      .WillOnce(Invoke([&](Buffer::Instance&) -> void {
+      .WillOnce(Invoke([&](const Buffer::Instance&) -> void {
         ReplyMessagePtr message(new ReplyMessageImpl(0, 0));
         message->flags(0b11);
         message->cursorId(1);
+        message->numberReturned(1);
         message->documents().push_back(Bson::DocumentImpl::create()->addString("hello", "world"));
         filter_->callbacks_->decodeReply(std::move(message));
       }));
@@ -194,7 +266,7 @@ TEST_F(MongoProxyFilterTest, CallingFunctionStats) {
   )EOF";
 
   EXPECT_CALL(*filter_->decoder_, onData(_))
-      .WillOnce(Invoke([&](Buffer::Instance&) -> void {
+      .WillOnce(Invoke([&](const Buffer::Instance&) -> void {
         QueryMessagePtr message(new QueryMessageImpl(0, 0));
         message->fullCollectionName("db.test");
         message->flags(0b1110010);
@@ -220,10 +292,11 @@ TEST_F(MongoProxyFilterTest, CallingFunctionStats) {
                           "test.collection.test.callsite.getByMongoId.query.reply_time_ms", _));
 
   EXPECT_CALL(*filter_->decoder_, onData(_))
-      .WillOnce(Invoke([&](Buffer::Instance&) -> void {
+      .WillOnce(Invoke([&](const Buffer::Instance&) -> void {
         ReplyMessagePtr message(new ReplyMessageImpl(0, 0));
         message->flags(0b11);
         message->cursorId(1);
+        message->numberReturned(1);
         message->documents().push_back(Bson::DocumentImpl::create()->addString("hello", "world"));
         filter_->callbacks_->decodeReply(std::move(message));
 
@@ -233,7 +306,7 @@ TEST_F(MongoProxyFilterTest, CallingFunctionStats) {
 
 TEST_F(MongoProxyFilterTest, MultiGet) {
   EXPECT_CALL(*filter_->decoder_, onData(_))
-      .WillOnce(Invoke([&](Buffer::Instance&) -> void {
+      .WillOnce(Invoke([&](const Buffer::Instance&) -> void {
         QueryMessagePtr message(new QueryMessageImpl(0, 0));
         message->fullCollectionName("db.test");
         message->flags(0b1110010);
@@ -249,7 +322,7 @@ TEST_F(MongoProxyFilterTest, MultiGet) {
 
 TEST_F(MongoProxyFilterTest, MaxTime) {
   EXPECT_CALL(*filter_->decoder_, onData(_))
-      .WillOnce(Invoke([&](Buffer::Instance&) -> void {
+      .WillOnce(Invoke([&](const Buffer::Instance&) -> void {
         QueryMessagePtr message(new QueryMessageImpl(0, 0));
         message->fullCollectionName("db.test");
         message->flags(0b1110010);
@@ -263,7 +336,8 @@ TEST_F(MongoProxyFilterTest, MaxTime) {
 
 TEST_F(MongoProxyFilterTest, DecodeError) {
   EXPECT_CALL(*filter_->decoder_, onData(_))
-      .WillOnce(Invoke([&](Buffer::Instance&) -> void { throw EnvoyException("bad decode"); }));
+      .WillOnce(Invoke(
+          [&](const Buffer::Instance&) -> void { throw EnvoyException("bad decode"); }));
   filter_->onData(fake_data_);
 
   // Should not call decode again.
@@ -274,7 +348,7 @@ TEST_F(MongoProxyFilterTest, DecodeError) {
 
 TEST_F(MongoProxyFilterTest, ConcurrentQuery) {
   EXPECT_CALL(*filter_->decoder_, onData(_))
-      .WillOnce(Invoke([&](Buffer::Instance&) -> void {
+      .WillOnce(Invoke([&](const Buffer::Instance&) -> void {
         QueryMessagePtr message(new QueryMessageImpl(1, 0));
         message->fullCollectionName("db.test");
         message->flags(0b1110010);
@@ -291,16 +365,18 @@ TEST_F(MongoProxyFilterTest, ConcurrentQuery) {
   EXPECT_EQ(2U, store_.gauge("test.op_query_active").value());
 
   EXPECT_CALL(*filter_->decoder_, onData(_))
-      .WillOnce(Invoke([&](Buffer::Instance&) -> void {
+      .WillOnce(Invoke([&](const Buffer::Instance&) -> void {
         ReplyMessagePtr message(new ReplyMessageImpl(0, 1));
         message->flags(0b11);
         message->cursorId(1);
+        message->numberReturned(1);
         message->documents().push_back(Bson::DocumentImpl::create()->addString("hello", "world"));
         filter_->callbacks_->decodeReply(std::move(message));
 
         message.reset(new ReplyMessageImpl(0, 2));
         message->flags(0b11);
         message->cursorId(1);
+        message->numberReturned(1);
         message->documents().push_back(Bson::DocumentImpl::create()->addString("hello", "world"));
         filter_->callbacks_->decodeReply(std::move(message));
       }));
@@ -310,7 +386,7 @@ TEST_F(MongoProxyFilterTest, ConcurrentQuery) {
 
 TEST_F(MongoProxyFilterTest, EmptyActiveQueryList) {
   EXPECT_CALL(*filter_->decoder_, onData(_))
-      .WillOnce(Invoke([&](Buffer::Instance&) -> void {
+      .WillOnce(Invoke([&](const Buffer::Instance&) -> void {
         QueryMessagePtr message(new QueryMessageImpl(0, 0));
         message->fullCollectionName("db.$cmd");
         message->flags(0b1110010);
@@ -320,10 +396,11 @@ TEST_F(MongoProxyFilterTest, EmptyActiveQueryList) {
   filter_->onData(fake_data_);
 
   EXPECT_CALL(*filter_->decoder_, onData(_))
-      .WillOnce(Invoke([&](Buffer::Instance&) -> void {
+      .WillOnce(Invoke([&](const Buffer::Instance&) -> void {
         ReplyMessagePtr message(new ReplyMessageImpl(0, 0));
         message->flags(0b11);
         message->cursorId(1);
+        message->numberReturned(1);
         message->documents().push_back(Bson::DocumentImpl::create()->addString("hello", "world"));
         filter_->callbacks_->decodeReply(std::move(message));
       }));
@@ -335,7 +412,7 @@ TEST_F(MongoProxyFilterTest, EmptyActiveQueryList) {
 
 TEST_F(MongoProxyFilterTest, ConnectionDestroyLocal) {
   EXPECT_CALL(*filter_->decoder_, onData(_))
-      .WillOnce(Invoke([&](Buffer::Instance&) -> void {
+      .WillOnce(Invoke([&](const Buffer::Instance&) -> void {
         QueryMessagePtr message(new QueryMessageImpl(0, 0));
         message->fullCollectionName("db.test");
         message->flags(0b1110010);
@@ -352,7 +429,7 @@ TEST_F(MongoProxyFilterTest, ConnectionDestroyLocal) {
 
 TEST_F(MongoProxyFilterTest, ConnectionDestroyRemote) {
   EXPECT_CALL(*filter_->decoder_, onData(_))
-      .WillOnce(Invoke([&](Buffer::Instance&) -> void {
+      .WillOnce(Invoke([&](const Buffer::Instance&) -> void {
         QueryMessagePtr message(new QueryMessageImpl(0, 0));
         message->fullCollectionName("db.test");
         message->flags(0b1110010);
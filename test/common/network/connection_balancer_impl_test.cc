@@ -0,0 +1,61 @@
+#include "common/network/connection_balancer_impl.h"
+
+#include "test/mocks/network/mocks.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace Envoy {
+using testing::_;
+using testing::NiceMock;
+using testing::Return;
+
+namespace Network {
+
+class ConnectionBalancerImplTest : public testing::Test {
+public:
+  ConnectionBalancerImplTest() {
+    balancer_.registerHandler(handler1_);
+    balancer_.registerHandler(handler2_);
+    balancer_.registerHandler(handler3_);
+  }
+
+  ConnectionBalancerImpl balancer_;
+  NiceMock<MockBalancedConnectionHandler> handler1_;
+  NiceMock<MockBalancedConnectionHandler> handler2_;
+  NiceMock<MockBalancedConnectionHandler> handler3_;
+  sockaddr_storage remote_addr_{};
+};
+
+TEST_F(ConnectionBalancerImplTest, LeastConnections) {
+  ON_CALL(handler1_, numConnections()).WillByDefault(Return(5));
+  ON_CALL(handler2_, numConnections()).WillByDefault(Return(3));
+  ON_CALL(handler3_, numConnections()).WillByDefault(Return(1));
+
+  const sockaddr* remote_addr = reinterpret_cast<const sockaddr*>(&remote_addr_);
+  EXPECT_CALL(handler3_, post(10, remote_addr, 16));
+  EXPECT_TRUE(balancer_.balance(handler1_, 10, remote_addr, 16));
+
+  // The accepting handler keeps the connection if no other handler has fewer connections.
+  EXPECT_CALL(handler1_, post(_, _, _)).Times(0);
+  EXPECT_CALL(handler2_, post(_, _, _)).Times(0);
+  EXPECT_FALSE(balancer_.balance(handler3_, 11, remote_addr, 16));
+
+  ON_CALL(handler1_, numConnections()).WillByDefault(Return(1));
+  EXPECT_FALSE(balancer_.balance(handler1_, 12, remote_addr, 16));
+}
+
+TEST_F(ConnectionBalancerImplTest, Unregister) {
+  ON_CALL(handler1_, numConnections()).WillByDefault(Return(5));
+  ON_CALL(handler2_, numConnections()).WillByDefault(Return(3));
+  ON_CALL(handler3_, numConnections()).WillByDefault(Return(1));
+  balancer_.unregisterHandler(handler3_);
+
+  const sockaddr* remote_addr = reinterpret_cast<const sockaddr*>(&remote_addr_);
+  EXPECT_CALL(handler3_, post(_, _, _)).Times(0);
+  EXPECT_CALL(handler2_, post(10, remote_addr, 16));
+  EXPECT_TRUE(balancer_.balance(handler1_, 10, remote_addr, 16));
+}
+
+} // Network
+} // Envoy
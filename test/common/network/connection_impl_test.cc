@@ -1,3 +1,7 @@
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -11,6 +15,7 @@
 #include "common/network/utility.h"
 #include "common/stats/stats_impl.h"
 
+#include "test/mocks/buffer/mocks.h"
 #include "test/mocks/network/mocks.h"
 #include "test/mocks/server/mocks.h"
 #include "test/mocks/stats/mocks.h"
@@ -26,6 +31,7 @@ using testing::_;
 using testing::Sequence;
 using testing::InSequence;
 using testing::Invoke;
+using testing::NiceMock;
 using testing::Return;
 using testing::StrictMock;
 using testing::Test;
@@ -55,6 +61,44 @@ TEST(ConnectionImplUtility, updateBufferStats) {
   ConnectionImplUtility::updateBufferStats(3, 3, previous_total, counter, gauge);
 }
 
+TEST(ConnectionImplUtility, readRequestSize) {
+  EXPECT_EQ(16384UL, ConnectionImplUtility::readRequestSize(16384, 0, 100000));
+  EXPECT_EQ(16384UL, ConnectionImplUtility::readRequestSize(16384, 32768, 0));
+  EXPECT_EQ(8192UL, ConnectionImplUtility::readRequestSize(16384, 32768, 24576));
+  EXPECT_EQ(ConnectionImplUtility::MinReadSize,
+            ConnectionImplUtility::readRequestSize(16384, 32768, 32000));
+  EXPECT_EQ(16384UL, ConnectionImplUtility::readRequestSize(16384, 32768, 32768));
+}
+
+TEST(ConnectionImplUtility, updateReadSize) {
+  uint64_t read_size = ConnectionImplUtility::DefaultReadSize;
+
+  // Full reads grow the read size up to the maximum.
+  ConnectionImplUtility::updateReadSize(16384, 16384, read_size);
+  EXPECT_EQ(32768UL, read_size);
+  while (read_size < ConnectionImplUtility::MaxReadSize) {
+    ConnectionImplUtility::updateReadSize(read_size, read_size, read_size);
+  }
+  ConnectionImplUtility::updateReadSize(read_size, read_size, read_size);
+  EXPECT_EQ(ConnectionImplUtility::MaxReadSize, read_size);
+
+  // A full read of a request that was capped by the buffer limit does not grow the read size, and
+  // neither does a partial read.
+  read_size = 16384;
+  ConnectionImplUtility::updateReadSize(8192, 8192, read_size);
+  EXPECT_EQ(16384UL, read_size);
+  ConnectionImplUtility::updateReadSize(16384, 8192, read_size);
+  EXPECT_EQ(16384UL, read_size);
+
+  // Small reads shrink the read size down to the minimum.
+  ConnectionImplUtility::updateReadSize(16384, 100, read_size);
+  EXPECT_EQ(8192UL, read_size);
+  for (int i = 0; i < 10; i++) {
+    ConnectionImplUtility::updateReadSize(read_size, 100, read_size);
+  }
+  EXPECT_EQ(ConnectionImplUtility::MinReadSize, read_size);
+}
+
 class ConnectionImplDeathTest : public testing::TestWithParam<Address::IpVersion> {};
 INSTANTIATE_TEST_CASE_P(IpVersions, ConnectionImplDeathTest,
                         testing::ValuesIn(TestEnvironment::getIpVersionsForTest()));
@@ -189,6 +233,167 @@ TEST_P(ConnectionImplTest, BufferStats) {
   dispatcher.run(Event::Dispatcher::RunType::Block);
 }
 
+class ConnectionImplWatermarkTest : public testing::Test {
+public:
+  ConnectionImplWatermarkTest() {
+    int fds[2];
+    RELEASE_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    RELEASE_ASSERT(fcntl(fds[0], F_SETFL, O_NONBLOCK) == 0);
+    peer_fd_ = fds[1];
+    Address::InstanceConstSharedPtr address = Utility::resolveUrl("tcp://127.0.0.1:0");
+    connection_.reset(new ConnectionImpl(dispatcher_, fds[0], address, address));
+    connection_->addConnectionCallbacks(callbacks_);
+  }
+
+  ~ConnectionImplWatermarkTest() {
+    connection_->close(ConnectionCloseType::NoFlush);
+    ::close(peer_fd_);
+  }
+
+  Event::DispatcherImpl dispatcher_;
+  int peer_fd_;
+  ConnectionPtr connection_;
+  NiceMock<MockConnectionCallbacks> callbacks_;
+};
+
+TEST_F(ConnectionImplWatermarkTest, WriteBufferWatermarks) {
+  connection_->setReadBufferLimit(10);
+
+  // Buffering up to the limit does not cross the high watermark.
+  Buffer::OwnedImpl data("0123456789");
+  EXPECT_CALL(callbacks_, onAboveWriteBufferHighWatermark()).Times(0);
+  connection_->write(data);
+
+  // Going over it does, but only once.
+  EXPECT_CALL(callbacks_, onAboveWriteBufferHighWatermark());
+  data.add("a");
+  connection_->write(data);
+  data.add("b");
+  connection_->write(data);
+
+  // Flushing to the socket drains below the low watermark.
+  EXPECT_CALL(callbacks_, onBelowWriteBufferLowWatermark());
+  dispatcher_.run(Event::Dispatcher::RunType::NonBlock);
+}
+
+TEST_F(ConnectionImplWatermarkTest, ReadDisableIsCounted) {
+  EXPECT_TRUE(connection_->readEnabled());
+  connection_->readDisable(true);
+  connection_->readDisable(true);
+  EXPECT_FALSE(connection_->readEnabled());
+  connection_->readDisable(false);
+  EXPECT_FALSE(connection_->readEnabled());
+  connection_->readDisable(false);
+  EXPECT_TRUE(connection_->readEnabled());
+}
+
+#ifdef __linux__
+class ConnectionImplSpliceTest : public testing::Test {
+public:
+  ConnectionImplSpliceTest() {
+    Address::InstanceConstSharedPtr address = Utility::resolveUrl("tcp://127.0.0.1:0");
+    source_ = createConnection(source_peer_fd_, address);
+    destination_ = createConnection(destination_peer_fd_, address);
+  }
+
+  ~ConnectionImplSpliceTest() {
+    source_->close(ConnectionCloseType::NoFlush);
+    destination_->close(ConnectionCloseType::NoFlush);
+    ::close(source_peer_fd_);
+    ::close(destination_peer_fd_);
+  }
+
+  ConnectionPtr createConnection(int& peer_fd, Address::InstanceConstSharedPtr address) {
+    int fds[2];
+    RELEASE_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    RELEASE_ASSERT(fcntl(fds[0], F_SETFL, O_NONBLOCK) == 0);
+    peer_fd = fds[1];
+    return ConnectionPtr{new ConnectionImpl(dispatcher_, fds[0], address, address)};
+  }
+
+  std::string readPeer(int fd, size_t length) {
+    std::string data(length, 0);
+    size_t offset = 0;
+    while (offset < length) {
+      dispatcher_.run(Event::Dispatcher::RunType::NonBlock);
+      ssize_t rc = recv(fd, &data[offset], length - offset, MSG_DONTWAIT);
+      if (rc > 0) {
+        offset += rc;
+      }
+    }
+    return data;
+  }
+
+  Event::DispatcherImpl dispatcher_;
+  Stats::IsolatedStoreImpl stats_store_;
+  int source_peer_fd_;
+  int destination_peer_fd_;
+  ConnectionPtr source_;
+  ConnectionPtr destination_;
+};
+
+TEST_F(ConnectionImplSpliceTest, Splice) {
+  std::shared_ptr<MockReadFilter> read_filter(new StrictMock<MockReadFilter>());
+  source_->addReadFilter(read_filter);
+  Stats::Counter& bytes_spliced = stats_store_.counter("spliced");
+  EXPECT_TRUE(source_->spliceTo(*destination_, bytes_spliced));
+
+  // Data that was already buffered is written before spliced data.
+  Buffer::OwnedImpl buffered("hello ");
+  destination_->write(buffered);
+  ASSERT_EQ(5, ::write(source_peer_fd_, "world", 5));
+  EXPECT_EQ("hello world", readPeer(destination_peer_fd_, 11));
+  EXPECT_EQ(5U, bytes_spliced.value());
+
+  std::string large(1024 * 1024, 'a');
+  size_t written = 0;
+  std::string received;
+  while (received.size() < large.size()) {
+    if (written < large.size()) {
+      ssize_t rc = send(source_peer_fd_, large.data() + written, large.size() - written,
+                        MSG_DONTWAIT);
+      if (rc > 0) {
+        written += rc;
+      }
+    }
+    dispatcher_.run(Event::Dispatcher::RunType::NonBlock);
+    char chunk[16384];
+    ssize_t rc = recv(destination_peer_fd_, chunk, sizeof(chunk), MSG_DONTWAIT);
+    if (rc > 0) {
+      received.append(chunk, rc);
+    }
+  }
+  EXPECT_EQ(large, received);
+  EXPECT_EQ(5U + large.size(), bytes_spliced.value());
+
+  // Once the destination closes, data goes through the read filters again.
+  destination_->close(ConnectionCloseType::NoFlush);
+  EXPECT_CALL(*read_filter, onNewConnection()).WillOnce(Return(FilterStatus::Continue));
+  EXPECT_CALL(*read_filter, onData(BufferStringEqual("again")))
+      .WillOnce(Invoke([&](Buffer::Instance& data) -> FilterStatus {
+        data.drain(data.length());
+        dispatcher_.exit();
+        return FilterStatus::StopIteration;
+      }));
+  ASSERT_EQ(5, ::write(source_peer_fd_, "again", 5));
+  dispatcher_.run(Event::Dispatcher::RunType::Block);
+}
+
+TEST_F(ConnectionImplSpliceTest, NotAllowedWithOtherReadFilters) {
+  Stats::Counter& bytes_spliced = stats_store_.counter("spliced");
+  source_->addReadFilter(ReadFilterSharedPtr{new NiceMock<MockReadFilter>()});
+  source_->addReadFilter(ReadFilterSharedPtr{new NiceMock<MockReadFilter>()});
+  EXPECT_FALSE(source_->spliceTo(*destination_, bytes_spliced));
+}
+
+TEST_F(ConnectionImplSpliceTest, NotAllowedWithWriteFilters) {
+  Stats::Counter& bytes_spliced = stats_store_.counter("spliced");
+  destination_->addWriteFilter(WriteFilterSharedPtr{new NiceMock<MockWriteFilter>()});
+  EXPECT_FALSE(source_->spliceTo(*destination_, bytes_spliced));
+  EXPECT_FALSE(source_->spliceTo(*source_, bytes_spliced));
+}
+#endif
+
 class ReadBufferLimitTest : public testing::TestWithParam<Network::Address::IpVersion> {
 public:
   void readBufferLimitTest(uint32_t read_buffer_limit, uint32_t expected_chunk_size) {
@@ -204,7 +409,10 @@ public:
                                   {.bind_to_port_ = true,
                                    .use_proxy_proto_ = false,
                                    .use_original_dst_ = false,
-                                   .per_connection_buffer_limit_bytes_ = read_buffer_limit});
+                                   .per_connection_buffer_limit_bytes_ = read_buffer_limit,
+                                   .connection_balancer_ = nullptr,
+                                   .inspect_tls_client_hello_ = false,
+                                   .socket_options_ = nullptr});
 
     Network::ClientConnectionPtr client_connection =
         dispatcher.createClientConnection(socket.localAddress());
@@ -288,5 +496,62 @@ TEST_P(TcpClientConnectionImplTest, BadConnectConnRefused) {
   dispatcher.run(Event::Dispatcher::RunType::Block);
 }
 
+// Validate that a connection that fails to connect to its remote address connects to an alternate
+// address instead.
+TEST_P(TcpClientConnectionImplTest, AlternateAddress) {
+  Stats::IsolatedStoreImpl stats_store;
+  Event::DispatcherImpl dispatcher;
+  Network::TcpListenSocket socket(Network::Test::getAnyAddress(GetParam()), true);
+  Network::MockListenerCallbacks listener_callbacks;
+  Network::MockConnectionHandler connection_handler;
+  Network::ListenerPtr listener =
+      dispatcher.createListener(connection_handler, socket, listener_callbacks, stats_store,
+                                Network::ListenerOptions::listenerOptionsWithBindToPort());
+
+  ClientConnectionPtr connection = dispatcher.createClientConnection(Utility::resolveUrl(
+      fmt::format("tcp://{}:1", Network::Test::getLoopbackAddressUrlString(GetParam()))));
+  connection->setAlternateAddresses({socket.localAddress()});
+  MockConnectionCallbacks client_callbacks;
+  connection->addConnectionCallbacks(client_callbacks);
+  connection->connect();
+  connection->noDelay(true);
+
+  EXPECT_CALL(client_callbacks, onEvent(ConnectionEvent::Connected))
+      .WillOnce(Invoke([&](uint32_t) -> void {
+        EXPECT_EQ(*socket.localAddress(), connection->remoteAddress());
+        connection->close(ConnectionCloseType::NoFlush);
+      }));
+  EXPECT_CALL(client_callbacks, onEvent(ConnectionEvent::LocalClose));
+
+  Network::ConnectionPtr server_connection;
+  Network::MockConnectionCallbacks server_callbacks;
+  EXPECT_CALL(listener_callbacks, onNewConnection_(_))
+      .WillOnce(Invoke([&](Network::ConnectionPtr& conn) -> void {
+        server_connection = std::move(conn);
+        server_connection->addConnectionCallbacks(server_callbacks);
+      }));
+  EXPECT_CALL(server_callbacks, onEvent(ConnectionEvent::RemoteClose))
+      .WillOnce(Invoke([&](uint32_t) -> void { dispatcher.exit(); }));
+
+  dispatcher.run(Event::Dispatcher::RunType::Block);
+}
+
+// Validate that a single close event is raised once every address has failed.
+TEST_P(TcpClientConnectionImplTest, AllAlternateAddressesFail) {
+  Event::DispatcherImpl dispatcher;
+  const std::string loopback = Network::Test::getLoopbackAddressUrlString(GetParam());
+  ClientConnectionPtr connection = dispatcher.createClientConnection(
+      Utility::resolveUrl(fmt::format("tcp://{}:1", loopback)));
+  connection->setAlternateAddresses({Utility::resolveUrl(fmt::format("tcp://{}:2", loopback)),
+                                     Utility::resolveUrl(fmt::format("tcp://{}:3", loopback))});
+  MockConnectionCallbacks client_callbacks;
+  connection->addConnectionCallbacks(client_callbacks);
+  connection->connect();
+
+  EXPECT_CALL(client_callbacks, onEvent(ConnectionEvent::RemoteClose))
+      .WillOnce(Invoke([&](uint32_t) -> void { dispatcher.exit(); }));
+  dispatcher.run(Event::Dispatcher::RunType::Block);
+}
+
 } // Network
 } // Envoy
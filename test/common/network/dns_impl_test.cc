@@ -18,7 +18,9 @@
 #include "common/network/listen_socket_impl.h"
 #include "common/network/utility.h"
 #include "common/stats/stats_impl.h"
+#include "common/thread_local/thread_local_impl.h"
 
+#include "test/mocks/common.h"
 #include "test/mocks/network/mocks.h"
 #include "test/test_common/environment.h"
 #include "test/test_common/network_utility.h"
@@ -26,8 +28,12 @@
 
 #include "ares.h"
 #include "ares_dns.h"
+#include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
+using testing::Invoke;
+using testing::NiceMock;
+
 namespace Envoy {
 namespace Network {
 
@@ -43,8 +49,10 @@ enum record_type { A, AAAA };
 
 class TestDnsServerQuery {
 public:
-  TestDnsServerQuery(ConnectionPtr connection, const HostMap& hosts_A, const HostMap& hosts_AAAA)
-      : connection_(std::move(connection)), hosts_A_(hosts_A), hosts_AAAA_(hosts_AAAA) {
+  TestDnsServerQuery(ConnectionPtr connection, const HostMap& hosts_A, const HostMap& hosts_AAAA,
+                     const uint32_t& ttl, uint32_t& query_count)
+      : connection_(std::move(connection)), hosts_A_(hosts_A), hosts_AAAA_(hosts_AAAA), ttl_(ttl),
+        query_count_(query_count) {
     connection_->addReadFilter(Network::ReadFilterSharedPtr{new ReadFilter(*this)});
   }
 
@@ -86,6 +94,7 @@ private:
         unsigned char* request = static_cast<unsigned char*>(buffer_.linearize(size_));
         // Only expecting a single question.
         ASSERT_EQ(1, DNS_HEADER_QDCOUNT(request));
+        parent_.query_count_++;
         // Decode the question and perform lookup.
         const unsigned char* question = request + HFIXEDSZ;
         // The number of bytes the encoded question name takes up in the request.
@@ -137,7 +146,7 @@ private:
           DNS_RR_SET_LEN(response_rr_fixed, sizeof(in6_addr));
         }
         DNS_RR_SET_CLASS(response_rr_fixed, C_IN);
-        DNS_RR_SET_TTL(response_rr_fixed, 0);
+        DNS_RR_SET_TTL(response_rr_fixed, parent_.ttl_);
 
         size_t response_rest_len;
         if (q_type == T_A) {
@@ -188,13 +197,16 @@ private:
   ConnectionPtr connection_;
   const HostMap& hosts_A_;
   const HostMap& hosts_AAAA_;
+  const uint32_t& ttl_;
+  uint32_t& query_count_;
 };
 
 class TestDnsServer : public ListenerCallbacks {
 public:
   void onNewConnection(ConnectionPtr&& new_connection) override {
     TestDnsServerQuery* query =
-        new TestDnsServerQuery(std::move(new_connection), hosts_A_, hosts_AAAA_);
+        new TestDnsServerQuery(std::move(new_connection), hosts_A_, hosts_AAAA_, ttl_,
+                               query_count_);
     queries_.emplace_back(query);
   }
 
@@ -206,9 +218,16 @@ public:
     }
   }
 
+  // Set the TTL of the records in subsequent responses.
+  void setTtl(uint32_t ttl) { ttl_ = ttl; }
+  // @return the number of questions that have been answered.
+  uint32_t queryCount() const { return query_count_; }
+
 private:
   HostMap hosts_A_;
   HostMap hosts_AAAA_;
+  uint32_t ttl_{};
+  uint32_t query_count_{};
   // All queries are tracked so we can do resource reclamation when the test is
   // over.
   std::vector<std::unique_ptr<TestDnsServerQuery>> queries_;
@@ -220,6 +239,8 @@ public:
   DnsResolverImplPeer(DnsResolverImpl* resolver) : resolver_(resolver) {}
   ares_channel channel() const { return resolver_->channel_; }
   const std::unordered_map<int, Event::FileEventPtr>& events() { return resolver_->events_; }
+  void setTimeSource(MonotonicTimeSource& time_source) { resolver_->time_source_ = &time_source; }
+  size_t pendingResolutions() const { return resolver_->pending_resolutions_.size(); }
   // Reset the channel state for a DnsResolverImpl such that it will only use
   // TCP and optionally has a zero timeout (for validating timeout behavior).
   void resetChannelTcpOnly(bool zero_timeout) {
@@ -267,7 +288,7 @@ TEST(DnsImplConstructor, SupportsCustomResolvers) {
 class DnsImplTest : public testing::TestWithParam<Address::IpVersion> {
 public:
   void SetUp() override {
-    resolver_ = dispatcher_.createDnsResolver({});
+    resolver_.reset(new DnsResolverImpl(dispatcher_, {}, cache_));
 
     // Instantiate TestDnsServer and listen on a random port on the loopback address.
     server_.reset(new TestDnsServer());
@@ -277,12 +298,17 @@ public:
                                            {.bind_to_port_ = true,
                                             .use_proxy_proto_ = false,
                                             .use_original_dst_ = false,
-                                            .per_connection_buffer_limit_bytes_ = 0});
+                                            .per_connection_buffer_limit_bytes_ = 0,
+                                            .connection_balancer_ = nullptr,
+                                            .inspect_tls_client_hello_ = false,
+                                            .socket_options_ = nullptr});
 
     // Point c-ares at the listener with no search domains and TCP-only.
     peer_.reset(new DnsResolverImplPeer(dynamic_cast<DnsResolverImpl*>(resolver_.get())));
     peer_->resetChannelTcpOnly(zero_timeout());
     ares_set_servers_ports_csv(peer_->channel(), socket_->localAddress()->asString().c_str());
+    ON_CALL(time_source_, currentTime()).WillByDefault(Invoke([this]() { return now_; }));
+    peer_->setTimeSource(time_source_);
   }
 
   void TearDown() override {
@@ -301,7 +327,10 @@ protected:
   Stats::IsolatedStoreImpl stats_store_;
   std::unique_ptr<Network::Listener> listener_;
   Event::DispatcherImpl dispatcher_;
+  DnsCacheSharedPtr cache_{new DnsCacheImpl()};
   DnsResolverSharedPtr resolver_;
+  NiceMock<MockMonotonicTimeSource> time_source_;
+  MonotonicTime now_;
 };
 
 static bool hasAddress(const std::list<Address::InstanceConstSharedPtr>& results,
@@ -547,6 +576,218 @@ TEST_P(DnsImplTest, Cancel) {
   EXPECT_TRUE(hasAddress(address_list, "201.134.56.7"));
 }
 
+// Validate that results are cached for the TTL of the records and that the non existence of a
+// name is cached as well.
+TEST_P(DnsImplTest, CachedLookup) {
+  server_->addHosts("some.good.domain", {"201.134.56.7"}, A);
+  server_->setTtl(30);
+  std::list<Address::InstanceConstSharedPtr> address_list;
+  EXPECT_NE(nullptr,
+            resolver_->resolve("some.good.domain", DnsLookupFamily::V4Only,
+                               [&](std::list<Address::InstanceConstSharedPtr>&& results) -> void {
+                                 address_list = results;
+                                 dispatcher_.exit();
+                               }));
+
+  dispatcher_.run(Event::Dispatcher::RunType::Block);
+  EXPECT_TRUE(hasAddress(address_list, "201.134.56.7"));
+  EXPECT_EQ(1U, server_->queryCount());
+
+  address_list.clear();
+  now_ += std::chrono::seconds(29);
+  EXPECT_EQ(nullptr, resolver_->resolve("some.good.domain", DnsLookupFamily::V4Only,
+                                        [&](std::list<Address::InstanceConstSharedPtr>&& results)
+                                            -> void { address_list = results; }));
+  EXPECT_TRUE(hasAddress(address_list, "201.134.56.7"));
+
+  EXPECT_NE(nullptr,
+            resolver_->resolve("some.bad.domain", DnsLookupFamily::V4Only,
+                               [&](std::list<Address::InstanceConstSharedPtr>&& results) -> void {
+                                 address_list = results;
+                                 dispatcher_.exit();
+                               }));
+
+  dispatcher_.run(Event::Dispatcher::RunType::Block);
+  EXPECT_TRUE(address_list.empty());
+
+  address_list.push_back(nullptr);
+  EXPECT_EQ(nullptr, resolver_->resolve("some.bad.domain", DnsLookupFamily::V4Only,
+                                        [&](std::list<Address::InstanceConstSharedPtr>&& results)
+                                            -> void { address_list = results; }));
+  EXPECT_TRUE(address_list.empty());
+  EXPECT_EQ(2U, server_->queryCount());
+
+  // The negative entry expires without being served stale.
+  now_ += DnsResolverImpl::NegativeCacheTtl;
+  EXPECT_NE(nullptr,
+            resolver_->resolve("some.bad.domain", DnsLookupFamily::V4Only,
+                               [&](std::list<Address::InstanceConstSharedPtr>&& results) -> void {
+                                 address_list = results;
+                                 dispatcher_.exit();
+                               }));
+
+  dispatcher_.run(Event::Dispatcher::RunType::Block);
+  EXPECT_EQ(3U, server_->queryCount());
+}
+
+// Validate that an expired entry is served while it is refreshed in the background, and that it
+// is no longer served once it is too stale.
+TEST_P(DnsImplTest, StaleWhileRevalidate) {
+  server_->addHosts("some.good.domain", {"201.134.56.7"}, A);
+  server_->setTtl(30);
+  std::list<Address::InstanceConstSharedPtr> address_list;
+  EXPECT_NE(nullptr,
+            resolver_->resolve("some.good.domain", DnsLookupFamily::V4Only,
+                               [&](std::list<Address::InstanceConstSharedPtr>&& results) -> void {
+                                 address_list = results;
+                                 dispatcher_.exit();
+                               }));
+
+  dispatcher_.run(Event::Dispatcher::RunType::Block);
+  EXPECT_TRUE(hasAddress(address_list, "201.134.56.7"));
+
+  server_->addHosts("some.good.domain", {"123.4.5.6"}, A);
+  now_ += std::chrono::seconds(30);
+  EXPECT_EQ(nullptr, resolver_->resolve("some.good.domain", DnsLookupFamily::V4Only,
+                                        [&](std::list<Address::InstanceConstSharedPtr>&& results)
+                                            -> void { address_list = results; }));
+  EXPECT_TRUE(hasAddress(address_list, "201.134.56.7"));
+  EXPECT_EQ(1U, peer_->pendingResolutions());
+  while (peer_->pendingResolutions() > 0) {
+    dispatcher_.run(Event::Dispatcher::RunType::NonBlock);
+  }
+
+  EXPECT_EQ(nullptr, resolver_->resolve("some.good.domain", DnsLookupFamily::V4Only,
+                                        [&](std::list<Address::InstanceConstSharedPtr>&& results)
+                                            -> void { address_list = results; }));
+  EXPECT_TRUE(hasAddress(address_list, "123.4.5.6"));
+  EXPECT_EQ(2U, server_->queryCount());
+
+  now_ += std::chrono::seconds(30) + DnsResolverImpl::MaxStaleTime;
+  EXPECT_NE(nullptr,
+            resolver_->resolve("some.good.domain", DnsLookupFamily::V4Only,
+                               [&](std::list<Address::InstanceConstSharedPtr>&& results) -> void {
+                                 address_list = results;
+                                 dispatcher_.exit();
+                               }));
+
+  dispatcher_.run(Event::Dispatcher::RunType::Block);
+  EXPECT_EQ(3U, server_->queryCount());
+}
+
+// Validate that concurrent resolutions of the same name share a single query.
+TEST_P(DnsImplTest, CoalescedLookup) {
+  server_->addHosts("some.good.domain", {"201.134.56.7"}, A);
+  std::list<Address::InstanceConstSharedPtr> address_list1;
+  std::list<Address::InstanceConstSharedPtr> address_list2;
+  ActiveDnsQuery* query =
+      resolver_->resolve("some.good.domain", DnsLookupFamily::V4Only,
+                         [](std::list<Address::InstanceConstSharedPtr> && ) -> void { FAIL(); });
+  EXPECT_NE(nullptr,
+            resolver_->resolve("some.good.domain", DnsLookupFamily::V4Only,
+                               [&](std::list<Address::InstanceConstSharedPtr>&& results) -> void {
+                                 address_list1 = results;
+                               }));
+  EXPECT_NE(nullptr,
+            resolver_->resolve("some.good.domain", DnsLookupFamily::V4Only,
+                               [&](std::list<Address::InstanceConstSharedPtr>&& results) -> void {
+                                 address_list2 = results;
+                                 dispatcher_.exit();
+                               }));
+
+  ASSERT_NE(nullptr, query);
+  query->cancel();
+
+  dispatcher_.run(Event::Dispatcher::RunType::Block);
+  EXPECT_TRUE(hasAddress(address_list1, "201.134.56.7"));
+  EXPECT_TRUE(hasAddress(address_list2, "201.134.56.7"));
+  EXPECT_EQ(1U, server_->queryCount());
+}
+
+// Validate that resolvers sharing a cache, e.g. on different workers, share one query and its
+// result, which the other resolver is handed on its own dispatcher.
+TEST_P(DnsImplTest, SharedCache) {
+  server_->addHosts("some.good.domain", {"201.134.56.7"}, A);
+  Event::DispatcherImpl dispatcher2;
+  DnsResolverImpl resolver2(dispatcher2, {}, cache_);
+  DnsResolverImplPeer(&resolver2).setTimeSource(time_source_);
+  std::list<Address::InstanceConstSharedPtr> address_list1;
+  std::list<Address::InstanceConstSharedPtr> address_list2;
+  EXPECT_NE(nullptr,
+            resolver_->resolve("some.good.domain", DnsLookupFamily::V4Only,
+                               [&](std::list<Address::InstanceConstSharedPtr>&& results) -> void {
+                                 address_list1 = results;
+                                 dispatcher_.exit();
+                               }));
+  EXPECT_NE(nullptr,
+            resolver2.resolve("some.good.domain", DnsLookupFamily::V4Only,
+                              [&](std::list<Address::InstanceConstSharedPtr>&& results) -> void {
+                                address_list2 = results;
+                              }));
+
+  dispatcher_.run(Event::Dispatcher::RunType::Block);
+  EXPECT_TRUE(hasAddress(address_list1, "201.134.56.7"));
+  EXPECT_TRUE(address_list2.empty());
+  dispatcher2.run(Event::Dispatcher::RunType::NonBlock);
+  EXPECT_TRUE(hasAddress(address_list2, "201.134.56.7"));
+  EXPECT_EQ(1U, server_->queryCount());
+
+  address_list2.clear();
+  EXPECT_EQ(nullptr, resolver2.resolve("some.good.domain", DnsLookupFamily::V4Only,
+                                       [&](std::list<Address::InstanceConstSharedPtr>&& results)
+                                           -> void { address_list2 = results; }));
+  EXPECT_TRUE(hasAddress(address_list2, "201.134.56.7"));
+  EXPECT_EQ(1U, server_->queryCount());
+}
+
+// Validate that a resolver that goes away while it waits for another resolver is not called
+// back, and that resolvers waiting for a resolver that goes away are handed a failure.
+TEST_P(DnsImplTest, SharedCacheResolverDestroyed) {
+  server_->addHosts("some.good.domain", {"201.134.56.7"}, A);
+  Event::DispatcherImpl dispatcher2;
+  std::unique_ptr<DnsResolverImpl> resolver2(new DnsResolverImpl(dispatcher2, {}, cache_));
+  EXPECT_NE(nullptr,
+            resolver_->resolve("some.good.domain", DnsLookupFamily::V4Only,
+                               [&](std::list<Address::InstanceConstSharedPtr> &&) -> void {
+                                 dispatcher_.exit();
+                               }));
+  EXPECT_NE(nullptr, resolver2->resolve("some.good.domain", DnsLookupFamily::V4Only,
+                                        [](std::list<Address::InstanceConstSharedPtr> && ) -> void {
+                                          FAIL();
+                                        }));
+
+  dispatcher_.run(Event::Dispatcher::RunType::Block);
+  resolver2.reset();
+  dispatcher2.run(Event::Dispatcher::RunType::NonBlock);
+
+  resolver2.reset(new DnsResolverImpl(dispatcher2, {}, cache_));
+  bool failed = false;
+  EXPECT_NE(nullptr, resolver_->resolve("some.other.domain", DnsLookupFamily::V4Only,
+                                        [](std::list<Address::InstanceConstSharedPtr> && ) -> void {
+                                          FAIL();
+                                        }));
+  EXPECT_NE(nullptr, resolver2->resolve("some.other.domain", DnsLookupFamily::V4Only,
+                                        [&](std::list<Address::InstanceConstSharedPtr>&& results)
+                                            -> void { failed = results.empty(); }));
+  resolver_.reset();
+  dispatcher2.run(Event::Dispatcher::RunType::NonBlock);
+  EXPECT_TRUE(failed);
+}
+
+// Validate that the thread local resolver resolves on the calling thread.
+TEST(ThreadLocalDnsResolverImplTest, Resolve) {
+  Event::DispatcherImpl dispatcher;
+  ThreadLocal::InstanceImpl tls;
+  tls.registerThread(dispatcher, true);
+  ThreadLocalDnsResolverImpl resolver(tls, {});
+  std::list<Address::InstanceConstSharedPtr> address_list;
+  EXPECT_EQ(nullptr, resolver.resolve("127.0.0.1", DnsLookupFamily::V4Only,
+                                      [&](std::list<Address::InstanceConstSharedPtr>&& results)
+                                          -> void { address_list = results; }));
+  EXPECT_TRUE(hasAddress(address_list, "127.0.0.1"));
+  tls.shutdownThread();
+}
+
 class DnsImplZeroTimeoutTest : public DnsImplTest {
 protected:
   bool zero_timeout() const override { return true; }
@@ -0,0 +1,77 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/network/filter_manager_impl.h"
+
+#include "test/mocks/network/mocks.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+using testing::NiceMock;
+
+namespace Network {
+
+/**
+ * This test is for benchmarking only and should not be run as part of unit tests. It measures the
+ * per connection cost of setting up a filter chain, passing it one read and one write, and tearing
+ * it down, for the chains typical of L4 listeners.
+ */
+class DISABLED_NetworkFilterManagerBenchmark : public testing::Test, public BufferSource {
+public:
+  static const uint32_t NumConnections = 1000000;
+
+  /**
+   * A filter that does nothing, so that only the cost of the filter manager is measured.
+   */
+  class PassThroughFilter : public Filter {
+  public:
+    // Network::ReadFilter
+    FilterStatus onData(Buffer::Instance&) override { return FilterStatus::Continue; }
+    FilterStatus onNewConnection() override { return FilterStatus::Continue; }
+    void initializeReadFilterCallbacks(ReadFilterCallbacks&) override {}
+
+    // Network::WriteFilter
+    FilterStatus onWrite(Buffer::Instance&) override { return FilterStatus::Continue; }
+  };
+
+  // Network::BufferSource
+  Buffer::Instance& getReadBuffer() override { return read_buffer_; }
+  Buffer::Instance& getWriteBuffer() override { return write_buffer_; }
+
+  void run(const std::string& name, uint32_t num_read_filters) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NumConnections; i++) {
+      FilterManagerImpl manager(connection_, *this);
+      for (uint32_t j = 1; j < num_read_filters; j++) {
+        manager.addReadFilter(std::make_shared<PassThroughFilter>());
+      }
+      manager.addFilter(std::make_shared<PassThroughFilter>());
+      manager.initializeReadFilters();
+      manager.onRead();
+      manager.onWrite();
+    }
+    std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << fmt::format("{}: {}ns/connection", name, elapsed.count() / NumConnections)
+              << std::endl;
+  }
+
+  NiceMock<MockConnection> connection_;
+  Buffer::OwnedImpl read_buffer_{"hello"};
+  Buffer::OwnedImpl write_buffer_{"world"};
+};
+
+TEST_F(DISABLED_NetworkFilterManagerBenchmark, SetupAndIterate) {
+  run("tcp_proxy", 1);
+  run("ratelimit + tcp_proxy", 2);
+  run("4 filters", 4);
+}
+
+} // Network
+} // Envoy
@@ -93,6 +93,37 @@ TEST_F(NetworkFilterManagerTest, All) {
   manager.onWrite();
 }
 
+// A filter may add further filters to the chain, which then see the same data.
+TEST_F(NetworkFilterManagerTest, AddReadFilterWhileIterating) {
+  InSequence s;
+
+  MockReadFilter* read_filter(new MockReadFilter());
+  MockReadFilter* added_filter(new MockReadFilter());
+
+  NiceMock<MockConnection> connection;
+  FilterManagerImpl manager(connection, *this);
+  manager.addReadFilter(ReadFilterSharedPtr{read_filter});
+
+  read_buffer_.add("hello");
+  EXPECT_CALL(*read_filter, onNewConnection()).WillOnce(Return(FilterStatus::Continue));
+  EXPECT_CALL(*read_filter, onData(BufferStringEqual("hello")))
+      .WillOnce(Invoke([&](Buffer::Instance&) -> FilterStatus {
+        manager.addReadFilter(ReadFilterSharedPtr{added_filter});
+        return FilterStatus::Continue;
+      }));
+  EXPECT_CALL(*added_filter, onNewConnection()).WillOnce(Return(FilterStatus::Continue));
+  EXPECT_CALL(*added_filter, onData(BufferStringEqual("hello")))
+      .WillOnce(Return(FilterStatus::StopIteration));
+  EXPECT_TRUE(manager.initializeReadFilters());
+  EXPECT_EQ(2U, manager.numReadFilters());
+
+  EXPECT_CALL(*read_filter, onData(BufferStringEqual("hello")))
+      .WillOnce(Return(FilterStatus::Continue));
+  EXPECT_CALL(*added_filter, onData(BufferStringEqual("hello")))
+      .WillOnce(Return(FilterStatus::Continue));
+  manager.onRead();
+}
+
 // This is a very important flow so make sure it works correctly in aggregate.
 TEST_F(NetworkFilterManagerTest, RateLimitAndTcpProxy) {
   InSequence s;
@@ -0,0 +1,118 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/network/address_impl.h"
+#include "common/network/cidr_range.h"
+#include "common/network/lc_trie.h"
+#include "common/network/utility.h"
+
+#include "gtest/gtest.h"
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+namespace Network {
+
+class LcTrieTest : public testing::Test {
+public:
+  void setup(const std::vector<std::pair<std::string, std::vector<std::string>>>& tags) {
+    std::vector<LcTrie::Prefix> prefixes;
+    for (const auto& tag : tags) {
+      for (const std::string& entry : tag.second) {
+        Address::CidrRange range = Address::CidrRange::create(entry);
+        ASSERT_TRUE(range.isValid()) << entry;
+        if (range.version() == Address::IpVersion::v4) {
+          prefixes.emplace_back(tag.first, range.ipv4()->address(), range.length());
+        } else {
+          prefixes.emplace_back(tag.first, range.ipv6()->address(), range.length());
+        }
+      }
+    }
+    trie_.reset(new LcTrie(prefixes));
+  }
+
+  std::vector<std::string> getTags(const std::string& address) {
+    return trie_->getTags(*Utility::parseInternetAddress(address));
+  }
+
+  std::unique_ptr<LcTrie> trie_;
+};
+
+TEST_F(LcTrieTest, Empty) {
+  setup({});
+  EXPECT_EQ(std::vector<std::string>{}, getTags("1.2.3.4"));
+  EXPECT_EQ(std::vector<std::string>{}, getTags("::1"));
+}
+
+TEST_F(LcTrieTest, Ipv4) {
+  setup({{"tag_0", {"0.0.0.0/0"}},
+         {"tag_1", {"10.0.0.0/8", "192.168.0.0/16"}},
+         {"tag_2", {"10.1.0.0/16"}},
+         {"tag_3", {"10.1.2.3/32"}},
+         {"tag_4", {"10.255.0.0/16"}}});
+
+  EXPECT_EQ(std::vector<std::string>{"tag_0"}, getTags("1.2.3.4"));
+  EXPECT_EQ((std::vector<std::string>{"tag_0", "tag_1"}), getTags("10.0.0.1"));
+  EXPECT_EQ((std::vector<std::string>{"tag_0", "tag_1", "tag_2"}), getTags("10.1.255.255"));
+  EXPECT_EQ((std::vector<std::string>{"tag_0", "tag_1", "tag_2", "tag_3"}), getTags("10.1.2.3"));
+  EXPECT_EQ((std::vector<std::string>{"tag_0", "tag_1", "tag_2"}), getTags("10.1.2.4"));
+  EXPECT_EQ((std::vector<std::string>{"tag_0", "tag_1", "tag_4"}), getTags("10.255.0.1"));
+  EXPECT_EQ((std::vector<std::string>{"tag_0", "tag_1"}), getTags("192.168.1.1"));
+  EXPECT_EQ(std::vector<std::string>{"tag_0"}, getTags("192.169.1.1"));
+  EXPECT_EQ(std::vector<std::string>{"tag_0"}, getTags("255.255.255.255"));
+
+  // IPv4 prefixes never match IPv6 addresses.
+  EXPECT_EQ(std::vector<std::string>{}, getTags("::"));
+}
+
+TEST_F(LcTrieTest, Ipv6) {
+  setup({{"tag_1", {"2001:abcd::/32"}},
+         {"tag_2", {"2001:abcd:ef01::/48", "::1/128"}},
+         {"tag_3", {"2001:abcd:ef01:2345:6789:abcd:ef01:2345/128"}}});
+
+  EXPECT_EQ(std::vector<std::string>{}, getTags("2001:abce::1"));
+  EXPECT_EQ(std::vector<std::string>{"tag_1"}, getTags("2001:abcd::1"));
+  EXPECT_EQ((std::vector<std::string>{"tag_1", "tag_2"}), getTags("2001:abcd:ef01::1"));
+  EXPECT_EQ((std::vector<std::string>{"tag_1", "tag_2", "tag_3"}),
+            getTags("2001:abcd:ef01:2345:6789:abcd:ef01:2345"));
+  EXPECT_EQ((std::vector<std::string>{"tag_1", "tag_2"}),
+            getTags("2001:abcd:ef01:2345:6789:abcd:ef01:2344"));
+  EXPECT_EQ(std::vector<std::string>{"tag_2"}, getTags("::1"));
+  EXPECT_EQ(std::vector<std::string>{}, getTags("::2"));
+  EXPECT_EQ(std::vector<std::string>{}, getTags("10.0.0.1"));
+}
+
+TEST_F(LcTrieTest, DuplicateAndNestedTags) {
+  setup({{"tag_1", {"10.0.0.0/8", "10.0.0.0/16", "10.0.0.0/8"}}, {"tag_2", {"10.0.0.0/8"}}});
+
+  EXPECT_EQ((std::vector<std::string>{"tag_1", "tag_2"}), getTags("10.0.0.1"));
+  EXPECT_EQ((std::vector<std::string>{"tag_1", "tag_2"}), getTags("10.1.0.1"));
+  EXPECT_EQ(std::vector<std::string>{}, getTags("11.0.0.1"));
+}
+
+TEST_F(LcTrieTest, MergesAdjacentRanges) {
+  // 256 adjacent /24s that together cover 10.1.0.0/16.
+  std::vector<std::string> ranges;
+  for (int i = 0; i < 256; i++) {
+    ranges.push_back(fmt::format("10.1.{}.0/24", i));
+  }
+  setup({{"tag_1", ranges}, {"tag_2", {"10.1.7.0/24"}}});
+
+  EXPECT_EQ(std::vector<std::string>{"tag_1"}, getTags("10.1.0.1"));
+  EXPECT_EQ((std::vector<std::string>{"tag_1", "tag_2"}), getTags("10.1.7.1"));
+  EXPECT_EQ(std::vector<std::string>{"tag_1"}, getTags("10.1.255.255"));
+  EXPECT_EQ(std::vector<std::string>{}, getTags("10.2.0.0"));
+
+  // Sibling leaves with the same tags merge back into the covering /16 before compression,
+  // leaving only the path to the /24 that has an extra tag.
+  EXPECT_GT(100U, trie_->size());
+}
+
+TEST_F(LcTrieTest, UnixAddress) {
+  setup({{"tag_1", {"0.0.0.0/0"}}});
+  Address::PipeInstance address("/foo");
+  EXPECT_EQ(std::vector<std::string>{}, trie_->getTags(address));
+}
+
+} // Network
+} // Envoy
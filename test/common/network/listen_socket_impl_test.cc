@@ -59,5 +59,20 @@ TEST_P(ListenSocketImplTest, BindPortZero) {
   EXPECT_GT(socket.localAddress()->ip()->port(), 0U);
 }
 
+// Validate that several SO_REUSEPORT sockets can listen on the same address.
+TEST_P(ListenSocketImplTest, ReusePort) {
+  auto loopback = Network::Test::getSomeLoopbackAddress(version_);
+  TcpListenSocket socket1(loopback, true, true);
+  TcpListenSocket socket2(socket1.localAddress(), true, true);
+  EXPECT_EQ(socket1.localAddress()->asString(), socket2.localAddress()->asString());
+
+  socket1.steerReusePortByCpu(2);
+  EXPECT_EQ(0, listen(socket1.fd(), 0));
+  EXPECT_EQ(0, listen(socket2.fd(), 0));
+
+  // A socket that does not set SO_REUSEPORT cannot join the group.
+  EXPECT_THROW(Network::TcpListenSocket socket3(socket1.localAddress(), true), EnvoyException);
+}
+
 } // Network
 } // Envoy
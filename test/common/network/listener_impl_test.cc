@@ -1,4 +1,9 @@
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
 #include "common/network/address_impl.h"
+#include "common/network/connection_balancer_impl.h"
 #include "common/network/listener_impl.h"
 #include "common/network/utility.h"
 #include "common/stats/stats_impl.h"
@@ -34,7 +39,10 @@ static void errorCallbackTest(Address::IpVersion version) {
                                 {.bind_to_port_ = true,
                                  .use_proxy_proto_ = false,
                                  .use_original_dst_ = false,
-                                 .per_connection_buffer_limit_bytes_ = 0});
+                                 .per_connection_buffer_limit_bytes_ = 0,
+                                 .connection_balancer_ = nullptr,
+                                 .inspect_tls_client_hello_ = false,
+                                 .socket_options_ = nullptr});
 
   Network::ClientConnectionPtr client_connection =
       dispatcher.createClientConnection(socket.localAddress());
@@ -103,7 +111,10 @@ TEST_P(ListenerImplTest, NormalRedirect) {
                                      stats_store, {.bind_to_port_ = true,
                                                    .use_proxy_proto_ = false,
                                                    .use_original_dst_ = true,
-                                                   .per_connection_buffer_limit_bytes_ = 0});
+                                                   .per_connection_buffer_limit_bytes_ = 0,
+                                                   .connection_balancer_ = nullptr,
+                                                   .inspect_tls_client_hello_ = false,
+                                                   .socket_options_ = nullptr});
   Network::MockListenerCallbacks listener_callbacks2;
   Network::TestListenerImpl listenerDst(connection_handler, dispatcher, socketDst,
                                         listener_callbacks2, stats_store,
@@ -142,7 +153,10 @@ TEST_P(ListenerImplTest, FallbackToWildcardListener) {
                                      stats_store, {.bind_to_port_ = true,
                                                    .use_proxy_proto_ = false,
                                                    .use_original_dst_ = true,
-                                                   .per_connection_buffer_limit_bytes_ = 0});
+                                                   .per_connection_buffer_limit_bytes_ = 0,
+                                                   .connection_balancer_ = nullptr,
+                                                   .inspect_tls_client_hello_ = false,
+                                                   .socket_options_ = nullptr});
   Network::MockListenerCallbacks listener_callbacks2;
   Network::TestListenerImpl listenerDst(connection_handler, dispatcher, socketDst,
                                         listener_callbacks2, stats_store,
@@ -180,7 +194,10 @@ TEST_P(ListenerImplTest, UseActualDst) {
                                      stats_store, {.bind_to_port_ = true,
                                                    .use_proxy_proto_ = false,
                                                    .use_original_dst_ = false,
-                                                   .per_connection_buffer_limit_bytes_ = 0});
+                                                   .per_connection_buffer_limit_bytes_ = 0,
+                                                   .connection_balancer_ = nullptr,
+                                                   .inspect_tls_client_hello_ = false,
+                                                   .socket_options_ = nullptr});
   Network::MockListenerCallbacks listener_callbacks2;
   Network::TestListenerImpl listenerDst(connection_handler, dispatcher, socketDst,
                                         listener_callbacks2, stats_store,
@@ -206,5 +223,87 @@ TEST_P(ListenerImplTest, UseActualDst) {
   dispatcher.run(Event::Dispatcher::RunType::Block);
 }
 
+TEST_P(ListenerImplTest, BalanceConnections) {
+  Stats::IsolatedStoreImpl stats_store;
+  Event::DispatcherImpl dispatcher;
+  Network::ConnectionBalancerImpl balancer;
+  const Network::ListenerOptions listener_options = {.bind_to_port_ = true,
+                                                     .use_proxy_proto_ = false,
+                                                     .use_original_dst_ = false,
+                                                     .per_connection_buffer_limit_bytes_ = 0,
+                                                     .connection_balancer_ = &balancer,
+                                                     .inspect_tls_client_hello_ = false,
+                                                     .socket_options_ = nullptr};
+
+  // The second listener never accepts anything itself, but it owns fewer connections so it gets
+  // the connection accepted by the first listener.
+  Network::TcpListenSocket socket1(Network::Test::getSomeLoopbackAddress(version_), true);
+  Network::TcpListenSocket socket2(Network::Test::getSomeLoopbackAddress(version_), true);
+  Network::MockListenerCallbacks listener_callbacks1;
+  Network::MockListenerCallbacks listener_callbacks2;
+  Network::MockConnectionHandler connection_handler1;
+  Network::MockConnectionHandler connection_handler2;
+  ON_CALL(connection_handler1, numConnections()).WillByDefault(Return(10));
+  ON_CALL(connection_handler2, numConnections()).WillByDefault(Return(0));
+  Network::TestListenerImpl listener1(connection_handler1, dispatcher, socket1,
+                                      listener_callbacks1, stats_store, listener_options);
+  Network::TestListenerImpl listener2(connection_handler2, dispatcher, socket2,
+                                      listener_callbacks2, stats_store, listener_options);
+
+  Network::ClientConnectionPtr client_connection =
+      dispatcher.createClientConnection(socket1.localAddress());
+  client_connection->connect();
+
+  EXPECT_CALL(listener1, newConnection(_, _, _)).Times(0);
+  EXPECT_CALL(listener2, newConnection(_, _, _));
+  EXPECT_CALL(listener_callbacks2, onNewConnection_(_))
+      .WillOnce(Invoke([&](Network::ConnectionPtr& conn) -> void {
+        EXPECT_EQ(socket1.localAddress()->ip()->addressAsString(),
+                  conn->remoteAddress().ip()->addressAsString());
+        client_connection->close(ConnectionCloseType::NoFlush);
+        conn->close(ConnectionCloseType::NoFlush);
+        dispatcher.exit();
+      }));
+
+  dispatcher.run(Event::Dispatcher::RunType::Block);
+}
+
+TEST_P(ListenerImplTest, SocketOptions) {
+  Stats::IsolatedStoreImpl stats_store;
+  Event::DispatcherImpl dispatcher;
+  std::shared_ptr<SocketOptions> socket_options(new SocketOptions());
+  socket_options->keepalive_ = true;
+  socket_options->keepalive_time_.value(60);
+  socket_options->tcp_fast_open_queue_length_.value(16);
+  const Network::ListenerOptions listener_options = {.bind_to_port_ = true,
+                                                     .use_proxy_proto_ = false,
+                                                     .use_original_dst_ = false,
+                                                     .per_connection_buffer_limit_bytes_ = 0,
+                                                     .connection_balancer_ = nullptr,
+                                                     .inspect_tls_client_hello_ = false,
+                                                     .socket_options_ = socket_options};
+
+  Network::TcpListenSocket socket(Network::Test::getCanonicalLoopbackAddress(version_), true);
+  Network::MockListenerCallbacks listener_callbacks;
+  Network::MockConnectionHandler connection_handler;
+  Network::ListenerImpl listener(connection_handler, dispatcher, socket, listener_callbacks,
+                                 stats_store, listener_options);
+
+  int value = 0;
+  socklen_t len = sizeof(value);
+  EXPECT_EQ(0, getsockopt(socket.fd(), SOL_SOCKET, SO_KEEPALIVE, &value, &len));
+  EXPECT_EQ(1, value);
+  EXPECT_EQ(0, getsockopt(socket.fd(), IPPROTO_TCP, TCP_KEEPIDLE, &value, &len));
+  EXPECT_EQ(60, value);
+
+  // Options that cannot be set fail the listener rather than being silently dropped.
+  Network::TcpListenSocket closed_socket(Network::Test::getCanonicalLoopbackAddress(version_),
+                                         true);
+  closed_socket.close();
+  EXPECT_THROW(Network::ListenerImpl(connection_handler, dispatcher, closed_socket,
+                                     listener_callbacks, stats_store, listener_options),
+               CreateListenerException);
+}
+
 } // Network
 } // Envoy
@@ -0,0 +1,47 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include "common/network/proxy_protocol.h"
+
+#include "gtest/gtest.h"
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+namespace Network {
+
+/**
+ * This test is for benchmarking only and should not be run as part of unit tests. It measures the
+ * time it takes to parse V1 and V2 PROXY protocol headers, which every connection accepted by a
+ * listener that uses the PROXY protocol pays for.
+ */
+class DISABLED_ProxyProtocolParserBenchmark : public testing::Test {
+public:
+  static const uint32_t NumHeaders = 1000000;
+
+  void run(const std::string& name, const std::string& data) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NumHeaders; i++) {
+      ProxyProtocolParser::Header header;
+      EXPECT_TRUE(ProxyProtocolParser::parse(data.data(), data.size(), header));
+    }
+    std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << fmt::format("{}: {}ns/header", name, elapsed.count() / NumHeaders) << std::endl;
+  }
+};
+
+TEST_F(DISABLED_ProxyProtocolParserBenchmark, Parse) {
+  run("V1 TCP4", "PROXY TCP4 192.168.100.200 10.1.2.3 56324 443\r\nGET / HTTP/1.1\r\n");
+  run("V1 TCP6", "PROXY TCP6 2001:db8::1234:5678 2001:db8::1 56324 443\r\nGET / HTTP/1.1\r\n");
+
+  // 192.168.100.200:56324 to 10.1.2.3:443, with an ALPN TLV.
+  run("V2 TCP4", std::string("\r\n\r\n\0\r\nQUIT\n\x21\x11\x00\x11"
+                             "\xc0\xa8\x64\xc8\x0a\x01\x02\x03\xdc\x04\x01\xbb"
+                             "\x01\x00\x02h2",
+                             33) +
+                     "GET / HTTP/1.1\r\n");
+}
+
+} // Network
+} // Envoy
@@ -1,5 +1,8 @@
+#include <cstdint>
 #include <memory>
+#include <random>
 #include <string>
+#include <vector>
 
 #include "common/buffer/buffer_impl.h"
 #include "common/event/dispatcher_impl.h"
@@ -23,6 +26,32 @@ using testing::Invoke;
 using testing::NiceMock;
 
 namespace Network {
+namespace {
+
+/**
+ * Build a PROXY protocol V2 header.
+ */
+std::string v2Header(uint8_t version_command, uint8_t family_protocol, const std::string& payload) {
+  std::string header("\r\n\r\n\0\r\nQUIT\n", 12);
+  header.push_back(version_command);
+  header.push_back(family_protocol);
+  header.push_back(payload.size() >> 8);
+  header.push_back(payload.size() & 0xff);
+  return header + payload;
+}
+
+// 1.2.3.4:1000 to 5.6.7.8:2000.
+const std::string V2_INET_ADDRESSES("\x01\x02\x03\x04\x05\x06\x07\x08\x03\xe8\x07\xd0", 12);
+
+// [1:2:3::4]:1000 to [5:6::7:8]:2000.
+const std::string V2_INET6_ADDRESSES("\x00\x01\x00\x02\x00\x03\x00\x00"
+                                     "\x00\x00\x00\x00\x00\x00\x00\x04"
+                                     "\x00\x05\x00\x06\x00\x00\x00\x00"
+                                     "\x00\x00\x00\x00\x00\x07\x00\x08"
+                                     "\x03\xe8\x07\xd0",
+                                     36);
+
+} // namespace
 
 class ProxyProtocolTest : public testing::TestWithParam<Address::IpVersion> {
 public:
@@ -32,7 +61,10 @@ public:
                   {.bind_to_port_ = true,
                    .use_proxy_proto_ = true,
                    .use_original_dst_ = false,
-                   .per_connection_buffer_limit_bytes_ = 0}) {
+                   .per_connection_buffer_limit_bytes_ = 0,
+                   .connection_balancer_ = nullptr,
+                   .inspect_tls_client_hello_ = false,
+                   .socket_options_ = nullptr}) {
     conn_ = dispatcher_.createClientConnection(socket_.localAddress());
     conn_->addConnectionCallbacks(connection_callbacks_);
     conn_->connect();
@@ -200,5 +232,250 @@ TEST_P(ProxyProtocolTest, AddressVersionsNotMatch) {
   dispatcher_.run(Event::Dispatcher::RunType::NonBlock);
 }
 
+TEST_P(ProxyProtocolTest, V2Basic) {
+  write(v2Header(0x21, 0x11, V2_INET_ADDRESSES) + "more data");
+
+  ConnectionPtr accepted_connection;
+
+  EXPECT_CALL(callbacks_, onNewConnection_(_))
+      .WillOnce(Invoke([&](ConnectionPtr& conn) -> void {
+        ASSERT_EQ("1.2.3.4:1000", conn->remoteAddress().asString());
+        conn->addReadFilter(read_filter_);
+        accepted_connection = std::move(conn);
+      }));
+
+  read_filter_.reset(new MockReadFilter());
+  EXPECT_CALL(*read_filter_, onNewConnection());
+  EXPECT_CALL(*read_filter_, onData(BufferStringEqual("more data")));
+
+  dispatcher_.run(Event::Dispatcher::RunType::NonBlock);
+  accepted_connection->close(ConnectionCloseType::NoFlush);
+  conn_->close(ConnectionCloseType::NoFlush);
+}
+
+TEST_P(ProxyProtocolTest, V2BasicV6) {
+  write(v2Header(0x21, 0x21, V2_INET6_ADDRESSES) + "more data");
+
+  ConnectionPtr accepted_connection;
+
+  EXPECT_CALL(callbacks_, onNewConnection_(_))
+      .WillOnce(Invoke([&](ConnectionPtr& conn) -> void {
+        ASSERT_EQ("[1:2:3::4]:1000", conn->remoteAddress().asString());
+        conn->addReadFilter(read_filter_);
+        accepted_connection = std::move(conn);
+      }));
+
+  read_filter_.reset(new MockReadFilter());
+  EXPECT_CALL(*read_filter_, onNewConnection());
+  EXPECT_CALL(*read_filter_, onData(BufferStringEqual("more data")));
+
+  dispatcher_.run(Event::Dispatcher::RunType::NonBlock);
+  accepted_connection->close(ConnectionCloseType::NoFlush);
+  conn_->close(ConnectionCloseType::NoFlush);
+}
+
+TEST_P(ProxyProtocolTest, V2Local) {
+  // A LOCAL command keeps the real remote address of the connection.
+  write(v2Header(0x20, 0x00, "") + "more data");
+
+  ConnectionPtr accepted_connection;
+
+  EXPECT_CALL(callbacks_, onNewConnection_(_))
+      .WillOnce(Invoke([&](ConnectionPtr& conn) -> void {
+        ASSERT_EQ(conn_->localAddress().ip()->addressAsString(),
+                  conn->remoteAddress().ip()->addressAsString());
+        conn->addReadFilter(read_filter_);
+        accepted_connection = std::move(conn);
+      }));
+
+  read_filter_.reset(new MockReadFilter());
+  EXPECT_CALL(*read_filter_, onNewConnection());
+  EXPECT_CALL(*read_filter_, onData(BufferStringEqual("more data")));
+
+  dispatcher_.run(Event::Dispatcher::RunType::NonBlock);
+  accepted_connection->close(ConnectionCloseType::NoFlush);
+  conn_->close(ConnectionCloseType::NoFlush);
+}
+
+TEST_P(ProxyProtocolTest, V2PartialRead) {
+  const std::string header =
+      v2Header(0x21, 0x11, V2_INET_ADDRESSES + std::string("\x04\x00\x01x", 4));
+  write(header.substr(0, 10));
+
+  EXPECT_CALL(callbacks_, onNewConnection_(_))
+      .WillOnce(Invoke([&](ConnectionPtr& conn) -> void {
+        ASSERT_EQ("1.2.3.4", conn->remoteAddress().ip()->addressAsString());
+        read_filter_.reset(new MockReadFilter());
+        conn->addReadFilter(read_filter_);
+        conn->close(ConnectionCloseType::NoFlush);
+      }));
+
+  dispatcher_.run(Event::Dispatcher::RunType::NonBlock);
+
+  write(header.substr(10, 10));
+  dispatcher_.run(Event::Dispatcher::RunType::NonBlock);
+
+  write(header.substr(20));
+  dispatcher_.run(Event::Dispatcher::RunType::NonBlock);
+}
+
+TEST_P(ProxyProtocolTest, V2BadVersion) {
+  write(v2Header(0x11, 0x11, V2_INET_ADDRESSES) + "more data");
+  EXPECT_CALL(connection_callbacks_, onEvent(ConnectionEvent::Connected));
+  EXPECT_CALL(connection_callbacks_, onEvent(ConnectionEvent::RemoteClose));
+  dispatcher_.run(Event::Dispatcher::RunType::NonBlock);
+}
+
+TEST_P(ProxyProtocolTest, V2TooLarge) {
+  write(v2Header(0x21, 0x11, V2_INET_ADDRESSES + std::string(2000, 'a')));
+  EXPECT_CALL(connection_callbacks_, onEvent(ConnectionEvent::Connected));
+  EXPECT_CALL(connection_callbacks_, onEvent(ConnectionEvent::RemoteClose));
+  dispatcher_.run(Event::Dispatcher::RunType::NonBlock);
+}
+
+TEST(ProxyProtocolParserTest, V1) {
+  const std::string line = "PROXY TCP4 1.2.3.4 5.6.7.8 1000 2000\r\n";
+  const std::string data = line + "more data";
+  for (size_t i = 0; i < line.size(); i++) {
+    ProxyProtocolParser::Header header;
+    EXPECT_FALSE(ProxyProtocolParser::parse(data.data(), i, header));
+  }
+
+  ProxyProtocolParser::Header header;
+  EXPECT_TRUE(ProxyProtocolParser::parse(data.data(), data.size(), header));
+  EXPECT_EQ(line.size(), header.length_);
+  EXPECT_EQ("1.2.3.4:1000", header.remote_address_->asString());
+  EXPECT_EQ("5.6.7.8:2000", header.destination_address_->asString());
+  EXPECT_TRUE(header.tlvs_.empty());
+}
+
+TEST(ProxyProtocolParserTest, V2Inet) {
+  const std::string data = v2Header(0x21, 0x11, V2_INET_ADDRESSES);
+  for (size_t i = 0; i < data.size(); i++) {
+    ProxyProtocolParser::Header header;
+    EXPECT_FALSE(ProxyProtocolParser::parse(data.data(), i, header));
+  }
+
+  ProxyProtocolParser::Header header;
+  EXPECT_TRUE(ProxyProtocolParser::parse(data.data(), data.size(), header));
+  EXPECT_EQ(28U, header.length_);
+  EXPECT_EQ("1.2.3.4:1000", header.remote_address_->asString());
+  EXPECT_EQ("5.6.7.8:2000", header.destination_address_->asString());
+}
+
+TEST(ProxyProtocolParserTest, V2Inet6) {
+  const std::string data = v2Header(0x21, 0x21, V2_INET6_ADDRESSES) + "more data";
+  ProxyProtocolParser::Header header;
+  EXPECT_TRUE(ProxyProtocolParser::parse(data.data(), data.size(), header));
+  EXPECT_EQ(52U, header.length_);
+  EXPECT_EQ("[1:2:3::4]:1000", header.remote_address_->asString());
+  EXPECT_EQ("[5:6::7:8]:2000", header.destination_address_->asString());
+}
+
+TEST(ProxyProtocolParserTest, V2WithoutAddresses) {
+  // A LOCAL command skips any addresses.
+  {
+    const std::string data = v2Header(0x20, 0x11, V2_INET_ADDRESSES);
+    ProxyProtocolParser::Header header;
+    EXPECT_TRUE(ProxyProtocolParser::parse(data.data(), data.size(), header));
+    EXPECT_EQ(28U, header.length_);
+    EXPECT_EQ(nullptr, header.remote_address_);
+  }
+
+  // So does a PROXY command for an unspecified or unix address family.
+  {
+    const std::string data = v2Header(0x21, 0x00, "");
+    ProxyProtocolParser::Header header;
+    EXPECT_TRUE(ProxyProtocolParser::parse(data.data(), data.size(), header));
+    EXPECT_EQ(16U, header.length_);
+    EXPECT_EQ(nullptr, header.remote_address_);
+  }
+
+  {
+    const std::string data = v2Header(0x21, 0x31, std::string(216, '/'));
+    ProxyProtocolParser::Header header;
+    EXPECT_TRUE(ProxyProtocolParser::parse(data.data(), data.size(), header));
+    EXPECT_EQ(232U, header.length_);
+    EXPECT_EQ(nullptr, header.remote_address_);
+  }
+}
+
+TEST(ProxyProtocolParserTest, V2Tlvs) {
+  const std::string data =
+      v2Header(0x21, 0x11, V2_INET_ADDRESSES + std::string("\x01\x00\x02h2\x04\x00\x00", 8));
+  ProxyProtocolParser::Header header;
+  EXPECT_TRUE(ProxyProtocolParser::parse(data.data(), data.size(), header));
+  EXPECT_EQ(36U, header.length_);
+  ASSERT_EQ(2U, header.tlvs_.size());
+  EXPECT_EQ(0x01, header.tlvs_[0].type_);
+  EXPECT_EQ("h2", std::string(header.tlvs_[0].value_, header.tlvs_[0].length_));
+  EXPECT_EQ(0x04, header.tlvs_[1].type_);
+  EXPECT_EQ(0U, header.tlvs_[1].length_);
+}
+
+TEST(ProxyProtocolParserTest, Errors) {
+  auto expectError = [](const std::string& data) -> void {
+    ProxyProtocolParser::Header header;
+    EXPECT_THROW(ProxyProtocolParser::parse(data.data(), data.size(), header), EnvoyException);
+  };
+
+  // Neither signature.
+  expectError("GET / HTTP/1.1\r\n");
+  expectError(std::string("\r\n\r\n\0\r\nQUIX", 11));
+  expectError("PROXY TCP4 1.2.3.4 5.6.7.8 1000 2000" + std::string(100, ' '));
+
+  // Bad version, command, address family or transport.
+  expectError(v2Header(0x11, 0x11, V2_INET_ADDRESSES));
+  expectError(v2Header(0x22, 0x11, V2_INET_ADDRESSES));
+  expectError(v2Header(0x21, 0x41, V2_INET_ADDRESSES));
+  expectError(v2Header(0x21, 0x12, V2_INET_ADDRESSES));
+
+  // Addresses or TLVs that are cut short by the header length.
+  expectError(v2Header(0x21, 0x11, V2_INET_ADDRESSES.substr(0, 11)));
+  expectError(v2Header(0x21, 0x21, V2_INET_ADDRESSES));
+  expectError(v2Header(0x21, 0x11, V2_INET_ADDRESSES + std::string("\x01\x00", 2)));
+  expectError(v2Header(0x21, 0x11, V2_INET_ADDRESSES + std::string("\x01\x00\x02h", 4)));
+
+  // A header that is too long, which is rejected before it has arrived.
+  expectError(v2Header(0x21, 0x11, std::string(ProxyProtocolParser::MAX_LENGTH, 'a'))
+                  .substr(0, ProxyProtocolParser::V2_HEADER_LENGTH));
+}
+
+TEST(ProxyProtocolParserTest, Fuzz) {
+  // Parse random mutations and truncations of valid headers. Every outcome must be consistent
+  // with the data: a parsed header never extends past the data, and nothing reads outside of it.
+  const std::vector<std::string> seeds{
+      "PROXY TCP4 1.2.3.4 5.6.7.8 1000 2000\r\n",
+      "PROXY TCP6 1:2:3::4 5:6::7:8 1000 2000\r\n",
+      v2Header(0x21, 0x11, V2_INET_ADDRESSES + std::string("\x01\x00\x02h2", 5)),
+      v2Header(0x21, 0x21, V2_INET6_ADDRESSES),
+      v2Header(0x20, 0x00, ""),
+  };
+  std::mt19937 random(0);
+  for (uint32_t i = 0; i < 100000; i++) {
+    std::string data = seeds[random() % seeds.size()];
+    const uint32_t mutations = random() % 4;
+    for (uint32_t j = 0; j < mutations; j++) {
+      data[random() % data.size()] = random();
+    }
+    data.resize(random() % (data.size() + 1));
+
+    // Copy the data so that any read past its end is caught by sanitizers.
+    std::unique_ptr<char[]> buffer(new char[data.size()]);
+    memcpy(buffer.get(), data.data(), data.size());
+    ProxyProtocolParser::Header header;
+    try {
+      if (ProxyProtocolParser::parse(buffer.get(), data.size(), header)) {
+        EXPECT_LE(header.length_, data.size());
+        EXPECT_LE(header.length_, ProxyProtocolParser::MAX_LENGTH);
+        for (const ProxyProtocolParser::Tlv& tlv : header.tlvs_) {
+          EXPECT_LE(tlv.value_ + tlv.length_, buffer.get() + header.length_);
+        }
+      }
+    } catch (const EnvoyException&) {
+    }
+  }
+}
+
 } // Network
 } // Envoy
@@ -0,0 +1,208 @@
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/event/dispatcher_impl.h"
+#include "common/network/listener_impl.h"
+#include "common/network/tls_inspector.h"
+#include "common/network/utility.h"
+#include "common/stats/stats_impl.h"
+
+#include "test/mocks/buffer/mocks.h"
+#include "test/mocks/network/mocks.h"
+#include "test/test_common/environment.h"
+#include "test/test_common/network_utility.h"
+#include "test/test_common/printers.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace Envoy {
+using testing::_;
+using testing::Invoke;
+using testing::NiceMock;
+
+namespace Network {
+namespace {
+
+std::string uint16(size_t value) {
+  return std::string{static_cast<char>(value >> 8), static_cast<char>(value & 0xff)};
+}
+
+std::string prefixed16(const std::string& data) { return uint16(data.size()) + data; }
+
+/**
+ * Build a TLS record holding a ClientHello with the given server name and application protocols.
+ * An empty server name or protocol list omits the extension.
+ */
+std::string clientHello(const std::string& server_name,
+                        const std::vector<std::string>& application_protocols) {
+  std::string extensions;
+  if (!server_name.empty()) {
+    extensions += uint16(0) + prefixed16(prefixed16('\0' + prefixed16(server_name)));
+  }
+  if (!application_protocols.empty()) {
+    std::string protocols;
+    for (const std::string& protocol : application_protocols) {
+      protocols += static_cast<char>(protocol.size()) + protocol;
+    }
+    extensions += uint16(16) + prefixed16(prefixed16(protocols));
+  }
+  // An extension that is skipped: supported_groups with x25519.
+  extensions += uint16(10) + prefixed16(prefixed16(uint16(29)));
+
+  const std::string body = uint16(0x0303) + std::string(32, 'r') + // client_version, random
+                           std::string(1, 0) +                     // session_id
+                           prefixed16(uint16(0xc02f)) +            // cipher_suites
+                           std::string{1, 0} +                     // compression_methods
+                           prefixed16(extensions);
+  const std::string handshake = std::string(1, 1) + std::string(1, 0) + uint16(body.size()) + body;
+  return std::string{0x16, 0x03, 0x01} + prefixed16(handshake);
+}
+
+} // namespace
+
+class TlsClientHelloParserTest : public testing::Test {
+public:
+  bool parse(const std::string& data) {
+    return TlsClientHelloParser::parse(reinterpret_cast<const uint8_t*>(data.data()), data.size(),
+                                       hello_);
+  }
+
+  TlsClientHelloParser::ClientHello hello_;
+};
+
+TEST_F(TlsClientHelloParserTest, ServerNameAndApplicationProtocols) {
+  EXPECT_TRUE(parse(clientHello("WWW.Example.com", {"h2", "http/1.1"})));
+  EXPECT_TRUE(hello_.is_tls_);
+  EXPECT_EQ("www.example.com", hello_.server_name_);
+  EXPECT_EQ((std::vector<std::string>{"h2", "http/1.1"}), hello_.application_protocols_);
+}
+
+TEST_F(TlsClientHelloParserTest, NoExtensions) {
+  EXPECT_TRUE(parse(clientHello("", {})));
+  EXPECT_TRUE(hello_.is_tls_);
+  EXPECT_EQ("", hello_.server_name_);
+  EXPECT_TRUE(hello_.application_protocols_.empty());
+}
+
+TEST_F(TlsClientHelloParserTest, NeedsMoreData) {
+  const std::string hello = clientHello("www.example.com", {"h2"});
+  for (size_t i = 0; i < hello.size(); i++) {
+    EXPECT_FALSE(parse(hello.substr(0, i))) << i;
+  }
+  EXPECT_TRUE(parse(hello));
+  EXPECT_EQ("www.example.com", hello_.server_name_);
+}
+
+TEST_F(TlsClientHelloParserTest, NotTls) {
+  EXPECT_TRUE(parse("G"));
+  EXPECT_FALSE(hello_.is_tls_);
+  EXPECT_TRUE(parse("GET / HTTP/1.1\r\n\r\n"));
+  EXPECT_FALSE(hello_.is_tls_);
+  EXPECT_TRUE(parse(std::string{0x16, 0x02}));
+  EXPECT_FALSE(hello_.is_tls_);
+  // A handshake record that is not a ClientHello.
+  EXPECT_TRUE(parse(std::string{0x16, 0x03, 0x01, 0x00, 0x04, 0x02}));
+  EXPECT_FALSE(hello_.is_tls_);
+}
+
+TEST_F(TlsClientHelloParserTest, Malformed) {
+  std::string hello = clientHello("www.example.com", {});
+  // Claim a longer server name than the extension holds.
+  const size_t name_length = hello.find("www.example.com") - 1;
+  hello[name_length] = 100;
+  EXPECT_TRUE(parse(hello));
+  EXPECT_FALSE(hello_.is_tls_);
+  EXPECT_EQ("", hello_.server_name_);
+}
+
+TEST_F(TlsClientHelloParserTest, SpansRecords) {
+  std::string hello = clientHello("www.example.com", {});
+  // Claim a ClientHello longer than the record, as if it continued in a second record.
+  hello[6] = 1;
+  EXPECT_TRUE(parse(hello));
+  EXPECT_TRUE(hello_.is_tls_);
+  EXPECT_EQ("", hello_.server_name_);
+}
+
+class TlsInspectorTest : public testing::TestWithParam<Address::IpVersion> {
+public:
+  TlsInspectorTest()
+      : socket_(Network::Test::getCanonicalLoopbackAddress(GetParam()), true),
+        listener_(connection_handler_, dispatcher_, socket_, callbacks_, stats_store_,
+                  {.bind_to_port_ = true,
+                   .use_proxy_proto_ = false,
+                   .use_original_dst_ = false,
+                   .per_connection_buffer_limit_bytes_ = 0,
+                   .connection_balancer_ = nullptr,
+                   .inspect_tls_client_hello_ = true,
+                   .socket_options_ = nullptr}) {
+    conn_ = dispatcher_.createClientConnection(socket_.localAddress());
+    conn_->addConnectionCallbacks(connection_callbacks_);
+    conn_->connect();
+  }
+
+  void write(const std::string& s) {
+    Buffer::OwnedImpl buf(s);
+    conn_->write(buf);
+  }
+
+  // Run until the server side of the connection has read the given data.
+  void expectConnection(const std::string& server_name,
+                        const std::vector<std::string>& application_protocols,
+                        const std::string& data) {
+    ConnectionPtr accepted_connection;
+    read_filter_.reset(new MockReadFilter());
+    EXPECT_CALL(callbacks_, onNewConnection_(_))
+        .WillOnce(Invoke([&](ConnectionPtr& conn) -> void {
+          EXPECT_EQ(server_name, conn->requestedServerName());
+          EXPECT_EQ(application_protocols, conn->requestedApplicationProtocols());
+          conn->addReadFilter(read_filter_);
+          accepted_connection = std::move(conn);
+        }));
+    EXPECT_CALL(*read_filter_, onNewConnection());
+    EXPECT_CALL(*read_filter_, onData(BufferStringEqual(data)))
+        .WillOnce(Invoke([&](Buffer::Instance&) -> FilterStatus {
+          dispatcher_.exit();
+          return FilterStatus::StopIteration;
+        }));
+
+    dispatcher_.run(Event::Dispatcher::RunType::Block);
+    accepted_connection->close(ConnectionCloseType::NoFlush);
+    conn_->close(ConnectionCloseType::NoFlush);
+  }
+
+  Event::DispatcherImpl dispatcher_;
+  TcpListenSocket socket_;
+  Stats::IsolatedStoreImpl stats_store_;
+  MockListenerCallbacks callbacks_;
+  Network::MockConnectionHandler connection_handler_;
+  ListenerImpl listener_;
+  ClientConnectionPtr conn_;
+  NiceMock<MockConnectionCallbacks> connection_callbacks_;
+  std::shared_ptr<MockReadFilter> read_filter_;
+};
+
+// Parameterize the listener socket address version.
+INSTANTIATE_TEST_CASE_P(IpVersions, TlsInspectorTest,
+                        testing::ValuesIn(TestEnvironment::getIpVersionsForTest()));
+
+TEST_P(TlsInspectorTest, ClientHello) {
+  // The connection still reads the whole ClientHello, as nothing is consumed by the inspector.
+  const std::string hello = clientHello("www.example.com", {"h2"});
+  write(hello);
+  expectConnection("www.example.com", {"h2"}, hello);
+  EXPECT_EQ(1U, stats_store_.counter("downstream_cx_tls_inspector_tls_found").value());
+}
+
+TEST_P(TlsInspectorTest, NotTls) {
+  write("GET / HTTP/1.1\r\n\r\n");
+  expectConnection("", {}, "GET / HTTP/1.1\r\n\r\n");
+  EXPECT_EQ(1U, stats_store_.counter("downstream_cx_tls_inspector_tls_not_found").value());
+}
+
+} // Network
+} // Envoy
@@ -1,3 +1,8 @@
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
 #include <cstdint>
 #include <list>
 #include <string>
@@ -348,5 +353,58 @@ TEST(PortRangeListTest, Normal) {
   }
 }
 
+TEST(NetworkUtility, ParseSocketOptions) {
+  EXPECT_EQ(nullptr, Utility::parseSocketOptions(*Json::Factory::loadFromString("{}")));
+
+  SocketOptionsConstSharedPtr options = Utility::parseSocketOptions(*Json::Factory::loadFromString(
+      R"EOF({"socket_options": {"keepalive": {"probes": 3, "time_s": 60}, "user_timeout_ms": 5000,
+             "tcp_fast_open": true}})EOF"));
+  ASSERT_NE(nullptr, options);
+  EXPECT_TRUE(options->keepalive_);
+  EXPECT_EQ(3U, options->keepalive_probes_.value());
+  EXPECT_EQ(60U, options->keepalive_time_.value());
+  EXPECT_FALSE(options->keepalive_interval_.valid());
+  EXPECT_EQ(5000U, options->user_timeout_ms_.value());
+  EXPECT_FALSE(options->send_buffer_bytes_.valid());
+  EXPECT_TRUE(options->tcp_fast_open_);
+  EXPECT_FALSE(options->tcp_fast_open_queue_length_.valid());
+
+  options = Utility::parseSocketOptions(
+      *Json::Factory::loadFromString(R"EOF({"socket_options": {"send_buffer_bytes": 8192}})EOF"));
+  ASSERT_NE(nullptr, options);
+  EXPECT_FALSE(options->keepalive_);
+  EXPECT_EQ(8192U, options->send_buffer_bytes_.value());
+  EXPECT_FALSE(options->tcp_fast_open_);
+}
+
+TEST(NetworkUtility, ApplySocketOptions) {
+  const auto get = [](int fd, int level, int name) -> int {
+    int value = 0;
+    socklen_t len = sizeof(value);
+    EXPECT_EQ(0, getsockopt(fd, level, name, &value, &len));
+    return value;
+  };
+
+  SocketOptions options;
+  options.keepalive_ = true;
+  options.keepalive_probes_.value(3);
+  options.keepalive_time_.value(60);
+  options.keepalive_interval_.value(10);
+  options.user_timeout_ms_.value(5000);
+
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(fd, 0);
+  EXPECT_TRUE(Utility::applySocketOptions(fd, options));
+  EXPECT_EQ(1, get(fd, SOL_SOCKET, SO_KEEPALIVE));
+  EXPECT_EQ(3, get(fd, IPPROTO_TCP, TCP_KEEPCNT));
+  EXPECT_EQ(60, get(fd, IPPROTO_TCP, TCP_KEEPIDLE));
+  EXPECT_EQ(10, get(fd, IPPROTO_TCP, TCP_KEEPINTVL));
+  EXPECT_EQ(5000, get(fd, IPPROTO_TCP, TCP_USER_TIMEOUT));
+  ::close(fd);
+
+  // An option that cannot be set fails the whole set.
+  EXPECT_FALSE(Utility::applySocketOptions(-1, options));
+}
+
 } // Network
 } // Envoy
@@ -0,0 +1,280 @@
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/json/json_loader.h"
+#include "common/ratelimit/local_ratelimit_impl.h"
+#include "common/stats/stats_impl.h"
+
+#include "test/mocks/common.h"
+#include "test/mocks/event/mocks.h"
+#include "test/mocks/ratelimit/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
+#include "test/mocks/upstream/mocks.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace Envoy {
+using testing::_;
+using testing::Invoke;
+using testing::NiceMock;
+using testing::WithArg;
+
+namespace RateLimit {
+
+class MockRequestCallbacks : public RequestCallbacks {
+public:
+  MOCK_METHOD1(complete, void(LimitStatus status));
+};
+
+class LocalRateLimitTest : public testing::Test {
+public:
+  LocalRateLimitTest() {
+    ON_CALL(time_source_, currentTime()).WillByDefault(Invoke([this]() -> MonotonicTime {
+      return time_;
+    }));
+  }
+
+  void setup(const std::string& json, uint32_t num_workers = 1) {
+    Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
+    rebalance_timer_ = new NiceMock<Event::MockTimer>(&dispatcher_);
+    limiter_.reset(
+        new LocalRateLimiter(*config, tls_, dispatcher_, store_, time_source_, num_workers));
+  }
+
+  void expectLimit(Client& client, const std::vector<Descriptor>& descriptors,
+                   LimitStatus status) {
+    EXPECT_CALL(request_callbacks_, complete(status));
+    client.limit(request_callbacks_, "foo", descriptors, Tracing::EMPTY_CONTEXT);
+  }
+
+  const std::string config_{R"EOF(
+  {
+    "limits": [
+      {
+        "domain": "foo",
+        "descriptor": [{"key": "generic_key", "value": "a"}],
+        "requests_per_second": 10,
+        "burst": 2
+      },
+      {
+        "domain": "foo",
+        "descriptor": [{"key": "generic_key", "value": "b"}],
+        "requests_per_second": 10,
+        "burst": 4
+      }
+    ]
+  }
+  )EOF"};
+
+  const std::vector<Descriptor> descriptor_a_{{{{"generic_key", "a"}}}};
+  const std::vector<Descriptor> descriptor_b_{{{{"generic_key", "b"}}}};
+
+  NiceMock<ThreadLocal::MockInstance> tls_;
+  NiceMock<Event::MockDispatcher> dispatcher_;
+  Event::MockTimer* rebalance_timer_{};
+  Stats::IsolatedStoreImpl store_;
+  NiceMock<MockMonotonicTimeSource> time_source_;
+  MonotonicTime time_;
+  LocalRateLimiterSharedPtr limiter_;
+  MockRequestCallbacks request_callbacks_;
+};
+
+TEST_F(LocalRateLimitTest, BadConfig) {
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(
+      R"EOF({"limits": [{"domain": "foo", "descriptor": [{"key": "a"}], "requests_per_second": 1}]})EOF");
+  EXPECT_THROW(LocalRateLimiter(*config, tls_, dispatcher_, store_, time_source_, 1),
+               Json::Exception);
+
+  config = Json::Factory::loadFromString(R"EOF(
+  {
+    "limits": [
+      {"domain": "foo", "descriptor": [{"key": "a", "value": "b"}], "requests_per_second": 1},
+      {"domain": "foo", "descriptor": [{"key": "a", "value": "b"}], "requests_per_second": 2}
+    ]
+  }
+  )EOF");
+  EXPECT_THROW(LocalRateLimiter(*config, tls_, dispatcher_, store_, time_source_, 1),
+               EnvoyException);
+}
+
+TEST_F(LocalRateLimitTest, Local) {
+  setup(config_);
+  LocalClientImpl client(limiter_, nullptr);
+
+  expectLimit(client, descriptor_a_, LimitStatus::OK);
+  expectLimit(client, descriptor_a_, LimitStatus::OK);
+  expectLimit(client, descriptor_a_, LimitStatus::OverLimit);
+
+  // Other descriptors have their own buckets.
+  expectLimit(client, descriptor_b_, LimitStatus::OK);
+
+  // Descriptors without a local limit are always allowed.
+  expectLimit(client, {{{{"generic_key", "c"}}}}, LimitStatus::OK);
+  expectLimit(client, {{{{"generic_key", "a"}, {"remote_address", "10.0.0.1"}}}}, LimitStatus::OK);
+
+  time_ += std::chrono::milliseconds(100);
+  expectLimit(client, descriptor_a_, LimitStatus::OK);
+  expectLimit(client, descriptor_a_, LimitStatus::OverLimit);
+
+  // The burst caps how many tokens can build up.
+  time_ += std::chrono::seconds(10);
+  expectLimit(client, descriptor_a_, LimitStatus::OK);
+  expectLimit(client, descriptor_a_, LimitStatus::OK);
+  expectLimit(client, descriptor_a_, LimitStatus::OverLimit);
+
+  EXPECT_EQ(7U, store_.counter("ratelimit.local.ok").value());
+  EXPECT_EQ(3U, store_.counter("ratelimit.local.over_limit").value());
+}
+
+TEST_F(LocalRateLimitTest, AllDescriptorsMustBeUnderLimit) {
+  setup(config_);
+  LocalClientImpl client(limiter_, nullptr);
+
+  const std::vector<Descriptor> both{descriptor_a_[0], descriptor_b_[0]};
+  expectLimit(client, both, LimitStatus::OK);
+  expectLimit(client, both, LimitStatus::OK);
+  expectLimit(client, both, LimitStatus::OverLimit);
+
+  // No token was taken from b by the request that went over the limit of a.
+  expectLimit(client, descriptor_b_, LimitStatus::OK);
+  expectLimit(client, descriptor_b_, LimitStatus::OK);
+  expectLimit(client, descriptor_b_, LimitStatus::OverLimit);
+}
+
+TEST_F(LocalRateLimitTest, Rebalance) {
+  // Simulate two workers by keeping each thread's data and switching between them.
+  std::vector<ThreadLocal::ThreadLocalObjectSharedPtr> threads;
+  EXPECT_CALL(tls_, set(_, _))
+      .WillOnce(Invoke([&](uint32_t, ThreadLocal::Instance::InitializeCb cb) -> void {
+        threads.push_back(cb(tls_.dispatcher_));
+        threads.push_back(cb(tls_.dispatcher_));
+      }));
+  setup(R"EOF(
+  {
+    "limits": [
+      {
+        "domain": "foo",
+        "descriptor": [{"key": "generic_key", "value": "a"}],
+        "requests_per_second": 10,
+        "burst": 10
+      }
+    ]
+  }
+  )EOF",
+        2);
+  LocalClientImpl client(limiter_, nullptr);
+  auto useThread = [&](uint32_t thread) -> void { tls_.data_[0] = threads[thread]; };
+
+  // Each worker starts with half of the limit.
+  useThread(0);
+  for (uint32_t i = 0; i < 5; i++) {
+    expectLimit(client, descriptor_a_, LimitStatus::OK);
+  }
+  expectLimit(client, descriptor_a_, LimitStatus::OverLimit);
+
+  // Thread 0 got all of the traffic, so it now gets 95% of the rate and thread 1 gets the rest.
+  EXPECT_CALL(*rebalance_timer_, enableTimer(std::chrono::milliseconds(1000)));
+  rebalance_timer_->callback_();
+  time_ += std::chrono::seconds(1);
+
+  for (uint32_t i = 0; i < 9; i++) {
+    expectLimit(client, descriptor_a_, LimitStatus::OK);
+  }
+  expectLimit(client, descriptor_a_, LimitStatus::OverLimit);
+
+  useThread(1);
+  expectLimit(client, descriptor_a_, LimitStatus::OverLimit);
+
+  // Thread 1 saw one of the eleven requests in that interval.
+  limiter_->rebalance();
+  const double share = 0.1 / 2 + 0.9 / 11;
+  EXPECT_DOUBLE_EQ(10 * share, limiter_->capacity(0, limiter_->bucket(0)));
+
+  // Without traffic in the last interval the split is kept.
+  limiter_->rebalance();
+  EXPECT_DOUBLE_EQ(10 * share, limiter_->capacity(0, limiter_->bucket(0)));
+}
+
+TEST_F(LocalRateLimitTest, Hybrid) {
+  setup(R"EOF(
+  {
+    "limits": [
+      {
+        "domain": "foo",
+        "descriptor": [{"key": "generic_key", "value": "a"}],
+        "requests_per_second": 10,
+        "burst": 4
+      }
+    ],
+    "hybrid": {"cluster_name": "ratelimit", "threshold_percent": 50}
+  }
+  )EOF");
+  MockClient* remote = new MockClient();
+  LocalClientImpl client(limiter_, ClientPtr{remote});
+
+  // While the bucket is at least half full it answers locally.
+  expectLimit(client, descriptor_a_, LimitStatus::OK);
+  expectLimit(client, descriptor_a_, LimitStatus::OK);
+  expectLimit(client, descriptor_a_, LimitStatus::OK);
+
+  // Close to exhaustion the remote service decides.
+  EXPECT_CALL(*remote, limit(_, "foo", descriptor_a_, _))
+      .WillOnce(WithArg<0>(
+          Invoke([](RequestCallbacks& callbacks) -> void { callbacks.complete(LimitStatus::OK); })));
+  expectLimit(client, descriptor_a_, LimitStatus::OK);
+
+  EXPECT_CALL(*remote, limit(_, "foo", descriptor_a_, _))
+      .WillOnce(WithArg<0>(Invoke(
+          [](RequestCallbacks& callbacks) -> void { callbacks.complete(LimitStatus::OverLimit); })));
+  expectLimit(client, descriptor_a_, LimitStatus::OverLimit);
+
+  // If the remote service fails the local bucket decides, and it is empty now.
+  EXPECT_CALL(*remote, limit(_, "foo", descriptor_a_, _))
+      .WillOnce(WithArg<0>(
+          Invoke([](RequestCallbacks& callbacks) -> void { callbacks.complete(LimitStatus::Error); })));
+  expectLimit(client, descriptor_a_, LimitStatus::OverLimit);
+
+  // Descriptors without a local limit always go to the remote service.
+  const std::vector<Descriptor> unmatched{{{{"generic_key", "c"}}}};
+  RequestCallbacks* remote_callbacks = nullptr;
+  EXPECT_CALL(*remote, limit(_, "foo", unmatched, _))
+      .WillOnce(WithArg<0>(
+          Invoke([&](RequestCallbacks& callbacks) -> void { remote_callbacks = &callbacks; })));
+  client.limit(request_callbacks_, "foo", unmatched, Tracing::EMPTY_CONTEXT);
+  EXPECT_CALL(*remote, cancel());
+  client.cancel();
+
+  EXPECT_EQ(4U, store_.counter("ratelimit.local.remote_check").value());
+  EXPECT_NE(nullptr, remote_callbacks);
+}
+
+TEST_F(LocalRateLimitTest, Factory) {
+  NiceMock<Upstream::MockClusterManager> cm;
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(R"EOF(
+  {
+    "limits": [
+      {
+        "domain": "foo",
+        "descriptor": [{"key": "generic_key", "value": "a"}],
+        "requests_per_second": 10
+      }
+    ],
+    "hybrid": {"cluster_name": "ratelimit"}
+  }
+  )EOF");
+  new NiceMock<Event::MockTimer>(&dispatcher_);
+  LocalFactoryImpl factory(*config, cm, tls_, dispatcher_, store_, time_source_, 1);
+  ClientPtr client = factory.create(Optional<std::chrono::milliseconds>());
+  EXPECT_NE(nullptr, dynamic_cast<LocalClientImpl*>(client.get()));
+
+  EXPECT_CALL(cm, get("ratelimit")).WillOnce(testing::Return(nullptr));
+  new NiceMock<Event::MockTimer>(&dispatcher_);
+  EXPECT_THROW(LocalFactoryImpl(*config, cm, tls_, dispatcher_, store_, time_source_, 1),
+               EnvoyException);
+}
+
+} // RateLimit
+} // Envoy
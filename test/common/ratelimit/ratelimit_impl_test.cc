@@ -5,8 +5,12 @@
 #include "common/http/header_map_impl.h"
 #include "common/http/headers.h"
 #include "common/ratelimit/ratelimit_impl.h"
+#include "common/stats/stats_impl.h"
 
+#include "test/mocks/common.h"
+#include "test/mocks/event/mocks.h"
 #include "test/mocks/grpc/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
 #include "test/mocks/upstream/mocks.h"
 #include "test/test_common/printers.h"
 
@@ -17,6 +21,7 @@ namespace Envoy {
 using testing::_;
 using testing::AtLeast;
 using testing::Invoke;
+using testing::NiceMock;
 using testing::Return;
 using testing::WithArg;
 
@@ -124,6 +129,178 @@ TEST_F(RateLimitGrpcClientTest, Cancel) {
   client_.cancel();
 }
 
+class RateLimitCoalescerTest : public testing::Test, public Grpc::RpcChannelFactory {
+public:
+  RateLimitCoalescerTest() {
+    ON_CALL(time_source_, currentTime()).WillByDefault(Invoke([this]() -> MonotonicTime {
+      return time_;
+    }));
+  }
+
+  // Grpc::RpcChannelFactory
+  Grpc::RpcChannelPtr create(Grpc::RpcChannelCallbacks& callbacks,
+                             const Optional<std::chrono::milliseconds>&) {
+    channels_.push_back(new Grpc::MockRpcChannel());
+    channel_callbacks_.push_back(&callbacks);
+    return Grpc::RpcChannelPtr{channels_.back()};
+  }
+
+  void setup(std::chrono::milliseconds window) {
+    coalescer_.reset(new RequestCoalescer(*this, dispatcher_, window, time_source_, stats_));
+  }
+
+  std::unique_ptr<GrpcClientImpl> createClient() {
+    return std::unique_ptr<GrpcClientImpl>{
+        new GrpcClientImpl(*this, Optional<std::chrono::milliseconds>(), coalescer_.get())};
+  }
+
+  void expectRequest(uint32_t channel, const std::vector<Descriptor>& descriptors,
+                     uint32_t hits_addend) {
+    pb::lyft::ratelimit::RateLimitRequest request;
+    GrpcClientImpl::createRequest(request, "foo", descriptors);
+    if (hits_addend > 0) {
+      request.set_hits_addend(hits_addend);
+    }
+
+    EXPECT_CALL(*channels_[channel], CallMethod(_, _, ProtoMessageEqual(&request), _, nullptr))
+        .WillOnce(WithArg<3>(Invoke([this](proto::Message* raw_response) -> void {
+          response_ = dynamic_cast<pb::lyft::ratelimit::RateLimitResponse*>(raw_response);
+        })));
+  }
+
+  void respondOverLimit(uint32_t channel, uint32_t duration_until_reset_ms) {
+    response_->Clear();
+    response_->set_overall_code(pb::lyft::ratelimit::RateLimitResponse_Code_OVER_LIMIT);
+    pb::lyft::ratelimit::RateLimitResponse::DescriptorStatus* status = response_->add_statuses();
+    status->set_code(pb::lyft::ratelimit::RateLimitResponse_Code_OVER_LIMIT);
+    status->set_duration_until_reset_ms(duration_until_reset_ms);
+    channel_callbacks_[channel]->onSuccess();
+  }
+
+  const std::vector<Descriptor> descriptors_{{{{"foo", "bar"}}}};
+  std::vector<Grpc::MockRpcChannel*> channels_;
+  std::vector<Grpc::RpcChannelCallbacks*> channel_callbacks_;
+  NiceMock<Event::MockDispatcher> dispatcher_;
+  NiceMock<MockMonotonicTimeSource> time_source_;
+  MonotonicTime time_;
+  Stats::IsolatedStoreImpl store_;
+  RateLimitClientStats stats_{
+      ALL_RATE_LIMIT_CLIENT_STATS(POOL_COUNTER_PREFIX(store_, "ratelimit.client."))};
+  std::unique_ptr<RequestCoalescer> coalescer_;
+  pb::lyft::ratelimit::RateLimitResponse* response_{};
+  MockRequestCallbacks request_callbacks_;
+};
+
+TEST_F(RateLimitCoalescerTest, OverLimitCache) {
+  setup(std::chrono::milliseconds(0));
+  std::unique_ptr<GrpcClientImpl> client = createClient();
+
+  // Without a reset hint nothing is cached.
+  expectRequest(0, descriptors_, 0);
+  client->limit(request_callbacks_, "foo", descriptors_, Tracing::EMPTY_CONTEXT);
+  EXPECT_CALL(request_callbacks_, complete(LimitStatus::OverLimit));
+  respondOverLimit(0, 0);
+
+  expectRequest(0, descriptors_, 0);
+  client->limit(request_callbacks_, "foo", descriptors_, Tracing::EMPTY_CONTEXT);
+  EXPECT_CALL(request_callbacks_, complete(LimitStatus::OverLimit));
+  respondOverLimit(0, 1000);
+
+  // Until the reset any request that contains the descriptor is answered locally.
+  EXPECT_CALL(request_callbacks_, complete(LimitStatus::OverLimit));
+  client->limit(request_callbacks_, "foo", descriptors_, Tracing::EMPTY_CONTEXT);
+  std::unique_ptr<GrpcClientImpl> client2 = createClient();
+  EXPECT_CALL(request_callbacks_, complete(LimitStatus::OverLimit));
+  client2->limit(request_callbacks_, "foo", {{{{"a", "b"}}}, descriptors_[0]},
+                 Tracing::EMPTY_CONTEXT);
+  EXPECT_EQ(2U, store_.counter("ratelimit.client.rq_over_limit_cached").value());
+
+  // The same descriptor in another domain is not affected.
+  EXPECT_CALL(*channels_[0], CallMethod(_, _, _, _, nullptr));
+  client->limit(request_callbacks_, "bar", descriptors_, Tracing::EMPTY_CONTEXT);
+  EXPECT_CALL(*channels_[0], cancel());
+  client->cancel();
+
+  time_ += std::chrono::milliseconds(1000);
+  expectRequest(1, descriptors_, 0);
+  client2->limit(request_callbacks_, "foo", descriptors_, Tracing::EMPTY_CONTEXT);
+  EXPECT_CALL(request_callbacks_, complete(LimitStatus::OK));
+  response_->Clear();
+  response_->set_overall_code(pb::lyft::ratelimit::RateLimitResponse_Code_OK);
+  channel_callbacks_[1]->onSuccess();
+}
+
+TEST_F(RateLimitCoalescerTest, Coalesce) {
+  setup(std::chrono::milliseconds(5));
+  std::unique_ptr<GrpcClientImpl> client1 = createClient();
+  std::unique_ptr<GrpcClientImpl> client2 = createClient();
+  std::unique_ptr<GrpcClientImpl> client3 = createClient();
+
+  // Channels 0-2 belong to the clients. Each coalesced request gets its own channel.
+  Event::MockTimer* timer1 = new Event::MockTimer(&dispatcher_);
+  EXPECT_CALL(*timer1, enableTimer(std::chrono::milliseconds(5)));
+  client1->limit(request_callbacks_, "foo", descriptors_, Tracing::EMPTY_CONTEXT);
+  client2->limit(request_callbacks_, "foo", descriptors_, Tracing::EMPTY_CONTEXT);
+  EXPECT_EQ(1U, store_.counter("ratelimit.client.rq_coalesced").value());
+
+  Event::MockTimer* timer2 = new NiceMock<Event::MockTimer>(&dispatcher_);
+  MockRequestCallbacks request_callbacks3;
+  client3->limit(request_callbacks3, "foo", {{{{"foo", "baz"}}}}, Tracing::EMPTY_CONTEXT);
+
+  expectRequest(3, descriptors_, 2);
+  timer1->callback_();
+
+  // Requests made while the shared request is in flight start a new one.
+  new NiceMock<Event::MockTimer>(&dispatcher_);
+  std::unique_ptr<GrpcClientImpl> client4 = createClient();
+  client4->limit(request_callbacks_, "foo", descriptors_, Tracing::EMPTY_CONTEXT);
+
+  EXPECT_CALL(request_callbacks_, complete(LimitStatus::OverLimit)).Times(2);
+  EXPECT_CALL(dispatcher_, deferredDelete_(_));
+  respondOverLimit(3, 0);
+
+  // A single client sends no hits_addend.
+  expectRequest(4, {{{{"foo", "baz"}}}}, 0);
+  timer2->callback_();
+  EXPECT_CALL(request_callbacks3, complete(LimitStatus::Error));
+  EXPECT_CALL(dispatcher_, deferredDelete_(_));
+  channel_callbacks_[4]->onFailure(Optional<uint64_t>(), "foo");
+
+  // A request that every client left before the window ended is never sent.
+  EXPECT_CALL(*channels_[5], CallMethod(_, _, _, _, _)).Times(0);
+  client4->cancel();
+}
+
+TEST_F(RateLimitCoalescerTest, CancelAfterSend) {
+  setup(std::chrono::milliseconds(5));
+  std::unique_ptr<GrpcClientImpl> client = createClient();
+
+  Event::MockTimer* timer = new NiceMock<Event::MockTimer>(&dispatcher_);
+  client->limit(request_callbacks_, "foo", descriptors_, Tracing::EMPTY_CONTEXT);
+  expectRequest(1, descriptors_, 0);
+  timer->callback_();
+  client->cancel();
+
+  // The response still fills the cache.
+  respondOverLimit(1, 1000);
+  EXPECT_CALL(request_callbacks_, complete(LimitStatus::OverLimit));
+  client->limit(request_callbacks_, "foo", descriptors_, Tracing::EMPTY_CONTEXT);
+}
+
+TEST_F(RateLimitCoalescerTest, Shutdown) {
+  setup(std::chrono::milliseconds(5));
+  std::unique_ptr<GrpcClientImpl> client = createClient();
+
+  Event::MockTimer* timer = new NiceMock<Event::MockTimer>(&dispatcher_);
+  client->limit(request_callbacks_, "foo", descriptors_, Tracing::EMPTY_CONTEXT);
+  expectRequest(1, descriptors_, 0);
+  timer->callback_();
+  client->cancel();
+
+  EXPECT_CALL(*channels_[1], cancel());
+  coalescer_->shutdown();
+}
+
 TEST(RateLimitGrpcFactoryTest, NoCluster) {
   std::string json = R"EOF(
   {
@@ -133,23 +310,31 @@ TEST(RateLimitGrpcFactoryTest, NoCluster) {
 
   Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
   Upstream::MockClusterManager cm;
+  NiceMock<ThreadLocal::MockInstance> tls;
+  Stats::IsolatedStoreImpl stats;
+  MockMonotonicTimeSource time_source;
 
   EXPECT_CALL(cm, get("foo")).WillOnce(Return(nullptr));
-  EXPECT_THROW(GrpcFactoryImpl(*config, cm), EnvoyException);
+  EXPECT_THROW(GrpcFactoryImpl(*config, cm, tls, stats, time_source), EnvoyException);
 }
 
 TEST(RateLimitGrpcFactoryTest, Create) {
   std::string json = R"EOF(
   {
-    "cluster_name": "foo"
+    "cluster_name": "foo",
+    "coalesce_window_ms": 5
   }
   )EOF";
 
   Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
   Upstream::MockClusterManager cm;
+  NiceMock<ThreadLocal::MockInstance> tls;
+  Stats::IsolatedStoreImpl stats;
+  MockMonotonicTimeSource time_source;
 
   EXPECT_CALL(cm, get("foo")).Times(AtLeast(1));
-  GrpcFactoryImpl factory(*config, cm);
+  EXPECT_CALL(tls, set(_, _));
+  GrpcFactoryImpl factory(*config, cm, tls, stats, time_source);
   factory.create(Optional<std::chrono::milliseconds>());
 }
 
@@ -0,0 +1,139 @@
+#include <string>
+#include <vector>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/redis/cluster_slots.h"
+#include "common/redis/codec_impl.h"
+
+#include "test/test_common/utility.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Redis {
+
+class RedisClusterSlotsTest : public testing::Test, public DecoderCallbacks {
+public:
+  // Redis::DecoderCallbacks
+  void onRespValue(RespValuePtr&& value) override { value_ = std::move(value); }
+
+  void decode(const std::string& data, bool retain_raw) {
+    DecoderImpl decoder(*this, retain_raw);
+    Buffer::OwnedImpl buffer(data);
+    decoder.decode(buffer);
+    ASSERT_NE(nullptr, value_);
+  }
+
+  void makeError(const std::string& error) {
+    value_.reset(new RespValue());
+    value_->type(RespType::Error);
+    value_->asString() = error;
+  }
+
+  // Two primaries. The second entry also lists a replica.
+  const std::string slots_response_{
+      "*2\r\n"
+      "*3\r\n:0\r\n:8191\r\n*3\r\n$8\r\n10.0.0.1\r\n:6379\r\n$2\r\nid\r\n"
+      "*4\r\n:8192\r\n:16383\r\n*2\r\n$3\r\n::1\r\n:7000\r\n*2\r\n$8\r\n10.0.0.3\r\n:7001\r\n"};
+  RespValuePtr value_;
+};
+
+TEST_F(RedisClusterSlotsTest, KeySlot) {
+  EXPECT_EQ(12739U, ClusterSlotUtility::keySlot("123456789"));
+  EXPECT_EQ(12182U, ClusterSlotUtility::keySlot("foo"));
+  EXPECT_EQ(5061U, ClusterSlotUtility::keySlot("bar"));
+  EXPECT_EQ(0U, ClusterSlotUtility::keySlot(""));
+
+  // Only the hash tag is hashed.
+  EXPECT_EQ(3443U, ClusterSlotUtility::keySlot("user1000"));
+  EXPECT_EQ(3443U, ClusterSlotUtility::keySlot("{user1000}.following"));
+  EXPECT_EQ(3443U, ClusterSlotUtility::keySlot("{user1000}.followers"));
+  EXPECT_EQ(5061U, ClusterSlotUtility::keySlot("foo{bar}{zap}"));
+
+  // An empty hash tag does not count, so the whole key is hashed.
+  EXPECT_EQ(8363U, ClusterSlotUtility::keySlot("foo{}{bar}"));
+  EXPECT_EQ(15257U, ClusterSlotUtility::keySlot("{}"));
+
+  // So does an unterminated one.
+  EXPECT_EQ(7673U, ClusterSlotUtility::keySlot("foo{"));
+  EXPECT_EQ(4015U, ClusterSlotUtility::keySlot("{bar"));
+}
+
+TEST_F(RedisClusterSlotsTest, ParseSlots) {
+  for (bool retain_raw : {false, true}) {
+    decode(slots_response_, retain_raw);
+    std::vector<ClusterSlotUtility::SlotRange> ranges;
+    EXPECT_TRUE(ClusterSlotUtility::parseSlots(*value_, ranges));
+    ASSERT_EQ(2UL, ranges.size());
+    EXPECT_EQ(0U, ranges[0].start_);
+    EXPECT_EQ(8191U, ranges[0].end_);
+    EXPECT_EQ("10.0.0.1:6379", ranges[0].primary_);
+    EXPECT_EQ(8192U, ranges[1].start_);
+    EXPECT_EQ(16383U, ranges[1].end_);
+    EXPECT_EQ("[::1]:7000", ranges[1].primary_);
+  }
+}
+
+TEST_F(RedisClusterSlotsTest, ParseSlotsInvalid) {
+  std::vector<ClusterSlotUtility::SlotRange> ranges;
+
+  decode("-ERR This instance has cluster support disabled\r\n", true);
+  EXPECT_FALSE(ClusterSlotUtility::parseSlots(*value_, ranges));
+
+  // End before start.
+  decode("*1\r\n*3\r\n:10\r\n:9\r\n*2\r\n$8\r\n10.0.0.1\r\n:6379\r\n", false);
+  EXPECT_FALSE(ClusterSlotUtility::parseSlots(*value_, ranges));
+
+  // Slot out of range.
+  decode("*1\r\n*3\r\n:0\r\n:16384\r\n*2\r\n$8\r\n10.0.0.1\r\n:6379\r\n", true);
+  EXPECT_FALSE(ClusterSlotUtility::parseSlots(*value_, ranges));
+
+  // No port.
+  decode("*1\r\n*3\r\n:0\r\n:16383\r\n*1\r\n$8\r\n10.0.0.1\r\n", false);
+  EXPECT_FALSE(ClusterSlotUtility::parseSlots(*value_, ranges));
+
+  // No primary.
+  decode("*1\r\n*2\r\n:0\r\n:16383\r\n", false);
+  EXPECT_FALSE(ClusterSlotUtility::parseSlots(*value_, ranges));
+}
+
+TEST_F(RedisClusterSlotsTest, ParseRedirect) {
+  ClusterSlotUtility::Redirect redirect;
+
+  makeError("MOVED 3999 127.0.0.1:6381");
+  EXPECT_TRUE(ClusterSlotUtility::parseRedirect(*value_, redirect));
+  EXPECT_FALSE(redirect.ask_);
+  EXPECT_EQ(3999U, redirect.slot_);
+  EXPECT_EQ("127.0.0.1:6381", redirect.address_);
+
+  makeError("ASK 16383 ::1:7000");
+  EXPECT_TRUE(ClusterSlotUtility::parseRedirect(*value_, redirect));
+  EXPECT_TRUE(redirect.ask_);
+  EXPECT_EQ(16383U, redirect.slot_);
+  EXPECT_EQ("[::1]:7000", redirect.address_);
+
+  // Errors received from upstream only keep their contents next to the raw bytes.
+  decode("-MOVED 1 10.0.0.1:6379\r\n", true);
+  EXPECT_TRUE(ClusterSlotUtility::parseRedirect(*value_, redirect));
+  EXPECT_EQ("10.0.0.1:6379", redirect.address_);
+}
+
+TEST_F(RedisClusterSlotsTest, ParseRedirectInvalid) {
+  ClusterSlotUtility::Redirect redirect;
+
+  value_.reset(new RespValue());
+  value_->type(RespType::SimpleString);
+  value_->asString() = "MOVED 3999 127.0.0.1:6381";
+  EXPECT_FALSE(ClusterSlotUtility::parseRedirect(*value_, redirect));
+
+  for (const std::string& error :
+       {"ERR unknown command", "MOVED 3999", "MOVED 16384 127.0.0.1:6381", "MOVED x 127.0.0.1:6381",
+        "MOVED 3999 127.0.0.1", "MOVED 3999 :6381", "MOVED 3999 127.0.0.1:port",
+        "TRYAGAIN 3999 127.0.0.1:6381"}) {
+    makeError(error);
+    EXPECT_FALSE(ClusterSlotUtility::parseRedirect(*value_, redirect)) << error;
+  }
+}
+
+} // Redis
+} // Envoy
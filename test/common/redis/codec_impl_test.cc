@@ -161,6 +161,44 @@ TEST_F(RedisEncoderDecoderImplTest, NullArray) {
   EXPECT_EQ(RespType::Null, decoded_values_[0]->type());
 }
 
+TEST_F(RedisEncoderDecoderImplTest, RetainRaw) {
+  DecoderImpl raw_decoder(*this, true);
+  buffer_.add("$3\r\nfoo\r\n:5\r\n*2\r\n$1\r\na\r\n*1\r\n+ok\r\n-error\r\n$5\r\nhel");
+  raw_decoder.decode(buffer_);
+  EXPECT_EQ(0UL, buffer_.length());
+  ASSERT_EQ(4UL, decoded_values_.size());
+
+  // Bulk string contents and array elements are only available in the raw bytes.
+  EXPECT_EQ(RespType::BulkString, decoded_values_[0]->type());
+  EXPECT_EQ("", decoded_values_[0]->asString());
+  EXPECT_EQ("$3\r\nfoo\r\n", TestUtility::bufferToString(*decoded_values_[0]->raw()));
+  EXPECT_EQ("<9 raw bytes>", decoded_values_[0]->toString());
+  EXPECT_EQ(5, decoded_values_[1]->asInteger());
+  EXPECT_EQ(":5\r\n", TestUtility::bufferToString(*decoded_values_[1]->raw()));
+  EXPECT_EQ(RespType::Array, decoded_values_[2]->type());
+  EXPECT_EQ(0UL, decoded_values_[2]->asArray().size());
+  EXPECT_EQ("*2\r\n$1\r\na\r\n*1\r\n+ok\r\n",
+            TestUtility::bufferToString(*decoded_values_[2]->raw()));
+  EXPECT_EQ("error", decoded_values_[3]->asString());
+  EXPECT_EQ("-error\r\n", TestUtility::bufferToString(*decoded_values_[3]->raw()));
+
+  // A value split across reads keeps the bytes of both.
+  buffer_.add("lo\r\n");
+  raw_decoder.decode(buffer_);
+  EXPECT_EQ(0UL, buffer_.length());
+  ASSERT_EQ(5UL, decoded_values_.size());
+  EXPECT_EQ("$5\r\nhello\r\n", TestUtility::bufferToString(*decoded_values_[4]->raw()));
+
+  // The encoder writes the raw bytes as is.
+  Buffer::OwnedImpl out;
+  encoder_.encode(*decoded_values_[4], out);
+  EXPECT_EQ("$5\r\nhello\r\n", TestUtility::bufferToString(out));
+
+  // Changing the type drops the raw bytes.
+  decoded_values_[4]->type(RespType::Null);
+  EXPECT_EQ(nullptr, decoded_values_[4]->raw());
+}
+
 TEST_F(RedisEncoderDecoderImplTest, InvalidType) {
   buffer_.add("^");
   EXPECT_THROW(decoder_.decode(buffer_), ProtocolError);
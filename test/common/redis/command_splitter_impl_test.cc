@@ -3,12 +3,16 @@
 #include <string>
 #include <vector>
 
+#include "common/json/json_loader.h"
 #include "common/redis/command_splitter_impl.h"
 #include "common/stats/stats_impl.h"
 
 #include "test/mocks/common.h"
 #include "test/mocks/redis/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
+#include "test/mocks/upstream/mocks.h"
 #include "test/test_common/printers.h"
+#include "test/test_common/utility.h"
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -19,6 +23,8 @@ using testing::ByRef;
 using testing::DoAll;
 using testing::Eq;
 using testing::InSequence;
+using testing::Invoke;
+using testing::NiceMock;
 using testing::Ref;
 using testing::Return;
 using testing::WithArg;
@@ -41,7 +47,7 @@ public:
 
   ConnPool::MockInstance* conn_pool_{new ConnPool::MockInstance()};
   Stats::IsolatedStoreImpl store_;
-  InstanceImpl splitter_{ConnPool::InstancePtr{conn_pool_}, store_, "redis.foo."};
+  InstanceImpl splitter_{ConnPool::InstancePtr{conn_pool_}, store_, "redis.foo.", nullptr};
   MockSplitCallbacks callbacks_;
   SplitRequestPtr handle_;
 };
@@ -179,7 +185,179 @@ TEST_P(RedisAllParamsToOneServerCommandHandlerTest, NoUpstream) {
 
 INSTANTIATE_TEST_CASE_P(RedisAllParamsToOneServerCommandHandlerTest,
                         RedisAllParamsToOneServerCommandHandlerTest,
-                        testing::Values("incr", "INCR", "inCrBY", "EXPIRE"));
+                        testing::Values("incr", "INCR", "inCrBY", "EXPIRE", "set"));
+
+class RedisGETCommandHandlerTest : public RedisCommandSplitterImplTest {
+public:
+  void makeRequest(const RespValue& request) {
+    EXPECT_CALL(*conn_pool_, makeReadRequest("hello", Ref(request), _))
+        .WillOnce(DoAll(WithArg<2>(SaveArgAddress(&pool_callbacks_)), Return(&pool_request_)));
+    handle_ = splitter_.makeRequest(request, callbacks_);
+  }
+
+  ConnPool::PoolCallbacks* pool_callbacks_;
+  ConnPool::MockPoolRequest pool_request_;
+};
+
+TEST_F(RedisGETCommandHandlerTest, Success) {
+  InSequence s;
+
+  RespValue request;
+  makeBulkStringArray(request, {"get", "hello"});
+  makeRequest(request);
+  EXPECT_NE(nullptr, handle_);
+
+  RespValuePtr response(new RespValue());
+  RespValue* response_ptr = response.get();
+  EXPECT_CALL(callbacks_, onResponse_(PointeesEq(response_ptr)));
+  pool_callbacks_->onResponse(std::move(response));
+  EXPECT_EQ(1UL, store_.counter("redis.foo.command.get.total").value());
+}
+
+TEST_F(RedisGETCommandHandlerTest, Fail) {
+  InSequence s;
+
+  RespValue request;
+  makeBulkStringArray(request, {"get", "hello"});
+  makeRequest(request);
+
+  RespValue response;
+  response.type(RespType::Error);
+  response.asString() = "upstream failure";
+  EXPECT_CALL(callbacks_, onResponse_(PointeesEq(&response)));
+  pool_callbacks_->onFailure();
+}
+
+TEST_F(RedisGETCommandHandlerTest, Cancel) {
+  InSequence s;
+
+  RespValue request;
+  makeBulkStringArray(request, {"get", "hello"});
+  makeRequest(request);
+
+  EXPECT_CALL(pool_request_, cancel());
+  handle_->cancel();
+}
+
+TEST_F(RedisGETCommandHandlerTest, NoUpstream) {
+  InSequence s;
+
+  RespValue request;
+  makeBulkStringArray(request, {"get", "hello"});
+  EXPECT_CALL(*conn_pool_, makeReadRequest("hello", Ref(request), _)).WillOnce(Return(nullptr));
+  RespValue response;
+  response.type(RespType::Error);
+  response.asString() = "no upstream host";
+  EXPECT_CALL(callbacks_, onResponse_(PointeesEq(&response)));
+  EXPECT_EQ(nullptr, splitter_.makeRequest(request, callbacks_));
+}
+
+class RedisReadCacheCommandSplitterTest : public RedisCommandSplitterImplTest {
+public:
+  RedisReadCacheCommandSplitterTest() {
+    std::string json_string = R"EOF(
+    {
+      "key_prefixes": ["hot:"],
+      "max_entries": 10,
+      "ttl_ms": 1000
+    }
+    )EOF";
+
+    Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json_string);
+    ON_CALL(time_source_, currentTime()).WillByDefault(Return(MonotonicTime()));
+    conn_pool_ = new ConnPool::MockInstance();
+    cached_splitter_.reset(new InstanceImpl(
+        ConnPool::InstancePtr{conn_pool_}, store_, "redis.bar.",
+        ReadCachePtr{new ReadCache(*json_config, tls_, time_source_, store_, "redis.bar.")}));
+  }
+
+  void get(const std::string& key) {
+    RespValue request;
+    makeBulkStringArray(request, {"get", key});
+    EXPECT_CALL(*conn_pool_, makeReadRequest(key, Ref(request), _))
+        .WillOnce(DoAll(WithArg<2>(SaveArgAddress(&pool_callbacks_)), Return(&pool_request_)));
+    handle_ = cached_splitter_->makeRequest(request, callbacks_);
+    EXPECT_NE(nullptr, handle_);
+  }
+
+  void respond(const std::string& value) {
+    RespValuePtr response(new RespValue());
+    response->type(RespType::BulkString);
+    response->asString() = value;
+    EXPECT_CALL(callbacks_, onResponse_(_));
+    pool_callbacks_->onResponse(std::move(response));
+  }
+
+  void expectCached(const std::string& key, const std::string& encoded) {
+    RespValue request;
+    makeBulkStringArray(request, {"get", key});
+    EXPECT_CALL(callbacks_, onResponse_(_)).WillOnce(Invoke([&](RespValuePtr& response) -> void {
+      ASSERT_NE(nullptr, response->raw());
+      EXPECT_EQ(encoded, TestUtility::bufferToString(*response->raw()));
+    }));
+    EXPECT_EQ(nullptr, cached_splitter_->makeRequest(request, callbacks_));
+  }
+
+  NiceMock<ThreadLocal::MockInstance> tls_;
+  NiceMock<MockMonotonicTimeSource> time_source_;
+  std::unique_ptr<InstanceImpl> cached_splitter_;
+  ConnPool::PoolCallbacks* pool_callbacks_;
+  ConnPool::MockPoolRequest pool_request_;
+};
+
+TEST_F(RedisReadCacheCommandSplitterTest, CachedGet) {
+  get("hot:a");
+  respond("a");
+  expectCached("hot:a", "$1\r\na\r\n");
+  EXPECT_EQ(1UL, store_.counter("redis.bar.read_cache.hit").value());
+}
+
+TEST_F(RedisReadCacheCommandSplitterTest, NotCacheable) {
+  get("cold:a");
+  respond("a");
+  get("cold:a");
+  respond("a");
+  EXPECT_EQ(0UL, store_.counter("redis.bar.read_cache.insert").value());
+}
+
+TEST_F(RedisReadCacheCommandSplitterTest, WriteInvalidates) {
+  get("hot:a");
+  respond("a");
+
+  RespValue request;
+  makeBulkStringArray(request, {"set", "hot:a", "b"});
+  EXPECT_CALL(*conn_pool_, makeRequest("hot:a", Ref(request), _)).WillOnce(Return(nullptr));
+  EXPECT_CALL(callbacks_, onResponse_(_));
+  EXPECT_EQ(nullptr, cached_splitter_->makeRequest(request, callbacks_));
+  EXPECT_EQ(1UL, store_.counter("redis.bar.read_cache.invalidated").value());
+
+  get("hot:a");
+  respond("b");
+  expectCached("hot:a", "$1\r\nb\r\n");
+}
+
+TEST_F(RedisReadCacheCommandSplitterTest, WriteWhileInFlight) {
+  get("hot:a");
+
+  RespValue request;
+  makeBulkStringArray(request, {"del", "cold:a", "hot:a"});
+  EXPECT_CALL(*conn_pool_, chooseHost(_)).WillRepeatedly(Return(nullptr));
+  EXPECT_CALL(callbacks_, onResponse_(_));
+  EXPECT_EQ(nullptr, cached_splitter_->makeRequest(request, callbacks_));
+  EXPECT_EQ(1UL, store_.counter("redis.bar.read_cache.invalidated").value());
+
+  respond("a");
+  EXPECT_EQ(0UL, store_.counter("redis.bar.read_cache.insert").value());
+}
+
+TEST_F(RedisReadCacheCommandSplitterTest, MSETInvalidatesKeysOnly) {
+  RespValue request;
+  makeBulkStringArray(request, {"mset", "hot:a", "hot:b", "cold:c", "hot:d"});
+  EXPECT_CALL(*conn_pool_, chooseHost(_)).WillRepeatedly(Return(nullptr));
+  EXPECT_CALL(callbacks_, onResponse_(_));
+  EXPECT_EQ(nullptr, cached_splitter_->makeRequest(request, callbacks_));
+  EXPECT_EQ(1UL, store_.counter("redis.bar.read_cache.invalidated").value());
+}
 
 class RedisMGETCommandHandlerTest : public RedisCommandSplitterImplTest {
 public:
@@ -204,7 +382,8 @@ public:
           null_handle_indexes.end()) {
         request_to_use = &pool_requests_[i];
       }
-      EXPECT_CALL(*conn_pool_, makeRequest(std::to_string(i), Eq(ByRef(expected_requests_[i])), _))
+      EXPECT_CALL(*conn_pool_,
+                  makeReadRequest(std::to_string(i), Eq(ByRef(expected_requests_[i])), _))
           .WillOnce(DoAll(WithArg<2>(SaveArgAddress(&pool_callbacks_[i])), Return(request_to_use)));
     }
 
@@ -363,6 +542,267 @@ TEST_F(RedisMGETCommandHandlerTest, Cancel) {
   handle_->cancel();
 };
 
+class RedisSplitKeysCommandHandlerTest : public RedisCommandSplitterImplTest {
+public:
+  void expectChooseHost(const std::string& key, Upstream::HostConstSharedPtr host,
+                        uint32_t slot = 0) {
+    EXPECT_CALL(*conn_pool_, chooseHost(key)).WillOnce(Return(host));
+    if (host) {
+      EXPECT_CALL(*conn_pool_, slot(key)).WillOnce(Return(slot));
+    }
+  }
+
+  void expectRequestToHost(uint32_t index, Upstream::HostConstSharedPtr host,
+                           const RespValue& request, bool null_handle = false) {
+    EXPECT_CALL(*conn_pool_, makeRequestToHost(Eq(host), Eq(ByRef(request)), _))
+        .WillOnce(DoAll(WithArg<2>(SaveArgAddress(&pool_callbacks_[index])),
+                        Return(null_handle ? nullptr : &pool_requests_[index])));
+  }
+
+  void respondStatus(uint32_t index, const std::string& status) {
+    RespValuePtr response(new RespValue());
+    response->type(RespType::SimpleString);
+    response->asString() = status;
+    pool_callbacks_[index]->onResponse(std::move(response));
+  }
+
+  void respondInteger(uint32_t index, int64_t value) {
+    RespValuePtr response(new RespValue());
+    response->type(RespType::Integer);
+    response->asInteger() = value;
+    pool_callbacks_[index]->onResponse(std::move(response));
+  }
+
+  Upstream::HostConstSharedPtr host1_{new Upstream::MockHost()};
+  Upstream::HostConstSharedPtr host2_{new Upstream::MockHost()};
+  ConnPool::PoolCallbacks* pool_callbacks_[2]{};
+  ConnPool::MockPoolRequest pool_requests_[2];
+};
+
+TEST_F(RedisSplitKeysCommandHandlerTest, MSETGroupedByHost) {
+  InSequence s;
+
+  RespValue request;
+  makeBulkStringArray(request, {"mset", "a", "1", "b", "2", "c", "3"});
+  RespValue expected_request1;
+  makeBulkStringArray(expected_request1, {"mset", "a", "1", "c", "3"});
+  RespValue expected_request2;
+  makeBulkStringArray(expected_request2, {"mset", "b", "2"});
+
+  expectChooseHost("a", host1_);
+  expectChooseHost("b", host2_);
+  expectChooseHost("c", host1_);
+  expectRequestToHost(0, host1_, expected_request1);
+  expectRequestToHost(1, host2_, expected_request2);
+  handle_ = splitter_.makeRequest(request, callbacks_);
+  EXPECT_NE(nullptr, handle_);
+
+  respondStatus(1, "OK");
+
+  RespValue expected_response;
+  expected_response.type(RespType::SimpleString);
+  expected_response.asString() = "OK";
+  EXPECT_CALL(callbacks_, onResponse_(PointeesEq(&expected_response)));
+  respondStatus(0, "OK");
+
+  EXPECT_EQ(1UL, store_.counter("redis.foo.command.mset.total").value());
+};
+
+TEST_F(RedisSplitKeysCommandHandlerTest, MSETGroupedBySlot) {
+  InSequence s;
+
+  // A Redis Cluster rejects requests with keys in different slots, even on the same node.
+  RespValue request;
+  makeBulkStringArray(request, {"mset", "a", "1", "b", "2", "c", "3"});
+  RespValue expected_request1;
+  makeBulkStringArray(expected_request1, {"mset", "a", "1", "c", "3"});
+  RespValue expected_request2;
+  makeBulkStringArray(expected_request2, {"mset", "b", "2"});
+
+  expectChooseHost("a", host1_, 1);
+  expectChooseHost("b", host1_, 2);
+  expectChooseHost("c", host1_, 1);
+  expectRequestToHost(0, host1_, expected_request1);
+  expectRequestToHost(1, host1_, expected_request2);
+  handle_ = splitter_.makeRequest(request, callbacks_);
+  EXPECT_NE(nullptr, handle_);
+
+  respondStatus(0, "OK");
+
+  RespValue expected_response;
+  expected_response.type(RespType::SimpleString);
+  expected_response.asString() = "OK";
+  EXPECT_CALL(callbacks_, onResponse_(PointeesEq(&expected_response)));
+  respondStatus(1, "OK");
+};
+
+TEST_F(RedisSplitKeysCommandHandlerTest, MSETError) {
+  InSequence s;
+
+  RespValue request;
+  makeBulkStringArray(request, {"mset", "a", "1", "b", "2"});
+  RespValue expected_request1;
+  makeBulkStringArray(expected_request1, {"mset", "a", "1"});
+  RespValue expected_request2;
+  makeBulkStringArray(expected_request2, {"mset", "b", "2"});
+
+  expectChooseHost("a", host1_);
+  expectChooseHost("b", host2_);
+  expectRequestToHost(0, host1_, expected_request1);
+  expectRequestToHost(1, host2_, expected_request2);
+  handle_ = splitter_.makeRequest(request, callbacks_);
+  EXPECT_NE(nullptr, handle_);
+
+  pool_callbacks_[1]->onFailure();
+
+  RespValue expected_response;
+  expected_response.type(RespType::Error);
+  expected_response.asString() = "finished with 1 error(s)";
+  EXPECT_CALL(callbacks_, onResponse_(PointeesEq(&expected_response)));
+  respondStatus(0, "OK");
+};
+
+TEST_F(RedisSplitKeysCommandHandlerTest, MSETWrongNumberOfArgs) {
+  InSequence s;
+
+  RespValue request;
+  makeBulkStringArray(request, {"mset", "a", "1", "b"});
+
+  RespValue expected_response;
+  expected_response.type(RespType::Error);
+  expected_response.asString() = "wrong number of arguments for 'mset' command";
+  EXPECT_CALL(callbacks_, onResponse_(PointeesEq(&expected_response)));
+  EXPECT_EQ(nullptr, splitter_.makeRequest(request, callbacks_));
+};
+
+TEST_F(RedisSplitKeysCommandHandlerTest, DELSum) {
+  InSequence s;
+
+  RespValue request;
+  makeBulkStringArray(request, {"del", "a", "b", "c"});
+  RespValue expected_request1;
+  makeBulkStringArray(expected_request1, {"del", "a"});
+  RespValue expected_request2;
+  makeBulkStringArray(expected_request2, {"del", "b", "c"});
+
+  expectChooseHost("a", host1_);
+  expectChooseHost("b", host2_);
+  expectChooseHost("c", host2_);
+  expectRequestToHost(0, host1_, expected_request1);
+  expectRequestToHost(1, host2_, expected_request2);
+  handle_ = splitter_.makeRequest(request, callbacks_);
+  EXPECT_NE(nullptr, handle_);
+
+  respondInteger(0, 1);
+
+  RespValue expected_response;
+  expected_response.type(RespType::Integer);
+  expected_response.asInteger() = 3;
+  EXPECT_CALL(callbacks_, onResponse_(PointeesEq(&expected_response)));
+  respondInteger(1, 2);
+
+  EXPECT_EQ(1UL, store_.counter("redis.foo.command.del.total").value());
+};
+
+TEST_F(RedisSplitKeysCommandHandlerTest, EXISTSSingleHost) {
+  InSequence s;
+
+  RespValue request;
+  makeBulkStringArray(request, {"exists", "a", "b"});
+
+  expectChooseHost("a", host1_);
+  expectChooseHost("b", host1_);
+  EXPECT_CALL(*conn_pool_, makeRequestToHost(Eq(host1_), Ref(request), _))
+      .WillOnce(DoAll(WithArg<2>(SaveArgAddress(&pool_callbacks_[0])), Return(&pool_requests_[0])));
+  handle_ = splitter_.makeRequest(request, callbacks_);
+  EXPECT_NE(nullptr, handle_);
+
+  RespValue expected_response;
+  expected_response.type(RespType::Integer);
+  expected_response.asInteger() = 1;
+  EXPECT_CALL(callbacks_, onResponse_(PointeesEq(&expected_response)));
+  respondInteger(0, 1);
+
+  EXPECT_EQ(1UL, store_.counter("redis.foo.command.exists.total").value());
+};
+
+TEST_F(RedisSplitKeysCommandHandlerTest, InvalidUpstreamResponse) {
+  InSequence s;
+
+  RespValue request;
+  makeBulkStringArray(request, {"del", "a"});
+
+  expectChooseHost("a", host1_);
+  EXPECT_CALL(*conn_pool_, makeRequestToHost(Eq(host1_), Ref(request), _))
+      .WillOnce(DoAll(WithArg<2>(SaveArgAddress(&pool_callbacks_[0])), Return(&pool_requests_[0])));
+  handle_ = splitter_.makeRequest(request, callbacks_);
+  EXPECT_NE(nullptr, handle_);
+
+  RespValue expected_response;
+  expected_response.type(RespType::Error);
+  expected_response.asString() = "finished with 1 error(s)";
+  EXPECT_CALL(callbacks_, onResponse_(PointeesEq(&expected_response)));
+  respondStatus(0, "OK");
+};
+
+TEST_F(RedisSplitKeysCommandHandlerTest, NoUpstreamHost) {
+  InSequence s;
+
+  RespValue request;
+  makeBulkStringArray(request, {"del", "a", "b"});
+
+  expectChooseHost("a", host1_);
+  expectChooseHost("b", nullptr);
+  RespValue expected_response;
+  expected_response.type(RespType::Error);
+  expected_response.asString() = "no upstream host";
+  EXPECT_CALL(callbacks_, onResponse_(PointeesEq(&expected_response)));
+  EXPECT_EQ(nullptr, splitter_.makeRequest(request, callbacks_));
+};
+
+TEST_F(RedisSplitKeysCommandHandlerTest, NoRequestHandles) {
+  InSequence s;
+
+  RespValue request;
+  makeBulkStringArray(request, {"del", "a", "b"});
+  RespValue expected_request1;
+  makeBulkStringArray(expected_request1, {"del", "a"});
+  RespValue expected_request2;
+  makeBulkStringArray(expected_request2, {"del", "b"});
+
+  expectChooseHost("a", host1_);
+  expectChooseHost("b", host2_);
+  expectRequestToHost(0, host1_, expected_request1, true);
+  RespValue expected_response;
+  expected_response.type(RespType::Error);
+  expected_response.asString() = "finished with 2 error(s)";
+  expectRequestToHost(1, host2_, expected_request2, true);
+  EXPECT_CALL(callbacks_, onResponse_(PointeesEq(&expected_response)));
+  EXPECT_EQ(nullptr, splitter_.makeRequest(request, callbacks_));
+};
+
+TEST_F(RedisSplitKeysCommandHandlerTest, Cancel) {
+  InSequence s;
+
+  RespValue request;
+  makeBulkStringArray(request, {"del", "a", "b"});
+  RespValue expected_request1;
+  makeBulkStringArray(expected_request1, {"del", "a"});
+  RespValue expected_request2;
+  makeBulkStringArray(expected_request2, {"del", "b"});
+
+  expectChooseHost("a", host1_);
+  expectChooseHost("b", host2_);
+  expectRequestToHost(0, host1_, expected_request1);
+  expectRequestToHost(1, host2_, expected_request2);
+  handle_ = splitter_.makeRequest(request, callbacks_);
+  EXPECT_NE(nullptr, handle_);
+
+  EXPECT_CALL(pool_requests_[0], cancel());
+  EXPECT_CALL(pool_requests_[1], cancel());
+  handle_->cancel();
+};
+
 } // CommandSplitter
 } // Redis
 } // Envoy
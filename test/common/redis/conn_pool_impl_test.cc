@@ -1,15 +1,20 @@
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "common/common/hash.h"
 #include "common/network/utility.h"
 #include "common/redis/conn_pool_impl.h"
 #include "common/upstream/upstream_impl.h"
 
+#include "test/mocks/common.h"
 #include "test/mocks/network/mocks.h"
 #include "test/mocks/redis/mocks.h"
 #include "test/mocks/thread_local/mocks.h"
 #include "test/mocks/upstream/mocks.h"
 #include "test/test_common/printers.h"
+#include "test/test_common/utility.h"
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -53,6 +58,10 @@ public:
     }
     )EOF";
 
+    setup(json_string);
+  }
+
+  void setup(const std::string& json_string) {
     Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json_string);
     config_.reset(new ConfigImpl(*json_config));
 
@@ -133,6 +142,72 @@ TEST_F(RedisClientImplTest, Basic) {
   client_->close();
 }
 
+TEST_F(RedisClientImplTest, Batching) {
+  InSequence s;
+
+  setup(R"EOF(
+  {
+    "op_timeout_ms": 20,
+    "max_batch_size": 2,
+    "batch_flush_delay_ms": 0
+  }
+  )EOF");
+  onConnected();
+
+  // The first request of a batch waits for the flush delay.
+  RespValue request1;
+  MockPoolCallbacks callbacks1;
+  EXPECT_CALL(*upstream_connection_, write(_)).Times(0);
+  EXPECT_CALL(*encoder_, encode(Ref(request1), _));
+  Event::MockTimer* batch_flush_timer = new Event::MockTimer(&dispatcher_);
+  EXPECT_CALL(*batch_flush_timer, enableTimer(std::chrono::milliseconds(0)));
+  EXPECT_CALL(*connect_or_op_timer_, enableTimer(_));
+  client_->makeRequest(request1, callbacks1);
+
+  // The second request fills the batch, which is written at once.
+  RespValue request2;
+  MockPoolCallbacks callbacks2;
+  EXPECT_CALL(*encoder_, encode(Ref(request2), _));
+  EXPECT_CALL(*batch_flush_timer, disableTimer());
+  EXPECT_CALL(*upstream_connection_, write(_));
+  EXPECT_CALL(*connect_or_op_timer_, enableTimer(_));
+  client_->makeRequest(request2, callbacks2);
+
+  // A batch that is not full is written when its flush delay expires.
+  RespValue request3;
+  MockPoolCallbacks callbacks3;
+  EXPECT_CALL(*encoder_, encode(Ref(request3), _));
+  EXPECT_CALL(*batch_flush_timer, enableTimer(_));
+  EXPECT_CALL(*connect_or_op_timer_, enableTimer(_));
+  client_->makeRequest(request3, callbacks3);
+
+  EXPECT_CALL(*batch_flush_timer, disableTimer());
+  EXPECT_CALL(*upstream_connection_, write(_));
+  batch_flush_timer->callback_();
+
+  EXPECT_EQ(2UL, host_->cluster_.stats_store_.counter("redis.batch_total").value());
+  EXPECT_EQ(3UL, host_->cluster_.stats_store_.counter("redis.batch_rq_total").value());
+  EXPECT_EQ(1UL, host_->cluster_.stats_store_.counter("redis.batch_flushed_full").value());
+  EXPECT_EQ(1UL, host_->cluster_.stats_store_.counter("redis.batch_flushed_delay").value());
+
+  // Requests of a batch that was not written yet fail when the connection closes.
+  RespValue request4;
+  MockPoolCallbacks callbacks4;
+  EXPECT_CALL(*encoder_, encode(Ref(request4), _));
+  EXPECT_CALL(*batch_flush_timer, enableTimer(_));
+  EXPECT_CALL(*connect_or_op_timer_, enableTimer(_));
+  client_->makeRequest(request4, callbacks4);
+
+  EXPECT_CALL(*upstream_connection_, close(Network::ConnectionCloseType::NoFlush));
+  EXPECT_CALL(callbacks1, onFailure());
+  EXPECT_CALL(callbacks2, onFailure());
+  EXPECT_CALL(callbacks3, onFailure());
+  EXPECT_CALL(callbacks4, onFailure());
+  EXPECT_CALL(*batch_flush_timer, disableTimer());
+  EXPECT_CALL(*connect_or_op_timer_, disableTimer());
+  client_->close();
+}
+
 TEST_F(RedisClientImplTest, Cancel) {
   InSequence s;
 
@@ -369,7 +444,7 @@ TEST_F(RedisConnPoolImplTest, Basic) {
   EXPECT_CALL(cm_.thread_local_cluster_.lb_, chooseHost(_))
       .WillOnce(
           Invoke([&](const Upstream::LoadBalancerContext* context) -> Upstream::HostConstSharedPtr {
-            EXPECT_EQ(context->hashKey().value(), std::hash<std::string>()("foo"));
+            EXPECT_EQ(context->hashKey().value(), HashUtil::xxHash64("foo"));
             return cm_.thread_local_cluster_.lb_.host_;
           }));
   EXPECT_CALL(*this, create_(_)).WillOnce(Return(client));
@@ -426,6 +501,35 @@ TEST_F(RedisConnPoolImplTest, NoHost) {
   tls_.shutdownThread();
 }
 
+TEST_F(RedisConnPoolImplTest, MakeRequestToHost) {
+  InSequence s;
+
+  RespValue value;
+  MockPoolRequest active_request1;
+  MockPoolRequest active_request2;
+  MockPoolCallbacks callbacks;
+  MockClient* client = new NiceMock<MockClient>();
+
+  EXPECT_CALL(cm_.thread_local_cluster_.lb_, chooseHost(_))
+      .WillOnce(
+          Invoke([&](const Upstream::LoadBalancerContext* context) -> Upstream::HostConstSharedPtr {
+            EXPECT_EQ(context->hashKey().value(), HashUtil::xxHash64("foo"));
+            return cm_.thread_local_cluster_.lb_.host_;
+          }));
+  Upstream::HostConstSharedPtr host = conn_pool_->chooseHost("foo");
+  EXPECT_EQ(cm_.thread_local_cluster_.lb_.host_, host);
+
+  // Requests to the same host share one client.
+  EXPECT_CALL(*this, create_(Eq(host))).WillOnce(Return(client));
+  EXPECT_CALL(*client, makeRequest(Ref(value), Ref(callbacks))).WillOnce(Return(&active_request1));
+  EXPECT_EQ(&active_request1, conn_pool_->makeRequestToHost(host, value, callbacks));
+  EXPECT_CALL(*client, makeRequest(Ref(value), Ref(callbacks))).WillOnce(Return(&active_request2));
+  EXPECT_EQ(&active_request2, conn_pool_->makeRequestToHost(host, value, callbacks));
+
+  EXPECT_CALL(*client, close());
+  tls_.shutdownThread();
+}
+
 TEST_F(RedisConnPoolImplTest, RemoteClose) {
   InSequence s;
 
@@ -445,6 +549,364 @@ TEST_F(RedisConnPoolImplTest, RemoteClose) {
   tls_.shutdownThread();
 }
 
+class RedisConnPoolImplReplicaTest : public testing::Test, public ClientFactory {
+public:
+  RedisConnPoolImplReplicaTest() {
+    std::string json_string = R"EOF(
+    {
+      "op_timeout_ms": 20,
+      "replica_cluster": "foo_replicas"
+    }
+    )EOF";
+
+    replica1_ = makeHost("tcp://10.0.0.2:6379", "10.0.0.1:6379");
+    replica2_ = makeHost("tcp://10.0.0.3:6379", "10.0.0.1:6379");
+    other_replica_ = makeHost("tcp://10.0.0.5:6379", "10.0.0.4:6379");
+    replica_cluster_.cluster_.hosts_ = {replica1_, replica2_, other_replica_,
+                                        makeHost("tcp://10.0.0.6:6379", "")};
+    ON_CALL(cm_, get("foo_replicas")).WillByDefault(Return(&replica_cluster_));
+
+    Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json_string);
+    conn_pool_.reset(new InstanceImpl(cluster_name_, cm_, *this, tls_, *json_config));
+  }
+
+  Upstream::HostSharedPtr makeHost(const std::string& url, const std::string& replica_of) {
+    Upstream::HostMetadata metadata;
+    if (!replica_of.empty()) {
+      metadata[InstanceImpl::REPLICA_OF_METADATA_KEY] = replica_of;
+    }
+    return Upstream::HostSharedPtr{new Upstream::HostImpl(replica_cluster_.cluster_.info_, "",
+                                                          Network::Utility::resolveUrl(url),
+                                                          false, 1, "", metadata)};
+  }
+
+  void setPrimary(const std::string& url) {
+    Upstream::HostSharedPtr primary{new Upstream::HostImpl(
+        cm_.thread_local_cluster_.cluster_.info_, "", Network::Utility::resolveUrl(url), false, 1,
+        "")};
+    ON_CALL(cm_.thread_local_cluster_.lb_, chooseHost(_)).WillByDefault(Return(primary));
+    primary_ = primary;
+  }
+
+  void expectReadTo(Upstream::HostConstSharedPtr host) {
+    EXPECT_CALL(*this, create_(Eq(host))).WillOnce(Return(new NiceMock<MockClient>()));
+    conn_pool_->makeReadRequest("foo", value_, callbacks_);
+  }
+
+  // Redis::ConnPool::ClientFactory
+  ClientPtr create(Upstream::HostConstSharedPtr host, Event::Dispatcher&, const Config&) override {
+    return ClientPtr{create_(host)};
+  }
+
+  MOCK_METHOD1(create_, Client*(Upstream::HostConstSharedPtr host));
+
+  const std::string cluster_name_{"foo"};
+  NiceMock<Upstream::MockClusterManager> cm_;
+  NiceMock<Upstream::MockThreadLocalCluster> replica_cluster_;
+  NiceMock<ThreadLocal::MockInstance> tls_;
+  Upstream::HostSharedPtr replica1_;
+  Upstream::HostSharedPtr replica2_;
+  Upstream::HostSharedPtr other_replica_;
+  Upstream::HostConstSharedPtr primary_;
+  RespValue value_;
+  MockPoolCallbacks callbacks_;
+  InstancePtr conn_pool_;
+};
+
+TEST_F(RedisConnPoolImplReplicaTest, RoundRobinOverReplicas) {
+  setPrimary("tcp://10.0.0.1:6379");
+  expectReadTo(replica1_);
+  expectReadTo(replica2_);
+
+  // Writes always go to the primary.
+  EXPECT_CALL(*this, create_(Eq(primary_))).WillOnce(Return(new NiceMock<MockClient>()));
+  conn_pool_->makeRequest("foo", value_, callbacks_);
+  tls_.shutdownThread();
+}
+
+TEST_F(RedisConnPoolImplReplicaTest, UnhealthyReplica) {
+  setPrimary("tcp://10.0.0.1:6379");
+  replica1_->healthFlagSet(Upstream::Host::HealthFlag::FAILED_ACTIVE_HC);
+  expectReadTo(replica2_);
+
+  // Clients are per host, so the second read to replica2 reuses the first client.
+  EXPECT_CALL(*this, create_(_)).Times(0);
+  conn_pool_->makeReadRequest("foo", value_, callbacks_);
+  tls_.shutdownThread();
+}
+
+TEST_F(RedisConnPoolImplReplicaTest, NoHealthyReplica) {
+  setPrimary("tcp://10.0.0.1:6379");
+  replica1_->healthFlagSet(Upstream::Host::HealthFlag::FAILED_ACTIVE_HC);
+  replica2_->healthFlagSet(Upstream::Host::HealthFlag::FAILED_ACTIVE_HC);
+  expectReadTo(primary_);
+  tls_.shutdownThread();
+}
+
+TEST_F(RedisConnPoolImplReplicaTest, NoReplica) {
+  setPrimary("tcp://10.0.0.7:6379");
+  expectReadTo(primary_);
+  tls_.shutdownThread();
+}
+
+TEST_F(RedisConnPoolImplReplicaTest, ReplicaMembershipChange) {
+  setPrimary("tcp://10.0.0.4:6379");
+  MockClient* client = new NiceMock<MockClient>();
+  EXPECT_CALL(*this, create_(Eq(other_replica_))).WillOnce(Return(client));
+  conn_pool_->makeReadRequest("foo", value_, callbacks_);
+
+  // Removing the only replica closes its client and sends reads back to the primary.
+  replica_cluster_.cluster_.hosts_.pop_back();
+  replica_cluster_.cluster_.hosts_.pop_back();
+  EXPECT_CALL(*client, close());
+  replica_cluster_.cluster_.runCallbacks({}, {other_replica_});
+  expectReadTo(primary_);
+  tls_.shutdownThread();
+}
+
+class RedisConnPoolImplClusterModeTest : public testing::Test, public ClientFactory {
+public:
+  RedisConnPoolImplClusterModeTest() {
+    std::string json_string = R"EOF(
+    {
+      "op_timeout_ms": 20,
+      "cluster_mode": true
+    }
+    )EOF";
+
+    host1_ = makeHost("tcp://10.0.0.1:6379");
+    host2_ = makeHost("tcp://10.0.0.2:6379");
+    cm_.thread_local_cluster_.cluster_.hosts_ = {host1_, host2_};
+    ON_CALL(cm_.thread_local_cluster_.lb_, chooseHost(_)).WillByDefault(Return(host1_));
+
+    Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json_string);
+    conn_pool_.reset(new InstanceImpl(cluster_name_, cm_, *this, tls_, *json_config));
+  }
+
+  Upstream::HostSharedPtr makeHost(const std::string& url) {
+    return Upstream::HostSharedPtr{new Upstream::HostImpl(cm_.thread_local_cluster_.cluster_.info_,
+                                                          "", Network::Utility::resolveUrl(url),
+                                                          false, 1, "")};
+  }
+
+  // Creates a client for the host whose requests are saved in requests_.
+  MockClient* expectClient(const std::string& address) {
+    MockClient* client = new NiceMock<MockClient>();
+    EXPECT_CALL(*this, create_(_))
+        .WillOnce(Invoke([address, client](Upstream::HostConstSharedPtr host) -> Client* {
+          EXPECT_EQ(address, host->address()->asString());
+          return client;
+        }));
+    ON_CALL(*client, makeRequest(_, _))
+        .WillByDefault(
+            Invoke([this](const RespValue& request, PoolCallbacks& callbacks) -> PoolRequest* {
+              Buffer::OwnedImpl buffer;
+              EncoderImpl().encode(request, buffer);
+              requests_.emplace_back(TestUtility::bufferToString(buffer), &callbacks);
+              return &active_request_;
+            }));
+    return client;
+  }
+
+  void makeValue(RespValue& value, RespType type, const std::string& contents) {
+    value.type(type);
+    value.asString() = contents;
+  }
+
+  RespValuePtr makeResponse(RespType type, const std::string& contents) {
+    RespValuePtr value(new RespValue());
+    makeValue(*value, type, contents);
+    return value;
+  }
+
+  // Answers the CLUSTER SLOTS request with slots 0-8191 on 10.0.0.1 and the others on 10.0.0.2.
+  void respondSlots(PoolCallbacks& callbacks) {
+    RespValuePtr response(new RespValue());
+    response->type(RespType::Array);
+    std::vector<RespValue> ranges(2);
+    for (uint32_t i = 0; i < 2; i++) {
+      std::vector<RespValue> range(3);
+      range[0].type(RespType::Integer);
+      range[0].asInteger() = i * 8192;
+      range[1].type(RespType::Integer);
+      range[1].asInteger() = i * 8192 + 8191;
+      range[2].type(RespType::Array);
+      std::vector<RespValue> primary(2);
+      makeValue(primary[0], RespType::BulkString, fmt::format("10.0.0.{}", i + 1));
+      primary[1].type(RespType::Integer);
+      primary[1].asInteger() = 6379;
+      range[2].asArray().swap(primary);
+      ranges[i].type(RespType::Array);
+      ranges[i].asArray().swap(range);
+    }
+    response->asArray().swap(ranges);
+    callbacks.onResponse(std::move(response));
+  }
+
+  uint64_t counter(const std::string& name) {
+    return cm_.thread_local_cluster_.cluster_.info_->stats_store_.counter("redis." + name).value();
+  }
+
+  // Redis::ConnPool::ClientFactory
+  ClientPtr create(Upstream::HostConstSharedPtr host, Event::Dispatcher&, const Config&) override {
+    return ClientPtr{create_(host)};
+  }
+
+  MOCK_METHOD1(create_, Client*(Upstream::HostConstSharedPtr host));
+
+  const std::string cluster_name_{"foo"};
+  const std::string slots_command_{"*2\r\n$7\r\nCLUSTER\r\n$5\r\nSLOTS\r\n"};
+  const std::string asking_command_{"*1\r\n$6\r\nASKING\r\n"};
+  const std::string get_command_{"*2\r\n$3\r\nget\r\n$3\r\nfoo\r\n"};
+  NiceMock<Upstream::MockClusterManager> cm_;
+  NiceMock<ThreadLocal::MockInstance> tls_;
+  Upstream::HostSharedPtr host1_;
+  Upstream::HostSharedPtr host2_;
+  std::vector<std::pair<std::string, PoolCallbacks*>> requests_;
+  NiceMock<MockPoolRequest> active_request_;
+  MockPoolCallbacks callbacks_;
+  RespValue value_;
+  InstancePtr conn_pool_;
+};
+
+TEST_F(RedisConnPoolImplClusterModeTest, Slot) {
+  EXPECT_EQ(12182U, conn_pool_->slot("foo"));
+  EXPECT_EQ(3443U, conn_pool_->slot("{user1000}.following"));
+  tls_.shutdownThread();
+}
+
+TEST_F(RedisConnPoolImplClusterModeTest, RouteBySlot) {
+  std::vector<RespValue> args(2);
+  makeValue(args[0], RespType::BulkString, "get");
+  makeValue(args[1], RespType::BulkString, "foo");
+  value_.type(RespType::Array);
+  value_.asArray().swap(args);
+
+  // Until the slots are loaded, requests go to any host.
+  expectClient("10.0.0.1:6379");
+  conn_pool_->makeRequest("foo", value_, callbacks_);
+  ASSERT_EQ(2UL, requests_.size());
+  EXPECT_EQ(slots_command_, requests_[0].first);
+  EXPECT_EQ(get_command_, requests_[1].first);
+  EXPECT_EQ(1UL, counter("cluster_slots_refresh"));
+
+  // The slots are only requested once at a time.
+  conn_pool_->makeRequest("foo", value_, callbacks_);
+  EXPECT_EQ(1UL, counter("cluster_slots_refresh"));
+
+  respondSlots(*requests_[0].second);
+  EXPECT_EQ(host2_, conn_pool_->chooseHost("foo"));
+  EXPECT_EQ(host1_, conn_pool_->chooseHost("bar"));
+
+  expectClient("10.0.0.2:6379");
+  conn_pool_->makeRequest("foo", value_, callbacks_);
+  EXPECT_EQ(4UL, requests_.size());
+
+  // Membership changes drop the slots.
+  cm_.thread_local_cluster_.cluster_.runCallbacks({}, {});
+  conn_pool_->chooseHost("foo");
+  EXPECT_EQ(2UL, counter("cluster_slots_refresh"));
+  tls_.shutdownThread();
+}
+
+TEST_F(RedisConnPoolImplClusterModeTest, Moved) {
+  makeValue(value_, RespType::SimpleString, "PING");
+
+  expectClient("10.0.0.1:6379");
+  conn_pool_->makeRequest("foo", value_, callbacks_);
+  ASSERT_EQ(2UL, requests_.size());
+  respondSlots(*requests_[0].second);
+
+  // The request is sent again to the host from the redirection, which also serves the new slots.
+  expectClient("10.0.0.2:6379");
+  requests_[1].second->onResponse(makeResponse(RespType::Error, "MOVED 12182 10.0.0.2:6379"));
+  ASSERT_EQ(4UL, requests_.size());
+  EXPECT_EQ(slots_command_, requests_[2].first);
+  EXPECT_EQ("+PING\r\n", requests_[3].first);
+  EXPECT_EQ(1UL, counter("cluster_moved"));
+  EXPECT_EQ(host2_, conn_pool_->chooseHost("foo"));
+
+  RespValue expected;
+  makeValue(expected, RespType::SimpleString, "PONG");
+  EXPECT_CALL(callbacks_, onResponse_(PointeesEq(&expected)));
+  requests_[3].second->onResponse(makeResponse(RespType::SimpleString, "PONG"));
+
+  // Nothing is done with a bad CLUSTER SLOTS response.
+  requests_[2].second->onResponse(makeResponse(RespType::Error, "ERR"));
+  EXPECT_EQ(1UL, counter("cluster_slots_refresh_failure"));
+  EXPECT_EQ(host2_, conn_pool_->chooseHost("foo"));
+  tls_.shutdownThread();
+}
+
+TEST_F(RedisConnPoolImplClusterModeTest, AskUnknownNode) {
+  makeValue(value_, RespType::SimpleString, "PING");
+
+  expectClient("10.0.0.1:6379");
+  conn_pool_->makeRequest("foo", value_, callbacks_);
+  ASSERT_EQ(2UL, requests_.size());
+
+  // Nodes that are not hosts of the cluster get a client of their own. The slot does not move.
+  expectClient("10.0.0.9:6379");
+  requests_[1].second->onResponse(makeResponse(RespType::Error, "ASK 12182 10.0.0.9:6379"));
+  ASSERT_EQ(4UL, requests_.size());
+  EXPECT_EQ(asking_command_, requests_[2].first);
+  EXPECT_EQ("+PING\r\n", requests_[3].first);
+  EXPECT_EQ(1UL, counter("cluster_ask"));
+
+  EXPECT_CALL(callbacks_, onFailure());
+  requests_[3].second->onFailure();
+  tls_.shutdownThread();
+}
+
+TEST_F(RedisConnPoolImplClusterModeTest, RedirectionLimit) {
+  makeValue(value_, RespType::SimpleString, "PING");
+
+  expectClient("10.0.0.1:6379");
+  conn_pool_->makeRequest("foo", value_, callbacks_);
+  expectClient("10.0.0.2:6379");
+  for (uint32_t i = 0; i < InstanceImpl::MAX_REDIRECTIONS; i++) {
+    requests_.back().second->onResponse(makeResponse(RespType::Error, "ASK 1 10.0.0.2:6379"));
+  }
+
+  // A redirection past the limit is passed to the caller.
+  RespValue expected;
+  makeValue(expected, RespType::Error, "ASK 1 10.0.0.2:6379");
+  EXPECT_CALL(callbacks_, onResponse_(PointeesEq(&expected)));
+  requests_.back().second->onResponse(makeResponse(RespType::Error, "ASK 1 10.0.0.2:6379"));
+  tls_.shutdownThread();
+}
+
+TEST_F(RedisConnPoolImplClusterModeTest, Cancel) {
+  makeValue(value_, RespType::SimpleString, "PING");
+
+  expectClient("10.0.0.1:6379");
+  PoolRequest* request = conn_pool_->makeRequest("foo", value_, callbacks_);
+  EXPECT_CALL(active_request_, cancel());
+  EXPECT_CALL(tls_.dispatcher_, deferredDelete_(_));
+  request->cancel();
+
+  // The client is deleted on shutdown.
+  EXPECT_CALL(tls_.dispatcher_, deferredDelete_(_));
+  tls_.shutdownThread();
+}
+
+TEST(RedisConnPoolImplConfigTest, UnknownReplicaCluster) {
+  std::string json_string = R"EOF(
+  {
+    "op_timeout_ms": 20,
+    "replica_cluster": "unknown"
+  }
+  )EOF";
+
+  NiceMock<Upstream::MockClusterManager> cm;
+  NiceMock<ThreadLocal::MockInstance> tls;
+  ON_CALL(cm, get("unknown")).WillByDefault(Return(nullptr));
+  Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json_string);
+  EXPECT_THROW_WITH_MESSAGE(InstanceImpl("foo", cm, ClientFactoryImpl::instance_, tls,
+                                         *json_config),
+                            EnvoyException, "redis: unknown replica cluster 'unknown'");
+}
+
 } // ConnPool
 } // Redis
 } // Envoy
@@ -8,6 +8,7 @@
 #include "test/mocks/redis/mocks.h"
 #include "test/mocks/upstream/mocks.h"
 #include "test/test_common/printers.h"
+#include "test/test_common/utility.h"
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -156,6 +157,37 @@ TEST_F(RedisProxyFilterTest, OutOfOrderResponse) {
   filter_callbacks_.connection_.raiseEvents(Network::ConnectionEvent::RemoteClose);
 }
 
+TEST_F(RedisProxyFilterTest, RawResponse) {
+  InSequence s;
+
+  Buffer::OwnedImpl fake_data;
+  CommandSplitter::MockSplitRequest* request_handle1 = new CommandSplitter::MockSplitRequest();
+  CommandSplitter::SplitCallbacks* request_callbacks1;
+  EXPECT_CALL(*decoder_, decode(Ref(fake_data)))
+      .WillOnce(Invoke([&](Buffer::Instance&) -> void {
+        RespValuePtr request1(new RespValue());
+        EXPECT_CALL(splitter_, makeRequest_(Ref(*request1), _))
+            .WillOnce(
+                DoAll(WithArg<1>(SaveArgAddress(&request_callbacks1)), Return(request_handle1)));
+        decoder_callbacks_->onRespValue(std::move(request1));
+      }));
+  EXPECT_EQ(Network::FilterStatus::Continue, filter_->onData(fake_data));
+
+  // A response that still holds its raw bytes is moved to the connection without being encoded.
+  RespValuePtr response1(new RespValue());
+  response1->type(RespType::BulkString);
+  response1->raw().reset(new Buffer::OwnedImpl("$3\r\nfoo\r\n"));
+  EXPECT_CALL(*encoder_, encode(_, _)).Times(0);
+  EXPECT_CALL(filter_callbacks_.connection_, write(_))
+      .WillOnce(Invoke([](Buffer::Instance& data) -> void {
+        EXPECT_EQ("$3\r\nfoo\r\n", TestUtility::bufferToString(data));
+        data.drain(data.length());
+      }));
+  request_callbacks1->onResponse(std::move(response1));
+
+  filter_callbacks_.connection_.raiseEvents(Network::ConnectionEvent::RemoteClose);
+}
+
 TEST_F(RedisProxyFilterTest, DownstreamDisconnectWithActive) {
   InSequence s;
 
@@ -0,0 +1,179 @@
+#include <chrono>
+#include <string>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/json/json_loader.h"
+#include "common/redis/read_cache.h"
+#include "common/stats/stats_impl.h"
+
+#include "test/mocks/common.h"
+#include "test/mocks/thread_local/mocks.h"
+#include "test/test_common/utility.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace Envoy {
+using testing::_;
+using testing::NiceMock;
+using testing::Return;
+
+namespace Redis {
+
+class RedisReadCacheTest : public testing::Test {
+public:
+  RedisReadCacheTest() {
+    std::string json_string = R"EOF(
+    {
+      "key_prefixes": ["hot:", "cfg:"],
+      "max_entries": 2,
+      "ttl_ms": 1000
+    }
+    )EOF";
+
+    Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json_string);
+    ON_CALL(time_source_, currentTime()).WillByDefault(Return(now_));
+    cache_.reset(new ReadCache(*json_config, tls_, time_source_, store_, "redis.foo."));
+  }
+
+  void insert(const std::string& key, const std::string& value) {
+    RespValue response;
+    response.type(RespType::BulkString);
+    response.asString() = value;
+    cache_->insert(key, response, cache_->epoch());
+  }
+
+  void expectHit(const std::string& key, const std::string& encoded) {
+    RespValuePtr response = cache_->lookup(key);
+    ASSERT_NE(nullptr, response);
+    EXPECT_EQ(RespType::BulkString, response->type());
+    ASSERT_NE(nullptr, response->raw());
+    EXPECT_EQ(encoded, TestUtility::bufferToString(*response->raw()));
+  }
+
+  void advance(std::chrono::milliseconds duration) {
+    now_ += duration;
+    ON_CALL(time_source_, currentTime()).WillByDefault(Return(now_));
+  }
+
+  NiceMock<ThreadLocal::MockInstance> tls_;
+  NiceMock<MockMonotonicTimeSource> time_source_;
+  Stats::IsolatedStoreImpl store_;
+  MonotonicTime now_{std::chrono::seconds(1)};
+  ReadCachePtr cache_;
+};
+
+TEST_F(RedisReadCacheTest, Cacheable) {
+  EXPECT_TRUE(cache_->cacheable("hot:a"));
+  EXPECT_TRUE(cache_->cacheable("cfg:"));
+  EXPECT_FALSE(cache_->cacheable("hot"));
+  EXPECT_FALSE(cache_->cacheable("cold:a"));
+}
+
+TEST_F(RedisReadCacheTest, HitAndMiss) {
+  EXPECT_EQ(nullptr, cache_->lookup("hot:a"));
+  insert("hot:a", "hello");
+  expectHit("hot:a", "$5\r\nhello\r\n");
+
+  EXPECT_EQ(1UL, store_.counter("redis.foo.read_cache.miss").value());
+  EXPECT_EQ(1UL, store_.counter("redis.foo.read_cache.hit").value());
+  EXPECT_EQ(1UL, store_.counter("redis.foo.read_cache.insert").value());
+}
+
+TEST_F(RedisReadCacheTest, Null) {
+  RespValue response;
+  cache_->insert("hot:a", response, cache_->epoch());
+  RespValuePtr cached = cache_->lookup("hot:a");
+  ASSERT_NE(nullptr, cached);
+  EXPECT_EQ(RespType::Null, cached->type());
+  EXPECT_EQ("$-1\r\n", TestUtility::bufferToString(*cached->raw()));
+}
+
+TEST_F(RedisReadCacheTest, NotCachedTypes) {
+  RespValue response;
+  response.type(RespType::Error);
+  response.asString() = "error";
+  cache_->insert("hot:a", response, cache_->epoch());
+  EXPECT_EQ(nullptr, cache_->lookup("hot:a"));
+  EXPECT_EQ(0UL, store_.counter("redis.foo.read_cache.insert").value());
+}
+
+TEST_F(RedisReadCacheTest, Raw) {
+  RespValue response;
+  response.type(RespType::BulkString);
+  response.raw().reset(new Buffer::OwnedImpl("$3\r\nraw\r\n"));
+  cache_->insert("hot:a", response, cache_->epoch());
+  expectHit("hot:a", "$3\r\nraw\r\n");
+}
+
+TEST_F(RedisReadCacheTest, Expiry) {
+  insert("hot:a", "hello");
+  advance(std::chrono::milliseconds(999));
+  expectHit("hot:a", "$5\r\nhello\r\n");
+  advance(std::chrono::milliseconds(1));
+  EXPECT_EQ(nullptr, cache_->lookup("hot:a"));
+  EXPECT_EQ(nullptr, cache_->lookup("hot:a"));
+}
+
+TEST_F(RedisReadCacheTest, LeastRecentlyUsedEviction) {
+  insert("hot:a", "a");
+  insert("hot:b", "b");
+  expectHit("hot:a", "$1\r\na\r\n");
+  insert("hot:c", "c");
+
+  EXPECT_EQ(1UL, store_.counter("redis.foo.read_cache.evicted").value());
+  expectHit("hot:a", "$1\r\na\r\n");
+  EXPECT_EQ(nullptr, cache_->lookup("hot:b"));
+  expectHit("hot:c", "$1\r\nc\r\n");
+}
+
+TEST_F(RedisReadCacheTest, Replace) {
+  insert("hot:a", "a");
+  insert("hot:a", "aa");
+  insert("hot:b", "b");
+  EXPECT_EQ(0UL, store_.counter("redis.foo.read_cache.evicted").value());
+  expectHit("hot:a", "$2\r\naa\r\n");
+}
+
+TEST_F(RedisReadCacheTest, Invalidate) {
+  insert("hot:a", "a");
+  insert("hot:b", "b");
+  EXPECT_CALL(tls_, runOnAllThreads(_));
+  cache_->invalidate("hot:a");
+
+  EXPECT_EQ(1UL, store_.counter("redis.foo.read_cache.invalidated").value());
+  EXPECT_EQ(nullptr, cache_->lookup("hot:a"));
+  expectHit("hot:b", "$1\r\nb\r\n");
+}
+
+TEST_F(RedisReadCacheTest, InvalidatedWhileInFlight) {
+  uint64_t epoch = cache_->epoch();
+  cache_->invalidate("hot:a");
+  RespValue response;
+  response.type(RespType::BulkString);
+  response.asString() = "stale";
+  cache_->insert("hot:a", response, epoch);
+  EXPECT_EQ(nullptr, cache_->lookup("hot:a"));
+
+  cache_->insert("hot:a", response, cache_->epoch());
+  expectHit("hot:a", "$5\r\nstale\r\n");
+}
+
+TEST(RedisReadCacheConfigTest, InvalidConfig) {
+  std::string json_string = R"EOF(
+  {
+    "key_prefixes": [],
+    "max_entries": 2,
+    "ttl_ms": 1000
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json_string);
+  NiceMock<ThreadLocal::MockInstance> tls;
+  NiceMock<MockMonotonicTimeSource> time_source;
+  Stats::IsolatedStoreImpl store;
+  EXPECT_THROW(ReadCache(*json_config, tls, time_source, store, "redis.foo."), Json::Exception);
+}
+
+} // Redis
+} // Envoy
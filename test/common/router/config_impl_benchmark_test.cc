@@ -0,0 +1,109 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "common/http/header_map_impl.h"
+#include "common/json/json_loader.h"
+#include "common/router/config_impl.h"
+
+#include "test/mocks/runtime/mocks.h"
+#include "test/mocks/upstream/mocks.h"
+#include "test/test_common/utility.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+using testing::NiceMock;
+
+namespace Router {
+
+/**
+ * This test is for benchmarking only and should not be run as part of unit tests. It loads a
+ * route table shaped like a large RDS response and measures how long matching a request takes.
+ */
+class DISABLED_RouteMatcherBenchmark : public testing::Test {
+public:
+  static const uint32_t NumRoutes = 3000;
+  static const uint32_t NumWildcardDomains = 500;
+  static const uint32_t NumLookups = 200000;
+
+  static std::string routeConfig() {
+    std::string routes;
+    for (uint32_t i = 0; i < NumRoutes; i++) {
+      // Mix prefix and path routes, a few of which also match on a header.
+      std::string route;
+      if (i % 3 == 0) {
+        route = fmt::format(R"EOF({{"path": "/service/{}/method", "cluster": "c{}"}})EOF", i, i);
+      } else if (i % 10 == 1) {
+        route = fmt::format(R"EOF({{"prefix": "/service/{}/", "cluster": "c{}",
+                                    "headers": [{{"name": "x-canary"}}]}})EOF",
+                            i, i);
+      } else {
+        route = fmt::format(R"EOF({{"prefix": "/service/{}/", "cluster": "c{}",
+                                    "case_sensitive": {}}})EOF",
+                            i, i, i % 7 == 0 ? "false" : "true");
+      }
+      routes += (i == 0 ? "" : ",") + route;
+    }
+    routes += R"EOF(,{"prefix": "/", "cluster": "default"})EOF";
+
+    std::string domains;
+    for (uint32_t i = 0; i < NumWildcardDomains; i++) {
+      domains += fmt::format("{}\"*.tenant{}.example.com\"", i == 0 ? "" : ",", i);
+    }
+
+    return fmt::format(R"EOF(
+    {{
+      "virtual_hosts": [
+        {{"name": "wildcards", "domains": [{}], "routes": [{}]}},
+        {{"name": "default", "domains": ["*"], "routes": [{{"prefix": "/", "cluster": "d"}}]}}
+      ]
+    }}
+    )EOF",
+                       domains, routes);
+  }
+};
+
+const uint32_t DISABLED_RouteMatcherBenchmark::NumRoutes;
+const uint32_t DISABLED_RouteMatcherBenchmark::NumWildcardDomains;
+const uint32_t DISABLED_RouteMatcherBenchmark::NumLookups;
+
+TEST_F(DISABLED_RouteMatcherBenchmark, LargeRouteTable) {
+  NiceMock<Runtime::MockLoader> runtime;
+  NiceMock<Upstream::MockClusterManager> cm;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  Json::ObjectSharedPtr loader = Json::Factory::loadFromString(routeConfig());
+  ConfigImpl config(*loader, runtime, cm, false);
+  std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << fmt::format("routes={} domains={} load={}ms", NumRoutes, NumWildcardDomains,
+                           std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count())
+            << std::endl;
+
+  std::vector<Http::TestHeaderMapImpl> requests;
+  for (uint32_t i = 0; i < 100; i++) {
+    const uint32_t route = (i * 31) % NumRoutes;
+    requests.push_back(Http::TestHeaderMapImpl{
+        {":authority", fmt::format("www.tenant{}.example.com", (i * 7) % NumWildcardDomains)},
+        {":path", fmt::format("/service/{}/method?id={}", route, i)},
+        {":method", "GET"}});
+  }
+
+  start = std::chrono::steady_clock::now();
+  uint64_t matched = 0;
+  for (uint32_t i = 0; i < NumLookups; i++) {
+    matched += config.route(requests[i % requests.size()], i) != nullptr;
+  }
+  elapsed = std::chrono::steady_clock::now() - start;
+  EXPECT_EQ(NumLookups, matched);
+  std::cout << fmt::format("lookups={} per_lookup={}ns", NumLookups,
+                           elapsed.count() / NumLookups)
+            << std::endl;
+}
+
+} // Router
+} // Envoy
@@ -152,8 +152,9 @@ TEST(RouteMatcherTest, TestRoutes) {
         {"pattern": "^/rides$", "method": "POST", "name": "ride_request"},
         {"pattern": "^/rides/\\d+$", "method": "PUT", "name": "update_ride"},
         {"pattern": "^/users/\\d+/chargeaccounts$", "method": "POST", "name": "cc_add"},
-        {"pattern": "^/users/\\d+/chargeaccounts/(?!validate)\\w+$", "method": "PUT",
-         "name": "cc_add"},
+        {"pattern": "^/users/\\d+/chargeaccounts/validate$", "method": "PUT",
+         "name": "cc_validate"},
+        {"pattern": "^/users/\\d+/chargeaccounts/\\w+$", "method": "PUT", "name": "cc_add"},
         {"pattern": "^/users$", "method": "POST", "name": "create_user_login"},
         {"pattern": "^/users/\\d+$", "method": "PUT", "name": "update_user"},
         {"pattern": "^/users/\\d+/location$", "method": "POST", "name": "ulu"}]
@@ -334,7 +335,8 @@ TEST(RouteMatcherTest, TestRoutes) {
   {
     Http::TestHeaderMapImpl headers =
         genHeaders("api.lyft.com", "/users/123/chargeaccounts/validate", "PUT");
-    EXPECT_EQ("other", config.route(headers, 0)->routeEntry()->virtualCluster(headers)->name());
+    EXPECT_EQ("cc_validate",
+              config.route(headers, 0)->routeEntry()->virtualCluster(headers)->name());
   }
   {
     Http::TestHeaderMapImpl headers = genHeaders("api.lyft.com", "/foo/bar", "PUT");
@@ -684,6 +686,212 @@ TEST(RouteMatcherTest, HeaderMatchedRouting) {
   }
 }
 
+TEST(RouteMatcherTest, FirstMatchWins) {
+  std::string json = R"EOF(
+{
+  "virtual_hosts": [
+    {
+      "name": "local_service",
+      "domains": ["*"],
+      "routes": [
+        {
+          "prefix": "/foo/bar",
+          "cluster": "foo_bar_with_header",
+          "headers" : [
+            {"name": "test_header", "value": "test"}
+          ]
+        },
+        {
+          "path": "/FOO",
+          "case_sensitive": false,
+          "cluster": "foo_path_insensitive"
+        },
+        {
+          "prefix": "/foo",
+          "cluster": "foo_prefix"
+        },
+        {
+          "path": "/foo",
+          "cluster": "foo_path_shadowed"
+        },
+        {
+          "prefix": "/",
+          "cluster": "default"
+        }
+      ]
+    }
+  ]
+}
+  )EOF";
+
+  Json::ObjectSharedPtr loader = Json::Factory::loadFromString(json);
+  NiceMock<Runtime::MockLoader> runtime;
+  NiceMock<Upstream::MockClusterManager> cm;
+  ConfigImpl config(*loader, runtime, cm, false);
+
+  {
+    Http::TestHeaderMapImpl headers = genHeaders("www.lyft.com", "/foo/bar/baz", "GET");
+    headers.addViaCopy("test_header", "test");
+    EXPECT_EQ("foo_bar_with_header", config.route(headers, 0)->routeEntry()->clusterName());
+  }
+
+  EXPECT_EQ("foo_prefix", config.route(genHeaders("www.lyft.com", "/foo/bar/baz", "GET"), 0)
+                              ->routeEntry()
+                              ->clusterName());
+  EXPECT_EQ("foo_path_insensitive", config.route(genHeaders("www.lyft.com", "/foo", "GET"), 0)
+                                        ->routeEntry()
+                                        ->clusterName());
+  EXPECT_EQ("foo_path_insensitive", config.route(genHeaders("www.lyft.com", "/fOo?a=b", "GET"), 0)
+                                        ->routeEntry()
+                                        ->clusterName());
+  EXPECT_EQ("foo_prefix", config.route(genHeaders("www.lyft.com", "/foobar", "GET"), 0)
+                              ->routeEntry()
+                              ->clusterName());
+  EXPECT_EQ("default", config.route(genHeaders("www.lyft.com", "/FOO/", "GET"), 0)
+                           ->routeEntry()
+                           ->clusterName());
+  EXPECT_EQ("default", config.route(genHeaders("www.lyft.com", "/bar", "GET"), 0)
+                           ->routeEntry()
+                           ->clusterName());
+}
+
+TEST(RouteMatcherTest, WildcardDomains) {
+  std::string json = R"EOF(
+{
+  "virtual_hosts": [
+    {
+      "name": "foo",
+      "domains": ["*.foo.com"],
+      "routes": [
+        {
+          "prefix": "/",
+          "cluster": "foo"
+        }
+      ]
+    },
+    {
+      "name": "bar_foo",
+      "domains": ["*.bar.foo.com", "*.foo.com"],
+      "routes": [
+        {
+          "prefix": "/",
+          "cluster": "bar_foo"
+        }
+      ]
+    },
+    {
+      "name": "default",
+      "domains": ["*"],
+      "routes": [
+        {
+          "prefix": "/",
+          "cluster": "default"
+        }
+      ]
+    }
+  ]
+}
+  )EOF";
+
+  Json::ObjectSharedPtr loader = Json::Factory::loadFromString(json);
+  NiceMock<Runtime::MockLoader> runtime;
+  NiceMock<Upstream::MockClusterManager> cm;
+  ConfigImpl config(*loader, runtime, cm, false);
+
+  EXPECT_EQ("bar_foo",
+            config.route(genHeaders("a.bar.foo.com", "/", "GET"), 0)->routeEntry()->clusterName());
+  EXPECT_EQ("foo",
+            config.route(genHeaders(".bar.foo.com", "/", "GET"), 0)->routeEntry()->clusterName());
+  // The first virtual host with a duplicate wildcard wins.
+  EXPECT_EQ("foo",
+            config.route(genHeaders("a.foo.com", "/", "GET"), 0)->routeEntry()->clusterName());
+  EXPECT_EQ("default",
+            config.route(genHeaders(".foo.com", "/", "GET"), 0)->routeEntry()->clusterName());
+  EXPECT_EQ("default", config.route(genHeaders("", "/", "GET"), 0)->routeEntry()->clusterName());
+}
+
+TEST(RouteMatcherTest, InvalidRegex) {
+  NiceMock<Runtime::MockLoader> runtime;
+  NiceMock<Upstream::MockClusterManager> cm;
+
+  {
+    std::string json = R"EOF(
+{
+  "virtual_hosts": [
+    {
+      "name": "local_service",
+      "domains": ["*"],
+      "routes": [
+        {
+          "prefix": "/",
+          "cluster": "local_service",
+          "headers" : [
+            {"name": "test_header", "value": "(", "regex": true}
+          ]
+        }
+      ]
+    }
+  ]
+}
+    )EOF";
+
+    Json::ObjectSharedPtr loader = Json::Factory::loadFromString(json);
+    EXPECT_THROW(ConfigImpl(*loader, runtime, cm, false), EnvoyException);
+  }
+
+  {
+    std::string json = R"EOF(
+{
+  "virtual_hosts": [
+    {
+      "name": "local_service",
+      "domains": ["*"],
+      "routes": [
+        {
+          "prefix": "/",
+          "cluster": "local_service",
+          "headers" : [
+            {"name": "test_header", "value": "("}
+          ]
+        }
+      ]
+    }
+  ]
+}
+    )EOF";
+
+    // Values that are not regexes are never compiled.
+    Json::ObjectSharedPtr loader = Json::Factory::loadFromString(json);
+    ConfigImpl config(*loader, runtime, cm, false);
+  }
+
+  {
+    std::string json = R"EOF(
+{
+  "virtual_hosts": [
+    {
+      "name": "local_service",
+      "domains": ["*"],
+      "routes": [
+        {
+          "prefix": "/",
+          "cluster": "local_service"
+        }
+      ],
+      "virtual_clusters": [
+        {"pattern": "^/users/\\d+/chargeaccounts/(?!validate)\\w+$", "name": "cc_add"}
+      ]
+    }
+  ]
+}
+    )EOF";
+
+    // Lookarounds are not supported.
+    Json::ObjectSharedPtr loader = Json::Factory::loadFromString(json);
+    EXPECT_THROW(ConfigImpl(*loader, runtime, cm, false), EnvoyException);
+  }
+}
+
 TEST(RouterMatcherTest, HashPolicy) {
   std::string json = R"EOF(
 {
@@ -790,6 +998,51 @@ TEST(RouteMatcherTest, ClusterHeader) {
   }
 }
 
+TEST(RouteMatcherTest, ClusterId) {
+  std::string json = R"EOF(
+{
+  "virtual_hosts": [
+    {
+      "name": "local_service",
+      "domains": ["*"],
+      "routes": [
+        {
+          "prefix": "/foo",
+          "cluster": "foo_cluster"
+        },
+        {
+          "prefix": "/bar",
+          "weighted_clusters": {
+            "clusters" : [{ "name" : "bar_cluster", "weight" : 100 }]
+          }
+        },
+        {
+          "prefix": "/",
+          "cluster_header": "some_header"
+        }
+      ]
+    }
+  ]
+}
+  )EOF";
+
+  Json::ObjectSharedPtr loader = Json::Factory::loadFromString(json);
+  NiceMock<Runtime::MockLoader> runtime;
+  NiceMock<Upstream::MockClusterManager> cm;
+  EXPECT_CALL(cm, clusterId("foo_cluster")).WillOnce(Return(1));
+  EXPECT_CALL(cm, clusterId("bar_cluster")).WillOnce(Return(2));
+  ConfigImpl config(*loader, runtime, cm, true);
+
+  Router::RouteConstSharedPtr route = config.route(genHeaders("www.lyft.com", "/foo", "GET"), 0);
+  EXPECT_EQ(1U, route->routeEntry()->clusterId().value());
+  route = config.route(genHeaders("www.lyft.com", "/bar", "GET"), 0);
+  EXPECT_EQ(2U, route->routeEntry()->clusterId().value());
+
+  Http::TestHeaderMapImpl headers = genHeaders("www.lyft.com", "/", "GET");
+  headers.addViaCopy("some_header", "some_cluster");
+  EXPECT_FALSE(config.route(headers, 0)->routeEntry()->clusterId().valid());
+}
+
 TEST(RouteMatcherTest, ContentType) {
   std::string json = R"EOF(
 {
@@ -1061,7 +1314,8 @@ TEST(RouteMatcherTest, Retry) {
           "retry_policy": {
             "per_try_timeout_ms" : 1000,
             "num_retries": 3,
-            "retry_on": "5xx,connect-failure"
+            "retry_on": "5xx,connect-failure",
+            "hedge_delay_ms" : 50
           }
         }
       ]
@@ -1117,6 +1371,14 @@ TEST(RouteMatcherTest, Retry) {
                 ->routeEntry()
                 ->retryPolicy()
                 .retryOn());
+  EXPECT_EQ(std::chrono::milliseconds(50), config.route(genHeaders("www.lyft.com", "/", "GET"), 0)
+                                               ->routeEntry()
+                                               ->retryPolicy()
+                                               .hedgeDelay());
+  EXPECT_EQ(std::chrono::milliseconds(0), config.route(genHeaders("www.lyft.com", "/foo", "GET"), 0)
+                                              ->routeEntry()
+                                              ->retryPolicy()
+                                              .hedgeDelay());
 }
 
 TEST(RouteMatcherTest, TestBadDefaultConfig) {
@@ -1813,6 +2075,47 @@ TEST(RouteMatcherTest, TestOpaqueConfig) {
   EXPECT_EQ(opaque_config.find("name2")->second, "value2");
 }
 
+TEST(RouteMatcherTest, TestMetadataMatchCriteria) {
+  std::string json = R"EOF(
+{
+  "virtual_hosts": [
+    {
+      "name": "default",
+      "domains": ["*"],
+      "routes": [
+        {
+          "prefix": "/api",
+          "cluster": "ats",
+          "metadata_match" : {
+              "version": "v2",
+              "stage": "canary"
+          }
+        },
+        {
+          "prefix": "/",
+          "cluster": "ats"
+        }
+      ]
+    }
+  ]
+}
+)EOF";
+
+  Json::ObjectSharedPtr loader = Json::Factory::loadFromString(json);
+  NiceMock<Runtime::MockLoader> runtime;
+  NiceMock<Upstream::MockClusterManager> cm;
+  ConfigImpl config(*loader, runtime, cm, true);
+
+  EXPECT_EQ((Upstream::HostMetadata{{"version", "v2"}, {"stage", "canary"}}),
+            config.route(genHeaders("api.lyft.com", "/api", "GET"), 0)
+                ->routeEntry()
+                ->metadataMatchCriteria());
+  EXPECT_TRUE(config.route(genHeaders("api.lyft.com", "/", "GET"), 0)
+                  ->routeEntry()
+                  ->metadataMatchCriteria()
+                  .empty());
+}
+
 TEST(RoutePropertyTest, excludeVHRateLimits) {
   std::string json = R"EOF(
   {
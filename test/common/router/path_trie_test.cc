@@ -0,0 +1,65 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "common/router/path_trie.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Router {
+
+std::vector<uint32_t> find(const PathTrie& trie, const std::string& input) {
+  std::vector<uint32_t> values;
+  size_t exact_length = input.find('?');
+  trie.find(input.c_str(), input.size(), exact_length == std::string::npos ? input.size()
+                                                                           : exact_length,
+            values);
+  return values;
+}
+
+TEST(PathTrieTest, Empty) {
+  PathTrie trie;
+  EXPECT_TRUE(trie.empty());
+  EXPECT_TRUE(find(trie, "/foo").empty());
+}
+
+TEST(PathTrieTest, Prefixes) {
+  PathTrie trie;
+  trie.addPrefix("/foo/bar", 0);
+  trie.addPrefix("/foo", 1);
+  trie.addPrefix("/", 2);
+  trie.addPrefix("/fob", 3);
+  trie.addPrefix("", 4);
+  trie.addPrefix("/foo", 5);
+  EXPECT_FALSE(trie.empty());
+
+  EXPECT_EQ(std::vector<uint32_t>({4, 2, 1, 5, 0}), find(trie, "/foo/bar/baz"));
+  EXPECT_EQ(std::vector<uint32_t>({4, 2, 1, 5}), find(trie, "/foo/ba"));
+  EXPECT_EQ(std::vector<uint32_t>({4, 2, 1, 5}), find(trie, "/foo"));
+  EXPECT_EQ(std::vector<uint32_t>({4, 2}), find(trie, "/fo"));
+  EXPECT_EQ(std::vector<uint32_t>({4, 2, 3}), find(trie, "/fob?x=1"));
+  EXPECT_EQ(std::vector<uint32_t>({4}), find(trie, "foo"));
+  EXPECT_EQ(std::vector<uint32_t>({4}), find(trie, ""));
+}
+
+TEST(PathTrieTest, Exact) {
+  PathTrie trie;
+  trie.addExact("/foo", 0);
+  trie.addExact("/foo/bar", 1);
+  trie.addExact("/", 2);
+  trie.addPrefix("/foo", 3);
+  trie.addExact("/foo?a", 4);
+
+  EXPECT_EQ(std::vector<uint32_t>({3, 0}), find(trie, "/foo"));
+  EXPECT_EQ(std::vector<uint32_t>({3, 0}), find(trie, "/foo?a=b"));
+  EXPECT_EQ(std::vector<uint32_t>({3}), find(trie, "/foo/"));
+  EXPECT_EQ(std::vector<uint32_t>({3, 1}), find(trie, "/foo/bar"));
+  EXPECT_EQ(std::vector<uint32_t>({2}), find(trie, "/"));
+  EXPECT_EQ(std::vector<uint32_t>({2}), find(trie, "/?foo"));
+  EXPECT_TRUE(find(trie, "/fo").empty());
+}
+
+} // Router
+} // Envoy
@@ -265,5 +265,57 @@ TEST_F(RouterRetryStateImplTest, Cancel) {
   EXPECT_TRUE(state_->shouldRetry(nullptr, connect_failure_, callback_));
 }
 
+TEST_F(RouterRetryStateImplTest, Hedge) {
+  cluster_.resource_manager_.reset(
+      new Upstream::ResourceManagerImpl(runtime_, "fake_key", 1, 1, 1, 1));
+  ON_CALL(runtime_.snapshot_, featureEnabled("upstream.use_hedging", 100))
+      .WillByDefault(Return(true));
+  policy_.hedge_delay_ = std::chrono::milliseconds(10);
+  Http::TestHeaderMapImpl request_headers;
+  setup(request_headers);
+  EXPECT_TRUE(state_->enabled());
+
+  // The hedge holds a retry until the retry state goes away.
+  EXPECT_TRUE(state_->shouldHedge());
+  EXPECT_FALSE(state_->shouldHedge());
+  EXPECT_FALSE(cluster_.resourceManager(Upstream::ResourcePriority::Default).retries().canCreate());
+  EXPECT_EQ(1UL, cluster_.stats().upstream_rq_hedge_.value());
+
+  state_.reset();
+  EXPECT_TRUE(cluster_.resourceManager(Upstream::ResourcePriority::Default).retries().canCreate());
+}
+
+TEST_F(RouterRetryStateImplTest, HedgeUsesRetryBudget) {
+  ON_CALL(runtime_.snapshot_, featureEnabled("upstream.use_hedging", 100))
+      .WillByDefault(Return(true));
+  policy_.hedge_delay_ = std::chrono::milliseconds(10);
+  policy_.retry_on_ = RetryPolicy::RETRY_ON_CONNECT_FAILURE;
+  Http::TestHeaderMapImpl request_headers;
+  setup(request_headers);
+
+  EXPECT_TRUE(state_->shouldHedge());
+  EXPECT_FALSE(state_->shouldRetry(nullptr, connect_failure_, callback_));
+  EXPECT_EQ(0UL, cluster_.stats().upstream_rq_retry_.value());
+}
+
+TEST_F(RouterRetryStateImplTest, HedgeOverflow) {
+  cluster_.resource_manager_.reset(
+      new Upstream::ResourceManagerImpl(runtime_, "fake_key", 0, 0, 0, 0));
+  ON_CALL(runtime_.snapshot_, featureEnabled("upstream.use_hedging", 100))
+      .WillByDefault(Return(true));
+  policy_.hedge_delay_ = std::chrono::milliseconds(10);
+  Http::TestHeaderMapImpl request_headers;
+  setup(request_headers);
+
+  EXPECT_FALSE(state_->shouldHedge());
+  EXPECT_EQ(1UL, cluster_.stats().upstream_rq_hedge_overflow_.value());
+}
+
+TEST_F(RouterRetryStateImplTest, HedgeNotConfigured) {
+  Http::TestHeaderMapImpl request_headers{{"x-envoy-retry-on", "connect-failure"}};
+  setup(request_headers);
+  EXPECT_FALSE(state_->shouldHedge());
+}
+
 } // Router
 } // Envoy
@@ -0,0 +1,226 @@
+#include <memory>
+#include <string>
+
+#include "common/http/header_map_impl.h"
+#include "common/json/json_loader.h"
+#include "common/router/config_impl.h"
+#include "common/router/route_cache_impl.h"
+
+#include "test/mocks/runtime/mocks.h"
+#include "test/mocks/upstream/mocks.h"
+#include "test/test_common/utility.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace Envoy {
+using testing::_;
+using testing::NiceMock;
+using testing::Return;
+
+namespace Router {
+
+static Http::TestHeaderMapImpl genHeaders(const std::string& host, const std::string& path) {
+  return Http::TestHeaderMapImpl{{":authority", host}, {":path", path}, {":method", "GET"}};
+}
+
+class RouteCacheImplTest : public testing::Test {
+public:
+  void setup(const std::string& json) {
+    Json::ObjectSharedPtr loader = Json::Factory::loadFromString(json);
+    config_ = std::make_shared<ConfigImpl>(*loader, runtime_, cm_, true);
+    cache_.reset(new RouteCacheImpl(config_));
+  }
+
+  const std::string& clusterName(const Http::HeaderMap& headers) {
+    return cache_->route(headers, 0)->routeEntry()->clusterName();
+  }
+
+  NiceMock<Runtime::MockLoader> runtime_;
+  NiceMock<Upstream::MockClusterManager> cm_;
+  ConfigImplConstSharedPtr config_;
+  std::unique_ptr<RouteCacheImpl> cache_;
+};
+
+TEST_F(RouteCacheImplTest, Disabled) {
+  std::string json = R"EOF(
+{
+  "virtual_hosts": [
+    {
+      "name": "www",
+      "domains": ["*"],
+      "routes": [{"prefix": "/", "cluster": "www"}]
+    }
+  ]
+}
+  )EOF";
+
+  setup(json);
+  EXPECT_EQ(config_, RouteCacheImpl::forWorker(config_));
+}
+
+TEST_F(RouteCacheImplTest, HitsAndEviction) {
+  std::string json = R"EOF(
+{
+  "virtual_hosts": [
+    {
+      "name": "www",
+      "domains": ["www.lyft.com"],
+      "routes": [
+        {"prefix": "/foo", "cluster": "foo"},
+        {"prefix": "/", "cluster": "www"}
+      ]
+    }
+  ],
+  "route_cache_size": 2
+}
+  )EOF";
+
+  setup(json);
+  EXPECT_NE(config_, RouteCacheImpl::forWorker(config_));
+
+  RouteConstSharedPtr route = cache_->route(genHeaders("www.lyft.com", "/foo"), 0);
+  EXPECT_EQ("foo", route->routeEntry()->clusterName());
+  EXPECT_EQ(1UL, cache_->size());
+  EXPECT_EQ(route, cache_->route(genHeaders("www.lyft.com", "/foo"), 0));
+
+  // The query string does not take up another entry.
+  EXPECT_EQ(route, cache_->route(genHeaders("www.lyft.com", "/foo?bar=baz"), 0));
+  EXPECT_EQ(1UL, cache_->size());
+
+  // Requests without a route are cached too.
+  EXPECT_EQ(nullptr, cache_->route(genHeaders("api.lyft.com", "/foo"), 0));
+  EXPECT_EQ(2UL, cache_->size());
+
+  // The least recently used entry goes first.
+  EXPECT_EQ(route, cache_->route(genHeaders("www.lyft.com", "/foo"), 0));
+  EXPECT_EQ("www", clusterName(genHeaders("www.lyft.com", "/bar")));
+  EXPECT_EQ(2UL, cache_->size());
+  EXPECT_EQ(route, cache_->route(genHeaders("www.lyft.com", "/foo"), 0));
+  EXPECT_EQ(2UL, cache_->size());
+}
+
+TEST_F(RouteCacheImplTest, QueryStringPrefix) {
+  std::string json = R"EOF(
+{
+  "virtual_hosts": [
+    {
+      "name": "www",
+      "domains": ["*"],
+      "routes": [
+        {"prefix": "/foo?debug", "cluster": "debug"},
+        {"prefix": "/", "cluster": "www"}
+      ]
+    }
+  ],
+  "route_cache_size": 10
+}
+  )EOF";
+
+  setup(json);
+  EXPECT_EQ("www", clusterName(genHeaders("www.lyft.com", "/foo")));
+  EXPECT_EQ("debug", clusterName(genHeaders("www.lyft.com", "/foo?debug=1")));
+  EXPECT_EQ("www", clusterName(genHeaders("www.lyft.com", "/foo?other=1")));
+  EXPECT_EQ(3UL, cache_->size());
+}
+
+TEST_F(RouteCacheImplTest, MatchedHeaders) {
+  std::string json = R"EOF(
+{
+  "virtual_hosts": [
+    {
+      "name": "www",
+      "domains": ["*"],
+      "routes": [
+        {
+          "prefix": "/",
+          "cluster": "with_header",
+          "headers": [{"name": "test_header"}]
+        },
+        {"prefix": "/", "cluster": "www"}
+      ]
+    },
+    {
+      "name": "secure",
+      "domains": ["secure.lyft.com"],
+      "require_ssl": "all",
+      "routes": [{"prefix": "/", "cluster": "secure"}]
+    }
+  ],
+  "route_cache_size": 10
+}
+  )EOF";
+
+  setup(json);
+  {
+    Http::TestHeaderMapImpl headers = genHeaders("www.lyft.com", "/");
+    EXPECT_EQ("www", clusterName(headers));
+    headers.addViaCopy("test_header", "");
+    EXPECT_EQ("with_header", clusterName(headers));
+    EXPECT_EQ(2UL, cache_->size());
+  }
+
+  {
+    Http::TestHeaderMapImpl headers = genHeaders("secure.lyft.com", "/");
+    headers.addViaCopy("x-forwarded-proto", "http");
+    EXPECT_EQ(nullptr, cache_->route(headers, 0)->routeEntry());
+    EXPECT_NE(nullptr, cache_->route(headers, 0)->redirectEntry());
+    headers.removeForwardedProto();
+    headers.addViaCopy("x-forwarded-proto", "https");
+    EXPECT_EQ("secure", clusterName(headers));
+    EXPECT_EQ(4UL, cache_->size());
+  }
+}
+
+TEST_F(RouteCacheImplTest, NotCacheable) {
+  std::string json = R"EOF(
+{
+  "virtual_hosts": [
+    {
+      "name": "www",
+      "domains": ["*"],
+      "routes": [
+        {
+          "prefix": "/runtime",
+          "cluster": "runtime",
+          "runtime": {"key": "some_key", "default": 50}
+        },
+        {
+          "prefix": "/weighted",
+          "weighted_clusters": {
+            "clusters": [
+              {"name": "cluster1", "weight": 50},
+              {"name": "cluster2", "weight": 50}
+            ]
+          }
+        },
+        {"prefix": "/", "cluster": "www"}
+      ]
+    }
+  ],
+  "route_cache_size": 10
+}
+  )EOF";
+
+  setup(json);
+  EXPECT_CALL(runtime_.snapshot_, featureEnabled("some_key", 50, _))
+      .WillOnce(Return(true))
+      .WillOnce(Return(false));
+  EXPECT_EQ("runtime", clusterName(genHeaders("www.lyft.com", "/runtime")));
+  EXPECT_EQ("www", clusterName(genHeaders("www.lyft.com", "/runtime")));
+
+  EXPECT_EQ("cluster1", cache_->route(genHeaders("www.lyft.com", "/weighted"), 10)
+                            ->routeEntry()
+                            ->clusterName());
+  EXPECT_EQ("cluster2", cache_->route(genHeaders("www.lyft.com", "/weighted"), 60)
+                            ->routeEntry()
+                            ->clusterName());
+  EXPECT_EQ(0UL, cache_->size());
+
+  // Paths that never reach those routes are still cached.
+  EXPECT_EQ("www", clusterName(genHeaders("www.lyft.com", "/other")));
+  EXPECT_EQ(1UL, cache_->size());
+}
+
+} // Router
+} // Envoy
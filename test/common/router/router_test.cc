@@ -8,11 +8,13 @@
 #include "common/upstream/upstream_impl.h"
 
 #include "test/common/http/common.h"
+#include "test/mocks/buffer/mocks.h"
 #include "test/mocks/http/mocks.h"
 #include "test/mocks/local_info/mocks.h"
 #include "test/mocks/router/mocks.h"
 #include "test/mocks/runtime/mocks.h"
 #include "test/mocks/ssl/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
 #include "test/mocks/upstream/mocks.h"
 #include "test/test_common/printers.h"
 #include "test/test_common/utility.h"
@@ -22,7 +24,7 @@
 
 namespace Envoy {
 using testing::_;
-using testing::AtLeast;
+using testing::DoAll;
 using testing::Invoke;
 using testing::NiceMock;
 using testing::Return;
@@ -52,7 +54,7 @@ public:
   RouterTest()
       : shadow_writer_(new MockShadowWriter()),
         config_("test.", local_info_, stats_store_, cm_, runtime_, random_,
-                ShadowWriterPtr{shadow_writer_}, true),
+                ShadowWriterPtr{shadow_writer_}, true, nullptr),
         router_(config_) {
     router_.setDecoderFilterCallbacks(callbacks_);
     ON_CALL(*cm_.conn_pool_.host_, address()).WillByDefault(Return(host_address_));
@@ -112,9 +114,96 @@ TEST_F(RouterTest, ClusterNotFound) {
   EXPECT_EQ(1UL, stats_store_.counter("test.no_cluster").value());
 }
 
+TEST_F(RouterTest, ClusterNotFoundById) {
+  EXPECT_CALL(callbacks_.request_info_,
+              setResponseFlag(Http::AccessLog::ResponseFlag::NoRouteFound));
+
+  Http::TestHeaderMapImpl headers;
+  HttpTestUtility::addDefaultHeaders(headers);
+  callbacks_.route_->route_entry_.cluster_id_.value(5);
+  EXPECT_CALL(cm_, getById(5)).WillOnce(Return(nullptr));
+  EXPECT_CALL(cm_, get(_)).Times(0);
+
+  router_.decodeHeaders(headers, true);
+  EXPECT_EQ(1UL, stats_store_.counter("test.no_cluster").value());
+}
+
+TEST_F(RouterTest, ClusterDiscovery) {
+  Upstream::MockClusterDiscoveryRequest discovery;
+  Upstream::ClusterDiscoveryCb discovered;
+  ON_CALL(cm_, get(_)).WillByDefault(Return(nullptr));
+  EXPECT_CALL(cm_, discoverCluster("fake_cluster", _))
+      .WillOnce(DoAll(SaveArg<1>(&discovered), Return(&discovery)));
+
+  // The request and its body wait for the cluster.
+  Http::TestHeaderMapImpl headers;
+  HttpTestUtility::addDefaultHeaders(headers);
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, router_.decodeHeaders(headers, false));
+  Buffer::OwnedImpl data("hello");
+  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer, router_.decodeData(data, true));
+  EXPECT_EQ(1UL, stats_store_.counter("test.rq_cluster_discovery").value());
+  EXPECT_EQ(0UL, stats_store_.counter("test.no_cluster").value());
+
+  // Once the cluster is known the request is sent upstream with the buffered body.
+  NiceMock<Http::MockStreamEncoder> encoder;
+  Http::StreamDecoder* response_decoder = nullptr;
+  EXPECT_CALL(cm_.conn_pool_, newStream(_, _))
+      .WillOnce(Invoke([&](Http::StreamDecoder& decoder, Http::ConnectionPool::Callbacks& callbacks)
+                           -> Http::ConnectionPool::Cancellable* {
+                             response_decoder = &decoder;
+                             callbacks.onPoolReady(encoder, cm_.conn_pool_.host_);
+                             return nullptr;
+                           }));
+  expectResponseTimerCreate();
+  ON_CALL(cm_, get(_)).WillByDefault(Return(&cm_.thread_local_cluster_));
+  Buffer::OwnedImpl buffered("hello");
+  ON_CALL(callbacks_, decodingBuffer()).WillByDefault(Return(&buffered));
+  EXPECT_CALL(encoder, encodeHeaders(_, false));
+  EXPECT_CALL(encoder, encodeData(BufferStringEqual("hello"), true));
+  discovered();
+
+  EXPECT_CALL(cm_.conn_pool_.host_->outlier_detector_, putHttpResponseCode(200));
+  EXPECT_CALL(cm_.conn_pool_.host_->outlier_detector_, putResponseTime(_));
+  Http::HeaderMapPtr response_headers(new Http::TestHeaderMapImpl{{":status", "200"}});
+  response_decoder->decodeHeaders(std::move(response_headers), true);
+}
+
+TEST_F(RouterTest, ClusterDiscoveryNotFound) {
+  Upstream::MockClusterDiscoveryRequest discovery;
+  Upstream::ClusterDiscoveryCb discovered;
+  ON_CALL(cm_, get(_)).WillByDefault(Return(nullptr));
+  EXPECT_CALL(cm_, discoverCluster("fake_cluster", _))
+      .WillOnce(DoAll(SaveArg<1>(&discovered), Return(&discovery)));
+
+  Http::TestHeaderMapImpl headers;
+  HttpTestUtility::addDefaultHeaders(headers);
+  router_.decodeHeaders(headers, true);
+
+  EXPECT_CALL(callbacks_.request_info_,
+              setResponseFlag(Http::AccessLog::ResponseFlag::NoRouteFound));
+  Http::TestHeaderMapImpl response_headers{{":status", "404"}};
+  EXPECT_CALL(callbacks_, encodeHeaders_(HeaderMapEqualRef(&response_headers), true));
+  EXPECT_CALL(cm_.conn_pool_, newStream(_, _)).Times(0);
+  discovered();
+  EXPECT_EQ(1UL, stats_store_.counter("test.no_cluster").value());
+}
+
+TEST_F(RouterTest, ClusterDiscoveryCancel) {
+  Upstream::MockClusterDiscoveryRequest discovery;
+  ON_CALL(cm_, get(_)).WillByDefault(Return(nullptr));
+  EXPECT_CALL(cm_, discoverCluster("fake_cluster", _)).WillOnce(Return(&discovery));
+
+  Http::TestHeaderMapImpl headers;
+  HttpTestUtility::addDefaultHeaders(headers);
+  router_.decodeHeaders(headers, true);
+
+  EXPECT_CALL(discovery, cancel());
+  router_.onDestroy();
+}
+
 TEST_F(RouterTest, PoolFailureWithPriority) {
   callbacks_.route_->route_entry_.virtual_cluster_.priority_ = Upstream::ResourcePriority::High;
-  EXPECT_CALL(cm_, httpConnPoolForCluster(_, Upstream::ResourcePriority::High, nullptr));
+  EXPECT_CALL(cm_.thread_local_cluster_, connPool(Upstream::ResourcePriority::High, nullptr));
 
   EXPECT_CALL(cm_.conn_pool_, newStream(_, _))
       .WillOnce(Invoke([&](Http::StreamDecoder&, Http::ConnectionPool::Callbacks& callbacks)
@@ -145,9 +234,9 @@ TEST_F(RouterTest, HashPolicy) {
       .WillByDefault(Return(&callbacks_.route_->route_entry_.hash_policy_));
   EXPECT_CALL(callbacks_.route_->route_entry_.hash_policy_, generateHash(_))
       .WillOnce(Return(Optional<uint64_t>(10)));
-  EXPECT_CALL(cm_, httpConnPoolForCluster(_, _, _))
+  EXPECT_CALL(cm_.thread_local_cluster_, connPool(_, _))
       .WillOnce(
-          Invoke([&](const std::string&, Upstream::ResourcePriority,
+          Invoke([&](Upstream::ResourcePriority,
                      Upstream::LoadBalancerContext* context) -> Http::ConnectionPool::Instance* {
             EXPECT_EQ(10UL, context->hashKey().value());
             return &cm_.conn_pool_;
@@ -169,7 +258,30 @@ TEST_F(RouterTest, HashPolicyNoHash) {
       .WillByDefault(Return(&callbacks_.route_->route_entry_.hash_policy_));
   EXPECT_CALL(callbacks_.route_->route_entry_.hash_policy_, generateHash(_))
       .WillOnce(Return(Optional<uint64_t>()));
-  EXPECT_CALL(cm_, httpConnPoolForCluster(_, _, nullptr));
+  EXPECT_CALL(cm_.thread_local_cluster_, connPool(_, nullptr));
+  EXPECT_CALL(cm_.conn_pool_, newStream(_, _)).WillOnce(Return(&cancellable_));
+  expectResponseTimerCreate();
+
+  Http::TestHeaderMapImpl headers;
+  HttpTestUtility::addDefaultHeaders(headers);
+  router_.decodeHeaders(headers, true);
+
+  // When the router filter gets reset we should cancel the pool request.
+  EXPECT_CALL(cancellable_, cancel());
+  router_.onDestroy();
+}
+
+TEST_F(RouterTest, MetadataMatchCriteria) {
+  callbacks_.route_->route_entry_.metadata_match_criteria_ = {{"version", "v2"}};
+  EXPECT_CALL(cm_.thread_local_cluster_, connPool(_, _))
+      .WillOnce(
+          Invoke([&](Upstream::ResourcePriority,
+                     Upstream::LoadBalancerContext* context) -> Http::ConnectionPool::Instance* {
+            EXPECT_FALSE(context->hashKey().valid());
+            EXPECT_EQ((Upstream::HostMetadata{{"version", "v2"}}),
+                      *context->metadataMatchCriteria());
+            return &cm_.conn_pool_;
+          }));
   EXPECT_CALL(cm_.conn_pool_, newStream(_, _)).WillOnce(Return(&cancellable_));
   expectResponseTimerCreate();
 
@@ -196,7 +308,7 @@ TEST_F(RouterTest, CancelBeforeBoundToPool) {
 }
 
 TEST_F(RouterTest, NoHost) {
-  EXPECT_CALL(cm_, httpConnPoolForCluster(_, _, _)).WillOnce(Return(nullptr));
+  EXPECT_CALL(cm_.thread_local_cluster_, connPool(_, _)).WillOnce(Return(nullptr));
 
   Http::TestHeaderMapImpl response_headers{
       {":status", "503"}, {"content-length", "19"}, {"content-type", "text/plain"}};
@@ -284,7 +396,6 @@ TEST_F(RouterTest, UpstreamTimeout) {
       {":status", "504"}, {"content-length", "24"}, {"content-type", "text/plain"}};
   EXPECT_CALL(callbacks_, encodeHeaders_(HeaderMapEqualRef(&response_headers), false));
   EXPECT_CALL(callbacks_, encodeData(_, true));
-  EXPECT_CALL(*router_.retry_state_, shouldRetry(_, _, _)).Times(0);
   EXPECT_CALL(cm_.conn_pool_.host_->outlier_detector_, putHttpResponseCode(504));
   response_timeout_->callback_();
 
@@ -294,6 +405,64 @@ TEST_F(RouterTest, UpstreamTimeout) {
   EXPECT_EQ(1UL, cm_.conn_pool_.host_->stats().rq_timeout_.value());
 }
 
+TEST_F(RouterTest, FlowControl) {
+  NiceMock<Http::MockStreamEncoder> encoder;
+  Http::StreamDecoder* response_decoder = nullptr;
+  Http::ConnectionPool::Callbacks* pool_callbacks = nullptr;
+  EXPECT_CALL(cm_.conn_pool_, newStream(_, _))
+      .WillOnce(Invoke([&](Http::StreamDecoder& decoder, Http::ConnectionPool::Callbacks& callbacks)
+                           -> Http::ConnectionPool::Cancellable* {
+                             response_decoder = &decoder;
+                             pool_callbacks = &callbacks;
+                             return &cancellable_;
+                           }));
+  Http::DownstreamWatermarkCallbacks* downstream_callbacks = nullptr;
+  EXPECT_CALL(callbacks_, addDownstreamWatermarkCallbacks(_))
+      .WillOnce(Invoke([&](Http::DownstreamWatermarkCallbacks& callbacks) -> void {
+        downstream_callbacks = &callbacks;
+      }));
+  expectResponseTimerCreate();
+
+  Http::TestHeaderMapImpl headers;
+  HttpTestUtility::addDefaultHeaders(headers);
+  router_.decodeHeaders(headers, true);
+
+  // The downstream backs up before the upstream stream exists; reading pauses once it does.
+  downstream_callbacks->onAboveWriteBufferHighWatermark();
+  EXPECT_CALL(encoder.stream_, readDisable(true));
+  pool_callbacks->onPoolReady(encoder, cm_.conn_pool_.host_);
+
+  EXPECT_CALL(encoder.stream_, readDisable(false));
+  downstream_callbacks->onBelowWriteBufferLowWatermark();
+
+  // An upstream that cannot keep up with the request pauses the downstream.
+  EXPECT_CALL(callbacks_, onDecoderFilterAboveWriteBufferHighWatermark());
+  encoder.stream_.callbacks_.front()->onAboveWriteBufferHighWatermark();
+  EXPECT_CALL(callbacks_, onDecoderFilterBelowWriteBufferLowWatermark());
+  encoder.stream_.callbacks_.front()->onBelowWriteBufferLowWatermark();
+
+  // Both sides are released if the request ends while paused.
+  EXPECT_CALL(encoder.stream_, readDisable(true));
+  downstream_callbacks->onAboveWriteBufferHighWatermark();
+  EXPECT_CALL(callbacks_, onDecoderFilterAboveWriteBufferHighWatermark());
+  encoder.stream_.callbacks_.front()->onAboveWriteBufferHighWatermark();
+
+  EXPECT_CALL(encoder.stream_, readDisable(false));
+  EXPECT_CALL(callbacks_, onDecoderFilterBelowWriteBufferLowWatermark());
+  EXPECT_CALL(callbacks_, encodeHeaders_(_, true));
+  Http::HeaderMapPtr response_headers(new Http::TestHeaderMapImpl{{":status", "200"}});
+  response_decoder->decodeHeaders(std::move(response_headers), true);
+
+  EXPECT_CALL(callbacks_, removeDownstreamWatermarkCallbacks(_));
+  router_.onDestroy();
+
+  Upstream::ClusterStats& stats = cm_.thread_local_cluster_.cluster_.info_->stats_;
+  EXPECT_EQ(2U, stats.upstream_flow_control_paused_reading_total_.value());
+  EXPECT_EQ(1U, stats.upstream_flow_control_resumed_reading_total_.value());
+  EXPECT_EQ(2U, stats.upstream_flow_control_backed_up_total_.value());
+  EXPECT_EQ(1U, stats.upstream_flow_control_drained_total_.value());
+}
+
 TEST_F(RouterTest, UpstreamTimeoutWithAltResponse) {
   NiceMock<Http::MockStreamEncoder> encoder;
   Http::StreamDecoder* response_decoder = nullptr;
@@ -322,7 +491,6 @@ TEST_F(RouterTest, UpstreamTimeoutWithAltResponse) {
   EXPECT_CALL(encoder.stream_, resetStream(Http::StreamResetReason::LocalReset));
   Http::TestHeaderMapImpl response_headers{{":status", "204"}};
   EXPECT_CALL(callbacks_, encodeHeaders_(HeaderMapEqualRef(&response_headers), true));
-  EXPECT_CALL(*router_.retry_state_, shouldRetry(_, _, _)).Times(0);
   EXPECT_CALL(cm_.conn_pool_.host_->outlier_detector_, putHttpResponseCode(204));
   response_timeout_->callback_();
 
@@ -422,7 +590,7 @@ TEST_F(RouterTest, RetryNoneHealthy) {
   EXPECT_CALL(cm_.conn_pool_.host_->outlier_detector_, putHttpResponseCode(503));
   encoder1.stream_.resetStream(Http::StreamResetReason::LocalReset);
 
-  EXPECT_CALL(cm_, httpConnPoolForCluster(_, _, _)).WillOnce(Return(nullptr));
+  EXPECT_CALL(cm_.thread_local_cluster_, connPool(_, _)).WillOnce(Return(nullptr));
   Http::TestHeaderMapImpl response_headers{
       {":status", "503"}, {"content-length", "19"}, {"content-type", "text/plain"}};
   EXPECT_CALL(callbacks_, encodeHeaders_(HeaderMapEqualRef(&response_headers), false));
@@ -579,6 +747,127 @@ TEST_F(RouterTest, RetryUpstream5xx) {
   response_decoder->decodeHeaders(std::move(response_headers2), true);
 }
 
+TEST_F(RouterTest, HedgeRespondsFirst) {
+  callbacks_.route_->route_entry_.retry_policy_.hedge_delay_ = std::chrono::milliseconds(5);
+  NiceMock<Http::MockStreamEncoder> encoder1;
+  EXPECT_CALL(cm_.conn_pool_, newStream(_, _))
+      .WillOnce(Invoke([&](Http::StreamDecoder&, Http::ConnectionPool::Callbacks& callbacks)
+                           -> Http::ConnectionPool::Cancellable* {
+                             callbacks.onPoolReady(encoder1, cm_.conn_pool_.host_);
+                             return nullptr;
+                           }));
+  Event::MockTimer* hedge_timer = new Event::MockTimer(&callbacks_.dispatcher_);
+  EXPECT_CALL(*hedge_timer, enableTimer(std::chrono::milliseconds(5)));
+  EXPECT_CALL(*hedge_timer, disableTimer());
+  expectResponseTimerCreate();
+
+  Http::TestHeaderMapImpl headers;
+  HttpTestUtility::addDefaultHeaders(headers);
+  router_.decodeHeaders(headers, true);
+
+  // The hedge goes to a different host.
+  NiceMock<Http::ConnectionPool::MockInstance> conn_pool2;
+  NiceMock<Http::MockStreamEncoder> encoder2;
+  Http::StreamDecoder* response_decoder2 = nullptr;
+  EXPECT_CALL(cm_.thread_local_cluster_, connPool(_, _)).WillOnce(Return(&conn_pool2));
+  EXPECT_CALL(*router_.retry_state_, shouldHedge()).WillOnce(Return(true));
+  EXPECT_CALL(conn_pool2, newStream(_, _))
+      .WillOnce(Invoke([&](Http::StreamDecoder& decoder, Http::ConnectionPool::Callbacks& callbacks)
+                           -> Http::ConnectionPool::Cancellable* {
+                             response_decoder2 = &decoder;
+                             callbacks.onPoolReady(encoder2, conn_pool2.host_);
+                             return nullptr;
+                           }));
+  hedge_timer->callback_();
+
+  // The hedge responds first so the original request is reset.
+  EXPECT_CALL(encoder1.stream_, resetStream(Http::StreamResetReason::LocalReset));
+  EXPECT_CALL(encoder2.stream_, resetStream(_)).Times(0);
+  EXPECT_CALL(cm_.conn_pool_.host_->outlier_detector_, putHttpResponseCode(_)).Times(0);
+  EXPECT_CALL(conn_pool2.host_->outlier_detector_, putHttpResponseCode(200));
+  Http::HeaderMapPtr response_headers(new Http::TestHeaderMapImpl{{":status", "200"}});
+  response_decoder2->decodeHeaders(std::move(response_headers), true);
+  EXPECT_EQ(1U, cm_.thread_local_cluster_.cluster_.info_->stats_store_
+                    .counter("upstream_rq_hedge_win")
+                    .value());
+}
+
+TEST_F(RouterTest, HedgeOriginalFails) {
+  callbacks_.route_->route_entry_.retry_policy_.hedge_delay_ = std::chrono::milliseconds(5);
+  NiceMock<Http::MockStreamEncoder> encoder1;
+  EXPECT_CALL(cm_.conn_pool_, newStream(_, _))
+      .WillOnce(Invoke([&](Http::StreamDecoder&, Http::ConnectionPool::Callbacks& callbacks)
+                           -> Http::ConnectionPool::Cancellable* {
+                             callbacks.onPoolReady(encoder1, cm_.conn_pool_.host_);
+                             return nullptr;
+                           }));
+  Event::MockTimer* hedge_timer = new Event::MockTimer(&callbacks_.dispatcher_);
+  EXPECT_CALL(*hedge_timer, enableTimer(_));
+  EXPECT_CALL(*hedge_timer, disableTimer());
+  expectResponseTimerCreate();
+
+  Http::TestHeaderMapImpl headers;
+  HttpTestUtility::addDefaultHeaders(headers);
+  router_.decodeHeaders(headers, true);
+
+  NiceMock<Http::ConnectionPool::MockInstance> conn_pool2;
+  NiceMock<Http::MockStreamEncoder> encoder2;
+  Http::StreamDecoder* response_decoder2 = nullptr;
+  EXPECT_CALL(cm_.thread_local_cluster_, connPool(_, _)).WillOnce(Return(&conn_pool2));
+  EXPECT_CALL(*router_.retry_state_, shouldHedge()).WillOnce(Return(true));
+  EXPECT_CALL(conn_pool2, newStream(_, _))
+      .WillOnce(Invoke([&](Http::StreamDecoder& decoder, Http::ConnectionPool::Callbacks& callbacks)
+                           -> Http::ConnectionPool::Cancellable* {
+                             response_decoder2 = &decoder;
+                             callbacks.onPoolReady(encoder2, conn_pool2.host_);
+                             return nullptr;
+                           }));
+  hedge_timer->callback_();
+
+  // The original request is reset. This is neither retried nor sent downstream since the hedge
+  // is still running.
+  EXPECT_CALL(cm_.conn_pool_.host_->outlier_detector_, putHttpResponseCode(503));
+  EXPECT_CALL(callbacks_, encodeHeaders_(_, _)).Times(0);
+  encoder1.stream_.resetStream(Http::StreamResetReason::RemoteReset);
+
+  EXPECT_CALL(conn_pool2.host_->outlier_detector_, putHttpResponseCode(200));
+  EXPECT_CALL(callbacks_, encodeHeaders_(_, true));
+  Http::HeaderMapPtr response_headers(new Http::TestHeaderMapImpl{{":status", "200"}});
+  response_decoder2->decodeHeaders(std::move(response_headers), true);
+  EXPECT_EQ(0U, cm_.thread_local_cluster_.cluster_.info_->stats_store_
+                    .counter("upstream_rq_hedge_win")
+                    .value());
+}
+
+TEST_F(RouterTest, HedgeSameHost) {
+  callbacks_.route_->route_entry_.retry_policy_.hedge_delay_ = std::chrono::milliseconds(5);
+  NiceMock<Http::MockStreamEncoder> encoder1;
+  Http::StreamDecoder* response_decoder = nullptr;
+  EXPECT_CALL(cm_.conn_pool_, newStream(_, _))
+      .WillOnce(Invoke([&](Http::StreamDecoder& decoder, Http::ConnectionPool::Callbacks& callbacks)
+                           -> Http::ConnectionPool::Cancellable* {
+                             response_decoder = &decoder;
+                             callbacks.onPoolReady(encoder1, cm_.conn_pool_.host_);
+                             return nullptr;
+                           }));
+  Event::MockTimer* hedge_timer = new Event::MockTimer(&callbacks_.dispatcher_);
+  EXPECT_CALL(*hedge_timer, enableTimer(_));
+  EXPECT_CALL(*hedge_timer, disableTimer());
+  expectResponseTimerCreate();
+
+  Http::TestHeaderMapImpl headers;
+  HttpTestUtility::addDefaultHeaders(headers);
+  router_.decodeHeaders(headers, true);
+
+  // The load balancer picks the same host again so the budget is left alone.
+  EXPECT_CALL(*router_.retry_state_, shouldHedge()).Times(0);
+  hedge_timer->callback_();
+
+  Http::HeaderMapPtr response_headers(new Http::TestHeaderMapImpl{{":status", "200"}});
+  EXPECT_CALL(cm_.conn_pool_.host_->outlier_detector_, putHttpResponseCode(200));
+  response_decoder->decodeHeaders(std::move(response_headers), true);
+}
+
 TEST_F(RouterTest, RetryTimeoutDuringRetryDelay) {
   NiceMock<Http::MockStreamEncoder> encoder1;
   Http::StreamDecoder* response_decoder = nullptr;
@@ -740,27 +1029,73 @@ TEST_F(RouterTest, Shadow) {
 
   EXPECT_CALL(runtime_.snapshot_, featureEnabled("bar", 0, 43, 10000)).WillOnce(Return(true));
 
+  // The shadow is started with the headers and the body is streamed to it, not buffered.
+  MockShadowStream shadow_stream;
+  EXPECT_CALL(*shadow_writer_, streamShadow_("foo", _, false, std::chrono::milliseconds(10)))
+      .WillOnce(Return(&shadow_stream));
   Http::TestHeaderMapImpl headers;
   HttpTestUtility::addDefaultHeaders(headers);
   router_.decodeHeaders(headers, false);
 
-  Buffer::InstancePtr body_data(new Buffer::OwnedImpl("hello"));
-  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer, router_.decodeData(*body_data, false));
+  Buffer::OwnedImpl body_data("hello");
+  EXPECT_CALL(shadow_stream, sendData(BufferStringEqual("hello"), false));
+  EXPECT_EQ(Http::FilterDataStatus::StopIterationNoBuffer, router_.decodeData(body_data, false));
 
   Http::TestHeaderMapImpl trailers{{"some", "trailer"}};
-  EXPECT_CALL(callbacks_, decodingBuffer())
-      .Times(AtLeast(1))
-      .WillRepeatedly(Return(body_data.get()));
-  EXPECT_CALL(*shadow_writer_, shadow_("foo", _, std::chrono::milliseconds(10)))
-      .WillOnce(Invoke([](const std::string&, Http::MessagePtr& request, std::chrono::milliseconds)
-                           -> void {
-                             EXPECT_NE(nullptr, request->body());
-                             EXPECT_NE(nullptr, request->trailers());
-                           }));
+  EXPECT_CALL(shadow_stream, sendTrailers(HeaderMapEqualRef(&trailers)));
   router_.decodeTrailers(trailers);
 
+  // The handle is released once the request has ended.
+  EXPECT_CALL(shadow_stream, cancel()).Times(0);
   Http::HeaderMapPtr response_headers(new Http::TestHeaderMapImpl{{":status", "200"}});
   response_decoder->decodeHeaders(std::move(response_headers), true);
+  router_.onDestroy();
+}
+
+TEST_F(RouterTest, ShadowHeaderOnly) {
+  callbacks_.route_->route_entry_.shadow_policy_.cluster_ = "foo";
+
+  NiceMock<Http::MockStreamEncoder> encoder;
+  EXPECT_CALL(cm_.conn_pool_, newStream(_, _))
+      .WillOnce(Invoke([&](Http::StreamDecoder&, Http::ConnectionPool::Callbacks& callbacks)
+                           -> Http::ConnectionPool::Cancellable* {
+                             callbacks.onPoolReady(encoder, cm_.conn_pool_.host_);
+                             return nullptr;
+                           }));
+  expectResponseTimerCreate();
+
+  EXPECT_CALL(*shadow_writer_, streamShadow_("foo", _, true, std::chrono::milliseconds(10)))
+      .WillOnce(Return(nullptr));
+  Http::TestHeaderMapImpl headers;
+  HttpTestUtility::addDefaultHeaders(headers);
+  router_.decodeHeaders(headers, true);
+
+  EXPECT_CALL(encoder.stream_, resetStream(Http::StreamResetReason::LocalReset));
+  router_.onDestroy();
+}
+
+TEST_F(RouterTest, ShadowCancelledOnReset) {
+  callbacks_.route_->route_entry_.shadow_policy_.cluster_ = "foo";
+
+  NiceMock<Http::MockStreamEncoder> encoder;
+  EXPECT_CALL(cm_.conn_pool_, newStream(_, _))
+      .WillOnce(Invoke([&](Http::StreamDecoder&, Http::ConnectionPool::Callbacks& callbacks)
+                           -> Http::ConnectionPool::Cancellable* {
+                             callbacks.onPoolReady(encoder, cm_.conn_pool_.host_);
+                             return nullptr;
+                           }));
+
+  MockShadowStream shadow_stream;
+  EXPECT_CALL(*shadow_writer_, streamShadow_("foo", _, false, std::chrono::milliseconds(10)))
+      .WillOnce(Return(&shadow_stream));
+  Http::TestHeaderMapImpl headers;
+  HttpTestUtility::addDefaultHeaders(headers);
+  router_.decodeHeaders(headers, false);
+
+  // The downstream request goes away before it has ended.
+  EXPECT_CALL(shadow_stream, cancel());
+  EXPECT_CALL(encoder.stream_, resetStream(Http::StreamResetReason::LocalReset));
+  router_.onDestroy();
 }
 
 TEST_F(RouterTest, AltStatName) {
@@ -1087,5 +1422,234 @@ TEST_F(RouterTest, AutoHostRewriteDisabled) {
   router_.decodeHeaders(incoming_headers, true);
 }
 
+TEST(RequestCoalescerTest, Key) {
+  NiceMock<ThreadLocal::MockInstance> tls;
+  RequestCoalescer coalescer(tls, {Http::LowerCaseString("accept-encoding"),
+                                   Http::LowerCaseString("authorization")});
+
+  Http::TestHeaderMapImpl headers;
+  HttpTestUtility::addDefaultHeaders(headers);
+  const std::string key = coalescer.key(headers, "cluster");
+  EXPECT_FALSE(key.empty());
+  EXPECT_NE(key, coalescer.key(headers, "other_cluster"));
+
+  // Vary headers must match, and a missing header is different from an empty one.
+  headers.addViaCopy("accept-encoding", "");
+  const std::string empty_encoding_key = coalescer.key(headers, "cluster");
+  EXPECT_NE(key, empty_encoding_key);
+  headers.Path()->value(std::string("/other"));
+  EXPECT_NE(empty_encoding_key, coalescer.key(headers, "cluster"));
+
+  // Requests with credentials are only coalesced if the credentials must match.
+  headers.insertAuthorization().value(std::string("secret"));
+  EXPECT_FALSE(coalescer.key(headers, "cluster").empty());
+  headers.addViaCopy("cookie", "secret");
+  EXPECT_EQ("", coalescer.key(headers, "cluster"));
+
+  Http::TestHeaderMapImpl head_headers{{":method", "HEAD"}, {":authority", "host"}, {":path", "/"}};
+  EXPECT_FALSE(coalescer.key(head_headers, "cluster").empty());
+  Http::TestHeaderMapImpl post_headers{{":method", "POST"}, {":authority", "host"}, {":path", "/"}};
+  EXPECT_EQ("", coalescer.key(post_headers, "cluster"));
+}
+
+class RouterCoalescingTest : public testing::Test {
+public:
+  RouterCoalescingTest()
+      : config_("test.", local_info_, stats_store_, cm_, runtime_, random_,
+                ShadowWriterPtr{new MockShadowWriter()}, true,
+                RequestCoalescerPtr{new RequestCoalescer(tls_, {})}) {}
+
+  struct Request {
+    Request(FilterConfig& config) : router_(config) {
+      router_.setDecoderFilterCallbacks(callbacks_);
+      HttpTestUtility::addDefaultHeaders(headers_);
+    }
+
+    ~Request() { router_.onDestroy(); }
+
+    NiceMock<Http::MockStreamDecoderFilterCallbacks> callbacks_;
+    TestFilter router_;
+    Http::TestHeaderMapImpl headers_;
+  };
+
+  typedef std::unique_ptr<Request> RequestPtr;
+
+  // Expect the request to be sent upstream through the encoder.
+  void expectUpstreamRequest(Request& request, Http::MockStreamEncoder& encoder) {
+    new NiceMock<Event::MockTimer>(&request.callbacks_.dispatcher_);
+    Http::MockStreamEncoder* request_encoder = &encoder;
+    EXPECT_CALL(cm_.conn_pool_, newStream(_, _))
+        .WillOnce(Invoke([this, request_encoder](Http::StreamDecoder& decoder,
+                                                 Http::ConnectionPool::Callbacks& callbacks)
+                             -> Http::ConnectionPool::Cancellable* {
+                               response_decoder_ = &decoder;
+                               callbacks.onPoolReady(*request_encoder, cm_.conn_pool_.host_);
+                               return nullptr;
+                             }))
+        .RetiresOnSaturation();
+  }
+
+  RequestPtr startRequest() {
+    RequestPtr request(new Request(config_));
+    EXPECT_EQ(Http::FilterHeadersStatus::StopIteration,
+              request->router_.decodeHeaders(request->headers_, true));
+    return request;
+  }
+
+  RequestPtr startLeader(Http::MockStreamEncoder& encoder) {
+    RequestPtr request(new Request(config_));
+    expectUpstreamRequest(*request, encoder);
+    EXPECT_EQ(Http::FilterHeadersStatus::StopIteration,
+              request->router_.decodeHeaders(request->headers_, true));
+    return request;
+  }
+
+  Stats::IsolatedStoreImpl stats_store_;
+  NiceMock<Upstream::MockClusterManager> cm_;
+  NiceMock<Runtime::MockLoader> runtime_;
+  NiceMock<Runtime::MockRandomGenerator> random_;
+  NiceMock<LocalInfo::MockLocalInfo> local_info_;
+  NiceMock<ThreadLocal::MockInstance> tls_;
+  FilterConfig config_;
+  Http::StreamDecoder* response_decoder_{};
+};
+
+TEST_F(RouterCoalescingTest, ShareResponse) {
+  NiceMock<Http::MockStreamEncoder> encoder;
+  RequestPtr leader = startLeader(encoder);
+  Http::StreamDecoder* response_decoder = response_decoder_;
+  RequestPtr follower1 = startRequest();
+  RequestPtr follower2 = startRequest();
+  EXPECT_EQ(2U, stats_store_.counter("test.rq_coalesced").value());
+
+  // A request with a body is sent upstream itself.
+  NiceMock<Http::MockStreamEncoder> other_encoder;
+  Request other(config_);
+  expectUpstreamRequest(other, other_encoder);
+  other.router_.decodeHeaders(other.headers_, false);
+
+  // Every request gets the response, and the body is not copied for each of them.
+  const void* data[3];
+  const void** request_data = data;
+  Http::TestHeaderMapImpl trailers{{"some", "trailer"}};
+  for (Request* request : {leader.get(), follower1.get(), follower2.get()}) {
+    EXPECT_CALL(request->callbacks_, encodeHeaders_(_, false))
+        .WillOnce(Invoke([](Http::HeaderMap& headers, bool) -> void {
+          EXPECT_STREQ("200", headers.Status()->value().c_str());
+        }));
+    EXPECT_CALL(request->callbacks_, encodeData(BufferStringEqual("hello"), false))
+        .WillOnce(Invoke([request_data](Buffer::Instance& body, bool) -> void {
+          Buffer::RawSlice slice;
+          EXPECT_EQ(1U, body.getRawSlices(&slice, 1));
+          *request_data = slice.mem_;
+        }));
+    EXPECT_CALL(request->callbacks_, encodeTrailers_(HeaderMapEqualRef(&trailers)));
+    request_data++;
+  }
+
+  response_decoder->decodeHeaders(
+      Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "200"}}}, false);
+  Buffer::OwnedImpl body("hello");
+  response_decoder->decodeData(body, false);
+  response_decoder->decodeTrailers(
+      Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{"some", "trailer"}}});
+  EXPECT_EQ(data[0], data[1]);
+  EXPECT_EQ(data[0], data[2]);
+
+  // Requests that arrive once the response has started are sent upstream.
+  NiceMock<Http::MockStreamEncoder> late_encoder;
+  RequestPtr late = startLeader(late_encoder);
+  EXPECT_EQ(2U, stats_store_.counter("test.rq_coalesced").value());
+}
+
+TEST_F(RouterCoalescingTest, FollowerDestroyed) {
+  NiceMock<Http::MockStreamEncoder> encoder;
+  RequestPtr leader = startLeader(encoder);
+  Http::StreamDecoder* response_decoder = response_decoder_;
+  RequestPtr follower1 = startRequest();
+  RequestPtr follower2 = startRequest();
+  RequestPtr follower3 = startRequest();
+
+  follower1->router_.onDestroy();
+  EXPECT_CALL(follower1->callbacks_, encodeHeaders_(_, _)).Times(0);
+
+  // A follower can be destroyed while the response is sent to another one.
+  EXPECT_CALL(follower2->callbacks_, encodeHeaders_(_, false))
+      .WillOnce(Invoke([&](Http::HeaderMap&, bool) -> void { follower3->router_.onDestroy(); }));
+  EXPECT_CALL(follower3->callbacks_, encodeHeaders_(_, _)).Times(0);
+  EXPECT_CALL(leader->callbacks_, encodeHeaders_(_, false));
+  response_decoder->decodeHeaders(
+      Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "200"}}}, false);
+
+  EXPECT_CALL(follower2->callbacks_, encodeData(BufferStringEqual("hello"), true));
+  EXPECT_CALL(leader->callbacks_, encodeData(BufferStringEqual("hello"), true));
+  Buffer::OwnedImpl body("hello");
+  response_decoder->decodeData(body, true);
+}
+
+TEST_F(RouterCoalescingTest, UpstreamFailure) {
+  NiceMock<Http::MockStreamEncoder> encoder;
+  RequestPtr leader = startLeader(encoder);
+  RequestPtr follower = startRequest();
+
+  // The followers get the same failure as the leader.
+  for (Request* request : {leader.get(), follower.get()}) {
+    EXPECT_CALL(request->callbacks_.request_info_,
+                setResponseFlag(Http::AccessLog::ResponseFlag::UpstreamRemoteReset));
+    EXPECT_CALL(request->callbacks_, encodeHeaders_(_, false))
+        .WillOnce(Invoke([](Http::HeaderMap& headers, bool) -> void {
+          EXPECT_STREQ("503", headers.Status()->value().c_str());
+        }));
+  }
+  encoder.stream_.resetStream(Http::StreamResetReason::RemoteReset);
+
+  NiceMock<Http::MockStreamEncoder> next_encoder;
+  RequestPtr next = startLeader(next_encoder);
+}
+
+TEST_F(RouterCoalescingTest, UpstreamResetAfterResponseStarted) {
+  NiceMock<Http::MockStreamEncoder> encoder;
+  RequestPtr leader = startLeader(encoder);
+  Http::StreamDecoder* response_decoder = response_decoder_;
+  RequestPtr follower = startRequest();
+
+  response_decoder->decodeHeaders(
+      Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "200"}}}, false);
+  EXPECT_CALL(leader->callbacks_, resetStream());
+  EXPECT_CALL(follower->callbacks_, resetStream());
+  encoder.stream_.resetStream(Http::StreamResetReason::RemoteReset);
+}
+
+TEST_F(RouterCoalescingTest, LeaderDestroyed) {
+  NiceMock<Http::MockStreamEncoder> encoder;
+  RequestPtr leader = startLeader(encoder);
+  RequestPtr follower1 = startRequest();
+  RequestPtr follower2 = startRequest();
+
+  // The first follower is sent upstream instead, on behalf of the other one.
+  NiceMock<Http::MockStreamEncoder> follower_encoder;
+  expectUpstreamRequest(*follower1, follower_encoder);
+  EXPECT_CALL(encoder.stream_, resetStream(Http::StreamResetReason::LocalReset));
+  leader->router_.onDestroy();
+  EXPECT_EQ(3U, stats_store_.counter("test.rq_coalesced").value());
+
+  EXPECT_CALL(follower1->callbacks_, encodeHeaders_(_, true));
+  EXPECT_CALL(follower2->callbacks_, encodeHeaders_(_, true));
+  response_decoder_->decodeHeaders(
+      Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "200"}}}, true);
+}
+
+TEST_F(RouterCoalescingTest, LeaderDestroyedAfterResponseStarted) {
+  NiceMock<Http::MockStreamEncoder> encoder;
+  RequestPtr leader = startLeader(encoder);
+  Http::StreamDecoder* response_decoder = response_decoder_;
+  RequestPtr follower = startRequest();
+
+  response_decoder->decodeHeaders(
+      Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "200"}}}, false);
+  EXPECT_CALL(follower->callbacks_, resetStream());
+  leader->router_.onDestroy();
+}
+
 } // Router
 } // Envoy
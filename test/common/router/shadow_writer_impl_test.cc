@@ -1,11 +1,15 @@
 #include <chrono>
 #include <string>
 
+#include "common/buffer/buffer_impl.h"
 #include "common/http/headers.h"
 #include "common/http/message_impl.h"
 #include "common/router/shadow_writer_impl.h"
 
+#include "test/mocks/buffer/mocks.h"
+#include "test/mocks/http/mocks.h"
 #include "test/mocks/upstream/mocks.h"
+#include "test/test_common/utility.h"
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -13,6 +17,7 @@
 namespace Envoy {
 using testing::_;
 using testing::Invoke;
+using testing::Return;
 
 namespace Router {
 
@@ -59,5 +64,107 @@ TEST(ShadowWriterImplTest, All) {
   callback->onFailure(Http::AsyncClient::FailureReason::Reset);
 }
 
+class ShadowWriterImplStreamTest : public testing::Test {
+public:
+  ShadowStream* start(bool end_stream) {
+    Http::HeaderMapPtr headers(new Http::TestHeaderMapImpl{{":authority", "cluster1"}});
+    EXPECT_CALL(cm_, get("foo"));
+    EXPECT_CALL(cm_, httpAsyncClientForCluster("foo"));
+    EXPECT_CALL(cm_.async_client_,
+                start(_, Optional<std::chrono::milliseconds>(std::chrono::milliseconds(5))))
+        .WillOnce(Invoke([&](Http::AsyncClient::StreamCallbacks& callbacks,
+                             const Optional<std::chrono::milliseconds>&)
+                             -> Http::AsyncClient::Stream* {
+                               callbacks_ = &callbacks;
+                               return &stream_;
+                             }));
+    EXPECT_CALL(stream_, sendHeaders(_, end_stream))
+        .WillOnce(Invoke([](Http::HeaderMap& headers, bool) -> void {
+          EXPECT_STREQ("cluster1-shadow", headers.Host()->value().c_str());
+        }));
+    return writer_.streamShadow("foo", std::move(headers), end_stream,
+                                std::chrono::milliseconds(5));
+  }
+
+  uint64_t droppedCount() {
+    return cm_.thread_local_cluster_.cluster_.info_->stats_store_
+        .counter("upstream_rq_shadow_dropped")
+        .value();
+  }
+
+  Upstream::MockClusterManager cm_;
+  ShadowWriterImpl writer_{cm_};
+  Http::MockAsyncClientStream stream_;
+  Http::AsyncClient::StreamCallbacks* callbacks_{};
+};
+
+TEST_F(ShadowWriterImplStreamTest, HeaderOnly) {
+  EXPECT_EQ(nullptr, start(true));
+  callbacks_->onHeaders(Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "200"}}}, true);
+}
+
+TEST_F(ShadowWriterImplStreamTest, StreamBodyAndTrailers) {
+  ShadowStream* shadow_stream = start(false);
+  ASSERT_NE(nullptr, shadow_stream);
+
+  Buffer::OwnedImpl data("hello");
+  EXPECT_CALL(stream_, sendData(BufferStringEqual("hello"), false));
+  shadow_stream->sendData(data, false);
+  EXPECT_EQ(5U, data.length());
+
+  Http::TestHeaderMapImpl trailers{{"some", "trailer"}};
+  EXPECT_CALL(stream_, sendTrailers(HeaderMapEqualRef(&trailers)));
+  shadow_stream->sendTrailers(trailers);
+
+  callbacks_->onHeaders(Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "200"}}},
+                        false);
+  callbacks_->onTrailers(Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{"grpc-status", "0"}}});
+  EXPECT_EQ(0U, droppedCount());
+}
+
+TEST_F(ShadowWriterImplStreamTest, DroppedAboveHighWatermark) {
+  ShadowStream* shadow_stream = start(false);
+
+  Buffer::OwnedImpl data("hello");
+  EXPECT_CALL(stream_, isAboveWriteBufferHighWatermark()).WillOnce(Return(true));
+  EXPECT_CALL(stream_, sendData(_, _)).Times(0);
+  EXPECT_CALL(stream_, reset()).WillOnce(Invoke([&]() -> void { callbacks_->onReset(); }));
+  shadow_stream->sendData(data, false);
+  EXPECT_EQ(1U, droppedCount());
+
+  // The rest of the request is ignored.
+  shadow_stream->sendData(data, true);
+  EXPECT_EQ(1U, droppedCount());
+}
+
+TEST_F(ShadowWriterImplStreamTest, EarlyResponse) {
+  ShadowStream* shadow_stream = start(false);
+  callbacks_->onHeaders(Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "503"}}},
+                        true);
+
+  // Nobody needs the rest of the request once the response is complete.
+  Buffer::OwnedImpl data("hello");
+  EXPECT_CALL(stream_, sendData(_, _)).Times(0);
+  EXPECT_CALL(stream_, reset()).WillOnce(Invoke([&]() -> void { callbacks_->onReset(); }));
+  shadow_stream->sendData(data, true);
+  EXPECT_EQ(0U, droppedCount());
+}
+
+TEST_F(ShadowWriterImplStreamTest, Cancel) {
+  ShadowStream* shadow_stream = start(false);
+  EXPECT_CALL(stream_, reset()).WillOnce(Invoke([&]() -> void { callbacks_->onReset(); }));
+  shadow_stream->cancel();
+}
+
+TEST_F(ShadowWriterImplStreamTest, ResetByUpstream) {
+  ShadowStream* shadow_stream = start(false);
+  callbacks_->onReset();
+
+  Buffer::OwnedImpl data("hello");
+  EXPECT_CALL(stream_, sendData(_, _)).Times(0);
+  shadow_stream->sendData(data, false);
+  shadow_stream->cancel();
+}
+
 } // Router
 } // Envoy
@@ -0,0 +1,70 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "common/runtime/runtime_impl.h"
+
+#include "gtest/gtest.h"
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+namespace Runtime {
+
+/**
+ * This test is for benchmarking only and should not be run as part of unit tests. It compares the
+ * per thread generator against the std::ranlux48 it replaced, and UUID generation against reading
+ * /proc/sys/kernel/random/uuid as was done before.
+ */
+class DISABLED_RandomBenchmark : public testing::Test {
+public:
+  static const uint32_t NumIterations = 10000000;
+  static const uint32_t NumUuids = 1000000;
+
+  template <class Function> void measure(const std::string& name, uint32_t iterations, Function f) {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+      f();
+    }
+    const std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << fmt::format("{}: {} iterations in {}ms, {}ns each", name, iterations,
+                             elapsed.count() / 1000000, elapsed.count() / iterations)
+              << std::endl;
+  }
+
+  // Keeps the compiler from discarding the generated numbers.
+  uint64_t sink_{};
+};
+
+TEST_F(DISABLED_RandomBenchmark, Random) {
+  std::ranlux48 ranlux(std::random_device{}());
+  measure("ranlux48", NumIterations, [&]() -> void { sink_ += ranlux(); });
+
+  RandomGeneratorImpl random;
+  measure("RandomGeneratorImpl::random", NumIterations, [&]() -> void { sink_ += random.random(); });
+
+  std::cout << sink_ << std::endl;
+}
+
+TEST_F(DISABLED_RandomBenchmark, Uuid) {
+  measure("/proc/sys/kernel/random/uuid", NumUuids, [&]() -> void {
+    char uuid[RandomGeneratorImpl::UUID_LENGTH];
+    int fd = open("/proc/sys/kernel/random/uuid", O_RDONLY);
+    ASSERT_NE(-1, fd);
+    ASSERT_EQ(static_cast<ssize_t>(sizeof(uuid)), read(fd, uuid, sizeof(uuid)));
+    close(fd);
+    sink_ += uuid[0];
+  });
+
+  RandomGeneratorImpl random;
+  measure("RandomGeneratorImpl::uuid", NumUuids, [&]() -> void { sink_ += random.uuid()[0]; });
+
+  std::cout << sink_ << std::endl;
+}
+
+} // Runtime
+} // Envoy
@@ -1,6 +1,12 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <fstream>
 #include <memory>
 #include <string>
+#include <vector>
 
+#include "common/runtime/key_registry.h"
 #include "common/runtime/runtime_impl.h"
 #include "common/stats/stats_impl.h"
 
@@ -14,9 +20,12 @@
 #include "gtest/gtest.h"
 
 namespace Envoy {
+using testing::Invoke;
 using testing::NiceMock;
 using testing::Return;
 using testing::ReturnNew;
+using testing::SaveArg;
+using testing::_;
 
 namespace Runtime {
 
@@ -29,6 +38,21 @@ TEST(UUID, checkLengthOfUUID) {
   EXPECT_EQ(expected_length, result.length());
 }
 
+TEST(UUID, versionAndVariant) {
+  RandomGeneratorImpl random;
+
+  for (size_t i = 0; i < 1000; ++i) {
+    std::string result = random.uuid();
+    EXPECT_EQ('-', result[8]);
+    EXPECT_EQ('-', result[13]);
+    EXPECT_EQ('-', result[18]);
+    EXPECT_EQ('-', result[23]);
+    EXPECT_EQ('4', result[14]);
+    EXPECT_NE(std::string::npos, std::string("89ab").find(result[19]));
+    EXPECT_EQ(std::string::npos, result.find_first_not_of("0123456789abcdef-"));
+  }
+}
+
 TEST(UUID, sanityCheckOfUniqueness) {
   std::set<std::string> uuids;
   const size_t num_of_uuids = 100000;
@@ -94,6 +118,104 @@ TEST_F(RuntimeImplTest, All) {
 
   // Overrides from override dir
   EXPECT_EQ("hello override", loader->snapshot().get("file1"));
+
+  // Every snapshot has its own non zero generation.
+  const uint64_t generation = loader->snapshot().generation();
+  EXPECT_NE(0UL, generation);
+  setup("test/common/runtime/test_data/current", "envoy_override");
+  EXPECT_NE(0UL, loader->snapshot().generation());
+  EXPECT_NE(generation, loader->snapshot().generation());
+}
+
+TEST_F(RuntimeImplTest, RegisteredKeys) {
+  const Key file1 = KeyRegistry::registerKey("file1");
+  const Key file3 = KeyRegistry::registerKey("file3");
+  const Key invalid = KeyRegistry::registerKey("invalid");
+  setup("test/common/runtime/test_data/current", "envoy_override");
+
+  // Keys registered after the snapshot was loaded are looked up by name.
+  const Key file4 = KeyRegistry::registerKey("file4");
+
+  // Integer getting. file1 is overridden with a value that is not an integer.
+  EXPECT_EQ(1UL, loader->snapshot().getInteger(file1, 1));
+  EXPECT_EQ(2UL, loader->snapshot().getInteger(file3, 1));
+  EXPECT_EQ(123UL, loader->snapshot().getInteger(file4, 1));
+  EXPECT_EQ(5UL, loader->snapshot().getInteger(invalid, 5));
+
+  // Feature enablement.
+  EXPECT_CALL(generator, random()).WillOnce(Return(1));
+  EXPECT_TRUE(loader->snapshot().featureEnabled(file3, 1));
+
+  EXPECT_CALL(generator, random()).WillOnce(Return(2));
+  EXPECT_FALSE(loader->snapshot().featureEnabled(file3, 1));
+
+  EXPECT_TRUE(loader->snapshot().featureEnabled(file3, 1, 1));
+  EXPECT_FALSE(loader->snapshot().featureEnabled(file3, 1, 3));
+  EXPECT_FALSE(loader->snapshot().featureEnabled(file4, 1, 200, 300));
+  EXPECT_TRUE(loader->snapshot().featureEnabled(file4, 1, 122, 300));
+
+  // A later snapshot indexes the late key too.
+  setup("test/common/runtime/test_data/current", "envoy_override");
+  EXPECT_EQ(123UL, loader->snapshot().getInteger(file4, 1));
+}
+
+TEST(KeyRegistryTest, DenseIndexes) {
+  const Key first = KeyRegistry::registerKey("key_registry_test.first");
+  const Key second = KeyRegistry::registerKey("key_registry_test.second");
+  EXPECT_EQ("key_registry_test.first", first.name());
+  EXPECT_EQ(first.index() + 1, second.index());
+  EXPECT_EQ(first.index(), KeyRegistry::registerKey("key_registry_test.first").index());
+
+  const std::vector<std::string> keys = KeyRegistry::keys();
+  ASSERT_LT(second.index(), keys.size());
+  EXPECT_EQ("key_registry_test.first", keys[first.index()]);
+  EXPECT_EQ("key_registry_test.second", keys[second.index()]);
+}
+
+TEST_F(RuntimeImplTest, ReloadOnlyReadsChangedFiles) {
+  const std::string root = TestEnvironment::temporaryPath("runtime_reload");
+  TestEnvironment::exec({"rm", "-rf", root});
+  TestEnvironment::exec({"mkdir", "-p", root + "/v1/envoy"});
+  TestEnvironment::exec({"ln", "-s", root + "/v1", root + "/current"});
+  const auto write_file = [&root](const std::string& name, const std::string& value) -> void {
+    std::ofstream file(root + "/v1/envoy/" + name);
+    file << value;
+  };
+  write_file("unchanged", "10");
+  write_file("changed", "20");
+  write_file("removed", "30");
+
+  Filesystem::Watcher::OnChangedCb on_symlink_swap;
+  EXPECT_CALL(dispatcher, createFilesystemWatcher_())
+      .WillOnce(Invoke([&on_symlink_swap]() -> Filesystem::Watcher* {
+        Filesystem::MockWatcher* watcher = new Filesystem::MockWatcher();
+        EXPECT_CALL(*watcher, addWatch(_, Filesystem::Watcher::Events::MovedTo, _))
+            .WillOnce(SaveArg<2>(&on_symlink_swap));
+        return watcher;
+      }));
+  loader.reset(new LoaderImpl(dispatcher, tls, root + "/current", "envoy", "envoy_override", store,
+                              generator));
+  EXPECT_EQ(10UL, loader->snapshot().getInteger("unchanged", 1));
+  EXPECT_EQ(20UL, loader->snapshot().getInteger("changed", 1));
+  EXPECT_EQ(30UL, loader->snapshot().getInteger("removed", 1));
+
+  // Rewrite the unchanged file without changing its size or modification time. The new contents
+  // are not read, which shows that the value is taken from the previous snapshot.
+  struct stat info;
+  ASSERT_EQ(0, stat((root + "/v1/envoy/unchanged").c_str(), &info));
+  write_file("unchanged", "11");
+  const timespec times[2] = {info.st_atim, info.st_mtim};
+  ASSERT_EQ(0, utimensat(AT_FDCWD, (root + "/v1/envoy/unchanged").c_str(), times, 0));
+  write_file("changed", "200");
+  TestEnvironment::exec({"rm", root + "/v1/envoy/removed"});
+  write_file("added", "40");
+
+  on_symlink_swap(Filesystem::Watcher::Events::MovedTo);
+  EXPECT_EQ(10UL, loader->snapshot().getInteger("unchanged", 1));
+  EXPECT_EQ(200UL, loader->snapshot().getInteger("changed", 1));
+  EXPECT_EQ(1UL, loader->snapshot().getInteger("removed", 1));
+  EXPECT_EQ(40UL, loader->snapshot().getInteger("added", 1));
+  EXPECT_EQ(3UL, store.gauge("runtime.num_keys").value());
 }
 
 TEST_F(RuntimeImplTest, BadDirectory) { setup("/baddir", "/baddir"); }
@@ -111,6 +233,8 @@ TEST(NullRuntimeImplTest, All) {
   EXPECT_EQ(1UL, loader.snapshot().getInteger("foo", 1));
   EXPECT_CALL(generator, random()).WillOnce(Return(49));
   EXPECT_TRUE(loader.snapshot().featureEnabled("foo", 50));
+  EXPECT_EQ(1UL, loader.snapshot().getInteger(KeyRegistry::registerKey("foo"), 1));
+  EXPECT_EQ(0UL, loader.snapshot().generation());
 }
 
 } // Runtime
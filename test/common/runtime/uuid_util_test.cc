@@ -18,6 +18,9 @@ TEST(UUIDUtilsTest, mod) {
   EXPECT_EQ(15, result);
 
   EXPECT_FALSE(UuidUtils::uuidModBy("", result, 100));
+  EXPECT_FALSE(UuidUtils::uuidModBy("0000000", result, 100));
+  EXPECT_FALSE(UuidUtils::uuidModBy("0000000g-0000-0000-0000-000000000000", result, 100));
+  EXPECT_FALSE(UuidUtils::uuidModBy("-0000001-0000-0000-0000-000000000000", result, 100));
 
   EXPECT_TRUE(UuidUtils::uuidModBy("000000ff-0000-0000-0000-000000000000", result, 100));
   EXPECT_EQ(55, result);
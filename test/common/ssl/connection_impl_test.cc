@@ -1,4 +1,5 @@
 #include <cstdint>
+#include <fstream>
 #include <memory>
 #include <string>
 
@@ -167,6 +168,123 @@ TEST_P(SslConnectionImplTest, NoCert) {
   testUtil(client_ctx_json, server_ctx_json, "", "", GetParam());
 }
 
+TEST_P(SslConnectionImplTest, PrivateKeyOffload) {
+  std::string client_ctx_json = R"EOF(
+  {
+    "cert_chain_file": "{{ test_rundir }}/test/common/ssl/test_data/no_san_cert.pem",
+    "private_key_file": "{{ test_rundir }}/test/common/ssl/test_data/no_san_key.pem"
+  }
+  )EOF";
+
+  std::string server_ctx_json = R"EOF(
+  {
+    "cert_chain_file": "{{ test_tmpdir }}/unittestcert.pem",
+    "private_key_file": "{{ test_tmpdir }}/unittestkey.pem",
+    "ca_cert_file": "{{ test_rundir }}/test/common/ssl/test_data/ca_cert.pem",
+    "private_key_offload_threads": 2
+  }
+  )EOF";
+
+  testUtil(client_ctx_json, server_ctx_json,
+           "9d51ffbe193020e88ac2eb9072315e2e8bb3dac589041995b2af80ec7cb86de2", "", GetParam());
+}
+
+TEST_P(SslConnectionImplTest, KernelTlsTx) {
+  std::string client_ctx_json = R"EOF(
+  {
+    "cert_chain_file": "{{ test_rundir }}/test/common/ssl/test_data/no_san_cert.pem",
+    "private_key_file": "{{ test_rundir }}/test/common/ssl/test_data/no_san_key.pem"
+  }
+  )EOF";
+
+  std::string server_ctx_json = R"EOF(
+  {
+    "cert_chain_file": "{{ test_tmpdir }}/unittestcert.pem",
+    "private_key_file": "{{ test_tmpdir }}/unittestkey.pem",
+    "ca_cert_file": "{{ test_rundir }}/test/common/ssl/test_data/ca_cert.pem",
+    "kernel_tls_tx": true
+  }
+  )EOF";
+
+  // Kernels without kTLS fall back to SSL_write() so this passes everywhere.
+  testUtil(client_ctx_json, server_ctx_json,
+           "9d51ffbe193020e88ac2eb9072315e2e8bb3dac589041995b2af80ec7cb86de2", "", GetParam());
+}
+
+TEST_P(SslConnectionImplTest, SniCertificateSelection) {
+  Stats::IsolatedStoreImpl stats_store;
+  Runtime::MockLoader runtime;
+
+  std::string server_ctx_json = R"EOF(
+  {
+    "cert_chain_file": "{{ test_rundir }}/test/common/ssl/test_data/no_san_cert.pem",
+    "private_key_file": "{{ test_rundir }}/test/common/ssl/test_data/no_san_key.pem",
+    "sni_certificates": [
+      {
+        "cert_chain_file": "{{ test_rundir }}/test/common/ssl/test_data/san_dns_cert.pem",
+        "private_key_file": "{{ test_rundir }}/test/common/ssl/test_data/san_dns_key.pem"
+      },
+      {
+        "cert_chain_file": "{{ test_rundir }}/test/common/ssl/test_data/san_wildcard_dns_cert.pem",
+        "private_key_file": "{{ test_rundir }}/test/common/ssl/test_data/san_wildcard_dns_key.pem"
+      }
+    ]
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr server_ctx_loader = TestEnvironment::jsonLoadFromString(server_ctx_json);
+  ContextConfigImpl server_ctx_config(*server_ctx_loader);
+  ContextManagerImpl manager(runtime);
+  ServerContextPtr server_ctx(manager.createSslServerContext(stats_store, server_ctx_config));
+
+  Event::DispatcherImpl dispatcher;
+  Network::TcpListenSocket socket(Network::Test::getCanonicalLoopbackAddress(GetParam()), true);
+  Network::MockListenerCallbacks callbacks;
+  Network::MockConnectionHandler connection_handler;
+  Network::ListenerPtr listener =
+      dispatcher.createSslListener(connection_handler, *server_ctx, socket, callbacks, stats_store,
+                                   Network::ListenerOptions::listenerOptionsWithBindToPort());
+
+  // Connect with a server name and check the digest of the certificate that the server selected.
+  auto expectCertificate = [&](const std::string& sni, const std::string& expected_digest) {
+    Json::ObjectSharedPtr client_ctx_loader =
+        Json::Factory::loadFromString(fmt::format(R"EOF({{"sni": "{}"}})EOF", sni));
+    ContextConfigImpl client_ctx_config(*client_ctx_loader);
+    ClientContextPtr client_ctx(manager.createSslClientContext(stats_store, client_ctx_config));
+    Network::ClientConnectionPtr client_connection =
+        dispatcher.createSslClientConnection(*client_ctx, socket.localAddress());
+    Network::MockConnectionCallbacks client_connection_callbacks;
+    client_connection->addConnectionCallbacks(client_connection_callbacks);
+    client_connection->connect();
+
+    Network::ConnectionPtr server_connection;
+    EXPECT_CALL(callbacks, onNewConnection_(_))
+        .WillOnce(Invoke([&](Network::ConnectionPtr& conn) -> void {
+          server_connection = std::move(conn);
+        }));
+
+    EXPECT_CALL(client_connection_callbacks, onEvent(Network::ConnectionEvent::Connected))
+        .WillOnce(Invoke([&](uint32_t) -> void {
+          EXPECT_EQ(expected_digest, client_connection->ssl()->sha256PeerCertificateDigest());
+          client_connection->close(Network::ConnectionCloseType::NoFlush);
+          dispatcher.exit();
+        }));
+    EXPECT_CALL(client_connection_callbacks, onEvent(Network::ConnectionEvent::LocalClose));
+
+    dispatcher.run(Event::Dispatcher::RunType::Block);
+    server_connection->close(Network::ConnectionCloseType::NoFlush);
+  };
+
+  const std::string no_san_digest =
+      "9d51ffbe193020e88ac2eb9072315e2e8bb3dac589041995b2af80ec7cb86de2";
+  expectCertificate("server1.example.com",
+                    "e9c3f2cc9b887fe286380e294a1c4e939b25295a54436ef913a9190d7a6ae2f7");
+  expectCertificate("WWW.example.com",
+                    "1f2f3d937bd2c5c0141df3ba5b44154c18a27714243cd28375488fb82a3856c4");
+  expectCertificate("unknown.example.org", no_san_digest);
+  expectCertificate("", no_san_digest);
+}
+
 TEST_P(SslConnectionImplTest, ClientAuthBadVerification) {
   Stats::IsolatedStoreImpl stats_store;
   Runtime::MockLoader runtime;
@@ -224,6 +342,76 @@ TEST_P(SslConnectionImplTest, ClientAuthBadVerification) {
   dispatcher.run(Event::Dispatcher::RunType::Block);
 }
 
+TEST_P(SslConnectionImplTest, SessionResumption) {
+  Stats::IsolatedStoreImpl stats_store;
+  Runtime::MockLoader runtime;
+
+  {
+    std::ofstream key_file(TestEnvironment::temporaryPath("ticket_key_a"), std::ios::binary);
+    key_file << std::string(80, 'a');
+  }
+
+  std::string server_ctx_json = R"EOF(
+  {
+    "cert_chain_file": "{{ test_tmpdir }}/unittestcert.pem",
+    "private_key_file": "{{ test_tmpdir }}/unittestkey.pem",
+    "session_ticket_key_paths": ["{{ test_tmpdir }}/ticket_key_a"]
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr server_ctx_loader = TestEnvironment::jsonLoadFromString(server_ctx_json);
+  ContextConfigImpl server_ctx_config(*server_ctx_loader);
+  ContextManagerImpl manager(runtime);
+  ServerContextPtr server_ctx(manager.createSslServerContext(stats_store, server_ctx_config));
+
+  Event::DispatcherImpl dispatcher;
+  Network::TcpListenSocket socket(Network::Test::getCanonicalLoopbackAddress(GetParam()), true);
+  Network::MockListenerCallbacks callbacks;
+  Network::MockConnectionHandler connection_handler;
+  Network::ListenerPtr listener =
+      dispatcher.createSslListener(connection_handler, *server_ctx, socket, callbacks, stats_store,
+                                   Network::ListenerOptions::listenerOptionsWithBindToPort());
+
+  Json::ObjectSharedPtr client_ctx_loader = TestEnvironment::jsonLoadFromString("{}");
+  ContextConfigImpl client_ctx_config(*client_ctx_loader);
+  ClientContextPtr client_ctx(manager.createSslClientContext(stats_store, client_ctx_config));
+
+  // The second connection resumes the session the client context cached from the first one.
+  for (uint32_t i = 0; i < 2; i++) {
+    Network::ClientConnectionPtr client_connection =
+        dispatcher.createSslClientConnection(*client_ctx, socket.localAddress());
+    Network::MockConnectionCallbacks client_connection_callbacks;
+    client_connection->addConnectionCallbacks(client_connection_callbacks);
+    client_connection->connect();
+
+    Network::ConnectionPtr server_connection;
+    Network::MockConnectionCallbacks server_connection_callbacks;
+    EXPECT_CALL(callbacks, onNewConnection_(_))
+        .WillOnce(Invoke([&](Network::ConnectionPtr& conn) -> void {
+          server_connection = std::move(conn);
+          server_connection->addConnectionCallbacks(server_connection_callbacks);
+        }));
+
+    // Wait for both sides to finish the handshake so that the client has cached its session.
+    uint32_t connected = 0;
+    auto on_event = [&](uint32_t events) -> void {
+      if ((events & Network::ConnectionEvent::Connected) && ++connected == 2) {
+        server_connection->close(Network::ConnectionCloseType::NoFlush);
+        client_connection->close(Network::ConnectionCloseType::NoFlush);
+        dispatcher.exit();
+      }
+    };
+    EXPECT_CALL(server_connection_callbacks, onEvent(_)).WillRepeatedly(Invoke(on_event));
+    EXPECT_CALL(client_connection_callbacks, onEvent(_)).WillRepeatedly(Invoke(on_event));
+
+    dispatcher.run(Event::Dispatcher::RunType::Block);
+  }
+
+  // Both the client and the server count the resumed handshake.
+  EXPECT_EQ(4UL, stats_store.counter("ssl.handshake").value());
+  EXPECT_EQ(2UL, stats_store.counter("ssl.session_reused").value());
+}
+
 TEST_P(SslConnectionImplTest, SslError) {
   Stats::IsolatedStoreImpl stats_store;
   Runtime::MockLoader runtime;
@@ -304,7 +492,10 @@ public:
         {.bind_to_port_ = true,
          .use_proxy_proto_ = false,
          .use_original_dst_ = false,
-         .per_connection_buffer_limit_bytes_ = read_buffer_limit});
+         .per_connection_buffer_limit_bytes_ = read_buffer_limit,
+         .connection_balancer_ = nullptr,
+         .inspect_tls_client_hello_ = false,
+         .socket_options_ = nullptr});
 
     std::string client_ctx_json = R"EOF(
     {
@@ -1,3 +1,7 @@
+#include <unistd.h>
+
+#include <fstream>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -9,6 +13,7 @@
 #include "test/common/ssl/ssl_certs_test.h"
 #include "test/mocks/runtime/mocks.h"
 #include "test/test_common/environment.h"
+#include "test/test_common/utility.h"
 
 #include "gtest/gtest.h"
 
@@ -17,6 +22,46 @@ namespace Ssl {
 
 class SslContextImplTest : public SslCertsTest {};
 
+class SslServerContextStateTest : public SslCertsTest {
+public:
+  ServerContextPtr createContext(const std::string& json) {
+    Json::ObjectSharedPtr loader = TestEnvironment::jsonLoadFromString(json);
+    ContextConfigImpl cfg(*loader);
+    return manager_.createSslServerContext(store_, cfg);
+  }
+
+  static ServerContextStateSharedPtr state(ServerContextPtr& context) {
+    return dynamic_cast<ServerContextImpl&>(*context).state();
+  }
+
+  static void copyFile(const std::string& from, const std::string& to) {
+    std::ifstream in(from, std::ios::binary);
+    std::ofstream out(to, std::ios::binary);
+    out << in.rdbuf();
+  }
+
+  const std::string sni_json_{R"EOF(
+  {
+    "cert_chain_file": "{{ test_rundir }}/test/common/ssl/test_data/no_san_cert.pem",
+    "private_key_file": "{{ test_rundir }}/test/common/ssl/test_data/no_san_key.pem",
+    "sni_certificates": [
+      {
+        "cert_chain_file": "{{ test_rundir }}/test/common/ssl/test_data/san_dns_cert.pem",
+        "private_key_file": "{{ test_rundir }}/test/common/ssl/test_data/san_dns_key.pem"
+      },
+      {
+        "cert_chain_file": "{{ test_rundir }}/test/common/ssl/test_data/san_wildcard_dns_cert.pem",
+        "private_key_file": "{{ test_rundir }}/test/common/ssl/test_data/san_wildcard_dns_key.pem"
+      }
+    ]
+  }
+  )EOF"};
+
+  Runtime::MockLoader runtime_;
+  ContextManagerImpl manager_{runtime_};
+  Stats::IsolatedStoreImpl store_;
+};
+
 TEST_F(SslContextImplTest, TestdNSNameMatching) {
   EXPECT_TRUE(ContextImpl::dNSNameMatch("lyft.com", "lyft.com"));
   EXPECT_TRUE(ContextImpl::dNSNameMatch("a.lyft.com", "*.lyft.com"));
@@ -157,6 +202,31 @@ TEST_F(SslContextImplTest, TestGetCertInformation) {
               std::string::npos);
 }
 
+TEST_F(SslContextImplTest, TestSessionTicketKeyWrongSize) {
+  {
+    std::ofstream key_file(TestEnvironment::temporaryPath("short_ticket_key"), std::ios::binary);
+    key_file << std::string(48, 'a');
+  }
+
+  std::string json = R"EOF(
+  {
+    "cert_chain_file": "{{ test_tmpdir }}/unittestcert.pem",
+    "private_key_file": "{{ test_tmpdir }}/unittestkey.pem",
+    "session_ticket_key_paths": ["{{ test_tmpdir }}/short_ticket_key"]
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr loader = TestEnvironment::jsonLoadFromString(json);
+  ContextConfigImpl cfg(*loader);
+  Runtime::MockLoader runtime;
+  ContextManagerImpl manager(runtime);
+  Stats::IsolatedStoreImpl store;
+  EXPECT_THROW_WITH_MESSAGE(manager.createSslServerContext(store, cfg), EnvoyException,
+                            "Invalid session ticket key file '" +
+                                TestEnvironment::temporaryPath("short_ticket_key") +
+                                "': expected 80 bytes");
+}
+
 TEST_F(SslContextImplTest, TestNoCert) {
   Json::ObjectSharedPtr loader = TestEnvironment::jsonLoadFromString("{}");
   ContextConfigImpl cfg(*loader);
@@ -168,5 +238,102 @@ TEST_F(SslContextImplTest, TestNoCert) {
   EXPECT_EQ("", context->getCertChainInformation());
 }
 
+TEST_F(SslServerContextStateTest, FindCtx) {
+  ServerContextPtr context = createContext(sni_json_);
+  ServerContextStateSharedPtr state = this->state(context);
+
+  SSL_CTX* exact = state->findCtx("server1.example.com");
+  SSL_CTX* wildcard = state->findCtx("server2.example.com");
+  ASSERT_NE(nullptr, exact);
+  ASSERT_NE(nullptr, wildcard);
+  EXPECT_NE(exact, wildcard);
+
+  EXPECT_EQ(exact, state->findCtx("SERVER1.Example.com"));
+  EXPECT_EQ(wildcard, state->findCtx("WWW.EXAMPLE.COM"));
+
+  // A wildcard only covers a single label.
+  EXPECT_EQ(nullptr, state->findCtx("example.com"));
+  EXPECT_EQ(nullptr, state->findCtx("a.b.example.com"));
+  EXPECT_EQ(nullptr, state->findCtx("server1.example.org"));
+  EXPECT_EQ(nullptr, state->findCtx(""));
+
+  // The default certificate is only served for its common name.
+  EXPECT_NE(nullptr, state->findCtx("test client"));
+}
+
+TEST_F(SslServerContextStateTest, NoSniCertificates) {
+  ServerContextPtr context = createContext(R"EOF(
+  {
+    "cert_chain_file": "{{ test_rundir }}/test/common/ssl/test_data/san_dns_cert.pem",
+    "private_key_file": "{{ test_rundir }}/test/common/ssl/test_data/san_dns_key.pem"
+  }
+  )EOF");
+  ServerContextStateSharedPtr state = this->state(context);
+  EXPECT_NE(nullptr, state->findCtx("server1.example.com"));
+  EXPECT_EQ(nullptr, state->findCtx("server2.example.com"));
+}
+
+TEST_F(SslServerContextStateTest, SharedState) {
+  ServerContextPtr context1 = createContext(sni_json_);
+  ServerContextPtr context2 = createContext(sni_json_);
+  EXPECT_EQ(state(context1), state(context2));
+
+  ServerContextPtr context3 = createContext(R"EOF(
+  {
+    "cert_chain_file": "{{ test_rundir }}/test/common/ssl/test_data/no_san_cert.pem",
+    "private_key_file": "{{ test_rundir }}/test/common/ssl/test_data/no_san_key.pem"
+  }
+  )EOF");
+  EXPECT_NE(state(context1), state(context3));
+
+  // Once the contexts that use a state are gone, it is built again.
+  std::weak_ptr<ServerContextState> weak_state = state(context1);
+  context1.reset();
+  context2.reset();
+  EXPECT_TRUE(weak_state.expired());
+  context1 = createContext(sni_json_);
+  EXPECT_NE(nullptr, state(context1));
+}
+
+TEST_F(SslServerContextStateTest, Reload) {
+  copyFile(TestEnvironment::runfilesPath("test/common/ssl/test_data/san_dns_cert.pem"),
+           TestEnvironment::temporaryPath("reload_cert.pem"));
+  copyFile(TestEnvironment::runfilesPath("test/common/ssl/test_data/san_dns_key.pem"),
+           TestEnvironment::temporaryPath("reload_key.pem"));
+  const std::string json = R"EOF(
+  {
+    "cert_chain_file": "{{ test_tmpdir }}/reload_cert.pem",
+    "private_key_file": "{{ test_tmpdir }}/reload_key.pem"
+  }
+  )EOF";
+  ServerContextPtr context1 = createContext(json);
+  ServerContextPtr context2 = createContext(json);
+  ServerContextStateSharedPtr old_state = state(context1);
+  EXPECT_NE(nullptr, old_state->findCtx("server1.example.com"));
+
+  // Renew the certificate with one that serves other names.
+  copyFile(TestEnvironment::runfilesPath("test/common/ssl/test_data/san_wildcard_dns_cert.pem"),
+           TestEnvironment::temporaryPath("reload_cert.pem"));
+  copyFile(TestEnvironment::runfilesPath("test/common/ssl/test_data/san_wildcard_dns_key.pem"),
+           TestEnvironment::temporaryPath("reload_key.pem"));
+  manager_.reloadServerContexts();
+
+  ServerContextStateSharedPtr new_state = state(context1);
+  EXPECT_NE(old_state, new_state);
+  EXPECT_EQ(new_state, state(context2));
+  EXPECT_NE(nullptr, new_state->findCtx("server2.example.com"));
+  // Connections that already use the old state keep it.
+  EXPECT_NE(nullptr, old_state->findCtx("server1.example.com"));
+  EXPECT_EQ(nullptr, old_state->findCtx("server2.example.com"));
+
+  // A state that fails to reload is kept.
+  ::unlink(TestEnvironment::temporaryPath("reload_key.pem").c_str());
+  EXPECT_THROW_WITH_MESSAGE(
+      manager_.reloadServerContexts(), EnvoyException,
+      "Failed to reload server contexts: Failed to load private key file " +
+          TestEnvironment::temporaryPath("reload_key.pem"));
+  EXPECT_EQ(new_state, state(context1));
+}
+
 } // Ssl
 } // Envoy
@@ -37,5 +37,10 @@ openssl req -new -key san_uri_key.pem -out san_uri_cert.csr -config san_uri_cert
 
 openssl x509 -req -days 730 -in san_uri_cert.csr -sha256 -CA ca_cert.pem -CAkey ca_key.pem -CAcreateserial -out san_uri_cert.pem -extensions v3_req -extfile san_uri_cert.cfg
 
+# Generate san_wildcard_dns_key.pem and san_wildcard_dns_cert.pem.
+openssl req -new -key san_wildcard_dns_key.pem -out san_wildcard_dns_cert.csr -config san_wildcard_dns_cert.cfg -batch -sha256
+
+openssl x509 -req -days 730 -in san_wildcard_dns_cert.csr -sha256 -CA ca_cert.pem -CAkey ca_key.pem -CAcreateserial -out san_wildcard_dns_cert.pem -extensions v3_req -extfile san_wildcard_dns_cert.cfg
+
 rm *csr
 rm *srl
@@ -0,0 +1,87 @@
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "common/stats/counter_shards.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Stats {
+
+TEST(CounterShardsTest, AcquireByKey) {
+  CounterShards& shards = CounterShards::instance();
+  int key1;
+  int key2;
+
+  const uint32_t index1 = shards.acquire(&key1);
+  ASSERT_NE(CounterShards::NO_INDEX, index1);
+  EXPECT_EQ(index1, shards.acquire(&key1));
+  const uint32_t index2 = shards.acquire(&key2);
+  EXPECT_NE(index1, index2);
+
+  shards.add(index1, 2);
+  shards.add(index2, 3);
+  EXPECT_EQ(2U, shards.fold(index1));
+  EXPECT_EQ(0U, shards.fold(index1));
+  EXPECT_EQ(3U, shards.fold(index2));
+  EXPECT_EQ(0U, shards.fold(CounterShards::NO_INDEX));
+
+  // The index stays with the key until every acquire is released.
+  shards.release(&key1);
+  EXPECT_EQ(index1, shards.acquire(&key1));
+  shards.release(&key1);
+  shards.release(&key1);
+  shards.release(&key2);
+}
+
+TEST(CounterShardsTest, ReusedIndexStartsFromCurrentSum) {
+  CounterShards& shards = CounterShards::instance();
+  int key1;
+  int key2;
+
+  const uint32_t index = shards.acquire(&key1);
+  shards.add(index, 5);
+  shards.release(&key1);
+
+  // The freed index is reused, and the increments of its previous key are not folded again.
+  EXPECT_EQ(index, shards.acquire(&key2));
+  EXPECT_EQ(0U, shards.fold(index));
+  shards.add(index, 1);
+  EXPECT_EQ(1U, shards.fold(index));
+  shards.release(&key2);
+}
+
+TEST(CounterShardsTest, MultipleThreads) {
+  CounterShards& shards = CounterShards::instance();
+  int key;
+  const uint32_t index = shards.acquire(&key);
+
+  const uint32_t num_threads = 4;
+  const uint64_t increments_per_thread = 100000;
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < num_threads; i++) {
+    threads.emplace_back([&shards, index]() -> void {
+      for (uint64_t j = 0; j < increments_per_thread; j++) {
+        shards.add(index, 1);
+      }
+    });
+  }
+
+  // Folds that race with the increments see part of them, and the rest is seen later.
+  uint64_t total = shards.fold(index);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  total += shards.fold(index);
+  EXPECT_EQ(num_threads * increments_per_thread, total);
+
+  // The shards of exited threads still count.
+  EXPECT_EQ(0U, shards.fold(index));
+  shards.add(index, 1);
+  EXPECT_EQ(1U, shards.fold(index));
+  shards.release(&key);
+}
+
+} // Stats
+} // Envoy
@@ -0,0 +1,123 @@
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "common/stats/histogram_impl.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Stats {
+
+TEST(HistogramBucketsTest, Bounds) {
+  for (uint64_t value = 0; value < HistogramBuckets::SubBucketCount * 2; value++) {
+    EXPECT_EQ(value, HistogramBuckets::index(value));
+    EXPECT_EQ(value, HistogramBuckets::lowerBound(value));
+    EXPECT_EQ(value, HistogramBuckets::upperBound(value));
+  }
+
+  // Every bucket is contiguous with the next one and contains its bounds.
+  for (uint32_t i = 0; i < HistogramBuckets::BucketCount; i++) {
+    EXPECT_EQ(i, HistogramBuckets::index(HistogramBuckets::lowerBound(i)));
+    EXPECT_EQ(i, HistogramBuckets::index(HistogramBuckets::upperBound(i)));
+    if (i + 1 < HistogramBuckets::BucketCount) {
+      EXPECT_EQ(HistogramBuckets::upperBound(i) + 1, HistogramBuckets::lowerBound(i + 1));
+    }
+  }
+
+  EXPECT_EQ(HistogramBuckets::MaxValue,
+            HistogramBuckets::upperBound(HistogramBuckets::BucketCount - 1));
+  EXPECT_EQ(HistogramBuckets::BucketCount - 1,
+            HistogramBuckets::index(HistogramBuckets::MaxValue + 1));
+  EXPECT_EQ(HistogramBuckets::BucketCount - 1, HistogramBuckets::index(UINT64_MAX));
+}
+
+TEST(HistogramBucketsTest, RelativeError) {
+  for (uint64_t value = 1; value < (1ULL << 30); value = value * 3 + 1) {
+    uint64_t upper = HistogramBuckets::upperBound(HistogramBuckets::index(value));
+    EXPECT_LE(value, upper);
+    EXPECT_LE(upper - value, value / HistogramBuckets::SubBucketCount);
+  }
+}
+
+TEST(HistogramStatisticsImplTest, Quantiles) {
+  HistogramStatisticsImpl statistics;
+  EXPECT_EQ(0UL, statistics.quantile(0.5));
+  EXPECT_EQ("count=0 p50=0 p90=0 p95=0 p99=0 p999=0 max=0", statistics.summary());
+
+  for (uint64_t value = 1; value <= 100; value++) {
+    statistics.addCount(HistogramBuckets::index(value), 1);
+    statistics.addSum(value);
+  }
+
+  EXPECT_EQ(100UL, statistics.sampleCount());
+  EXPECT_EQ(5050UL, statistics.sampleSum());
+  EXPECT_EQ(1UL, statistics.quantile(0));
+  EXPECT_EQ(51UL, statistics.quantile(0.5));
+  EXPECT_EQ(91UL, statistics.quantile(0.9));
+  EXPECT_EQ(103UL, statistics.quantile(1));
+  EXPECT_EQ("count=100 p50=51 p90=91 p95=95 p99=99 p999=103 max=103", statistics.summary());
+}
+
+TEST(HistogramStatisticsImplTest, IterateBuckets) {
+  HistogramStatisticsImpl statistics;
+  for (uint64_t value : {1, 1, 100, 100000}) {
+    statistics.addCount(HistogramBuckets::index(value), 1);
+  }
+
+  // Recording each bucket's value again lands in the same buckets.
+  std::vector<std::pair<uint64_t, uint64_t>> buckets;
+  statistics.iterateBuckets([&buckets](uint64_t value, uint64_t count) -> void {
+    buckets.emplace_back(value, count);
+  });
+  EXPECT_EQ(3UL, buckets.size());
+  EXPECT_EQ(std::make_pair(1UL, 2UL), buckets[0]);
+
+  HistogramStatisticsImpl copy;
+  for (const std::pair<uint64_t, uint64_t>& bucket : buckets) {
+    copy.addCount(HistogramBuckets::index(bucket.first), bucket.second);
+  }
+  EXPECT_EQ(statistics.summary(), copy.summary());
+}
+
+TEST(ParentHistogramImplTest, Merge) {
+  ParentHistogramImpl parent("h", "h", {});
+  EXPECT_EQ("h", parent.name());
+
+  ThreadLocalHistogramSharedPtr tls1 = std::make_shared<ThreadLocalHistogramImpl>();
+  ThreadLocalHistogramSharedPtr tls2 = std::make_shared<ThreadLocalHistogramImpl>();
+  parent.addTlsHistogram(tls1);
+  parent.addTlsHistogram(tls2);
+
+  tls1->recordValue(1);
+  tls1->recordValue(2);
+  tls2->recordValue(3);
+  parent.merge();
+  EXPECT_EQ(3UL, parent.intervalStatistics().sampleCount());
+  EXPECT_EQ(6UL, parent.intervalStatistics().sampleSum());
+  EXPECT_EQ(3UL, parent.intervalStatistics().quantile(1));
+  EXPECT_EQ(3UL, parent.cumulativeStatistics().sampleCount());
+
+  // Only new samples show up in the next interval.
+  tls2->recordValue(10);
+  parent.merge();
+  EXPECT_EQ(1UL, parent.intervalStatistics().sampleCount());
+  EXPECT_EQ(10UL, parent.intervalStatistics().quantile(0));
+  EXPECT_EQ(4UL, parent.cumulativeStatistics().sampleCount());
+  EXPECT_EQ(16UL, parent.cumulativeStatistics().sampleSum());
+
+  // Samples recorded before a thread releases its histogram are still merged.
+  tls1->recordValue(5);
+  tls1.reset();
+  parent.merge();
+  EXPECT_EQ(1UL, parent.intervalStatistics().sampleCount());
+  EXPECT_EQ(5UL, parent.cumulativeStatistics().sampleCount());
+
+  parent.merge();
+  EXPECT_EQ(0UL, parent.intervalStatistics().sampleCount());
+  EXPECT_EQ(5UL, parent.cumulativeStatistics().sampleCount());
+}
+
+} // Stats
+} // Envoy
@@ -1,10 +1,22 @@
 #include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "common/stats/stats_impl.h"
 
+#include "test/mocks/common.h"
+#include "test/mocks/stats/mocks.h"
+
+#include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
 namespace Envoy {
+using testing::NiceMock;
+using testing::Return;
+
 namespace Stats {
 
 TEST(StatsIsolatedStoreImplTest, All) {
@@ -35,5 +47,129 @@ TEST(StatsIsolatedStoreImplTest, All) {
   EXPECT_EQ(2UL, store.gauges().size());
 }
 
+TEST(StatsTimerImplTest, TimespanWithTimeSource) {
+  NiceMock<MockStore> store;
+  NiceMock<MockMonotonicTimeSource> time_source;
+  TimerImpl timer("t", store);
+
+  const MonotonicTime start{std::chrono::seconds(10)};
+  EXPECT_CALL(time_source, currentTime())
+      .WillOnce(Return(start))
+      .WillOnce(Return(start + std::chrono::milliseconds(25)));
+  TimespanPtr span = timer.allocateSpan(time_source);
+  EXPECT_CALL(store, deliverTimingToSinks("t", std::chrono::milliseconds(25)));
+  span->complete();
+}
+
+TEST(StatsCounterImplTest, IncrementsAreFoldedOnRead) {
+  HeapRawStatDataAllocator alloc;
+  RawStatData& data = *alloc.alloc("c");
+  CounterImpl counter(data, alloc, "c", {});
+
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < 4; i++) {
+    threads.emplace_back([&counter]() -> void {
+      for (uint32_t j = 0; j < 1000; j++) {
+        counter.inc();
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  // The increments stay in the per thread shards until the counter is read.
+  EXPECT_TRUE(counter.used());
+  EXPECT_EQ(0U, data.value_);
+  EXPECT_EQ(4000U, counter.value());
+  EXPECT_EQ(4000U, data.value_);
+  EXPECT_EQ(4000U, counter.latch());
+  EXPECT_EQ(0U, counter.latch());
+
+  counter.add(2);
+  counter.reset();
+  EXPECT_EQ(0U, counter.value());
+  EXPECT_EQ(2U, counter.latch());
+}
+
+TEST(StatsPrimitiveStatsTest, All) {
+  const std::string counter_name{"c"};
+  PrimitiveCounter counter(counter_name);
+  EXPECT_EQ("c", counter.name());
+  EXPECT_EQ("c", counter.tagExtractedName());
+  EXPECT_TRUE(counter.tags().empty());
+  EXPECT_FALSE(counter.used());
+  counter.inc();
+  counter.add(2);
+  EXPECT_TRUE(counter.used());
+  EXPECT_EQ(3U, counter.value());
+  EXPECT_EQ(3U, counter.latch());
+  counter.inc();
+  EXPECT_EQ(1U, counter.latch());
+  EXPECT_EQ(0U, counter.latch());
+  counter.reset();
+  EXPECT_EQ(0U, counter.value());
+  EXPECT_EQ(0U, counter.latch());
+
+  const std::string gauge_name{"g"};
+  PrimitiveGauge gauge(gauge_name);
+  EXPECT_EQ("g", gauge.name());
+  EXPECT_FALSE(gauge.used());
+  gauge.set(5);
+  EXPECT_TRUE(gauge.used());
+  gauge.inc();
+  gauge.sub(2);
+  gauge.dec();
+  EXPECT_EQ(3U, gauge.value());
+}
+
+TEST(ChangedStatsTest, OnlyChangedStatsAreVisited) {
+  HeapRawStatDataAllocator alloc;
+  ChangedStats changed_stats;
+  std::vector<std::shared_ptr<CounterImpl>> counters;
+  for (const std::string name : {"c1", "c2", "c3"}) {
+    counters.emplace_back(new CounterImpl(*alloc.alloc(name), alloc, std::string(name), {},
+                                          &changed_stats));
+  }
+  std::shared_ptr<GaugeImpl> g1(
+      new GaugeImpl(*alloc.alloc("g1"), alloc, "g1", {}, &changed_stats));
+
+  std::vector<std::pair<std::string, uint64_t>> flushed;
+  const StoreRoot::ChangedCounterCb counter_cb = [&](Counter& counter, uint64_t delta) -> void {
+    flushed.emplace_back(counter.name(), delta);
+  };
+  const StoreRoot::ChangedGaugeCb gauge_cb = [&](Gauge& gauge) -> void {
+    flushed.emplace_back(gauge.name(), gauge.value());
+  };
+
+  counters[0]->inc();
+  counters[0]->add(2);
+  counters[2]->inc();
+  g1->set(5);
+  changed_stats.flush(counter_cb, gauge_cb);
+  EXPECT_EQ((std::vector<std::pair<std::string, uint64_t>>{{"c1", 3}, {"c3", 1}, {"g1", 5}}),
+            flushed);
+
+  // Nothing changed since the last flush.
+  flushed.clear();
+  changed_stats.flush(counter_cb, gauge_cb);
+  EXPECT_TRUE(flushed.empty());
+
+  // Stats that change again are visited again, and deleted stats are skipped.
+  counters[0]->inc();
+  counters[1]->inc();
+  g1->dec();
+  counters[1].reset();
+  changed_stats.flush(counter_cb, gauge_cb);
+  EXPECT_EQ((std::vector<std::pair<std::string, uint64_t>>{{"c1", 1}, {"g1", 4}}), flushed);
+
+  // A counter latched elsewhere has nothing left to report.
+  flushed.clear();
+  counters[2]->inc();
+  counters[2]->latch();
+  changed_stats.flush(counter_cb, gauge_cb);
+  EXPECT_TRUE(flushed.empty());
+}
+
 } // Stats
 } // Envoy
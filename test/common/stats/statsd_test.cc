@@ -1,13 +1,14 @@
-#include <chrono>
 #include <memory>
 
 #include "common/network/utility.h"
+#include "common/stats/histogram_impl.h"
 #include "common/stats/statsd.h"
 #include "common/upstream/upstream_impl.h"
 
 #include "test/mocks/buffer/mocks.h"
 #include "test/mocks/local_info/mocks.h"
 #include "test/mocks/network/mocks.h"
+#include "test/mocks/stats/mocks.h"
 #include "test/mocks/thread_local/mocks.h"
 #include "test/mocks/upstream/mocks.h"
 
@@ -55,22 +56,34 @@ public:
 TEST_F(TcpStatsdSinkTest, All) {
   InSequence s;
 
+  NiceMock<MockCounter> counter;
+  counter.name_ = "test_counter";
   expectCreateConnection();
   EXPECT_CALL(*connection_, write(BufferStringEqual("envoy.test_counter:1|c\n")));
-  sink_->flushCounter("test_counter", 1);
+  sink_->flushCounter(counter, 1);
 
+  NiceMock<MockGauge> gauge;
+  gauge.name_ = "test_gauge";
   EXPECT_CALL(*connection_, write(BufferStringEqual("envoy.test_gauge:2|g\n")));
-  sink_->flushGauge("test_gauge", 2);
+  sink_->flushGauge(gauge, 2);
 
   // Test a disconnect. We should connect again.
   connection_->raiseEvents(Network::ConnectionEvent::RemoteClose);
 
   expectCreateConnection();
-  EXPECT_CALL(*connection_, write(BufferStringEqual("envoy.test_timer:5|ms\n")));
-  sink_->onTimespanComplete("test_timer", std::chrono::milliseconds(5));
-
-  EXPECT_CALL(*connection_, write(BufferStringEqual("envoy.histogram_test_timer:15|ms\n")));
-  sink_->onHistogramComplete("histogram_test_timer", 15);
+  NiceMock<MockHistogram> histogram;
+  histogram.name_ = "test_timer";
+  HistogramStatisticsImpl statistics;
+  statistics.addCount(HistogramBuckets::index(5), 1);
+  statistics.addCount(HistogramBuckets::index(15), 1);
+  EXPECT_CALL(*connection_, write(BufferStringEqual("envoy.test_timer.count:2|c\n"
+                                                    "envoy.test_timer.p50:5|g\n"
+                                                    "envoy.test_timer.p90:15|g\n"
+                                                    "envoy.test_timer.p95:15|g\n"
+                                                    "envoy.test_timer.p99:15|g\n"
+                                                    "envoy.test_timer.p999:15|g\n"
+                                                    "envoy.test_timer.max:15|g\n")));
+  sink_->flushHistogram(histogram, statistics);
 
   EXPECT_CALL(*connection_, close(Network::ConnectionCloseType::NoFlush));
   tls_.shutdownThread();
@@ -79,23 +92,26 @@ TEST_F(TcpStatsdSinkTest, All) {
 TEST_F(TcpStatsdSinkTest, Overflow) {
   InSequence s;
 
+  NiceMock<MockCounter> counter;
+  counter.name_ = "test_counter";
+
   // Synthetically set buffer above high watermark. Make sure we don't write anything.
   cluster_manager_.thread_local_cluster_.cluster_.info_->stats().upstream_cx_tx_bytes_buffered_.set(
       1024 * 1024 * 17);
-  sink_->flushCounter("test_counter", 1);
+  sink_->flushCounter(counter, 1);
 
   // Lower and make sure we write.
   cluster_manager_.thread_local_cluster_.cluster_.info_->stats().upstream_cx_tx_bytes_buffered_.set(
       1024 * 1024 * 15);
   expectCreateConnection();
   EXPECT_CALL(*connection_, write(BufferStringEqual("envoy.test_counter:1|c\n")));
-  sink_->flushCounter("test_counter", 1);
+  sink_->flushCounter(counter, 1);
 
   // Raise and make sure we don't write and kill connection.
   cluster_manager_.thread_local_cluster_.cluster_.info_->stats().upstream_cx_tx_bytes_buffered_.set(
       1024 * 1024 * 17);
   EXPECT_CALL(*connection_, close(Network::ConnectionCloseType::NoFlush));
-  sink_->flushCounter("test_counter", 1);
+  sink_->flushCounter(counter, 1);
 
   EXPECT_EQ(2UL, cluster_manager_.thread_local_cluster_.cluster_.info_->stats_store_
                      .counter("statsd.cx_overflow")
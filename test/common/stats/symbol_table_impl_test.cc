@@ -0,0 +1,62 @@
+#include <string>
+#include <vector>
+
+#include "common/stats/symbol_table_impl.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Stats {
+
+TEST(SymbolTableTest, RoundTrip) {
+  SymbolTable table;
+  const std::vector<std::string> names{"", "a", "cluster.foo.upstream_rq_200", "a..b", ".a", "a."};
+  for (const std::string& name : names) {
+    EXPECT_EQ(name, table.decode(table.encode(name)));
+  }
+}
+
+TEST(SymbolTableTest, TokensInternedOnce) {
+  SymbolTable table;
+  StatName name1 = table.encode("cluster.foo.upstream_rq_200");
+  StatName name2 = table.encode("cluster.bar.upstream_rq_200");
+  EXPECT_EQ(4UL, table.numSymbols());
+  EXPECT_EQ(3UL, name1.size());
+  EXPECT_NE(name1, name2);
+  EXPECT_EQ(name1, table.encode("cluster.foo.upstream_rq_200"));
+  EXPECT_EQ(4UL, table.numSymbols());
+
+  std::vector<Symbol> symbols1 = name1.symbols();
+  std::vector<Symbol> symbols2 = name2.symbols();
+  EXPECT_EQ(symbols1[0], symbols2[0]);
+  EXPECT_NE(symbols1[1], symbols2[1]);
+  EXPECT_EQ(symbols1[2], symbols2[2]);
+}
+
+TEST(SymbolTableTest, LargeSymbols) {
+  SymbolTable table;
+  for (uint32_t i = 0; i < 20000; i++) {
+    table.toSymbol(std::to_string(i));
+  }
+
+  // Symbols above 127 take more than one byte.
+  StatName name = table.encode("1.200.19999");
+  EXPECT_EQ(1UL + 2 + 3, name.size());
+  EXPECT_EQ((std::vector<Symbol>{1, 200, 19999}), name.symbols());
+  EXPECT_EQ("1.200.19999", table.decode(name));
+}
+
+TEST(SymbolCacheTest, MatchesTable) {
+  SymbolTable table;
+  SymbolCache cache1(table);
+  SymbolCache cache2(table);
+  StatName name = cache1.encode("http.admin.downstream_rq_total");
+  EXPECT_EQ(name, cache2.encode("http.admin.downstream_rq_total"));
+  EXPECT_EQ(name, table.encode("http.admin.downstream_rq_total"));
+  EXPECT_EQ(name, cache1.encode("http.admin.downstream_rq_total"));
+  EXPECT_EQ(3UL, table.numSymbols());
+  EXPECT_EQ("http.admin.downstream_rq_total", table.decode(name));
+}
+
+} // Stats
+} // Envoy
@@ -0,0 +1,84 @@
+#include <string>
+#include <vector>
+
+#include "envoy/common/exception.h"
+
+#include "common/stats/tag_extractor_impl.h"
+
+#include "test/test_common/utility.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Stats {
+
+TEST(TagExtractorTest, Extract) {
+  TagExtractorImpl extractor("cluster_name", "^cluster\\.((.+?)\\.)");
+  std::vector<Tag> tags;
+
+  std::string name = "cluster.foo.upstream_rq_200";
+  EXPECT_TRUE(extractor.extractTag(name, tags));
+  EXPECT_EQ("cluster.upstream_rq_200", name);
+  ASSERT_EQ(1U, tags.size());
+  EXPECT_EQ("cluster_name", tags[0].name_);
+  EXPECT_EQ("foo", tags[0].value_);
+
+  name = "listener.admin.downstream_cx_total";
+  EXPECT_FALSE(extractor.extractTag(name, tags));
+  EXPECT_EQ("listener.admin.downstream_cx_total", name);
+  EXPECT_EQ(1U, tags.size());
+}
+
+TEST(TagExtractorTest, SingleCaptureGroup) {
+  TagExtractorImpl extractor("code", "_(\\d{3})$");
+  std::vector<Tag> tags;
+
+  std::string name = "upstream_rq_200";
+  EXPECT_TRUE(extractor.extractTag(name, tags));
+  EXPECT_EQ("upstream_rq_", name);
+  ASSERT_EQ(1U, tags.size());
+  EXPECT_EQ("200", tags[0].value_);
+}
+
+TEST(TagExtractorTest, BadRegex) {
+  EXPECT_THROW_WITH_MESSAGE(TagExtractorImpl("name", "^cluster\\.$"), EnvoyException,
+                            "regex '^cluster\\.$' for tag 'name' has no capture group");
+  EXPECT_THROW(TagExtractorImpl("name", "(("), EnvoyException);
+}
+
+TEST(TagProducerTest, DefaultExtractors) {
+  TagProducerImpl producer;
+  std::vector<Tag> tags;
+
+  EXPECT_EQ("cluster.upstream_rq", producer.produceTags("cluster.foo.upstream_rq_503", tags));
+  ASSERT_EQ(2U, tags.size());
+  EXPECT_EQ("envoy.cluster_name", tags[0].name_);
+  EXPECT_EQ("foo", tags[0].value_);
+  EXPECT_EQ("envoy.response_code", tags[1].name_);
+  EXPECT_EQ("503", tags[1].value_);
+
+  tags.clear();
+  EXPECT_EQ("vhost.vcluster.upstream_rq",
+            producer.produceTags("vhost.www.vcluster.other.upstream_rq_2xx", tags));
+  ASSERT_EQ(3U, tags.size());
+  EXPECT_EQ("envoy.virtual_host", tags[0].name_);
+  EXPECT_EQ("www", tags[0].value_);
+  EXPECT_EQ("envoy.virtual_cluster", tags[1].name_);
+  EXPECT_EQ("other", tags[1].value_);
+  EXPECT_EQ("envoy.response_code_class", tags[2].name_);
+  EXPECT_EQ("2xx", tags[2].value_);
+
+  tags.clear();
+  EXPECT_EQ("http.downstream_rq_total",
+            producer.produceTags("http.ingress_http.downstream_rq_total", tags));
+  ASSERT_EQ(1U, tags.size());
+  EXPECT_EQ("envoy.http_conn_manager_prefix", tags[0].name_);
+  EXPECT_EQ("ingress_http", tags[0].value_);
+
+  tags.clear();
+  EXPECT_EQ("server.uptime", producer.produceTags("server.uptime", tags));
+  EXPECT_TRUE(tags.empty());
+}
+
+} // Stats
+} // Envoy
@@ -0,0 +1,80 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "common/stats/stats_impl.h"
+#include "common/stats/thread_local_store.h"
+
+#include "test/mocks/event/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+using testing::NiceMock;
+
+namespace Stats {
+
+/**
+ * This test is for benchmarking only and should not be run as part of unit tests. It measures how
+ * long looking up an existing counter by name takes once the thread local caches are warm, from
+ * the store and from a scope, as done by code that does not hold on to its counters.
+ */
+class DISABLED_ThreadLocalStoreBenchmark : public testing::Test {
+public:
+  static const uint32_t NumCounters = 10000;
+  static const uint32_t NumLookups = 1000000;
+
+  DISABLED_ThreadLocalStoreBenchmark() : store_(alloc_) {
+    store_.initializeThreading(main_thread_dispatcher_, tls_);
+    for (uint32_t i = 0; i < NumCounters; i++) {
+      names_.push_back(fmt::format("cluster.service_{}.upstream_rq_total", i));
+    }
+  }
+
+  ~DISABLED_ThreadLocalStoreBenchmark() {
+    store_.shutdownThreading();
+    tls_.shutdownThread();
+  }
+
+  void run(const std::string& name, Scope& scope) {
+    // The first pass allocates the counters and fills the caches.
+    for (const std::string& counter_name : names_) {
+      scope.counter(counter_name).inc();
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NumLookups; i++) {
+      scope.counter(names_[i % NumCounters]).inc();
+    }
+    std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << fmt::format("{}: counters={} {}ns/op", name, NumCounters,
+                             elapsed.count() / NumLookups)
+              << std::endl;
+  }
+
+  HeapRawStatDataAllocator alloc_;
+  NiceMock<Event::MockDispatcher> main_thread_dispatcher_;
+  NiceMock<ThreadLocal::MockInstance> tls_;
+  ThreadLocalStoreImpl store_;
+  std::vector<std::string> names_;
+};
+
+const uint32_t DISABLED_ThreadLocalStoreBenchmark::NumCounters;
+const uint32_t DISABLED_ThreadLocalStoreBenchmark::NumLookups;
+
+TEST_F(DISABLED_ThreadLocalStoreBenchmark, CounterLookup) {
+  run("stats_counter_lookup", store_);
+}
+
+TEST_F(DISABLED_ThreadLocalStoreBenchmark, ScopedCounterLookup) {
+  ScopePtr scope = store_.createScope("listener.0.0.0.0_443.");
+  run("stats_scoped_counter_lookup", *scope);
+}
+
+} // Stats
+} // Envoy
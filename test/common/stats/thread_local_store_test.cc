@@ -2,7 +2,9 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
+#include "common/stats/tag_extractor_impl.h"
 #include "common/stats/thread_local_store.h"
 
 #include "test/mocks/event/mocks.h"
@@ -73,7 +75,6 @@ public:
 
     EXPECT_CALL(*this, alloc("stats.overflow"));
     store_.reset(new ThreadLocalStoreImpl(*this));
-    store_->addSink(sink_);
   }
 
   CounterSharedPtr findCounter(const std::string& name) {
@@ -94,13 +95,21 @@ public:
     return nullptr;
   }
 
+  HistogramSharedPtr findHistogram(const std::string& name) {
+    for (auto histogram : store_->histograms()) {
+      if (histogram->name() == name) {
+        return histogram;
+      }
+    }
+    return nullptr;
+  }
+
   MOCK_METHOD1(alloc, RawStatData*(const std::string& name));
   MOCK_METHOD1(free, void(RawStatData& data));
 
   NiceMock<Event::MockDispatcher> main_thread_dispatcher_;
   NiceMock<ThreadLocal::MockInstance> tls_;
   TestAllocator alloc_;
-  MockSink sink_;
   std::unique_ptr<ThreadLocalStoreImpl> store_;
 };
 
@@ -117,11 +126,14 @@ TEST_F(StatsThreadLocalStoreTest, NoTls) {
   Timer& t1 = store_->timer("t1");
   EXPECT_EQ(&t1, &store_->timer("t1"));
 
-  EXPECT_CALL(sink_, onHistogramComplete("h", 100));
   store_->deliverHistogramToSinks("h", 100);
-
-  EXPECT_CALL(sink_, onTimespanComplete("t", std::chrono::milliseconds(200)));
   store_->deliverTimingToSinks("t", std::chrono::milliseconds(200));
+  store_->deliverTimingToSinks("t", std::chrono::milliseconds(200));
+  EXPECT_EQ(2UL, store_->histograms().size());
+  HistogramSharedPtr t = findHistogram("t");
+  t->merge();
+  EXPECT_EQ(2UL, t->intervalStatistics().sampleCount());
+  EXPECT_EQ(400UL, t->intervalStatistics().sampleSum());
 
   EXPECT_EQ(2UL, store_->counters().size());
   EXPECT_EQ(&c1, store_->counters().front().get());
@@ -193,11 +205,18 @@ TEST_F(StatsThreadLocalStoreTest, BasicScope) {
   EXPECT_EQ("t1", t1.name());
   EXPECT_EQ("scope1.t2", t2.name());
 
-  EXPECT_CALL(sink_, onHistogramComplete("scope1.h", 100));
   scope1->deliverHistogramToSinks("h", 100);
-
-  EXPECT_CALL(sink_, onTimespanComplete("scope1.t", std::chrono::milliseconds(200)));
   scope1->deliverTimingToSinks("t", std::chrono::milliseconds(200));
+  store_->deliverHistogramToSinks("h", 1);
+  EXPECT_EQ(3UL, store_->histograms().size());
+  HistogramSharedPtr h1 = findHistogram("h");
+  HistogramSharedPtr h2 = findHistogram("scope1.h");
+  h1->merge();
+  h2->merge();
+  EXPECT_EQ(1UL, h1->intervalStatistics().sampleSum());
+  EXPECT_EQ(100UL, h2->intervalStatistics().sampleSum());
+  findHistogram("scope1.t")->merge();
+  EXPECT_EQ(200UL, findHistogram("scope1.t")->cumulativeStatistics().sampleSum());
 
   store_->shutdownThreading();
   tls_.shutdownThread();
@@ -216,11 +235,14 @@ TEST_F(StatsThreadLocalStoreTest, ScopeDelete) {
   EXPECT_EQ(2UL, store_->counters().size());
   CounterSharedPtr c1 = store_->counters().front();
   EXPECT_EQ("scope1.c1", c1->name());
+  scope1->deliverHistogramToSinks("h", 1);
+  EXPECT_EQ(1UL, store_->histograms().size());
 
   EXPECT_CALL(main_thread_dispatcher_, post(_));
   EXPECT_CALL(tls_, runOnAllThreads(_));
   scope1.reset();
   EXPECT_EQ(1UL, store_->counters().size());
+  EXPECT_EQ(0UL, store_->histograms().size());
 
   EXPECT_CALL(*this, free(_));
   EXPECT_EQ(1L, c1.use_count());
@@ -270,6 +292,14 @@ TEST_F(StatsThreadLocalStoreTest, OverlappingScopes) {
   EXPECT_EQ(1UL, g2.value());
   EXPECT_EQ(1UL, store_->gauges().size());
 
+  // Histograms are shared by both scopes.
+  scope1->deliverHistogramToSinks("h", 1);
+  scope2->deliverHistogramToSinks("h", 2);
+  EXPECT_EQ(1UL, store_->histograms().size());
+  HistogramSharedPtr h = findHistogram("scope1.h");
+  h->merge();
+  EXPECT_EQ(3UL, h->intervalStatistics().sampleSum());
+
   // Deleting scope 1 will call free but will be reference counted. It still leaves scope 2 valid.
   EXPECT_CALL(*this, free(_)).Times(2);
   scope1.reset();
@@ -279,6 +309,100 @@ TEST_F(StatsThreadLocalStoreTest, OverlappingScopes) {
   g2.set(10);
   EXPECT_EQ(10UL, g2.value());
   EXPECT_EQ(1UL, store_->gauges().size());
+  scope2->deliverHistogramToSinks("h", 4);
+  h->merge();
+  EXPECT_EQ(4UL, h->intervalStatistics().sampleSum());
+  EXPECT_EQ(1UL, store_->histograms().size());
+
+  store_->shutdownThreading();
+  tls_.shutdownThread();
+
+  // Includes overflow stat.
+  EXPECT_CALL(*this, free(_)).Times(3);
+}
+
+TEST_F(StatsThreadLocalStoreTest, Tags) {
+  InSequence s;
+  store_->initializeThreading(main_thread_dispatcher_, tls_);
+
+  // Stats created before a tag producer is set have no tags.
+  EXPECT_CALL(*this, alloc(_)).Times(3);
+  Counter& untagged = store_->counter("cluster.foo.upstream_rq_200");
+  EXPECT_EQ("cluster.foo.upstream_rq_200", untagged.tagExtractedName());
+  EXPECT_TRUE(untagged.tags().empty());
+
+  store_->setTagProducer(TagProducerPtr{new TagProducerImpl()});
+  ScopePtr scope = store_->createScope("cluster.bar.");
+  Counter& c1 = scope->counter("upstream_rq_503");
+  EXPECT_EQ("cluster.bar.upstream_rq_503", c1.name());
+  EXPECT_EQ("cluster.upstream_rq", c1.tagExtractedName());
+  ASSERT_EQ(2UL, c1.tags().size());
+  EXPECT_EQ("envoy.cluster_name", c1.tags()[0].name_);
+  EXPECT_EQ("bar", c1.tags()[0].value_);
+  EXPECT_EQ("envoy.response_code", c1.tags()[1].name_);
+  EXPECT_EQ("503", c1.tags()[1].value_);
+
+  Gauge& g1 = scope->gauge("upstream_cx_active");
+  EXPECT_EQ("cluster.upstream_cx_active", g1.tagExtractedName());
+  ASSERT_EQ(1UL, g1.tags().size());
+  EXPECT_EQ("bar", g1.tags()[0].value_);
+
+  scope->deliverHistogramToSinks("upstream_rq_time", 1);
+  HistogramSharedPtr h1 = findHistogram("cluster.bar.upstream_rq_time");
+  EXPECT_EQ("cluster.upstream_rq_time", h1->tagExtractedName());
+  ASSERT_EQ(1UL, h1->tags().size());
+  EXPECT_EQ("bar", h1->tags()[0].value_);
+
+  // The tags are computed once, so cached lookups return the same stat.
+  EXPECT_EQ(&c1, &scope->counter("upstream_rq_503"));
+
+  store_->shutdownThreading();
+  tls_.shutdownThread();
+
+  // Includes overflow stat.
+  EXPECT_CALL(*this, free(_)).Times(4);
+  scope.reset();
+  h1.reset();
+}
+
+TEST_F(StatsThreadLocalStoreTest, ChangedStats) {
+  InSequence s;
+  store_->initializeThreading(main_thread_dispatcher_, tls_);
+
+  std::vector<std::string> flushed;
+  const StoreRoot::ChangedCounterCb counter_cb = [&](Counter& counter, uint64_t delta) -> void {
+    flushed.push_back(counter.name() + ":" + std::to_string(delta));
+  };
+  const StoreRoot::ChangedGaugeCb gauge_cb = [&](Gauge& gauge) -> void {
+    flushed.push_back(gauge.name() + ":" + std::to_string(gauge.value()));
+  };
+
+  ScopePtr scope1 = store_->createScope("scope1.");
+  EXPECT_CALL(*this, alloc(_)).Times(3);
+  Counter& c1 = store_->counter("c1");
+  Counter& c2 = scope1->counter("c2");
+  Gauge& g1 = store_->gauge("g1");
+
+  // Stats that were created but never changed are not visited.
+  store_->forEachChangedStat(counter_cb, gauge_cb);
+  EXPECT_TRUE(flushed.empty());
+
+  c1.add(2);
+  c2.inc();
+  g1.set(3);
+  store_->forEachChangedStat(counter_cb, gauge_cb);
+  EXPECT_EQ((std::vector<std::string>{"c1:2", "scope1.c2:1", "g1:3"}), flushed);
+
+  // The stats of a deleted scope are not kept alive by the changed stats.
+  flushed.clear();
+  c1.inc();
+  c2.inc();
+  EXPECT_CALL(main_thread_dispatcher_, post(_));
+  EXPECT_CALL(tls_, runOnAllThreads(_));
+  EXPECT_CALL(*this, free(_));
+  scope1.reset();
+  store_->forEachChangedStat(counter_cb, gauge_cb);
+  EXPECT_EQ((std::vector<std::string>{"c1:1"}), flushed);
 
   store_->shutdownThreading();
   tls_.shutdownThread();
@@ -287,6 +411,41 @@ TEST_F(StatsThreadLocalStoreTest, OverlappingScopes) {
   EXPECT_CALL(*this, free(_)).Times(3);
 }
 
+TEST_F(StatsThreadLocalStoreTest, ParentHistograms) {
+  InSequence s;
+  store_->initializeThreading(main_thread_dispatcher_, tls_);
+
+  // Samples of a parent process create the histogram, and only count towards its cumulative
+  // statistics.
+  store_->addParentHistogram("h", 15, {{5, 1}, {10, 1}});
+  HistogramSharedPtr h = findHistogram("h");
+  ASSERT_NE(nullptr, h);
+  EXPECT_EQ(2UL, h->cumulativeStatistics().sampleCount());
+  EXPECT_EQ(15UL, h->cumulativeStatistics().sampleSum());
+  EXPECT_EQ(10UL, h->cumulativeStatistics().quantile(1));
+
+  ScopePtr scope = store_->createScope("scope.");
+  scope->deliverHistogramToSinks("h", 20);
+  store_->deliverHistogramToSinks("h", 20);
+  h->merge();
+  EXPECT_EQ(1UL, h->intervalStatistics().sampleCount());
+  EXPECT_EQ(3UL, h->cumulativeStatistics().sampleCount());
+  EXPECT_EQ(35UL, h->cumulativeStatistics().sampleSum());
+
+  // Samples are added to an existing histogram too.
+  store_->addParentHistogram("scope.h", 40, {{40, 1}});
+  HistogramSharedPtr scope_h = findHistogram("scope.h");
+  scope_h->merge();
+  EXPECT_EQ(2UL, scope_h->cumulativeStatistics().sampleCount());
+  EXPECT_EQ(60UL, scope_h->cumulativeStatistics().sampleSum());
+
+  store_->shutdownThreading();
+  tls_.shutdownThread();
+
+  // Includes overflow stat.
+  EXPECT_CALL(*this, free(_));
+}
+
 TEST_F(StatsThreadLocalStoreTest, AllocFailed) {
   InSequence s;
   store_->initializeThreading(main_thread_dispatcher_, tls_);
@@ -315,6 +474,8 @@ TEST_F(StatsThreadLocalStoreTest, ShuttingDown) {
   store_->shutdownThreading();
   store_->counter("c2");
   store_->gauge("g2");
+  store_->deliverHistogramToSinks("h", 1);
+  EXPECT_EQ(0UL, store_->histograms().size());
 
   // c1, g1 should have a thread local ref, but c2, g2 should not.
   EXPECT_EQ(3L, findCounter("c1").use_count());
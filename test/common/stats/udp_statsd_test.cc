@@ -1,9 +1,15 @@
-#include <chrono>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
 
 #include "common/network/address_impl.h"
 #include "common/network/utility.h"
+#include "common/stats/histogram_impl.h"
 #include "common/stats/statsd.h"
 
+#include "test/mocks/stats/mocks.h"
 #include "test/mocks/thread_local/mocks.h"
 #include "test/test_common/environment.h"
 #include "test/test_common/network_utility.h"
@@ -32,10 +38,19 @@ TEST_P(UdpStatsdSinkTest, InitWithIpAddress) {
   int fd = sink.getFdForTests();
   EXPECT_NE(fd, -1);
 
+  NiceMock<MockCounter> counter;
+  counter.name_ = "test_counter";
+  NiceMock<MockGauge> gauge;
+  gauge.name_ = "test_gauge";
+  NiceMock<MockHistogram> histogram;
+  histogram.name_ = "test_histogram";
+
   // Check that fd has not changed.
-  sink.flushCounter("test_counter", 1);
-  sink.flushGauge("test_gauge", 1);
-  sink.onTimespanComplete("test_counter", std::chrono::milliseconds(5));
+  sink.flushCounter(counter, 1);
+  sink.beginFlush();
+  sink.flushGauge(gauge, 1);
+  sink.flushHistogram(histogram, HistogramStatisticsImpl());
+  sink.endFlush();
   EXPECT_EQ(fd, sink.getFdForTests());
 
   if (GetParam() == Network::Address::IpVersion::v4) {
@@ -46,6 +61,49 @@ TEST_P(UdpStatsdSinkTest, InitWithIpAddress) {
   tls_.shutdownThread();
 }
 
+TEST_P(UdpStatsdSinkTest, Batching) {
+  NiceMock<ThreadLocal::MockInstance> tls_;
+  std::pair<Network::Address::InstanceConstSharedPtr, int> server =
+      Network::Test::bindFreeLoopbackPort(GetParam(), Network::Address::SocketType::Datagram);
+  UdpStatsdSink sink(tls_, server.first, 30);
+
+  NiceMock<MockCounter> c1, c2, c3;
+  c1.name_ = "c1";
+  c2.name_ = "c2";
+  c3.name_ = "c3";
+  NiceMock<MockGauge> g1, g2;
+  g1.name_ = "g1";
+  g2.name_ = std::string(50, 'a');
+
+  // Nothing is sent until the end of the flush.
+  sink.beginFlush();
+  sink.flushCounter(c1, 1);
+  sink.flushGauge(g1, 2);
+  sink.flushCounter(c2, 3);
+  sink.flushGauge(g2, 4);
+  sink.flushCounter(c3, 5);
+  char buffer[128];
+  EXPECT_EQ(-1, recv(server.second, buffer, sizeof(buffer), MSG_DONTWAIT));
+  sink.endFlush();
+
+  // Metrics are packed up to the maximum datagram size. A metric that is too large on its own is
+  // sent in a datagram by itself.
+  std::vector<std::string> datagrams;
+  for (int i = 0; i < 4; i++) {
+    ssize_t rc = recv(server.second, buffer, sizeof(buffer), 0);
+    ASSERT_GT(rc, 0);
+    datagrams.emplace_back(buffer, rc);
+  }
+  EXPECT_EQ("envoy.c1:1|c\nenvoy.g1:2|g", datagrams[0]);
+  EXPECT_EQ("envoy.c2:3|c", datagrams[1]);
+  EXPECT_EQ("envoy." + std::string(50, 'a') + ":4|g", datagrams[2]);
+  EXPECT_EQ("envoy.c3:5|c", datagrams[3]);
+  EXPECT_EQ(-1, recv(server.second, buffer, sizeof(buffer), MSG_DONTWAIT));
+
+  tls_.shutdownThread();
+  close(server.second);
+}
+
 } // Statsd
 } // Stats
 } // Envoy
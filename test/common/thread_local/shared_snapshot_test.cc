@@ -0,0 +1,89 @@
+#include <memory>
+
+#include "common/thread_local/shared_snapshot.h"
+
+#include "test/mocks/event/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::Invoke;
+using testing::NiceMock;
+using testing::SaveArg;
+using testing::_;
+
+namespace Envoy {
+namespace ThreadLocal {
+
+class TestSnapshotObject : public ThreadLocalObject {
+public:
+  // ThreadLocal::ThreadLocalObject
+  void shutdown() override {}
+};
+
+TEST(SharedSnapshotTest, WorkerSwapsFromItsEventLoop) {
+  NiceMock<MockInstance> tls;
+  NiceMock<Event::MockDispatcher> worker_dispatcher;
+
+  // Keep the initialize callback so that a second thread's copy can be created.
+  Instance::InitializeCb initialize;
+  EXPECT_CALL(tls, set(_, _))
+      .WillOnce(Invoke([&](uint32_t index, Instance::InitializeCb cb) -> void {
+        initialize = cb;
+        tls.data_[index] = cb(tls.dispatcher_);
+      }));
+
+  std::shared_ptr<TestSnapshotObject> first(new TestSnapshotObject());
+  SharedSnapshot snapshot(tls, first);
+  EXPECT_EQ(first.get(), &snapshot.getTyped<TestSnapshotObject>());
+  ThreadLocalObjectSharedPtr worker_copy = initialize(worker_dispatcher);
+
+  // The main thread sees a published object right away.
+  std::shared_ptr<TestSnapshotObject> second(new TestSnapshotObject());
+  snapshot.publish(second);
+  EXPECT_EQ(second.get(), snapshot.get().get());
+
+  // The worker keeps its object until its dispatcher runs a single refresh.
+  tls.data_[0] = worker_copy;
+  Event::PostCb refresh;
+  EXPECT_CALL(worker_dispatcher, post(_)).WillOnce(SaveArg<0>(&refresh));
+  EXPECT_EQ(first.get(), snapshot.get().get());
+  EXPECT_EQ(first.get(), snapshot.get().get());
+  refresh();
+  EXPECT_EQ(second.get(), snapshot.get().get());
+  EXPECT_EQ(1, first.use_count());
+
+  // Nothing more is posted until the next publish.
+  EXPECT_CALL(worker_dispatcher, post(_)).Times(0);
+  EXPECT_EQ(second.get(), snapshot.get().get());
+}
+
+TEST(SharedSnapshotTest, RefreshAfterThreadExit) {
+  NiceMock<MockInstance> tls;
+  NiceMock<Event::MockDispatcher> worker_dispatcher;
+  Instance::InitializeCb initialize;
+  EXPECT_CALL(tls, set(_, _))
+      .WillOnce(Invoke([&](uint32_t index, Instance::InitializeCb cb) -> void {
+        initialize = cb;
+        tls.data_[index] = cb(tls.dispatcher_);
+      }));
+
+  std::shared_ptr<TestSnapshotObject> first(new TestSnapshotObject());
+  SharedSnapshot snapshot(tls, first);
+  ThreadLocalObjectSharedPtr worker_copy = initialize(worker_dispatcher);
+  snapshot.publish(ThreadLocalObjectSharedPtr{new TestSnapshotObject()});
+
+  tls.data_[0] = std::move(worker_copy);
+  Event::PostCb refresh;
+  EXPECT_CALL(worker_dispatcher, post(_)).WillOnce(SaveArg<0>(&refresh));
+  snapshot.get();
+
+  // The worker's copy is gone by the time its dispatcher gets to the refresh.
+  tls.data_.erase(0);
+  refresh();
+  EXPECT_EQ(1, first.use_count());
+}
+
+} // ThreadLocal
+} // Envoy
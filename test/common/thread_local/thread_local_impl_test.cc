@@ -0,0 +1,56 @@
+#include <memory>
+
+#include "common/thread_local/thread_local_impl.h"
+
+#include "test/mocks/event/mocks.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::InSequence;
+using testing::NiceMock;
+
+namespace Envoy {
+namespace ThreadLocal {
+
+class TestThreadLocalObject : public ThreadLocalObject {
+public:
+  MOCK_METHOD0(shutdown, void());
+};
+
+TEST(ThreadLocalInstanceImplTest, All) {
+  InSequence s;
+
+  InstanceImpl tls;
+  NiceMock<Event::MockDispatcher> main_dispatcher;
+  tls.registerThread(main_dispatcher, true);
+
+  std::shared_ptr<TestThreadLocalObject> object1(new TestThreadLocalObject());
+  std::shared_ptr<TestThreadLocalObject> object2(new TestThreadLocalObject());
+  const uint32_t slot1 = tls.allocateSlot();
+  const uint32_t slot2 = tls.allocateSlot();
+  EXPECT_NE(slot1, slot2);
+
+  tls.set(slot1, [object1](Event::Dispatcher&) -> ThreadLocalObjectSharedPtr { return object1; });
+  tls.set(slot2, [object2](Event::Dispatcher&) -> ThreadLocalObjectSharedPtr { return object2; });
+
+  // Reading a slot does not take a reference on the object.
+  EXPECT_EQ(2, object1.use_count());
+  EXPECT_EQ(object1.get(), &tls.getTyped<TestThreadLocalObject>(slot1));
+  EXPECT_EQ(object1.get(), tls.get(slot1).get());
+  EXPECT_EQ(2, object1.use_count());
+  EXPECT_EQ(object2.get(), &tls.getTyped<TestThreadLocalObject>(slot2));
+
+  // Setting the slot again releases the previous object.
+  std::shared_ptr<TestThreadLocalObject> object3(new TestThreadLocalObject());
+  tls.set(slot1, [object3](Event::Dispatcher&) -> ThreadLocalObjectSharedPtr { return object3; });
+  EXPECT_EQ(1, object1.use_count());
+  EXPECT_EQ(object3.get(), &tls.getTyped<TestThreadLocalObject>(slot1));
+
+  EXPECT_CALL(*object3, shutdown());
+  EXPECT_CALL(*object2, shutdown());
+  tls.shutdownThread();
+}
+
+} // ThreadLocal
+} // Envoy
@@ -1,5 +1,8 @@
+#include "common/buffer/buffer_impl.h"
 #include "common/tracing/zipkin/span_buffer.h"
 
+#include "test/test_common/utility.h"
+
 #include "gtest/gtest.h"
 
 namespace Envoy {
@@ -101,5 +104,59 @@ TEST(ZipkinSpanBufferTest, sizeConstructorEndtoEnd) {
   EXPECT_EQ(0ULL, buffer.pendingSpans());
   EXPECT_EQ("[]", buffer.toStringifiedJsonArray());
 }
+
+TEST(ZipkinSpanBufferTest, full) {
+  SpanBuffer buffer(1);
+
+  EXPECT_TRUE(buffer.addSpan(Span()));
+  EXPECT_FALSE(buffer.addSpan(Span()));
+  EXPECT_EQ(1ULL, buffer.pendingSpans());
+}
+
+TEST(ZipkinSpanBufferTest, moveToJson) {
+  SpanBuffer buffer(2);
+  Buffer::OwnedImpl body;
+
+  buffer.addSpan(Span());
+  buffer.addSpan(Span());
+  buffer.moveTo(body);
+  EXPECT_EQ(0ULL, buffer.pendingSpans());
+  EXPECT_EQ("["
+            "{"
+            R"("traceId":"0000000000000000",)"
+            R"("name":"",)"
+            R"("id":"0000000000000000",)"
+            R"("annotations":[],)"
+            R"("binaryAnnotations":[])"
+            "},"
+            "{"
+            R"("traceId":"0000000000000000",)"
+            R"("name":"",)"
+            R"("id":"0000000000000000",)"
+            R"("annotations":[],)"
+            R"("binaryAnnotations":[])"
+            "}]",
+            TestUtility::bufferToString(body));
+}
+
+TEST(ZipkinSpanBufferTest, moveToThrift) {
+  SpanBuffer buffer(2, SpanEncoding::Thrift);
+  Buffer::OwnedImpl body;
+
+  buffer.addSpan(Span());
+  buffer.addSpan(Span());
+  buffer.moveTo(body);
+  EXPECT_EQ(0ULL, buffer.pendingSpans());
+
+  const std::string span("\x0a\x00\x01\x00\x00\x00\x00\x00\x00\x00\x00"
+                         "\x0b\x00\x03\x00\x00\x00\x00"
+                         "\x0a\x00\x04\x00\x00\x00\x00\x00\x00\x00\x00"
+                         "\x0f\x00\x06\x0c\x00\x00\x00\x00"
+                         "\x0f\x00\x08\x0c\x00\x00\x00\x00"
+                         "\x00",
+                         46);
+  EXPECT_EQ(std::string("\x0c\x00\x00\x00\x02", 5) + span + span,
+            TestUtility::bufferToString(body));
+}
 } // Zipkin
 } // Envoy
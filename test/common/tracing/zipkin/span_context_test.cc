@@ -233,5 +233,39 @@ TEST(ZipkinSpanContextTest, populateFromSpan) {
   EXPECT_EQ("25c6f38dd0600e78;56707c7b3e1092af;c49193ea42335d1c;cr;cs;sr;ss",
             span_context_6.serializeToString());
 }
+TEST(ZipkinSpanContextTest, populateFromInvalidString) {
+  const std::string valid = "25c6f38dd0600e78;56707c7b3e1092af;c49193ea42335d1c;cs";
+  SpanContext span_context;
+  span_context.populateFromString(valid);
+  EXPECT_EQ(valid, span_context.serializeToString());
+
+  // Each of these resets the context to its non-initialized state.
+  for (const std::string& invalid :
+       {std::string("25c6f38dd0600e78;56707c7b3e1092af"),
+        std::string("25c6f38dd0600e78;56707c7b3e1092af;c49193ea42335d1"),
+        std::string("25c6f38dd0600e7g;56707c7b3e1092af;c49193ea42335d1c"),
+        std::string("25c6f38dd0600e78,56707c7b3e1092af;c49193ea42335d1c"),
+        std::string("25c6f38dd0600e78;56707c7b3e1092af;c49193ea42335d1c;"),
+        std::string("25c6f38dd0600e78;56707c7b3e1092af;c49193ea42335d1c;cs;"),
+        std::string("25c6f38dd0600e78;56707c7b3e1092af;c49193ea42335d1c;xx"),
+        std::string("25c6f38dd0600e78;56707c7b3e1092af;c49193ea42335d1c;csr")}) {
+    span_context.populateFromString(valid);
+    span_context.populateFromString(invalid);
+    EXPECT_EQ(0ULL, span_context.trace_id()) << invalid;
+    EXPECT_FALSE(span_context.annotationSet().cs_) << invalid;
+    EXPECT_EQ("0000000000000000;0000000000000000;0000000000000000",
+              span_context.serializeToString());
+  }
+}
+
+TEST(ZipkinSpanContextTest, serializeTo) {
+  SpanContext span_context;
+  span_context.populateFromString("25c6f38dd0600e78;56707c7b3e1092af;c49193ea42335d1c;cs;cr;ss;sr");
+
+  char buffer[SpanContext::MAX_SERIALIZED_LENGTH];
+  EXPECT_EQ(SpanContext::MAX_SERIALIZED_LENGTH, span_context.serializeTo(buffer));
+  EXPECT_EQ("25c6f38dd0600e78;56707c7b3e1092af;c49193ea42335d1c;cr;cs;sr;ss",
+            std::string(buffer, sizeof(buffer)));
+}
 } // Zipkin
 } // Envoy
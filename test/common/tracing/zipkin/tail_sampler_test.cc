@@ -0,0 +1,120 @@
+#include <chrono>
+#include <vector>
+
+#include "common/tracing/zipkin/tail_sampler.h"
+
+#include "test/mocks/common.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::NiceMock;
+using testing::ReturnPointee;
+
+namespace Envoy {
+namespace Zipkin {
+
+class ZipkinTailSamplerTest : public testing::Test {
+public:
+  ZipkinTailSamplerTest() {
+    ON_CALL(time_source_, currentTime()).WillByDefault(ReturnPointee(&now_));
+  }
+
+  void initialize(uint64_t max_buffered_spans, uint64_t max_exports_per_second) {
+    limiter_.reset(new TailSamplingLimiter(max_exports_per_second, time_source_));
+    sampler_.reset(new TailSampler(
+        {std::chrono::milliseconds(100), max_buffered_spans, max_exports_per_second}, *limiter_,
+        time_source_));
+  }
+
+  // Returns a span of the given trace that started duration_ms ago.
+  Span span(uint64_t trace_id, uint64_t id, int64_t duration_ms) {
+    Span span;
+    span.setTraceId(trace_id);
+    span.setId(id);
+    span.setStartTime(std::chrono::duration_cast<std::chrono::microseconds>(
+                          (now_ - std::chrono::milliseconds(duration_ms)).time_since_epoch())
+                          .count());
+    return span;
+  }
+
+  TailSampler::Decision addSpan(const Span& span) {
+    return sampler_->addSpan(span, [this](const Span& exported) {
+      exported_.push_back(exported.id());
+    });
+  }
+
+  MonotonicTime now_{std::chrono::seconds(1000)};
+  NiceMock<MockMonotonicTimeSource> time_source_;
+  std::unique_ptr<TailSamplingLimiter> limiter_;
+  std::unique_ptr<TailSampler> sampler_;
+  std::vector<uint64_t> exported_;
+};
+
+TEST_F(ZipkinTailSamplerTest, FastSpansAreBuffered) {
+  initialize(10, 10);
+
+  EXPECT_EQ(TailSampler::Decision::Buffered, addSpan(span(1, 1, 10)));
+  EXPECT_EQ(TailSampler::Decision::Buffered, addSpan(span(2, 2, 99)));
+  EXPECT_TRUE(exported_.empty());
+}
+
+TEST_F(ZipkinTailSamplerTest, SlowSpanExportsItsTrace) {
+  initialize(10, 10);
+
+  addSpan(span(1, 1, 10));
+  addSpan(span(2, 2, 10));
+  addSpan(span(1, 3, 10));
+
+  EXPECT_EQ(TailSampler::Decision::Exported, addSpan(span(1, 4, 100)));
+  EXPECT_EQ(std::vector<uint64_t>({1, 3, 4}), exported_);
+
+  // The exported spans are not exported a second time.
+  exported_.clear();
+  EXPECT_EQ(TailSampler::Decision::Exported, addSpan(span(1, 5, 200)));
+  EXPECT_EQ(std::vector<uint64_t>({5}), exported_);
+}
+
+TEST_F(ZipkinTailSamplerTest, FailedSpanIsExported) {
+  initialize(10, 10);
+
+  Span failed = span(1, 1, 0);
+  failed.setError();
+  EXPECT_EQ(TailSampler::Decision::Exported, addSpan(failed));
+  EXPECT_EQ(std::vector<uint64_t>({1}), exported_);
+}
+
+TEST_F(ZipkinTailSamplerTest, OldestSpansAreOverwritten) {
+  initialize(2, 10);
+
+  addSpan(span(1, 1, 10));
+  addSpan(span(1, 2, 10));
+  addSpan(span(1, 3, 10));
+  addSpan(span(1, 4, 100));
+  EXPECT_EQ(std::vector<uint64_t>({2, 3, 4}), exported_);
+}
+
+TEST_F(ZipkinTailSamplerTest, NoBuffer) {
+  initialize(0, 10);
+
+  EXPECT_EQ(TailSampler::Decision::Buffered, addSpan(span(1, 1, 10)));
+  EXPECT_EQ(TailSampler::Decision::Exported, addSpan(span(1, 2, 100)));
+  EXPECT_EQ(std::vector<uint64_t>({2}), exported_);
+}
+
+TEST_F(ZipkinTailSamplerTest, ExportBudget) {
+  initialize(10, 2);
+
+  EXPECT_EQ(TailSampler::Decision::Exported, addSpan(span(1, 1, 100)));
+  EXPECT_EQ(TailSampler::Decision::Exported, addSpan(span(2, 2, 100)));
+  EXPECT_EQ(TailSampler::Decision::RateLimited, addSpan(span(3, 3, 100)));
+
+  // Tokens are refilled over time at the configured rate.
+  now_ += std::chrono::milliseconds(500);
+  EXPECT_EQ(TailSampler::Decision::Exported, addSpan(span(4, 4, 100)));
+  EXPECT_EQ(TailSampler::Decision::RateLimited, addSpan(span(5, 5, 100)));
+  EXPECT_EQ(std::vector<uint64_t>({1, 2, 4}), exported_);
+}
+
+} // Zipkin
+} // Envoy
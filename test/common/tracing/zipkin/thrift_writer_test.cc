@@ -0,0 +1,49 @@
+#include <string>
+
+#include "common/buffer/buffer_impl.h"
+#include "common/tracing/zipkin/thrift_writer.h"
+
+#include "test/test_common/utility.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Zipkin {
+
+TEST(ZipkinThriftWriterTest, Values) {
+  Buffer::OwnedImpl buffer;
+  ThriftWriter writer(buffer);
+
+  writer.writeBool(true);
+  writer.writeBool(false);
+  writer.writeI16(-2);
+  writer.writeI32(0x01020304);
+  writer.writeI64(0x0102030405060708);
+  writer.writeString("ab");
+  EXPECT_EQ(std::string("\x01\x00"
+                        "\xff\xfe"
+                        "\x01\x02\x03\x04"
+                        "\x01\x02\x03\x04\x05\x06\x07\x08"
+                        "\x00\x00\x00\x02"
+                        "ab",
+                        24),
+            TestUtility::bufferToString(buffer));
+}
+
+TEST(ZipkinThriftWriterTest, Containers) {
+  Buffer::OwnedImpl buffer;
+  ThriftWriter writer(buffer);
+
+  writer.writeFieldBegin(ThriftWriter::Type::List, 6);
+  writer.writeListBegin(ThriftWriter::Type::Struct, 3);
+  writer.writeFieldBegin(ThriftWriter::Type::I64, 0x0102);
+  writer.writeFieldStop();
+  EXPECT_EQ(std::string("\x0f\x00\x06"
+                        "\x0c\x00\x00\x00\x03"
+                        "\x0a\x01\x02"
+                        "\x00",
+                        12),
+            TestUtility::bufferToString(buffer));
+}
+} // Zipkin
+} // Envoy
@@ -1,9 +1,12 @@
+#include "common/buffer/buffer_impl.h"
 #include "common/common/utility.h"
 #include "common/network/address_impl.h"
 #include "common/network/utility.h"
 #include "common/tracing/zipkin/zipkin_core_constants.h"
 #include "common/tracing/zipkin/zipkin_core_types.h"
 
+#include "test/test_common/utility.h"
+
 #include "gtest/gtest.h"
 
 namespace Envoy {
@@ -559,5 +562,73 @@ TEST(ZipkinCoreTypesSpanTest, setTag) {
   EXPECT_EQ("key2", bann.key());
   EXPECT_EQ("value2", bann.value());
 }
+TEST(ZipkinCoreTypesEndpointTest, toThrift) {
+  Buffer::OwnedImpl buffer;
+  ThriftWriter writer(buffer);
+
+  Endpoint ep(std::string("s"), Network::Utility::parseInternetAddressAndPort("1.2.3.4:80"));
+  ep.toThrift(writer);
+  EXPECT_EQ(std::string("\x08\x00\x01\x01\x02\x03\x04"
+                        "\x06\x00\x02\x00\x50"
+                        "\x0b\x00\x03\x00\x00\x00\x01s"
+                        "\x00",
+                        21),
+            TestUtility::bufferToString(buffer));
+
+  buffer.drain(buffer.length());
+  ep.setAddress(Network::Utility::parseInternetAddressAndPort("[::1]:80"));
+  ep.toThrift(writer);
+  EXPECT_EQ(std::string("\x08\x00\x01\x00\x00\x00\x00"
+                        "\x06\x00\x02\x00\x50"
+                        "\x0b\x00\x03\x00\x00\x00\x01s"
+                        "\x0b\x00\x04\x00\x00\x00\x10"
+                        "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x01"
+                        "\x00",
+                        44),
+            TestUtility::bufferToString(buffer));
+}
+
+TEST(ZipkinCoreTypesSpanTest, toThrift) {
+  Buffer::OwnedImpl buffer;
+  ThriftWriter writer(buffer);
+
+  Endpoint ep;
+  Span span;
+  span.setTraceId(1);
+  span.setName("n");
+  span.setId(2);
+  span.setParentId(3);
+  span.addAnnotation(Annotation(4, "cs", ep));
+  span.addBinaryAnnotation(BinaryAnnotation("k", "v"));
+  span.setDuration(5);
+  span.toThrift(writer);
+
+  EXPECT_EQ(std::string("\x0a\x00\x01\x00\x00\x00\x00\x00\x00\x00\x01"
+                        "\x0b\x00\x03\x00\x00\x00\x01n"
+                        "\x0a\x00\x04\x00\x00\x00\x00\x00\x00\x00\x02"
+                        "\x0a\x00\x05\x00\x00\x00\x00\x00\x00\x00\x03"
+                        // Annotations.
+                        "\x0f\x00\x06\x0c\x00\x00\x00\x01"
+                        "\x0a\x00\x01\x00\x00\x00\x00\x00\x00\x00\x04"
+                        "\x0b\x00\x02\x00\x00\x00\x02"
+                        "cs"
+                        "\x0c\x00\x03"
+                        "\x08\x00\x01\x00\x00\x00\x00"
+                        "\x06\x00\x02\x00\x00"
+                        "\x0b\x00\x03\x00\x00\x00\x00"
+                        "\x00"
+                        "\x00"
+                        // Binary annotations.
+                        "\x0f\x00\x08\x0c\x00\x00\x00\x01"
+                        "\x0b\x00\x01\x00\x00\x00\x01k"
+                        "\x0b\x00\x02\x00\x00\x00\x01v"
+                        "\x08\x00\x03\x00\x00\x00\x06"
+                        "\x00"
+                        // Duration.
+                        "\x0a\x00\x0b\x00\x00\x00\x00\x00\x00\x00\x05"
+                        "\x00",
+                        137),
+            TestUtility::bufferToString(buffer));
+}
 } // Zipkin
 } // Envoy
@@ -237,6 +237,112 @@ TEST_F(ZipkinDriverTest, FlushSpansTimer) {
   EXPECT_EQ(1U, stats_.counter("tracing.zipkin.spans_sent").value());
 }
 
+TEST_F(ZipkinDriverTest, FlushSpansThrift) {
+  EXPECT_CALL(cm_, get("fake_cluster")).WillRepeatedly(Return(&cm_.thread_local_cluster_));
+  ON_CALL(runtime_.snapshot_, getInteger("tracing.zipkin.min_flush_spans", 5))
+      .WillByDefault(Return(1));
+
+  std::string thrift_config = R"EOF(
+    {
+     "collector_cluster": "fake_cluster",
+     "collector_endpoint": "/api/v1/spans",
+     "collector_encoding": "thrift"
+     }
+  )EOF";
+  Json::ObjectSharedPtr loader = Json::Factory::loadFromString(thrift_config);
+  setup(*loader, true);
+
+  Http::MockAsyncClientRequest request(&cm_.async_client_);
+  EXPECT_CALL(cm_.async_client_, send_(_, _, _))
+      .WillOnce(
+          Invoke([&](Http::MessagePtr& message, Http::AsyncClient::Callbacks&,
+                     const Optional<std::chrono::milliseconds>&) -> Http::AsyncClient::Request* {
+            EXPECT_STREQ("application/x-thrift",
+                         message->headers().ContentType()->value().c_str());
+            // A list of one struct.
+            EXPECT_EQ(std::string("\x0c\x00\x00\x00\x01", 5),
+                      TestUtility::bufferToString(*message->body()).substr(0, 5));
+
+            return &request;
+          }));
+
+  Tracing::SpanPtr span = driver_->startSpan(request_headers_, operation_name_, start_time_);
+  span->finishSpan();
+
+  EXPECT_EQ(1U, stats_.counter("tracing.zipkin.spans_sent").value());
+}
+
+TEST_F(ZipkinDriverTest, DropSpansWhenReportsArePending) {
+  ON_CALL(runtime_.snapshot_, getInteger("tracing.zipkin.min_flush_spans", 5))
+      .WillByDefault(Return(1));
+  ON_CALL(runtime_.snapshot_, getInteger("tracing.zipkin.max_pending_reports", 10))
+      .WillByDefault(Return(1));
+  setupValidDriver();
+
+  Http::MockAsyncClientRequest request(&cm_.async_client_);
+  Http::AsyncClient::Callbacks* callback;
+  EXPECT_CALL(cm_.async_client_, send_(_, _, _))
+      .WillOnce(
+          Invoke([&](Http::MessagePtr&, Http::AsyncClient::Callbacks& callbacks,
+                     const Optional<std::chrono::milliseconds>&) -> Http::AsyncClient::Request* {
+            callback = &callbacks;
+            return &request;
+          }));
+
+  // The first report is still outstanding when the second span is flushed.
+  Tracing::SpanPtr first_span = driver_->startSpan(request_headers_, operation_name_, start_time_);
+  first_span->finishSpan();
+  Tracing::SpanPtr second_span = driver_->startSpan(request_headers_, operation_name_, start_time_);
+  second_span->finishSpan();
+
+  EXPECT_EQ(1U, stats_.counter("tracing.zipkin.spans_sent").value());
+  EXPECT_EQ(1U, stats_.counter("tracing.zipkin.spans_dropped").value());
+
+  // Once the report completes spans are sent again.
+  callback->onSuccess(Http::MessagePtr{new Http::ResponseMessageImpl(
+      Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "202"}}})});
+  EXPECT_CALL(cm_.async_client_, send_(_, _, _)).WillOnce(Return(&request));
+  Tracing::SpanPtr third_span = driver_->startSpan(request_headers_, operation_name_, start_time_);
+  third_span->finishSpan();
+
+  EXPECT_EQ(2U, stats_.counter("tracing.zipkin.spans_sent").value());
+  EXPECT_EQ(1U, stats_.counter("tracing.zipkin.spans_dropped").value());
+}
+
+TEST_F(ZipkinDriverTest, TailSampling) {
+  EXPECT_CALL(cm_, get("fake_cluster")).WillRepeatedly(Return(&cm_.thread_local_cluster_));
+  ON_CALL(runtime_.snapshot_, getInteger("tracing.zipkin.min_flush_spans", 5))
+      .WillByDefault(Return(1));
+
+  std::string tail_sampling_config = R"EOF(
+    {
+     "collector_cluster": "fake_cluster",
+     "tail_sampling": {
+       "latency_threshold_ms": 3600000
+     }
+    }
+  )EOF";
+  Json::ObjectSharedPtr loader = Json::Factory::loadFromString(tail_sampling_config);
+  setup(*loader, true);
+
+  // A fast span is buffered and not sent.
+  EXPECT_CALL(random_, random()).WillOnce(Return(1)).WillOnce(Return(2));
+  EXPECT_CALL(cm_.async_client_, send_(_, _, _)).Times(0);
+  Tracing::SpanPtr fast_span = driver_->startSpan(request_headers_, operation_name_, start_time_);
+  fast_span->finishSpan();
+  EXPECT_EQ(0U, stats_.counter("tracing.zipkin.spans_sent").value());
+
+  // A failed span of another trace is sent on its own.
+  Http::MockAsyncClientRequest request(&cm_.async_client_);
+  EXPECT_CALL(cm_.async_client_, send_(_, _, _)).WillOnce(Return(&request));
+  Tracing::SpanPtr failed_span =
+      driver_->startSpan(request_headers_, operation_name_, start_time_);
+  failed_span->setTag("error", "true");
+  failed_span->finishSpan();
+  EXPECT_EQ(1U, stats_.counter("tracing.zipkin.spans_sent").value());
+  EXPECT_EQ(1U, stats_.counter("tracing.zipkin.tail_sampling_exported").value());
+}
+
 TEST_F(ZipkinDriverTest, SerializeAndDeserializeContext) {
   setupValidDriver();
 
@@ -0,0 +1,58 @@
+#include <cstdint>
+#include <vector>
+
+#include "common/upstream/alias_table.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Upstream {
+
+TEST(AliasTableTest, Empty) { EXPECT_EQ(0U, AliasTable().size()); }
+
+TEST(AliasTableTest, EqualWeights) {
+  AliasTable table({1, 1, 1});
+  EXPECT_EQ(3U, table.size());
+  for (uint64_t i = 0; i < 3 * AliasTable::Scale; i++) {
+    // Every column is full, so each index keeps its own column.
+    EXPECT_EQ(i % 3, table.pick(i));
+  }
+}
+
+TEST(AliasTableTest, Columns) {
+  // Average weight is 2, so index 1 fills half of its column and donates the rest to index 0.
+  AliasTable table({3, 1});
+  EXPECT_EQ(0U, table.pick(0));
+  EXPECT_EQ(1U, table.pick(1));
+  EXPECT_EQ(1U, table.pick(1 + 2 * (AliasTable::Scale / 2 - 1)));
+  EXPECT_EQ(0U, table.pick(1 + 2 * (AliasTable::Scale / 2)));
+}
+
+TEST(AliasTableTest, ZeroWeight) {
+  AliasTable table({0, 5, 0});
+  for (uint64_t i = 0; i < 3 * AliasTable::Scale; i += 7) {
+    EXPECT_EQ(1U, table.pick(i));
+  }
+}
+
+TEST(AliasTableTest, Distribution) {
+  const std::vector<uint64_t> weights = {1, 2, 3, 4, 10, 100};
+  AliasTable table(weights);
+
+  // Walking every random value in [0, size * Scale) visits each column/coin pair exactly once, so
+  // the counts are the exact per index probabilities of the table.
+  std::vector<uint64_t> counts(weights.size());
+  for (uint64_t i = 0; i < weights.size() * AliasTable::Scale; i++) {
+    counts[table.pick(i)]++;
+  }
+
+  const uint64_t total_weight = 120;
+  for (size_t i = 0; i < weights.size(); i++) {
+    const double expected = static_cast<double>(weights[i]) / total_weight;
+    EXPECT_NEAR(expected, static_cast<double>(counts[i]) / (weights.size() * AliasTable::Scale),
+                0.001);
+  }
+}
+
+} // Upstream
+} // Envoy
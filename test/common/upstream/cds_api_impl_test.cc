@@ -1,13 +1,17 @@
+#include <array>
 #include <chrono>
 #include <string>
 #include <vector>
 
+#include "common/filesystem/filesystem_impl.h"
+#include "common/grpc/codec.h"
 #include "common/http/message_impl.h"
 #include "common/json/json_loader.h"
 #include "common/upstream/cds_api_impl.h"
 
 #include "test/mocks/local_info/mocks.h"
 #include "test/mocks/upstream/mocks.h"
+#include "test/test_common/environment.h"
 #include "test/test_common/printers.h"
 #include "test/test_common/utility.h"
 
@@ -69,6 +73,13 @@ public:
             }));
   }
 
+  void addFrame(Buffer::Instance& buffer, const std::string& body, uint8_t flags) {
+    std::array<uint8_t, 5> header;
+    Grpc::Encoder().newFrame(flags, body.size(), header);
+    buffer.add(header.data(), header.size());
+    buffer.add(body);
+  }
+
   ClusterManager::ClusterInfoMap makeClusterMap(std::vector<std::string> clusters) {
     ClusterManager::ClusterInfoMap map;
     for (auto cluster : clusters) {
@@ -111,6 +122,7 @@ TEST_F(CdsApiImplTest, Basic) {
   InSequence s;
 
   setup();
+  EXPECT_FALSE(cds_->requestCluster("cluster3"));
 
   std::string response1_json = R"EOF(
   {
@@ -165,6 +177,109 @@ TEST_F(CdsApiImplTest, Basic) {
 
   EXPECT_EQ(2UL, store_.counter("cluster_manager.cds.update_attempt").value());
   EXPECT_EQ(2UL, store_.counter("cluster_manager.cds.update_success").value());
+
+  expectRequest();
+  interval_timer_->callback_();
+
+  // An unchanged response is neither parsed nor applied.
+  message.reset(new Http::ResponseMessageImpl(
+      Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "200"}}}));
+  message->body().reset(new Buffer::OwnedImpl(response2_json));
+
+  EXPECT_CALL(cm_, clusters()).Times(0);
+  EXPECT_CALL(cm_, addOrUpdatePrimaryCluster(_)).Times(0);
+  EXPECT_CALL(*interval_timer_, enableTimer(_));
+  callbacks_->onSuccess(std::move(message));
+
+  EXPECT_EQ(3UL, store_.counter("cluster_manager.cds.update_attempt").value());
+  EXPECT_EQ(3UL, store_.counter("cluster_manager.cds.update_success").value());
+}
+
+TEST_F(CdsApiImplTest, OnDemand) {
+  std::string config_json = R"EOF(
+  {
+    "cds": {
+      "cluster": {
+        "name": "foo_cluster"
+      },
+      "on_demand": true
+    }
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(config_json);
+  cds_ = CdsApiImpl::create(*config, cm_, dispatcher_, random_, local_info_, store_);
+  std::vector<std::string> completed;
+  cds_->setClusterRequestCompleteCb(
+      [&completed](const std::string& cluster) -> void { completed.push_back(cluster); });
+
+  Http::MockAsyncClientRequest on_demand_request(&cm_.async_client_);
+  Http::AsyncClient::Callbacks* on_demand_callbacks{};
+  const auto expect_on_demand_request = [&](const std::string& path) -> void {
+    EXPECT_CALL(cm_, httpAsyncClientForCluster("foo_cluster"));
+    EXPECT_CALL(cm_.async_client_, send_(_, _, _))
+        .WillOnce(Invoke([&, path](Http::MessagePtr& request,
+                                   Http::AsyncClient::Callbacks& callbacks,
+                                   const Optional<std::chrono::milliseconds>&)
+                             -> Http::AsyncClient::Request* {
+          EXPECT_EQ((Http::TestHeaderMapImpl{
+                        {":method", "GET"}, {":path", path}, {":authority", "foo_cluster"}}),
+                    request->headers());
+          on_demand_callbacks = &callbacks;
+          return &on_demand_request;
+        }));
+  };
+
+  // A request for a cluster that is already being fetched joins the fetch.
+  EXPECT_CALL(dispatcher_, post(_)).Times(2);
+  expect_on_demand_request("/v1/clusters/cluster_name/node_name/cluster3");
+  EXPECT_TRUE(cds_->requestCluster("cluster3"));
+  EXPECT_TRUE(cds_->requestCluster("cluster3"));
+
+  Http::MessagePtr message(new Http::ResponseMessageImpl(
+      Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "200"}}}));
+  message->body().reset(new Buffer::OwnedImpl(R"EOF({"clusters": [{"name": "cluster3"}]})EOF"));
+  expectAdd("cluster3");
+  on_demand_callbacks->onSuccess(std::move(message));
+  EXPECT_EQ(std::vector<std::string>{"cluster3"}, completed);
+  EXPECT_EQ(1UL, store_.counter("cluster_manager.cds.on_demand_attempt").value());
+  EXPECT_EQ(1UL, store_.counter("cluster_manager.cds.on_demand_success").value());
+
+  // Clusters fetched on demand are kept when the periodic fetch does not return them.
+  expectRequest();
+  cds_->initialize();
+  message.reset(new Http::ResponseMessageImpl(
+      Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "200"}}}));
+  message->body().reset(new Buffer::OwnedImpl(R"EOF({"clusters": [{"name": "cluster1"}]})EOF"));
+  EXPECT_CALL(cm_, clusters()).WillOnce(Return(makeClusterMap({"cluster3"})));
+  expectAdd("cluster1");
+  EXPECT_CALL(cm_, removePrimaryCluster(_)).Times(0);
+  EXPECT_CALL(*interval_timer_, enableTimer(_));
+  callbacks_->onSuccess(std::move(message));
+
+  // Failed fetches complete too.
+  EXPECT_CALL(dispatcher_, post(_));
+  expect_on_demand_request("/v1/clusters/cluster_name/node_name/cluster4");
+  EXPECT_TRUE(cds_->requestCluster("cluster4"));
+  message.reset(new Http::ResponseMessageImpl(
+      Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "404"}}}));
+  on_demand_callbacks->onSuccess(std::move(message));
+
+  EXPECT_CALL(dispatcher_, post(_));
+  expect_on_demand_request("/v1/clusters/cluster_name/node_name/cluster5");
+  EXPECT_TRUE(cds_->requestCluster("cluster5"));
+  on_demand_callbacks->onFailure(Http::AsyncClient::FailureReason::Reset);
+
+  EXPECT_EQ((std::vector<std::string>{"cluster3", "cluster4", "cluster5"}), completed);
+  EXPECT_EQ(3UL, store_.counter("cluster_manager.cds.on_demand_attempt").value());
+  EXPECT_EQ(2UL, store_.counter("cluster_manager.cds.on_demand_failure").value());
+
+  // In flight fetches are cancelled with the API.
+  EXPECT_CALL(dispatcher_, post(_));
+  expect_on_demand_request("/v1/clusters/cluster_name/node_name/cluster6");
+  EXPECT_TRUE(cds_->requestCluster("cluster6"));
+  EXPECT_CALL(on_demand_request, cancel());
+  cds_.reset();
 }
 
 TEST_F(CdsApiImplTest, Failure) {
@@ -217,5 +332,218 @@ TEST_F(CdsApiImplTest, FailureArray) {
   EXPECT_EQ(1UL, store_.counter("cluster_manager.cds.update_failure").value());
 }
 
+TEST_F(CdsApiImplTest, Snapshot) {
+  InSequence s;
+
+  const std::string snapshot_path = TestEnvironment::temporaryPath("cds_snapshot");
+  unlink(snapshot_path.c_str());
+  std::string config_json = R"EOF(
+  {
+    "cds": {
+      "cluster": {
+        "name": "foo_cluster"
+      },
+      "snapshot_path": "{{ test_tmpdir }}/cds_snapshot"
+    }
+  }
+  )EOF";
+  Json::ObjectSharedPtr config =
+      Json::Factory::loadFromString(TestEnvironment::substitute(config_json));
+
+  const std::string response_json = R"EOF(
+  {
+    "clusters": [
+    {
+      "name": "cluster1"
+    }
+    ]
+  }
+  )EOF";
+
+  // Without a snapshot the API is initialized by the first fetch, which persists the response.
+  cds_ = CdsApiImpl::create(*config, cm_, dispatcher_, random_, local_info_, store_);
+  cds_->setInitializedCb([this]() -> void { initialized_.ready(); });
+  expectRequest();
+  cds_->initialize();
+
+  Http::MessagePtr message(new Http::ResponseMessageImpl(
+      Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "200"}}}));
+  message->body().reset(new Buffer::OwnedImpl(response_json));
+  EXPECT_CALL(cm_, clusters()).WillOnce(Return(ClusterManager::ClusterInfoMap{}));
+  expectAdd("cluster1");
+  EXPECT_CALL(initialized_, ready());
+  EXPECT_CALL(*interval_timer_, enableTimer(_));
+  callbacks_->onSuccess(std::move(message));
+  EXPECT_EQ(response_json, Filesystem::fileReadToEnd(snapshot_path));
+  EXPECT_EQ(0UL, store_.counter("cluster_manager.cds.snapshot_load").value());
+
+  // After a restart the snapshot initializes the API before the fetch, which finds it unchanged.
+  cds_.reset();
+  interval_timer_ = new Event::MockTimer(&dispatcher_);
+  cds_ = CdsApiImpl::create(*config, cm_, dispatcher_, random_, local_info_, store_);
+  cds_->setInitializedCb([this]() -> void { initialized_.ready(); });
+  EXPECT_CALL(cm_, clusters()).WillOnce(Return(ClusterManager::ClusterInfoMap{}));
+  expectAdd("cluster1");
+  EXPECT_CALL(initialized_, ready());
+  expectRequest();
+  cds_->initialize();
+  EXPECT_EQ(1UL, store_.counter("cluster_manager.cds.snapshot_load").value());
+
+  message.reset(new Http::ResponseMessageImpl(
+      Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "200"}}}));
+  message->body().reset(new Buffer::OwnedImpl(response_json));
+  EXPECT_CALL(cm_, addOrUpdatePrimaryCluster(_)).Times(0);
+  EXPECT_CALL(*interval_timer_, enableTimer(_));
+  callbacks_->onSuccess(std::move(message));
+
+  // A snapshot that cannot be parsed is ignored and the API waits for the fetch.
+  Filesystem::fileWriteAtomically(snapshot_path, "[]");
+  cds_.reset();
+  interval_timer_ = new Event::MockTimer(&dispatcher_);
+  cds_ = CdsApiImpl::create(*config, cm_, dispatcher_, random_, local_info_, store_);
+  cds_->setInitializedCb([this]() -> void { initialized_.ready(); });
+  expectRequest();
+  cds_->initialize();
+  EXPECT_EQ(1UL, store_.counter("cluster_manager.cds.snapshot_load_failure").value());
+
+  EXPECT_CALL(request_, cancel());
+  cds_.reset();
+}
+
+TEST_F(CdsApiImplTest, Stream) {
+  InSequence s;
+
+  std::string config_json = R"EOF(
+  {
+    "cds": {
+      "cluster": {
+        "name": "foo_cluster"
+      },
+      "api_type": "stream"
+    }
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(config_json);
+  cds_ = CdsApiImpl::create(*config, cm_, dispatcher_, random_, local_info_, store_);
+  cds_->setInitializedCb([this]() -> void { initialized_.ready(); });
+
+  Http::MockAsyncClientStream stream;
+  Http::AsyncClient::StreamCallbacks* stream_callbacks{};
+  Http::TestHeaderMapImpl stream_request{{":method", "GET"},
+                                         {":path", "/v1/clusters/cluster_name/node_name"},
+                                         {":authority", "foo_cluster"},
+                                         {"accept", "application/x-envoy-discovery-stream"}};
+  auto expectStream = [&]() -> void {
+    EXPECT_CALL(cm_, httpAsyncClientForCluster("foo_cluster"));
+    EXPECT_CALL(cm_.async_client_, start(_, _))
+        .WillOnce(Invoke([&](Http::AsyncClient::StreamCallbacks& callbacks,
+                             const Optional<std::chrono::milliseconds>& timeout)
+                             -> Http::AsyncClient::Stream* {
+                               EXPECT_FALSE(timeout.valid());
+                               stream_callbacks = &callbacks;
+                               return &stream;
+                             }));
+    EXPECT_CALL(stream, sendHeaders(HeaderMapEqualRef(&stream_request), true));
+  };
+
+  expectStream();
+  cds_->initialize();
+  stream_callbacks->onHeaders(
+      Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "200"}}}, false);
+
+  std::string response1_json = R"EOF(
+  {
+    "clusters": [
+    {
+      "name": "cluster1"
+    },
+    {
+      "name": "cluster2"
+    }
+    ]
+  }
+  )EOF";
+
+  // A body that is split across several data frames is applied once it is complete.
+  Buffer::OwnedImpl data;
+  addFrame(data, response1_json, Grpc::GRPC_FH_DEFAULT);
+  const uint64_t response1_length = data.length();
+  Buffer::OwnedImpl partial;
+  partial.move(data, 10);
+  stream_callbacks->onData(partial, false);
+
+  EXPECT_CALL(cm_, clusters()).WillOnce(Return(ClusterManager::ClusterInfoMap{}));
+  expectAdd("cluster1");
+  expectAdd("cluster2");
+  EXPECT_CALL(initialized_, ready());
+  stream_callbacks->onData(data, false);
+
+  std::string response2_json = R"EOF(
+  {
+    "clusters": [
+    {
+      "name": "cluster1"
+    }
+    ]
+  }
+  )EOF";
+
+  // Several bodies can arrive at once. An unchanged body is not applied.
+  addFrame(data, response2_json, Grpc::GRPC_FH_DEFAULT);
+  addFrame(data, response2_json, Grpc::GRPC_FH_DEFAULT);
+  const uint64_t response2_length = data.length();
+  EXPECT_CALL(cm_, clusters()).WillOnce(Return(makeClusterMap({"cluster1", "cluster2"})));
+  expectAdd("cluster1");
+  EXPECT_CALL(cm_, removePrimaryCluster("cluster2"));
+  stream_callbacks->onData(data, false);
+
+  EXPECT_EQ(1UL, store_.counter("cluster_manager.cds.update_attempt").value());
+  EXPECT_EQ(3UL, store_.counter("cluster_manager.cds.update_success").value());
+  EXPECT_EQ(response1_length + response2_length,
+            store_.counter("cluster_manager.cds.bytes_received").value());
+
+  // The stream is reopened after the jittered interval once the server closes it.
+  EXPECT_CALL(*interval_timer_, enableTimer(_));
+  stream_callbacks->onData(data, true);
+
+  expectStream();
+  interval_timer_->callback_();
+  stream_callbacks->onHeaders(
+      Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "200"}}}, false);
+
+  // Compressed bodies are not supported. The failed stream is reset before the next one starts.
+  addFrame(data, response2_json, Grpc::GRPC_FH_COMPRESSED);
+  EXPECT_CALL(*interval_timer_, enableTimer(_));
+  stream_callbacks->onData(data, false);
+  EXPECT_EQ(1UL, store_.counter("cluster_manager.cds.update_failure").value());
+
+  EXPECT_CALL(stream, reset());
+  expectStream();
+  interval_timer_->callback_();
+
+  // A non-200 response fails the stream.
+  EXPECT_CALL(*interval_timer_, enableTimer(_));
+  stream_callbacks->onHeaders(
+      Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "503"}}}, true);
+  EXPECT_EQ(2UL, store_.counter("cluster_manager.cds.update_failure").value());
+
+  // A reset stream is reopened as well.
+  expectStream();
+  interval_timer_->callback_();
+  EXPECT_CALL(*interval_timer_, enableTimer(_));
+  stream_callbacks->onReset();
+
+  EXPECT_EQ(4UL, store_.counter("cluster_manager.cds.update_attempt").value());
+  EXPECT_EQ(3UL, store_.counter("cluster_manager.cds.update_failure").value());
+  EXPECT_EQ(4UL, store_.counter("cluster_manager.cds.stream_start").value());
+
+  // An open stream is reset on destruction.
+  expectStream();
+  interval_timer_->callback_();
+  EXPECT_CALL(stream, reset());
+  cds_.reset();
+}
+
 } // Upstream
 } // Envoy
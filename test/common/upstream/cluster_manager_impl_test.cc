@@ -1,5 +1,7 @@
+#include <algorithm>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "envoy/upstream/upstream.h"
 
@@ -64,6 +66,8 @@ public:
     return CdsApiPtr{createCds_()};
   }
 
+  Network::DnsResolverSharedPtr dnsResolver() override { return dns_resolver_; }
+
   ClusterManagerPtr clusterManagerFromJson(const Json::Object& config, Stats::Store& stats,
                                            ThreadLocal::Instance& tls, Runtime::Loader& runtime,
                                            Runtime::RandomGenerator& random,
@@ -371,7 +375,7 @@ TEST_F(ClusterManagerImplTest, UnknownCluster) {
   EXPECT_EQ(nullptr, cluster_manager_->get("hello"));
   EXPECT_EQ(nullptr,
             cluster_manager_->httpConnPoolForCluster("hello", ResourcePriority::Default, nullptr));
-  EXPECT_THROW(cluster_manager_->tcpConnForCluster("hello"), EnvoyException);
+  EXPECT_THROW(cluster_manager_->tcpConnForCluster("hello", nullptr), EnvoyException);
   EXPECT_THROW(cluster_manager_->httpAsyncClientForCluster("hello"), EnvoyException);
   factory_.tls_.shutdownThread();
 }
@@ -399,7 +403,7 @@ TEST_F(ClusterManagerImplTest, VerifyBufferLimits) {
   Network::MockClientConnection* connection = new NiceMock<Network::MockClientConnection>();
   EXPECT_CALL(*connection, setReadBufferLimit(8192));
   EXPECT_CALL(factory_.tls_.dispatcher_, createClientConnection_(_)).WillOnce(Return(connection));
-  auto conn_data = cluster_manager_->tcpConnForCluster("cluster_1");
+  auto conn_data = cluster_manager_->tcpConnForCluster("cluster_1", nullptr);
   EXPECT_EQ(connection, conn_data.connection_.get());
   factory_.tls_.shutdownThread();
 }
@@ -427,14 +431,152 @@ TEST_F(ClusterManagerImplTest, ShutdownOrder) {
   EXPECT_EQ(cluster.hosts()[0],
             cluster_manager_->get("cluster_1")->loadBalancer().chooseHost(nullptr));
 
-  // Local reference, primary reference, thread local reference, host reference.
-  EXPECT_EQ(4U, cluster.info().use_count());
+  // Local reference, primary reference, thread local slot and entry references, host reference.
+  EXPECT_EQ(5U, cluster.info().use_count());
 
-  // Thread local reference should be gone.
+  // Thread local references should be gone.
   factory_.tls_.shutdownThread();
   EXPECT_EQ(3U, cluster.info().use_count());
 }
 
+TEST_F(ClusterManagerImplTest, LazyClusterEntries) {
+  std::string json = R"EOF(
+  {
+    "clusters": [
+    {
+      "name": "cluster_1",
+      "connect_timeout_ms": 250,
+      "type": "strict_dns",
+      "lb_type": "round_robin",
+      "hosts": [{"url": "tcp://localhost:11001"}]
+    }]
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr loader = Json::Factory::loadFromString(json);
+
+  Network::DnsResolver::ResolveCb dns_callback;
+  new NiceMock<Event::MockTimer>(&factory_.dispatcher_);
+  Network::MockActiveDnsQuery active_dns_query;
+  EXPECT_CALL(*factory_.dns_resolver_, resolve(_, _, _))
+      .WillOnce(DoAll(SaveArg<2>(&dns_callback), Return(&active_dns_query)));
+  create(*loader);
+  const Cluster& cluster = cluster_manager_->clusters().at("cluster_1");
+
+  // Hosts that arrive before the cluster is used only replace the thread local snapshot.
+  dns_callback(TestUtility::makeDnsResponse({"127.0.0.1", "127.0.0.2"}));
+  const long use_count = cluster.info().use_count();
+
+  // The first use creates the entry, which takes another reference, with the latest hosts.
+  ThreadLocalCluster* thread_local_cluster = cluster_manager_->get("cluster_1");
+  EXPECT_EQ(use_count + 1, cluster.info().use_count());
+  EXPECT_EQ(2UL, thread_local_cluster->hostSet().hosts().size());
+  EXPECT_EQ(2UL, thread_local_cluster->hostSet().healthyHosts().size());
+  EXPECT_NE(nullptr, thread_local_cluster->loadBalancer().chooseHost(nullptr));
+  EXPECT_EQ(thread_local_cluster, cluster_manager_->get("cluster_1"));
+  EXPECT_EQ(thread_local_cluster,
+            cluster_manager_->getById(cluster_manager_->clusterId("cluster_1")));
+
+  factory_.tls_.shutdownThread();
+}
+
+TEST_F(ClusterManagerImplTest, IdleClusterDrain) {
+  std::string json = R"EOF(
+  {
+    "idle_cluster_timeout_ms": 1000,
+    "clusters": [
+    {
+      "name": "idle",
+      "connect_timeout_ms": 250,
+      "type": "static",
+      "lb_type": "round_robin",
+      "hosts": [{"url": "tcp://127.0.0.1:11001"}]
+    },
+    {
+      "name": "busy",
+      "connect_timeout_ms": 250,
+      "type": "static",
+      "lb_type": "round_robin",
+      "hosts": [{"url": "tcp://127.0.0.1:11002"}]
+    }]
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr loader = Json::Factory::loadFromString(json);
+  Event::MockTimer* idle_timer = new Event::MockTimer(&factory_.tls_.dispatcher_);
+  EXPECT_CALL(*idle_timer, enableTimer(std::chrono::milliseconds(1000)));
+  create(*loader);
+
+  Http::ConnectionPool::MockInstance* idle_cp = new Http::ConnectionPool::MockInstance();
+  Http::ConnectionPool::MockInstance* busy_cp = new Http::ConnectionPool::MockInstance();
+  EXPECT_CALL(factory_, allocateConnPool_(_)).WillOnce(Return(idle_cp)).WillOnce(Return(busy_cp));
+  EXPECT_EQ(idle_cp,
+            cluster_manager_->httpConnPoolForCluster("idle", ResourcePriority::Default, nullptr));
+  EXPECT_EQ(busy_cp,
+            cluster_manager_->httpConnPoolForCluster("busy", ResourcePriority::Default, nullptr));
+
+  // Both clusters were used during the first interval.
+  EXPECT_CALL(*idle_timer, enableTimer(std::chrono::milliseconds(1000)));
+  idle_timer->callback_();
+
+  // Only the cluster that is not used during the next interval is drained.
+  EXPECT_EQ(busy_cp,
+            cluster_manager_->httpConnPoolForCluster("busy", ResourcePriority::Default, nullptr));
+  Http::ConnectionPool::Instance::DrainedCb drained_cb;
+  EXPECT_CALL(*idle_cp, addDrainedCallback(_)).WillOnce(SaveArg<0>(&drained_cb));
+  EXPECT_CALL(*idle_timer, enableTimer(std::chrono::milliseconds(1000)));
+  idle_timer->callback_();
+  EXPECT_CALL(factory_.tls_.dispatcher_, deferredDelete_(_)).Times(2);
+  drained_cb();
+  EXPECT_EQ(1UL, factory_.stats_.counter("cluster_manager.cluster_idle_drained").value());
+
+  // A drained cluster is not drained again while it stays idle.
+  EXPECT_CALL(*busy_cp, addDrainedCallback(_));
+  EXPECT_CALL(*idle_timer, enableTimer(std::chrono::milliseconds(1000)));
+  idle_timer->callback_();
+  EXPECT_EQ(2UL, factory_.stats_.counter("cluster_manager.cluster_idle_drained").value());
+
+  // The next request creates a new pool.
+  Http::ConnectionPool::MockInstance* new_cp = new Http::ConnectionPool::MockInstance();
+  EXPECT_CALL(factory_, allocateConnPool_(_)).WillOnce(Return(new_cp));
+  EXPECT_EQ(new_cp,
+            cluster_manager_->httpConnPoolForCluster("idle", ResourcePriority::Default, nullptr));
+
+  factory_.tls_.shutdownThread();
+}
+
+TEST_F(ClusterManagerImplTest, SharedLoadBalancerTables) {
+  std::string json = R"EOF(
+  {
+    "clusters": [
+    {
+      "name": "cluster_1",
+      "connect_timeout_ms": 250,
+      "type": "static",
+      "lb_type": "ring_hash",
+      "hosts": [{"url": "tcp://127.0.0.1:11001"}]
+    },
+    {
+      "name": "cluster_2",
+      "connect_timeout_ms": 250,
+      "type": "static",
+      "lb_type": "maglev",
+      "hosts": [{"url": "tcp://127.0.0.1:11002"}]
+    }]
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr loader = Json::Factory::loadFromString(json);
+  create(*loader);
+
+  // The thread local load balancers pick from the tables built on the main thread.
+  for (const std::string name : {"cluster_1", "cluster_2"}) {
+    const Cluster& cluster = cluster_manager_->clusters().at(name);
+    EXPECT_EQ(cluster.hosts()[0], cluster_manager_->get(name)->loadBalancer().chooseHost(nullptr));
+  }
+  factory_.tls_.shutdownThread();
+}
+
 TEST_F(ClusterManagerImplTest, InitializeOrder) {
   std::string json = R"EOF(
   {
@@ -468,6 +610,7 @@ TEST_F(ClusterManagerImplTest, InitializeOrder) {
   EXPECT_CALL(*cds_cluster, initialize());
   EXPECT_CALL(factory_, createCds_()).WillOnce(Return(cds));
   EXPECT_CALL(*cds, setInitializedCb(_));
+  EXPECT_CALL(*cds, setClusterRequestCompleteCb(_));
   EXPECT_CALL(factory_, clusterFromJson_(_, _, _, _)).WillOnce(Return(cluster1));
   ON_CALL(*cluster1, initializePhase()).WillByDefault(Return(Cluster::InitializePhase::Primary));
   EXPECT_CALL(*cluster1, initialize());
@@ -558,6 +701,12 @@ TEST_F(ClusterManagerImplTest, DynamicAddRemove) {
   EXPECT_CALL(initialized, ready());
   cluster_manager_->setInitializedCb([&]() -> void { initialized.ready(); });
 
+  // IDs can be resolved before the cluster exists and stay the same across updates.
+  const ClusterId id = cluster_manager_->clusterId("fake_cluster");
+  EXPECT_EQ(id, cluster_manager_->clusterId("fake_cluster"));
+  EXPECT_NE(id, cluster_manager_->clusterId("other_cluster"));
+  EXPECT_EQ(nullptr, cluster_manager_->getById(id));
+
   std::string json_api = R"EOF(
   {
     "name": "fake_cluster"
@@ -572,6 +721,7 @@ TEST_F(ClusterManagerImplTest, DynamicAddRemove) {
   EXPECT_TRUE(cluster_manager_->addOrUpdatePrimaryCluster(*loader_api));
 
   EXPECT_EQ(cluster1->info_, cluster_manager_->get("fake_cluster")->info());
+  EXPECT_EQ(cluster_manager_->get("fake_cluster"), cluster_manager_->getById(id));
   EXPECT_EQ(1UL, factory_.stats_.gauge("cluster_manager.total_clusters").value());
 
   // Now try to update again but with the same hash (different white space).
@@ -602,6 +752,7 @@ TEST_F(ClusterManagerImplTest, DynamicAddRemove) {
   EXPECT_TRUE(cluster_manager_->addOrUpdatePrimaryCluster(*loader_api));
 
   EXPECT_EQ(cluster2->info_, cluster_manager_->get("fake_cluster")->info());
+  EXPECT_EQ(cluster_manager_->get("fake_cluster"), cluster_manager_->getById(id));
   EXPECT_EQ(1UL, cluster_manager_->clusters().size());
   Http::ConnectionPool::MockInstance* cp = new Http::ConnectionPool::MockInstance();
   EXPECT_CALL(factory_, allocateConnPool_(_)).WillOnce(Return(cp));
@@ -613,6 +764,7 @@ TEST_F(ClusterManagerImplTest, DynamicAddRemove) {
   EXPECT_CALL(*cp, addDrainedCallback(_)).WillOnce(SaveArg<0>(&drained_cb));
   EXPECT_TRUE(cluster_manager_->removePrimaryCluster("fake_cluster"));
   EXPECT_EQ(nullptr, cluster_manager_->get("fake_cluster"));
+  EXPECT_EQ(nullptr, cluster_manager_->getById(id));
   EXPECT_EQ(0UL, cluster_manager_->clusters().size());
 
   // Remove an unknown cluster.
@@ -626,6 +778,58 @@ TEST_F(ClusterManagerImplTest, DynamicAddRemove) {
   EXPECT_EQ(0UL, factory_.stats_.gauge("cluster_manager.total_clusters").value());
 }
 
+TEST_F(ClusterManagerImplTest, DiscoverCluster) {
+  Json::ObjectSharedPtr loader = Json::Factory::loadFromString(R"EOF({"clusters": []})EOF");
+  MockCdsApi* cds = new NiceMock<MockCdsApi>();
+  std::function<void(const std::string&)> complete_cb;
+  EXPECT_CALL(factory_, createCds_()).WillOnce(Return(cds));
+  EXPECT_CALL(*cds, setClusterRequestCompleteCb(_)).WillOnce(SaveArg<0>(&complete_cb));
+  create(*loader);
+
+  // Nothing is discovered if on demand fetches are not enabled.
+  EXPECT_CALL(*cds, requestCluster("cluster_1")).WillOnce(Return(false));
+  EXPECT_EQ(nullptr, cluster_manager_->discoverCluster("cluster_1", []() -> void {}));
+
+  // Only the first discovery of a cluster starts a fetch.
+  ReadyWatcher discovered1;
+  ReadyWatcher discovered2;
+  ReadyWatcher cancelled;
+  EXPECT_CALL(*cds, requestCluster("cluster_1")).WillOnce(Return(true));
+  ClusterDiscoveryRequest* request1 =
+      cluster_manager_->discoverCluster("cluster_1", [&]() -> void { discovered1.ready(); });
+  ClusterDiscoveryRequest* request2 =
+      cluster_manager_->discoverCluster("cluster_1", [&]() -> void { cancelled.ready(); });
+  ClusterDiscoveryRequest* request3 =
+      cluster_manager_->discoverCluster("cluster_1", [&]() -> void { discovered2.ready(); });
+  EXPECT_NE(nullptr, request1);
+  ASSERT_NE(nullptr, request2);
+  EXPECT_NE(nullptr, request3);
+  request2->cancel();
+
+  // The cluster that the fetch found is known by the time the requests complete.
+  MockCluster* cluster1 = new NiceMock<MockCluster>();
+  cluster1->info_->name_ = "cluster_1";
+  EXPECT_CALL(factory_, clusterFromJson_(_, _, _, _)).WillOnce(Return(cluster1));
+  EXPECT_TRUE(cluster_manager_->addOrUpdatePrimaryCluster(
+      *Json::Factory::loadFromString(R"EOF({"name": "cluster_1"})EOF")));
+  EXPECT_CALL(discovered1, ready()).WillOnce(Invoke([&]() -> void {
+    EXPECT_EQ(cluster1->info_, cluster_manager_->get("cluster_1")->info());
+  }));
+  EXPECT_CALL(discovered2, ready());
+  EXPECT_CALL(cancelled, ready()).Times(0);
+  complete_cb("cluster_1");
+
+  // Completions without waiting requests are ignored, and a later discovery fetches again.
+  complete_cb("cluster_1");
+  EXPECT_CALL(*cds, requestCluster("cluster_2")).WillOnce(Return(true));
+  EXPECT_NE(nullptr, cluster_manager_->discoverCluster("cluster_2", [&]() -> void {
+    cancelled.ready();
+  }));
+
+  // Discoveries that are still waiting are dropped when the thread shuts down.
+  factory_.tls_.shutdownThread();
+}
+
 TEST_F(ClusterManagerImplTest, AddOrUpdatePrimaryClusterStaticExists) {
   std::string json = R"EOF(
   {
@@ -692,7 +896,7 @@ TEST_F(ClusterManagerImplTest, DynamicHostRemove) {
   // Test for no hosts returning the correct values before we have hosts.
   EXPECT_EQ(nullptr, cluster_manager_->httpConnPoolForCluster("cluster_1",
                                                               ResourcePriority::Default, nullptr));
-  EXPECT_EQ(nullptr, cluster_manager_->tcpConnForCluster("cluster_1").connection_);
+  EXPECT_EQ(nullptr, cluster_manager_->tcpConnForCluster("cluster_1", nullptr).connection_);
   EXPECT_EQ(2UL, factory_.stats_.counter("cluster.cluster_1.upstream_cx_none_healthy").value());
 
   // Set up for an initialize callback.
@@ -757,6 +961,214 @@ TEST_F(ClusterManagerImplTest, DynamicHostRemove) {
   factory_.tls_.shutdownThread();
 }
 
+TEST_F(ClusterManagerImplTest, BatchedMembershipUpdates) {
+  std::string json = R"EOF(
+  {
+    "clusters": [
+    {
+      "name": "cluster_1",
+      "connect_timeout_ms": 250,
+      "type": "strict_dns",
+      "lb_type": "round_robin",
+      "hosts": [{"url": "tcp://cluster_1:11001"}]
+    },
+    {
+      "name": "cluster_2",
+      "connect_timeout_ms": 250,
+      "type": "strict_dns",
+      "lb_type": "round_robin",
+      "hosts": [{"url": "tcp://cluster_2:11001"}]
+    }]
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr loader = Json::Factory::loadFromString(json);
+  new NiceMock<Event::MockTimer>(&factory_.dispatcher_);
+  new NiceMock<Event::MockTimer>(&factory_.dispatcher_);
+  std::unordered_map<std::string, Network::DnsResolver::ResolveCb> dns_callbacks;
+  Network::MockActiveDnsQuery active_dns_query;
+  EXPECT_CALL(*factory_.dns_resolver_, resolve(_, _, _))
+      .WillRepeatedly(Invoke([&](const std::string& dns_name, Network::DnsLookupFamily,
+                                 Network::DnsResolver::ResolveCb callback)
+                                 -> Network::ActiveDnsQuery* {
+                                   dns_callbacks[dns_name] = callback;
+                                   return &active_dns_query;
+                                 }));
+
+  // A second thread local cluster manager stands in for a worker. Work for all threads runs on
+  // it as well as on the main thread.
+  ThreadLocal::ThreadLocalObjectSharedPtr worker;
+  NiceMock<Event::MockDispatcher> worker_dispatcher;
+  uint32_t slot = 0;
+  EXPECT_CALL(factory_.tls_, set(_, _))
+      .WillOnce(Invoke([&](uint32_t index, ThreadLocal::Instance::InitializeCb cb) -> void {
+        slot = index;
+        factory_.tls_.data_[index] = cb(factory_.tls_.dispatcher_);
+        worker = cb(worker_dispatcher);
+      }));
+  auto on_worker = [&](std::function<void()> cb) -> void {
+    std::swap(factory_.tls_.data_[slot], worker);
+    cb();
+    std::swap(factory_.tls_.data_[slot], worker);
+  };
+  ON_CALL(factory_.tls_, runOnAllThreads(_)).WillByDefault(Invoke([&](Event::PostCb cb) -> void {
+    on_worker(cb);
+    cb();
+  }));
+  std::vector<Event::PostCb> posts;
+  ON_CALL(factory_.tls_.dispatcher_, post(_))
+      .WillByDefault(Invoke([&](Event::PostCb cb) -> void { posts.push_back(cb); }));
+  create(*loader);
+
+  std::vector<HostSharedPtr> worker_hosts_added;
+  std::vector<HostSharedPtr> worker_hosts_removed;
+  on_worker([&]() -> void {
+    cluster_manager_->get("cluster_1")
+        ->hostSet()
+        .addMemberUpdateCb([&](const std::vector<HostSharedPtr>& hosts_added,
+                               const std::vector<HostSharedPtr>& hosts_removed) -> void {
+          worker_hosts_added = hosts_added;
+          worker_hosts_removed = hosts_removed;
+        });
+  });
+
+  // Updates of two clusters, one of them twice, while the main thread handles one event. The main
+  // thread applies each of them right away.
+  dns_callbacks["cluster_1"](TestUtility::makeDnsResponse({"127.0.0.1", "127.0.0.2"}));
+  dns_callbacks["cluster_2"](TestUtility::makeDnsResponse({"127.0.0.3"}));
+  dns_callbacks["cluster_1"](TestUtility::makeDnsResponse({"127.0.0.1"}));
+  EXPECT_EQ(1UL, cluster_manager_->get("cluster_1")->hostSet().hosts().size());
+  EXPECT_EQ(1UL, cluster_manager_->get("cluster_2")->hostSet().hosts().size());
+  EXPECT_EQ(3UL, factory_.stats_.counter("cluster_manager.membership_update").value());
+  EXPECT_EQ(1UL, factory_.stats_.counter("cluster_manager.membership_update_merged").value());
+  EXPECT_EQ(0UL, factory_.stats_.counter("cluster_manager.membership_update_batch").value());
+  on_worker([&]() -> void {
+    EXPECT_EQ(0UL, cluster_manager_->get("cluster_1")->hostSet().hosts().size());
+  });
+
+  // The worker gets all of them in one batch. The host that was added and removed again is not
+  // part of the update of cluster_1.
+  ASSERT_EQ(1UL, posts.size());
+  EXPECT_CALL(factory_.tls_, runOnAllThreads(_));
+  posts[0]();
+  EXPECT_EQ(1UL, factory_.stats_.counter("cluster_manager.membership_update_batch").value());
+  on_worker([&]() -> void {
+    EXPECT_EQ(1UL, cluster_manager_->get("cluster_1")->hostSet().hosts().size());
+    EXPECT_EQ(1UL, cluster_manager_->get("cluster_2")->hostSet().hosts().size());
+  });
+  ASSERT_EQ(1UL, worker_hosts_added.size());
+  EXPECT_EQ("127.0.0.1:11001", worker_hosts_added[0]->address()->asString());
+  EXPECT_TRUE(worker_hosts_removed.empty());
+
+  // An update after the batch is posted starts a new batch.
+  dns_callbacks["cluster_1"](TestUtility::makeDnsResponse({"127.0.0.4"}));
+  EXPECT_EQ(2UL, posts.size());
+
+  on_worker([&]() -> void { factory_.tls_.shutdownThread(); });
+  factory_.tls_.shutdownThread();
+}
+
+TEST_F(ClusterManagerImplTest, WarmConnPools) {
+  std::string json = R"EOF(
+  {
+    "clusters": [
+    {
+      "name": "cluster_1",
+      "connect_timeout_ms": 250,
+      "type": "strict_dns",
+      "lb_type": "round_robin",
+      "prefetch_ratio": 1.5,
+      "hosts": [{"url": "tcp://localhost:11001"}]
+    }]
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr loader = Json::Factory::loadFromString(json);
+
+  Network::DnsResolver::ResolveCb dns_callback;
+  Event::MockTimer* dns_timer_ = new NiceMock<Event::MockTimer>(&factory_.dispatcher_);
+  Network::MockActiveDnsQuery active_dns_query;
+  EXPECT_CALL(*factory_.dns_resolver_, resolve(_, _, _))
+      .WillRepeatedly(DoAll(SaveArg<2>(&dns_callback), Return(&active_dns_query)));
+  create(*loader);
+
+  std::vector<Http::ConnectionPool::MockInstance*> pools;
+  EXPECT_CALL(factory_, allocateConnPool_(_))
+      .Times(3)
+      .WillRepeatedly(Invoke([&](HostConstSharedPtr) -> Http::ConnectionPool::Instance* {
+        Http::ConnectionPool::MockInstance* pool = new Http::ConnectionPool::MockInstance();
+        EXPECT_CALL(*pool, warm());
+        pools.push_back(pool);
+        return pool;
+      }));
+
+  // Both hosts are healthy as soon as they are resolved, so each gets a warmed pool.
+  dns_callback(TestUtility::makeDnsResponse({"127.0.0.1", "127.0.0.2"}));
+  EXPECT_EQ(2U, pools.size());
+
+  // Only the new host is warmed when the membership changes again.
+  dns_timer_->callback_();
+  dns_callback(TestUtility::makeDnsResponse({"127.0.0.1", "127.0.0.2", "127.0.0.3"}));
+  EXPECT_EQ(3U, pools.size());
+
+  // Requests use the warmed pools.
+  Http::ConnectionPool::Instance* cp =
+      cluster_manager_->httpConnPoolForCluster("cluster_1", ResourcePriority::Default, nullptr);
+  EXPECT_NE(pools.end(), std::find(pools.begin(), pools.end(), cp));
+
+  factory_.tls_.shutdownThread();
+}
+
+TEST_F(ClusterManagerImplTest, SharedConnPools) {
+  Json::ObjectSharedPtr loader = Json::Factory::loadFromString(R"EOF({"clusters": []})EOF");
+  create(*loader);
+
+  // All clusters have a single host with the same address.
+  const auto cluster_json = [](const std::string& name,
+                               const std::string& options) -> Json::ObjectSharedPtr {
+    return Json::Factory::loadFromString(
+        R"EOF({"connect_timeout_ms": 250, "type": "static", "lb_type": "round_robin",
+               "hosts": [{"url": "tcp://127.0.0.1:11001"}], "name": ")EOF" +
+        name + "\"" + options + "}");
+  };
+  EXPECT_TRUE(cluster_manager_->addOrUpdatePrimaryCluster(
+      *cluster_json("primary", R"EOF(, "share_connection_pools": true)EOF")));
+  EXPECT_TRUE(cluster_manager_->addOrUpdatePrimaryCluster(
+      *cluster_json("canary", R"EOF(, "share_connection_pools": true)EOF")));
+  EXPECT_TRUE(cluster_manager_->addOrUpdatePrimaryCluster(*cluster_json(
+      "http2", R"EOF(, "share_connection_pools": true, "features": "http2")EOF")));
+  EXPECT_TRUE(cluster_manager_->addOrUpdatePrimaryCluster(*cluster_json("unshared", "")));
+
+  EXPECT_CALL(factory_, allocateConnPool_(_))
+      .Times(3)
+      .WillRepeatedly(ReturnNew<Http::ConnectionPool::MockInstance>());
+
+  Http::ConnectionPool::MockInstance* shared = dynamic_cast<Http::ConnectionPool::MockInstance*>(
+      cluster_manager_->httpConnPoolForCluster("primary", ResourcePriority::Default, nullptr));
+  EXPECT_EQ(shared, cluster_manager_->httpConnPoolForCluster("canary", ResourcePriority::Default,
+                                                             nullptr));
+  Http::ConnectionPool::Instance* http2 =
+      cluster_manager_->httpConnPoolForCluster("http2", ResourcePriority::Default, nullptr);
+  Http::ConnectionPool::Instance* unshared =
+      cluster_manager_->httpConnPoolForCluster("unshared", ResourcePriority::Default, nullptr);
+  EXPECT_NE(shared, http2);
+  EXPECT_NE(shared, unshared);
+  EXPECT_NE(http2, unshared);
+
+  // The pool stays while any of the clusters that share it remain.
+  EXPECT_CALL(*shared, addDrainedCallback(_)).Times(0);
+  EXPECT_TRUE(cluster_manager_->removePrimaryCluster("primary"));
+  EXPECT_EQ(shared, cluster_manager_->httpConnPoolForCluster("canary", ResourcePriority::Default,
+                                                             nullptr));
+
+  Http::ConnectionPool::Instance::DrainedCb drained_cb;
+  EXPECT_CALL(*shared, addDrainedCallback(_)).WillOnce(SaveArg<0>(&drained_cb));
+  EXPECT_TRUE(cluster_manager_->removePrimaryCluster("canary"));
+  drained_cb();
+
+  factory_.tls_.shutdownThread();
+}
+
 TEST(ClusterManagerInitHelper, ImmediateInitialize) {
   InSequence s;
   ClusterManagerInitHelper init_helper;
@@ -855,6 +1267,47 @@ TEST(ClusterManagerInitHelper, AddSecondaryAfterSecondaryInit) {
   cluster2.initialize_callback_();
 }
 
+TEST(ClusterManagerInitHelper, MaxConcurrentSecondaryInit) {
+  InSequence s;
+  ClusterManagerInitHelper init_helper;
+  init_helper.setMaxConcurrentSecondaryInit(2);
+
+  ReadyWatcher cm_initialized;
+  init_helper.setInitializedCb([&]() -> void { cm_initialized.ready(); });
+
+  NiceMock<MockCluster> cluster1;
+  ON_CALL(cluster1, initializePhase()).WillByDefault(Return(Cluster::InitializePhase::Secondary));
+  init_helper.addCluster(cluster1);
+
+  NiceMock<MockCluster> cluster2;
+  ON_CALL(cluster2, initializePhase()).WillByDefault(Return(Cluster::InitializePhase::Secondary));
+  init_helper.addCluster(cluster2);
+
+  NiceMock<MockCluster> cluster3;
+  ON_CALL(cluster3, initializePhase()).WillByDefault(Return(Cluster::InitializePhase::Secondary));
+  init_helper.addCluster(cluster3);
+
+  // Only two clusters are initialized at first.
+  EXPECT_CALL(cluster1, initialize());
+  EXPECT_CALL(cluster2, initialize());
+  init_helper.onStaticLoadComplete();
+
+  // A cluster added after secondary init started waits for a free slot as well.
+  NiceMock<MockCluster> cluster4;
+  ON_CALL(cluster4, initializePhase()).WillByDefault(Return(Cluster::InitializePhase::Secondary));
+  init_helper.addCluster(cluster4);
+
+  EXPECT_CALL(cluster3, initialize());
+  cluster2.initialize_callback_();
+
+  EXPECT_CALL(cluster4, initialize());
+  init_helper.removeCluster(cluster1);
+
+  cluster4.initialize_callback_();
+  EXPECT_CALL(cm_initialized, ready());
+  cluster3.initialize_callback_();
+}
+
 TEST(ClusterManagerInitHelper, RemoveClusterWithinInitLoop) {
   // Tests the scenario encountered in Issue 903: The cluster was removed from
   // the secondary init list while traversing the list.
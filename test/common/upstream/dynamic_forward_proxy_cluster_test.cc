@@ -0,0 +1,303 @@
+#include <chrono>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/network/utility.h"
+#include "common/upstream/dynamic_forward_proxy_cluster.h"
+
+#include "test/mocks/common.h"
+#include "test/mocks/network/mocks.h"
+#include "test/mocks/runtime/mocks.h"
+#include "test/mocks/ssl/mocks.h"
+#include "test/mocks/upstream/mocks.h"
+#include "test/test_common/utility.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace Envoy {
+using testing::DoAll;
+using testing::Invoke;
+using testing::NiceMock;
+using testing::Return;
+using testing::SaveArg;
+using testing::_;
+
+namespace Upstream {
+
+class TestLoadBalancerContext : public LoadBalancerContext {
+public:
+  TestLoadBalancerContext(const std::string& authority) : headers_{{":authority", authority}} {}
+
+  // Upstream::LoadBalancerContext
+  const Optional<uint64_t>& hashKey() const override { return hash_key_; }
+  const HostMetadata* metadataMatchCriteria() const override { return nullptr; }
+  const Network::Connection* downstreamConnection() const override { return nullptr; }
+  const Http::HeaderMap* downstreamHeaders() const override { return &headers_; }
+
+  Optional<uint64_t> hash_key_;
+  Http::TestHeaderMapImpl headers_;
+};
+
+class DynamicForwardProxyClusterTest : public testing::Test {
+public:
+  void setup(const std::string& json) {
+    Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
+    cluster_.reset(
+        new DynamicForwardProxyCluster(*config, runtime_, stats_store_, ssl_context_manager_));
+  }
+
+  Stats::IsolatedStoreImpl stats_store_;
+  Ssl::MockContextManager ssl_context_manager_;
+  NiceMock<Runtime::MockLoader> runtime_;
+  std::unique_ptr<DynamicForwardProxyCluster> cluster_;
+};
+
+TEST_F(DynamicForwardProxyClusterTest, Config) {
+  setup(R"EOF(
+  {
+    "name": "name",
+    "connect_timeout_ms": 250,
+    "type": "dynamic_forward_proxy",
+    "lb_type": "dynamic_forward_proxy_lb",
+    "cleanup_interval_ms": 1000,
+    "dns_lookup_family": "v6_only"
+  }
+  )EOF");
+
+  EXPECT_EQ(LoadBalancerType::DynamicForwardProxy, cluster_->info()->lbType());
+  EXPECT_EQ(std::chrono::milliseconds(1000), cluster_->info()->hostCleanupInterval());
+  EXPECT_EQ(Network::DnsLookupFamily::V6Only, cluster_->info()->dnsLookupFamily());
+  EXPECT_TRUE(cluster_->hosts().empty());
+  ReadyWatcher initialized;
+  EXPECT_CALL(initialized, ready());
+  cluster_->setInitializedCb([&]() -> void { initialized.ready(); });
+}
+
+TEST_F(DynamicForwardProxyClusterTest, BadConfig) {
+  EXPECT_THROW_WITH_MESSAGE(setup(R"EOF(
+  {
+    "name": "name",
+    "connect_timeout_ms": 250,
+    "type": "dynamic_forward_proxy",
+    "lb_type": "dynamic_forward_proxy_lb",
+    "hosts": [{"url": "tcp://127.0.0.1:11001"}]
+  }
+  )EOF"),
+                            EnvoyException, "dynamic_forward_proxy clusters must have no hosts");
+
+  EXPECT_THROW_WITH_MESSAGE(setup(R"EOF(
+  {
+    "name": "name",
+    "connect_timeout_ms": 250,
+    "type": "static",
+    "lb_type": "dynamic_forward_proxy_lb",
+    "hosts": [{"url": "tcp://127.0.0.1:11001"}]
+  }
+  )EOF"),
+                            EnvoyException,
+                            "cluster: LB type 'dynamic_forward_proxy_lb' may only be used with "
+                            "cluster type 'dynamic_forward_proxy'");
+
+  EXPECT_THROW_WITH_MESSAGE(setup(R"EOF(
+  {
+    "name": "name",
+    "connect_timeout_ms": 250,
+    "type": "dynamic_forward_proxy",
+    "lb_type": "dynamic_forward_proxy_lb",
+    "lb_subset_config": {"subset_keys": [["version"]]}
+  }
+  )EOF"),
+                            EnvoyException,
+                            "cluster: LB type 'dynamic_forward_proxy_lb' may not be used with "
+                            "lb_subset_config");
+}
+
+TEST(DynamicForwardProxyParseAuthorityTest, All) {
+  NiceMock<MockClusterInfo> info;
+  std::string dns_name;
+  uint32_t port;
+
+  EXPECT_TRUE(DynamicForwardProxyCluster::parseAuthority("example.com", info, dns_name, port));
+  EXPECT_EQ("example.com", dns_name);
+  EXPECT_EQ(80U, port);
+  EXPECT_TRUE(
+      DynamicForwardProxyCluster::parseAuthority("example.com:8080", info, dns_name, port));
+  EXPECT_EQ("example.com", dns_name);
+  EXPECT_EQ(8080U, port);
+  EXPECT_TRUE(DynamicForwardProxyCluster::parseAuthority("[::1]:8080", info, dns_name, port));
+  EXPECT_EQ("::1", dns_name);
+  EXPECT_EQ(8080U, port);
+  EXPECT_TRUE(DynamicForwardProxyCluster::parseAuthority("[::1]", info, dns_name, port));
+  EXPECT_EQ("::1", dns_name);
+  EXPECT_EQ(80U, port);
+
+  EXPECT_FALSE(DynamicForwardProxyCluster::parseAuthority("", info, dns_name, port));
+  EXPECT_FALSE(DynamicForwardProxyCluster::parseAuthority(":80", info, dns_name, port));
+  EXPECT_FALSE(DynamicForwardProxyCluster::parseAuthority("example.com:", info, dns_name, port));
+  EXPECT_FALSE(DynamicForwardProxyCluster::parseAuthority("example.com:0", info, dns_name, port));
+  EXPECT_FALSE(
+      DynamicForwardProxyCluster::parseAuthority("example.com:65536", info, dns_name, port));
+  EXPECT_FALSE(DynamicForwardProxyCluster::parseAuthority("example.com:a", info, dns_name, port));
+  EXPECT_FALSE(DynamicForwardProxyCluster::parseAuthority("[::1", info, dns_name, port));
+  EXPECT_FALSE(DynamicForwardProxyCluster::parseAuthority("[::1]80", info, dns_name, port));
+
+  // Secure clusters default to 443.
+  Ssl::MockClientContext ssl_context;
+  ON_CALL(info, sslContext()).WillByDefault(Return(&ssl_context));
+  EXPECT_TRUE(DynamicForwardProxyCluster::parseAuthority("example.com", info, dns_name, port));
+  EXPECT_EQ(443U, port);
+}
+
+class DynamicForwardProxyLoadBalancerTest : public testing::Test {
+public:
+  DynamicForwardProxyLoadBalancerTest() {
+    cleanup_timer_ = new Event::MockTimer(&dispatcher_);
+    EXPECT_CALL(*cleanup_timer_, enableTimer(std::chrono::milliseconds(5000)));
+    lb_.reset(new DynamicForwardProxyCluster::LoadBalancer(
+        info_, dispatcher_, dns_resolver_,
+        [this](const std::vector<HostSharedPtr>& hosts_removed) -> void {
+          hostsRemoved(hosts_removed);
+        }));
+  }
+
+  MOCK_METHOD1(hostsRemoved, void(const std::vector<HostSharedPtr>& hosts_removed));
+
+  HostConstSharedPtr chooseHost(const std::string& authority) {
+    TestLoadBalancerContext context(authority);
+    return lb_->chooseHost(&context);
+  }
+
+  // Answers the next resolution of dns_name right away, as the DNS cache does.
+  void expectCachedResolve(const std::string& dns_name, const std::string& address) {
+    EXPECT_CALL(*dns_resolver_, resolve(dns_name, Network::DnsLookupFamily::V4Only, _))
+        .WillOnce(Invoke([address](const std::string&, Network::DnsLookupFamily,
+                                   Network::DnsResolver::ResolveCb cb) -> Network::ActiveDnsQuery* {
+          cb(TestUtility::makeDnsResponse({address}));
+          return nullptr;
+        }));
+  }
+
+  std::shared_ptr<NiceMock<MockClusterInfo>> info_{new NiceMock<MockClusterInfo>()};
+  NiceMock<Event::MockDispatcher> dispatcher_;
+  std::shared_ptr<NiceMock<Network::MockDnsResolver>> dns_resolver_{
+      new NiceMock<Network::MockDnsResolver>()};
+  Event::MockTimer* cleanup_timer_;
+  std::unique_ptr<DynamicForwardProxyCluster::LoadBalancer> lb_;
+};
+
+TEST_F(DynamicForwardProxyLoadBalancerTest, NoAuthority) {
+  EXPECT_EQ(nullptr, lb_->chooseHost(nullptr));
+  EXPECT_CALL(*dns_resolver_, resolve(_, _, _)).Times(0);
+  EXPECT_EQ(nullptr, chooseHost(""));
+  EXPECT_EQ(nullptr, chooseHost("example.com:http"));
+}
+
+TEST_F(DynamicForwardProxyLoadBalancerTest, HostPerAuthority) {
+  expectCachedResolve("example.com", "10.0.0.1");
+  HostConstSharedPtr host = chooseHost("example.com");
+  ASSERT_NE(nullptr, host);
+  EXPECT_EQ("10.0.0.1:80", host->address()->asString());
+  EXPECT_EQ("example.com", host->hostname());
+  EXPECT_EQ(info_.get(), &host->cluster());
+  EXPECT_EQ(host, chooseHost("example.com"));
+
+  // The same name with another port is another host.
+  expectCachedResolve("example.com", "10.0.0.1");
+  HostConstSharedPtr other_port = chooseHost("example.com:8080");
+  ASSERT_NE(nullptr, other_port);
+  EXPECT_EQ("10.0.0.1:8080", other_port->address()->asString());
+
+  std::vector<HostSharedPtr> hosts_removed;
+  EXPECT_CALL(*this, hostsRemoved(_)).WillOnce(SaveArg<0>(&hosts_removed));
+  lb_.reset();
+  EXPECT_EQ(2U, hosts_removed.size());
+}
+
+TEST_F(DynamicForwardProxyLoadBalancerTest, AsyncResolve) {
+  Network::DnsResolver::ResolveCb resolve_cb;
+  EXPECT_CALL(*dns_resolver_, resolve("example.com", _, _))
+      .WillOnce(DoAll(SaveArg<2>(&resolve_cb), Return(&dns_resolver_->active_query_)));
+  EXPECT_EQ(nullptr, chooseHost("example.com"));
+
+  // No other query is started while one is in flight.
+  EXPECT_EQ(nullptr, chooseHost("example.com"));
+
+  resolve_cb(TestUtility::makeDnsResponse({"10.0.0.1"}));
+  HostConstSharedPtr host = chooseHost("example.com");
+  ASSERT_NE(nullptr, host);
+  EXPECT_EQ("10.0.0.1:80", host->address()->asString());
+
+  EXPECT_CALL(*this, hostsRemoved(_));
+  lb_.reset();
+}
+
+TEST_F(DynamicForwardProxyLoadBalancerTest, ResolveFailure) {
+  EXPECT_CALL(*dns_resolver_, resolve("example.com", _, _))
+      .Times(2)
+      .WillRepeatedly(Invoke([](const std::string&, Network::DnsLookupFamily,
+                                Network::DnsResolver::ResolveCb cb) -> Network::ActiveDnsQuery* {
+        cb({});
+        return nullptr;
+      }));
+  EXPECT_EQ(nullptr, chooseHost("example.com"));
+  EXPECT_EQ(nullptr, chooseHost("example.com"));
+
+  EXPECT_CALL(*this, hostsRemoved(_)).Times(0);
+  lb_.reset();
+}
+
+TEST_F(DynamicForwardProxyLoadBalancerTest, Cleanup) {
+  expectCachedResolve("idle.com", "10.0.0.1");
+  HostConstSharedPtr idle = chooseHost("idle.com");
+  expectCachedResolve("busy.com", "10.0.0.2");
+  HostConstSharedPtr busy = chooseHost("busy.com");
+
+  // Both hosts were used since the last cleanup, so their names are resolved again. The address
+  // of busy.com has changed, which replaces its host.
+  expectCachedResolve("idle.com", "10.0.0.1");
+  expectCachedResolve("busy.com", "10.0.0.3");
+  std::vector<HostSharedPtr> hosts_removed;
+  EXPECT_CALL(*this, hostsRemoved(_)).WillOnce(SaveArg<0>(&hosts_removed));
+  EXPECT_CALL(*cleanup_timer_, enableTimer(std::chrono::milliseconds(5000)));
+  cleanup_timer_->callback_();
+  ASSERT_EQ(1U, hosts_removed.size());
+  EXPECT_EQ(busy, hosts_removed[0]);
+
+  HostConstSharedPtr new_busy = chooseHost("busy.com");
+  EXPECT_EQ("10.0.0.3:80", new_busy->address()->asString());
+  expectCachedResolve("busy.com", "10.0.0.3");
+  EXPECT_CALL(*this, hostsRemoved(_)).WillOnce(SaveArg<0>(&hosts_removed));
+  EXPECT_CALL(*cleanup_timer_, enableTimer(std::chrono::milliseconds(5000)));
+  cleanup_timer_->callback_();
+  ASSERT_EQ(1U, hosts_removed.size());
+  EXPECT_EQ(idle, hosts_removed[0]);
+
+  // An evicted authority gets a new host.
+  expectCachedResolve("idle.com", "10.0.0.1");
+  EXPECT_NE(idle, chooseHost("idle.com"));
+
+  EXPECT_CALL(*this, hostsRemoved(_)).WillOnce(SaveArg<0>(&hosts_removed));
+  lb_.reset();
+  EXPECT_EQ(2U, hosts_removed.size());
+}
+
+TEST_F(DynamicForwardProxyLoadBalancerTest, CleanupCancelsQuery) {
+  EXPECT_CALL(*dns_resolver_, resolve("example.com", _, _))
+      .WillOnce(Return(&dns_resolver_->active_query_));
+  EXPECT_EQ(nullptr, chooseHost("example.com"));
+
+  // Still marked used.
+  EXPECT_CALL(*cleanup_timer_, enableTimer(std::chrono::milliseconds(5000)));
+  cleanup_timer_->callback_();
+
+  EXPECT_CALL(dns_resolver_->active_query_, cancel());
+  EXPECT_CALL(*this, hostsRemoved(_)).Times(0);
+  EXPECT_CALL(*cleanup_timer_, enableTimer(std::chrono::milliseconds(5000)));
+  cleanup_timer_->callback_();
+}
+
+} // Upstream
+} // Envoy
@@ -0,0 +1,72 @@
+#include <memory>
+#include <vector>
+
+#include "common/upstream/edf_scheduler.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Upstream {
+
+TEST(EdfSchedulerTest, Empty) {
+  EdfScheduler<uint32_t> sched;
+  EXPECT_EQ(nullptr, sched.pick());
+  EXPECT_EQ(0U, sched.size());
+}
+
+TEST(EdfSchedulerTest, Unweighted) {
+  EdfScheduler<uint32_t> sched;
+  constexpr uint32_t num_entries = 128;
+  std::shared_ptr<uint32_t> entries[num_entries];
+
+  for (uint32_t i = 0; i < num_entries; ++i) {
+    entries[i] = std::make_shared<uint32_t>(i);
+    sched.add(1, entries[i]);
+  }
+
+  // Entries of equal weight are picked in insertion order.
+  for (uint32_t rounds = 0; rounds < 3; ++rounds) {
+    for (uint32_t i = 0; i < num_entries; ++i) {
+      EXPECT_EQ(i, *sched.pick());
+    }
+  }
+}
+
+TEST(EdfSchedulerTest, Weighted) {
+  EdfScheduler<uint32_t> sched;
+  constexpr uint32_t num_entries = 128;
+  std::shared_ptr<uint32_t> entries[num_entries];
+  uint32_t pick_count[num_entries];
+
+  for (uint32_t i = 0; i < num_entries; ++i) {
+    entries[i] = std::make_shared<uint32_t>(i);
+    sched.add(i + 1, entries[i]);
+    pick_count[i] = 0;
+  }
+
+  for (uint32_t i = 0; i < (num_entries * (1 + num_entries)) / 2; ++i) {
+    ++pick_count[*sched.pick()];
+  }
+
+  for (uint32_t i = 0; i < num_entries; ++i) {
+    EXPECT_EQ(i + 1, pick_count[i]);
+  }
+}
+
+TEST(EdfSchedulerTest, WeightedOrder) {
+  EdfScheduler<uint32_t> sched;
+  sched.add(4, std::make_shared<uint32_t>(0));
+  sched.add(1, std::make_shared<uint32_t>(1));
+  sched.add(1, std::make_shared<uint32_t>(2));
+
+  // Every six picks hold the heavy entry four times and each light entry once. On equal deadlines
+  // the entry that has been waiting the longest goes first.
+  std::vector<uint32_t> picks;
+  for (uint32_t i = 0; i < 12; ++i) {
+    picks.push_back(*sched.pick());
+  }
+  EXPECT_EQ((std::vector<uint32_t>{0, 0, 0, 1, 2, 0, 0, 0, 0, 1, 2, 0}), picks);
+}
+
+} // Upstream
+} // Envoy
@@ -0,0 +1,108 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/network/utility.h"
+#include "common/upstream/maglev_lb.h"
+#include "common/upstream/ring_hash_lb.h"
+#include "common/upstream/upstream_impl.h"
+
+#include "test/mocks/runtime/mocks.h"
+#include "test/mocks/upstream/mocks.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+using testing::NiceMock;
+
+namespace Upstream {
+
+class BenchmarkLoadBalancerContext : public LoadBalancerContext {
+public:
+  // Upstream::LoadBalancerContext
+  const Optional<uint64_t>& hashKey() const override { return hash_key_; }
+  const HostMetadata* metadataMatchCriteria() const override { return nullptr; }
+  const Network::Connection* downstreamConnection() const override { return nullptr; }
+  const Http::HeaderMap* downstreamHeaders() const override { return nullptr; }
+
+  Optional<uint64_t> hash_key_;
+};
+
+/**
+ * This test is for benchmarking only and should not be run as part of unit tests. It compares the
+ * rebuild time and pick latency of the consistent hashing load balancers for a large cluster.
+ */
+class DISABLED_HashLoadBalancerBenchmark : public testing::Test {
+public:
+  static const uint32_t NumHosts = 10000;
+  static const uint32_t NumRebuilds = 10;
+  static const uint32_t NumPicks = 10000000;
+
+  DISABLED_HashLoadBalancerBenchmark() : stats_(ClusterInfoImpl::generateStats(stats_store_)) {
+    for (uint32_t i = 0; i < NumHosts; i++) {
+      cluster_.hosts_.push_back(std::make_shared<HostImpl>(
+          cluster_.info_, "",
+          Network::Utility::resolveUrl(fmt::format("tcp://10.0.{}.{}:80", i / 256, i % 256)),
+          false, 1, ""));
+    }
+    cluster_.healthy_hosts_ = cluster_.hosts_;
+  }
+
+  void run(const std::string& name, LoadBalancer& lb) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NumRebuilds; i++) {
+      cluster_.runCallbacks({}, {});
+    }
+    std::chrono::nanoseconds rebuild = std::chrono::steady_clock::now() - start;
+
+    BenchmarkLoadBalancerContext context;
+    uint64_t hash = 0;
+    uintptr_t checksum = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NumPicks; i++) {
+      // Spread the keys over the whole hash space.
+      hash = hash * 6364136223846793005ULL + 1442695040888963407ULL;
+      context.hash_key_.value(hash);
+      checksum += reinterpret_cast<uintptr_t>(lb.chooseHost(&context).get());
+    }
+    std::chrono::nanoseconds pick = std::chrono::steady_clock::now() - start;
+
+    // The rebuild includes both the healthy and all hosts tables or rings.
+    const uint64_t rebuild_us =
+        std::chrono::duration_cast<std::chrono::microseconds>(rebuild).count() / NumRebuilds;
+    std::cout << fmt::format("{}: hosts={} rebuild={}us pick={}ns checksum={}", name, NumHosts,
+                             rebuild_us, pick.count() / NumPicks, checksum)
+              << std::endl;
+  }
+
+  NiceMock<MockCluster> cluster_;
+  Stats::IsolatedStoreImpl stats_store_;
+  ClusterStats stats_;
+  NiceMock<Runtime::MockLoader> runtime_;
+  NiceMock<Runtime::MockRandomGenerator> random_;
+};
+
+const uint32_t DISABLED_HashLoadBalancerBenchmark::NumHosts;
+
+TEST_F(DISABLED_HashLoadBalancerBenchmark, RingHash) {
+  RingHashLoadBalancer lb(cluster_, stats_, runtime_, random_, RingHashFunction::StdHash);
+  run("ring_hash", lb);
+}
+
+TEST_F(DISABLED_HashLoadBalancerBenchmark, RingHashXxHash64) {
+  RingHashLoadBalancer lb(cluster_, stats_, runtime_, random_, RingHashFunction::XxHash64);
+  run("ring_hash_xx_hash", lb);
+}
+
+TEST_F(DISABLED_HashLoadBalancerBenchmark, Maglev) {
+  MaglevLoadBalancer lb(cluster_, stats_, runtime_, random_);
+  run("maglev", lb);
+}
+
+} // Upstream
+} // Envoy
@@ -4,9 +4,12 @@
 #include <vector>
 
 #include "common/buffer/buffer_impl.h"
+#include "common/grpc/codec.h"
+#include "common/grpc/common.h"
 #include "common/http/headers.h"
 #include "common/json/json_loader.h"
 #include "common/network/utility.h"
+#include "common/upstream/grpc_health.pb.h"
 #include "common/upstream/health_checker_impl.h"
 #include "common/upstream/upstream_impl.h"
 
@@ -35,6 +38,27 @@ using testing::WithArg;
 
 namespace Upstream {
 
+TEST(HealthCheckerFactoryTest, createGrpc) {
+  std::string json = R"EOF(
+  {
+    "type": "grpc",
+    "timeout_ms": 1000,
+    "interval_ms": 1000,
+    "unhealthy_threshold": 1,
+    "healthy_threshold": 1
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
+  NiceMock<Upstream::MockCluster> cluster;
+  Runtime::MockLoader runtime;
+  Runtime::MockRandomGenerator random;
+  Event::MockDispatcher dispatcher;
+  EXPECT_NE(nullptr,
+            dynamic_cast<ProdHttpHealthCheckerImpl*>(
+                HealthCheckerFactory::create(*config, cluster, runtime, random, dispatcher).get()));
+}
+
 TEST(HealthCheckerFactoryTest, createRedis) {
   std::string json = R"EOF(
   {
@@ -127,6 +151,45 @@ public:
                                                 -> void { onHostStatus(host, changed_state); });
   }
 
+  void setupHttp2HC() {
+    std::string json = R"EOF(
+    {
+      "type": "http",
+      "timeout_ms": 1000,
+      "interval_ms": 1000,
+      "unhealthy_threshold": 2,
+      "healthy_threshold": 2,
+      "path": "/healthcheck",
+      "use_http2": true
+    }
+    )EOF";
+
+    Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
+    health_checker_.reset(
+        new TestHttpHealthCheckerImpl(*cluster_, *config, dispatcher_, runtime_, random_));
+    health_checker_->addHostCheckCompleteCb([this](HostSharedPtr host, bool changed_state)
+                                                -> void { onHostStatus(host, changed_state); });
+  }
+
+  void setupGrpcHC() {
+    std::string json = R"EOF(
+    {
+      "type": "grpc",
+      "timeout_ms": 1000,
+      "interval_ms": 1000,
+      "unhealthy_threshold": 1,
+      "healthy_threshold": 1,
+      "service_name": "locations"
+    }
+    )EOF";
+
+    Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
+    health_checker_.reset(
+        new TestHttpHealthCheckerImpl(*cluster_, *config, dispatcher_, runtime_, random_));
+    health_checker_->addHostCheckCompleteCb([this](HostSharedPtr host, bool changed_state)
+                                                -> void { onHostStatus(host, changed_state); });
+  }
+
   void expectSessionCreate() {
     // Expectations are in LIFO order.
     TestSessionPtr new_test_session(new TestSession());
@@ -184,6 +247,22 @@ public:
     }
   }
 
+  void respondGrpc(size_t index, grpc::health::v1::HealthCheckResponse::ServingStatus status,
+                   const std::string& grpc_status) {
+    test_sessions_[index]->stream_response_callbacks_->decodeHeaders(
+        Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{":status", "200"},
+                                                       {"content-type", "application/grpc"}}},
+        false);
+
+    grpc::health::v1::HealthCheckResponse response;
+    response.set_status(status);
+    test_sessions_[index]->stream_response_callbacks_->decodeData(
+        *Grpc::Common::serializeBody(response), false);
+
+    test_sessions_[index]->stream_response_callbacks_->decodeTrailers(
+        Http::HeaderMapPtr{new Http::TestHeaderMapImpl{{"grpc-status", grpc_status}}});
+  }
+
   MOCK_METHOD2(onHostStatus, void(HostSharedPtr host, bool changed_state));
 
   std::shared_ptr<MockCluster> cluster_;
@@ -600,6 +679,196 @@ TEST_F(HttpHealthCheckerImplTest, RemoteCloseBetweenChecks) {
   EXPECT_TRUE(cluster_->hosts_[0]->healthy());
 }
 
+TEST_F(HttpHealthCheckerImplTest, TimerWheel) {
+  std::string json = R"EOF(
+  {
+    "type": "http",
+    "timeout_ms": 1000,
+    "interval_ms": 1000,
+    "unhealthy_threshold": 2,
+    "healthy_threshold": 2,
+    "path": "/healthcheck",
+    "timer_resolution_ms": 10
+  }
+  )EOF";
+
+  // All sessions share the timer wheel's single dispatcher timer.
+  Event::MockTimer* tick_timer = new Event::MockTimer(&dispatcher_);
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
+  health_checker_.reset(
+      new TestHttpHealthCheckerImpl(*cluster_, *config, dispatcher_, runtime_, random_));
+  health_checker_->addHostCheckCompleteCb([this](HostSharedPtr host, bool changed_state)
+                                              -> void { onHostStatus(host, changed_state); });
+  EXPECT_CALL(dispatcher_, createTimer_(_)).Times(0);
+  EXPECT_CALL(*this, onHostStatus(_, false)).Times(2);
+
+  cluster_->hosts_ = {
+      HostSharedPtr{new HostImpl(cluster_->info_, "",
+                                 Network::Utility::resolveUrl("tcp://127.0.0.1:80"), false, 1, "")},
+      HostSharedPtr{new HostImpl(cluster_->info_, "",
+                                 Network::Utility::resolveUrl("tcp://127.0.0.2:80"), false, 1, "")}};
+  for (size_t i = 0; i < cluster_->hosts_.size(); i++) {
+    test_sessions_.emplace_back(new TestSession());
+    expectClientCreate(i);
+    expectStreamCreate(i);
+  }
+  EXPECT_CALL(*tick_timer, enableTimer(std::chrono::milliseconds(10)));
+  health_checker_->start();
+
+  respond(0, "200", false);
+  respond(1, "200", false);
+  EXPECT_TRUE(cluster_->hosts_[0]->healthy());
+  EXPECT_TRUE(cluster_->hosts_[1]->healthy());
+}
+
+TEST_F(HttpHealthCheckerImplTest, SharedAcrossClusters) {
+  std::string json = R"EOF(
+  {
+    "type": "http",
+    "timeout_ms": 1000,
+    "interval_ms": 1000,
+    "unhealthy_threshold": 2,
+    "healthy_threshold": 2,
+    "path": "/healthcheck",
+    "share_across_clusters": true
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
+  health_checker_.reset(
+      new TestHttpHealthCheckerImpl(*cluster_, *config, dispatcher_, runtime_, random_));
+  health_checker_->addHostCheckCompleteCb([this](HostSharedPtr host, bool changed_state)
+                                              -> void { onHostStatus(host, changed_state); });
+  std::shared_ptr<MockCluster> cluster2(new NiceMock<MockCluster>());
+  TestHttpHealthCheckerImpl health_checker2(*cluster2, *config, dispatcher_, runtime_, random_);
+  health_checker2.addHostCheckCompleteCb([this](HostSharedPtr host, bool changed_state)
+                                             -> void { onHostStatus(host, changed_state); });
+
+  cluster_->hosts_ = {HostSharedPtr{new HostImpl(
+      cluster_->info_, "", Network::Utility::resolveUrl("tcp://127.0.0.1:80"), false, 1, "")}};
+  cluster2->hosts_ = {HostSharedPtr{new HostImpl(
+      cluster2->info_, "", Network::Utility::resolveUrl("tcp://127.0.0.1:80"), false, 1, "")}};
+  cluster2->hosts_[0]->healthFlagSet(Host::HealthFlag::FAILED_ACTIVE_HC);
+
+  expectSessionCreate();
+  expectStreamCreate(0);
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, enableTimer(_));
+  health_checker_->start();
+
+  // The second cluster follows the checks of the first one and does not connect itself.
+  Event::MockTimer* follower_timeout_timer = new Event::MockTimer(&dispatcher_);
+  Event::MockTimer* follower_interval_timer = new Event::MockTimer(&dispatcher_);
+  EXPECT_CALL(dispatcher_, createClientConnection_(_)).Times(0);
+  EXPECT_CALL(*follower_timeout_timer, enableTimer(_)).Times(0);
+  EXPECT_CALL(*follower_interval_timer, enableTimer(_)).Times(0);
+  health_checker2.start();
+
+  EXPECT_CALL(*this, onHostStatus(cluster_->hosts_[0], false));
+  EXPECT_CALL(*this, onHostStatus(cluster2->hosts_[0], true));
+  EXPECT_CALL(*test_sessions_[0]->interval_timer_, enableTimer(_));
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, disableTimer());
+  respond(0, "200", false);
+  EXPECT_TRUE(cluster_->hosts_[0]->healthy());
+  EXPECT_TRUE(cluster2->hosts_[0]->healthy());
+
+  // When the first cluster goes away the second one takes over the checks.
+  EXPECT_CALL(*follower_interval_timer, enableTimer(_));
+  health_checker_.reset();
+}
+
+TEST_F(HttpHealthCheckerImplTest, Http2TimeoutResetsStream) {
+  setupHttp2HC();
+  cluster_->hosts_ = {HostSharedPtr{new HostImpl(
+      cluster_->info_, "", Network::Utility::resolveUrl("tcp://127.0.0.1:80"), false, 1, "")}};
+  expectSessionCreate();
+  expectStreamCreate(0);
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, enableTimer(_));
+  health_checker_->start();
+  test_sessions_[0]->client_connection_->raiseEvents(Network::ConnectionEvent::Connected);
+
+  // Only the stream is reset, the connection stays open for the next check.
+  EXPECT_CALL(*this, onHostStatus(_, false));
+  EXPECT_CALL(test_sessions_[0]->request_encoder_.stream_,
+              resetStream(Http::StreamResetReason::LocalReset));
+  EXPECT_CALL(*test_sessions_[0]->client_connection_, close(_)).Times(0);
+  EXPECT_CALL(*test_sessions_[0]->interval_timer_, enableTimer(_));
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, disableTimer());
+  test_sessions_[0]->timeout_timer_->callback_();
+  EXPECT_EQ(1UL, cluster_->info_->stats_store_.counter("health_check.failure").value());
+
+  expectStreamCreate(0);
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, enableTimer(_));
+  test_sessions_[0]->interval_timer_->callback_();
+
+  EXPECT_CALL(*this, onHostStatus(_, false));
+  EXPECT_CALL(*test_sessions_[0]->interval_timer_, enableTimer(_));
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, disableTimer());
+  respond(0, "200", false);
+  EXPECT_TRUE(cluster_->hosts_[0]->healthy());
+}
+
+TEST_F(HttpHealthCheckerImplTest, GrpcSuccess) {
+  setupGrpcHC();
+  EXPECT_CALL(*this, onHostStatus(_, false));
+
+  cluster_->hosts_ = {HostSharedPtr{new HostImpl(
+      cluster_->info_, "", Network::Utility::resolveUrl("tcp://127.0.0.1:80"), false, 1, "")}};
+  expectSessionCreate();
+  expectStreamCreate(0);
+  EXPECT_CALL(test_sessions_[0]->request_encoder_, encodeHeaders(_, false))
+      .WillOnce(Invoke([](const Http::HeaderMap& headers, bool) -> void {
+        EXPECT_STREQ("POST", headers.Method()->value().c_str());
+        EXPECT_STREQ("/grpc.health.v1.Health/Check", headers.Path()->value().c_str());
+        EXPECT_STREQ("application/grpc", headers.ContentType()->value().c_str());
+      }));
+  EXPECT_CALL(test_sessions_[0]->request_encoder_, encodeData(_, true))
+      .WillOnce(Invoke([](Buffer::Instance& data, bool) -> void {
+        Grpc::Decoder decoder;
+        std::vector<Grpc::Frame> frames;
+        ASSERT_TRUE(decoder.decode(data, frames));
+        ASSERT_EQ(1U, frames.size());
+        grpc::health::v1::HealthCheckRequest request;
+        ASSERT_TRUE(Grpc::Common::parseBody(*frames[0].data_, request));
+        EXPECT_EQ("locations", request.service());
+      }));
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, enableTimer(_));
+  health_checker_->start();
+
+  EXPECT_CALL(*test_sessions_[0]->interval_timer_, enableTimer(_));
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, disableTimer());
+  respondGrpc(0, grpc::health::v1::HealthCheckResponse::SERVING, "0");
+  EXPECT_TRUE(cluster_->hosts_[0]->healthy());
+  EXPECT_EQ(1UL, cluster_->info_->stats_store_.counter("health_check.success").value());
+}
+
+TEST_F(HttpHealthCheckerImplTest, GrpcNotServing) {
+  setupGrpcHC();
+  cluster_->hosts_ = {HostSharedPtr{new HostImpl(
+      cluster_->info_, "", Network::Utility::resolveUrl("tcp://127.0.0.1:80"), false, 1, "")}};
+  expectSessionCreate();
+  expectStreamCreate(0);
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, enableTimer(_));
+  health_checker_->start();
+
+  EXPECT_CALL(*this, onHostStatus(_, true));
+  EXPECT_CALL(*test_sessions_[0]->interval_timer_, enableTimer(_));
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, disableTimer());
+  respondGrpc(0, grpc::health::v1::HealthCheckResponse::NOT_SERVING, "0");
+  EXPECT_FALSE(cluster_->hosts_[0]->healthy());
+
+  // A gRPC error is a failure even if the body says the service is serving.
+  expectStreamCreate(0);
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, enableTimer(_));
+  test_sessions_[0]->interval_timer_->callback_();
+
+  EXPECT_CALL(*this, onHostStatus(_, false));
+  EXPECT_CALL(*test_sessions_[0]->interval_timer_, enableTimer(_));
+  EXPECT_CALL(*test_sessions_[0]->timeout_timer_, disableTimer());
+  respondGrpc(0, grpc::health::v1::HealthCheckResponse::SERVING, "14");
+  EXPECT_FALSE(cluster_->hosts_[0]->healthy());
+  EXPECT_EQ(2UL, cluster_->info_->stats_store_.counter("health_check.failure").value());
+}
+
 TEST(TcpHealthCheckMatcher, loadJsonBytes) {
   {
     std::string json = R"EOF(
@@ -683,6 +952,12 @@ TEST(TcpHealthCheckMatcher, match) {
   add_uint8(buffer, 1);
   add_uint8(buffer, 2);
   EXPECT_TRUE(TcpHealthCheckMatcher::match(segments, buffer));
+
+  // The segments must be found in order.
+  buffer.drain(4);
+  add_uint8(buffer, 2);
+  add_uint8(buffer, 1);
+  EXPECT_FALSE(TcpHealthCheckMatcher::match(segments, buffer));
 }
 
 class TcpHealthCheckerImplTest : public testing::Test {
@@ -0,0 +1,114 @@
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/network/utility.h"
+#include "common/runtime/runtime_impl.h"
+#include "common/upstream/load_balancer_impl.h"
+#include "common/upstream/upstream_impl.h"
+
+#include "test/mocks/runtime/mocks.h"
+#include "test/mocks/upstream/mocks.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+using testing::NiceMock;
+
+namespace Upstream {
+
+/**
+ * This test is for benchmarking only and should not be run as part of unit tests. It compares the
+ * rebuild time and pick latency of the weighted round robin, weighted random and least request load
+ * balancers for different weight distributions.
+ */
+class DISABLED_WeightedLoadBalancerBenchmark : public testing::Test {
+public:
+  static const uint32_t NumHosts = 10000;
+  static const uint32_t NumRebuilds = 10;
+  static const uint32_t NumPicks = 10000000;
+
+  DISABLED_WeightedLoadBalancerBenchmark() : stats_(ClusterInfoImpl::generateStats(stats_store_)) {
+    for (uint32_t i = 0; i < NumHosts; i++) {
+      cluster_.hosts_.push_back(std::make_shared<HostImpl>(
+          cluster_.info_, "",
+          Network::Utility::resolveUrl(fmt::format("tcp://10.0.{}.{}:80", i / 256, i % 256)),
+          false, 1, ""));
+    }
+    cluster_.healthy_hosts_ = cluster_.hosts_;
+  }
+
+  void setWeights(std::function<uint32_t(uint32_t)> weight) {
+    uint32_t max_weight = 1;
+    for (uint32_t i = 0; i < NumHosts; i++) {
+      cluster_.hosts_[i]->weight(weight(i));
+      max_weight = std::max(max_weight, cluster_.hosts_[i]->weight());
+    }
+    stats_.max_host_weight_.set(max_weight);
+  }
+
+  void run(const std::string& name, LoadBalancer& lb) {
+    // Picking right after an update pays for building the weighted structure.
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NumRebuilds; i++) {
+      cluster_.runCallbacks({}, {});
+      lb.chooseHost(nullptr);
+    }
+    std::chrono::nanoseconds rebuild = std::chrono::steady_clock::now() - start;
+
+    uintptr_t checksum = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NumPicks; i++) {
+      checksum += reinterpret_cast<uintptr_t>(lb.chooseHost(nullptr).get());
+    }
+    std::chrono::nanoseconds pick = std::chrono::steady_clock::now() - start;
+
+    const uint64_t rebuild_us =
+        std::chrono::duration_cast<std::chrono::microseconds>(rebuild).count() / NumRebuilds;
+    std::cout << fmt::format("{}: hosts={} max_weight={} rebuild={}us pick={}ns checksum={}", name,
+                             NumHosts, stats_.max_host_weight_.value(), rebuild_us,
+                             pick.count() / NumPicks, checksum)
+              << std::endl;
+  }
+
+  void runAll(const std::string& distribution) {
+    RoundRobinLoadBalancer round_robin(cluster_, nullptr, stats_, runtime_, random_);
+    run(distribution + "_round_robin", round_robin);
+    RandomLoadBalancer random(cluster_, nullptr, stats_, runtime_, random_);
+    run(distribution + "_random", random);
+    LeastRequestLoadBalancer least_request(cluster_, nullptr, stats_, runtime_, random_);
+    run(distribution + "_least_request", least_request);
+  }
+
+  NiceMock<MockCluster> cluster_;
+  Stats::IsolatedStoreImpl stats_store_;
+  ClusterStats stats_;
+  NiceMock<Runtime::MockLoader> runtime_;
+  Runtime::RandomGeneratorImpl random_;
+};
+
+const uint32_t DISABLED_WeightedLoadBalancerBenchmark::NumHosts;
+
+TEST_F(DISABLED_WeightedLoadBalancerBenchmark, Unweighted) {
+  setWeights([](uint32_t) -> uint32_t { return 1; });
+  runAll("unweighted");
+}
+
+TEST_F(DISABLED_WeightedLoadBalancerBenchmark, FewHeavyHosts) {
+  setWeights([](uint32_t i) -> uint32_t { return i % 100 == 0 ? 100 : 1; });
+  runAll("few_heavy");
+}
+
+TEST_F(DISABLED_WeightedLoadBalancerBenchmark, LinearWeights) {
+  setWeights([](uint32_t i) -> uint32_t { return 1 + i % 100; });
+  runAll("linear");
+}
+
+} // Upstream
+} // Envoy
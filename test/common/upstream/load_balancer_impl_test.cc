@@ -1,6 +1,7 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "common/network/utility.h"
@@ -16,6 +17,7 @@
 namespace Envoy {
 using testing::NiceMock;
 using testing::Return;
+using testing::ReturnRef;
 
 namespace Upstream {
 
@@ -25,6 +27,13 @@ static HostSharedPtr newTestHost(Upstream::ClusterInfoConstSharedPtr cluster,
       new HostImpl(cluster, "", Network::Utility::resolveUrl(url), false, weight, "")};
 }
 
+static HostSharedPtr newTestHost(Upstream::ClusterInfoConstSharedPtr cluster,
+                                 const std::string& url, const std::string& zone,
+                                 uint32_t priority) {
+  return HostSharedPtr{new HostImpl(cluster, "", Network::Utility::resolveUrl(url), false, 1, zone,
+                                    {}, priority)};
+}
+
 class RoundRobinLoadBalancerTest : public testing::Test {
 public:
   RoundRobinLoadBalancerTest() : stats_(ClusterInfoImpl::generateStats(stats_store_)) {}
@@ -96,6 +105,36 @@ TEST_F(RoundRobinLoadBalancerTest, MaxUnhealthyPanic) {
   EXPECT_EQ(3UL, stats_.lb_healthy_panic_.value());
 }
 
+TEST_F(RoundRobinLoadBalancerTest, Weighted) {
+  init(false);
+  cluster_.healthy_hosts_ = {newTestHost(cluster_.info_, "tcp://127.0.0.1:80", 1),
+                             newTestHost(cluster_.info_, "tcp://127.0.0.1:81", 4)};
+  cluster_.hosts_ = cluster_.healthy_hosts_;
+  stats_.max_host_weight_.set(4UL);
+
+  // The second host is picked four times as often and the first host gets its turn on a tie.
+  for (uint32_t i = 0; i < 2; i++) {
+    EXPECT_EQ(cluster_.healthy_hosts_[1], lb_->chooseHost(nullptr));
+    EXPECT_EQ(cluster_.healthy_hosts_[1], lb_->chooseHost(nullptr));
+    EXPECT_EQ(cluster_.healthy_hosts_[1], lb_->chooseHost(nullptr));
+    EXPECT_EQ(cluster_.healthy_hosts_[0], lb_->chooseHost(nullptr));
+    EXPECT_EQ(cluster_.healthy_hosts_[1], lb_->chooseHost(nullptr));
+  }
+
+  // A host set update rebuilds the schedule with the new weights.
+  cluster_.healthy_hosts_[0]->weight(4);
+  cluster_.runCallbacks({}, {});
+  EXPECT_EQ(cluster_.healthy_hosts_[0], lb_->chooseHost(nullptr));
+  EXPECT_EQ(cluster_.healthy_hosts_[1], lb_->chooseHost(nullptr));
+  EXPECT_EQ(cluster_.healthy_hosts_[0], lb_->chooseHost(nullptr));
+
+  // Weighting can be disabled in runtime.
+  EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.weight_enabled", 1))
+      .WillRepeatedly(Return(0));
+  EXPECT_EQ(cluster_.healthy_hosts_[0], lb_->chooseHost(nullptr));
+  EXPECT_EQ(cluster_.healthy_hosts_[1], lb_->chooseHost(nullptr));
+}
+
 TEST_F(RoundRobinLoadBalancerTest, ZoneAwareSmallCluster) {
   init(true);
   HostVectorSharedPtr hosts(
@@ -115,8 +154,8 @@ TEST_F(RoundRobinLoadBalancerTest, ZoneAwareSmallCluster) {
 
   EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.healthy_panic_threshold", 50))
       .WillRepeatedly(Return(50));
-  EXPECT_CALL(runtime_.snapshot_, featureEnabled("upstream.zone_routing.enabled", 100))
-      .WillRepeatedly(Return(true));
+  EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.zone_routing.enabled", 100))
+      .WillRepeatedly(Return(100));
   EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.zone_routing.min_cluster_size", 6))
       .WillRepeatedly(Return(6));
 
@@ -157,8 +196,8 @@ TEST_F(RoundRobinLoadBalancerTest, NoZoneAwareDifferentZoneSize) {
 
   EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.healthy_panic_threshold", 50))
       .WillRepeatedly(Return(50));
-  EXPECT_CALL(runtime_.snapshot_, featureEnabled("upstream.zone_routing.enabled", 100))
-      .WillRepeatedly(Return(true));
+  EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.zone_routing.enabled", 100))
+      .WillRepeatedly(Return(100));
 
   EXPECT_EQ(cluster_.healthy_hosts_[0], lb_->chooseHost(nullptr));
   EXPECT_EQ(1U, stats_.lb_zone_number_differs_.value());
@@ -177,8 +216,8 @@ TEST_F(RoundRobinLoadBalancerTest, ZoneAwareRoutingLargeZoneSwitchOnOff) {
 
   EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.healthy_panic_threshold", 50))
       .WillRepeatedly(Return(50));
-  EXPECT_CALL(runtime_.snapshot_, featureEnabled("upstream.zone_routing.enabled", 100))
-      .WillRepeatedly(Return(true));
+  EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.zone_routing.enabled", 100))
+      .WillRepeatedly(Return(100));
   EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.zone_routing.min_cluster_size", 6))
       .WillRepeatedly(Return(3));
 
@@ -194,9 +233,11 @@ TEST_F(RoundRobinLoadBalancerTest, ZoneAwareRoutingLargeZoneSwitchOnOff) {
   EXPECT_EQ(cluster_.healthy_hosts_per_zone_[0][0], lb_->chooseHost(nullptr));
   EXPECT_EQ(2U, stats_.lb_zone_routing_all_directly_.value());
 
-  // Disable runtime global zone routing.
-  EXPECT_CALL(runtime_.snapshot_, featureEnabled("upstream.zone_routing.enabled", 100))
-      .WillRepeatedly(Return(false));
+  // Disable runtime global zone routing. Runtime values are cached until a new snapshot is loaded.
+  NiceMock<Runtime::MockSnapshot> snapshot;
+  EXPECT_CALL(runtime_, snapshot()).WillRepeatedly(ReturnRef(snapshot));
+  EXPECT_CALL(snapshot, getInteger("upstream.healthy_panic_threshold", 50)).WillOnce(Return(50));
+  EXPECT_CALL(snapshot, getInteger("upstream.zone_routing.enabled", 100)).WillOnce(Return(0));
   EXPECT_EQ(cluster_.healthy_hosts_[2], lb_->chooseHost(nullptr));
 }
 
@@ -227,8 +268,8 @@ TEST_F(RoundRobinLoadBalancerTest, ZoneAwareRoutingSmallZone) {
 
   EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.healthy_panic_threshold", 50))
       .WillRepeatedly(Return(50));
-  EXPECT_CALL(runtime_.snapshot_, featureEnabled("upstream.zone_routing.enabled", 100))
-      .WillRepeatedly(Return(true));
+  EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.zone_routing.enabled", 100))
+      .WillRepeatedly(Return(100));
   EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.zone_routing.min_cluster_size", 6))
       .WillRepeatedly(Return(5));
 
@@ -238,15 +279,27 @@ TEST_F(RoundRobinLoadBalancerTest, ZoneAwareRoutingSmallZone) {
   local_cluster_hosts_->updateHosts(local_hosts, local_hosts, local_hosts_per_zone,
                                     local_hosts_per_zone, empty_host_vector_, empty_host_vector_);
 
-  // There is only one host in the given zone for zone aware routing.
-  EXPECT_CALL(random_, random()).WillOnce(Return(100));
+  // 60% of the requests stay in the local zone and the remaining 40% are split evenly between the
+  // other two zones. The alias table is {10000, 6000 -> 0, 6000 -> 0}. Column 0 always routes to
+  // the local zone.
+  EXPECT_CALL(random_, random()).WillOnce(Return(0));
   EXPECT_EQ(cluster_.healthy_hosts_per_zone_[0][0], lb_->chooseHost(nullptr));
   EXPECT_EQ(1U, stats_.lb_zone_routing_sampled_.value());
 
-  // Force request out of small zone.
-  EXPECT_CALL(random_, random()).WillOnce(Return(9999)).WillOnce(Return(2));
+  // Force request out of small zone with column 1 and a coin under its probability.
+  EXPECT_CALL(random_, random()).WillOnce(Return(1));
   EXPECT_EQ(cluster_.healthy_hosts_per_zone_[1][1], lb_->chooseHost(nullptr));
   EXPECT_EQ(1U, stats_.lb_zone_routing_cross_zone_.value());
+
+  // Column 2 with a coin of 6000 falls through to its alias, the local zone.
+  EXPECT_CALL(random_, random()).WillOnce(Return(2 + 3 * 6000));
+  EXPECT_EQ(cluster_.healthy_hosts_per_zone_[0][0], lb_->chooseHost(nullptr));
+  EXPECT_EQ(2U, stats_.lb_zone_routing_sampled_.value());
+
+  // Column 2 with a coin of 5999 stays in zone 2.
+  EXPECT_CALL(random_, random()).WillOnce(Return(2 + 3 * 5999));
+  EXPECT_EQ(cluster_.healthy_hosts_per_zone_[2][1], lb_->chooseHost(nullptr));
+  EXPECT_EQ(2U, stats_.lb_zone_routing_cross_zone_.value());
 }
 
 TEST_F(RoundRobinLoadBalancerTest, LowPrecisionForDistribution) {
@@ -265,8 +318,8 @@ TEST_F(RoundRobinLoadBalancerTest, LowPrecisionForDistribution) {
 
   EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.healthy_panic_threshold", 50))
       .WillRepeatedly(Return(50));
-  EXPECT_CALL(runtime_.snapshot_, featureEnabled("upstream.zone_routing.enabled", 100))
-      .WillRepeatedly(Return(true));
+  EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.zone_routing.enabled", 100))
+      .WillRepeatedly(Return(100));
   EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.zone_routing.min_cluster_size", 6))
       .WillRepeatedly(Return(1));
 
@@ -306,10 +359,17 @@ TEST_F(RoundRobinLoadBalancerTest, LowPrecisionForDistribution) {
   local_cluster_hosts_->updateHosts(local_hosts, local_hosts, local_hosts_per_zone,
                                     local_hosts_per_zone, empty_host_vector_, empty_host_vector_);
 
-  // Force request out of small zone and to randomly select zone.
-  EXPECT_CALL(random_, random()).WillOnce(Return(9999)).WillOnce(Return(2));
+  // Force request out of small zone. With no residual capacity left, the cross zone share is spread
+  // evenly and the alias table is {10000, 3 -> 0}.
+  EXPECT_CALL(random_, random()).WillOnce(Return(1));
+  lb_->chooseHost(nullptr);
+  EXPECT_EQ(1U, stats_.lb_zone_no_capacity_left_.value());
+  EXPECT_EQ(1U, stats_.lb_zone_routing_cross_zone_.value());
+
+  EXPECT_CALL(random_, random()).WillOnce(Return(1 + 2 * 3));
   lb_->chooseHost(nullptr);
   EXPECT_EQ(1U, stats_.lb_zone_no_capacity_left_.value());
+  EXPECT_EQ(1U, stats_.lb_zone_routing_sampled_.value());
 }
 
 TEST_F(RoundRobinLoadBalancerTest, NoZoneAwareRoutingOneZone) {
@@ -360,11 +420,11 @@ TEST_F(RoundRobinLoadBalancerTest, NoZoneAwareRoutingLocalEmpty) {
        {newTestHost(cluster_.info_, "tcp://127.0.0.1:81")}}));
   HostListsSharedPtr local_hosts_per_zone(new std::vector<std::vector<HostSharedPtr>>({{}, {}}));
 
+  // Runtime is read once for the snapshot even though both clusters are checked for panic.
   EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.healthy_panic_threshold", 50))
-      .WillOnce(Return(50))
       .WillOnce(Return(50));
-  EXPECT_CALL(runtime_.snapshot_, featureEnabled("upstream.zone_routing.enabled", 100))
-      .WillOnce(Return(true));
+  EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.zone_routing.enabled", 100))
+      .WillOnce(Return(100));
   EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.zone_routing.min_cluster_size", 6))
       .WillOnce(Return(1));
 
@@ -379,6 +439,83 @@ TEST_F(RoundRobinLoadBalancerTest, NoZoneAwareRoutingLocalEmpty) {
   EXPECT_EQ(1U, stats_.lb_local_cluster_not_ok_.value());
 }
 
+TEST_F(RoundRobinLoadBalancerTest, PriorityFailover) {
+  init(false);
+  cluster_.hosts_ = {newTestHost(cluster_.info_, "tcp://127.0.0.1:80", "", 0),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:81", "", 0),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:82", "", 0),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:83", "", 1),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:84", "", 1),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:85", "", 1)};
+  cluster_.healthy_hosts_ = cluster_.hosts_;
+  cluster_.runCallbacks({}, {});
+
+  // All of the traffic goes to the healthy priority 0 hosts.
+  EXPECT_CALL(random_, random()).WillOnce(Return(99));
+  EXPECT_EQ(0U, lb_->chooseHost(nullptr)->priority());
+  EXPECT_EQ(0U, stats_.lb_priority_failover_.value());
+
+  // With two of its three hosts healthy, priority 0 has a health of 93 and keeps 93% of the
+  // traffic.
+  cluster_.healthy_hosts_ = {cluster_.hosts_[1], cluster_.hosts_[2], cluster_.hosts_[3],
+                             cluster_.hosts_[4], cluster_.hosts_[5]};
+  cluster_.runCallbacks({}, {});
+  EXPECT_CALL(random_, random()).WillOnce(Return(92));
+  EXPECT_EQ(0U, lb_->chooseHost(nullptr)->priority());
+  EXPECT_CALL(random_, random()).WillOnce(Return(93));
+  EXPECT_EQ(1U, lb_->chooseHost(nullptr)->priority());
+  EXPECT_EQ(1U, stats_.lb_priority_failover_.value());
+
+  // Without healthy priority 0 hosts, all of the traffic fails over to priority 1.
+  cluster_.healthy_hosts_ = {cluster_.hosts_[3], cluster_.hosts_[4], cluster_.hosts_[5]};
+  cluster_.runCallbacks({}, {});
+  EXPECT_CALL(random_, random()).WillOnce(Return(0));
+  EXPECT_EQ(1U, lb_->chooseHost(nullptr)->priority());
+  EXPECT_EQ(2U, stats_.lb_priority_failover_.value());
+
+  // When the levels together are not healthy enough to take all of the traffic, it is spread by
+  // their health. Both levels have a health of 46 here, so they get half of the traffic each and
+  // only their healthy hosts are used.
+  cluster_.healthy_hosts_ = {cluster_.hosts_[1], cluster_.hosts_[5]};
+  cluster_.runCallbacks({}, {});
+  EXPECT_CALL(random_, random()).WillOnce(Return(49));
+  EXPECT_EQ(cluster_.hosts_[1], lb_->chooseHost(nullptr));
+  EXPECT_CALL(random_, random()).WillOnce(Return(50));
+  EXPECT_EQ(cluster_.hosts_[5], lb_->chooseHost(nullptr));
+  EXPECT_EQ(3U, stats_.lb_priority_failover_.value());
+
+  // Below the panic threshold all hosts are used.
+  cluster_.healthy_hosts_ = {cluster_.hosts_[1]};
+  cluster_.runCallbacks({}, {});
+  EXPECT_CALL(random_, random()).Times(0);
+  EXPECT_NE(nullptr, lb_->chooseHost(nullptr));
+  EXPECT_EQ(1U, stats_.lb_healthy_panic_.value());
+}
+
+TEST_F(RoundRobinLoadBalancerTest, LocalityWeights) {
+  init(false);
+  cluster_.info_->locality_weights_ = {{"a", 1}, {"b", 3}};
+  cluster_.hosts_ = {newTestHost(cluster_.info_, "tcp://127.0.0.1:80", "a", 0),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:81", "b", 0),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:82", "c", 0),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:83", "c", 0)};
+  cluster_.healthy_hosts_ = {cluster_.hosts_[0], cluster_.hosts_[1], cluster_.hosts_[2]};
+  cluster_.runCallbacks({}, {});
+
+  // Locality "c" has no configured weight and half of its hosts are healthy, so the localities are
+  // picked in proportion 1:3:0.7. The high part of the random value covers every column and coin
+  // of the locality alias table once.
+  std::unordered_map<HostConstSharedPtr, uint64_t> picks;
+  for (uint64_t i = 0; i < 3 * AliasTable::Scale; ++i) {
+    EXPECT_CALL(random_, random()).WillOnce(Return(i * 100));
+    picks[lb_->chooseHost(nullptr)]++;
+  }
+  EXPECT_EQ(6382U, picks[cluster_.hosts_[0]]);
+  EXPECT_EQ(19150U, picks[cluster_.hosts_[1]]);
+  EXPECT_EQ(4468U, picks[cluster_.hosts_[2]]);
+  EXPECT_EQ(0U, stats_.lb_priority_failover_.value());
+}
+
 class LeastRequestLoadBalancerTest : public testing::Test {
 public:
   LeastRequestLoadBalancerTest() : stats_(ClusterInfoImpl::generateStats(stats_store_)) {}
@@ -454,6 +591,8 @@ TEST_F(LeastRequestLoadBalancerTest, WeightImbalanceRuntimeOff) {
       .WillRepeatedly(Return(0));
   EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.healthy_panic_threshold", 50))
       .WillRepeatedly(Return(50));
+  EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.least_request.p2c_enabled", 0))
+      .WillRepeatedly(Return(0));
 
   cluster_.healthy_hosts_ = {newTestHost(cluster_.info_, "tcp://127.0.0.1:80", 1),
                              newTestHost(cluster_.info_, "tcp://127.0.0.1:81", 3)};
@@ -483,6 +622,8 @@ TEST_F(LeastRequestLoadBalancerTest, WeightImbalance) {
       .WillRepeatedly(Return(1));
   EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.healthy_panic_threshold", 50))
       .WillRepeatedly(Return(50));
+  EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.least_request.p2c_enabled", 0))
+      .WillRepeatedly(Return(0));
 
   // As max weight higher then 1 we do random host pick and keep it for weight requests.
   EXPECT_CALL(random_, random()).WillOnce(Return(1));
@@ -537,6 +678,67 @@ TEST_F(LeastRequestLoadBalancerTest, WeightImbalanceCallbacks) {
   EXPECT_EQ(cluster_.healthy_hosts_[0], lb_.chooseHost(nullptr));
 }
 
+TEST_F(LeastRequestLoadBalancerTest, P2cWeighted) {
+  cluster_.healthy_hosts_ = {newTestHost(cluster_.info_, "tcp://127.0.0.1:80", 1),
+                             newTestHost(cluster_.info_, "tcp://127.0.0.1:81", 3)};
+  cluster_.hosts_ = cluster_.healthy_hosts_;
+  stats_.max_host_weight_.set(3UL);
+  ON_CALL(runtime_.snapshot_, getInteger("upstream.least_request.p2c_enabled", 0))
+      .WillByDefault(Return(1));
+
+  // Requests per unit of weight including the new one: 2 / 1 vs. 5 / 3.
+  cluster_.healthy_hosts_[0]->incActiveRequests();
+  for (int i = 0; i < 4; i++) {
+    cluster_.healthy_hosts_[1]->incActiveRequests();
+  }
+  EXPECT_CALL(random_, random()).WillOnce(Return(0)).WillOnce(Return(1));
+  EXPECT_EQ(cluster_.healthy_hosts_[1], lb_.chooseHost(nullptr));
+
+  // 2 / 1 vs. 7 / 3.
+  cluster_.healthy_hosts_[1]->incActiveRequests();
+  cluster_.healthy_hosts_[1]->incActiveRequests();
+  EXPECT_CALL(random_, random()).WillOnce(Return(0)).WillOnce(Return(1));
+  EXPECT_EQ(cluster_.healthy_hosts_[0], lb_.chooseHost(nullptr));
+
+  // Two random hosts are compared on every pick, even though the weights are unequal.
+  cluster_.healthy_hosts_[1]->decActiveRequests();
+  cluster_.healthy_hosts_[1]->decActiveRequests();
+  EXPECT_CALL(random_, random()).WillOnce(Return(1)).WillOnce(Return(0));
+  EXPECT_EQ(cluster_.healthy_hosts_[1], lb_.chooseHost(nullptr));
+
+  // With weighting disabled only the active requests are compared.
+  ON_CALL(runtime_.snapshot_, getInteger("upstream.weight_enabled", 1)).WillByDefault(Return(0));
+  EXPECT_CALL(random_, random()).WillOnce(Return(0)).WillOnce(Return(1));
+  EXPECT_EQ(cluster_.healthy_hosts_[0], lb_.chooseHost(nullptr));
+}
+
+TEST_F(LeastRequestLoadBalancerTest, P2cPeakEwma) {
+  cluster_.healthy_hosts_ = {newTestHost(cluster_.info_, "tcp://127.0.0.1:80"),
+                             newTestHost(cluster_.info_, "tcp://127.0.0.1:81")};
+  cluster_.hosts_ = cluster_.healthy_hosts_;
+  stats_.max_host_weight_.set(1UL);
+  ON_CALL(runtime_.snapshot_, getInteger("upstream.least_request.p2c_enabled", 0))
+      .WillByDefault(Return(1));
+
+  Outlier::MockDetectorHostSink* detector1 = new NiceMock<Outlier::MockDetectorHostSink>();
+  Outlier::MockDetectorHostSink* detector2 = new NiceMock<Outlier::MockDetectorHostSink>();
+  cluster_.healthy_hosts_[0]->setOutlierDetector(Outlier::DetectorHostSinkPtr{detector1});
+  cluster_.healthy_hosts_[1]->setOutlierDetector(Outlier::DetectorHostSinkPtr{detector2});
+  ON_CALL(*detector1, responseTimeEwma()).WillByDefault(Return(10));
+  ON_CALL(*detector2, responseTimeEwma()).WillByDefault(Return(2));
+  cluster_.healthy_hosts_[1]->incActiveRequests();
+
+  // Response times are ignored unless enabled.
+  EXPECT_CALL(random_, random()).WillOnce(Return(0)).WillOnce(Return(1));
+  EXPECT_EQ(cluster_.healthy_hosts_[0], lb_.chooseHost(nullptr));
+
+  // 1 * 11 vs. 2 * 3.
+  ON_CALL(runtime_.snapshot_, getInteger("upstream.least_request.peak_ewma_enabled", 0))
+      .WillByDefault(Return(1));
+  EXPECT_CALL(random_, random()).WillOnce(Return(0)).WillOnce(Return(1));
+  EXPECT_EQ(cluster_.healthy_hosts_[1], lb_.chooseHost(nullptr));
+}
+
 class RandomLoadBalancerTest : public testing::Test {
 public:
   RandomLoadBalancerTest() : stats_(ClusterInfoImpl::generateStats(stats_store_)) {}
@@ -560,5 +762,29 @@ TEST_F(RandomLoadBalancerTest, Normal) {
   EXPECT_EQ(cluster_.healthy_hosts_[1], lb_.chooseHost(nullptr));
 }
 
+TEST_F(RandomLoadBalancerTest, Weighted) {
+  cluster_.healthy_hosts_ = {newTestHost(cluster_.info_, "tcp://127.0.0.1:80", 1),
+                             newTestHost(cluster_.info_, "tcp://127.0.0.1:81", 3)};
+  cluster_.hosts_ = cluster_.healthy_hosts_;
+  stats_.max_host_weight_.set(3UL);
+
+  // The alias table is {5000 -> 1, 10000}: the first host keeps half of its column.
+  EXPECT_CALL(random_, random())
+      .WillOnce(Return(0))
+      .WillOnce(Return(2 * 4999))
+      .WillOnce(Return(2 * 5000))
+      .WillOnce(Return(1));
+  EXPECT_EQ(cluster_.healthy_hosts_[0], lb_.chooseHost(nullptr));
+  EXPECT_EQ(cluster_.healthy_hosts_[0], lb_.chooseHost(nullptr));
+  EXPECT_EQ(cluster_.healthy_hosts_[1], lb_.chooseHost(nullptr));
+  EXPECT_EQ(cluster_.healthy_hosts_[1], lb_.chooseHost(nullptr));
+
+  // A host set update rebuilds the table with the new weights.
+  cluster_.healthy_hosts_[0]->weight(3);
+  cluster_.runCallbacks({}, {});
+  EXPECT_CALL(random_, random()).WillOnce(Return(2 * 5000));
+  EXPECT_EQ(cluster_.healthy_hosts_[0], lb_.chooseHost(nullptr));
+}
+
 } // Upstream
 } // Envoy
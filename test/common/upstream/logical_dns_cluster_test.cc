@@ -21,6 +21,7 @@ namespace Envoy {
 using testing::_;
 using testing::Invoke;
 using testing::NiceMock;
+using testing::Return;
 
 namespace Upstream {
 
@@ -185,14 +186,24 @@ TEST_F(LogicalDnsClusterTest, Basic) {
   dns_callback_(TestUtility::makeDnsResponse({"127.0.0.1", "127.0.0.2", "127.0.0.3"}));
 
   EXPECT_EQ(logical_host, cluster_->hosts()[0]);
+  Network::MockClientConnection* connection = new NiceMock<Network::MockClientConnection>();
   EXPECT_CALL(dispatcher_, createClientConnection_(
                                PointeesEq(Network::Utility::resolveUrl("tcp://127.0.0.1:443"))))
-      .WillOnce(Return(new NiceMock<Network::MockClientConnection>()));
+      .WillOnce(Return(connection));
+  // The rest of the resolved addresses are raced against the first.
+  EXPECT_CALL(*connection, setAlternateAddresses(_))
+      .WillOnce(Invoke([](const std::vector<Network::Address::InstanceConstSharedPtr>& addresses)
+                           -> void {
+                             ASSERT_EQ(2U, addresses.size());
+                             EXPECT_EQ("127.0.0.2:443", addresses[0]->asString());
+                             EXPECT_EQ("127.0.0.3:443", addresses[1]->asString());
+                           }));
   Host::CreateConnectionData data = logical_host->createConnection(dispatcher_);
   EXPECT_FALSE(data.host_description_->canary());
   EXPECT_EQ(&cluster_->hosts()[0]->cluster(), &data.host_description_->cluster());
   EXPECT_EQ(&cluster_->hosts()[0]->stats(), &data.host_description_->stats());
   EXPECT_EQ("127.0.0.1:443", data.host_description_->address()->asString());
+  EXPECT_EQ(3U, data.host_description_->addressList().size());
   EXPECT_EQ("", data.host_description_->zone());
   EXPECT_EQ("foo.bar.com", data.host_description_->hostname());
   data.host_description_->outlierDetector().putHttpResponseCode(200);
@@ -0,0 +1,165 @@
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common/network/utility.h"
+#include "common/upstream/maglev_lb.h"
+#include "common/upstream/upstream_impl.h"
+
+#include "test/mocks/runtime/mocks.h"
+#include "test/mocks/upstream/mocks.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace Envoy {
+using testing::NiceMock;
+using testing::Return;
+
+namespace Upstream {
+
+static HostSharedPtr newTestHost(Upstream::ClusterInfoConstSharedPtr cluster,
+                                 const std::string& url) {
+  return std::make_shared<HostImpl>(cluster, "", Network::Utility::resolveUrl(url), false, 1, "");
+}
+
+class TestLoadBalancerContext : public LoadBalancerContext {
+public:
+  TestLoadBalancerContext(uint64_t hash_key) : hash_key_(hash_key) {}
+
+  // Upstream::LoadBalancerContext
+  const Optional<uint64_t>& hashKey() const override { return hash_key_; }
+  const HostMetadata* metadataMatchCriteria() const override { return nullptr; }
+  const Network::Connection* downstreamConnection() const override { return nullptr; }
+  const Http::HeaderMap* downstreamHeaders() const override { return nullptr; }
+
+  Optional<uint64_t> hash_key_;
+};
+
+class MaglevLoadBalancerTest : public testing::Test {
+public:
+  MaglevLoadBalancerTest() : stats_(ClusterInfoImpl::generateStats(stats_store_)) {}
+
+  // Map every table slot to the host chosen for it.
+  std::vector<HostConstSharedPtr> chooseAll(LoadBalancer& lb) {
+    std::vector<HostConstSharedPtr> hosts;
+    for (uint64_t i = 0; i < MaglevLoadBalancer::TableSize; i++) {
+      TestLoadBalancerContext context(i);
+      hosts.push_back(lb.chooseHost(&context));
+    }
+    return hosts;
+  }
+
+  NiceMock<MockCluster> cluster_;
+  Stats::IsolatedStoreImpl stats_store_;
+  ClusterStats stats_;
+  NiceMock<Runtime::MockLoader> runtime_;
+  NiceMock<Runtime::MockRandomGenerator> random_;
+  MaglevLoadBalancer lb_{cluster_, stats_, runtime_, random_};
+};
+
+TEST_F(MaglevLoadBalancerTest, NoHost) { EXPECT_EQ(nullptr, lb_.chooseHost(nullptr)); };
+
+TEST_F(MaglevLoadBalancerTest, Basic) {
+  cluster_.hosts_ = {newTestHost(cluster_.info_, "tcp://127.0.0.1:80"),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:81"),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:82"),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:83"),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:84"),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:85")};
+  cluster_.healthy_hosts_ = cluster_.hosts_;
+  cluster_.runCallbacks({}, {});
+
+  // Every host owns an equal share of the table, to within one slot.
+  std::unordered_map<HostConstSharedPtr, uint64_t> slots;
+  for (const HostConstSharedPtr& host : chooseAll(lb_)) {
+    slots[host]++;
+  }
+  EXPECT_EQ(6UL, slots.size());
+  for (const auto& host_slots : slots) {
+    EXPECT_LE(MaglevLoadBalancer::TableSize / 6, host_slots.second);
+    EXPECT_GE(MaglevLoadBalancer::TableSize / 6 + 1, host_slots.second);
+  }
+
+  // Hash keys wrap around the table.
+  {
+    TestLoadBalancerContext context1(1);
+    TestLoadBalancerContext context2(MaglevLoadBalancer::TableSize + 1);
+    EXPECT_EQ(lb_.chooseHost(&context1), lb_.chooseHost(&context2));
+  }
+  {
+    TestLoadBalancerContext context(7);
+    EXPECT_CALL(random_, random()).WillOnce(Return(7));
+    EXPECT_EQ(lb_.chooseHost(&context), lb_.chooseHost(nullptr));
+  }
+
+  // With no healthy hosts we are in panic mode and use the table for all hosts.
+  std::vector<HostConstSharedPtr> all_hosts = chooseAll(lb_);
+  cluster_.healthy_hosts_.clear();
+  cluster_.runCallbacks({}, {});
+  EXPECT_EQ(all_hosts, chooseAll(lb_));
+}
+
+TEST_F(MaglevLoadBalancerTest, HealthyHostsOnly) {
+  cluster_.hosts_ = {newTestHost(cluster_.info_, "tcp://127.0.0.1:80"),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:81"),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:82")};
+  cluster_.healthy_hosts_ = {cluster_.hosts_[0], cluster_.hosts_[1]};
+  cluster_.runCallbacks({}, {});
+
+  for (const HostConstSharedPtr& host : chooseAll(lb_)) {
+    EXPECT_NE(cluster_.hosts_[2], host);
+  }
+}
+
+TEST_F(MaglevLoadBalancerTest, RemoveHost) {
+  for (uint32_t port = 80; port < 90; port++) {
+    cluster_.hosts_.push_back(newTestHost(cluster_.info_, fmt::format("tcp://127.0.0.1:{}", port)));
+  }
+  cluster_.healthy_hosts_ = cluster_.hosts_;
+  cluster_.runCallbacks({}, {});
+  std::vector<HostConstSharedPtr> before = chooseAll(lb_);
+
+  HostConstSharedPtr removed = cluster_.hosts_[3];
+  cluster_.hosts_.erase(cluster_.hosts_.begin() + 3);
+  cluster_.healthy_hosts_ = cluster_.hosts_;
+  cluster_.runCallbacks({}, {});
+  std::vector<HostConstSharedPtr> after = chooseAll(lb_);
+
+  // Keys that went to the removed host are spread over the others, and only a small fraction of
+  // the remaining keys change hosts.
+  uint64_t moved = 0;
+  for (uint64_t i = 0; i < MaglevLoadBalancer::TableSize; i++) {
+    EXPECT_NE(removed, after[i]);
+    if (before[i] != removed && before[i] != after[i]) {
+      moved++;
+    }
+  }
+  EXPECT_GT(MaglevLoadBalancer::TableSize / 50, moved);
+}
+
+TEST_F(MaglevLoadBalancerTest, SharedTables) {
+  LoadBalancerTableConstSharedPtr table;
+  MaglevLoadBalancer shared_lb{cluster_, stats_, runtime_, random_, table};
+  EXPECT_EQ(nullptr, shared_lb.chooseHost(nullptr));
+
+  // Load balancers that pick from tables built by a TableBuilder choose the same hosts as a load
+  // balancer that builds its own.
+  MaglevLoadBalancer::TableBuilder builder;
+  cluster_.hosts_ = {newTestHost(cluster_.info_, "tcp://127.0.0.1:80"),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:81"),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:82")};
+  cluster_.healthy_hosts_ = cluster_.hosts_;
+  table = builder.build(cluster_);
+  cluster_.runCallbacks({}, {});
+  EXPECT_EQ(chooseAll(lb_), chooseAll(shared_lb));
+
+  cluster_.healthy_hosts_ = {cluster_.hosts_[0]};
+  table = builder.build(cluster_);
+  cluster_.runCallbacks({}, {});
+  EXPECT_EQ(chooseAll(lb_), chooseAll(shared_lb));
+}
+
+} // Upstream
+} // Envoy
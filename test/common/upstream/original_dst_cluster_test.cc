@@ -0,0 +1,190 @@
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/network/utility.h"
+#include "common/upstream/original_dst_cluster.h"
+
+#include "test/mocks/common.h"
+#include "test/mocks/network/mocks.h"
+#include "test/mocks/runtime/mocks.h"
+#include "test/mocks/ssl/mocks.h"
+#include "test/mocks/upstream/mocks.h"
+#include "test/test_common/utility.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace Envoy {
+using testing::NiceMock;
+using testing::ReturnRef;
+using testing::SaveArg;
+using testing::_;
+
+namespace Upstream {
+
+class TestLoadBalancerContext : public LoadBalancerContext {
+public:
+  TestLoadBalancerContext(const Network::Connection* connection) : connection_(connection) {}
+
+  // Upstream::LoadBalancerContext
+  const Optional<uint64_t>& hashKey() const override { return hash_key_; }
+  const HostMetadata* metadataMatchCriteria() const override { return nullptr; }
+  const Network::Connection* downstreamConnection() const override { return connection_; }
+  const Http::HeaderMap* downstreamHeaders() const override { return nullptr; }
+
+  Optional<uint64_t> hash_key_;
+  const Network::Connection* connection_;
+};
+
+class OriginalDstClusterTest : public testing::Test {
+public:
+  void setup(const std::string& json) {
+    Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
+    cluster_.reset(new OriginalDstCluster(*config, runtime_, stats_store_, ssl_context_manager_));
+  }
+
+  Stats::IsolatedStoreImpl stats_store_;
+  Ssl::MockContextManager ssl_context_manager_;
+  NiceMock<Runtime::MockLoader> runtime_;
+  std::unique_ptr<OriginalDstCluster> cluster_;
+};
+
+TEST_F(OriginalDstClusterTest, Config) {
+  setup(R"EOF(
+  {
+    "name": "name",
+    "connect_timeout_ms": 250,
+    "type": "original_dst",
+    "lb_type": "original_dst_lb",
+    "cleanup_interval_ms": 1000
+  }
+  )EOF");
+
+  EXPECT_EQ(LoadBalancerType::OriginalDst, cluster_->info()->lbType());
+  EXPECT_EQ(std::chrono::milliseconds(1000), cluster_->info()->hostCleanupInterval());
+  EXPECT_TRUE(cluster_->hosts().empty());
+  ReadyWatcher initialized;
+  EXPECT_CALL(initialized, ready());
+  cluster_->setInitializedCb([&]() -> void { initialized.ready(); });
+}
+
+TEST_F(OriginalDstClusterTest, BadConfig) {
+  EXPECT_THROW_WITH_MESSAGE(setup(R"EOF(
+  {
+    "name": "name",
+    "connect_timeout_ms": 250,
+    "type": "original_dst",
+    "lb_type": "original_dst_lb",
+    "hosts": [{"url": "tcp://127.0.0.1:11001"}]
+  }
+  )EOF"),
+                            EnvoyException, "original_dst clusters must have no hosts");
+
+  EXPECT_THROW_WITH_MESSAGE(
+      setup(R"EOF(
+  {
+    "name": "name",
+    "connect_timeout_ms": 250,
+    "type": "original_dst",
+    "lb_type": "round_robin"
+  }
+  )EOF"),
+      EnvoyException,
+      "cluster: LB type 'original_dst_lb' may only be used with cluster type 'original_dst'");
+
+  EXPECT_THROW_WITH_MESSAGE(
+      setup(R"EOF(
+  {
+    "name": "name",
+    "connect_timeout_ms": 250,
+    "type": "original_dst",
+    "lb_type": "original_dst_lb",
+    "lb_subset_config": {"subset_keys": [["version"]]}
+  }
+  )EOF"),
+      EnvoyException, "cluster: LB type 'original_dst_lb' may not be used with lb_subset_config");
+}
+
+class OriginalDstLoadBalancerTest : public testing::Test {
+public:
+  OriginalDstLoadBalancerTest() {
+    cleanup_timer_ = new Event::MockTimer(&dispatcher_);
+    EXPECT_CALL(*cleanup_timer_, enableTimer(std::chrono::milliseconds(5000)));
+    lb_.reset(new OriginalDstCluster::LoadBalancer(
+        info_, dispatcher_, [this](const std::vector<HostSharedPtr>& hosts_removed) -> void {
+          hostsRemoved(hosts_removed);
+        }));
+  }
+
+  MOCK_METHOD1(hostsRemoved, void(const std::vector<HostSharedPtr>& hosts_removed));
+
+  HostConstSharedPtr chooseHost(const std::string& local_address) {
+    Network::Address::InstanceConstSharedPtr address =
+        Network::Utility::resolveUrl(local_address);
+    NiceMock<Network::MockConnection> connection;
+    ON_CALL(connection, localAddress()).WillByDefault(ReturnRef(*address));
+    TestLoadBalancerContext context(&connection);
+    return lb_->chooseHost(&context);
+  }
+
+  std::shared_ptr<NiceMock<MockClusterInfo>> info_{new NiceMock<MockClusterInfo>()};
+  NiceMock<Event::MockDispatcher> dispatcher_;
+  Event::MockTimer* cleanup_timer_;
+  std::unique_ptr<OriginalDstCluster::LoadBalancer> lb_;
+};
+
+TEST_F(OriginalDstLoadBalancerTest, NoContext) {
+  EXPECT_EQ(nullptr, lb_->chooseHost(nullptr));
+  TestLoadBalancerContext context(nullptr);
+  EXPECT_EQ(nullptr, lb_->chooseHost(&context));
+  EXPECT_EQ(nullptr, chooseHost("unix://foo"));
+}
+
+TEST_F(OriginalDstLoadBalancerTest, HostPerDestination) {
+  HostConstSharedPtr host = chooseHost("tcp://10.0.0.1:80");
+  ASSERT_NE(nullptr, host);
+  EXPECT_EQ("10.0.0.1:80", host->address()->asString());
+  EXPECT_EQ(info_.get(), &host->cluster());
+
+  EXPECT_EQ(host, chooseHost("tcp://10.0.0.1:80"));
+  EXPECT_NE(host, chooseHost("tcp://10.0.0.1:443"));
+  HostConstSharedPtr ipv6_host = chooseHost("tcp://[::1]:80");
+  ASSERT_NE(nullptr, ipv6_host);
+  EXPECT_EQ("[::1]:80", ipv6_host->address()->asString());
+
+  std::vector<HostSharedPtr> hosts_removed;
+  EXPECT_CALL(*this, hostsRemoved(_)).WillOnce(SaveArg<0>(&hosts_removed));
+  lb_.reset();
+  EXPECT_EQ(3U, hosts_removed.size());
+}
+
+TEST_F(OriginalDstLoadBalancerTest, Cleanup) {
+  HostConstSharedPtr idle = chooseHost("tcp://10.0.0.1:80");
+  HostConstSharedPtr busy = chooseHost("tcp://10.0.0.2:80");
+
+  // Both hosts were used since the last cleanup, so only their use is reset.
+  EXPECT_CALL(*cleanup_timer_, enableTimer(std::chrono::milliseconds(5000)));
+  cleanup_timer_->callback_();
+
+  EXPECT_EQ(busy, chooseHost("tcp://10.0.0.2:80"));
+  std::vector<HostSharedPtr> hosts_removed;
+  EXPECT_CALL(*this, hostsRemoved(_)).WillOnce(SaveArg<0>(&hosts_removed));
+  EXPECT_CALL(*cleanup_timer_, enableTimer(std::chrono::milliseconds(5000)));
+  cleanup_timer_->callback_();
+  ASSERT_EQ(1U, hosts_removed.size());
+  EXPECT_EQ(idle, hosts_removed[0]);
+
+  // A removed destination gets a new host.
+  HostConstSharedPtr new_host = chooseHost("tcp://10.0.0.1:80");
+  EXPECT_NE(idle, new_host);
+  EXPECT_EQ(busy, chooseHost("tcp://10.0.0.2:80"));
+
+  EXPECT_CALL(*this, hostsRemoved(_)).WillOnce(SaveArg<0>(&hosts_removed));
+  lb_.reset();
+  EXPECT_EQ(2U, hosts_removed.size());
+}
+
+} // Upstream
+} // Envoy
@@ -0,0 +1,108 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/network/utility.h"
+#include "common/upstream/outlier_detection_impl.h"
+#include "common/upstream/upstream_impl.h"
+
+#include "test/mocks/event/mocks.h"
+#include "test/mocks/runtime/mocks.h"
+#include "test/mocks/upstream/mocks.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+using testing::NiceMock;
+
+namespace Upstream {
+namespace Outlier {
+
+/**
+ * This test is for benchmarking only and should not be run as part of unit tests. It measures the
+ * cost of the outlier detection interval sweep and of the success rate statistics for a very large
+ * cluster.
+ */
+class DISABLED_OutlierDetectionBenchmark : public testing::Test {
+public:
+  static const uint32_t NumHosts = 50000;
+  static const uint32_t NumIntervals = 20;
+  static const uint32_t NumReductions = 1000;
+  static const uint32_t RequestsPerInterval = 100;
+
+  DISABLED_OutlierDetectionBenchmark() {
+    for (uint32_t i = 0; i < NumHosts; i++) {
+      cluster_.hosts_.push_back(std::make_shared<HostImpl>(
+          cluster_.info_, "", Network::Utility::resolveUrl(fmt::format(
+                                  "tcp://10.{}.{}.{}:80", i / 65536, (i / 256) % 256, i % 256)),
+          false, 1, ""));
+    }
+  }
+
+  void loadRequests() {
+    for (uint32_t i = 0; i < NumHosts; i++) {
+      DetectorHostSink& sink = cluster_.hosts_[i]->outlierDetector();
+      // Every host sees a few errors and a small fraction of hosts is noticeably worse.
+      const uint32_t errors = (i % 1000 == 0) ? 50 : (i % 5);
+      for (uint32_t j = 0; j < RequestsPerInterval; j++) {
+        sink.putHttpResponseCode(j < errors ? 503 : 200);
+      }
+    }
+  }
+
+  NiceMock<MockCluster> cluster_;
+  NiceMock<Event::MockDispatcher> dispatcher_;
+  NiceMock<Runtime::MockLoader> runtime_;
+  Event::MockTimer* interval_timer_ = new Event::MockTimer(&dispatcher_);
+  NiceMock<MockMonotonicTimeSource> time_source_;
+  Json::ObjectSharedPtr loader_ = Json::Factory::loadFromString("{}");
+};
+
+const uint32_t DISABLED_OutlierDetectionBenchmark::NumHosts;
+
+TEST_F(DISABLED_OutlierDetectionBenchmark, IntervalSweep) {
+  std::shared_ptr<DetectorImpl> detector(
+      DetectorImpl::create(cluster_, *loader_, dispatcher_, runtime_, time_source_, nullptr));
+
+  std::chrono::nanoseconds sweep{};
+  for (uint32_t i = 0; i < NumIntervals; i++) {
+    loadRequests();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    interval_timer_->callback_();
+    sweep += std::chrono::steady_clock::now() - start;
+  }
+
+  std::cout << fmt::format("interval_sweep: hosts={} sweep={}us threshold={}", NumHosts,
+                           std::chrono::duration_cast<std::chrono::microseconds>(sweep).count() /
+                               NumIntervals,
+                           detector->successRateEjectionThreshold())
+            << std::endl;
+}
+
+TEST_F(DISABLED_OutlierDetectionBenchmark, SuccessRateThreshold) {
+  std::vector<double> success_rates;
+  success_rates.reserve(NumHosts);
+  for (uint32_t i = 0; i < NumHosts; i++) {
+    success_rates.push_back((i % 1000 == 0) ? 50.0 : 100.0 - (i % 5));
+  }
+
+  double checksum = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < NumReductions; i++) {
+    checksum += Utility::successRateEjectionThreshold(success_rates, 1.9).ejection_threshold_;
+  }
+  std::chrono::nanoseconds reduction = std::chrono::steady_clock::now() - start;
+
+  std::cout << fmt::format("success_rate_threshold: hosts={} reduction={}ns checksum={}", NumHosts,
+                           reduction.count() / NumReductions, checksum)
+            << std::endl;
+}
+
+} // Outlier
+} // Upstream
+} // Envoy
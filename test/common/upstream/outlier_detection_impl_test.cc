@@ -2,6 +2,7 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "envoy/common/optional.h"
@@ -100,7 +101,11 @@ TEST_F(OutlierDetectorImplTest, DetectorStaticConfig) {
     "enforcing_success_rate": 20,
     "success_rate_minimum_hosts": 50,
     "success_rate_request_volume": 200,
-    "success_rate_stdev_factor": 3000
+    "success_rate_stdev_factor": 3000,
+    "enforcing_latency": 30,
+    "latency_minimum_hosts": 10,
+    "latency_request_volume": 300,
+    "latency_stdev_factor": 2500
   }
   )EOF";
 
@@ -118,6 +123,10 @@ TEST_F(OutlierDetectorImplTest, DetectorStaticConfig) {
   EXPECT_EQ(50UL, detector->config().successRateMinimumHosts());
   EXPECT_EQ(200UL, detector->config().successRateRequestVolume());
   EXPECT_EQ(3000UL, detector->config().successRateStdevFactor());
+  EXPECT_EQ(30UL, detector->config().enforcingLatency());
+  EXPECT_EQ(10UL, detector->config().latencyMinimumHosts());
+  EXPECT_EQ(300UL, detector->config().latencyRequestVolume());
+  EXPECT_EQ(2500UL, detector->config().latencyStdevFactor());
 }
 
 TEST_F(OutlierDetectorImplTest, DestroyWithActive) {
@@ -313,6 +322,60 @@ TEST_F(OutlierDetectorImplTest, BasicFlowSuccessRate) {
   EXPECT_EQ(-1, detector->successRateEjectionThreshold());
 }
 
+TEST_F(OutlierDetectorImplTest, BasicFlowLatency) {
+  EXPECT_CALL(cluster_, addMemberUpdateCb(_));
+  cluster_.hosts_ = {
+      HostSharedPtr{new HostImpl(cluster_.info_, "",
+                                 Network::Utility::resolveUrl("tcp://127.0.0.1:80"), false, 1, "")},
+      HostSharedPtr{new HostImpl(cluster_.info_, "",
+                                 Network::Utility::resolveUrl("tcp://127.0.0.1:81"), false, 1, "")},
+      HostSharedPtr{new HostImpl(cluster_.info_, "",
+                                 Network::Utility::resolveUrl("tcp://127.0.0.1:82"), false, 1, "")},
+      HostSharedPtr{new HostImpl(cluster_.info_, "",
+                                 Network::Utility::resolveUrl("tcp://127.0.0.1:83"), false, 1, "")},
+      HostSharedPtr{new HostImpl(
+          cluster_.info_, "", Network::Utility::resolveUrl("tcp://127.0.0.1:84"), false, 1, "")}};
+  EXPECT_CALL(*interval_timer_, enableTimer(std::chrono::milliseconds(10000)));
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString("{\"enforcing_latency\": 100}");
+  std::shared_ptr<DetectorImpl> detector(
+      DetectorImpl::create(cluster_, *config, dispatcher_, runtime_, time_source_, event_logger_));
+  detector->addChangedStateCb([&](HostSharedPtr host) -> void { checker_.check(host); });
+  ON_CALL(runtime_.snapshot_, featureEnabled("outlier_detection.enforcing_latency", 100))
+      .WillByDefault(Return(true));
+
+  // Four hosts respond in 5ms, the fifth is two orders of magnitude slower.
+  for (uint64_t i = 0; i < cluster_.hosts_.size(); i++) {
+    for (int j = 0; j < 200; j++) {
+      cluster_.hosts_[i]->outlierDetector().putResponseTime(
+          std::chrono::milliseconds(i < 4 ? 5 : 500));
+    }
+  }
+
+  EXPECT_CALL(time_source_, currentTime())
+      .Times(2)
+      .WillRepeatedly(Return(MonotonicTime(std::chrono::milliseconds(10000))));
+  EXPECT_CALL(checker_, check(cluster_.hosts_[4]));
+  EXPECT_CALL(*event_logger_,
+              logEject(std::static_pointer_cast<const HostDescription>(cluster_.hosts_[4]), _,
+                       EjectionType::Latency, true));
+  EXPECT_CALL(*interval_timer_, enableTimer(std::chrono::milliseconds(10000)));
+  interval_timer_->callback_();
+  EXPECT_EQ(5, cluster_.hosts_[0]->outlierDetector().responseTimeP99());
+  EXPECT_EQ(500, cluster_.hosts_[4]->outlierDetector().responseTimeP99());
+  EXPECT_NEAR(480.2, detector->latencyEjectionThreshold(), 0.001);
+  EXPECT_TRUE(cluster_.hosts_[4]->healthFlagGet(Host::HealthFlag::FAILED_OUTLIER_CHECK));
+  EXPECT_EQ(1UL,
+            cluster_.info_->stats_store_.counter("outlier_detection.ejections_latency").value());
+
+  // Without new response times there is no data for the next interval.
+  EXPECT_CALL(time_source_, currentTime())
+      .WillOnce(Return(MonotonicTime(std::chrono::milliseconds(20000))));
+  EXPECT_CALL(*interval_timer_, enableTimer(std::chrono::milliseconds(10000)));
+  interval_timer_->callback_();
+  EXPECT_EQ(-1, cluster_.hosts_[0]->outlierDetector().responseTimeP99());
+  EXPECT_EQ(-1, detector->latencyEjectionThreshold());
+}
+
 TEST_F(OutlierDetectorImplTest, RemoveWhileEjected) {
   EXPECT_CALL(cluster_, addMemberUpdateCb(_));
   cluster_.hosts_ = {HostSharedPtr{new HostImpl(
@@ -514,6 +577,86 @@ TEST(DetectorHostSinkNullImplTest, All) {
   EXPECT_EQ(0UL, null_sink.numEjections());
   EXPECT_FALSE(null_sink.lastEjectionTime().valid());
   EXPECT_FALSE(null_sink.lastUnejectionTime().valid());
+  EXPECT_EQ(0, null_sink.responseTimeEwma());
+}
+
+TEST(DetectorHostSinkImplTest, ResponseTimeEwma) {
+  DetectorHostSinkImpl sink(nullptr, nullptr);
+  EXPECT_EQ(0, sink.responseTimeEwma());
+
+  // Increases take effect immediately.
+  sink.putResponseTime(std::chrono::milliseconds(10));
+  EXPECT_DOUBLE_EQ(10, sink.responseTimeEwma());
+  sink.putResponseTime(std::chrono::milliseconds(20));
+  EXPECT_DOUBLE_EQ(20, sink.responseTimeEwma());
+
+  // Decreases decay in.
+  sink.putResponseTime(std::chrono::milliseconds(10));
+  EXPECT_DOUBLE_EQ(19, sink.responseTimeEwma());
+  sink.putResponseTime(std::chrono::milliseconds(0));
+  EXPECT_DOUBLE_EQ(17.1, sink.responseTimeEwma());
+}
+
+TEST(RequestAccumulatorTest, SuccessRate) {
+  RequestAccumulator accumulator(false);
+  accumulator.updateInterval();
+  EXPECT_FALSE(accumulator.getSuccessRate(1).valid());
+
+  // Results recorded from several threads are merged at the interval.
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 10; i++) {
+    threads.emplace_back([&accumulator, i]() -> void {
+      for (int j = 0; j < 100; j++) {
+        accumulator.putResult(i != 0);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_FALSE(accumulator.getSuccessRate(1).valid());
+  accumulator.updateInterval();
+  EXPECT_FALSE(accumulator.getSuccessRate(1001).valid());
+  EXPECT_EQ(90, accumulator.getSuccessRate(1000).value());
+
+  // The next interval only contains the results recorded since.
+  accumulator.putResult(true);
+  accumulator.updateInterval();
+  EXPECT_EQ(100, accumulator.getSuccessRate(1).value());
+}
+
+TEST(RequestAccumulatorTest, ResponseTimeP99) {
+  EXPECT_EQ(0U, RequestAccumulator::responseTimeBucket(std::chrono::milliseconds(0)));
+  EXPECT_EQ(0U, RequestAccumulator::responseTimeBucket(std::chrono::milliseconds(1)));
+  EXPECT_EQ(1U, RequestAccumulator::responseTimeBucket(std::chrono::milliseconds(2)));
+  EXPECT_EQ(5U, RequestAccumulator::responseTimeBucket(std::chrono::milliseconds(6)));
+  EXPECT_EQ(RequestAccumulator::NUM_RESPONSE_TIME_BUCKETS - 1,
+            RequestAccumulator::responseTimeBucket(std::chrono::milliseconds(30001)));
+
+  // Not tracked.
+  RequestAccumulator untracked(false);
+  untracked.putResponseTime(std::chrono::milliseconds(10));
+  untracked.updateInterval();
+  EXPECT_FALSE(untracked.getResponseTimeP99(0).valid());
+
+  RequestAccumulator accumulator(true);
+  for (int i = 0; i < 99; i++) {
+    accumulator.putResponseTime(std::chrono::milliseconds(10));
+  }
+  accumulator.putResponseTime(std::chrono::milliseconds(900));
+  accumulator.updateInterval();
+  EXPECT_FALSE(accumulator.getResponseTimeP99(101).valid());
+  EXPECT_EQ(10, accumulator.getResponseTimeP99(100).value());
+
+  accumulator.putResponseTime(std::chrono::milliseconds(10));
+  accumulator.putResponseTime(std::chrono::milliseconds(900));
+  accumulator.updateInterval();
+  EXPECT_EQ(1000, accumulator.getResponseTimeP99(1).value());
+
+  accumulator.putResponseTime(std::chrono::milliseconds(60000));
+  accumulator.updateInterval();
+  EXPECT_EQ(60000, accumulator.getResponseTimeP99(1).value());
 }
 
 TEST(OutlierDetectionEventLoggerImplTest, All) {
@@ -578,21 +721,38 @@ TEST(OutlierDetectionEventLoggerImplTest, All) {
                            "\"num_ejections\": 0}\n")).WillOnce(SaveArg<0>(&log4));
   event_logger.logUneject(host);
   Json::Factory::loadFromString(log4);
+
+  std::string log5;
+  EXPECT_CALL(host->outlier_detector_, lastUnejectionTime()).WillOnce(ReturnRef(monotonic_time));
+  EXPECT_CALL(host->outlier_detector_, responseTimeP99()).WillOnce(Return(500));
+  EXPECT_CALL(detector, latencyEjectionThreshold()).WillOnce(Return(480.5));
+  EXPECT_CALL(*file, write("{\"time\": \"1970-01-01T00:00:00.000Z\", \"secs_since_last_action\": "
+                           "\"30\", \"cluster\": "
+                           "\"fake_cluster\", \"upstream_url\": \"10.0.0.1:443\", \"action\": "
+                           "\"eject\", \"type\": \"Latency\", \"num_ejections\": \"0\", "
+                           "\"enforced\": \"true\", \"host_p99_response_time_ms\": \"500\", "
+                           "\"cluster_latency_ejection_threshold_ms\": \"480.5\""
+                           "}\n")).WillOnce(SaveArg<0>(&log5));
+  event_logger.logEject(host, detector, EjectionType::Latency, true);
+  Json::Factory::loadFromString(log5);
 }
 
 TEST(OutlierUtility, SRThreshold) {
-  std::vector<HostSuccessRatePair> data = {
-      HostSuccessRatePair(nullptr, 50),  HostSuccessRatePair(nullptr, 100),
-      HostSuccessRatePair(nullptr, 100), HostSuccessRatePair(nullptr, 100),
-      HostSuccessRatePair(nullptr, 100),
-  };
-  double sum = 450;
-
-  Utility::EjectionPair ejection_pair = Utility::successRateEjectionThreshold(sum, data, 1.9);
+  std::vector<double> data = {50, 100, 100, 100, 100};
+
+  Utility::EjectionPair ejection_pair = Utility::successRateEjectionThreshold(data, 1.9);
   EXPECT_EQ(52.0, ejection_pair.ejection_threshold_);
   EXPECT_EQ(90.0, ejection_pair.success_rate_average_);
 }
 
+TEST(OutlierUtility, LatencyThreshold) {
+  std::vector<double> data = {10, 30, 10, 30, 10, 30, 10, 30};
+
+  Utility::LatencyEjectionPair ejection_pair = Utility::latencyEjectionThreshold(data, 2);
+  EXPECT_EQ(40.0, ejection_pair.ejection_threshold_);
+  EXPECT_EQ(20.0, ejection_pair.latency_average_);
+}
+
 } // Outlier
 } // Upstream
 } // Envoy
@@ -1,6 +1,7 @@
 #include "common/upstream/resource_manager_impl.h"
 
 #include "test/mocks/runtime/mocks.h"
+#include "test/mocks/stats/mocks.h"
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -47,5 +48,52 @@ TEST(ResourceManagerImplTest, RuntimeResourceManager) {
   EXPECT_FALSE(resource_manager.retries().canCreate());
 }
 
+TEST(ResourceManagerImplTest, RetryBudget) {
+  NiceMock<Runtime::MockLoader> runtime;
+  NiceMock<Stats::MockCounter> overflow;
+  RetryBudget budget;
+  budget.budget_percent_ = 25.0;
+  budget.min_retry_concurrency_ = 1;
+  budget.overflow_ = &overflow;
+  ResourceManagerImpl resource_manager(runtime, "circuit_breakers.budget.default.", 100, 100, 100,
+                                       100, budget);
+
+  // With no active requests only the minimum concurrency is allowed.
+  EXPECT_EQ(1U, resource_manager.retries().max());
+  EXPECT_TRUE(resource_manager.retries().canCreate());
+  resource_manager.retries().inc();
+  EXPECT_CALL(overflow, inc());
+  EXPECT_FALSE(resource_manager.retries().canCreate());
+
+  // The budget grows with active and pending requests.
+  for (uint64_t i = 0; i < 6; i++) {
+    resource_manager.requests().inc();
+  }
+  for (uint64_t i = 0; i < 2; i++) {
+    resource_manager.pendingRequests().inc();
+  }
+  EXPECT_EQ(2U, resource_manager.retries().max());
+  EXPECT_TRUE(resource_manager.retries().canCreate());
+
+  EXPECT_CALL(runtime.snapshot_,
+              getInteger("circuit_breakers.budget.default.retry_budget.min_retry_concurrency", 1U))
+      .WillOnce(Return(4U))
+      .RetiresOnSaturation();
+  EXPECT_EQ(4U, resource_manager.retries().max());
+
+  // The fixed maximum no longer applies once a budget is configured.
+  EXPECT_CALL(runtime.snapshot_, getInteger("circuit_breakers.budget.default.max_retries", 100U))
+      .Times(0);
+  EXPECT_EQ(2U, resource_manager.retries().max());
+
+  resource_manager.retries().dec();
+  for (uint64_t i = 0; i < 6; i++) {
+    resource_manager.requests().dec();
+  }
+  for (uint64_t i = 0; i < 2; i++) {
+    resource_manager.pendingRequests().dec();
+  }
+}
+
 } // Upstream
 } // Envoy
@@ -13,6 +13,7 @@
 
 namespace Envoy {
 using testing::_;
+using testing::AnyNumber;
 using testing::NiceMock;
 using testing::Return;
 
@@ -29,6 +30,9 @@ public:
 
   // Upstream::LoadBalancerContext
   const Optional<uint64_t>& hashKey() const override { return hash_key_; }
+  const HostMetadata* metadataMatchCriteria() const override { return nullptr; }
+  const Network::Connection* downstreamConnection() const override { return nullptr; }
+  const Http::HeaderMap* downstreamHeaders() const override { return nullptr; }
 
   Optional<uint64_t> hash_key_;
 };
@@ -42,7 +46,7 @@ public:
   ClusterStats stats_;
   NiceMock<Runtime::MockLoader> runtime_;
   NiceMock<Runtime::MockRandomGenerator> random_;
-  RingHashLoadBalancer lb_{cluster_, stats_, runtime_, random_};
+  RingHashLoadBalancer lb_{cluster_, stats_, runtime_, random_, RingHashFunction::StdHash};
 };
 
 TEST_F(RingHashLoadBalancerTest, NoHost) { EXPECT_EQ(nullptr, lb_.chooseHost(nullptr)); };
@@ -104,6 +108,53 @@ TEST_F(RingHashLoadBalancerTest, Basic) {
   }
 }
 
+TEST_F(RingHashLoadBalancerTest, XxHash64) {
+  cluster_.hosts_ = {newTestHost(cluster_.info_, "tcp://127.0.0.1:80"),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:81"),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:82"),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:83"),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:84"),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:85")};
+  cluster_.healthy_hosts_ = cluster_.hosts_;
+  ON_CALL(runtime_.snapshot_, getInteger("upstream.ring_hash.min_ring_size", _))
+      .WillByDefault(Return(12));
+  RingHashLoadBalancer lb{cluster_, stats_, runtime_, random_, RingHashFunction::XxHash64};
+
+  // Unlike std::hash, xxHash64 builds the same ring on every platform.
+  // ring hash: host=127.0.0.1:83 hash=842294666033307227
+  // ring hash: host=127.0.0.1:84 hash=2231552554775993225
+  // ring hash: host=127.0.0.1:85 hash=3617836676629228985
+  // ring hash: host=127.0.0.1:80 hash=5454692015285649509
+  // ring hash: host=127.0.0.1:81 hash=7859399908942313493
+  // ring hash: host=127.0.0.1:82 hash=8241336090459785962
+  // ring hash: host=127.0.0.1:84 hash=12589998527382061165
+  // ring hash: host=127.0.0.1:82 hash=12882406409176325258
+  // ring hash: host=127.0.0.1:80 hash=13838424394637650569
+  // ring hash: host=127.0.0.1:85 hash=14454039294846722197
+  // ring hash: host=127.0.0.1:81 hash=16064866803292627174
+  // ring hash: host=127.0.0.1:83 hash=17869494589454488074
+  {
+    TestLoadBalancerContext context(0);
+    EXPECT_EQ(cluster_.hosts_[3], lb.chooseHost(&context));
+  }
+  {
+    TestLoadBalancerContext context(std::numeric_limits<uint64_t>::max());
+    EXPECT_EQ(cluster_.hosts_[3], lb.chooseHost(&context));
+  }
+  {
+    TestLoadBalancerContext context(5454692015285649509);
+    EXPECT_EQ(cluster_.hosts_[0], lb.chooseHost(&context));
+  }
+  {
+    TestLoadBalancerContext context(5454692015285649510);
+    EXPECT_EQ(cluster_.hosts_[1], lb.chooseHost(&context));
+  }
+  {
+    TestLoadBalancerContext context(17869494589454488073UL);
+    EXPECT_EQ(cluster_.hosts_[3], lb.chooseHost(&context));
+  }
+}
+
 TEST_F(RingHashLoadBalancerTest, UnevenHosts) {
   cluster_.hosts_ = {newTestHost(cluster_.info_, "tcp://127.0.0.1:80"),
                      newTestHost(cluster_.info_, "tcp://127.0.0.1:81")};
@@ -140,5 +191,110 @@ TEST_F(RingHashLoadBalancerTest, UnevenHosts) {
   }
 }
 
+TEST_F(RingHashLoadBalancerTest, BoundedLoad) {
+  cluster_.hosts_ = {newTestHost(cluster_.info_, "tcp://127.0.0.1:80"),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:81")};
+  cluster_.healthy_hosts_ = cluster_.hosts_;
+  ON_CALL(runtime_.snapshot_, getInteger("upstream.ring_hash.min_ring_size", _))
+      .WillByDefault(Return(3));
+  cluster_.runCallbacks({}, {});
+
+  // ring hash: host=127.0.0.1:81 hash=7701421856454313576
+  // ring hash: host=127.0.0.1:81 hash=9887544217113020895
+  // ring hash: host=127.0.0.1:80 hash=15427156902705414897
+  // ring hash: host=127.0.0.1:80 hash=17613279263364193813
+  TestLoadBalancerContext context(0);
+  cluster_.hosts_[1]->incActiveRequests();
+  stats_.upstream_rq_active_.set(1);
+
+  // Without a bound the key always maps to its host.
+  EXPECT_CALL(runtime_.snapshot_, getInteger(_, _)).Times(AnyNumber());
+  EXPECT_EQ(cluster_.hosts_[1], lb_.chooseHost(&context));
+
+  // With the new request the average load is 1 per host, and :81 is already at the bound, so the
+  // pick walks past both of its entries to :80. A bound below the average is raised to it.
+  for (uint64_t percent : {100, 50}) {
+    EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.ring_hash.bounded_load_percent", 0))
+        .WillOnce(Return(percent));
+    EXPECT_EQ(cluster_.hosts_[0], lb_.chooseHost(&context));
+  }
+
+  // A larger bound leaves room on :81.
+  EXPECT_CALL(runtime_.snapshot_, getInteger("upstream.ring_hash.bounded_load_percent", 0))
+      .WillOnce(Return(200));
+  EXPECT_EQ(cluster_.hosts_[1], lb_.chooseHost(&context));
+
+  cluster_.hosts_[1]->decActiveRequests();
+}
+
+TEST_F(RingHashLoadBalancerTest, IncrementalUpdate) {
+  for (uint32_t port = 80; port < 86; port++) {
+    cluster_.hosts_.push_back(
+        newTestHost(cluster_.info_, "tcp://127.0.0.1:" + std::to_string(port)));
+  }
+  cluster_.healthy_hosts_ = cluster_.hosts_;
+  ON_CALL(runtime_.snapshot_, getInteger("upstream.ring_hash.min_ring_size", _))
+      .WillByDefault(Return(3));
+  cluster_.runCallbacks({}, {});
+
+  // Remove one host and add another. The replication factor does not change so the ring is
+  // updated in place, and must match a ring built from scratch.
+  HostSharedPtr removed = cluster_.hosts_[1];
+  HostSharedPtr added = newTestHost(cluster_.info_, "tcp://127.0.0.1:86");
+  cluster_.hosts_.erase(cluster_.hosts_.begin() + 1);
+  cluster_.hosts_.push_back(added);
+  cluster_.healthy_hosts_ = cluster_.hosts_;
+  cluster_.runCallbacks({added}, {removed});
+
+  NiceMock<MockCluster> fresh_cluster;
+  fresh_cluster.hosts_ = cluster_.hosts_;
+  fresh_cluster.healthy_hosts_ = cluster_.hosts_;
+  RingHashLoadBalancer fresh_lb{fresh_cluster, stats_, runtime_, random_,
+                                RingHashFunction::StdHash};
+
+  bool added_chosen = false;
+  for (uint64_t i = 0; i < 1000; i++) {
+    TestLoadBalancerContext context(i * (std::numeric_limits<uint64_t>::max() / 1000));
+    HostConstSharedPtr host = lb_.chooseHost(&context);
+    EXPECT_EQ(fresh_lb.chooseHost(&context), host);
+    EXPECT_NE(removed, host);
+    added_chosen |= host == added;
+  }
+  EXPECT_TRUE(added_chosen);
+}
+
+TEST_F(RingHashLoadBalancerTest, SharedRings) {
+  LoadBalancerTableConstSharedPtr table;
+  RingHashLoadBalancer worker_lb1{cluster_, stats_, runtime_, random_, table};
+  RingHashLoadBalancer worker_lb2{cluster_, stats_, runtime_, random_, table};
+  EXPECT_EQ(nullptr, worker_lb1.chooseHost(nullptr));
+
+  for (uint32_t port = 80; port < 86; port++) {
+    cluster_.hosts_.push_back(
+        newTestHost(cluster_.info_, "tcp://127.0.0.1:" + std::to_string(port)));
+  }
+  cluster_.healthy_hosts_ = cluster_.hosts_;
+  ON_CALL(runtime_.snapshot_, getInteger("upstream.ring_hash.min_ring_size", _))
+      .WillByDefault(Return(12));
+
+  // The rings are built once and every load balancer that shares them picks the same hosts as a
+  // load balancer that builds its own, also after an incremental update of the shared rings.
+  RingHashLoadBalancer::TableBuilder builder(runtime_, RingHashFunction::StdHash);
+  table = builder.build(cluster_);
+  cluster_.runCallbacks({}, {});
+  for (uint32_t update = 0; update < 2; update++) {
+    for (uint64_t i = 0; i < 1000; i++) {
+      TestLoadBalancerContext context(i * (std::numeric_limits<uint64_t>::max() / 1000));
+      HostConstSharedPtr host = lb_.chooseHost(&context);
+      EXPECT_EQ(host, worker_lb1.chooseHost(&context));
+      EXPECT_EQ(host, worker_lb2.chooseHost(&context));
+    }
+
+    cluster_.healthy_hosts_.erase(cluster_.healthy_hosts_.begin());
+    table = builder.build(cluster_);
+    cluster_.runCallbacks({}, {});
+  }
+}
+
 } // Upstream
 } // Envoy
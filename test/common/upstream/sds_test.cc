@@ -34,7 +34,8 @@ namespace Upstream {
 
 class SdsTest : public testing::Test {
 protected:
-  SdsTest() : sds_config_{"sds", std::chrono::milliseconds(30000)}, request_(&cm_.async_client_) {
+  SdsTest()
+      : sds_config_{"sds", std::chrono::milliseconds(30000), false}, request_(&cm_.async_client_) {
     std::string raw_config = R"EOF(
     {
       "name": "name",
@@ -154,6 +155,8 @@ TEST_F(SdsTest, NoHealthChecker) {
   EXPECT_TRUE(canary_host->canary());
   EXPECT_EQ("us-east-1d", canary_host->zone());
   EXPECT_EQ(40U, canary_host->weight());
+  EXPECT_EQ(1U, canary_host->priority());
+  EXPECT_EQ(0U, findHost("10.0.14.27")->priority());
   EXPECT_EQ(90UL, cluster_->info()->stats().max_host_weight_.value());
 
   // Test response with weight change. We should still have the same host.
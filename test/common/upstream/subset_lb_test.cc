@@ -0,0 +1,169 @@
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "common/network/utility.h"
+#include "common/upstream/load_balancer_impl.h"
+#include "common/upstream/subset_lb.h"
+#include "common/upstream/upstream_impl.h"
+
+#include "test/mocks/runtime/mocks.h"
+#include "test/mocks/upstream/mocks.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace Envoy {
+using testing::NiceMock;
+
+namespace Upstream {
+
+static HostSharedPtr newTestHost(Upstream::ClusterInfoConstSharedPtr cluster,
+                                 const std::string& url, const HostMetadata& metadata) {
+  return std::make_shared<HostImpl>(cluster, "", Network::Utility::resolveUrl(url), false, 1, "",
+                                    metadata);
+}
+
+class TestLoadBalancerContext : public LoadBalancerContext {
+public:
+  TestLoadBalancerContext(const HostMetadata& metadata_match) : metadata_match_(metadata_match) {}
+
+  // Upstream::LoadBalancerContext
+  const Optional<uint64_t>& hashKey() const override { return hash_key_; }
+  const HostMetadata* metadataMatchCriteria() const override { return &metadata_match_; }
+  const Network::Connection* downstreamConnection() const override { return nullptr; }
+  const Http::HeaderMap* downstreamHeaders() const override { return nullptr; }
+
+  Optional<uint64_t> hash_key_;
+  HostMetadata metadata_match_;
+};
+
+class SubsetLoadBalancerTest : public testing::Test {
+public:
+  SubsetLoadBalancerTest() : stats_(ClusterInfoImpl::generateStats(stats_store_)) {
+    subset_info_.enabled_ = true;
+    subset_info_.subset_keys_ = {{"version"}, {"version", "stage"}};
+  }
+
+  void init() {
+    lb_.reset(new SubsetLoadBalancer(
+        cluster_, subset_info_, stats_, [this](HostSet& host_set) -> LoadBalancerPtr {
+          return LoadBalancerPtr{
+              new RoundRobinLoadBalancer(host_set, nullptr, stats_, runtime_, random_)};
+        }));
+  }
+
+  HostConstSharedPtr chooseHost(const HostMetadata& metadata_match) {
+    TestLoadBalancerContext context(metadata_match);
+    return lb_->chooseHost(&context);
+  }
+
+  NiceMock<MockCluster> cluster_;
+  NiceMock<MockLbSubsetInfo> subset_info_;
+  Stats::IsolatedStoreImpl stats_store_;
+  ClusterStats stats_;
+  NiceMock<Runtime::MockLoader> runtime_;
+  NiceMock<Runtime::MockRandomGenerator> random_;
+  std::unique_ptr<SubsetLoadBalancer> lb_;
+};
+
+TEST_F(SubsetLoadBalancerTest, NoHosts) {
+  init();
+  EXPECT_EQ(nullptr, lb_->chooseHost(nullptr));
+  EXPECT_EQ(nullptr, chooseHost({{"version", "v1"}}));
+  EXPECT_EQ(0U, stats_.lb_subsets_active_.value());
+}
+
+TEST_F(SubsetLoadBalancerTest, SelectSubset) {
+  cluster_.hosts_ = {newTestHost(cluster_.info_, "tcp://127.0.0.1:80", {{"version", "v1"}}),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:81",
+                                 {{"version", "v1"}, {"stage", "canary"}}),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:82", {{"version", "v2"}}),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:83", {})};
+  cluster_.healthy_hosts_ = cluster_.hosts_;
+  init();
+
+  // {version=v1}, {version=v1, stage=canary} and {version=v2}.
+  EXPECT_EQ(3U, stats_.lb_subsets_created_.value());
+  EXPECT_EQ(3U, stats_.lb_subsets_active_.value());
+
+  EXPECT_EQ(cluster_.hosts_[2], chooseHost({{"version", "v2"}}));
+  EXPECT_EQ(cluster_.hosts_[2], chooseHost({{"version", "v2"}}));
+  EXPECT_EQ(cluster_.hosts_[1], chooseHost({{"version", "v1"}, {"stage", "canary"}}));
+
+  // The v1 subset round robins over its own hosts only.
+  std::set<HostConstSharedPtr> v1_hosts;
+  for (uint32_t i = 0; i < 4; i++) {
+    v1_hosts.insert(chooseHost({{"version", "v1"}}));
+  }
+  EXPECT_EQ((std::set<HostConstSharedPtr>{cluster_.hosts_[0], cluster_.hosts_[1]}), v1_hosts);
+  EXPECT_EQ(7U, stats_.lb_subsets_selected_.value());
+  EXPECT_EQ(0U, stats_.lb_subsets_fallback_.value());
+
+  // Criteria that match no subset, and requests without criteria, use any host.
+  EXPECT_NE(nullptr, chooseHost({{"version", "v3"}}));
+  EXPECT_NE(nullptr, chooseHost({{"stage", "canary"}}));
+  EXPECT_NE(nullptr, lb_->chooseHost(nullptr));
+  EXPECT_EQ(3U, stats_.lb_subsets_fallback_.value());
+}
+
+TEST_F(SubsetLoadBalancerTest, NoFallback) {
+  subset_info_.fallback_policy_ = LbSubsetInfo::FallbackPolicy::NoFallback;
+  cluster_.hosts_ = {newTestHost(cluster_.info_, "tcp://127.0.0.1:80", {{"version", "v1"}})};
+  cluster_.healthy_hosts_ = cluster_.hosts_;
+  init();
+
+  EXPECT_EQ(cluster_.hosts_[0], chooseHost({{"version", "v1"}}));
+  EXPECT_EQ(nullptr, chooseHost({{"version", "v2"}}));
+  EXPECT_EQ(nullptr, lb_->chooseHost(nullptr));
+  EXPECT_EQ(0U, stats_.lb_subsets_fallback_.value());
+}
+
+TEST_F(SubsetLoadBalancerTest, MembershipUpdates) {
+  cluster_.hosts_ = {newTestHost(cluster_.info_, "tcp://127.0.0.1:80", {{"version", "v1"}})};
+  cluster_.healthy_hosts_ = cluster_.hosts_;
+  init();
+  EXPECT_EQ(1U, stats_.lb_subsets_active_.value());
+
+  // Adding a host with a new value creates its subset.
+  HostSharedPtr v2_host = newTestHost(cluster_.info_, "tcp://127.0.0.1:81", {{"version", "v2"}});
+  cluster_.hosts_.push_back(v2_host);
+  cluster_.healthy_hosts_ = cluster_.hosts_;
+  cluster_.runCallbacks({v2_host}, {});
+  EXPECT_EQ(2U, stats_.lb_subsets_created_.value());
+  EXPECT_EQ(2U, stats_.lb_subsets_active_.value());
+  EXPECT_EQ(v2_host, chooseHost({{"version", "v2"}}));
+
+  // Removing the last host of a subset removes the subset.
+  HostSharedPtr v1_host = cluster_.hosts_[0];
+  cluster_.hosts_ = {v2_host};
+  cluster_.healthy_hosts_ = cluster_.hosts_;
+  cluster_.runCallbacks({}, {v1_host});
+  EXPECT_EQ(1U, stats_.lb_subsets_removed_.value());
+  EXPECT_EQ(1U, stats_.lb_subsets_active_.value());
+  EXPECT_EQ(v2_host, chooseHost({{"version", "v1"}}));
+  EXPECT_EQ(1U, stats_.lb_subsets_fallback_.value());
+
+  lb_.reset();
+  EXPECT_EQ(0U, stats_.lb_subsets_active_.value());
+}
+
+TEST_F(SubsetLoadBalancerTest, HealthUpdates) {
+  cluster_.hosts_ = {newTestHost(cluster_.info_, "tcp://127.0.0.1:80", {{"version", "v1"}}),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:81", {{"version", "v1"}}),
+                     newTestHost(cluster_.info_, "tcp://127.0.0.1:82", {{"version", "v2"}})};
+  cluster_.healthy_hosts_ = cluster_.hosts_;
+  init();
+
+  // A health change without membership changes still reaches the subset load balancers.
+  cluster_.healthy_hosts_ = {cluster_.hosts_[1], cluster_.hosts_[2]};
+  cluster_.runCallbacks({}, {});
+  for (uint32_t i = 0; i < 4; i++) {
+    EXPECT_EQ(cluster_.hosts_[1], chooseHost({{"version", "v1"}}));
+  }
+}
+
+} // Upstream
+} // Envoy
@@ -1,8 +1,11 @@
 #include <chrono>
 #include <cstdint>
 #include <list>
+#include <map>
+#include <set>
 #include <string>
 #include <tuple>
+#include <unordered_map>
 #include <vector>
 
 #include "envoy/api/api.h"
@@ -30,6 +33,7 @@ using testing::_;
 using testing::ContainerEq;
 using testing::Invoke;
 using testing::NiceMock;
+using testing::Return;
 
 namespace Upstream {
 
@@ -162,7 +166,8 @@ TEST(StrictDnsClusterImplTest, Basic) {
         "max_connections": 1,
         "max_pending_requests": 2,
         "max_requests": 3,
-        "max_retries": 4
+        "max_retries": 4,
+        "retry_budget": {"budget_percent": 50.0, "min_retry_concurrency": 5}
       }
     },
     "max_requests_per_connection": 3,
@@ -183,7 +188,7 @@ TEST(StrictDnsClusterImplTest, Basic) {
   EXPECT_EQ(1U, cluster.info()->resourceManager(ResourcePriority::High).connections().max());
   EXPECT_EQ(2U, cluster.info()->resourceManager(ResourcePriority::High).pendingRequests().max());
   EXPECT_EQ(3U, cluster.info()->resourceManager(ResourcePriority::High).requests().max());
-  EXPECT_EQ(4U, cluster.info()->resourceManager(ResourcePriority::High).retries().max());
+  EXPECT_EQ(5U, cluster.info()->resourceManager(ResourcePriority::High).retries().max());
   EXPECT_EQ(3U, cluster.info()->maxRequestsPerConnection());
   EXPECT_EQ(0U, cluster.info()->http2Settings().hpack_table_size_);
 
@@ -291,6 +296,53 @@ TEST(HostImplTest, Weight) {
   }
 }
 
+TEST(HostImplTest, ActiveRequests) {
+  MockCluster cluster;
+  HostImpl host(cluster.info_, "", Network::Utility::resolveUrl("tcp://10.0.0.1:1234"), false, 1,
+                "");
+  EXPECT_EQ(0U, host.activeRequests());
+  host.incActiveRequests();
+  host.incActiveRequests();
+  EXPECT_EQ(2U, host.activeRequests());
+  host.decActiveRequests();
+  EXPECT_EQ(1U, host.activeRequests());
+
+  // The rq_active gauge is maintained separately by the connection pools.
+  EXPECT_EQ(0U, host.stats().rq_active_.value());
+}
+
+TEST(HostImplTest, Stats) {
+  MockCluster cluster;
+  HostSharedPtr host{new HostImpl(cluster.info_, "",
+                                  Network::Utility::resolveUrl("tcp://10.0.0.1:1234"), false, 1,
+                                  "")};
+  host->stats().cx_total_.inc();
+  host->stats().rq_total_.add(2);
+  host->stats().rq_active_.inc();
+
+  std::map<std::string, uint64_t> counters;
+  for (const Stats::CounterSharedPtr& counter : host->counters()) {
+    counters[counter->name()] = counter->value();
+  }
+  EXPECT_EQ((std::map<std::string, uint64_t>{{"cx_connect_fail", 0},
+                                             {"cx_total", 1},
+                                             {"rq_timeout", 0},
+                                             {"rq_total", 2}}),
+            counters);
+
+  std::map<std::string, uint64_t> gauges;
+  for (const Stats::GaugeSharedPtr& gauge : host->gauges()) {
+    gauges[gauge->name()] = gauge->value();
+  }
+  EXPECT_EQ((std::map<std::string, uint64_t>{{"cx_active", 0}, {"rq_active", 1}}), gauges);
+
+  // The stats keep the host alive.
+  Stats::CounterSharedPtr cx_total = host->counters().front();
+  host.reset();
+  EXPECT_EQ("cx_total", cx_total->name());
+  EXPECT_EQ(1U, cx_total->value());
+}
+
 TEST(HostImplTest, HostameCanaryAndZone) {
   MockCluster cluster;
   HostImpl host(cluster.info_, "lyft.com", Network::Utility::resolveUrl("tcp://10.0.0.1:1234"),
@@ -341,6 +393,26 @@ TEST(StaticClusterImplTest, RingHash) {
   EXPECT_EQ(LoadBalancerType::RingHash, cluster.info()->lbType());
 }
 
+TEST(StaticClusterImplTest, Maglev) {
+  Stats::IsolatedStoreImpl stats;
+  Ssl::MockContextManager ssl_context_manager;
+  NiceMock<Runtime::MockLoader> runtime;
+  std::string json = R"EOF(
+  {
+    "name": "staticcluster",
+    "connect_timeout_ms": 250,
+    "type": "static",
+    "lb_type": "maglev",
+    "hosts": [{"url": "tcp://10.0.0.1:11001"}]
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
+  StaticClusterImpl cluster(*config, runtime, stats, ssl_context_manager);
+  EXPECT_EQ(1UL, cluster.healthyHosts().size());
+  EXPECT_EQ(LoadBalancerType::Maglev, cluster.info()->lbType());
+}
+
 TEST(StaticClusterImplTest, OutlierDetector) {
   Stats::IsolatedStoreImpl stats;
   Ssl::MockContextManager ssl_context_manager;
@@ -470,6 +542,8 @@ TEST(StaticClusterImplTest, UrlConfig) {
   EXPECT_EQ(Http::Http2Settings::DEFAULT_HPACK_TABLE_SIZE,
             cluster.info()->http2Settings().hpack_table_size_);
   EXPECT_EQ(LoadBalancerType::Random, cluster.info()->lbType());
+  EXPECT_FALSE(cluster.info()->lbSubsetInfo().isEnabled());
+  EXPECT_EQ(RingHashFunction::StdHash, cluster.info()->ringHashFunction());
   EXPECT_THAT(std::list<std::string>({"10.0.0.1:11001", "10.0.0.2:11002"}),
               ContainerEq(hostListToAddresses(cluster.hosts())));
   EXPECT_EQ(2UL, cluster.healthyHosts().size());
@@ -477,6 +551,142 @@ TEST(StaticClusterImplTest, UrlConfig) {
   EXPECT_EQ(0UL, cluster.healthyHostsPerZone().size());
 }
 
+TEST(StaticClusterImplTest, SubsetConfig) {
+  Stats::IsolatedStoreImpl stats;
+  Ssl::MockContextManager ssl_context_manager;
+  NiceMock<Runtime::MockLoader> runtime;
+  std::string json = R"EOF(
+  {
+    "name": "addressportconfig",
+    "connect_timeout_ms": 250,
+    "type": "static",
+    "lb_type": "round_robin",
+    "lb_subset_config": {
+      "subset_keys": [["version"], ["version", "stage"]],
+      "fallback_policy": "no_fallback"
+    },
+    "hosts": [{"url": "tcp://10.0.0.1:11001", "metadata": {"version": "v1", "stage": "prod"}},
+              {"url": "tcp://10.0.0.2:11002"}]
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
+  config->validateSchema(Json::Schema::CLUSTER_SCHEMA);
+  StaticClusterImpl cluster(*config, runtime, stats, ssl_context_manager);
+  const LbSubsetInfo& subset_info = cluster.info()->lbSubsetInfo();
+  EXPECT_TRUE(subset_info.isEnabled());
+  EXPECT_EQ(LbSubsetInfo::FallbackPolicy::NoFallback, subset_info.fallbackPolicy());
+  EXPECT_EQ((std::vector<std::set<std::string>>{{"version"}, {"version", "stage"}}),
+            subset_info.subsetKeys());
+  EXPECT_EQ((HostMetadata{{"version", "v1"}, {"stage", "prod"}}), cluster.hosts()[0]->metadata());
+  EXPECT_TRUE(cluster.hosts()[1]->metadata().empty());
+}
+
+TEST(StaticClusterImplTest, PriorityAndLocalityWeights) {
+  Stats::IsolatedStoreImpl stats;
+  Ssl::MockContextManager ssl_context_manager;
+  NiceMock<Runtime::MockLoader> runtime;
+  std::string json = R"EOF(
+  {
+    "name": "addressportconfig",
+    "connect_timeout_ms": 250,
+    "type": "static",
+    "lb_type": "round_robin",
+    "locality_weights": {"us-east-1a": 3, "us-east-1b": 1},
+    "hosts": [{"url": "tcp://10.0.0.1:11001", "zone": "us-east-1a"},
+              {"url": "tcp://10.0.0.2:11002", "zone": "us-east-1b", "priority": 1}]
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
+  config->validateSchema(Json::Schema::CLUSTER_SCHEMA);
+  StaticClusterImpl cluster(*config, runtime, stats, ssl_context_manager);
+  EXPECT_EQ((std::unordered_map<std::string, uint32_t>{{"us-east-1a", 3}, {"us-east-1b", 1}}),
+            cluster.info()->localityWeights());
+  EXPECT_EQ("us-east-1a", cluster.hosts()[0]->zone());
+  EXPECT_EQ(0U, cluster.hosts()[0]->priority());
+  EXPECT_EQ("us-east-1b", cluster.hosts()[1]->zone());
+  EXPECT_EQ(1U, cluster.hosts()[1]->priority());
+}
+
+TEST(StaticClusterImplTest, RingHashConfig) {
+  Stats::IsolatedStoreImpl stats;
+  Ssl::MockContextManager ssl_context_manager;
+  NiceMock<Runtime::MockLoader> runtime;
+  std::string json = R"EOF(
+  {
+    "name": "addressportconfig",
+    "connect_timeout_ms": 250,
+    "type": "static",
+    "lb_type": "ring_hash",
+    "ring_hash_lb_config": {"hash_function": "xx_hash"},
+    "hosts": [{"url": "tcp://10.0.0.1:11001"}]
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
+  config->validateSchema(Json::Schema::CLUSTER_SCHEMA);
+  StaticClusterImpl cluster(*config, runtime, stats, ssl_context_manager);
+  EXPECT_EQ(RingHashFunction::XxHash64, cluster.info()->ringHashFunction());
+}
+
+TEST(StaticClusterImplTest, SocketOptionsConfig) {
+  Stats::IsolatedStoreImpl stats;
+  Ssl::MockContextManager ssl_context_manager;
+  NiceMock<Runtime::MockLoader> runtime;
+  std::string json = R"EOF(
+  {
+    "name": "addressportconfig",
+    "connect_timeout_ms": 250,
+    "type": "static",
+    "lb_type": "round_robin",
+    "socket_options": {"keepalive": {"probes": 3}, "notsent_lowat_bytes": 16384},
+    "hosts": [{"url": "tcp://10.0.0.1:11001"}]
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
+  config->validateSchema(Json::Schema::CLUSTER_SCHEMA);
+  StaticClusterImpl cluster(*config, runtime, stats, ssl_context_manager);
+  ASSERT_NE(nullptr, cluster.info()->socketOptions());
+  EXPECT_TRUE(cluster.info()->socketOptions()->keepalive_);
+  EXPECT_EQ(3U, cluster.info()->socketOptions()->keepalive_probes_.value());
+  EXPECT_EQ(16384U, cluster.info()->socketOptions()->notsent_lowat_bytes_.value());
+
+  NiceMock<Event::MockDispatcher> dispatcher;
+  Network::MockClientConnection* connection = new NiceMock<Network::MockClientConnection>();
+  EXPECT_CALL(dispatcher, createClientConnection_(_)).WillOnce(Return(connection));
+  EXPECT_CALL(*connection, setSocketOptions(cluster.info()->socketOptions()));
+  cluster.hosts()[0]->createConnection(dispatcher);
+}
+
+TEST(StaticClusterImplTest, ConnectionLifetimeConfig) {
+  Stats::IsolatedStoreImpl stats;
+  Ssl::MockContextManager ssl_context_manager;
+  NiceMock<Runtime::MockLoader> runtime;
+  std::string json = R"EOF(
+  {
+    "name": "addressportconfig",
+    "connect_timeout_ms": 250,
+    "type": "static",
+    "lb_type": "round_robin",
+    "max_requests_per_connection": 1000,
+    "max_requests_per_connection_jitter_percent": 20,
+    "idle_timeout_ms": 30000,
+    "http1_pipeline_depth": 4,
+    "hosts": [{"url": "tcp://10.0.0.1:11001"}]
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
+  config->validateSchema(Json::Schema::CLUSTER_SCHEMA);
+  StaticClusterImpl cluster(*config, runtime, stats, ssl_context_manager);
+  EXPECT_EQ(1000U, cluster.info()->maxRequestsPerConnection());
+  EXPECT_EQ(20U, cluster.info()->maxRequestsPerConnectionJitterPercent());
+  EXPECT_EQ(std::chrono::milliseconds(30000), cluster.info()->idleTimeout().value());
+  EXPECT_EQ(4U, cluster.info()->http1PipelineDepth());
+}
+
 TEST(StaticClusterImplTest, UnsupportedLBType) {
   Stats::IsolatedStoreImpl stats;
   Ssl::MockContextManager ssl_context_manager;
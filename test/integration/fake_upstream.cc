@@ -125,14 +125,62 @@ void FakeStream::waitForReset() {
   }
 }
 
+AutoRespondingStream::AutoRespondingStream(FakeHttpConnection& parent,
+                                           Http::StreamEncoder& encoder)
+    : parent_(parent), encoder_(encoder) {
+  encoder.getStream().addCallbacks(*this);
+}
+
+void AutoRespondingStream::decodeHeaders(Http::HeaderMapPtr&&, bool end_stream) {
+  if (end_stream) {
+    respond();
+  }
+}
+
+void AutoRespondingStream::decodeData(Buffer::Instance&, bool end_stream) {
+  if (end_stream) {
+    respond();
+  }
+}
+
+void AutoRespondingStream::decodeTrailers(Http::HeaderMapPtr&&) { respond(); }
+
+void AutoRespondingStream::onResetStream(Http::StreamResetReason) { destroy(); }
+
+void AutoRespondingStream::respond() {
+  const uint64_t body_size = parent_.auto_response_body_size_;
+  encoder_.encodeHeaders(Http::TestHeaderMapImpl{{":status", "200"}}, body_size == 0);
+  if (body_size > 0) {
+    Buffer::OwnedImpl data(std::string(body_size, 'a'));
+    encoder_.encodeData(data, true);
+  }
+  destroy();
+}
+
+void AutoRespondingStream::destroy() {
+  // The stream may be reset after it has responded, e.g. if the connection closes.
+  if (inserted()) {
+    parent_.connection_.dispatcher().deferredDelete(removeFromList(parent_.auto_streams_));
+  }
+}
+
+FakeHttpConnection::FakeHttpConnection(QueuedConnectionWrapperPtr connection_wrapper,
+                                       Stats::Store& store, Type type,
+                                       uint64_t auto_response_body_size)
+    : FakeHttpConnection(std::move(connection_wrapper), store, type) {
+  auto_respond_ = true;
+  auto_response_body_size_ = auto_response_body_size;
+}
+
 FakeHttpConnection::FakeHttpConnection(QueuedConnectionWrapperPtr connection_wrapper,
                                        Stats::Store& store, Type type)
     : FakeConnectionBase(std::move(connection_wrapper)) {
   if (type == Type::HTTP1) {
-    codec_.reset(new Http::Http1::ServerConnectionImpl(connection_, *this));
+    codec_.reset(new Http::Http1::ServerConnectionImpl(connection_, *this, Http::HeaderLimits()));
   } else {
-    codec_.reset(
-        new Http::Http2::ServerConnectionImpl(connection_, *this, store, Http::Http2Settings()));
+    codec_.reset(new Http::Http2::ServerConnectionImpl(connection_, *this, store,
+                                                       Http::Http2Settings(),
+                                                       Http::HeaderLimits()));
     ASSERT(type == Type::HTTP2);
   }
 
@@ -158,6 +206,12 @@ void FakeConnectionBase::readDisable(bool disable) {
 }
 
 Http::StreamDecoder& FakeHttpConnection::newStream(Http::StreamEncoder& encoder) {
+  if (auto_respond_) {
+    AutoRespondingStreamPtr stream(new AutoRespondingStream(*this, encoder));
+    stream->moveIntoList(std::move(stream), auto_streams_);
+    return *auto_streams_.front();
+  }
+
   std::unique_lock<std::mutex> lock(lock_);
   new_streams_.emplace_back(new FakeStream(*this, encoder));
   connection_event_.notify_one();
@@ -225,7 +279,7 @@ FakeUpstream::FakeUpstream(Ssl::ServerContext* ssl_ctx, uint32_t port,
 FakeUpstream::FakeUpstream(Ssl::ServerContext* ssl_ctx, Network::ListenSocketPtr&& listen_socket,
                            FakeHttpConnection::Type type)
     : ssl_ctx_(ssl_ctx), socket_(std::move(listen_socket)),
-      handler_(log(), Api::ApiPtr{new Api::Impl(std::chrono::milliseconds(10000))}),
+      handler_(log(), Api::ApiPtr{new Api::Impl(std::chrono::milliseconds(10000))}, nullptr),
       http_type_(type) {
   thread_.reset(new Thread::Thread([this]() -> void { threadRoutine(); }));
   server_initialized_.waitReady();
@@ -236,8 +290,21 @@ FakeUpstream::~FakeUpstream() {
   thread_->join();
 }
 
+void FakeUpstream::autoRespond(uint64_t response_body_size) {
+  std::unique_lock<std::mutex> lock(lock_);
+  auto_respond_ = true;
+  auto_response_body_size_ = response_body_size;
+}
+
 bool FakeUpstream::createFilterChain(Network::Connection& connection) {
   std::unique_lock<std::mutex> lock(lock_);
+  if (auto_respond_) {
+    auto_connections_.emplace_back(
+        new FakeHttpConnection(QueuedConnectionWrapperPtr{new QueuedConnectionWrapper(connection)},
+                               stats_store_, http_type_, auto_response_body_size_));
+    return true;
+  }
+
   connection.readDisable(true);
   new_connections_.emplace_back(new QueuedConnectionWrapper(connection));
   new_connection_event_.notify_one();
@@ -7,12 +7,14 @@
 #include <mutex>
 #include <string>
 
+#include "envoy/event/deferred_deletable.h"
 #include "envoy/http/codec.h"
 #include "envoy/network/connection.h"
 #include "envoy/network/filter.h"
 #include "envoy/server/configuration.h"
 
 #include "common/buffer/buffer_impl.h"
+#include "common/common/linked_object.h"
 #include "common/common/thread.h"
 #include "common/network/filter_impl.h"
 #include "common/network/listen_socket_impl.h"
@@ -55,6 +57,8 @@ public:
 
   // Http::StreamCallbacks
   void onResetStream(Http::StreamResetReason reason) override;
+  void onAboveWriteBufferHighWatermark() override {}
+  void onBelowWriteBufferLowWatermark() override {}
 
 private:
   FakeHttpConnection& parent_;
@@ -93,6 +97,8 @@ public:
     RELEASE_ASSERT(parented_ || (!(events & Network::ConnectionEvent::RemoteClose) &&
                                  !(events & Network::ConnectionEvent::LocalClose)));
   }
+  void onAboveWriteBufferHighWatermark() override {}
+  void onBelowWriteBufferLowWatermark() override {}
 
 private:
   Network::Connection& connection_;
@@ -112,6 +118,8 @@ public:
 
   // Network::ConnectionCallbacks
   void onEvent(uint32_t events) override;
+  void onAboveWriteBufferHighWatermark() override {}
+  void onBelowWriteBufferLowWatermark() override {}
 
 protected:
   FakeConnectionBase(QueuedConnectionWrapperPtr connection_wrapper)
@@ -132,6 +140,39 @@ private:
   QueuedConnectionWrapperPtr connection_wrapper_;
 };
 
+class FakeHttpConnection;
+
+/**
+ * Fake HTTP stream that answers its request with a 200 as soon as the request is complete, on the
+ * fake upstream's own thread. It is used to generate load without the test thread in the loop.
+ */
+class AutoRespondingStream : public Http::StreamDecoder,
+                             public Http::StreamCallbacks,
+                             public Event::DeferredDeletable,
+                             public LinkedObject<AutoRespondingStream> {
+public:
+  AutoRespondingStream(FakeHttpConnection& parent, Http::StreamEncoder& encoder);
+
+  // Http::StreamDecoder
+  void decodeHeaders(Http::HeaderMapPtr&& headers, bool end_stream) override;
+  void decodeData(Buffer::Instance& data, bool end_stream) override;
+  void decodeTrailers(Http::HeaderMapPtr&& trailers) override;
+
+  // Http::StreamCallbacks
+  void onResetStream(Http::StreamResetReason reason) override;
+  void onAboveWriteBufferHighWatermark() override {}
+  void onBelowWriteBufferLowWatermark() override {}
+
+private:
+  void respond();
+  void destroy();
+
+  FakeHttpConnection& parent_;
+  Http::StreamEncoder& encoder_;
+};
+
+typedef std::unique_ptr<AutoRespondingStream> AutoRespondingStreamPtr;
+
 /**
  * Provides a fake HTTP connection for integration testing.
  */
@@ -140,6 +181,14 @@ public:
   enum class Type { HTTP1, HTTP2 };
 
   FakeHttpConnection(QueuedConnectionWrapperPtr connection_wrapper, Stats::Store& store, Type type);
+
+  /**
+   * Create a connection whose streams are answered by AutoRespondingStream, with a response body
+   * of the given size, instead of being handed to the test by waitForNewStream().
+   */
+  FakeHttpConnection(QueuedConnectionWrapperPtr connection_wrapper, Stats::Store& store, Type type,
+                     uint64_t auto_response_body_size);
+
   Network::Connection& connection() { return connection_; }
   FakeStreamPtr waitForNewStream();
 
@@ -162,6 +211,11 @@ private:
 
   Http::ServerConnectionPtr codec_;
   std::list<FakeStreamPtr> new_streams_;
+  bool auto_respond_{};
+  uint64_t auto_response_body_size_{};
+  std::list<AutoRespondingStreamPtr> auto_streams_;
+
+  friend class AutoRespondingStream;
 };
 
 typedef std::unique_ptr<FakeHttpConnection> FakeHttpConnectionPtr;
@@ -206,6 +260,14 @@ public:
   ~FakeUpstream();
 
   FakeHttpConnection::Type httpType() { return http_type_; }
+
+  /**
+   * Answer every request on connections accepted from now on with a 200 and a response body of
+   * the given size, on the upstream's own thread. Such connections are owned by the upstream and
+   * are not returned by waitForHttpConnection(). Used to generate load.
+   */
+  void autoRespond(uint64_t response_body_size);
+
   FakeHttpConnectionPtr waitForHttpConnection(Event::Dispatcher& client_dispatcher);
   FakeRawConnectionPtr waitForRawConnection();
   Network::Address::InstanceConstSharedPtr localAddress() const { return socket_->localAddress(); }
@@ -228,5 +290,8 @@ private:
   Server::ConnectionHandlerImpl handler_;
   std::list<QueuedConnectionWrapperPtr> new_connections_;
   FakeHttpConnection::Type http_type_;
+  bool auto_respond_{};
+  uint64_t auto_response_body_size_{};
+  std::list<FakeHttpConnectionPtr> auto_connections_;
 };
 } // Envoy
@@ -0,0 +1,294 @@
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "test/integration/integration.h"
+#include "test/test_common/allocation_counter.h"
+#include "test/test_common/environment.h"
+#include "test/test_common/network_utility.h"
+#include "test/test_common/utility.h"
+
+#include "gtest/gtest.h"
+#include "spdlog/spdlog.h"
+
+namespace Envoy {
+
+/**
+ * Closed loop load generator. Every connection keeps a fixed number of requests outstanding, and
+ * issues the next request as soon as a response completes, until the requested number of requests
+ * has completed. It runs on the dispatcher of the test thread.
+ */
+class HttpLoadGenerator {
+public:
+  HttpLoadGenerator(Event::Dispatcher& dispatcher,
+                    const std::vector<IntegrationCodecClientPtr>& clients,
+                    uint32_t streams_per_connection)
+      : dispatcher_(dispatcher) {
+    for (const IntegrationCodecClientPtr& client : clients) {
+      for (uint32_t i = 0; i < streams_per_connection; i++) {
+        slots_.emplace_back(new Slot(*this, *client));
+      }
+    }
+  }
+
+  /**
+   * Run until the given number of requests has completed.
+   * @return the latency of every request, sorted.
+   */
+  std::vector<std::chrono::microseconds> run(uint64_t requests) {
+    target_ = requests;
+    issued_ = 0;
+    completed_ = 0;
+    latencies_.clear();
+    latencies_.reserve(requests);
+    for (std::unique_ptr<Slot>& slot : slots_) {
+      if (issued_ == target_) {
+        break;
+      }
+      issued_++;
+      slot->start();
+    }
+
+    dispatcher_.run(Event::Dispatcher::RunType::Block);
+    std::sort(latencies_.begin(), latencies_.end());
+    return latencies_;
+  }
+
+private:
+  /**
+   * A request slot. Only one request is outstanding per slot at a time.
+   */
+  struct Slot : public Http::StreamDecoder, public Http::StreamCallbacks {
+    Slot(HttpLoadGenerator& parent, Http::CodecClient& client) : parent_(parent), client_(client) {}
+
+    void start() {
+      start_time_ = std::chrono::steady_clock::now();
+      Http::StreamEncoder& encoder = client_.newStream(*this);
+      encoder.getStream().addCallbacks(*this);
+      encoder.encodeHeaders(parent_.request_headers_, true);
+    }
+
+    // Http::StreamDecoder
+    void decodeHeaders(Http::HeaderMapPtr&&, bool end_stream) override {
+      if (end_stream) {
+        parent_.onComplete(*this);
+      }
+    }
+    void decodeData(Buffer::Instance&, bool end_stream) override {
+      if (end_stream) {
+        parent_.onComplete(*this);
+      }
+    }
+    void decodeTrailers(Http::HeaderMapPtr&&) override { parent_.onComplete(*this); }
+
+    // Http::StreamCallbacks
+    void onResetStream(Http::StreamResetReason) override {
+      ADD_FAILURE() << "benchmark stream reset";
+      parent_.dispatcher_.exit();
+    }
+    void onAboveWriteBufferHighWatermark() override {}
+    void onBelowWriteBufferLowWatermark() override {}
+
+    HttpLoadGenerator& parent_;
+    Http::CodecClient& client_;
+    MonotonicTime start_time_;
+  };
+
+  void onComplete(Slot& slot) {
+    latencies_.push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - slot.start_time_));
+    if (++completed_ == target_) {
+      dispatcher_.exit();
+    } else if (issued_ < target_) {
+      // The codec is still dispatching the response, so start the next request once it is done.
+      issued_++;
+      dispatcher_.post([&slot]() -> void { slot.start(); });
+    }
+  }
+
+  Event::Dispatcher& dispatcher_;
+  std::vector<std::unique_ptr<Slot>> slots_;
+  Http::TestHeaderMapImpl request_headers_{{":method", "GET"},
+                                           {":path", "/benchmark"},
+                                           {":scheme", "http"},
+                                           {":authority", "benchmark"}};
+  uint64_t target_{};
+  uint64_t issued_{};
+  uint64_t completed_{};
+  std::vector<std::chrono::microseconds> latencies_;
+};
+
+/**
+ * This test is for benchmarking only and should not be run as part of unit tests. It runs the
+ * server in process against a fake upstream that answers every request on its own thread, drives
+ * it with a closed loop load generator, and prints one JSON line of results per scenario so that
+ * runs can be tracked for regressions.
+ *
+ * CPU time and allocations are measured for the whole process, so they include the load generator
+ * and the fake upstream as well as the server. They are meant to be compared between runs of the
+ * same scenario rather than read as absolute costs.
+ */
+class DISABLED_HttpProxyBenchmark : public BaseIntegrationTest, public testing::Test {
+public:
+  DISABLED_HttpProxyBenchmark()
+      : BaseIntegrationTest(TestEnvironment::getIpVersionsForTest().front()) {}
+
+  struct Scenario {
+    std::string name_;
+    Http::CodecClient::Type downstream_type_;
+    FakeHttpConnection::Type upstream_type_;
+    // JSON filter entries that run ahead of the router, including a trailing comma.
+    std::string filters_;
+    uint32_t num_routes_;
+    uint32_t connections_;
+    uint32_t streams_per_connection_;
+    uint64_t requests_;
+    uint64_t response_body_size_;
+  };
+
+  void TearDown() override {
+    test_server_.reset();
+    fake_upstreams_.clear();
+  }
+
+  void run(const Scenario& scenario) {
+    fake_upstreams_.emplace_back(new FakeUpstream(0, scenario.upstream_type_, version_));
+    fake_upstreams_.back()->autoRespond(scenario.response_body_size_);
+    const std::string config_path = TestEnvironment::temporaryPath("http_benchmark.json");
+    {
+      std::ofstream config_file(config_path);
+      config_file << config(scenario, fake_upstreams_.back()->localAddress()->ip()->port());
+    }
+    test_server_ = IntegrationTestServer::create(config_path, version_);
+    registerTestServerPorts({"http"});
+
+    std::vector<IntegrationCodecClientPtr> clients;
+    for (uint32_t i = 0; i < scenario.connections_; i++) {
+      clients.push_back(makeHttpConnection(lookupPort("http"), scenario.downstream_type_));
+    }
+    HttpLoadGenerator load_generator(*dispatcher_, clients, scenario.streams_per_connection_);
+
+    // Warm up connection pools and caches before measuring.
+    load_generator.run(scenario.requests_ / 10);
+
+    AllocationCounter allocation_counter;
+    const double start_cpu_seconds = cpuSeconds();
+    const MonotonicTime start_time = std::chrono::steady_clock::now();
+    const std::vector<std::chrono::microseconds> latencies =
+        load_generator.run(scenario.requests_);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+    const double cpu_seconds = cpuSeconds() - start_cpu_seconds;
+    const uint64_t allocations = allocation_counter.allocations();
+
+    const uint64_t requests = latencies.size();
+    ASSERT_EQ(scenario.requests_, requests);
+    const std::string allocations_per_request =
+        AllocationCounter::supported()
+            ? fmt::format("{:.1f}", static_cast<double>(allocations) / requests)
+            : "null";
+    std::cout << fmt::format("{{\"name\": \"{}\", \"requests\": {}, \"rps\": {:.0f}, "
+                             "\"rps_per_core\": {:.0f}, \"p50_us\": {}, \"p99_us\": {}, "
+                             "\"p999_us\": {}, \"allocations_per_request\": {}}}",
+                             scenario.name_, requests, requests / elapsed.count(),
+                             requests / cpu_seconds, percentile(latencies, 0.5),
+                             percentile(latencies, 0.99), percentile(latencies, 0.999),
+                             allocations_per_request)
+              << std::endl;
+
+    for (IntegrationCodecClientPtr& client : clients) {
+      client->close();
+    }
+  }
+
+private:
+  static double cpuSeconds() {
+    rusage usage;
+    RELEASE_ASSERT(getrusage(RUSAGE_SELF, &usage) == 0);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+  }
+
+  static uint64_t percentile(const std::vector<std::chrono::microseconds>& sorted, double q) {
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(q * sorted.size()))].count();
+  }
+
+  std::string config(const Scenario& scenario, uint32_t upstream_port) {
+    // Requests only match the last route, so every route is evaluated.
+    std::string routes;
+    for (uint32_t i = 1; i < scenario.num_routes_; i++) {
+      routes += fmt::format("{{\"prefix\": \"/route_{}/\", \"cluster\": \"benchmark\"}},", i);
+    }
+    routes += "{\"prefix\": \"/\", \"cluster\": \"benchmark\"}";
+
+    const std::string address = Network::Test::getLoopbackAddressUrlString(version_);
+    return fmt::format(
+        R"EOF(
+{{
+  "listeners": [{{
+    "address": "tcp://{0}:0",
+    "filters": [{{
+      "type": "read",
+      "name": "http_connection_manager",
+      "config": {{
+        "codec_type": "{1}",
+        "stat_prefix": "benchmark",
+        "route_config": {{
+          "virtual_hosts": [{{"name": "benchmark", "domains": ["*"], "routes": [{2}]}}]
+        }},
+        "filters": [{3} {{"type": "decoder", "name": "router", "config": {{}}}}]
+      }}
+    }}]
+  }}],
+  "admin": {{"access_log_path": "/dev/null", "address": "tcp://{0}:0"}},
+  "cluster_manager": {{
+    "clusters": [{{
+      "name": "benchmark",
+      "connect_timeout_ms": 5000,
+      "type": "static",
+      "lb_type": "round_robin",
+      {4}
+      "hosts": [{{"url": "tcp://{0}:{5}"}}]
+    }}]
+  }}
+}}
+)EOF",
+        address, scenario.downstream_type_ == Http::CodecClient::Type::HTTP1 ? "http1" : "http2",
+        routes, scenario.filters_,
+        scenario.upstream_type_ == FakeHttpConnection::Type::HTTP2 ? "\"features\": \"http2\","
+                                                                   : "",
+        upstream_port);
+  }
+};
+
+TEST_F(DISABLED_HttpProxyBenchmark, Http1) {
+  run({"http1", Http::CodecClient::Type::HTTP1, FakeHttpConnection::Type::HTTP1, "", 1, 16, 1,
+       200000, 0});
+}
+
+TEST_F(DISABLED_HttpProxyBenchmark, Http2) {
+  run({"http2", Http::CodecClient::Type::HTTP2, FakeHttpConnection::Type::HTTP2, "", 1, 4, 32,
+       200000, 0});
+}
+
+TEST_F(DISABLED_HttpProxyBenchmark, Http1LargeRouteTable) {
+  run({"http1_1000_routes", Http::CodecClient::Type::HTTP1, FakeHttpConnection::Type::HTTP1, "",
+       1000, 16, 1, 200000, 0});
+}
+
+TEST_F(DISABLED_HttpProxyBenchmark, Http1Filters) {
+  run({"http1_filters", Http::CodecClient::Type::HTTP1, FakeHttpConnection::Type::HTTP1,
+       R"EOF(
+       {"type": "decoder", "name": "buffer",
+        "config": {"max_request_bytes": 1048576, "max_request_time_s": 10}},
+       {"type": "both", "name": "gzip", "config": {}},
+       )EOF",
+       1, 16, 1, 200000, 1024});
+}
+
+} // Envoy
@@ -1,6 +1,7 @@
 #include "test/integration/server.h"
 
 #include <string>
+#include <vector>
 
 #include "envoy/http/header_map.h"
 #include "envoy/server/hot_restart.h"
@@ -21,8 +22,12 @@ class TestHotRestart : public HotRestart {
 public:
   // Server::HotRestart
   void drainParentListeners() override {}
-  int duplicateParentListenSocket(const std::string&) override { return -1; }
+  std::vector<int>
+  duplicateParentListenSockets(const std::vector<std::string>& addresses) override {
+    return std::vector<int>(addresses.size(), -1);
+  }
   void getParentStats(GetParentStatsInfo& info) override { memset(&info, 0, sizeof(info)); }
+  void mergeParentHistograms(Stats::StoreRoot&) override {}
   void initialize(Event::Dispatcher&, Server::Instance&) override {}
   void shutdownParentAdmin(ShutdownParentAdminInfo&) override {}
   void terminateParent() override {}
@@ -6,6 +6,7 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 
 #include "envoy/server/options.h"
 
@@ -45,10 +46,16 @@ public:
     return std::chrono::milliseconds(10000);
   }
   Mode mode() const override { return Mode::Serve; }
+  uint64_t maxStats() override { return 16384; }
+  const std::vector<uint32_t>& workerCpus() override { return cpus_; }
+  const std::vector<uint32_t>& mainThreadCpus() override { return cpus_; }
+  bool memoryAccounting() override { return false; }
+  uint32_t asyncLogLines() override { return 0; }
 
 private:
   const std::string config_path_;
   const std::string admin_address_path_;
+  const std::vector<uint32_t> cpus_;
   Network::Address::IpVersion local_address_ip_version_;
 };
 
@@ -109,15 +116,36 @@ public:
     std::unique_lock<std::mutex> lock(lock_);
     return store_.gauges();
   }
+  std::list<HistogramSharedPtr> histograms() const override {
+    std::unique_lock<std::mutex> lock(lock_);
+    return store_.histograms();
+  }
   ScopePtr createScope(const std::string& name) override {
     std::unique_lock<std::mutex> lock(lock_);
     return store_.createScope(name);
   }
 
   // Stats::StoreRoot
-  void addSink(Sink&) override {}
   void initializeThreading(Event::Dispatcher&, ThreadLocal::Instance&) override {}
   void shutdownThreading() override {}
+  void setTagProducer(TagProducerPtr&&) override {}
+  void forEachChangedStat(const ChangedCounterCb& counter_cb,
+                          const ChangedGaugeCb& gauge_cb) override {
+    // The isolated store does not track changes, so all used stats are visited.
+    for (const CounterSharedPtr& counter : counters()) {
+      const uint64_t delta = counter->latch();
+      if (delta > 0) {
+        counter_cb(*counter, delta);
+      }
+    }
+    for (const GaugeSharedPtr& gauge : gauges()) {
+      if (gauge->used()) {
+        gauge_cb(*gauge);
+      }
+    }
+  }
+  void addParentHistogram(const std::string&, uint64_t,
+                          const std::vector<std::pair<uint64_t, uint64_t>>&) override {}
 
 private:
   mutable std::mutex lock_;
@@ -16,6 +16,8 @@
 #include "envoy/network/listener.h"
 #include "envoy/ssl/context.h"
 
+#include "common/common/utility.h"
+
 #include "gmock/gmock.h"
 
 namespace Envoy {
@@ -69,6 +71,11 @@ public:
 
   TimerPtr createTimer(TimerCb cb) override { return TimerPtr{createTimer_(cb)}; }
 
+  MonotonicTimeSource& loopTimeSource() override { return ProdMonotonicTimeSource::instance_; }
+
+  // Coarse timers are mocked the same way as precise ones.
+  TimerPtr createCoarseTimer(TimerCb cb) override { return TimerPtr{createTimer_(cb)}; }
+
   void deferredDelete(DeferredDeletablePtr&& to_delete) override {
     deferredDelete_(to_delete);
     if (to_delete) {
@@ -107,6 +114,7 @@ public:
   MOCK_METHOD1(deferredDelete_, void(DeferredDeletablePtr& to_delete));
   MOCK_METHOD0(exit, void());
   MOCK_METHOD2(listenForSignal_, SignalEvent*(int signal_num, SignalCb cb));
+  MOCK_METHOD2(initializeStats, void(Stats::Scope& scope, const std::string& prefix));
   MOCK_METHOD1(post, void(std::function<void()> callback));
   MOCK_METHOD1(run, void(RunType type));
 
@@ -29,6 +29,16 @@ ssize_t MockOsSysCalls::write(int fd, const void* buffer, size_t num_bytes) {
   return result;
 }
 
+ssize_t MockOsSysCalls::writev(int fd, const iovec* iov, int iovcnt) {
+  // Gathered writes are seen by write_() as a single write of the concatenated buffers.
+  std::string data;
+  for (int i = 0; i < iovcnt; i++) {
+    data.append(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len);
+  }
+
+  return write(fd, data.data(), data.size());
+}
+
 MockFile::MockFile() {}
 MockFile::~MockFile() {}
 
@@ -20,6 +20,7 @@ public:
 
   // Filesystem::OsSysCalls
   ssize_t write(int fd, const void* buffer, size_t num_bytes) override;
+  ssize_t writev(int fd, const iovec* iov, int iovcnt) override;
   int open(const std::string& full_path, int flags, int mode) override;
   MOCK_METHOD1(close, int(int));
 
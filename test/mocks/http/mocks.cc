@@ -78,6 +78,9 @@ template <class T> static void initializeMockStreamFilterCallbacks(T& callbacks)
   ON_CALL(callbacks, downstreamAddress()).WillByDefault(ReturnRef(callbacks.downstream_address_));
 }
 
+MockDownstreamWatermarkCallbacks::MockDownstreamWatermarkCallbacks() {}
+MockDownstreamWatermarkCallbacks::~MockDownstreamWatermarkCallbacks() {}
+
 MockStreamDecoderFilterCallbacks::MockStreamDecoderFilterCallbacks() {
   initializeMockStreamFilterCallbacks(*this);
   ON_CALL(*this, decodingBuffer()).WillByDefault(Return(buffer_.get()));
@@ -131,6 +134,9 @@ MockAsyncClientStreamCallbacks::~MockAsyncClientStreamCallbacks() {}
 MockAsyncClientRequest::MockAsyncClientRequest(MockAsyncClient* client) : client_(client) {}
 MockAsyncClientRequest::~MockAsyncClientRequest() { client_->onRequestDestroy(); }
 
+MockAsyncClientStream::MockAsyncClientStream() {}
+MockAsyncClientStream::~MockAsyncClientStream() {}
+
 MockFilterChainFactoryCallbacks::MockFilterChainFactoryCallbacks() {}
 MockFilterChainFactoryCallbacks::~MockFilterChainFactoryCallbacks() {}
 
@@ -137,6 +137,8 @@ public:
 
   // Http::StreamCallbacks
   MOCK_METHOD1(onResetStream, void(StreamResetReason reason));
+  MOCK_METHOD0(onAboveWriteBufferHighWatermark, void());
+  MOCK_METHOD0(onBelowWriteBufferLowWatermark, void());
 };
 
 class MockStream : public Stream {
@@ -148,6 +150,7 @@ public:
   MOCK_METHOD1(addCallbacks, void(StreamCallbacks& callbacks));
   MOCK_METHOD1(removeCallbacks, void(StreamCallbacks& callbacks));
   MOCK_METHOD1(resetStream, void(StreamResetReason reason));
+  MOCK_METHOD1(readDisable, void(bool disable));
 
   std::list<StreamCallbacks*> callbacks_{};
 };
@@ -177,6 +180,8 @@ public:
   MOCK_METHOD0(protocol, Protocol());
   MOCK_METHOD0(shutdownNotice, void());
   MOCK_METHOD0(wantsToWrite, bool());
+  MOCK_METHOD0(onUnderlyingConnectionAboveWriteBufferHighWatermark, void());
+  MOCK_METHOD0(onUnderlyingConnectionBelowWriteBufferLowWatermark, void());
 
   Protocol protocol_{Protocol::Http11};
 };
@@ -192,9 +197,12 @@ public:
   MOCK_METHOD0(protocol, Protocol());
   MOCK_METHOD0(shutdownNotice, void());
   MOCK_METHOD0(wantsToWrite, bool());
+  MOCK_METHOD0(onUnderlyingConnectionAboveWriteBufferHighWatermark, void());
+  MOCK_METHOD0(onUnderlyingConnectionBelowWriteBufferLowWatermark, void());
 
   // Http::ClientConnection
   MOCK_METHOD1(newStream, StreamEncoder&(StreamDecoder& response_decoder));
+  MOCK_METHOD0(maxConcurrentStreams, uint64_t());
 };
 
 class MockFilterChainFactory : public FilterChainFactory {
@@ -214,6 +222,16 @@ public:
   std::string downstream_address_;
 };
 
+class MockDownstreamWatermarkCallbacks : public DownstreamWatermarkCallbacks {
+public:
+  MockDownstreamWatermarkCallbacks();
+  ~MockDownstreamWatermarkCallbacks();
+
+  // Http::DownstreamWatermarkCallbacks
+  MOCK_METHOD0(onAboveWriteBufferHighWatermark, void());
+  MOCK_METHOD0(onBelowWriteBufferLowWatermark, void());
+};
+
 class MockStreamDecoderFilterCallbacks : public StreamDecoderFilterCallbacks,
                                          public MockStreamFilterCallbacksBase {
 public:
@@ -223,6 +241,7 @@ public:
   // Http::StreamFilterCallbacks
   MOCK_METHOD0(connectionId, uint64_t());
   MOCK_METHOD0(ssl, Ssl::Connection*());
+  MOCK_METHOD0(connection, const Network::Connection*());
   MOCK_METHOD0(dispatcher, Event::Dispatcher&());
   MOCK_METHOD0(resetStream, void());
   MOCK_METHOD0(route, Router::RouteConstSharedPtr());
@@ -236,13 +255,23 @@ public:
     encodeHeaders_(*headers, end_stream);
   }
   void encodeTrailers(HeaderMapPtr&& trailers) override { encodeTrailers_(*trailers); }
+  void setDecodingBuffer(Buffer::InstancePtr&& buffer) override {
+    setDecodingBuffer_(*buffer);
+    buffer_ = std::move(buffer);
+  }
 
   MOCK_METHOD0(continueDecoding, void());
   MOCK_METHOD1(addDecodedData, void(Buffer::Instance& data));
   MOCK_METHOD0(decodingBuffer, const Buffer::Instance*());
+  MOCK_METHOD1(setDecodingBuffer_, void(Buffer::Instance& buffer));
+  MOCK_METHOD0(clearRouteCache, void());
   MOCK_METHOD2(encodeHeaders_, void(HeaderMap& headers, bool end_stream));
   MOCK_METHOD2(encodeData, void(Buffer::Instance& data, bool end_stream));
   MOCK_METHOD1(encodeTrailers_, void(HeaderMap& trailers));
+  MOCK_METHOD0(onDecoderFilterAboveWriteBufferHighWatermark, void());
+  MOCK_METHOD0(onDecoderFilterBelowWriteBufferLowWatermark, void());
+  MOCK_METHOD1(addDownstreamWatermarkCallbacks, void(DownstreamWatermarkCallbacks& callbacks));
+  MOCK_METHOD1(removeDownstreamWatermarkCallbacks, void(DownstreamWatermarkCallbacks& callbacks));
 
   Buffer::InstancePtr buffer_;
 };
@@ -256,6 +285,7 @@ public:
   // Http::StreamFilterCallbacks
   MOCK_METHOD0(connectionId, uint64_t());
   MOCK_METHOD0(ssl, Ssl::Connection*());
+  MOCK_METHOD0(connection, const Network::Connection*());
   MOCK_METHOD0(dispatcher, Event::Dispatcher&());
   MOCK_METHOD0(resetStream, void());
   MOCK_METHOD0(route, Router::RouteConstSharedPtr());
@@ -388,6 +418,18 @@ public:
   MockAsyncClient* client_;
 };
 
+class MockAsyncClientStream : public AsyncClient::Stream {
+public:
+  MockAsyncClientStream();
+  ~MockAsyncClientStream();
+
+  MOCK_METHOD2(sendHeaders, void(HeaderMap& headers, bool end_stream));
+  MOCK_METHOD2(sendData, void(Buffer::Instance& data, bool end_stream));
+  MOCK_METHOD1(sendTrailers, void(HeaderMap& trailers));
+  MOCK_METHOD0(reset, void());
+  MOCK_CONST_METHOD0(isAboveWriteBufferHighWatermark, bool());
+};
+
 class MockFilterChainFactoryCallbacks : public Http::FilterChainFactoryCallbacks {
 public:
   MockFilterChainFactoryCallbacks();
@@ -397,6 +439,7 @@ public:
   MOCK_METHOD1(addStreamEncoderFilter, void(Http::StreamEncoderFilterSharedPtr filter));
   MOCK_METHOD1(addStreamFilter, void(Http::StreamFilterSharedPtr filter));
   MOCK_METHOD1(addAccessLogHandler, void(Http::AccessLog::InstanceSharedPtr handler));
+  MOCK_METHOD1(setFilterName, void(const std::string& name));
 };
 } // Http
 
@@ -421,6 +464,7 @@ public:
   MOCK_METHOD1(addDrainedCallback, void(DrainedCb cb));
   MOCK_METHOD2(newStream, Cancellable*(Http::StreamDecoder& response_decoder,
                                        Http::ConnectionPool::Callbacks& callbacks));
+  MOCK_METHOD0(warm, void());
 
   std::shared_ptr<testing::NiceMock<Upstream::MockHostDescription>> host_{
       new testing::NiceMock<Upstream::MockHostDescription>()};
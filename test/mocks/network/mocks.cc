@@ -4,6 +4,7 @@
 
 #include "envoy/buffer/buffer.h"
 
+#include "common/common/assert.h"
 #include "common/network/address_impl.h"
 #include "common/network/utility.h"
 
@@ -27,6 +28,16 @@ MockConnectionCallbacks::~MockConnectionCallbacks() {}
 
 uint64_t MockConnectionBase::next_id_;
 
+void MockConnectionBase::raiseWatermarkEvent(bool above_high_watermark) {
+  for (Network::ConnectionCallbacks* callbacks : callbacks_) {
+    if (above_high_watermark) {
+      callbacks->onAboveWriteBufferHighWatermark();
+    } else {
+      callbacks->onBelowWriteBufferLowWatermark();
+    }
+  }
+}
+
 void MockConnectionBase::raiseEvents(uint32_t events) {
   if ((events & Network::ConnectionEvent::RemoteClose) ||
       (events & Network::ConnectionEvent::LocalClose)) {
@@ -44,7 +55,18 @@ void MockConnectionBase::raiseEvents(uint32_t events) {
 
 template <class T> static void initializeMockConnection(T& connection) {
   ON_CALL(connection, dispatcher()).WillByDefault(ReturnRef(connection.dispatcher_));
-  ON_CALL(connection, readEnabled()).WillByDefault(ReturnPointee(&connection.read_enabled_));
+  ON_CALL(connection, readDisable(_))
+      .WillByDefault(Invoke([&connection](bool disable) -> void {
+        if (disable) {
+          connection.read_disable_count_++;
+        } else {
+          ASSERT(connection.read_disable_count_ > 0);
+          connection.read_disable_count_--;
+        }
+      }));
+  ON_CALL(connection, readEnabled()).WillByDefault(Invoke([&connection]() -> bool {
+    return connection.read_disable_count_ == 0;
+  }));
   ON_CALL(connection, addConnectionCallbacks(_))
       .WillByDefault(Invoke([&connection](Network::ConnectionCallbacks& callbacks)
                                 -> void { connection.callbacks_.push_back(&callbacks); }));
@@ -53,6 +75,10 @@ template <class T> static void initializeMockConnection(T& connection) {
         connection.raiseEvents(Network::ConnectionEvent::LocalClose);
       }));
   ON_CALL(connection, remoteAddress()).WillByDefault(ReturnPointee(connection.remote_address_));
+  ON_CALL(connection, requestedServerName())
+      .WillByDefault(ReturnRef(connection.requested_server_name_));
+  ON_CALL(connection, requestedApplicationProtocols())
+      .WillByDefault(ReturnRef(connection.requested_application_protocols_));
   ON_CALL(connection, id()).WillByDefault(Return(connection.next_id_));
   ON_CALL(connection, state()).WillByDefault(ReturnPointee(&connection.state_));
 
@@ -130,5 +156,8 @@ MockListener::~MockListener() {}
 MockConnectionHandler::MockConnectionHandler() {}
 MockConnectionHandler::~MockConnectionHandler() {}
 
+MockBalancedConnectionHandler::MockBalancedConnectionHandler() {}
+MockBalancedConnectionHandler::~MockBalancedConnectionHandler() {}
+
 } // Network
 } // Envoy
@@ -23,11 +23,15 @@ public:
 
   // Network::ConnectionCallbacks
   MOCK_METHOD1(onEvent, void(uint32_t events));
+  MOCK_METHOD0(onAboveWriteBufferHighWatermark, void());
+  MOCK_METHOD0(onBelowWriteBufferLowWatermark, void());
 };
 
 class MockConnectionBase {
 public:
   void raiseEvents(uint32_t events);
+  // Raise onAboveWriteBufferHighWatermark() or onBelowWriteBufferLowWatermark() on the callbacks.
+  void raiseWatermarkEvent(bool above_high_watermark);
 
   static uint64_t next_id_;
 
@@ -35,7 +39,9 @@ public:
   std::list<Network::ConnectionCallbacks*> callbacks_;
   uint64_t id_{next_id_++};
   Address::InstanceConstSharedPtr remote_address_;
-  bool read_enabled_{true};
+  std::string requested_server_name_;
+  std::vector<std::string> requested_application_protocols_;
+  uint32_t read_disable_count_{};
   Connection::State state_{Connection::State::Open};
 };
 
@@ -57,14 +63,18 @@ public:
   MOCK_METHOD1(noDelay, void(bool enable));
   MOCK_METHOD1(readDisable, void(bool disable));
   MOCK_METHOD0(readEnabled, bool());
-  MOCK_METHOD0(remoteAddress, const Address::Instance&());
-  MOCK_METHOD0(localAddress, const Address::Instance&());
+  MOCK_CONST_METHOD0(remoteAddress, const Address::Instance&());
+  MOCK_CONST_METHOD0(localAddress, const Address::Instance&());
+  MOCK_METHOD0(requestedServerName, const std::string&());
+  MOCK_METHOD0(requestedApplicationProtocols, const std::vector<std::string>&());
   MOCK_METHOD1(setBufferStats, void(const BufferStats& stats));
   MOCK_METHOD0(ssl, Ssl::Connection*());
   MOCK_METHOD0(state, State());
   MOCK_METHOD1(write, void(Buffer::Instance& data));
   MOCK_METHOD1(setReadBufferLimit, void(uint32_t limit));
   MOCK_CONST_METHOD0(readBufferLimit, uint32_t());
+  MOCK_METHOD1(setBufferAccount, void(Buffer::MemoryAccountSharedPtr account));
+  MOCK_METHOD2(spliceTo, bool(Connection& destination, Stats::Counter& bytes_spliced));
 };
 
 /**
@@ -89,17 +99,24 @@ public:
   MOCK_METHOD1(noDelay, void(bool enable));
   MOCK_METHOD1(readDisable, void(bool disable));
   MOCK_METHOD0(readEnabled, bool());
-  MOCK_METHOD0(remoteAddress, const Address::Instance&());
-  MOCK_METHOD0(localAddress, const Address::Instance&());
+  MOCK_CONST_METHOD0(remoteAddress, const Address::Instance&());
+  MOCK_CONST_METHOD0(localAddress, const Address::Instance&());
+  MOCK_METHOD0(requestedServerName, const std::string&());
+  MOCK_METHOD0(requestedApplicationProtocols, const std::vector<std::string>&());
   MOCK_METHOD1(setBufferStats, void(const BufferStats& stats));
   MOCK_METHOD0(ssl, Ssl::Connection*());
   MOCK_METHOD0(state, State());
   MOCK_METHOD1(write, void(Buffer::Instance& data));
   MOCK_METHOD1(setReadBufferLimit, void(uint32_t limit));
   MOCK_CONST_METHOD0(readBufferLimit, uint32_t());
+  MOCK_METHOD1(setBufferAccount, void(Buffer::MemoryAccountSharedPtr account));
+  MOCK_METHOD2(spliceTo, bool(Connection& destination, Stats::Counter& bytes_spliced));
 
   // Network::ClientConnection
   MOCK_METHOD0(connect, void());
+  MOCK_METHOD1(setSocketOptions, void(SocketOptionsConstSharedPtr options));
+  MOCK_METHOD1(setAlternateAddresses,
+               void(const std::vector<Address::InstanceConstSharedPtr>& addresses));
 };
 
 class MockActiveDnsQuery : public ActiveDnsQuery {
@@ -232,5 +249,14 @@ public:
   MOCK_METHOD0(closeListeners, void());
 };
 
+class MockBalancedConnectionHandler : public BalancedConnectionHandler {
+public:
+  MockBalancedConnectionHandler();
+  ~MockBalancedConnectionHandler();
+
+  MOCK_METHOD0(numConnections, uint64_t());
+  MOCK_METHOD3(post, void(int fd, const sockaddr* remote_addr, int remote_addr_len));
+};
+
 } // Network
 } // Envoy
@@ -83,6 +83,13 @@ public:
 
   MOCK_METHOD3(makeRequest, PoolRequest*(const std::string& hash_key, const RespValue& request,
                                          PoolCallbacks& callbacks));
+  MOCK_METHOD3(makeReadRequest, PoolRequest*(const std::string& hash_key,
+                                             const RespValue& request, PoolCallbacks& callbacks));
+  MOCK_METHOD1(chooseHost, Upstream::HostConstSharedPtr(const std::string& hash_key));
+  MOCK_METHOD1(slot, uint32_t(const std::string& hash_key));
+  MOCK_METHOD3(makeRequestToHost,
+               PoolRequest*(const Upstream::HostConstSharedPtr& host, const RespValue& request,
+                            PoolCallbacks& callbacks));
 };
 
 } // ConnPool
@@ -38,6 +38,9 @@ MockRateLimitPolicy::MockRateLimitPolicy() {
 
 MockRateLimitPolicy::~MockRateLimitPolicy() {}
 
+MockShadowStream::MockShadowStream() {}
+MockShadowStream::~MockShadowStream() {}
+
 MockShadowWriter::MockShadowWriter() {}
 MockShadowWriter::~MockShadowWriter() {}
 
@@ -53,7 +56,9 @@ MockHashPolicy::~MockHashPolicy() {}
 
 MockRouteEntry::MockRouteEntry() {
   ON_CALL(*this, clusterName()).WillByDefault(ReturnRef(cluster_name_));
+  ON_CALL(*this, clusterId()).WillByDefault(ReturnRef(cluster_id_));
   ON_CALL(*this, opaqueConfig()).WillByDefault(ReturnRef(opaque_config_));
+  ON_CALL(*this, metadataMatchCriteria()).WillByDefault(ReturnRef(metadata_match_criteria_));
   ON_CALL(*this, rateLimitPolicy()).WillByDefault(ReturnRef(rate_limit_policy_));
   ON_CALL(*this, retryPolicy()).WillByDefault(ReturnRef(retry_policy_));
   ON_CALL(*this, shadowPolicy()).WillByDefault(ReturnRef(shadow_policy_));
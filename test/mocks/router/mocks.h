@@ -12,6 +12,8 @@
 #include "envoy/router/router_ratelimit.h"
 #include "envoy/router/shadow_writer.h"
 
+#include "common/http/codes.h"
+
 #include "gmock/gmock.h"
 
 namespace Envoy {
@@ -32,10 +34,12 @@ public:
   std::chrono::milliseconds perTryTimeout() const override { return per_try_timeout_; }
   uint32_t numRetries() const override { return num_retries_; }
   uint32_t retryOn() const override { return retry_on_; }
+  std::chrono::milliseconds hedgeDelay() const override { return hedge_delay_; }
 
   std::chrono::milliseconds per_try_timeout_{0};
   uint32_t num_retries_{};
   uint32_t retry_on_{};
+  std::chrono::milliseconds hedge_delay_{0};
 };
 
 class MockRetryState : public RetryState {
@@ -49,6 +53,7 @@ public:
   MOCK_METHOD3(shouldRetry, bool(const Http::HeaderMap* response_headers,
                                  const Optional<Http::StreamResetReason>& reset_reason,
                                  DoRetryCallback callback));
+  MOCK_METHOD0(shouldHedge, bool());
 
   DoRetryCallback callback_;
 };
@@ -95,6 +100,17 @@ public:
   std::string runtime_key_;
 };
 
+class MockShadowStream : public ShadowStream {
+public:
+  MockShadowStream();
+  ~MockShadowStream();
+
+  // Router::ShadowStream
+  MOCK_METHOD2(sendData, void(const Buffer::Instance& data, bool end_stream));
+  MOCK_METHOD1(sendTrailers, void(const Http::HeaderMap& trailers));
+  MOCK_METHOD0(cancel, void());
+};
+
 class MockShadowWriter : public ShadowWriter {
 public:
   MockShadowWriter();
@@ -106,8 +122,16 @@ public:
     shadow_(cluster, request, timeout);
   }
 
+  ShadowStream* streamShadow(const std::string& cluster, Http::HeaderMapPtr&& headers,
+                             bool end_stream, std::chrono::milliseconds timeout) override {
+    return streamShadow_(cluster, *headers, end_stream, timeout);
+  }
+
   MOCK_METHOD3(shadow_, void(const std::string& cluster, Http::MessagePtr& request,
                              std::chrono::milliseconds timeout));
+  MOCK_METHOD4(streamShadow_,
+               ShadowStream*(const std::string& cluster, Http::HeaderMap& headers, bool end_stream,
+                             std::chrono::milliseconds timeout));
 };
 
 class TestVirtualCluster : public VirtualCluster {
@@ -115,9 +139,11 @@ public:
   // Router::VirtualCluster
   const std::string& name() const override { return name_; }
   Upstream::ResourcePriority priority() const override { return priority_; }
+  Http::CodeStats& codeStats() const override { return code_stats_; }
 
   std::string name_{"fake_virtual_cluster"};
   Upstream::ResourcePriority priority_{Upstream::ResourcePriority::Default};
+  mutable Http::CodeStatsImpl code_stats_{"vhost.fake_vhost.vcluster.fake_virtual_cluster."};
 };
 
 class MockVirtualHost : public VirtualHost {
@@ -149,6 +175,7 @@ public:
 
   // Router::Config
   MOCK_CONST_METHOD0(clusterName, const std::string&());
+  MOCK_CONST_METHOD0(clusterId, const Optional<Upstream::ClusterId>&());
   MOCK_CONST_METHOD1(finalizeRequestHeaders, void(Http::HeaderMap& headers));
   MOCK_CONST_METHOD0(hashPolicy, const HashPolicy*());
   MOCK_CONST_METHOD0(priority, Upstream::ResourcePriority());
@@ -162,9 +189,12 @@ public:
   MOCK_CONST_METHOD0(autoHostRewrite, bool());
   MOCK_CONST_METHOD0(opaqueConfig, const std::multimap<std::string, std::string>&());
   MOCK_CONST_METHOD0(includeVirtualHostRateLimits, bool());
+  MOCK_CONST_METHOD0(metadataMatchCriteria, const Upstream::HostMetadata&());
 
   std::string cluster_name_{"fake_cluster"};
+  Optional<Upstream::ClusterId> cluster_id_;
   std::multimap<std::string, std::string> opaque_config_;
+  Upstream::HostMetadata metadata_match_criteria_;
   TestVirtualCluster virtual_cluster_;
   TestRetryPolicy retry_policy_;
   testing::NiceMock<MockRateLimitPolicy> rate_limit_policy_;
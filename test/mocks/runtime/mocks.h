@@ -21,6 +21,10 @@ public:
   MockSnapshot();
   ~MockSnapshot();
 
+  // Calls with a registered key are answered by the mocks below, by key name.
+  using Snapshot::featureEnabled;
+  using Snapshot::getInteger;
+
   MOCK_CONST_METHOD2(featureEnabled, bool(const std::string& key, uint64_t default_value));
   MOCK_CONST_METHOD3(featureEnabled,
                      bool(const std::string& key, uint64_t default_value, uint64_t random_value));
@@ -28,6 +32,7 @@ public:
                                           uint64_t random_value, uint16_t num_buckets));
   MOCK_CONST_METHOD1(get, const std::string&(const std::string& key));
   MOCK_CONST_METHOD2(getInteger, uint64_t(const std::string& key, uint64_t default_value));
+  MOCK_CONST_METHOD0(generation, uint64_t());
 };
 
 class MockLoader : public Loader {
@@ -1,12 +1,14 @@
 #include "mocks.h"
 
 #include <string>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
 namespace Envoy {
 using testing::_;
+using testing::Invoke;
 using testing::Return;
 using testing::ReturnNew;
 using testing::ReturnRef;
@@ -18,6 +20,8 @@ MockOptions::MockOptions(const std::string& config_path)
     : config_path_(config_path), admin_address_path_("") {
   ON_CALL(*this, configPath()).WillByDefault(ReturnRef(config_path_));
   ON_CALL(*this, adminAddressPath()).WillByDefault(ReturnRef(admin_address_path_));
+  ON_CALL(*this, workerCpus()).WillByDefault(ReturnRef(cpus_));
+  ON_CALL(*this, mainThreadCpus()).WillByDefault(ReturnRef(cpus_));
 }
 MockOptions::~MockOptions() {}
 
@@ -27,7 +31,17 @@ MockAdmin::~MockAdmin() {}
 MockDrainManager::MockDrainManager() {}
 MockDrainManager::~MockDrainManager() {}
 
-MockHotRestart::MockHotRestart() {}
+MockOverloadManager::MockOverloadManager() {
+  ON_CALL(*this, getActionState(_)).WillByDefault(ReturnRef(action_state_));
+}
+MockOverloadManager::~MockOverloadManager() {}
+
+MockHotRestart::MockHotRestart() {
+  ON_CALL(*this, duplicateParentListenSockets(_))
+      .WillByDefault(Invoke([](const std::vector<std::string>& addresses) -> std::vector<int> {
+        return std::vector<int>(addresses.size(), -1);
+      }));
+}
 MockHotRestart::~MockHotRestart() {}
 
 MockInstance::MockInstance() : ssl_context_manager_(runtime_loader_) {
@@ -46,8 +60,10 @@ MockInstance::MockInstance() : ssl_context_manager_(runtime_loader_) {
   ON_CALL(*this, random()).WillByDefault(ReturnRef(random_));
   ON_CALL(*this, localInfo()).WillByDefault(ReturnRef(local_info_));
   ON_CALL(*this, options()).WillByDefault(ReturnRef(options_));
+  ON_CALL(*this, overloadManager()).WillByDefault(ReturnRef(overload_manager_));
   ON_CALL(*this, drainManager()).WillByDefault(ReturnRef(drain_manager_));
   ON_CALL(*this, initManager()).WillByDefault(ReturnRef(init_manager_));
+  ON_CALL(*this, startupPhaseTimes()).WillByDefault(ReturnRef(startup_phase_times_));
 }
 
 MockInstance::~MockInstance() {}
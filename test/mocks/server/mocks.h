@@ -4,12 +4,14 @@
 #include <cstdint>
 #include <list>
 #include <string>
+#include <vector>
 
 #include "envoy/server/admin.h"
 #include "envoy/server/configuration.h"
 #include "envoy/server/drain_manager.h"
 #include "envoy/server/instance.h"
 #include "envoy/server/options.h"
+#include "envoy/server/overload_manager.h"
 #include "envoy/ssl/context_manager.h"
 
 #include "common/ssl/context_manager_impl.h"
@@ -55,9 +57,15 @@ public:
   MOCK_METHOD0(restartEpoch, uint64_t());
   MOCK_METHOD0(fileFlushIntervalMsec, std::chrono::milliseconds());
   MOCK_CONST_METHOD0(mode, Mode());
+  MOCK_METHOD0(maxStats, uint64_t());
+  MOCK_METHOD0(workerCpus, const std::vector<uint32_t>&());
+  MOCK_METHOD0(mainThreadCpus, const std::vector<uint32_t>&());
+  MOCK_METHOD0(memoryAccounting, bool());
+  MOCK_METHOD0(asyncLogLines, uint32_t());
 
   std::string config_path_;
   std::string admin_address_path_;
+  std::vector<uint32_t> cpus_;
 };
 
 class MockAdmin : public Admin {
@@ -83,6 +91,21 @@ public:
   MOCK_METHOD0(startParentShutdownSequence, void());
 };
 
+class MockOverloadManager : public OverloadManager {
+public:
+  MockOverloadManager();
+  ~MockOverloadManager();
+
+  // Server::OverloadManager
+  MOCK_METHOD0(start, void());
+  MOCK_METHOD1(getActionState, const OverloadActionState&(OverloadActionName action));
+  MOCK_METHOD0(reducedBufferLimitBytes, uint32_t());
+  MOCK_METHOD3(registerForAction, void(OverloadActionName action, Event::Dispatcher& dispatcher,
+                                       ActionCb cb));
+
+  OverloadActionState action_state_;
+};
+
 class MockHotRestart : public HotRestart {
 public:
   MockHotRestart();
@@ -90,8 +113,10 @@ public:
 
   // Server::HotRestart
   MOCK_METHOD0(drainParentListeners, void());
-  MOCK_METHOD1(duplicateParentListenSocket, int(const std::string& address));
+  MOCK_METHOD1(duplicateParentListenSockets,
+               std::vector<int>(const std::vector<std::string>& addresses));
   MOCK_METHOD1(getParentStats, void(GetParentStatsInfo& info));
+  MOCK_METHOD1(mergeParentHistograms, void(Stats::StoreRoot& store));
   MOCK_METHOD2(initialize, void(Event::Dispatcher& dispatcher, Server::Instance& server));
   MOCK_METHOD1(shutdownParentAdmin, void(ShutdownParentAdminInfo& info));
   MOCK_METHOD0(terminateParent, void());
@@ -126,7 +151,9 @@ public:
   MOCK_METHOD0(healthCheckFailed, bool());
   MOCK_METHOD0(hotRestart, HotRestart&());
   MOCK_METHOD0(initManager, Init::Manager&());
+  MOCK_METHOD0(numConnections, uint64_t());
   MOCK_METHOD0(options, Options&());
+  MOCK_METHOD0(overloadManager, OverloadManager&());
   MOCK_METHOD0(random, Runtime::RandomGenerator&());
   MOCK_METHOD0(rateLimitClient_, RateLimit::Client*());
   MOCK_METHOD0(runtime, Runtime::Loader&());
@@ -134,6 +161,7 @@ public:
   MOCK_METHOD0(shutdownAdmin, void());
   MOCK_METHOD0(startTimeCurrentEpoch, time_t());
   MOCK_METHOD0(startTimeFirstEpoch, time_t());
+  MOCK_METHOD0(startupPhaseTimes, const StartupPhaseTimes&());
   MOCK_METHOD0(stats, Stats::Store&());
   MOCK_METHOD0(httpTracer, Tracing::HttpTracer&());
   MOCK_METHOD0(threadLocal, ThreadLocal::Instance&());
@@ -155,9 +183,11 @@ public:
   testing::NiceMock<AccessLog::MockAccessLogManager> access_log_manager_;
   testing::NiceMock<MockHotRestart> hot_restart_;
   testing::NiceMock<MockOptions> options_;
+  testing::NiceMock<MockOverloadManager> overload_manager_;
   testing::NiceMock<Runtime::MockRandomGenerator> random_;
   testing::NiceMock<LocalInfo::MockLocalInfo> local_info_;
   testing::NiceMock<Init::MockManager> init_manager_;
+  StartupPhaseTimes startup_phase_times_;
 };
 
 namespace Configuration {
@@ -173,11 +203,13 @@ public:
   MOCK_METHOD0(statsdTcpClusterName, Optional<std::string>());
   MOCK_METHOD0(statsdUdpPort, Optional<uint32_t>());
   MOCK_METHOD0(statsdUdpIpAddress, Optional<std::string>());
+  MOCK_METHOD0(statsdUdpMaxDatagramSize, uint32_t());
   MOCK_METHOD0(statsFlushInterval, std::chrono::milliseconds());
   MOCK_CONST_METHOD0(wdMissTimeout, std::chrono::milliseconds());
   MOCK_CONST_METHOD0(wdMegaMissTimeout, std::chrono::milliseconds());
   MOCK_CONST_METHOD0(wdKillTimeout, std::chrono::milliseconds());
   MOCK_CONST_METHOD0(wdMultiKillTimeout, std::chrono::milliseconds());
+  MOCK_CONST_METHOD0(wdStallSamples, uint32_t());
 
   std::chrono::milliseconds wd_miss_;
   std::chrono::milliseconds wd_megamiss_;
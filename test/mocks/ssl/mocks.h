@@ -31,6 +31,7 @@ public:
   MOCK_METHOD2(createSslServerContext_, ServerContext*(Stats::Scope& stats, ContextConfig& config));
   MOCK_METHOD0(daysUntilFirstCertExpires, size_t());
   MOCK_METHOD1(iterateContexts, void(std::function<void(Context&)> callback));
+  MOCK_METHOD0(reloadServerContexts, void());
 };
 
 class MockConnection : public Connection {
@@ -4,16 +4,33 @@
 #include "gtest/gtest.h"
 
 namespace Envoy {
+using testing::ReturnPointee;
+using testing::ReturnRef;
 using testing::_;
 
 namespace Stats {
 
-MockCounter::MockCounter() {}
+MockCounter::MockCounter() {
+  ON_CALL(*this, name()).WillByDefault(ReturnPointee(&name_));
+  ON_CALL(*this, tagExtractedName()).WillByDefault(ReturnRef(name_));
+  ON_CALL(*this, tags()).WillByDefault(ReturnRef(tags_));
+}
 MockCounter::~MockCounter() {}
 
-MockGauge::MockGauge() {}
+MockGauge::MockGauge() {
+  ON_CALL(*this, name()).WillByDefault(ReturnPointee(&name_));
+  ON_CALL(*this, tagExtractedName()).WillByDefault(ReturnRef(name_));
+  ON_CALL(*this, tags()).WillByDefault(ReturnRef(tags_));
+}
 MockGauge::~MockGauge() {}
 
+MockHistogram::MockHistogram() {
+  ON_CALL(*this, name()).WillByDefault(ReturnPointee(&name_));
+  ON_CALL(*this, tagExtractedName()).WillByDefault(ReturnRef(name_));
+  ON_CALL(*this, tags()).WillByDefault(ReturnRef(tags_));
+}
+MockHistogram::~MockHistogram() {}
+
 MockTimespan::MockTimespan() {}
 MockTimespan::~MockTimespan() {}
 
@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <list>
 #include <string>
+#include <vector>
 
 #include "envoy/stats/stats.h"
 #include "envoy/thread_local/thread_local.h"
@@ -23,10 +24,15 @@ public:
   MOCK_METHOD1(add, void(uint64_t amount));
   MOCK_METHOD0(inc, void());
   MOCK_METHOD0(latch, uint64_t());
-  MOCK_METHOD0(name, std::string());
+  MOCK_CONST_METHOD0(name, std::string());
+  MOCK_CONST_METHOD0(tagExtractedName, const std::string&());
+  MOCK_CONST_METHOD0(tags, const std::vector<Tag>&());
   MOCK_METHOD0(reset, void());
   MOCK_METHOD0(used, bool());
   MOCK_METHOD0(value, uint64_t());
+
+  std::string name_;
+  std::vector<Tag> tags_;
 };
 
 class MockGauge : public Gauge {
@@ -37,11 +43,32 @@ public:
   MOCK_METHOD1(add, void(uint64_t amount));
   MOCK_METHOD0(dec, void());
   MOCK_METHOD0(inc, void());
-  MOCK_METHOD0(name, std::string());
+  MOCK_CONST_METHOD0(name, std::string());
+  MOCK_CONST_METHOD0(tagExtractedName, const std::string&());
+  MOCK_CONST_METHOD0(tags, const std::vector<Tag>&());
   MOCK_METHOD1(set, void(uint64_t value));
   MOCK_METHOD1(sub, void(uint64_t amount));
   MOCK_METHOD0(used, bool());
   MOCK_METHOD0(value, uint64_t());
+
+  std::string name_;
+  std::vector<Tag> tags_;
+};
+
+class MockHistogram : public Histogram {
+public:
+  MockHistogram();
+  ~MockHistogram();
+
+  MOCK_METHOD0(merge, void());
+  MOCK_CONST_METHOD0(intervalStatistics, const HistogramStatistics&());
+  MOCK_CONST_METHOD0(cumulativeStatistics, const HistogramStatistics&());
+  MOCK_CONST_METHOD0(name, std::string());
+  MOCK_CONST_METHOD0(tagExtractedName, const std::string&());
+  MOCK_CONST_METHOD0(tags, const std::vector<Tag>&());
+
+  std::string name_;
+  std::vector<Tag> tags_;
 };
 
 class MockTimespan : public Timespan {
@@ -58,10 +85,12 @@ public:
   MockSink();
   ~MockSink();
 
-  MOCK_METHOD2(flushCounter, void(const std::string& name, uint64_t delta));
-  MOCK_METHOD2(flushGauge, void(const std::string& name, uint64_t value));
-  MOCK_METHOD2(onHistogramComplete, void(const std::string& name, uint64_t value));
-  MOCK_METHOD2(onTimespanComplete, void(const std::string& name, std::chrono::milliseconds ms));
+  MOCK_METHOD0(beginFlush, void());
+  MOCK_METHOD2(flushCounter, void(const Counter& counter, uint64_t delta));
+  MOCK_METHOD2(flushGauge, void(const Gauge& gauge, uint64_t value));
+  MOCK_METHOD2(flushHistogram,
+               void(const Histogram& histogram, const HistogramStatistics& statistics));
+  MOCK_METHOD0(endFlush, void());
 };
 
 class MockStore : public Store {
@@ -78,6 +107,7 @@ public:
   MOCK_METHOD1(createScope_, Scope*(const std::string& name));
   MOCK_METHOD1(gauge, Gauge&(const std::string&));
   MOCK_CONST_METHOD0(gauges, std::list<GaugeSharedPtr>());
+  MOCK_CONST_METHOD0(histograms, std::list<HistogramSharedPtr>());
   MOCK_METHOD1(timer, Timer&(const std::string& name));
 
   testing::NiceMock<MockCounter> counter_;
@@ -85,13 +115,15 @@ public:
 
 /**
  * With IsolatedStoreImpl it's hard to test timing stats.
- * MockIsolatedStatsStore mocks only deliverTimingToSinks for better testing.
+ * MockIsolatedStatsStore mocks only deliverHistogramToSinks and deliverTimingToSinks for better
+ * testing.
  */
 class MockIsolatedStatsStore : public IsolatedStoreImpl {
 public:
   MockIsolatedStatsStore();
   ~MockIsolatedStatsStore();
 
+  MOCK_METHOD2(deliverHistogramToSinks, void(const std::string&, uint64_t));
   MOCK_METHOD2(deliverTimingToSinks, void(const std::string&, std::chrono::milliseconds));
 };
 
@@ -3,11 +3,17 @@
 #include <chrono>
 #include <cstdint>
 #include <memory>
+#include <set>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "envoy/upstream/cluster_manager.h"
 #include "envoy/upstream/upstream.h"
 
+#include "common/grpc/method_stats_impl.h"
+#include "common/http/codes.h"
+
 #include "test/mocks/runtime/mocks.h"
 #include "test/mocks/stats/mocks.h"
 
@@ -19,6 +25,21 @@ using testing::NiceMock;
 
 namespace Upstream {
 
+class MockLbSubsetInfo : public LbSubsetInfo {
+public:
+  MockLbSubsetInfo();
+  ~MockLbSubsetInfo();
+
+  // Upstream::LbSubsetInfo
+  MOCK_CONST_METHOD0(isEnabled, bool());
+  MOCK_CONST_METHOD0(fallbackPolicy, FallbackPolicy());
+  MOCK_CONST_METHOD0(subsetKeys, const std::vector<std::set<std::string>>&());
+
+  bool enabled_{};
+  FallbackPolicy fallback_policy_{FallbackPolicy::AnyEndpoint};
+  std::vector<std::set<std::string>> subset_keys_;
+};
+
 class MockClusterInfo : public ClusterInfo {
 public:
   MockClusterInfo();
@@ -29,23 +50,49 @@ public:
   MOCK_CONST_METHOD0(perConnectionBufferLimitBytes, uint32_t());
   MOCK_CONST_METHOD0(features, uint64_t());
   MOCK_CONST_METHOD0(http2Settings, const Http::Http2Settings&());
+  MOCK_CONST_METHOD0(http1PipelineDepth, uint32_t());
   MOCK_CONST_METHOD0(lbType, LoadBalancerType());
+  MOCK_CONST_METHOD0(lbSubsetInfo, const LbSubsetInfo&());
+  MOCK_CONST_METHOD0(ringHashFunction, RingHashFunction());
+  MOCK_CONST_METHOD0(hostCleanupInterval, std::chrono::milliseconds());
+  MOCK_CONST_METHOD0(dnsLookupFamily, Network::DnsLookupFamily());
+  MOCK_CONST_METHOD0(localityWeights, const std::unordered_map<std::string, uint32_t>&());
   MOCK_CONST_METHOD0(maintenanceMode, bool());
   MOCK_CONST_METHOD0(maxRequestsPerConnection, uint64_t());
+  MOCK_CONST_METHOD0(maxRequestsPerConnectionJitterPercent, uint32_t());
+  MOCK_CONST_METHOD0(idleTimeout, const Optional<std::chrono::milliseconds>&());
   MOCK_CONST_METHOD0(name, const std::string&());
+  MOCK_CONST_METHOD0(prefetchRatio, double());
+  MOCK_CONST_METHOD0(connPoolSharingKey, const std::string&());
   MOCK_CONST_METHOD1(resourceManager, ResourceManager&(ResourcePriority priority));
   MOCK_CONST_METHOD0(sslContext, Ssl::ClientContext*());
+  MOCK_CONST_METHOD0(socketOptions, const Network::SocketOptionsConstSharedPtr&());
   MOCK_CONST_METHOD0(stats, ClusterStats&());
   MOCK_CONST_METHOD0(statsScope, Stats::Scope&());
+  MOCK_CONST_METHOD0(codeStats, Http::CodeStats&());
+  MOCK_CONST_METHOD0(grpcMethodStats, Grpc::MethodStatsTable&());
 
   std::string name_{"fake_cluster"};
   Http::Http2Settings http2_settings_{};
+  uint32_t http1_pipeline_depth_{1};
   uint64_t max_requests_per_connection_{};
+  uint32_t max_requests_per_connection_jitter_percent_{};
+  Optional<std::chrono::milliseconds> idle_timeout_;
+  double prefetch_ratio_{1.0};
+  std::string conn_pool_sharing_key_;
+  Network::SocketOptionsConstSharedPtr socket_options_;
   NiceMock<Stats::MockIsolatedStatsStore> stats_store_;
   ClusterStats stats_;
+  Http::CodeStatsImpl code_stats_{""};
+  Grpc::MethodStatsTableImpl grpc_method_stats_;
   NiceMock<Runtime::MockLoader> runtime_;
   std::unique_ptr<Upstream::ResourceManager> resource_manager_;
   LoadBalancerType lb_type_{LoadBalancerType::RoundRobin};
+  NiceMock<MockLbSubsetInfo> lb_subset_;
+  RingHashFunction ring_hash_function_{RingHashFunction::StdHash};
+  std::chrono::milliseconds host_cleanup_interval_{5000};
+  Network::DnsLookupFamily dns_lookup_family_{Network::DnsLookupFamily::V4Only};
+  std::unordered_map<std::string, uint32_t> locality_weights_;
 };
 
 } // Upstream
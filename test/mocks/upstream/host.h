@@ -29,6 +29,8 @@ public:
   MOCK_METHOD0(lastUnejectionTime, const Optional<MonotonicTime>&());
   MOCK_CONST_METHOD0(successRate, double());
   MOCK_METHOD1(successRate, void(double new_success_rate));
+  MOCK_CONST_METHOD0(responseTimeEwma, double());
+  MOCK_CONST_METHOD0(responseTimeP99, double());
 };
 
 class MockEventLogger : public EventLogger {
@@ -55,6 +57,7 @@ public:
   MOCK_METHOD1(addChangedStateCb, void(ChangeStateCb cb));
   MOCK_CONST_METHOD0(successRateAverage, double());
   MOCK_CONST_METHOD0(successRateEjectionThreshold, double());
+  MOCK_CONST_METHOD0(latencyEjectionThreshold, double());
 
   std::list<ChangeStateCb> callbacks_;
 };
@@ -67,15 +70,19 @@ public:
   ~MockHostDescription();
 
   MOCK_CONST_METHOD0(address, Network::Address::InstanceConstSharedPtr());
+  MOCK_CONST_METHOD0(addressList, std::vector<Network::Address::InstanceConstSharedPtr>());
   MOCK_CONST_METHOD0(canary, bool());
   MOCK_CONST_METHOD0(cluster, const ClusterInfo&());
   MOCK_CONST_METHOD0(outlierDetector, Outlier::DetectorHostSink&());
   MOCK_CONST_METHOD0(hostname, const std::string&());
+  MOCK_CONST_METHOD0(metadata, const HostMetadata&());
+  MOCK_CONST_METHOD0(priority, uint32_t());
   MOCK_CONST_METHOD0(stats, HostStats&());
   MOCK_CONST_METHOD0(zone, const std::string&());
 
   std::string hostname_;
   Network::Address::InstanceConstSharedPtr address_;
+  HostMetadata metadata_;
   testing::NiceMock<Outlier::MockDetectorHostSink> outlier_detector_;
   testing::NiceMock<MockClusterInfo> cluster_;
   Stats::IsolatedStoreImpl stats_store_;
@@ -101,18 +108,24 @@ public:
     setOutlierDetector_(outlier_detector);
   }
 
+  MOCK_CONST_METHOD0(activeRequests, uint64_t());
   MOCK_CONST_METHOD0(address, Network::Address::InstanceConstSharedPtr());
+  MOCK_CONST_METHOD0(addressList, std::vector<Network::Address::InstanceConstSharedPtr>());
   MOCK_CONST_METHOD0(canary, bool());
   MOCK_CONST_METHOD0(cluster, const ClusterInfo&());
   MOCK_CONST_METHOD0(counters, std::list<Stats::CounterSharedPtr>());
   MOCK_CONST_METHOD1(createConnection_, MockCreateConnectionData(Event::Dispatcher& dispatcher));
+  MOCK_CONST_METHOD0(decActiveRequests, void());
   MOCK_CONST_METHOD0(gauges, std::list<Stats::GaugeSharedPtr>());
   MOCK_METHOD1(healthFlagClear, void(HealthFlag flag));
   MOCK_CONST_METHOD1(healthFlagGet, bool(HealthFlag flag));
   MOCK_METHOD1(healthFlagSet, void(HealthFlag flag));
   MOCK_CONST_METHOD0(healthy, bool());
   MOCK_CONST_METHOD0(hostname, const std::string&());
+  MOCK_CONST_METHOD0(incActiveRequests, void());
+  MOCK_CONST_METHOD0(metadata, const HostMetadata&());
   MOCK_CONST_METHOD0(outlierDetector, Outlier::DetectorHostSink&());
+  MOCK_CONST_METHOD0(priority, uint32_t());
   MOCK_METHOD1(setOutlierDetector_, void(Outlier::DetectorHostSinkPtr& outlier_detector));
   MOCK_CONST_METHOD0(stats, HostStats&());
   MOCK_CONST_METHOD0(weight, uint32_t());
@@ -120,6 +133,7 @@ public:
   MOCK_CONST_METHOD0(zone, const std::string&());
 
   testing::NiceMock<MockClusterInfo> cluster_;
+  HostMetadata metadata_;
   Stats::IsolatedStoreImpl stats_store_;
   HostStats stats_{ALL_HOST_STATS(POOL_COUNTER(stats_store_), POOL_GAUGE(stats_store_))};
 };
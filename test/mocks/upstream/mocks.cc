@@ -41,15 +41,19 @@ MockHostDescription::MockHostDescription()
     : address_(Network::Utility::resolveUrl("tcp://10.0.0.1:443")) {
   ON_CALL(*this, hostname()).WillByDefault(ReturnRef(hostname_));
   ON_CALL(*this, address()).WillByDefault(Return(address_));
+  ON_CALL(*this, addressList())
+      .WillByDefault(Return(std::vector<Network::Address::InstanceConstSharedPtr>{address_}));
   ON_CALL(*this, outlierDetector()).WillByDefault(ReturnRef(outlier_detector_));
   ON_CALL(*this, stats()).WillByDefault(ReturnRef(stats_));
   ON_CALL(*this, cluster()).WillByDefault(ReturnRef(cluster_));
+  ON_CALL(*this, metadata()).WillByDefault(ReturnRef(metadata_));
 }
 
 MockHostDescription::~MockHostDescription() {}
 
 MockHost::MockHost() {
   ON_CALL(*this, cluster()).WillByDefault(ReturnRef(cluster_));
+  ON_CALL(*this, metadata()).WillByDefault(ReturnRef(metadata_));
   ON_CALL(*this, stats()).WillByDefault(ReturnRef(stats_));
 }
 
@@ -62,18 +66,40 @@ MockClusterInfo::MockClusterInfo()
   ON_CALL(*this, connectTimeout()).WillByDefault(Return(std::chrono::milliseconds(1)));
   ON_CALL(*this, name()).WillByDefault(ReturnRef(name_));
   ON_CALL(*this, http2Settings()).WillByDefault(ReturnRef(http2_settings_));
+  ON_CALL(*this, http1PipelineDepth()).WillByDefault(ReturnPointee(&http1_pipeline_depth_));
   ON_CALL(*this, maxRequestsPerConnection())
       .WillByDefault(ReturnPointee(&max_requests_per_connection_));
+  ON_CALL(*this, maxRequestsPerConnectionJitterPercent())
+      .WillByDefault(ReturnPointee(&max_requests_per_connection_jitter_percent_));
+  ON_CALL(*this, idleTimeout()).WillByDefault(ReturnRef(idle_timeout_));
+  ON_CALL(*this, prefetchRatio()).WillByDefault(ReturnPointee(&prefetch_ratio_));
+  ON_CALL(*this, connPoolSharingKey()).WillByDefault(ReturnRef(conn_pool_sharing_key_));
+  ON_CALL(*this, socketOptions()).WillByDefault(ReturnRef(socket_options_));
   ON_CALL(*this, stats()).WillByDefault(ReturnRef(stats_));
   ON_CALL(*this, statsScope()).WillByDefault(ReturnRef(stats_store_));
+  ON_CALL(*this, codeStats()).WillByDefault(ReturnRef(code_stats_));
+  ON_CALL(*this, grpcMethodStats()).WillByDefault(ReturnRef(grpc_method_stats_));
   ON_CALL(*this, resourceManager(_))
       .WillByDefault(Invoke([this](ResourcePriority)
                                 -> Upstream::ResourceManager& { return *resource_manager_; }));
   ON_CALL(*this, lbType()).WillByDefault(ReturnPointee(&lb_type_));
+  ON_CALL(*this, lbSubsetInfo()).WillByDefault(ReturnRef(lb_subset_));
+  ON_CALL(*this, ringHashFunction()).WillByDefault(ReturnPointee(&ring_hash_function_));
+  ON_CALL(*this, hostCleanupInterval()).WillByDefault(ReturnPointee(&host_cleanup_interval_));
+  ON_CALL(*this, dnsLookupFamily()).WillByDefault(ReturnPointee(&dns_lookup_family_));
+  ON_CALL(*this, localityWeights()).WillByDefault(ReturnRef(locality_weights_));
 }
 
 MockClusterInfo::~MockClusterInfo() {}
 
+MockLbSubsetInfo::MockLbSubsetInfo() {
+  ON_CALL(*this, isEnabled()).WillByDefault(ReturnPointee(&enabled_));
+  ON_CALL(*this, fallbackPolicy()).WillByDefault(ReturnPointee(&fallback_policy_));
+  ON_CALL(*this, subsetKeys()).WillByDefault(ReturnRef(subset_keys_));
+}
+
+MockLbSubsetInfo::~MockLbSubsetInfo() {}
+
 MockCluster::MockCluster() {
   ON_CALL(*this, addMemberUpdateCb(_))
       .WillByDefault(Invoke([this](MemberUpdateCb cb) -> void { callbacks_.push_back(cb); }));
@@ -81,6 +107,20 @@ MockCluster::MockCluster() {
   ON_CALL(*this, healthyHosts()).WillByDefault(ReturnRef(healthy_hosts_));
   ON_CALL(*this, hostsPerZone()).WillByDefault(ReturnRef(hosts_per_zone_));
   ON_CALL(*this, healthyHostsPerZone()).WillByDefault(ReturnRef(healthy_hosts_per_zone_));
+  ON_CALL(*this, hostsPtr()).WillByDefault(Invoke([this]() -> HostVectorConstSharedPtr {
+    return std::make_shared<const std::vector<HostSharedPtr>>(hosts_);
+  }));
+  ON_CALL(*this, healthyHostsPtr()).WillByDefault(Invoke([this]() -> HostVectorConstSharedPtr {
+    return std::make_shared<const std::vector<HostSharedPtr>>(healthy_hosts_);
+  }));
+  ON_CALL(*this, hostsPerZonePtr()).WillByDefault(Invoke([this]() -> HostListsConstSharedPtr {
+    return std::make_shared<const std::vector<std::vector<HostSharedPtr>>>(hosts_per_zone_);
+  }));
+  ON_CALL(*this, healthyHostsPerZonePtr())
+      .WillByDefault(Invoke([this]() -> HostListsConstSharedPtr {
+        return std::make_shared<const std::vector<std::vector<HostSharedPtr>>>(
+            healthy_hosts_per_zone_);
+      }));
   ON_CALL(*this, info()).WillByDefault(Return(info_));
   ON_CALL(*this, setInitializedCb(_))
       .WillByDefault(Invoke([this](std::function<void()> callback) -> void {
@@ -103,14 +143,19 @@ MockThreadLocalCluster::MockThreadLocalCluster() {
 
 MockThreadLocalCluster::~MockThreadLocalCluster() {}
 
+MockClusterDiscoveryRequest::MockClusterDiscoveryRequest() {}
+MockClusterDiscoveryRequest::~MockClusterDiscoveryRequest() {}
+
 MockClusterManager::MockClusterManager() {
   ON_CALL(*this, httpConnPoolForCluster(_, _, _)).WillByDefault(Return(&conn_pool_));
+  ON_CALL(thread_local_cluster_, connPool(_, _)).WillByDefault(Return(&conn_pool_));
   ON_CALL(*this, httpAsyncClientForCluster(_)).WillByDefault(ReturnRef(async_client_));
   ON_CALL(*this, httpAsyncClientForCluster(_)).WillByDefault((ReturnRef(async_client_)));
 
   // Matches are LIFO so "" will match first.
   ON_CALL(*this, get(_)).WillByDefault(Return(&thread_local_cluster_));
   ON_CALL(*this, get("")).WillByDefault(Return(nullptr));
+  ON_CALL(*this, getById(_)).WillByDefault(Return(&thread_local_cluster_));
 }
 
 MockClusterManager::~MockClusterManager() {}
@@ -42,6 +42,10 @@ public:
   MOCK_CONST_METHOD0(healthyHosts, const std::vector<HostSharedPtr>&());
   MOCK_CONST_METHOD0(hostsPerZone, const std::vector<std::vector<HostSharedPtr>>&());
   MOCK_CONST_METHOD0(healthyHostsPerZone, const std::vector<std::vector<HostSharedPtr>>&());
+  MOCK_CONST_METHOD0(hostsPtr, HostVectorConstSharedPtr());
+  MOCK_CONST_METHOD0(healthyHostsPtr, HostVectorConstSharedPtr());
+  MOCK_CONST_METHOD0(hostsPerZonePtr, HostListsConstSharedPtr());
+  MOCK_CONST_METHOD0(healthyHostsPerZonePtr, HostListsConstSharedPtr());
 
   // Upstream::Cluster
   MOCK_CONST_METHOD0(info, ClusterInfoConstSharedPtr());
@@ -79,17 +83,29 @@ public:
   MOCK_METHOD0(hostSet, const HostSet&());
   MOCK_METHOD0(info, ClusterInfoConstSharedPtr());
   MOCK_METHOD0(loadBalancer, LoadBalancer&());
+  MOCK_METHOD2(connPool, Http::ConnectionPool::Instance*(ResourcePriority priority,
+                                                         LoadBalancerContext* context));
 
   NiceMock<MockCluster> cluster_;
   NiceMock<MockLoadBalancer> lb_;
 };
 
+class MockClusterDiscoveryRequest : public ClusterDiscoveryRequest {
+public:
+  MockClusterDiscoveryRequest();
+  ~MockClusterDiscoveryRequest();
+
+  // Upstream::ClusterDiscoveryRequest
+  MOCK_METHOD0(cancel, void());
+};
+
 class MockClusterManager : public ClusterManager {
 public:
   MockClusterManager();
   ~MockClusterManager();
 
-  Host::CreateConnectionData tcpConnForCluster(const std::string& cluster) override {
+  Host::CreateConnectionData tcpConnForCluster(const std::string& cluster,
+                                               LoadBalancerContext*) override {
     MockHost::MockCreateConnectionData data = tcpConnForCluster_(cluster);
     return {Network::ClientConnectionPtr{data.connection_}, data.host_};
   }
@@ -99,6 +115,8 @@ public:
   MOCK_METHOD1(setInitializedCb, void(std::function<void()>));
   MOCK_METHOD0(clusters, ClusterInfoMap());
   MOCK_METHOD1(get, ThreadLocalCluster*(const std::string& cluster));
+  MOCK_METHOD1(clusterId, ClusterId(const std::string& cluster));
+  MOCK_METHOD1(getById, ThreadLocalCluster*(ClusterId id));
   MOCK_METHOD3(httpConnPoolForCluster,
                Http::ConnectionPool::Instance*(const std::string& cluster,
                                                ResourcePriority priority,
@@ -106,6 +124,8 @@ public:
   MOCK_METHOD1(tcpConnForCluster_, MockHost::MockCreateConnectionData(const std::string& cluster));
   MOCK_METHOD1(httpAsyncClientForCluster, Http::AsyncClient&(const std::string& cluster));
   MOCK_METHOD1(removePrimaryCluster, bool(const std::string& cluster));
+  MOCK_METHOD2(discoverCluster, ClusterDiscoveryRequest*(const std::string& cluster,
+                                                         ClusterDiscoveryCb callback));
   MOCK_METHOD0(shutdown, void());
 
   NiceMock<Http::ConnectionPool::MockInstance> conn_pool_;
@@ -137,6 +157,9 @@ public:
 
   MOCK_METHOD0(initialize, void());
   MOCK_METHOD1(setInitializedCb, void(std::function<void()> callback));
+  MOCK_METHOD1(requestCluster, bool(const std::string& cluster));
+  MOCK_METHOD1(setClusterRequestCompleteCb,
+               void(std::function<void(const std::string& cluster)> callback));
 
   std::function<void()> initialized_callback_;
 };
@@ -1,10 +1,14 @@
 #include <string>
 
+#include "server/config/http/adaptive_concurrency.h"
 #include "server/config/http/buffer.h"
+#include "server/config/http/cache.h"
+#include "server/config/http/dynamic_forward_proxy.h"
 #include "server/config/http/dynamo.h"
 #include "server/config/http/fault.h"
 #include "server/config/http/grpc_http1_bridge.h"
 #include "server/config/http/grpc_web.h"
+#include "server/config/http/gzip.h"
 #include "server/config/http/ip_tagging.h"
 #include "server/config/http/lightstep_http_tracer.h"
 #include "server/config/http/ratelimit.h"
@@ -26,6 +30,27 @@ using testing::Return;
 namespace Server {
 namespace Configuration {
 
+TEST(HttpFilterConfigTest, AdaptiveConcurrencyFilter) {
+  std::string json_string = R"EOF(
+  {
+    "initial_concurrency_limit" : 50,
+    "max_concurrency_limit" : 500
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json_string);
+  NiceMock<MockInstance> server;
+  AdaptiveConcurrencyFilterConfig factory;
+  HttpFilterFactoryCb cb =
+      factory.createFilterFactory(HttpFilterType::Both, *json_config, "stats", server);
+  Http::MockFilterChainFactoryCallbacks filter_callback;
+  EXPECT_CALL(filter_callback, addStreamFilter(_));
+  cb(filter_callback);
+
+  EXPECT_THROW(factory.createFilterFactory(HttpFilterType::Decoder, *json_config, "stats", server),
+               EnvoyException);
+}
+
 TEST(HttpFilterConfigTest, BufferFilter) {
   std::string json_string = R"EOF(
   {
@@ -44,6 +69,49 @@ TEST(HttpFilterConfigTest, BufferFilter) {
   cb(filter_callback);
 }
 
+TEST(HttpFilterConfigTest, CacheFilter) {
+  std::string json_string = R"EOF(
+  {
+    "max_size_bytes" : 1048576,
+    "max_entry_bytes" : 65536
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json_string);
+  NiceMock<MockInstance> server;
+  CacheFilterConfig factory;
+  HttpFilterFactoryCb cb =
+      factory.createFilterFactory(HttpFilterType::Both, *json_config, "stats", server);
+  Http::MockFilterChainFactoryCallbacks filter_callback;
+  EXPECT_CALL(filter_callback, addStreamFilter(_));
+  cb(filter_callback);
+
+  EXPECT_THROW(factory.createFilterFactory(HttpFilterType::Decoder, *json_config, "stats", server),
+               EnvoyException);
+}
+
+TEST(HttpFilterConfigTest, GzipFilter) {
+  std::string json_string = R"EOF(
+  {
+    "compression_level" : 6,
+    "min_content_length" : 100,
+    "content_types" : ["text/html", "application/json"]
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json_string);
+  NiceMock<MockInstance> server;
+  GzipFilterConfig factory;
+  HttpFilterFactoryCb cb =
+      factory.createFilterFactory(HttpFilterType::Both, *json_config, "stats", server);
+  Http::MockFilterChainFactoryCallbacks filter_callback;
+  EXPECT_CALL(filter_callback, addStreamFilter(_));
+  cb(filter_callback);
+
+  EXPECT_THROW(factory.createFilterFactory(HttpFilterType::Encoder, *json_config, "stats", server),
+               EnvoyException);
+}
+
 TEST(HttpFilterConfigTest, BadBufferFilterConfig) {
   std::string json_string = R"EOF(
   {
@@ -112,6 +180,37 @@ TEST(HttpFilterConfigTest, GrpcHttp1BridgeFilter) {
   cb(filter_callback);
 }
 
+TEST(HttpFilterConfigTest, GrpcHttp1BridgeFilterStreaming) {
+  std::string json_string = R"EOF(
+  {
+    "mode": "streaming"
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json_string);
+  NiceMock<MockInstance> server;
+  GrpcHttp1BridgeFilterConfig factory;
+  HttpFilterFactoryCb cb =
+      factory.createFilterFactory(HttpFilterType::Both, *json_config, "stats", server);
+  Http::MockFilterChainFactoryCallbacks filter_callback;
+  EXPECT_CALL(filter_callback, addStreamFilter(_));
+  cb(filter_callback);
+}
+
+TEST(HttpFilterConfigTest, BadGrpcHttp1BridgeFilterConfig) {
+  std::string json_string = R"EOF(
+  {
+    "mode": "chunked"
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json_string);
+  NiceMock<MockInstance> server;
+  GrpcHttp1BridgeFilterConfig factory;
+  EXPECT_THROW(factory.createFilterFactory(HttpFilterType::Both, *json_config, "stats", server),
+               Json::Exception);
+}
+
 TEST(HttpFilterConfigTest, GrpcWebFilter) {
   std::string json_string = R"EOF(
   {
@@ -179,6 +278,25 @@ TEST(HttpFilterConfigTest, RouterFilter) {
   cb(filter_callback);
 }
 
+TEST(HttpFilterConfigTest, RouterFilterRequestCoalescing) {
+  std::string json_string = R"EOF(
+  {
+    "request_coalescing" : {
+      "vary_headers" : ["accept-encoding"]
+    }
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json_string);
+  NiceMock<MockInstance> server;
+  RouterFilterConfig factory;
+  HttpFilterFactoryCb cb =
+      factory.createFilterFactory(HttpFilterType::Decoder, *json_config, "stats", server);
+  Http::MockFilterChainFactoryCallbacks filter_callback;
+  EXPECT_CALL(filter_callback, addStreamDecoderFilter(_));
+  cb(filter_callback);
+}
+
 TEST(HttpFilterConfigTest, BadRouterFilterConfig) {
   std::string json_string = R"EOF(
   {
@@ -200,7 +318,7 @@ TEST(HttpFilterConfigTest, IpTaggingFilter) {
     "request_type" : "internal",
     "ip_tags" : [
       { "ip_tag_name" : "example_tag",
-        "ip_list" : ["0.0.0.0"]
+        "ip_list" : ["0.0.0.0/0"]
       }
     ]
   }
@@ -234,6 +352,20 @@ TEST(HttpFilterConfigTest, BadIpTaggingFilterConfig) {
                Json::Exception);
 }
 
+TEST(HttpFilterConfigTest, DynamicForwardProxyFilter) {
+  Json::ObjectSharedPtr json_config = Json::Factory::loadFromString("{}");
+  NiceMock<MockInstance> server;
+  DynamicForwardProxyFilterConfig factory;
+  HttpFilterFactoryCb cb =
+      factory.createFilterFactory(HttpFilterType::Decoder, *json_config, "stats", server);
+  Http::MockFilterChainFactoryCallbacks filter_callback;
+  EXPECT_CALL(filter_callback, addStreamDecoderFilter(_));
+  cb(filter_callback);
+
+  EXPECT_THROW(factory.createFilterFactory(HttpFilterType::Both, *json_config, "stats", server),
+               EnvoyException);
+}
+
 TEST(HttpFilterConfigTest, DoubleRegistrationTest) {
   EXPECT_THROW_WITH_MESSAGE(
       RegisterNamedHttpFilterConfigFactory<RouterFilterConfig>(), EnvoyException,
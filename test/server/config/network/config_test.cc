@@ -7,6 +7,7 @@
 #include "server/config/network/mongo_proxy.h"
 #include "server/config/network/ratelimit.h"
 #include "server/config/network/redis_proxy.h"
+#include "server/config/network/tap.h"
 #include "server/config/network/tcp_proxy.h"
 
 #include "test/mocks/server/mocks.h"
@@ -47,7 +48,8 @@ TEST(NetworkFilterConfigTest, MongoProxy) {
   std::string json_string = R"EOF(
   {
     "stat_prefix": "my_stat_prefix",
-    "access_log" : "path/to/access/log"
+    "access_log" : "path/to/access/log",
+    "access_log_max_pending" : 100
   }
   )EOF";
 
@@ -77,6 +79,46 @@ TEST(NetworkFilterConfigTest, BadMongoProxyConfig) {
                Json::Exception);
 }
 
+TEST(NetworkFilterConfigTest, Tap) {
+  std::string json_string = R"EOF(
+  {
+    "stat_prefix": "my_stat_prefix",
+    "path" : "path/to/trace",
+    "sample_percent" : 10,
+    "max_connection_bytes" : 4096
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json_string);
+  NiceMock<MockInstance> server;
+  TapFilterConfigFactory factory;
+  EXPECT_CALL(server.access_log_manager_, createAccessLog("path/to/trace"));
+  NetworkFilterFactoryCb cb =
+      factory.createFilterFactory(NetworkFilterType::Both, *json_config, server);
+  Network::MockConnection connection;
+  EXPECT_CALL(connection, addFilter(_));
+  cb(connection);
+
+  EXPECT_THROW(factory.createFilterFactory(NetworkFilterType::Read, *json_config, server),
+               EnvoyException);
+}
+
+TEST(NetworkFilterConfigTest, BadTapConfig) {
+  std::string json_string = R"EOF(
+  {
+    "stat_prefix": "my_stat_prefix",
+    "path" : "path/to/trace",
+    "sample_percent" : 101
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr json_config = Json::Factory::loadFromString(json_string);
+  NiceMock<MockInstance> server;
+  TapFilterConfigFactory factory;
+  EXPECT_THROW(factory.createFilterFactory(NetworkFilterType::Both, *json_config, server),
+               Json::Exception);
+}
+
 TEST(NetworkFilterConfigTest, TcpProxy) {
   std::string json_string = R"EOF(
   {
@@ -338,9 +380,11 @@ public:
       return nullptr;
     }
 
-    return [&server, stat_prefix](Http::FilterChainFactoryCallbacks& callbacks) -> void {
-      callbacks.addStreamFilter(Http::StreamFilterSharedPtr{
-          new Dynamo::DynamoFilter(server.runtime(), stat_prefix, server.stats())});
+    Dynamo::DynamoStatsSharedPtr stats =
+        std::make_shared<Dynamo::DynamoStats>(stat_prefix, server.stats(), server.threadLocal());
+    return [&server, stats](Http::FilterChainFactoryCallbacks& callbacks) -> void {
+      callbacks.addStreamFilter(
+          Http::StreamFilterSharedPtr{new Dynamo::DynamoFilter(server.runtime(), stats)});
     };
   }
 };
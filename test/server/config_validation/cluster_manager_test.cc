@@ -45,7 +45,7 @@ TEST(ValidationClusterManagerTest, MockedMethods) {
       factory.clusterManagerFromJson(*config, stats, tls, runtime, random, local_info, log_manager);
   EXPECT_EQ(nullptr,
             cluster_manager->httpConnPoolForCluster("cluster", ResourcePriority::Default, nullptr));
-  Host::CreateConnectionData data = cluster_manager->tcpConnForCluster("cluster");
+  Host::CreateConnectionData data = cluster_manager->tcpConnForCluster("cluster", nullptr);
   EXPECT_EQ(nullptr, data.connection_);
   EXPECT_EQ(nullptr, data.host_description_);
 
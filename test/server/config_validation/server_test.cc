@@ -1,3 +1,5 @@
+#include <string>
+
 #include "server/config_validation/server.h"
 
 #include "test/integration/server.h"
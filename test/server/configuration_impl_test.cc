@@ -3,6 +3,8 @@
 #include <string>
 
 #include "common/filter/echo.h"
+#include "common/json/config_schemas.h"
+#include "common/json/json_loader.h"
 
 #include "server/configuration_impl.h"
 
@@ -165,6 +167,136 @@ TEST_F(ConfigurationImplTest, SetListenerPerConnectionBufferLimit) {
   EXPECT_EQ(8192U, config.listeners().back()->perConnectionBufferLimitBytes());
 }
 
+TEST_F(ConfigurationImplTest, ListenerFilterChains) {
+  std::string json = R"EOF(
+  {
+    "listeners" : [
+      {
+        "address": "tcp://127.0.0.1:1234",
+        "filter_chains": [
+          {
+            "filter_chain_match": {"server_names": ["www.example.com"]},
+            "filters": []
+          },
+          {
+            "filter_chain_match": {
+              "destination_ip_ranges": ["10.0.0.0/8"],
+              "application_protocols": ["h2"]
+            },
+            "filters": []
+          }
+        ]
+      }
+    ],
+    "cluster_manager": {
+      "clusters": []
+    }
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr loader = Json::Factory::loadFromString(json);
+
+  MainImpl config(server_, cluster_manager_factory_);
+  config.initialize(*loader);
+
+  Listener& listener = *config.listeners().back();
+  EXPECT_TRUE(listener.inspectTlsClientHello());
+
+  Network::Address::InstanceConstSharedPtr local_address =
+      Network::Utility::resolveUrl("tcp://127.0.0.1:1234");
+  Network::MockConnection connection;
+  EXPECT_CALL(connection, localAddress()).WillRepeatedly(ReturnRef(*local_address));
+
+  connection.requested_server_name_ = "www.example.com";
+  EXPECT_CALL(connection, initializeReadFilters()).WillOnce(Return(true));
+  EXPECT_TRUE(listener.filterChainFactory().createFilterChain(connection));
+
+  connection.requested_server_name_ = "other.example.com";
+  EXPECT_CALL(connection, initializeReadFilters()).Times(0);
+  EXPECT_FALSE(listener.filterChainFactory().createFilterChain(connection));
+  EXPECT_EQ(1U, server_.stats_store_.counter("listener.127.0.0.1_1234.no_filter_chain_match")
+                    .value());
+}
+
+TEST_F(ConfigurationImplTest, ListenerFiltersAndFilterChains) {
+  std::string json = R"EOF(
+  {
+    "listeners" : [
+      {
+        "address": "tcp://127.0.0.1:1234",
+        "filters": [],
+        "filter_chains": [{"filters": []}]
+      }
+    ],
+    "cluster_manager": {
+      "clusters": []
+    }
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr loader = Json::Factory::loadFromString(json);
+
+  MainImpl config(server_, cluster_manager_factory_);
+  EXPECT_THROW_WITH_MESSAGE(
+      config.initialize(*loader), EnvoyException,
+      "listener 127.0.0.1:1234: exactly one of filters or filter_chains must be specified");
+}
+
+TEST_F(ConfigurationImplTest, ListenerReusePort) {
+  std::string json = R"EOF(
+  {
+    "listeners" : [
+      {
+        "address": "tcp://127.0.0.1:1234",
+        "filters": []
+      },
+      {
+        "address": "tcp://127.0.0.1:1235",
+        "filters": [],
+        "reuse_port": true,
+        "reuse_port_cpu_steering": true
+      }
+    ],
+    "cluster_manager": {
+      "clusters": []
+    }
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr loader = Json::Factory::loadFromString(json);
+
+  MainImpl config(server_, cluster_manager_factory_);
+  config.initialize(*loader);
+
+  EXPECT_FALSE(config.listeners().front()->reusePort());
+  EXPECT_FALSE(config.listeners().front()->reusePortCpuSteering());
+  EXPECT_TRUE(config.listeners().back()->reusePort());
+  EXPECT_TRUE(config.listeners().back()->reusePortCpuSteering());
+}
+
+TEST_F(ConfigurationImplTest, ListenerCpuSteeringWithoutReusePort) {
+  std::string json = R"EOF(
+  {
+    "listeners" : [
+      {
+        "address": "tcp://127.0.0.1:1234",
+        "filters": [],
+        "reuse_port_cpu_steering": true
+      }
+    ],
+    "cluster_manager": {
+      "clusters": []
+    }
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr loader = Json::Factory::loadFromString(json);
+
+  MainImpl config(server_, cluster_manager_factory_);
+  EXPECT_THROW_WITH_MESSAGE(config.initialize(*loader), EnvoyException,
+                            "listener 127.0.0.1:1234: reuse_port_cpu_steering requires reuse_port");
+}
+
 TEST_F(ConfigurationImplTest, VerifySubjectAltNameConfig) {
   std::string json = R"EOF(
   {
@@ -479,6 +611,121 @@ TEST_F(ConfigurationImplTest, DeprecatedFilterConfigFactoryRegistrationTest) {
   MainImpl config(server_, cluster_manager_factory_);
   config.initialize(*loader);
 }
+
+TEST(InitialImplTest, ContinuousProfiling) {
+  std::string json = R"EOF(
+  {
+    "admin": {
+      "access_log_path": "/dev/null",
+      "address": "tcp://127.0.0.1:0",
+      "profile_frequency_hz": 10,
+      "profile_window_ms": 30000
+    },
+    "listeners": [],
+    "cluster_manager": {"clusters": []}
+  }
+  )EOF";
+
+  InitialImpl config(*Json::Factory::loadFromString(json));
+  EXPECT_EQ(10U, config.admin().profileFrequencyHz());
+  EXPECT_EQ(std::chrono::milliseconds(30000), config.admin().profileWindow());
+}
+
+TEST(InitialImplTest, StatsTags) {
+  std::string json = R"EOF(
+  {
+    "admin": {"access_log_path": "/dev/null", "address": "tcp://127.0.0.1:0"},
+    "listeners": [],
+    "cluster_manager": {"clusters": []},
+    "stats_tags": [{"tag_name": "my.tag", "regex": "^my\\.((.+?)\\.)"}]
+  }
+  )EOF";
+
+  InitialImpl config(*Json::Factory::loadFromString(json));
+  Stats::TagProducerPtr producer = config.createTagProducer();
+  std::vector<Stats::Tag> tags;
+  EXPECT_EQ("my.upstream_rq", producer->produceTags("my.foo.upstream_rq_200", tags));
+  ASSERT_EQ(2UL, tags.size());
+  EXPECT_EQ("envoy.response_code", tags[0].name_);
+  EXPECT_EQ("200", tags[0].value_);
+  EXPECT_EQ("my.tag", tags[1].name_);
+  EXPECT_EQ("foo", tags[1].value_);
+}
+
+TEST(InitialImplTest, StatsTagsWithoutDefaults) {
+  std::string json = R"EOF(
+  {
+    "admin": {"access_log_path": "/dev/null", "address": "tcp://127.0.0.1:0"},
+    "listeners": [],
+    "cluster_manager": {"clusters": []},
+    "use_all_default_tags": false
+  }
+  )EOF";
+
+  InitialImpl config(*Json::Factory::loadFromString(json));
+  std::vector<Stats::Tag> tags;
+  EXPECT_EQ("cluster.foo.upstream_rq_200",
+            config.createTagProducer()->produceTags("cluster.foo.upstream_rq_200", tags));
+  EXPECT_TRUE(tags.empty());
+}
+
+TEST(InitialImplTest, BadStatsTag) {
+  std::string json = R"EOF(
+  {
+    "admin": {"access_log_path": "/dev/null", "address": "tcp://127.0.0.1:0"},
+    "listeners": [],
+    "cluster_manager": {"clusters": []},
+    "stats_tags": [{"tag_name": "my.tag", "regex": "^my\\."}]
+  }
+  )EOF";
+
+  InitialImpl config(*Json::Factory::loadFromString(json));
+  EXPECT_THROW_WITH_MESSAGE(config.createTagProducer(), EnvoyException,
+                            "regex '^my\\.' for tag 'my.tag' has no capture group");
+}
+
+TEST_F(ConfigurationImplTest, ValidateSchemas) {
+  std::string clusters;
+  for (int i = 0; i < 50; i++) {
+    if (!clusters.empty()) {
+      clusters += ",";
+    }
+    // Clusters 10 and 30 have an unknown type, and so do not conform to the schema.
+    clusters += fmt::format(R"EOF(
+      {{"name": "cluster_{}", "connect_timeout_ms": 250, "type": "{}", "lb_type": "round_robin",
+        "hosts": [{{"url": "tcp://127.0.0.1:80"}}]}})EOF",
+                            i, (i == 10 || i == 30) ? "bogus" : "static");
+  }
+  const std::string json = fmt::format(R"EOF(
+  {{
+    "listeners": [],
+    "cluster_manager": {{"clusters": [{}]}}
+  }}
+  )EOF",
+                                       clusters);
+
+  // The first invalid cluster in config order is reported, whichever thread validates it.
+  std::string expected_error;
+  try {
+    Json::Factory::loadFromString(json)
+        ->getObject("cluster_manager")
+        ->getObjectArray("clusters")[10]
+        ->validateSchema(Json::Schema::CLUSTER_SCHEMA);
+  } catch (const Json::Exception& e) {
+    expected_error = e.what();
+  }
+  EXPECT_NE("", expected_error);
+
+  for (uint32_t concurrency : {0, 1, 4, 64}) {
+    EXPECT_THROW_WITH_MESSAGE(
+        MainImpl::validateSchemas(*Json::Factory::loadFromString(json), concurrency),
+        Json::Exception, expected_error);
+  }
+
+  // Structural errors are left to the top level schema.
+  MainImpl::validateSchemas(*Json::Factory::loadFromString("{\"listeners\": 1}"), 4);
+}
+
 } // Configuration
 } // Server
 } // Envoy
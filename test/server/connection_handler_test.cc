@@ -18,6 +18,7 @@ using testing::InSequence;
 using testing::Invoke;
 using testing::NiceMock;
 using testing::Return;
+using testing::ReturnRef;
 
 class ConnectionHandlerTest : public testing::Test, protected Logger::Loggable<Logger::Id::main> {};
 
@@ -28,7 +29,7 @@ TEST_F(ConnectionHandlerTest, CloseDuringFilterChainCreate) {
   Api::MockApi* api = new Api::MockApi();
   Event::MockDispatcher* dispatcher = new NiceMock<Event::MockDispatcher>();
   EXPECT_CALL(*api, allocateDispatcher_()).WillOnce(Return(dispatcher));
-  Server::ConnectionHandlerImpl handler(log(), Api::ApiPtr{api});
+  Server::ConnectionHandlerImpl handler(log(), Api::ApiPtr{api}, nullptr);
   Network::MockFilterChainFactory factory;
   Network::MockConnectionHandler connection_handler;
   NiceMock<Network::MockListenSocket> socket;
@@ -61,7 +62,7 @@ TEST_F(ConnectionHandlerTest, CloseConnectionOnEmptyFilterChain) {
   Api::MockApi* api = new Api::MockApi();
   Event::MockDispatcher* dispatcher = new NiceMock<Event::MockDispatcher>();
   EXPECT_CALL(*api, allocateDispatcher_()).WillOnce(Return(dispatcher));
-  Server::ConnectionHandlerImpl handler(log(), Api::ApiPtr{api});
+  Server::ConnectionHandlerImpl handler(log(), Api::ApiPtr{api}, nullptr);
   Network::MockFilterChainFactory factory;
   Network::MockConnectionHandler connection_handler;
   NiceMock<Network::MockListenSocket> socket;
@@ -91,7 +92,7 @@ TEST_F(ConnectionHandlerTest, FindListenerByAddress) {
   Api::MockApi* api = new Api::MockApi();
   Event::MockDispatcher* dispatcher = new NiceMock<Event::MockDispatcher>();
   EXPECT_CALL(*api, allocateDispatcher_()).WillOnce(Return(dispatcher));
-  Server::ConnectionHandlerImpl handler(log(), Api::ApiPtr{api});
+  Server::ConnectionHandlerImpl handler(log(), Api::ApiPtr{api}, nullptr);
   Network::MockFilterChainFactory factory;
   Network::MockConnectionHandler connection_handler;
   Network::MockListenSocket socket;
@@ -137,4 +138,112 @@ TEST_F(ConnectionHandlerTest, FindListenerByAddress) {
   EXPECT_EQ(listener2, handler.findListenerByAddress(ByRef(*alt_address2)));
   EXPECT_EQ(listener2, handler.findListenerByAddress(ByRef(*alt_address3)));
 }
+
+TEST_F(ConnectionHandlerTest, OverloadActions) {
+  Stats::IsolatedStoreImpl stats_store;
+  Api::MockApi* api = new Api::MockApi();
+  Event::MockDispatcher* dispatcher = new NiceMock<Event::MockDispatcher>();
+  EXPECT_CALL(*api, allocateDispatcher_()).WillOnce(Return(dispatcher));
+  NiceMock<Server::MockOverloadManager> overload_manager;
+  Server::OverloadActionState stop_accepting;
+  Server::OverloadActionState reduce_buffers;
+  ON_CALL(overload_manager,
+          getActionState(Server::OverloadActionName::StopAcceptingConnections))
+      .WillByDefault(ReturnRef(stop_accepting));
+  ON_CALL(overload_manager, getActionState(Server::OverloadActionName::ReduceBufferLimits))
+      .WillByDefault(ReturnRef(reduce_buffers));
+  ON_CALL(overload_manager, reducedBufferLimitBytes()).WillByDefault(Return(16384));
+  Server::ConnectionHandlerImpl handler(log(), Api::ApiPtr{api}, &overload_manager);
+  NiceMock<Network::MockFilterChainFactory> factory;
+  NiceMock<Network::MockListenSocket> socket;
+
+  Network::Listener* listener = new Network::MockListener();
+  Network::ListenerCallbacks* listener_callbacks;
+  EXPECT_CALL(*dispatcher, createListener_(_, _, _, _, _))
+      .WillOnce(Invoke([&](Network::ConnectionHandler&, Network::ListenSocket&,
+                           Network::ListenerCallbacks& cb, Stats::Scope&,
+                           const Network::ListenerOptions&) -> Network::Listener* {
+        listener_callbacks = &cb;
+        return listener;
+      }));
+  handler.addListener(factory, socket, stats_store,
+                      Network::ListenerOptions::listenerOptionsWithBindToPort());
+
+  // While connections are not accepted they are closed before any filter is created.
+  stop_accepting.setActive(true);
+  Network::MockConnection* connection = new NiceMock<Network::MockConnection>();
+  EXPECT_CALL(factory, createFilterChain(_)).Times(0);
+  EXPECT_CALL(*connection, close(Network::ConnectionCloseType::NoFlush));
+  listener_callbacks->onNewConnection(Network::ConnectionPtr{connection});
+  EXPECT_EQ(0UL, handler.numConnections());
+  EXPECT_EQ(1UL, stats_store.counter("downstream_cx_overload_reject").value());
+
+  // Reduced buffer limits only ever lower the limit of the listener.
+  stop_accepting.setActive(false);
+  reduce_buffers.setActive(true);
+  connection = new NiceMock<Network::MockConnection>();
+  EXPECT_CALL(factory, createFilterChain(_)).WillOnce(Return(true));
+  EXPECT_CALL(*connection, readBufferLimit()).WillOnce(Return(1024 * 1024));
+  EXPECT_CALL(*connection, setReadBufferLimit(16384));
+  listener_callbacks->onNewConnection(Network::ConnectionPtr{connection});
+
+  connection = new NiceMock<Network::MockConnection>();
+  EXPECT_CALL(factory, createFilterChain(_)).WillOnce(Return(true));
+  EXPECT_CALL(*connection, readBufferLimit()).WillOnce(Return(1024));
+  EXPECT_CALL(*connection, setReadBufferLimit(_)).Times(0);
+  listener_callbacks->onNewConnection(Network::ConnectionPtr{connection});
+  EXPECT_EQ(2UL, handler.numConnections());
+}
+
+TEST_F(ConnectionHandlerTest, ResetLargestConnections) {
+  Stats::IsolatedStoreImpl stats_store;
+  Api::MockApi* api = new Api::MockApi();
+  Event::MockDispatcher* dispatcher = new NiceMock<Event::MockDispatcher>();
+  EXPECT_CALL(*api, allocateDispatcher_()).WillOnce(Return(dispatcher));
+  NiceMock<Server::MockOverloadManager> overload_manager;
+  Server::OverloadManager::ActionCb reset_cb;
+  EXPECT_CALL(overload_manager,
+              registerForAction(Server::OverloadActionName::ResetLargestConnections, _, _))
+      .WillOnce(Invoke([&](Server::OverloadActionName, Event::Dispatcher&,
+                           Server::OverloadManager::ActionCb cb) -> void { reset_cb = cb; }));
+  Server::ConnectionHandlerImpl handler(log(), Api::ApiPtr{api}, &overload_manager);
+  NiceMock<Network::MockFilterChainFactory> factory;
+  ON_CALL(factory, createFilterChain(_)).WillByDefault(Return(true));
+  NiceMock<Network::MockListenSocket> socket;
+
+  Network::Listener* listener = new Network::MockListener();
+  Network::ListenerCallbacks* listener_callbacks;
+  EXPECT_CALL(*dispatcher, createListener_(_, _, _, _, _))
+      .WillOnce(Invoke([&](Network::ConnectionHandler&, Network::ListenSocket&,
+                           Network::ListenerCallbacks& cb, Stats::Scope&,
+                           const Network::ListenerOptions&) -> Network::Listener* {
+        listener_callbacks = &cb;
+        return listener;
+      }));
+  handler.addListener(factory, socket, stats_store,
+                      Network::ListenerOptions::listenerOptionsWithBindToPort());
+
+  // Each connection is given its own account which rolls up into the handler's.
+  std::vector<Network::MockConnection*> connections;
+  std::vector<Buffer::MemoryAccountSharedPtr> accounts;
+  for (uint64_t balance : {100, 2000, 300}) {
+    Network::MockConnection* connection = new NiceMock<Network::MockConnection>();
+    EXPECT_CALL(*connection, setBufferAccount(_))
+        .WillOnce(Invoke([&](Buffer::MemoryAccountSharedPtr account) -> void {
+          accounts.push_back(account);
+        }));
+    listener_callbacks->onNewConnection(Network::ConnectionPtr{connection});
+    accounts.back()->charge(balance);
+    connections.push_back(connection);
+  }
+  EXPECT_EQ(2400UL, handler.bufferedBytes());
+
+  // Only the largest connection is needed to shed a tenth of the buffered data.
+  EXPECT_CALL(*connections[1], close(Network::ConnectionCloseType::NoFlush));
+  EXPECT_CALL(*connections[0], close(_)).Times(0);
+  EXPECT_CALL(*connections[2], close(_)).Times(0);
+  reset_cb();
+  EXPECT_EQ(2UL, handler.numConnections());
+  EXPECT_EQ(1UL, stats_store.counter("downstream_cx_overload_reset").value());
+}
 } // Envoy
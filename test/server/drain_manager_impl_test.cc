@@ -2,6 +2,7 @@
 
 #include "server/drain_manager_impl.h"
 
+#include "test/mocks/common.h"
 #include "test/mocks/server/mocks.h"
 
 #include "gmock/gmock.h"
@@ -9,46 +10,116 @@
 
 namespace Envoy {
 using testing::_;
+using testing::NiceMock;
 using testing::Return;
+using testing::ReturnPointee;
 using testing::SaveArg;
 
 namespace Server {
 
-TEST(DrainManagerImplTest, All) {
-  NiceMock<MockInstance> server;
-  ON_CALL(server.options_, drainTime()).WillByDefault(Return(std::chrono::seconds(600)));
-  ON_CALL(server.options_, parentShutdownTime()).WillByDefault(Return(std::chrono::seconds(900)));
-  DrainManagerImpl drain_manager(server);
+class DrainManagerImplTest : public testing::Test {
+public:
+  DrainManagerImplTest() {
+    ON_CALL(server_.options_, drainTime()).WillByDefault(Return(std::chrono::seconds(600)));
+    ON_CALL(server_.options_, parentShutdownTime())
+        .WillByDefault(Return(std::chrono::seconds(900)));
+    ON_CALL(server_, healthCheckFailed()).WillByDefault(Return(false));
+    ON_CALL(time_source_, currentTime()).WillByDefault(ReturnPointee(&time_));
+  }
+
+  void advance(std::chrono::seconds seconds) { time_ += seconds; }
+
+  uint64_t drainClosed() { return server_.stats_store_.counter("server.drain_closed").value(); }
+
+  NiceMock<MockInstance> server_;
+  NiceMock<MockMonotonicTimeSource> time_source_;
+  MonotonicTime time_;
+};
+
+TEST_F(DrainManagerImplTest, All) {
+  DrainManagerImpl drain_manager(server_, time_source_);
 
   // Test parent shutdown.
-  Event::MockTimer* shutdown_timer = new Event::MockTimer(&server.dispatcher_);
+  Event::MockTimer* shutdown_timer = new Event::MockTimer(&server_.dispatcher_);
   EXPECT_CALL(*shutdown_timer, enableTimer(std::chrono::milliseconds(900000)));
   drain_manager.startParentShutdownSequence();
 
-  EXPECT_CALL(server.hot_restart_, terminateParent());
+  EXPECT_CALL(server_.hot_restart_, terminateParent());
   shutdown_timer->callback_();
 
   // Verify basic drain close.
-  EXPECT_CALL(server, healthCheckFailed()).WillOnce(Return(false));
+  EXPECT_CALL(server_, healthCheckFailed()).WillOnce(Return(false));
   EXPECT_FALSE(drain_manager.drainClose());
-  EXPECT_CALL(server, healthCheckFailed()).WillOnce(Return(true));
+  EXPECT_CALL(server_, healthCheckFailed()).WillOnce(Return(true));
+  EXPECT_TRUE(drain_manager.drainClose());
+
+  // Keepalive disabled by the overload manager drain closes as well.
+  server_.overload_manager_.action_state_.setActive(true);
+  EXPECT_CALL(server_, healthCheckFailed()).WillOnce(Return(false));
   EXPECT_TRUE(drain_manager.drainClose());
+  server_.overload_manager_.action_state_.setActive(false);
 
   // Test drain sequence.
-  Event::MockTimer* drain_timer = new Event::MockTimer(&server.dispatcher_);
+  EXPECT_FALSE(drain_manager.draining());
+  EXPECT_CALL(server_, numConnections()).WillRepeatedly(Return(0));
+  Event::MockTimer* drain_timer = new Event::MockTimer(&server_.dispatcher_);
   EXPECT_CALL(*drain_timer, enableTimer(_));
   drain_manager.startDrainSequence();
+  EXPECT_TRUE(drain_manager.draining());
 
   // 600s which is the default drain time.
-  for (size_t i = 0; i < 599; i++) {
-    if (i < 598) {
+  for (size_t i = 0; i < 600; i++) {
+    advance(std::chrono::seconds(1));
+    if (i < 599) {
       EXPECT_CALL(*drain_timer, enableTimer(_));
     }
     drain_timer->callback_();
   }
 
-  EXPECT_CALL(server, healthCheckFailed()).WillOnce(Return(false));
   EXPECT_TRUE(drain_manager.drainClose());
+  EXPECT_EQ(1UL, drainClosed());
+}
+
+TEST_F(DrainManagerImplTest, Pacing) {
+  DrainManagerImpl drain_manager(server_, time_source_);
+
+  // 1200 connections over 600s is 2 drain closes per second.
+  EXPECT_CALL(server_, numConnections()).WillOnce(Return(1200)).WillOnce(Return(1200));
+  Event::MockTimer* drain_timer = new Event::MockTimer(&server_.dispatcher_);
+  EXPECT_CALL(*drain_timer, enableTimer(_));
+  drain_manager.startDrainSequence();
+  EXPECT_EQ(1200UL, server_.stats_store_.gauge("server.drain_target").value());
+  EXPECT_EQ(1200UL, server_.stats_store_.gauge("server.drain_remaining").value());
+  EXPECT_FALSE(drain_manager.drainClose());
+
+  advance(std::chrono::seconds(1));
+  EXPECT_TRUE(drain_manager.drainClose());
+  EXPECT_TRUE(drain_manager.drainClose());
+  EXPECT_FALSE(drain_manager.drainClose());
+
+  // Allowance that went unused only carries over for a second.
+  advance(std::chrono::seconds(10));
+  EXPECT_TRUE(drain_manager.drainClose());
+  EXPECT_TRUE(drain_manager.drainClose());
+  EXPECT_FALSE(drain_manager.drainClose());
+  EXPECT_EQ(4UL, drainClosed());
+
+  EXPECT_CALL(server_, numConnections()).WillOnce(Return(1100));
+  EXPECT_CALL(*drain_timer, enableTimer(_));
+  drain_timer->callback_();
+  EXPECT_EQ(1100UL, server_.stats_store_.gauge("server.drain_remaining").value());
+
+  // Health check failure is not paced.
+  EXPECT_CALL(server_, healthCheckFailed()).WillOnce(Return(true));
+  EXPECT_TRUE(drain_manager.drainClose());
+  EXPECT_EQ(4UL, drainClosed());
+
+  // Once the drain time is over every connection is drain closed.
+  advance(std::chrono::seconds(600));
+  for (int i = 0; i < 10; i++) {
+    EXPECT_TRUE(drain_manager.drainClose());
+  }
+  EXPECT_EQ(14UL, drainClosed());
 }
 
 } // Server
@@ -0,0 +1,109 @@
+#include <string>
+#include <vector>
+
+#include "common/network/utility.h"
+
+#include "server/filter_chain_table.h"
+
+#include "test/test_common/utility.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Server {
+
+class FilterChainTableTest : public testing::Test {
+public:
+  Optional<size_t> find(const std::string& local_address, const std::string& server_name = "",
+                        const std::vector<std::string>& application_protocols = {}) {
+    return table_->find(*Network::Utility::resolveUrl(local_address), server_name,
+                        application_protocols);
+  }
+
+  std::unique_ptr<FilterChainTable> table_;
+};
+
+TEST_F(FilterChainTableTest, DestinationPort) {
+  table_.reset(new FilterChainTable({{{}, 8080, {}, {}}, {{}, 0, {}, {}}}));
+  EXPECT_FALSE(table_->needsClientHello());
+  EXPECT_EQ(0U, find("tcp://127.0.0.1:8080").value());
+  EXPECT_EQ(1U, find("tcp://127.0.0.1:8081").value());
+  EXPECT_EQ(1U, find("tcp://[::1]:8081").value());
+}
+
+TEST_F(FilterChainTableTest, DestinationIp) {
+  table_.reset(new FilterChainTable({{{"10.0.0.0/8"}, 0, {}, {}},
+                                     {{"10.1.0.0/16", "2001:db8::/32"}, 0, {}, {}},
+                                     {{}, 0, {}, {}}}));
+  EXPECT_EQ(0U, find("tcp://10.2.0.1:80").value());
+  EXPECT_EQ(1U, find("tcp://10.1.0.1:80").value());
+  EXPECT_EQ(1U, find("tcp://[2001:db8::1]:80").value());
+  EXPECT_EQ(2U, find("tcp://192.168.0.1:80").value());
+  EXPECT_EQ(2U, find("tcp://[::1]:80").value());
+}
+
+TEST_F(FilterChainTableTest, DestinationIpNoFallback) {
+  // A connection to a more specific port does not fall back to chains without a port.
+  table_.reset(new FilterChainTable({{{"10.0.0.0/8"}, 443, {}, {}}, {{}, 0, {}, {}}}));
+  EXPECT_EQ(0U, find("tcp://10.0.0.1:443").value());
+  EXPECT_FALSE(find("tcp://192.168.0.1:443").valid());
+  EXPECT_EQ(1U, find("tcp://192.168.0.1:80").value());
+}
+
+TEST_F(FilterChainTableTest, ServerName) {
+  table_.reset(new FilterChainTable({{{}, 0, {"www.example.com"}, {}},
+                                     {{}, 0, {"*.example.com"}, {}},
+                                     {{}, 0, {"*.b.example.com", "Other.com"}, {}},
+                                     {{}, 0, {}, {}}}));
+  EXPECT_TRUE(table_->needsClientHello());
+  EXPECT_EQ(0U, find("tcp://127.0.0.1:443", "www.example.com").value());
+  EXPECT_EQ(1U, find("tcp://127.0.0.1:443", "a.example.com").value());
+  EXPECT_EQ(1U, find("tcp://127.0.0.1:443", "a.www.example.com").value());
+  EXPECT_EQ(2U, find("tcp://127.0.0.1:443", "a.b.example.com").value());
+  EXPECT_EQ(2U, find("tcp://127.0.0.1:443", "other.com").value());
+  EXPECT_EQ(3U, find("tcp://127.0.0.1:443", "example.com").value());
+  EXPECT_EQ(3U, find("tcp://127.0.0.1:443").value());
+}
+
+TEST_F(FilterChainTableTest, ApplicationProtocols) {
+  table_.reset(new FilterChainTable(
+      {{{}, 0, {}, {"h2"}}, {{}, 0, {}, {"http/1.1", "http/1.0"}}, {{}, 0, {"api.com"}, {"h2"}}}));
+  EXPECT_EQ(0U, find("tcp://127.0.0.1:443", "", {"h2", "http/1.1"}).value());
+  EXPECT_EQ(1U, find("tcp://127.0.0.1:443", "", {"http/1.1", "h2"}).value());
+  EXPECT_EQ(2U, find("tcp://127.0.0.1:443", "api.com", {"h2"}).value());
+  EXPECT_FALSE(find("tcp://127.0.0.1:443", "api.com", {"http/1.1"}).valid());
+  EXPECT_FALSE(find("tcp://127.0.0.1:443", "", {"spdy/3"}).valid());
+  EXPECT_FALSE(find("tcp://127.0.0.1:443").valid());
+}
+
+TEST_F(FilterChainTableTest, Pipe) {
+  table_.reset(new FilterChainTable({{{"10.0.0.0/8"}, 0, {}, {}}, {{}, 0, {"a.com"}, {}}}));
+  EXPECT_EQ(1U, find("unix://foo", "a.com").value());
+  EXPECT_FALSE(find("unix://foo", "b.com").valid());
+}
+
+TEST_F(FilterChainTableTest, Duplicate) {
+  EXPECT_THROW_WITH_MESSAGE(
+      table_.reset(new FilterChainTable({{{}, 0, {}, {}}, {{}, 0, {}, {}}})), EnvoyException,
+      "multiple filter chains with the same filter_chain_match");
+  EXPECT_THROW_WITH_MESSAGE(table_.reset(new FilterChainTable(
+                                {{{"10.0.0.0/8"}, 0, {"a.com"}, {}},
+                                 {{"10.1.2.3/8"}, 0, {"A.com"}, {}}})),
+                            EnvoyException,
+                            "multiple filter chains with the same filter_chain_match");
+  EXPECT_THROW_WITH_MESSAGE(
+      table_.reset(new FilterChainTable({{{}, 0, {}, {"h2"}}, {{}, 0, {}, {"h2"}}})),
+      EnvoyException, "multiple filter chains with the same filter_chain_match");
+}
+
+TEST_F(FilterChainTableTest, Invalid) {
+  EXPECT_THROW_WITH_MESSAGE(
+      table_.reset(new FilterChainTable({{{"10.0.0.0/33"}, 0, {}, {}}})), EnvoyException,
+      "invalid destination ip range '10.0.0.0/33' in filter chain");
+  EXPECT_THROW_WITH_MESSAGE(
+      table_.reset(new FilterChainTable({{{}, 0, {"www.*.com"}, {}}})), EnvoyException,
+      "invalid server name 'www.*.com' in filter chain: only a leading '*.' wildcard is supported");
+}
+
+} // Server
+} // Envoy
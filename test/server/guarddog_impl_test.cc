@@ -4,6 +4,7 @@
 
 #include "envoy/common/time.h"
 
+#include "common/common/thread.h"
 #include "common/common/utility.h"
 #include "common/stats/stats_impl.h"
 
@@ -18,7 +19,9 @@
 
 namespace Envoy {
 using testing::InSequence;
+using testing::HasSubstr;
 using testing::NiceMock;
+using testing::Return;
 
 namespace Server {
 
@@ -189,6 +192,76 @@ TEST_F(GuardDogMissTest, MegaMissTest) {
   unpet_dog = nullptr;
 }
 
+TEST_F(GuardDogMissTest, EventLoopLagTest) {
+  // The loop interval is 500ms, so the watchdogs are touched every 250ms.
+  GuardDogImpl gd(stats_store_, config_miss_, time_source_);
+  EXPECT_EQ(0, gd.eventLoopLag().count());
+  auto pet_dog = gd.createWatchDog(0);
+  auto unpet_dog = gd.createWatchDog(1);
+  // Within the touch interval there is no lag:
+  mock_time_ += 200;
+  EXPECT_EQ(0, gd.eventLoopLag().count());
+  // Only the most delayed dog counts:
+  mock_time_ += 100;
+  pet_dog->touch();
+  EXPECT_EQ(50, gd.eventLoopLag().count());
+  gd.stopWatching(unpet_dog);
+  EXPECT_EQ(0, gd.eventLoopLag().count());
+  gd.stopWatching(pet_dog);
+  unpet_dog = nullptr;
+  pet_dog = nullptr;
+}
+
+TEST_F(GuardDogMissTest, StallSampleTest) {
+  ON_CALL(config_miss_, wdStallSamples()).WillByDefault(Return(2));
+  GuardDogImpl gd(stats_store_, config_miss_, time_source_);
+  EXPECT_EQ("", gd.stallReport());
+
+  // A real thread for the guard dog to sample, spinning as a stuck event loop would.
+  std::atomic<int32_t> thread_id(0);
+  std::atomic<bool> stop(false);
+  Thread::Thread thread([&]() -> void {
+    thread_id = Thread::Thread::currentThreadId();
+    while (!stop) {
+    }
+  });
+  while (thread_id == 0) {
+  }
+
+  auto unpet_dog = gd.createWatchDog(thread_id);
+  mock_time_ += 550;
+  gd.forceCheckForTest();
+  const std::string report = gd.stallReport();
+  EXPECT_THAT(report, HasSubstr(fmt::format("thread {} stalled for 550ms", thread_id.load())));
+  EXPECT_THAT(report, HasSubstr("  sample 0:\n    0x"));
+  EXPECT_THAT(report, HasSubstr("  sample 1:\n    0x"));
+
+  // The same stall is only sampled once.
+  mock_time_ += 100;
+  gd.forceCheckForTest();
+  EXPECT_EQ(report, gd.stallReport());
+
+  // A new stall is reported first.
+  unpet_dog->touch();
+  mock_time_ += 600;
+  gd.forceCheckForTest();
+  EXPECT_EQ(0, gd.stallReport().find(fmt::format("thread {} stalled for 600ms", thread_id.load())));
+  EXPECT_THAT(gd.stallReport(), HasSubstr(report));
+
+  gd.stopWatching(unpet_dog);
+  unpet_dog = nullptr;
+  stop = true;
+  thread.join();
+}
+
+TEST(GuardDogBasicTest, StallReportDisabledTest) {
+  NiceMock<Stats::MockStore> stats;
+  NiceMock<Configuration::MockMain> config(0, 0, 0, 0);
+  NiceMock<MockMonotonicTimeSource> time_source;
+  GuardDogImpl gd(stats, config, time_source);
+  EXPECT_EQ("stall sampling is disabled, see watchdog_stall_samples\n", gd.stallReport());
+}
+
 TEST(GuardDogBasicTest, StartStopTest) {
   NiceMock<Stats::MockStore> stats;
   NiceMock<Configuration::MockMain> config(0, 0, 0, 0);
@@ -1,11 +1,19 @@
+#include <algorithm>
 #include <fstream>
 
 #include "common/http/message_impl.h"
+#include "common/memory/accounting.h"
 #include "common/profiler/profiler.h"
+#include "common/stats/stats_impl.h"
+#include "common/stats/tag_extractor_impl.h"
+#include "common/stats/thread_local_store.h"
+#include "common/upstream/upstream_impl.h"
 
 #include "server/http/admin.h"
 
 #include "test/mocks/server/mocks.h"
+#include "test/mocks/ssl/mocks.h"
+#include "test/mocks/upstream/mocks.h"
 #include "test/test_common/environment.h"
 #include "test/test_common/network_utility.h"
 #include "test/test_common/printers.h"
@@ -16,7 +24,11 @@
 
 namespace Envoy {
 using testing::_;
+using testing::Invoke;
 using testing::NiceMock;
+using testing::Return;
+using testing::ReturnRef;
+using testing::Throw;
 
 namespace Server {
 
@@ -61,6 +73,123 @@ TEST_P(AdminFilterTest, Trailers) {
   filter_.decodeTrailers(request_headers_);
 }
 
+TEST_P(AdminFilterTest, StreamStats) {
+  for (uint32_t i = 0; i < StatsWriter::BatchSize + 1; i++) {
+    server_.stats_store_.counter(fmt::format("counter{}", i));
+  }
+
+  Event::MockTimer* timer = new Event::MockTimer(&callbacks_.dispatcher_);
+  request_headers_.insertPath().value(std::string("/stats?filter=^counter"));
+  EXPECT_CALL(callbacks_, encodeHeaders_(_, false)).WillOnce(Invoke([](Http::HeaderMap& headers, bool) {
+    EXPECT_STREQ("200", headers.Status()->value().c_str());
+  }));
+  EXPECT_CALL(callbacks_, encodeData(_, false));
+  EXPECT_CALL(*timer, enableTimer(std::chrono::milliseconds(0)));
+  filter_.decodeHeaders(request_headers_, true);
+
+  EXPECT_CALL(callbacks_, encodeData(_, true)).WillOnce(Invoke([](Buffer::Instance& data, bool) {
+    EXPECT_EQ("counter999: 0\n", TestUtility::bufferToString(data));
+  }));
+  timer->callback_();
+}
+
+TEST_P(AdminFilterTest, StreamStatsBadRequest) {
+  request_headers_.insertPath().value(std::string("/stats?filter=(("));
+  EXPECT_CALL(callbacks_, encodeHeaders_(_, false)).WillOnce(Invoke([](Http::HeaderMap& headers, bool) {
+    EXPECT_STREQ("400", headers.Status()->value().c_str());
+  }));
+  EXPECT_CALL(callbacks_, encodeData(_, true));
+  filter_.decodeHeaders(request_headers_, true);
+}
+
+TEST_P(AdminFilterTest, StreamClusters) {
+  NiceMock<Upstream::MockCluster> cluster;
+  for (uint32_t i = 0; i < ClustersWriter::BatchSize; i++) {
+    cluster.hosts_.emplace_back(new Upstream::HostImpl(
+        cluster.info_, "", Network::Utility::resolveUrl(fmt::format("tcp://10.0.0.{}:80", i)),
+        false, 1, ""));
+  }
+  Upstream::ClusterManager::ClusterInfoMap clusters{{"fake_cluster", cluster}};
+  ON_CALL(server_.cluster_manager_, clusters()).WillByDefault(Return(clusters));
+
+  // The cluster wide settings and all but the last host fit in the first batch.
+  Event::MockTimer* timer = new Event::MockTimer(&callbacks_.dispatcher_);
+  request_headers_.insertPath().value(std::string("/clusters"));
+  EXPECT_CALL(callbacks_, encodeHeaders_(_, false)).WillOnce(Invoke([](Http::HeaderMap& headers, bool) {
+    EXPECT_STREQ("200", headers.Status()->value().c_str());
+  }));
+  EXPECT_CALL(callbacks_, encodeData(_, false)).WillOnce(Invoke([](Buffer::Instance& data, bool) {
+    const std::string output = TestUtility::bufferToString(data);
+    EXPECT_EQ(0U, output.find("fake_cluster::default_priority::max_connections::"));
+    EXPECT_NE(std::string::npos, output.find("fake_cluster::10.0.0.98:80::weight::1\n"));
+    EXPECT_EQ(std::string::npos, output.find("fake_cluster::10.0.0.99:80::"));
+  }));
+  EXPECT_CALL(*timer, enableTimer(std::chrono::milliseconds(0)));
+  filter_.decodeHeaders(request_headers_, true);
+
+  // Hosts removed while the response is streamed are still written from the snapshot.
+  cluster.hosts_.clear();
+  EXPECT_CALL(callbacks_, encodeData(_, true)).WillOnce(Invoke([](Buffer::Instance& data, bool) {
+    const std::string output = TestUtility::bufferToString(data);
+    EXPECT_EQ(0U, output.find("fake_cluster::10.0.0.99:80::"));
+    EXPECT_NE(std::string::npos,
+              output.find("fake_cluster::10.0.0.99:80::health_flags::healthy\n"));
+  }));
+  timer->callback_();
+}
+
+TEST_P(AdminFilterTest, ProfileBadSeconds) {
+  request_headers_.insertPath().value(std::string("/profile?seconds=0"));
+  EXPECT_CALL(callbacks_, encodeHeaders_(_, false)).WillOnce(Invoke([](Http::HeaderMap& headers, bool) {
+    EXPECT_STREQ("400", headers.Status()->value().c_str());
+  }));
+  EXPECT_CALL(callbacks_, encodeData(_, true));
+  filter_.decodeHeaders(request_headers_, true);
+}
+
+#ifdef TCMALLOC
+
+TEST_P(AdminFilterTest, Profile) {
+  Event::MockTimer* timer = new Event::MockTimer(&callbacks_.dispatcher_);
+  request_headers_.insertPath().value(std::string("/profile?seconds=1"));
+  EXPECT_CALL(*timer, enableTimer(std::chrono::milliseconds(1000)));
+  filter_.decodeHeaders(request_headers_, true);
+  EXPECT_TRUE(Profiler::Cpu::profilerEnabled());
+
+  EXPECT_CALL(callbacks_, encodeHeaders_(_, false)).WillOnce(Invoke([](Http::HeaderMap& headers, bool) {
+    EXPECT_STREQ("200", headers.Status()->value().c_str());
+    EXPECT_STREQ("application/octet-stream", headers.ContentType()->value().c_str());
+  }));
+  EXPECT_CALL(callbacks_, encodeData(_, true));
+  timer->callback_();
+  EXPECT_FALSE(Profiler::Cpu::profilerEnabled());
+}
+
+TEST_P(AdminFilterTest, ProfileAbortedByReset) {
+  Event::MockTimer* timer = new Event::MockTimer(&callbacks_.dispatcher_);
+  request_headers_.insertPath().value(std::string("/profile?seconds=1"));
+  EXPECT_CALL(*timer, enableTimer(std::chrono::milliseconds(1000)));
+  filter_.decodeHeaders(request_headers_, true);
+  EXPECT_TRUE(Profiler::Cpu::profilerEnabled());
+
+  EXPECT_CALL(callbacks_, encodeHeaders_(_, _)).Times(0);
+  filter_.onDestroy();
+  EXPECT_FALSE(Profiler::Cpu::profilerEnabled());
+}
+
+#else
+
+TEST_P(AdminFilterTest, ProfileUnavailable) {
+  request_headers_.insertPath().value(std::string("/profile?seconds=1"));
+  EXPECT_CALL(callbacks_, encodeHeaders_(_, false)).WillOnce(Invoke([](Http::HeaderMap& headers, bool) {
+    EXPECT_STREQ("503", headers.Status()->value().c_str());
+  }));
+  EXPECT_CALL(callbacks_, encodeData(_, true));
+  filter_.decodeHeaders(request_headers_, true);
+}
+
+#endif
+
 class AdminInstanceTest : public testing::TestWithParam<Network::Address::IpVersion> {
 public:
   AdminInstanceTest()
@@ -90,8 +219,119 @@ TEST_P(AdminInstanceTest, AdminProfiler) {
   EXPECT_FALSE(Profiler::Cpu::profilerEnabled());
 }
 
+TEST_P(AdminInstanceTest, ContinuousProfiler) {
+  Event::MockTimer* timer = new Event::MockTimer(&server_.dispatcher_);
+  EXPECT_CALL(*timer, enableTimer(std::chrono::milliseconds(1000)));
+  EXPECT_TRUE(admin_.cpuProfileRecorder().startContinuous(10, std::chrono::milliseconds(1000)));
+  EXPECT_TRUE(Profiler::Cpu::profilerEnabled());
+
+  // /cpuprofiler can't take the profiler over.
+  Buffer::OwnedImpl response;
+  EXPECT_EQ(Http::Code::Conflict, admin_.runCallback("/cpuprofiler?enable=n", response));
+  EXPECT_TRUE(Profiler::Cpu::profilerEnabled());
+
+  response.drain(response.length());
+  EXPECT_EQ(Http::Code::NotFound, admin_.runCallback("/profile", response));
+
+  EXPECT_CALL(*timer, disableTimer());
+  EXPECT_CALL(*timer, enableTimer(std::chrono::milliseconds(1000)));
+  timer->callback_();
+  response.drain(response.length());
+  EXPECT_EQ(Http::Code::OK, admin_.runCallback("/profile", response));
+  EXPECT_NE(0U, response.length());
+  EXPECT_TRUE(Profiler::Cpu::profilerEnabled());
+
+  // A capture cuts the window short and a new one starts once it is done.
+  EXPECT_CALL(*timer, disableTimer());
+  std::chrono::milliseconds duration;
+  EXPECT_EQ(Http::Code::OK, admin_.startProfile("/profile?seconds=2", duration, response));
+  EXPECT_EQ(std::chrono::milliseconds(2000), duration);
+  EXPECT_EQ(Http::Code::ServiceUnavailable,
+            admin_.startProfile("/profile?seconds=2", duration, response));
+  EXPECT_CALL(*timer, enableTimer(std::chrono::milliseconds(1000)));
+  response.drain(response.length());
+  EXPECT_EQ(Http::Code::OK, admin_.finishProfile(response));
+  EXPECT_NE(0U, response.length());
+  EXPECT_TRUE(Profiler::Cpu::profilerEnabled());
+}
+
+TEST_P(AdminInstanceTest, HeapProfile) {
+  Buffer::OwnedImpl response;
+  EXPECT_EQ(Http::Code::OK, admin_.runCallback("/heapprofile", response));
+}
+
+#else
+
+TEST_P(AdminInstanceTest, ProfilerUnavailable) {
+  EXPECT_FALSE(admin_.cpuProfileRecorder().startContinuous(10, std::chrono::milliseconds(1000)));
+  Buffer::OwnedImpl response;
+  EXPECT_EQ(Http::Code::NotFound, admin_.runCallback("/profile", response));
+  EXPECT_EQ(Http::Code::NotImplemented, admin_.runCallback("/heapprofile", response));
+}
+
 #endif
 
+TEST_P(AdminInstanceTest, Memory) {
+  Buffer::OwnedImpl response;
+  EXPECT_EQ(Http::Code::OK, admin_.runCallback("/memory", response));
+  std::string output = TestUtility::bufferToString(response);
+  EXPECT_EQ(0U, output.find("allocated: "));
+  EXPECT_NE(std::string::npos, output.find("memory accounting is off"));
+
+  // Accounting can only be turned on with tcmalloc.
+  if (Memory::Accounting::enable()) {
+    response.drain(response.length());
+    EXPECT_EQ(Http::Code::OK, admin_.runCallback("/memory", response));
+    output = TestUtility::bufferToString(response);
+    EXPECT_NE(std::string::npos, output.find("header_map.net_bytes: "));
+  }
+}
+
+TEST_P(AdminInstanceTest, ServerInfo) {
+  server_.startup_phase_times_.emplace_back("parse", std::chrono::milliseconds(12));
+  server_.startup_phase_times_.emplace_back("configuration", std::chrono::milliseconds(345));
+  Buffer::OwnedImpl response;
+  EXPECT_EQ(Http::Code::OK, admin_.runCallback("/server_info", response));
+  std::string output = TestUtility::bufferToString(response);
+  EXPECT_EQ(0U, output.find("envoy "));
+  EXPECT_NE(std::string::npos,
+            output.find("\nstartup parse: 12ms\nstartup configuration: 345ms\n"));
+}
+
+TEST_P(AdminInstanceTest, RequestAllocations) {
+  Buffer::OwnedImpl response;
+  EXPECT_EQ(Http::Code::BadRequest, admin_.runCallback("/request_allocations", response));
+  EXPECT_EQ(Http::Code::BadRequest,
+            admin_.runCallback("/request_allocations?enable=maybe", response));
+
+  // Accounting can only be turned on with tcmalloc.
+  EXPECT_EQ(Memory::Accounting::enable() ? Http::Code::OK : Http::Code::NotImplemented,
+            admin_.runCallback("/request_allocations?enable=y", response));
+  EXPECT_EQ(Memory::Accounting::enable(), Memory::RequestAllocations::enabled());
+
+  EXPECT_EQ(Http::Code::OK, admin_.runCallback("/request_allocations?enable=n", response));
+  EXPECT_FALSE(Memory::RequestAllocations::enabled());
+}
+
+TEST_P(AdminInstanceTest, ReloadCerts) {
+  Buffer::OwnedImpl response;
+  EXPECT_EQ(Http::Code::OK, admin_.runCallback("/reload_certs", response));
+  EXPECT_EQ("OK\n", TestUtility::bufferToString(response));
+
+  Ssl::MockContextManager ssl_context_manager;
+  ON_CALL(server_, sslContextManager()).WillByDefault(ReturnRef(ssl_context_manager));
+  EXPECT_CALL(ssl_context_manager, reloadServerContexts())
+      .WillOnce(Throw(EnvoyException("bad cert")));
+  response.drain(response.length());
+  EXPECT_EQ(Http::Code::InternalServerError, admin_.runCallback("/reload_certs", response));
+  EXPECT_EQ("bad cert\n", TestUtility::bufferToString(response));
+}
+
+TEST_P(AdminInstanceTest, ProfileSecondsOnlyOverHttp) {
+  Buffer::OwnedImpl response;
+  EXPECT_EQ(Http::Code::BadRequest, admin_.runCallback("/profile?seconds=1", response));
+}
+
 TEST_P(AdminInstanceTest, AdminBadProfiler) {
   Buffer::OwnedImpl data;
   AdminImpl admin_bad_profile_path(
@@ -108,6 +348,72 @@ TEST_P(AdminInstanceTest, WriteAddressToFile) {
   EXPECT_EQ(admin_.socket().localAddress()->asString(), address_from_file);
 }
 
+TEST(StatsWriterTest, Text) {
+  Stats::IsolatedStoreImpl store;
+  store.counter("b.counter").inc();
+  store.gauge("a.gauge").set(5);
+  store.counter("c.unused");
+
+  Buffer::OwnedImpl response;
+  StatsWriter writer(store, {});
+  EXPECT_FALSE(writer.writeBatch(response));
+  EXPECT_EQ("a.gauge: 5\nb.counter: 1\nc.unused: 0\n", TestUtility::bufferToString(response));
+}
+
+TEST(StatsWriterTest, FilterAndUsedOnly) {
+  Stats::IsolatedStoreImpl store;
+  store.counter("cluster.foo.upstream_rq_total").inc();
+  store.counter("cluster.foo.upstream_cx_total");
+  store.counter("http.ingress.downstream_rq_total").inc();
+
+  Buffer::OwnedImpl response;
+  StatsWriter filtered(store, {{"filter", "^cluster\\."}});
+  filtered.writeBatch(response);
+  EXPECT_EQ("cluster.foo.upstream_cx_total: 0\ncluster.foo.upstream_rq_total: 1\n",
+            TestUtility::bufferToString(response));
+
+  response.drain(response.length());
+  StatsWriter used(store, {{"usedonly", ""}});
+  used.writeBatch(response);
+  EXPECT_EQ("cluster.foo.upstream_rq_total: 1\nhttp.ingress.downstream_rq_total: 1\n",
+            TestUtility::bufferToString(response));
+}
+
+TEST(StatsWriterTest, Prometheus) {
+  Stats::HeapRawStatDataAllocator alloc;
+  Stats::ThreadLocalStoreImpl store(alloc);
+  store.setTagProducer(Stats::TagProducerPtr{new Stats::TagProducerImpl()});
+  store.counter("cluster.foo.upstream_rq_503").add(3);
+  store.counter("cluster.bar.upstream_rq_200").add(2);
+  store.gauge("server.live").set(1);
+
+  Buffer::OwnedImpl response;
+  StatsWriter writer(store, {{"format", "prometheus"}, {"usedonly", ""}});
+  EXPECT_TRUE(writer.prometheus());
+  writer.writeBatch(response);
+  std::string output = TestUtility::bufferToString(response);
+
+  // Both clusters are series of the same metric, which only has one TYPE line.
+  EXPECT_EQ(0U, output.find("# TYPE envoy_cluster_upstream_rq counter\n"));
+  EXPECT_EQ(2, std::count(output.begin(), output.end(), '#'));
+  EXPECT_NE(std::string::npos,
+            output.find(
+                "envoy_cluster_upstream_rq{envoy_cluster_name=\"foo\",envoy_response_code=\"503\"} 3\n"));
+  EXPECT_NE(std::string::npos,
+            output.find(
+                "envoy_cluster_upstream_rq{envoy_cluster_name=\"bar\",envoy_response_code=\"200\"} 2\n"));
+  EXPECT_NE(std::string::npos, output.find("# TYPE envoy_server_live gauge\nenvoy_server_live 1\n"));
+
+  store.shutdownThreading();
+}
+
+TEST(StatsWriterTest, BadParams) {
+  Stats::IsolatedStoreImpl store;
+  EXPECT_THROW_WITH_MESSAGE(StatsWriter(store, {{"format", "xml"}}), EnvoyException,
+                            "unknown stats format 'xml'");
+  EXPECT_THROW(StatsWriter(store, {{"filter", "(("}}), EnvoyException);
+}
+
 TEST_P(AdminInstanceTest, AdminBadAddressOutPath) {
   std::string bad_path = TestEnvironment::temporaryPath("some/unlikely/bad/path/admin.address");
   AdminImpl admin_bad_address_out_path("/dev/null", cpu_profile_path_, bad_path,
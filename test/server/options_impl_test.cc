@@ -19,12 +19,16 @@ std::unique_ptr<OptionsImpl> createOptionsImpl(const std::string& args) {
   for (const std::string& s : words) {
     argv.push_back(s.c_str());
   }
-  return std::unique_ptr<OptionsImpl>(
-      new OptionsImpl(argv.size(), const_cast<char**>(&argv[0]), "1", spdlog::level::warn));
+  return std::unique_ptr<OptionsImpl>(new OptionsImpl(
+      argv.size(), const_cast<char**>(&argv[0]),
+      [](uint64_t max_stats) { return fmt::format("1.{}", max_stats); }, spdlog::level::warn));
 }
 
 TEST(OptionsImplDeathTest, HotRestartVersion) {
-  EXPECT_EXIT(createOptionsImpl("envoy --hot-restart-version"), testing::ExitedWithCode(0), "");
+  EXPECT_EXIT(createOptionsImpl("envoy --hot-restart-version"), testing::ExitedWithCode(0),
+              "1.16384");
+  EXPECT_EXIT(createOptionsImpl("envoy --hot-restart-version --max-stats 100"),
+              testing::ExitedWithCode(0), "1.100");
 }
 
 TEST(OptionsImplDeathTest, InvalidMode) {
@@ -36,7 +40,8 @@ TEST(OptionsImplTest, All) {
       "envoy --mode validate --concurrency 2 -c hello --admin-address-path path --restart-epoch 1 "
       "--local-address-ip-version v6 -l info --service-cluster cluster --service-node node "
       "--service-zone zone --file-flush-interval-msec 9000 --drain-time-s 60 "
-      "--parent-shutdown-time-s 90");
+      "--parent-shutdown-time-s 90 --max-stats 20000 --worker-cpus 2-4,8 --main-thread-cpus 0 "
+      "--memory-accounting --async-log-lines 1000");
   EXPECT_EQ(Server::Mode::Validate, options->mode());
   EXPECT_EQ(2U, options->concurrency());
   EXPECT_EQ("hello", options->configPath());
@@ -50,19 +55,33 @@ TEST(OptionsImplTest, All) {
   EXPECT_EQ(std::chrono::milliseconds(9000), options->fileFlushIntervalMsec());
   EXPECT_EQ(std::chrono::seconds(60), options->drainTime());
   EXPECT_EQ(std::chrono::seconds(90), options->parentShutdownTime());
+  EXPECT_EQ(20000U, options->maxStats());
+  EXPECT_EQ(std::vector<uint32_t>({2, 3, 4, 8}), options->workerCpus());
+  EXPECT_EQ(std::vector<uint32_t>({0}), options->mainThreadCpus());
+  EXPECT_TRUE(options->memoryAccounting());
+  EXPECT_EQ(1000U, options->asyncLogLines());
 }
 
 TEST(OptionsImplTest, DefaultParams) {
   std::unique_ptr<OptionsImpl> options = createOptionsImpl("envoy -c hello");
   EXPECT_EQ(std::chrono::seconds(600), options->drainTime());
   EXPECT_EQ(std::chrono::seconds(900), options->parentShutdownTime());
+  EXPECT_EQ(16384U, options->maxStats());
   EXPECT_EQ("", options->adminAddressPath());
   EXPECT_EQ(Network::Address::IpVersion::v4, options->localAddressIpVersion());
   EXPECT_EQ(Server::Mode::Serve, options->mode());
+  EXPECT_TRUE(options->workerCpus().empty());
+  EXPECT_TRUE(options->mainThreadCpus().empty());
+  EXPECT_FALSE(options->memoryAccounting());
+  EXPECT_EQ(0U, options->asyncLogLines());
 }
 
 TEST(OptionsImplTest, BadCliOption) {
   EXPECT_DEATH(createOptionsImpl("envoy -c hello --local-address-ip-version foo"),
                "error: unknown IP address version 'foo'");
+  EXPECT_DEATH(createOptionsImpl("envoy -c hello --worker-cpus 3-1"),
+               "error: invalid CPU list '3-1'");
+  EXPECT_DEATH(createOptionsImpl("envoy -c hello --main-thread-cpus 1-"),
+               "error: invalid CPU list '1-'");
 }
 } // Envoy
@@ -0,0 +1,230 @@
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "common/json/json_loader.h"
+#include "common/stats/stats_impl.h"
+
+#include "server/overload_manager_impl.h"
+
+#include "test/mocks/event/mocks.h"
+#include "test/mocks/thread_local/mocks.h"
+#include "test/test_common/utility.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using testing::Invoke;
+using testing::NiceMock;
+using testing::_;
+
+namespace Envoy {
+namespace Server {
+
+class OverloadManagerImplTest : public testing::Test {
+public:
+  void initialize(const std::string& json) {
+    Json::ObjectSharedPtr loader = Json::Factory::loadFromString(json);
+    manager_.reset(new OverloadManagerImpl(*loader, dispatcher_, tls_, stats_store_));
+    manager_->registerResource(OverloadResource::HeapSize, [this]() { return heap_size_; });
+    manager_->registerResource(OverloadResource::ActiveConnections,
+                               [this]() { return connections_; });
+    manager_->registerResource(OverloadResource::EventLoopLag, [this]() { return lag_ms_; });
+    manager_->registerResource(OverloadResource::BufferedBytes,
+                               [this]() { return buffered_bytes_; });
+  }
+
+  void start() {
+    timer_ = new Event::MockTimer(&dispatcher_);
+    EXPECT_CALL(*timer_, enableTimer(std::chrono::milliseconds(100)));
+    manager_->start();
+  }
+
+  void refresh() {
+    EXPECT_CALL(*timer_, enableTimer(std::chrono::milliseconds(100)));
+    timer_->callback_();
+  }
+
+  bool active(OverloadActionName action) { return manager_->getActionState(action).isActive(); }
+
+  uint64_t gauge(const std::string& name) {
+    return stats_store_.gauge("overload." + name).value();
+  }
+
+  const std::string default_json_{R"EOF(
+    {
+      "refresh_interval_ms": 100,
+      "reduced_buffer_limit_bytes": 4096,
+      "resources": {
+        "heap_size_bytes": 1000,
+        "active_connections": 100
+      },
+      "actions": [
+        {
+          "name": "disable_http_keepalive",
+          "triggers": [{"resource": "heap_size", "threshold_percent": 80}]
+        },
+        {
+          "name": "stop_accepting_connections",
+          "triggers": [
+            {"resource": "heap_size", "threshold_percent": 95},
+            {"resource": "active_connections", "threshold_percent": 100}
+          ]
+        }
+      ]
+    }
+    )EOF"};
+
+  NiceMock<Event::MockDispatcher> dispatcher_;
+  NiceMock<ThreadLocal::MockInstance> tls_;
+  Stats::IsolatedStoreImpl stats_store_;
+  Event::MockTimer* timer_{};
+  std::unique_ptr<OverloadManagerImpl> manager_;
+  uint64_t heap_size_{};
+  uint64_t connections_{};
+  uint64_t lag_ms_{};
+  uint64_t buffered_bytes_{};
+};
+
+TEST_F(OverloadManagerImplTest, Defaults) {
+  initialize("{}");
+  EXPECT_EQ(16384U, manager_->reducedBufferLimitBytes());
+
+  timer_ = new Event::MockTimer(&dispatcher_);
+  EXPECT_CALL(*timer_, enableTimer(std::chrono::milliseconds(250)));
+  manager_->start();
+  EXPECT_FALSE(active(OverloadActionName::StopAcceptingConnections));
+}
+
+TEST_F(OverloadManagerImplTest, ActionsFollowPressure) {
+  initialize(default_json_);
+  EXPECT_EQ(4096U, manager_->reducedBufferLimitBytes());
+
+  heap_size_ = 500;
+  start();
+  EXPECT_EQ(50U, gauge("heap_size.pressure"));
+  EXPECT_FALSE(active(OverloadActionName::DisableHttpKeepAlive));
+  EXPECT_FALSE(active(OverloadActionName::StopAcceptingConnections));
+
+  heap_size_ = 800;
+  refresh();
+  EXPECT_TRUE(active(OverloadActionName::DisableHttpKeepAlive));
+  EXPECT_FALSE(active(OverloadActionName::StopAcceptingConnections));
+  EXPECT_EQ(1U, gauge("disable_http_keepalive.active"));
+
+  // Any trigger activates an action.
+  connections_ = 100;
+  refresh();
+  EXPECT_EQ(100U, gauge("active_connections.pressure"));
+  EXPECT_TRUE(active(OverloadActionName::StopAcceptingConnections));
+
+  heap_size_ = 100;
+  connections_ = 10;
+  refresh();
+  EXPECT_FALSE(active(OverloadActionName::DisableHttpKeepAlive));
+  EXPECT_FALSE(active(OverloadActionName::StopAcceptingConnections));
+  EXPECT_EQ(0U, gauge("disable_http_keepalive.active"));
+  EXPECT_EQ(0U, gauge("stop_accepting_connections.active"));
+}
+
+TEST_F(OverloadManagerImplTest, ShrinkHeapReleasesOnActivation) {
+  initialize(R"EOF(
+    {
+      "refresh_interval_ms": 100,
+      "resources": {"event_loop_lag_ms": 200},
+      "actions": [
+        {
+          "name": "shrink_heap",
+          "triggers": [{"resource": "event_loop_lag", "threshold_percent": 50}]
+        }
+      ]
+    }
+    )EOF");
+
+  EXPECT_CALL(tls_, runOnAllThreads(_)).Times(0);
+  start();
+
+  // The caches are released once, when the action is activated.
+  lag_ms_ = 100;
+  EXPECT_CALL(tls_, runOnAllThreads(_));
+  refresh();
+  EXPECT_TRUE(active(OverloadActionName::ShrinkHeap));
+
+  EXPECT_CALL(tls_, runOnAllThreads(_)).Times(0);
+  refresh();
+  EXPECT_TRUE(active(OverloadActionName::ShrinkHeap));
+}
+
+TEST_F(OverloadManagerImplTest, CallbacksPostedWhileActive) {
+  initialize(R"EOF(
+    {
+      "refresh_interval_ms": 100,
+      "resources": {"buffered_bytes": 1000},
+      "actions": [
+        {
+          "name": "reset_largest_connections",
+          "triggers": [{"resource": "buffered_bytes", "threshold_percent": 90}]
+        }
+      ]
+    }
+    )EOF");
+
+  NiceMock<Event::MockDispatcher> worker_dispatcher;
+  uint32_t resets = 0;
+  manager_->registerForAction(OverloadActionName::ResetLargestConnections, worker_dispatcher,
+                              [&resets]() -> void { resets++; });
+  ON_CALL(worker_dispatcher, post(_)).WillByDefault(Invoke([](std::function<void()> cb) {
+    cb();
+  }));
+
+  EXPECT_CALL(worker_dispatcher, post(_)).Times(0);
+  start();
+
+  // The callback keeps running on every refresh for as long as the action is active.
+  buffered_bytes_ = 950;
+  EXPECT_CALL(worker_dispatcher, post(_)).Times(2);
+  refresh();
+  refresh();
+  EXPECT_EQ(95U, gauge("buffered_bytes.pressure"));
+  EXPECT_TRUE(active(OverloadActionName::ResetLargestConnections));
+  EXPECT_EQ(2U, resets);
+
+  buffered_bytes_ = 100;
+  EXPECT_CALL(worker_dispatcher, post(_)).Times(0);
+  refresh();
+  EXPECT_FALSE(active(OverloadActionName::ResetLargestConnections));
+  EXPECT_EQ(2U, resets);
+}
+
+TEST_F(OverloadManagerImplTest, TriggerOnResourceWithoutMaximum) {
+  EXPECT_THROW_WITH_MESSAGE(initialize(R"EOF(
+    {
+      "actions": [
+        {
+          "name": "reduce_buffer_limits",
+          "triggers": [{"resource": "heap_size", "threshold_percent": 90}]
+        }
+      ]
+    }
+    )EOF"),
+                            EnvoyException, "overload action 'reduce_buffer_limits' triggers on "
+                                            "resource 'heap_size' which has no maximum");
+}
+
+TEST_F(OverloadManagerImplTest, BadConfig) {
+  EXPECT_THROW(initialize(R"EOF(
+    {
+      "resources": {"heap_size_bytes": 1000},
+      "actions": [
+        {
+          "name": "unknown_action",
+          "triggers": [{"resource": "heap_size", "threshold_percent": 90}]
+        }
+      ]
+    }
+    )EOF"),
+               Json::Exception);
+}
+
+} // Server
+} // Envoy
@@ -0,0 +1,48 @@
+#include "test/test_common/allocation_counter.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "common/common/assert.h"
+
+#ifdef TCMALLOC
+#include "gperftools/malloc_hook.h"
+#endif
+
+namespace Envoy {
+
+namespace {
+
+std::atomic<uint64_t> allocation_count{0};
+
+#ifdef TCMALLOC
+void newHook(const void*, size_t) { allocation_count.fetch_add(1, std::memory_order_relaxed); }
+#endif
+
+} // namespace
+
+AllocationCounter::AllocationCounter() {
+  allocation_count = 0;
+#ifdef TCMALLOC
+  RELEASE_ASSERT(MallocHook::AddNewHook(&newHook));
+#endif
+}
+
+AllocationCounter::~AllocationCounter() {
+#ifdef TCMALLOC
+  RELEASE_ASSERT(MallocHook::RemoveNewHook(&newHook));
+#endif
+}
+
+bool AllocationCounter::supported() {
+#ifdef TCMALLOC
+  return true;
+#else
+  return false;
+#endif
+}
+
+uint64_t AllocationCounter::allocations() const { return allocation_count; }
+
+} // Envoy
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Envoy {
+
+/**
+ * Counts the heap allocations made by all threads of the process while an instance is alive. Used
+ * by benchmarks to report allocations per operation. Allocations are observed through the tcmalloc
+ * malloc hooks, so nothing is counted without tcmalloc. Only one counter may be alive at a time.
+ */
+class AllocationCounter {
+public:
+  AllocationCounter();
+  ~AllocationCounter();
+
+  /**
+   * @return bool whether allocations can be counted, i.e. whether tcmalloc is in use.
+   */
+  static bool supported();
+
+  /**
+   * @return uint64_t the number of allocations made since the counter was created.
+   */
+  uint64_t allocations() const;
+};
+
+} // Envoy
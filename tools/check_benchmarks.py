@@ -0,0 +1,72 @@
+#!/usr/bin/env python
+
+# This tool reads the output of the DISABLED_ benchmark tests on stdin and fails if any metric listed
+# in the thresholds file given as the only argument is slower than its threshold, or was not
+# reported at all.
+#
+# Benchmarks report a metric either as "name: ... <N>ns/op" or as "[name: ]... key=<N>ns" (us and
+# ms are also accepted). The metric is called "name" in the first case and "name.key" in the
+# second. Lines without a "name:" prefix are named after the test that printed them, without the
+# DISABLED_ prefix, e.g. "RouteMatcherBenchmark.LargeRouteTable.per_lookup".
+#
+# The thresholds file has one "<metric> <max ns>" pair per line. Blank lines and lines starting
+# with # are ignored.
+
+import re
+import sys
+
+UNIT_NS = {"ns": 1, "us": 1000, "ms": 1000000}
+
+
+def ParseThresholds(path):
+  thresholds = {}
+  with open(path) as f:
+    for line in f:
+      line = line.strip()
+      if not line or line.startswith("#"):
+        continue
+      metric, max_ns = line.split()
+      thresholds[metric] = int(max_ns)
+  return thresholds
+
+
+def ParseMetrics(f):
+  metrics = {}
+  test = None
+  for line in f:
+    run = re.match(r"\[ RUN +\] DISABLED_(\S+)", line)
+    if run:
+      test = run.group(1)
+      continue
+    named = re.match(r"([\w ]+): (.*)", line)
+    name, values = named.groups() if named else (test, line)
+    if not name:
+      continue
+    for key, value, unit in re.findall(r"(\w+)=(\d+)(ns|us|ms)\b", values):
+      metrics["%s.%s" % (name, key)] = int(value) * UNIT_NS[unit]
+    per_op = re.search(r"\b(\d+)ns/op\b", values)
+    if per_op:
+      metrics[name] = int(per_op.group(1))
+  return metrics
+
+
+def CheckBenchmarks(thresholds, metrics):
+  failed = False
+  for metric in sorted(thresholds):
+    if metric not in metrics:
+      print "MISSING: %s" % metric
+      failed = True
+    elif metrics[metric] > thresholds[metric]:
+      print "SLOW: %s %dns > %dns" % (metric, metrics[metric], thresholds[metric])
+      failed = True
+    else:
+      print "OK: %s %dns <= %dns" % (metric, metrics[metric], thresholds[metric])
+  return not failed
+
+
+if __name__ == "__main__":
+  if len(sys.argv) != 2:
+    print "Usage: %s <thresholds file> < <benchmark output>" % sys.argv[0]
+    sys.exit(1)
+  if not CheckBenchmarks(ParseThresholds(sys.argv[1]), ParseMetrics(sys.stdin)):
+    sys.exit(1)
@@ -0,0 +1,170 @@
+#!/usr/bin/env python
+
+# This tool replays a trace written by the tap network filter against a listener, e.g. an Envoy
+# under test or the upstream of a benchmark. Every tapped connection is opened at the same offset
+# from the start of the trace as it was originally, and the data that was read from the downstream
+# client is sent at its original offsets. Responses are read and discarded. Offsets are divided by
+# --speed, and --speed=0 replays everything as fast as possible.
+#
+# The summary is printed in the format that check_benchmarks.py understands, e.g.:
+#   tap_replay: connections=12 sent_bytes=3456 received_bytes=7890 replay_time=1234ms
+#
+# Usage: tap_replay.py [--speed=<factor>] <trace> <host>:<port>
+
+import argparse
+import collections
+import errno
+import select
+import socket
+import struct
+import sys
+import time
+
+# @see TapBuffer in source/common/filter/tap.h.
+RECORD_HEADER = struct.Struct("<BQQI")
+CONNECTED, READ, WRITE, CLOSED = range(4)
+
+Record = collections.namedtuple("Record", ["event", "connection_id", "timestamp_us", "data"])
+
+
+def ReadTrace(path):
+  records = []
+  with open(path, "rb") as f:
+    trace = f.read()
+  offset = 0
+  while offset + RECORD_HEADER.size <= len(trace):
+    event, connection_id, timestamp_us, length = RECORD_HEADER.unpack_from(trace, offset)
+    offset += RECORD_HEADER.size
+    if offset + length > len(trace):
+      break
+    records.append(Record(event, connection_id, timestamp_us, trace[offset:offset + length]))
+    offset += length
+  if offset != len(trace):
+    sys.stderr.write("ignoring %d bytes of truncated record at the end of %s\n" %
+                     (len(trace) - offset, path))
+  return records
+
+
+def Schedule(records):
+  # Connections of different runs may share ids so a connection only lives from its Connected
+  # record to its Closed record. Data of connections that were already open when the trace was
+  # started is skipped since the beginning of the stream is missing.
+  start_us = min(record.timestamp_us for record in records) if records else 0
+  schedule = []
+  open_connections = {}
+  next_index = 0
+  for record in sorted(records, key=lambda record: record.timestamp_us):
+    offset_s = (record.timestamp_us - start_us) / 1e6
+    if record.event == CONNECTED:
+      open_connections[record.connection_id] = next_index
+      schedule.append((offset_s, next_index, CONNECTED, b""))
+      next_index += 1
+    elif record.connection_id not in open_connections:
+      continue
+    elif record.event == READ:
+      schedule.append((offset_s, open_connections[record.connection_id], READ, record.data))
+    elif record.event == CLOSED:
+      schedule.append((offset_s, open_connections.pop(record.connection_id), CLOSED, b""))
+  return schedule
+
+
+class Replay(object):
+
+  def __init__(self, address, speed):
+    self.address = address
+    self.speed = speed
+    self.sockets = {}
+    self.pending = collections.defaultdict(bytes)
+    self.closing = set()
+    self.connections = 0
+    self.sent_bytes = 0
+    self.received_bytes = 0
+
+  def Run(self, schedule):
+    start = time.time()
+    position = 0
+    while position < len(schedule):
+      offset_s, index, event, data = schedule[position]
+      due = start + (offset_s / self.speed if self.speed else 0)
+      if due > time.time():
+        self.Poll(due - time.time())
+        continue
+      self.Apply(index, event, data)
+      position += 1
+
+    # Connections that were still open when the trace ended are closed once their data is sent.
+    for index in list(self.sockets):
+      self.Apply(index, CLOSED, b"")
+    while self.sockets:
+      self.Poll(None)
+    return time.time() - start
+
+  def Apply(self, index, event, data):
+    if event == CONNECTED:
+      self.sockets[index] = socket.create_connection(self.address)
+      self.sockets[index].setblocking(False)
+      self.connections += 1
+    elif index not in self.sockets:
+      return
+    elif event == READ:
+      self.pending[index] += data
+    elif event == CLOSED and not self.pending[index]:
+      self.Close(index)
+    elif event == CLOSED:
+      self.closing.add(index)
+
+  def Poll(self, timeout):
+    if not self.sockets:
+      if timeout:
+        time.sleep(timeout)
+      return
+    readers = list(self.sockets.values())
+    writers = [self.sockets[index] for index in self.sockets if self.pending[index]]
+    readable, writable, _ = select.select(readers, writers, [], timeout)
+    for index, sock in list(self.sockets.items()):
+      if sock in writable:
+        try:
+          sent = sock.send(self.pending[index])
+        except socket.error as e:
+          if e.errno in (errno.EAGAIN, errno.EWOULDBLOCK):
+            continue
+          self.Close(index)
+          continue
+        self.sent_bytes += sent
+        self.pending[index] = self.pending[index][sent:]
+        if not self.pending[index] and index in self.closing:
+          self.Close(index)
+          continue
+      if sock in readable:
+        try:
+          data = sock.recv(65536)
+        except socket.error:
+          data = b""
+        if not data:
+          self.Close(index)
+          continue
+        self.received_bytes += len(data)
+
+  def Close(self, index):
+    self.sockets.pop(index).close()
+    self.pending.pop(index, None)
+    self.closing.discard(index)
+
+
+def main():
+  parser = argparse.ArgumentParser(description="Replay a tap filter trace.")
+  parser.add_argument("--speed", type=float, default=1.0,
+                      help="replay speed factor, 0 replays as fast as possible")
+  parser.add_argument("trace")
+  parser.add_argument("address", help="<host>:<port> to replay to")
+  args = parser.parse_args()
+
+  host, port = args.address.rsplit(":", 1)
+  replay = Replay((host.strip("[]"), int(port)), args.speed)
+  elapsed = replay.Run(Schedule(ReadTrace(args.trace)))
+  print("tap_replay: connections=%d sent_bytes=%d received_bytes=%d replay_time=%dms" %
+        (replay.connections, replay.sent_bytes, replay.received_bytes, elapsed * 1000))
+
+
+if __name__ == "__main__":
+  main()